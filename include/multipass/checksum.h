@@ -0,0 +1,64 @@
+/*
+ * Copyright (C) Canonical, Ltd.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; version 3.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#ifndef MULTIPASS_CHECKSUM_H
+#define MULTIPASS_CHECKSUM_H
+
+#include <multipass/disabled_copy_move.h>
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string>
+
+struct evp_md_ctx_st;
+
+namespace multipass
+{
+namespace checksum
+{
+// CRC-32 as zlib, gzip and xz have it. Pass the previous result along to carry on over more data. Runs on the
+// carry-less multiply (x86-64) or CRC32 (ARMv8) instructions when the CPU has them
+std::uint32_t crc32(const void* data, std::size_t size, std::uint32_t crc = 0);
+
+// CRC-64 as xz has it (ECMA-182 polynomial, reflected)
+std::uint64_t crc64(const void* data, std::size_t size, std::uint64_t crc = 0);
+
+// Which of the above crc32 picked for this CPU, to be told in logs
+const char* crc32_implementation();
+
+// MD4, as zsync checks blocks with. Long broken, only ever to tell blocks apart that a stronger hash covers as a whole
+std::array<std::uint8_t, 16> md4(const void* data, std::size_t size);
+
+// Streaming SHA-256, through OpenSSL so that it runs on the SHA extensions (x86 SHA-NI, ARMv8) when there are any
+class Sha256 : private DisabledCopyMove
+{
+public:
+    Sha256();
+    ~Sha256();
+
+    void add_data(const void* data, std::size_t size);
+    void reset();
+    std::string hex_digest() const; // of all the data so far, more can still be added
+
+private:
+    std::unique_ptr<evp_md_ctx_st, void (*)(evp_md_ctx_st*)> context;
+};
+} // namespace checksum
+} // namespace multipass
+#endif // MULTIPASS_CHECKSUM_H
@@ -21,6 +21,7 @@
 #include <multipass/alias_definition.h>
 #include <multipass/terminal.h>
 
+#include <memory>
 #include <optional>
 #include <string>
 #include <unordered_map>
@@ -30,12 +31,16 @@ class QJsonObject;
 
 namespace multipass
 {
+class AliasIndex;
+
 static constexpr auto default_context_name = "default";
 
 typedef std::pair<std::string, std::string> ContextAliasPair;
 
 // The alias dictionary is basically a mapping between strings and contexts. The string represents the context name
 // and the associated context is itself a map relating alias names to alias definitions.
+// While it is only asked for the active context or to resolve an alias, the dictionary answers from the index of the
+// aliases file, and it parses the file the first time it needs anything else.
 class AliasDict
 {
 public:
@@ -60,26 +65,32 @@ public:
     std::optional<AliasDefinition> get_alias(const std::string& alias) const;
     DictType::iterator begin()
     {
+        load();
         return aliases.begin();
     }
     DictType::iterator end()
     {
+        load();
         return aliases.end();
     }
     DictType::const_iterator cbegin() const
     {
+        load();
         return aliases.cbegin();
     }
     DictType::const_iterator cend() const
     {
+        load();
         return aliases.cend();
     }
     bool empty() const
     {
+        load();
         return (aliases.empty() || (aliases.size() == 1 && get_active_context().empty()));
     }
     size_type size() const
     {
+        load();
         return aliases.size();
     }
     void clear()
@@ -96,16 +107,21 @@ public:
     QJsonObject to_json() const;
 
 private:
-    void load_dict();
+    void load() const;
+    void load_dict() const;
     void save_dict();
+    void save_index() const;
     void sanitize_contexts();
     std::optional<AliasDefinition> get_alias_from_all_contexts(const std::string& alias) const;
 
-    std::string active_context;
-    DictType aliases;
+    // Both only filled in once loaded, until then it is all in the index
+    mutable std::string active_context;
+    mutable DictType aliases;
+    mutable std::shared_ptr<const AliasIndex> index;
 
     bool modified = false;
     std::string aliases_file;
+    std::string index_file;
     std::ostream& cout;
     std::ostream& cerr;
 }; // class AliasDict
@@ -0,0 +1,65 @@
+/*
+ * Copyright (C) Canonical, Ltd.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; version 3.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#ifndef MULTIPASS_ALIAS_INDEX_H
+#define MULTIPASS_ALIAS_INDEX_H
+
+#include <multipass/alias_definition.h>
+#include <multipass/disabled_copy_move.h>
+
+#include <QFile>
+#include <QFileInfo>
+
+#include <memory>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace multipass
+{
+// A compact hash table from what an alias can be invoked as to its definition, as AliasDict::get_alias resolves it.
+// It is kept next to the aliases file and mapped into memory, so looking an alias up does not need to parse anything.
+// It carries the size and modification time of the aliases file it was made from, to tell when it is out of date.
+class AliasIndex : private DisabledCopyMove
+{
+public:
+    using Entries = std::vector<std::pair<std::string, AliasDefinition>>;
+
+    // nullptr unless there is an index at the path, and it is current for the source
+    static std::unique_ptr<AliasIndex> open(const QString& path, const QFileInfo& source);
+    static bool write(const QString& path, const QFileInfo& source, const std::string& active_context,
+                      const Entries& entries);
+
+    const std::string& active_context() const;
+    std::optional<AliasDefinition> find(const std::string& key) const;
+
+private:
+    explicit AliasIndex(const QString& path);
+
+    template <typename T>
+    bool read(qint64 pos, T& value) const;
+    bool read_string(qint64& pos, std::string_view& value) const;
+
+    QFile file;
+    const uchar* data = nullptr;
+    qint64 size = 0;
+    quint32 bucket_count = 0;
+    std::string active;
+};
+} // namespace multipass
+#endif // MULTIPASS_ALIAS_INDEX_H
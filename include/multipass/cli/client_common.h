@@ -27,6 +27,8 @@
 #include <multipass/rpc/multipass.grpc.pb.h>
 #include <multipass/ssl_cert_provider.h>
 
+#include <QStringList>
+
 #include <memory>
 #include <string>
 
@@ -40,6 +42,7 @@ const QString cert_file_suffix{".pem"};
 const QString key_file_suffix{"_key.pem"};
 const QString client_cert_file{client_cert_prefix + cert_file_suffix};
 const QString client_key_file{client_cert_prefix + key_file_suffix};
+const QString client_session_file{"multipass_session"};
 
 namespace logging
 {
@@ -68,6 +71,9 @@ namespace client
 QString persistent_settings_filename();
 void register_global_settings_handlers();
 std::shared_ptr<grpc::Channel> make_channel(const std::string& server_address, CertProvider* cert_provider);
+void keep_session(const grpc::ClientContext& context); // the daemon's token, if it offered one
+// As "multipass <alias> --" when invoked through the link of a known alias, otherwise as they are
+QStringList alias_invocation_arguments(const QStringList& arguments, Terminal* term);
 std::string get_server_address();
 std::unique_ptr<SSLCertProvider> get_cert_provider();
 void set_logger();
@@ -19,6 +19,7 @@
 #define MULTIPASS_COMMAND_H
 
 #include <multipass/callable_traits.h>
+#include <multipass/cli/client_common.h>
 #include <multipass/cli/return_codes.h>
 #include <multipass/disabled_copy_move.h>
 #include <multipass/format.h>
@@ -89,6 +90,7 @@ protected:
 
         if (status.ok())
         {
+            client::keep_session(context);
             return on_success(reply);
         }
         else if (status.error_code() != grpc::StatusCode::UNAVAILABLE)
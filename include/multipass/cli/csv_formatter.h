@@ -31,6 +31,7 @@ public:
     std::string format(const FindReply& list) const override;
     std::string format(const VersionReply& list, const std::string& client_version) const override;
     std::string format(const AliasDict& aliases) const override;
+    std::unique_ptr<ListFormatStream> list_stream() const override;
 };
 }
 #endif // MULTIPASS_CSV_FORMATTER
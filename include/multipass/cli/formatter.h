@@ -24,12 +24,22 @@
 #include <multipass/cli/alias_dict.h>
 #include <multipass/cli/client_platform.h>
 
+#include <memory>
 #include <string>
 
 namespace multipass
 {
 constexpr auto default_id_str = "default";
 
+// Formats a list that comes in several replies, handing back whatever output it can as each of them arrives
+class ListFormatStream : private DisabledCopyMove
+{
+public:
+    virtual ~ListFormatStream() = default;
+    virtual std::string add(const ListReply& chunk) = 0;
+    virtual std::string finish() = 0; // the rest, once the last chunk is in
+};
+
 class Formatter : private DisabledCopyMove
 {
 public:
@@ -41,6 +51,8 @@ public:
     virtual std::string format(const VersionReply& reply, const std::string& client_version) const = 0;
     virtual std::string format(const AliasDict& aliases) const = 0;
 
+    virtual std::unique_ptr<ListFormatStream> list_stream() const; // by default, formats it all at the end
+
 protected:
     Formatter() = default;
 
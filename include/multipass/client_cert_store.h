@@ -25,6 +25,10 @@
 #include <QList>
 #include <QSslCertificate>
 
+#include <mutex>
+#include <string>
+#include <unordered_set>
+
 namespace multipass
 {
 class ClientCertStore : public CertStore
@@ -41,6 +45,13 @@ private:
 
     QDir cert_dir;
     QList<QSslCertificate> authenticated_client_certs;
+    std::unordered_set<std::string> fingerprints; // SHA-256 of each authenticated cert
+
+    // Certs as they come from connections, once they've been found in the store. Every call from a client brings the
+    // same PEM, so it only needs parsing the first time. Only what was authenticated is kept, which the store never
+    // takes back, and which does not grow with whoever knocks.
+    std::unordered_set<std::string> verified_pem_certs;
+    std::mutex mutex;
 };
 } // namespace multipass
 #endif // MULTIPASS_CLIENT_CERT_STORE_H
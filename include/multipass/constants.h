@@ -50,18 +50,50 @@ constexpr auto winterm_profile_guid =
 
 constexpr auto bridged_network_name = "bridged";
 
+constexpr auto readiness_port_name = "com.canonical.multipass.ready"; // virtio port guests open once booted, if any
+constexpr auto vsock_ssh_port = 22; // where guests with a vsock device listen for SSH on it
+
 constexpr auto settings_extension = ".conf";
 constexpr auto daemon_settings_root = "local";
 
 constexpr auto petenv_key = "client.primary-name";  // This will eventually be moved to some dynamic settings schema
 constexpr auto driver_key = "local.driver";         // idem
 constexpr auto passphrase_key = "local.passphrase"; // idem
-constexpr auto bridged_interface_key = "local.bridged-network";       // idem
-constexpr auto mounts_key = "local.privileged-mounts";                // idem
-constexpr auto autostart_key = "client.gui.autostart";                // idem
-constexpr auto winterm_key = "client.apps.windows-terminal.profiles"; // idem
-constexpr auto hotkey_key = "client.gui.hotkey";                      // idem
-constexpr auto mirror_key = "local.image.mirror";                     // idem; this defines the mirror of simple streams
+constexpr auto bridged_interface_key = "local.bridged-network";        // idem
+constexpr auto mounts_key = "local.privileged-mounts";                 // idem
+constexpr auto autostart_key = "client.gui.autostart";                 // idem
+constexpr auto winterm_key = "client.apps.windows-terminal.profiles";  // idem
+constexpr auto hotkey_key = "client.gui.hotkey";                       // idem
+constexpr auto mirror_key = "local.image.mirror";                      // idem; comma-separated simple streams mirrors
+constexpr auto ssh_compression_key = "local.ssh-compression";          // idem; one of auto, on or off
+constexpr auto sshfs_shared_server_key = "local.sshfs-shared-server";  // idem; one sshfs_server for an instance
+constexpr auto sshfs_write_behind_key = "local.sshfs-write-behind";    // idem; acknowledge writes before they land
+constexpr auto qemu_virtiofs_key = "local.qemu.virtiofs";              // idem; classic mounts over virtiofs, if found
+constexpr auto transfer_window_key = "local.transfer-window";          // idem; reads in flight when pulling a file
+constexpr auto qemu_page_reporting_key = "local.qemu.page-reporting";  // idem; guests hand back pages they free
+constexpr auto qemu_reattach_key = "local.qemu.reattach";              // idem; instances outlive the daemon stopping
+constexpr auto qemu_nocloud_net_key = "local.qemu.nocloud-net";        // idem; seeds served over the bridge, not ISOs
+constexpr auto qemu_state_file_key = "local.qemu.state-file";          // idem; suspend to a file of its own, not savevm
+constexpr auto qemu_vsock_key = "local.qemu.vsock";                    // idem; guests reachable over vsock
+constexpr auto qemu_guest_agent_key = "local.qemu.guest-agent";        // idem; info asks qemu-guest-agent, not SSH
+constexpr auto ssh_control_persist_key = "client.ssh-control-persist"; // idem; seconds to keep sessions, 0 disables
+constexpr auto image_peers_key = "local.image.peers";                  // idem; daemons to get images from first
+constexpr auto image_share_port_key = "local.image.share-port";        // idem; serves images to peers, empty disables
+constexpr auto image_share_address_key = "local.image.share-address";  // idem; the address images are served on
+constexpr auto image_prewarm_key = "local.image.prewarm";              // idem; images and blueprints to keep prepared
+constexpr auto image_lazy_hosts_key = "local.image.lazy-hosts";        // idem; fetch manifests only when needed
+constexpr auto image_cache_size_key = "local.image.cache-size";        // idem; unused images evicted past it, or empty
+constexpr auto image_compression_key = "local.image.compression";      // idem; none or zstd, for cached qemu images
+constexpr auto ksm_key = "local.ksm";                                  // idem; host, on or off: who runs memory merging
+constexpr auto ksm_pages_to_scan_key = "local.ksm.pages-to-scan";      // idem; pages KSM looks at per run, when on
+constexpr auto bulk_parallelism_key = "local.bulk-parallelism";        // idem; instances to stop/suspend/delete at once
+constexpr auto warm_pool_key = "local.warm-pool";                      // idem; instances to keep booted for launch
+constexpr auto cpu_overcommit_key = "local.overcommit.cpus";           // idem; host CPUs times this, 0 for no limit
+constexpr auto memory_overcommit_key = "local.overcommit.memory";      // idem; host memory times this, 0 for no limit
+constexpr auto disk_overcommit_key = "local.overcommit.disk";          // idem; storage size times this, 0 for no limit
+constexpr auto placement_key = "local.placement";                      // idem; none or numa, for new instances' vCPUs
+constexpr auto rpc_compression_key = "client.rpc-compression";         // idem; accept compressed daemon replies
+constexpr auto rpc_keepalive_key = "client.rpc-keepalive";             // idem; seconds between pings, 0 disables
 
 [[maybe_unused]] // hands off clang-format
 constexpr auto key_examples = {autostart_key, driver_key, mounts_key};
@@ -72,6 +104,7 @@ constexpr auto hotkey_default = "Ctrl+Alt+U";                         // idem; t
 constexpr auto timeout_exit_code = 5;
 
 constexpr auto authenticated_certs_dir = "authenticated-certs";
+constexpr auto session_metadata_key = "multipass-session"; // the token handed to clients for the local socket
 } // namespace multipass
 
 #endif // MULTIPASS_CONSTANTS_H
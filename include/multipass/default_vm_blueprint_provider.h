@@ -23,6 +23,7 @@
 
 #include <yaml-cpp/yaml.h>
 
+#include <QByteArray>
 #include <QDir>
 #include <QString>
 #include <QSysInfo>
@@ -30,6 +31,7 @@
 
 #include <chrono>
 #include <map>
+#include <mutex>
 
 namespace multipass
 {
@@ -66,8 +68,10 @@ private:
     const std::chrono::milliseconds blueprints_ttl;
     std::chrono::steady_clock::time_point last_update;
     std::map<std::string, YAML::Node> blueprint_map;
+    QByteArray archive_hash; // of the archive blueprint_map was read from
     bool needs_update{true};
     const QString arch;
+    std::recursive_mutex blueprints_mutex; // find asks off the main thread; all_blueprints() goes through info_for()
 };
 } // namespace multipass
 #endif // MULTIPASS_DEFAULT_VM_BLUEPRINT_PROVIDER_H
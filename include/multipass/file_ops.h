@@ -59,6 +59,7 @@ public:
     virtual bool open(QFileDevice& file, QIODevice::OpenMode mode) const;
     virtual QFileDevice::Permissions permissions(const QFile& file) const;
     virtual qint64 read(QFile& file, char* data, qint64 maxSize) const;
+    virtual qint64 read_at(QFile& file, char* data, qint64 maxSize, qint64 pos) const; // positional, no seek
     virtual QByteArray read_all(QFile& file) const;
     virtual QString read_line(QTextStream& text_stream) const;
     virtual bool remove(QFile& file) const;
@@ -88,6 +89,9 @@ public:
     virtual fs::path read_symlink(const fs::path& path, std::error_code& err) const;
     virtual void permissions(const fs::path& path, fs::perms perms, std::error_code& err) const;
     virtual fs::file_status status(const fs::path& path, std::error_code& err) const;
+    virtual std::uintmax_t file_size(const fs::path& path, std::error_code& err) const;
+    virtual fs::file_time_type last_write_time(const fs::path& path, std::error_code& err) const;
+    virtual void last_write_time(const fs::path& path, fs::file_time_type new_time, std::error_code& err) const;
     virtual std::unique_ptr<RecursiveDirIterator> recursive_dir_iterator(const fs::path& path,
                                                                          std::error_code& err) const;
 };
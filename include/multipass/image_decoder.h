@@ -0,0 +1,84 @@
+/*
+ * Copyright (C) Canonical, Ltd.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; version 3.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#ifndef MULTIPASS_IMAGE_DECODER_H
+#define MULTIPASS_IMAGE_DECODER_H
+
+#include <multipass/path.h>
+#include <multipass/progress_monitor.h>
+
+#include <QByteArray>
+#include <QString>
+
+#include <cstddef>
+#include <memory>
+
+namespace multipass
+{
+// Decodes a compressed image file into another, at once
+class ImageDecoder
+{
+public:
+    using UPtr = std::unique_ptr<ImageDecoder>;
+
+    virtual ~ImageDecoder() = default;
+    virtual void decode_to(const Path& decoded_file_path, const ProgressMonitor& monitor) = 0;
+};
+
+// Decodes data into a file as it is handed over piecemeal, e.g. as it comes off the network
+class StreamDecoder
+{
+public:
+    using UPtr = std::unique_ptr<StreamDecoder>;
+
+    virtual ~StreamDecoder() = default;
+    virtual void decode(const char* data, std::size_t size) = 0;
+    // Drops what was decoded so far, for the data to be handed over again from the beginning
+    virtual void restart() = 0;
+    // Throws unless the whole stream was decoded
+    virtual void finish() = 0;
+};
+
+namespace decoding
+{
+enum class Codec
+{
+    raw,
+    xz,
+    zstd,
+    gzip
+};
+
+constexpr auto magic_size = 6; // enough to tell them all apart
+
+// By the magic bytes data starts with, raw when they are none of the others'
+Codec codec_of(const QByteArray& head);
+
+// Whether the image is served compressed, by its suffix, and where it goes decompressed
+bool is_compressed(const QString& image_path);
+QString decoded_path_for(const QString& image_path);
+
+// Picked by what the data turns out to hold, whatever the suffix said
+ImageDecoder::UPtr make_decoder(const Path& compressed_file_path);
+StreamDecoder::UPtr make_stream_decoder(const Path& decoded_file_path);
+StreamDecoder::UPtr make_stream_decoder(Codec codec, const Path& decoded_file_path);
+
+// Hands a whole file to a stream decoder, telling of the progress through it
+void decode_file(const Path& compressed_file_path, StreamDecoder& decoder, const ProgressMonitor& monitor);
+} // namespace decoding
+} // namespace multipass
+#endif // MULTIPASS_IMAGE_DECODER_H
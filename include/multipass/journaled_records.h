@@ -0,0 +1,54 @@
+/*
+ * Copyright (C) Canonical, Ltd.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; version 3.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#ifndef MULTIPASS_JOURNALED_RECORDS_H
+#define MULTIPASS_JOURNALED_RECORDS_H
+
+#include <QJsonObject>
+#include <QString>
+
+#include <cstddef>
+#include <functional>
+#include <string>
+
+namespace multipass
+{
+// A JSON object of records kept in a database file, with changes to single records appended to a journal next to it
+// (".journal" instead of ".json") rather than rewriting them all. The journal is folded back into the database once it
+// holds about twice as many entries as the database has records. Not thread-safe, callers serialize writes
+class JournaledRecords
+{
+public:
+    explicit JournaledRecords(QString db_path, std::size_t min_entries_to_compact = 64);
+
+    // What is in the database at db_path, with the journal left on top of it replayed
+    static QJsonObject read(const QString& db_path);
+
+    void write(const QJsonObject& records); // all of them, folding the journal in
+    // One record changed, a null one is gone. all_records is only asked for when the database is written in full
+    void update(const QString& key, const QJsonValue& record, const std::function<QJsonObject()>& all_records);
+
+private:
+    const QString db_path;
+    const QString journal_path;
+    const std::size_t min_entries_to_compact;
+    std::string db_hash; // of the database as last written, what the journal goes on top of
+    std::size_t db_records{0};
+    std::size_t journal_entries{0};
+};
+} // namespace multipass
+#endif // MULTIPASS_JOURNALED_RECORDS_H
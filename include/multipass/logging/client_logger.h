@@ -25,16 +25,24 @@
 
 #include <fmt/format.h>
 
+#include <chrono>
+#include <cstddef>
+#include <iterator>
+#include <mutex>
+#include <string>
+
 namespace multipass
 {
 namespace logging
 {
+// Sends lines to the client in batches, each as soon as it reaches so many bytes or its first line so much age, and
+// whatever is pending as the multiplexer catches up with what was logged or the logger goes
 template <typename T, typename U>
 class ClientLogger : public Logger
 {
 public:
     ClientLogger(Level level, MultiplexingLogger& mpx, grpc::ServerReaderWriterInterface<T, U>* server)
-        : logging_level{level}, server{server}, mpx_logger{mpx}
+        : Logger{level}, server{server}, mpx_logger{mpx}
     {
         mpx_logger.add_logger(this);
     }
@@ -42,23 +50,53 @@ public:
     ~ClientLogger()
     {
         mpx_logger.remove_logger(this);
+        flush();
     }
 
     void log(Level level, CString category, CString message) const override
     {
         if (level <= logging_level && server != nullptr)
         {
-            T reply;
-            reply.set_log_line(fmt::format("[{}] [{}] [{}] {}\n", timestamp(), as_string(level).c_str(),
-                                           category.c_str(), message.c_str()));
-            server->Write(reply);
+            const auto now = std::chrono::steady_clock::now();
+
+            std::lock_guard<std::mutex> lock{mutex};
+            if (pending.empty())
+                pending_since = now;
+
+            fmt::format_to(std::back_inserter(pending), "[{}] [{}] [{}] {}\n", timestamp(), as_string(level).c_str(),
+                           category.c_str(), message.c_str());
+
+            if (pending.size() >= max_batch_size || now - pending_since >= max_batch_delay)
+                write_pending();
         }
     }
 
+    void flush() const override
+    {
+        std::lock_guard<std::mutex> lock{mutex};
+        write_pending();
+    }
+
 private:
-    Level logging_level;
+    static constexpr std::size_t max_batch_size = 16384;
+    static constexpr std::chrono::milliseconds max_batch_delay{100};
+
+    void write_pending() const // under the lock
+    {
+        if (pending.empty())
+            return;
+
+        T reply;
+        reply.set_log_line(std::move(pending));
+        pending.clear();
+        server->Write(reply);
+    }
+
     grpc::ServerReaderWriterInterface<T, U>* server;
     MultiplexingLogger& mpx_logger;
+    mutable std::mutex mutex;
+    mutable std::string pending;
+    mutable std::chrono::steady_clock::time_point pending_since;
 };
 } // namespace logging
 } // namespace multipass
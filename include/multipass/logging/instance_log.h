@@ -0,0 +1,65 @@
+/*
+ * Copyright (C) Canonical, Ltd.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; version 3.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#ifndef MULTIPASS_INSTANCE_LOG_H
+#define MULTIPASS_INSTANCE_LOG_H
+
+#include <multipass/logging/level.h>
+
+#include <chrono>
+#include <cstddef>
+#include <mutex>
+#include <string>
+#include <string_view>
+
+namespace multipass
+{
+namespace logging
+{
+// Keeps the latest output of an instance's processes, and forwards it to the log line by line at a bounded rate, so
+// that a chatty process can neither flood the journal nor hold up the thread it is read on
+class InstanceLog
+{
+public:
+    static constexpr std::size_t default_capacity = 256 * 1024; // in bytes
+    static constexpr int default_lines_per_second = 20;
+
+    explicit InstanceLog(std::string category, std::size_t capacity = default_capacity,
+                         int lines_per_second = default_lines_per_second);
+    ~InstanceLog();
+
+    static std::size_t buffered_bytes(); // held by every instance's log together
+
+    void append(Level level, std::string_view output); // lines over the rate are kept, but not logged
+    std::string contents() const;                      // oldest first
+
+private:
+    void forward(Level level, std::string_view line);
+
+    const std::string category;
+    const std::size_t capacity;
+    const int lines_per_second;
+
+    mutable std::mutex mutex;
+    std::string buffer;
+    std::chrono::steady_clock::time_point window_start{};
+    int lines_in_window{0};
+    int suppressed{0};
+};
+} // namespace logging
+} // namespace multipass
+#endif // MULTIPASS_INSTANCE_LOG_H
@@ -21,12 +21,36 @@
 #include <multipass/logging/cstring.h>
 #include <multipass/logging/level.h>
 #include <multipass/logging/logger.h>
+#include <multipass/logging/record.h>
+
+#include <multipass/format.h>
+
+#include <string>
+#include <utility>
 
 namespace multipass
 {
 namespace logging
 {
 void log(Level level, CString category, CString message);
+void log(const Record& record);
+
+// Whether a message at that level, in that category, would get anywhere. Cheap enough to ask before building one.
+bool enabled(Level level, CString category);
+
+// Formats the message only if it is to be logged, for the messages logged so often that building them adds up
+template <typename Arg, typename... Args>
+void log(Level level, CString category, fmt::format_string<Arg, Args...> format, Arg&& arg, Args&&... args)
+{
+    if (enabled(level, category))
+        log(level, category, fmt::format(format, std::forward<Arg>(arg), std::forward<Args>(args)...));
+}
+
+// Caps what a category logs, below what the logger would take. These also come from MULTIPASS_LOG_CATEGORY_LEVELS,
+// e.g. "sftp server=info,url downloader=warning", as the logger is set.
+void set_category_level(const std::string& category, Level level);
+void clear_category_levels();
+
 void set_logger(std::shared_ptr<Logger> logger);
 Level get_logging_level();
 Logger* get_logger(); // for tests, don't rely on it lasting
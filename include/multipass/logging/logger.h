@@ -21,6 +21,7 @@
 #include <multipass/disabled_copy_move.h>
 #include <multipass/logging/cstring.h>
 #include <multipass/logging/level.h>
+#include <multipass/logging/record.h>
 
 #include <QDateTime>
 
@@ -38,10 +39,21 @@ public:
     using UPtr = std::unique_ptr<Logger>;
     virtual ~Logger() = default;
     virtual void log(Level level, CString category, CString message) const = 0;
-    Level get_logging_level()
+    virtual void log_record(const Record& record) const // fields go into the text, unless the logger keeps them apart
+    {
+        log(record.level, record.category, record.text());
+    }
+    virtual void flush() const // waits for what was logged to be written, for loggers that write in the background
+    {
+    }
+    Level get_logging_level() const
     {
         return logging_level;
     };
+    virtual bool takes(Level level) const // whether messages at that level get anywhere
+    {
+        return level <= logging_level;
+    }
     static std::string timestamp()
     {
         auto time = QDateTime::currentDateTime();
@@ -0,0 +1,74 @@
+/*
+ * Copyright (C) Canonical, Ltd.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; version 3.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#ifndef MULTIPASS_METRICS_H
+#define MULTIPASS_METRICS_H
+
+#include <multipass/singleton.h>
+
+#include <chrono>
+#include <cstdint>
+#include <map>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#define MP_METRICS multipass::logging::Metrics::instance()
+
+namespace multipass
+{
+namespace logging
+{
+// Counters, gauges and histograms kept for the lifetime of the daemon, to be scraped in Prometheus' text format
+class Metrics : public Singleton<Metrics>
+{
+public:
+    using Labels = std::map<std::string, std::string>;
+
+    Metrics(const Singleton<Metrics>::PrivatePass&) noexcept;
+
+    virtual void increment(const std::string& name, const Labels& labels = {}, double by = 1);
+    virtual void adjust(const std::string& name, const Labels& labels, double by); // gauges, can go up and down
+    virtual void set(const std::string& name, const Labels& labels, double value); // gauges sampled when scraped
+    virtual void forget(const std::string& name); // drops every series, for those sampled anew
+    virtual void observe(const std::string& name, const Labels& labels, std::chrono::duration<double> duration);
+
+    std::string exposition() const;
+
+private:
+    enum class Type
+    {
+        counter,
+        gauge,
+        histogram
+    };
+
+    struct Series
+    {
+        double value{0}; // or the sum of what was observed
+        std::uint64_t count{0};
+        std::vector<std::uint64_t> buckets{};
+    };
+
+    Series& series(const std::string& name, Type type, const Labels& labels);
+
+    mutable std::mutex mutex;
+    std::map<std::string, std::pair<Type, std::map<Labels, Series>>> families;
+};
+} // namespace logging
+} // namespace multipass
+#endif // MULTIPASS_METRICS_H
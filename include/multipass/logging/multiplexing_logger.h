@@ -20,26 +20,61 @@
 
 #include "logger.h"
 
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <list>
 #include <memory>
-#include <shared_mutex>
-#include <vector>
+#include <mutex>
+#include <string>
+#include <thread>
 
 namespace multipass
 {
 namespace logging
 {
+// Hands what is logged to the system logger and to those added, from a thread of its own so that a slow sink never
+// holds up whoever logs. Each sink queues up to so many messages, those beyond are dropped and counted for it.
 class MultiplexingLogger : public Logger
 {
 public:
-    explicit MultiplexingLogger(UPtr system_logger);
+    static constexpr std::size_t default_queue_capacity = 4096;
+
+    explicit MultiplexingLogger(UPtr system_logger, std::size_t queue_capacity = default_queue_capacity);
+    ~MultiplexingLogger() override; // delivers what is queued first
+
     void log(Level level, CString category, CString message) const override;
+    void log_record(const Record& record) const override; // handed on whole, for sinks to keep the fields apart
+    void flush() const override;
+    bool takes(Level level) const override; // if any of those it logs to does
     void add_logger(const Logger* logger);
-    void remove_logger(const Logger* logger);
+    void remove_logger(const Logger* logger); // once what was queued for it is delivered
 
 private:
+    struct Sink
+    {
+        const Logger* logger;
+        std::deque<Record> queue{};
+        std::uint64_t dropped{0}; // since last delivered
+        bool busy{false};
+        bool unflushed{false}; // delivered to since last flushed
+    };
+
+    void drain();
+    bool idle(const Sink& sink) const;
+    void update_logging_level(); // under the lock
+
     UPtr system_logger;
-    mutable std::shared_timed_mutex mutex;
-    std::vector<const Logger*> loggers;
+    const std::size_t queue_capacity;
+    mutable std::mutex mutex;
+    mutable std::condition_variable queued;
+    mutable std::condition_variable delivered;
+    mutable std::list<Sink> sinks; // stable, the drain thread holds on to the one it delivers to
+    std::atomic<Level> most_verbose;
+    bool stopping{false};
+    std::thread drainer;
 };
 } // namespace logging
 } // namespace multipass
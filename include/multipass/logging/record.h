@@ -0,0 +1,58 @@
+/*
+ * Copyright (C) Canonical, Ltd.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; version 3.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#ifndef MULTIPASS_RECORD_H
+#define MULTIPASS_RECORD_H
+
+#include <multipass/logging/level.h>
+
+#include <chrono>
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace multipass
+{
+namespace logging
+{
+// A message along with what it is about, for loggers that can keep fields apart from the text, e.g. the journal.
+// Loggers that can't get the fields appended to the message as key=value pairs.
+struct Record
+{
+    using Fields = std::vector<std::pair<std::string, std::string>>;
+
+    Level level;
+    std::string category;
+    std::string message;
+    std::string instance{};
+    Fields fields{};
+    std::chrono::steady_clock::time_point time{std::chrono::steady_clock::now()};
+
+    std::string text() const // the message, followed by the instance and fields
+    {
+        auto text = message;
+        if (!instance.empty())
+            text.append(" instance=").append(instance);
+        for (const auto& [key, value] : fields)
+            text.append(" ").append(key).append("=").append(value);
+
+        return text;
+    }
+};
+} // namespace logging
+} // namespace multipass
+#endif // MULTIPASS_RECORD_H
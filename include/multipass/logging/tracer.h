@@ -0,0 +1,72 @@
+/*
+ * Copyright (C) Canonical, Ltd.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; version 3.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#ifndef MULTIPASS_TRACER_H
+#define MULTIPASS_TRACER_H
+
+#include <multipass/disabled_copy_move.h>
+#include <multipass/singleton.h>
+
+#include <chrono>
+#include <fstream>
+#include <mutex>
+#include <string>
+
+#define MP_TRACER multipass::logging::Tracer::instance()
+
+namespace multipass
+{
+namespace logging
+{
+constexpr auto trace_file_env_var = "MULTIPASS_TRACE_FILE";
+
+// Writes spans to the file named in MULTIPASS_TRACE_FILE, in Chrome's trace event format, so they can be loaded in
+// chrome://tracing or Perfetto. Nothing is recorded when it is not set.
+class Tracer : public Singleton<Tracer>
+{
+public:
+    using Clock = std::chrono::steady_clock;
+
+    Tracer(const Singleton<Tracer>::PrivatePass&) noexcept;
+
+    // detail is whatever the span is about, e.g. an instance name
+    virtual void record(const std::string& name, const std::string& detail, Clock::time_point start,
+                        Clock::time_point end) noexcept;
+
+private:
+    bool open();
+
+    std::mutex mutex;
+    bool disabled{false};
+    std::ofstream out;
+};
+
+// Records the time from its construction to its destruction as a span
+class TraceSpan : private DisabledCopyMove
+{
+public:
+    explicit TraceSpan(std::string name, std::string detail = {});
+    ~TraceSpan();
+
+private:
+    const std::string name;
+    const std::string detail;
+    const Tracer::Clock::time_point start;
+};
+} // namespace logging
+} // namespace multipass
+#endif // MULTIPASS_TRACER_H
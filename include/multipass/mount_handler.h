@@ -19,11 +19,14 @@
 #define MULTIPASS_MOUNT_HANDLER_H
 
 #include <multipass/file_ops.h>
+#include <multipass/logging/metrics.h>
+#include <multipass/logging/tracer.h>
 #include <multipass/rpc/multipass.grpc.pb.h>
 #include <multipass/ssh/ssh_key_provider.h>
 #include <multipass/vm_mount.h>
 
 #include <chrono>
+#include <optional>
 #include <variant>
 
 namespace multipass
@@ -55,7 +58,11 @@ public:
     {
         std::lock_guard active_lock{active_mutex};
         if (!is_active())
+        {
+            logging::TraceSpan span{"activate mount", target};
             activate_impl(server, timeout);
+            MP_METRICS.increment("multipass_mount_operations_total", {{"operation", "activate"}});
+        }
         active = true;
     }
 
@@ -63,7 +70,10 @@ public:
     {
         std::lock_guard active_lock{active_mutex};
         if (is_active())
+        {
             deactivate_impl(force);
+            MP_METRICS.increment("multipass_mount_operations_total", {{"operation", "deactivate"}});
+        }
         active = false;
     }
 
@@ -77,6 +87,12 @@ public:
         return false;
     }
 
+    // I/O statistics, for mounts that keep them
+    virtual std::optional<MountStats> stats()
+    {
+        return std::nullopt;
+    }
+
 protected:
     MountHandler() = default;
     MountHandler(VirtualMachine* vm, const SSHKeyProvider* ssh_key_provider, const std::string& target,
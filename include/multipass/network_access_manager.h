@@ -25,6 +25,7 @@
 
 namespace multipass
 {
+class LocalSocketPool;
 
 class NetworkAccessManager : public QNetworkAccessManager
 {
@@ -33,10 +34,14 @@ public:
     using UPtr = std::unique_ptr<NetworkAccessManager>;
 
     NetworkAccessManager(QObject* parent = nullptr);
+    ~NetworkAccessManager() override;
 
 protected:
     QNetworkReply* createRequest(Operation op, const QNetworkRequest& orig_request,
                                  QIODevice* outgoingData = nullptr) override;
+
+private:
+    std::shared_ptr<LocalSocketPool> local_socket_pool; // shared with replies, which may outlive the manager
 };
 } // namespace multipass
 
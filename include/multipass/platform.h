@@ -32,9 +32,12 @@
 #include <multipass/vm_image_vault.h>
 
 #include <QDir>
+#include <QObject>
 #include <QString>
 
+#include <cstdint>
 #include <functional>
+#include <map>
 #include <memory>
 #include <string>
 #include <vector>
@@ -47,6 +50,23 @@ namespace multipass
 {
 namespace platform
 {
+// What the host has to give instances, 0 where it cannot tell
+struct HostCapacity
+{
+    int cpus{0};
+    long long memory{0}; // in bytes
+    long long disk{0};   // in bytes, the size of the filesystem instances are kept in
+};
+
+// How long some and all of the tasks of the daemon or an instance were held up waiting on a resource
+struct ResourcePressure
+{
+    std::string instance; // empty for the daemon
+    std::string resource; // "cpu", "memory" or "io"
+    double some_seconds{0};
+    double full_seconds{0};
+};
+
 class Platform : public Singleton<Platform>
 {
 public:
@@ -62,6 +82,8 @@ public:
     virtual bool set_permissions(const multipass::Path path, const QFileDevice::Permissions permissions) const;
     virtual bool link(const char* target, const char* link) const;
     virtual bool symlink(const char* target, const char* link, bool is_dir) const;
+    // Makes destination share source's data until either is written to, where the filesystem can (e.g. reflinks)
+    virtual bool clone_file(const char* source, const char* destination) const;
     virtual int utime(const char* path, int atime, int mtime) const;
     virtual QString get_username() const;
     virtual QDir get_alias_scripts_folder() const;
@@ -76,6 +98,18 @@ public:
     virtual QString default_driver() const;
     virtual QString default_privileged_mounts() const;
     virtual bool is_image_url_supported() const;
+    virtual HostCapacity host_capacity(const QString& storage_dir) const;
+    // Kernel same-page merging: "host" leaves it as the host has it, "on" and "off" start and stop it
+    virtual void tune_memory_merging(const QString& policy, int pages_to_scan) const;
+    virtual std::map<std::string, std::uint64_t> memory_merging_stats() const; // under the kernel's own names
+    // As the kernel counts it for the cgroups that the daemon and instances are in, empty where they have none
+    virtual std::vector<ResourcePressure> resource_pressure() const;
+    virtual std::uint64_t resident_memory() const; // of the daemon itself, in bytes, 0 where it cannot be told
+    // Has the slot, taking a bool, told when the host is about to sleep (true) and once it wakes up (false); false
+    // where the host cannot be watched for that
+    virtual bool watch_host_sleep(QObject* receiver, const char* slot) const;
+    // While held, the host waits a little before going to sleep, for instances to be suspended first
+    virtual void hold_host_sleep(bool hold) const;
 };
 
 QString interpret_setting(const QString& key, const QString& val);
@@ -62,6 +62,7 @@ public:
     void set_process_channel_mode(QProcess::ProcessChannelMode mode) override;
 
     ProcessState execute(const int timeout = 30000) override;
+    void execute_async(Callback on_finished, const int timeout = 30000) override; // calls back from the event loop
 
 protected:
     const std::shared_ptr<ProcessSpec> process_spec;
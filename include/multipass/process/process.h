@@ -21,6 +21,7 @@
 #include <QProcessEnvironment>
 #include <QStringList>
 
+#include <functional>
 #include <memory>
 #include <optional>
 
@@ -107,6 +108,14 @@ public:
 
     virtual ProcessState execute(const int timeout = 30000) = 0;
 
+    // Like execute(), but hands the outcome to on_finished instead of returning it. By default that still blocks,
+    // implementations driven by the event loop call back from it. The process must outlive the callback.
+    using Callback = std::function<void(const ProcessState&)>;
+    virtual void execute_async(Callback on_finished, const int timeout = 30000)
+    {
+        on_finished(execute(timeout));
+    }
+
 signals:
     void started();
     void finished(multipass::ProcessState process_state);
@@ -38,6 +38,7 @@ public:
     virtual QString working_directory() const;
 
     virtual logging::Level error_log_level() const;
+    virtual bool run_to_completion() const; // only ever waited for, never handled through signals of the event loop
 
     virtual QString apparmor_profile() const = 0;
     const QString apparmor_profile_name() const;
@@ -21,11 +21,14 @@
 #include "setting_spec.h"
 #include "settings_handler.h"
 
+#include <QFileSystemWatcher>
+
 #include <map>
 #include <mutex>
 
 namespace multipass
 {
+// Reads go to the file only the first time for each key, after that only once the file changes or the key is set
 class PersistentSettingsHandler : public SettingsHandler
 {
 public:
@@ -33,9 +36,12 @@ public:
     QString get(const QString& key) const override;
     void set(const QString& key, const QString& val) override;
     std::set<QString> keys() const override;
+    std::map<QString, QString> get_values(const std::set<QString>& keys) const override; // from one read of the file
+    void set_values(const std::map<QString, QString>& values) override;                   // with one write of it
 
 private:
     const SettingSpec& get_setting(const QString& key) const; // throws on unknown key
+    void forget_values();                                      // on the file changing
 
 private:
     using SettingMap = std::map<QString, SettingSpec::UPtr>;
@@ -45,6 +51,8 @@ private:
     QString filename;
     SettingMap settings;
     mutable std::mutex mutex;
+    mutable std::map<QString, QString> cached; // values as last read or set
+    QFileSystemWatcher watcher;
 };
 } // namespace multipass
 
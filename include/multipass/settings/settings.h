@@ -26,6 +26,7 @@
 #include <QString>
 #include <QVariant>
 
+#include <map>
 #include <set>
 
 #define MP_SETTINGS multipass::Settings::instance()
@@ -71,6 +72,28 @@ public:
      */
     virtual void set(const QString& key, const QString& val);
 
+    /**
+     * Get the values of the settings specified by @c keys, asking each registered handler for all those it handles at
+     * once, in registration order, until none are left.
+     * @param keys The keys identifying the requested settings.
+     * @return The value of each setting, by key.
+     * @throws UnrecognizedSettingException When any of @c keys does not identify a setting that any registered
+     * handler recognizes.
+     * @note May also throw any other exceptions that occur when handling.
+     */
+    virtual std::map<QString, QString> get_values(const std::set<QString>& keys) const;
+
+    /**
+     * Set the values of the settings specified by their keys in @c values, giving each registered handler all those
+     * it handles at once. Nothing is set unless every key is recognized.
+     * @param values The values to assign, by key.
+     * @throws UnrecognizedSettingException When any of the keys does not identify a setting that any registered
+     * handler recognizes.
+     * @throws InvalidSettingException When any of the values is not valid for its setting.
+     * @note May also throw any other exceptions that occur when handling.
+     */
+    virtual void set_values(const std::map<QString, QString>& values);
+
     /**
      * Obtain a setting as a certain type
      * @tparam T The type to obtain the setting as
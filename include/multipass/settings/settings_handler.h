@@ -22,6 +22,7 @@
 
 #include <QString>
 
+#include <map>
 #include <set>
 
 namespace multipass
@@ -59,6 +60,23 @@ public:
      * @note Descendents are free to throw other exceptions as well.
      */
     virtual void set(const QString& key, const QString& val) = 0;
+
+    /**
+     * Get the values of those among @c keys that this SettingsHandler handles, all at once.
+     * @param keys The keys identifying the requested settings.
+     * @return The value of each key that this handler recognizes, by key. Those it doesn't recognize are left out.
+     * @note The default gets them one by one. Descendents that can read them together should override it.
+     */
+    virtual std::map<QString, QString> get_values(const std::set<QString>& keys) const;
+
+    /**
+     * Set those among @c values that this SettingsHandler handles, all at once.
+     * @param values The values to assign, by key. Those with keys that this handler doesn't recognize are ignored.
+     * @throws InvalidSettingException When any of the values is not valid for its setting.
+     * @note The default sets them one by one. Descendents that can should check them all before setting any, and
+     * write them together.
+     */
+    virtual void set_values(const std::map<QString, QString>& values);
 };
 
 } // namespace multipass
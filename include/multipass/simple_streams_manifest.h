@@ -27,6 +27,7 @@
 #include <QMap>
 #include <QString>
 
+#include <cstddef>
 #include <memory>
 #include <optional>
 #include <vector>
@@ -39,6 +40,13 @@ struct SimpleStreamsManifest
     static std::unique_ptr<SimpleStreamsManifest>
     fromJson(const QByteArray& json, const std::optional<QByteArray>& json_from_mirror, const QString& host_url);
 
+    // The parsed manifest in a compact binary form, far quicker to load than the JSON it came from. Snapshots only
+    // load for the same format version, architecture and driver they were taken with, nothing is given otherwise.
+    static std::unique_ptr<SimpleStreamsManifest> fromSnapshot(const QByteArray& snapshot);
+    QByteArray toSnapshot() const;
+
+    std::size_t memory_footprint() const; // in bytes, estimated, with the strings products share counted once
+
     const QString updated_at;
     const std::vector<VMImageInfo> products;
     const QMap<QString, const VMImageInfo*> image_records;
@@ -0,0 +1,65 @@
+/*
+ * Copyright (C) Canonical, Ltd.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; version 3.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#ifndef MULTIPASS_SPARSE_FILE_H
+#define MULTIPASS_SPARSE_FILE_H
+
+#include <QFileDevice>
+
+#include <algorithm>
+
+namespace multipass
+{
+namespace sparse
+{
+// Filesystems allocate in blocks, only whole blocks of zeros can be left out
+constexpr qint64 block_size = 4096;
+
+/**
+ * Writes data at the current position of file, seeking over blocks that are all zeros instead of writing them, so
+ * that they end up as holes. That is only correct where the file holds nothing yet, i.e. past its end or in space
+ * that resize() added. Once done writing, call end() so that zeros at the very end are not lost.
+ */
+inline bool write(QFileDevice& file, const char* data, qint64 size)
+{
+    const auto start = file.pos();
+    qint64 unwritten{0};
+
+    for (qint64 pos{0}, len; pos < size; pos += len)
+    {
+        len = std::min(size - pos, block_size - (start + pos) % block_size);
+        if (std::any_of(data + pos, data + pos + len, [](char c) { return c != '\0'; }))
+            continue;
+
+        if ((pos > unwritten && file.write(data + unwritten, pos - unwritten) != pos - unwritten) ||
+            !file.seek(start + pos + len))
+            return false;
+
+        unwritten = pos + len;
+    }
+
+    return unwritten == size || file.write(data + unwritten, size - unwritten) == size - unwritten;
+}
+
+// Grows the file to its current position, in case the last write() skipped its tail
+inline bool end(QFileDevice& file)
+{
+    return file.size() >= file.pos() || file.resize(file.pos());
+}
+} // namespace sparse
+} // namespace multipass
+#endif // MULTIPASS_SPARSE_FILE_H
@@ -25,6 +25,8 @@
 #include <filesystem>
 #include <functional>
 #include <iostream>
+#include <memory>
+#include <vector>
 
 #include <QFlags>
 
@@ -44,11 +46,14 @@ public:
     {
         Recursive = 1,
         MakeParent = 2,
+        Sync = 4,
+        Resume = 8,
     };
     Q_DECLARE_FLAGS(Flags, Flag)
 
     SFTPClient() = default;
-    SFTPClient(const std::string& host, int port, const std::string& username, const std::string& priv_key_blob);
+    SFTPClient(const std::string& host, int port, const std::string& username, const std::string& priv_key_blob,
+               bool compression = false, const std::string& ciphers = SSHSession::default_ciphers);
     SFTPClient(SSHSessionUPtr ssh_session);
 
     virtual bool is_remote_dir(const fs::path& path);
@@ -57,18 +62,30 @@ public:
     virtual void from_cin(std::istream& cin, const fs::path& target_path, bool make_parent);
     virtual void to_cout(const fs::path& source_path, std::ostream& cout);
 
+    // Recursive copies spread files over this many connections, when the client knows how to make more of them
+    virtual void set_parallel_transfers(int count);
+    // How many reads are kept in flight at once while pulling a file
+    virtual void set_transfer_window(int window);
+
     virtual ~SFTPClient() = default;
 
 private:
-    void push_file(const fs::path& source_path, const fs::path& target_path);
-    void pull_file(const fs::path& source_path, const fs::path& target_path);
-    bool push_dir(const fs::path& source_path, const fs::path& target_path);
-    bool pull_dir(const fs::path& source_path, const fs::path& target_path);
-    void do_push_file(std::istream& source, const fs::path& target_path);
-    void do_pull_file(const fs::path& source_path, std::ostream& target);
+    void push_file(const fs::path& source_path, const fs::path& target_path, Flags flags);
+    void pull_file(const fs::path& source_path, const fs::path& target_path, Flags flags);
+    bool push_dir(const fs::path& source_path, const fs::path& target_path, Flags flags);
+    bool pull_dir(const fs::path& source_path, const fs::path& target_path, Flags flags);
+    // Where copying can pick up from a partial target left behind earlier, 0 if it has to start over
+    std::uintmax_t push_resume_offset(const fs::path& source_path, const fs::path& target_path);
+    std::uintmax_t pull_resume_offset(const fs::path& source_path, const fs::path& target_path);
+    void do_push_file(std::istream& source, const fs::path& target_path, std::uintmax_t offset = 0);
+    void do_pull_file(const fs::path& source_path, std::ostream& target, std::uintmax_t offset = 0);
+    std::vector<std::unique_ptr<SFTPClient>> make_parallel_clients();
 
     SSHSessionUPtr ssh_session;
     SFTPSessionUPtr sftp;
+    int transfer_window{1};
+    std::function<SSHSessionUPtr()> make_ssh_session; // empty when the session was handed over
+    int parallel_transfers{1};
 };
 
 Q_DECLARE_OPERATORS_FOR_FLAGS(SFTPClient::Flags)
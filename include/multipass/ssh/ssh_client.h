@@ -23,6 +23,7 @@
 
 #include <libssh/libssh.h>
 
+#include <cstddef>
 #include <functional>
 #include <memory>
 #include <string>
@@ -37,22 +38,31 @@ class SSHClient
 public:
     using ChannelUPtr = std::unique_ptr<ssh_channel_struct, void (*)(ssh_channel)>;
     using ConsoleCreator = std::function<Console::UPtr(ssh_channel_struct*)>;
+    static constexpr std::size_t default_buffer_size = 256 * 1024;
 
     SSHClient(const std::string& host, int port, const std::string& username, const std::string& priv_key_blob,
-              ConsoleCreator console_creator);
+              ConsoleCreator console_creator, bool compression = false);
     SSHClient(SSHSessionUPtr ssh_session, ConsoleCreator console_creator);
 
     int exec(const std::vector<std::string>& args);
     int exec(const std::vector<std::vector<std::string>>& args_list);
     void connect();
 
+    // How much input is read and sent on at a time when output does not go to a terminal
+    void set_buffer_size(std::size_t size);
+
+    // The single shell line that exec runs for args_list
+    static std::string to_cmd_line(const std::vector<std::vector<std::string>>& args_list);
+
 private:
     void handle_ssh_events();
+    void forward_streams();
     int exec_string(const std::string& cmd_line);
 
     SSHSessionUPtr ssh_session;
     ChannelUPtr channel;
     Console::UPtr console;
+    std::size_t buffer_size{default_buffer_size};
 };
 } // namespace multipass
 #endif // MULTIPASS_SSH_CLIENT_H
@@ -0,0 +1,82 @@
+/*
+ * Copyright (C) Canonical, Ltd.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; version 3.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#ifndef MULTIPASS_SSH_CONTROL_MASTER_H
+#define MULTIPASS_SSH_CONTROL_MASTER_H
+
+#include <multipass/ssh/ssh_session.h>
+
+#include <chrono>
+#include <list>
+#include <memory>
+#include <optional>
+#include <string>
+
+namespace multipass
+{
+// Holds on to an SSH session and runs commands on it on behalf of other processes, which connect to it on a local
+// socket and hand over their standard streams, much like OpenSSH's ControlMaster. Every command gets a channel of its
+// own, so later invocations skip connecting, key exchange and authentication.
+class SSHControlMaster
+{
+public:
+    SSHControlMaster(std::unique_ptr<SSHSession> session, const std::string& socket_path,
+                     std::chrono::seconds idle_timeout);
+    ~SSHControlMaster();
+
+    // Serves commands until no one has used the session for idle_timeout, or the session goes away. Shells no one has
+    // attached to for that long are closed.
+    void run();
+
+    // Starts a master serving on socket_path in a process of its own, by running executable with master_argument. The
+    // session is only opened in there. Does not wait for it to be up.
+    static void spawn(const std::string& executable, const std::string& socket_path, const std::string& host, int port,
+                      const std::string& username, const std::string& priv_key_blob, std::chrono::seconds idle_timeout,
+                      bool compression);
+
+    // What a process started by spawn runs, with what it needs coming in on parameters_fd. Returns its exit code.
+    static int serve(int parameters_fd);
+
+    // Runs cmd_line, or a shell when empty, through the master listening on socket_path, with this process's standard
+    // streams. Waits for it to finish and returns its exit code, or nothing if no master could take it. With a session
+    // name, the master keeps it running if this process goes away, and the next exec with that name attaches to it.
+    static std::optional<int> exec(const std::string& socket_path, const std::string& cmd_line, bool pty,
+                                   const std::string& session = {});
+
+    static constexpr std::size_t max_session_name_length = 31;
+    static constexpr auto master_argument = "--ssh-control-master"; // not for users, spawn passes it
+
+private:
+    struct Client;
+
+    void accept_client();
+    void take_request(Client& client);
+    void handle_control(Client& client);
+    std::list<Client>::iterator find_session(const Client& client);
+    void detach(Client& client);
+    void finish(Client& client);
+    void drop(Client& client);
+
+    std::unique_ptr<SSHSession> session;
+    const std::string socket_path;
+    const std::chrono::seconds idle_timeout;
+    int listen_fd{-1};
+    std::unique_ptr<ssh_event_struct, void (*)(ssh_event)> event;
+    std::list<Client> clients;
+};
+} // namespace multipass
+#endif // MULTIPASS_SSH_CONTROL_MASTER_H
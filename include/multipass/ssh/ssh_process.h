@@ -21,9 +21,11 @@
 #include <libssh/libssh.h>
 
 #include <chrono>
+#include <functional>
 #include <memory>
 #include <optional>
 #include <string>
+#include <string_view>
 
 namespace multipass
 {
@@ -31,12 +33,25 @@ class SSHProcess
 {
 public:
     using ChannelUPtr = std::unique_ptr<ssh_channel_struct, void (*)(ssh_channel)>;
+    // Called with each chunk of output as it arrives, the data is only valid for the duration of the call
+    using OutputHandler = std::function<void(std::string_view)>;
 
     SSHProcess(ssh_session ssh_session, const std::string& cmd);
 
     int exit_code(std::chrono::milliseconds timeout = std::chrono::seconds(5));
     std::string read_std_output();
     std::string read_std_error();
+    void read_std_output(const OutputHandler& handler);
+    void read_std_error(const OutputHandler& handler);
+
+    // For commands that are fed input and followed while they run, rather than read one stream to the end at a time
+    void write_std_input(std::string_view data);
+    void close_std_input();
+    // Hands what either stream has to its handler, waiting up to timeout for some; false once both are finished
+    bool read_available_output(const OutputHandler& out_handler, const OutputHandler& err_handler,
+                               std::chrono::milliseconds timeout);
+    // Once the output is read to the end, the status may have come in with it before there was a callback for it
+    int final_exit_code();
 
 private:
     enum class StreamType
@@ -46,6 +61,9 @@ private:
     };
 
     std::string read_stream(StreamType type, int timeout = -1);
+    void read_stream(StreamType type, const OutputHandler& handler, int timeout = -1);
+    void read_stream(StreamType type, const std::function<char*(std::size_t)>& get_buffer,
+                     const std::function<void(std::size_t)>& on_read, int timeout);
     ssh_channel release_channel();
 
     ssh_session session;
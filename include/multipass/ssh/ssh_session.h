@@ -23,6 +23,7 @@
 #include <libssh/libssh.h>
 
 #include <chrono>
+#include <cstdint>
 #include <memory>
 #include <string>
 
@@ -32,9 +33,16 @@ class SSHKeyProvider;
 class SSHSession
 {
 public:
+    // What is offered, in order, unless asked otherwise; libssh turns down names it does not know
+    static constexpr auto default_ciphers = "chacha20-poly1305@openssh.com,aes256-ctr";
+
     SSHSession(const std::string& host, int port, const std::chrono::milliseconds timeout = std::chrono::seconds(1));
     SSHSession(const std::string& host, int port, const std::string& ssh_username, const SSHKeyProvider& key_provider,
-               const std::chrono::milliseconds timeout = std::chrono::seconds(20));
+               const std::chrono::milliseconds timeout = std::chrono::seconds(20), bool compression = false,
+               const std::string& ciphers = default_ciphers);
+
+    // Hosts named like this are guests reached over AF_VSOCK by their context id, rather than over TCP; Linux only
+    static std::string vsock_host(std::uint32_t cid);
 
     SSHProcess exec(const std::string& cmd);
 
@@ -44,7 +52,8 @@ public:
 private:
     SSHSession(const std::string& host, int port, const std::string& ssh_username, const SSHKeyProvider* key_provider);
     SSHSession(const std::string& host, int port, const std::string& ssh_username, const SSHKeyProvider* key_provider,
-               const std::chrono::milliseconds timeout = std::chrono::seconds(20));
+               const std::chrono::milliseconds timeout = std::chrono::seconds(20), bool compression = false,
+               const std::string& ciphers = default_ciphers);
     void set_option(ssh_options_e type, const void* value);
     std::unique_ptr<ssh_session_struct, void (*)(ssh_session)> session;
 };
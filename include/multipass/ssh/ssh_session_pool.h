@@ -0,0 +1,73 @@
+/*
+ * Copyright (C) Canonical, Ltd.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; version 3.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#ifndef MULTIPASS_SSH_SESSION_POOL_H
+#define MULTIPASS_SSH_SESSION_POOL_H
+
+#include <chrono>
+#include <functional>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <tuple>
+#include <vector>
+
+namespace multipass
+{
+class SSHKeyProvider;
+class SSHSession;
+
+// Keeps sessions to instances around after use, so that each operation only has to open a channel instead of going
+// through connecting, key exchange and authentication all over again
+class SSHSessionPool
+{
+public:
+    using Action = std::function<void(SSHSession&)>;
+
+    explicit SSHSessionPool(std::chrono::milliseconds max_idle = std::chrono::seconds(30));
+    ~SSHSessionPool();
+
+    // Runs action on a pooled session, or a new one if none is fit for use. Should SSH fail on a pooled session, the
+    // action is tried once more on a new one, its connection may have just gone away with the instance it was to.
+    // Anything else the action throws is let through as it is.
+    void with_session(const std::string& instance, const std::string& host, int port, const std::string& username,
+                      const SSHKeyProvider& key_provider, const Action& action);
+
+    // Drops the sessions to an instance, e.g. because it is stopping
+    void forget(const std::string& instance);
+
+private:
+    using Destination = std::tuple<std::string, int, std::string>; // host, port and username
+    using Clock = std::chrono::steady_clock;
+
+    struct IdleSession
+    {
+        Destination destination;
+        std::unique_ptr<SSHSession> session;
+        Clock::time_point since;
+    };
+
+    std::unique_ptr<SSHSession> take(const std::string& instance, const Destination& destination);
+    void give_back(const std::string& instance, const Destination& destination, std::unique_ptr<SSHSession> session);
+
+    const std::chrono::milliseconds max_idle;
+    std::mutex mutex;
+    std::map<std::string, std::vector<IdleSession>> idle_sessions;
+};
+} // namespace multipass
+#endif // MULTIPASS_SSH_SESSION_POOL_H
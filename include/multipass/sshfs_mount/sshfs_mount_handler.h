@@ -23,8 +23,18 @@
 #include <multipass/qt_delete_later_unique_ptr.h>
 #include <multipass/sshfs_server_config.h>
 
+#include <QByteArray>
+
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <vector>
+
 namespace multipass
 {
+class SharedSSHFSServer;
+
 class SSHFSMountHandler : public MountHandler
 {
 public:
@@ -32,13 +42,24 @@ public:
                       const VMMount& mount);
     ~SSHFSMountHandler() override;
 
+    // The sets of sshfs options mounts can be given by name, see VMMount
+    static const std::vector<std::string>& mount_profiles();
+
     void activate_impl(ServerVariant server, std::chrono::milliseconds timeout) override;
     void deactivate_impl(bool force) override;
     bool is_active() override;
+    std::optional<MountStats> stats() override;
 
 private:
+    void read_stats(Process& process);
+
     qt_delete_later_unique_ptr<Process> process;
+    std::shared_ptr<SharedSSHFSServer> shared_server; // instead of process, when the instance's mounts share one
+    const std::string mount_id;                         // how the shared server tells this mount apart
     SSHFSServerConfig config;
+    std::mutex stats_mutex;
+    QByteArray unread_output;
+    std::optional<MountStats> last_stats;
 };
 } // namespace multipass
 #endif // MULTIPASS_SSHFS_MOUNT_HANDLER_H
@@ -22,6 +22,7 @@
 
 #include <string>
 #include <unordered_map>
+#include <vector>
 
 namespace multipass
 {
@@ -37,6 +38,12 @@ struct SSHFSServerConfig
     std::string target_path;
     id_mappings gid_mappings;
     id_mappings uid_mappings;
+    bool compression{false};
+    bool write_behind{false}; // writes acknowledged before they reach the disk, settling for close-to-open consistency
+    std::string mount_profile{};
+    // When set, a single server for the instance's mounts, which may only come from these sources; source_path and
+    // target_path are then unused
+    std::vector<std::string> shared_sources{};
 };
 
 } // namespace multipass
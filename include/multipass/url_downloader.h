@@ -29,6 +29,12 @@
 
 #include <atomic>
 #include <chrono>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <unordered_map>
 
 #define MP_NETMGRFACTORY multipass::NetworkManagerFactory::instance()
 
@@ -47,12 +53,34 @@ public:
 class URLDownloader : private DisabledCopyMove
 {
 public:
+    using ChunkAction = std::function<void(const QByteArray&)>;
+    using RestartAction = std::function<void()>;
+
+    // What the server said identifies the version of a resource it sent, to ask later whether it is still current
+    struct Validators
+    {
+        QByteArray etag;
+        QByteArray last_modified;
+    };
+
+    // download_to() keeps what it got so far next to the target, with this suffix, to resume from there next time
+    static constexpr auto partial_download_suffix = ".part";
+
     URLDownloader(std::chrono::milliseconds timeout);
     URLDownloader(const Path& cache_dir, std::chrono::milliseconds timeout);
     virtual ~URLDownloader() = default;
     virtual void download_to(const QUrl& url, const QString& file_name, int64_t size, const int download_type,
                              const ProgressMonitor& monitor);
+    // Hands the data to on_chunk as it arrives instead of storing it; anything on_chunk throws aborts the download and
+    // is rethrown. Should the download have to start over, e.g. from the cache after a network error, on_restart is
+    // called before the data comes again from the beginning.
+    virtual void download_chunks(const QUrl& url, const ChunkAction& on_chunk, const RestartAction& on_restart,
+                                 int64_t size, const int download_type, const ProgressMonitor& monitor);
     virtual QByteArray download(const QUrl& url);
+    // Exactly size bytes from offset on, straight from the server; throws if it does not serve them as a range
+    virtual QByteArray download_range(const QUrl& url, qint64 offset, qint64 size);
+    // Downloads url only if it changed since validators were taken, updating them; gives nothing when it did not
+    virtual std::optional<QByteArray> download_if_changed(const QUrl& url, Validators& validators);
     virtual QDateTime last_modified(const QUrl& url);
     virtual void abort_all_downloads();
 
@@ -60,8 +88,14 @@ protected:
     std::atomic_bool abort_downloads{false};
 
 private:
+    // The calling thread's: managers only work on the thread they were made on, and they are kept for connections,
+    // DNS lookups and HTTP/2 sessions to carry over from one request to the next
+    QNetworkAccessManager* network_manager();
+
     const Path cache_dir_path;
     std::chrono::milliseconds timeout;
+    std::mutex managers_mutex;
+    std::unordered_map<std::uint64_t, std::unique_ptr<QNetworkAccessManager>> managers; // by thread serial
 };
 }
 #endif // MULTIPASS_URL_DOWNLOADER_H
@@ -27,9 +27,12 @@
 #include <yaml-cpp/yaml.h>
 
 #include <chrono>
+#include <cstddef>
 #include <functional>
+#include <iterator>
 #include <sstream>
 #include <string>
+#include <string_view>
 #include <thread>
 #include <vector>
 
@@ -64,6 +67,97 @@ enum class TimeoutAction
     done
 };
 
+// The pieces of some text between delimiters, as views into it rather than copies, for output that gets parsed over
+// and over. The text has to outlive the view and whatever came out of it
+class SplitView
+{
+public:
+    class Iterator
+    {
+    public:
+        using iterator_category = std::forward_iterator_tag;
+        using value_type = std::string_view;
+        using difference_type = std::ptrdiff_t;
+        using pointer = const std::string_view*;
+        using reference = const std::string_view&;
+
+        Iterator() = default;
+        Iterator(const SplitView& split_view, std::string_view::size_type from) : view{&split_view}, next{from}
+        {
+            ++*this;
+        }
+
+        reference operator*() const
+        {
+            return piece;
+        }
+
+        pointer operator->() const
+        {
+            return &piece;
+        }
+
+        Iterator& operator++()
+        {
+            const auto& text = view->text;
+            start = view->keep_empty ? next : text.find_first_not_of(view->delimiters, next);
+            if (start >= text.size())
+            {
+                start = std::string_view::npos;
+                return *this;
+            }
+
+            const auto end = text.find_first_of(view->delimiters, start);
+            piece = text.substr(start, end - start);
+            next = end == std::string_view::npos ? text.size() : end + 1;
+            return *this;
+        }
+
+        Iterator operator++(int)
+        {
+            auto previous = *this;
+            ++*this;
+            return previous;
+        }
+
+        bool operator==(const Iterator& other) const
+        {
+            return start == other.start;
+        }
+
+        bool operator!=(const Iterator& other) const
+        {
+            return !(*this == other);
+        }
+
+    private:
+        const SplitView* view{nullptr};
+        std::string_view::size_type start{std::string_view::npos}; // of the current piece, npos past the last one
+        std::string_view::size_type next{0};
+        std::string_view piece;
+    };
+
+    SplitView(std::string_view text, std::string_view delimiters, bool keep_empty)
+        : text{text}, delimiters{delimiters}, keep_empty{keep_empty}
+    {
+    }
+
+    Iterator begin() const
+    {
+        return {*this, 0};
+    }
+
+    Iterator end() const
+    {
+        return {};
+    }
+
+private:
+    std::string_view text;
+    std::string_view delimiters;
+    bool keep_empty;
+};
+
 // filesystem and path helpers
 QDir base_dir(const QString& path);
 bool is_dir(const std::string& path);
@@ -94,6 +188,8 @@ bool process_log_on_error(const QString& program, const QStringList& arguments,
 
 // networking helpers
 void validate_server_address(const std::string& value);
+std::string local_server_address(const std::string& server_address); // empty unless it's a unix socket
+std::string completion_cache_path(const std::string& server_address); // next to the socket, empty unless there is one
 bool valid_hostname(const std::string& name_string);
 std::string generate_mac_address();
 bool valid_mac_address(const std::string& mac);
@@ -106,6 +202,8 @@ std::string& trim_newline(std::string& s);
 std::string escape_char(const std::string& s, char c);
 std::string escape_for_shell(const std::string& s);
 std::vector<std::string> split(const std::string& string, const std::string& delimiter);
+SplitView lines_of(std::string_view text); // without the '\n', and as many as std::getline would give
+SplitView tokens_of(std::string_view text, std::string_view delimiters = " \t"); // runs of delimiters are skipped
 std::string match_line_for(const std::string& output, const std::string& matcher);
 
 // virtual machine helpers
@@ -113,6 +211,12 @@ bool is_running(const VirtualMachine::State& state);
 void wait_until_ssh_up(VirtualMachine* virtual_machine, std::chrono::milliseconds timeout,
                        std::function<void()> const& ensure_vm_is_running = []() {});
 std::string run_in_ssh_session(SSHSession& session, const std::string& cmd);
+std::vector<std::string> ipv4_addresses_in(SSHSession& session); // the guest's global ones, lets SSH errors through
+
+// concurrency helpers
+// Runs the tasks on up to max_workers threads, including the calling one, and returns once they have all finished.
+// The first exception a task throws is rethrown then, the other tasks still run.
+void run_concurrently(const std::vector<std::function<void()>>& tasks, std::size_t max_workers);
 
 // yaml helpers
 std::string emit_yaml(const YAML::Node& node);
@@ -19,10 +19,12 @@
 #define MULTIPASS_VIRTUAL_MACHINE_H
 
 #include "disabled_copy_move.h"
+#include "exceptions/not_implemented_on_this_backend_exception.h"
 #include "ip_address.h"
 
 #include <chrono>
 #include <condition_variable>
+#include <cstdint>
 #include <memory>
 #include <mutex>
 #include <optional>
@@ -33,6 +35,7 @@ namespace multipass
 {
 class MemorySize;
 class SSHKeyProvider;
+class SSHSession;
 struct VMMount;
 class MountHandler;
 
@@ -55,12 +58,31 @@ public:
     using UPtr = std::unique_ptr<VirtualMachine>;
     using ShPtr = std::shared_ptr<VirtualMachine>;
 
+    // What the host sees of a running instance, without having to ask the guest. All but the memory are totals since
+    // it started; whatever could not be found out is left at 0.
+    struct HostStats
+    {
+        std::uint64_t cpu_time_ns{0};   // spent by the hypervisor's process, user and system
+        std::uint64_t steal_time_ns{0}; // that its threads were ready to run but waiting for a host CPU
+        std::uint64_t rss_bytes{0};
+        std::uint64_t balloon_bytes{0}; // the memory the guest is left with by the balloon, if it has one
+        std::uint64_t disk_read_bytes{0};
+        std::uint64_t disk_written_bytes{0};
+        std::uint64_t network_received_bytes{0}; // by the guest
+        std::uint64_t network_sent_bytes{0};
+    };
+
     virtual ~VirtualMachine() = default;
     virtual void stop() = 0;
     virtual void start() = 0;
     virtual void shutdown() = 0;
     virtual void suspend() = 0;
     virtual State current_state() = 0;
+    // What current_state() last found, as long as that is recent enough to answer listings from memory
+    virtual State cached_state()
+    {
+        return current_state();
+    }
     virtual int ssh_port() = 0;
     virtual std::string ssh_hostname()
     {
@@ -68,8 +90,30 @@ public:
     };
     virtual std::string ssh_hostname(std::chrono::milliseconds timeout) = 0;
     virtual std::string ssh_username() = 0;
+    // The guest's context id, when it was given a vsock device for SSH to reach it directly, see SSHSession
+    virtual std::optional<std::uint32_t> vsock_cid()
+    {
+        return std::nullopt;
+    }
     virtual std::string management_ipv4() = 0;
     virtual std::vector<std::string> get_all_ipv4(const SSHKeyProvider& key_provider) = 0;
+    virtual std::vector<std::string> get_all_ipv4(SSHSession& session) = 0; // lets SSH errors through
+    // Asked of the guest without SSH, through an agent or API of the backend's; nullopt when there is none to ask or it
+    // did not answer, for SSH to be used instead. guest_exec() gives what a command prints, guest_ipv4() the
+    // addresses get_all_ipv4() would.
+    virtual std::optional<std::string> guest_exec(const std::string& /*command*/)
+    {
+        return std::nullopt;
+    }
+    virtual std::optional<std::vector<std::string>> guest_ipv4()
+    {
+        return std::nullopt;
+    }
+    // Cheap to sample, and answered whether the guest is responsive or not; nullopt where the backend cannot tell
+    virtual std::optional<HostStats> host_stats()
+    {
+        return std::nullopt;
+    }
     virtual std::string ipv6() = 0;
     virtual void wait_until_ssh_up(std::chrono::milliseconds timeout) = 0;
     virtual void ensure_vm_is_running() = 0;
@@ -77,6 +121,141 @@ public:
     virtual void update_cpus(int num_cores) = 0;
     virtual void resize_memory(const MemorySize& new_size) = 0;
     virtual void resize_disk(const MemorySize& new_size) = 0;
+    // Whether update_cpus() and resize_memory() can grow the instance while it is running
+    virtual bool hotpluggable()
+    {
+        return false;
+    }
+    // Whether resize_disk() can grow the disk while the instance is running
+    virtual bool online_disk_resize()
+    {
+        return false;
+    }
+    // Whether shutdown() and suspend() can be called from other threads than the one the instance lives in, alongside
+    // those of other instances
+    virtual bool concurrent_state_changes()
+    {
+        return false;
+    }
+    // The ways the backend knows of attaching the instance's disk, a new choice taking effect when it next starts
+    // from scratch
+    virtual std::vector<std::string> disk_profiles()
+    {
+        return {"default"};
+    }
+    virtual std::string disk_profile()
+    {
+        return "default";
+    }
+    virtual void set_disk_profile(const std::string& /*profile*/)
+    {
+    }
+    // Whether guest memory comes from the host's hugepages, a change taking effect when the instance next starts
+    virtual bool hugepages()
+    {
+        return false;
+    }
+    virtual void set_hugepages(bool /*enabled*/)
+    {
+        throw NotImplementedOnThisBackendException{"hugepages"};
+    }
+    // The host CPUs that vCPUs run on: "none" to leave it to the scheduler, "numa" for those of a single NUMA node,
+    // or a list like "0-3,8"; throws std::invalid_argument for anything else
+    virtual std::string cpu_pinning()
+    {
+        return "none";
+    }
+    virtual void set_cpu_pinning(const std::string& /*pinning*/)
+    {
+        throw NotImplementedOnThisBackendException{"CPU pinning"};
+    }
+    // What the instance is held to, for others not to suffer from it: network bandwidth in Mbit/s, each way, and disk
+    // I/O operations per second; 0 for no limit, a change taking effect when the instance next starts
+    virtual int network_limit()
+    {
+        return 0;
+    }
+    virtual void set_network_limit(int /*mbits*/)
+    {
+        throw NotImplementedOnThisBackendException{"network limits"};
+    }
+    virtual int disk_iops_limit()
+    {
+        return 0;
+    }
+    virtual void set_disk_iops_limit(int /*iops*/)
+    {
+        throw NotImplementedOnThisBackendException{"disk IOPS limits"};
+    }
+    // What the instance gets when the host is contended for, against the daemon and other instances: weights from 1
+    // to 10000 for CPU time and disk I/O, 0 for the default of 100, and how its memory is held to what it was given,
+    // "none", "soft" to be reclaimed from past it or "hard" to run out there; throws std::invalid_argument for
+    // anything else, a change taking effect when the instance next starts
+    virtual int cpu_weight()
+    {
+        return 0;
+    }
+    virtual void set_cpu_weight(int /*weight*/)
+    {
+        throw NotImplementedOnThisBackendException{"resource weights"};
+    }
+    virtual int io_weight()
+    {
+        return 0;
+    }
+    virtual void set_io_weight(int /*weight*/)
+    {
+        throw NotImplementedOnThisBackendException{"resource weights"};
+    }
+    virtual std::string memory_limit()
+    {
+        return "none";
+    }
+    virtual void set_memory_limit(const std::string& /*limit*/)
+    {
+        throw NotImplementedOnThisBackendException{"memory limits"};
+    }
+    // Whether the instance boots its kernel directly, skipping firmware and bootloader, from when the backend has a
+    // copy of the guest's kernel; a change taking effect when the instance next starts
+    virtual bool fast_boot()
+    {
+        return false;
+    }
+    virtual void set_fast_boot(bool /*enabled*/)
+    {
+        throw NotImplementedOnThisBackendException{"fast boot"};
+    }
+    // Called once the instance is reachable over SSH, to copy whatever fast boot needs from the guest
+    virtual void capture_boot_files(const SSHKeyProvider& /*key_provider*/)
+    {
+    }
+    // Rewrites the disk image of a stopped instance without its unused space
+    virtual void compact_disk(bool /*compress*/)
+    {
+        throw NotImplementedOnThisBackendException{"compact"};
+    }
+    // Disk snapshots of a stopped instance, to roll it back to as it was then
+    virtual void take_snapshot(const std::string& /*name*/)
+    {
+        throw NotImplementedOnThisBackendException{"snapshots"};
+    }
+    virtual void restore_snapshot(const std::string& /*name*/)
+    {
+        throw NotImplementedOnThisBackendException{"snapshots"};
+    }
+    virtual std::vector<std::string> list_snapshots()
+    {
+        throw NotImplementedOnThisBackendException{"snapshots"};
+    }
+    virtual void delete_snapshot(const std::string& /*name*/)
+    {
+        throw NotImplementedOnThisBackendException{"snapshots"};
+    }
+    // The latest output of the instance's processes and serial console, as much as the backend keeps of it
+    virtual std::string console_log()
+    {
+        throw NotImplementedOnThisBackendException{"console log"};
+    }
     virtual std::unique_ptr<MountHandler> make_native_mount_handler(const SSHKeyProvider* ssh_key_provider,
                                                                     const std::string& target,
                                                                     const VMMount& mount) = 0;
@@ -87,6 +266,7 @@ public:
     std::mutex state_mutex;
     std::optional<IPAddress> management_ip;
     bool shutdown_while_starting{false};
+    bool guest_ready{false}; // the guest told the backend it is booted, since last started; guarded by state_mutex
 
 protected:
     VirtualMachine(VirtualMachine::State state, const std::string& vm_name) : state{state}, vm_name{vm_name} {};
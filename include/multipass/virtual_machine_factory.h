@@ -63,12 +63,16 @@ public:
     virtual QString get_backend_version_string() = 0;
     virtual VMImageVault::UPtr create_image_vault(std::vector<VMImageHost*> image_hosts, URLDownloader* downloader,
                                                   const Path& cache_dir_path, const Path& data_dir_path,
-                                                  const days& days_to_expire) = 0;
+                                                  const days& days_to_expire, const vault::BlobStore& blobs) = 0;
     virtual void configure(VirtualMachineDescription& vm_desc) = 0;
 
     // List all the network interfaces seen by the backend.
     virtual std::vector<NetworkInterfaceInfo> networks() const = 0;
 
+    // Bring the state of the given instances up to date at once, for backends that can ask for all in one go, so that
+    // their cached_state() need not ask one by one. Best effort: what is not refreshed is asked as usual.
+    virtual void refresh_states(const std::vector<VirtualMachine*>& vms) = 0;
+
 protected:
     VirtualMachineFactory() = default;
 
@@ -21,6 +21,7 @@
 #include "disabled_copy_move.h"
 #include "vm_image_info.h"
 
+#include <cstddef>
 #include <functional>
 #include <optional>
 #include <string>
@@ -43,6 +44,10 @@ public:
     virtual std::vector<VMImageInfo> all_images_for(const std::string& remote_name, const bool allow_unsupported) = 0;
     virtual void for_each_entry_do(const Action& action) = 0;
     virtual std::vector<std::string> supported_remotes() = 0;
+    virtual std::size_t memory_footprint() const // of what is kept of the remotes' images, in bytes, estimated
+    {
+        return 0;
+    }
 
 protected:
     VMImageHost() = default;
@@ -19,18 +19,23 @@
 #define MULTIPASS_VM_IMAGE_VAULT_H
 
 #include "disabled_copy_move.h"
+#include "exceptions/not_implemented_on_this_backend_exception.h"
 #include "fetch_type.h"
 #include "memory_size.h"
 #include "path.h"
 #include "progress_monitor.h"
+#include "vm_image.h"
 #include "vm_image_info.h"
 
 #include <QDir>
 #include <QFile>
+#include <QJsonObject>
 #include <QString>
+#include <QStringList>
 
 #include <functional>
 #include <memory>
+#include <mutex>
 #include <optional>
 #include <string>
 #include <unordered_map>
@@ -69,10 +74,50 @@ private:
     QFile file;
     const int initial_exc_count = std::uncaught_exceptions();
 };
+
+// Remembers image hashes by file identity (device, inode, size and modification time), persisted in cache_file, so
+// that images that have not changed are not read again
+class ImageHashCache
+{
+public:
+    explicit ImageHashCache(const Path& cache_file);
+
+    QString hash_of(const Path& image_path);
+
+private:
+    void persist();
+
+    const Path cache_file;
+    std::mutex mutex;
+    QJsonObject hashes;
+};
+
+// Keeps downloaded images once per content, under the SHA-256 they are published with, for all the vaults on the host
+// to share. Vaults hard-link blobs into place, so the link count of a blob tells whether any image still refers to it.
+// Peers are the base URLs of other hosts sharing theirs, which have blob <hash> at images/<hash>.
+class BlobStore
+{
+public:
+    explicit BlobStore(const Path& store_dir, const QStringList& peers = {});
+
+    // Where the blob for hash is or would be kept, nothing if hash is no hash at all
+    Path path_for(const std::string& hash) const;
+    // Where peers would have the blob for hash
+    QStringList peer_urls_for(const std::string& hash) const;
+    // Puts the blob for hash at destination, if there is one
+    bool link(const std::string& hash, const Path& destination) const;
+    // Keeps image as the blob for hash, unless there is one already
+    void add(const std::string& hash, const Path& image_path) const;
+    // Removes the blobs no image refers to anymore
+    void prune() const;
+
+private:
+    QDir store_dir;
+    QStringList peers;
+};
 } // namespace vault
 
 class Query;
-class VMImage;
 class VMImageVault : private DisabledCopyMove
 {
 public:
@@ -84,13 +129,40 @@ public:
                                 const ProgressMonitor& monitor, const bool unlock,
                                 const std::optional<std::string>& checksum) = 0;
     virtual void remove(const std::string& name) = 0;
+    // Frees the space of what was removed, which can take a while for large images, and of whatever a crash left
+    virtual void empty_trash()
+    {
+    }
     virtual bool has_record_for(const std::string& name) = 0;
     virtual void prune_expired_images() = 0;
+    // Removes the least recently used images no instance was made from, until the rest fit in budget
+    virtual void prune_to_size(const MemorySize& /*budget*/)
+    {
+    }
     virtual void update_images(const FetchType& fetch_type, const PrepareAction& prepare,
                                const ProgressMonitor& monitor) = 0;
     virtual MemorySize minimum_image_size_for(const std::string& id) = 0;
     virtual VMImageHost* image_host_for(const std::string& remote_name) const = 0;
     virtual std::vector<std::pair<std::string, VMImageInfo>> all_info_for(const Query& query) const = 0;
+    // A copy of source_name's instance image, for a new instance called destination_name
+    virtual VMImage clone(const std::string& /*source_name*/, const std::string& /*destination_name*/)
+    {
+        throw NotImplementedOnThisBackendException{"clone"};
+    }
+    // Golden images are instance images kept once provisioned, for later instances to start from in their stead
+    virtual bool keeps_golden_images() const
+    {
+        return false;
+    }
+    virtual void keep_golden_image(const std::string& /*key*/, const std::string& /*instance_name*/)
+    {
+        throw NotImplementedOnThisBackendException{"golden images"};
+    }
+    // Replaces instance_name's image by a copy of the golden image for key, if there is one
+    virtual std::optional<VMImage> golden_image_for(const std::string& /*key*/, const std::string& /*instance_name*/)
+    {
+        return std::nullopt;
+    }
 
 protected:
     VMImageVault() = default;
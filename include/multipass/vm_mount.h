@@ -36,6 +36,7 @@ struct VMMount
     id_mappings gid_mappings;
     id_mappings uid_mappings;
     MountType mount_type;
+    std::string mount_profile{}; // the set of sshfs options classic mounts use, empty for the default one
 };
 
 inline bool operator==(const VMMount& a, const VMMount& b)
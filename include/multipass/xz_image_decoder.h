@@ -18,10 +18,14 @@
 #ifndef MULTIPASS_XZ_IMAGE_DECODER_H
 #define MULTIPASS_XZ_IMAGE_DECODER_H
 
+#include <multipass/image_decoder.h>
 #include <multipass/path.h>
 #include <multipass/progress_monitor.h>
 
+#include <cstddef>
+#include <cstdint>
 #include <memory>
+#include <vector>
 
 #include <QFile>
 
@@ -29,18 +33,55 @@
 
 namespace multipass
 {
-class XzImageDecoder
+struct XzBlock
+{
+    qint64 offset;
+    qint64 size;
+    std::uint64_t unpadded_size;
+    qint64 decoded_offset;
+    std::uint64_t decoded_size;
+};
+
+struct XzBlockIndex
+{
+    QByteArray stream_header;
+    std::vector<XzBlock> blocks;
+};
+
+class XzImageDecoder : public ImageDecoder
 {
 public:
     XzImageDecoder(const Path& xz_file_path);
 
-    void decode_to(const Path& decoded_file_path, const ProgressMonitor& monitor);
+    // Files with several blocks, as written by xz --threads or --block-size, are decoded in parallel
+    void decode_to(const Path& decoded_file_path, const ProgressMonitor& monitor) override;
 
     using XzDecoderUPtr = std::unique_ptr<xz_dec, decltype(xz_dec_end)*>;
 
 private:
+    void decode_stream(const Path& decoded_file_path, const ProgressMonitor& monitor);
+    void decode_blocks(const XzBlockIndex& index, std::size_t num_threads, const Path& decoded_file_path,
+                       const ProgressMonitor& monitor);
+
     QFile xz_file;
-    XzDecoderUPtr xz_decoder;
+};
+
+class XzStreamDecoder : public StreamDecoder
+{
+public:
+    explicit XzStreamDecoder(const Path& decoded_file_path);
+
+    void decode(const char* data, std::size_t size) override;
+    void restart() override;
+    void finish() override;
+
+private:
+    void flush(std::size_t size);
+
+    QFile decoded_file;
+    XzImageDecoder::XzDecoderUPtr xz_decoder;
+    std::vector<unsigned char> out_buffer;
+    bool ended{false};
 };
 } // namespace multipass
 #endif // MULTIPASS_XZ_IMAGE_DECODER_H
@@ -27,6 +27,7 @@
 #include <multipass/url_downloader.h>
 #include <multipass/utils.h>
 
+#include <QCryptographicHash>
 #include <QFile>
 #include <QFileInfo>
 
@@ -391,6 +392,8 @@ mp::Query mp::DefaultVMBlueprintProvider::fetch_blueprint_for(const std::string&
                                                               VirtualMachineDescription& vm_desc,
                                                               ClientLaunchData& client_launch_data)
 {
+    std::lock_guard<decltype(blueprints_mutex)> lock{blueprints_mutex};
+
     update_blueprints();
 
     auto& blueprint_config = blueprint_map.at(blueprint_name);
@@ -404,6 +407,8 @@ mp::Query mp::DefaultVMBlueprintProvider::blueprint_from_file(const std::string&
                                                               VirtualMachineDescription& vm_desc,
                                                               ClientLaunchData& client_launch_data)
 {
+    std::lock_guard<decltype(blueprints_mutex)> lock{blueprints_mutex};
+
     if (!MP_PLATFORM.is_image_url_supported())
         throw std::runtime_error(fmt::format("Launching a Blueprint from a file is not supported"));
 
@@ -438,6 +443,8 @@ mp::Query mp::DefaultVMBlueprintProvider::blueprint_from_file(const std::string&
 
 std::optional<mp::VMImageInfo> mp::DefaultVMBlueprintProvider::info_for(const std::string& blueprint_name)
 {
+    std::lock_guard<decltype(blueprints_mutex)> lock{blueprints_mutex};
+
     update_blueprints();
 
     static constexpr auto missing_key_template{"The \'{}\' key is required for the {} Blueprint"};
@@ -491,6 +498,8 @@ std::optional<mp::VMImageInfo> mp::DefaultVMBlueprintProvider::info_for(const st
 
 std::vector<mp::VMImageInfo> mp::DefaultVMBlueprintProvider::all_blueprints()
 {
+    std::lock_guard<decltype(blueprints_mutex)> lock{blueprints_mutex};
+
     update_blueprints();
 
     bool will_need_update{false};
@@ -526,6 +535,8 @@ std::vector<mp::VMImageInfo> mp::DefaultVMBlueprintProvider::all_blueprints()
 
 std::string mp::DefaultVMBlueprintProvider::name_from_blueprint(const std::string& blueprint_name)
 {
+    std::lock_guard<decltype(blueprints_mutex)> lock{blueprints_mutex};
+
     if (blueprint_map.count(blueprint_name) == 1)
         return blueprint_name;
 
@@ -544,6 +555,8 @@ std::string mp::DefaultVMBlueprintProvider::name_from_blueprint(const std::strin
 
 int mp::DefaultVMBlueprintProvider::blueprint_timeout(const std::string& blueprint_name)
 {
+    std::lock_guard<decltype(blueprints_mutex)> lock{blueprints_mutex};
+
     auto timeout_seconds{0};
 
     try
@@ -579,7 +592,20 @@ void mp::DefaultVMBlueprintProvider::fetch_blueprints()
 {
     url_downloader->download_to(blueprints_url, archive_file_path, -1, -1, [](auto...) { return true; });
 
+    // Reading every Blueprint in there takes a while, no need for it when the archive did not change
+    QFile archive_file{archive_file_path};
+    QCryptographicHash hash{QCryptographicHash::Sha256};
+    if (archive_file.open(QIODevice::ReadOnly))
+        hash.addData(&archive_file);
+
+    if (!blueprint_map.empty() && hash.result() == archive_hash)
+    {
+        mpl::log(mpl::Level::debug, category, "Blueprints archive unchanged");
+        return;
+    }
+
     blueprint_map = blueprints_map_for(archive_file_path.toStdString(), needs_update, arch.toStdString());
+    archive_hash = hash.result();
 }
 
 void mp::DefaultVMBlueprintProvider::update_blueprints()
@@ -22,6 +22,7 @@
 #include <multipass/logging/log.h>
 #include <multipass/utils.h>
 
+#include <QCryptographicHash>
 #include <QDir>
 #include <QFile>
 #include <QSaveFile>
@@ -51,6 +52,11 @@ auto load_certs_from_file(const QDir& cert_dir)
 
     return certs;
 }
+
+std::string fingerprint(const QSslCertificate& cert)
+{
+    return cert.digest(QCryptographicHash::Sha256).toStdString();
+}
 } // namespace
 
 mp::ClientCertStore::ClientCertStore(const multipass::Path& data_dir)
@@ -59,6 +65,8 @@ mp::ClientCertStore::ClientCertStore(const multipass::Path& data_dir)
       authenticated_client_certs{load_certs_from_file(cert_dir)}
 {
     mpl::log(mpl::Level::trace, category, fmt::format("Loading client certs from {}", cert_dir.absolutePath()));
+    for (const auto& cert : authenticated_client_certs)
+        fingerprints.insert(fingerprint(cert));
 }
 
 void mp::ClientCertStore::add_cert(const std::string& pem_cert)
@@ -70,6 +78,7 @@ void mp::ClientCertStore::add_cert(const std::string& pem_cert)
     if (cert.isNull())
         throw std::runtime_error("invalid certificate data");
 
+    std::lock_guard lock{mutex};
     if (verify_cert(cert))
         return;
 
@@ -92,6 +101,7 @@ void mp::ClientCertStore::add_cert(const std::string& pem_cert)
         throw std::runtime_error("failed to write certificate");
 
     authenticated_client_certs.push_back(cert);
+    fingerprints.insert(fingerprint(cert));
 }
 
 std::string mp::ClientCertStore::PEM_cert_chain() const
@@ -104,17 +114,25 @@ std::string mp::ClientCertStore::PEM_cert_chain() const
 
 bool mp::ClientCertStore::verify_cert(const std::string& pem_cert)
 {
+    std::lock_guard lock{mutex};
+    if (verified_pem_certs.find(pem_cert) != verified_pem_certs.end())
+        return true;
+
     mpl::log(mpl::Level::trace, category, fmt::format("Verifying cert:\n{}", pem_cert));
+    if (!verify_cert(QSslCertificate(QByteArray::fromStdString(pem_cert))))
+        return false;
 
-    return verify_cert(QSslCertificate(QByteArray::fromStdString(pem_cert)));
+    verified_pem_certs.insert(pem_cert);
+    return true;
 }
 
 bool mp::ClientCertStore::verify_cert(const QSslCertificate& cert)
 {
-    return authenticated_client_certs.contains(cert);
+    return !cert.isNull() && fingerprints.find(fingerprint(cert)) != fingerprints.end();
 }
 
 bool mp::ClientCertStore::empty()
 {
+    std::lock_guard lock{mutex};
     return authenticated_client_certs.empty();
 }
@@ -18,10 +18,17 @@
 #include "client.h"
 #include "cmd/alias.h"
 #include "cmd/aliases.h"
+#include "cmd/apply.h"
 #include "cmd/authenticate.h"
+#include "cmd/batch.h"
+#include "cmd/benchmark_mount.h"
+#include "cmd/clone.h"
+#include "cmd/compact.h"
+#include "cmd/complete.h"
 #include "cmd/delete.h"
 #include "cmd/exec.h"
 #include "cmd/find.h"
+#include "cmd/forward.h"
 #include "cmd/get.h"
 #include "cmd/help.h"
 #include "cmd/info.h"
@@ -34,8 +41,10 @@
 #include "cmd/recover.h"
 #include "cmd/remote_settings_handler.h"
 #include "cmd/restart.h"
+#include "cmd/restore.h"
 #include "cmd/set.h"
 #include "cmd/shell.h"
+#include "cmd/snapshot.h"
 #include "cmd/start.h"
 #include "cmd/stop.h"
 #include "cmd/suspend.h"
@@ -74,17 +83,31 @@ auto make_handler_unregisterer(mp::SettingsHandler* handler)
 } // namespace
 
 mp::Client::Client(ClientConfig& config)
-    : stub{mp::Rpc::NewStub(mp::client::make_channel(config.server_address, config.cert_provider.get()))},
-      term{config.term},
-      aliases{config.term}
+    : Client{mp::Rpc::NewStub(mp::client::make_channel(config.server_address, config.cert_provider.get())),
+             config.term}
+{
+}
+
+mp::Client::Client(std::shared_ptr<mp::Rpc::Stub> stub, Terminal* term)
+    : stub{std::move(stub)}, term{term}, aliases{term}
 {
     add_command<cmd::Alias>(aliases);
     add_command<cmd::Aliases>(aliases);
+    add_command<cmd::Apply>();
     add_command<cmd::Authenticate>();
+    // Each command gets fresh ones, as they keep what they parsed, but they all share the channel
+    add_command<cmd::Batch>([stub = this->stub, term](const QStringList& arguments) {
+        return static_cast<mp::ReturnCode>(Client{stub, term}.run(arguments));
+    });
+    add_command<cmd::BenchmarkMount>();
+    add_command<cmd::Clone>();
+    add_command<cmd::Compact>();
+    add_command<cmd::Complete>(aliases);
     add_command<cmd::Launch>(aliases);
     add_command<cmd::Purge>(aliases);
     add_command<cmd::Exec>(aliases);
     add_command<cmd::Find>();
+    add_command<cmd::Forward>();
     add_command<cmd::Get>();
     add_command<cmd::Help>();
     add_command<cmd::Info>();
@@ -93,8 +116,10 @@ mp::Client::Client(ClientConfig& config)
     add_command<cmd::Mount>();
     add_command<cmd::Prefer>(aliases);
     add_command<cmd::Recover>();
+    add_command<cmd::Restore>();
     add_command<cmd::Set>();
     add_command<cmd::Shell>();
+    add_command<cmd::Snapshot>();
     add_command<cmd::Start>();
     add_command<cmd::Stop>();
     add_command<cmd::Suspend>();
@@ -132,6 +157,10 @@ int mp::Client::run(const QStringList& arguments)
     if (!mpl::get_logger())
         mp::client::set_logger(mpl::level_from(verbosity));
 
+    // Usage errors and the general help are told without a command to run, nor anything set up for one
+    if (parse_status != ParseCode::Ok)
+        return parser.returnCodeFrom(parse_status);
+
     {
         auto daemon_settings_prefix = QString{daemon_settings_root} + ".";
         auto* handler = MP_SETTINGS.register_handler(
@@ -142,8 +171,7 @@ int mp::Client::run(const QStringList& arguments)
         {
             mp::client::pre_setup();
 
-            ret = parse_status == ParseCode::Ok ? parser.chosenCommand()->run(&parser)
-                                                : parser.returnCodeFrom(parse_status);
+            ret = parser.chosenCommand()->run(&parser);
         }
         catch (const RemoteHandlerException& e)
         {
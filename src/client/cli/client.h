@@ -50,7 +50,9 @@ protected:
     void sort_commands();
 
 private:
-    std::unique_ptr<multipass::Rpc::Stub> stub;
+    Client(std::shared_ptr<multipass::Rpc::Stub> stub, Terminal* term); // for each command of a batch
+
+    std::shared_ptr<multipass::Rpc::Stub> stub;
 
     std::vector<cmd::Command::UPtr> commands;
 
@@ -0,0 +1,227 @@
+/*
+ * Copyright (C) Canonical, Ltd.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; version 3.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#include "apply.h"
+
+#include "common_cli.h"
+
+#include <multipass/cli/argparser.h>
+#include <multipass/cli/client_platform.h>
+#include <multipass/constants.h>
+#include <multipass/exceptions/cmd_exceptions.h>
+#include <multipass/format.h>
+
+#include <yaml-cpp/yaml.h>
+
+#include <QDir>
+#include <QFileInfo>
+#include <QTimeZone>
+
+#include <stdexcept>
+
+namespace mp = multipass;
+namespace mcp = multipass::cli::platform;
+namespace cmd = multipass::cmd;
+
+namespace
+{
+const QString dry_run_option_name{"dry-run"};
+
+std::string scalar(const YAML::Node& node, const std::string& instance, const char* field)
+{
+    if (!node.IsScalar())
+        throw std::runtime_error{fmt::format("\"{}\" of instance \"{}\" has to be a single value", field, instance)};
+
+    return node.as<std::string>();
+}
+
+// As launch takes it, "<remote>:<image>", or a URL
+void set_image(mp::LaunchRequest& launch, const std::string& image)
+{
+    const auto remote_image = QString::fromStdString(image);
+    if (remote_image.startsWith("http://") || remote_image.startsWith("https://") || remote_image.startsWith("file://"))
+        return launch.set_image(image);
+
+    if (remote_image.count(':') > 1)
+        throw std::runtime_error{fmt::format("Invalid remote and source image name \"{}\"", image)};
+
+    if (remote_image.contains(':'))
+        launch.set_remote_name(remote_image.section(':', 0, 0).toStdString());
+    launch.set_image(remote_image.section(':', -1).toStdString());
+}
+} // namespace
+
+mp::ReturnCode cmd::Apply::run(mp::ArgParser* parser)
+{
+    auto ret = parse_args(parser);
+    if (ret != ParseCode::Ok)
+    {
+        return parser->returnCodeFrom(ret);
+    }
+
+    auto on_success = [](mp::ApplyReply& reply) { return ReturnCode::Ok; };
+
+    auto on_failure = [this](grpc::Status& status) { return standard_failure_handler_for(name(), cerr, status); };
+
+    auto streaming_callback = [this](mp::ApplyReply& reply,
+                                     grpc::ClientReaderWriterInterface<ApplyRequest, ApplyReply>* client) {
+        if (!reply.log_line().empty())
+            cerr << reply.log_line();
+
+        if (!reply.reply_message().empty())
+            cout << reply.instance_name() << ": " << reply.reply_message() << "\n";
+    };
+
+    request.set_verbosity_level(parser->verbosityLevel());
+    return dispatch(&RpcMethod::apply, request, on_success, on_failure, streaming_callback);
+}
+
+std::string cmd::Apply::name() const
+{
+    return "apply";
+}
+
+QString cmd::Apply::short_help() const
+{
+    return QStringLiteral("Bring instances to what a file describes");
+}
+
+QString cmd::Apply::description() const
+{
+    return QStringLiteral(
+        "Launch, reconfigure, mount, start, stop, suspend or purge instances so that\n"
+        "they match a YAML file of the following form. All fields but the instance\n"
+        "names are optional, and those left out are left as they are:\n\n"
+        "instances:\n"
+        "  <name>:\n"
+        "    image: [<remote:>]<image>   # only for launching\n"
+        "    cloud-init: <file>          # only for launching\n"
+        "    cpus: <cpus>\n"
+        "    memory: <memory>\n"
+        "    disk: <disk>\n"
+        "    mounts:                     # exactly these, when given\n"
+        "      - source: <host path>\n"
+        "        target: <instance path>\n"
+        "    state: running | stopped | suspended | absent\n\n"
+        "Paths are relative to the file. Instances are brought along side by side, the\n"
+        "steps of each one after another.");
+}
+
+mp::ParseCode cmd::Apply::parse_args(mp::ArgParser* parser)
+{
+    parser->addPositionalArgument("file", "YAML file describing the instances", "<file>");
+
+    QCommandLineOption dry_run_option(dry_run_option_name, "Only tell what would be done");
+    parser->addOption(dry_run_option);
+    mp::cmd::add_timeout(parser);
+
+    auto status = parser->commandParse(this);
+    if (status != ParseCode::Ok)
+        return status;
+
+    if (parser->positionalArguments().count() != 1)
+    {
+        cerr << "A file describing the instances is required\n";
+        return ParseCode::CommandLineError;
+    }
+
+    try
+    {
+        request.set_timeout(mp::cmd::parse_timeout(parser));
+        parse_file(parser->positionalArguments().first());
+    }
+    catch (const mp::ValidationException& e)
+    {
+        cerr << "error: " << e.what() << "\n";
+        return ParseCode::CommandLineError;
+    }
+    catch (const std::exception& e)
+    {
+        cerr << "Could not read " << parser->positionalArguments().first().toStdString() << ": " << e.what() << "\n";
+        return ParseCode::CommandLineError;
+    }
+
+    request.set_dry_run(parser->isSet(dry_run_option));
+    return status;
+}
+
+void cmd::Apply::parse_file(const QString& path)
+{
+    const auto dir = QFileInfo{path}.absoluteDir();
+    const auto relative_to_file = [&dir](const std::string& file) {
+        return QDir::cleanPath(dir.absoluteFilePath(QString::fromStdString(file))).toStdString();
+    };
+
+    const auto file = YAML::LoadFile(path.toStdString());
+    const auto instances = file["instances"];
+    if (!instances.IsMap() || !instances.size())
+        throw std::runtime_error{"\"instances\" has to map instance names to what they should be"};
+
+    for (const auto& entry : instances)
+    {
+        const auto name = entry.first.as<std::string>();
+        const auto& node = entry.second;
+        if (!node.IsNull() && !node.IsMap())
+            throw std::runtime_error{fmt::format("instance \"{}\" has to be a map of its fields", name)};
+
+        auto instance = request.add_instances();
+        auto launch = instance->mutable_launch();
+        launch->set_instance_name(name);
+        launch->set_time_zone(QTimeZone::systemTimeZoneId().toStdString());
+
+        for (const auto& field : node)
+        {
+            const auto key = field.first.as<std::string>();
+            const auto& value = field.second;
+            if (key == "image")
+                set_image(*launch, scalar(value, name, "image"));
+            else if (key == "cpus")
+                launch->set_num_cores(value.as<int>());
+            else if (key == "memory")
+                launch->set_mem_size(scalar(value, name, "memory"));
+            else if (key == "disk")
+                launch->set_disk_space(scalar(value, name, "disk"));
+            else if (key == "cloud-init")
+                launch->set_cloud_init_user_data(
+                    YAML::Dump(YAML::LoadFile(relative_to_file(scalar(value, name, "cloud-init")))));
+            else if (key == "state")
+                instance->set_state(scalar(value, name, "state"));
+            else if (key == "mounts")
+            {
+                if (!value.IsNull() && !value.IsSequence())
+                    throw std::runtime_error{fmt::format("\"mounts\" of instance \"{}\" has to be a list", name)};
+
+                auto mounts = instance->mutable_mounts();
+                for (const auto& mount : value)
+                {
+                    auto added = mounts->add_mounts();
+                    added->set_source_path(relative_to_file(scalar(mount["source"], name, "source")));
+                    added->set_target_path(scalar(mount["target"], name, "target"));
+                }
+
+                auto uid_pair = mounts->mutable_mount_maps()->add_uid_mappings();
+                uid_pair->set_host_id(mcp::getuid());
+                uid_pair->set_instance_id(mp::default_id);
+                auto gid_pair = mounts->mutable_mount_maps()->add_gid_mappings();
+                gid_pair->set_host_id(mcp::getgid());
+                gid_pair->set_instance_id(mp::default_id);
+            }
+            else
+                throw std::runtime_error{fmt::format("instance \"{}\" has an unknown field \"{}\"", name, key)};
+        }
+    }
+}
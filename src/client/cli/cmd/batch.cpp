@@ -0,0 +1,147 @@
+/*
+ * Copyright (C) Canonical, Ltd.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; version 3.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#include "batch.h"
+
+#include <multipass/cli/argparser.h>
+#include <multipass/constants.h>
+
+#include <optional>
+
+namespace mp = multipass;
+namespace cmd = multipass::cmd;
+
+namespace
+{
+// Words as a shell would have them, with quotes and backslashes, or nothing when a quote is left open
+std::optional<QStringList> split_words(const QString& line)
+{
+    QStringList words;
+    QString word;
+    QChar quote;
+    auto in_word = false;
+
+    for (auto i = 0; i < line.size(); ++i)
+    {
+        const auto c = line[i];
+        if (!quote.isNull())
+        {
+            if (c == quote)
+                quote = QChar{};
+            else if (c == '\\' && quote == '"' && i + 1 < line.size())
+                word += line[++i];
+            else
+                word += c;
+        }
+        else if (c == '\'' || c == '"')
+        {
+            quote = c;
+            in_word = true;
+        }
+        else if (c == '\\' && i + 1 < line.size())
+        {
+            word += line[++i];
+            in_word = true;
+        }
+        else if (c.isSpace())
+        {
+            if (in_word)
+                words << word;
+            word.clear();
+            in_word = false;
+        }
+        else
+        {
+            word += c;
+            in_word = true;
+        }
+    }
+
+    if (!quote.isNull())
+        return std::nullopt;
+
+    if (in_word)
+        words << word;
+
+    return words;
+}
+} // namespace
+
+mp::ReturnCode cmd::Batch::run(mp::ArgParser* parser)
+{
+    auto ret = parse_args(parser);
+    if (ret != ParseCode::Ok)
+        return parser->returnCodeFrom(ret);
+
+    auto batch_ret = ReturnCode::Ok;
+    std::string line;
+    while (std::getline(term->cin(), line))
+    {
+        const auto trimmed = QString::fromStdString(line).trimmed();
+        if (trimmed.isEmpty() || trimmed.startsWith('#'))
+            continue;
+
+        auto line_ret = ReturnCode::CommandLineError;
+        if (const auto words = split_words(trimmed))
+            line_ret = run_command(QStringList{mp::client_name} + *words);
+        else
+            cerr << fmt::format("Unbalanced quotes in: {}\n", line);
+
+        // Whoever reads this needs to know where the output of one command ends, and how it went
+        cout << fmt::format("--- {}\n", static_cast<int>(line_ret)) << std::flush;
+        if (line_ret != ReturnCode::Ok)
+            batch_ret = line_ret;
+    }
+
+    return batch_ret;
+}
+
+std::string cmd::Batch::name() const
+{
+    return "batch";
+}
+
+QString cmd::Batch::short_help() const
+{
+    return QStringLiteral("Run commands read from standard input");
+}
+
+QString cmd::Batch::description() const
+{
+    return QStringLiteral("Read commands from standard input, one per line and without the\n"
+                          "leading \"multipass\", and run them one after the other over a single\n"
+                          "connection to the daemon. Words can be quoted as in a shell; empty\n"
+                          "lines and lines starting with \"#\" are skipped. After the output of\n"
+                          "each command, a line with \"---\" and its return code is printed.\n"
+                          "The batch returns the code of the last command that failed, if any.\n"
+                          "Commands that read standard input themselves do not mix with this.");
+}
+
+mp::ParseCode cmd::Batch::parse_args(mp::ArgParser* parser)
+{
+    auto status = parser->commandParse(this);
+    if (status != ParseCode::Ok)
+        return status;
+
+    if (parser->positionalArguments().count() > 0)
+    {
+        cerr << "This command takes no arguments\n";
+        return ParseCode::CommandLineError;
+    }
+
+    return ParseCode::Ok;
+}
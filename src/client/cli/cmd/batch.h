@@ -0,0 +1,51 @@
+/*
+ * Copyright (C) Canonical, Ltd.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; version 3.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#ifndef MULTIPASS_BATCH_H
+#define MULTIPASS_BATCH_H
+
+#include <multipass/cli/command.h>
+
+#include <functional>
+
+namespace multipass
+{
+namespace cmd
+{
+class Batch final : public Command
+{
+public:
+    using RunCommand = std::function<ReturnCode(const QStringList& arguments)>; // as if given to a client of its own
+
+    Batch(Rpc::StubInterface& stub, Terminal* term, RunCommand run_command)
+        : Command(stub, term), run_command{std::move(run_command)}
+    {
+    }
+
+    ReturnCode run(ArgParser* parser) override;
+    std::string name() const override;
+    QString short_help() const override;
+    QString description() const override;
+
+private:
+    ParseCode parse_args(ArgParser* parser);
+
+    RunCommand run_command;
+};
+} // namespace cmd
+} // namespace multipass
+#endif // MULTIPASS_BATCH_H
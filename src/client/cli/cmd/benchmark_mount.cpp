@@ -0,0 +1,298 @@
+/*
+ * Copyright (C) Canonical, Ltd.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; version 3.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#include "benchmark_mount.h"
+#include "common_cli.h"
+
+#include <multipass/cli/argparser.h>
+#include <multipass/format.h>
+#include <multipass/ssh/ssh_session.h>
+#include <multipass/utils.h>
+
+#include <ssh/ssh_client_key_provider.h>
+
+#include <QDir>
+
+#include <string_view>
+
+namespace mp = multipass;
+namespace cmd = multipass::cmd;
+
+namespace
+{
+const QString size_option_name{"size"};
+const QString files_option_name{"files"};
+
+constexpr auto default_size_mib = 256;
+constexpr auto default_files = 2000;
+
+// Run with python3 in the instance, fio is not something images come with. Prints tab separated workload, value
+// and unit, a line per workload as each finishes, and leaves nothing behind on the mount
+constexpr auto workloads_script = R"script(
+import os, random, shutil, sys, time
+
+root = os.path.join(sys.argv[1], ".multipass-benchmark-%d" % os.getpid())
+size = int(sys.argv[2]) * 1024 * 1024
+block = 1024 * 1024
+data_path = os.path.join(root, "data")
+files_dir = os.path.join(root, "files")
+names = [os.path.join(files_dir, "f%06d" % i) for i in range(int(sys.argv[3]))]
+offsets = [random.randrange(size // 4096) * 4096 for _ in range(min(4096, size // 4096))]
+
+
+def timed(run):
+    start = time.monotonic()
+    run()
+    return max(time.monotonic() - start, 1e-9)
+
+
+def report(workload, count, run, unit):
+    print("%s\t%.1f\t%s" % (workload, count / timed(run), unit), flush=True)
+
+
+def with_fd(flags, run):
+    fd = os.open(data_path, flags)
+    try:
+        os.posix_fadvise(fd, 0, 0, os.POSIX_FADV_DONTNEED)
+        run(fd)
+    finally:
+        os.close(fd)
+
+
+def sequential_write():
+    chunk = os.urandom(block)
+    with open(data_path, "wb") as f:
+        for _ in range(size // block):
+            f.write(chunk)
+        f.flush()
+        os.fsync(f.fileno())
+
+
+def sequential_read(fd):
+    while os.read(fd, block):
+        pass
+
+
+def random_write(fd):
+    chunk = os.urandom(4096)
+    for offset in offsets:
+        os.pwrite(fd, chunk, offset)
+    os.fsync(fd)
+
+
+def random_read(fd):
+    for offset in offsets:
+        os.pread(fd, 4096, offset)
+
+
+def create():
+    os.mkdir(files_dir)
+    for name in names:
+        os.close(os.open(name, os.O_CREAT | os.O_WRONLY, 0o644))
+
+
+def readdir():
+    for _ in os.scandir(files_dir):
+        pass
+
+
+os.makedirs(root)
+try:
+    report("sequential write", size / block, sequential_write, "MiB/s")
+    report("sequential read", size / block, lambda: with_fd(os.O_RDONLY, sequential_read), "MiB/s")
+    report("random 4k write", len(offsets), lambda: with_fd(os.O_WRONLY, random_write), "IOPS")
+    report("random 4k read", len(offsets), lambda: with_fd(os.O_RDONLY, random_read), "IOPS")
+    report("create", len(names), create, "files/s")
+    report("stat", len(names), lambda: [os.stat(name) for name in names], "files/s")
+    report("readdir", len(names), readdir, "entries/s")
+    report("unlink", len(names), lambda: [os.unlink(name) for name in names], "files/s")
+finally:
+    shutil.rmtree(root, ignore_errors=True)
+)script";
+
+bool is_under(const std::string& path, const std::string& mount_target)
+{
+    const auto clean_path = QDir::cleanPath(QString::fromStdString(path));
+    const auto clean_target = QDir::cleanPath(QString::fromStdString(mount_target));
+
+    return clean_path == clean_target || clean_path.startsWith(clean_target + '/');
+}
+
+std::string mount_type_name(mp::MountRequest::MountType mount_type)
+{
+    return mount_type == mp::MountRequest::CLASSIC ? "classic (sshfs)" : "native";
+}
+} // namespace
+
+mp::ReturnCode cmd::BenchmarkMount::run(mp::ArgParser* parser)
+{
+    auto ret = parse_args(parser);
+    if (ret != ParseCode::Ok)
+    {
+        return parser->returnCodeFrom(ret);
+    }
+
+    auto on_failure = [this](grpc::Status& status) { return standard_failure_handler_for(name(), cerr, status); };
+
+    std::string mount_type;
+    auto on_info_success = [this, &mount_type](mp::InfoReply& reply) {
+        for (const auto& mount : reply.info(0).mount_info().mount_paths())
+            if (is_under(target_path, mount.target_path()))
+                mount_type = mount_type_name(mount.mount_type());
+
+        if (mount_type.empty())
+        {
+            cerr << fmt::format("{} is not in a mount of {}\n", target_path, instance_name);
+            return ReturnCode::CommandFail;
+        }
+
+        return ReturnCode::Ok;
+    };
+
+    InfoRequest info_request;
+    info_request.set_verbosity_level(parser->verbosityLevel());
+    info_request.mutable_instance_names()->add_instance_name(instance_name);
+    info_request.set_no_runtime_information(true);
+    info_request.add_fields("mount_info");
+
+    if (auto info_ret = dispatch(&RpcMethod::info, info_request, on_info_success, on_failure);
+        info_ret != ReturnCode::Ok)
+        return info_ret;
+
+    auto on_ssh_info_success = [this, &mount_type](mp::SSHInfoReply& reply) {
+        if (reply.ssh_info().empty())
+            return ReturnCode::Ok;
+
+        return run_workloads(reply.ssh_info().begin()->second, mount_type);
+    };
+
+    SSHInfoRequest ssh_info_request;
+    ssh_info_request.set_verbosity_level(parser->verbosityLevel());
+    ssh_info_request.add_instance_name(instance_name);
+
+    return dispatch(&RpcMethod::ssh_info, ssh_info_request, on_ssh_info_success, on_failure);
+}
+
+std::string cmd::BenchmarkMount::name() const
+{
+    return "benchmark-mount";
+}
+
+QString cmd::BenchmarkMount::short_help() const
+{
+    return QStringLiteral("Measure the I/O performance of a mount");
+}
+
+QString cmd::BenchmarkMount::description() const
+{
+    return QStringLiteral("Run a standard set of workloads in a mounted directory of an instance: sequential reads\n"
+                          "and writes, random 4k reads and writes, creating, stat'ing and unlinking many files,\n"
+                          "and reading a large directory. The results come with the type of the mount, to compare\n"
+                          "mount types by. The instance needs python3.");
+}
+
+mp::ParseCode cmd::BenchmarkMount::parse_args(mp::ArgParser* parser)
+{
+    parser->addPositionalArgument("mount", "Directory to run the workloads in, in <name>:<path> format, where <name> "
+                                           "is an instance name and <path> is in one of its mounts",
+                                  "<name>:<path>");
+
+    QCommandLineOption size_option(size_option_name,
+                                   QString{"Size of the file to read and write, in MiB. Defaults to %1"}.arg(
+                                       default_size_mib),
+                                   "size", QString::number(default_size_mib));
+    QCommandLineOption files_option(files_option_name,
+                                    QString{"Number of files to create, stat and unlink. Defaults to %1"}.arg(
+                                        default_files),
+                                    "files", QString::number(default_files));
+    parser->addOptions({size_option, files_option});
+
+    auto status = parser->commandParse(this);
+
+    if (status != ParseCode::Ok)
+    {
+        return status;
+    }
+
+    if (parser->positionalArguments().count() != 1)
+    {
+        cerr << "Wrong number of arguments\n";
+        return ParseCode::CommandLineError;
+    }
+
+    const auto mount = parser->positionalArguments().first();
+    const auto colon = mount.indexOf(':');
+    if (colon < 1 || colon == mount.size() - 1)
+    {
+        cerr << "The mount has to be given in <name>:<path> format\n";
+        return ParseCode::CommandLineError;
+    }
+
+    instance_name = mount.left(colon).toStdString();
+    target_path = mount.mid(colon + 1).toStdString();
+
+    bool size_ok, files_ok;
+    size_mib = parser->value(size_option_name).toInt(&size_ok);
+    files = parser->value(files_option_name).toInt(&files_ok);
+    if (!size_ok || size_mib < 1 || !files_ok || files < 1)
+    {
+        cerr << fmt::format("--{} and --{} have to be positive integers\n", size_option_name, files_option_name);
+        return ParseCode::CommandLineError;
+    }
+
+    return status;
+}
+
+mp::ReturnCode cmd::BenchmarkMount::run_workloads(const mp::SSHInfo& ssh_info, const std::string& mount_type)
+{
+    cout << fmt::format("Benchmarking {}:{}, a {} mount\n", instance_name, target_path, mount_type);
+
+    try
+    {
+        mp::SSHSession session{ssh_info.host(), ssh_info.port(), ssh_info.username(),
+                               mp::SSHClientKeyProvider{ssh_info.priv_key_base64()}};
+        auto process = session.exec(mp::utils::to_cmd(
+            {"python3", "-c", workloads_script, target_path, std::to_string(size_mib), std::to_string(files)},
+            mp::utils::QuoteType::quote_every_arg));
+
+        // One result per line, printed as they come, the workloads can take a while on slow mounts
+        std::string pending;
+        process.read_std_output([this, &pending](std::string_view chunk) {
+            pending.append(chunk);
+            for (auto end = pending.find('\n'); end != std::string::npos; end = pending.find('\n'))
+            {
+                const auto fields = QString::fromStdString(pending.substr(0, end)).split('\t');
+                if (fields.size() == 3)
+                    cout << fmt::format("{:<20}{:>12} {}\n", fields[0], fields[1], fields[2]) << std::flush;
+                pending.erase(0, end + 1);
+            }
+        });
+
+        if (auto exit_code = process.exit_code(); exit_code != 0)
+        {
+            cerr << fmt::format("benchmark-mount failed: {}", process.read_std_error());
+            return ReturnCode::CommandFail;
+        }
+    }
+    catch (const std::exception& e)
+    {
+        cerr << "benchmark-mount failed: " << e.what() << "\n";
+        return ReturnCode::CommandFail;
+    }
+
+    return ReturnCode::Ok;
+}
@@ -0,0 +1,48 @@
+/*
+ * Copyright (C) Canonical, Ltd.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; version 3.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#ifndef MULTIPASS_BENCHMARK_MOUNT_H
+#define MULTIPASS_BENCHMARK_MOUNT_H
+
+#include <multipass/cli/command.h>
+
+namespace multipass
+{
+namespace cmd
+{
+class BenchmarkMount final : public Command
+{
+public:
+    using Command::Command;
+    ReturnCode run(ArgParser* parser) override;
+
+    std::string name() const override;
+    QString short_help() const override;
+    QString description() const override;
+
+private:
+    std::string instance_name;
+    std::string target_path;
+    int size_mib{0};
+    int files{0};
+
+    ParseCode parse_args(ArgParser* parser);
+    ReturnCode run_workloads(const SSHInfo& ssh_info, const std::string& mount_type);
+};
+} // namespace cmd
+} // namespace multipass
+#endif // MULTIPASS_BENCHMARK_MOUNT_H
@@ -0,0 +1,106 @@
+/*
+ * Copyright (C) Canonical, Ltd.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; version 3.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#include "clone.h"
+
+#include "animated_spinner.h"
+#include "common_cli.h"
+
+#include <multipass/cli/argparser.h>
+
+namespace mp = multipass;
+namespace cmd = multipass::cmd;
+
+mp::ReturnCode cmd::Clone::run(mp::ArgParser* parser)
+{
+    auto ret = parse_args(parser);
+    if (ret != ParseCode::Ok)
+    {
+        return parser->returnCodeFrom(ret);
+    }
+
+    AnimatedSpinner spinner{cout};
+
+    auto on_success = [this, &spinner](mp::CloneReply& reply) {
+        spinner.stop();
+        cout << reply.reply_message() << "\n";
+        return ReturnCode::Ok;
+    };
+
+    auto on_failure = [this, &spinner](grpc::Status& status) {
+        spinner.stop();
+        return standard_failure_handler_for(name(), cerr, status);
+    };
+
+    auto streaming_callback = [this, &spinner](mp::CloneReply& reply,
+                                               grpc::ClientReaderWriterInterface<CloneRequest, CloneReply>*) {
+        if (!reply.log_line().empty())
+            spinner.print(cerr, reply.log_line());
+
+        if (const auto& msg = reply.reply_message(); !msg.empty())
+        {
+            spinner.stop();
+            spinner.start(msg);
+        }
+    };
+
+    request.set_verbosity_level(parser->verbosityLevel());
+    return dispatch(&RpcMethod::clone, request, on_success, on_failure, streaming_callback);
+}
+
+std::string cmd::Clone::name() const
+{
+    return "clone";
+}
+
+QString cmd::Clone::short_help() const
+{
+    return QStringLiteral("Create a new instance from a stopped one");
+}
+
+QString cmd::Clone::description() const
+{
+    return QStringLiteral("Create a new instance with a copy of the disk and the settings of a\n"
+                          "stopped instance. The clone gets its own MAC addresses, hostname and\n"
+                          "machine ID on its first boot.");
+}
+
+mp::ParseCode cmd::Clone::parse_args(mp::ArgParser* parser)
+{
+    parser->addPositionalArgument("source", "Name of the instance to clone", "<source>");
+
+    QCommandLineOption name_option({"n", "name"},
+                                   "Name for the new instance. Defaults to <source>-cloneN, with N counting up.",
+                                   "name");
+    parser->addOption(name_option);
+
+    auto status = parser->commandParse(this);
+    if (status != ParseCode::Ok)
+        return status;
+
+    if (parser->positionalArguments().count() != 1)
+    {
+        cerr << "The name of one instance to clone is required\n";
+        return ParseCode::CommandLineError;
+    }
+
+    request.set_source_name(parser->positionalArguments().first().toStdString());
+    if (parser->isSet(name_option))
+        request.set_destination_name(parser->value(name_option).toStdString());
+
+    return status;
+}
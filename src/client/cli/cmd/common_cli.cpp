@@ -24,8 +24,16 @@
 #include <multipass/constants.h>
 #include <multipass/exceptions/cmd_exceptions.h>
 #include <multipass/exceptions/settings_exceptions.h>
+#include <multipass/format.h>
+#include <multipass/logging/log.h>
+#include <multipass/settings/settings.h>
+#include <multipass/ssh/ssh_control_master.h>
+#include <multipass/standard_paths.h>
 
 #include <QCommandLineOption>
+#include <QCoreApplication>
+#include <QCryptographicHash>
+#include <QDir>
 #include <QString>
 
 #include <chrono>
@@ -34,6 +42,7 @@
 
 namespace mp = multipass;
 namespace cmd = multipass::cmd;
+namespace mpl = multipass::logging;
 
 mp::ParseCode cmd::check_for_name_and_all_option_conflict(const mp::ArgParser* parser, std::ostream& cerr,
                                                           bool allow_empty)
@@ -185,3 +194,74 @@ std::unique_ptr<multipass::utils::Timer> multipass::cmd::make_timer(int timeout,
 
     return timer;
 }
+
+void multipass::cmd::add_compression_options(multipass::ArgParser* parser)
+{
+    parser->addOption({"compress", "Compress data on the wire, regardless of the local.ssh-compression setting"});
+    parser->addOption({"no-compress", "Do not compress data on the wire, regardless of the local.ssh-compression "
+                                      "setting"});
+}
+
+mp::ParseCode multipass::cmd::parse_compression_options(const multipass::ArgParser* parser,
+                                                        std::optional<bool>& compression, std::ostream& cerr)
+{
+    if (parser->isSet("compress") && parser->isSet("no-compress"))
+    {
+        cerr << "Options --compress and --no-compress clash\n";
+        return ParseCode::CommandLineError;
+    }
+
+    if (parser->isSet("compress") || parser->isSet("no-compress"))
+        compression = parser->isSet("compress");
+
+    return ParseCode::Ok;
+}
+
+bool multipass::cmd::wants_compression(const std::optional<bool>& compression, const mp::SSHInfo& ssh_info)
+{
+    if (compression)
+        return *compression;
+
+    if (ssh_info.compression() == "on" || ssh_info.compression() == "off")
+        return ssh_info.compression() == "on";
+
+    // Instances served by a daemon on this host are a local link away, not worth compressing for
+    const auto address = QString::fromStdString(mp::client::get_server_address());
+    return !address.startsWith("unix:") && !address.startsWith("localhost:") && !address.startsWith("127.") &&
+           !address.startsWith("[::1]:");
+}
+
+std::optional<int> multipass::cmd::exec_multiplexed(const mp::SSHInfo& ssh_info, const std::string& cmd_line,
+                                                    bool compression, mp::Terminal* term, const std::string& session)
+{
+    const auto persist = MP_SETTINGS.get(mp::ssh_control_persist_key).toInt();
+    const auto runtime_dir = MP_STDPATHS.writableLocation(mp::StandardPaths::RuntimeLocation);
+    if (persist <= 0 || runtime_dir.isEmpty())
+        return std::nullopt;
+
+    // One master per destination, kept short since socket paths cannot be longer than 107 bytes
+    QCryptographicHash hash{QCryptographicHash::Sha256};
+    for (const auto& part : {ssh_info.host(), std::to_string(ssh_info.port()), ssh_info.username(),
+                             ssh_info.priv_key_base64(), std::string{compression ? "z" : ""}})
+        hash.addData(part.c_str(), part.size() + 1);
+
+    const auto socket_path =
+        QDir{runtime_dir}.filePath(QString{"multipass-ssh2-%1.sock"}.arg(hash.result().toHex().left(16).constData()));
+
+    try
+    {
+        if (auto exit_code = SSHControlMaster::exec(socket_path.toStdString(), cmd_line, term->is_live(), session))
+            return exit_code;
+
+        // This one connects on its own all the same, what follows gets to use the master
+        SSHControlMaster::spawn(QCoreApplication::applicationFilePath().toStdString(), socket_path.toStdString(),
+                                ssh_info.host(), ssh_info.port(), ssh_info.username(), ssh_info.priv_key_base64(),
+                                std::chrono::seconds(persist), compression);
+    }
+    catch (const std::exception& e)
+    {
+        mpl::log(mpl::Level::debug, "ssh control", fmt::format("not using a control master: {}", e.what()));
+    }
+
+    return std::nullopt;
+}
@@ -26,6 +26,8 @@
 
 #include <QString>
 
+#include <optional>
+
 using RpcMethod = multipass::Rpc::StubInterface;
 
 namespace multipass
@@ -55,6 +57,16 @@ void add_timeout(multipass::ArgParser*);
 int parse_timeout(const multipass::ArgParser* parser);
 std::unique_ptr<multipass::utils::Timer> make_timer(int timeout, AnimatedSpinner* spinner, std::ostream& cerr,
                                                     const std::string& msg);
+void add_compression_options(multipass::ArgParser* parser);
+ParseCode parse_compression_options(const multipass::ArgParser* parser, std::optional<bool>& compression,
+                                    std::ostream& cerr);
+// What was asked on the command line, or else what the daemon is set to; "auto" means only away from this host
+bool wants_compression(const std::optional<bool>& compression, const SSHInfo& ssh_info);
+// Runs cmd_line, or a shell when empty, on a session shared with other invocations if client.ssh-control-persist asks
+// for it, setting one up otherwise. Nothing is returned when the caller needs to connect on its own. A named session
+// is kept running there when the caller goes away, to be attached to again.
+std::optional<int> exec_multiplexed(const SSHInfo& ssh_info, const std::string& cmd_line, bool compression,
+                                    Terminal* term, const std::string& session = {});
 
 } // namespace cmd
 } // namespace multipass
@@ -0,0 +1,106 @@
+/*
+ * Copyright (C) Canonical, Ltd.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; version 3.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#include "compact.h"
+
+#include "animated_spinner.h"
+#include "common_cli.h"
+
+#include <multipass/cli/argparser.h>
+
+namespace mp = multipass;
+namespace cmd = multipass::cmd;
+
+mp::ReturnCode cmd::Compact::run(mp::ArgParser* parser)
+{
+    auto ret = parse_args(parser);
+    if (ret != ParseCode::Ok)
+    {
+        return parser->returnCodeFrom(ret);
+    }
+
+    AnimatedSpinner spinner{cout};
+
+    auto on_success = [this, &spinner](mp::CompactReply& reply) {
+        spinner.stop();
+        cout << reply.reply_message() << "\n";
+        return ReturnCode::Ok;
+    };
+
+    auto on_failure = [this, &spinner](grpc::Status& status) {
+        spinner.stop();
+        return standard_failure_handler_for(name(), cerr, status);
+    };
+
+    auto streaming_callback = [this, &spinner](mp::CompactReply& reply,
+                                               grpc::ClientReaderWriterInterface<CompactRequest, CompactReply>*) {
+        if (!reply.log_line().empty())
+            spinner.print(cerr, reply.log_line());
+
+        if (const auto& msg = reply.reply_message(); !msg.empty())
+        {
+            spinner.stop();
+            spinner.start(msg);
+        }
+    };
+
+    request.set_verbosity_level(parser->verbosityLevel());
+    return dispatch(&RpcMethod::compact, request, on_success, on_failure, streaming_callback);
+}
+
+std::string cmd::Compact::name() const
+{
+    return "compact";
+}
+
+QString cmd::Compact::short_help() const
+{
+    return QStringLiteral("Give unused disk space back to the host");
+}
+
+QString cmd::Compact::description() const
+{
+    return QStringLiteral("Give the space of what was deleted in an instance back to the host.\n"
+                          "Running instances have their file systems trimmed from the inside.\n"
+                          "Stopped instances have their disk image rewritten without the unused\n"
+                          "parts, which takes longer but also reclaims what was never trimmed.");
+}
+
+mp::ParseCode cmd::Compact::parse_args(mp::ArgParser* parser)
+{
+    parser->addPositionalArgument("name", "Name of the instance to compact", "<name>");
+
+    QCommandLineOption compress_option(
+        "compress", "Also compress the disk image of a stopped instance. Saves more space, at the cost of slower "
+                    "writes to what is compressed.");
+    parser->addOption(compress_option);
+
+    auto status = parser->commandParse(this);
+    if (status != ParseCode::Ok)
+        return status;
+
+    if (parser->positionalArguments().count() != 1)
+    {
+        cerr << "The name of one instance to compact is required\n";
+        return ParseCode::CommandLineError;
+    }
+
+    request.set_instance_name(parser->positionalArguments().first().toStdString());
+    request.set_compress(parser->isSet(compress_option));
+
+    return status;
+}
@@ -0,0 +1,122 @@
+/*
+ * Copyright (C) Canonical, Ltd.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; version 3.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#include "complete.h"
+
+#include <multipass/cli/alias_dict.h>
+#include <multipass/cli/argparser.h>
+#include <multipass/cli/client_common.h>
+#include <multipass/utils.h>
+
+#include <fstream>
+#include <iterator>
+#include <vector>
+
+namespace mp = multipass;
+namespace cmd = multipass::cmd;
+
+mp::ReturnCode cmd::Complete::run(mp::ArgParser* parser)
+{
+    auto ret = parse_args(parser);
+    if (ret != ParseCode::Ok)
+    {
+        return parser->returnCodeFrom(ret);
+    }
+
+    if (what == "aliases")
+    {
+        for (const auto& [context_name, context] : aliases)
+            for (const auto& [alias_name, definition] : context)
+                cout << alias_name << "\n";
+
+        return ReturnCode::Ok;
+    }
+
+    return print_cached(what == "instances" ? "instance" : "network");
+}
+
+std::string cmd::Complete::name() const
+{
+    return "complete";
+}
+
+QString cmd::Complete::short_help() const
+{
+    return QStringLiteral("Print names for shell completion");
+}
+
+QString cmd::Complete::description() const
+{
+    return QStringLiteral("Print the names of instances, networks or aliases, one per line, for shell\n"
+                          "completion to offer. Instances and networks come from what the daemon keeps\n"
+                          "for this next to its socket, without asking it; the command fails when there\n"
+                          "is no such cache.");
+}
+
+mp::ParseCode cmd::Complete::parse_args(mp::ArgParser* parser)
+{
+    parser->addPositionalArgument("what", "What to print the names of: instances, networks or aliases.",
+                                  "<what>");
+    parser->addPositionalArgument("state", "Only instances in one of these states, e.g. Running.", "[<state> ...]");
+
+    auto status = parser->commandParse(this);
+    if (status != ParseCode::Ok)
+    {
+        return status;
+    }
+
+    auto args = parser->positionalArguments();
+    what = args.isEmpty() ? QString{} : args.takeFirst();
+    if (what != "instances" && what != "networks" && what != "aliases")
+    {
+        cerr << "Need to be told what to complete: instances, networks or aliases\n";
+        return ParseCode::CommandLineError;
+    }
+
+    if (what != "instances" && !args.isEmpty())
+    {
+        cerr << "Only instances can be picked by state\n";
+        return ParseCode::CommandLineError;
+    }
+
+    for (const auto& state : args)
+        states.append(state.toUpper());
+
+    return ParseCode::Ok;
+}
+
+mp::ReturnCode cmd::Complete::print_cached(const std::string& kind)
+{
+    const auto cache_path = mp::utils::completion_cache_path(mp::client::get_server_address());
+    std::ifstream cache{cache_path};
+    if (cache_path.empty() || !cache)
+        return ReturnCode::CommandFail; // for completion to fall back on asking the daemon
+
+    for (std::string line; std::getline(cache, line);)
+    {
+        const auto tokens = mp::utils::tokens_of(line);
+        const std::vector<std::string_view> fields(tokens.begin(), tokens.end());
+        if (fields.size() < 2 || fields[0] != kind)
+            continue;
+
+        if (states.isEmpty() ||
+            (fields.size() > 2 && states.contains(QString::fromUtf8(fields[2].data(), fields[2].size()))))
+            cout << fields[1] << "\n";
+    }
+
+    return ReturnCode::Ok;
+}
@@ -0,0 +1,57 @@
+/*
+ * Copyright (C) Canonical, Ltd.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; version 3.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#ifndef MULTIPASS_COMPLETE_H
+#define MULTIPASS_COMPLETE_H
+
+#include <multipass/cli/command.h>
+
+#include <QString>
+#include <QStringList>
+
+namespace multipass
+{
+class AliasDict;
+
+namespace cmd
+{
+// Prints names for shell completion to offer, without a round trip to the daemon
+class Complete final : public Command
+{
+public:
+    using Command::Command;
+
+    Complete(Rpc::StubInterface& stub, Terminal* term, AliasDict& dict) : Command(stub, term), aliases(dict)
+    {
+    }
+
+    ReturnCode run(ArgParser* parser) override;
+    std::string name() const override;
+    QString short_help() const override;
+    QString description() const override;
+
+private:
+    ParseCode parse_args(ArgParser* parser);
+    ReturnCode print_cached(const std::string& kind);
+
+    AliasDict& aliases;
+    QString what;
+    QStringList states;
+};
+} // namespace cmd
+} // namespace multipass
+#endif // MULTIPASS_COMPLETE_H
@@ -19,8 +19,13 @@
 #include "common_cli.h"
 
 #include <multipass/cli/argparser.h>
+#include <multipass/cli/client_common.h>
 #include <multipass/ssh/ssh_client.h>
 
+#include <memory>
+#include <mutex>
+#include <thread>
+
 namespace mp = multipass;
 namespace cmd = multipass::cmd;
 
@@ -28,6 +33,10 @@ namespace
 {
 const QString work_dir_option_name{"working-directory"};
 const QString no_dir_mapping_option{"no-map-working-directory"};
+const QString buffer_size_option{"buffer-size"};
+
+constexpr auto min_buffer_size = 4 * 1024;
+constexpr auto max_buffer_size = 64 * 1024 * 1024;
 
 auto is_dir_mounted(const QStringList& split_current_dir, const QStringList& split_source_dir)
 {
@@ -42,6 +51,44 @@ auto is_dir_mounted(const QStringList& split_current_dir, const QStringList& spl
 
     return true;
 }
+
+std::vector<std::vector<std::string>> command_args(const std::optional<std::string>& dir,
+                                                   const std::vector<std::string>& args)
+{
+    if (!dir)
+        return {{args}};
+
+    if (args[0] == "sudo")
+    {
+        // If we are running through 'sudo' and need to change directory, it might happen that the default user
+        // does not have access to the folder and thus the cd command will fail. Additionally, `cd` cannot be
+        // ran with sudo, what forces us to run everything through `sh`.
+        auto sh_args = fmt::format("cd {} && {}", *dir, fmt::join(args, " "));
+        return {{"sudo", "sh", "-c", sh_args}};
+    }
+
+    return {{"cd", *dir}, {args}};
+}
+
+// A daemon on another host may well have instances this one cannot reach, and going through it spares setting up SSH
+// on each exec
+bool daemon_is_remote(const std::string& server_address)
+{
+    if (server_address.rfind("unix:", 0) == 0)
+        return false;
+
+    const auto host = server_address.substr(0, server_address.rfind(':'));
+    return host != "localhost" && host.rfind("127.", 0) != 0;
+}
+
+// Input is sent on from a thread of its own, which may be stuck reading when the command exits. It is then left
+// behind, and only ever told that the stream is no longer its to write to.
+struct InputForwarding
+{
+    std::mutex mutex;
+    grpc::ClientReaderWriterInterface<mp::ExecRequest, mp::ExecReply>* client{nullptr}; // until the command exits
+    bool done_reading{false};
+};
 } // namespace
 
 mp::ReturnCode cmd::Exec::run(mp::ArgParser* parser)
@@ -107,14 +154,18 @@ mp::ReturnCode cmd::Exec::run(mp::ArgParser* parser)
             info_instance_name->append(instance_name);
             info_request.mutable_instance_names()->CopyFrom(instance_names);
             info_request.set_no_runtime_information(true);
+            info_request.add_fields("mount_info");
 
             dispatch(&RpcMethod::info, info_request, on_info_success, on_info_failure);
             // TODO: what to do with the returned value?
         }
     }
 
+    if (daemon_is_remote(client::get_server_address()))
+        return exec_through_daemon(parser, instance_name, mp::SSHClient::to_cmd_line(command_args(work_dir, args)));
+
     auto on_success = [this, &args, &work_dir](mp::SSHInfoReply& reply) {
-        return exec_success(reply, work_dir, args, term);
+        return exec_success(reply, work_dir, args, term, compression, buffer_size);
     };
 
     auto on_failure = [this, &instance_name, parser](grpc::Status& status) {
@@ -149,7 +200,8 @@ QString cmd::Exec::description() const
 }
 
 mp::ReturnCode cmd::Exec::exec_success(const mp::SSHInfoReply& reply, const std::optional<std::string>& dir,
-                                       const std::vector<std::string>& args, mp::Terminal* term)
+                                       const std::vector<std::string>& args, mp::Terminal* term,
+                                       const std::optional<bool>& compression, std::size_t buffer_size)
 {
     // TODO: mainly for testing - need a better way to test parsing
     if (reply.ssh_info().empty())
@@ -163,25 +215,14 @@ mp::ReturnCode cmd::Exec::exec_success(const mp::SSHInfoReply& reply, const std:
 
     try
     {
-        auto console_creator = [&term](auto channel) { return Console::make_console(channel, term); };
-        mp::SSHClient ssh_client{host, port, username, priv_key_blob, console_creator};
+        const auto all_args = command_args(dir, args);
+        const auto compress = wants_compression(compression, ssh_info);
+        if (auto exit_code = exec_multiplexed(ssh_info, mp::SSHClient::to_cmd_line(all_args), compress, term))
+            return static_cast<mp::ReturnCode>(*exit_code);
 
-        std::vector<std::vector<std::string>> all_args;
-        if (dir)
-        {
-            if (args[0] == "sudo")
-            {
-                // If we are running through 'sudo' and need to change directory, it might happen that the default user
-                // does not have access to the folder and thus the cd command will fail. Additionally, `cd` cannot be
-                // ran with sudo, what forces us to run everything through `sh`.
-                auto sh_args = fmt::format("cd {} && {}", *dir, fmt::join(args, " "));
-                all_args = {{"sudo", "sh", "-c", sh_args}};
-            }
-            else
-                all_args = {{"cd", *dir}, {args}};
-        }
-        else
-            all_args = {{args}};
+        auto console_creator = [&term](auto channel) { return Console::make_console(channel, term); };
+        mp::SSHClient ssh_client{host, port, username, priv_key_blob, console_creator, compress};
+        ssh_client.set_buffer_size(buffer_size);
 
         return static_cast<mp::ReturnCode>(ssh_client.exec(all_args));
     }
@@ -192,6 +233,93 @@ mp::ReturnCode cmd::Exec::exec_success(const mp::SSHInfoReply& reply, const std:
     }
 }
 
+mp::ReturnCode cmd::Exec::exec_through_daemon(mp::ArgParser* parser, const std::string& instance_name,
+                                              const std::string& cmd_line)
+{
+    ExecRequest request;
+    request.set_instance_name(instance_name);
+    request.set_command(cmd_line);
+    request.set_verbosity_level(parser->verbosityLevel());
+
+    std::optional<int> exit_code;
+    std::thread input_thread;
+    auto forwarding = std::make_shared<InputForwarding>();
+
+    auto streaming_callback = [this, &exit_code, &input_thread, forwarding](
+                                  mp::ExecReply& reply,
+                                  grpc::ClientReaderWriterInterface<ExecRequest, ExecReply>* client) {
+        if (!reply.log_line().empty())
+            cerr << reply.log_line();
+
+        cout.write(reply.std_out().data(), reply.std_out().size()).flush();
+        cerr.write(reply.std_err().data(), reply.std_err().size()).flush();
+
+        if (reply.exited())
+        {
+            exit_code = reply.exit_code();
+
+            // Also when it could not be started, the daemon waits for the client to stop sending either way
+            std::lock_guard<std::mutex> lock{forwarding->mutex};
+            if (!input_thread.joinable() || (forwarding->client && !forwarding->done_reading))
+                client->WritesDone();
+            forwarding->client = nullptr;
+        }
+        else if (!input_thread.joinable())
+        {
+            // The command has started, what it reads can follow. Lines go as they come, for it to answer them.
+            forwarding->client = client;
+            input_thread = std::thread{[forwarding, &in = term->cin()] {
+                std::string line;
+                while (std::getline(in, line))
+                {
+                    if (!in.eof())
+                        line += '\n';
+
+                    ExecRequest more_input;
+                    more_input.set_std_in(std::move(line));
+
+                    std::lock_guard<std::mutex> lock{forwarding->mutex};
+                    if (!forwarding->client || !forwarding->client->Write(more_input))
+                        return;
+                }
+
+                std::lock_guard<std::mutex> lock{forwarding->mutex};
+                forwarding->done_reading = true;
+                if (forwarding->client)
+                    forwarding->client->WritesDone();
+            }};
+        }
+    };
+
+    auto on_success = [&exit_code](mp::ExecReply&) {
+        return exit_code ? static_cast<mp::ReturnCode>(*exit_code) : ReturnCode::Ok;
+    };
+
+    auto on_failure = [this, &instance_name, parser](grpc::Status& status) {
+        if (status.error_code() == grpc::StatusCode::ABORTED)
+            return run_cmd_and_retry({"multipass", "start", QString::fromStdString(instance_name)}, parser, cout, cerr);
+        else
+            return standard_failure_handler_for(name(), cerr, status);
+    };
+
+    ReturnCode return_code;
+    while ((return_code = dispatch(&RpcMethod::exec, request, on_success, on_failure, streaming_callback)) ==
+           ReturnCode::Retry)
+        ;
+
+    if (input_thread.joinable())
+    {
+        std::lock_guard<std::mutex> lock{forwarding->mutex};
+        forwarding->client = nullptr;
+        if (forwarding->done_reading)
+            input_thread.join();
+        else
+            input_thread.detach();
+    }
+
+    return return_code;
+}
+
 mp::ParseCode cmd::Exec::parse_args(mp::ArgParser* parser)
 {
     parser->addPositionalArgument("name", "Name of instance to execute the command on", "<name>");
@@ -203,6 +331,14 @@ mp::ParseCode cmd::Exec::parse_args(mp::ArgParser* parser)
 
     parser->addOptions({workDirOption});
     parser->addOptions({noDirMappingOption});
+    parser->addOption({buffer_size_option,
+                       QString{"Read and send on up to <bytes> of input at a time when output is not a terminal. "
+                               "Defaults to %1, between %2 and %3"}
+                           .arg(SSHClient::default_buffer_size)
+                           .arg(min_buffer_size)
+                           .arg(max_buffer_size),
+                       "bytes"});
+    add_compression_options(parser);
 
     auto status = parser->commandParse(this);
 
@@ -223,6 +359,14 @@ mp::ParseCode cmd::Exec::parse_args(mp::ArgParser* parser)
         cerr << fmt::format("Options --{} and --{} clash\n", work_dir_option_name, no_dir_mapping_option);
         status = ParseCode::CommandLineError;
     }
+    else if (parse_compression_options(parser, compression, cerr) != ParseCode::Ok)
+    {
+        status = ParseCode::CommandLineError;
+    }
+    else if (parser->isSet(buffer_size_option) && parse_buffer_size(parser) != ParseCode::Ok)
+    {
+        status = ParseCode::CommandLineError;
+    }
     else if (parser->positionalArguments().count() < 2)
     {
         cerr << "Wrong number of arguments\n";
@@ -236,3 +380,18 @@ mp::ParseCode cmd::Exec::parse_args(mp::ArgParser* parser)
 
     return status;
 }
+
+mp::ParseCode cmd::Exec::parse_buffer_size(mp::ArgParser* parser)
+{
+    bool ok;
+    const auto size = parser->value(buffer_size_option).toInt(&ok);
+    if (!ok || size < min_buffer_size || size > max_buffer_size)
+    {
+        cerr << fmt::format("--{} value has to be an integer between {} and {}\n", buffer_size_option, min_buffer_size,
+                            max_buffer_size);
+        return ParseCode::CommandLineError;
+    }
+
+    buffer_size = size;
+    return ParseCode::Ok;
+}
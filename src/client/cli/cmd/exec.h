@@ -22,6 +22,7 @@
 
 #include <multipass/cli/alias_dict.h>
 #include <multipass/cli/command.h>
+#include <multipass/ssh/ssh_client.h>
 
 namespace multipass
 {
@@ -42,14 +43,20 @@ public:
     QString description() const override;
 
     static ReturnCode exec_success(const SSHInfoReply& reply, const std::optional<std::string>& dir,
-                                   const std::vector<std::string>& args, Terminal* term);
+                                   const std::vector<std::string>& args, Terminal* term,
+                                   const std::optional<bool>& compression = std::nullopt,
+                                   std::size_t buffer_size = SSHClient::default_buffer_size);
 
 private:
     SSHInfoRequest ssh_info_request;
     InfoRequest info_request;
     AliasDict aliases;
+    std::optional<bool> compression;
+    std::size_t buffer_size{SSHClient::default_buffer_size};
 
+    ReturnCode exec_through_daemon(ArgParser* parser, const std::string& instance_name, const std::string& cmd_line);
     ParseCode parse_args(ArgParser* parser);
+    ParseCode parse_buffer_size(ArgParser* parser);
 };
 } // namespace cmd
 } // namespace multipass
@@ -24,6 +24,12 @@
 namespace mp = multipass;
 namespace cmd = multipass::cmd;
 
+namespace
+{
+// How many images or blueprints the daemon sends at a time
+constexpr auto chunk_size = 32u;
+} // namespace
+
 mp::ReturnCode cmd::Find::run(mp::ArgParser* parser)
 {
     auto ret = parse_args(parser);
@@ -32,16 +38,33 @@ mp::ReturnCode cmd::Find::run(mp::ArgParser* parser)
         return parser->returnCodeFrom(ret);
     }
 
-    auto on_success = [this](FindReply& reply) {
-        cout << chosen_formatter->format(reply);
+    // Results come in chunks, only formatted once they are all in
+    FindReply found;
+    auto on_success = [this, &found](FindReply& /* last reply */) {
+        cout << chosen_formatter->format(found);
 
         return ReturnCode::Ok;
     };
 
     auto on_failure = [this](grpc::Status& status) { return standard_failure_handler_for(name(), cerr, status); };
 
+    auto streaming_callback = [this, &found](FindReply& reply,
+                                             grpc::ClientReaderWriterInterface<FindRequest, FindReply>*) {
+        if (!reply.log_line().empty())
+        {
+            cerr << reply.log_line();
+            return;
+        }
+
+        found.set_show_images(reply.show_images());
+        found.set_show_blueprints(reply.show_blueprints());
+        found.mutable_images_info()->MergeFrom(reply.images_info());
+        found.mutable_blueprints_info()->MergeFrom(reply.blueprints_info());
+    };
+
     request.set_verbosity_level(parser->verbosityLevel());
-    return dispatch(&RpcMethod::find, request, on_success, on_failure);
+    request.set_chunk_size(chunk_size);
+    return dispatch(&RpcMethod::find, request, on_success, on_failure, streaming_callback);
 }
 
 std::string cmd::Find::name() const
@@ -72,10 +95,16 @@ mp::ParseCode cmd::Find::parse_args(mp::ArgParser* parser)
     QCommandLineOption unsupportedOption("show-unsupported", "Show unsupported cloud images as well");
     QCommandLineOption imagesOnlyOption("only-images", "Show only images");
     QCommandLineOption blueprintsOnlyOption("only-blueprints", "Show only blueprints");
+    QCommandLineOption aliasPrefixOption("alias-prefix", "Show only what has an alias starting with <prefix>",
+                                         "prefix");
+    QCommandLineOption minReleaseOption("min-release", "Show only releases from <version> on, e.g. 20.04",
+                                        "version");
+    QCommandLineOption maxReleaseOption("max-release", "Show only releases up to <version>, e.g. 24.04", "version");
     QCommandLineOption formatOption(
         "format", "Output list in the requested format.\nValid formats are: table (default), json, csv and yaml",
         "format", "table");
-    parser->addOptions({unsupportedOption, imagesOnlyOption, blueprintsOnlyOption, formatOption});
+    parser->addOptions({unsupportedOption, imagesOnlyOption, blueprintsOnlyOption, aliasPrefixOption,
+                        minReleaseOption, maxReleaseOption, formatOption});
 
     auto status = parser->commandParse(this);
 
@@ -124,6 +153,10 @@ mp::ParseCode cmd::Find::parse_args(mp::ArgParser* parser)
         request.set_allow_unsupported(true);
     }
 
+    request.set_alias_prefix(parser->value(aliasPrefixOption).toStdString());
+    request.set_min_release(parser->value(minReleaseOption).toStdString());
+    request.set_max_release(parser->value(maxReleaseOption).toStdString());
+
     status = handle_format_option(parser, &chosen_formatter, cerr);
 
     return status;
@@ -0,0 +1,111 @@
+/*
+ * Copyright (C) Canonical, Ltd.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; version 3.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+#include "forward.h"
+
+#include "common_cli.h"
+
+#include <multipass/cli/argparser.h>
+
+namespace mp = multipass;
+namespace cmd = multipass::cmd;
+
+namespace
+{
+const QString cancel_option_name{"cancel"};
+
+int port_from(const QString& arg)
+{
+    bool ok;
+    const auto port = arg.toUShort(&ok);
+    return ok ? port : 0;
+}
+} // namespace
+
+mp::ReturnCode cmd::Forward::run(mp::ArgParser* parser)
+{
+    auto ret = parse_args(parser);
+    if (ret != ParseCode::Ok)
+    {
+        return parser->returnCodeFrom(ret);
+    }
+
+    auto on_success = [this](mp::ForwardReply& reply) {
+        cout << reply.reply_message() << "\n";
+        return ReturnCode::Ok;
+    };
+
+    auto on_failure = [this](grpc::Status& status) { return standard_failure_handler_for(name(), cerr, status); };
+
+    request.set_verbosity_level(parser->verbosityLevel());
+    return dispatch(&RpcMethod::forward, request, on_success, on_failure);
+}
+
+std::string cmd::Forward::name() const
+{
+    return "forward";
+}
+
+QString cmd::Forward::short_help() const
+{
+    return QStringLiteral("Forward a port on the host to an instance");
+}
+
+QString cmd::Forward::description() const
+{
+    return QStringLiteral("Forward connections to a port on the host's loopback interface to a port of an\n"
+                          "instance, for as long as the daemon runs or until cancelled.");
+}
+
+mp::ParseCode cmd::Forward::parse_args(mp::ArgParser* parser)
+{
+    parser->addPositionalArgument("target", "Instance and port to forward to", "<name>:<port>");
+    parser->addPositionalArgument("host-port", "Port on the host to forward from", "<host-port>");
+
+    QCommandLineOption cancel_option(cancel_option_name, "Stop forwarding the given host port instead");
+    parser->addOption(cancel_option);
+
+    auto status = parser->commandParse(this);
+    if (status != ParseCode::Ok)
+        return status;
+
+    const auto args = parser->positionalArguments();
+    if (parser->isSet(cancel_option))
+    {
+        if (args.count() != 1 || !port_from(args.first()))
+        {
+            cerr << "The host port to stop forwarding is required\n";
+            return ParseCode::CommandLineError;
+        }
+
+        request.set_cancel(true);
+        request.set_host_port(port_from(args.first()));
+        return status;
+    }
+
+    const auto separator = args.value(0).lastIndexOf(':');
+    if (args.count() != 2 || separator <= 0 || !port_from(args[0].mid(separator + 1)) || !port_from(args[1]))
+    {
+        cerr << "An instance with the port to forward to, and the host port to forward from, are required\n";
+        return ParseCode::CommandLineError;
+    }
+
+    request.set_instance_name(args[0].left(separator).toStdString());
+    request.set_instance_port(port_from(args[0].mid(separator + 1)));
+    request.set_host_port(port_from(args[1]));
+
+    return status;
+}
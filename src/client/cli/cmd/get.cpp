@@ -26,6 +26,7 @@
 #include <QtGlobal>
 
 #include <cassert>
+#include <set>
 
 namespace mp = multipass;
 namespace cmd = multipass::cmd;
@@ -65,14 +66,14 @@ QString cmd::Get::short_help() const
 
 QString cmd::Get::description() const
 {
-    auto desc = QStringLiteral("Get the configuration setting corresponding to the given key, or all settings if "
-                               "no key is specified.\n(Support for multiple keys and wildcards coming...)");
+    auto desc = QStringLiteral("Get the configuration setting corresponding to the given key, or those corresponding "
+                               "to several keys, one <key>=<value> per line.\n(Support for wildcards coming...)");
     return desc + "\n\n" + describe_common_settings_keys();
 }
 
 mp::ParseCode cmd::Get::parse_args(mp::ArgParser* parser)
 {
-    parser->addPositionalArgument("arg", "Setting key, i.e. path to the intended setting.", "[<arg>]");
+    parser->addPositionalArgument("arg", "Setting key, i.e. path to the intended setting.", "[<arg> ...]");
 
     QCommandLineOption raw_option("raw", "Output in raw format. For now, this affects only the representation of empty "
                                          "values (i.e. \"\" instead of \"<empty>\").");
@@ -88,17 +89,13 @@ mp::ParseCode cmd::Get::parse_args(mp::ArgParser* parser)
         keys_opt = parser->isSet(keys_option);
         raw_opt = parser->isSet(raw_option);
 
-        const auto args = parser->positionalArguments();
-        if (args.count() == 1)
+        args = parser->positionalArguments();
+        if (args.count() > 1 && keys_opt)
         {
-            arg = args.at(0);
-        }
-        else if (args.count() > 1)
-        {
-            cerr << "Need at most one setting key.\n";
+            cerr << "Need at most one setting key with `--keys`.\n";
             status = ParseCode::CommandLineError;
         }
-        else if (!keys_opt) // support 0 or 1 positional arg when --keys is given
+        else if (args.isEmpty() && !keys_opt) // support 0 or 1 positional arg when --keys is given
         {
             cerr << "Multiple settings not implemented yet. Please try again with one setting key or just the "
                     "`--keys` option for now.\n";
@@ -111,22 +108,36 @@ mp::ParseCode cmd::Get::parse_args(mp::ArgParser* parser)
 
 void cmd::Get::print_settings() const
 {
-    assert(!arg.isEmpty() && "Need single arg until we implement multiple settings");
+    assert(!args.isEmpty() && "Need some arg until we implement all settings");
 
-    if (const auto val = MP_SETTINGS.get(arg); arg == passphrase_key) // TODO integrate into setting specs
-        cout << (val.isEmpty() ? "false" : "true");
-    else if (val.isEmpty() && !raw_opt)
-        cout << "<empty>";
-    else
-        cout << qUtf8Printable(val);
+    auto print = [this](const QString& key, const QString& val) {
+        if (key == passphrase_key) // TODO integrate into setting specs
+            cout << (val.isEmpty() ? "false" : "true");
+        else if (val.isEmpty() && !raw_opt)
+            cout << "<empty>";
+        else
+            cout << qUtf8Printable(val);
+
+        cout << "\n";
+    };
 
-    cout << "\n";
+    if (args.count() == 1)
+        return print(args.at(0), MP_SETTINGS.get(args.at(0)));
+
+    // All in one go, so that remote settings take a single request
+    const auto values = MP_SETTINGS.get_values(std::set<QString>{args.cbegin(), args.cend()});
+    for (const auto& key : args)
+    {
+        cout << qUtf8Printable(key) << "=";
+        print(key, values.at(key));
+    }
 }
 
 void multipass::cmd::Get::print_keys() const
 {
     const auto keys = MP_SETTINGS.keys();
     const auto format = "{}\n";
+    const auto arg = args.value(0);
 
     if (arg.isEmpty())
         fmt::print(cout, format, fmt::join(keys, "\n"));
@@ -41,7 +41,7 @@ private:
     void print_settings() const;
     void print_keys() const;
 
-    QString arg;
+    QStringList args;
     bool raw_opt = false;
     bool keys_opt = false;
 };
@@ -121,6 +121,18 @@ auto net_digest(const QString& options)
 
     return net;
 }
+
+std::string progress_message_for(int type)
+{
+    static const std::unordered_map<int, std::string> progress_messages{
+        {mp::LaunchProgress_ProgressTypes_IMAGE, "Retrieving image"},
+        {mp::LaunchProgress_ProgressTypes_EXTRACT, "Extracting image"},
+        {mp::LaunchProgress_ProgressTypes_VERIFY, "Verifying image"},
+        {mp::LaunchProgress_ProgressTypes_WAITING, "Preparing image"}};
+
+    auto it = progress_messages.find(type);
+    return it != progress_messages.end() ? it->second : std::string{};
+}
 } // namespace
 
 mp::ReturnCode cmd::Launch::run(mp::ArgParser* parser)
@@ -131,6 +143,9 @@ mp::ReturnCode cmd::Launch::run(mp::ArgParser* parser)
         return parser->returnCodeFrom(ret);
     }
 
+    if (request.count() > 1)
+        return request_batch_launch();
+
     auto ret = request_launch(parser);
 
     if (ret != ReturnCode::Ok)
@@ -251,9 +266,14 @@ mp::ParseCode cmd::Launch::parse_args(mp::ArgParser* parser)
                                    "Mount a local directory inside the instance. If <instance-path> is omitted, the "
                                    "mount point will be the same as the absolute path of <local-path>",
                                    "local-path>:<instance-path");
+    QCommandLineOption countOption("count",
+                                   "Number of instances to launch alike (default: 1). With more than one, the name is "
+                                   "a pattern where {} stands for the number of each instance, which is otherwise "
+                                   "appended as \"-<number>\".",
+                                   "count", "1");
 
     parser->addOptions({cpusOption, diskOption, memOption, memOptionDeprecated, nameOption, cloudInitOption,
-                        networkOption, bridgedOption, mountOption});
+                        networkOption, bridgedOption, mountOption, countOption});
 
     mp::cmd::add_timeout(parser);
 
@@ -384,6 +404,27 @@ mp::ParseCode cmd::Launch::parse_args(mp::ArgParser* parser)
         }
     }
 
+    if (parser->isSet(countOption))
+    {
+        bool conversion_pass;
+        const auto& count_text = parser->value(countOption);
+        const int count = count_text.toInt(&conversion_pass);
+
+        if (!conversion_pass || count < 1)
+        {
+            fmt::print(cerr, "error: Invalid instance count '{}', need a positive integer value.\n", count_text);
+            return ParseCode::CommandLineError;
+        }
+
+        if (count > 1 && !mount_routes.empty())
+        {
+            cerr << "error: Mounts are not supported when launching several instances\n";
+            return ParseCode::CommandLineError;
+        }
+
+        request.set_count(count);
+    }
+
     if (parser->isSet(cloudInitOption))
     {
         try
@@ -562,12 +603,6 @@ mp::ReturnCode cmd::Launch::request_launch(const ArgParser* parser)
 
     auto streaming_callback = [this](mp::LaunchReply& reply,
                                      grpc::ClientReaderWriterInterface<LaunchRequest, LaunchReply>* client) {
-        std::unordered_map<int, std::string> progress_messages{
-            {LaunchProgress_ProgressTypes_IMAGE, "Retrieving image: "},
-            {LaunchProgress_ProgressTypes_EXTRACT, "Extracting image: "},
-            {LaunchProgress_ProgressTypes_VERIFY, "Verifying image: "},
-            {LaunchProgress_ProgressTypes_WAITING, "Preparing image: "}};
-
         if (!reply.log_line().empty())
         {
             spinner->print(cerr, reply.log_line());
@@ -575,7 +610,7 @@ mp::ReturnCode cmd::Launch::request_launch(const ArgParser* parser)
 
         if (reply.create_oneof_case() == mp::LaunchReply::CreateOneofCase::kLaunchProgress)
         {
-            auto& progress_message = progress_messages[reply.launch_progress().type()];
+            const auto progress_message = progress_message_for(reply.launch_progress().type()) + ": ";
             if (reply.launch_progress().percent_complete() != "-1")
             {
                 spinner->stop();
@@ -603,6 +638,52 @@ mp::ReturnCode cmd::Launch::request_launch(const ArgParser* parser)
     return dispatch(&RpcMethod::launch, request, on_success, on_failure, streaming_callback);
 }
 
+mp::ReturnCode cmd::Launch::request_batch_launch()
+{
+    // With instances going side by side, there is no one line to animate, so each says how it goes on lines of its own
+    auto on_success = [this](mp::LaunchReply& reply) {
+        if (term->is_live() && update_available(reply.update_info()))
+            cout << update_notice(reply.update_info());
+
+        return ReturnCode::Ok;
+    };
+
+    auto on_failure = [this](grpc::Status& status) { return standard_failure_handler_for(name(), cerr, status); };
+
+    std::unordered_map<std::string, int> progress_types;
+    auto streaming_callback = [this, &progress_types](mp::LaunchReply& reply,
+                                                      grpc::ClientReaderWriterInterface<LaunchRequest, LaunchReply>*) {
+        if (!reply.log_line().empty())
+            cerr << reply.log_line();
+
+        const auto& instance = reply.batch_instance();
+        if (reply.create_oneof_case() == mp::LaunchReply::CreateOneofCase::kVmInstanceName)
+        {
+            cout << "Launched: " << reply.vm_instance_name() << "\n";
+        }
+        else if (reply.create_oneof_case() == mp::LaunchReply::CreateOneofCase::kLaunchProgress)
+        {
+            // Percentages would interleave, only the start of each step is told
+            const auto type = reply.launch_progress().type();
+            if (auto [it, inserted] = progress_types.try_emplace(instance, type); inserted || it->second != type)
+            {
+                it->second = type;
+                cout << instance << ": " << progress_message_for(type) << "\n";
+            }
+        }
+        else if (reply.create_oneof_case() == mp::LaunchReply::CreateOneofCase::kCreateMessage)
+        {
+            cout << instance << ": " << reply.create_message() << "\n";
+        }
+        else if (!reply.reply_message().empty())
+        {
+            cout << instance << ": " << reply.reply_message() << "\n";
+        }
+    };
+
+    return dispatch(&RpcMethod::launch, request, on_success, on_failure, streaming_callback);
+}
+
 auto cmd::Launch::mount(const mp::ArgParser* parser, const QString& mount_source, const QString& mount_target)
     -> ReturnCode
 {
@@ -24,6 +24,12 @@
 namespace mp = multipass;
 namespace cmd = multipass::cmd;
 
+namespace
+{
+// How many instances the daemon sends at a time
+constexpr auto chunk_size = 64u;
+} // namespace
+
 mp::ReturnCode cmd::List::run(mp::ArgParser* parser)
 {
     auto ret = parse_args(parser);
@@ -32,19 +38,37 @@ mp::ReturnCode cmd::List::run(mp::ArgParser* parser)
         return parser->returnCodeFrom(ret);
     }
 
-    auto on_success = [this](ListReply& reply) {
-        cout << chosen_formatter->format(reply);
+    // Instances come in chunks, written out as they arrive
+    auto stream = chosen_formatter->list_stream();
+    UpdateInfo update_info;
+    auto on_success = [this, &stream, &update_info](ListReply& /* last reply, already streamed */) {
+        cout << stream->finish();
 
-        if (term->is_live() && update_available(reply.update_info()))
-            cout << update_notice(reply.update_info());
+        if (term->is_live() && update_available(update_info))
+            cout << update_notice(update_info);
 
         return ReturnCode::Ok;
     };
 
     auto on_failure = [this](grpc::Status& status) { return standard_failure_handler_for(name(), cerr, status); };
 
+    auto streaming_callback = [this, &stream, &update_info](
+                                  ListReply& reply, grpc::ClientReaderWriterInterface<ListRequest, ListReply>*) {
+        if (!reply.log_line().empty())
+        {
+            cerr << reply.log_line();
+            return;
+        }
+
+        if (reply.has_update_info())
+            update_info = reply.update_info();
+
+        cout << stream->add(reply);
+    };
+
     request.set_verbosity_level(parser->verbosityLevel());
-    return dispatch(&RpcMethod::list, request, on_success, on_failure);
+    request.set_chunk_size(chunk_size);
+    return dispatch(&RpcMethod::list, request, on_success, on_failure, streaming_callback);
 }
 
 std::string cmd::List::name() const
@@ -134,8 +134,14 @@ mp::ParseCode cmd::Mount::parse_args(mp::ArgParser* parser)
                                          "Native mounts use hypervisor and/or platform specific mounts.\n"
                                          "Valid types are: \'classic\' (default) and \'native\'",
                                          "type", default_mount_type);
+    QCommandLineOption mount_profile_option("mount-profile",
+                                            "Tune a classic mount for a kind of use.\n"
+                                            "Valid profiles are: \'default\', \'throughput\' (large files),\n"
+                                            "\'metadata\' (many small files, as in builds) and \'consistent\'\n"
+                                            "(changes on the host are seen right away)",
+                                            "profile");
 
-    parser->addOptions({gid_mappings, uid_mappings, mount_type_option});
+    parser->addOptions({gid_mappings, uid_mappings, mount_type_option, mount_profile_option});
 
     auto status = parser->commandParse(this);
     if (status != ParseCode::Ok)
@@ -280,6 +286,7 @@ mp::ParseCode cmd::Mount::parse_args(mp::ArgParser* parser)
     try
     {
         request.set_mount_type(checked_mount_type(parser->value(mount_type_option).toLower()));
+        request.set_mount_profile(parser->value(mount_profile_option).toLower().toStdString());
     }
     catch (mp::ValidationException& e)
     {
@@ -22,7 +22,9 @@
 #include <multipass/exceptions/settings_exceptions.h>
 #include <multipass/logging/log.h>
 
+#include <algorithm>
 #include <cassert>
+#include <iterator>
 #include <stdexcept>
 #include <utility>
 
@@ -103,8 +105,27 @@ public:
         assert(ret == mp::ReturnCode::Ok && "should have thrown otherwise");
     }
 
+    RemoteGet(const std::set<QString>& keys, mp::Rpc::StubInterface& stub, mp::Terminal* term, int verbosity)
+        : RemoteSettingsCmd{stub, term} // need to ensure refs outlive this
+    {
+        mp::GetRequest get_request;
+        get_request.set_verbosity_level(verbosity);
+        for (const auto& key : keys)
+            get_request.add_keys(key.toStdString());
+
+        auto custom_on_success = [this](mp::GetReply& reply) {
+            for (const auto& [key, val] : reply.values())
+                got_values.emplace(QString::fromStdString(key), QString::fromStdString(val));
+            return mp::ReturnCode::Ok;
+        };
+
+        [[maybe_unused]] auto ret = dispatch(&RpcMethod::get, get_request, custom_on_success, on_failure);
+        assert(ret == mp::ReturnCode::Ok && "should have thrown otherwise");
+    }
+
 public:
     QString got = {};
+    std::map<QString, QString> got_values = {};
 };
 
 class RemoteSet : public RemoteSettingsCmd
@@ -118,6 +139,24 @@ public:
         set_request.set_key(key.toStdString());
         set_request.set_val(val.toStdString());
 
+        send(set_request);
+    }
+
+    RemoteSet(const std::map<QString, QString>& values, mp::Rpc::StubInterface& stub, mp::Terminal* term,
+              int verbosity)
+        : RemoteSettingsCmd{stub, term} // need to ensure refs outlive this
+    {
+        mp::SetRequest set_request;
+        set_request.set_verbosity_level(verbosity);
+        for (const auto& [key, val] : values)
+            (*set_request.mutable_values())[key.toStdString()] = val.toStdString();
+
+        send(set_request);
+    }
+
+private:
+    void send(const mp::SetRequest& set_request)
+    {
         mp::AnimatedSpinner spinner{cout};
         auto streaming_callback = [this,
                                    &spinner](mp::SetReply& reply,
@@ -201,6 +240,30 @@ void mp::RemoteSettingsHandler::set(const QString& key, const QString& val)
         throw mp::UnrecognizedSettingException{key};
 }
 
+std::map<QString, QString> mp::RemoteSettingsHandler::get_values(const std::set<QString>& keys) const
+{
+    std::set<QString> remote_keys;
+    std::copy_if(keys.cbegin(), keys.cend(), std::inserter(remote_keys, remote_keys.end()),
+                 [this](const QString& key) { return key.startsWith(key_prefix); });
+    if (remote_keys.empty())
+        return {};
+
+    assert(term);
+    return RemoteGet{remote_keys, stub, term, verbosity}.got_values;
+}
+
+void mp::RemoteSettingsHandler::set_values(const std::map<QString, QString>& values)
+{
+    std::map<QString, QString> remote_values;
+    std::copy_if(values.cbegin(), values.cend(), std::inserter(remote_values, remote_values.end()),
+                 [this](const auto& keyval) { return keyval.first.startsWith(key_prefix); });
+    if (remote_values.empty())
+        return;
+
+    assert(term);
+    RemoteSet(remote_values, stub, term, verbosity);
+}
+
 std::set<QString> mp::RemoteSettingsHandler::keys() const
 {
     assert(term);
@@ -32,6 +32,8 @@ public:
     QString get(const QString& key) const override;
     void set(const QString& key, const QString& val) override;
     std::set<QString> keys() const override;
+    std::map<QString, QString> get_values(const std::set<QString>& keys) const override; // in one request
+    void set_values(const std::map<QString, QString>& values) override;                   // in one request
 
 public: // accessors for tests
     const QString& get_key_prefix() const;
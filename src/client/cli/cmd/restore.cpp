@@ -0,0 +1,97 @@
+/*
+ * Copyright (C) Canonical, Ltd.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; version 3.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#include "restore.h"
+
+#include "animated_spinner.h"
+#include "common_cli.h"
+
+#include <multipass/cli/argparser.h>
+#include <multipass/format.h>
+
+namespace mp = multipass;
+namespace cmd = multipass::cmd;
+
+mp::ReturnCode cmd::Restore::run(mp::ArgParser* parser)
+{
+    auto ret = parse_args(parser);
+    if (ret != ParseCode::Ok)
+    {
+        return parser->returnCodeFrom(ret);
+    }
+
+    AnimatedSpinner spinner{cout};
+    spinner.start(fmt::format("Restoring {}", request.instance_name()));
+
+    auto on_success = [this, &spinner](RestoreReply& reply) {
+        spinner.stop();
+        cout << reply.reply_message() << "\n";
+        return ReturnCode::Ok;
+    };
+
+    auto on_failure = [this, &spinner](grpc::Status& status) {
+        spinner.stop();
+        return standard_failure_handler_for(name(), cerr, status);
+    };
+
+    auto streaming_callback = [this, &spinner](RestoreReply& reply,
+                                               grpc::ClientReaderWriterInterface<RestoreRequest, RestoreReply>*) {
+        if (!reply.log_line().empty())
+            spinner.print(cerr, reply.log_line());
+    };
+
+    request.set_verbosity_level(parser->verbosityLevel());
+    return dispatch(&RpcMethod::restore, request, on_success, on_failure, streaming_callback);
+}
+
+std::string cmd::Restore::name() const
+{
+    return "restore";
+}
+
+QString cmd::Restore::short_help() const
+{
+    return QStringLiteral("Restore a stopped instance to a snapshot");
+}
+
+QString cmd::Restore::description() const
+{
+    return QStringLiteral("Restore the disk of a stopped instance to what it was when the snapshot was\n"
+                          "taken. Whatever changed since is lost. Nothing is copied, so restoring\n"
+                          "takes no longer for large instances than for small ones.");
+}
+
+mp::ParseCode cmd::Restore::parse_args(mp::ArgParser* parser)
+{
+    parser->addPositionalArgument("instance", "Name of the instance to restore", "<instance>");
+    parser->addPositionalArgument("snapshot", "Name of the snapshot to restore", "<snapshot>");
+
+    auto status = parser->commandParse(this);
+    if (status != ParseCode::Ok)
+        return status;
+
+    if (parser->positionalArguments().count() != 2)
+    {
+        cerr << "The name of one instance and of a snapshot are required\n";
+        return ParseCode::CommandLineError;
+    }
+
+    request.set_instance_name(parser->positionalArguments().at(0).toStdString());
+    request.set_snapshot_name(parser->positionalArguments().at(1).toStdString());
+
+    return status;
+}
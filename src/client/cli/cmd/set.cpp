@@ -38,8 +38,10 @@ mp::ReturnCode cmd::Set::run(mp::ArgParser* parser)
     {
         try
         {
-            if (ret == ReturnCode::Ok)
+            if (ret == ReturnCode::Ok && values.empty())
                 MP_SETTINGS.set(key, val);
+            else if (ret == ReturnCode::Ok)
+                MP_SETTINGS.set_values(values); // all in one go, so that remote settings take a single request
         }
         catch (const SettingsException& e)
         {
@@ -63,7 +65,8 @@ QString cmd::Set::short_help() const
 
 QString cmd::Set::description() const
 {
-    auto desc = QStringLiteral("Set, to the given value, the configuration setting corresponding to the given key.");
+    auto desc = QStringLiteral("Set, to the given value, the configuration setting corresponding to the given key. "
+                               "Several can be given at once, as key-value pairs.");
     return desc + "\n\n" + describe_common_settings_keys();
 }
 
@@ -73,17 +76,35 @@ mp::ParseCode cmd::Set::parse_args(mp::ArgParser* parser)
                                   "A key, or a key-value pair. The key specifies a path to the setting to configure. "
                                   "The value is its intended value. If only the key is given, "
                                   "the value will be prompted for.",
-                                  "<key>[=<value>]");
+                                  "<key>[=<value>] [<key>=<value> ...]");
 
     auto status = parser->commandParse(this);
     if (status == ParseCode::Ok)
     {
         const auto args = parser->positionalArguments();
-        if (args.size() != 1)
+        if (args.isEmpty())
         {
-            cerr << "Need exactly one key-value pair (in <key>=<value> form).\n";
+            cerr << "Need at least one key-value pair (in <key>=<value> form).\n";
             status = ParseCode::CommandLineError;
         }
+        else if (args.size() > 1)
+        {
+            for (const auto& arg : args)
+            {
+                const auto keyval = arg.split('=', QString::KeepEmptyParts);
+                if (keyval.size() != 2 || keyval[0].isEmpty())
+                {
+                    cerr << "Bad key-value format, several settings need a value each (in <key>=<value> form).\n";
+                    return ParseCode::CommandLineError;
+                }
+
+                if (!values.emplace(keyval.at(0), keyval.at(1)).second)
+                {
+                    cerr << "Setting key given more than once.\n";
+                    return ParseCode::CommandLineError;
+                }
+            }
+        }
         else
         {
             const auto keyval = args.at(0).split('=', QString::KeepEmptyParts);
@@ -22,6 +22,8 @@
 
 #include <QString>
 
+#include <map>
+
 namespace multipass
 {
 namespace cmd
@@ -42,6 +44,7 @@ private:
 
     QString key;
     QString val;
+    std::map<QString, QString> values; // when given several
 };
 } // namespace cmd
 } // namespace multipass
@@ -24,6 +24,7 @@
 #include <multipass/exceptions/cmd_exceptions.h>
 #include <multipass/settings/settings.h>
 #include <multipass/ssh/ssh_client.h>
+#include <multipass/ssh/ssh_control_master.h>
 #include <multipass/timer.h>
 
 #include <chrono>
@@ -72,6 +73,9 @@ mp::ReturnCode cmd::Shell::run(mp::ArgParser* parser)
 
         try
         {
+            if (exec_multiplexed(ssh_info, "", false, term, session))
+                return ReturnCode::Ok;
+
             auto console_creator = [this](auto channel) { return Console::make_console(channel, term); };
             mp::SSHClient ssh_client{host, port, username, priv_key_blob, console_creator};
             ssh_client.connect();
@@ -140,6 +144,13 @@ mp::ParseCode cmd::Shell::parse_args(mp::ArgParser* parser)
 
     mp::cmd::add_timeout(parser);
 
+    QCommandLineOption session_option{
+        "session",
+        "Keep the shell running under this name when disconnected, and attach to it again when opening a shell with "
+        "the same name. It is kept for as long as client.ssh-control-persist says, after it was last used.",
+        "name"};
+    parser->addOption(session_option);
+
     auto status = parser->commandParse(this);
 
     if (status != ParseCode::Ok)
@@ -157,6 +168,24 @@ mp::ParseCode cmd::Shell::parse_args(mp::ArgParser* parser)
         return ParseCode::CommandLineError;
     }
 
+    if (parser->isSet(session_option))
+    {
+        session = parser->value(session_option).toStdString();
+        if (session.empty() || session.size() > SSHControlMaster::max_session_name_length)
+        {
+            fmt::print(cerr, "The session name must be 1 to {} characters long.\n",
+                       SSHControlMaster::max_session_name_length);
+            return ParseCode::CommandLineError;
+        }
+
+        if (MP_SETTINGS.get(ssh_control_persist_key).toInt() <= 0)
+        {
+            fmt::print(cerr, "Shell sessions are kept by shared SSH connections, please set {} to use them.\n",
+                       ssh_control_persist_key);
+            return ParseCode::CommandLineError;
+        }
+    }
+
     const auto pos_args = parser->positionalArguments();
     const auto num_args = pos_args.count();
     if (num_args > 1)
@@ -40,6 +40,7 @@ public:
 private:
     SSHInfoRequest request;
     QString petenv_name;
+    std::string session;
 
     ParseCode parse_args(ArgParser* parser);
 };
@@ -0,0 +1,124 @@
+/*
+ * Copyright (C) Canonical, Ltd.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; version 3.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#include "snapshot.h"
+
+#include "animated_spinner.h"
+#include "common_cli.h"
+
+#include <multipass/cli/argparser.h>
+#include <multipass/format.h>
+
+namespace mp = multipass;
+namespace cmd = multipass::cmd;
+
+mp::ReturnCode cmd::Snapshot::run(mp::ArgParser* parser)
+{
+    auto ret = parse_args(parser);
+    if (ret != ParseCode::Ok)
+    {
+        return parser->returnCodeFrom(ret);
+    }
+
+    AnimatedSpinner spinner{cout};
+    if (!request.list_snapshots())
+        spinner.start(request.delete_snapshot() ? fmt::format("Deleting snapshot {}", request.snapshot_name())
+                                                : fmt::format("Snapshotting {}", request.instance_name()));
+
+    auto on_success = [this, &spinner](SnapshotReply& reply) {
+        spinner.stop();
+        if (request.list_snapshots())
+        {
+            if (reply.snapshot_names().empty())
+                cout << fmt::format("{} has no snapshots\n", request.instance_name());
+            for (const auto& snapshot : reply.snapshot_names())
+                cout << snapshot << "\n";
+        }
+        else
+            cout << reply.reply_message() << "\n";
+
+        return ReturnCode::Ok;
+    };
+
+    auto on_failure = [this, &spinner](grpc::Status& status) {
+        spinner.stop();
+        return standard_failure_handler_for(name(), cerr, status);
+    };
+
+    auto streaming_callback = [this, &spinner](SnapshotReply& reply,
+                                               grpc::ClientReaderWriterInterface<SnapshotRequest, SnapshotReply>*) {
+        if (!reply.log_line().empty())
+            spinner.print(cerr, reply.log_line());
+    };
+
+    request.set_verbosity_level(parser->verbosityLevel());
+    return dispatch(&RpcMethod::snapshot, request, on_success, on_failure, streaming_callback);
+}
+
+std::string cmd::Snapshot::name() const
+{
+    return "snapshot";
+}
+
+QString cmd::Snapshot::short_help() const
+{
+    return QStringLiteral("Take, list or delete snapshots of an instance");
+}
+
+QString cmd::Snapshot::description() const
+{
+    return QStringLiteral("Take a snapshot of the disk of a stopped instance, to restore it to later.\n"
+                          "Nothing is copied: from then on, the instance only keeps what changes.\n"
+                          "With --list, show the snapshots of an instance. With --delete, remove one:\n"
+                          "the instance and the snapshots taken after it keep all they had.");
+}
+
+mp::ParseCode cmd::Snapshot::parse_args(mp::ArgParser* parser)
+{
+    parser->addPositionalArgument("instance", "Name of the instance to snapshot", "<instance>");
+    parser->addPositionalArgument("snapshot", "Name to give the snapshot, or of the one to delete", "[<snapshot>]");
+
+    QCommandLineOption list_option("list", "List the snapshots of the instance instead");
+    QCommandLineOption delete_option("delete", "Delete the named snapshot instead");
+    parser->addOptions({list_option, delete_option});
+
+    auto status = parser->commandParse(this);
+    if (status != ParseCode::Ok)
+        return status;
+
+    const auto list = parser->isSet(list_option);
+    if (list && parser->isSet(delete_option))
+    {
+        cerr << "Cannot both list and delete snapshots\n";
+        return ParseCode::CommandLineError;
+    }
+
+    if (parser->positionalArguments().count() != (list ? 1 : 2))
+    {
+        cerr << (list ? "The name of one instance is required\n"
+                      : "The name of one instance and of a snapshot are required\n");
+        return ParseCode::CommandLineError;
+    }
+
+    request.set_instance_name(parser->positionalArguments().at(0).toStdString());
+    if (!list)
+        request.set_snapshot_name(parser->positionalArguments().at(1).toStdString());
+    request.set_list_snapshots(list);
+    request.set_delete_snapshot(parser->isSet(delete_option));
+
+    return status;
+}
@@ -35,6 +35,7 @@ namespace fs = mp::fs;
 namespace
 {
 constexpr char streaming_symbol{'-'};
+constexpr auto max_parallel_transfers = 16;
 } // namespace
 
 mp::ReturnCode cmd::Transfer::run(mp::ArgParser* parser)
@@ -52,7 +53,12 @@ mp::ReturnCode cmd::Transfer::run(mp::ArgParser* parser)
             try
             {
                 auto sftp_client = MP_SFTPUTILS.make_SFTPClient(ssh_info.host(), ssh_info.port(), ssh_info.username(),
-                                                                ssh_info.priv_key_base64());
+                                                                ssh_info.priv_key_base64(),
+                                                                wants_compression(compression, ssh_info));
+                if (parallel_transfers > 1)
+                    sftp_client->set_parallel_transfers(parallel_transfers);
+                if (ssh_info.transfer_window() > 0)
+                    sftp_client->set_transfer_window(ssh_info.transfer_window());
 
                 if (const auto args = std::get_if<InstanceSourcesLocalTarget>(&arguments); args)
                 {
@@ -131,12 +137,39 @@ mp::ParseCode cmd::Transfer::parse_args(mp::ArgParser* parser)
                                   "<destination>");
     parser->addOption({{"r", "recursive"}, "Recursively copy entire directories"});
     parser->addOption({{"p", "parents"}, "Make parent directories as needed"});
+    parser->addOption({"sync", "Only copy files whose size or modification time differ from those already at the "
+                               "destination, and carry modification times over"});
+    parser->addOption(
+        {"resume", "Continue copying files that an earlier, interrupted transfer left partially written"});
+    parser->addOption({"parallel",
+                       QString{"Copy up to <count> files at a time in recursive transfers, each over a connection "
+                               "of its own. Defaults to 1, at most %1"}
+                           .arg(max_parallel_transfers),
+                       "count"});
+    add_compression_options(parser);
 
     if (auto status = parser->commandParse(this); status != ParseCode::Ok)
         return status;
 
     flags.setFlag(SFTPClient::Flag::Recursive, parser->isSet("r"));
     flags.setFlag(SFTPClient::Flag::MakeParent, parser->isSet("p"));
+    flags.setFlag(SFTPClient::Flag::Sync, parser->isSet("sync"));
+    flags.setFlag(SFTPClient::Flag::Resume, parser->isSet("resume"));
+
+    if (auto status = parse_compression_options(parser, compression, term->cerr()); status != ParseCode::Ok)
+        return status;
+
+    if (parser->isSet("parallel"))
+    {
+        bool ok;
+        parallel_transfers = parser->value("parallel").toInt(&ok);
+        if (!ok || parallel_transfers < 1 || parallel_transfers > max_parallel_transfers)
+        {
+            term->cerr() << fmt::format("--parallel value has to be an integer between 1 and {}\n",
+                                        max_parallel_transfers);
+            return ParseCode::CommandLineError;
+        }
+    }
 
     auto positionalArgs = parser->positionalArguments();
     if (positionalArgs.size() < 2)
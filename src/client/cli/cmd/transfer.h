@@ -23,6 +23,7 @@
 
 #include "multipass/cli/return_codes.h"
 #include <filesystem>
+#include <optional>
 #include <string>
 #include <variant>
 #include <vector>
@@ -67,6 +68,8 @@ private:
     SSHInfoRequest request;
     std::variant<InstanceSourcesLocalTarget, LocalSourcesInstanceTarget, FromCin, ToCout> arguments;
     SFTPClient::Flags flags;
+    int parallel_transfers{1};
+    std::optional<bool> compression;
 
     ParseCode parse_args(ArgParser* parser);
     std::vector<std::pair<std::string, fs::path>> args_to_instance_and_path(const QStringList& args);
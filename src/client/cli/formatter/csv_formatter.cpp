@@ -23,6 +23,46 @@ namespace mp = multipass;
 
 namespace
 {
+constexpr auto list_header = "Name,State,IPv4,IPv6,Release,AllIPv4\n";
+
+void format_list_rows(fmt::memory_buffer& buf, const google::protobuf::RepeatedPtrField<mp::ListVMInstance>& instances)
+{
+    for (const auto& instance : mp::format::sorted(instances))
+    {
+        fmt::format_to(std::back_inserter(buf), "{},{},{},{},{},\"{}\"\n", instance.name(),
+                       mp::format::status_string_for(instance.instance_status()),
+                       instance.ipv4_size() ? instance.ipv4(0) : "", instance.ipv6_size() ? instance.ipv6(0) : "",
+                       instance.current_release().empty() ? "Not Available"
+                                                          : fmt::format("Ubuntu {}", instance.current_release()),
+                       fmt::join(instance.ipv4(), ","));
+    }
+}
+
+// Rows are sorted within each chunk
+class CSVListStream final : public mp::ListFormatStream
+{
+public:
+    std::string add(const mp::ListReply& chunk) override
+    {
+        fmt::memory_buffer buf;
+        if (!started)
+            fmt::format_to(std::back_inserter(buf), list_header);
+
+        started = true;
+        format_list_rows(buf, chunk.instances());
+
+        return fmt::to_string(buf);
+    }
+
+    std::string finish() override
+    {
+        return started ? std::string{} : list_header;
+    }
+
+private:
+    bool started = false;
+};
+
 std::string format_images(const google::protobuf::RepeatedPtrField<mp::FindReply_ImageInfo>& images_info,
                           std::string type)
 {
@@ -77,17 +117,8 @@ std::string mp::CSVFormatter::format(const ListReply& reply) const
 {
     fmt::memory_buffer buf;
 
-    fmt::format_to(std::back_inserter(buf), "Name,State,IPv4,IPv6,Release,AllIPv4\n");
-
-    for (const auto& instance : format::sorted(reply.instances()))
-    {
-        fmt::format_to(std::back_inserter(buf), "{},{},{},{},{},\"{}\"\n", instance.name(),
-                       mp::format::status_string_for(instance.instance_status()),
-                       instance.ipv4_size() ? instance.ipv4(0) : "", instance.ipv6_size() ? instance.ipv6(0) : "",
-                       instance.current_release().empty() ? "Not Available"
-                                                          : fmt::format("Ubuntu {}", instance.current_release()),
-                       fmt::join(instance.ipv4(), ","));
-    }
+    fmt::format_to(std::back_inserter(buf), list_header);
+    format_list_rows(buf, reply.instances());
 
     return fmt::to_string(buf);
 }
@@ -149,3 +180,8 @@ std::string mp::CSVFormatter::format(const mp::AliasDict& aliases) const
 
     return fmt::to_string(buf);
 }
+
+std::unique_ptr<mp::ListFormatStream> mp::CSVFormatter::list_stream() const
+{
+    return std::make_unique<CSVListStream>();
+}
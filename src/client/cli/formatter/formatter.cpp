@@ -0,0 +1,51 @@
+/*
+ * Copyright (C) Canonical, Ltd.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; version 3.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#include <multipass/cli/formatter.h>
+
+namespace mp = multipass;
+
+namespace
+{
+class CollectingListStream final : public mp::ListFormatStream
+{
+public:
+    explicit CollectingListStream(const mp::Formatter& formatter) : formatter{formatter}
+    {
+    }
+
+    std::string add(const mp::ListReply& chunk) override
+    {
+        list.mutable_instances()->MergeFrom(chunk.instances());
+        return {};
+    }
+
+    std::string finish() override
+    {
+        return formatter.format(list);
+    }
+
+private:
+    const mp::Formatter& formatter;
+    mp::ListReply list;
+};
+} // namespace
+
+std::unique_ptr<mp::ListFormatStream> mp::Formatter::list_stream() const
+{
+    return std::make_unique<CollectingListStream>(*this);
+}
@@ -29,6 +29,77 @@ namespace mp = multipass;
 
 namespace
 {
+QJsonObject list_instance_to_json(const mp::ListVMInstance& instance)
+{
+    QJsonObject instance_obj;
+    instance_obj.insert("name", QString::fromStdString(instance.name()));
+    instance_obj.insert("state", QString::fromStdString(mp::format::status_string_for(instance.instance_status())));
+
+    QJsonArray ipv4_addrs;
+    for (const auto& ip : instance.ipv4())
+        ipv4_addrs.append(QString::fromStdString(ip));
+    instance_obj.insert("ipv4", ipv4_addrs);
+
+    instance_obj.insert("release",
+                        QString::fromStdString(instance.current_release().empty()
+                                                   ? "Not Available"
+                                                   : fmt::format("Ubuntu {}", instance.current_release())));
+
+    return instance_obj;
+}
+
+// Writes the same document format() would, an instance at a time, instead of building it all first
+class JsonListStream final : public mp::ListFormatStream
+{
+public:
+    std::string add(const mp::ListReply& chunk) override
+    {
+        std::string out = start();
+        for (const auto& instance : chunk.instances())
+        {
+            if (any_instances)
+                out += ",\n";
+
+            any_instances = true;
+            out += indented(QJsonDocument{list_instance_to_json(instance)}.toJson().toStdString());
+        }
+
+        return out;
+    }
+
+    std::string finish() override
+    {
+        return start() + (any_instances ? "\n" : "") + "    ]\n}\n";
+    }
+
+private:
+    std::string start()
+    {
+        if (started)
+            return {};
+
+        started = true;
+        return "{\n    \"list\": [\n";
+    }
+
+    // Two levels in, as the elements of the "list" array, and without the document's trailing newline
+    static std::string indented(const std::string& object)
+    {
+        std::string out;
+        std::string::size_type begin = 0, end;
+        while ((end = object.find('\n', begin)) != std::string::npos)
+        {
+            out += (begin ? "\n        " : "        ") + object.substr(begin, end - begin);
+            begin = end + 1;
+        }
+
+        return out;
+    }
+
+    bool started = false;
+    bool any_instances = false;
+};
+
 QJsonObject format_images(const google::protobuf::RepeatedPtrField<mp::FindReply_ImageInfo>& images_info)
 {
     QJsonObject images_obj;
@@ -73,6 +144,30 @@ std::string mp::JsonFormatter::format(const InfoReply& reply) const
         instance_info.insert("release", QString::fromStdString(info.current_release()));
         instance_info.insert("cpu_count", QString::fromStdString(info.cpu_count()));
 
+        // Only there for instances held to them
+        QJsonObject limits;
+        if (!info.network_limit().empty())
+            limits.insert("network_mbits", std::stoi(info.network_limit()));
+        if (!info.disk_iops_limit().empty())
+            limits.insert("disk_iops", std::stoi(info.disk_iops_limit()));
+        if (!limits.isEmpty())
+            instance_info.insert("limits", limits);
+
+        if (info.has_host_stats())
+        {
+            const auto& stats = info.host_stats();
+            instance_info.insert("host_stats",
+                                 QJsonObject{{"cpu_time_ns", static_cast<qint64>(stats.cpu_time_ns())},
+                                             {"steal_time_ns", static_cast<qint64>(stats.steal_time_ns())},
+                                             {"rss_bytes", static_cast<qint64>(stats.rss_bytes())},
+                                             {"balloon_bytes", static_cast<qint64>(stats.balloon_bytes())},
+                                             {"disk_read_bytes", static_cast<qint64>(stats.disk_read_bytes())},
+                                             {"disk_written_bytes", static_cast<qint64>(stats.disk_written_bytes())},
+                                             {"network_received_bytes",
+                                              static_cast<qint64>(stats.network_received_bytes())},
+                                             {"network_sent_bytes", static_cast<qint64>(stats.network_sent_bytes())}});
+        }
+
         QJsonArray load;
         if (!info.load().empty())
         {
@@ -140,6 +235,26 @@ std::string mp::JsonFormatter::format(const InfoReply& reply) const
             entry.insert("gid_mappings", mount_gids);
             entry.insert("source_path", QString::fromStdString(mount.source_path()));
 
+            if (mount.has_mount_stats())
+            {
+                const auto& stats = mount.mount_stats();
+                QJsonObject requests;
+                for (const auto& op : stats.ops())
+                {
+                    QJsonArray histogram;
+                    for (const auto bucket : op.latency_histogram())
+                        histogram.append(static_cast<qint64>(bucket));
+
+                    requests.insert(QString::fromStdString(op.op()),
+                                    QJsonObject{{"count", static_cast<qint64>(op.count())},
+                                                {"latency_histogram", histogram}});
+                }
+
+                entry.insert("stats", QJsonObject{{"bytes_read", static_cast<qint64>(stats.bytes_read())},
+                                                  {"bytes_written", static_cast<qint64>(stats.bytes_written())},
+                                                  {"requests", requests}});
+            }
+
             mounts.insert(QString::fromStdString(mount.target_path()), entry);
         }
         instance_info.insert("mounts", mounts);
@@ -157,23 +272,7 @@ std::string mp::JsonFormatter::format(const ListReply& reply) const
     QJsonArray instances;
 
     for (const auto& instance : reply.instances())
-    {
-        QJsonObject instance_obj;
-        instance_obj.insert("name", QString::fromStdString(instance.name()));
-        instance_obj.insert("state", QString::fromStdString(mp::format::status_string_for(instance.instance_status())));
-
-        QJsonArray ipv4_addrs;
-        for (const auto& ip : instance.ipv4())
-            ipv4_addrs.append(QString::fromStdString(ip));
-        instance_obj.insert("ipv4", ipv4_addrs);
-
-        instance_obj.insert("release",
-                            QString::fromStdString(instance.current_release().empty()
-                                                       ? "Not Available"
-                                                       : fmt::format("Ubuntu {}", instance.current_release())));
-
-        instances.append(instance_obj);
-    }
+        instances.append(list_instance_to_json(instance));
 
     list_json.insert("list", instances);
 
@@ -238,3 +337,8 @@ std::string mp::JsonFormatter::format(const mp::AliasDict& aliases) const
 {
     return mp::json_to_string(aliases.to_json());
 }
+
+std::unique_ptr<mp::ListFormatStream> mp::JsonFormatter::list_stream() const
+{
+    return std::make_unique<JsonListStream>();
+}
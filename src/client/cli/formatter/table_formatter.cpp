@@ -22,6 +22,8 @@
 #include <multipass/format.h>
 #include <multipass/memory_size.h>
 
+#include <optional>
+
 namespace mp = multipass;
 
 namespace
@@ -53,7 +55,99 @@ std::string to_usage(const std::string& usage, const std::string& total)
     return fmt::format("{} out of {}", mp::MemorySize{usage}.human_readable(), mp::MemorySize{total}.human_readable());
 }
 
+std::string to_human_readable(std::uint64_t bytes)
+{
+    return mp::MemorySize{std::to_string(bytes)}.human_readable();
+}
+
+using Instances = google::protobuf::RepeatedPtrField<mp::ListVMInstance>;
+
+constexpr auto list_row_format = "{:<{}}{:<{}}{:<{}}{:<}\n";
+constexpr std::string::size_type list_state_column_width = 18;
+constexpr std::string::size_type list_ip_column_width = 17;
+
+int list_name_column_width(const Instances& instances)
+{
+    return mp::format::column_width(
+        instances.begin(), instances.end(), [](const auto& instance) -> int { return instance.name().length(); }, 24);
+}
+
+void format_list_header(fmt::memory_buffer& buf, int name_column_width)
+{
+    fmt::format_to(std::back_inserter(buf), list_row_format, "Name", name_column_width, "State",
+                   list_state_column_width, "IPv4", list_ip_column_width, "Image");
+}
+
+void format_list_rows(fmt::memory_buffer& buf, const Instances& instances, int name_column_width)
+{
+    for (const auto& instance : mp::format::sorted(instances))
+    {
+        int ipv4_size = instance.ipv4_size();
+
+        fmt::format_to(std::back_inserter(buf), list_row_format, instance.name(), name_column_width,
+                       mp::format::status_string_for(instance.instance_status()), list_state_column_width,
+                       ipv4_size ? instance.ipv4(0) : "--", list_ip_column_width,
+                       instance.current_release().empty() ? "Not Available"
+                                                          : fmt::format("Ubuntu {}", instance.current_release()));
+
+        for (int i = 1; i < ipv4_size; ++i)
+        {
+            fmt::format_to(std::back_inserter(buf), list_row_format, "", name_column_width, "",
+                           list_state_column_width, instance.ipv4(i), instance.ipv4(i).size(), "");
+        }
+    }
+}
+
+// The widths are those of the first rows, held back until there are enough of them to go by. Rows are sorted among
+// those that come out together, and any later name that is longer than the column pushes the rest of its row along.
+class TableListStream final : public mp::ListFormatStream
+{
+public:
+    std::string add(const mp::ListReply& chunk) override
+    {
+        if (name_column_width)
+            return rows(chunk.instances());
+
+        preview.MergeFrom(chunk.instances());
+        return preview.size() < preview_rows ? std::string{} : start();
+    }
+
+    std::string finish() override
+    {
+        if (name_column_width)
+            return {};
+
+        return preview.empty() ? "No instances found.\n" : start();
+    }
+
+private:
+    static constexpr auto preview_rows = 64;
+
+    std::string start()
+    {
+        name_column_width = list_name_column_width(preview);
+
+        fmt::memory_buffer buf;
+        format_list_header(buf, *name_column_width);
+        format_list_rows(buf, preview, *name_column_width);
+        preview.Clear();
+
+        return fmt::to_string(buf);
+    }
+
+    std::string rows(const Instances& instances) const
+    {
+        fmt::memory_buffer buf;
+        format_list_rows(buf, instances, *name_column_width);
+
+        return fmt::to_string(buf);
+    }
+
+    Instances preview;
+    std::optional<int> name_column_width;
+};
 } // namespace
+
 std::string mp::TableFormatter::format(const InfoReply& reply) const
 {
     fmt::memory_buffer buf;
@@ -95,6 +189,27 @@ std::string mp::TableFormatter::format(const InfoReply& reply) const
         fmt::format_to(std::back_inserter(buf), "{:<16}{}\n",
                        "Memory usage:", to_usage(info.memory_usage(), info.memory_total()));
 
+        if (!info.network_limit().empty())
+            fmt::format_to(std::back_inserter(buf), "{:<16}{} Mbit/s\n", "Network limit:", info.network_limit());
+        if (!info.disk_iops_limit().empty())
+            fmt::format_to(std::back_inserter(buf), "{:<16}{} IOPS\n", "Disk limit:", info.disk_iops_limit());
+
+        if (info.has_host_stats())
+        {
+            const auto& stats = info.host_stats();
+            fmt::format_to(std::back_inserter(buf), "{:<16}{:.2f}s, {:.2f}s of it stolen\n", "Host CPU time:",
+                           stats.cpu_time_ns() / 1e9, stats.steal_time_ns() / 1e9);
+            const auto balloon =
+                stats.balloon_bytes() ? fmt::format(", balloon at {}", to_human_readable(stats.balloon_bytes())) : "";
+            fmt::format_to(std::back_inserter(buf), "{:<16}{} resident{}\n", "Host memory:",
+                           to_human_readable(stats.rss_bytes()), balloon);
+            fmt::format_to(std::back_inserter(buf), "{:<16}{} read, {} written\n", "Host disk I/O:",
+                           to_human_readable(stats.disk_read_bytes()), to_human_readable(stats.disk_written_bytes()));
+            fmt::format_to(std::back_inserter(buf), "{:<16}{} received, {} sent\n", "Host network:",
+                           to_human_readable(stats.network_received_bytes()),
+                           to_human_readable(stats.network_sent_bytes()));
+        }
+
         auto mount_paths = info.mount_info().mount_paths();
         fmt::format_to(std::back_inserter(buf), "{:<16}{}", "Mounts:", mount_paths.empty() ? "--\n" : "");
 
@@ -133,6 +248,19 @@ std::string mp::TableFormatter::format(const InfoReply& reply) const
                                (std::next(gid_mapping) != mount_maps.gid_mappings().cend()) ? ", " : "",
                                (std::next(gid_mapping) == mount_maps.gid_mappings().cend()) ? "\n" : "");
             }
+
+            if (mount->has_mount_stats())
+            {
+                const auto& stats = mount->mount_stats();
+                fmt::format_to(std::back_inserter(buf), "{:>29}{} read, {} written\n", "I/O: ",
+                               to_human_readable(stats.bytes_read()), to_human_readable(stats.bytes_written()));
+
+                for (auto op = stats.ops().cbegin(); op != stats.ops().cend(); ++op)
+                    fmt::format_to(std::back_inserter(buf), "{:>{}}{} {}{}",
+                                   (op == stats.ops().cbegin()) ? "Requests: " : "",
+                                   (op == stats.ops().cbegin()) ? 29 : 0, op->op(), op->count(),
+                                   (std::next(op) != stats.ops().cend()) ? ", " : "\n");
+            }
         }
 
         fmt::format_to(std::back_inserter(buf), "\n");
@@ -156,31 +284,9 @@ std::string mp::TableFormatter::format(const ListReply& reply) const
     if (instances.empty())
         return "No instances found.\n";
 
-    const auto name_column_width = mp::format::column_width(
-        instances.begin(), instances.end(), [](const auto& instance) -> int { return instance.name().length(); }, 24);
-    const std::string::size_type state_column_width = 18;
-    const std::string::size_type ip_column_width = 17;
-
-    const auto row_format = "{:<{}}{:<{}}{:<{}}{:<}\n";
-    fmt::format_to(std::back_inserter(buf), row_format, "Name", name_column_width, "State", state_column_width, "IPv4",
-                   ip_column_width, "Image");
-
-    for (const auto& instance : format::sorted(reply.instances()))
-    {
-        int ipv4_size = instance.ipv4_size();
-
-        fmt::format_to(std::back_inserter(buf), row_format, instance.name(), name_column_width,
-                       mp::format::status_string_for(instance.instance_status()), state_column_width,
-                       ipv4_size ? instance.ipv4(0) : "--", ip_column_width,
-                       instance.current_release().empty() ? "Not Available"
-                                                          : fmt::format("Ubuntu {}", instance.current_release()));
-
-        for (int i = 1; i < ipv4_size; ++i)
-        {
-            fmt::format_to(std::back_inserter(buf), row_format, "", name_column_width, "", state_column_width,
-                           instance.ipv4(i), instance.ipv4(i).size(), "");
-        }
-    }
+    const auto name_column_width = list_name_column_width(instances);
+    format_list_header(buf, name_column_width);
+    format_list_rows(buf, instances, name_column_width);
 
     return fmt::to_string(buf);
 }
@@ -311,3 +417,8 @@ std::string mp::TableFormatter::format(const mp::AliasDict& aliases) const
 
     return fmt::to_string(buf);
 }
+
+std::unique_ptr<mp::ListFormatStream> mp::TableFormatter::list_stream() const
+{
+    return std::make_unique<TableListStream>();
+}
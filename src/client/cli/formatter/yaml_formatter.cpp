@@ -31,6 +31,50 @@ namespace mpu = multipass::utils;
 
 namespace
 {
+YAML::Node list_to_yaml(const google::protobuf::RepeatedPtrField<mp::ListVMInstance>& instances)
+{
+    YAML::Node list;
+
+    for (const auto& instance : mp::format::sorted(instances))
+    {
+        YAML::Node instance_node;
+        instance_node["state"] = mp::format::status_string_for(instance.instance_status());
+
+        instance_node["ipv4"] = YAML::Node(YAML::NodeType::Sequence);
+        for (const auto& ip : instance.ipv4())
+            instance_node["ipv4"].push_back(ip);
+
+        instance_node["release"] =
+            instance.current_release().empty() ? "Not Available" : fmt::format("Ubuntu {}", instance.current_release());
+
+        list[instance.name()].push_back(instance_node);
+    }
+
+    return list;
+}
+
+// Each chunk is a mapping of its own instances, and one after the other they make up the mapping of them all
+class YamlListStream final : public mp::ListFormatStream
+{
+public:
+    std::string add(const mp::ListReply& chunk) override
+    {
+        if (chunk.instances().empty())
+            return {};
+
+        any_instances = true;
+        return mpu::emit_yaml(list_to_yaml(chunk.instances()));
+    }
+
+    std::string finish() override
+    {
+        return any_instances ? std::string{} : mpu::emit_yaml(YAML::Node{});
+    }
+
+private:
+    bool any_instances = false;
+};
+
 std::map<std::string, YAML::Node>
 format_images(const google::protobuf::RepeatedPtrField<mp::FindReply_ImageInfo>& images_info)
 {
@@ -81,6 +125,25 @@ std::string mp::YamlFormatter::format(const InfoReply& reply) const
         if (!info.cpu_count().empty())
             instance_node["cpu_count"] = info.cpu_count();
 
+        // Only there for instances held to them
+        if (!info.network_limit().empty())
+            instance_node["limits"]["network_mbits"] = info.network_limit();
+        if (!info.disk_iops_limit().empty())
+            instance_node["limits"]["disk_iops"] = info.disk_iops_limit();
+
+        if (info.has_host_stats())
+        {
+            const auto& stats = info.host_stats();
+            instance_node["host_stats"]["cpu_time_ns"] = stats.cpu_time_ns();
+            instance_node["host_stats"]["steal_time_ns"] = stats.steal_time_ns();
+            instance_node["host_stats"]["rss_bytes"] = stats.rss_bytes();
+            instance_node["host_stats"]["balloon_bytes"] = stats.balloon_bytes();
+            instance_node["host_stats"]["disk_read_bytes"] = stats.disk_read_bytes();
+            instance_node["host_stats"]["disk_written_bytes"] = stats.disk_written_bytes();
+            instance_node["host_stats"]["network_received_bytes"] = stats.network_received_bytes();
+            instance_node["host_stats"]["network_sent_bytes"] = stats.network_sent_bytes();
+        }
+
         if (!info.load().empty())
         {
             // The VM returns load info in the default C locale
@@ -144,6 +207,23 @@ std::string mp::YamlFormatter::format(const InfoReply& reply) const
             }
 
             mount_node["source_path"] = mount.source_path();
+
+            if (mount.has_mount_stats())
+            {
+                const auto& stats = mount.mount_stats();
+                YAML::Node stats_node;
+                stats_node["bytes_read"] = stats.bytes_read();
+                stats_node["bytes_written"] = stats.bytes_written();
+                for (const auto& op : stats.ops())
+                {
+                    stats_node["requests"][op.op()]["count"] = op.count();
+                    for (const auto bucket : op.latency_histogram())
+                        stats_node["requests"][op.op()]["latency_histogram"].push_back(bucket);
+                }
+
+                mount_node["stats"] = stats_node;
+            }
+
             mounts[mount.target_path()] = mount_node;
         }
         instance_node["mounts"] = mounts;
@@ -155,24 +235,7 @@ std::string mp::YamlFormatter::format(const InfoReply& reply) const
 
 std::string mp::YamlFormatter::format(const ListReply& reply) const
 {
-    YAML::Node list;
-
-    for (const auto& instance : format::sorted(reply.instances()))
-    {
-        YAML::Node instance_node;
-        instance_node["state"] = mp::format::status_string_for(instance.instance_status());
-
-        instance_node["ipv4"] = YAML::Node(YAML::NodeType::Sequence);
-        for (const auto& ip : instance.ipv4())
-            instance_node["ipv4"].push_back(ip);
-
-        instance_node["release"] =
-            instance.current_release().empty() ? "Not Available" : fmt::format("Ubuntu {}", instance.current_release());
-
-        list[instance.name()].push_back(instance_node);
-    }
-
-    return mpu::emit_yaml(list);
+    return mpu::emit_yaml(list_to_yaml(reply.instances()));
 }
 
 std::string mp::YamlFormatter::format(const NetworksReply& reply) const
@@ -251,3 +314,8 @@ std::string mp::YamlFormatter::format(const mp::AliasDict& aliases) const
 
     return mpu::emit_yaml(aliases_list);
 }
+
+std::unique_ptr<mp::ListFormatStream> mp::YamlFormatter::list_stream() const
+{
+    return std::make_unique<YamlListStream>();
+}
@@ -20,10 +20,13 @@
 #include <multipass/cli/client_common.h>
 #include <multipass/console.h>
 #include <multipass/constants.h>
+#include <multipass/ssh/ssh_control_master.h>
 #include <multipass/top_catch_all.h>
 
 #include <QCoreApplication>
 
+#include <string>
+
 namespace mp = multipass;
 
 namespace
@@ -33,6 +36,10 @@ int main_impl(int argc, char* argv[])
     QCoreApplication app(argc, argv);
     QCoreApplication::setApplicationName(mp::client_name);
 
+    // Started by an earlier exec or shell to hold on to its SSH session, see SSHControlMaster::spawn
+    if (argc == 2 && std::string{argv[1]} == mp::SSHControlMaster::master_argument)
+        return mp::SSHControlMaster::serve(/* its standard input */ 0);
+
     mp::Console::setup_environment();
     auto term = mp::Terminal::make_terminal();
 
@@ -41,7 +48,7 @@ int main_impl(int argc, char* argv[])
     mp::ClientConfig config{mp::client::get_server_address(), mp::client::get_cert_provider(), term.get()};
     mp::Client client{config};
 
-    return client.run(QCoreApplication::arguments());
+    return client.run(mp::client::alias_invocation_arguments(QCoreApplication::arguments(), term.get()));
 }
 } // namespace
 
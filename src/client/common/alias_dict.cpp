@@ -16,6 +16,7 @@
  */
 
 #include <multipass/cli/alias_dict.h>
+#include <multipass/cli/alias_index.h>
 #include <multipass/constants.h>
 #include <multipass/file_ops.h>
 #include <multipass/format.h>
@@ -31,6 +32,8 @@
 #include <QJsonParseError>
 #include <QTemporaryFile>
 
+#include <set>
+
 namespace mp = multipass;
 namespace mpu = multipass::utils;
 
@@ -50,8 +53,16 @@ mp::AliasDict::AliasDict(mp::Terminal* term) : cout(term->cout()), cerr(term->ce
     const auto cli_client_dir_path = QDir{user_config_path.absoluteFilePath(mp::client_name)};
 
     aliases_file = cli_client_dir_path.absoluteFilePath(file_name).toStdString();
+    index_file = aliases_file + ".idx";
+
+    if (const QFileInfo source{QString::fromStdString(aliases_file)}; source.exists())
+        index = AliasIndex::open(QString::fromStdString(index_file), source);
 
-    load_dict();
+    if (!index)
+    {
+        load_dict();
+        save_index();
+    }
 }
 
 mp::AliasDict::~AliasDict()
@@ -71,6 +82,8 @@ mp::AliasDict::~AliasDict()
 
 void mp::AliasDict::set_active_context(const std::string& new_active_context)
 {
+    load();
+
     if (new_active_context != active_context)
     {
         modified = true;
@@ -84,11 +97,13 @@ void mp::AliasDict::set_active_context(const std::string& new_active_context)
 
 std::string mp::AliasDict::active_context_name() const
 {
-    return active_context;
+    return index ? index->active_context() : active_context;
 }
 
 const mp::AliasContext& mp::AliasDict::get_active_context() const
 {
+    load();
+
     try
     {
         return aliases.at(active_context);
@@ -101,6 +116,8 @@ const mp::AliasContext& mp::AliasDict::get_active_context() const
 
 bool mp::AliasDict::add_alias(const std::string& alias, const mp::AliasDefinition& command)
 {
+    load();
+
     if (aliases[active_context].try_emplace(alias, command).second)
     {
         modified = true;
@@ -113,6 +130,8 @@ bool mp::AliasDict::add_alias(const std::string& alias, const mp::AliasDefinitio
 
 bool mp::AliasDict::exists_alias(const std::string& alias) const
 {
+    load();
+
     for (const auto& [_, context_dict] : aliases)
     {
         if (context_dict.find(alias) != context_dict.cend())
@@ -131,6 +150,8 @@ bool mp::AliasDict::is_alias_unique(const std::string& alias) const
 
 bool mp::AliasDict::remove_alias(const std::string& alias)
 {
+    load();
+
     if (aliases[active_context].erase(alias) > 0)
     {
         modified = true;
@@ -142,6 +163,8 @@ bool mp::AliasDict::remove_alias(const std::string& alias)
 
 bool mp::AliasDict::remove_context(const std::string& context)
 {
+    load();
+
     if (aliases.erase(context) > 0)
     {
         modified = true;
@@ -192,6 +215,8 @@ std::vector<mp::ContextAliasPair> mp::AliasDict::remove_aliases_for_instance(con
 // (ii): returns <context name, alias name> if the alias exists in the given context; std::nullopt otherwise.
 std::optional<mp::ContextAliasPair> mp::AliasDict::get_context_and_alias(const std::string& alias) const
 {
+    load();
+
     // This will never throw because we already checked that the active context exists.
     if (aliases.at(active_context).count(alias) > 0)
         return std::make_pair(active_context, alias);
@@ -214,6 +239,8 @@ std::optional<mp::ContextAliasPair> mp::AliasDict::get_context_and_alias(const s
 
 std::optional<mp::AliasDefinition> mp::AliasDict::get_alias_from_current_context(const std::string& alias) const
 {
+    load();
+
     try
     {
         return aliases.at(active_context).at(alias);
@@ -231,6 +258,9 @@ std::optional<mp::AliasDefinition> mp::AliasDict::get_alias_from_current_context
 // The given alias can be fully qualified or not.
 std::optional<mp::AliasDefinition> mp::AliasDict::get_alias(const std::string& alias) const
 {
+    if (index)
+        return index->find(alias);
+
     std::optional<mp::AliasDefinition> alias_in_current_context = get_alias_from_current_context(alias);
 
     if (alias_in_current_context)
@@ -266,6 +296,8 @@ std::optional<mp::AliasDefinition> mp::AliasDict::get_alias(const std::string& a
 
 QJsonObject mp::AliasDict::to_json() const
 {
+    load();
+
     auto alias_to_json = [](const mp::AliasDefinition& alias) -> QJsonObject {
         QJsonObject json;
 
@@ -298,7 +330,16 @@ QJsonObject mp::AliasDict::to_json() const
     return dict_json;
 }
 
-void mp::AliasDict::load_dict()
+void mp::AliasDict::load() const
+{
+    if (index)
+    {
+        index.reset();
+        load_dict();
+    }
+}
+
+void mp::AliasDict::load_dict() const
 {
     QFile db_file{QString::fromStdString(aliases_file)};
 
@@ -424,7 +465,35 @@ void mp::AliasDict::save_dict()
 
         if (!MP_FILEOPS.rename(temp_file, config_file_name))
             throw std::runtime_error(fmt::format("cannot create aliases config file {}", config_file_name));
+
+        save_index();
+    }
+}
+
+// The index is written with the answers get_alias gives for whatever an alias can be invoked as. It is only a
+// shortcut, when it cannot be written the aliases file is parsed instead.
+void mp::AliasDict::save_index() const
+{
+    const QFileInfo source{QString::fromStdString(aliases_file)};
+    if (!source.exists())
+        return;
+
+    std::set<std::string> keys;
+    for (const auto& [context_name, context_contents] : aliases)
+    {
+        for (const auto& [alias_name, _] : context_contents)
+        {
+            keys.insert(alias_name);
+            keys.insert(context_name + "." + alias_name);
+        }
     }
+
+    AliasIndex::Entries entries;
+    for (const auto& key : keys)
+        if (auto definition = get_alias(key))
+            entries.emplace_back(key, *definition);
+
+    AliasIndex::write(QString::fromStdString(index_file), source, active_context, entries);
 }
 
 // This function removes the contexts which do not contain aliases, except the active context.
@@ -456,6 +525,8 @@ void mp::AliasDict::sanitize_contexts()
 // be fully qualified, that is, it must not be prepended by a context name.
 std::optional<mp::AliasDefinition> mp::AliasDict::get_alias_from_all_contexts(const std::string& alias) const
 {
+    load();
+
     const AliasDefinition* ret;
     bool found{false};
 
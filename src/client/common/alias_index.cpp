@@ -0,0 +1,206 @@
+/*
+ * Copyright (C) Canonical, Ltd.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; version 3.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#include <multipass/cli/alias_index.h>
+
+#include <QDateTime>
+#include <QSaveFile>
+
+#include <cstring>
+#include <limits>
+
+namespace mp = multipass;
+
+namespace
+{
+constexpr char magic[8] = {'M', 'P', 'A', 'L', 'I', 'A', 'S', '1'};
+
+// In the byte order of the machine, the index is never shared with another
+struct Header
+{
+    char magic[8];
+    quint64 source_size;
+    qint64 source_mtime; // in milliseconds since the epoch
+    quint32 bucket_count;
+    quint32 active_context; // offset of the active context's name
+};
+static_assert(sizeof(Header) == 32);
+
+// Buckets follow the header, each the offset of an entry or 0 when empty. Entries are the hash of the key, then the
+// key, instance, command and working directory, as a 32-bit length followed by the characters.
+constexpr qint64 buckets_offset = sizeof(Header);
+
+quint32 hash_of(std::string_view key) // FNV-1a
+{
+    quint32 hash = 2166136261u;
+    for (const auto c : key)
+    {
+        hash ^= static_cast<unsigned char>(c);
+        hash *= 16777619u;
+    }
+
+    return hash;
+}
+
+template <typename T>
+void append(QByteArray& out, const T& value)
+{
+    out.append(reinterpret_cast<const char*>(&value), sizeof(value));
+}
+
+void append_string(QByteArray& out, const std::string& value)
+{
+    append(out, static_cast<quint32>(value.size()));
+    out.append(value.data(), static_cast<int>(value.size()));
+}
+} // namespace
+
+mp::AliasIndex::AliasIndex(const QString& path) : file{path}
+{
+}
+
+std::unique_ptr<mp::AliasIndex> mp::AliasIndex::open(const QString& path, const QFileInfo& source)
+{
+    std::unique_ptr<AliasIndex> index{new AliasIndex{path}};
+    if (!index->file.open(QIODevice::ReadOnly))
+        return nullptr;
+
+    index->size = index->file.size();
+    if (index->size < buckets_offset || !(index->data = index->file.map(0, index->size)))
+        return nullptr;
+
+    Header header;
+    std::memcpy(&header, index->data, sizeof(header));
+
+    std::string_view active_context;
+    qint64 active_context_pos = header.active_context;
+    if (std::memcmp(header.magic, magic, sizeof(magic)) != 0 ||
+        header.source_size != static_cast<quint64>(source.size()) ||
+        header.source_mtime != source.lastModified().toMSecsSinceEpoch() || header.bucket_count == 0 ||
+        buckets_offset + header.bucket_count * qint64{sizeof(quint32)} > index->size ||
+        !index->read_string(active_context_pos, active_context))
+        return nullptr;
+
+    index->bucket_count = header.bucket_count;
+    index->active = active_context;
+
+    return index;
+}
+
+bool mp::AliasIndex::write(const QString& path, const QFileInfo& source, const std::string& active_context,
+                           const Entries& entries)
+{
+    // At most half full, for short probe sequences
+    quint32 bucket_count = 8;
+    while (bucket_count < 2 * entries.size())
+        bucket_count *= 2;
+
+    QByteArray out(buckets_offset + bucket_count * sizeof(quint32), '\0');
+
+    Header header{};
+    std::memcpy(header.magic, magic, sizeof(magic));
+    header.source_size = source.size();
+    header.source_mtime = source.lastModified().toMSecsSinceEpoch();
+    header.bucket_count = bucket_count;
+    header.active_context = out.size();
+    std::memcpy(out.data(), &header, sizeof(header));
+
+    append_string(out, active_context);
+
+    auto bucket_at = [&out](quint32 bucket) { return out.data() + buckets_offset + bucket * sizeof(quint32); };
+    auto taken = [&bucket_at](quint32 bucket) {
+        quint32 offset;
+        std::memcpy(&offset, bucket_at(bucket), sizeof(offset));
+        return offset != 0;
+    };
+
+    for (const auto& [key, definition] : entries)
+    {
+        const auto hash = hash_of(key);
+
+        auto bucket = hash % bucket_count;
+        while (taken(bucket))
+            bucket = (bucket + 1) % bucket_count;
+
+        const quint32 offset = out.size();
+        std::memcpy(bucket_at(bucket), &offset, sizeof(offset));
+
+        append(out, hash);
+        append_string(out, key);
+        append_string(out, definition.instance);
+        append_string(out, definition.command);
+        append_string(out, definition.working_directory);
+    }
+
+    if (out.size() > std::numeric_limits<quint32>::max())
+        return false;
+
+    QSaveFile file{path};
+    return file.open(QIODevice::WriteOnly) && file.write(out) == out.size() && file.commit();
+}
+
+const std::string& mp::AliasIndex::active_context() const
+{
+    return active;
+}
+
+std::optional<mp::AliasDefinition> mp::AliasIndex::find(const std::string& key) const
+{
+    const auto hash = hash_of(key);
+
+    auto bucket = hash % bucket_count;
+    for (quint32 probe = 0; probe < bucket_count; ++probe, bucket = (bucket + 1) % bucket_count)
+    {
+        quint32 offset, entry_hash;
+        if (!read(buckets_offset + bucket * qint64{sizeof(quint32)}, offset) || offset == 0 ||
+            !read(offset, entry_hash))
+            return std::nullopt;
+
+        qint64 pos = offset + qint64{sizeof(entry_hash)};
+        std::string_view entry_key, instance, command, working_directory;
+        if (entry_hash != hash || !read_string(pos, entry_key) || entry_key != key)
+            continue;
+
+        if (!read_string(pos, instance) || !read_string(pos, command) || !read_string(pos, working_directory))
+            return std::nullopt;
+
+        return AliasDefinition{std::string{instance}, std::string{command}, std::string{working_directory}};
+    }
+
+    return std::nullopt;
+}
+
+template <typename T>
+bool mp::AliasIndex::read(qint64 pos, T& value) const
+{
+    if (pos < 0 || pos + qint64{sizeof(T)} > size)
+        return false;
+
+    std::memcpy(&value, data + pos, sizeof(T));
+    return true;
+}
+
+bool mp::AliasIndex::read_string(qint64& pos, std::string_view& value) const
+{
+    quint32 length;
+    if (!read(pos, length) || pos + qint64{sizeof(length)} + length > size)
+        return false;
+
+    value = std::string_view{reinterpret_cast<const char*>(data) + pos + sizeof(length), length};
+    pos += sizeof(length) + length;
+    return true;
+}
@@ -15,6 +15,7 @@
  *
  */
 
+#include <multipass/cli/alias_dict.h>
 #include <multipass/cli/client_common.h>
 #include <multipass/constants.h>
 #include <multipass/exceptions/autostart_setup_exception.h>
@@ -33,6 +34,9 @@
 
 #include <fmt/ostream.h>
 
+#include <grpc/grpc_security.h>
+
+#include <QFileInfo>
 #include <QKeySequence>
 
 namespace mp = multipass;
@@ -42,6 +46,10 @@ namespace
 {
 const auto client_root = QStringLiteral("client");
 const auto autostart_default = QStringLiteral("true");
+const auto rpc_compression_default = QStringLiteral("true");
+const auto rpc_keepalive_default = QStringLiteral("60");
+constexpr auto rpc_keepalive_timeout_ms = 20000;
+constexpr auto tls_session_cache_capacity = 8;
 
 QString default_hotkey()
 {
@@ -56,6 +64,26 @@ QString petenv_interpreter(QString val)
     return val;
 }
 
+QString ssh_control_persist_interpreter(QString val)
+{
+    bool ok;
+    const auto seconds = val.toInt(&ok);
+    if (!ok || seconds < 0)
+        throw mp::InvalidSettingException{mp::ssh_control_persist_key, val, "Expected a non-negative number"};
+
+    return QString::number(seconds);
+}
+
+QString rpc_keepalive_interpreter(QString val)
+{
+    bool ok;
+    const auto seconds = val.toInt(&ok);
+    if (!ok || seconds < 0)
+        throw mp::InvalidSettingException{mp::rpc_keepalive_key, val, "Expected a non-negative number"};
+
+    return QString::number(seconds);
+}
+
 mp::ReturnCode return_code_for(const grpc::StatusCode& code)
 {
     return code == grpc::StatusCode::UNAVAILABLE ? mp::ReturnCode::DaemonFail : mp::ReturnCode::CommandFail;
@@ -78,6 +106,50 @@ std::string message_box(const std::string& message)
     return '\n' + divider + '\n' + message + '\n' + divider + '\n';
 }
 
+// Channels can be made before the client settings are registered
+QString client_setting(const QString& key, const QString& fallback)
+{
+    try
+    {
+        return MP_SETTINGS.get(key);
+    }
+    catch (const mp::UnrecognizedSettingException&)
+    {
+        return fallback;
+    }
+}
+
+grpc::ChannelArguments channel_arguments()
+{
+    grpc::ChannelArguments args;
+
+    // Pings keep idle connections from being dropped on the way, so that the next call does not have to reconnect
+    if (const auto keepalive = client_setting(mp::rpc_keepalive_key, rpc_keepalive_default).toInt(); keepalive > 0)
+    {
+        args.SetInt(GRPC_ARG_KEEPALIVE_TIME_MS, keepalive * 1000);
+        args.SetInt(GRPC_ARG_KEEPALIVE_TIMEOUT_MS, rpc_keepalive_timeout_ms);
+        args.SetInt(GRPC_ARG_KEEPALIVE_PERMIT_WITHOUT_CALLS, 1);
+        args.SetInt(GRPC_ARG_HTTP2_MAX_PINGS_WITHOUT_DATA, 0);
+    }
+
+    // The daemon only compresses what the client says it accepts
+    if (client_setting(mp::rpc_compression_key, rpc_compression_default) != "true")
+        args.SetInt(GRPC_COMPRESSION_CHANNEL_ENABLED_ALGORITHMS_BITSET, 1 << GRPC_COMPRESS_NONE);
+
+    // Shared by every channel in the process, so reconnecting resumes the TLS session rather than redoing it all
+    static const auto session_cache = grpc_ssl_session_cache_create_lru(tls_session_cache_capacity);
+    const auto cache_arg = grpc_ssl_session_cache_create_channel_arg(session_cache);
+    args.SetPointerWithVtable(cache_arg.key, cache_arg.value.pointer.p, cache_arg.value.pointer.vtable);
+
+    return args;
+}
+
+std::shared_ptr<grpc::Channel> create_channel(const std::string& server_address,
+                                              const std::shared_ptr<grpc::ChannelCredentials>& credentials)
+{
+    return grpc::CreateCustomChannel(server_address, credentials, channel_arguments());
+}
+
 grpc::SslCredentialsOptions get_ssl_credentials_opts_from(const QString& cert_dir_path)
 {
     mp::SSLCertProvider cert_provider{cert_dir_path};
@@ -93,7 +165,7 @@ grpc::SslCredentialsOptions get_ssl_credentials_opts_from(const QString& cert_di
 std::shared_ptr<grpc::Channel> create_channel_and_validate(const std::string& server_address,
                                                            const grpc::SslCredentialsOptions& opts)
 {
-    auto rpc_channel{grpc::CreateChannel(server_address, grpc::SslCredentials(opts))};
+    auto rpc_channel{create_channel(server_address, grpc::SslCredentials(opts))};
     mp::Rpc::Stub stub{rpc_channel};
 
     grpc::ClientContext context;
@@ -124,6 +196,34 @@ std::shared_ptr<grpc::Channel> create_channel_and_validate(const std::string& se
     }
 }
 
+QString session_file_path()
+{
+    const auto data_location{MP_STDPATHS.writableLocation(mp::StandardPaths::GenericDataLocation)};
+    return QDir{data_location + mp::common_client_cert_dir}.filePath(mp::client_session_file);
+}
+
+// Over the local socket, with a token from an earlier connection through TLS, when the daemon still takes it
+std::shared_ptr<grpc::Channel> create_session_channel(const std::string& server_address)
+{
+    const auto local_address = mp::utils::local_server_address(server_address);
+    QFile session_file{session_file_path()};
+    if (local_address.empty() || !session_file.open(QIODevice::ReadOnly))
+        return nullptr;
+
+    const auto token = session_file.readAll().trimmed().toStdString();
+    auto credentials = grpc::CompositeChannelCredentials(grpc::experimental::LocalCredentials(LOCAL_UDS),
+                                                         grpc::AccessTokenCredentials(token));
+    auto rpc_channel{create_channel(local_address, credentials)};
+    mp::Rpc::Stub stub{rpc_channel};
+
+    grpc::ClientContext context;
+    context.set_deadline(std::chrono::system_clock::now() + std::chrono::milliseconds(100));
+
+    mp::PingRequest request;
+    mp::PingReply reply;
+    return stub.ping(&context, request, &reply).ok() ? rpc_channel : nullptr;
+}
+
 bool client_certs_exist(const QString& cert_dir_path)
 {
     QDir cert_dir{cert_dir_path};
@@ -185,6 +285,11 @@ void mp::client::register_global_settings_handlers()
     settings.insert(std::make_unique<CustomSettingSpec>(mp::hotkey_key, default_hotkey(), [](QString val) {
         return mp::platform::interpret_setting(mp::hotkey_key, val);
     }));
+    settings.insert(
+        std::make_unique<CustomSettingSpec>(mp::ssh_control_persist_key, "0", ssh_control_persist_interpreter));
+    settings.insert(std::make_unique<BoolSettingSpec>(rpc_compression_key, rpc_compression_default));
+    settings.insert(
+        std::make_unique<CustomSettingSpec>(mp::rpc_keepalive_key, rpc_keepalive_default, rpc_keepalive_interpreter));
 
     MP_SETTINGS.register_handler(
         std::make_unique<PersistentSettingsHandler>(persistent_settings_filename(), std::move(settings)));
@@ -226,16 +331,53 @@ std::shared_ptr<grpc::Channel> mp::client::make_channel(const std::string& serve
         mp::utils::remove_directories(cert_dirs);
         MP_UTILS.make_dir(common_client_cert_dir_path);
 
-        return grpc::CreateChannel(server_address,
-                                   grpc::SslCredentials(get_ssl_credentials_opts_from(common_client_cert_dir_path)));
+        return create_channel(server_address,
+                              grpc::SslCredentials(get_ssl_credentials_opts_from(common_client_cert_dir_path)));
     }
 
+    if (auto rpc_channel{create_session_channel(server_address)})
+        return rpc_channel;
+
     auto opts = grpc::SslCredentialsOptions();
     opts.server_certificate_request = GRPC_SSL_REQUEST_SERVER_CERTIFICATE_BUT_DONT_VERIFY;
     opts.pem_cert_chain = cert_provider->PEM_certificate();
     opts.pem_private_key = cert_provider->PEM_signing_key();
 
-    return grpc::CreateChannel(server_address, grpc::SslCredentials(opts));
+    return create_channel(server_address, grpc::SslCredentials(opts));
+}
+
+void mp::client::keep_session(const grpc::ClientContext& context)
+{
+    const auto& metadata = context.GetServerInitialMetadata();
+    const auto it = metadata.find(mp::session_metadata_key);
+    if (it == metadata.end())
+        return;
+
+    const QByteArray token{it->second.data(), static_cast<int>(it->second.size())};
+    QFile session_file{session_file_path()};
+    if (session_file.open(QIODevice::ReadOnly) && session_file.readAll() == token)
+        return;
+    session_file.close();
+
+    // Only readable by whoever it was handed to, it's as good as their key for as long as the daemon runs
+    if (session_file.open(QIODevice::WriteOnly | QIODevice::Truncate) &&
+        session_file.setPermissions(QFile::ReadOwner | QFile::WriteOwner))
+        session_file.write(token);
+}
+
+// Alias links point at the client, and are named after the alias to run. Other links and wrappers can give the client
+// any name, so only the names of aliases there are count.
+QStringList mp::client::alias_invocation_arguments(const QStringList& arguments, Terminal* term)
+{
+    const auto invoked_as = arguments.isEmpty() ? QString{} : QFileInfo{arguments.first()}.fileName();
+    if (invoked_as.isEmpty() || invoked_as == mp::client_name ||
+        invoked_as == QStringLiteral("%1.exe").arg(mp::client_name))
+        return arguments;
+
+    if (!AliasDict{term}.get_alias(invoked_as.toStdString()))
+        return arguments;
+
+    return QStringList{mp::client_name, invoked_as, "--"} + arguments.mid(1);
 }
 
 std::string mp::client::get_server_address()
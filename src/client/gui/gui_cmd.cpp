@@ -30,6 +30,7 @@
 #include <QDesktopServices>
 #include <QLockFile>
 #include <QStyle>
+#include <QTimer>
 #include <QtConcurrent/QtConcurrent>
 
 namespace mp = multipass;
@@ -158,8 +159,11 @@ void cmd::GuiCmd::create_actions()
     mp::utils::check_and_create_config_file(client_config_path);
     config_watcher.addPath(client_config_path);
     QObject::connect(&config_watcher, &QFileSystemWatcher::fileChanged, this, [this](const QString& path) {
-        update_hotkey();
-        autostart_option.setChecked(MP_SETTINGS.get_as<bool>(autostart_key));
+        // Once the settings handler has heard of the change too, it keeps what it read until then
+        QTimer::singleShot(0, this, [this] {
+            update_hotkey();
+            autostart_option.setChecked(MP_SETTINGS.get_as<bool>(autostart_key));
+        });
 
         // Needed since the original watched file may be removed and opened as a new file
         if (!config_watcher.files().contains(path) && QFile::exists(path))
@@ -372,6 +376,8 @@ mp::ListReply cmd::GuiCmd::retrieve_all_instances()
 
     ListRequest request;
     request.set_request_ipv4(false);
+    request.add_fields("name");
+    request.add_fields("instance_status");
     dispatch(&RpcMethod::list, request, on_success, on_failure);
 
     return list_reply;
@@ -26,6 +26,42 @@ constexpr auto base_cloud_init_config = "growpart:\n"
                                         "users:\n"
                                         "    - default\n"
                                         "manage_etc_hosts: true\n";
+
+// Opens the readiness port, on every boot once cloud-init is done, so that the host need not keep polling
+constexpr auto readiness_service_path = "/etc/systemd/system/multipass-ready.service";
+constexpr auto readiness_service = "[Unit]\n"
+                                   "Description=Tell Multipass that the instance is ready\n"
+                                   "After=cloud-final.service ssh.service\n"
+                                   "ConditionPathExists=/dev/virtio-ports/{0}\n"
+                                   "\n"
+                                   "[Service]\n"
+                                   "Type=oneshot\n"
+                                   "ExecStart=/bin/sh -c 'echo ready > /dev/virtio-ports/{0}'\n"
+                                   "\n"
+                                   "[Install]\n"
+                                   "WantedBy=cloud-init.target\n";
+
+// Lets the host reach sshd over vsock in guests that have a vsock device, sparing SSH the network on both ends
+constexpr auto vsock_ssh_socket_path = "/etc/systemd/system/multipass-ssh-vsock.socket";
+constexpr auto vsock_ssh_socket = "[Unit]\n"
+                                  "Description=SSH over vsock for Multipass\n"
+                                  "ConditionPathExists=/dev/vsock\n"
+                                  "\n"
+                                  "[Socket]\n"
+                                  "ListenStream=vsock::{0}\n"
+                                  "Accept=yes\n"
+                                  "\n"
+                                  "[Install]\n"
+                                  "WantedBy=sockets.target\n";
+constexpr auto vsock_ssh_service_path = "/etc/systemd/system/multipass-ssh-vsock@.service";
+constexpr auto vsock_ssh_service = "[Unit]\n"
+                                   "Description=SSH over vsock for Multipass, per connection\n"
+                                   "\n"
+                                   "[Service]\n"
+                                   "ExecStart=-/usr/sbin/sshd -i\n"
+                                   "StandardInput=socket\n"
+                                   "RuntimeDirectory=sshd\n"
+                                   "RuntimeDirectoryPreserve=yes\n";
 }
 
 #endif // MULTIPASS_BASE_CLOUD_INIT_CONFIG_H
@@ -25,20 +25,34 @@
 #include <multipass/exceptions/unsupported_alias_exception.h>
 #include <multipass/exceptions/unsupported_remote_exception.h>
 
+#include <QDateTime>
+#include <QFile>
+#include <QFileInfo>
+
 namespace mp = multipass;
 namespace mpl = multipass::logging;
 
 namespace
 {
 constexpr auto category = "VMImageHost";
+constexpr auto recent_usage = std::chrono::hours{24 * 30};
+
+bool used_lately(const QString& usage_stamp)
+{
+    const QFileInfo stamp{usage_stamp};
+    return stamp.exists() &&
+           stamp.lastModified() > QDateTime::currentDateTime().addSecs(-std::chrono::seconds{recent_usage}.count());
 }
+} // namespace
 
-mp::CommonVMImageHost::CommonVMImageHost(std::chrono::seconds manifest_time_to_live)
-  : manifest_time_to_live{manifest_time_to_live}, last_update{}
+mp::CommonVMImageHost::CommonVMImageHost(std::chrono::seconds manifest_time_to_live, const QString& usage_stamp)
+  : manifest_time_to_live{manifest_time_to_live}, last_update{}, usage_stamp{usage_stamp}
 {
     // careful: the functor below relies on polymorphic behavior, which is not available in constructors
     // fine here as the call is deferred to after the constructor is done (independently of connection type)
     QObject::connect(&manifest_single_shot, &QTimer::timeout, [this]() {
+        std::lock_guard lock{manifests_mutex};
+        fetching_ahead = true;
         try
         {
             update_manifests();
@@ -47,14 +61,19 @@ mp::CommonVMImageHost::CommonVMImageHost(std::chrono::seconds manifest_time_to_l
         {
             mpl::log(mpl::Level::error, category, e.what());
         }
+        fetching_ahead = false;
     });
 
     manifest_single_shot.setSingleShot(true);
-    manifest_single_shot.start(0);
+    if (usage_stamp.isEmpty() || used_lately(usage_stamp))
+        manifest_single_shot.start(0);
+    else
+        mpl::log(mpl::Level::debug, category, "Not fetching manifests until they are needed");
 }
 
 void mp::CommonVMImageHost::for_each_entry_do(const Action& action)
 {
+    std::lock_guard lock{manifests_mutex};
     update_manifests();
 
     for_each_entry_do_impl(action);
@@ -62,6 +81,7 @@ void mp::CommonVMImageHost::for_each_entry_do(const Action& action)
 
 auto mp::CommonVMImageHost::info_for_full_hash(const std::string& full_hash) -> VMImageInfo
 {
+    std::lock_guard lock{manifests_mutex};
     update_manifests();
 
     return info_for_full_hash_impl(full_hash);
@@ -69,18 +89,32 @@ auto mp::CommonVMImageHost::info_for_full_hash(const std::string& full_hash) ->
 
 void mp::CommonVMImageHost::update_manifests()
 {
+    std::lock_guard lock{manifests_mutex};
+    if (!fetching_ahead)
+        stamp_usage();
+
     const auto now = std::chrono::steady_clock::now();
     if ((now - last_update) > manifest_time_to_live || need_extra_update)
     {
         need_extra_update = false;
 
-        clear();
+        // Manifests are replaced as fresh ones come in, the stale ones keep serving until then
         fetch_manifests();
 
         last_update = now;
     }
 }
 
+void mp::CommonVMImageHost::stamp_usage()
+{
+    if (usage_stamp.isEmpty() || usage_stamped)
+        return;
+
+    QFile stamp{usage_stamp};
+    usage_stamped = stamp.open(QIODevice::WriteOnly | QIODevice::Truncate) &&
+                    stamp.write(QDateTime::currentDateTimeUtc().toString(Qt::ISODate).toUtf8()) >= 0;
+}
+
 void mp::CommonVMImageHost::on_manifest_empty(const std::string& details)
 {
     mpl::log(mpl::Level::info, category, details);
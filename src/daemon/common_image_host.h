@@ -20,10 +20,12 @@
 
 #include "multipass/vm_image_host.h"
 
+#include <QString>
 #include <QStringList>
 #include <QTimer>
 
 #include <chrono>
+#include <mutex>
 
 namespace multipass
 {
@@ -31,7 +33,9 @@ namespace multipass
 class CommonVMImageHost : public VMImageHost
 {
 public:
-    CommonVMImageHost(std::chrono::seconds manifest_time_to_live);
+    // With a usage stamp, manifests are only fetched once they are asked for, or right away when the stamp says the
+    // host was used lately. The stamp is renewed when the host is used.
+    CommonVMImageHost(std::chrono::seconds manifest_time_to_live, const QString& usage_stamp = {});
     void for_each_entry_do(const Action& action) final;
     VMImageInfo info_for_full_hash(const std::string& full_hash) final;
 
@@ -45,14 +49,22 @@ protected:
 
     virtual void for_each_entry_do_impl(const Action& action) = 0;
     virtual VMImageInfo info_for_full_hash_impl(const std::string& full_hash) = 0;
-    virtual void clear() = 0;
     virtual void fetch_manifests() = 0;
 
+    // Held by whatever reads or replaces the manifests, for requests are answered on threads other than the daemon's.
+    // Recursive, as what holds it may well update the manifests first.
+    mutable std::recursive_mutex manifests_mutex;
+
 private:
+    void stamp_usage();
+
     std::chrono::seconds manifest_time_to_live;
     std::chrono::steady_clock::time_point last_update;
     bool need_extra_update = true;
     QTimer manifest_single_shot;
+    const QString usage_stamp;
+    bool fetching_ahead = false;
+    bool usage_stamped = false;
 };
 
 }
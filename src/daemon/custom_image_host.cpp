@@ -25,23 +25,26 @@
 #include <multipass/exceptions/unsupported_remote_exception.h>
 
 #include <multipass/format.h>
+#include <multipass/logging/log.h>
 
+#include <QDir>
+#include <QFile>
+#include <QJsonDocument>
+#include <QJsonObject>
 #include <QMap>
 #include <QUrl>
 
+#include <future>
 #include <utility>
 
 namespace mp = multipass;
+namespace mpl = multipass::logging;
 
 namespace
 {
 constexpr auto no_remote = "";
-
-struct BaseImageInfo
-{
-    const QString last_modified;
-    const QString hash;
-};
+constexpr auto category = "custom image host";
+constexpr auto metadata_file_name = "custom-images.json";
 
 struct CustomImageInfo
 {
@@ -67,23 +70,81 @@ const QMap<QString, QMap<QString, CustomImageInfo>> multipass_image_info{
       {{"ubuntu-core-22-amd64.img.xz"},
        {"https://cdimage.ubuntu.com/ubuntu-core/22/stable/current/", {"core22"}, "Ubuntu", "core-22", "Core 22"}}}}};
 
-auto base_image_info_for(mp::URLDownloader* url_downloader, const QString& image_url, const QString& hash_url,
-                         const QString& image_file)
+QMap<QString, mp::CustomImageMetadata> load_image_metadata(const QString& cache_dir)
 {
-    const auto last_modified = QLocale::c().toString(url_downloader->last_modified({image_url}), "yyyyMMdd");
-    const auto sha256_sums = url_downloader->download({hash_url}).split('\n');
-    QString hash;
+    QMap<QString, mp::CustomImageMetadata> metadata;
+    QFile file{QDir{cache_dir}.filePath(metadata_file_name)};
+    if (cache_dir.isEmpty() || !file.open(QIODevice::ReadOnly))
+        return metadata;
+
+    const auto images = QJsonDocument::fromJson(file.readAll()).object();
+    for (auto it = images.begin(); it != images.end(); ++it)
+    {
+        const auto image = it.value().toObject();
+        metadata[it.key()] = {image["version"].toString(),
+                              image["hash"].toString(),
+                              {image["etag"].toString().toUtf8(), image["last_modified"].toString().toUtf8()}};
+    }
+
+    return metadata;
+}
+
+void save_image_metadata(const QString& cache_dir, const QMap<QString, mp::CustomImageMetadata>& metadata)
+{
+    QFile file{QDir{cache_dir}.filePath(metadata_file_name)};
+    if (cache_dir.isEmpty() || !file.open(QIODevice::WriteOnly | QIODevice::Truncate))
+        return;
+
+    QJsonObject images;
+    for (auto it = metadata.cbegin(); it != metadata.cend(); ++it)
+        images.insert(it.key(), QJsonObject{{"version", it->last_modified},
+                                            {"hash", it->hash},
+                                            {"etag", QString::fromUtf8(it->validators.etag)},
+                                            {"last_modified", QString::fromUtf8(it->validators.last_modified)}});
+
+    file.write(QJsonDocument{images}.toJson());
+}
+
+// The sums are asked for conditionally, an image whose sums did not change keeps what was known about it, without
+// asking for its last modification again. What was known also stands in when the server cannot be reached.
+mp::CustomImageMetadata base_image_info_for(mp::URLDownloader* url_downloader, const QString& image_url,
+                                            const QString& hash_url, const QString& image_file,
+                                            const mp::CustomImageMetadata& known)
+try
+{
+    const auto conditional =
+        !known.hash.isEmpty() && (!known.validators.etag.isEmpty() || !known.validators.last_modified.isEmpty());
+    auto validators = conditional ? known.validators : mp::URLDownloader::Validators{};
+
+    auto sha256_sums = url_downloader->download_if_changed({hash_url}, validators);
+    if (!sha256_sums && conditional)
+        return known;
+    if (!sha256_sums)
+        sha256_sums = url_downloader->download({hash_url});
+
+    mp::CustomImageMetadata metadata{QLocale::c().toString(url_downloader->last_modified({image_url}), "yyyyMMdd"),
+                                     {},
+                                     validators};
 
-    for (const QString line : sha256_sums) // intentional copy
+    for (const QString line : sha256_sums->split('\n')) // intentional copy
     {
         if (line.trimmed().endsWith(image_file))
         {
-            hash = line.split(' ').first();
+            metadata.hash = line.split(' ').first();
             break;
         }
     }
 
-    return BaseImageInfo{last_modified, hash};
+    return metadata;
+}
+catch (const mp::DownloadException& e)
+{
+    if (known.hash.isEmpty())
+        throw;
+
+    mpl::log(mpl::Level::warning, category,
+             fmt::format("Error getting metadata for {}: {} - using what was known.", image_url, e.what()));
+    return known;
 }
 
 auto map_aliases_to_vm_info_for(const std::vector<mp::VMImageInfo>& images)
@@ -101,17 +162,27 @@ auto map_aliases_to_vm_info_for(const std::vector<mp::VMImageInfo>& images)
     return map;
 }
 
-auto full_image_info_for(const QMap<QString, CustomImageInfo>& custom_image_info, mp::URLDownloader* url_downloader)
+auto full_image_info_for(const QMap<QString, CustomImageInfo>& custom_image_info, mp::URLDownloader* url_downloader,
+                         QMap<QString, mp::CustomImageMetadata>& image_metadata)
 {
-    std::vector<mp::VMImageInfo> default_images;
-
+    // Every image's metadata is looked up side by side
+    std::vector<std::future<mp::CustomImageMetadata>> lookups;
     for (const auto& image_info : custom_image_info.toStdMap())
     {
-        auto image_file = image_info.first;
         QString image_url{image_info.second.url_prefix + image_info.first};
         QString hash_url{image_info.second.url_prefix + QStringLiteral("SHA256SUMS")};
 
-        auto base_image_info = base_image_info_for(url_downloader, image_url, hash_url, image_file);
+        lookups.push_back(std::async(std::launch::async, base_image_info_for, url_downloader, image_url, hash_url,
+                                     image_info.first, image_metadata.value(image_url)));
+    }
+
+    std::vector<mp::VMImageInfo> default_images;
+    auto lookup = lookups.begin();
+    for (const auto& image_info : custom_image_info.toStdMap())
+    {
+        QString image_url{image_info.second.url_prefix + image_info.first};
+
+        auto base_image_info = image_metadata[image_url] = (lookup++)->get();
         mp::VMImageInfo full_image_info{image_info.second.aliases,
                                         image_info.second.os,
                                         image_info.second.release,
@@ -135,17 +206,21 @@ auto full_image_info_for(const QMap<QString, CustomImageInfo>& custom_image_info
 } // namespace
 
 mp::CustomVMImageHost::CustomVMImageHost(const QString& arch, URLDownloader* downloader,
-                                         std::chrono::seconds manifest_time_to_live)
-    : CommonVMImageHost{manifest_time_to_live},
+                                         std::chrono::seconds manifest_time_to_live, const QString& cache_dir,
+                                         const QString& usage_stamp)
+    : CommonVMImageHost{manifest_time_to_live, usage_stamp},
       arch{arch},
       url_downloader{downloader},
       custom_image_info{},
-      remotes{no_remote}
+      remotes{no_remote},
+      cache_dir{cache_dir},
+      image_metadata{load_image_metadata(cache_dir)}
 {
 }
 
 std::optional<mp::VMImageInfo> mp::CustomVMImageHost::info_for(const Query& query)
 {
+    std::lock_guard lock{manifests_mutex};
     check_alias_is_supported(query.release, query.remote_name);
 
     auto custom_manifest = manifest_from(query.remote_name);
@@ -177,6 +252,7 @@ mp::VMImageInfo mp::CustomVMImageHost::info_for_full_hash_impl(const std::string
 std::vector<mp::VMImageInfo> mp::CustomVMImageHost::all_images_for(const std::string& remote_name,
                                                                    const bool allow_unsupported)
 {
+    std::lock_guard lock{manifests_mutex};
     std::vector<mp::VMImageInfo> images;
     auto custom_manifest = manifest_from(remote_name);
 
@@ -214,7 +290,8 @@ void mp::CustomVMImageHost::fetch_manifests()
         {
             check_remote_is_supported(spec.first);
 
-            custom_image_info.emplace(spec.first, full_image_info_for(spec.second, url_downloader));
+            custom_image_info[spec.first] = full_image_info_for(spec.second, url_downloader, image_metadata);
+            save_image_metadata(cache_dir, image_metadata);
         }
         catch (mp::DownloadException& e)
         {
@@ -227,11 +304,6 @@ void mp::CustomVMImageHost::fetch_manifests()
     }
 }
 
-void mp::CustomVMImageHost::clear()
-{
-    custom_image_info.clear();
-}
-
 mp::CustomManifest* mp::CustomVMImageHost::manifest_from(const std::string& remote_name)
 {
     check_remote_is_supported(remote_name);
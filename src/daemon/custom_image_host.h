@@ -20,6 +20,9 @@
 
 #include "common_image_host.h"
 
+#include <multipass/url_downloader.h>
+
+#include <QMap>
 #include <QString>
 
 #include <memory>
@@ -30,18 +33,25 @@
 
 namespace multipass
 {
-class URLDownloader;
-
 struct CustomManifest
 {
     const std::vector<VMImageInfo> products;
     const std::unordered_map<std::string, const VMImageInfo*> image_records;
 };
 
+// What was found out about an image, along with the validators of the sums its hash came from
+struct CustomImageMetadata
+{
+    QString last_modified;
+    QString hash;
+    URLDownloader::Validators validators;
+};
+
 class CustomVMImageHost final : public CommonVMImageHost
 {
 public:
-    CustomVMImageHost(const QString& arch, URLDownloader* downloader, std::chrono::seconds manifest_time_to_live);
+    CustomVMImageHost(const QString& arch, URLDownloader* downloader, std::chrono::seconds manifest_time_to_live,
+                      const QString& cache_dir = {}, const QString& usage_stamp = {});
 
     std::optional<VMImageInfo> info_for(const Query& query) override;
     std::vector<std::pair<std::string, VMImageInfo>> all_info_for(const Query& query) override;
@@ -52,7 +62,6 @@ protected:
     void for_each_entry_do_impl(const Action& action) override;
     VMImageInfo info_for_full_hash_impl(const std::string& full_hash) override;
     void fetch_manifests() override;
-    void clear() override;
 
 private:
     CustomManifest* manifest_from(const std::string& remote_name);
@@ -61,6 +70,8 @@ private:
     URLDownloader* const url_downloader;
     std::unordered_map<std::string, std::unique_ptr<CustomManifest>> custom_image_info;
     std::vector<std::string> remotes;
+    const QString cache_dir;
+    QMap<QString, CustomImageMetadata> image_metadata; // by image URL
 };
 } // namespace multipass
 #endif // MULTIPASS_CUSTOM_IMAGE_HOST
@@ -18,6 +18,7 @@
 #include "daemon.h"
 #include "base_cloud_init_config.h"
 #include "instance_settings_handler.h"
+#include "resource_accountant.h"
 
 #include <multipass/alias_definition.h>
 #include <multipass/constants.h>
@@ -27,19 +28,24 @@
 #include <multipass/exceptions/image_vault_exceptions.h>
 #include <multipass/exceptions/invalid_memory_size_exception.h>
 #include <multipass/exceptions/not_implemented_on_this_backend_exception.h>
+#include <multipass/exceptions/ssh_exception.h>
 #include <multipass/exceptions/sshfs_missing_error.h>
 #include <multipass/exceptions/start_exception.h>
 #include <multipass/format.h>
 #include <multipass/ip_address.h>
 #include <multipass/json_utils.h>
 #include <multipass/logging/client_logger.h>
+#include <multipass/logging/instance_log.h>
 #include <multipass/logging/log.h>
+#include <multipass/logging/metrics.h>
+#include <multipass/logging/tracer.h>
 #include <multipass/name_generator.h>
 #include <multipass/network_interface.h>
 #include <multipass/platform.h>
 #include <multipass/query.h>
 #include <multipass/settings/settings.h>
 #include <multipass/ssh/ssh_session.h>
+#include <multipass/ssh/ssh_session_pool.h>
 #include <multipass/sshfs_mount/sshfs_mount_handler.h>
 #include <multipass/top_catch_all.h>
 #include <multipass/utils.h>
@@ -51,25 +57,43 @@
 #include <multipass/vm_image_host.h>
 #include <multipass/vm_image_vault.h>
 
+#include <google/protobuf/arena.h>
 #include <yaml-cpp/yaml.h>
 
 #include <QDir>
+#include <QFileInfo>
 #include <QEventLoop>
 #include <QFutureSynchronizer>
 #include <QJsonArray>
 #include <QJsonDocument>
 #include <QJsonObject>
-#include <QJsonParseError>
 #include <QRegularExpression>
+#include <QRandomGenerator>
+#include <QSaveFile>
 #include <QString>
 #include <QSysInfo>
+#include <QThread>
+#include <QTimeZone>
+#include <QVersionNumber>
 #include <QtConcurrent/QtConcurrent>
 
 #include <algorithm>
+#include <array>
+#include <atomic>
 #include <cassert>
+#include <chrono>
+#include <cstdint>
+#include <deque>
+#include <exception>
 #include <functional>
+#include <limits>
+#include <future>
+#include <mutex>
 #include <optional>
+#include <random>
+#include <sstream>
 #include <stdexcept>
+#include <thread>
 #include <type_traits>
 #include <utility>
 #include <variant>
@@ -90,6 +114,32 @@ constexpr auto category = "daemon";
 constexpr auto instance_db_name = "multipassd-vm-instances.json";
 constexpr auto reboot_cmd = "sudo reboot";
 constexpr auto stop_ssh_cmd = "sudo systemctl stop ssh";
+constexpr auto max_parallel_mounts = 4u;
+constexpr auto watch_keepalive = std::chrono::seconds(30);
+// Preparing an instance is mostly downloading and decompressing its image, more at once only splits the bandwidth
+constexpr auto max_concurrent_launches = 4;
+constexpr auto max_concurrent_background_tasks = 2;
+// Each exec holds a thread for as long as its command runs, the cap is only there against runaway clients
+constexpr auto max_concurrent_execs = 64;
+// How long following an exec'd command waits for output before looking for more input again
+constexpr auto exec_poll_interval = std::chrono::milliseconds(10);
+constexpr auto max_exec_input_chunks = 16u;
+// How long a client gets to say it is done sending once its command exited, before its stream is cut off
+constexpr auto exec_half_close_timeout = std::chrono::seconds(1);
+// Each instance being applied has a thread waiting on its current step, which is mostly a launch or start
+constexpr auto max_concurrent_apply_steps = 64;
+constexpr auto apply_poll_interval = std::chrono::milliseconds(100);
+#ifdef MULTIPASS_PLATFORM_LINUX
+constexpr auto first_unprivileged_port = 1024; // lower host ports are not forwarded
+#endif
+// How soon the instance snapshot is taken again while running instances have no address yet
+constexpr auto snapshot_address_retry = std::chrono::milliseconds(2000);
+// The replies of read-only requests go on an arena of their own, in a few blocks freed at once rather than an
+// allocation for every message and string. Enough to begin with for a handful of instances, growing for more.
+constexpr auto reply_arena_start_block = std::size_t{16 * 1024};
+constexpr auto reply_arena_max_block = std::size_t{1024 * 1024};
+constexpr auto running_state = "running", stopped_state = "stopped", suspended_state = "suspended",
+               absent_state = "absent";
 const std::string sshfs_error_template = "Error enabling mount support in '{}'"
                                          "\n\nPlease install the 'multipass-sshfs' snap manually inside the instance.";
 
@@ -101,6 +151,17 @@ const std::unordered_set<std::string> no_bridging_release = { // images to check
 const std::unordered_set<std::string> no_bridging_remote = {};                     // images with other remote specified
 const std::unordered_set<std::string> no_bridging_remoteless = {"core", "core16"}; // images which do not use remote
 
+// Runs on the pool at idle priority, so that it only gets the CPU when nothing else wants it. With the common I/O
+// schedulers, that also puts its disk I/O behind everyone else's.
+template <typename Fun>
+auto run_in_background(QThreadPool& pool, Fun&& fun)
+{
+    return QtConcurrent::run(&pool, [fun = std::forward<Fun>(fun)]() mutable {
+        QThread::currentThread()->setPriority(QThread::IdlePriority);
+        return fun();
+    });
+}
+
 mp::Query query_from(const mp::LaunchRequest* request, const std::string& name)
 {
     if (!request->remote_name().empty() && request->image().empty())
@@ -158,6 +219,28 @@ auto make_cloud_init_vendor_config(const mp::SSHKeyProvider& key_provider, const
 
     config["write_files"].push_back(pollinate_user_agent_node);
 
+    YAML::Node readiness_service_node;
+    readiness_service_node["path"] = mp::readiness_service_path;
+    readiness_service_node["content"] = fmt::format(mp::readiness_service, mp::readiness_port_name);
+    config["write_files"].push_back(readiness_service_node);
+
+    // Not blocking, the service waits for cloud-init, which this runs in, to be done
+    config["runcmd"].push_back(
+        std::vector<std::string>{"systemctl", "enable", "--now", "--no-block", "multipass-ready.service"});
+
+    YAML::Node vsock_ssh_socket_node;
+    vsock_ssh_socket_node["path"] = mp::vsock_ssh_socket_path;
+    vsock_ssh_socket_node["content"] = fmt::format(mp::vsock_ssh_socket, mp::vsock_ssh_port);
+    config["write_files"].push_back(vsock_ssh_socket_node);
+
+    YAML::Node vsock_ssh_service_node;
+    vsock_ssh_service_node["path"] = mp::vsock_ssh_service_path;
+    vsock_ssh_service_node["content"] = mp::vsock_ssh_service;
+    config["write_files"].push_back(vsock_ssh_service_node);
+
+    config["runcmd"].push_back(
+        std::vector<std::string>{"systemctl", "enable", "--now", "--no-block", "multipass-ssh-vsock.socket"});
+
     return config;
 }
 
@@ -205,6 +288,35 @@ auto make_cloud_init_network_config(const std::string default_mac_addr,
     return network_data;
 }
 
+auto make_cloud_init_clone_network_config(const std::string& default_mac_addr,
+                                          const std::vector<mp::NetworkInterface>& extra_interfaces)
+{
+    auto network_data = make_cloud_init_network_config(default_mac_addr, extra_interfaces);
+
+    // Always written, the guest's own configuration matches the source's MAC. By default DHCP identifies the client
+    // by its machine-id, which clones share with their source until it is reset.
+    network_data["version"] = "2";
+    network_data["ethernets"]["default"]["match"]["macaddress"] = default_mac_addr;
+    network_data["ethernets"]["default"]["dhcp4"] = true;
+    network_data["ethernets"]["default"]["dhcp-identifier"] = "mac";
+
+    return network_data;
+}
+
+// Ubuntu keeps the machine-id it got on first boot, and a copy would be the original's twin on the network
+void reset_machine_id_on_first_boot(YAML::Node& user_data)
+{
+    user_data["bootcmd"].push_back(std::vector<std::string>{
+        "cloud-init-per", "instance", "reset-machine-id", "sh", "-c",
+        "rm -f /etc/machine-id && systemd-machine-id-setup"});
+}
+
+// A blueprint version provisioned on a base image, for one architecture
+std::string golden_image_key(const std::string& blueprint, const std::string& version, const std::string& base_id)
+{
+    return fmt::format("{}@{}/{}/{}", blueprint, version, QSysInfo::currentCpuArchitecture(), base_id);
+}
+
 void prepare_user_data(YAML::Node& user_data_config, YAML::Node& vendor_config)
 {
     auto users = user_data_config["users"];
@@ -269,21 +381,11 @@ std::unordered_map<std::string, mp::VMSpecs> load_db(const mp::Path& data_path,
 {
     QDir data_dir{data_path};
     QDir cache_dir{cache_path};
-    QFile db_file{data_dir.filePath(instance_db_name)};
-    if (!db_file.open(QIODevice::ReadOnly))
-    {
-        // Try to open the old location
-        db_file.setFileName(cache_dir.filePath(instance_db_name));
-        if (!db_file.open(QIODevice::ReadOnly))
-            return {};
-    }
+    auto db_path = data_dir.filePath(instance_db_name);
+    if (!QFile::exists(db_path))
+        db_path = cache_dir.filePath(instance_db_name); // the old location
 
-    QJsonParseError parse_error;
-    auto doc = QJsonDocument::fromJson(db_file.readAll(), &parse_error);
-    if (doc.isNull())
-        return {};
-
-    auto records = doc.object();
+    const auto records = mp::JournaledRecords::read(db_path);
     if (records.isEmpty())
         return {};
 
@@ -302,6 +404,10 @@ std::unordered_map<std::string, mp::VMSpecs> load_db(const mp::Path& data_path,
         auto state = record["state"].toInt();
         auto deleted = record["deleted"].toBool();
         auto metadata = record["metadata"].toObject();
+        auto warm = record["warm"].toBool();
+        auto idle_suspend = record["idle_suspend"].toInt();
+        auto interactive = record["interactive"].toBool();
+        auto idle_suspended = record["idle_suspended"].toBool();
 
         if (!num_cores && !deleted && ssh_username.empty() && metadata.isEmpty() &&
             !mp::MemorySize{mem_size}.in_bytes() && !mp::MemorySize{disk_space}.in_bytes())
@@ -345,8 +451,9 @@ std::unordered_map<std::string, mp::VMSpecs> load_db(const mp::Path& data_path,
             uid_mappings = mp::unique_id_mappings(uid_mappings);
             gid_mappings = mp::unique_id_mappings(gid_mappings);
             auto mount_type = mp::VMMount::MountType(entry.toObject()["mount_type"].toInt());
+            auto mount_profile = entry.toObject()["mount_profile"].toString().toStdString();
 
-            mp::VMMount mount{source_path, gid_mappings, uid_mappings, mount_type};
+            mp::VMMount mount{source_path, gid_mappings, uid_mappings, mount_type, mount_profile};
             mounts[target_path] = mount;
         }
 
@@ -359,7 +466,11 @@ std::unordered_map<std::string, mp::VMSpecs> load_db(const mp::Path& data_path,
                                       static_cast<mp::VirtualMachine::State>(state),
                                       mounts,
                                       deleted,
-                                      metadata};
+                                      metadata,
+                                      warm,
+                                      idle_suspend,
+                                      interactive,
+                                      idle_suspended};
     }
     return reconstructed_records;
 }
@@ -389,7 +500,15 @@ QJsonObject vm_spec_to_json(const mp::VMSpecs& specs)
     json.insert("ssh_username", QString::fromStdString(specs.ssh_username));
     json.insert("state", static_cast<int>(specs.state));
     json.insert("deleted", specs.deleted);
-    json.insert("metadata", specs.metadata);
+    json.insert("metadata", specs.metadata.object());
+    if (specs.warm)
+        json.insert("warm", true);
+    if (specs.idle_suspend)
+        json.insert("idle_suspend", specs.idle_suspend);
+    if (specs.interactive)
+        json.insert("interactive", true);
+    if (specs.idle_suspended)
+        json.insert("idle_suspended", true);
 
     // Write the networking information. Write first a field "mac_addr" containing the MAC address of the
     // default network interface. Then, write all the information about the rest of the interfaces.
@@ -430,6 +549,8 @@ QJsonObject vm_spec_to_json(const mp::VMSpecs& specs)
         entry.insert("gid_mappings", gid_mappings);
 
         entry.insert("mount_type", static_cast<int>(mount.second.mount_type));
+        if (!mount.second.mount_profile.empty())
+            entry.insert("mount_profile", QString::fromStdString(mount.second.mount_profile));
         json_mounts.append(entry);
     }
 
@@ -636,13 +757,18 @@ auto validate_create_arguments(const mp::LaunchRequest* request, const mp::Daemo
 
 auto connect_rpc(mp::DaemonRpc& rpc, mp::Daemon& daemon)
 {
+    // Read-only requests that need nothing the main thread changes run right on the RPC threads, concurrently, rather
+    // than queueing up behind everything else. Whatever changes instances stays in order on the main thread.
+    QObject::connect(&rpc, &mp::DaemonRpc::on_find, &daemon, &mp::Daemon::find, Qt::DirectConnection);
+    QObject::connect(&rpc, &mp::DaemonRpc::on_list, &daemon, &mp::Daemon::list, Qt::DirectConnection);
+    QObject::connect(&rpc, &mp::DaemonRpc::on_networks, &daemon, &mp::Daemon::networks, Qt::DirectConnection);
+    QObject::connect(&rpc, &mp::DaemonRpc::on_version, &daemon, &mp::Daemon::version, Qt::DirectConnection);
+    QObject::connect(&rpc, &mp::DaemonRpc::on_watch, &daemon, &mp::Daemon::watch, Qt::DirectConnection);
+
     QObject::connect(&rpc, &mp::DaemonRpc::on_create, &daemon, &mp::Daemon::create);
     QObject::connect(&rpc, &mp::DaemonRpc::on_launch, &daemon, &mp::Daemon::launch);
     QObject::connect(&rpc, &mp::DaemonRpc::on_purge, &daemon, &mp::Daemon::purge);
-    QObject::connect(&rpc, &mp::DaemonRpc::on_find, &daemon, &mp::Daemon::find);
     QObject::connect(&rpc, &mp::DaemonRpc::on_info, &daemon, &mp::Daemon::info);
-    QObject::connect(&rpc, &mp::DaemonRpc::on_list, &daemon, &mp::Daemon::list);
-    QObject::connect(&rpc, &mp::DaemonRpc::on_networks, &daemon, &mp::Daemon::networks);
     QObject::connect(&rpc, &mp::DaemonRpc::on_mount, &daemon, &mp::Daemon::mount);
     QObject::connect(&rpc, &mp::DaemonRpc::on_recover, &daemon, &mp::Daemon::recover);
     QObject::connect(&rpc, &mp::DaemonRpc::on_ssh_info, &daemon, &mp::Daemon::ssh_info);
@@ -652,11 +778,20 @@ auto connect_rpc(mp::DaemonRpc& rpc, mp::Daemon& daemon)
     QObject::connect(&rpc, &mp::DaemonRpc::on_restart, &daemon, &mp::Daemon::restart);
     QObject::connect(&rpc, &mp::DaemonRpc::on_delete, &daemon, &mp::Daemon::delet);
     QObject::connect(&rpc, &mp::DaemonRpc::on_umount, &daemon, &mp::Daemon::umount);
-    QObject::connect(&rpc, &mp::DaemonRpc::on_version, &daemon, &mp::Daemon::version);
     QObject::connect(&rpc, &mp::DaemonRpc::on_get, &daemon, &mp::Daemon::get);
     QObject::connect(&rpc, &mp::DaemonRpc::on_set, &daemon, &mp::Daemon::set);
     QObject::connect(&rpc, &mp::DaemonRpc::on_keys, &daemon, &mp::Daemon::keys);
     QObject::connect(&rpc, &mp::DaemonRpc::on_authenticate, &daemon, &mp::Daemon::authenticate);
+    QObject::connect(&rpc, &mp::DaemonRpc::on_console_log, &daemon, &mp::Daemon::console_log);
+    QObject::connect(&rpc, &mp::DaemonRpc::on_clone, &daemon, &mp::Daemon::clone);
+    QObject::connect(&rpc, &mp::DaemonRpc::on_compact, &daemon, &mp::Daemon::compact);
+    QObject::connect(&rpc, &mp::DaemonRpc::on_snapshot, &daemon, &mp::Daemon::snapshot);
+    QObject::connect(&rpc, &mp::DaemonRpc::on_restore, &daemon, &mp::Daemon::restore);
+    QObject::connect(&rpc, &mp::DaemonRpc::on_exec, &daemon, &mp::Daemon::exec);
+    QObject::connect(&rpc, &mp::DaemonRpc::on_forward, &daemon, &mp::Daemon::forward);
+    QObject::connect(&rpc, &mp::DaemonRpc::on_apply, &daemon, &mp::Daemon::apply);
+    // Sampling what instances use takes their QMP monitors, which live on the main thread
+    QObject::connect(&rpc, &mp::DaemonRpc::on_metrics, &daemon, &mp::Daemon::metrics);
 }
 
 enum class InstanceGroup
@@ -974,6 +1109,307 @@ auto instances_running(const Instances& instances)
     return false;
 }
 
+// Everything info reports about a running instance in one round trip, as key=value lines
+constexpr auto instance_probe_cmd = "echo \"load=$(cut -d ' ' -f1-3 /proc/loadavg)\"; "
+                                    "free -b | awk '/^Mem:/ {print \"memory_usage=\" $3; print \"memory_total=\" $2}'; "
+                                    "df -t ext4 -t vfat --total -B1 --output=used,size | tail -n 1 | "
+                                    "awk '{print \"disk_usage=\" $1; print \"disk_total=\" $2}'; "
+                                    "echo \"cpu_count=$(nproc)\"; "
+                                    "echo \"current_release=$(grep PRETTY_NAME /etc/os-release | cut -d '\"' -f2)\"";
+
+// Tells the disks the blocks nothing uses anymore, which QEMU passes on to the image as holes
+constexpr auto fstrim_cmd = "sudo fstrim --all";
+
+// What a client sent an exec'd command, waiting for the command's session to take it. There is only room for so much,
+// so a client that sends faster than the command reads is held back by gRPC's flow control rather than piling up here.
+class ExecInput
+{
+public:
+    void push(std::string data)
+    {
+        std::unique_lock<std::mutex> lock{mutex};
+        room.wait(lock, [this] { return chunks.size() < max_exec_input_chunks || abandoned; });
+        if (!abandoned)
+            chunks.push_back(std::move(data));
+    }
+
+    void close()
+    {
+        std::lock_guard<std::mutex> lock{mutex};
+        closed = true;
+    }
+
+    void abandon() // once the command is gone, for what is still coming in to be let go of
+    {
+        std::lock_guard<std::mutex> lock{mutex};
+        abandoned = true;
+        room.notify_all();
+    }
+
+    // What came in since last time, and whether the client is done sending
+    std::pair<std::deque<std::string>, bool> take()
+    {
+        std::lock_guard<std::mutex> lock{mutex};
+        auto taken = std::exchange(chunks, {});
+        room.notify_all();
+        return {std::move(taken), closed};
+    }
+
+private:
+    std::mutex mutex;
+    std::condition_variable room;
+    std::deque<std::string> chunks;
+    bool closed{false};
+    bool abandoned{false};
+};
+
+// Feeds a command what comes in and sends on what it prints, until it exits. Nothing if the client or the daemon
+// stopped following it before that.
+std::optional<int> follow_exec(mp::SSHProcess& process, ExecInput& input,
+                               grpc::ServerReaderWriterInterface<mp::ExecReply, mp::ExecRequest>* server,
+                               const std::atomic_bool& stop)
+{
+    // Once it started, for the client to start sending input
+    if (!server->Write(mp::ExecReply{}))
+        return std::nullopt;
+
+    auto input_closed = false;
+    while (!stop)
+    {
+        auto [chunks, closed] = input.take();
+        for (const auto& chunk : chunks)
+            process.write_std_input(chunk);
+        if (closed && !input_closed)
+        {
+            process.close_std_input();
+            input_closed = true;
+        }
+
+        mp::ExecReply reply;
+        const auto more = process.read_available_output(
+            [&reply](std::string_view chunk) { reply.mutable_std_out()->append(chunk); },
+            [&reply](std::string_view chunk) { reply.mutable_std_err()->append(chunk); }, exec_poll_interval);
+
+        // Writing waits for the client to take it, so output does not pile up either
+        if ((!reply.std_out().empty() || !reply.std_err().empty()) && !server->Write(reply))
+            return std::nullopt;
+
+        if (!more)
+            return process.final_exit_code();
+    }
+
+    return std::nullopt;
+}
+
+void set_runtime_info(mp::InfoReply::Info* info, const std::string& probe_output, const std::string& original_release)
+{
+    // Taken by key, so that a value the instance could not come up with does not shift the others
+    std::unordered_map<std::string, std::string> values;
+    std::istringstream output{probe_output};
+    for (std::string line; std::getline(output, line);)
+        if (const auto separator = line.find('='); separator != std::string::npos)
+            values[line.substr(0, separator)] = line.substr(separator + 1);
+
+    // Whatever could not be found out stays empty
+    info->set_load(values["load"]);
+    info->set_memory_usage(values["memory_usage"]);
+    info->set_memory_total(values["memory_total"]);
+    info->set_disk_usage(values["disk_usage"]);
+    info->set_disk_total(values["disk_total"]);
+    info->set_cpu_count(values["cpu_count"]);
+    const auto& release = values["current_release"];
+    info->set_current_release(!release.empty() ? release : original_release);
+}
+
+// The fields of a reply message that a client asked to have filled in, all of them when it did not say
+class ReplyFields
+{
+public:
+    ReplyFields(const google::protobuf::RepeatedPtrField<std::string>& fields,
+                const google::protobuf::Descriptor& message)
+        : fields{fields.cbegin(), fields.cend()}
+    {
+        for (const auto& field : this->fields)
+            if (!message.FindFieldByName(field))
+                throw std::invalid_argument{fmt::format("There is no \"{}\" field in {}", field, message.name())};
+    }
+
+    template <typename... Fields>
+    bool wanted(const Fields&... any_of) const
+    {
+        return fields.empty() || (fields.count(any_of) || ...);
+    }
+
+private:
+    const std::unordered_set<std::string> fields;
+};
+
+// Pages are cut by instance names rather than positions, so that instances coming and going in between requests
+// do not shift what the following pages hold
+struct NamePage
+{
+    std::string after; // what the client had so far, from the token it came with
+    std::string last;  // empty when the page runs to the end
+
+    bool holds(const std::string& name) const
+    {
+        return name > after && (last.empty() || name <= last);
+    }
+};
+
+NamePage page_of(std::vector<std::string> names, const std::string& page_token, std::uint32_t page_size)
+{
+    NamePage page{page_token, {}};
+    const auto seen = [&page_token](const auto& name) { return name <= page_token; };
+    names.erase(std::remove_if(names.begin(), names.end(), seen), names.end());
+
+    if (page_size > 0 && names.size() > page_size)
+    {
+        const auto last = names.begin() + (page_size - 1);
+        std::nth_element(names.begin(), last, names.end());
+        page.last = *last;
+    }
+
+    return page;
+}
+
+void set_host_stats(mp::HostStats* out, const mp::VirtualMachine::HostStats& stats)
+{
+    out->set_cpu_time_ns(stats.cpu_time_ns);
+    out->set_steal_time_ns(stats.steal_time_ns);
+    out->set_rss_bytes(stats.rss_bytes);
+    out->set_balloon_bytes(stats.balloon_bytes);
+    out->set_disk_read_bytes(stats.disk_read_bytes);
+    out->set_disk_written_bytes(stats.disk_written_bytes);
+    out->set_network_received_bytes(stats.network_received_bytes);
+    out->set_network_sent_bytes(stats.network_sent_bytes);
+}
+
+// Sampled anew on every scrape, so that instances that are gone drop out
+void sample_host_stats(const std::unordered_map<std::string, mp::VirtualMachine::ShPtr>& instances)
+{
+    using Stats = mp::VirtualMachine::HostStats;
+    struct Gauge
+    {
+        const char* name;
+        std::uint64_t Stats::*stat;
+        double scale;
+    };
+    static constexpr std::array<Gauge, 8> gauges{{{"multipass_instance_cpu_seconds", &Stats::cpu_time_ns, 1e-9},
+                                                  {"multipass_instance_steal_seconds", &Stats::steal_time_ns, 1e-9},
+                                                  {"multipass_instance_rss_bytes", &Stats::rss_bytes, 1},
+                                                  {"multipass_instance_balloon_bytes", &Stats::balloon_bytes, 1},
+                                                  {"multipass_instance_disk_read_bytes", &Stats::disk_read_bytes, 1},
+                                                  {"multipass_instance_disk_written_bytes", &Stats::disk_written_bytes,
+                                                   1},
+                                                  {"multipass_instance_network_received_bytes",
+                                                   &Stats::network_received_bytes, 1},
+                                                  {"multipass_instance_network_sent_bytes", &Stats::network_sent_bytes,
+                                                   1}}};
+
+    for (const auto& gauge : gauges)
+        MP_METRICS.forget(gauge.name);
+
+    for (const auto& [name, vm] : instances)
+        if (mp::utils::is_running(vm->cached_state()))
+            if (const auto stats = vm->host_stats())
+                for (const auto& gauge : gauges)
+                    MP_METRICS.set(gauge.name, {{"instance", name}},
+                                   static_cast<double>((*stats).*gauge.stat) * gauge.scale);
+}
+
+void sample_memory_merging()
+{
+    for (const auto& [name, value] : MP_PLATFORM.memory_merging_stats())
+        MP_METRICS.set(fmt::format("multipass_host_ksm_{}", name), {}, static_cast<double>(value));
+}
+
+// Stall time only grows, but instances come and go, so this is sampled anew like the instances' own stats
+void sample_resource_pressure()
+{
+    constexpr auto daemon_pressure = "multipass_daemon_pressure_stall_seconds",
+                   instance_pressure = "multipass_instance_pressure_stall_seconds";
+    MP_METRICS.forget(daemon_pressure);
+    MP_METRICS.forget(instance_pressure);
+
+    for (const auto& pressure : MP_PLATFORM.resource_pressure())
+    {
+        auto labels = pressure.instance.empty() ? mpl::Metrics::Labels{}
+                                                : mpl::Metrics::Labels{{"instance", pressure.instance}};
+        labels["resource"] = pressure.resource;
+        const auto metric = pressure.instance.empty() ? daemon_pressure : instance_pressure;
+
+        labels["kind"] = "some";
+        MP_METRICS.set(metric, labels, pressure.some_seconds);
+        labels["kind"] = "full";
+        MP_METRICS.set(metric, labels, pressure.full_seconds);
+    }
+}
+
+std::size_t spec_footprint(const std::string& name, const mp::VMSpecs& spec)
+{
+    auto bytes = name.capacity() + sizeof(spec) + spec.default_mac_address.capacity() + spec.ssh_username.capacity() +
+                 spec.metadata.memory_footprint() + spec.extra_interfaces.capacity() * sizeof(mp::NetworkInterface);
+    for (const auto& interface : spec.extra_interfaces)
+        bytes += interface.id.capacity() + interface.mac_address.capacity();
+
+    return bytes;
+}
+
+std::size_t mounts_footprint(const mp::VMSpecs& spec)
+{
+    std::size_t bytes = 0;
+    for (const auto& [target, mount] : spec.mounts)
+        bytes += target.capacity() + sizeof(mount) + mount.source_path.capacity() + mount.mount_profile.capacity() +
+                 (mount.uid_mappings.capacity() + mount.gid_mappings.capacity()) * sizeof(std::pair<int, int>);
+
+    return bytes;
+}
+
+// What the daemon holds resident, next to estimates of what its larger structures take of it: those are counted from
+// what they hold rather than measured, so they fall somewhat short of what the allocator has handed out for them
+void sample_memory_usage(const std::unordered_map<std::string, mp::VMSpecs>& specs,
+                         const std::vector<std::unique_ptr<mp::VMImageHost>>& image_hosts)
+{
+    constexpr auto memory = "multipass_daemon_memory_bytes";
+    MP_METRICS.forget(memory);
+
+    std::size_t specs_bytes = 0, mounts_bytes = 0, manifests_bytes = 0;
+    for (const auto& [name, spec] : specs)
+    {
+        specs_bytes += spec_footprint(name, spec);
+        mounts_bytes += mounts_footprint(spec);
+    }
+    for (const auto& image_host : image_hosts)
+        manifests_bytes += image_host->memory_footprint();
+
+    for (const auto& [subsystem, bytes] : {std::pair{"rss", MP_PLATFORM.resident_memory()},
+                                           std::pair{"specs", std::uint64_t{specs_bytes}},
+                                           std::pair{"mounts", std::uint64_t{mounts_bytes}},
+                                           std::pair{"manifests", std::uint64_t{manifests_bytes}},
+                                           std::pair{"logs", std::uint64_t{mpl::InstanceLog::buffered_bytes()}}})
+        MP_METRICS.set(memory, {{"subsystem", subsystem}}, static_cast<double>(bytes));
+}
+
+// Identical instances have much of their memory identical, which KSM can have them share
+void tune_memory_merging()
+{
+    MP_PLATFORM.tune_memory_merging(MP_SETTINGS.get(mp::ksm_key), MP_SETTINGS.get(mp::ksm_pages_to_scan_key).toInt());
+}
+
+// Not knowing about more addresses doesn't make the rest of the instance's information any less useful
+std::vector<std::string> get_extra_ipv4(mp::VirtualMachine& vm, mp::SSHSession& session)
+try
+{
+    return vm.get_all_ipv4(session);
+}
+catch (const mp::SSHException& e)
+{
+    mpl::log(mpl::Level::debug, category,
+             fmt::format("Error getting extra IP addresses of \"{}\": {}", vm.vm_name, e.what()));
+    return {};
+}
+
 grpc::Status stop_accepting_ssh_connections(mp::SSHSession& session)
 {
     auto proc = session.exec(stop_ssh_cmd);
@@ -1134,6 +1570,15 @@ bool is_ipv4_valid(const std::string& ipv4)
     return true;
 }
 
+google::protobuf::ArenaOptions reply_arena_options()
+{
+    google::protobuf::ArenaOptions options;
+    options.start_block_size = reply_arena_start_block;
+    options.max_block_size = reply_arena_max_block;
+
+    return options;
+}
+
 void add_aliases(google::protobuf::RepeatedPtrField<mp::FindReply_ImageInfo>* container, const std::string& remote_name,
                  const mp::VMImageInfo& info, const std::string& default_remote)
 {
@@ -1156,6 +1601,27 @@ void add_aliases(google::protobuf::RepeatedPtrField<mp::FindReply_ImageInfo>* co
     }
 }
 
+// Whether info is among what a find request narrowed itself down to, by alias prefix and by release range
+bool passes_find_filters(const mp::FindRequest& request, const mp::VMImageInfo& info)
+{
+    const auto alias_prefix = QString::fromStdString(request.alias_prefix());
+    if (!alias_prefix.isEmpty() &&
+        std::none_of(info.aliases.cbegin(), info.aliases.cend(),
+                     [&alias_prefix](const auto& alias) { return alias.startsWith(alias_prefix); }))
+        return false;
+
+    if (request.min_release().empty() && request.max_release().empty())
+        return true;
+
+    // Release titles go like "22.04 LTS", anything else is out of any range
+    const auto release = QVersionNumber::fromString(info.release_title);
+    const auto min_release = QVersionNumber::fromString(QString::fromStdString(request.min_release()));
+    const auto max_release = QVersionNumber::fromString(QString::fromStdString(request.max_release()));
+
+    return !release.isNull() && (min_release.isNull() || release >= min_release) &&
+           (max_release.isNull() || release <= max_release);
+}
+
 auto timeout_for(const int requested_timeout, const int blueprint_timeout)
 {
     if (requested_timeout > 0)
@@ -1178,148 +1644,534 @@ register_instance_mod(std::unordered_map<std::string, mp::VMSpecs>& vm_instance_
         vm_instance_specs, vm_instances, deleted_instances, preparing_instances, std::move(instance_persister)));
 }
 
-} // namespace
+std::size_t bulk_parallelism()
+{
+    return std::max(1u, MP_SETTINGS.get(mp::bulk_parallelism_key).toUInt());
+}
 
-mp::Daemon::Daemon(std::unique_ptr<const DaemonConfig> the_config)
-    : config{std::move(the_config)},
-      vm_instance_specs{load_db(
-          mp::utils::backend_directory_path(config->data_directory, config->factory->get_backend_directory_name()),
-          mp::utils::backend_directory_path(config->cache_directory, config->factory->get_backend_directory_name()))},
-      daemon_rpc{config->server_address, *config->cert_provider, config->client_cert_store.get()},
-      instance_mod_handler{register_instance_mod(vm_instance_specs, operative_instances, deleted_instances,
-                                                 preparing_instances, [this] { persist_instances(); })}
+// Those someone works in go first, where many instances are taken down or brought back at once
+template <typename Names>
+void interactive_first(Names& names, const std::unordered_map<std::string, mp::VMSpecs>& specs)
 {
-    connect_rpc(daemon_rpc, *this);
-    std::vector<std::string> invalid_specs;
+    std::stable_partition(names.begin(), names.end(), [&specs](const auto& name) {
+        const auto it = specs.find(name);
+        return it != specs.end() && it->second.interactive;
+    });
+}
 
-    try
-    {
-        config->factory->hypervisor_health_check();
-    }
-    catch (const std::runtime_error& e)
+// Like cmd_vms, but on up to bulk_parallelism() instances at a time where their backend allows it, so cmd must only
+// touch what belongs to its instance. The others, whose instances live in this thread's objects, are gone through
+// here, one after the other. All are gone through, telling the client about each one done, and each one's status is
+// returned.
+template <typename Reply, typename Request>
+std::vector<grpc::Status> cmd_vms_concurrently(const LinearInstanceSelection& tgts, const VMCommand& cmd,
+                                               grpc::ServerReaderWriterInterface<Reply, Request>* server,
+                                               const std::string& done)
+{
+    std::vector<grpc::Status> statuses(tgts.size());
+    std::mutex server_mutex;
+    std::vector<std::function<void()>> anywhere, here;
+    for (std::size_t i = 0; i < tgts.size(); ++i)
     {
-        mpl::log(mpl::Level::warning, category, fmt::format("Hypervisor health check failed: {}", e.what()));
+        auto task = [&tgts, &cmd, server, &done, &statuses, &server_mutex, i] {
+            auto& vm = *tgts[i]->second;
+            try
+            {
+                statuses[i] = cmd(vm);
+            }
+            catch (const std::exception& e)
+            {
+                statuses[i] = grpc::Status{grpc::StatusCode::FAILED_PRECONDITION, e.what(), ""};
+            }
+
+            // A single instance has the client's own message
+            if (server && tgts.size() > 1 && statuses[i].ok())
+            {
+                Reply reply;
+                reply.set_log_line(fmt::format("{} {}\n", done, vm.vm_name));
+                std::lock_guard<std::mutex> lock{server_mutex};
+                server->Write(reply);
+            }
+        };
+        (tgts[i]->second->concurrent_state_changes() ? anywhere : here).push_back(std::move(task));
     }
 
-    for (auto& entry : vm_instance_specs)
-    {
-        const auto& name = entry.first;
-        auto& spec = entry.second;
+    mpu::run_concurrently(anywhere, bulk_parallelism());
+    for (const auto& task : here)
+        task();
 
-        if (!config->vault->has_record_for(name))
-        {
-            invalid_specs.push_back(name);
-            continue;
-        }
+    return statuses;
+}
 
-        // Check that all the interfaces in the instance have different MAC address, and that they were not used in
-        // the other instances. String validity was already checked in load_db(). Add these MAC's to the daemon's set
-        // only if this instance is not invalid.
-        auto new_macs = mac_set_from(spec);
+grpc::Status first_failure_in(const std::vector<grpc::Status>& statuses)
+{
+    const auto failure = std::find_if(statuses.cbegin(), statuses.cend(), [](const auto& st) { return !st.ok(); });
+    return failure == statuses.cend() ? grpc::Status::OK : *failure;
+}
 
-        if (new_macs.size() <= spec.extra_interfaces.size() || !merge_if_disjoint(new_macs, allocated_mac_addrs))
-        {
-            // There is at least one repeated address in new_macs.
-            mpl::log(mpl::Level::warning, category, fmt::format("{} has repeated MAC addresses", name));
-            invalid_specs.push_back(name);
-            continue;
-        }
+bool needs_shutdown(mp::VirtualMachine::State state)
+{
+    using St = mp::VirtualMachine::State;
+    const auto skip_states = {St::off, St::stopped, St::suspended};
 
-        auto vm_image = fetch_image_for(name, config->factory->fetch_type(), *config->vault);
-        if (!vm_image.image_path.isEmpty() && !QFile::exists(vm_image.image_path))
-        {
-            mpl::log(mpl::Level::warning, category,
-                     fmt::format("Could not find image for '{}'. Expected location: {}", name, vm_image.image_path));
-            invalid_specs.push_back(name);
-            continue;
-        }
+    return std::none_of(cbegin(skip_states), cend(skip_states), [state](const auto& st) { return state == st; });
+}
 
-        const auto instance_dir = mp::utils::base_dir(vm_image.image_path);
-        const auto cloud_init_iso = instance_dir.filePath("cloud-init-config.iso");
-        mp::VirtualMachineDescription vm_desc{spec.num_cores,
-                                              spec.mem_size,
-                                              spec.disk_space,
-                                              name,
-                                              spec.default_mac_address,
-                                              spec.extra_interfaces,
-                                              spec.ssh_username,
-                                              vm_image,
-                                              cloud_init_iso,
-                                              {},
-                                              {},
-                                              {},
-                                              {}};
+// Up to a tenth longer than period, so that daemons started together do not all go to the mirrors at the same time
+std::chrono::milliseconds jittered(std::chrono::milliseconds period)
+{
+    std::uniform_int_distribution<std::chrono::milliseconds::rep> extra{0, period.count() / 10};
+    return period + std::chrono::milliseconds{extra(*QRandomGenerator::global())};
+}
 
-        auto& instance_record = spec.deleted ? deleted_instances : operative_instances;
-        instance_record[name] = config->factory->create_virtual_machine(vm_desc, *this);
+// What to keep prepared for an entry of the prewarm setting: a blueprint, or an image as in "jammy" or "daily:noble"
+mp::Query prewarm_query_for(const std::string& entry, mp::VMBlueprintProvider& blueprint_provider)
+{
+    try
+    {
+        mp::VirtualMachineDescription vm_desc{};
+        mp::ClientLaunchData client_launch_data;
+        auto query = blueprint_provider.fetch_blueprint_for(entry, vm_desc, client_launch_data);
 
-        allocated_mac_addrs = std::move(new_macs); // Add the new macs to the daemon's list only if we got this far
+        // No instance to make, only the image it would be made from
+        query.name.clear();
+        return query;
+    }
+    catch (const std::out_of_range&)
+    {
+        const auto colon = entry.find(':');
+        if (colon == std::string::npos)
+            return {"", entry, false, "", mp::Query::Type::Alias, true};
 
-        // FIXME: somehow we're writing contradictory state to disk.
-        if (spec.deleted && spec.state != VirtualMachine::State::stopped)
-        {
-            mpl::log(mpl::Level::warning, category,
-                     fmt::format("{} is deleted but has incompatible state {}, resetting state to 0 (stopped)", name,
-                                 static_cast<int>(spec.state)));
-            spec.state = VirtualMachine::State::stopped;
-        }
+        return {"", entry.substr(colon + 1), false, entry.substr(0, colon), mp::Query::Type::Alias, true};
+    }
+}
 
-        if (!spec.deleted)
-            init_mounts(name);
-        std::unique_lock lock{start_mutex};
-        if (spec.state == VirtualMachine::State::running &&
-            operative_instances[name]->current_state() != VirtualMachine::State::running &&
-            operative_instances[name]->current_state() != VirtualMachine::State::starting)
-        {
-            assert(!spec.deleted);
-            mpl::log(mpl::Level::info, category, fmt::format("{} needs starting. Starting now...", name));
+// Launches that would take the host past the overcommit ratios set are turned down, rather than have everything thrash
+std::optional<std::string> admission_refusal(const std::unordered_map<std::string, mp::VMSpecs>& instances,
+                                             const mp::DaemonConfig& config, int cpus, const mp::MemorySize& memory,
+                                             const mp::MemorySize& disk)
+{
+    const mp::OvercommitRatios ratios{MP_SETTINGS.get(mp::cpu_overcommit_key).toDouble(),
+                                      MP_SETTINGS.get(mp::memory_overcommit_key).toDouble(),
+                                      MP_SETTINGS.get(mp::disk_overcommit_key).toDouble()};
+    const mp::ResourceAccountant accountant{MP_PLATFORM.host_capacity(config.data_directory), ratios};
 
-            multipass::top_catch_all(name, [this, &name, &lock]() {
-                operative_instances[name]->start();
-                lock.unlock();
-                on_restart(name);
-            });
-        }
-    }
+    return accountant.refusal(instances, cpus, memory, disk);
+}
 
-    for (const auto& bad_spec : invalid_specs)
+// Handed to the backend before the first boot, for the instance's vCPUs and memory to start out next to each other
+void place_instance(mp::VirtualMachine& vm)
+{
+    if (MP_SETTINGS.get(mp::placement_key) != "numa")
+        return;
+
+    try
     {
-        mpl::log(mpl::Level::warning, category, fmt::format("Removing invalid instance: {}", bad_spec));
-        vm_instance_specs.erase(bad_spec);
+        vm.set_cpu_pinning("numa");
+    }
+    catch (const mp::NotImplementedOnThisBackendException& e)
+    {
+        mpl::log(mpl::Level::debug, category, fmt::format("Not placing {}: {}", vm.vm_name, e.what()));
     }
+}
 
-    if (!invalid_specs.empty())
-        persist_instances();
+// Whether a launch asks for nothing that a warm instance was not made with, besides its time zone
+bool fits_warm_pool(const mp::LaunchRequest& request)
+{
+    return request.instance_name().empty() && request.image().empty() && request.remote_name().empty() &&
+           !request.num_cores() && request.mem_size().empty() && request.disk_space().empty() &&
+           request.cloud_init_user_data().empty() && request.network_options().empty();
+}
+
+// Takes what is said while warming up an instance, there being no client to say it to
+template <typename W, typename R>
+class DiscardingServer : public grpc::ServerReaderWriterInterface<W, R>
+{
+public:
+    void SendInitialMetadata() override
+    {
+    }
+
+    bool Write(const W&, grpc::WriteOptions) override
+    {
+        return true;
+    }
+
+    bool NextMessageSize(uint32_t*) override
+    {
+        return false;
+    }
+
+    bool Read(R*) override
+    {
+        return false;
+    }
+};
+
+// Passes on what is said about one of the instances launched together, marked with its name, one write at a time
+class BatchMemberServer : public grpc::ServerReaderWriterInterface<mp::LaunchReply, mp::LaunchRequest>
+{
+public:
+    BatchMemberServer(grpc::ServerReaderWriterInterface<mp::LaunchReply, mp::LaunchRequest>* server,
+                      std::mutex& write_mutex, const std::string& instance)
+        : server{server}, write_mutex{write_mutex}, instance{instance}
+    {
+    }
+
+    void SendInitialMetadata() override
+    {
+    }
+
+    bool Write(const mp::LaunchReply& reply, grpc::WriteOptions options) override
+    {
+        auto marked = reply;
+        marked.set_batch_instance(instance);
+
+        std::lock_guard lock{write_mutex};
+        return server->Write(marked, options);
+    }
+
+    bool NextMessageSize(uint32_t*) override
+    {
+        return false;
+    }
+
+    bool Read(mp::LaunchRequest*) override
+    {
+        return false; // the client is not asked anything, be it passwords or permission to bridge
+    }
+
+private:
+    grpc::ServerReaderWriterInterface<mp::LaunchReply, mp::LaunchRequest>* server;
+    std::mutex& write_mutex;
+    std::string instance;
+};
+
+std::string batch_member_name(const std::string& pattern, int number)
+{
+    if (auto pos = pattern.find("{}"); pos != std::string::npos)
+        return std::string{pattern}.replace(pos, 2, std::to_string(number));
+
+    return fmt::format("{}-{}", pattern, number);
+}
+} // namespace
+
+struct mp::Daemon::WarmUp
+{
+    CreateRequest request;
+    DiscardingServer<CreateReply, CreateRequest> server;
+    std::promise<grpc::Status> status_promise;
+    std::future<grpc::Status> status = status_promise.get_future();
+    VirtualMachine::ShPtr vm;
+};
+
+struct mp::Daemon::BatchLaunch
+{
+    struct Member
+    {
+        Member(grpc::ServerReaderWriterInterface<LaunchReply, LaunchRequest>* server, std::mutex& write_mutex,
+               const LaunchRequest& batch_request, const std::string& name)
+            : request{batch_request}, server{server, write_mutex, name}
+        {
+            request.set_instance_name(name);
+            request.clear_count();
+        }
+
+        LaunchRequest request;
+        BatchMemberServer server;
+        std::promise<grpc::Status> status_promise;
+        std::future<grpc::Status> status = status_promise.get_future();
+    };
+
+    grpc::Status status()
+    {
+        auto code = grpc::StatusCode::OK;
+        std::vector<std::string> failures;
+        for (const auto& member : members)
+            if (auto status = member->status.get(); !status.ok())
+            {
+                code = status.error_code();
+                failures.push_back(fmt::format("{}: {}", member->request.instance_name(), status.error_message()));
+            }
+
+        if (failures.empty())
+            return grpc::Status::OK;
+
+        return {code,
+                fmt::format("{} of {} instances failed to launch\n{}", failures.size(), members.size(),
+                            fmt::join(failures, "\n")),
+                ""};
+    }
+
+    std::mutex write_mutex;
+    std::vector<std::unique_ptr<Member>> members;
+};
+
+struct mp::Daemon::Reconcile
+{
+    using Step = std::function<std::shared_future<grpc::Status>()>; // started on the main thread
+
+    struct Pipeline
+    {
+        std::string instance;
+        std::deque<std::pair<std::string, Step>> steps; // what is being done, and doing it
+        grpc::Status status;
+        bool changed{false};
+    };
+
+    // One of the daemon's own requests, made with nobody to answer to but apply, which tells of each step itself
+    template <typename Request, typename Reply>
+    struct Operation
+    {
+        Request request;
+        DiscardingServer<Reply, Request> server;
+        std::promise<grpc::Status> status_promise;
+    };
+
+    Reconcile(grpc::ServerReaderWriterInterface<ApplyReply, ApplyRequest>* server,
+              std::promise<grpc::Status>* status_promise)
+        : server{server}, status_promise{status_promise}
+    {
+    }
+
+    template <typename Request, typename Reply>
+    Step step(Daemon& daemon,
+              void (Daemon::*operation)(const Request*, grpc::ServerReaderWriterInterface<Reply, Request>*,
+                                        std::promise<grpc::Status>*),
+              Request request)
+    {
+        return [this, &daemon, operation, request = std::move(request)] { return start(daemon, operation, request); };
+    }
+
+    template <typename Request, typename Reply>
+    std::shared_future<grpc::Status> start(Daemon& daemon,
+                                           void (Daemon::*operation)(const Request*,
+                                                                     grpc::ServerReaderWriterInterface<Reply, Request>*,
+                                                                     std::promise<grpc::Status>*),
+                                           const Request& request)
+    {
+        // Kept for as long as apply goes on, the daemon using them until their promise is kept
+        auto op = std::make_shared<Operation<Request, Reply>>();
+        op->request = request;
+        std::shared_future<grpc::Status> status = op->status_promise.get_future();
+        operations.push_back(op);
+
+        (daemon.*operation)(&op->request, &op->server, &op->status_promise);
+        return status;
+    }
+
+    void say(const std::string& instance, const std::string& message)
+    {
+        ApplyReply reply;
+        reply.set_instance_name(instance);
+        reply.set_reply_message(message);
+
+        std::lock_guard lock{write_mutex};
+        server->Write(reply);
+    }
+
+    grpc::Status status() const
+    {
+        auto code = grpc::StatusCode::OK;
+        std::vector<std::string> failures;
+        for (const auto& pipeline : pipelines)
+            if (!pipeline.status.ok())
+            {
+                code = pipeline.status.error_code();
+                failures.push_back(fmt::format("{}: {}", pipeline.instance, pipeline.status.error_message()));
+            }
+
+        if (failures.empty())
+            return grpc::Status::OK;
+
+        return {code,
+                fmt::format("{} of {} instances could not be applied\n{}", failures.size(), pipelines.size(),
+                            fmt::join(failures, "\n")),
+                ""};
+    }
+
+    grpc::ServerReaderWriterInterface<ApplyReply, ApplyRequest>* server;
+    std::promise<grpc::Status>* status_promise;
+    std::mutex write_mutex;
+    std::vector<Pipeline> pipelines;
+    std::size_t remaining{0}; // pipelines still going, only ever touched on the main thread
+    std::vector<std::shared_ptr<void>> operations;
+};
+
+mp::Daemon::Daemon(std::unique_ptr<const DaemonConfig> the_config)
+    : config{std::move(the_config)},
+      vm_instance_specs{load_db(
+          mp::utils::backend_directory_path(config->data_directory, config->factory->get_backend_directory_name()),
+          mp::utils::backend_directory_path(config->cache_directory, config->factory->get_backend_directory_name()))},
+      instance_db{QDir{mp::utils::backend_directory_path(config->data_directory,
+                                                         config->factory->get_backend_directory_name())}
+                      .filePath(instance_db_name)},
+      daemon_rpc{config->server_address, *config->cert_provider, config->client_cert_store.get()},
+      instance_mod_handler{register_instance_mod(vm_instance_specs, operative_instances, deleted_instances,
+                                                 preparing_instances, [this] { persist_instances(); })}
+{
+    launch_pool.setMaxThreadCount(max_concurrent_launches);
+    background_pool.setMaxThreadCount(max_concurrent_background_tasks);
+    exec_pool.setMaxThreadCount(max_concurrent_execs);
+    apply_pool.setMaxThreadCount(max_concurrent_apply_steps);
+
+    connect_rpc(daemon_rpc, *this);
+    std::vector<std::string> invalid_specs;
+
+    try
+    {
+        config->factory->hypervisor_health_check();
+    }
+    catch (const std::runtime_error& e)
+    {
+        mpl::log(mpl::Level::warning, category, fmt::format("Hypervisor health check failed: {}", e.what()));
+    }
+
+    for (auto& entry : vm_instance_specs)
+    {
+        const auto& name = entry.first;
+        auto& spec = entry.second;
+
+        if (!config->vault->has_record_for(name))
+        {
+            invalid_specs.push_back(name);
+            continue;
+        }
+
+        // Check that all the interfaces in the instance have different MAC address, and that they were not used in
+        // the other instances. String validity was already checked in load_db(). Add these MAC's to the daemon's set
+        // only if this instance is not invalid.
+        auto new_macs = mac_set_from(spec);
+
+        if (new_macs.size() <= spec.extra_interfaces.size() || !merge_if_disjoint(new_macs, allocated_mac_addrs))
+        {
+            // There is at least one repeated address in new_macs.
+            mpl::log(mpl::Level::warning, category, fmt::format("{} has repeated MAC addresses", name));
+            invalid_specs.push_back(name);
+            continue;
+        }
+
+        auto vm_image = fetch_image_for(name, config->factory->fetch_type(), *config->vault);
+        if (!vm_image.image_path.isEmpty() && !QFile::exists(vm_image.image_path))
+        {
+            mpl::log(mpl::Level::warning, category,
+                     fmt::format("Could not find image for '{}'. Expected location: {}", name, vm_image.image_path));
+            invalid_specs.push_back(name);
+            continue;
+        }
+
+        const auto instance_dir = mp::utils::base_dir(vm_image.image_path);
+        const auto cloud_init_iso = instance_dir.filePath("cloud-init-config.iso");
+        mp::VirtualMachineDescription vm_desc{spec.num_cores,
+                                              spec.mem_size,
+                                              spec.disk_space,
+                                              name,
+                                              spec.default_mac_address,
+                                              spec.extra_interfaces,
+                                              spec.ssh_username,
+                                              vm_image,
+                                              cloud_init_iso,
+                                              {},
+                                              {},
+                                              {},
+                                              {}};
+
+        auto& instance_record = spec.deleted ? deleted_instances : spec.warm ? warm_instances : operative_instances;
+        instance_record[name] = config->factory->create_virtual_machine(vm_desc, *this);
+
+        allocated_mac_addrs = std::move(new_macs); // Add the new macs to the daemon's list only if we got this far
+
+        // Even if it was still warming up, whoever takes it boots it and waits for it like any new instance
+        if (spec.warm)
+        {
+            preparing_instances.insert(name);
+            continue;
+        }
+
+        // FIXME: somehow we're writing contradictory state to disk.
+        if (spec.deleted && spec.state != VirtualMachine::State::stopped)
+        {
+            mpl::log(mpl::Level::warning, category,
+                     fmt::format("{} is deleted but has incompatible state {}, resetting state to 0 (stopped)", name,
+                                 static_cast<int>(spec.state)));
+            spec.state = VirtualMachine::State::stopped;
+        }
+
+        if (!spec.deleted)
+            init_mounts(name);
+
+        // Asking the backend about the instance and starting it is left for later, not to hold up clients meanwhile
+        if (spec.state == VirtualMachine::State::running)
+        {
+            assert(!spec.deleted);
+            instances_to_restore.push_back(name);
+
+            // Backends that took back what was left running have nothing to start, only what the daemon serves it
+            if (instance_record[name]->state == VirtualMachine::State::running)
+                reattached_instances.insert(name);
+        }
+    }
+
+    for (const auto& bad_spec : invalid_specs)
+    {
+        mpl::log(mpl::Level::warning, category, fmt::format("Removing invalid instance: {}", bad_spec));
+        vm_instance_specs.erase(bad_spec);
+    }
+
+    if (!invalid_specs.empty())
+        persist_instances();
+    else
+        take_instance_snapshot();
+
+    // One at a time once the event loop runs, so that requests queued up in between are not kept waiting for all
+    interactive_first(instances_to_restore, vm_instance_specs);
+    if (!instances_to_restore.empty())
+        QTimer::singleShot(0, this, [this] { restore_next_instance(); });
 
     config->vault->prune_expired_images();
+    empty_trash(); // left over from before a crash
+    tune_memory_merging();
+
+    // Suspended rather than left to wake up to clocks and connections gone stale
+    if (MP_PLATFORM.watch_host_sleep(this, SLOT(on_host_sleep(bool))))
+        MP_PLATFORM.hold_host_sleep(true);
 
     // Fire timer every six hours to perform maintenance on source images such as
     // pruning expired images and updating to newly released images.
     connect(&source_images_maintenance_task, &QTimer::timeout, [this]() {
+        source_images_maintenance_task.setInterval(jittered(config->image_refresh_timer));
+        fill_warm_pool();
+        evict_images();
+
         if (image_update_future.isRunning())
         {
             mpl::log(mpl::Level::info, category, "Image updater already running. Skipping…");
         }
         else
         {
-            image_update_future = QtConcurrent::run([this] {
+            image_update_future = run_in_background(background_pool, [this] {
                 config->vault->prune_expired_images();
 
+                // Looked up again as they are next asked for, against the manifests as they are now
+                {
+                    std::lock_guard<std::mutex> lock{release_titles_mutex};
+                    release_titles.clear();
+                }
+
                 auto prepare_action = [this](const VMImage& source_image) -> VMImage {
                     return config->factory->prepare_source_image(source_image);
                 };
 
                 auto download_monitor = [](int download_type, int percentage) {
-                    static int last_percentage_logged = -1;
+                    // Images are refreshed concurrently, all reporting here
+                    static std::atomic_int last_percentage_logged{-1};
                     if (percentage % 10 == 0)
                     {
                         // Note: The progress callback may be called repeatedly with the same percentage,
                         // so this logic is to only log it once
-                        if (last_percentage_logged != percentage)
-                        {
+                        if (last_percentage_logged.exchange(percentage) != percentage)
                             mpl::log(mpl::Level::info, category, fmt::format("  {}%", percentage));
-                            last_percentage_logged = percentage;
-                        }
                     }
                     return true;
                 };
@@ -1332,14 +2184,48 @@ mp::Daemon::Daemon(std::unique_ptr<const DaemonConfig> the_config)
                 {
                     mpl::log(mpl::Level::error, category, fmt::format("Error updating images: {}", e.what()));
                 }
+
+                // Fetched and prepared ahead, so that launching from them only takes making the instance image
+                for (const auto& entry : MP_SETTINGS.get(mp::image_prewarm_key).split(',', QString::SkipEmptyParts))
+                {
+                    try
+                    {
+                        mpl::log(mpl::Level::debug, category, fmt::format("Prewarming image {}", entry));
+                        config->vault->fetch_image(
+                            config->factory->fetch_type(),
+                            prewarm_query_for(entry.trimmed().toStdString(), *config->blueprint_provider),
+                            prepare_action, download_monitor, false, std::nullopt);
+                    }
+                    catch (const std::exception& e)
+                    {
+                        mpl::log(mpl::Level::warning, category,
+                                 fmt::format("Cannot prewarm image {}: {}", entry, e.what()));
+                    }
+                }
             });
         }
     });
-    source_images_maintenance_task.start(config->image_refresh_timer);
+    source_images_maintenance_task.start(jittered(config->image_refresh_timer));
+
+    connect(&idle_check_timer, &QTimer::timeout, this, &Daemon::check_idle_instances);
+    idle_check_timer.start(std::chrono::minutes{1});
 }
 
 mp::Daemon::~Daemon()
 {
+    {
+        std::lock_guard<std::mutex> lock{instance_snapshot_mutex};
+        stop_watching = true;
+    }
+    instance_changed.notify_all();
+    stop_execs = true;
+    stop_applies = true;
+
+    read_only_pool.waitForDone();
+    launch_pool.waitForDone();
+    background_pool.waitForDone();
+    exec_pool.waitForDone();
+    apply_pool.waitForDone();
     mp::top_catch_all(category, [this] { MP_SETTINGS.unregister_handler(instance_mod_handler); });
 }
 
@@ -1362,6 +2248,9 @@ void mp::Daemon::launch(const LaunchRequest* request,
                         std::promise<grpc::Status>* status_promise) // clang-format off
 try // clang-format on
 {
+    if (request->count() > 1)
+        return launch_batch(request, server, status_promise);
+
     mpl::ClientLogger<LaunchReply, LaunchRequest> logger{mpl::level_from(request->verbosity_level()), *config->logger,
                                                          server};
 
@@ -1387,18 +2276,31 @@ void mp::Daemon::purge(const PurgeRequest* request, grpc::ServerReaderWriterInte
 try // clang-format on
 {
     PurgeReply response;
+    fmt::memory_buffer errors;
 
-    for (const auto& del : deleted_instances)
+    for (auto it = deleted_instances.begin(); it != deleted_instances.end();)
     {
-        release_resources(del.first);
-        response.add_purged_instances(del.first);
+        // Its disk is not to go from under whatever is being done to it
+        if (const auto busy = disk_busy_instances.find(it->first);
+            busy != disk_busy_instances.end() || cloning_instances.count(it->first))
+        {
+            fmt::format_to(std::back_inserter(errors), "Cannot purge the instance '{}' while {} it\n", it->first,
+                           busy != disk_busy_instances.end() ? busy->second : "cloning");
+            ++it;
+            continue;
+        }
+
+        release_resources(it->first);
+        response.add_purged_instances(it->first);
+        it = deleted_instances.erase(it);
     }
 
-    deleted_instances.clear();
     persist_instances();
 
     server->Write(response);
-    status_promise->set_value(grpc::Status::OK);
+    status_promise->set_value(errors.size() ? grpc::Status{grpc::StatusCode::FAILED_PRECONDITION,
+                                                           fmt::to_string(errors), ""}
+                                            : grpc::Status::OK);
 }
 catch (const std::exception& e)
 {
@@ -1411,12 +2313,27 @@ try // clang-format on
 {
     mpl::ClientLogger<FindReply, FindRequest> logger{mpl::level_from(request->verbosity_level()), *config->logger,
                                                      server};
-    FindReply response;
+    google::protobuf::Arena arena{reply_arena_options()};
+    auto& response = *google::protobuf::Arena::CreateMessage<FindReply>(&arena);
     response.set_show_images(request->show_images());
     response.set_show_blueprints(request->show_blueprints());
 
     const auto default_remote{"release"};
 
+    // With a chunk size, what was found goes out in replies that big, rather than all together at the end
+    auto add_found = [request, server, &response](auto* container, const std::string& remote_name,
+                                                  const VMImageInfo& info, const std::string& default_remote) {
+        add_aliases(container, remote_name, info, default_remote);
+
+        if (const auto chunk_size = static_cast<int>(request->chunk_size());
+            chunk_size > 0 && response.images_info_size() + response.blueprints_info_size() >= chunk_size)
+        {
+            server->Write(response);
+            response.clear_images_info();
+            response.clear_blueprints_info();
+        }
+    };
+
     if (!request->search_string().empty())
     {
         if (!request->remote_name().empty())
@@ -1449,6 +2366,9 @@ try // clang-format on
 
             for (auto& [remote, info] : vm_images_info)
             {
+                if (!passes_find_filters(*request, info))
+                    continue;
+
                 if (info.aliases.contains(QString::fromStdString(request->search_string())))
                     info.aliases = QStringList({QString::fromStdString(request->search_string())});
                 else
@@ -1460,7 +2380,7 @@ try // clang-format on
                         ? remote
                         : "";
 
-                add_aliases(response.mutable_images_info(), remote_name, info, "");
+                add_found(response.mutable_images_info(), remote_name, info, "");
             }
         }
 
@@ -1478,14 +2398,14 @@ try // clang-format on
                                      request->search_string(), e.what()));
             }
 
-            if (info)
+            if (info && passes_find_filters(*request, *info))
             {
                 if ((*info).aliases.contains(QString::fromStdString(request->search_string())))
                     (*info).aliases = QStringList({QString::fromStdString(request->search_string())});
                 else
                     (*info).aliases = QStringList({(*info).id.left(12)});
 
-                add_aliases(response.mutable_blueprints_info(), "", *info, "");
+                add_found(response.mutable_blueprints_info(), "", *info, "");
             }
         }
     }
@@ -1496,12 +2416,13 @@ try // clang-format on
             for (const auto& image_host : config->image_hosts)
             {
                 std::unordered_set<std::string> images_found;
-                auto action = [&images_found, &default_remote, request, &response](const std::string& remote,
-                                                                                   const mp::VMImageInfo& info) {
+                auto action = [&images_found, &default_remote, request, &response, &add_found](
+                                  const std::string& remote, const mp::VMImageInfo& info) {
                     if ((info.supported || request->allow_unsupported()) && !info.aliases.empty() &&
-                        images_found.find(info.release_title.toStdString()) == images_found.end())
+                        images_found.find(info.release_title.toStdString()) == images_found.end() &&
+                        passes_find_filters(*request, info))
                     {
-                        add_aliases(response.mutable_images_info(), remote, info, default_remote);
+                        add_found(response.mutable_images_info(), remote, info, default_remote);
                         images_found.insert(info.release_title.toStdString());
                     }
                 };
@@ -1515,7 +2436,8 @@ try // clang-format on
             auto vm_blueprints_info = config->blueprint_provider->all_blueprints();
 
             for (const auto& info : vm_blueprints_info)
-                add_aliases(response.mutable_blueprints_info(), "", info, "");
+                if (passes_find_filters(*request, info))
+                    add_found(response.mutable_blueprints_info(), "", info, "");
         }
     }
     else
@@ -1525,7 +2447,8 @@ try // clang-format on
         auto vm_images_info = image_host->all_images_for(remote, request->allow_unsupported());
 
         for (const auto& info : vm_images_info)
-            add_aliases(response.mutable_images_info(), remote, info, "");
+            if (passes_find_filters(*request, info))
+                add_found(response.mutable_images_info(), remote, info, "");
     }
 
     server->Write(response);
@@ -1540,15 +2463,27 @@ void mp::Daemon::info(const InfoRequest* request, grpc::ServerReaderWriterInterf
                       std::promise<grpc::Status>* status_promise) // clang-format off
 try // clang-format on
 {
-    mpl::ClientLogger<InfoReply, InfoRequest> logger{mpl::level_from(request->verbosity_level()), *config->logger,
-                                                     server};
-    InfoReply response;
+    auto logger = std::make_shared<mpl::ClientLogger<InfoReply, InfoRequest>>(
+        mpl::level_from(request->verbosity_level()), *config->logger, server);
+    // Shared with the probes and whoever writes the reply, which may all be on other threads: arenas allow for that
+    auto arena = std::make_shared<google::protobuf::Arena>(reply_arena_options());
+    auto response = google::protobuf::Arena::CreateMessage<InfoReply>(arena.get());
     bool have_mounts = false;
     bool deleted = false;
+    const ReplyFields fields{request->fields(), *InfoReply::Info::descriptor()};
+    const auto want_runtime_info = fields.wanted("load", "memory_usage", "memory_total", "disk_usage", "disk_total",
+                                                 "cpu_count", "current_release");
+    const auto want_ipv4 = fields.wanted("ipv4");
+    NamePage page;
+    // after the response they fill in, so that they are done with it first
+    auto probes = std::make_shared<std::vector<std::function<void()>>>();
     auto fetch_info = [&](VirtualMachine& vm) {
         const auto& name = vm.vm_name;
-        auto info = response.add_info();
-        auto present_state = vm.current_state();
+        if (!page.holds(name))
+            return grpc::Status::OK;
+
+        auto info = response->add_info();
+        auto present_state = vm.cached_state();
         info->set_name(name);
         if (deleted)
         {
@@ -1559,36 +2494,35 @@ try // clang-format on
             info->mutable_instance_status()->set_status(grpc_instance_status_for(present_state));
         }
 
-        auto vm_image = fetch_image_for(name, config->factory->fetch_type(), *config->vault);
-        auto original_release = vm_image.original_release;
-
-        if (!vm_image.id.empty() && original_release.empty())
+        std::string original_release;
+        if (fields.wanted("image_release", "id", "current_release"))
         {
-            try
-            {
-                auto vm_image_info = config->image_hosts.back()->info_for_full_hash(vm_image.id);
-                original_release = vm_image_info.release_title.toStdString();
-            }
-            catch (const std::exception& e)
-            {
-                mpl::log(mpl::Level::warning, category, fmt::format("Cannot fetch image information: {}", e.what()));
-            }
+            auto vm_image = fetch_image_for(name, config->factory->fetch_type(), *config->vault);
+            original_release = release_title_for(vm_image);
+
+            if (fields.wanted("image_release"))
+                info->set_image_release(original_release);
+            if (fields.wanted("id"))
+                info->set_id(std::move(vm_image.id));
         }
 
-        info->set_image_release(original_release);
-        info->set_id(vm_image.id);
+        if (const auto limit = vm.network_limit(); limit && fields.wanted("network_limit"))
+            info->set_network_limit(std::to_string(limit));
+        if (const auto limit = vm.disk_iops_limit(); limit && fields.wanted("disk_iops_limit"))
+            info->set_disk_iops_limit(std::to_string(limit));
 
         auto vm_specs = vm_instance_specs[name];
 
-        auto mount_info = info->mutable_mount_info();
+        const auto want_mounts = fields.wanted("mount_info");
+        if (want_mounts)
+            info->mutable_mount_info()->set_longest_path_len(0);
 
-        mount_info->set_longest_path_len(0);
-
-        if (!vm_specs.mounts.empty())
+        if (want_mounts && !vm_specs.mounts.empty())
             have_mounts = true;
 
-        if (MP_SETTINGS.get_as<bool>(mp::mounts_key))
+        if (want_mounts && MP_SETTINGS.get_as<bool>(mp::mounts_key))
         {
+            auto mount_info = info->mutable_mount_info();
             for (const auto& mount : vm_specs.mounts)
             {
                 if (mount.second.source_path.size() > mount_info->longest_path_len())
@@ -1599,6 +2533,14 @@ try // clang-format on
                 auto entry = mount_info->add_mount_paths();
                 entry->set_source_path(mount.second.source_path);
                 entry->set_target_path(mount.first);
+                entry->set_mount_type(mount.second.mount_type == VMMount::MountType::Classic
+                                          ? MountRequest_MountType_CLASSIC
+                                          : MountRequest_MountType_NATIVE);
+
+                if (auto vm_mounts = mounts.find(name); vm_mounts != mounts.end())
+                    if (auto it = vm_mounts->second.find(mount.first); it != vm_mounts->second.end())
+                        if (auto stats = it->second->stats())
+                            *entry->mutable_mount_stats() = std::move(*stats);
 
                 for (const auto& uid_mapping : mount.second.uid_mappings)
                 {
@@ -1617,32 +2559,51 @@ try // clang-format on
 
         if (!request->no_runtime_information() && mp::utils::is_running(present_state))
         {
-            mp::SSHSession session{vm.ssh_hostname(), vm.ssh_port(), vm_specs.ssh_username, *config->ssh_key_provider};
+            // From the host's side and over QMP, before the probe has the reply to itself
+            if (fields.wanted("host_stats"))
+                if (const auto host_stats = vm.host_stats())
+                    set_host_stats(info->mutable_host_stats(), *host_stats);
+
+            if (!want_runtime_info && !want_ipv4)
+                return grpc::Status::OK;
+
+            // Held on to, in case the instance goes while it is still being asked
+            auto vm_ptr = (deleted ? deleted_instances : operative_instances).at(name);
+            auto probe = [this, info, vm_ptr = std::move(vm_ptr), host = vm.ssh_hostname(), port = vm.ssh_port(),
+                          username = vm_specs.ssh_username, management_ip = vm.management_ipv4(), original_release,
+                          want_runtime_info, want_ipv4] {
+                // Backends that can ask the guest directly spare it an SSH session, SSH gets what they can't
+                auto probe_output = want_runtime_info ? vm_ptr->guest_exec(instance_probe_cmd) : std::string{};
+                auto all_ipv4 = want_ipv4 ? vm_ptr->guest_ipv4() : std::vector<std::string>{};
+                if (!probe_output || !all_ipv4)
+                {
+                    auto ask_over_ssh = [&](mp::SSHSession& session) {
+                        if (!probe_output)
+                            probe_output = mpu::run_in_ssh_session(session, instance_probe_cmd);
+                        if (!all_ipv4)
+                            all_ipv4 = get_extra_ipv4(*vm_ptr, session);
+                    };
+                    ssh_sessions.with_session(vm_ptr->vm_name, host, port, username, *config->ssh_key_provider,
+                                              ask_over_ssh);
+                }
 
-            info->set_load(mpu::run_in_ssh_session(session, "cat /proc/loadavg | cut -d ' ' -f1-3"));
-            info->set_memory_usage(mpu::run_in_ssh_session(session, "free -b | grep 'Mem:' | awk '{printf $3}'"));
-            info->set_memory_total(mpu::run_in_ssh_session(session, "free -b | grep 'Mem:' | awk '{printf $2}'"));
-            info->set_disk_usage(
-                mpu::run_in_ssh_session(session, "df -t ext4 -t vfat --total -B1 --output=used | tail -n 1"));
-            info->set_disk_total(
-                mpu::run_in_ssh_session(session, "df -t ext4 -t vfat --total -B1 --output=size | tail -n 1"));
-            info->set_cpu_count(mpu::run_in_ssh_session(session, "nproc"));
+                if (want_runtime_info)
+                    set_runtime_info(info, *probe_output, original_release);
 
-            std::string management_ip = vm.management_ipv4();
-            auto all_ipv4 = vm.get_all_ipv4(*config->ssh_key_provider);
+                if (!want_ipv4)
+                    return;
 
-            if (is_ipv4_valid(management_ip))
-                info->add_ipv4(management_ip);
-            else if (all_ipv4.empty())
-                info->add_ipv4("N/A");
+                if (is_ipv4_valid(management_ip))
+                    info->add_ipv4(management_ip);
+                else if (all_ipv4->empty())
+                    info->add_ipv4("N/A");
 
-            for (const auto& extra_ipv4 : all_ipv4)
-                if (extra_ipv4 != management_ip)
-                    info->add_ipv4(extra_ipv4);
+                for (const auto& extra_ipv4 : *all_ipv4)
+                    if (extra_ipv4 != management_ip)
+                        info->add_ipv4(extra_ipv4);
+            };
 
-            auto current_release =
-                mpu::run_in_ssh_session(session, "cat /etc/os-release | grep 'PRETTY_NAME' | cut -d \\\" -f2");
-            info->set_current_release(!current_release.empty() ? current_release : original_release);
+            probes->push_back(std::move(probe));
         }
         return grpc::Status::OK;
     };
@@ -1653,14 +2614,48 @@ try // clang-format on
 
     if (status.ok())
     {
+        std::vector<std::string> names;
+        for (const auto& it : instance_selection.operative_selection)
+            names.push_back(it->first);
+        for (const auto& it : instance_selection.deleted_selection)
+            names.push_back(it->first);
+        page = page_of(std::move(names), request->page_token(), request->page_size());
+        response->set_next_page_token(page.last);
+
+        std::vector<VirtualMachine*> vms;
+        for (const auto& it : instance_selection.operative_selection)
+            if (page.holds(it->first))
+                vms.push_back(it->second.get());
+        config->factory->refresh_states(vms); // all at once, where the backend can
+
         cmd_vms(instance_selection.operative_selection, fetch_info);
         deleted = true;
         cmd_vms(instance_selection.deleted_selection, fetch_info);
 
-        if (have_mounts && !MP_SETTINGS.get_as<bool>(mp::mounts_key))
-            mpl::log(mpl::Level::error, category, "Mounts have been disabled on this instance of Multipass");
+        // Asking the instances is left to another thread, the main one has other requests to get to. Up to
+        // bulk_parallelism() are asked at a time, the first to fail fails the request.
+        const auto parallelism = probes->empty() ? 1 : bulk_parallelism();
+        QtConcurrent::run(&read_only_pool, [logger, arena, response, probes, parallelism, have_mounts, server,
+                                            status_promise]() mutable {
+            auto result = grpc::Status::OK;
+            try
+            {
+                mpu::run_concurrently(*probes, parallelism);
 
-        server->Write(response);
+                if (have_mounts && !MP_SETTINGS.get_as<bool>(mp::mounts_key))
+                    mpl::log(mpl::Level::error, category, "Mounts have been disabled on this instance of Multipass");
+
+                server->Write(*response);
+            }
+            catch (const std::exception& e)
+            {
+                result = grpc::Status(grpc::StatusCode::FAILED_PRECONDITION, e.what(), "");
+            }
+
+            logger.reset(); // nothing is to be logged to the client once it has its answer
+            status_promise->set_value(result);
+        });
+        return;
     }
 
     status_promise->set_value(status);
@@ -1676,61 +2671,103 @@ try // clang-format on
 {
     mpl::ClientLogger<ListReply, ListRequest> logger{mpl::level_from(request->verbosity_level()), *config->logger,
                                                      server};
-    ListReply response;
+    google::protobuf::Arena arena{reply_arena_options()};
+    auto& response = *google::protobuf::Arena::CreateMessage<ListReply>(&arena);
     config->update_prompt->populate_if_time_to_show(response.mutable_update_info());
 
-    for (const auto& instance : operative_instances)
-    {
-        const auto& name = instance.first;
-        const auto& vm = instance.second;
-        auto present_state = vm->current_state();
+    // Answered on an RPC thread, from what the main thread last saw of the instances. Changes from outside, which
+    // no backend reports, show from the next listing on.
+    const auto snapshot = instance_snapshot();
+    retake_instance_snapshot();
+    const ReplyFields fields{request->fields(), *ListVMInstance::descriptor()};
+
+    std::vector<std::string> names{snapshot->deleted};
+    for (const auto& instance : snapshot->operative)
+        names.push_back(instance.name);
+    const auto page = page_of(std::move(names), request->page_token(), request->page_size());
+
+    // Clients that ask for it get the instances in chunks, to show them as they come rather than all at the end
+    const auto chunk_size = static_cast<int>(request->chunk_size());
+    auto write_if_full = [&response, chunk_size, server] {
+        if (chunk_size > 0 && response.instances_size() >= chunk_size)
+        {
+            server->Write(response);
+            response.clear_instances();
+            response.clear_update_info();
+        }
+    };
+
+    auto add_operative = [&](const InstanceSnapshot::Instance& instance) {
+        if (!page.holds(instance.name))
+            return;
+
+        write_if_full();
+
+        const auto& name = instance.name;
         auto entry = response.add_instances();
         entry->set_name(name);
-        entry->mutable_instance_status()->set_status(grpc_instance_status_for(present_state));
+        entry->mutable_instance_status()->set_status(grpc_instance_status_for(instance.state));
 
         // FIXME: Set the release to the cached current version when supported
-        auto vm_image = fetch_image_for(name, config->factory->fetch_type(), *config->vault);
-        auto current_release = vm_image.original_release;
+        if (fields.wanted("current_release"))
+        {
+            auto vm_image = fetch_image_for(name, config->factory->fetch_type(), *config->vault);
+            entry->set_current_release(release_title_for(vm_image));
+        }
 
-        if (!vm_image.id.empty() && current_release.empty())
+        if (request->request_ipv4() && fields.wanted("ipv4") && mp::utils::is_running(instance.state))
         {
+            const auto& management_ip = instance.management_ipv4;
+            std::vector<std::string> all_ipv4;
             try
             {
-                auto vm_image_info = config->image_hosts.back()->info_for_full_hash(vm_image.id);
-                current_release = vm_image_info.release_title.toStdString();
+                // Over the management address, which is what instances are reached by
+                if (!management_ip.empty())
+                    ssh_sessions.with_session(
+                        name, management_ip, instance.ssh_port, instance.ssh_username, *config->ssh_key_provider,
+                        [&all_ipv4](mp::SSHSession& session) { all_ipv4 = mp::utils::ipv4_addresses_in(session); });
             }
             catch (const std::exception& e)
             {
-                mpl::log(mpl::Level::warning, category, fmt::format("Cannot fetch image information: {}", e.what()));
+                mpl::log(mpl::Level::debug, category,
+                         fmt::format("Error getting extra IP addresses of \"{}\": {}", name, e.what()));
             }
-        }
-
-        entry->set_current_release(current_release);
 
-        if (request->request_ipv4() && mp::utils::is_running(present_state))
-        {
-            std::string management_ip = vm->management_ipv4();
-            auto all_ipv4 = vm->get_all_ipv4(*config->ssh_key_provider);
-
-            if (is_ipv4_valid(management_ip))
+            if (!management_ip.empty())
                 entry->add_ipv4(management_ip);
-            else if (all_ipv4.empty())
+            else
                 entry->add_ipv4("N/A");
 
-            for (const auto& extra_ipv4 : all_ipv4)
+            for (auto& extra_ipv4 : all_ipv4)
                 if (extra_ipv4 != management_ip)
-                    entry->add_ipv4(extra_ipv4);
+                    entry->add_ipv4(std::move(extra_ipv4));
         }
-    }
+    };
+
+    auto add_deleted = [&](const std::string& name) {
+        if (!page.holds(name))
+            return;
+
+        write_if_full();
 
-    for (const auto& instance : deleted_instances)
-    {
-        const auto& name = instance.first;
         auto entry = response.add_instances();
         entry->set_name(name);
         entry->mutable_instance_status()->set_status(mp::InstanceStatus::DELETED);
+    };
+
+    // Both are sorted by name, so merging them sends the instances in order across chunks, not just within them
+    auto operative_it = snapshot->operative.cbegin();
+    auto deleted_it = snapshot->deleted.cbegin();
+    while (operative_it != snapshot->operative.cend() || deleted_it != snapshot->deleted.cend())
+    {
+        if (deleted_it == snapshot->deleted.cend() ||
+            (operative_it != snapshot->operative.cend() && operative_it->name < *deleted_it))
+            add_operative(*operative_it++);
+        else
+            add_deleted(*deleted_it++);
     }
 
+    response.set_next_page_token(page.last);
     server->Write(response);
     status_promise->set_value(grpc::Status::OK);
 }
@@ -1746,21 +2783,32 @@ try // clang-format on
 {
     mpl::ClientLogger<NetworksReply, NetworksRequest> logger{mpl::level_from(request->verbosity_level()),
                                                              *config->logger, server};
-    NetworksReply response;
+    google::protobuf::Arena arena{reply_arena_options()};
+    auto& response = *google::protobuf::Arena::CreateMessage<NetworksReply>(&arena);
     config->update_prompt->populate_if_time_to_show(response.mutable_update_info());
 
-    if (!instances_running(operative_instances))
+    const auto snapshot = instance_snapshot();
+    if (std::none_of(snapshot->operative.cbegin(), snapshot->operative.cend(),
+                     [](const auto& instance) { return mp::utils::is_running(instance.state); }))
         config->factory->hypervisor_health_check();
 
-    const auto& iface_list = config->factory->networks();
+    auto iface_list = config->factory->networks();
 
-    for (const auto& iface : iface_list)
+    std::vector<std::string> names;
+    for (auto& iface : iface_list)
     {
         auto entry = response.add_interfaces();
         entry->set_name(iface.id);
-        entry->set_type(iface.type);
-        entry->set_description(iface.description);
+        entry->set_type(std::move(iface.type));
+        entry->set_description(std::move(iface.description));
+        names.push_back(std::move(iface.id));
+    }
+
+    {
+        std::lock_guard<std::mutex> lock{completion_cache_mutex};
+        known_networks = std::move(names);
     }
+    update_completion_cache();
 
     server->Write(response);
     status_promise->set_value(grpc::Status::OK);
@@ -1792,6 +2840,7 @@ try // clang-format on
         gid_mappings.push_back({map.host_id(), map.instance_id()});
 
     fmt::memory_buffer errors;
+    std::unordered_set<std::string> mounted_on;
     for (const auto& path_entry : request->target_paths())
     {
         const auto& name = path_entry.instance_name();
@@ -1821,7 +2870,24 @@ try // clang-format on
         const auto mount_type = request->mount_type() == MountRequest_MountType_CLASSIC ? VMMount::MountType::Classic
                                                                                         : VMMount::MountType::Native;
 
-        VMMount vm_mount{request->source_path(), gid_mappings, uid_mappings, mount_type};
+        const auto& mount_profile = request->mount_profile();
+        if (!mount_profile.empty())
+        {
+            const auto& profiles = SSHFSMountHandler::mount_profiles();
+            if (mount_type != VMMount::MountType::Classic)
+            {
+                add_fmt_to(errors, "mount profiles only apply to classic mounts");
+                continue;
+            }
+            if (std::find(profiles.cbegin(), profiles.cend(), mount_profile) == profiles.cend())
+            {
+                add_fmt_to(errors, "unknown mount profile \"{}\", expected one of: {}", mount_profile,
+                           fmt::join(profiles, ", "));
+                continue;
+            }
+        }
+
+        VMMount vm_mount{request->source_path(), gid_mappings, uid_mappings, mount_type, mount_profile};
         vm_mounts[target_path] = make_mount(vm.get(), target_path, vm_mount);
         if (vm->current_state() == mp::VirtualMachine::State::running ||
             vm_mounts[target_path]->is_mount_managed_by_backend())
@@ -1843,9 +2909,12 @@ try // clang-format on
         }
 
         vm_instance_specs[name].mounts[target_path] = vm_mount;
+        mounted_on.insert(name);
     }
 
-    persist_instances();
+    for (const auto& name : mounted_on)
+        persist_instance(name);
+    take_instance_snapshot();
 
     status_promise->set_value(grpc_status_for(errors));
 }
@@ -1904,6 +2973,46 @@ try // clang-format on
 
     if (status.ok())
     {
+        // Instances the daemon suspended for sitting idle are resumed for whoever wants in, and answered once up
+        std::vector<std::string> resuming;
+        for (auto& vm_it : instance_selection.operative_selection)
+        {
+            const auto& name = vm_it->first;
+            idle_monitor.touch(name);
+
+            auto& idle_suspended = vm_instance_specs[name].idle_suspended;
+            if (std::exchange(idle_suspended, false) &&
+                vm_it->second->current_state() == VirtualMachine::State::suspended)
+            {
+                mpl::log(mpl::Level::info, category, fmt::format("Resuming {}, which was suspended while idle", name));
+                vm_it->second->start();
+                resuming.push_back(name);
+            }
+        }
+
+        if (!resuming.empty())
+            persist_instances();
+
+        if (!resuming.empty())
+        {
+            auto future_watcher = create_future_watcher([this, request, server] {
+                auto [instance_selection, status] =
+                    select_instances_and_react(operative_instances, deleted_instances, request->instance_name(),
+                                               InstanceGroup::None, require_operative_instances_reaction);
+
+                SSHInfoReply response;
+                auto operation =
+                    std::bind(&Daemon::get_ssh_info_for_vm, this, std::placeholders::_1, std::ref(response));
+                if (status.ok() && cmd_vms(instance_selection.operative_selection, operation).ok())
+                    server->Write(response);
+            });
+            future_watcher->setFuture(QtConcurrent::run(this,
+                                                        &Daemon::async_wait_for_ready_all<StartReply, StartRequest>,
+                                                        nullptr, resuming, mp::default_timeout, status_promise,
+                                                        std::string()));
+            return;
+        }
+
         SSHInfoReply response;
         auto operation = std::bind(&Daemon::get_ssh_info_for_vm, this, std::placeholders::_1, std::ref(response));
         if ((status = cmd_vms(instance_selection.operative_selection, operation)).ok())
@@ -1971,6 +3080,20 @@ try // clang-format on
         case VirtualMachine::State::restarting:
             break;
         default:
+            if (cloning_instances.count(name))
+            {
+                fmt::format_to(std::back_inserter(start_errors), "Cannot start the instance \'{}\' while cloning it",
+                               name);
+                continue;
+            }
+
+            if (const auto busy = disk_busy_instances.find(name); busy != disk_busy_instances.end())
+            {
+                fmt::format_to(std::back_inserter(start_errors), "Cannot start the instance \'{}\' while {} it", name,
+                               busy->second);
+                continue;
+            }
+
             if (complain_disabled_mounts && !vm_instance_specs[name].mounts.empty())
             {
                 complain_disabled_mounts = false; // I shall say zis only once
@@ -2012,11 +3135,38 @@ try // clang-format on
         std::function<grpc::Status(VirtualMachine&)> operation;
         if (request->cancel_shutdown())
             operation = std::bind(&Daemon::cancel_vm_shutdown, this, std::placeholders::_1);
-        else
+        else if (request->time_minutes() > 0)
             operation = std::bind(&Daemon::shutdown_vm, this, std::placeholders::_1,
                                   std::chrono::minutes(request->time_minutes()));
 
-        status = cmd_vms(instance_selection.operative_selection, operation);
+        if (operation)
+            status = cmd_vms(instance_selection.operative_selection, operation);
+        else
+        {
+            // Shutting down waits for the instance to power off, so several are taken down at a time
+            LinearInstanceSelection stopping;
+            for (const auto& vm_it : instance_selection.operative_selection)
+            {
+                const auto& name = vm_it->first;
+                if (!needs_shutdown(vm_it->second->current_state()))
+                {
+                    mpl::log(mpl::Level::debug, category, fmt::format("instance \"{}\" does not need stopping", name));
+                    continue;
+                }
+
+                delayed_shutdown_instances.erase(name);
+                ssh_sessions.forget(name);
+                stopping.push_back(vm_it);
+            }
+
+            status = first_failure_in(cmd_vms_concurrently(
+                stopping,
+                [this](auto& vm) {
+                    make_shutdown_timer(vm)->start(std::chrono::milliseconds::zero());
+                    return grpc::Status::OK;
+                },
+                server, "Stopped"));
+        }
     }
 
     status_promise->set_value(status);
@@ -2040,12 +3190,17 @@ try // clang-format on
 
     if (status.ok())
     {
-        status = cmd_vms(instance_selection.operative_selection, [this](auto& vm) {
-            stop_mounts(vm.vm_name);
-
-            vm.suspend();
-            return grpc::Status::OK;
-        });
+        // Mount handlers live in this thread
+        for (const auto& vm_it : instance_selection.operative_selection)
+            stop_mounts(vm_it->first);
+
+        status = first_failure_in(cmd_vms_concurrently(
+            instance_selection.operative_selection,
+            [](auto& vm) {
+                vm.suspend();
+                return grpc::Status::OK;
+            },
+            server, "Suspended"));
     }
 
     status_promise->set_value(status);
@@ -2110,22 +3265,52 @@ try // clang-format on
         select_instances_and_react(operative_instances, deleted_instances, request->instance_names().instance_name(),
                                    InstanceGroup::All, require_existing_instances_reaction);
 
+    // Nothing is deleted while any of them has something done to its disk, or is being cloned, which is not to go
+    // from under it
+    for (const auto* selection : {&instance_selection.operative_selection, &instance_selection.deleted_selection})
+        for (const auto& vm_it : *selection)
+            if (const auto busy = disk_busy_instances.find(vm_it->first);
+                status.ok() && (busy != disk_busy_instances.end() || cloning_instances.count(vm_it->first)))
+                status = grpc::Status{grpc::StatusCode::FAILED_PRECONDITION,
+                                      fmt::format("Cannot delete the instance '{}' while {} it", vm_it->first,
+                                                  busy != disk_busy_instances.end() ? busy->second : "cloning"),
+                                      ""};
+
     if (status.ok())
     {
         const bool purge = request->purge();
 
         for (const auto& vm_it : instance_selection.operative_selection)
         {
+            if (vm_it->second->current_state() == VirtualMachine::State::delayed_shutdown)
+                delayed_shutdown_instances.erase(vm_it->first);
+
+            // Mount handlers live in this thread
+            if (auto mounts_it = mounts.find(vm_it->first); mounts_it != mounts.end())
+                mounts_it->second.clear();
+        }
+
+        const auto& operative_selection = instance_selection.operative_selection;
+        const auto shutdowns = cmd_vms_concurrently(
+            operative_selection,
+            [](auto& vm) {
+                vm.shutdown();
+                return grpc::Status::OK;
+            },
+            server, purge ? "Purged" : "Deleted");
+        status = first_failure_in(shutdowns);
+
+        for (std::size_t i = 0; i < operative_selection.size(); ++i)
+        {
+            // Those that could not be shut down are left as they are
+            if (!shutdowns[i].ok())
+                continue;
+
+            const auto& vm_it = operative_selection[i];
             const auto& name = vm_it->first;
             auto& instance = vm_it->second;
             assert(!vm_instance_specs[name].deleted);
 
-            if (instance->current_state() == VirtualMachine::State::delayed_shutdown)
-                delayed_shutdown_instances.erase(name);
-
-            mounts[name].clear();
-            instance->shutdown();
-
             if (purge)
             {
                 release_resources(name);
@@ -2172,6 +3357,7 @@ try // clang-format on
                                                          server};
 
     fmt::memory_buffer errors;
+    std::unordered_set<std::string> unmounted_from;
     for (const auto& path_entry : request->target_paths())
     {
         const auto& name = path_entry.instance_name();
@@ -2182,6 +3368,7 @@ try // clang-format on
             add_fmt_to(errors, "instance '{}' does not exist", name);
             continue;
         }
+        unmounted_from.insert(name);
 
         auto& vm_spec_mounts = vm_instance_specs[name].mounts;
         auto& vm_mounts = mounts[name];
@@ -2215,7 +3402,9 @@ try // clang-format on
             add_fmt_to(errors, "path \"{}\" is not mounted in '{}'", target_path, name);
     }
 
-    persist_instances();
+    for (const auto& name : unmounted_from)
+        persist_instance(name);
+    take_instance_snapshot();
 
     status_promise->set_value(grpc_status_for(errors));
 }
@@ -2247,11 +3436,25 @@ try
 
     GetReply reply;
 
-    auto key = request->key();
-    auto val = MP_SETTINGS.get(QString::fromStdString(key)).toStdString();
-    mpl::log(mpl::Level::debug, category, fmt::format("Returning setting {}={}", key, val));
+    if (request->keys_size())
+    {
+        std::set<QString> keys;
+        for (const auto& key : request->keys())
+            keys.insert(QString::fromStdString(key));
+
+        for (const auto& [key, val] : MP_SETTINGS.get_values(keys))
+            (*reply.mutable_values())[key.toStdString()] = val.toStdString();
+        mpl::log(mpl::Level::debug, category, fmt::format("Returning {} settings", reply.values_size()));
+    }
+    else
+    {
+        auto key = request->key();
+        auto val = MP_SETTINGS.get(QString::fromStdString(key)).toStdString();
+        mpl::log(mpl::Level::debug, category, fmt::format("Returning setting {}={}", key, val));
+
+        reply.set_value(val);
+    }
 
-    reply.set_value(val);
     server->Write(reply);
     status_promise->set_value(grpc::Status::OK);
 }
@@ -2271,12 +3474,35 @@ try
     mpl::ClientLogger<SetReply, SetRequest> logger{mpl::level_from(request->verbosity_level()), *config->logger,
                                                    server};
 
-    auto key = request->key();
-    auto val = request->val();
+    if (request->values_size())
+    {
+        std::map<QString, QString> values;
+        for (const auto& [key, val] : request->values())
+            values.emplace(QString::fromStdString(key), QString::fromStdString(val));
+
+        mpl::log(mpl::Level::trace, category, fmt::format("Trying to set {} settings", values.size()));
+        MP_SETTINGS.set_values(values);
+        mpl::log(mpl::Level::debug, category, fmt::format("Succeeded setting {} settings", values.size()));
+
+        if (request->values().count(mp::warm_pool_key))
+            fill_warm_pool();
+        if (request->values().count(mp::ksm_key) || request->values().count(mp::ksm_pages_to_scan_key))
+            tune_memory_merging();
+    }
+    else
+    {
+        auto key = request->key();
+        auto val = request->val();
+
+        mpl::log(mpl::Level::trace, category, fmt::format("Trying to set {}={}", key, val));
+        MP_SETTINGS.set(QString::fromStdString(key), QString::fromStdString(val));
+        mpl::log(mpl::Level::debug, category, fmt::format("Succeeded setting {}={}", key, val));
 
-    mpl::log(mpl::Level::trace, category, fmt::format("Trying to set {}={}", key, val));
-    MP_SETTINGS.set(QString::fromStdString(key), QString::fromStdString(val));
-    mpl::log(mpl::Level::debug, category, fmt::format("Succeeded setting {}={}", key, val));
+        if (key == mp::warm_pool_key)
+            fill_warm_pool();
+        if (key == mp::ksm_key || key == mp::ksm_pages_to_scan_key)
+            tune_memory_merging();
+    }
 
     status_promise->set_value(grpc::Status::OK);
 }
@@ -2347,152 +3573,1266 @@ catch (const std::exception& e)
     status_promise->set_value(grpc::Status(grpc::StatusCode::INTERNAL, e.what(), ""));
 }
 
-void mp::Daemon::on_shutdown()
+void mp::Daemon::watch(const WatchRequest* request, grpc::ServerReaderWriterInterface<WatchReply, WatchRequest>* server,
+                       std::promise<grpc::Status>* status_promise) // clang-format off
+try // clang-format on
 {
-}
+    // Answered on an RPC thread, for as long as the client stays. Each instance is compared with what was last sent
+    // about it, so that only what changed goes out.
+    std::unordered_map<std::string, std::string> last_sent;
+    std::uint64_t seen_changes;
+    {
+        std::lock_guard<std::mutex> lock{instance_snapshot_mutex};
+        seen_changes = instance_changes;
+    }
 
-void mp::Daemon::on_resume()
-{
-}
+    for (auto first = true;; first = false)
+    {
+        WatchReply reply;
+        std::unordered_set<std::string> present;
+        auto add_if_changed = [&reply, &present, &last_sent](WatchVMInstance& entry) {
+            present.insert(entry.name());
+            auto serialized = entry.SerializeAsString();
+            if (auto& sent = last_sent[entry.name()]; sent != serialized)
+            {
+                sent = std::move(serialized);
+                reply.add_instances()->Swap(&entry);
+            }
+        };
 
-void mp::Daemon::on_stop()
-{
-}
+        const auto snapshot = instance_snapshot();
+        for (const auto& instance : snapshot->operative)
+        {
+            WatchVMInstance entry;
+            entry.set_name(instance.name);
+            entry.mutable_instance_status()->set_status(grpc_instance_status_for(instance.state));
 
-void mp::Daemon::on_suspend()
-{
-}
+            if (request->request_ipv4() && !instance.management_ipv4.empty())
+                entry.add_ipv4(instance.management_ipv4);
 
-void mp::Daemon::on_restart(const std::string& name)
-{
-    stop_mounts(name);
-    auto future_watcher = create_future_watcher([this, &name]() {
-        auto virtual_machine = operative_instances[name];
-        std::lock_guard<decltype(virtual_machine->state_mutex)> lock{virtual_machine->state_mutex};
-        virtual_machine->state = VirtualMachine::State::running;
-        virtual_machine->update_state();
-    });
-    future_watcher->setFuture(QtConcurrent::run(this, &Daemon::async_wait_for_ready_all<StartReply, StartRequest>,
-                                                nullptr, std::vector<std::string>{name}, mp::default_timeout, nullptr,
-                                                std::string()));
-}
+            for (const auto& [target, source] : instance.mounts)
+            {
+                auto mount = entry.add_mounts();
+                mount->set_source_path(source);
+                mount->set_target_path(target);
+            }
 
-void mp::Daemon::persist_state_for(const std::string& name, const VirtualMachine::State& state)
-{
-    vm_instance_specs[name].state = state;
-    persist_instances();
-}
+            add_if_changed(entry);
+        }
 
-void mp::Daemon::update_metadata_for(const std::string& name, const QJsonObject& metadata)
-{
-    vm_instance_specs[name].metadata = metadata;
+        for (const auto& name : snapshot->deleted)
+        {
+            WatchVMInstance entry;
+            entry.set_name(name);
+            entry.mutable_instance_status()->set_status(mp::InstanceStatus::DELETED);
+            add_if_changed(entry);
+        }
 
-    persist_instances();
-}
+        for (auto it = last_sent.begin(); it != last_sent.end();)
+        {
+            if (present.count(it->first))
+                ++it;
+            else
+            {
+                reply.add_purged(it->first);
+                it = last_sent.erase(it);
+            }
+        }
 
-QJsonObject mp::Daemon::retrieve_metadata_for(const std::string& name)
+        if ((first || reply.instances_size() || reply.purged_size()) && !server->Write(reply))
+            break; // the client is gone
+
+        auto changed = [this, seen_changes] { return stop_watching || instance_changes != seen_changes; };
+        std::unique_lock<std::mutex> lock{instance_snapshot_mutex};
+        if (instance_changed.wait_for(lock, watch_keepalive, changed))
+        {
+            if (stop_watching)
+                break;
+
+            seen_changes = instance_changes;
+        }
+        else
+        {
+            // Nothing happened in here, but there may have been changes from outside. Looking again tells, and an
+            // empty reply is how to notice a client that went away.
+            lock.unlock();
+            if (!server->Write(WatchReply{}))
+                break;
+        }
+    }
+
+    status_promise->set_value(grpc::Status::OK);
+}
+catch (const std::exception& e)
 {
-    return vm_instance_specs[name].metadata;
+    status_promise->set_value(grpc::Status(grpc::StatusCode::FAILED_PRECONDITION, e.what(), ""));
 }
 
-void mp::Daemon::persist_instances()
+void mp::Daemon::metrics(const MetricsRequest* request,
+                         grpc::ServerReaderWriterInterface<MetricsReply, MetricsRequest>* server,
+                         std::promise<grpc::Status>* status_promise)
 {
-    QJsonObject instance_records_json;
-    for (const auto& record : vm_instance_specs)
-    {
-        auto key = QString::fromStdString(record.first);
-        instance_records_json.insert(key, vm_spec_to_json(record.second));
-    }
-    QDir data_dir{
-        mp::utils::backend_directory_path(config->data_directory, config->factory->get_backend_directory_name())};
-    mp::write_json(instance_records_json, data_dir.filePath(instance_db_name));
+    mpl::ClientLogger<MetricsReply, MetricsRequest> logger{mpl::level_from(request->verbosity_level()), *config->logger,
+                                                           server};
+
+    sample_host_stats(operative_instances);
+    sample_memory_merging();
+    sample_resource_pressure();
+    sample_memory_usage(vm_instance_specs, config->image_hosts);
+    MP_METRICS.set("multipass_daemon_async_operations", {}, static_cast<double>(async_future_watchers.size()));
+
+    MetricsReply reply;
+    reply.set_metrics(MP_METRICS.exposition());
+    server->Write(reply);
+
+    status_promise->set_value(grpc::Status::OK);
 }
 
-void mp::Daemon::release_resources(const std::string& instance)
+void mp::Daemon::console_log(const ConsoleLogRequest* request,
+                             grpc::ServerReaderWriterInterface<ConsoleLogReply, ConsoleLogRequest>* server,
+                             std::promise<grpc::Status>* status_promise) // clang-format off
+try // clang-format on
 {
-    config->factory->remove_resources_for(instance);
-    config->vault->remove(instance);
+    mpl::ClientLogger<ConsoleLogReply, ConsoleLogRequest> logger{mpl::level_from(request->verbosity_level()),
+                                                                 *config->logger, server};
 
-    auto spec_it = vm_instance_specs.find(instance);
-    if (spec_it != cend(vm_instance_specs))
-    {
-        for (const auto& mac : mac_set_from(spec_it->second))
-            allocated_mac_addrs.erase(mac);
+    const auto& name = request->instance_name();
+    auto [instance_trail, status] =
+        find_instance_and_react(operative_instances, deleted_instances, name, require_operative_instances_reaction);
+    if (!status.ok())
+        return status_promise->set_value(status);
 
-        vm_instance_specs.erase(spec_it);
-    }
-}
+    ConsoleLogReply reply;
+    reply.set_console_log(std::get<0>(instance_trail)->second->console_log());
+    server->Write(reply);
 
-void mp::Daemon::create_vm(const CreateRequest* request,
-                           grpc::ServerReaderWriterInterface<CreateReply, CreateRequest>* server,
-                           std::promise<grpc::Status>* status_promise, bool start)
+    status_promise->set_value(grpc::Status::OK);
+}
+catch (const std::exception& e)
 {
-    typedef typename std::pair<VirtualMachineDescription, ClientLaunchData> VMFullDescription;
+    status_promise->set_value(grpc::Status(grpc::StatusCode::FAILED_PRECONDITION, e.what(), ""));
+}
 
-    auto checked_args = validate_create_arguments(request, config.get());
+void mp::Daemon::clone(const CloneRequest* request, grpc::ServerReaderWriterInterface<CloneReply, CloneRequest>* server,
+                       std::promise<grpc::Status>* status_promise) // clang-format off
+try // clang-format on
+{
+    mpl::ClientLogger<CloneReply, CloneRequest> logger{mpl::level_from(request->verbosity_level()), *config->logger,
+                                                       server};
 
-    if (!checked_args.option_errors.error_codes().empty())
-    {
-        return status_promise->set_value(grpc::Status(grpc::StatusCode::INVALID_ARGUMENT, "Invalid arguments supplied",
-                                                      checked_args.option_errors.SerializeAsString()));
-    }
-    else if (auto& nets = checked_args.nets_need_bridging; !nets.empty() && !request->permission_to_bridge())
-    {
-        CreateError create_error;
-        create_error.add_error_codes(CreateError::INVALID_NETWORK);
+    const auto& source_name = request->source_name();
+    auto [source_trail, source_status] = find_instance_and_react(operative_instances, deleted_instances, source_name,
+                                                                 require_operative_instances_reaction);
+    if (!source_status.ok())
+        return status_promise->set_value(source_status);
 
-        CreateReply reply;
-        *reply.mutable_nets_need_bridging() = {std::make_move_iterator(nets.begin()),
-                                               std::make_move_iterator(nets.end())}; /* this constructs a temporary
-                                               RepeatedPtrField from the range, then move-assigns that temporary in */
-        server->Write(reply);
+    if (const auto state = std::get<0>(source_trail)->second->current_state();
+        state != VirtualMachine::State::off && state != VirtualMachine::State::stopped)
+        return status_promise->set_value({grpc::StatusCode::FAILED_PRECONDITION,
+                                          fmt::format("instance \"{}\" must be stopped to be cloned", source_name),
+                                          ""});
 
+    if (const auto busy = disk_busy_instances.find(source_name); busy != disk_busy_instances.end())
         return status_promise->set_value(
-            grpc::Status{grpc::StatusCode::FAILED_PRECONDITION, "Missing bridges", create_error.SerializeAsString()});
-    }
+            {grpc::StatusCode::FAILED_PRECONDITION,
+             fmt::format("Cannot clone the instance '{}' while {} it", source_name, busy->second), ""});
 
-    // TODO: We should only need to query the Blueprint Provider once for all info, so this (and timeout below) will
-    //       need a refactoring to do so.
-    const std::string blueprint_name = config->blueprint_provider->name_from_blueprint(request->image());
-    auto name = name_from(checked_args.instance_name, blueprint_name, *config->name_generator, operative_instances);
+    auto name = request->destination_name();
+    for (auto i = 1; name.empty(); ++i)
+        if (auto candidate = fmt::format("{}-clone{}", source_name, i);
+            !vm_instance_specs.count(candidate) && !preparing_instances.count(candidate))
+            name = candidate;
+
+    if (!mp::utils::valid_hostname(name))
+        return status_promise->set_value(
+            {grpc::StatusCode::INVALID_ARGUMENT, fmt::format("invalid instance name \"{}\"", name), ""});
 
     auto [instance_trail, status] =
         find_instance_and_react(operative_instances, deleted_instances, name, require_missing_instances_reaction);
-
-    assert(status.ok() == (instance_trail.index() == 2));
     if (!status.ok())
         return status_promise->set_value(status);
 
-    if (preparing_instances.find(name) != preparing_instances.end())
+    if (preparing_instances.count(name))
         return status_promise->set_value(
             {grpc::StatusCode::INVALID_ARGUMENT, fmt::format("instance \"{}\" is being prepared", name), ""});
 
-    if (!instances_running(operative_instances))
-        config->factory->hypervisor_health_check();
-
-    // TODO: We should only need to query the Blueprint Provider once for all info, so this (and name above) will
-    //       need a refactoring to do so.
-    auto timeout = timeout_for(request->timeout(), config->blueprint_provider->blueprint_timeout(blueprint_name));
+    // The same hardware and mounts, with new MACs. The guest takes a new identity from a new cloud-init instance-id.
+    auto spec = vm_instance_specs.at(source_name);
+    auto new_macs = allocated_mac_addrs;
+    spec.default_mac_address = generate_unused_mac_address(new_macs);
+    for (auto& iface : spec.extra_interfaces)
+        iface.mac_address = generate_unused_mac_address(new_macs);
+    spec.state = VirtualMachine::State::off;
+    spec.metadata = QJsonObject{}; // backend settings, some of which refer to the source's files
+
+    CreateRequest create_request;
+    YAML::Node user_data;
+    reset_machine_id_on_first_boot(user_data);
+
+    VirtualMachineDescription vm_desc{
+        spec.num_cores,
+        spec.mem_size,
+        spec.disk_space,
+        name,
+        spec.default_mac_address,
+        spec.extra_interfaces,
+        spec.ssh_username,
+        VMImage{},
+        "",
+        make_cloud_init_meta_config(name),
+        user_data,
+        cloud_init_vendor_config(spec.ssh_username, &create_request),
+        make_cloud_init_clone_network_config(spec.default_mac_address, spec.extra_interfaces)};
 
     preparing_instances.insert(name);
+    cloning_instances.insert(source_name);
 
-    auto prepare_future_watcher = new QFutureWatcher<VMFullDescription>();
-    auto log_level = mpl::level_from(request->verbosity_level());
+    CloneReply reply;
+    reply.set_reply_message(fmt::format("Cloning {}", source_name));
+    server->Write(reply);
 
+    auto clone_future_watcher = new QFutureWatcher<VirtualMachineDescription>();
     QObject::connect(
-        prepare_future_watcher, &QFutureWatcher<VMFullDescription>::finished,
-        [this, server, status_promise, name, timeout, start, prepare_future_watcher, log_level] {
-            mpl::ClientLogger<CreateReply, CreateRequest> logger{log_level, *config->logger, server};
+        clone_future_watcher, &QFutureWatcher<VirtualMachineDescription>::finished,
+        [this, server, status_promise, name, source_name, spec, new_macs, clone_future_watcher]() mutable {
+            preparing_instances.erase(name);
+            cloning_instances.erase(cloning_instances.find(source_name));
 
             try
             {
-                auto vm_desc_pair = prepare_future_watcher->future().result();
-                auto vm_desc = vm_desc_pair.first;
-                auto& vm_client_data = vm_desc_pair.second;
-                auto& vm_aliases = vm_client_data.aliases_to_be_created;
-                auto& vm_workspaces = vm_client_data.workspaces_to_be_created;
+                const auto vm_desc = clone_future_watcher->future().result();
 
-                vm_instance_specs[name] = {vm_desc.num_cores,
+                vm_instance_specs[name] = spec;
+                operative_instances[name] = config->factory->create_virtual_machine(vm_desc, *this);
+                allocated_mac_addrs = std::move(new_macs);
+                init_mounts(name);
+                persist_instance(name);
+                take_instance_snapshot();
+
+                CloneReply reply;
+                reply.set_reply_message(fmt::format("Cloned {} as {}", source_name, name));
+                server->Write(reply);
+                status_promise->set_value(grpc::Status::OK);
+            }
+            catch (const std::exception& e)
+            {
+                mounts.erase(name);
+                operative_instances.erase(name);
+                vm_instance_specs.erase(name);
+                config->vault->remove(name);
+                status_promise->set_value(grpc::Status(grpc::StatusCode::FAILED_PRECONDITION, e.what(), ""));
+            }
+
+            delete clone_future_watcher;
+        });
+
+    // The image is copied away from the main thread, the source is kept from starting in the meantime
+    clone_future_watcher->setFuture(QtConcurrent::run(&launch_pool, [this, source_name, name, vm_desc]() mutable {
+        try
+        {
+            mpl::TraceSpan span{"clone", name};
+            vm_desc.image = config->vault->clone(source_name, name);
+            config->factory->configure(vm_desc);
+
+            return vm_desc;
+        }
+        catch (const std::exception& e)
+        {
+            throw CreateImageException(e.what());
+        }
+    }));
+}
+catch (const std::exception& e)
+{
+    status_promise->set_value(grpc::Status(grpc::StatusCode::FAILED_PRECONDITION, e.what(), ""));
+}
+
+void mp::Daemon::compact(const CompactRequest* request,
+                         grpc::ServerReaderWriterInterface<CompactReply, CompactRequest>* server,
+                         std::promise<grpc::Status>* status_promise) // clang-format off
+try // clang-format on
+{
+    mpl::ClientLogger<CompactReply, CompactRequest> logger{mpl::level_from(request->verbosity_level()),
+                                                           *config->logger, server};
+
+    const auto& name = request->instance_name();
+    auto [instance_trail, status] =
+        find_instance_and_react(operative_instances, deleted_instances, name, require_operative_instances_reaction);
+    if (!status.ok())
+        return status_promise->set_value(status);
+
+    auto vm = std::get<0>(instance_trail)->second;
+    const auto state = vm->current_state();
+    const auto running = state == VirtualMachine::State::running;
+    if (!running && state != VirtualMachine::State::off && state != VirtualMachine::State::stopped)
+        return status_promise->set_value(
+            {grpc::StatusCode::FAILED_PRECONDITION,
+             fmt::format("instance \"{}\" must be running or stopped to be compacted", name), ""});
+
+    if (disk_busy_instances.count(name) || cloning_instances.count(name))
+        return status_promise->set_value(
+            {grpc::StatusCode::FAILED_PRECONDITION, fmt::format("instance \"{}\" is busy with its disk", name), ""});
+
+    // Running instances give back what they trim. Stopped ones have their image rewritten, and stay stopped until then.
+    if (!running)
+        disk_busy_instances.emplace(name, "compacting");
+
+    CompactReply reply;
+    reply.set_reply_message(running ? fmt::format("Trimming {}", name) : fmt::format("Compacting {}", name));
+    server->Write(reply);
+
+    // The outcome is the error, if any
+    auto compact_future_watcher = new QFutureWatcher<std::string>();
+    QObject::connect(compact_future_watcher, &QFutureWatcher<std::string>::finished,
+                     [this, server, status_promise, name, running, compact_future_watcher] {
+                         disk_busy_instances.erase(name);
+
+                         if (const auto error = compact_future_watcher->result(); !error.empty())
+                         {
+                             status_promise->set_value(grpc::Status(grpc::StatusCode::FAILED_PRECONDITION, error, ""));
+                         }
+                         else
+                         {
+                             CompactReply reply;
+                             reply.set_reply_message(running ? fmt::format("Trimmed {}", name)
+                                                             : fmt::format("Compacted {}", name));
+                             server->Write(reply);
+                             status_promise->set_value(grpc::Status::OK);
+                         }
+
+                         delete compact_future_watcher;
+                     });
+
+    const auto host = running ? vm->ssh_hostname() : std::string{};
+    const auto port = running ? vm->ssh_port() : 0;
+    compact_future_watcher->setFuture(QtConcurrent::run(
+        &launch_pool, [this, vm, name, running, host, port, username = vm_instance_specs[name].ssh_username,
+                       compress = request->compress()]() -> std::string {
+            mpl::TraceSpan span{"compact", name};
+            try
+            {
+                if (!running)
+                    vm->compact_disk(compress);
+                else if (!vm->guest_exec(fstrim_cmd))
+                    ssh_sessions.with_session(
+                        name, host, port, username, *config->ssh_key_provider,
+                        [](mp::SSHSession& session) { mpu::run_in_ssh_session(session, fstrim_cmd); });
+
+                return {};
+            }
+            catch (const std::exception& e)
+            {
+                return e.what();
+            }
+        }));
+}
+catch (const std::exception& e)
+{
+    status_promise->set_value(grpc::Status(grpc::StatusCode::FAILED_PRECONDITION, e.what(), ""));
+}
+
+void mp::Daemon::snapshot(const SnapshotRequest* request,
+                          grpc::ServerReaderWriterInterface<SnapshotReply, SnapshotRequest>* server,
+                          std::promise<grpc::Status>* status_promise) // clang-format off
+try // clang-format on
+{
+    if (!request->list_snapshots())
+        return snapshot_or_restore(request, server, status_promise,
+                                   request->delete_snapshot() ? SnapshotAction::remove : SnapshotAction::take);
+
+    mpl::ClientLogger<SnapshotReply, SnapshotRequest> logger{mpl::level_from(request->verbosity_level()),
+                                                             *config->logger, server};
+
+    auto [instance_trail, status] = find_instance_and_react(operative_instances, deleted_instances,
+                                                            request->instance_name(),
+                                                            require_operative_instances_reaction);
+    if (!status.ok())
+        return status_promise->set_value(status);
+
+    SnapshotReply reply;
+    for (const auto& snapshot : std::get<0>(instance_trail)->second->list_snapshots())
+        reply.add_snapshot_names(snapshot);
+
+    server->Write(reply);
+    status_promise->set_value(grpc::Status::OK);
+}
+catch (const std::exception& e)
+{
+    status_promise->set_value(grpc::Status(grpc::StatusCode::FAILED_PRECONDITION, e.what(), ""));
+}
+
+void mp::Daemon::restore(const RestoreRequest* request,
+                         grpc::ServerReaderWriterInterface<RestoreReply, RestoreRequest>* server,
+                         std::promise<grpc::Status>* status_promise)
+{
+    snapshot_or_restore(request, server, status_promise, SnapshotAction::restore);
+}
+
+void mp::Daemon::exec(const ExecRequest* request, ExecServer* server,
+                      std::promise<grpc::Status>* status_promise) // clang-format off
+try // clang-format on
+{
+    mpl::ClientLogger<ExecReply, ExecRequest> logger{mpl::level_from(request->verbosity_level()), *config->logger,
+                                                     server};
+
+    const auto& name = request->instance_name();
+    auto [instance_trail, status] =
+        find_instance_and_react(operative_instances, deleted_instances, name, require_operative_instances_reaction);
+    if (!status.ok())
+        return status_promise->set_value(status);
+
+    // Like for ssh_info, so that clients know to start it first
+    auto vm = std::get<0>(instance_trail)->second;
+    if (!mp::utils::is_running(vm->current_state()))
+        return status_promise->set_value(
+            {grpc::StatusCode::ABORTED, fmt::format("instance \"{}\" is not running", name), ""});
+
+    idle_monitor.touch(name);
+    {
+        std::lock_guard<std::mutex> lock{exec_sessions_mutex};
+        exec_sessions.insert(name); // keeps it from being suspended while the command runs
+    }
+
+    // Only the first part of the input may have come with the command, the rest is read as the command runs
+    QtConcurrent::run(&exec_pool, [this, server, status_promise, name, host = vm->ssh_hostname(),
+                                   port = vm->ssh_port(), username = vm->ssh_username(), command = request->command(),
+                                   first_input = request->std_in()] {
+        mpl::TraceSpan span{"exec", name};
+        ExecInput input;
+        if (!first_input.empty())
+            input.push(first_input);
+
+        std::promise<void> reader_done;
+        std::thread reader{[server, &input, &reader_done] {
+            for (ExecRequest more_input; server->Read(&more_input);)
+                if (!more_input.std_in().empty())
+                    input.push(std::move(*more_input.mutable_std_in()));
+            input.close();
+            reader_done.set_value();
+        }};
+
+        std::optional<int> exit_code;
+        std::string error;
+        try
+        {
+            // A pooled session is tried again on a new one when it fails, which is fine until the command has started
+            ssh_sessions.with_session(name, host, port, username, *config->ssh_key_provider,
+                                      [&](mp::SSHSession& session) {
+                                          auto process = session.exec(command);
+                                          try
+                                          {
+                                              exit_code = follow_exec(process, input, server, stop_execs);
+                                          }
+                                          catch (const std::exception& e)
+                                          {
+                                              error = e.what();
+                                          }
+                                      });
+        }
+        catch (const std::exception& e)
+        {
+            error = e.what();
+        }
+
+        // The last reply is what tells the client to stop sending, which the reader waits on for a moment, not to
+        // hold this thread for as long as a client that never does stays connected. It goes out however the command
+        // ended, the status says whether it came with an exit code.
+        input.abandon();
+        ExecReply reply;
+        reply.set_exited(true);
+        reply.set_exit_code(exit_code.value_or(-1));
+        server->Write(reply);
+        if (reader_done.get_future().wait_for(exec_half_close_timeout) != std::future_status::ready)
+            server->cancel();
+        reader.join();
+
+        {
+            std::lock_guard<std::mutex> lock{exec_sessions_mutex};
+            exec_sessions.erase(exec_sessions.find(name));
+        }
+
+        if (!error.empty())
+            status_promise->set_value(grpc::Status(grpc::StatusCode::FAILED_PRECONDITION, error, ""));
+        else if (!exit_code && stop_execs)
+            status_promise->set_value(grpc::Status(grpc::StatusCode::UNAVAILABLE, "the daemon is shutting down", ""));
+        else
+            status_promise->set_value(grpc::Status::OK);
+    });
+}
+catch (const std::exception& e)
+{
+    status_promise->set_value(grpc::Status(grpc::StatusCode::FAILED_PRECONDITION, e.what(), ""));
+}
+
+void mp::Daemon::forward(const ForwardRequest* request,
+                         grpc::ServerReaderWriterInterface<ForwardReply, ForwardRequest>* server,
+                         std::promise<grpc::Status>* status_promise) // clang-format off
+try // clang-format on
+{
+    mpl::ClientLogger<ForwardReply, ForwardRequest> logger{mpl::level_from(request->verbosity_level()),
+                                                           *config->logger, server};
+
+#ifndef MULTIPASS_PLATFORM_LINUX
+    // Relays splice(2) between the sockets, which only Linux has
+    return status_promise->set_value(
+        {grpc::StatusCode::UNIMPLEMENTED, "forwarding ports is not supported on this platform", ""});
+#else
+    const auto valid_port = [](int port) { return port > 0 && port <= std::numeric_limits<quint16>::max(); };
+    const auto host_port = request->host_port();
+    if (!valid_port(host_port))
+        return status_promise->set_value(
+            {grpc::StatusCode::INVALID_ARGUMENT, fmt::format("invalid host port {}", host_port), ""});
+
+    // The daemon runs as root, which is not to bind privileged ports on behalf of whoever can reach it
+    if (host_port < first_unprivileged_port)
+        return status_promise->set_value(
+            {grpc::StatusCode::INVALID_ARGUMENT,
+             fmt::format("host port {} is privileged, only ports from {} up can be forwarded", host_port,
+                         first_unprivileged_port),
+             ""});
+
+    ForwardReply reply;
+    if (request->cancel())
+    {
+        if (!port_forwards.erase(host_port))
+            return status_promise->set_value(
+                {grpc::StatusCode::INVALID_ARGUMENT, fmt::format("port {} is not forwarded", host_port), ""});
+
+        reply.set_reply_message(fmt::format("Stopped forwarding port {}", host_port));
+        server->Write(reply);
+        return status_promise->set_value(grpc::Status::OK);
+    }
+
+    const auto& name = request->instance_name();
+    const auto instance_port = request->instance_port();
+    auto [instance_trail, status] =
+        find_instance_and_react(operative_instances, deleted_instances, name, require_operative_instances_reaction);
+    if (!status.ok())
+        return status_promise->set_value(status);
+
+    if (!valid_port(instance_port))
+        return status_promise->set_value(
+            {grpc::StatusCode::INVALID_ARGUMENT, fmt::format("invalid instance port {}", instance_port), ""});
+
+    if (auto it = port_forwards.find(host_port); it != port_forwards.end())
+        return status_promise->set_value(
+            {grpc::StatusCode::INVALID_ARGUMENT,
+             fmt::format("port {} is already forwarded to \"{}\"", host_port, it->second.first), ""});
+
+    // Looked up for each connection, the instance may have come back with another address in the meantime. This is
+    // called on this thread, by the forwarder's listener, where the instance's state is kept.
+    std::weak_ptr<VirtualMachine> weak_vm = std::get<0>(instance_trail)->second;
+    auto instance_address = [weak_vm, name] {
+        const auto vm = weak_vm.lock();
+        if (!vm || !mp::utils::is_running(vm->current_state()))
+            throw std::runtime_error(fmt::format("instance \"{}\" is not running", name));
+
+        return vm->management_ipv4();
+    };
+
+    port_forwards.emplace(host_port,
+                          std::make_pair(name, std::make_unique<PortForwarder>(host_port, instance_address,
+                                                                               static_cast<quint16>(instance_port))));
+
+    reply.set_reply_message(fmt::format("Forwarding localhost:{} to {}:{}", host_port, name, instance_port));
+    server->Write(reply);
+    status_promise->set_value(grpc::Status::OK);
+#endif
+}
+catch (const std::exception& e)
+{
+    status_promise->set_value(grpc::Status(grpc::StatusCode::FAILED_PRECONDITION, e.what(), ""));
+}
+
+void mp::Daemon::apply(const ApplyRequest* request,
+                       grpc::ServerReaderWriterInterface<ApplyReply, ApplyRequest>* server,
+                       std::promise<grpc::Status>* status_promise) // clang-format off
+try // clang-format on
+{
+    mpl::ClientLogger<ApplyReply, ApplyRequest> logger{mpl::level_from(request->verbosity_level()), *config->logger,
+                                                       server};
+
+    std::unordered_set<std::string> names;
+    for (const auto& instance : request->instances())
+    {
+        const auto& name = instance.launch().instance_name();
+        const auto& state = instance.state();
+        if (name.empty())
+            return status_promise->set_value({grpc::StatusCode::INVALID_ARGUMENT, "every instance needs a name", ""});
+        if (!names.insert(name).second)
+            return status_promise->set_value(
+                {grpc::StatusCode::INVALID_ARGUMENT, fmt::format("instance \"{}\" is given twice", name), ""});
+        if (!state.empty() && state != running_state && state != stopped_state && state != suspended_state &&
+            state != absent_state)
+            return status_promise->set_value(
+                {grpc::StatusCode::INVALID_ARGUMENT,
+                 fmt::format("instance \"{}\" cannot be \"{}\", only {}, {}, {} or {}", name, state, running_state,
+                             stopped_state, suspended_state, absent_state),
+                 ""});
+    }
+
+    auto reconcile = std::make_shared<Reconcile>(server, status_promise);
+    const auto timeout = request->timeout();
+
+    // Stopping and purging are done for all at once first, the way the bulk requests take them down side by side
+    StopRequest stops;
+    DeleteRequest purges;
+    purges.set_purge(true);
+    std::vector<std::pair<std::size_t, bool>> joining; // pipelines that wait on those, and on which of them
+
+    for (const auto& instance : request->instances())
+    {
+        const auto& launch = instance.launch();
+        const auto& name = launch.instance_name();
+        const auto state = instance.state().empty() ? running_state : instance.state();
+        auto& pipeline = reconcile->pipelines.emplace_back();
+        pipeline.instance = name;
+
+        const auto vm_it = operative_instances.find(name);
+        const auto deleted = deleted_instances.find(name) != deleted_instances.end();
+        if (state == absent_state)
+        {
+            if (vm_it != operative_instances.end() || deleted)
+            {
+                purges.mutable_instance_names()->add_instance_name(name);
+                joining.emplace_back(reconcile->pipelines.size() - 1, false);
+            }
+            continue;
+        }
+
+        try
+        {
+            if (deleted)
+                throw std::invalid_argument{"the instance is deleted, recover or purge it first"};
+            if (preparing_instances.find(name) != preparing_instances.end())
+                throw std::invalid_argument{"the instance is being prepared"};
+
+            auto start = false, suspend = false;
+            std::map<std::string, VMMount> current_mounts;
+            if (vm_it == operative_instances.end())
+            {
+                // Created stopped rather than launched, when it is to be stopped
+                LaunchRequest create{launch};
+                create.set_timeout(timeout);
+                create.clear_count();
+                create.set_verbosity_level(0);
+                pipeline.steps.emplace_back(
+                    state == stopped_state ? "creating" : "launching",
+                    state == stopped_state ? reconcile->step(*this, &Daemon::create, create)
+                                           : reconcile->step(*this, &Daemon::launch, create));
+                suspend = state == suspended_state;
+            }
+            else
+            {
+                const auto& spec = vm_instance_specs[name];
+                const auto current = vm_it->second->current_state();
+
+                SetRequest set;
+                const auto key = [&name](const char* property) {
+                    return fmt::format("{}.{}.{}", mp::daemon_settings_root, name, property);
+                };
+                if (launch.num_cores() && launch.num_cores() != spec.num_cores)
+                    (*set.mutable_values())[key("cpus")] = std::to_string(launch.num_cores());
+                if (!launch.mem_size().empty() && MemorySize{launch.mem_size()} != spec.mem_size)
+                    (*set.mutable_values())[key("memory")] = launch.mem_size();
+                if (!launch.disk_space().empty() && MemorySize{launch.disk_space()} != spec.disk_space)
+                    (*set.mutable_values())[key("disk")] = launch.disk_space();
+
+                const auto stop = needs_shutdown(current) && (set.values_size() || state == stopped_state);
+                if (stop)
+                {
+                    stops.mutable_instance_names()->add_instance_name(name);
+                    joining.emplace_back(reconcile->pipelines.size() - 1, true);
+                }
+                if (set.values_size())
+                    pipeline.steps.emplace_back("resizing", reconcile->step(*this, &Daemon::set, set));
+
+                const auto running = !stop && mp::utils::is_running(current);
+                const auto suspended = !stop && current == VirtualMachine::State::suspended;
+                start = !running && (state == running_state || (state == suspended_state && !suspended));
+                suspend = state == suspended_state && !suspended;
+                current_mounts.insert(spec.mounts.cbegin(), spec.mounts.cend());
+            }
+
+            if (instance.has_mounts())
+            {
+                std::map<std::string, std::string> wanted; // by target
+                for (const auto& mount : instance.mounts().mounts())
+                    wanted[QDir::cleanPath(QString::fromStdString(mount.target_path())).toStdString()] =
+                        mount.source_path();
+
+                for (const auto& [target, mount] : current_mounts)
+                    if (auto it = wanted.find(target); it == wanted.end() || it->second != mount.source_path)
+                    {
+                        UmountRequest umount;
+                        auto path = umount.add_target_paths();
+                        path->set_instance_name(name);
+                        path->set_target_path(target);
+                        pipeline.steps.emplace_back(fmt::format("unmounting {}", target),
+                                                    reconcile->step(*this, &Daemon::umount, umount));
+                    }
+
+                for (const auto& [target, source] : wanted)
+                    if (auto it = current_mounts.find(target);
+                        it == current_mounts.end() || it->second.source_path != source)
+                    {
+                        MountRequest mount;
+                        mount.set_source_path(source);
+                        *mount.mutable_mount_maps() = instance.mounts().mount_maps();
+                        auto path = mount.add_target_paths();
+                        path->set_instance_name(name);
+                        path->set_target_path(target);
+                        pipeline.steps.emplace_back(fmt::format("mounting {} on {}", source, target),
+                                                    reconcile->step(*this, &Daemon::mount, mount));
+                    }
+            }
+
+            StartRequest start_request;
+            start_request.mutable_instance_names()->add_instance_name(name);
+            start_request.set_timeout(timeout);
+            SuspendRequest suspend_request;
+            *suspend_request.mutable_instance_names() = start_request.instance_names();
+            if (start)
+                pipeline.steps.emplace_back("starting", reconcile->step(*this, &Daemon::start, start_request));
+            if (suspend)
+                pipeline.steps.emplace_back("suspending", reconcile->step(*this, &Daemon::suspend, suspend_request));
+        }
+        catch (const std::exception& e)
+        {
+            pipeline.status = {grpc::StatusCode::INVALID_ARGUMENT, e.what(), ""};
+            pipeline.steps.clear();
+        }
+    }
+
+    if (request->dry_run())
+    {
+        for (const auto& [index, stopping] : joining)
+            reconcile->say(reconcile->pipelines[index].instance, stopping ? "would be stopping" : "would be purging");
+        for (const auto& pipeline : reconcile->pipelines)
+            for (const auto& [doing, step] : pipeline.steps)
+                reconcile->say(pipeline.instance, "would be " + doing);
+
+        return status_promise->set_value(reconcile->status());
+    }
+
+    std::shared_future<grpc::Status> stopped, purged;
+    if (stops.instance_names().instance_name_size())
+        stopped = reconcile->start(*this, &Daemon::stop, stops);
+    if (purges.instance_names().instance_name_size())
+        purged = reconcile->start(*this, &Daemon::delet, purges);
+
+    for (const auto& [index, stopping] : joining)
+        reconcile->pipelines[index].steps.emplace_front(stopping ? "stopping" : "purging",
+                                                        [status = stopping ? stopped : purged] { return status; });
+
+    mpl::log(mpl::Level::info, category, fmt::format("Applying {} instances", reconcile->pipelines.size()));
+    reconcile->remaining = reconcile->pipelines.size();
+    if (!reconcile->remaining)
+        return status_promise->set_value(grpc::Status::OK);
+
+    for (std::size_t i = 0; i < reconcile->pipelines.size(); ++i)
+        next_apply_step(reconcile, i);
+}
+catch (const std::exception& e)
+{
+    status_promise->set_value(grpc::Status(grpc::StatusCode::FAILED_PRECONDITION, e.what(), ""));
+}
+
+void mp::Daemon::on_shutdown()
+{
+}
+
+void mp::Daemon::on_resume()
+{
+}
+
+void mp::Daemon::on_stop()
+{
+}
+
+void mp::Daemon::on_suspend()
+{
+}
+
+void mp::Daemon::on_restart(const std::string& name)
+{
+    if (operative_instances.find(name) == operative_instances.end())
+        return; // warm instances are left alone until taken
+
+    ssh_sessions.forget(name);
+    stop_mounts(name);
+    auto future_watcher = create_future_watcher([this, name]() {
+        auto virtual_machine = operative_instances[name];
+        std::lock_guard<decltype(virtual_machine->state_mutex)> lock{virtual_machine->state_mutex};
+        virtual_machine->state = VirtualMachine::State::running;
+        virtual_machine->update_state();
+    });
+    future_watcher->setFuture(QtConcurrent::run(this, &Daemon::async_wait_for_ready_all<StartReply, StartRequest>,
+                                                nullptr, std::vector<std::string>{name}, mp::default_timeout, nullptr,
+                                                std::string()));
+}
+
+void mp::Daemon::check_idle_instances()
+{
+    auto changed = false;
+    for (const auto& [name, vm] : operative_instances)
+    {
+        auto& spec = vm_instance_specs[name];
+        const auto state = vm->current_state();
+        if (state != VirtualMachine::State::suspended && std::exchange(spec.idle_suspended, false))
+            changed = true; // someone else resumed it
+
+        const auto limit = std::chrono::minutes{spec.idle_suspend};
+        if (!limit.count() || state != VirtualMachine::State::running || cloning_instances.count(name))
+        {
+            idle_monitor.forget(name);
+            continue;
+        }
+
+        // Backends that cannot tell what instances use leave them running
+        const auto stats = vm->host_stats();
+        if (!stats || !idle_monitor.idle_for(name, *stats, limit))
+            continue;
+
+        // Quiet sessions and mounts keep it in use all the same, and would not survive it being suspended
+        if (in_use(name, *vm))
+        {
+            idle_monitor.touch(name);
+            continue;
+        }
+
+        mpl::log(mpl::Level::info, category, fmt::format("Suspending {}, idle for {} minutes", name, limit.count()));
+        idle_monitor.forget(name);
+        try
+        {
+            stop_mounts(name);
+            vm->suspend();
+            spec.idle_suspended = changed = true;
+        }
+        catch (const std::exception& e)
+        {
+            mpl::log(mpl::Level::warning, category, fmt::format("Cannot suspend idle {}: {}", name, e.what()));
+        }
+    }
+
+    if (changed)
+        persist_instances(); // so that they are still resumed for whoever wants in after the daemon restarts
+}
+
+bool mp::Daemon::in_use(const std::string& name, VirtualMachine& vm)
+{
+    if (const auto mounts_it = mounts.find(name); mounts_it != mounts.end())
+        for (const auto& [_, mount] : mounts_it->second)
+            if (mount->is_active())
+                return true;
+
+    {
+        std::lock_guard<std::mutex> lock{exec_sessions_mutex};
+        if (exec_sessions.count(name))
+            return true;
+    }
+
+    // Clients open shells and transfers straight to the instance, only it knows of them. Without pooled sessions of
+    // the daemon's own, the one asking is the only one that should be there.
+    constexpr auto list_connections = "ss --no-header --tcp --numeric state established '( sport = :22 )'";
+    auto others_connected = false;
+    try
+    {
+        ssh_sessions.forget(name);
+        ssh_sessions.with_session(name, vm.ssh_hostname(), vm.ssh_port(), vm.ssh_username(),
+                                  *config->ssh_key_provider, [&others_connected](mp::SSHSession& session) {
+                                      // Trimmed, so any line break is past that of the session asking
+                                      const auto connections = mpu::run_in_ssh_session(session, list_connections);
+                                      others_connected = connections.find('\n') != std::string::npos;
+                                  });
+        ssh_sessions.forget(name);
+    }
+    catch (const std::exception& e)
+    {
+        mpl::log(mpl::Level::debug, category, fmt::format("Cannot tell who is connected to {}: {}", name, e.what()));
+    }
+
+    return others_connected;
+}
+
+void mp::Daemon::restore_next_instance()
+{
+    const auto name = instances_to_restore.front();
+    instances_to_restore.pop_front();
+    if (!instances_to_restore.empty())
+        QTimer::singleShot(0, this, [this] { restore_next_instance(); });
+
+    // Requests that came first may have started, stopped or deleted it already
+    const auto it = operative_instances.find(name);
+    const auto spec_it = vm_instance_specs.find(name);
+    const auto slept = host_sleep_suspended.erase(name);
+    if (it == operative_instances.end() || spec_it == vm_instance_specs.end() ||
+        (spec_it->second.state != VirtualMachine::State::running &&
+         !(slept && spec_it->second.state == VirtualMachine::State::suspended)))
+        return;
+
+    auto vm = it->second;
+    std::unique_lock lock{start_mutex};
+    if (const auto state = vm->current_state();
+        state != VirtualMachine::State::running && state != VirtualMachine::State::starting)
+    {
+        mpl::log(mpl::Level::info, category, fmt::format("{} needs starting. Starting now...", name));
+
+        multipass::top_catch_all(name, [this, &vm, &name, &lock]() {
+            vm->start();
+            lock.unlock();
+            on_restart(name);
+        });
+    }
+    else if (reattached_instances.erase(name))
+    {
+        mpl::log(mpl::Level::info, category, fmt::format("{} is still running, restoring its mounts", name));
+
+        lock.unlock();
+        multipass::top_catch_all(name, [this, &name]() { on_restart(name); });
+    }
+}
+
+void mp::Daemon::on_host_sleep(bool sleeping)
+{
+    if (!sleeping)
+    {
+        MP_PLATFORM.hold_host_sleep(true); // for the next time
+
+        // Through the restore queue, so that requests that come in meanwhile are not kept waiting for all
+        std::vector<std::string> names{host_sleep_suspended.cbegin(), host_sleep_suspended.cend()};
+        interactive_first(names, vm_instance_specs);
+        mpl::log(mpl::Level::info, category, fmt::format("Host woke up, resuming {} instance(s)", names.size()));
+
+        const auto idle = instances_to_restore.empty();
+        instances_to_restore.insert(instances_to_restore.end(), names.cbegin(), names.cend());
+        if (idle && !instances_to_restore.empty())
+            QTimer::singleShot(0, this, [this] { restore_next_instance(); });
+
+        return;
+    }
+
+    std::vector<std::string> names;
+    for (const auto& [name, vm] : operative_instances)
+        if (vm->current_state() == VirtualMachine::State::running && !cloning_instances.count(name) &&
+            !disk_busy_instances.count(name))
+            names.push_back(name);
+    interactive_first(names, vm_instance_specs);
+
+    // Each writes out its memory, so how many go at once is bounded like other bulk operations, for the disk's sake
+    mpl::log(mpl::Level::info, category, fmt::format("Host going to sleep, suspending {} instance(s)", names.size()));
+    std::mutex suspended_mutex;
+    std::vector<std::function<void()>> anywhere, here; // as in cmd_vms_concurrently
+    for (const auto& name : names)
+    {
+        ssh_sessions.forget(name);
+        stop_mounts(name);
+
+        const auto& vm = operative_instances[name];
+        (vm->concurrent_state_changes() ? anywhere : here).push_back([this, &suspended_mutex, name, vm] {
+            try
+            {
+                vm->suspend();
+
+                std::lock_guard lock{suspended_mutex};
+                host_sleep_suspended.insert(name);
+            }
+            catch (const std::exception& e)
+            {
+                mpl::log(mpl::Level::warning, category, fmt::format("Cannot suspend {}: {}", name, e.what()));
+            }
+        });
+    }
+
+    mpu::run_concurrently(anywhere, bulk_parallelism());
+    for (const auto& task : here)
+        task();
+
+    MP_PLATFORM.hold_host_sleep(false); // letting the host go
+}
+
+void mp::Daemon::persist_state_for(const std::string& name, const VirtualMachine::State& state)
+{
+    std::lock_guard<std::recursive_mutex> lock{persist_mutex};
+    vm_instance_specs[name].state = state;
+    persist_instance(name);
+
+    // Reported from whichever thread the backend noticed it on, the instance is only looked at on the main one
+    retake_instance_snapshot();
+}
+
+void mp::Daemon::update_metadata_for(const std::string& name, const QJsonObject& metadata)
+{
+    std::lock_guard<std::recursive_mutex> lock{persist_mutex};
+    vm_instance_specs[name].metadata = metadata;
+
+    persist_instance(name);
+}
+
+QJsonObject mp::Daemon::retrieve_metadata_for(const std::string& name)
+{
+    return vm_instance_specs[name].metadata.object();
+}
+
+void mp::Daemon::persist_instances()
+{
+    {
+        std::lock_guard<std::recursive_mutex> lock{persist_mutex};
+        write_instance_db();
+    }
+
+    take_instance_snapshot();
+}
+
+void mp::Daemon::persist_instance(const std::string& name)
+{
+    std::lock_guard<std::recursive_mutex> lock{persist_mutex};
+
+    auto spec_it = vm_instance_specs.find(name);
+    if (spec_it == vm_instance_specs.end())
+        return;
+
+    instance_db.update(QString::fromStdString(name), vm_spec_to_json(spec_it->second),
+                       [this] { return instance_records_json(); });
+}
+
+void mp::Daemon::write_instance_db()
+{
+    instance_db.write(instance_records_json());
+}
+
+QJsonObject mp::Daemon::instance_records_json() const
+{
+    QJsonObject records;
+    for (const auto& record : vm_instance_specs)
+    {
+        auto key = QString::fromStdString(record.first);
+        records.insert(key, vm_spec_to_json(record.second));
+    }
+
+    return records;
+}
+
+void mp::Daemon::take_instance_snapshot()
+{
+    std::vector<VirtualMachine*> vms;
+    for (const auto& [name, vm] : operative_instances)
+        vms.push_back(vm.get());
+    config->factory->refresh_states(vms); // all at once, where the backend can
+
+    auto snapshot = std::make_shared<InstanceSnapshot>();
+    auto addresses_missing = false;
+    for (const auto& [name, vm] : operative_instances)
+    {
+        std::map<std::string, std::string> mounts;
+        if (auto spec_it = vm_instance_specs.find(name); spec_it != vm_instance_specs.end())
+            for (const auto& [target, mount] : spec_it->second.mounts)
+                mounts.emplace(target, mount.source_path);
+
+        const auto state = vm->cached_state();
+        std::string management_ipv4;
+        if (mp::utils::is_running(state))
+        {
+            management_ipv4 = vm->management_ipv4();
+            if (!is_ipv4_valid(management_ipv4))
+            {
+                management_ipv4.clear();
+                addresses_missing = true;
+            }
+        }
+
+        snapshot->operative.push_back(
+            {name, state, std::move(management_ipv4), vm->ssh_port(), vm->ssh_username(), std::move(mounts)});
+    }
+
+    for (const auto& instance : deleted_instances)
+        snapshot->deleted.push_back(instance.first);
+
+    std::sort(snapshot->operative.begin(), snapshot->operative.end(),
+              [](const auto& a, const auto& b) { return a.name < b.name; });
+    std::sort(snapshot->deleted.begin(), snapshot->deleted.end());
+
+    std::atomic_store(&latest_instance_snapshot, std::shared_ptr<const InstanceSnapshot>{std::move(snapshot)});
+    {
+        std::lock_guard<std::mutex> lock{instance_snapshot_mutex};
+        ++instance_changes;
+    }
+    instance_changed.notify_all();
+    update_completion_cache();
+
+    // Instances get their address some time after they are running, they are looked at again until they have it
+    if (addresses_missing)
+        retake_instance_snapshot(snapshot_address_retry);
+}
+
+void mp::Daemon::retake_instance_snapshot(std::chrono::milliseconds delay)
+{
+    // Those asked for while one is pending come down to that one
+    if (instance_snapshot_retake_pending.exchange(true))
+        return;
+
+    QMetaObject::invokeMethod(
+        this,
+        [this, delay] {
+            QTimer::singleShot(delay, this, [this] {
+                instance_snapshot_retake_pending = false;
+                take_instance_snapshot();
+            });
+        },
+        Qt::QueuedConnection);
+}
+
+// One "instance <name> <STATE>" or "network <name>" per line, states as InstanceStatus names them
+void mp::Daemon::update_completion_cache()
+{
+    const auto cache_path = QString::fromStdString(mp::utils::completion_cache_path(config->server_address));
+    if (cache_path.isEmpty())
+        return;
+
+    const auto snapshot = instance_snapshot();
+    fmt::memory_buffer contents;
+    for (const auto& instance : snapshot->operative)
+        fmt::format_to(std::back_inserter(contents), "instance {} {}\n", instance.name,
+                       mp::InstanceStatus::Status_Name(grpc_instance_status_for(instance.state)));
+    for (const auto& name : snapshot->deleted)
+        fmt::format_to(std::back_inserter(contents), "instance {} {}\n", name,
+                       mp::InstanceStatus::Status_Name(mp::InstanceStatus::DELETED));
+
+    std::lock_guard<std::mutex> lock{completion_cache_mutex};
+    for (const auto& name : known_networks)
+        fmt::format_to(std::back_inserter(contents), "network {}\n", name);
+
+    QSaveFile cache_file{cache_path};
+    const auto size = static_cast<qint64>(contents.size());
+    if (!cache_file.open(QIODevice::WriteOnly) || cache_file.write(contents.data(), size) != size ||
+        !cache_file.commit())
+    {
+        mpl::log(mpl::Level::debug, category,
+                 fmt::format("Cannot write the completion cache: {}", cache_file.errorString()));
+        return;
+    }
+
+    // Readable by whoever can talk to the daemon anyway
+    const QFileInfo socket{QString::fromStdString(config->server_address).section(':', 1)};
+    if (socket.exists())
+    {
+        MP_PLATFORM.chown(cache_path.toStdString().c_str(), socket.ownerId(), socket.groupId());
+        const auto readable = QFile::ReadOwner | QFile::ReadUser | QFile::ReadGroup | QFile::ReadOther;
+        QFile::setPermissions(cache_path, socket.permissions() & readable);
+    }
+}
+
+auto mp::Daemon::instance_snapshot() -> std::shared_ptr<const InstanceSnapshot>
+{
+    auto snapshot = std::atomic_load(&latest_instance_snapshot);
+    return snapshot ? snapshot : std::make_shared<const InstanceSnapshot>();
+}
+
+void mp::Daemon::release_resources(const std::string& instance)
+{
+    take_golden_image_candidate(instance);
+    ssh_sessions.forget(instance);
+#ifdef MULTIPASS_PLATFORM_LINUX
+    for (auto it = port_forwards.begin(); it != port_forwards.end();)
+        it = it->second.first == instance ? port_forwards.erase(it) : std::next(it);
+#endif
+    config->factory->remove_resources_for(instance);
+    config->vault->remove(instance);
+    empty_trash();
+
+    auto spec_it = vm_instance_specs.find(instance);
+    if (spec_it != cend(vm_instance_specs))
+    {
+        for (const auto& mac : mac_set_from(spec_it->second))
+            allocated_mac_addrs.erase(mac);
+
+        vm_instance_specs.erase(spec_it);
+    }
+}
+
+void mp::Daemon::create_vm(const CreateRequest* request,
+                           grpc::ServerReaderWriterInterface<CreateReply, CreateRequest>* server,
+                           std::promise<grpc::Status>* status_promise, bool start, bool warm)
+{
+    typedef typename std::pair<VirtualMachineDescription, ClientLaunchData> VMFullDescription;
+
+    auto checked_args = validate_create_arguments(request, config.get());
+
+    if (!checked_args.option_errors.error_codes().empty())
+    {
+        return status_promise->set_value(grpc::Status(grpc::StatusCode::INVALID_ARGUMENT, "Invalid arguments supplied",
+                                                      checked_args.option_errors.SerializeAsString()));
+    }
+    else if (auto& nets = checked_args.nets_need_bridging; !nets.empty() && !request->permission_to_bridge())
+    {
+        CreateError create_error;
+        create_error.add_error_codes(CreateError::INVALID_NETWORK);
+
+        CreateReply reply;
+        *reply.mutable_nets_need_bridging() = {std::make_move_iterator(nets.begin()),
+                                               std::make_move_iterator(nets.end())}; /* this constructs a temporary
+                                               RepeatedPtrField from the range, then move-assigns that temporary in */
+        server->Write(reply);
+
+        return status_promise->set_value(
+            grpc::Status{grpc::StatusCode::FAILED_PRECONDITION, "Missing bridges", create_error.SerializeAsString()});
+    }
+
+    // TODO: We should only need to query the Blueprint Provider once for all info, so this (and timeout below) will
+    //       need a refactoring to do so.
+    const std::string blueprint_name = config->blueprint_provider->name_from_blueprint(request->image());
+    auto name = name_from(checked_args.instance_name, blueprint_name, *config->name_generator, vm_instance_specs);
+
+    auto [instance_trail, status] =
+        find_instance_and_react(operative_instances, deleted_instances, name, require_missing_instances_reaction);
+
+    assert(status.ok() == (instance_trail.index() == 2));
+    if (!status.ok())
+        return status_promise->set_value(status);
+
+    if (preparing_instances.find(name) != preparing_instances.end())
+        return status_promise->set_value(
+            {grpc::StatusCode::INVALID_ARGUMENT, fmt::format("instance \"{}\" is being prepared", name), ""});
+
+    if (!instances_running(operative_instances))
+        config->factory->hypervisor_health_check();
+
+    // TODO: We should only need to query the Blueprint Provider once for all info, so this (and name above) will
+    //       need a refactoring to do so.
+    auto timeout = timeout_for(request->timeout(), config->blueprint_provider->blueprint_timeout(blueprint_name));
+
+    if (start && !warm && !warm_instances.empty() && fits_warm_pool(*request))
+        return launch_warm_instance(request, server, status_promise, timeout);
+
+    const auto num_cores = std::max(request->num_cores(), std::stoi(mp::default_cpu_cores));
+    const auto disk_space = checked_args.disk_space.value_or(MemorySize{mp::default_disk_size});
+    if (auto refusal = admission_refusal(vm_instance_specs, *config, num_cores, checked_args.mem_size, disk_space))
+        return status_promise->set_value({grpc::StatusCode::RESOURCE_EXHAUSTED, *refusal, ""});
+
+    preparing_instances.insert(name);
+
+    auto prepare_future_watcher = new QFutureWatcher<VMFullDescription>();
+    auto log_level = mpl::level_from(request->verbosity_level());
+
+    QObject::connect(
+        prepare_future_watcher, &QFutureWatcher<VMFullDescription>::finished,
+        [this, server, status_promise, name, timeout, start, warm, prepare_future_watcher, log_level] {
+            mpl::ClientLogger<CreateReply, CreateRequest> logger{log_level, *config->logger, server};
+
+            try
+            {
+                auto vm_desc_pair = prepare_future_watcher->future().result();
+                auto vm_desc = vm_desc_pair.first;
+                auto& vm_client_data = vm_desc_pair.second;
+                auto& vm_aliases = vm_client_data.aliases_to_be_created;
+                auto& vm_workspaces = vm_client_data.workspaces_to_be_created;
+
+                // Again, with what blueprints made of the request and what else was launched meanwhile
+                if (auto refusal = admission_refusal(vm_instance_specs, *config, vm_desc.num_cores, vm_desc.mem_size,
+                                                     vm_desc.disk_space))
+                    throw std::runtime_error{*refusal};
+
+                vm_instance_specs[name] = {vm_desc.num_cores,
                                            vm_desc.mem_size,
                                            vm_desc.disk_space,
                                            vm_desc.default_mac_address,
@@ -2501,13 +4841,23 @@ void mp::Daemon::create_vm(const CreateRequest* request,
                                            VirtualMachine::State::off,
                                            {},
                                            false,
-                                           QJsonObject()};
-                operative_instances[name] = config->factory->create_virtual_machine(vm_desc, *this);
-                preparing_instances.erase(name);
+                                           QJsonObject(),
+                                           warm};
+                auto vm = config->factory->create_virtual_machine(vm_desc, *this);
+                place_instance(*vm);
+                if (!warm)
+                {
+                    operative_instances[name] = vm;
+                    preparing_instances.erase(name);
+                }
 
                 persist_instances();
 
-                if (start)
+                if (warm)
+                {
+                    warm_up_instance(name, std::move(vm));
+                }
+                else if (start)
                 {
                     LaunchReply reply;
                     reply.set_create_message("Starting " + name);
@@ -2558,6 +4908,12 @@ void mp::Daemon::create_vm(const CreateRequest* request,
                 operative_instances.erase(name);
                 persist_instances();
                 status_promise->set_value(grpc::Status(grpc::StatusCode::FAILED_PRECONDITION, e.what(), ""));
+
+                if (warm)
+                {
+                    mpl::log(mpl::Level::warning, category, fmt::format("Cannot warm up an instance: {}", e.what()));
+                    warm_up.reset();
+                }
             }
 
             delete prepare_future_watcher;
@@ -2568,10 +4924,39 @@ void mp::Daemon::create_vm(const CreateRequest* request,
 
         try
         {
+            mpl::TraceSpan span{"create_vm", name};
             CreateReply reply;
             reply.set_create_message("Creating " + name);
             server->Write(reply);
 
+            // Stages are timed for the client to see where launching goes
+            using Clock = std::chrono::steady_clock;
+            CreateReply timings_reply;
+            auto time_stage = [&timings_reply, &name](const std::string& stage, Clock::duration duration) {
+                const auto milliseconds = std::chrono::duration_cast<std::chrono::milliseconds>(duration).count();
+                mpl::log(mpl::Level::debug, category,
+                         fmt::format("Preparing {}: {} took {}ms", name, stage, milliseconds));
+
+                const auto now = Clock::now();
+                MP_TRACER.record(stage, name, now - duration, now);
+                MP_METRICS.observe("multipass_launch_stage_duration_seconds", {{"stage", stage}}, duration);
+
+                auto timing = timings_reply.add_stage_timings();
+                timing->set_stage(stage);
+                timing->set_milliseconds(milliseconds);
+            };
+
+            // Setting up host networking does not depend on the image. It can take long when bridges are involved,
+            // and downloading the image takes longer still, so they are done side by side.
+            auto& extra_interfaces = checked_args.extra_interfaces;
+            auto networking = std::async(extra_interfaces.empty() ? std::launch::deferred : std::launch::async,
+                                         [this, &extra_interfaces] {
+                                             const auto started = Clock::now();
+                                             config->factory->prepare_networking(extra_interfaces);
+                                             return Clock::now() - started;
+                                         });
+
+            auto stage_started = Clock::now();
             Query query;
             VirtualMachineDescription vm_desc{
                 request->num_cores(),
@@ -2585,13 +4970,13 @@ void mp::Daemon::create_vm(const CreateRequest* request,
                 "",
                 YAML::Node{},
                 YAML::Node{},
-                make_cloud_init_vendor_config(*config->ssh_key_provider, config->ssh_username,
-                                              config->factory->get_backend_version_string().toStdString(), request),
+                cloud_init_vendor_config(config->ssh_username, request),
                 YAML::Node{}};
 
             ClientLaunchData client_launch_data;
 
             bool launch_from_blueprint{true};
+            std::string blueprint_version; // for those that can have golden images
             try
             {
                 auto image = request->image();
@@ -2613,117 +4998,505 @@ void mp::Daemon::create_vm(const CreateRequest* request,
                 else
                 {
                     query = config->blueprint_provider->fetch_blueprint_for(image, vm_desc, client_launch_data);
+                    if (const auto info = config->blueprint_provider->info_for(image))
+                        blueprint_version = info->version.toStdString();
+                }
+
+                query.name = name;
+
+                // Aliases and default workspace are named in function of the instance name in the Blueprint. If the
+                // user asked for a different name, it will be necessary to change the alias definitions and the
+                // workspace name to reflect it.
+                if (name != image)
+                {
+                    for (auto& alias_to_define : client_launch_data.aliases_to_be_created)
+                        if (alias_to_define.second.instance == image)
+                        {
+                            mpl::log(mpl::Level::trace, category,
+                                     fmt::format("Renaming instance on alias \"{}\" from \"{}\" to \"{}\"",
+                                                 alias_to_define.first, alias_to_define.second.instance, name));
+                            alias_to_define.second.instance = name;
+                        }
+
+                    for (auto& workspace_to_create : client_launch_data.workspaces_to_be_created)
+                        if (workspace_to_create == image)
+                        {
+                            mpl::log(mpl::Level::trace, category,
+                                     fmt::format("Renaming workspace \"{}\" to \"{}\"", workspace_to_create, name));
+                            workspace_to_create = name;
+                        }
+                }
+            }
+            catch (const std::out_of_range&)
+            {
+                // Blueprint not found, move on
+                launch_from_blueprint = false;
+                query = query_from(request, name);
+                vm_desc.mem_size = checked_args.mem_size;
+            }
+
+            time_stage("blueprint", Clock::now() - stage_started);
+            stage_started = Clock::now();
+
+            auto progress_monitor = [server](int progress_type, int percentage) {
+                CreateReply create_reply;
+                create_reply.mutable_launch_progress()->set_percent_complete(std::to_string(percentage));
+                create_reply.mutable_launch_progress()->set_type((CreateProgress::ProgressTypes)progress_type);
+                return server->Write(create_reply);
+            };
+
+            auto prepare_action = [this, server, &name](const VMImage& source_image) -> VMImage {
+                CreateReply reply;
+                reply.set_create_message("Preparing image for " + name);
+                server->Write(reply);
+
+                return config->factory->prepare_source_image(source_image);
+            };
+
+            auto fetch_type = config->factory->fetch_type();
+
+            std::optional<std::string> checksum;
+            if (!vm_desc.image.id.empty())
+                checksum = vm_desc.image.id;
+
+            auto vm_image = config->vault->fetch_image(fetch_type, query, prepare_action, progress_monitor,
+                                                       launch_from_blueprint, checksum);
+            evict_images(); // what was just fetched may well have taken the cache over its size
+
+            bool from_golden_image{false};
+            if (!blueprint_version.empty() && config->vault->keeps_golden_images())
+            {
+                const auto key = golden_image_key(request->image(), blueprint_version, vm_image.id);
+                if (auto golden_image = config->vault->golden_image_for(key, name))
+                {
+                    mpl::log(mpl::Level::debug, category, fmt::format("Starting {} from golden image {}", name, key));
+                    vm_image = *golden_image;
+                    from_golden_image = true;
+
+                    // What the blueprint had cloud-init do is done already
+                    vm_desc.vendor_data_config = cloud_init_vendor_config(config->ssh_username, request);
+                }
+                else if (request->cloud_init_user_data().empty())
+                {
+                    // Not with the user's own cloud-init in, which is not the blueprint's to give to everyone else
+                    std::lock_guard lock{golden_image_mutex};
+                    golden_image_candidates[name] = key;
+                }
+            }
+
+            const auto image_size = config->vault->minimum_image_size_for(vm_image.id);
+            vm_desc.disk_space = compute_final_image_size(
+                image_size, vm_desc.disk_space.in_bytes() > 0 ? vm_desc.disk_space : checked_args.disk_space,
+                config->data_directory);
+
+            time_stage("image", Clock::now() - stage_started);
+
+            reply.set_create_message("Configuring " + name);
+            server->Write(reply);
+
+            time_stage("networking", networking.get());
+            stage_started = Clock::now();
+
+            // This set stores the MAC's which need to be in the allocated_mac_addrs if everything goes well.
+            auto new_macs = allocated_mac_addrs;
+
+            // check for repetition of requested macs
+            for (auto& iface : checked_args.extra_interfaces)
+                if (!iface.mac_address.empty() && !new_macs.insert(iface.mac_address).second)
+                    throw std::runtime_error(fmt::format("Repeated MAC address {}", iface.mac_address));
+
+            // generate missing macs in a second pass, to avoid repeating macs that the user requested
+            for (auto& iface : checked_args.extra_interfaces)
+                if (iface.mac_address.empty())
+                    iface.mac_address = generate_unused_mac_address(new_macs);
+
+            vm_desc.default_mac_address = generate_unused_mac_address(new_macs);
+            vm_desc.extra_interfaces = checked_args.extra_interfaces;
+
+            vm_desc.meta_data_config = make_cloud_init_meta_config(name);
+            vm_desc.user_data_config = YAML::Load(request->cloud_init_user_data());
+            if (from_golden_image)
+                reset_machine_id_on_first_boot(vm_desc.user_data_config);
+            prepare_user_data(vm_desc.user_data_config, vm_desc.vendor_data_config);
+
+            if (vm_desc.num_cores < std::stoi(mp::min_cpu_cores))
+                vm_desc.num_cores = std::stoi(mp::default_cpu_cores);
+
+            vm_desc.network_data_config =
+                make_cloud_init_network_config(vm_desc.default_mac_address, checked_args.extra_interfaces);
+
+            vm_desc.image = vm_image;
+            config->factory->configure(vm_desc);
+
+            time_stage("configuration", Clock::now() - stage_started);
+            stage_started = Clock::now();
+
+            config->factory->prepare_instance_image(vm_image, vm_desc);
+
+            time_stage("instance image", Clock::now() - stage_started);
+            server->Write(timings_reply);
+
+            // Everything went well, add the MAC addresses used in this instance.
+            allocated_mac_addrs = std::move(new_macs);
+
+            return VMFullDescription{vm_desc, client_launch_data};
+        }
+        catch (const std::exception& e)
+        {
+            throw CreateImageException(e.what());
+        }
+    };
+
+    // Instances for the warm pool are made whenever there is nothing better to do
+    prepare_future_watcher->setFuture(warm ? run_in_background(background_pool, make_vm_description)
+                                           : QtConcurrent::run(&launch_pool, make_vm_description));
+}
+
+void mp::Daemon::evict_images()
+{
+    const auto cache_size = MP_SETTINGS.get(mp::image_cache_size_key);
+    if (cache_size.isEmpty() || evicting_images.exchange(true))
+        return;
+
+    run_in_background(background_pool, [this, budget = MemorySize{cache_size.toStdString()}] {
+        try
+        {
+            config->vault->prune_to_size(budget);
+        }
+        catch (const std::exception& e)
+        {
+            mpl::log(mpl::Level::warning, category, fmt::format("Cannot evict images: {}", e.what()));
+        }
+
+        evicting_images = false;
+    });
+}
+
+void mp::Daemon::empty_trash()
+{
+    trash_pending = true;
+    if (emptying_trash.exchange(true))
+        return;
+
+    // Goes round once more if asked again meanwhile, for what was thrown away since the round started
+    run_in_background(background_pool, [this] {
+        do
+        {
+            trash_pending = false;
+            try
+            {
+                config->vault->empty_trash();
+            }
+            catch (const std::exception& e)
+            {
+                mpl::log(mpl::Level::warning, category, fmt::format("Cannot empty the image trash: {}", e.what()));
+            }
+
+            emptying_trash = false;
+        } while (trash_pending && !emptying_trash.exchange(true));
+    });
+}
+
+std::string mp::Daemon::take_golden_image_candidate(const std::string& name)
+{
+    std::lock_guard lock{golden_image_mutex};
+    auto it = golden_image_candidates.find(name);
+    if (it == golden_image_candidates.end())
+        return {};
+
+    auto key = std::move(it->second);
+    golden_image_candidates.erase(it);
+    return key;
+}
+
+void mp::Daemon::keep_golden_image(VirtualMachine& vm, const std::string& key, const std::chrono::seconds& timeout)
+{
+    mpl::TraceSpan span{"keep_golden_image", vm.vm_name};
+
+    // Stopped and started again from the daemon's thread, as some backends need their processes to belong to it
+    auto in_daemon_thread = [this](const std::function<void()>& action) {
+        std::string error;
+        QMetaObject::invokeMethod(
+            this,
+            [&action, &error] {
+                try
+                {
+                    action();
                 }
+                catch (const std::exception& e)
+                {
+                    error = e.what();
+                }
+            },
+            Qt::BlockingQueuedConnection);
+
+        if (!error.empty())
+            throw std::runtime_error(error);
+    };
+
+    // Copied while off, for the disk to be as the guest left it. Failing that is no reason to fail the launch.
+    try
+    {
+        in_daemon_thread([&vm] { vm.shutdown(); });
+        config->vault->keep_golden_image(key, vm.vm_name);
+    }
+    catch (const std::exception& e)
+    {
+        mpl::log(mpl::Level::warning, category,
+                 fmt::format("Cannot keep a golden image of {}: {}", vm.vm_name, e.what()));
+    }
+
+    if (vm.current_state() == VirtualMachine::State::running)
+        return;
+
+    in_daemon_thread([&vm] { vm.start(); });
+    vm.wait_until_ssh_up(timeout);
+}
+
+void mp::Daemon::fill_warm_pool()
+try
+{
+    const auto pool_size = MP_SETTINGS.get(mp::warm_pool_key).toUInt();
+    while (warm_instances.size() > pool_size)
+    {
+        auto it = warm_instances.begin();
+        discard_warm_instance(it->first, *it->second);
+        warm_instances.erase(it);
+    }
 
-                query.name = name;
+    // One at a time, so that filling the pool does not get in the way of what is being launched meanwhile
+    if (warm_up || warm_instances.size() >= pool_size)
+        return;
 
-                // Aliases and default workspace are named in function of the instance name in the Blueprint. If the
-                // user asked for a different name, it will be necessary to change the alias definitions and the
-                // workspace name to reflect it.
-                if (name != image)
-                {
-                    for (auto& alias_to_define : client_launch_data.aliases_to_be_created)
-                        if (alias_to_define.second.instance == image)
-                        {
-                            mpl::log(mpl::Level::trace, category,
-                                     fmt::format("Renaming instance on alias \"{}\" from \"{}\" to \"{}\"",
-                                                 alias_to_define.first, alias_to_define.second.instance, name));
-                            alias_to_define.second.instance = name;
-                        }
+    warm_up = std::make_unique<WarmUp>();
+    warm_up->request.set_time_zone(QTimeZone::systemTimeZoneId().toStdString());
+    create_vm(&warm_up->request, &warm_up->server, &warm_up->status_promise, /*start=*/true, /*warm=*/true);
 
-                    for (auto& workspace_to_create : client_launch_data.workspaces_to_be_created)
-                        if (workspace_to_create == image)
-                        {
-                            mpl::log(mpl::Level::trace, category,
-                                     fmt::format("Renaming workspace \"{}\" to \"{}\"", workspace_to_create, name));
-                            workspace_to_create = name;
-                        }
-                }
+    // Turned down before getting anywhere
+    if (warm_up && warm_up->status.wait_for(std::chrono::seconds::zero()) == std::future_status::ready)
+    {
+        mpl::log(mpl::Level::warning, category,
+                 fmt::format("Cannot warm up an instance: {}", warm_up->status.get().error_message()));
+        warm_up.reset();
+    }
+}
+catch (const std::exception& e)
+{
+    mpl::log(mpl::Level::warning, category, fmt::format("Cannot fill the warm instance pool: {}", e.what()));
+}
+
+void mp::Daemon::warm_up_instance(const std::string& name, VirtualMachine::ShPtr vm)
+{
+    mpl::log(mpl::Level::info, category, fmt::format("Warming up {}", name));
+    warm_up->vm = vm;
+    vm->start(); // here, the process some backends start belongs to this thread
+
+    auto boot_watcher = new QFutureWatcher<std::string>();
+    QObject::connect(boot_watcher, &QFutureWatcher<std::string>::finished, this, [this, name, boot_watcher] {
+        auto vm = std::move(warm_up->vm);
+        warm_up.reset();
+
+        if (auto error = boot_watcher->result(); !error.empty())
+        {
+            mpl::log(mpl::Level::warning, category, fmt::format("Cannot warm up {}: {}", name, error));
+            discard_warm_instance(name, *vm);
+        }
+        else
+        {
+            // Suspended where possible, so that taking it is only a matter of resuming
+            try
+            {
+                vm->suspend();
             }
-            catch (const std::out_of_range&)
+            catch (const std::exception& e)
             {
-                // Blueprint not found, move on
-                launch_from_blueprint = false;
-                query = query_from(request, name);
-                vm_desc.mem_size = checked_args.mem_size;
+                mpl::log(mpl::Level::debug, category,
+                         fmt::format("Stopping {} instead of suspending: {}", name, e.what()));
+                mp::top_catch_all(name, [&vm] { vm->shutdown(); });
             }
 
-            auto progress_monitor = [server](int progress_type, int percentage) {
-                CreateReply create_reply;
-                create_reply.mutable_launch_progress()->set_percent_complete(std::to_string(percentage));
-                create_reply.mutable_launch_progress()->set_type((CreateProgress::ProgressTypes)progress_type);
-                return server->Write(create_reply);
-            };
+            mpl::log(mpl::Level::info, category, fmt::format("{} is warm", name));
+            warm_instances[name] = std::move(vm);
+            fill_warm_pool();
+        }
 
-            auto prepare_action = [this, server, &name](const VMImage& source_image) -> VMImage {
-                CreateReply reply;
-                reply.set_create_message("Preparing image for " + name);
-                server->Write(reply);
+        delete boot_watcher;
+    });
 
-                return config->factory->prepare_source_image(source_image);
-            };
+    boot_watcher->setFuture(QtConcurrent::run([this, vm]() -> std::string {
+        try
+        {
+            vm->wait_until_ssh_up(mp::default_timeout);
+            MP_UTILS.wait_for_cloud_init(vm.get(), mp::default_timeout, *config->ssh_key_provider);
+            return {};
+        }
+        catch (const std::exception& e)
+        {
+            return e.what();
+        }
+    }));
+}
 
-            auto fetch_type = config->factory->fetch_type();
+void mp::Daemon::discard_warm_instance(const std::string& name, VirtualMachine& vm)
+{
+    mpl::log(mpl::Level::info, category, fmt::format("Discarding warm instance {}", name));
+    mp::top_catch_all(name, [&vm] {
+        if (needs_shutdown(vm.current_state()))
+            vm.shutdown();
+    });
 
-            std::optional<std::string> checksum;
-            if (!vm_desc.image.id.empty())
-                checksum = vm_desc.image.id;
+    preparing_instances.erase(name);
+    release_resources(name);
+    persist_instances();
+}
 
-            auto vm_image = config->vault->fetch_image(fetch_type, query, prepare_action, progress_monitor,
-                                                       launch_from_blueprint, checksum);
+void mp::Daemon::launch_batch(const LaunchRequest* request,
+                              grpc::ServerReaderWriterInterface<LaunchReply, LaunchRequest>* server,
+                              std::promise<grpc::Status>* status_promise)
+{
+    // Names are settled beforehand, so that what is said about each instance can be told apart from the start
+    auto pattern = request->instance_name();
+    if (pattern.empty())
+        pattern = config->blueprint_provider->name_from_blueprint(request->image());
 
-            const auto image_size = config->vault->minimum_image_size_for(vm_image.id);
-            vm_desc.disk_space = compute_final_image_size(
-                image_size, vm_desc.disk_space.in_bytes() > 0 ? vm_desc.disk_space : checked_args.disk_space,
-                config->data_directory);
+    std::unordered_set<std::string> taken_names{preparing_instances};
+    for (const auto& [name, specs] : vm_instance_specs)
+        taken_names.insert(name);
 
-            reply.set_create_message("Configuring " + name);
-            server->Write(reply);
+    auto batch = std::make_shared<BatchLaunch>();
+    for (auto number = 1; number <= request->count(); ++number)
+    {
+        auto name = pattern.empty() ? name_from({}, {}, *config->name_generator, taken_names)
+                                    : batch_member_name(pattern, number);
+        taken_names.insert(name);
+        batch->members.push_back(std::make_unique<BatchLaunch::Member>(server, batch->write_mutex, *request, name));
+    }
 
-            config->factory->prepare_networking(checked_args.extra_interfaces);
+    mpl::log(mpl::Level::info, category, fmt::format("Launching {} instances together", batch->members.size()));
 
-            // This set stores the MAC's which need to be in the allocated_mac_addrs if everything goes well.
-            auto new_macs = allocated_mac_addrs;
+    // Each goes its own way from here, the vault fetching their image once for all and cloning each disk from it
+    for (auto& member : batch->members)
+        launch(&member->request, &member->server, &member->status_promise);
 
-            // check for repetition of requested macs
-            for (auto& iface : checked_args.extra_interfaces)
-                if (!iface.mac_address.empty() && !new_macs.insert(iface.mac_address).second)
-                    throw std::runtime_error(fmt::format("Repeated MAC address {}", iface.mac_address));
+    // The promises are set from this thread, so the batch is done with here too, once they have all been kept
+    QtConcurrent::run([this, batch = std::move(batch), status_promise]() mutable {
+        for (const auto& member : batch->members)
+            member->status.wait();
 
-            // generate missing macs in a second pass, to avoid repeating macs that the user requested
-            for (auto& iface : checked_args.extra_interfaces)
-                if (iface.mac_address.empty())
-                    iface.mac_address = generate_unused_mac_address(new_macs);
+        QMetaObject::invokeMethod(
+            this, [batch = std::move(batch), status_promise] { status_promise->set_value(batch->status()); },
+            Qt::QueuedConnection);
+    });
+}
 
-            vm_desc.default_mac_address = generate_unused_mac_address(new_macs);
-            vm_desc.extra_interfaces = checked_args.extra_interfaces;
+void mp::Daemon::next_apply_step(std::shared_ptr<Reconcile> reconcile, std::size_t index)
+{
+    auto& pipeline = reconcile->pipelines[index];
+    if (!pipeline.status.ok() || pipeline.steps.empty())
+    {
+        const auto outcome = pipeline.changed ? "done" : "up to date";
+        reconcile->say(pipeline.instance,
+                       pipeline.status.ok() ? outcome : "failed: " + pipeline.status.error_message());
+        if (--reconcile->remaining == 0)
+            reconcile->status_promise->set_value(reconcile->status());
+        return;
+    }
 
-            vm_desc.meta_data_config = make_cloud_init_meta_config(name);
-            vm_desc.user_data_config = YAML::Load(request->cloud_init_user_data());
-            prepare_user_data(vm_desc.user_data_config, vm_desc.vendor_data_config);
+    auto [doing, step] = std::move(pipeline.steps.front());
+    pipeline.steps.pop_front();
+    pipeline.changed = true;
+    reconcile->say(pipeline.instance, doing);
 
-            if (vm_desc.num_cores < std::stoi(mp::min_cpu_cores))
-                vm_desc.num_cores = std::stoi(mp::default_cpu_cores);
+    std::shared_future<grpc::Status> status;
+    try
+    {
+        status = step();
+    }
+    catch (const std::exception& e)
+    {
+        std::promise<grpc::Status> failure;
+        failure.set_value({grpc::StatusCode::FAILED_PRECONDITION, e.what(), ""});
+        status = failure.get_future();
+    }
 
-            vm_desc.network_data_config =
-                make_cloud_init_network_config(vm_desc.default_mac_address, checked_args.extra_interfaces);
+    // Waited on apart, the step being kept on the main thread, or elsewhere by then
+    QtConcurrent::run(&apply_pool, [this, reconcile = std::move(reconcile), index, status]() mutable {
+        while (status.wait_for(apply_poll_interval) != std::future_status::ready)
+            if (stop_applies)
+                return;
+
+        QMetaObject::invokeMethod(
+            this,
+            [this, reconcile = std::move(reconcile), index, status] {
+                reconcile->pipelines[index].status = status.get();
+                next_apply_step(reconcile, index);
+            },
+            Qt::QueuedConnection);
+    });
+}
 
-            vm_desc.image = vm_image;
-            config->factory->configure(vm_desc);
-            config->factory->prepare_instance_image(vm_image, vm_desc);
+void mp::Daemon::launch_warm_instance(const LaunchRequest* request,
+                                      grpc::ServerReaderWriterInterface<LaunchReply, LaunchRequest>* server,
+                                      std::promise<grpc::Status>* status_promise, std::chrono::seconds timeout)
+{
+    auto it = warm_instances.begin();
+    const auto name = it->first;
+
+    // Counted as what it would add to the others, like any other launch
+    auto others = vm_instance_specs;
+    others.erase(name);
+    const auto& specs = vm_instance_specs[name];
+    if (auto refusal = admission_refusal(others, *config, specs.num_cores, specs.mem_size, specs.disk_space))
+        return status_promise->set_value({grpc::StatusCode::RESOURCE_EXHAUSTED, *refusal, ""});
+
+    operative_instances[name] = std::move(it->second);
+    warm_instances.erase(it);
+    preparing_instances.erase(name);
+    vm_instance_specs[name].warm = false;
+    persist_instances();
 
-            // Everything went well, add the MAC addresses used in this instance.
-            allocated_mac_addrs = std::move(new_macs);
+    mpl::log(mpl::Level::info, category, fmt::format("Launching warm instance {}", name));
+    LaunchReply reply;
+    reply.set_create_message("Starting " + name);
+    server->Write(reply);
 
-            return VMFullDescription{vm_desc, client_launch_data};
-        }
-        catch (const std::exception& e)
+    auto vm = operative_instances[name];
+    vm->start();
+
+    auto future_watcher = create_future_watcher([this, server, name] {
+        LaunchReply reply;
+        reply.set_vm_instance_name(name);
+        config->update_prompt->populate_if_time_to_show(reply.mutable_update_info());
+        server->Write(reply);
+    });
+
+    // The instance was set up for this host's time zone, the rest of its cloud-init config is the same for everyone
+    auto time_zone = request->time_zone();
+    future_watcher->setFuture(QtConcurrent::run([this, server, name, timeout, status_promise, vm, time_zone] {
+        auto result = async_wait_for_ready_all<LaunchReply, LaunchRequest>(server, std::vector<std::string>{name},
+                                                                           timeout, status_promise, std::string());
+
+        if (result.status.ok() && !time_zone.empty() && time_zone != QTimeZone::systemTimeZoneId().toStdString())
         {
-            throw CreateImageException(e.what());
+            try
+            {
+                ssh_sessions.with_session(name, vm->ssh_hostname(), vm->ssh_port(), vm->ssh_username(),
+                                          *config->ssh_key_provider, [&time_zone](mp::SSHSession& session) {
+                                              mpu::run_in_ssh_session(
+                                                  session, fmt::format("sudo timedatectl set-timezone {}", time_zone));
+                                          });
+            }
+            catch (const std::exception& e)
+            {
+                mpl::log(mpl::Level::warning, category,
+                         fmt::format("Cannot set the time zone of {} to {}: {}", name, time_zone, e.what()));
+            }
         }
-    };
 
-    prepare_future_watcher->setFuture(QtConcurrent::run(make_vm_description));
+        return result;
+    }));
+
+    QTimer::singleShot(0, this, [this] { fill_warm_pool(); });
 }
 
 grpc::Status mp::Daemon::reboot_vm(VirtualMachine& vm)
@@ -2742,29 +5515,13 @@ grpc::Status mp::Daemon::reboot_vm(VirtualMachine& vm)
 grpc::Status mp::Daemon::shutdown_vm(VirtualMachine& vm, const std::chrono::milliseconds delay)
 {
     const auto& name = vm.vm_name;
-    const auto& state = vm.current_state();
-
-    using St = VirtualMachine::State;
-    const auto skip_states = {St::off, St::stopped, St::suspended};
 
-    if (std::none_of(cbegin(skip_states), cend(skip_states), [&state](const auto& st) { return state == st; }))
+    if (needs_shutdown(vm.current_state()))
     {
         delayed_shutdown_instances.erase(name);
+        ssh_sessions.forget(name);
 
-        std::optional<mp::SSHSession> session;
-        try
-        {
-            session = mp::SSHSession{vm.ssh_hostname(), vm.ssh_port(), vm.ssh_username(), *config->ssh_key_provider};
-        }
-        catch (const std::exception& e)
-        {
-            mpl::log(mpl::Level::info, category,
-                     fmt::format("Cannot open ssh session on \"{}\" shutdown: {}", name, e.what()));
-        }
-
-        auto stop_all_mounts = [this](const std::string& name) { stop_mounts(name); };
-        auto& shutdown_timer = delayed_shutdown_instances[name] =
-            std::make_unique<DelayedShutdownTimer>(&vm, std::move(session), stop_all_mounts);
+        auto& shutdown_timer = delayed_shutdown_instances[name] = make_shutdown_timer(vm);
 
         QObject::connect(shutdown_timer.get(), &DelayedShutdownTimer::finished,
                          [this, name]() { delayed_shutdown_instances.erase(name); });
@@ -2777,6 +5534,23 @@ grpc::Status mp::Daemon::shutdown_vm(VirtualMachine& vm, const std::chrono::mill
     return grpc::Status::OK;
 }
 
+std::unique_ptr<mp::DelayedShutdownTimer> mp::Daemon::make_shutdown_timer(VirtualMachine& vm)
+{
+    std::optional<mp::SSHSession> session;
+    try
+    {
+        session = mp::SSHSession{vm.ssh_hostname(), vm.ssh_port(), vm.ssh_username(), *config->ssh_key_provider};
+    }
+    catch (const std::exception& e)
+    {
+        mpl::log(mpl::Level::info, category,
+                 fmt::format("Cannot open ssh session on \"{}\" shutdown: {}", vm.vm_name, e.what()));
+    }
+
+    auto stop_all_mounts = [this](const std::string& name) { stop_mounts(name); };
+    return std::make_unique<DelayedShutdownTimer>(&vm, std::move(session), stop_all_mounts);
+}
+
 grpc::Status mp::Daemon::cancel_vm_shutdown(const VirtualMachine& vm)
 {
     auto it = delayed_shutdown_instances.find(vm.vm_name);
@@ -2811,6 +5585,8 @@ grpc::Status mp::Daemon::get_ssh_info_for_vm(VirtualMachine& vm, SSHInfoReply& r
     ssh_info.set_port(vm.ssh_port());
     ssh_info.set_priv_key_base64(config->ssh_key_provider->private_key_as_base64());
     ssh_info.set_username(vm.ssh_username());
+    ssh_info.set_compression(MP_SETTINGS.get(mp::ssh_compression_key).toStdString());
+    ssh_info.set_transfer_window(MP_SETTINGS.get(mp::transfer_window_key).toInt());
     (*response.mutable_ssh_info())[name] = ssh_info;
 
     return grpc::Status::OK;
@@ -2841,12 +5617,17 @@ void mp::Daemon::init_mounts(const std::string& name)
         vm_spec_mounts.erase(mount_target);
 
     if (!mounts_to_remove.empty())
-        persist_instances();
+        persist_instance(name);
 }
 
 void mp::Daemon::stop_mounts(const std::string& name)
 {
-    for (auto& [_, mount] : mounts[name])
+    // Only looked up, several instances may be stopping at once
+    const auto mounts_it = mounts.find(name);
+    if (mounts_it == mounts.end())
+        return;
+
+    for (auto& [_, mount] : mounts_it->second)
     {
         if (!mount->is_mount_managed_by_backend())
         {
@@ -2862,9 +5643,86 @@ mp::MountHandler::UPtr mp::Daemon::make_mount(VirtualMachine* vm, const std::str
                : vm->make_native_mount_handler(config->ssh_key_provider.get(), target, mount);
 }
 
+std::string mp::Daemon::release_title_for(const VMImage& image)
+{
+    if (!image.original_release.empty() || image.id.empty())
+        return image.original_release;
+
+    std::lock_guard<std::mutex> lock{release_titles_mutex};
+    if (const auto it = release_titles.find(image.id); it != release_titles.end())
+        return it->second;
+
+    // Not known yet, looked up in the background so that listing instances never waits on manifests
+    unresolved_release_titles.insert(image.id);
+    if (!release_title_lookup.isRunning())
+        release_title_lookup = run_in_background(background_pool, [this] {
+            for (;;)
+            {
+                std::string id;
+                {
+                    std::lock_guard<std::mutex> lock{release_titles_mutex};
+                    if (unresolved_release_titles.empty())
+                        return;
+                    id = *unresolved_release_titles.begin();
+                }
+
+                std::string release_title;
+                try
+                {
+                    release_title = config->image_hosts.back()->info_for_full_hash(id).release_title.toStdString();
+                }
+                catch (const std::exception& e)
+                {
+                    mpl::log(mpl::Level::warning, category,
+                             fmt::format("Cannot fetch image information: {}", e.what()));
+                }
+
+                std::lock_guard<std::mutex> lock{release_titles_mutex};
+                unresolved_release_titles.erase(id);
+                release_titles[id] = release_title;
+            }
+        });
+
+    return {};
+}
+
+YAML::Node mp::Daemon::cloud_init_vendor_config(const std::string& username, const CreateRequest* request)
+{
+    // Nothing of the instance goes in, so launches of the same image share it, and only copies are handed out as
+    // blueprints and user data add to it
+    const auto key = fmt::format("{}\n{}\n{}\n{}", username, request->remote_name(), request->image(),
+                                 request->time_zone());
+
+    std::lock_guard<std::mutex> lock{vendor_configs_mutex};
+    auto it = vendor_configs.find(key);
+    if (it == vendor_configs.end())
+    {
+        if (backend_version.empty())
+            backend_version = config->factory->get_backend_version_string().toStdString();
+
+        it = vendor_configs
+                 .emplace(key, make_cloud_init_vendor_config(*config->ssh_key_provider, username, backend_version,
+                                                             request))
+                 .first;
+    }
+
+    return YAML::Clone(it->second);
+}
+
 QFutureWatcher<mp::Daemon::AsyncOperationStatus>*
 mp::Daemon::create_future_watcher(std::function<void()> const& finished_op)
 {
+    // Those that were never given their future, for the operation failed before it got going, would never finish
+    const auto never_started = std::partition(async_future_watchers.begin(), async_future_watchers.end(),
+                                              [](const std::unique_ptr<QFutureWatcher<AsyncOperationStatus>>& watcher) {
+                                                  return !watcher->future().isCanceled();
+                                              });
+    std::for_each(never_started, async_future_watchers.end(),
+                  [](std::unique_ptr<QFutureWatcher<AsyncOperationStatus>>& watcher) {
+                      watcher.release()->deleteLater();
+                  });
+    async_future_watchers.erase(never_started, async_future_watchers.end());
+
     async_future_watchers.emplace_back(std::make_unique<QFutureWatcher<AsyncOperationStatus>>());
 
     auto future_watcher = async_future_watchers.back().get();
@@ -2899,35 +5757,94 @@ mp::Daemon::async_wait_for_ssh_and_start_mounts_for(const std::string& name, con
             }
 
             MP_UTILS.wait_for_cloud_init(vm.get(), timeout, *config->ssh_key_provider);
+
+            if (const auto golden_key = take_golden_image_candidate(name); !golden_key.empty())
+            {
+                if (server)
+                {
+                    Reply reply;
+                    reply.set_reply_message("Keeping the provisioned image for later launches");
+                    server->Write(reply);
+                }
+
+                keep_golden_image(*vm, golden_key, timeout);
+            }
+        }
+
+        try
+        {
+            vm->capture_boot_files(*config->ssh_key_provider);
+        }
+        catch (const std::exception& e)
+        {
+            mpl::log(mpl::Level::warning, name, fmt::format("Cannot copy boot files for fast boot: {}", e.what()));
         }
 
         if (MP_SETTINGS.get_as<bool>(mp::mounts_key))
         {
+            std::mutex results_mutex;
+            bool sshfs_missing{false};
             std::vector<std::string> invalid_mounts;
             fmt::memory_buffer warnings;
             auto& vm_mounts = mounts[name];
-            for (auto& [target, mount] : vm_mounts)
+            auto& vm_spec_mounts = vm_instance_specs[name].mounts;
+
+            auto activate = [&](const std::string& target, MountHandler& mount, ServerVariant mount_server) {
                 try
                 {
-                    if (!mount->is_mount_managed_by_backend())
-                    {
-                        mount->activate(server);
-                    }
+                    const auto start = std::chrono::steady_clock::now();
+                    mount.activate(mount_server);
+
+                    const auto elapsed = std::chrono::duration_cast<std::chrono::milliseconds>(
+                        std::chrono::steady_clock::now() - start);
+                    mpl::log(mpl::Level::info, category,
+                             fmt::format("Mount \"{}\" in '{}' activated in {}ms", target, name, elapsed.count()));
                 }
                 catch (const mp::SSHFSMissingError&)
                 {
-                    add_fmt_to(errors, sshfs_error_template, name);
-                    break;
+                    std::lock_guard lock{results_mutex};
+                    sshfs_missing = true;
                 }
                 catch (const std::exception& e)
                 {
                     auto msg = fmt::format("Removing mount \"{}\" from '{}': {}\n", target, name, e.what());
                     mpl::log(mpl::Level::warning, category, msg);
+
+                    std::lock_guard lock{results_mutex};
                     fmt::format_to(std::back_inserter(warnings), msg);
                     invalid_mounts.push_back(target);
                 }
+            };
+
+            std::vector<std::pair<std::string, MountHandler*>> pending;
+            for (auto& [target, mount] : vm_mounts)
+                if (!mount->is_mount_managed_by_backend())
+                    pending.emplace_back(target, mount.get());
+
+            // The first classic mount goes alone: it may need to install sshfs, which the others then rely on
+            auto first_classic = std::find_if(pending.begin(), pending.end(), [&vm_spec_mounts](const auto& entry) {
+                auto it = vm_spec_mounts.find(entry.first);
+                return it != vm_spec_mounts.end() && it->second.mount_type == VMMount::MountType::Classic;
+            });
+            if (first_classic != pending.end())
+            {
+                activate(first_classic->first, *first_classic->second, server);
+                pending.erase(first_classic);
+            }
+
+            // Only the one above can have anything to tell the client, the rest would write to it concurrently
+            std::vector<std::function<void()>> activations;
+            if (!sshfs_missing)
+                for (const auto& [target, mount] : pending)
+                    activations.emplace_back([&activate, &target = target, mount = mount] {
+                        activate(target, *mount, ServerVariant{});
+                    });
+
+            mpu::run_concurrently(activations, max_parallel_mounts);
+
+            if (sshfs_missing)
+                add_fmt_to(errors, sshfs_error_template, name);
 
-            auto& vm_spec_mounts = vm_instance_specs[name].mounts;
             for (const auto& target : invalid_mounts)
             {
                 vm_mounts.erase(target);
@@ -2941,7 +5858,7 @@ mp::Daemon::async_wait_for_ssh_and_start_mounts_for(const std::string& name, con
                 server->Write(reply);
             }
 
-            persist_instances();
+            persist_instance(name);
         }
     }
     catch (const std::exception& e)
@@ -2952,6 +5869,93 @@ mp::Daemon::async_wait_for_ssh_and_start_mounts_for(const std::string& name, con
     return fmt::to_string(errors);
 }
 
+// Whatever the action, only the disk of a stopped instance is concerned; the backend makes them cheap where it can
+template <typename Reply, typename Request>
+void mp::Daemon::snapshot_or_restore(const Request* request, grpc::ServerReaderWriterInterface<Reply, Request>* server,
+                                     std::promise<grpc::Status>* status_promise,
+                                     SnapshotAction action) // clang-format off
+try // clang-format on
+{
+    const auto restore = action == SnapshotAction::restore, remove = action == SnapshotAction::remove;
+
+    mpl::ClientLogger<Reply, Request> logger{mpl::level_from(request->verbosity_level()), *config->logger, server};
+
+    const auto& name = request->instance_name();
+    auto [instance_trail, status] =
+        find_instance_and_react(operative_instances, deleted_instances, name, require_operative_instances_reaction);
+    if (!status.ok())
+        return status_promise->set_value(status);
+
+    // Kept to what makes a file name on the host and a snapshot name in LXD alike
+    static const QRegularExpression snapshot_name_regex{"^[A-Za-z0-9][A-Za-z0-9._-]{0,62}$"};
+    const auto& snapshot = request->snapshot_name();
+    if (!snapshot_name_regex.match(QString::fromStdString(snapshot)).hasMatch())
+        return status_promise->set_value({grpc::StatusCode::INVALID_ARGUMENT,
+                                          fmt::format("Invalid snapshot name \"{}\"", snapshot), ""});
+
+    auto vm = std::get<0>(instance_trail)->second;
+    if (const auto state = vm->current_state();
+        state != VirtualMachine::State::off && state != VirtualMachine::State::stopped)
+        return status_promise->set_value(
+            {grpc::StatusCode::FAILED_PRECONDITION,
+             fmt::format("instance \"{}\" must be stopped to {}", name,
+                         restore ? "be restored" : remove ? "have a snapshot deleted" : "be snapshotted"),
+             ""});
+
+    if (disk_busy_instances.count(name) || cloning_instances.count(name))
+        return status_promise->set_value(
+            {grpc::StatusCode::FAILED_PRECONDITION, fmt::format("instance \"{}\" is busy with its disk", name), ""});
+
+    disk_busy_instances.emplace(name, restore ? "restoring" : remove ? "deleting a snapshot" : "snapshotting");
+
+    // The outcome is the error, if any
+    auto snapshot_future_watcher = new QFutureWatcher<std::string>();
+    QObject::connect(snapshot_future_watcher, &QFutureWatcher<std::string>::finished,
+                     [this, server, status_promise, name, snapshot, restore, remove, snapshot_future_watcher] {
+                         disk_busy_instances.erase(name);
+
+                         if (const auto error = snapshot_future_watcher->result(); !error.empty())
+                         {
+                             status_promise->set_value(grpc::Status(grpc::StatusCode::FAILED_PRECONDITION, error, ""));
+                         }
+                         else
+                         {
+                             Reply reply;
+                             reply.set_reply_message(restore  ? fmt::format("Restored {} to {}", name, snapshot)
+                                                     : remove ? fmt::format("Deleted snapshot {} of {}", snapshot, name)
+                                                              : fmt::format("Snapshotted {} as {}", name, snapshot));
+                             server->Write(reply);
+                             status_promise->set_value(grpc::Status::OK);
+                         }
+
+                         delete snapshot_future_watcher;
+                     });
+
+    snapshot_future_watcher->setFuture(
+        QtConcurrent::run(&launch_pool, [vm, name, snapshot, restore, remove]() -> std::string {
+            mpl::TraceSpan span{restore ? "restore" : "snapshot", name};
+            try
+            {
+                if (restore)
+                    vm->restore_snapshot(snapshot);
+                else if (remove)
+                    vm->delete_snapshot(snapshot);
+                else
+                    vm->take_snapshot(snapshot);
+
+                return {};
+            }
+            catch (const std::exception& e)
+            {
+                return e.what();
+            }
+        }));
+}
+catch (const std::exception& e)
+{
+    status_promise->set_value(grpc::Status(grpc::StatusCode::FAILED_PRECONDITION, e.what(), ""));
+}
+
 template <typename Reply, typename Request>
 mp::Daemon::AsyncOperationStatus
 mp::Daemon::async_wait_for_ready_all(grpc::ServerReaderWriterInterface<Reply, Request>* server,
@@ -3016,6 +6020,7 @@ void mp::Daemon::finish_async_operation(QFuture<AsyncOperationStatus> async_futu
 
     if (it != async_future_watchers.end())
     {
+        it->release()->deleteLater(); // this comes from its own signal
         async_future_watchers.erase(it);
     }
 
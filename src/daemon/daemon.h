@@ -20,15 +20,29 @@
 
 #include "daemon_config.h"
 #include "daemon_rpc.h"
+#include "idle_monitor.h"
 #include "vm_specs.h"
 
+#ifdef MULTIPASS_PLATFORM_LINUX
+#include "port_forwarder.h"
+#endif
+
 #include <multipass/delayed_shutdown_timer.h>
+#include <multipass/journaled_records.h>
 #include <multipass/mount_handler.h>
+#include <multipass/ssh/ssh_session_pool.h>
 #include <multipass/virtual_machine.h>
 #include <multipass/vm_status_monitor.h>
 
+#include <yaml-cpp/yaml.h>
+
+#include <atomic>
 #include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
 #include <future>
+#include <map>
 #include <memory>
 #include <mutex>
 #include <unordered_map>
@@ -36,6 +50,7 @@
 #include <vector>
 
 #include <QFutureWatcher>
+#include <QThreadPool>
 
 namespace multipass
 {
@@ -48,7 +63,7 @@ public:
     explicit Daemon(std::unique_ptr<const DaemonConfig> config);
     ~Daemon();
 
-    void persist_instances();
+    void persist_instances(); // rewrites the whole database, folding the journal in
 
 protected:
     void on_resume() override;
@@ -60,6 +75,9 @@ protected:
     void update_metadata_for(const std::string& name, const QJsonObject& metadata) override;
     QJsonObject retrieve_metadata_for(const std::string& name) override;
 
+private slots:
+    void on_host_sleep(bool sleeping); // suspends what runs before the host sleeps, to be resumed once it wakes up
+
 public slots:
     virtual void create(const CreateRequest* request,
                         grpc::ServerReaderWriterInterface<CreateReply, CreateRequest>* server,
@@ -135,17 +153,116 @@ public slots:
                               grpc::ServerReaderWriterInterface<AuthenticateReply, AuthenticateRequest>* server,
                               std::promise<grpc::Status>* status_promise);
 
+    virtual void watch(const WatchRequest* request, grpc::ServerReaderWriterInterface<WatchReply, WatchRequest>* server,
+                       std::promise<grpc::Status>* status_promise);
+
+    virtual void metrics(const MetricsRequest* request,
+                         grpc::ServerReaderWriterInterface<MetricsReply, MetricsRequest>* server,
+                         std::promise<grpc::Status>* status_promise);
+
+    virtual void console_log(const ConsoleLogRequest* request,
+                             grpc::ServerReaderWriterInterface<ConsoleLogReply, ConsoleLogRequest>* server,
+                             std::promise<grpc::Status>* status_promise);
+
+    virtual void clone(const CloneRequest* request, grpc::ServerReaderWriterInterface<CloneReply, CloneRequest>* server,
+                       std::promise<grpc::Status>* status_promise);
+
+    virtual void compact(const CompactRequest* request,
+                         grpc::ServerReaderWriterInterface<CompactReply, CompactRequest>* server,
+                         std::promise<grpc::Status>* status_promise);
+
+    virtual void snapshot(const SnapshotRequest* request,
+                          grpc::ServerReaderWriterInterface<SnapshotReply, SnapshotRequest>* server,
+                          std::promise<grpc::Status>* status_promise);
+
+    virtual void restore(const RestoreRequest* request,
+                         grpc::ServerReaderWriterInterface<RestoreReply, RestoreRequest>* server,
+                         std::promise<grpc::Status>* status_promise);
+
+    virtual void exec(const ExecRequest* request, ExecServer* server, std::promise<grpc::Status>* status_promise);
+
+    virtual void forward(const ForwardRequest* request,
+                         grpc::ServerReaderWriterInterface<ForwardReply, ForwardRequest>* server,
+                         std::promise<grpc::Status>* status_promise);
+
+    virtual void apply(const ApplyRequest* request, grpc::ServerReaderWriterInterface<ApplyReply, ApplyRequest>* server,
+                       std::promise<grpc::Status>* status_promise);
+
 private:
+    void persist_instance(const std::string& name); // journals the one instance, compacting now and then
+    void write_instance_db();
+    QJsonObject instance_records_json() const;
     void release_resources(const std::string& instance);
     void create_vm(const CreateRequest* request, grpc::ServerReaderWriterInterface<CreateReply, CreateRequest>* server,
-                   std::promise<grpc::Status>* status_promise, bool start);
+                   std::promise<grpc::Status>* status_promise, bool start, bool warm = false);
+
+    // Warm instances are created and booted ahead of time, then suspended, for launches that ask for nothing in
+    // particular to take instead of creating one. They are kept out of the operative instances, and count as being
+    // prepared for everything else, so they cannot be seen or touched until taken.
+    struct WarmUp;
+    void fill_warm_pool();
+    void warm_up_instance(const std::string& name, VirtualMachine::ShPtr vm);
+    void discard_warm_instance(const std::string& name, VirtualMachine& vm);
+    void launch_warm_instance(const LaunchRequest* request,
+                              grpc::ServerReaderWriterInterface<LaunchReply, LaunchRequest>* server,
+                              std::promise<grpc::Status>* status_promise, std::chrono::seconds timeout);
+
+    // Several instances launched alike in one request, side by side, each named after the requested pattern
+    struct BatchLaunch;
+    void launch_batch(const LaunchRequest* request,
+                      grpc::ServerReaderWriterInterface<LaunchReply, LaunchRequest>* server,
+                      std::promise<grpc::Status>* status_promise);
+
+    // What apply has each instance go through, one step after the other, all instances side by side. Each step is one
+    // of the requests clients would make, started on the main thread and waited on in the apply pool.
+    struct Reconcile;
+    void next_apply_step(std::shared_ptr<Reconcile> reconcile, std::size_t pipeline);
+
+    void restore_next_instance();
+    void check_idle_instances(); // suspends those that asked to be, once idle for long enough
+    bool in_use(const std::string& name, VirtualMachine& vm); // through sessions or mounts, however quiet
+    void evict_images();         // down to the image cache size, in the background
+    void empty_trash();          // of the vault, in the background
+
+    // The first launch of a blueprint version is provisioned in full, then rebooted to have its disk kept as a golden
+    // image. Later launches of that version on the same base image start from a copy of it, with only what is their
+    // own for cloud-init to apply.
+    std::string take_golden_image_candidate(const std::string& name);
+    void keep_golden_image(VirtualMachine& vm, const std::string& key, const std::chrono::seconds& timeout);
     grpc::Status reboot_vm(VirtualMachine& vm);
     grpc::Status shutdown_vm(VirtualMachine& vm, const std::chrono::milliseconds delay);
+    std::unique_ptr<DelayedShutdownTimer> make_shutdown_timer(VirtualMachine& vm);
     grpc::Status cancel_vm_shutdown(const VirtualMachine& vm);
     grpc::Status get_ssh_info_for_vm(VirtualMachine& vm, SSHInfoReply& response);
     void init_mounts(const std::string& name);
     void stop_mounts(const std::string& name);
     MountHandler::UPtr make_mount(VirtualMachine* vm, const std::string& target, const VMMount& mount);
+    std::string release_title_for(const VMImage& image);
+    YAML::Node cloud_init_vendor_config(const std::string& username, const CreateRequest* request);
+
+    // What read-only requests see of the instances. It is taken on the main thread whenever instances are persisted,
+    // so that those requests can be answered on RPC threads without going through tables that the main thread changes.
+    // Snapshots are swapped in whole, and readers only ever share them, so neither side waits on the other.
+    struct InstanceSnapshot
+    {
+        // All that requests on other threads need, for instances are only to be asked on the main thread
+        struct Instance
+        {
+            std::string name;
+            VirtualMachine::State state;
+            std::string management_ipv4; // empty unless running with a known address
+            int ssh_port;
+            std::string ssh_username;
+            std::map<std::string, std::string> mounts; // target => source
+        };
+
+        std::vector<Instance> operative; // both sorted by name
+        std::vector<std::string> deleted;
+    };
+    void take_instance_snapshot();
+    void retake_instance_snapshot(std::chrono::milliseconds delay = std::chrono::milliseconds::zero()); // any thread
+    void update_completion_cache(); // names for shell completion, next to the socket for clients to read without RPC
+    std::shared_ptr<const InstanceSnapshot> instance_snapshot();
 
     struct AsyncOperationStatus
     {
@@ -162,6 +279,15 @@ private:
     async_wait_for_ready_all(grpc::ServerReaderWriterInterface<Reply, Request>* server,
                              const std::vector<std::string>& vms, const std::chrono::seconds& timeout,
                              std::promise<grpc::Status>* status_promise, const std::string& errors);
+    enum class SnapshotAction
+    {
+        take,
+        restore,
+        remove
+    };
+    template <typename Reply, typename Request>
+    void snapshot_or_restore(const Request* request, grpc::ServerReaderWriterInterface<Reply, Request>* server,
+                             std::promise<grpc::Status>* status_promise, SnapshotAction action);
     void finish_async_operation(QFuture<AsyncOperationStatus> async_future);
     QFutureWatcher<AsyncOperationStatus>* create_future_watcher(std::function<void()> const& finished_op = []() {});
 
@@ -170,16 +296,62 @@ private:
     std::unordered_map<std::string, VirtualMachine::ShPtr> operative_instances;
     std::unordered_map<std::string, VirtualMachine::ShPtr> deleted_instances;
     std::unordered_map<std::string, std::unique_ptr<DelayedShutdownTimer>> delayed_shutdown_instances;
+    std::recursive_mutex persist_mutex; // instances report their state from whatever thread takes them down
+    JournaledRecords instance_db;
     std::unordered_set<std::string> allocated_mac_addrs;
+    std::shared_ptr<const InstanceSnapshot> latest_instance_snapshot; // only through std::atomic_load/store
+    std::atomic_bool instance_snapshot_retake_pending{false};
+    std::mutex instance_snapshot_mutex;
+    std::condition_variable instance_changed; // what watch requests wait on; under instance_snapshot_mutex, like these
+    std::uint64_t instance_changes{0};
+    std::mutex completion_cache_mutex;
+    std::vector<std::string> known_networks; // as last listed, under completion_cache_mutex
+    bool stop_watching{false};
+    std::atomic_bool stop_execs{false};
+    std::mutex exec_sessions_mutex;
+    std::unordered_multiset<std::string> exec_sessions; // instances commands run in, once for each command
+    std::atomic_bool stop_applies{false};
     DaemonRpc daemon_rpc;
     QTimer source_images_maintenance_task;
+    QTimer idle_check_timer;
+    IdleMonitor idle_monitor;
     std::vector<std::unique_ptr<QFutureWatcher<AsyncOperationStatus>>> async_future_watchers;
     std::unordered_map<std::string, QFuture<std::string>> async_running_futures;
     std::mutex start_mutex;
+    std::deque<std::string> instances_to_restore; // that were running when the daemon went down, to be started again
+    std::unordered_set<std::string> host_sleep_suspended; // to be resumed through the restore queue once the host wakes
+    std::unordered_set<std::string> reattached_instances; // still running when the daemon came up, mounts to restore
     std::unordered_set<std::string> preparing_instances;
+    std::unordered_multiset<std::string> cloning_instances; // clone sources, not to be started until they are copied
+    std::unordered_map<std::string, std::string> disk_busy_instances; // by what is done to their disk, not to start
+    std::unordered_map<std::string, VirtualMachine::ShPtr> warm_instances; // ready to be taken
+    std::unique_ptr<WarmUp> warm_up; // the one being warmed up, if any
     QFuture<void> image_update_future;
+    std::atomic_bool evicting_images{false};
+    std::atomic_bool emptying_trash{false};
+    std::atomic_bool trash_pending{false}; // asked to empty the trash again while at it
+    std::mutex golden_image_mutex;
+    std::unordered_map<std::string, std::string> golden_image_candidates; // golden image keys, by instance name
+    std::mutex release_titles_mutex;
+    std::unordered_map<std::string, std::string> release_titles; // by image ID, for images without one in the vault
+    std::unordered_set<std::string> unresolved_release_titles;
+    std::mutex vendor_configs_mutex;
+    std::unordered_map<std::string, YAML::Node> vendor_configs; // by what goes into them, the same for many launches
+    std::string backend_version;                                // asked of the backend for the first one
+    QFuture<void> release_title_lookup;
     SettingsHandler* instance_mod_handler;
     std::unordered_map<std::string, std::unordered_map<std::string, MountHandler::UPtr>> mounts;
+#ifdef MULTIPASS_PLATFORM_LINUX
+    std::map<int, std::pair<std::string, std::unique_ptr<PortForwarder>>> port_forwards; // by host port, with instance
+#endif
+    SSHSessionPool ssh_sessions;
+    // Work is split by how soon it is wanted, each kind with its own cap. Tasks that only wait on instances go to the
+    // global pool, as they take no more than a thread while sleeping.
+    QThreadPool read_only_pool;  // where read-only requests finish what would otherwise hold up the main thread
+    QThreadPool launch_pool;     // where instances are prepared
+    QThreadPool background_pool; // for maintenance and the warm pool, at idle priority
+    QThreadPool exec_pool;       // where exec requests follow their commands, for as long as those run
+    QThreadPool apply_pool;      // where apply waits on each instance's steps, apart from what the steps wait on
 };
 } // namespace multipass
 #endif // MULTIPASS_DAEMON_H
@@ -27,11 +27,13 @@
 #include <multipass/logging/standard_logger.h>
 #include <multipass/name_generator.h>
 #include <multipass/platform.h>
+#include <multipass/settings/settings.h>
 #include <multipass/ssh/openssh_key_provider.h>
 #include <multipass/ssl_cert_provider.h>
 #include <multipass/standard_paths.h>
 #include <multipass/utils.h>
 
+#include <QDir>
 #include <QString>
 #include <QSysInfo>
 #include <QUrl>
@@ -135,8 +137,16 @@ std::unique_ptr<const mp::DaemonConfig> mp::DaemonConfigBuilder::build()
         update_prompt = platform::make_update_prompt();
     if (image_hosts.empty())
     {
-        image_hosts.push_back(std::make_unique<mp::CustomVMImageHost>(QSysInfo::currentCpuArchitecture(),
-                                                                      url_downloader.get(), manifest_ttl));
+        // Lazy hosts keep track of their use, to know whether to fetch their manifests ahead the next time
+        const auto lazy_hosts = MP_SETTINGS.get_as<bool>(mp::image_lazy_hosts_key);
+        const auto usage_stamp = [lazy_hosts, &cache_directory = cache_directory](const QString& host_name) {
+            return lazy_hosts ? QDir{cache_directory}.filePath(host_name + "-image-host.used") : QString{};
+        };
+        const auto manifest_cache = MP_UTILS.make_dir(cache_directory, "manifests");
+
+        image_hosts.push_back(std::make_unique<mp::CustomVMImageHost>(
+            QSysInfo::currentCpuArchitecture(), url_downloader.get(), manifest_ttl, manifest_cache,
+            usage_stamp("custom")));
         image_hosts.push_back(std::make_unique<mp::UbuntuVMImageHost>(
             std::vector<std::pair<std::string, UbuntuVMImageRemote>>{
                 {mp::release_remote, UbuntuVMImageRemote{"https://cloud-images.ubuntu.com/", "releases/",
@@ -146,8 +156,10 @@ std::unique_ptr<const mp::DaemonConfig> mp::DaemonConfigBuilder::build()
                 {mp::snapcraft_remote, UbuntuVMImageRemote{"https://cloud-images.ubuntu.com/", "buildd/daily/",
                                                            std::make_optional<QString>(mp::mirror_key)}},
                 {mp::appliance_remote, UbuntuVMImageRemote{"https://cdimage.ubuntu.com/", "ubuntu-core/appliances/"}}},
-            url_downloader.get(), manifest_ttl));
+            url_downloader.get(), manifest_ttl, manifest_cache,
+            usage_stamp("ubuntu")));
     }
+    std::unique_ptr<ImageShareServer> image_share_server;
     if (vault == nullptr)
     {
         std::vector<VMImageHost*> hosts;
@@ -156,9 +168,19 @@ std::unique_ptr<const mp::DaemonConfig> mp::DaemonConfigBuilder::build()
             hosts.push_back(image.get());
         }
 
+        // Shared by all backends, so that switching between them need not fetch the same images again
+        const vault::BlobStore blobs{MP_UTILS.make_dir(cache_directory, "blobs"),
+                                     MP_SETTINGS.get(mp::image_peers_key).split(',', QString::SkipEmptyParts)};
+
         vault = factory->create_image_vault(
             hosts, url_downloader.get(), MP_UTILS.make_dir(cache_directory, factory->get_backend_directory_name()),
-            mp::utils::backend_directory_path(data_directory, factory->get_backend_directory_name()), days_to_expire);
+            mp::utils::backend_directory_path(data_directory, factory->get_backend_directory_name()), days_to_expire,
+            blobs);
+
+        // Only the blobs of a vault made here are known to be shared
+        if (const auto port = MP_SETTINGS.get(mp::image_share_port_key); !port.isEmpty())
+            image_share_server = std::make_unique<ImageShareServer>(
+                blobs, QHostAddress{MP_SETTINGS.get(mp::image_share_address_key)}, port.toUShort());
     }
     if (name_generator == nullptr)
         name_generator = mp::make_default_name_generator();
@@ -193,5 +215,6 @@ std::unique_ptr<const mp::DaemonConfig> mp::DaemonConfigBuilder::build()
         std::move(url_downloader), std::move(factory), std::move(image_hosts), std::move(vault),
         std::move(name_generator), std::move(ssh_key_provider), std::move(cert_provider), std::move(client_cert_store),
         std::move(update_prompt), multiplexing_logger, std::move(network_proxy), std::move(blueprint_provider),
-        cache_directory, data_directory, server_address, ssh_username, image_refresh_timer});
+        cache_directory, data_directory, server_address, ssh_username, image_refresh_timer,
+        std::move(image_share_server)});
 }
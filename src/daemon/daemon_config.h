@@ -18,6 +18,8 @@
 #ifndef MULTIPASS_DAEMON_CONFIG_H
 #define MULTIPASS_DAEMON_CONFIG_H
 
+#include "image_share_server.h"
+
 #include <multipass/cert_provider.h>
 #include <multipass/cert_store.h>
 #include <multipass/days.h>
@@ -61,6 +63,7 @@ struct DaemonConfig
     const std::string server_address;
     const std::string ssh_username;
     const std::chrono::hours image_refresh_timer;
+    const std::unique_ptr<ImageShareServer> image_share_server;
 };
 
 struct DaemonConfigBuilder
@@ -18,6 +18,7 @@
 #include "daemon_init_settings.h"
 
 #include <multipass/constants.h>
+#include <multipass/memory_size.h>
 #include <multipass/platform.h>
 #include <multipass/settings/basic_setting_spec.h>
 #include <multipass/settings/bool_setting_spec.h>
@@ -28,6 +29,7 @@
 
 #include <QCoreApplication>
 #include <QFileSystemWatcher>
+#include <QHostAddress>
 #include <QObject>
 
 namespace mp = multipass;
@@ -59,23 +61,170 @@ QString driver_interpreter(QString val)
     return val;
 }
 
+// Several mirrors can be given, separated by commas, the fastest of them is used
 QString image_mirror_interpreter(QString val)
 {
-    if (val.size() == 0)
+    QStringList mirrors;
+    for (auto mirror : val.split(',', QString::SkipEmptyParts))
     {
-        return val;
+        mirror = mirror.trimmed();
+        if (!mirror.startsWith("https://"))
+        {
+            throw mp::InvalidSettingException(mp::mirror_key, val,
+                                              "The hostname of mirror must contain protocol name: https");
+        }
+
+        if (!mirror.endsWith("/"))
+        {
+            mirror.append("/");
+        }
+        mirrors << mirror;
     }
 
-    if (!val.startsWith("https://"))
+    return mirrors.join(',');
+}
+
+QString image_peers_interpreter(QString val)
+{
+    QStringList peers;
+    for (auto peer : val.split(',', QString::SkipEmptyParts))
     {
-        throw mp::InvalidSettingException(mp::mirror_key, val,
-                                          "The hostname of mirror must contain protocol name: https");
+        peer = peer.trimmed();
+        if (!peer.startsWith("http://") && !peer.startsWith("https://"))
+            throw mp::InvalidSettingException(mp::image_peers_key, val,
+                                              "Every peer must contain protocol name: http or https");
+
+        if (!peer.endsWith("/"))
+            peer.append("/");
+        peers << peer;
     }
 
-    if (!val.endsWith("/"))
+    return peers.join(',');
+}
+
+QString image_share_port_interpreter(QString val)
+{
+    bool ok = val.isEmpty();
+    if (!ok)
+    {
+        const auto port = val.toUShort(&ok);
+        ok = ok && port > 0;
+    }
+
+    if (!ok)
+        throw mp::InvalidSettingException(mp::image_share_port_key, val, "Expected a port number, or nothing");
+
+    return val;
+}
+
+// One address of this host's, not any of them: what is shared is meant for the peers that can reach that one
+QString image_share_address_interpreter(QString val)
+{
+    QHostAddress address;
+    if (!address.setAddress(val.trimmed()) || address == QHostAddress::AnyIPv4 || address == QHostAddress::AnyIPv6)
+        throw mp::InvalidSettingException(mp::image_share_address_key, val,
+                                          "Expected the IP address of one of this host's interfaces");
+
+    return address.toString();
+}
+
+QString image_cache_size_interpreter(QString val)
+{
+    if (!val.isEmpty())
     {
-        val.append("/");
+        try
+        {
+            mp::MemorySize{val.toStdString()};
+        }
+        catch (const std::exception&)
+        {
+            throw mp::InvalidSettingException(mp::image_cache_size_key, val, "Expected a size, or nothing");
+        }
     }
+
+    return val;
+}
+
+QString ksm_interpreter(QString val)
+{
+    if (val != "host" && val != "on" && val != "off")
+        throw mp::InvalidSettingException(mp::ksm_key, val, "Expected host, on or off");
+
+    return val;
+}
+
+QString ksm_pages_to_scan_interpreter(QString val)
+{
+    bool ok;
+    if (val.toUInt(&ok) == 0 || !ok)
+        throw mp::InvalidSettingException(mp::ksm_pages_to_scan_key, val, "Expected a positive number of pages");
+
+    return val;
+}
+
+QString image_compression_interpreter(QString val)
+{
+    if (val != "none" && val != "zstd")
+        throw mp::InvalidSettingException(mp::image_compression_key, val, "Expected none or zstd");
+
+    return val;
+}
+
+QString bulk_parallelism_interpreter(QString val)
+{
+    bool ok;
+    if (val.toUInt(&ok) == 0 || !ok)
+        throw mp::InvalidSettingException(mp::bulk_parallelism_key, val, "Expected a positive number");
+
+    return val;
+}
+
+QString warm_pool_interpreter(QString val)
+{
+    bool ok;
+    val.toUInt(&ok);
+    if (!ok)
+        throw mp::InvalidSettingException(mp::warm_pool_key, val, "Expected a number of instances");
+
+    return val;
+}
+
+auto overcommit_interpreter(const char* key)
+{
+    return [key](QString val) {
+        bool ok;
+        if (val.toDouble(&ok) < 0 || !ok)
+            throw mp::InvalidSettingException(key, val, "Expected a ratio, or 0 for no limit");
+
+        return val;
+    };
+}
+
+QString placement_interpreter(QString val)
+{
+    val = val.toLower();
+    if (val != "none" && val != "numa")
+        throw mp::InvalidSettingException(mp::placement_key, val, "Expected one of: none, numa");
+
+    return val;
+}
+
+QString ssh_compression_interpreter(QString val)
+{
+    val = val.toLower();
+    if (val != "auto" && val != "on" && val != "off")
+        throw mp::InvalidSettingException(mp::ssh_compression_key, val, "Expected one of: auto, on, off");
+
+    return val;
+}
+
+QString transfer_window_interpreter(QString val)
+{
+    bool ok;
+    const auto window = val.toUInt(&ok);
+    if (!ok || window == 0 || window > 256)
+        throw mp::InvalidSettingException(mp::transfer_window_key, val, "Expected a number of reads from 1 to 256");
+
     return val;
 }
 
@@ -100,6 +249,38 @@ void mp::daemon::register_global_settings_handlers()
         return val.isEmpty() ? val : MP_UTILS.generate_scrypt_hash_for(val);
     }));
     settings.insert(std::make_unique<CustomSettingSpec>(mp::mirror_key, "", image_mirror_interpreter));
+    settings.insert(std::make_unique<CustomSettingSpec>(mp::image_peers_key, "", image_peers_interpreter));
+    settings.insert(std::make_unique<CustomSettingSpec>(mp::image_share_port_key, "", image_share_port_interpreter));
+    settings.insert(std::make_unique<CustomSettingSpec>(mp::image_share_address_key, "127.0.0.1",
+                                                        image_share_address_interpreter));
+    settings.insert(std::make_unique<BasicSettingSpec>(mp::image_prewarm_key, ""));
+    settings.insert(std::make_unique<BoolSettingSpec>(mp::image_lazy_hosts_key, false));
+    settings.insert(std::make_unique<CustomSettingSpec>(mp::image_cache_size_key, "", image_cache_size_interpreter));
+    settings.insert(
+        std::make_unique<CustomSettingSpec>(mp::image_compression_key, "none", image_compression_interpreter));
+    settings.insert(std::make_unique<CustomSettingSpec>(mp::ksm_key, "host", ksm_interpreter));
+    settings.insert(
+        std::make_unique<CustomSettingSpec>(mp::ksm_pages_to_scan_key, "100", ksm_pages_to_scan_interpreter));
+    settings.insert(std::make_unique<CustomSettingSpec>(mp::bulk_parallelism_key, "8", bulk_parallelism_interpreter));
+    settings.insert(std::make_unique<CustomSettingSpec>(mp::warm_pool_key, "0", warm_pool_interpreter));
+    settings.insert(std::make_unique<CustomSettingSpec>(mp::cpu_overcommit_key, "0",
+                                                        overcommit_interpreter(mp::cpu_overcommit_key)));
+    settings.insert(std::make_unique<CustomSettingSpec>(mp::memory_overcommit_key, "0",
+                                                        overcommit_interpreter(mp::memory_overcommit_key)));
+    settings.insert(std::make_unique<CustomSettingSpec>(mp::disk_overcommit_key, "0",
+                                                        overcommit_interpreter(mp::disk_overcommit_key)));
+    settings.insert(std::make_unique<CustomSettingSpec>(mp::placement_key, "none", placement_interpreter));
+    settings.insert(std::make_unique<CustomSettingSpec>(mp::ssh_compression_key, "auto", ssh_compression_interpreter));
+    settings.insert(std::make_unique<BoolSettingSpec>(mp::sshfs_shared_server_key, false));
+    settings.insert(std::make_unique<BoolSettingSpec>(mp::sshfs_write_behind_key, false));
+    settings.insert(std::make_unique<BoolSettingSpec>(mp::qemu_virtiofs_key, false));
+    settings.insert(std::make_unique<CustomSettingSpec>(mp::transfer_window_key, "16", transfer_window_interpreter));
+    settings.insert(std::make_unique<BoolSettingSpec>(mp::qemu_page_reporting_key, false));
+    settings.insert(std::make_unique<BoolSettingSpec>(mp::qemu_reattach_key, false));
+    settings.insert(std::make_unique<BoolSettingSpec>(mp::qemu_nocloud_net_key, false));
+    settings.insert(std::make_unique<BoolSettingSpec>(mp::qemu_state_file_key, false));
+    settings.insert(std::make_unique<BoolSettingSpec>(mp::qemu_vsock_key, false));
+    settings.insert(std::make_unique<BoolSettingSpec>(mp::qemu_guest_agent_key, false));
 
     MP_SETTINGS.register_handler(
         std::make_unique<PersistentSettingsHandler>(persistent_settings_filename(), std::move(settings)));
@@ -18,6 +18,7 @@
 #include "daemon.h"
 #include "daemon_config.h"
 #include "daemon_init_settings.h"
+#include "profiler.h"
 
 #include "cli.h"
 
@@ -32,8 +33,11 @@
 #include <multipass/format.h>
 
 #include <QCoreApplication>
+#include <QDir>
 
 #include <csignal>
+#include <mutex>
+#include <optional>
 
 namespace mp = multipass;
 namespace mpl = multipass::logging;
@@ -41,12 +45,14 @@ namespace mpp = multipass::platform;
 
 namespace
 {
+// SIGUSR2 starts profiling the daemon, and the next one stops it
 class UnixSignalHandler
 {
 public:
     UnixSignalHandler()
-        : signal_handling_thread{
-              [this, sigs = mpp::make_and_block_signals({SIGTERM, SIGINT, SIGUSR1})] { monitor_signals(sigs); }}
+        : signal_handling_thread{[this, sigs = mpp::make_and_block_signals({SIGTERM, SIGINT, SIGUSR1, SIGUSR2})] {
+              monitor_signals(sigs);
+          }}
     {
     }
 
@@ -55,16 +61,49 @@ public:
         pthread_kill(signal_handling_thread.thread.native_handle(), SIGUSR1);
     }
 
+    void set_profile_directory(const QString& directory)
+    {
+        std::lock_guard lock{mutex};
+        profile_directory = directory;
+    }
+
     void monitor_signals(sigset_t sigset)
     {
         int sig = -1;
-        sigwait(&sigset, &sig);
+        for (sigwait(&sigset, &sig); sig == SIGUSR2; sigwait(&sigset, &sig))
+            toggle_profiling();
+
+        capture.reset(); // a profile of up to the end is still worth having
         if (sig != SIGUSR1)
             mpl::log(mpl::Level::info, "daemon", fmt::format("Received signal {} ({})", sig, strsignal(sig)));
         QCoreApplication::quit();
     }
 
 private:
+    void toggle_profiling()
+    {
+        if (capture)
+        {
+            for (const auto& file : capture->finish())
+                mpl::log(mpl::Level::info, "daemon", fmt::format("Wrote {}", file));
+            capture.reset();
+            return;
+        }
+
+        std::lock_guard lock{mutex};
+        if (profile_directory.isEmpty())
+        {
+            mpl::log(mpl::Level::warning, "daemon", "Not ready to profile yet");
+            return;
+        }
+
+        capture.emplace(profile_directory);
+        mpl::log(mpl::Level::info, "daemon", "Profiling, send SIGUSR2 again to stop");
+    }
+
+    std::mutex mutex;
+    QString profile_directory; // empty until the daemon knows where its data goes
+    std::optional<mp::daemon::ProfileCapture> capture;
     mp::AutoJoinThread signal_handling_thread;
 };
 
@@ -81,6 +120,7 @@ int main_impl(int argc, char* argv[])
     auto builder = mp::cli::parse(app);
     auto config = builder.build();
     auto server_address = config->server_address;
+    handler.set_profile_directory(QDir{config->data_directory}.filePath("profiles"));
 
     mp::daemon::monitor_and_quit_on_settings_change(); // TODO replace with async restart in relevant settings handlers
     mp::Daemon daemon(std::move(config));
@@ -18,13 +18,22 @@
 #include "daemon_rpc.h"
 #include "daemon_config.h"
 
+#include <multipass/constants.h>
 #include <multipass/format.h>
 #include <multipass/logging/log.h>
+#include <multipass/logging/metrics.h>
 #include <multipass/platform.h>
 #include <multipass/utils.h>
 
+#include <QFile>
+#include <QRandomGenerator>
+
+#include <algorithm>
+#include <array>
+#include <atomic>
 #include <chrono>
 #include <stdexcept>
+#include <string>
 
 namespace mp = multipass;
 namespace mpl = multipass::logging;
@@ -33,6 +42,60 @@ namespace
 {
 constexpr auto category = "rpc";
 
+// The threads are capped a little higher than the requests in flight, so that there are always some left to turn
+// requests away with
+constexpr auto max_rpc_threads = mp::DaemonRpc::max_requests_in_flight + 8;
+
+// Keeps idle connections from remote clients alive through middleboxes, and lets clients ping as often as their own
+// keepalive asks for without being told to calm down
+constexpr auto keepalive_time_ms = 60000;
+constexpr auto keepalive_timeout_ms = 20000;
+constexpr auto min_client_ping_interval_ms = 10000;
+
+// Counts a request in while it is being handled
+class RequestSlot
+{
+public:
+    explicit RequestSlot(std::atomic_int& requests_in_flight)
+        : queue_depth{++requests_in_flight}, requests_in_flight{requests_in_flight}
+    {
+        MP_METRICS.adjust("multipass_rpc_requests_in_flight", {}, 1);
+    }
+
+    ~RequestSlot()
+    {
+        --requests_in_flight;
+        MP_METRICS.adjust("multipass_rpc_requests_in_flight", {}, -1);
+    }
+
+    const int queue_depth; // including this one
+
+private:
+    std::atomic_int& requests_in_flight;
+};
+
+// Counts and times requests by method and the status they got
+class RequestMetrics
+{
+public:
+    explicit RequestMetrics(const char* method) : method{method}, started{std::chrono::steady_clock::now()}
+    {
+    }
+
+    grpc::Status done(grpc::Status status) const
+    {
+        const mpl::Metrics::Labels labels{{"method", method}, {"code", std::to_string(status.error_code())}};
+        MP_METRICS.increment("multipass_rpc_requests_total", labels);
+        MP_METRICS.observe("multipass_rpc_duration_seconds", {{"method", method}},
+                           std::chrono::steady_clock::now() - started);
+        return status;
+    }
+
+private:
+    const char* method;
+    const std::chrono::steady_clock::time_point started;
+};
+
 bool check_is_server_running(const std::string& address)
 {
     auto channel = grpc::CreateChannel(address, grpc::InsecureChannelCredentials());
@@ -57,8 +120,22 @@ auto make_server(const std::string& server_address, const mp::CertProvider& cert
     creds = grpc::SslServerCredentials(opts);
 
     builder.AddListeningPort(server_address, creds);
+
+    // Clients that were handed a session over TLS come back through this one, with no handshake to go through
+    if (const auto local_address = mp::utils::local_server_address(server_address); !local_address.empty())
+        builder.AddListeningPort(local_address, grpc::experimental::LocalServerCredentials(LOCAL_UDS));
     builder.RegisterService(service);
 
+    grpc::ResourceQuota quota{"multipassd"};
+    quota.SetMaxThreads(max_rpc_threads);
+    builder.SetResourceQuota(quota);
+
+    builder.AddChannelArgument(GRPC_ARG_KEEPALIVE_TIME_MS, keepalive_time_ms);
+    builder.AddChannelArgument(GRPC_ARG_KEEPALIVE_TIMEOUT_MS, keepalive_timeout_ms);
+    builder.AddChannelArgument(GRPC_ARG_KEEPALIVE_PERMIT_WITHOUT_CALLS, 1);
+    builder.AddChannelArgument(GRPC_ARG_HTTP2_MAX_PINGS_WITHOUT_DATA, 0);
+    builder.AddChannelArgument(GRPC_ARG_HTTP2_MIN_RECV_PING_INTERVAL_WITHOUT_DATA_MS, min_client_ping_interval_ms);
+
     std::unique_ptr<grpc::Server> server{builder.BuildAndStart()};
     if (server == nullptr)
     {
@@ -90,7 +167,7 @@ grpc::Status emit_signal_and_wait_for_result(OperationSignal operation_signal)
     return status_future.get();
 }
 
-std::string client_cert_from(grpc::ServerContext* context)
+std::string tls_client_cert_from(grpc::ServerContext* context)
 {
     std::string client_cert;
     auto client_certs{context->auth_context()->FindPropertyValues("x509_pem_cert")};
@@ -103,6 +180,49 @@ std::string client_cert_from(grpc::ServerContext* context)
     return client_cert;
 }
 
+bool came_through_local_socket(grpc::ServerContext* context)
+{
+    const auto security{context->auth_context()->FindPropertyValues(GRPC_TRANSPORT_SECURITY_TYPE_PROPERTY_NAME)};
+    return !security.empty() && security.front() == GRPC_LOCAL_TRANSPORT_SECURITY_TYPE;
+}
+
+// For the replies that can get large, when they go over the network. Only used if the client accepts it, and gRPC
+// still sends messages that would not shrink as they are
+void compress_remote_replies(grpc::ServerContext* context, mp::ServerSocketType server_socket_type)
+{
+    if (server_socket_type == mp::ServerSocketType::tcp && !came_through_local_socket(context))
+        context->set_compression_algorithm(GRPC_COMPRESS_GZIP);
+}
+
+std::string session_token_from(grpc::ServerContext* context)
+{
+    const grpc::string_ref bearer{"Bearer "}; // how access token credentials send it
+    const auto& metadata = context->client_metadata();
+    if (const auto it = metadata.find("authorization"); it != metadata.end() && it->second.starts_with(bearer))
+        return std::string{it->second.data() + bearer.size(), it->second.size() - bearer.size()};
+
+    return {};
+}
+
+std::string new_session_token()
+{
+    std::array<quint32, 8> random;
+    QRandomGenerator::system()->fillRange(random.data(), random.size());
+
+    return QByteArray{reinterpret_cast<const char*>(random.data()), int(random.size() * sizeof(quint32))}
+        .toHex()
+        .toStdString();
+}
+
+void open_local_socket(const std::string& local_address)
+{
+    // Anyone may connect, only those with a session get anything done
+    const auto path = QString::fromStdString(local_address.substr(local_address.find(':') + 1));
+    if (!QFile::setPermissions(path, QFile::ReadOwner | QFile::WriteOwner | QFile::ReadGroup | QFile::WriteGroup |
+                                         QFile::ReadOther | QFile::WriteOther))
+        mpl::log(mpl::Level::warning, category, fmt::format("Could not open up local socket {}", local_address));
+}
+
 void handle_socket_restrictions(const std::string& server_address, const bool restricted)
 {
     try
@@ -117,6 +237,44 @@ void handle_socket_restrictions(const std::string& server_address, const bool re
     }
 }
 
+class ContextExecServer : public mp::ExecServer
+{
+public:
+    ContextExecServer(grpc::ServerContext* context, grpc::ServerReaderWriter<mp::ExecReply, mp::ExecRequest>* server)
+        : context{context}, server{server}
+    {
+    }
+
+    void SendInitialMetadata() override
+    {
+        server->SendInitialMetadata();
+    }
+
+    bool Write(const mp::ExecReply& msg, grpc::WriteOptions options) override
+    {
+        return server->Write(msg, options);
+    }
+
+    bool NextMessageSize(uint32_t* sz) override
+    {
+        return server->NextMessageSize(sz);
+    }
+
+    bool Read(mp::ExecRequest* msg) override
+    {
+        return server->Read(msg);
+    }
+
+    void cancel() override
+    {
+        context->TryCancel();
+    }
+
+private:
+    grpc::ServerContext* const context;
+    grpc::ServerReaderWriter<mp::ExecReply, mp::ExecRequest>* const server;
+};
+
 void accept_cert(mp::CertStore* client_cert_store, const std::string& client_cert, const std::string& server_address)
 {
     client_cert_store->add_cert(client_cert);
@@ -133,6 +291,8 @@ mp::DaemonRpc::DaemonRpc(const std::string& server_address, const CertProvider&
       client_cert_store{client_cert_store}
 {
     handle_socket_restrictions(server_address, client_cert_store->empty());
+    if (const auto local_address = mp::utils::local_server_address(server_address); !local_address.empty())
+        open_local_socket(local_address);
 
     mpl::log(mpl::Level::info, category, fmt::format("gRPC listening on {}", server_address));
 }
@@ -144,7 +304,7 @@ grpc::Status mp::DaemonRpc::create(grpc::ServerContext* context,
     server->Read(&request);
 
     return verify_client_and_dispatch_operation(
-        std::bind(&DaemonRpc::on_create, this, &request, server, std::placeholders::_1), client_cert_from(context));
+        __func__, std::bind(&DaemonRpc::on_create, this, &request, server, std::placeholders::_1), context);
 }
 
 grpc::Status mp::DaemonRpc::launch(grpc::ServerContext* context,
@@ -154,7 +314,7 @@ grpc::Status mp::DaemonRpc::launch(grpc::ServerContext* context,
     server->Read(&request);
 
     return verify_client_and_dispatch_operation(
-        std::bind(&DaemonRpc::on_launch, this, &request, server, std::placeholders::_1), client_cert_from(context));
+        __func__, std::bind(&DaemonRpc::on_launch, this, &request, server, std::placeholders::_1), context);
 }
 
 grpc::Status mp::DaemonRpc::purge(grpc::ServerContext* context,
@@ -164,34 +324,37 @@ grpc::Status mp::DaemonRpc::purge(grpc::ServerContext* context,
     server->Read(&request);
 
     return verify_client_and_dispatch_operation(
-        std::bind(&DaemonRpc::on_purge, this, &request, server, std::placeholders::_1), client_cert_from(context));
+        __func__, std::bind(&DaemonRpc::on_purge, this, &request, server, std::placeholders::_1), context);
 }
 
 grpc::Status mp::DaemonRpc::find(grpc::ServerContext* context, grpc::ServerReaderWriter<FindReply, FindRequest>* server)
 {
     FindRequest request;
     server->Read(&request);
+    compress_remote_replies(context, server_socket_type);
 
     return verify_client_and_dispatch_operation(
-        std::bind(&DaemonRpc::on_find, this, &request, server, std::placeholders::_1), client_cert_from(context));
+        __func__, std::bind(&DaemonRpc::on_find, this, &request, server, std::placeholders::_1), context);
 }
 
 grpc::Status mp::DaemonRpc::info(grpc::ServerContext* context, grpc::ServerReaderWriter<InfoReply, InfoRequest>* server)
 {
     InfoRequest request;
     server->Read(&request);
+    compress_remote_replies(context, server_socket_type);
 
     return verify_client_and_dispatch_operation(
-        std::bind(&DaemonRpc::on_info, this, &request, server, std::placeholders::_1), client_cert_from(context));
+        __func__, std::bind(&DaemonRpc::on_info, this, &request, server, std::placeholders::_1), context);
 }
 
 grpc::Status mp::DaemonRpc::list(grpc::ServerContext* context, grpc::ServerReaderWriter<ListReply, ListRequest>* server)
 {
     ListRequest request;
     server->Read(&request);
+    compress_remote_replies(context, server_socket_type);
 
     return verify_client_and_dispatch_operation(
-        std::bind(&DaemonRpc::on_list, this, &request, server, std::placeholders::_1), client_cert_from(context));
+        __func__, std::bind(&DaemonRpc::on_list, this, &request, server, std::placeholders::_1), context);
 }
 
 grpc::Status mp::DaemonRpc::networks(grpc::ServerContext* context,
@@ -201,7 +364,7 @@ grpc::Status mp::DaemonRpc::networks(grpc::ServerContext* context,
     server->Read(&request);
 
     return verify_client_and_dispatch_operation(
-        std::bind(&DaemonRpc::on_networks, this, &request, server, std::placeholders::_1), client_cert_from(context));
+        __func__, std::bind(&DaemonRpc::on_networks, this, &request, server, std::placeholders::_1), context);
 }
 
 grpc::Status mp::DaemonRpc::mount(grpc::ServerContext* context,
@@ -211,7 +374,7 @@ grpc::Status mp::DaemonRpc::mount(grpc::ServerContext* context,
     server->Read(&request);
 
     return verify_client_and_dispatch_operation(
-        std::bind(&DaemonRpc::on_mount, this, &request, server, std::placeholders::_1), client_cert_from(context));
+        __func__, std::bind(&DaemonRpc::on_mount, this, &request, server, std::placeholders::_1), context);
 }
 
 grpc::Status mp::DaemonRpc::recover(grpc::ServerContext* context,
@@ -221,7 +384,7 @@ grpc::Status mp::DaemonRpc::recover(grpc::ServerContext* context,
     server->Read(&request);
 
     return verify_client_and_dispatch_operation(
-        std::bind(&DaemonRpc::on_recover, this, &request, server, std::placeholders::_1), client_cert_from(context));
+        __func__, std::bind(&DaemonRpc::on_recover, this, &request, server, std::placeholders::_1), context);
 }
 
 grpc::Status mp::DaemonRpc::ssh_info(grpc::ServerContext* context,
@@ -231,7 +394,7 @@ grpc::Status mp::DaemonRpc::ssh_info(grpc::ServerContext* context,
     server->Read(&request);
 
     return verify_client_and_dispatch_operation(
-        std::bind(&DaemonRpc::on_ssh_info, this, &request, server, std::placeholders::_1), client_cert_from(context));
+        __func__, std::bind(&DaemonRpc::on_ssh_info, this, &request, server, std::placeholders::_1), context);
 }
 
 grpc::Status mp::DaemonRpc::start(grpc::ServerContext* context,
@@ -241,7 +404,7 @@ grpc::Status mp::DaemonRpc::start(grpc::ServerContext* context,
     server->Read(&request);
 
     return verify_client_and_dispatch_operation(
-        std::bind(&DaemonRpc::on_start, this, &request, server, std::placeholders::_1), client_cert_from(context));
+        __func__, std::bind(&DaemonRpc::on_start, this, &request, server, std::placeholders::_1), context);
 }
 
 grpc::Status mp::DaemonRpc::stop(grpc::ServerContext* context, grpc::ServerReaderWriter<StopReply, StopRequest>* server)
@@ -250,7 +413,7 @@ grpc::Status mp::DaemonRpc::stop(grpc::ServerContext* context, grpc::ServerReade
     server->Read(&request);
 
     return verify_client_and_dispatch_operation(
-        std::bind(&DaemonRpc::on_stop, this, &request, server, std::placeholders::_1), client_cert_from(context));
+        __func__, std::bind(&DaemonRpc::on_stop, this, &request, server, std::placeholders::_1), context);
 }
 
 grpc::Status mp::DaemonRpc::suspend(grpc::ServerContext* context,
@@ -260,7 +423,7 @@ grpc::Status mp::DaemonRpc::suspend(grpc::ServerContext* context,
     server->Read(&request);
 
     return verify_client_and_dispatch_operation(
-        std::bind(&DaemonRpc::on_suspend, this, &request, server, std::placeholders::_1), client_cert_from(context));
+        __func__, std::bind(&DaemonRpc::on_suspend, this, &request, server, std::placeholders::_1), context);
 }
 
 grpc::Status mp::DaemonRpc::restart(grpc::ServerContext* context,
@@ -270,7 +433,7 @@ grpc::Status mp::DaemonRpc::restart(grpc::ServerContext* context,
     server->Read(&request);
 
     return verify_client_and_dispatch_operation(
-        std::bind(&DaemonRpc::on_restart, this, &request, server, std::placeholders::_1), client_cert_from(context));
+        __func__, std::bind(&DaemonRpc::on_restart, this, &request, server, std::placeholders::_1), context);
 }
 
 grpc::Status mp::DaemonRpc::delet(grpc::ServerContext* context,
@@ -280,7 +443,7 @@ grpc::Status mp::DaemonRpc::delet(grpc::ServerContext* context,
     server->Read(&request);
 
     return verify_client_and_dispatch_operation(
-        std::bind(&DaemonRpc::on_delete, this, &request, server, std::placeholders::_1), client_cert_from(context));
+        __func__, std::bind(&DaemonRpc::on_delete, this, &request, server, std::placeholders::_1), context);
 }
 
 grpc::Status mp::DaemonRpc::umount(grpc::ServerContext* context,
@@ -290,7 +453,7 @@ grpc::Status mp::DaemonRpc::umount(grpc::ServerContext* context,
     server->Read(&request);
 
     return verify_client_and_dispatch_operation(
-        std::bind(&DaemonRpc::on_umount, this, &request, server, std::placeholders::_1), client_cert_from(context));
+        __func__, std::bind(&DaemonRpc::on_umount, this, &request, server, std::placeholders::_1), context);
 }
 
 grpc::Status mp::DaemonRpc::version(grpc::ServerContext* context,
@@ -300,7 +463,7 @@ grpc::Status mp::DaemonRpc::version(grpc::ServerContext* context,
     server->Read(&request);
 
     return verify_client_and_dispatch_operation(
-        std::bind(&DaemonRpc::on_version, this, &request, server, std::placeholders::_1), client_cert_from(context));
+        __func__, std::bind(&DaemonRpc::on_version, this, &request, server, std::placeholders::_1), context);
 }
 
 grpc::Status mp::DaemonRpc::ping(grpc::ServerContext* context, const PingRequest* request, PingReply* server)
@@ -309,6 +472,7 @@ grpc::Status mp::DaemonRpc::ping(grpc::ServerContext* context, const PingRequest
 
     if (!client_cert.empty() && client_cert_store->verify_cert(client_cert))
     {
+        offer_session(context, client_cert);
         return grpc::Status::OK;
     }
 
@@ -321,7 +485,7 @@ grpc::Status mp::DaemonRpc::get(grpc::ServerContext* context, grpc::ServerReader
     server->Read(&request);
 
     return verify_client_and_dispatch_operation(
-        std::bind(&DaemonRpc::on_get, this, &request, server, std::placeholders::_1), client_cert_from(context));
+        __func__, std::bind(&DaemonRpc::on_get, this, &request, server, std::placeholders::_1), context);
 }
 
 grpc::Status mp::DaemonRpc::authenticate(grpc::ServerContext* context,
@@ -330,6 +494,10 @@ grpc::Status mp::DaemonRpc::authenticate(grpc::ServerContext* context,
     AuthenticateRequest request;
     server->Read(&request);
 
+    const RequestSlot slot{requests_in_flight};
+    if (auto status = check_queue_depth(slot.queue_depth); !status.ok())
+        return status;
+
     auto status = emit_signal_and_wait_for_result(
         std::bind(&DaemonRpc::on_authenticate, this, &request, server, std::placeholders::_1));
 
@@ -337,7 +505,8 @@ grpc::Status mp::DaemonRpc::authenticate(grpc::ServerContext* context,
     {
         try
         {
-            accept_cert(client_cert_store, client_cert_from(context), server_address);
+            if (const auto client_cert = client_cert_from(context); !client_cert.empty())
+                accept_cert(client_cert_store, client_cert, server_address);
         }
         catch (const std::exception& e)
         {
@@ -354,7 +523,7 @@ grpc::Status mp::DaemonRpc::set(grpc::ServerContext* context, grpc::ServerReader
     server->Read(&request);
 
     return verify_client_and_dispatch_operation(
-        std::bind(&DaemonRpc::on_set, this, &request, server, std::placeholders::_1), client_cert_from(context));
+        __func__, std::bind(&DaemonRpc::on_set, this, &request, server, std::placeholders::_1), context);
 }
 
 grpc::Status mp::DaemonRpc::keys(grpc::ServerContext* context, grpc::ServerReaderWriter<KeysReply, KeysRequest>* server)
@@ -363,13 +532,168 @@ grpc::Status mp::DaemonRpc::keys(grpc::ServerContext* context, grpc::ServerReade
     server->Read(&request);
 
     return verify_client_and_dispatch_operation(
-        std::bind(&DaemonRpc::on_keys, this, &request, server, std::placeholders::_1), client_cert_from(context));
+        __func__, std::bind(&DaemonRpc::on_keys, this, &request, server, std::placeholders::_1), context);
 }
 
-template <typename OperationSignal>
-grpc::Status mp::DaemonRpc::verify_client_and_dispatch_operation(OperationSignal signal, const std::string& client_cert)
+grpc::Status mp::DaemonRpc::watch(grpc::ServerContext* context,
+                                  grpc::ServerReaderWriter<WatchReply, WatchRequest>* server)
+{
+    WatchRequest request;
+    server->Read(&request);
+
+    return verify_client_and_dispatch_operation(
+        __func__, std::bind(&DaemonRpc::on_watch, this, &request, server, std::placeholders::_1), context);
+}
+
+grpc::Status mp::DaemonRpc::metrics(grpc::ServerContext* context,
+                                    grpc::ServerReaderWriter<MetricsReply, MetricsRequest>* server)
+{
+    MetricsRequest request;
+    server->Read(&request);
+
+    return verify_client_and_dispatch_operation(
+        __func__, std::bind(&DaemonRpc::on_metrics, this, &request, server, std::placeholders::_1), context);
+}
+
+grpc::Status mp::DaemonRpc::console_log(grpc::ServerContext* context,
+                                        grpc::ServerReaderWriter<ConsoleLogReply, ConsoleLogRequest>* server)
+{
+    ConsoleLogRequest request;
+    server->Read(&request);
+
+    return verify_client_and_dispatch_operation(
+        __func__, std::bind(&DaemonRpc::on_console_log, this, &request, server, std::placeholders::_1), context);
+}
+
+grpc::Status mp::DaemonRpc::clone(grpc::ServerContext* context,
+                                  grpc::ServerReaderWriter<CloneReply, CloneRequest>* server)
+{
+    CloneRequest request;
+    server->Read(&request);
+
+    return verify_client_and_dispatch_operation(
+        __func__, std::bind(&DaemonRpc::on_clone, this, &request, server, std::placeholders::_1), context);
+}
+
+grpc::Status mp::DaemonRpc::compact(grpc::ServerContext* context,
+                                    grpc::ServerReaderWriter<CompactReply, CompactRequest>* server)
+{
+    CompactRequest request;
+    server->Read(&request);
+
+    return verify_client_and_dispatch_operation(
+        __func__, std::bind(&DaemonRpc::on_compact, this, &request, server, std::placeholders::_1), context);
+}
+
+grpc::Status mp::DaemonRpc::snapshot(grpc::ServerContext* context,
+                                     grpc::ServerReaderWriter<SnapshotReply, SnapshotRequest>* server)
+{
+    SnapshotRequest request;
+    server->Read(&request);
+
+    return verify_client_and_dispatch_operation(
+        __func__, std::bind(&DaemonRpc::on_snapshot, this, &request, server, std::placeholders::_1), context);
+}
+
+grpc::Status mp::DaemonRpc::restore(grpc::ServerContext* context,
+                                    grpc::ServerReaderWriter<RestoreReply, RestoreRequest>* server)
+{
+    RestoreRequest request;
+    server->Read(&request);
+
+    return verify_client_and_dispatch_operation(
+        __func__, std::bind(&DaemonRpc::on_restore, this, &request, server, std::placeholders::_1), context);
+}
+
+grpc::Status mp::DaemonRpc::exec(grpc::ServerContext* context, grpc::ServerReaderWriter<ExecReply, ExecRequest>* server)
+{
+    ExecRequest request;
+    server->Read(&request);
+
+    ContextExecServer exec_server{context, server};
+    return verify_client_and_dispatch_operation(
+        __func__, std::bind(&DaemonRpc::on_exec, this, &request, &exec_server, std::placeholders::_1), context);
+}
+
+grpc::Status mp::DaemonRpc::forward(grpc::ServerContext* context,
+                                    grpc::ServerReaderWriter<ForwardReply, ForwardRequest>* server)
+{
+    ForwardRequest request;
+    server->Read(&request);
+
+    return verify_client_and_dispatch_operation(
+        __func__, std::bind(&DaemonRpc::on_forward, this, &request, server, std::placeholders::_1), context);
+}
+
+grpc::Status mp::DaemonRpc::apply(grpc::ServerContext* context,
+                                  grpc::ServerReaderWriter<ApplyReply, ApplyRequest>* server)
 {
-    if (server_socket_type == mp::ServerSocketType::unix && client_cert_store->empty())
+    ApplyRequest request;
+    server->Read(&request);
+
+    return verify_client_and_dispatch_operation(
+        __func__, std::bind(&DaemonRpc::on_apply, this, &request, server, std::placeholders::_1), context);
+}
+
+grpc::Status mp::DaemonRpc::check_queue_depth(int queue_depth)
+{
+    if (queue_depth > max_requests_in_flight)
+    {
+        mpl::log(mpl::Level::warning, category,
+                 fmt::format("Turning a request away, {} are in flight already", queue_depth - 1));
+        return grpc::Status{grpc::StatusCode::RESOURCE_EXHAUSTED,
+                            "The Multipass service is too busy at the moment, please try again later."};
+    }
+
+    auto peak = peak_requests_in_flight.load();
+    while (queue_depth > peak && !peak_requests_in_flight.compare_exchange_weak(peak, queue_depth))
+        ;
+
+    mpl::log(mpl::Level::trace, category,
+             fmt::format("Requests in flight: {} (peak {})", queue_depth, peak_requests_in_flight.load()));
+    return grpc::Status::OK;
+}
+
+std::string mp::DaemonRpc::client_cert_from(grpc::ServerContext* context)
+{
+    if (!came_through_local_socket(context))
+        return tls_client_cert_from(context);
+
+    const auto token = session_token_from(context);
+    std::lock_guard lock{sessions_mutex};
+    const auto it = session_certs.find(token);
+
+    return it != session_certs.end() ? it->second : std::string{};
+}
+
+void mp::DaemonRpc::offer_session(grpc::ServerContext* context, const std::string& client_cert)
+{
+    // Only to clients that came through TLS over the unix socket, the local one being right next to it
+    if (server_socket_type != mp::ServerSocketType::unix || came_through_local_socket(context) || client_cert.empty())
+        return;
+
+    std::lock_guard lock{sessions_mutex};
+    auto it = std::find_if(session_certs.cbegin(), session_certs.cend(),
+                           [&client_cert](const auto& session) { return session.second == client_cert; });
+    if (it == session_certs.cend())
+        it = session_certs.emplace(new_session_token(), client_cert).first;
+
+    context->AddInitialMetadata(mp::session_metadata_key, it->first);
+}
+
+template <typename OperationSignal>
+grpc::Status mp::DaemonRpc::verify_client_and_dispatch_operation(const char* method, OperationSignal signal,
+                                                                 grpc::ServerContext* context)
+{
+    const RequestMetrics metrics{method};
+    const RequestSlot slot{requests_in_flight};
+    if (auto status = check_queue_depth(slot.queue_depth); !status.ok())
+        return metrics.done(status);
+
+    const auto client_cert = client_cert_from(context);
+    // The first client to come along is trusted, as long as it came through the socket that's restricted until then
+    if (server_socket_type == mp::ServerSocketType::unix && client_cert_store->empty() &&
+        !came_through_local_socket(context))
     {
         try
         {
@@ -377,15 +701,16 @@ grpc::Status mp::DaemonRpc::verify_client_and_dispatch_operation(OperationSignal
         }
         catch (const std::exception& e)
         {
-            return grpc::Status{grpc::StatusCode::INTERNAL, e.what()};
+            return metrics.done(grpc::Status{grpc::StatusCode::INTERNAL, e.what()});
         }
     }
     else if (!client_cert_store->verify_cert(client_cert))
     {
-        return grpc::Status{grpc::StatusCode::UNAUTHENTICATED,
-                            "The client is not authenticated with the Multipass service.\n"
-                            "Please use 'multipass authenticate' before proceeding."};
+        return metrics.done(grpc::Status{grpc::StatusCode::UNAUTHENTICATED,
+                                         "The client is not authenticated with the Multipass service.\n"
+                                         "Please use 'multipass authenticate' before proceeding."});
     }
 
-    return emit_signal_and_wait_for_result(signal);
+    offer_session(context, client_cert);
+    return metrics.done(emit_signal_and_wait_for_result(signal));
 }
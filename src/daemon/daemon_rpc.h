@@ -28,8 +28,12 @@
 
 #include <QObject>
 
+#include <atomic>
 #include <future>
 #include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
 
 namespace multipass
 {
@@ -47,6 +51,13 @@ enum class ServerSocketType
 };
 #endif
 
+// An exec request's stream, which the daemon can cut off for a client that never says it is done sending
+class ExecServer : public grpc::ServerReaderWriterInterface<ExecReply, ExecRequest>
+{
+public:
+    virtual void cancel() = 0;
+};
+
 struct DaemonConfig;
 class DaemonRpc : public QObject, public multipass::Rpc::Service, private DisabledCopyMove
 {
@@ -54,6 +65,10 @@ class DaemonRpc : public QObject, public multipass::Rpc::Service, private Disabl
 public:
     DaemonRpc(const std::string& server_address, const CertProvider& cert_provider, CertStore* client_cert_store);
 
+    // Each request in flight holds on to a gRPC thread until it is answered. Past this many, new ones are turned away
+    // rather than spawning ever more threads.
+    static constexpr int max_requests_in_flight = 64;
+
 signals:
     void on_create(const CreateRequest* request, grpc::ServerReaderWriter<CreateReply, CreateRequest>* server,
                    std::promise<grpc::Status>* status_promise);
@@ -98,10 +113,40 @@ signals:
     void on_authenticate(const AuthenticateRequest* request,
                          grpc::ServerReaderWriter<AuthenticateReply, AuthenticateRequest>* server,
                          std::promise<grpc::Status>* status_promise);
+    void on_watch(const WatchRequest* request, grpc::ServerReaderWriter<WatchReply, WatchRequest>* server,
+                  std::promise<grpc::Status>* status_promise);
+    void on_metrics(const MetricsRequest* request, grpc::ServerReaderWriter<MetricsReply, MetricsRequest>* server,
+                    std::promise<grpc::Status>* status_promise);
+    void on_console_log(const ConsoleLogRequest* request,
+                        grpc::ServerReaderWriter<ConsoleLogReply, ConsoleLogRequest>* server,
+                        std::promise<grpc::Status>* status_promise);
+    void on_clone(const CloneRequest* request, grpc::ServerReaderWriter<CloneReply, CloneRequest>* server,
+                  std::promise<grpc::Status>* status_promise);
+    void on_compact(const CompactRequest* request, grpc::ServerReaderWriter<CompactReply, CompactRequest>* server,
+                    std::promise<grpc::Status>* status_promise);
+    void on_snapshot(const SnapshotRequest* request, grpc::ServerReaderWriter<SnapshotReply, SnapshotRequest>* server,
+                     std::promise<grpc::Status>* status_promise);
+    void on_restore(const RestoreRequest* request, grpc::ServerReaderWriter<RestoreReply, RestoreRequest>* server,
+                    std::promise<grpc::Status>* status_promise);
+    void on_exec(const ExecRequest* request, ExecServer* server, std::promise<grpc::Status>* status_promise);
+    void on_forward(const ForwardRequest* request, grpc::ServerReaderWriter<ForwardReply, ForwardRequest>* server,
+                    std::promise<grpc::Status>* status_promise);
+    void on_apply(const ApplyRequest* request, grpc::ServerReaderWriter<ApplyReply, ApplyRequest>* server,
+                  std::promise<grpc::Status>* status_promise);
 
 private:
     template <typename OperationSignal>
-    grpc::Status verify_client_and_dispatch_operation(OperationSignal signal, const std::string& client_cert);
+    grpc::Status verify_client_and_dispatch_operation(const char* method, OperationSignal signal,
+                                                      grpc::ServerContext* context);
+    grpc::Status check_queue_depth(int queue_depth);
+    std::string client_cert_from(grpc::ServerContext* context); // over TLS, or that of a session
+    void offer_session(grpc::ServerContext* context, const std::string& client_cert);
+
+    // Metrics and sessions, these come first so that they are there for the server to handle requests with
+    std::atomic_int requests_in_flight{0};
+    std::atomic_int peak_requests_in_flight{0};
+    std::mutex sessions_mutex;
+    std::unordered_map<std::string, std::string> session_certs; // by token, for the lifetime of the daemon
 
     const std::string server_address;
     const std::unique_ptr<grpc::Server> server;
@@ -145,6 +190,25 @@ protected:
     grpc::Status keys(grpc::ServerContext* context, grpc::ServerReaderWriter<KeysReply, KeysRequest>* server) override;
     grpc::Status authenticate(grpc::ServerContext* context,
                               grpc::ServerReaderWriter<AuthenticateReply, AuthenticateRequest>* server) override;
+    grpc::Status watch(grpc::ServerContext* context,
+                       grpc::ServerReaderWriter<WatchReply, WatchRequest>* server) override;
+    grpc::Status metrics(grpc::ServerContext* context,
+                         grpc::ServerReaderWriter<MetricsReply, MetricsRequest>* server) override;
+    grpc::Status console_log(grpc::ServerContext* context,
+                             grpc::ServerReaderWriter<ConsoleLogReply, ConsoleLogRequest>* server) override;
+    grpc::Status clone(grpc::ServerContext* context,
+                       grpc::ServerReaderWriter<CloneReply, CloneRequest>* server) override;
+    grpc::Status compact(grpc::ServerContext* context,
+                         grpc::ServerReaderWriter<CompactReply, CompactRequest>* server) override;
+    grpc::Status snapshot(grpc::ServerContext* context,
+                          grpc::ServerReaderWriter<SnapshotReply, SnapshotRequest>* server) override;
+    grpc::Status restore(grpc::ServerContext* context,
+                         grpc::ServerReaderWriter<RestoreReply, RestoreRequest>* server) override;
+    grpc::Status exec(grpc::ServerContext* context, grpc::ServerReaderWriter<ExecReply, ExecRequest>* server) override;
+    grpc::Status forward(grpc::ServerContext* context,
+                         grpc::ServerReaderWriter<ForwardReply, ForwardRequest>* server) override;
+    grpc::Status apply(grpc::ServerContext* context,
+                       grpc::ServerReaderWriter<ApplyReply, ApplyRequest>* server) override;
 };
 } // namespace multipass
 #endif // MULTIPASS_DAEMON_RPC_H
@@ -16,13 +16,17 @@
  */
 
 #include "default_vm_image_vault.h"
+#include "zsync_delta.h"
 
+#include <multipass/checksum.h>
 #include <multipass/exceptions/aborted_download_exception.h>
 #include <multipass/exceptions/create_image_exception.h>
 #include <multipass/exceptions/image_vault_exceptions.h>
 #include <multipass/exceptions/unsupported_image_exception.h>
-#include <multipass/json_utils.h>
+#include <multipass/image_decoder.h>
 #include <multipass/logging/log.h>
+#include <multipass/logging/metrics.h>
+#include <multipass/logging/tracer.h>
 #include <multipass/platform.h>
 #include <multipass/process/qemuimg_process_spec.h>
 #include <multipass/query.h>
@@ -30,17 +34,27 @@
 #include <multipass/url_downloader.h>
 #include <multipass/utils.h>
 #include <multipass/vm_image.h>
-#include <multipass/xz_image_decoder.h>
+#include <shared/qemu_img_utils/qemu_img_utils.h>
 
 #include <multipass/format.h>
 
+#include <QCryptographicHash>
 #include <QJsonArray>
 #include <QJsonDocument>
 #include <QJsonObject>
 #include <QUrl>
-#include <QtConcurrent/QtConcurrent>
 
+#include <algorithm>
+#include <atomic>
 #include <exception>
+#include <filesystem>
+#include <functional>
+#include <future>
+#include <mutex>
+#include <tuple>
+#include <unordered_set>
+#include <utility>
+#include <vector>
 
 namespace mp = multipass;
 namespace mpl = multipass::logging;
@@ -50,6 +64,11 @@ namespace
 constexpr auto category = "image vault";
 constexpr auto instance_db_name = "multipassd-instance-image-records.json";
 constexpr auto image_db_name = "multipassd-image-records.json";
+// Refreshes are independent of each other, but there is only so much bandwidth to share with the launches going on
+constexpr auto max_concurrent_updates = 2u;
+constexpr auto last_modified_ttl = std::chrono::minutes{5};
+constexpr auto trash_truncate_step = 1024ll * 1024 * 1024;
+constexpr auto image_cache_metric = "multipass_image_cache_requests_total";
 
 auto query_to_json(const mp::Query& query)
 {
@@ -88,22 +107,14 @@ auto record_to_json(const mp::VaultRecord& record)
     json.insert("image", image_to_json(record.image));
     json.insert("query", query_to_json(record.query));
     json.insert("last_accessed", static_cast<qint64>(record.last_accessed.time_since_epoch().count()));
+    if (record.virtual_size)
+        json.insert("virtual_size", QString::number(record.virtual_size->in_bytes()));
     return json;
 }
 
 std::unordered_map<std::string, mp::VaultRecord> load_db(const QString& db_name)
 {
-    QFile db_file{db_name};
-    auto opened = db_file.open(QIODevice::ReadOnly);
-    if (!opened)
-        return {};
-
-    QJsonParseError parse_error;
-    auto doc = QJsonDocument::fromJson(db_file.readAll(), &parse_error);
-    if (doc.isNull())
-        return {};
-
-    auto records = doc.object();
+    const auto records = mp::JournaledRecords::read(db_name);
     if (records.isEmpty())
         return {};
 
@@ -158,10 +169,15 @@ std::unordered_map<std::string, mp::VaultRecord> load_db(const QString& db_name)
             last_accessed = std::chrono::system_clock::time_point(duration);
         }
 
+        std::optional<mp::MemorySize> virtual_size;
+        if (const auto size = record["virtual_size"].toString(); !size.isEmpty())
+            virtual_size = mp::MemorySize{size.toStdString()};
+
         reconstructed_records[key] = {
             {image_path, image_id, original_release, current_release, release_date, aliases},
             {"", release.toStdString(), persistent.toBool(), remote_name.toStdString(), query_type},
-            last_accessed};
+            last_accessed,
+            virtual_size};
     }
     return reconstructed_records;
 }
@@ -185,8 +201,118 @@ void delete_image_dir(const mp::Path& image_path)
     }
 }
 
+// Other hosts may have the image already. What they send is checked against the published hash all the same, and
+// compressed images are left out: peers keep them decompressed, which that hash says nothing about.
+bool download_from_peers(mp::URLDownloader* downloader, const mp::vault::BlobStore& blobs, const mp::VMImageInfo& info,
+                         const QString& image_path, const mp::ProgressMonitor& monitor)
+{
+    for (const auto& url : blobs.peer_urls_for(info.id.toStdString()))
+    {
+        try
+        {
+            downloader->download_to(url, image_path, info.size, mp::LaunchProgress::IMAGE, monitor);
+
+            monitor(mp::LaunchProgress::VERIFY, -1);
+            mp::vault::verify_image_download(image_path, info.id);
+
+            mpl::log(mpl::Level::info, category, fmt::format("Got image \"{}\" from {}", info.id, url));
+            return true;
+        }
+        catch (const mp::AbortedDownloadException&)
+        {
+            throw;
+        }
+        catch (const std::exception& e)
+        {
+            mpl::log(mpl::Level::debug, category,
+                     fmt::format("Cannot get image \"{}\" from {}: {}", info.id, url, e.what()));
+            QFile::remove(image_path);
+        }
+    }
+
+    return false;
+}
+
+// The image of what query got before, to rebuild what it gets now from: daily builds of a release share most of their
+// blocks. The blob is what was downloaded, preparing may have changed the image since.
+std::optional<mp::Path> delta_basis_for(const mp::VaultRecords& images, const mp::vault::BlobStore& blobs,
+                                        const mp::Query& query)
+{
+    for (const auto& [key, record] : images)
+    {
+        const auto& aliases = record.image.aliases;
+        if (record.query.remote_name != query.remote_name ||
+            (record.query.release != query.release &&
+             std::find(aliases.cbegin(), aliases.cend(), query.release) == aliases.cend()))
+            continue;
+
+        if (const auto blob = blobs.path_for(key); !blob.isEmpty() && QFile::exists(blob))
+            return blob;
+        if (QFile::exists(record.image.image_path))
+            return record.image.image_path;
+    }
+
+    return std::nullopt;
+}
+
+// Interrupted downloads are left for the next fetch to resume, for as long as unused images are kept around
+bool has_recent_partial_download(const QFileInfo& image_dir, const mp::days& days_to_expire)
+{
+    if (!image_dir.isDir())
+        return false;
+
+    const auto partials = QDir{image_dir.absoluteFilePath()}.entryInfoList(
+        {QString{"*"} + mp::URLDownloader::partial_download_suffix}, QDir::Files);
+    const auto now = QDateTime::currentDateTime();
+    const auto max_age = std::chrono::duration_cast<std::chrono::seconds>(days_to_expire).count();
+
+    return std::any_of(partials.cbegin(), partials.cend(), [&now, max_age](const QFileInfo& partial) {
+        return partial.lastModified().secsTo(now) < max_age;
+    });
+}
+
+// What the image and whatever came with it, like a kernel and initrd, take in its directory
+qint64 image_dir_size(const mp::Path& image_path)
+{
+    qint64 size{0};
+    for (const auto& file : QFileInfo{image_path}.dir().entryInfoList(QDir::Files))
+        size += file.size();
+
+    return size;
+}
+
+// Large files are shrunk a step at a time before being unlinked, so the file system frees their extents in bits
+// rather than holding up everyone else in one go. Files with other links still have content to keep.
+void reclaim(const QFileInfo& entry)
+{
+    const auto path = entry.absoluteFilePath();
+    if (entry.isDir() && !entry.isSymLink())
+    {
+        for (const auto& child :
+             QDir{path}.entryInfoList(QDir::AllEntries | QDir::NoDotAndDotDot | QDir::Hidden | QDir::System))
+            reclaim(child);
+
+        QDir{}.rmdir(path);
+        return;
+    }
+
+    std::error_code err;
+    if (!entry.isSymLink() && std::filesystem::hard_link_count(path.toStdString(), err) == 1)
+    {
+        QFile file{path};
+        for (auto size = entry.size() - trash_truncate_step; size > 0; size -= trash_truncate_step)
+            if (!file.resize(size))
+                break;
+    }
+
+    QFile::remove(path);
+}
+
 mp::MemorySize get_image_size(const mp::Path& image_path)
 {
+    if (const auto header = mp::backend::read_image_header(image_path))
+        return header->virtual_size;
+
     QStringList qemuimg_parameters{{"info", image_path}};
     auto qemuimg_process =
         mp::platform::make_process(std::make_unique<mp::QemuImgProcessSpec>(qemuimg_parameters, image_path));
@@ -221,16 +347,21 @@ mp::MemorySize get_image_size(const mp::Path& image_path)
 } // namespace
 
 mp::DefaultVMImageVault::DefaultVMImageVault(std::vector<VMImageHost*> image_hosts, URLDownloader* downloader,
-                                             mp::Path cache_dir_path, mp::Path data_dir_path, mp::days days_to_expire)
+                                             mp::Path cache_dir_path, mp::Path data_dir_path, mp::days days_to_expire,
+                                             const std::optional<vault::BlobStore>& shared_blobs)
     : BaseVMImageVault{image_hosts},
       url_downloader{downloader},
       cache_dir{QDir(cache_dir_path).filePath("vault")},
       data_dir{QDir(data_dir_path).filePath("vault")},
       instances_dir(data_dir.filePath("instances")),
       images_dir(cache_dir.filePath("images")),
+      trash_dir(data_dir.filePath("trash")),
+      blobs{shared_blobs.value_or(vault::BlobStore{cache_dir.filePath("blobs")})},
       days_to_expire{days_to_expire},
-      prepared_image_records{load_db(cache_dir.filePath(image_db_name))},
-      instance_image_records{load_db(data_dir.filePath(instance_db_name))}
+      prepared_image_records{std::make_shared<const VaultRecords>(load_db(cache_dir.filePath(image_db_name)))},
+      instance_image_records{std::make_shared<const VaultRecords>(load_db(data_dir.filePath(instance_db_name)))},
+      image_db{cache_dir.filePath(image_db_name)},
+      instance_db{data_dir.filePath(instance_db_name)}
 {
 }
 
@@ -243,10 +374,12 @@ mp::VMImage mp::DefaultVMImageVault::fetch_image(const FetchType& fetch_type, co
                                                  const PrepareAction& prepare, const ProgressMonitor& monitor,
                                                  const bool unlock, const std::optional<std::string>& checksum)
 {
+    mpl::TraceSpan span{"fetch_image", query.name};
+
     {
-        std::lock_guard<decltype(fetch_mutex)> lock{fetch_mutex};
-        auto name_entry = instance_image_records.find(query.name);
-        if (name_entry != instance_image_records.end())
+        const auto instances = instance_records();
+        auto name_entry = instances->find(query.name);
+        if (name_entry != instances->end())
         {
             const auto& record = name_entry->second;
 
@@ -267,7 +400,7 @@ mp::VMImage mp::DefaultVMImageVault::fetch_image(const FetchType& fetch_type, co
 
         source_image.image_path = image_url.path();
 
-        if (source_image.image_path.endsWith(".xz"))
+        if (mp::decoding::is_compressed(source_image.image_path))
         {
             source_image.image_path = extract_image_from(query.name, source_image, monitor);
         }
@@ -281,11 +414,9 @@ mp::VMImage mp::DefaultVMImageVault::fetch_image(const FetchType& fetch_type, co
 
         remove_source_images(source_image, vm_image);
 
-        {
-            std::lock_guard<decltype(fetch_mutex)> lock{fetch_mutex};
-            instance_image_records[query.name] = {vm_image, query, std::chrono::system_clock::now()};
-            persist_instance_records();
-        }
+        update_instance_records(query.name, [&query, &vm_image](VaultRecords& records) {
+            records[query.name] = {vm_image, query, std::chrono::system_clock::now()};
+        });
 
         return vm_image;
     }
@@ -293,7 +424,8 @@ mp::VMImage mp::DefaultVMImageVault::fetch_image(const FetchType& fetch_type, co
     {
         std::string id;
         std::optional<VMImage> source_image{std::nullopt};
-        QFuture<VMImage> future;
+        std::optional<std::shared_future<VMImage>> running_fetch;
+        std::function<VMImage()> fetch;
 
         if (query.query_type == Query::Type::HttpDownload)
         {
@@ -304,25 +436,27 @@ mp::VMImage mp::DefaultVMImageVault::fetch_image(const FetchType& fetch_type, co
                 checksum
                     ? *checksum
                     : QCryptographicHash::hash(query.release.c_str(), QCryptographicHash::Sha256).toHex().toStdString();
-            auto last_modified = url_downloader->last_modified(image_url);
+            auto last_modified = cached_last_modified(image_url);
 
-            std::lock_guard<decltype(fetch_mutex)> lock{fetch_mutex};
-            auto entry = prepared_image_records.find(id);
-            if (entry != prepared_image_records.end())
+            const auto image_lock = image_mutex(id);
+            std::lock_guard<std::mutex> lock{*image_lock};
+            const auto images = image_records();
+            auto entry = images->find(id);
+            if (entry != images->end())
             {
-                auto& record = entry->second;
+                const auto& record = entry->second;
 
                 if (last_modified.isValid() && (last_modified.toString().toStdString() == record.image.release_date))
                 {
+                    MP_METRICS.increment(image_cache_metric, {{"result", "hit"}});
                     return finalize_image_records(query, record.image, id);
                 }
             }
 
-            auto running_future = get_image_future(id);
-            if (running_future)
+            running_fetch = in_flight_fetches.join(id);
+            if (running_fetch)
             {
                 monitor(LaunchProgress::WAITING, -1);
-                future = *running_future;
             }
             else
             {
@@ -340,17 +474,16 @@ mp::VMImage mp::DefaultVMImageVault::fetch_image(const FetchType& fetch_type, co
                 const auto image_filename = mp::vault::filename_for(image_url.path());
                 // Attempt to make a sane directory name based on the filename of the image
 
-                const auto image_dir_name =
-                    QString("%1-%2").arg(image_filename.section(".", 0, image_filename.endsWith(".xz") ? -3 : -2),
-                                         QLocale::c().toString(last_modified, "yyyyMMdd"));
-                const auto image_dir = MP_UTILS.make_dir(images_dir, image_dir_name);
-
-                // Had to use std::bind here to workaround the 5 allowable function arguments constraint of
-                // QtConcurrent::run()
-                future = QtConcurrent::run(std::bind(&DefaultVMImageVault::download_and_prepare_source_image, this,
-                                                     info, source_image, image_dir, fetch_type, prepare, monitor));
+                const auto image_dir_name = QString("%1-%2").arg(
+                    mp::decoding::decoded_path_for(image_filename).section(".", 0, -2),
+                    QLocale::c().toString(last_modified, "yyyyMMdd"));
 
-                in_progress_image_fetches[id] = future;
+                // Anything that can fail happens in there, for whoever joined meanwhile to hear about it
+                fetch = [this, info, source_image, image_dir_name, fetch_type, prepare, monitor]() mutable {
+                    const auto image_dir = MP_UTILS.make_dir(images_dir, image_dir_name);
+                    return download_and_prepare_source_image(info, source_image, image_dir, fetch_type, prepare,
+                                                             monitor);
+                };
             }
         }
         else
@@ -361,65 +494,76 @@ mp::VMImage mp::DefaultVMImageVault::fetch_image(const FetchType& fetch_type, co
 
             id = info->id.toStdString();
 
-            std::lock_guard<decltype(fetch_mutex)> lock{fetch_mutex};
-            if (!query.name.empty())
+            const auto image_lock = image_mutex(id);
+            std::lock_guard<std::mutex> lock{*image_lock};
+            const auto images = image_records();
+            for (const auto& record : *images)
             {
-                for (auto& record : prepared_image_records)
+                if (record.second.query.remote_name != query.remote_name)
+                    continue;
+
+                // Without an instance to make, only the very image will do: an alias may have moved on since
+                const auto aliases = record.second.image.aliases;
+                if (id == record.first ||
+                    (!query.name.empty() &&
+                     std::find(aliases.cbegin(), aliases.cend(), query.release) != aliases.cend()))
                 {
-                    if (record.second.query.remote_name != query.remote_name)
-                        continue;
-
-                    const auto aliases = record.second.image.aliases;
-                    if (id == record.first ||
-                        std::find(aliases.cbegin(), aliases.cend(), query.release) != aliases.cend())
+                    const auto prepared_image = record.second.image;
+                    try
                     {
-                        const auto prepared_image = record.second.image;
-                        try
-                        {
-                            return finalize_image_records(query, prepared_image, record.first);
-                        }
-                        catch (const std::exception& e)
-                        {
-                            mpl::log(mpl::Level::warning, category,
-                                     fmt::format("Cannot create instance image: {}", e.what()));
-
-                            break;
-                        }
+                        auto vm_image = finalize_image_records(query, prepared_image, record.first);
+                        MP_METRICS.increment(image_cache_metric, {{"result", "hit"}});
+                        return vm_image;
+                    }
+                    catch (const std::exception& e)
+                    {
+                        mpl::log(mpl::Level::warning, category,
+                                 fmt::format("Cannot create instance image: {}", e.what()));
+
+                        break;
                     }
                 }
             }
 
-            auto running_future = get_image_future(id);
-            if (running_future)
+            running_fetch = in_flight_fetches.join(id);
+            if (running_fetch)
             {
                 monitor(LaunchProgress::WAITING, -1);
-                future = *running_future;
             }
             else
             {
-                const auto image_dir =
-                    MP_UTILS.make_dir(images_dir, QString("%1-%2").arg(info->release).arg(info->version));
-
-                // Had to use std::bind here to workaround the 5 allowable function arguments constraint of
-                // QtConcurrent::run()
-                future = QtConcurrent::run(std::bind(&DefaultVMImageVault::download_and_prepare_source_image, this,
-                                                     *info, source_image, image_dir, fetch_type, prepare, monitor));
-
-                in_progress_image_fetches[id] = future;
+                // As above, anything that can fail happens in there
+                fetch = [this, info = *info, source_image, fetch_type, prepare, monitor, images, query]() mutable {
+                    const auto image_dir =
+                        MP_UTILS.make_dir(images_dir, QString("%1-%2").arg(info.release).arg(info.version));
+                    const auto delta_basis = delta_basis_for(*images, blobs, query);
+                    return download_and_prepare_source_image(info, source_image, image_dir, fetch_type, prepare,
+                                                             monitor, delta_basis);
+                };
             }
         }
 
+        if (running_fetch)
+        {
+            MP_METRICS.increment(image_cache_metric, {{"result", "shared"}}); // joined a download already going
+            auto prepared_image = running_fetch->get();
+            return finalize_image_records(query, prepared_image, id);
+        }
+
         try
         {
-            auto prepared_image = future.result();
-            std::lock_guard<decltype(fetch_mutex)> lock{fetch_mutex};
-            in_progress_image_fetches.erase(id);
+            MP_METRICS.increment(image_cache_metric, {{"result", "miss"}});
+            auto prepared_image = fetch();
+
+            // Whoever comes after this finds either the fetch in progress or its records
+            const auto image_lock = image_mutex(id);
+            std::lock_guard<std::mutex> lock{*image_lock};
+            in_flight_fetches.done(id, prepared_image);
             return finalize_image_records(query, prepared_image, id);
         }
-        catch (const std::exception&)
+        catch (...)
         {
-            std::lock_guard<decltype(fetch_mutex)> lock{fetch_mutex};
-            in_progress_image_fetches.erase(id);
+            in_flight_fetches.failed(id, std::current_exception());
             throw;
         }
     }
@@ -427,49 +571,87 @@ mp::VMImage mp::DefaultVMImageVault::fetch_image(const FetchType& fetch_type, co
 
 void mp::DefaultVMImageVault::remove(const std::string& name)
 {
-    const auto& name_entry = instance_image_records.find(name);
-    if (name_entry == instance_image_records.end())
+    if (!has_record_for(name))
         return;
 
+    // Deleting large images takes a while, they are only renamed away here and deleted with the trash
     QDir instance_dir{instances_dir};
     if (instance_dir.cd(QString::fromStdString(name)))
-        instance_dir.removeRecursively();
+    {
+        const auto trashed = trash_dir.filePath(
+            QString{"%1-%2"}.arg(QString::fromStdString(name)).arg(QDateTime::currentMSecsSinceEpoch()));
+        if (!trash_dir.mkpath(".") || !QDir{}.rename(instance_dir.absolutePath(), trashed))
+            instance_dir.removeRecursively();
+    }
+
+    update_instance_records(name, [&name](VaultRecords& records) { records.erase(name); });
+}
+
+void mp::DefaultVMImageVault::empty_trash()
+{
+    // Whatever is moved here meanwhile is picked up in another round
+    std::lock_guard<decltype(trash_mutex)> lock{trash_mutex};
+    for (auto entries = trash_dir.entryInfoList(QDir::AllEntries | QDir::NoDotAndDotDot); !entries.isEmpty();
+         entries = trash_dir.entryInfoList(QDir::AllEntries | QDir::NoDotAndDotDot))
+    {
+        for (const auto& entry : entries)
+        {
+            mpl::log(mpl::Level::debug, category, fmt::format("Deleting {}", entry.absoluteFilePath()));
+            reclaim(entry);
 
-    instance_image_records.erase(name);
-    persist_instance_records();
+            if (QFileInfo::exists(entry.absoluteFilePath()))
+            {
+                mpl::log(mpl::Level::warning, category, fmt::format("Cannot delete {}", entry.absoluteFilePath()));
+                return;
+            }
+        }
+    }
 }
 
 bool mp::DefaultVMImageVault::has_record_for(const std::string& name)
 {
-    return instance_image_records.find(name) != instance_image_records.end();
+    return instance_records()->count(name) > 0;
 }
 
 void mp::DefaultVMImageVault::prune_expired_images()
 {
-    std::vector<decltype(prepared_image_records)::key_type> expired_keys;
-    std::lock_guard<decltype(fetch_mutex)> lock{fetch_mutex};
-
-    for (const auto& record : prepared_image_records)
+    const auto expiring = image_records();
+    for (const auto& record : *expiring)
     {
         // Expire source images if they aren't persistent and haven't been accessed in 14 days
         if (record.second.query.query_type == Query::Type::Alias && !record.second.query.persistent &&
             record.second.last_accessed + days_to_expire <= std::chrono::system_clock::now())
         {
+            const auto& key = record.first;
+            const auto image_lock = image_mutex(key);
+            std::lock_guard<std::mutex> lock{*image_lock};
+
+            // Looked up again, it may have been used or replaced since, as in prune_to_size
+            const auto current = image_records();
+            auto entry = current->find(key);
+            if (entry == current->end() || entry->second.last_accessed != record.second.last_accessed ||
+                entry->second.query.persistent)
+                continue;
+
             mpl::log(
                 mpl::Level::info, category,
-                fmt::format("Source image {} is expired. Removing it from the cache.", record.second.query.release));
-            expired_keys.push_back(record.first);
-            delete_image_dir(record.second.image.image_path);
+                fmt::format("Source image {} is expired. Removing it from the cache.", entry->second.query.release));
+            delete_image_dir(entry->second.image.image_path);
+            update_image_records(key, [&key](VaultRecords& records) { records.erase(key); });
         }
     }
 
     // Remove any image directories that have no corresponding database entry
+    const auto images = image_records();
     for (const auto& entry : images_dir.entryInfoList(QDir::AllEntries | QDir::NoDotAndDotDot))
     {
-        if (std::find_if(prepared_image_records.cbegin(), prepared_image_records.cend(),
+        if (has_recent_partial_download(entry, days_to_expire))
+            continue;
+
+        if (std::find_if(images->cbegin(), images->cend(),
                          [&entry](const std::pair<std::string, VaultRecord>& record) {
                              return record.second.image.image_path.contains(entry.absoluteFilePath());
-                         }) == prepared_image_records.cend())
+                         }) == images->cend())
         {
             mpl::log(mpl::Level::info, category,
                      fmt::format("Source image {} is no longer valid. Removing it from the cache.",
@@ -478,10 +660,57 @@ void mp::DefaultVMImageVault::prune_expired_images()
         }
     }
 
-    for (const auto& key : expired_keys)
-        prepared_image_records.erase(key);
+    // Other vaults may still be using some of what was removed here, their links keep those blobs around
+    blobs.prune();
+}
+
+void mp::DefaultVMImageVault::prune_to_size(const MemorySize& budget)
+{
+    const auto images = image_records();
+    const auto instances = instance_records();
 
-    persist_image_records();
+    std::unordered_set<std::string> in_use;
+    for (const auto& record : *instances)
+        in_use.insert(record.second.image.id);
+
+    qint64 cached{0};
+    std::vector<std::tuple<std::chrono::system_clock::time_point, std::string, qint64>> candidates;
+    for (const auto& record : *images)
+    {
+        const auto size = image_dir_size(record.second.image.image_path);
+        cached += size;
+
+        if (!in_use.count(record.second.image.id))
+            candidates.emplace_back(record.second.last_accessed, record.first, size);
+    }
+
+    std::sort(candidates.begin(), candidates.end());
+    for (const auto& [last_accessed, key, size] : candidates)
+    {
+        if (cached <= budget.in_bytes())
+            break;
+
+        const auto image_lock = image_mutex(key);
+        std::lock_guard<std::mutex> lock{*image_lock};
+
+        // Looked up again, it may have been used or replaced since
+        const auto current = image_records();
+        auto entry = current->find(key);
+        if (entry == current->end() || entry->second.last_accessed != last_accessed)
+            continue;
+
+        mpl::log(mpl::Level::info, category,
+                 fmt::format("Removing source image {} from the cache, which is over {}", entry->second.query.release,
+                             budget.human_readable()));
+        delete_image_dir(entry->second.image.image_path);
+        update_image_records(key, [&key = key](VaultRecords& records) { records.erase(key); });
+        cached -= size;
+    }
+
+    if (cached > budget.in_bytes())
+        mpl::log(mpl::Level::debug, category, "What is left in the image cache is in use");
+
+    blobs.prune();
 }
 
 void mp::DefaultVMImageVault::update_images(const FetchType& fetch_type, const PrepareAction& prepare,
@@ -489,8 +718,9 @@ void mp::DefaultVMImageVault::update_images(const FetchType& fetch_type, const P
 {
     mpl::log(mpl::Level::debug, category, "Checking for images to update…");
 
-    std::vector<decltype(prepared_image_records)::key_type> keys_to_update;
-    for (const auto& record : prepared_image_records)
+    const auto images = image_records();
+    std::vector<VaultRecords::key_type> keys_to_update;
+    for (const auto& record : *images)
     {
         if (record.second.query.query_type == Query::Type::Alias &&
             record.first.compare(0, record.second.query.release.length(), record.second.query.release) != 0)
@@ -517,39 +747,58 @@ void mp::DefaultVMImageVault::update_images(const FetchType& fetch_type, const P
         }
     }
 
+    std::vector<std::function<void()>> updates;
     for (const auto& key : keys_to_update)
+        updates.emplace_back([this, &fetch_type, &prepare, &monitor, key, record = images->at(key)] {
+            update_image(fetch_type, prepare, monitor, key, record);
+        });
+
+    mp::utils::run_concurrently(updates, max_concurrent_updates);
+}
+
+void mp::DefaultVMImageVault::update_image(const FetchType& fetch_type, const PrepareAction& prepare,
+                                           const ProgressMonitor& monitor, const std::string& key,
+                                           const VaultRecord& record)
+{
+    mpl::log(mpl::Level::info, category, fmt::format("Updating {} source image to latest", record.query.release));
+    try
     {
-        const auto& record = prepared_image_records[key];
-        mpl::log(mpl::Level::info, category, fmt::format("Updating {} source image to latest", record.query.release));
-        try
-        {
-            fetch_image(fetch_type, record.query, prepare, monitor, false, std::nullopt);
+        fetch_image(fetch_type, record.query, prepare, monitor, false, std::nullopt);
 
-            // Remove old image
-            std::lock_guard<decltype(fetch_mutex)> lock{fetch_mutex};
-            delete_image_dir(record.image.image_path);
-            prepared_image_records.erase(key);
-            persist_image_records();
-        }
-        catch (const CreateImageException& e)
-        {
-            mpl::log(mpl::Level::warning, category,
-                     fmt::format("Cannot update source image {}: {}", record.query.release, e.what()));
-        }
+        // Remove old image
+        const auto image_lock = image_mutex(key);
+        std::lock_guard<std::mutex> lock{*image_lock};
+        delete_image_dir(record.image.image_path);
+        update_image_records(key, [&key](VaultRecords& records) { records.erase(key); });
+    }
+    catch (const CreateImageException& e)
+    {
+        mpl::log(mpl::Level::warning, category,
+                 fmt::format("Cannot update source image {}: {}", record.query.release, e.what()));
     }
 }
 
 mp::MemorySize mp::DefaultVMImageVault::minimum_image_size_for(const std::string& id)
 {
-    auto prepared_image_entry = prepared_image_records.find(id);
-    if (prepared_image_entry != prepared_image_records.end())
+    const auto images = image_records();
+    auto prepared_image_entry = images->find(id);
+    if (prepared_image_entry != images->end())
     {
         const auto& record = prepared_image_entry->second;
+        if (record.virtual_size)
+            return *record.virtual_size;
+
+        const auto virtual_size = get_image_size(record.image.image_path);
+        update_image_records(id, [&id, &virtual_size](VaultRecords& records) {
+            if (auto entry = records.find(id); entry != records.end())
+                entry->second.virtual_size = virtual_size;
+        });
 
-        return get_image_size(record.image.image_path);
+        return virtual_size;
     }
 
-    for (const auto& instance_image_entry : instance_image_records)
+    const auto instances = instance_records();
+    for (const auto& instance_image_entry : *instances)
     {
         const auto& record = instance_image_entry.second;
 
@@ -562,9 +811,142 @@ mp::MemorySize mp::DefaultVMImageVault::minimum_image_size_for(const std::string
     throw std::runtime_error(fmt::format("Cannot determine minimum image size for id \'{}\'", id));
 }
 
+mp::VMImage mp::DefaultVMImageVault::clone(const std::string& source_name, const std::string& destination_name)
+{
+    VaultRecord record;
+    {
+        const auto instances = instance_records();
+        auto source_entry = instances->find(source_name);
+        if (source_entry == instances->end())
+            throw std::runtime_error(fmt::format("Cannot find an image for instance \"{}\"", source_name));
+        if (instances->count(destination_name))
+            throw std::runtime_error(fmt::format("There is already an image for instance \"{}\"", destination_name));
+
+        record = source_entry->second;
+    }
+
+    // Copied without holding anything up, cloning a large image should not hold up launches
+    QDir output_dir{MP_UTILS.make_dir(instances_dir, QString::fromStdString(destination_name))};
+    const auto image_path = output_dir.filePath(QFileInfo{record.image.image_path}.fileName());
+    try
+    {
+        mp::backend::clone_image(record.image.image_path, image_path);
+    }
+    catch (const std::exception&)
+    {
+        output_dir.removeRecursively();
+        throw;
+    }
+
+    record.image.image_path = image_path;
+    record.query.name = destination_name;
+    record.last_accessed = std::chrono::system_clock::now();
+
+    update_instance_records(destination_name, [&destination_name, &record](VaultRecords& records) {
+        records[destination_name] = record;
+    });
+
+    return record.image;
+}
+
+bool mp::DefaultVMImageVault::keeps_golden_images() const
+{
+    return true;
+}
+
+void mp::DefaultVMImageVault::keep_golden_image(const std::string& key, const std::string& instance_name)
+{
+    VaultRecord record;
+    {
+        const auto instances = instance_records();
+        auto entry = instances->find(instance_name);
+        if (entry == instances->end())
+            throw std::runtime_error(fmt::format("Cannot find an image for instance \"{}\"", instance_name));
+
+        record = entry->second;
+    }
+
+    const auto image_lock = image_mutex(key);
+    std::lock_guard<std::mutex> lock{*image_lock};
+    if (image_records()->count(key))
+        return;
+
+    // Kept with the other cached images, evicted and expired like them
+    const auto hash = QCryptographicHash::hash(QByteArray::fromStdString(key), QCryptographicHash::Sha256).toHex();
+    QDir golden_dir{MP_UTILS.make_dir(images_dir, QString{"golden-%1"}.arg(QString{hash.left(16)}))};
+    const auto image_path = golden_dir.filePath(QFileInfo{record.image.image_path}.fileName());
+    try
+    {
+        mp::backend::clone_image(record.image.image_path, image_path);
+    }
+    catch (const std::exception&)
+    {
+        golden_dir.removeRecursively();
+        throw;
+    }
+
+    record.image.image_path = image_path;
+    record.image.id = key;
+    record.image.aliases.clear();
+    record.query = {"", key, false, "", Query::Type::LocalFile};
+    record.last_accessed = std::chrono::system_clock::now();
+    record.virtual_size = std::nullopt;
+
+    update_image_records(key, [&key, &record](VaultRecords& records) { records[key] = record; });
+    mpl::log(mpl::Level::info, category, fmt::format("Keeping a golden image of {} for {}", instance_name, key));
+}
+
+std::optional<mp::VMImage> mp::DefaultVMImageVault::golden_image_for(const std::string& key,
+                                                                    const std::string& instance_name)
+{
+    const auto image_lock = image_mutex(key);
+    std::lock_guard<std::mutex> lock{*image_lock};
+
+    VaultRecord golden;
+    {
+        const auto images = image_records();
+        auto entry = images->find(key);
+        if (entry == images->end() || !QFile::exists(entry->second.image.image_path))
+            return std::nullopt;
+
+        golden = entry->second;
+    }
+
+    VaultRecord record;
+    {
+        const auto instances = instance_records();
+        auto entry = instances->find(instance_name);
+        if (entry == instances->end())
+            throw std::runtime_error(fmt::format("Cannot find an image for instance \"{}\"", instance_name));
+
+        record = entry->second;
+    }
+
+    // In place of what the instance was given, copy-on-write where the file system can
+    const auto image_path = record.image.image_path;
+    const auto source = QFile::encodeName(golden.image.image_path), destination = QFile::encodeName(image_path);
+    QFile::remove(image_path);
+    if (!MP_PLATFORM.clone_file(source.constData(), destination.constData()))
+        mp::backend::clone_image(golden.image.image_path, image_path);
+
+    record.image = golden.image;
+    record.image.image_path = image_path;
+    record.last_accessed = std::chrono::system_clock::now();
+
+    update_instance_records(instance_name,
+                            [&instance_name, &record](VaultRecords& records) { records[instance_name] = record; });
+    update_image_records(key, [&key, last_accessed = record.last_accessed](VaultRecords& records) {
+        if (auto entry = records.find(key); entry != records.end())
+            entry->second.last_accessed = last_accessed;
+    });
+
+    return record.image;
+}
+
 mp::VMImage mp::DefaultVMImageVault::download_and_prepare_source_image(
     const VMImageInfo& info, std::optional<VMImage>& existing_source_image, const QDir& image_dir,
-    const FetchType& fetch_type, const PrepareAction& prepare, const ProgressMonitor& monitor)
+    const FetchType& fetch_type, const PrepareAction& prepare, const ProgressMonitor& monitor,
+    const std::optional<Path>& delta_basis)
 {
     VMImage source_image;
     auto id = info.id;
@@ -586,23 +968,73 @@ mp::VMImage mp::DefaultVMImageVault::download_and_prepare_source_image(
         }
     }
 
+    // Compressed images are kept decompressed
+    const auto stored_path = mp::decoding::decoded_path_for(source_image.image_path);
+
     mp::vault::DeleteOnException image_file{source_image.image_path};
+    mp::vault::DeleteOnException stored_file{stored_path};
 
     try
     {
-        url_downloader->download_to(info.image_location, source_image.image_path, info.size, LaunchProgress::IMAGE,
-                                    monitor);
-
-        if (info.verify)
+        if (info.verify && blobs.link(id.toStdString(), stored_path))
         {
-            mpl::log(mpl::Level::debug, category, fmt::format("Verifying hash \"{}\"", id));
-            monitor(LaunchProgress::VERIFY, -1);
-            mp::vault::verify_image_download(source_image.image_path, id);
+            mpl::log(mpl::Level::debug, category, fmt::format("Using image \"{}\" already on the host", id));
+            source_image.image_path = stored_path;
         }
+        else if (mp::decoding::is_compressed(source_image.image_path))
+        {
+            // Hash and decompress as the image comes in, so the compressed image never hits the disk
+            const auto& decoded_path = stored_path;
+
+            mp::checksum::Sha256 hash;
+            const auto decoder = mp::decoding::make_stream_decoder(decoded_path);
+            url_downloader->download_chunks(
+                info.image_location,
+                [&hash, &decoder, verify = info.verify](const QByteArray& chunk) {
+                    if (verify)
+                        hash.add_data(chunk.constData(), chunk.size());
+                    decoder->decode(chunk.constData(), chunk.size());
+                },
+                [&hash, &decoder] {
+                    hash.reset();
+                    decoder->restart();
+                },
+                info.size, LaunchProgress::IMAGE, monitor);
+            decoder->finish();
+
+            if (info.verify)
+            {
+                mpl::log(mpl::Level::debug, category, fmt::format("Verifying hash \"{}\"", id));
+                monitor(LaunchProgress::VERIFY, -1);
+                if (hash.hex_digest() != id.toStdString())
+                    throw std::runtime_error("Downloaded image hash does not match");
+            }
 
-        if (source_image.image_path.endsWith(".xz"))
+            source_image.image_path = decoded_path;
+            if (info.verify)
+                blobs.add(id.toStdString(), decoded_path);
+        }
+        else if (info.verify && download_from_peers(url_downloader, blobs, info, source_image.image_path, monitor))
         {
-            source_image.image_path = mp::vault::extract_image(source_image.image_path, monitor, true);
+            blobs.add(id.toStdString(), source_image.image_path);
+        }
+        else if (info.verify && delta_basis &&
+                 mp::zsync::fetch_delta(url_downloader, info, *delta_basis, source_image.image_path, monitor))
+        {
+            blobs.add(id.toStdString(), source_image.image_path);
+        }
+        else
+        {
+            url_downloader->download_to(info.image_location, source_image.image_path, info.size,
+                                        LaunchProgress::IMAGE, monitor);
+
+            if (info.verify)
+            {
+                mpl::log(mpl::Level::debug, category, fmt::format("Verifying hash \"{}\"", id));
+                monitor(LaunchProgress::VERIFY, -1);
+                mp::vault::verify_image_download(source_image.image_path, id);
+                blobs.add(id.toStdString(), source_image.image_path);
+            }
         }
 
         auto prepared_image = prepare(source_image);
@@ -626,7 +1058,7 @@ QString mp::DefaultVMImageVault::extract_image_from(const std::string& instance_
     const auto name = QString::fromStdString(instance_name);
     const QDir output_dir{MP_UTILS.make_dir(instances_dir, name)};
     QFileInfo file_info{source_image.image_path};
-    const auto image_name = file_info.fileName().remove(".xz");
+    const auto image_name = mp::decoding::decoded_path_for(file_info.fileName());
     const auto image_path = output_dir.filePath(image_name);
 
     return mp::vault::extract_image(image_path, monitor);
@@ -646,17 +1078,6 @@ mp::VMImage mp::DefaultVMImageVault::image_instance_from(const std::string& inst
             {}};
 }
 
-std::optional<QFuture<mp::VMImage>> mp::DefaultVMImageVault::get_image_future(const std::string& id)
-{
-    auto it = in_progress_image_fetches.find(id);
-    if (it != in_progress_image_fetches.end())
-    {
-        return it->second;
-    }
-
-    return std::nullopt;
-}
-
 mp::VMImage mp::DefaultVMImageVault::finalize_image_records(const Query& query, const VMImage& prepared_image,
                                                             const std::string& id)
 {
@@ -665,24 +1086,24 @@ mp::VMImage mp::DefaultVMImageVault::finalize_image_records(const Query& query,
     if (!query.name.empty())
     {
         vm_image = image_instance_from(query.name, prepared_image);
-        instance_image_records[query.name] = {vm_image, query, std::chrono::system_clock::now()};
+        update_instance_records(query.name, [&query, &vm_image](VaultRecords& records) {
+            records[query.name] = {vm_image, query, std::chrono::system_clock::now()};
+        });
     }
 
     // Do not save the instance name for prepared images
     Query prepared_query{query};
     prepared_query.name = "";
-    prepared_image_records[id] = {prepared_image, prepared_query, std::chrono::system_clock::now()};
-
-    persist_instance_records();
-    persist_image_records();
+    update_image_records(id, [&id, &prepared_image, &prepared_query](VaultRecords& records) {
+        records[id] = {prepared_image, prepared_query, std::chrono::system_clock::now()};
+    });
 
     return vm_image;
 }
 
 namespace
 {
-template <typename T>
-void persist_records(const T& records, const QString& path)
+QJsonObject records_to_json(const mp::VaultRecords& records)
 {
     QJsonObject json_records;
     for (const auto& record : records)
@@ -690,16 +1111,83 @@ void persist_records(const T& records, const QString& path)
         auto key = QString::fromStdString(record.first);
         json_records.insert(key, record_to_json(record.second));
     }
-    mp::write_json(json_records, path);
+
+    return json_records;
 }
 } // namespace
 
-void mp::DefaultVMImageVault::persist_instance_records()
+auto mp::DefaultVMImageVault::image_records() const -> Records
+{
+    return std::atomic_load(&prepared_image_records);
+}
+
+auto mp::DefaultVMImageVault::instance_records() const -> Records
 {
-    persist_records(instance_image_records, data_dir.filePath(instance_db_name));
+    return std::atomic_load(&instance_image_records);
 }
 
-void mp::DefaultVMImageVault::persist_image_records()
+void mp::DefaultVMImageVault::update_image_records(const std::string& key,
+                                                   const std::function<void(VaultRecords&)>& change)
 {
-    persist_records(prepared_image_records, cache_dir.filePath(image_db_name));
+    update_records(prepared_image_records, image_db, key, change);
+}
+
+void mp::DefaultVMImageVault::update_instance_records(const std::string& key,
+                                                      const std::function<void(VaultRecords&)>& change)
+{
+    update_records(instance_image_records, instance_db, key, change);
+}
+
+void mp::DefaultVMImageVault::update_records(Records& records, JournaledRecords& db, const std::string& key,
+                                             const std::function<void(VaultRecords&)>& change)
+{
+    {
+        std::lock_guard<decltype(records_mutex)> lock{records_mutex};
+        auto copy = std::make_shared<VaultRecords>(*std::atomic_load(&records));
+        change(*copy);
+        std::atomic_store(&records, Records{std::move(copy)});
+    }
+
+    // Journaled as it is by now, a newer change to the same record can only have taken it further
+    std::lock_guard<decltype(persist_mutex)> lock{persist_mutex};
+    const auto latest = std::atomic_load(&records);
+    const auto record = latest->find(key);
+    db.update(QString::fromStdString(key), record == latest->end() ? QJsonValue{} : record_to_json(record->second),
+              [&latest] { return records_to_json(*latest); });
+}
+
+std::shared_ptr<std::mutex> mp::DefaultVMImageVault::image_mutex(const std::string& key)
+{
+    std::lock_guard<decltype(image_mutexes_mutex)> lock{image_mutexes_mutex};
+    for (auto it = image_mutexes.begin(); it != image_mutexes.end();)
+        it = it->second.expired() ? image_mutexes.erase(it) : std::next(it);
+
+    auto& entry = image_mutexes[key];
+    auto mutex = entry.lock();
+    if (!mutex)
+        entry = mutex = std::make_shared<std::mutex>();
+
+    return mutex;
+}
+
+// Custom images are checked for changes with a HEAD request, which need not go out again on every launch
+QDateTime mp::DefaultVMImageVault::cached_last_modified(const QUrl& image_url)
+{
+    const auto url = image_url.toString().toStdString();
+    const auto now = std::chrono::steady_clock::now();
+    {
+        std::lock_guard<decltype(last_modified_mutex)> lock{last_modified_mutex};
+        if (auto it = last_modified_cache.find(url);
+            it != last_modified_cache.end() && now - it->second.second < last_modified_ttl)
+            return it->second.first;
+    }
+
+    auto last_modified = url_downloader->last_modified(image_url);
+    if (last_modified.isValid())
+    {
+        std::lock_guard<decltype(last_modified_mutex)> lock{last_modified_mutex};
+        last_modified_cache[url] = {last_modified, now};
+    }
+
+    return last_modified;
 }
@@ -19,14 +19,20 @@
 #define MULTIPASS_DEFAULT_VM_IMAGE_VAULT_H
 
 #include <multipass/days.h>
+#include <multipass/journaled_records.h>
+#include <multipass/memory_size.h>
 #include <multipass/query.h>
 #include <multipass/vm_image.h>
 #include <multipass/vm_image_host.h>
 #include <shared/base_vm_image_vault.h>
 
+#include <QDateTime>
 #include <QDir>
-#include <QFuture>
+#include <QUrl>
 
+#include <chrono>
+#include <functional>
+#include <memory>
 #include <mutex>
 #include <optional>
 #include <unordered_map>
@@ -41,47 +47,84 @@ public:
     multipass::VMImage image;
     multipass::Query query;
     std::chrono::system_clock::time_point last_accessed;
+    std::optional<multipass::MemorySize> virtual_size{}; // cached, prepared images do not change
 };
+using VaultRecords = std::unordered_map<std::string, VaultRecord>;
 class DefaultVMImageVault final : public BaseVMImageVault
 {
 public:
+    // Blobs are kept in the vault's own cache unless there are shared_blobs
     DefaultVMImageVault(std::vector<VMImageHost*> image_host, URLDownloader* downloader, multipass::Path cache_dir_path,
-                        multipass::Path data_dir_path, multipass::days days_to_expire);
+                        multipass::Path data_dir_path, multipass::days days_to_expire,
+                        const std::optional<vault::BlobStore>& shared_blobs = std::nullopt);
     ~DefaultVMImageVault();
 
     VMImage fetch_image(const FetchType& fetch_type, const Query& query, const PrepareAction& prepare,
                         const ProgressMonitor& monitor, const bool unlock,
                         const std::optional<std::string>& checksum) override;
     void remove(const std::string& name) override;
+    void empty_trash() override;
     bool has_record_for(const std::string& name) override;
     void prune_expired_images() override;
+    void prune_to_size(const MemorySize& budget) override;
     void update_images(const FetchType& fetch_type, const PrepareAction& prepare,
                        const ProgressMonitor& monitor) override;
     MemorySize minimum_image_size_for(const std::string& id) override;
+    VMImage clone(const std::string& source_name, const std::string& destination_name) override;
+    bool keeps_golden_images() const override;
+    void keep_golden_image(const std::string& key, const std::string& instance_name) override;
+    std::optional<VMImage> golden_image_for(const std::string& key, const std::string& instance_name) override;
 
 private:
     VMImage image_instance_from(const std::string& name, const VMImage& prepared_image);
+    // An image of an older build of the same release, if there is one, lets it be fetched as a delta
     VMImage download_and_prepare_source_image(const VMImageInfo& info, std::optional<VMImage>& existing_source_image,
                                               const QDir& image_dir, const FetchType& fetch_type,
-                                              const PrepareAction& prepare, const ProgressMonitor& monitor);
+                                              const PrepareAction& prepare, const ProgressMonitor& monitor,
+                                              const std::optional<Path>& delta_basis = std::nullopt);
     QString extract_image_from(const std::string& instance_name, const VMImage& source_image,
                                const ProgressMonitor& monitor);
-    std::optional<QFuture<VMImage>> get_image_future(const std::string& id);
     VMImage finalize_image_records(const Query& query, const VMImage& prepared_image, const std::string& id);
-    void persist_image_records();
-    void persist_instance_records();
+    // To the latest of its release, once fetched the one it replaces is removed
+    void update_image(const FetchType& fetch_type, const PrepareAction& prepare, const ProgressMonitor& monitor,
+                      const std::string& key, const VaultRecord& record);
+    using Records = std::shared_ptr<const VaultRecords>;
+    Records image_records() const;
+    Records instance_records() const;
+    // Every change is to the one record under key, which is all that gets journaled
+    void update_image_records(const std::string& key, const std::function<void(VaultRecords&)>& change);
+    void update_instance_records(const std::string& key, const std::function<void(VaultRecords&)>& change);
+    void update_records(Records& records, JournaledRecords& db, const std::string& key,
+                        const std::function<void(VaultRecords&)>& change);
+    std::shared_ptr<std::mutex> image_mutex(const std::string& key);
+    QDateTime cached_last_modified(const QUrl& image_url);
 
     URLDownloader* const url_downloader;
     const QDir cache_dir;
     const QDir data_dir;
     const QDir instances_dir;
     const QDir images_dir;
+    const QDir trash_dir; // where removed instance images wait to be deleted, on the same file system
+    const vault::BlobStore blobs;
     const days days_to_expire;
-    std::mutex fetch_mutex;
 
-    std::unordered_map<std::string, VaultRecord> prepared_image_records;
-    std::unordered_map<std::string, VaultRecord> instance_image_records;
-    std::unordered_map<std::string, QFuture<VMImage>> in_progress_image_fetches;
+    // Published whole, so that lookups take no lock: changes copy the records under records_mutex and swap them in,
+    // to be journaled after, under persist_mutex
+    Records prepared_image_records;
+    Records instance_image_records;
+    JournaledRecords image_db;
+    JournaledRecords instance_db;
+    std::mutex records_mutex;
+    std::mutex persist_mutex;
+
+    // Held while an image is looked up and fetched or removed, so that only work on the same image is serialized
+    std::mutex image_mutexes_mutex;
+    std::unordered_map<std::string, std::weak_ptr<std::mutex>> image_mutexes;
+
+    std::mutex trash_mutex;
+
+    std::mutex last_modified_mutex;
+    std::unordered_map<std::string, std::pair<QDateTime, std::chrono::steady_clock::time_point>> last_modified_cache;
 };
 } // namespace multipass
 #endif // MULTIPASS_DEFAULT_VM_IMAGE_VAULT_H
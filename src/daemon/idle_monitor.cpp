@@ -0,0 +1,62 @@
+/*
+ * Copyright (C) Canonical, Ltd.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; version 3.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#include "idle_monitor.h"
+
+namespace mp = multipass;
+
+namespace
+{
+// An idle guest still keeps time and answers the odd packet, anything past this is someone using it
+constexpr auto busy_cpu_share = 0.05;                  // of one host CPU
+constexpr auto busy_network_bytes_per_second = 1024.0; // either way, SSH sessions and mounts included
+} // namespace
+
+bool mp::IdleMonitor::idle_for(const std::string& name, const VirtualMachine::HostStats& stats,
+                               std::chrono::minutes limit, Clock::time_point now)
+{
+    const auto network_bytes = stats.network_received_bytes + stats.network_sent_bytes;
+    const auto [it, first] = samples.try_emplace(name, Sample{stats.cpu_time_ns, network_bytes, now, now});
+    auto& sample = it->second;
+    if (first)
+        return false;
+
+    const auto elapsed = std::chrono::duration<double>(now - sample.taken).count();
+    // Counters go back to 0 when the instance boots again
+    const auto cpu = stats.cpu_time_ns >= sample.cpu_time_ns ? stats.cpu_time_ns - sample.cpu_time_ns : 0;
+    const auto network = network_bytes >= sample.network_bytes ? network_bytes - sample.network_bytes : 0;
+
+    if (cpu / 1e9 > busy_cpu_share * elapsed || network > busy_network_bytes_per_second * elapsed)
+        sample.idle_since = now;
+
+    sample.cpu_time_ns = stats.cpu_time_ns;
+    sample.network_bytes = network_bytes;
+    sample.taken = now;
+
+    return now - sample.idle_since >= limit;
+}
+
+void mp::IdleMonitor::touch(const std::string& name, Clock::time_point now)
+{
+    if (auto it = samples.find(name); it != samples.end())
+        it->second.idle_since = now;
+}
+
+void mp::IdleMonitor::forget(const std::string& name)
+{
+    samples.erase(name);
+}
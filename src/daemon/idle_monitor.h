@@ -0,0 +1,54 @@
+/*
+ * Copyright (C) Canonical, Ltd.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; version 3.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#ifndef MULTIPASS_IDLE_MONITOR_H
+#define MULTIPASS_IDLE_MONITOR_H
+
+#include <multipass/virtual_machine.h>
+
+#include <chrono>
+#include <cstdint>
+#include <string>
+#include <unordered_map>
+
+namespace multipass
+{
+// Tells instances that have sat idle from what the host sees them use between samples, for them to be suspended
+class IdleMonitor
+{
+public:
+    using Clock = std::chrono::steady_clock;
+
+    // Whether the instance has been idle for so long, as of these stats. Busy instances start the count over.
+    bool idle_for(const std::string& name, const VirtualMachine::HostStats& stats, std::chrono::minutes limit,
+                  Clock::time_point now = Clock::now());
+    void touch(const std::string& name, Clock::time_point now = Clock::now()); // someone is using it
+    void forget(const std::string& name);
+
+private:
+    struct Sample
+    {
+        std::uint64_t cpu_time_ns;
+        std::uint64_t network_bytes;
+        Clock::time_point taken;
+        Clock::time_point idle_since;
+    };
+
+    std::unordered_map<std::string, Sample> samples;
+};
+} // namespace multipass
+#endif // MULTIPASS_IDLE_MONITOR_H
@@ -0,0 +1,155 @@
+/*
+ * Copyright (C) Canonical, Ltd.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; version 3.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#include "image_share_server.h"
+
+#include <multipass/format.h>
+#include <multipass/logging/log.h>
+
+#include <QFile>
+#include <QTcpSocket>
+#include <QTimer>
+
+#include <stdexcept>
+
+namespace mp = multipass;
+namespace mpl = multipass::logging;
+
+namespace
+{
+constexpr auto category = "image share";
+constexpr auto max_request_size = 8192;
+constexpr auto chunk_size = 1 << 20;
+constexpr auto images_path = "/images/";
+constexpr auto max_connections = 16;
+constexpr auto idle_timeout_ms = 30000; // without anything read or written
+
+void respond(QTcpSocket* socket, const QByteArray& status, qint64 content_length = 0)
+{
+    socket->write("HTTP/1.1 " + status + "\r\nContent-Length: " + QByteArray::number(content_length) +
+                  "\r\nConnection: close\r\n\r\n");
+}
+} // namespace
+
+mp::ImageShareServer::ImageShareServer(const vault::BlobStore& blobs, const QHostAddress& address, quint16 port)
+    : blobs{blobs}
+{
+    QObject::connect(&server, &QTcpServer::newConnection, [this] {
+        while (auto socket = server.nextPendingConnection())
+            accept(socket);
+    });
+
+    const auto where = fmt::format("{}:{}", address.toString().toStdString(), port);
+    if (!server.listen(address, port))
+        throw std::runtime_error(
+            fmt::format("Cannot share images on {}: {}", where, server.errorString().toStdString()));
+
+    mpl::log(mpl::Level::info, category, fmt::format("Sharing images on {}", where));
+}
+
+void mp::ImageShareServer::accept(QTcpSocket* socket)
+{
+    QObject::connect(socket, &QTcpSocket::disconnected, socket, &QObject::deleteLater);
+
+    if (connections >= max_connections)
+    {
+        mpl::log(mpl::Level::debug, category,
+                 fmt::format("Turning {} away, {} connections are open already",
+                             socket->peerAddress().toString().toStdString(), connections));
+        respond(socket, "503 Service Unavailable");
+        socket->disconnectFromHost();
+        return;
+    }
+
+    ++connections;
+    QObject::connect(socket, &QTcpSocket::disconnected, [this] { --connections; });
+
+    // Peers that stop reading, or never send a whole request, don't get to hold a connection
+    auto idle_timer = new QTimer{socket};
+    idle_timer->setSingleShot(true);
+    idle_timer->setInterval(idle_timeout_ms);
+    QObject::connect(idle_timer, &QTimer::timeout, socket, &QTcpSocket::abort);
+    QObject::connect(socket, &QTcpSocket::readyRead, idle_timer, qOverload<>(&QTimer::start));
+    QObject::connect(socket, &QTcpSocket::bytesWritten, idle_timer, qOverload<>(&QTimer::start));
+    idle_timer->start();
+
+    QObject::connect(socket, &QTcpSocket::readyRead, socket, [this, socket] { serve(socket); });
+}
+
+void mp::ImageShareServer::serve(QTcpSocket* socket)
+{
+    // Whatever comes after the request is of no interest
+    if (socket->property("answered").toBool())
+    {
+        socket->readAll();
+        return;
+    }
+
+    const auto request = socket->peek(max_request_size);
+    const auto headers_end = request.indexOf("\r\n\r\n");
+    if (headers_end < 0 && request.size() < max_request_size)
+        return;
+
+    socket->setProperty("answered", true);
+    socket->readAll();
+
+    const auto request_line = request.left(request.indexOf("\r\n")).split(' ');
+    const auto method = request_line.value(0);
+    const auto target = request_line.value(1);
+
+    if (headers_end < 0)
+        respond(socket, "431 Request Header Fields Too Large");
+    else if (method != "GET" && method != "HEAD")
+        respond(socket, "405 Method Not Allowed");
+    else if (auto blob = blobs.path_for(target.mid(qstrlen(images_path)).toStdString());
+             !target.startsWith(images_path) || blob.isEmpty() || !QFile::exists(blob))
+        respond(socket, "404 Not Found");
+    else
+    {
+        auto file = new QFile{blob, socket};
+        if (!file->open(QIODevice::ReadOnly))
+        {
+            respond(socket, "500 Internal Server Error");
+            socket->disconnectFromHost();
+            return;
+        }
+
+        mpl::log(mpl::Level::debug, category,
+                 fmt::format("Sending {} to {}", target.toStdString(), socket->peerAddress().toString().toStdString()));
+        respond(socket, "200 OK", file->size());
+
+        if (method == "GET")
+        {
+            // Images are large, they go out a chunk at a time as the socket drains
+            auto send_more = [socket, file] {
+                if (socket->bytesToWrite() >= chunk_size)
+                    return;
+
+                if (file->atEnd())
+                    socket->disconnectFromHost();
+                else
+                    socket->write(file->read(chunk_size));
+            };
+
+            QObject::connect(socket, &QTcpSocket::bytesWritten, file, send_more);
+            send_more();
+            return;
+        }
+    }
+
+    socket->disconnectFromHost();
+}
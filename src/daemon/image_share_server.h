@@ -0,0 +1,48 @@
+/*
+ * Copyright (C) Canonical, Ltd.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; version 3.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#ifndef MULTIPASS_IMAGE_SHARE_SERVER_H
+#define MULTIPASS_IMAGE_SHARE_SERVER_H
+
+#include <multipass/disabled_copy_move.h>
+#include <multipass/vm_image_vault.h>
+
+#include <QHostAddress>
+#include <QTcpServer>
+
+class QTcpSocket;
+
+namespace multipass
+{
+// Serves the images in a blob store to other hosts on the network, the blob for <hash> as GET /images/<hash>, so that
+// they need not fetch them from the remote. Listens on the one address it is given, closes connections that go idle
+// and turns new ones away while it is busy with enough. Works in the event loop of the thread it was made on.
+class ImageShareServer : private DisabledCopyMove
+{
+public:
+    ImageShareServer(const vault::BlobStore& blobs, const QHostAddress& address, quint16 port);
+
+private:
+    void accept(QTcpSocket* socket);
+    void serve(QTcpSocket* socket);
+
+    const vault::BlobStore blobs;
+    int connections{0}; // before the server, which closes the ones left as it goes
+    QTcpServer server;
+};
+} // namespace multipass
+#endif // MULTIPASS_IMAGE_SHARE_SERVER_H
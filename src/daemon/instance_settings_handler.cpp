@@ -19,10 +19,16 @@
 
 #include <multipass/constants.h>
 #include <multipass/exceptions/invalid_memory_size_exception.h>
+#include <multipass/format.h>
+#include <multipass/settings/bool_setting_spec.h>
 
 #include <QRegularExpression>
 #include <QStringList>
 
+#include <algorithm>
+#include <map>
+#include <vector>
+
 namespace mp = multipass;
 
 namespace
@@ -30,6 +36,20 @@ namespace
 constexpr auto cpus_suffix = "cpus";
 constexpr auto mem_suffix = "memory";
 constexpr auto disk_suffix = "disk";
+constexpr auto disk_profile_suffix = "disk-profile";
+constexpr auto hugepages_suffix = "hugepages";
+constexpr auto cpu_pinning_suffix = "cpu-pinning";
+constexpr auto fast_boot_suffix = "fast-boot";
+constexpr auto network_limit_suffix = "network-limit";
+constexpr auto disk_iops_suffix = "disk-iops";
+constexpr auto cpu_weight_suffix = "cpu-weight";
+constexpr auto io_weight_suffix = "io-weight";
+constexpr auto memory_limit_suffix = "memory-limit";
+constexpr auto idle_suspend_suffix = "idle-suspend";
+constexpr auto interactive_suffix = "interactive";
+constexpr auto no_limit = "none";
+constexpr auto default_weight = "default";
+constexpr auto max_weight = 10000;
 
 enum class Operation
 {
@@ -46,7 +66,12 @@ QRegularExpression make_key_regex()
 {
     const auto instance_pattern = QStringLiteral("(?<instance>.+)");
     const auto prop_template = QStringLiteral("(?<property>%1)");
-    const auto either_prop = QStringList{cpus_suffix, mem_suffix, disk_suffix}.join("|");
+    const auto either_prop =
+        QStringList{cpus_suffix,       mem_suffix,          disk_profile_suffix, disk_suffix,
+                    hugepages_suffix,  cpu_pinning_suffix,  fast_boot_suffix,    network_limit_suffix,
+                    disk_iops_suffix,  idle_suspend_suffix, interactive_suffix,  cpu_weight_suffix,
+                    io_weight_suffix,  memory_limit_suffix}
+            .join("|");
     const auto prop_pattern = prop_template.arg(either_prop);
 
     const auto key_template = QStringLiteral(R"(%1\.%2\.%3)");
@@ -91,9 +116,19 @@ pick_instance(InstanceMap& instances, const std::string& instance_name, Operatio
     }
 }
 
-void check_state_for_update(mp::VirtualMachine& instance)
+void check_state_for_update(mp::VirtualMachine& instance, const std::string& property)
 {
+    if (property == idle_suspend_suffix || property == interactive_suffix)
+        return; // up to the daemon, whatever the instance is doing
+
     auto st = instance.current_state();
+    if (st == mp::VirtualMachine::State::running && (property == cpus_suffix || property == mem_suffix) &&
+        instance.hotpluggable())
+        return; // grown in place
+
+    if (st == mp::VirtualMachine::State::running && property == disk_suffix && instance.online_disk_resize())
+        return; // likewise
+
     if (st != mp::VirtualMachine::State::stopped && st != mp::VirtualMachine::State::off)
         throw mp::InstanceSettingsException{operation_msg(Operation::Modify), instance.vm_name,
                                             "Instance must be stopped for modification"};
@@ -115,44 +150,240 @@ mp::MemorySize get_memory_size(const QString& key, const QString& val)
     }
 }
 
-void update_cpus(const QString& key, const QString& val, mp::VirtualMachine& instance, mp::VMSpecs& spec)
+// Changes to running instances go through the backend, which may turn them down
+template <typename Update>
+void apply_update(mp::VirtualMachine& instance, Update&& update)
+try
+{
+    update();
+}
+catch (const std::runtime_error& e)
+{
+    throw mp::InstanceSettingsException{operation_msg(Operation::Modify), instance.vm_name, e.what()};
+}
+
+int checked_cpus(const QString& key, const QString& val)
 {
     bool converted_ok = false;
-    if (auto cpus = val.toInt(&converted_ok); !converted_ok || cpus < std::stoi(mp::min_cpu_cores))
+    const auto cpus = val.toInt(&converted_ok);
+    if (!converted_ok || cpus < std::stoi(mp::min_cpu_cores))
         throw mp::InvalidSettingException{
             key, val, QString("Need a positive integer (in decimal format) of minimum %1").arg(mp::min_cpu_cores)};
-    else if (cpus != spec.num_cores) // NOOP if equal
+
+    return cpus;
+}
+
+void update_cpus(const QString& key, const QString& val, mp::VirtualMachine& instance, mp::VMSpecs& spec)
+{
+    if (auto cpus = checked_cpus(key, val); cpus != spec.num_cores) // NOOP if equal
     {
-        instance.update_cpus(cpus);
+        apply_update(instance, [&instance, cpus] { instance.update_cpus(cpus); });
         spec.num_cores = cpus;
     }
 }
 
-void update_mem(const QString& key, const QString& val, mp::VirtualMachine& instance, mp::VMSpecs& spec,
-                const mp::MemorySize& size)
+void check_mem(const QString& key, const QString& val, const mp::MemorySize& size)
 {
     if (size < mp::MemorySize{mp::min_memory_size})
         throw mp::InvalidSettingException{key, val,
                                           QString("Memory less than %1 minimum not allowed").arg(mp::min_memory_size)};
-    else if (size != spec.mem_size) // NOOP if equal
+}
+
+void update_mem(const QString& key, const QString& val, mp::VirtualMachine& instance, mp::VMSpecs& spec,
+                const mp::MemorySize& size)
+{
+    check_mem(key, val, size);
+    if (size != spec.mem_size) // NOOP if equal
     {
-        instance.resize_memory(size);
+        apply_update(instance, [&instance, &size] { instance.resize_memory(size); });
         spec.mem_size = size;
     }
 }
 
-void update_disk(const QString& key, const QString& val, mp::VirtualMachine& instance, mp::VMSpecs& spec,
-                 const mp::MemorySize& size)
+void check_disk(const QString& key, const QString& val, const mp::VMSpecs& spec, const mp::MemorySize& size)
 {
     if (size < spec.disk_space)
         throw mp::InvalidSettingException{key, val, "Disk can only be expanded"};
-    else if (size > spec.disk_space) // NOOP if equal
+}
+
+void update_disk(const QString& key, const QString& val, mp::VirtualMachine& instance, mp::VMSpecs& spec,
+                 const mp::MemorySize& size)
+{
+    check_disk(key, val, spec, size);
+    if (size > spec.disk_space) // NOOP if equal
     {
-        instance.resize_disk(size);
+        apply_update(instance, [&instance, &size] { instance.resize_disk(size); });
         spec.disk_space = size;
     }
 }
 
+void check_disk_profile(const QString& key, const QString& val, mp::VirtualMachine& instance)
+{
+    const auto profiles = instance.disk_profiles();
+    if (std::find(profiles.cbegin(), profiles.cend(), val.toStdString()) == profiles.cend())
+    {
+        const auto choices = fmt::format("{}", fmt::join(profiles.cbegin(), profiles.cend(), ", "));
+        throw mp::InvalidSettingException{key, val, QString("Need one of: %1").arg(choices.c_str())};
+    }
+}
+
+void update_disk_profile(const QString& key, const QString& val, mp::VirtualMachine& instance)
+{
+    check_disk_profile(key, val, instance);
+    if (val.toStdString() != instance.disk_profile()) // NOOP if equal
+        instance.set_disk_profile(val.toStdString());
+}
+
+bool checked_bool(const QString& key, const QString& val)
+{
+    return mp::BoolSettingSpec{key, "false"}.interpret(val) == "true";
+}
+
+void update_hugepages(const QString& key, const QString& val, mp::VirtualMachine& instance)
+{
+    const auto enabled = checked_bool(key, val);
+    if (enabled != instance.hugepages()) // NOOP if equal
+        apply_update(instance, [&instance, enabled] { instance.set_hugepages(enabled); });
+}
+
+void update_cpu_pinning(const QString& key, const QString& val, mp::VirtualMachine& instance)
+try
+{
+    if (val.toStdString() != instance.cpu_pinning()) // NOOP if equal
+        apply_update(instance, [&instance, &val] { instance.set_cpu_pinning(val.toStdString()); });
+}
+catch (const std::invalid_argument& e)
+{
+    throw mp::InvalidSettingException{key, val, e.what()};
+}
+
+void update_fast_boot(const QString& key, const QString& val, mp::VirtualMachine& instance)
+{
+    const auto enabled = checked_bool(key, val);
+    if (enabled != instance.fast_boot()) // NOOP if equal
+        apply_update(instance, [&instance, enabled] { instance.set_fast_boot(enabled); });
+}
+
+QString limit_to_string(int limit)
+{
+    return limit ? QString::number(limit) : no_limit;
+}
+
+int checked_limit(const QString& key, const QString& val)
+{
+    bool converted_ok = val == no_limit;
+    const auto limit = converted_ok ? 0 : val.toInt(&converted_ok);
+    if (!converted_ok || limit < 0)
+        throw mp::InvalidSettingException{key, val, QString{"Need \"%1\" or a positive integer"}.arg(no_limit)};
+
+    return limit;
+}
+
+template <typename Setter>
+void update_limit(const QString& key, const QString& val, mp::VirtualMachine& instance, int current, Setter&& set)
+{
+    if (const auto limit = checked_limit(key, val); limit != current) // NOOP if equal
+        apply_update(instance, [&set, limit] { set(limit); });
+}
+
+QString weight_to_string(int weight)
+{
+    return weight ? QString::number(weight) : default_weight;
+}
+
+int checked_weight(const QString& key, const QString& val)
+{
+    bool converted_ok = val == default_weight;
+    const auto weight = converted_ok ? 0 : val.toInt(&converted_ok);
+    if (!converted_ok || (val != default_weight && (weight < 1 || weight > max_weight)))
+        throw mp::InvalidSettingException{
+            key, val, QString{"Need \"%1\" or an integer from 1 to %2"}.arg(default_weight).arg(max_weight)};
+
+    return weight;
+}
+
+template <typename Setter>
+void update_weight(const QString& key, const QString& val, mp::VirtualMachine& instance, int current, Setter&& set)
+{
+    if (const auto weight = checked_weight(key, val); weight != current) // NOOP if equal
+        apply_update(instance, [&set, weight] { set(weight); });
+}
+
+void update_memory_limit(const QString& key, const QString& val, mp::VirtualMachine& instance)
+try
+{
+    if (val.toStdString() != instance.memory_limit()) // NOOP if equal
+        apply_update(instance, [&instance, &val] { instance.set_memory_limit(val.toStdString()); });
+}
+catch (const std::invalid_argument& e)
+{
+    throw mp::InvalidSettingException{key, val, e.what()};
+}
+
+// What can be told before changing anything, the rest is up to the backend as each change is applied
+void check_value(const QString& key, const std::string& property, const QString& val, mp::VirtualMachine& instance,
+                 const mp::VMSpecs& spec)
+{
+    if (property == cpus_suffix)
+        checked_cpus(key, val);
+    else if (property == disk_profile_suffix)
+        check_disk_profile(key, val, instance);
+    else if (property == hugepages_suffix || property == fast_boot_suffix || property == interactive_suffix)
+        checked_bool(key, val);
+    else if (property == network_limit_suffix || property == disk_iops_suffix || property == idle_suspend_suffix)
+        checked_limit(key, val);
+    else if (property == cpu_weight_suffix || property == io_weight_suffix)
+        checked_weight(key, val);
+    else if (property == mem_suffix)
+        check_mem(key, val, get_memory_size(key, val));
+    else if (property == disk_suffix)
+        check_disk(key, val, spec, get_memory_size(key, val));
+}
+
+void apply_value(const QString& key, const std::string& property, const QString& val, mp::VirtualMachine& instance,
+                 mp::VMSpecs& spec)
+{
+    if (property == cpus_suffix)
+        update_cpus(key, val, instance, spec);
+    else if (property == disk_profile_suffix)
+        update_disk_profile(key, val, instance);
+    else if (property == hugepages_suffix)
+        update_hugepages(key, val, instance);
+    else if (property == cpu_pinning_suffix)
+        update_cpu_pinning(key, val, instance);
+    else if (property == fast_boot_suffix)
+        update_fast_boot(key, val, instance);
+    else if (property == network_limit_suffix)
+        update_limit(key, val, instance, instance.network_limit(),
+                     [&instance](int limit) { instance.set_network_limit(limit); });
+    else if (property == disk_iops_suffix)
+        update_limit(key, val, instance, instance.disk_iops_limit(),
+                     [&instance](int limit) { instance.set_disk_iops_limit(limit); });
+    else if (property == cpu_weight_suffix)
+        update_weight(key, val, instance, instance.cpu_weight(),
+                      [&instance](int weight) { instance.set_cpu_weight(weight); });
+    else if (property == io_weight_suffix)
+        update_weight(key, val, instance, instance.io_weight(),
+                      [&instance](int weight) { instance.set_io_weight(weight); });
+    else if (property == memory_limit_suffix)
+        update_memory_limit(key, val, instance);
+    else if (property == idle_suspend_suffix)
+        spec.idle_suspend = checked_limit(key, val);
+    else if (property == interactive_suffix)
+        spec.interactive = checked_bool(key, val);
+    else
+    {
+        auto size = get_memory_size(key, val);
+        if (property == mem_suffix)
+            update_mem(key, val, instance, spec, size);
+        else
+        {
+            assert(property == disk_suffix);
+            update_disk(key, val, instance, spec, size);
+        }
+    }
+}
+
 } // namespace
 
 mp::InstanceSettingsException::InstanceSettingsException(const std::string& reason, const std::string& instance,
@@ -180,8 +411,12 @@ std::set<QString> mp::InstanceSettingsHandler::keys() const
 
     std::set<QString> ret;
     for (const auto& item : vm_instance_specs)
-        for (const auto& suffix : {cpus_suffix, mem_suffix, disk_suffix})
-            ret.insert(key_template.arg(item.first.c_str()).arg(suffix));
+        if (!item.second.warm) // not anyone's yet
+            for (const auto& suffix :
+                 {cpus_suffix, mem_suffix, disk_suffix, disk_profile_suffix, hugepages_suffix, cpu_pinning_suffix,
+                  fast_boot_suffix, network_limit_suffix, disk_iops_suffix, idle_suspend_suffix, interactive_suffix,
+                  cpu_weight_suffix, io_weight_suffix, memory_limit_suffix})
+                ret.insert(key_template.arg(item.first.c_str()).arg(suffix));
 
     return ret;
 }
@@ -197,6 +432,29 @@ QString mp::InstanceSettingsHandler::get(const QString& key) const
         return QString::fromStdString(spec.mem_size.human_readable()); /* TODO return in bytes when --raw
                                                                           (need unmarshall capability, w/ flag) */
 
+    if (property == disk_profile_suffix)
+        return QString::fromStdString(find_instance(instance_name).disk_profile());
+    if (property == hugepages_suffix)
+        return find_instance(instance_name).hugepages() ? "true" : "false";
+    if (property == cpu_pinning_suffix)
+        return QString::fromStdString(find_instance(instance_name).cpu_pinning());
+    if (property == fast_boot_suffix)
+        return find_instance(instance_name).fast_boot() ? "true" : "false";
+    if (property == network_limit_suffix)
+        return limit_to_string(find_instance(instance_name).network_limit());
+    if (property == disk_iops_suffix)
+        return limit_to_string(find_instance(instance_name).disk_iops_limit());
+    if (property == cpu_weight_suffix)
+        return weight_to_string(find_instance(instance_name).cpu_weight());
+    if (property == io_weight_suffix)
+        return weight_to_string(find_instance(instance_name).io_weight());
+    if (property == memory_limit_suffix)
+        return QString::fromStdString(find_instance(instance_name).memory_limit());
+    if (property == idle_suspend_suffix)
+        return limit_to_string(spec.idle_suspend);
+    if (property == interactive_suffix)
+        return spec.interactive ? "true" : "false";
+
     assert(property == disk_suffix);
     return QString::fromStdString(spec.disk_space.human_readable()); // TODO idem
 }
@@ -210,23 +468,71 @@ void mp::InstanceSettingsHandler::set(const QString& key, const QString& val)
 
     auto& instance = modify_instance(instance_name); // we need this first, to refuse updating deleted instances
     auto& spec = modify_spec(instance_name);
-    check_state_for_update(instance);
+    check_state_for_update(instance, property);
 
-    if (property == cpus_suffix)
-        update_cpus(key, val, instance, spec);
-    else
+    apply_value(key, property, val, instance, spec);
+    instance_persister();
+}
+
+void mp::InstanceSettingsHandler::set_values(const std::map<QString, QString>& values)
+{
+    struct Update
     {
-        auto size = get_memory_size(key, val);
-        if (property == mem_suffix)
-            update_mem(key, val, instance, spec, size);
-        else
+        QString key;
+        std::string property;
+        QString val;
+    };
+
+    std::map<std::string, std::vector<Update>> updates; // by instance
+    for (const auto& [key, val] : values)
+    {
+        try
         {
-            assert(property == disk_suffix);
-            update_disk(key, val, instance, spec, size);
+            auto [instance_name, property] = parse_key(key);
+            updates[instance_name].push_back(Update{key, std::move(property), val});
+        }
+        catch (const UnrecognizedSettingException&)
+        {
+            continue; // for other handlers
         }
     }
 
-    instance_persister();
+    if (updates.empty())
+        return;
+
+    // Everything that can be checked is, for all instances, before anything is changed
+    for (const auto& [instance_name, instance_updates] : updates)
+    {
+        if (preparing_instances.find(instance_name) != preparing_instances.end())
+            throw InstanceSettingsException{operation_msg(Operation::Modify), instance_name,
+                                            "Instance is being prepared"};
+
+        auto& instance = modify_instance(instance_name);
+        const auto& spec = modify_spec(instance_name);
+        for (const auto& update : instance_updates)
+        {
+            check_state_for_update(instance, update.property);
+            check_value(update.key, update.property, update.val, instance, spec);
+        }
+    }
+
+    try
+    {
+        for (const auto& [instance_name, instance_updates] : updates)
+        {
+            auto& instance = modify_instance(instance_name);
+            auto& spec = modify_spec(instance_name);
+            for (const auto& update : instance_updates)
+                apply_value(update.key, update.property, update.val, instance, spec);
+        }
+    }
+    catch (...)
+    {
+        instance_persister(); // what the backend took before turning something down
+        throw;
+    }
+
+    instance_persister(); // once, for all of them
 }
 
 auto mp::InstanceSettingsHandler::modify_instance(const std::string& instance_name) -> VirtualMachine&
@@ -237,6 +543,16 @@ auto mp::InstanceSettingsHandler::modify_instance(const std::string& instance_na
     return *ret;
 }
 
+auto mp::InstanceSettingsHandler::find_instance(const std::string& instance_name) const -> VirtualMachine&
+{
+    auto it = deleted_instances.find(instance_name);
+    auto ret =
+        it != deleted_instances.end() ? it->second : pick_instance(vm_instances, instance_name, Operation::Obtain);
+
+    assert(ret && "can't have null instance");
+    return *ret;
+}
+
 auto mp::InstanceSettingsHandler::modify_spec(const std::string& instance_name) -> VMSpecs&
 {
     return pick_instance(vm_instance_specs, instance_name, Operation::Modify);
@@ -46,11 +46,13 @@ public:
     std::set<QString> keys() const override;
     QString get(const QString& key) const override;
     void set(const QString& key, const QString& val) override;
+    void set_values(const std::map<QString, QString>& values) override; // all checked first, then persisted once
 
 private:
     VirtualMachine& modify_instance(const std::string& instance_name);
     VMSpecs& modify_spec(const std::string& instance_name);
     const VMSpecs& find_spec(const std::string& instance_name) const;
+    VirtualMachine& find_instance(const std::string& instance_name) const; // deleted ones too
 
 private:
     // references, careful
@@ -0,0 +1,286 @@
+/*
+ * Copyright (C) Canonical, Ltd.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; version 3.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+#include "port_forwarder.h"
+
+#include <multipass/format.h>
+#include <multipass/logging/log.h>
+
+#include <QTcpServer>
+
+#include <arpa/inet.h>
+#include <fcntl.h>
+#include <netinet/in.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include <array>
+#include <cerrno>
+#include <cstring>
+#include <functional>
+#include <stdexcept>
+#include <thread>
+#include <utility>
+
+namespace mp = multipass;
+namespace mpl = multipass::logging;
+
+namespace
+{
+constexpr auto category = "port forward";
+
+// As much as a pipe holds by default
+constexpr std::size_t splice_chunk_size = 64 * 1024;
+
+// Connections relayed at once by each forward, a thread each; those beyond are turned away
+constexpr std::size_t max_relays = 64;
+
+int connect_to(const std::string& address, quint16 port)
+{
+    sockaddr_in target{};
+    target.sin_family = AF_INET;
+    target.sin_port = htons(port);
+    if (inet_pton(AF_INET, address.c_str(), &target.sin_addr) != 1)
+        throw std::runtime_error(fmt::format("\"{}\" is not an IPv4 address", address));
+
+    const auto fd = socket(AF_INET, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    if (fd < 0)
+        throw std::runtime_error(fmt::format("cannot open a socket: {}", std::strerror(errno)));
+
+    if (connect(fd, reinterpret_cast<const sockaddr*>(&target), sizeof(target)) < 0)
+    {
+        const auto error = errno;
+        close(fd);
+        throw std::runtime_error(fmt::format("cannot connect to {}:{}: {}", address, port, std::strerror(error)));
+    }
+
+    return fd;
+}
+
+// One way of a connection: from a socket into a pipe, and from the pipe into the other socket
+struct SpliceDirection
+{
+    SpliceDirection(int from, int to) : from{from}, to{to}
+    {
+        if (pipe2(pipe_fds.data(), O_CLOEXEC | O_NONBLOCK) < 0)
+            throw std::runtime_error(fmt::format("cannot make a pipe: {}", std::strerror(errno)));
+    }
+
+    ~SpliceDirection()
+    {
+        close(pipe_fds[0]);
+        close(pipe_fds[1]);
+    }
+
+    bool wants_to_read() const
+    {
+        return !eof && in_pipe < splice_chunk_size;
+    }
+
+    bool finished() const
+    {
+        return eof && in_pipe == 0;
+    }
+
+    // Moves what it can without waiting, false on errors, e.g. when either end went away
+    bool move_on()
+    {
+        if (wants_to_read())
+        {
+            const auto spliced = splice(from, nullptr, pipe_fds[1], nullptr, splice_chunk_size - in_pipe,
+                                        SPLICE_F_MOVE | SPLICE_F_NONBLOCK);
+            if (spliced == 0)
+                eof = true;
+            else if (spliced > 0)
+                in_pipe += spliced;
+            else if (errno != EAGAIN)
+                return false;
+        }
+
+        if (in_pipe > 0)
+        {
+            const auto spliced =
+                splice(pipe_fds[0], nullptr, to, nullptr, in_pipe, SPLICE_F_MOVE | SPLICE_F_NONBLOCK);
+            if (spliced > 0)
+                in_pipe -= spliced;
+            else if (spliced < 0 && errno != EAGAIN)
+                return false;
+        }
+
+        // Passed on, so that the other end sees the end too while answers can still come back
+        if (finished() && !write_shut)
+        {
+            shutdown(to, SHUT_WR);
+            write_shut = true;
+        }
+
+        return true;
+    }
+
+    const int from;
+    const int to;
+    std::array<int, 2> pipe_fds{};
+    std::size_t in_pipe{0};
+    bool eof{false};
+    bool write_shut{false};
+};
+
+void splice_both_ways(int one, int other)
+{
+    for (const auto fd : {one, other})
+        fcntl(fd, F_SETFL, fcntl(fd, F_GETFL) | O_NONBLOCK);
+
+    SpliceDirection there{one, other}, back{other, one};
+    while (there.move_on() && back.move_on())
+    {
+        if (there.finished() && back.finished())
+            return;
+
+        const auto events_on = [](const SpliceDirection& reading, const SpliceDirection& writing) {
+            return static_cast<short>((reading.wants_to_read() ? POLLIN : 0) | (writing.in_pipe ? POLLOUT : 0));
+        };
+        std::array<pollfd, 2> fds{pollfd{one, events_on(there, back), 0}, pollfd{other, events_on(back, there), 0}};
+
+        // Sockets with nothing to wait for are left out, one that hung up would otherwise keep poll from waiting
+        for (auto& fd : fds)
+            if (!fd.events)
+                fd.fd = -1;
+
+        if (poll(fds.data(), fds.size(), -1) < 0 && errno != EINTR)
+            return;
+    }
+}
+} // namespace
+
+class mp::PortForwarder::Listener : public QTcpServer
+{
+public:
+    explicit Listener(PortForwarder& forwarder) : forwarder{forwarder}
+    {
+    }
+
+protected:
+    void incomingConnection(qintptr fd) override
+    {
+        forwarder.relay(fd);
+    }
+
+private:
+    PortForwarder& forwarder;
+};
+
+struct mp::PortForwarder::Relay
+{
+    int client_fd;
+    int instance_fd{-1};
+    bool done{false};
+    std::thread thread{};
+};
+
+mp::PortForwarder::PortForwarder(quint16 host_port, AddressLookup instance_address, quint16 instance_port)
+    : instance_address{std::move(instance_address)},
+      instance_port{instance_port},
+      listener{std::make_unique<Listener>(*this)}
+{
+    // Only for this host, whoever else is meant to get in can be let through with their own means
+    if (!listener->listen(QHostAddress::LocalHost, host_port))
+        throw std::runtime_error(
+            fmt::format("cannot listen on port {}: {}", host_port, listener->errorString().toStdString()));
+}
+
+mp::PortForwarder::~PortForwarder()
+{
+    listener.reset();
+
+    {
+        std::lock_guard<std::mutex> lock{mutex};
+        stopping = true;
+        for (const auto& relay : relays)
+            for (const auto fd : {relay.client_fd, relay.instance_fd})
+                if (fd >= 0)
+                    shutdown(fd, SHUT_RDWR);
+    }
+
+    for (auto& relay : relays)
+        if (relay.thread.joinable())
+            relay.thread.join();
+}
+
+quint16 mp::PortForwarder::host_port() const
+{
+    return listener->serverPort();
+}
+
+void mp::PortForwarder::relay(qintptr client_fd)
+{
+    // Looked up here, on the thread the forward was made on, which is where the instance is looked after
+    std::string address;
+    try
+    {
+        address = instance_address();
+    }
+    catch (const std::exception& e)
+    {
+        mpl::log(mpl::Level::warning, category, fmt::format("Cannot forward a connection: {}", e.what()));
+        close(static_cast<int>(client_fd));
+        return;
+    }
+
+    std::lock_guard<std::mutex> lock{mutex};
+    relays.remove_if([](Relay& relay) {
+        if (!relay.done)
+            return false;
+
+        relay.thread.join();
+        return true;
+    });
+
+    if (relays.size() >= max_relays)
+    {
+        mpl::log(mpl::Level::warning, category,
+                 fmt::format("Cannot forward a connection: {} are being relayed already", max_relays));
+        close(static_cast<int>(client_fd));
+        return;
+    }
+
+    auto& relay = relays.emplace_back(Relay{static_cast<int>(client_fd)});
+    relay.thread = std::thread{[this, &relay, address = std::move(address)] {
+        try
+        {
+            const auto instance_fd = connect_to(address, instance_port);
+            bool stopped;
+            {
+                std::lock_guard<std::mutex> lock{mutex};
+                relay.instance_fd = instance_fd;
+                stopped = stopping;
+            }
+
+            if (!stopped)
+                splice_both_ways(relay.client_fd, instance_fd);
+        }
+        catch (const std::exception& e)
+        {
+            mpl::log(mpl::Level::warning, category, fmt::format("Cannot forward a connection: {}", e.what()));
+        }
+
+        std::lock_guard<std::mutex> lock{mutex};
+        for (auto& fd : {std::ref(relay.client_fd), std::ref(relay.instance_fd)})
+            if (fd >= 0)
+                close(std::exchange(fd.get(), -1));
+        relay.done = true;
+    }};
+}
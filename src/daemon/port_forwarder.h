@@ -0,0 +1,62 @@
+/*
+ * Copyright (C) Canonical, Ltd.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; version 3.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+#ifndef MULTIPASS_PORT_FORWARDER_H
+#define MULTIPASS_PORT_FORWARDER_H
+
+#include <multipass/disabled_copy_move.h>
+
+#include <QtGlobal>
+
+#include <functional>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <string>
+
+namespace multipass
+{
+// Relays connections to a port on the host's loopback to a port of an instance. Listens in the event loop of the
+// thread it was made on. Each connection is then relayed on a thread of its own with splice(2), so that what goes
+// through is moved between the sockets by the kernel rather than copied in and out of the daemon. Up to a bounded
+// number at once. Linux only, as splice(2) is.
+class PortForwarder : private DisabledCopyMove
+{
+public:
+    // Of the instance, anew for each connection as it may change, and always on the thread the forwarder was made on
+    using AddressLookup = std::function<std::string()>;
+
+    PortForwarder(quint16 host_port, AddressLookup instance_address, quint16 instance_port);
+    ~PortForwarder();
+
+    quint16 host_port() const;
+
+private:
+    class Listener;
+    struct Relay;
+
+    void relay(qintptr client_fd);
+
+    const AddressLookup instance_address;
+    const quint16 instance_port;
+    std::unique_ptr<Listener> listener;
+
+    std::mutex mutex;
+    std::list<Relay> relays; // those still going are shut down along with the forward, finished ones let go of
+    bool stopping{false}; // under the mutex, like the relays
+};
+} // namespace multipass
+#endif // MULTIPASS_PORT_FORWARDER_H
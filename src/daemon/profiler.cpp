@@ -0,0 +1,99 @@
+/*
+ * Copyright (C) Canonical, Ltd.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; version 3.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#include "profiler.h"
+
+#include <multipass/format.h>
+#include <multipass/logging/log.h>
+
+#include <QDateTime>
+#include <QDir>
+
+#include <cstdio>
+
+#if MULTIPASS_PROFILER_GPERFTOOLS
+#include <gperftools/heap-profiler.h>
+#include <gperftools/profiler.h>
+#elif MULTIPASS_PROFILER_JEMALLOC
+#include <jemalloc/jemalloc.h>
+#elif defined(__GLIBC__)
+#include <malloc.h>
+#endif
+
+namespace mp = multipass;
+namespace mpl = multipass::logging;
+
+namespace
+{
+constexpr auto category = "profiler";
+} // namespace
+
+mp::daemon::ProfileCapture::ProfileCapture(const QString& directory)
+    : prefix{QDir{directory}.filePath(QDateTime::currentDateTimeUtc().toString("yyyyMMdd-HHmmss"))}
+{
+    if (!QDir{}.mkpath(directory))
+        mpl::log(mpl::Level::warning, category, fmt::format("Could not create {}", directory));
+
+#if MULTIPASS_PROFILER_GPERFTOOLS
+    ProfilerStart((prefix + ".cpu.prof").toStdString().c_str());
+    HeapProfilerStart(prefix.toStdString().c_str());
+#endif
+}
+
+mp::daemon::ProfileCapture::~ProfileCapture()
+{
+    finish();
+}
+
+std::vector<QString> mp::daemon::ProfileCapture::finish()
+{
+    if (finished)
+        return {};
+
+    finished = true;
+    std::vector<QString> files;
+
+#if MULTIPASS_PROFILER_GPERFTOOLS
+    ProfilerStop();
+    files.push_back(prefix + ".cpu.prof");
+
+    // Numbered by gperftools, as it dumps
+    HeapProfilerDump("capture finished");
+    HeapProfilerStop();
+    files.push_back(prefix + ".*.heap");
+#elif MULTIPASS_PROFILER_JEMALLOC
+    const auto path = (prefix + ".heap").toStdString();
+    auto path_data = path.c_str();
+    if (mallctl("prof.dump", nullptr, nullptr, &path_data, sizeof(path_data)) == 0)
+        files.push_back(QString::fromStdString(path));
+    else
+        mpl::log(mpl::Level::warning, category, "No heap profile, jemalloc needs MALLOC_CONF=prof:true for them");
+#elif defined(__GLIBC__)
+    // No CPU profile without a profiler built in, but glibc can still tell how the heap is doing
+    const auto path = prefix + ".malloc_info.xml";
+    if (auto file = std::fopen(path.toStdString().c_str(), "w"))
+    {
+        const auto ret = malloc_info(0, file);
+        if (std::fclose(file) == 0 && ret == 0)
+            files.push_back(path);
+    }
+#else
+    mpl::log(mpl::Level::warning, category, "Nothing to profile with, build with MULTIPASS_PROFILER set");
+#endif
+
+    return files;
+}
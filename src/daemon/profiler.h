@@ -0,0 +1,46 @@
+/*
+ * Copyright (C) Canonical, Ltd.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; version 3.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#ifndef MULTIPASS_DAEMON_PROFILER_H
+#define MULTIPASS_DAEMON_PROFILER_H
+
+#include <multipass/disabled_copy_move.h>
+
+#include <QString>
+
+#include <vector>
+
+namespace multipass::daemon
+{
+// Profiles the running daemon from construction until finished, with whatever the build has for it: CPU and heap
+// profiles with MULTIPASS_PROFILER=gperftools, heap profiles with =jemalloc (when started with MALLOC_CONF=prof:true)
+// and glibc's heap statistics otherwise. The files are named after when the capture started, in the given directory.
+class ProfileCapture : private DisabledCopyMove
+{
+public:
+    explicit ProfileCapture(const QString& directory);
+    ~ProfileCapture();
+
+    std::vector<QString> finish(); // the files written, nothing the second time
+
+private:
+    const QString prefix;
+    bool finished{false};
+};
+} // namespace multipass::daemon
+
+#endif // MULTIPASS_DAEMON_PROFILER_H
@@ -0,0 +1,69 @@
+/*
+ * Copyright (C) Canonical, Ltd.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; version 3.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#include "resource_accountant.h"
+
+#include <multipass/format.h>
+#include <multipass/utils.h>
+
+#include <string>
+
+namespace mp = multipass;
+
+mp::ResourceAccountant::ResourceAccountant(const platform::HostCapacity& capacity, const OvercommitRatios& ratios)
+    : capacity{capacity}, ratios{ratios}
+{
+}
+
+std::optional<std::string> mp::ResourceAccountant::refusal(const std::unordered_map<std::string, VMSpecs>& instances,
+                                                           int cpus, const MemorySize& memory,
+                                                           const MemorySize& disk) const
+{
+    long long committed_cpus = cpus, committed_memory = memory.in_bytes(), committed_disk = disk.in_bytes();
+    for (const auto& [name, specs] : instances)
+    {
+        const auto booting = specs.state == VirtualMachine::State::starting ||
+                             specs.state == VirtualMachine::State::restarting;
+        if (!specs.deleted && (booting || mp::utils::is_running(specs.state)))
+        {
+            committed_cpus += specs.num_cores;
+            committed_memory += specs.mem_size.in_bytes();
+        }
+
+        committed_disk += specs.disk_space.in_bytes();
+    }
+
+    auto exceeds = [](long long committed, long long available, double ratio) {
+        return ratio > 0 && available > 0 && committed > available * ratio;
+    };
+
+    auto bytes = [](double bytes) {
+        return MemorySize{std::to_string(static_cast<long long>(bytes))}.human_readable();
+    };
+
+    if (exceeds(committed_cpus, capacity.cpus, ratios.cpus))
+        return fmt::format("{} vCPUs would be committed, past the {} that {} host CPUs allow", committed_cpus,
+                           static_cast<long long>(capacity.cpus * ratios.cpus), capacity.cpus);
+    if (exceeds(committed_memory, capacity.memory, ratios.memory))
+        return fmt::format("{} of memory would be committed, past the {} that {} on the host allow",
+                           bytes(committed_memory), bytes(capacity.memory * ratios.memory), bytes(capacity.memory));
+    if (exceeds(committed_disk, capacity.disk, ratios.disk))
+        return fmt::format("{} of disk would be committed, past the {} that {} of storage allow", bytes(committed_disk),
+                           bytes(capacity.disk * ratios.disk), bytes(capacity.disk));
+
+    return std::nullopt;
+}
@@ -0,0 +1,56 @@
+/*
+ * Copyright (C) Canonical, Ltd.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; version 3.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#ifndef MULTIPASS_RESOURCE_ACCOUNTANT_H
+#define MULTIPASS_RESOURCE_ACCOUNTANT_H
+
+#include "vm_specs.h"
+
+#include <multipass/memory_size.h>
+#include <multipass/platform.h>
+
+#include <optional>
+#include <string>
+#include <unordered_map>
+
+namespace multipass
+{
+// How many times what the host has instances may be committed, 0 leaving that resource unchecked
+struct OvercommitRatios
+{
+    double cpus{0};
+    double memory{0};
+    double disk{0};
+};
+
+// Adds up what instances are committed to against what the host has, for launches not to take it past the ratios.
+// vCPUs and memory count while instances boot or run, disk for as long as they are kept, deleted or not.
+class ResourceAccountant
+{
+public:
+    ResourceAccountant(const platform::HostCapacity& capacity, const OvercommitRatios& ratios);
+
+    // Why a new running instance with these would not fit next to the others, nothing when it would
+    std::optional<std::string> refusal(const std::unordered_map<std::string, VMSpecs>& instances, int cpus,
+                                       const MemorySize& memory, const MemorySize& disk) const;
+
+private:
+    const platform::HostCapacity capacity;
+    const OvercommitRatios ratios;
+};
+} // namespace multipass
+#endif // MULTIPASS_RESOURCE_ACCOUNTANT_H
@@ -18,6 +18,7 @@
 #include "ubuntu_image_host.h"
 
 #include <multipass/constants.h>
+#include <multipass/format.h>
 #include <multipass/platform.h>
 #include <multipass/query.h>
 #include <multipass/settings/settings.h>
@@ -29,26 +30,251 @@
 #include <multipass/exceptions/unsupported_image_exception.h>
 #include <multipass/exceptions/unsupported_remote_exception.h>
 
+#include <multipass/logging/log.h>
+
+#include <QCryptographicHash>
+#include <QDir>
+#include <QFile>
 #include <QJsonDocument>
 #include <QJsonObject>
 #include <QUrl>
 
 #include <algorithm>
-#include <unordered_set>
+#include <chrono>
+#include <future>
+#include <optional>
 
 namespace mp = multipass;
+namespace mpl = multipass::logging;
 
 namespace
 {
 constexpr auto index_path = "streams/v1/index.json";
 
-auto download_manifest(const QString& host_url, mp::URLDownloader* url_downloader)
+constexpr auto category = "ubuntu image host";
+
+struct CachedManifest
+{
+    QByteArray bytes;
+    mp::URLDownloader::Validators validators;
+};
+
+struct ManifestBytes
+{
+    QByteArray bytes;
+    mp::URLDownloader::Validators validators;
+    bool changed;
+};
+
+// Manifests are kept on disk along with their validators, so that a server can tell they are still current
+QString cached_manifest_path(const QString& cache_dir, const QUrl& manifest_url)
+{
+    const auto hash = QCryptographicHash::hash(manifest_url.toEncoded(), QCryptographicHash::Sha256).toHex();
+    return QDir{cache_dir}.filePath(QString::fromLatin1(hash) + ".json");
+}
+
+CachedManifest load_cached_manifest(const QString& cache_dir, const QUrl& manifest_url)
+{
+    if (cache_dir.isEmpty())
+        return {};
+
+    const auto path = cached_manifest_path(cache_dir, manifest_url);
+    QFile manifest_file{path}, validators_file{path + ".validators"};
+    if (!manifest_file.open(QIODevice::ReadOnly) || !validators_file.open(QIODevice::ReadOnly))
+        return {};
+
+    const auto validators = QJsonDocument::fromJson(validators_file.readAll()).object();
+    if (validators["url"].toString() != manifest_url.toString())
+        return {};
+
+    return {manifest_file.readAll(),
+            {validators["etag"].toString().toUtf8(), validators["last_modified"].toString().toUtf8()}};
+}
+
+void save_cached_manifest(const QString& cache_dir, const QUrl& manifest_url, const QByteArray& bytes,
+                          const mp::URLDownloader::Validators& validators)
+{
+    if (cache_dir.isEmpty())
+        return;
+
+    // Without validators there is nothing to ask the server with, the manifest is just downloaded again
+    const auto path = cached_manifest_path(cache_dir, manifest_url);
+    QFile::remove(path + ".validators");
+    if (validators.etag.isEmpty() && validators.last_modified.isEmpty())
+    {
+        QFile::remove(path);
+        return;
+    }
+
+    QFile manifest_file{path}, validators_file{path + ".validators"};
+    if (!manifest_file.open(QIODevice::WriteOnly | QIODevice::Truncate) || manifest_file.write(bytes) != bytes.size())
+        return;
+
+    if (validators_file.open(QIODevice::WriteOnly | QIODevice::Truncate))
+        validators_file.write(QJsonDocument{QJsonObject{{"url", manifest_url.toString()},
+                                                        {"etag", QString::fromUtf8(validators.etag)},
+                                                        {"last_modified", QString::fromUtf8(validators.last_modified)}}}
+                                  .toJson());
+}
+
+ManifestBytes download_manifest(const QString& host_url, mp::URLDownloader* url_downloader, const QString& cache_dir)
 {
     auto json_index = url_downloader->download({host_url + index_path});
     auto index = mp::SimpleStreamsIndex::fromJson(json_index);
 
-    auto json_manifest = url_downloader->download({host_url + index.manifest_path});
-    return json_manifest;
+    const QUrl manifest_url{host_url + index.manifest_path};
+    auto cached = load_cached_manifest(cache_dir, manifest_url);
+
+    std::optional<QByteArray> json_manifest;
+    try
+    {
+        json_manifest = url_downloader->download_if_changed(manifest_url, cached.validators);
+    }
+    catch (const mp::DownloadException& e)
+    {
+        if (cached.bytes.isEmpty())
+            throw;
+
+        mpl::log(mpl::Level::warning, category,
+                 fmt::format("Error getting {}: {} - using cached manifest.", manifest_url.toString(), e.what()));
+    }
+
+    if (!json_manifest)
+        return {cached.bytes, cached.validators, false};
+
+    save_cached_manifest(cache_dir, manifest_url, *json_manifest, cached.validators);
+    return {*json_manifest, cached.validators, true};
+}
+
+// Snapshots go by what the manifests they were taken from are known by, so that nothing needs parsing to tell
+// whether one is current. Nothing to go by without validators.
+QByteArray snapshot_key_for(const QString& host_url, const ManifestBytes& official,
+                            const std::optional<ManifestBytes>& mirrored)
+{
+    QByteArray key;
+    for (const auto* manifest : {&official, mirrored ? &*mirrored : nullptr})
+    {
+        if (!manifest)
+            continue;
+        if (manifest->validators.etag.isEmpty() && manifest->validators.last_modified.isEmpty())
+            return {};
+        key += manifest->validators.etag + '\n' + manifest->validators.last_modified + '\n';
+    }
+
+    return key + host_url.toUtf8();
+}
+
+QString snapshot_path(const QString& cache_dir, const std::string& remote_name)
+{
+    return QDir{cache_dir}.filePath(QString::fromStdString(remote_name) + ".snapshot");
+}
+
+std::unique_ptr<mp::SimpleStreamsManifest> load_snapshot(const QString& cache_dir, const std::string& remote_name,
+                                                         const QByteArray& key)
+{
+    QFile file{snapshot_path(cache_dir, remote_name)};
+    if (cache_dir.isEmpty() || key.isEmpty() || !file.open(QIODevice::ReadOnly))
+        return nullptr;
+
+    const auto contents = file.readAll();
+    if (!contents.startsWith(key + '\0'))
+        return nullptr;
+
+    return mp::SimpleStreamsManifest::fromSnapshot(contents.mid(key.size() + 1));
+}
+
+void save_snapshot(const QString& cache_dir, const std::string& remote_name, const QByteArray& key,
+                   const mp::SimpleStreamsManifest& manifest)
+{
+    QFile file{snapshot_path(cache_dir, remote_name)};
+    if (cache_dir.isEmpty() || key.isEmpty())
+        file.remove();
+    else if (file.open(QIODevice::WriteOnly | QIODevice::Truncate))
+        file.write(key + '\0' + manifest.toSnapshot());
+}
+
+// Mirrors are ranked by how long they take to serve their index, a small file, which accounts for both latency and
+// throughput. Those that fail are left out. With none left, the first one stays, so that its error shows.
+std::optional<QString> fastest_mirror(const std::vector<QString>& mirror_sites, mp::URLDownloader* url_downloader)
+{
+    if (mirror_sites.size() < 2)
+        return mirror_sites.empty() ? std::nullopt : std::make_optional(mirror_sites.front());
+
+    using Probe = std::optional<std::chrono::steady_clock::duration>;
+    std::vector<std::future<Probe>> probes;
+    for (const auto& mirror_site : mirror_sites)
+        probes.push_back(std::async(std::launch::async, [url_downloader, &mirror_site]() -> Probe {
+            // Conditional downloads skip the network cache, which would make any mirror look fast
+            mp::URLDownloader::Validators validators;
+            const auto start = std::chrono::steady_clock::now();
+            try
+            {
+                url_downloader->download_if_changed({mirror_site + index_path}, validators);
+                return std::chrono::steady_clock::now() - start;
+            }
+            catch (const mp::DownloadException& e)
+            {
+                mpl::log(mpl::Level::debug, category,
+                         fmt::format("Mirror {} did not respond: {}", mirror_site, e.what()));
+                return std::nullopt;
+            }
+        }));
+
+    auto fastest = mirror_sites.front();
+    Probe fastest_time;
+    for (std::size_t i = 0; i < probes.size(); ++i)
+    {
+        if (const auto time = probes[i].get(); time && (!fastest_time || *time < *fastest_time))
+        {
+            fastest = mirror_sites[i];
+            fastest_time = time;
+        }
+    }
+
+    mpl::log(mpl::Level::debug, category, fmt::format("Using mirror {}", fastest));
+    return fastest;
+}
+
+struct FetchedManifest
+{
+    std::unique_ptr<mp::SimpleStreamsManifest> manifest;
+    std::optional<QString> mirror_site;
+};
+
+// The official manifest and, if there is one, the fastest mirror's, fetched side by side. Gives no manifest when
+// neither changed and there is a manifest already, which then stays as it is rather than being parsed again.
+// Otherwise, unchanged manifests come from their snapshot if there is one.
+FetchedManifest fetch_manifest(const std::string& remote_name, const QString& official_site,
+                               const std::vector<QString>& mirror_sites, mp::URLDownloader* url_downloader,
+                               const QString& cache_dir, bool have_manifest)
+{
+    const auto mirror_site = fastest_mirror(mirror_sites, url_downloader);
+
+    std::optional<std::future<ManifestBytes>> manifest_from_mirror;
+    if (mirror_site)
+        manifest_from_mirror = std::async(std::launch::async,
+                                          [&] { return download_manifest(*mirror_site, url_downloader, cache_dir); });
+
+    const auto manifest_from_official = download_manifest(official_site, url_downloader, cache_dir);
+    const auto mirrored = manifest_from_mirror ? std::make_optional(manifest_from_mirror->get()) : std::nullopt;
+
+    const auto host_url = mirror_site.value_or(official_site);
+    const auto snapshot_key = snapshot_key_for(host_url, manifest_from_official, mirrored);
+
+    if (!manifest_from_official.changed && !(mirrored && mirrored->changed))
+    {
+        if (have_manifest)
+            return {nullptr, mirror_site};
+
+        if (auto manifest = load_snapshot(cache_dir, remote_name, snapshot_key))
+            return {std::move(manifest), mirror_site};
+    }
+
+    auto manifest = mp::SimpleStreamsManifest::fromJson(
+        manifest_from_official.bytes, mirrored ? std::make_optional(mirrored->bytes) : std::nullopt, host_url);
+    save_snapshot(cache_dir, remote_name, snapshot_key, *manifest);
+
+    return {std::move(manifest), mirror_site};
 }
 
 mp::VMImageInfo with_location_fully_resolved(const QString& host_url, const mp::VMImageInfo& info)
@@ -66,6 +292,16 @@ mp::VMImageInfo with_location_fully_resolved(const QString& host_url, const mp::
             info.verify};
 }
 
+// The first product with any given id, like searching through them in order would find
+std::map<QString, const mp::VMImageInfo*> index_by_id(const mp::SimpleStreamsManifest& manifest)
+{
+    std::map<QString, const mp::VMImageInfo*> products_by_id;
+    for (const auto& product : manifest.products)
+        products_by_id.emplace(product.id, &product);
+
+    return products_by_id;
+}
+
 auto key_from(const std::string& search_string)
 {
     auto key = QString::fromStdString(search_string);
@@ -76,13 +312,18 @@ auto key_from(const std::string& search_string)
 } // namespace
 
 mp::UbuntuVMImageHost::UbuntuVMImageHost(std::vector<std::pair<std::string, UbuntuVMImageRemote>> remotes,
-                                         URLDownloader* downloader, std::chrono::seconds manifest_time_to_live)
-    : CommonVMImageHost{manifest_time_to_live}, url_downloader{downloader}, remotes{std::move(remotes)}
+                                         URLDownloader* downloader, std::chrono::seconds manifest_time_to_live,
+                                         const QString& cache_dir, const QString& usage_stamp)
+    : CommonVMImageHost{manifest_time_to_live, usage_stamp},
+      url_downloader{downloader},
+      remotes{std::move(remotes)},
+      cache_dir{cache_dir}
 {
 }
 
 std::optional<mp::VMImageInfo> mp::UbuntuVMImageHost::info_for(const Query& query)
 {
+    std::lock_guard lock{manifests_mutex};
     auto images = all_info_for(query);
 
     if (images.size() == 0)
@@ -101,6 +342,7 @@ std::optional<mp::VMImageInfo> mp::UbuntuVMImageHost::info_for(const Query& quer
 
 std::vector<std::pair<std::string, mp::VMImageInfo>> mp::UbuntuVMImageHost::all_info_for(const Query& query)
 {
+    std::lock_guard lock{manifests_mutex};
     auto key = key_from(query.release);
     check_alias_is_supported(key.toStdString(), query.remote_name);
 
@@ -144,19 +386,17 @@ std::vector<std::pair<std::string, mp::VMImageInfo>> mp::UbuntuVMImageHost::all_
                 remote_name,
                 with_location_fully_resolved(QString::fromStdString(remote_url_from(remote_name)), *info)));
         }
-        else
+        else if (const auto by_id = products_by_id.find(remote_name); by_id != products_by_id.end())
         {
-            std::unordered_set<std::string> found_hashes;
-
-            for (const auto& entry : manifest->products)
+            // Ids starting with key are all next to each other, from the first one not less than key
+            for (auto it = by_id->second.lower_bound(key); it != by_id->second.end() && it->first.startsWith(key); ++it)
             {
-                if (entry.id.startsWith(key) && (entry.supported || query.allow_unsupported) &&
-                    found_hashes.find(entry.id.toStdString()) == found_hashes.end())
+                const auto& entry = *it->second;
+                if (entry.supported || query.allow_unsupported)
                 {
                     images.push_back(std::make_pair(
                         remote_name,
                         with_location_fully_resolved(QString::fromStdString(remote_url_from(remote_name)), entry)));
-                    found_hashes.insert(entry.id.toStdString());
                 }
             }
         }
@@ -167,15 +407,12 @@ std::vector<std::pair<std::string, mp::VMImageInfo>> mp::UbuntuVMImageHost::all_
 
 mp::VMImageInfo mp::UbuntuVMImageHost::info_for_full_hash_impl(const std::string& full_hash)
 {
+    const auto id = QString::fromStdString(full_hash);
     for (const auto& manifest : manifests)
     {
-        for (const auto& product : manifest.second->products)
-        {
-            if (product.id.toStdString() == full_hash)
-            {
-                return with_location_fully_resolved(QString::fromStdString(remote_url_from(manifest.first)), product);
-            }
-        }
+        const auto& by_id = products_by_id.at(manifest.first);
+        if (const auto it = by_id.find(id); it != by_id.end())
+            return with_location_fully_resolved(QString::fromStdString(remote_url_from(manifest.first)), *it->second);
     }
 
     // TODO: Throw a specific exception type here so callers can be more specific about what to catch
@@ -186,6 +423,7 @@ mp::VMImageInfo mp::UbuntuVMImageHost::info_for_full_hash_impl(const std::string
 std::vector<mp::VMImageInfo> mp::UbuntuVMImageHost::all_images_for(const std::string& remote_name,
                                                                    const bool allow_unsupported)
 {
+    std::lock_guard lock{manifests_mutex};
     std::vector<mp::VMImageInfo> images;
     auto manifest = manifest_from(remote_name);
 
@@ -230,27 +468,62 @@ std::vector<std::string> mp::UbuntuVMImageHost::supported_remotes()
     return supported_remotes;
 }
 
+std::size_t mp::UbuntuVMImageHost::memory_footprint() const
+{
+    std::lock_guard lock{manifests_mutex};
+    std::size_t bytes = 0;
+    for (const auto& [remote_name, manifest] : manifests)
+        bytes += remote_name.capacity() + manifest->memory_footprint();
+
+    return bytes;
+}
+
 void mp::UbuntuVMImageHost::fetch_manifests()
 {
+    // All remotes are fetched at the same time, so this takes as long as the slowest of them
+    std::vector<std::pair<std::string, std::future<FetchedManifest>>> fetches;
     for (const auto& [remote_name, remote_info] : remotes)
     {
         try
         {
             check_remote_is_supported(remote_name);
-            auto official_site = remote_info.get_official_url();
-            auto manifest_bytes_from_official = download_manifest(official_site, url_downloader);
+        }
+        catch (const mp::UnsupportedRemoteException&)
+        {
+            continue;
+        }
 
-            auto mirror_site = remote_info.get_mirror_url();
-            std::optional<QByteArray> manifest_bytes_from_mirror = std::nullopt;
+        const auto have_manifest =
+            std::any_of(manifests.cbegin(), manifests.cend(),
+                        [&remote_name = remote_name](const auto& element) { return element.first == remote_name; });
+        fetches.emplace_back(remote_name,
+                             std::async(std::launch::async, fetch_manifest, remote_name, remote_info.get_official_url(),
+                                        remote_info.get_mirror_urls(), url_downloader, cache_dir, have_manifest));
+    }
+
+    for (auto& [remote_name, fetch] : fetches)
+    {
+        try
+        {
+            auto [manifest, mirror_site] = fetch.get();
             if (mirror_site)
-            {
-                auto bytes = download_manifest(mirror_site.value(), url_downloader);
-                manifest_bytes_from_mirror = std::make_optional(bytes);
-            }
+                mirror_urls[remote_name] = *mirror_site;
+            else
+                mirror_urls.erase(remote_name);
 
-            auto manifest = mp::SimpleStreamsManifest::fromJson(
-                manifest_bytes_from_official, manifest_bytes_from_mirror, mirror_site.value_or(official_site));
-            manifests.emplace_back(std::make_pair(remote_name, std::move(manifest)));
+            if (!manifest)
+                continue;
+
+            products_by_id[remote_name] = index_by_id(*manifest);
+            // Until it is replaced, the previous manifest keeps serving
+            auto it = std::find_if(manifests.begin(), manifests.end(),
+                                   [&remote_name = remote_name](const auto& element) {
+                                       return element.first == remote_name;
+                                   });
+            if (it != manifests.end())
+                it->second = std::move(manifest);
+            else
+                manifests.emplace_back(std::make_pair(remote_name, std::move(manifest)));
         }
         catch (mp::EmptyManifestException& /* e */)
         {
@@ -264,18 +537,9 @@ void mp::UbuntuVMImageHost::fetch_manifests()
         {
             on_manifest_update_failure(e.what());
         }
-        catch (const mp::UnsupportedRemoteException&)
-        {
-            continue;
-        }
     }
 }
 
-void mp::UbuntuVMImageHost::clear()
-{
-    manifests.clear();
-}
-
 mp::SimpleStreamsManifest* mp::UbuntuVMImageHost::manifest_from(const std::string& remote)
 {
     check_remote_is_supported(remote);
@@ -318,7 +582,14 @@ std::string mp::UbuntuVMImageHost::remote_url_from(const std::string& remote_nam
 
     if (it != remotes.cend())
     {
-        url = it->second.get_url().toStdString();
+        // The mirror found fastest, as long as it is still among those configured
+        const auto configured = it->second.get_mirror_urls();
+        const auto chosen = mirror_urls.find(remote_name);
+        if (chosen != mirror_urls.end() &&
+            std::find(configured.cbegin(), configured.cend(), chosen->second) != configured.cend())
+            url = chosen->second.toStdString();
+        else
+            url = it->second.get_url().toStdString();
     }
 
     return url;
@@ -344,16 +615,18 @@ const QString mp::UbuntuVMImageRemote::get_official_url() const
 
 const std::optional<QString> mp::UbuntuVMImageRemote::get_mirror_url() const
 {
+    const auto mirror_urls = get_mirror_urls();
+    return mirror_urls.empty() ? std::nullopt : std::make_optional(mirror_urls.front());
+}
+
+const std::vector<QString> mp::UbuntuVMImageRemote::get_mirror_urls() const
+{
+    std::vector<QString> mirror_urls;
     if (mirror_key)
     {
-        auto mirror = MP_SETTINGS.get(mirror_key.value());
-        if (!mirror.isEmpty())
-        {
-            auto url = mirror.toStdString();
-            url.append(uri);
-            return std::make_optional(QString::fromStdString(url));
-        }
+        for (const auto& mirror : MP_SETTINGS.get(mirror_key.value()).split(',', QString::SkipEmptyParts))
+            mirror_urls.push_back(mirror.trimmed() + QString::fromStdString(uri));
     }
 
-    return std::nullopt;
+    return mirror_urls;
 }
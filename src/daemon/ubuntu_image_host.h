@@ -25,7 +25,9 @@
 
 #include <QString>
 
+#include <map>
 #include <string>
+#include <unordered_map>
 #include <utility>
 #include <vector>
 
@@ -41,27 +43,32 @@ class UbuntuVMImageHost final : public CommonVMImageHost
 {
 public:
     UbuntuVMImageHost(std::vector<std::pair<std::string, UbuntuVMImageRemote>> remotes, URLDownloader* downloader,
-                      std::chrono::seconds manifest_time_to_live);
+                      std::chrono::seconds manifest_time_to_live, const QString& cache_dir = {},
+                      const QString& usage_stamp = {});
 
     std::optional<VMImageInfo> info_for(const Query& query) override;
     std::vector<std::pair<std::string, VMImageInfo>> all_info_for(const Query& query) override;
     std::vector<VMImageInfo> all_images_for(const std::string& remote_name, const bool allow_unsupported) override;
     std::vector<std::string> supported_remotes() override;
+    std::size_t memory_footprint() const override;
 
 protected:
     void for_each_entry_do_impl(const Action& action) override;
     VMImageInfo info_for_full_hash_impl(const std::string& full_hash) override;
     void fetch_manifests() override;
-    void clear() override;
 
 private:
     SimpleStreamsManifest* manifest_from(const std::string& remote);
     const VMImageInfo* match_alias(const QString& key, const SimpleStreamsManifest& manifest) const;
     std::vector<std::pair<std::string, std::unique_ptr<SimpleStreamsManifest>>> manifests;
+    // Each remote's products by id, sorted so that partial hashes find theirs without going through them all
+    std::unordered_map<std::string, std::map<QString, const VMImageInfo*>> products_by_id;
     URLDownloader* const url_downloader;
     std::vector<std::pair<std::string, UbuntuVMImageRemote>> remotes;
+    std::unordered_map<std::string, QString> mirror_urls; // the mirror each remote was last found fastest on
     std::string remote_url_from(const std::string& remote_name);
     QString index_path;
+    const QString cache_dir; // where manifests are kept between refreshes, if anywhere
 };
 class UbuntuVMImageRemote
 {
@@ -70,6 +77,7 @@ public:
     const QString get_url() const;
     const QString get_official_url() const;
     const std::optional<QString> get_mirror_url() const;
+    const std::vector<QString> get_mirror_urls() const; // all candidates, in the order they were configured
 
 private:
     const std::string official_host;
@@ -23,15 +23,54 @@
 #include <multipass/virtual_machine.h>
 #include <multipass/vm_mount.h>
 
+#include <cstddef>
 #include <string>
 #include <tuple>
 #include <unordered_map>
 #include <vector>
 
+#include <QByteArray>
+#include <QJsonDocument>
 #include <QJsonObject>
 
 namespace multipass
 {
+// Backends' settings for an instance, held as the compact JSON they are persisted in and only parsed when asked for:
+// a parsed object takes several times the memory, and is only wanted when the instance is started or changed
+class VMMetadata
+{
+public:
+    VMMetadata() = default;
+    VMMetadata(const QJsonObject& object) // implicit, to stand in for the object it holds
+        : json{object.isEmpty() ? QByteArray{} : QJsonDocument{object}.toJson(QJsonDocument::Compact)}
+    {
+    }
+
+    QJsonObject object() const
+    {
+        return json.isEmpty() ? QJsonObject{} : QJsonDocument::fromJson(json).object();
+    }
+
+    bool isEmpty() const
+    {
+        return json.isEmpty();
+    }
+
+    std::size_t memory_footprint() const
+    {
+        return static_cast<std::size_t>(json.capacity());
+    }
+
+    // Objects keep their keys sorted, so equal objects are equal text
+    friend bool operator==(const VMMetadata& a, const VMMetadata& b)
+    {
+        return a.json == b.json;
+    }
+
+private:
+    QByteArray json;
+};
+
 struct VMSpecs
 {
     int num_cores;
@@ -43,15 +82,21 @@ struct VMSpecs
     multipass::VirtualMachine::State state;
     std::unordered_map<std::string, VMMount> mounts;
     bool deleted;
-    QJsonObject metadata;
+    VMMetadata metadata;
+    bool warm{false}; // booted ahead of time, waiting in the pool for a launch to take it
+    int idle_suspend{0}; // minutes without being used before the instance is suspended, 0 for never
+    bool interactive{false}; // someone works in it, to be resumed first when the host wakes up
+    bool idle_suspended{false}; // suspended by the daemon for sitting idle, to be resumed for whoever wants in
 };
 
 inline bool operator==(const VMSpecs& a, const VMSpecs& b)
 {
     return std::tie(a.num_cores, a.mem_size, a.disk_space, a.default_mac_address, a.extra_interfaces, a.ssh_username,
-                    a.state, a.mounts, a.deleted, a.metadata) ==
+                    a.state, a.mounts, a.deleted, a.metadata, a.warm, a.idle_suspend, a.interactive,
+                    a.idle_suspended) ==
            std::tie(b.num_cores, b.mem_size, b.disk_space, b.default_mac_address, b.extra_interfaces, b.ssh_username,
-                    b.state, b.mounts, b.deleted, b.metadata);
+                    b.state, b.mounts, b.deleted, b.metadata, b.warm, b.idle_suspend, b.interactive,
+                    b.idle_suspended);
 }
 } // namespace multipass
 
@@ -0,0 +1,348 @@
+/*
+ * Copyright (C) Canonical, Ltd.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; version 3.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#include "zsync_delta.h"
+
+#include <multipass/checksum.h>
+#include <multipass/exceptions/aborted_download_exception.h>
+#include <multipass/format.h>
+#include <multipass/logging/log.h>
+#include <multipass/logging/tracer.h>
+#include <multipass/rpc/multipass.grpc.pb.h>
+#include <multipass/url_downloader.h>
+#include <multipass/vm_image_info.h>
+#include <multipass/vm_image_vault.h>
+
+#include <QFile>
+#include <QList>
+#include <QUrl>
+
+#include <algorithm>
+#include <cstring>
+#include <map>
+#include <numeric>
+#include <stdexcept>
+#include <unordered_map>
+#include <utility>
+
+namespace mp = multipass;
+namespace mpl = multipass::logging;
+
+namespace
+{
+constexpr auto category = "zsync";
+constexpr auto control_file_suffix = ".zsync";
+constexpr qint64 max_range_size = 16 * 1024 * 1024; // what one request brings at most, it is held in memory
+constexpr qint64 max_gap_size = 64 * 1024;          // blocks the basis has that are cheaper fetched than asked around
+constexpr auto min_shared_fraction = 0.1;           // below that, a full download is not worth putting off
+
+std::uint32_t rsum_mask(int rsum_bytes)
+{
+    return rsum_bytes == 4 ? 0xffffffff : (1u << (8 * rsum_bytes)) - 1;
+}
+
+int to_int(const QByteArray& value, const char* name)
+{
+    bool ok{false};
+    const auto number = value.toInt(&ok);
+    if (!ok)
+        throw std::runtime_error(fmt::format("invalid {} \"{}\"", name, value));
+
+    return number;
+}
+
+// Blocks of the target that have the same sums, e.g. all those full of zeroes, are found all at once
+struct BlockGroup
+{
+    std::array<std::uint8_t, 16> checksum;
+    std::vector<std::size_t> blocks;
+    bool found{false};
+};
+
+// Consecutive blocks to fetch in one request, from first up to end
+struct Run
+{
+    std::size_t first;
+    std::size_t end;
+};
+
+std::vector<Run> plan_runs(const mp::zsync::ControlFile& control, const std::vector<qint64>& found)
+{
+    const auto max_gap_blocks = static_cast<std::size_t>(std::max<qint64>(1, max_gap_size / control.block_size));
+    const auto max_run_blocks = static_cast<std::size_t>(std::max<qint64>(1, max_range_size / control.block_size));
+
+    std::vector<Run> runs;
+    for (std::size_t i = 0; i < found.size(); ++i)
+    {
+        if (found[i] >= 0)
+            continue;
+
+        // Joins the last run when what is between is short enough to be fetched again rather than asked for apart
+        if (!runs.empty() && i - runs.back().end < max_gap_blocks && i + 1 - runs.back().first <= max_run_blocks)
+            runs.back().end = i + 1;
+        else
+            runs.push_back({i, i + 1});
+    }
+
+    return runs;
+}
+} // namespace
+
+mp::zsync::ControlFile mp::zsync::parse_control_file(const QByteArray& data)
+{
+    const auto header_end = data.indexOf("\n\n");
+    if (header_end < 0)
+        throw std::runtime_error("no end to the control file header");
+
+    std::map<QByteArray, QByteArray> headers;
+    for (const auto& line : data.left(header_end).split('\n'))
+    {
+        const auto colon = line.indexOf(':');
+        if (colon > 0)
+            headers[line.left(colon).trimmed()] = line.mid(colon + 1).trimmed();
+    }
+
+    if (!headers.count("zsync"))
+        throw std::runtime_error("not a zsync control file");
+
+    // Those describe a compressed file to be fetched instead, and put back together the way it was compressed
+    for (const auto& [key, value] : headers)
+        if (key.startsWith("Z-") || key == "Recompress")
+            throw std::runtime_error(fmt::format("\"{}\" is not supported", key));
+
+    ControlFile control{};
+    bool ok{false};
+    control.length = headers["Length"].toLongLong(&ok);
+    if (!ok || control.length <= 0)
+        throw std::runtime_error(fmt::format("invalid length \"{}\"", headers["Length"]));
+
+    control.block_size = to_int(headers["Blocksize"], "block size");
+    if (control.block_size <= 0 || control.block_size > 1024 * 1024)
+        throw std::runtime_error(fmt::format("unsupported block size {}", control.block_size));
+
+    const auto hash_lengths = headers["Hash-Lengths"].split(',');
+    if (hash_lengths.size() != 3)
+        throw std::runtime_error(fmt::format("invalid hash lengths \"{}\"", headers["Hash-Lengths"]));
+
+    control.seq_matches = to_int(hash_lengths[0], "sequence matches");
+    control.rsum_bytes = to_int(hash_lengths[1], "rsum length");
+    control.checksum_bytes = to_int(hash_lengths[2], "checksum length");
+    if (control.seq_matches < 1 || control.seq_matches > 2 || control.rsum_bytes < 1 || control.rsum_bytes > 4 ||
+        control.checksum_bytes < 3 || control.checksum_bytes > 16)
+        throw std::runtime_error(fmt::format("invalid hash lengths \"{}\"", headers["Hash-Lengths"]));
+
+    // Each block's rsum is kept big-endian, as many of its low bytes as it says, then the start of its MD4
+    const auto num_blocks = static_cast<std::size_t>((control.length + control.block_size - 1) / control.block_size);
+    const auto entry_size = control.rsum_bytes + control.checksum_bytes;
+    const auto sums = reinterpret_cast<const std::uint8_t*>(data.constData()) + header_end + 2;
+    if (static_cast<std::size_t>(data.size() - header_end - 2) < num_blocks * entry_size)
+        throw std::runtime_error("block sums are cut short");
+
+    control.blocks.resize(num_blocks);
+    for (std::size_t i = 0; i < num_blocks; ++i)
+    {
+        const auto entry = sums + i * entry_size;
+        auto& block = control.blocks[i];
+        for (auto j = 0; j < control.rsum_bytes; ++j)
+            block.rsum = block.rsum << 8 | entry[j];
+        std::copy(entry + control.rsum_bytes, entry + entry_size, block.checksum.begin());
+    }
+
+    return control;
+}
+
+std::uint32_t mp::zsync::rsum(const std::uint8_t* data, std::size_t size)
+{
+    std::uint16_t a{0}, b{0};
+    for (auto left = size; left; --left)
+    {
+        const auto c = *data++;
+        a += c;
+        b += left * c;
+    }
+
+    return std::uint32_t{a} << 16 | b;
+}
+
+std::vector<qint64> mp::zsync::find_blocks(const ControlFile& control, const std::uint8_t* basis, qint64 basis_size)
+{
+    std::vector<qint64> found(control.blocks.size(), -1);
+    const auto block_size = control.block_size;
+    if (basis_size < block_size)
+        return found;
+
+    std::unordered_map<std::uint32_t, std::vector<BlockGroup>> groups;
+    for (std::size_t i = 0; i < control.blocks.size(); ++i)
+    {
+        const auto& block = control.blocks[i];
+        auto& candidates = groups[block.rsum];
+        auto group = std::find_if(candidates.begin(), candidates.end(),
+                                  [&block](const auto& group) { return group.checksum == block.checksum; });
+        if (group == candidates.end())
+            group = candidates.insert(candidates.end(), BlockGroup{block.checksum, {}});
+        group->blocks.push_back(i);
+    }
+
+    // Most positions have no block with their rsum, which this tells without going through the map
+    const auto mask = rsum_mask(control.rsum_bytes);
+    const auto filter_mask = rsum_mask(std::min(control.rsum_bytes, 3));
+    std::vector<bool> filter(std::size_t{filter_mask} + 1);
+    for (const auto& [rsum, candidates] : groups)
+        filter[rsum & filter_mask] = true;
+
+    auto groups_left = std::accumulate(groups.cbegin(), groups.cend(), std::size_t{0},
+                                       [](auto sum, const auto& entry) { return sum + entry.second.size(); });
+
+    // The weak sum rolls along the basis a byte at a time, the MD4 only comes in when it matches
+    const auto sums = rsum(basis, block_size);
+    std::uint16_t a = sums >> 16, b = sums & 0xffff;
+    for (qint64 pos = 0; groups_left && pos + block_size <= basis_size;)
+    {
+        const auto key = (std::uint32_t{a} << 16 | b) & mask;
+        auto matched = false;
+        if (filter[key & filter_mask])
+        {
+            if (const auto candidates = groups.find(key); candidates != groups.end())
+            {
+                const auto checksum = checksum::md4(basis + pos, block_size);
+                for (auto& group : candidates->second)
+                {
+                    const auto checksum_end = checksum.cbegin() + control.checksum_bytes;
+                    if (group.found || !std::equal(checksum.cbegin(), checksum_end, group.checksum.cbegin()))
+                        continue;
+
+                    for (const auto i : group.blocks)
+                        found[i] = pos;
+                    group.found = matched = true;
+                    --groups_left;
+                }
+            }
+        }
+
+        if (matched)
+        {
+            pos += block_size;
+            if (pos + block_size <= basis_size)
+            {
+                const auto next = rsum(basis + pos, block_size);
+                a = next >> 16, b = next & 0xffff;
+            }
+        }
+        else if (pos + block_size < basis_size)
+        {
+            const std::uint8_t out = basis[pos], in = basis[pos + block_size];
+            a += in - out;
+            b += a - block_size * out;
+            ++pos;
+        }
+        else
+        {
+            break;
+        }
+    }
+
+    return found;
+}
+
+bool mp::zsync::fetch_delta(URLDownloader* downloader, const VMImageInfo& info, const Path& basis_path,
+                            const Path& image_path, const ProgressMonitor& monitor)
+{
+    mpl::TraceSpan span{"fetch_delta", info.image_location.toStdString()};
+    const QUrl image_url{info.image_location};
+
+    try
+    {
+        const auto control = parse_control_file(downloader->download(QUrl{info.image_location + control_file_suffix}));
+
+        QFile basis{basis_path};
+        if (!basis.open(QIODevice::ReadOnly))
+            throw std::runtime_error(fmt::format("cannot open {}", basis_path));
+
+        const auto basis_data = basis.size() > 0 ? basis.map(0, basis.size()) : nullptr;
+        if (!basis_data)
+            throw std::runtime_error(fmt::format("cannot map {}", basis_path));
+
+        monitor(LaunchProgress::IMAGE, 0);
+        const auto found = find_blocks(control, basis_data, basis.size());
+        const auto runs = plan_runs(control, found);
+
+        auto bytes_of = [&control](std::size_t first, std::size_t end) {
+            return std::min<qint64>(end * control.block_size, control.length) - first * control.block_size;
+        };
+        qint64 to_fetch{0};
+        for (const auto& run : runs)
+            to_fetch += bytes_of(run.first, run.end);
+
+        if (control.length - to_fetch < min_shared_fraction * control.length)
+            throw std::runtime_error(fmt::format("{} has too little in common with it", basis_path));
+
+        QFile image{image_path};
+        if (!image.open(QIODevice::WriteOnly | QIODevice::Truncate))
+            throw std::runtime_error(fmt::format("cannot open {} for writing", image_path));
+
+        auto write = [&image](const char* data, qint64 size) {
+            if (image.write(data, size) != size)
+                throw std::runtime_error(fmt::format("error writing image: {}", image.errorString()));
+        };
+
+        // Front to back, so that nothing has to be seeked: blocks from the basis up to each run, then the run
+        qint64 fetched{0};
+        auto last_progress = -1;
+        std::size_t next{0};
+        auto copy_up_to = [&](std::size_t end) {
+            for (; next < end; ++next)
+                write(reinterpret_cast<const char*>(basis_data) + found[next], bytes_of(next, next + 1));
+        };
+
+        for (const auto& run : runs)
+        {
+            copy_up_to(run.first);
+
+            const auto size = bytes_of(run.first, run.end);
+            write(downloader->download_range(image_url, run.first * control.block_size, size).constData(), size);
+            next = run.end;
+
+            fetched += size;
+            const int progress = 100 * fetched / to_fetch;
+            if (progress != last_progress && !monitor(LaunchProgress::IMAGE, progress))
+                throw AbortedDownloadException{"Download aborted"};
+            last_progress = progress;
+        }
+        copy_up_to(found.size());
+        image.close();
+
+        monitor(LaunchProgress::VERIFY, -1);
+        vault::verify_image_download(image_path, info.id);
+
+        mpl::log(mpl::Level::info, category,
+                 fmt::format("Rebuilt {} from {}, fetching {} of its {} bytes", image_path, basis_path, to_fetch,
+                             control.length));
+        return true;
+    }
+    catch (const AbortedDownloadException&)
+    {
+        QFile::remove(image_path);
+        throw;
+    }
+    catch (const std::exception& e)
+    {
+        mpl::log(mpl::Level::debug, category,
+                 fmt::format("Cannot fetch {} as a delta: {}", image_url.toString(), e.what()));
+        QFile::remove(image_path);
+        return false;
+    }
+}
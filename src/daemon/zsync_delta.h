@@ -0,0 +1,71 @@
+/*
+ * Copyright (C) Canonical, Ltd.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; version 3.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#ifndef MULTIPASS_ZSYNC_DELTA_H
+#define MULTIPASS_ZSYNC_DELTA_H
+
+#include <multipass/path.h>
+#include <multipass/progress_monitor.h>
+
+#include <QByteArray>
+#include <QtGlobal>
+
+#include <array>
+#include <cstdint>
+#include <vector>
+
+namespace multipass
+{
+class URLDownloader;
+class VMImageInfo;
+
+// Rebuilds images from an older one that shares most of their blocks, as told by the zsync control file published
+// next to them, fetching only the blocks the older one does not have
+namespace zsync
+{
+struct BlockSum
+{
+    std::uint32_t rsum; // only as many low bytes as the control file keeps
+    std::array<std::uint8_t, 16> checksum;
+};
+
+struct ControlFile
+{
+    qint64 length;
+    qint64 block_size;
+    int seq_matches; // how many blocks in a row have to match for any of them to count
+    int rsum_bytes;
+    int checksum_bytes;
+    std::vector<BlockSum> blocks;
+};
+
+// Throws std::runtime_error on anything this cannot rebuild from, e.g. files zsync would recompress
+ControlFile parse_control_file(const QByteArray& data);
+
+// Weak checksum of a whole block, zero padding left to the caller
+std::uint32_t rsum(const std::uint8_t* data, std::size_t size);
+
+// For every block of the target, where basis has it, -1 where it does not
+std::vector<qint64> find_blocks(const ControlFile& control, const std::uint8_t* basis, qint64 basis_size);
+
+// Rebuilds info's image at image_path from basis when its control file can be had, verifying the result against
+// info.id. Gives false, leaving nothing behind, when that does not work out for a full download to take over.
+bool fetch_delta(URLDownloader* downloader, const VMImageInfo& info, const Path& basis, const Path& image_path,
+                 const ProgressMonitor& monitor);
+} // namespace zsync
+} // namespace multipass
+#endif // MULTIPASS_ZSYNC_DELTA_H
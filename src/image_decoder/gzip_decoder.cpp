@@ -0,0 +1,110 @@
+/*
+ * Copyright (C) Canonical, Ltd.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; version 3.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#include "gzip_decoder.h"
+
+#include <multipass/format.h>
+#include <multipass/sparse_file.h>
+
+#include <stdexcept>
+
+namespace mp = multipass;
+
+namespace
+{
+constexpr auto out_size = 1u << 20;
+constexpr auto gzip_window_bits = 16 + MAX_WBITS; // gzip headers rather than zlib's
+} // namespace
+
+mp::GzipStreamDecoder::GzipStreamDecoder(const Path& decoded_file_path)
+    : decoded_file{decoded_file_path}, out_buffer(out_size)
+{
+    if (inflateInit2(&stream, gzip_window_bits) != Z_OK)
+        throw std::runtime_error("gzip decoder initialization failed");
+
+    if (!decoded_file.open(QIODevice::WriteOnly | QIODevice::Truncate))
+    {
+        inflateEnd(&stream);
+        throw std::runtime_error(fmt::format("failed to open {} for writing", decoded_file.fileName()));
+    }
+}
+
+mp::GzipStreamDecoder::~GzipStreamDecoder()
+{
+    inflateEnd(&stream);
+}
+
+void mp::GzipStreamDecoder::decode(const char* data, std::size_t size)
+{
+    stream.next_in = reinterpret_cast<Bytef*>(const_cast<char*>(data));
+    stream.avail_in = size;
+
+    // Output that did not fit comes out on the next round, even with no input left
+    do
+    {
+        // Another member follows the one that ended
+        if (ended && stream.avail_in > 0)
+        {
+            inflateReset(&stream);
+            ended = false;
+        }
+
+        stream.next_out = out_buffer.data();
+        stream.avail_out = out_buffer.size();
+
+        switch (inflate(&stream, Z_NO_FLUSH))
+        {
+        case Z_OK:
+        case Z_BUF_ERROR: // nothing could be done with what was left, more is needed
+            break;
+        case Z_STREAM_END:
+            ended = true;
+            break;
+        case Z_MEM_ERROR:
+            throw std::runtime_error("gzip decoder memory allocation failed");
+        default:
+            throw std::runtime_error(
+                fmt::format("gzip file is corrupt: {}", stream.msg ? stream.msg : "unknown error"));
+        }
+
+        flush(out_buffer.size() - stream.avail_out);
+    } while (stream.avail_in > 0 || stream.avail_out == 0);
+}
+
+void mp::GzipStreamDecoder::restart()
+{
+    inflateReset(&stream);
+    ended = false;
+
+    if (!decoded_file.resize(0) || !decoded_file.seek(0))
+        throw std::runtime_error(fmt::format("failed to truncate {}", decoded_file.fileName()));
+}
+
+void mp::GzipStreamDecoder::finish()
+{
+    if (!ended)
+        throw std::runtime_error("gzip file is truncated");
+
+    if (!sparse::end(decoded_file) || !decoded_file.flush())
+        throw std::runtime_error(fmt::format("failed to write {}", decoded_file.fileName()));
+}
+
+void mp::GzipStreamDecoder::flush(std::size_t size)
+{
+    if (size > 0 && !sparse::write(decoded_file, reinterpret_cast<const char*>(out_buffer.data()), size))
+        throw std::runtime_error(fmt::format("failed to write {}", decoded_file.fileName()));
+}
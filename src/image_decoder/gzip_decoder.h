@@ -0,0 +1,51 @@
+/*
+ * Copyright (C) Canonical, Ltd.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; version 3.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#ifndef MULTIPASS_GZIP_DECODER_H
+#define MULTIPASS_GZIP_DECODER_H
+
+#include <multipass/image_decoder.h>
+
+#include <QFile>
+
+#include <vector>
+
+#include <zlib.h>
+
+namespace multipass
+{
+// Members of files that were concatenated are decoded one after the other, as gunzip does
+class GzipStreamDecoder : public StreamDecoder
+{
+public:
+    explicit GzipStreamDecoder(const Path& decoded_file_path);
+    ~GzipStreamDecoder() override;
+
+    void decode(const char* data, std::size_t size) override;
+    void restart() override;
+    void finish() override;
+
+private:
+    void flush(std::size_t size);
+
+    QFile decoded_file;
+    z_stream stream{};
+    std::vector<unsigned char> out_buffer;
+    bool ended{false};
+};
+} // namespace multipass
+#endif // MULTIPASS_GZIP_DECODER_H
@@ -0,0 +1,245 @@
+/*
+ * Copyright (C) Canonical, Ltd.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; version 3.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#include "gzip_decoder.h"
+#include "zstd_decoder.h"
+
+#include <multipass/format.h>
+#include <multipass/image_decoder.h>
+#include <multipass/logging/tracer.h>
+#include <multipass/rpc/multipass.grpc.pb.h>
+#include <multipass/sparse_file.h>
+#include <multipass/xz_image_decoder.h>
+
+#include <QFile>
+
+#include <algorithm>
+#include <array>
+#include <stdexcept>
+#include <vector>
+
+namespace mp = multipass;
+namespace mpd = multipass::decoding;
+
+namespace
+{
+constexpr auto read_size = 1u << 20;
+constexpr std::array<const char*, 3> compressed_suffixes{".xz", ".zst", ".gz"};
+
+// Data that is not compressed after all, written out as it comes
+class RawStreamDecoder : public mp::StreamDecoder
+{
+public:
+    explicit RawStreamDecoder(const mp::Path& decoded_file_path) : decoded_file{decoded_file_path}
+    {
+        if (!decoded_file.open(QIODevice::WriteOnly | QIODevice::Truncate))
+            throw std::runtime_error(fmt::format("failed to open {} for writing", decoded_file.fileName()));
+    }
+
+    void decode(const char* data, std::size_t size) override
+    {
+        if (!mp::sparse::write(decoded_file, data, size))
+            throw std::runtime_error(fmt::format("failed to write {}", decoded_file.fileName()));
+    }
+
+    void restart() override
+    {
+        if (!decoded_file.resize(0) || !decoded_file.seek(0))
+            throw std::runtime_error(fmt::format("failed to truncate {}", decoded_file.fileName()));
+    }
+
+    void finish() override
+    {
+        if (!mp::sparse::end(decoded_file) || !decoded_file.flush())
+            throw std::runtime_error(fmt::format("failed to write {}", decoded_file.fileName()));
+    }
+
+private:
+    QFile decoded_file;
+};
+
+// Holds on to the first bytes until there are enough to tell what decodes them
+class SniffingStreamDecoder : public mp::StreamDecoder
+{
+public:
+    explicit SniffingStreamDecoder(const mp::Path& decoded_file_path) : decoded_file_path{decoded_file_path}
+    {
+    }
+
+    void decode(const char* data, std::size_t size) override
+    {
+        if (!decoder)
+        {
+            head.append(data, size);
+            if (head.size() < mpd::magic_size)
+                return;
+
+            pick();
+            data = nullptr;
+            size = 0;
+        }
+
+        if (size)
+            decoder->decode(data, size);
+    }
+
+    void restart() override
+    {
+        decoder.reset();
+        head.clear();
+    }
+
+    void finish() override
+    {
+        if (!decoder)
+            pick(); // data too short to be compressed is taken as it is
+
+        decoder->finish();
+    }
+
+private:
+    void pick()
+    {
+        decoder = mpd::make_stream_decoder(mpd::codec_of(head), decoded_file_path);
+        decoder->decode(head.constData(), head.size());
+        head.clear();
+    }
+
+    const mp::Path decoded_file_path;
+    QByteArray head;
+    mp::StreamDecoder::UPtr decoder;
+};
+
+// For codecs that are decoded front to back whatever they hold
+class StreamingImageDecoder : public mp::ImageDecoder
+{
+public:
+    StreamingImageDecoder(mpd::Codec codec, const mp::Path& compressed_file_path)
+        : codec{codec}, compressed_file_path{compressed_file_path}
+    {
+    }
+
+    void decode_to(const mp::Path& decoded_file_path, const mp::ProgressMonitor& monitor) override
+    {
+        mp::logging::TraceSpan span{"decode_to", compressed_file_path.toStdString()};
+
+        const auto decoder = mpd::make_stream_decoder(codec, decoded_file_path);
+        mpd::decode_file(compressed_file_path, *decoder, monitor);
+    }
+
+private:
+    const mpd::Codec codec;
+    const mp::Path compressed_file_path;
+};
+} // namespace
+
+mpd::Codec mpd::codec_of(const QByteArray& head)
+{
+    const auto byte = [&head](int i) { return i < head.size() ? static_cast<unsigned char>(head[i]) : 0u; };
+
+    if (byte(0) == 0xfd && head.mid(1, 5) == QByteArray{"7zXZ\0", 5})
+        return Codec::xz;
+    if (byte(0) == 0x28 && byte(1) == 0xb5 && byte(2) == 0x2f && byte(3) == 0xfd)
+        return Codec::zstd;
+    // Skippable frames, as pzstd puts in front of each frame to tell its size
+    if ((byte(0) & 0xf0) == 0x50 && byte(1) == 0x2a && byte(2) == 0x4d && byte(3) == 0x18)
+        return Codec::zstd;
+    if (byte(0) == 0x1f && byte(1) == 0x8b)
+        return Codec::gzip;
+
+    return Codec::raw;
+}
+
+bool mpd::is_compressed(const QString& image_path)
+{
+    return std::any_of(compressed_suffixes.cbegin(), compressed_suffixes.cend(),
+                       [&image_path](const char* suffix) { return image_path.endsWith(suffix); });
+}
+
+QString mpd::decoded_path_for(const QString& image_path)
+{
+    for (const auto suffix : compressed_suffixes)
+        if (image_path.endsWith(suffix))
+            return image_path.chopped(qstrlen(suffix));
+
+    return image_path;
+}
+
+mp::ImageDecoder::UPtr mpd::make_decoder(const Path& compressed_file_path)
+{
+    QFile compressed_file{compressed_file_path};
+    if (!compressed_file.open(QIODevice::ReadOnly))
+        throw std::runtime_error(fmt::format("failed to open {} for reading", compressed_file_path));
+
+    switch (const auto codec = codec_of(compressed_file.read(magic_size)); codec)
+    {
+    case Codec::xz:
+        return std::make_unique<XzImageDecoder>(compressed_file_path);
+    case Codec::zstd:
+        return std::make_unique<ZstdImageDecoder>(compressed_file_path);
+    default:
+        return std::make_unique<StreamingImageDecoder>(codec, compressed_file_path);
+    }
+}
+
+mp::StreamDecoder::UPtr mpd::make_stream_decoder(const Path& decoded_file_path)
+{
+    return std::make_unique<SniffingStreamDecoder>(decoded_file_path);
+}
+
+mp::StreamDecoder::UPtr mpd::make_stream_decoder(Codec codec, const Path& decoded_file_path)
+{
+    switch (codec)
+    {
+    case Codec::xz:
+        return std::make_unique<XzStreamDecoder>(decoded_file_path);
+    case Codec::zstd:
+        return std::make_unique<ZstdStreamDecoder>(decoded_file_path);
+    case Codec::gzip:
+        return std::make_unique<GzipStreamDecoder>(decoded_file_path);
+    default:
+        return std::make_unique<RawStreamDecoder>(decoded_file_path);
+    }
+}
+
+void mpd::decode_file(const Path& compressed_file_path, StreamDecoder& decoder, const ProgressMonitor& monitor)
+{
+    QFile compressed_file{compressed_file_path};
+    if (!compressed_file.open(QIODevice::ReadOnly))
+        throw std::runtime_error(fmt::format("failed to open {} for reading", compressed_file_path));
+
+    std::vector<char> read_data(read_size);
+    const auto file_size = compressed_file.size();
+    qint64 total_bytes_read{0};
+
+    auto last_progress = -1;
+    for (qint64 num_read; (num_read = compressed_file.read(read_data.data(), read_data.size())) > 0;)
+    {
+        decoder.decode(read_data.data(), num_read);
+
+        total_bytes_read += num_read;
+        const int progress = (total_bytes_read / (float)file_size) * 100;
+        if (last_progress != progress)
+            monitor(LaunchProgress::EXTRACT, progress);
+        last_progress = progress;
+    }
+
+    if (compressed_file.error() != QFileDevice::NoError)
+        throw std::runtime_error(fmt::format("failed to read {}", compressed_file_path));
+
+    decoder.finish();
+}
@@ -0,0 +1,255 @@
+/*
+ * Copyright (C) Canonical, Ltd.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; version 3.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#include "zstd_decoder.h"
+
+#include <multipass/format.h>
+#include <multipass/logging/tracer.h>
+#include <multipass/rpc/multipass.grpc.pb.h>
+#include <multipass/sparse_file.h>
+
+#include <algorithm>
+#include <atomic>
+#include <exception>
+#include <mutex>
+#include <numeric>
+#include <stdexcept>
+#include <thread>
+
+namespace mp = multipass;
+
+namespace
+{
+constexpr auto block_write_size = 1u << 20;
+// As far as --long goes, so that images compressed with it are not refused for the window they need
+constexpr auto max_window_log = sizeof(void*) == 8 ? 31 : 30;
+
+std::size_t checked(std::size_t ret)
+{
+    if (ZSTD_isError(ret))
+        throw std::runtime_error(fmt::format("zstd file is corrupt: {}", ZSTD_getErrorName(ret)));
+
+    return ret;
+}
+
+bool is_skippable(const uchar* data, std::size_t size)
+{
+    return size >= 4 && (data[0] & 0xf0) == 0x50 && data[1] == 0x2a && data[2] == 0x4d && data[3] == 0x18;
+}
+
+// Frames can only be decoded apart when they tell how much they decode to. When that cannot be made sense of, the
+// result has fewer than two frames and the file is decoded front to back instead.
+std::vector<mp::ZstdFrame> read_frames(const uchar* data, qint64 size)
+{
+    std::vector<mp::ZstdFrame> frames;
+    qint64 decoded_offset{0};
+    for (qint64 offset{0}; offset < size;)
+    {
+        const auto frame_size = ZSTD_findFrameCompressedSize(data + offset, size - offset);
+        if (ZSTD_isError(frame_size))
+            return {};
+
+        if (!is_skippable(data + offset, size - offset))
+        {
+            const auto decoded_size = ZSTD_getFrameContentSize(data + offset, size - offset);
+            if (decoded_size == ZSTD_CONTENTSIZE_UNKNOWN || decoded_size == ZSTD_CONTENTSIZE_ERROR)
+                return {};
+
+            frames.push_back({offset, static_cast<qint64>(frame_size), decoded_offset, decoded_size});
+            decoded_offset += decoded_size;
+        }
+
+        offset += frame_size;
+    }
+
+    return frames;
+}
+
+void decode_frame(ZSTD_DCtx* context, const uchar* data, const mp::ZstdFrame& frame, std::vector<char>& out_buffer,
+                  QFile& out)
+{
+    checked(ZSTD_DCtx_reset(context, ZSTD_reset_session_only));
+
+    ZSTD_inBuffer in{data + frame.offset, static_cast<std::size_t>(frame.size), 0};
+    std::uint64_t decoded{0};
+    for (std::size_t left{1}; left;)
+    {
+        ZSTD_outBuffer out_buf{out_buffer.data(), out_buffer.size(), 0};
+        left = checked(ZSTD_decompressStream(context, &out_buf, &in));
+        if (left && in.pos == in.size && out_buf.pos < out_buf.size)
+            throw std::runtime_error("zstd frame is truncated");
+
+        if (!mp::sparse::write(out, out_buffer.data(), out_buf.pos))
+            throw std::runtime_error(fmt::format("failed to write {}", out.fileName()));
+        decoded += out_buf.pos;
+    }
+
+    if (decoded != frame.decoded_size)
+        throw std::runtime_error("zstd frame does not decode to the size it tells");
+}
+} // namespace
+
+mp::ZstdImageDecoder::ZstdImageDecoder(const Path& zstd_file_path) : zstd_file{zstd_file_path}
+{
+}
+
+auto mp::ZstdImageDecoder::make_context() -> DecoderUPtr
+{
+    DecoderUPtr context{ZSTD_createDCtx(), ZSTD_freeDCtx};
+    if (!context)
+        throw std::runtime_error("zstd decoder memory allocation failed");
+
+    checked(ZSTD_DCtx_setParameter(context.get(), ZSTD_d_windowLogMax, max_window_log));
+    return context;
+}
+
+void mp::ZstdImageDecoder::decode_to(const Path& decoded_file_path, const ProgressMonitor& monitor)
+{
+    mp::logging::TraceSpan span{"decode_to", zstd_file.fileName().toStdString()};
+
+    if (!zstd_file.open(QIODevice::ReadOnly))
+        throw std::runtime_error(fmt::format("failed to open {} for reading", zstd_file.fileName()));
+
+    // Mapped rather than read, for frames to be found and decoded without going through a copy
+    const auto size = zstd_file.size();
+    if (const auto data = size > 0 ? zstd_file.map(0, size) : nullptr)
+    {
+        const auto frames = read_frames(data, size);
+        const auto num_threads = std::min<std::size_t>(std::thread::hardware_concurrency(), frames.size());
+        if (num_threads > 1)
+            return decode_frames(data, frames, num_threads, decoded_file_path, monitor);
+    }
+
+    ZstdStreamDecoder decoder{decoded_file_path};
+    decoding::decode_file(zstd_file.fileName(), decoder, monitor);
+}
+
+void mp::ZstdImageDecoder::decode_frames(const uchar* data, const std::vector<ZstdFrame>& frames,
+                                         std::size_t num_threads, const Path& decoded_file_path,
+                                         const ProgressMonitor& monitor)
+{
+    const auto& last_frame = frames.back();
+    QFile decoded_file{decoded_file_path};
+    if (!decoded_file.open(QIODevice::WriteOnly | QIODevice::Truncate) ||
+        !decoded_file.resize(last_frame.decoded_offset + last_frame.decoded_size))
+        throw std::runtime_error(fmt::format("failed to open {} for writing", decoded_file.fileName()));
+    decoded_file.close();
+
+    const auto total_bytes = std::accumulate(frames.cbegin(), frames.cend(), qint64{0},
+                                             [](qint64 sum, const ZstdFrame& frame) { return sum + frame.size; });
+    std::atomic_size_t next_frame{0};
+    std::atomic_bool failed{false};
+    std::exception_ptr error;
+    std::mutex mutex;
+    qint64 total_bytes_extracted{0};
+    auto last_progress = -1;
+
+    // Every frame goes to its own place in the preallocated file, in whatever order they get done
+    auto work = [&] {
+        try
+        {
+            QFile out{decoded_file_path};
+            if (!out.open(QIODevice::ReadWrite))
+                throw std::runtime_error(fmt::format("failed to open {} for decoding", decoded_file_path));
+
+            const auto context = make_context();
+            std::vector<char> out_buffer(block_write_size);
+
+            while (!failed)
+            {
+                const auto i = next_frame++;
+                if (i >= frames.size())
+                    break;
+
+                const auto& frame = frames[i];
+                if (!out.seek(frame.decoded_offset))
+                    throw std::runtime_error(fmt::format("failed to seek in {}", decoded_file_path));
+
+                decode_frame(context.get(), data, frame, out_buffer, out);
+
+                std::lock_guard<std::mutex> lock{mutex};
+                total_bytes_extracted += frame.size;
+                const int progress = (total_bytes_extracted / (float)total_bytes) * 100;
+                if (last_progress != progress)
+                    monitor(LaunchProgress::EXTRACT, progress);
+                last_progress = progress;
+            }
+        }
+        catch (...)
+        {
+            std::lock_guard<std::mutex> lock{mutex};
+            if (!failed.exchange(true))
+                error = std::current_exception();
+        }
+    };
+
+    std::vector<std::thread> threads;
+    for (std::size_t i = 1; i < num_threads; ++i)
+        threads.emplace_back(work);
+    work();
+
+    for (auto& thread : threads)
+        thread.join();
+
+    if (error)
+        std::rethrow_exception(error);
+}
+
+mp::ZstdStreamDecoder::ZstdStreamDecoder(const Path& decoded_file_path)
+    : decoded_file{decoded_file_path}, context{ZstdImageDecoder::make_context()}, out_buffer(ZSTD_DStreamOutSize())
+{
+    if (!decoded_file.open(QIODevice::WriteOnly | QIODevice::Truncate))
+        throw std::runtime_error(fmt::format("failed to open {} for writing", decoded_file.fileName()));
+}
+
+void mp::ZstdStreamDecoder::decode(const char* data, std::size_t size)
+{
+    // Several frames one after the other make one stream; output that did not fit comes out on the next round
+    ZSTD_inBuffer in{data, size, 0};
+    for (bool out_full{true}; in.pos < in.size || out_full;)
+    {
+        ZSTD_outBuffer out{out_buffer.data(), out_buffer.size(), 0};
+        ended = checked(ZSTD_decompressStream(context.get(), &out, &in)) == 0;
+        out_full = out.pos == out.size;
+
+        flush(out.pos);
+    }
+}
+
+void mp::ZstdStreamDecoder::restart()
+{
+    checked(ZSTD_DCtx_reset(context.get(), ZSTD_reset_session_only));
+    ended = false;
+
+    if (!decoded_file.resize(0) || !decoded_file.seek(0))
+        throw std::runtime_error(fmt::format("failed to truncate {}", decoded_file.fileName()));
+}
+
+void mp::ZstdStreamDecoder::finish()
+{
+    if (!ended)
+        throw std::runtime_error("zstd file is truncated");
+
+    if (!sparse::end(decoded_file) || !decoded_file.flush())
+        throw std::runtime_error(fmt::format("failed to write {}", decoded_file.fileName()));
+}
+
+void mp::ZstdStreamDecoder::flush(std::size_t size)
+{
+    if (size > 0 && !sparse::write(decoded_file, out_buffer.data(), size))
+        throw std::runtime_error(fmt::format("failed to write {}", decoded_file.fileName()));
+}
@@ -0,0 +1,77 @@
+/*
+ * Copyright (C) Canonical, Ltd.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; version 3.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#ifndef MULTIPASS_ZSTD_DECODER_H
+#define MULTIPASS_ZSTD_DECODER_H
+
+#include <multipass/image_decoder.h>
+
+#include <QFile>
+
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+#include <zstd.h>
+
+namespace multipass
+{
+struct ZstdFrame
+{
+    qint64 offset;
+    qint64 size;
+    qint64 decoded_offset;
+    std::uint64_t decoded_size;
+};
+
+class ZstdImageDecoder : public ImageDecoder
+{
+public:
+    explicit ZstdImageDecoder(const Path& zstd_file_path);
+
+    // Files with several frames that tell their size, as pzstd writes them, are decoded in parallel
+    void decode_to(const Path& decoded_file_path, const ProgressMonitor& monitor) override;
+
+    using DecoderUPtr = std::unique_ptr<ZSTD_DCtx, decltype(ZSTD_freeDCtx)*>;
+    static DecoderUPtr make_context();
+
+private:
+    void decode_frames(const uchar* data, const std::vector<ZstdFrame>& frames, std::size_t num_threads,
+                       const Path& decoded_file_path, const ProgressMonitor& monitor);
+
+    QFile zstd_file;
+};
+
+class ZstdStreamDecoder : public StreamDecoder
+{
+public:
+    explicit ZstdStreamDecoder(const Path& decoded_file_path);
+
+    void decode(const char* data, std::size_t size) override;
+    void restart() override;
+    void finish() override;
+
+private:
+    void flush(std::size_t size);
+
+    QFile decoded_file;
+    ZstdImageDecoder::DecoderUPtr context;
+    std::vector<char> out_buffer;
+    bool ended{false};
+};
+} // namespace multipass
+#endif // MULTIPASS_ZSTD_DECODER_H
@@ -23,6 +23,8 @@
 
 #include <array>
 #include <cctype>
+#include <stdexcept>
+#include <vector>
 
 namespace mp = multipass;
 
@@ -96,12 +98,6 @@ void set_at(T& t, SizeType offset, const V& value)
     std::copy(std::begin(value), std::end(value), t.begin() + offset);
 }
 
-template <typename T>
-void write(const T& t, QFile& f)
-{
-    f.write(reinterpret_cast<const char*>(t.data.data()), t.data.size());
-}
-
 template <size_t size>
 struct PaddedString
 {
@@ -360,23 +356,58 @@ struct RootPathTable
 };
 
 template <typename Size>
-Size num_blocks(Size num_bytes)
+constexpr Size num_blocks(Size num_bytes)
 {
     return ((num_bytes + logical_block_size - 1) / logical_block_size);
 }
 
-void seek_to_next_block(QFile& f)
+// Where everything but the files goes, the same for every seed image
+constexpr uint32_t num_reserved_blocks = num_blocks(32768u);
+constexpr uint32_t path_table_block = num_reserved_blocks + 3u; // after the three volume descriptors
+constexpr uint32_t joliet_path_table_block = path_table_block + 1u;
+constexpr uint32_t dir_records_block = joliet_path_table_block + 1u;
+constexpr uint32_t joliet_dir_records_block = dir_records_block + 1u;
+constexpr uint32_t first_file_block = joliet_dir_records_block + 1u;
+
+// All that only records the root filesystem is built once, to be copied into each image with its size set
+struct FixedLayout
+{
+    FixedLayout()
+        : root_path{dir_records_block},
+          joliet_root_path{joliet_dir_records_block},
+          root_record{RootDirRecord::Type::root, dir_records_block},
+          root_parent_record{RootDirRecord::Type::root_parent, dir_records_block},
+          joliet_root_record{RootDirRecord::Type::root, joliet_dir_records_block},
+          joliet_root_parent_record{RootDirRecord::Type::root_parent, joliet_dir_records_block}
+    {
+        prim_desc.set_path_table_info(root_path.data.size(), path_table_block);
+        prim_desc.set_root_dir_record(root_record);
+        joliet_desc.set_path_table_info(joliet_root_path.data.size(), joliet_path_table_block);
+        joliet_desc.set_root_dir_record(joliet_root_record);
+    }
+
+    PrimaryVolumeDescriptor prim_desc;
+    JolietVolumeDescriptor joliet_desc;
+    VolumeDescriptorSetTerminator terminator;
+    RootPathTable root_path;
+    RootPathTable joliet_root_path;
+    RootDirRecord root_record;
+    RootDirRecord root_parent_record;
+    RootDirRecord joliet_root_record;
+    RootDirRecord joliet_root_parent_record;
+};
+
+const FixedLayout& fixed_layout()
 {
-    const auto next_block_pos = num_blocks(f.pos()) * logical_block_size;
-    f.seek(next_block_pos);
+    static const FixedLayout layout;
+    return layout;
 }
 
-void pad_to_end(QFile& f)
+template <typename... Records>
+void set_records_at(std::vector<uint8_t>& image, uint32_t block, const Records&... records)
 {
-    seek_to_next_block(f);
-    f.seek(f.pos() - 1);
-    char end = 0;
-    f.write(&end, 1);
+    auto offset = block * logical_block_size;
+    ((set_at(image, offset, records.data), offset += records.data.size()), ...);
 }
 } // namespace
 
@@ -391,87 +422,42 @@ void mp::CloudInitIso::write_to(const Path& path)
     if (!f.open(QIODevice::WriteOnly))
         throw std::runtime_error{"failed to open file for writing during cloud-init generation"};
 
-    const uint32_t num_reserved_bytes = 32768u;
-    const uint32_t num_reserved_blocks = num_blocks(num_reserved_bytes);
-    f.seek(num_reserved_bytes);
-
-    PrimaryVolumeDescriptor prim_desc;
-    JolietVolumeDescriptor joliet_desc;
-
-    const uint32_t num_blocks_for_descriptors = 3u;
-    const uint32_t num_blocks_for_path_table = 2u;
-    const uint32_t num_blocks_for_dir_records = 2u;
-
-    auto volume_size =
-        num_reserved_blocks + num_blocks_for_descriptors + num_blocks_for_path_table + num_blocks_for_dir_records;
+    auto volume_size = first_file_block;
     for (const auto& entry : files)
     {
         volume_size += num_blocks(entry.data.size());
     }
 
+    // Laid out in memory, zeroes for the reserved area and padding included, to go out in a single write
+    const auto& layout = fixed_layout();
+    std::vector<uint8_t> image(volume_size * logical_block_size, 0u);
+
+    auto prim_desc = layout.prim_desc;
+    auto joliet_desc = layout.joliet_desc;
     prim_desc.set_volume_size(volume_size);
     joliet_desc.set_volume_size(volume_size);
-
-    uint32_t current_block_index = num_reserved_blocks + num_blocks_for_descriptors;
-
-    // The following records are simply to specify that a root filesystem exists
-    RootPathTable root_path{current_block_index + num_blocks_for_path_table};
-    prim_desc.set_path_table_info(root_path.data.size(), current_block_index);
-    ++current_block_index;
-
-    RootPathTable joliet_root_path{current_block_index + num_blocks_for_path_table};
-    joliet_desc.set_path_table_info(joliet_root_path.data.size(), current_block_index);
-    ++current_block_index;
-
-    RootDirRecord root_record{RootDirRecord::Type::root, current_block_index};
-    RootDirRecord root_parent_record{RootDirRecord::Type::root_parent, current_block_index};
-    prim_desc.set_root_dir_record(root_record);
-    ++current_block_index;
-
-    RootDirRecord joliet_root_record{RootDirRecord::Type::root, current_block_index};
-    RootDirRecord joliet_root_parent_record{RootDirRecord::Type::root_parent, current_block_index};
-    joliet_desc.set_root_dir_record(joliet_root_record);
-    ++current_block_index;
-
-    std::vector<ISOFileRecord> iso_file_records;
-    std::vector<JolietFileRecord> joliet_file_records;
-
+    set_records_at(image, num_reserved_blocks, prim_desc, joliet_desc, layout.terminator);
+    set_records_at(image, path_table_block, layout.root_path);
+    set_records_at(image, joliet_path_table_block, layout.joliet_root_path);
+    set_records_at(image, dir_records_block, layout.root_record, layout.root_parent_record);
+    set_records_at(image, joliet_dir_records_block, layout.joliet_root_record, layout.joliet_root_parent_record);
+
+    auto iso_records_offset = dir_records_block * logical_block_size + 2 * sizeof(layout.root_record.data);
+    auto joliet_records_offset = joliet_dir_records_block * logical_block_size + 2 * sizeof(layout.root_record.data);
+    auto current_block_index = first_file_block;
     for (const auto& entry : files)
     {
-        iso_file_records.emplace_back(entry.name, current_block_index, entry.data.size());
-        joliet_file_records.emplace_back(entry.name, current_block_index, entry.data.size());
+        const ISOFileRecord iso_record{entry.name, current_block_index, static_cast<uint32_t>(entry.data.size())};
+        const JolietFileRecord joliet_record{entry.name, current_block_index, static_cast<uint32_t>(entry.data.size())};
+        set_at(image, iso_records_offset, iso_record.data);
+        set_at(image, joliet_records_offset, joliet_record.data);
+        iso_records_offset += iso_record.data.size();
+        joliet_records_offset += joliet_record.data.size();
+
+        set_at(image, current_block_index * logical_block_size, entry.data);
         current_block_index += num_blocks(entry.data.size());
     }
 
-    write(prim_desc, f);
-    write(joliet_desc, f);
-    write(VolumeDescriptorSetTerminator(), f);
-
-    write(root_path, f);
-    seek_to_next_block(f);
-    write(joliet_root_path, f);
-    seek_to_next_block(f);
-
-    write(root_record, f);
-    write(root_parent_record, f);
-    for (const auto& iso_record : iso_file_records)
-    {
-        write(iso_record, f);
-    }
-    seek_to_next_block(f);
-
-    write(joliet_root_record, f);
-    write(joliet_root_parent_record, f);
-    for (const auto& joliet_record : joliet_file_records)
-    {
-        write(joliet_record, f);
-    }
-    seek_to_next_block(f);
-
-    for (const auto& entry : files)
-    {
-        f.write(entry.data.data(), entry.data.size());
-        seek_to_next_block(f);
-    }
-    pad_to_end(f);
+    if (f.write(reinterpret_cast<const char*>(image.data()), image.size()) != static_cast<qint64>(image.size()))
+        throw std::runtime_error{"failed to write cloud-init ISO"};
 }
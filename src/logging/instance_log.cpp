@@ -0,0 +1,104 @@
+/*
+ * Copyright (C) Canonical, Ltd.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; version 3.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#include <multipass/logging/instance_log.h>
+#include <multipass/logging/log.h>
+
+#include <multipass/format.h>
+
+#include <atomic>
+#include <utility>
+
+namespace mpl = multipass::logging;
+
+using namespace std::chrono_literals;
+
+namespace
+{
+std::atomic<std::size_t> all_buffered_bytes{0}; // as allocated, for buffers grow ahead of what they hold
+} // namespace
+
+mpl::InstanceLog::InstanceLog(std::string category, std::size_t capacity, int lines_per_second)
+    : category{std::move(category)}, capacity{capacity}, lines_per_second{lines_per_second}
+{
+    all_buffered_bytes += buffer.capacity();
+}
+
+mpl::InstanceLog::~InstanceLog()
+{
+    all_buffered_bytes -= buffer.capacity();
+}
+
+std::size_t mpl::InstanceLog::buffered_bytes()
+{
+    return all_buffered_bytes;
+}
+
+void mpl::InstanceLog::append(Level level, std::string_view output)
+{
+    std::lock_guard lock{mutex};
+
+    const auto allocated = buffer.capacity();
+    buffer.append(output);
+    if (buffer.size() > capacity)
+    {
+        // Dropping the oldest, from a line boundary when there is one
+        auto drop = buffer.size() - capacity;
+        if (const auto newline = buffer.find('\n', drop); newline != std::string::npos)
+            drop = newline + 1;
+        buffer.erase(0, drop);
+    }
+    all_buffered_bytes += buffer.capacity() - allocated;
+
+    while (!output.empty())
+    {
+        const auto newline = output.find('\n');
+        const auto line = output.substr(0, newline);
+        if (!line.empty())
+            forward(level, line);
+
+        output.remove_prefix(newline == std::string_view::npos ? output.size() : newline + 1);
+    }
+}
+
+std::string mpl::InstanceLog::contents() const
+{
+    std::lock_guard lock{mutex};
+    return buffer;
+}
+
+void mpl::InstanceLog::forward(Level level, std::string_view line)
+{
+    const auto now = std::chrono::steady_clock::now();
+    if (now - window_start >= 1s)
+    {
+        if (suppressed)
+            log(Level::info, category, fmt::format("{} lines of output were not logged", suppressed));
+
+        window_start = now;
+        lines_in_window = 0;
+        suppressed = 0;
+    }
+
+    if (lines_in_window < lines_per_second)
+    {
+        ++lines_in_window;
+        log(level, category, std::string{line});
+    }
+    else
+        ++suppressed;
+}
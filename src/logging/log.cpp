@@ -16,14 +16,18 @@
  */
 
 #include <multipass/logging/log.h>
+#include <multipass/logging/metrics.h>
 
 #include <multipass/format.h>
 
 #include <QString>
 #include <QtGlobal>
 
+#include <functional>
+#include <map>
 #include <shared_mutex>
 #include <stdexcept>
+#include <string_view>
 
 namespace mpl = multipass::logging;
 
@@ -31,6 +35,38 @@ namespace
 {
 std::shared_timed_mutex mutex;
 std::shared_ptr<multipass::logging::Logger> global_logger;
+std::map<std::string, mpl::Level, std::less<>> category_levels;
+
+constexpr auto category_levels_env_var = "MULTIPASS_LOG_CATEGORY_LEVELS";
+
+// Under the lock
+bool within_category_level(mpl::Level level, mpl::CString category)
+{
+    if (category_levels.empty())
+        return true;
+
+    const auto it = category_levels.find(std::string_view{category.c_str()});
+    return it == category_levels.end() || level <= it->second;
+}
+
+// Outside the lock, so that logging is not held up by what scrapes the metrics
+void count(mpl::Level level, mpl::CString category)
+{
+    MP_METRICS.increment("multipass_log_messages_total",
+                         {{"category", category.c_str()}, {"level", mpl::as_string(level).c_str()}});
+}
+
+void read_category_levels()
+{
+    for (const auto& entry : qEnvironmentVariable(category_levels_env_var).split(',', QString::SkipEmptyParts))
+    {
+        const auto separator = entry.lastIndexOf('=');
+        const auto level = entry.mid(separator + 1).trimmed();
+        for (auto i = mpl::enum_type(mpl::Level::error); separator > 0 && i <= mpl::enum_type(mpl::Level::trace); ++i)
+            if (level == mpl::as_string(mpl::level_from(i)).c_str())
+                category_levels[entry.left(separator).trimmed().toStdString()] = mpl::level_from(i);
+    }
+}
 
 mpl::Level to_level(QtMsgType type)
 {
@@ -53,16 +89,65 @@ void qt_message_handler(QtMsgType type, const QMessageLogContext&, const QString
 {
     auto msg = message.toLocal8Bit();
     mpl::log(to_level(type), "Qt", msg.constData());
+
+    // Qt aborts right after
+    if (type == QtFatalMsg)
+    {
+        std::shared_lock<decltype(mutex)> lock{mutex};
+        if (global_logger)
+            global_logger->flush();
+    }
 }
 } // namespace
 
 void mpl::log(Level level, CString category, CString message)
+{
+    {
+        std::shared_lock<decltype(mutex)> lock{mutex};
+        if (!within_category_level(level, category))
+            return;
+
+        if (global_logger)
+            global_logger->log(level, category, message);
+        else
+            fmt::print(stderr, "[{}] [{}] {}\n", as_string(level).c_str(), category.c_str(), message.c_str());
+    }
+
+    count(level, category);
+}
+
+void mpl::log(const Record& record)
+{
+    {
+        std::shared_lock<decltype(mutex)> lock{mutex};
+        if (!within_category_level(record.level, record.category))
+            return;
+
+        if (global_logger)
+            global_logger->log_record(record);
+        else
+            fmt::print(stderr, "[{}] [{}] {}\n", as_string(record.level).c_str(), record.category, record.text());
+    }
+
+    count(record.level, record.category);
+}
+
+bool mpl::enabled(Level level, CString category)
 {
     std::shared_lock<decltype(mutex)> lock{mutex};
-    if (global_logger)
-        global_logger->log(level, category, message);
-    else
-        fmt::print(stderr, "[{}] [{}] {}\n", as_string(level).c_str(), category.c_str(), message.c_str());
+    return within_category_level(level, category) && (!global_logger || global_logger->takes(level));
+}
+
+void mpl::set_category_level(const std::string& category, Level level)
+{
+    std::lock_guard<decltype(mutex)> lock{mutex};
+    category_levels[category] = level;
+}
+
+void mpl::clear_category_levels()
+{
+    std::lock_guard<decltype(mutex)> lock{mutex};
+    category_levels.clear();
 }
 
 mpl::Level mpl::get_logging_level()
@@ -79,6 +164,7 @@ void mpl::set_logger(std::shared_ptr<Logger> logger)
 {
     std::lock_guard<decltype(mutex)> lock{mutex};
     global_logger = std::move(logger);
+    read_category_levels();
     qInstallMessageHandler(qt_message_handler);
 }
 
@@ -0,0 +1,144 @@
+/*
+ * Copyright (C) Canonical, Ltd.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; version 3.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#include <multipass/logging/metrics.h>
+
+#include <multipass/format.h>
+
+#include <array>
+#include <iterator>
+#include <stdexcept>
+
+namespace mpl = multipass::logging;
+
+namespace
+{
+// In seconds, from quick RPCs to launches that download an image
+constexpr std::array<double, 14> bucket_bounds{0.005, 0.01, 0.025, 0.05, 0.1, 0.25, 0.5, 1, 2.5, 5, 10, 30, 60, 300};
+
+std::string escape(const std::string& value)
+{
+    std::string escaped;
+    for (const auto c : value)
+    {
+        if (c == '\\' || c == '"')
+            escaped += {'\\', c};
+        else if (c == '\n')
+            escaped += "\\n";
+        else
+            escaped += c;
+    }
+
+    return escaped;
+}
+
+std::string format_labels(const mpl::Metrics::Labels& labels, const std::string& le = {})
+{
+    std::vector<std::string> pairs;
+    for (const auto& [key, value] : labels)
+        pairs.push_back(fmt::format("{}=\"{}\"", key, escape(value)));
+    if (!le.empty())
+        pairs.push_back(fmt::format("le=\"{}\"", le));
+
+    return pairs.empty() ? std::string{} : fmt::format("{{{}}}", fmt::join(pairs.cbegin(), pairs.cend(), ","));
+}
+} // namespace
+
+mpl::Metrics::Metrics(const Singleton<Metrics>::PrivatePass& pass) noexcept : Singleton<Metrics>::Singleton{pass}
+{
+}
+
+void mpl::Metrics::increment(const std::string& name, const Labels& labels, double by)
+{
+    std::lock_guard lock{mutex};
+    series(name, Type::counter, labels).value += by;
+}
+
+void mpl::Metrics::adjust(const std::string& name, const Labels& labels, double by)
+{
+    std::lock_guard lock{mutex};
+    series(name, Type::gauge, labels).value += by;
+}
+
+void mpl::Metrics::set(const std::string& name, const Labels& labels, double value)
+{
+    std::lock_guard lock{mutex};
+    series(name, Type::gauge, labels).value = value;
+}
+
+void mpl::Metrics::forget(const std::string& name)
+{
+    std::lock_guard lock{mutex};
+    families.erase(name);
+}
+
+void mpl::Metrics::observe(const std::string& name, const Labels& labels, std::chrono::duration<double> duration)
+{
+    std::lock_guard lock{mutex};
+    auto& observed = series(name, Type::histogram, labels);
+
+    const auto seconds = duration.count();
+    observed.value += seconds;
+    ++observed.count;
+
+    // Cumulative, as they are exposed
+    observed.buckets.resize(bucket_bounds.size());
+    for (std::size_t i = 0; i < bucket_bounds.size(); ++i)
+        if (seconds <= bucket_bounds[i])
+            ++observed.buckets[i];
+}
+
+std::string mpl::Metrics::exposition() const
+{
+    std::lock_guard lock{mutex};
+
+    fmt::memory_buffer out;
+    for (const auto& [name, family] : families)
+    {
+        const auto& [type, all_series] = family;
+        fmt::format_to(std::back_inserter(out), "# TYPE {} {}\n", name,
+                       type == Type::counter ? "counter" : type == Type::gauge ? "gauge" : "histogram");
+
+        for (const auto& [labels, values] : all_series)
+        {
+            if (type != Type::histogram)
+            {
+                fmt::format_to(std::back_inserter(out), "{}{} {}\n", name, format_labels(labels), values.value);
+                continue;
+            }
+
+            for (std::size_t i = 0; i < bucket_bounds.size(); ++i)
+                fmt::format_to(std::back_inserter(out), "{}_bucket{} {}\n", name,
+                               format_labels(labels, fmt::format("{}", bucket_bounds[i])), values.buckets[i]);
+            fmt::format_to(std::back_inserter(out), "{}_bucket{} {}\n", name, format_labels(labels, "+Inf"),
+                           values.count);
+            fmt::format_to(std::back_inserter(out), "{}_sum{} {}\n", name, format_labels(labels), values.value);
+            fmt::format_to(std::back_inserter(out), "{}_count{} {}\n", name, format_labels(labels), values.count);
+        }
+    }
+
+    return fmt::to_string(out);
+}
+
+auto mpl::Metrics::series(const std::string& name, Type type, const Labels& labels) -> Series&
+{
+    auto& family = families.try_emplace(name, type, std::map<Labels, Series>{}).first->second;
+    if (family.first != type)
+        throw std::logic_error{fmt::format("Metric {} is already used as another type", name)};
+
+    return family.second[labels];
+}
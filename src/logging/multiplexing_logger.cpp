@@ -17,31 +17,167 @@
 
 #include <multipass/logging/multiplexing_logger.h>
 
+#include <multipass/format.h>
+
 #include <algorithm>
+#include <utility>
 
 namespace mpl = multipass::logging;
 
-multipass::logging::MultiplexingLogger::MultiplexingLogger(UPtr system_logger)
-    : Logger{system_logger->get_logging_level()}, system_logger{std::move(system_logger)}
+mpl::MultiplexingLogger::MultiplexingLogger(UPtr system_logger, std::size_t queue_capacity)
+    : Logger{system_logger->get_logging_level()},
+      system_logger{std::move(system_logger)},
+      queue_capacity{std::max<std::size_t>(queue_capacity, 1)},
+      most_verbose{logging_level}
+{
+    sinks.push_back(Sink{this->system_logger.get()});
+    drainer = std::thread{[this] { drain(); }};
+}
+
+mpl::MultiplexingLogger::~MultiplexingLogger()
 {
+    {
+        std::lock_guard<decltype(mutex)> lock{mutex};
+        stopping = true;
+    }
+
+    queued.notify_one();
+    drainer.join();
 }
 
 void mpl::MultiplexingLogger::log(mpl::Level level, CString category, CString message) const
 {
-    std::shared_lock<decltype(mutex)> lock{mutex};
-    system_logger->log(level, category, message);
-    for (auto logger : loggers)
-        logger->log(level, category, message);
+    log_record(Record{level, category.c_str(), message.c_str()});
+}
+
+void mpl::MultiplexingLogger::log_record(const Record& record) const
+{
+    {
+        std::lock_guard<decltype(mutex)> lock{mutex};
+        for (auto& sink : sinks)
+        {
+            if (!sink.logger->takes(record.level)) // nothing copied for those that would throw it away
+                continue;
+
+            if (sink.queue.size() < queue_capacity)
+                sink.queue.push_back(record);
+            else
+                ++sink.dropped;
+        }
+    }
+
+    queued.notify_one();
+}
+
+bool mpl::MultiplexingLogger::takes(Level level) const
+{
+    return level <= most_verbose.load(std::memory_order_relaxed);
+}
+
+void mpl::MultiplexingLogger::flush() const
+{
+    // What the drain thread logs itself is for it to deliver later
+    if (std::this_thread::get_id() == drainer.get_id())
+        return;
+
+    std::unique_lock<decltype(mutex)> lock{mutex};
+    delivered.wait(lock, [this] {
+        return std::all_of(sinks.cbegin(), sinks.cend(), [this](const Sink& sink) { return idle(sink); });
+    });
 }
 
 void mpl::MultiplexingLogger::add_logger(const Logger* logger)
 {
     std::lock_guard<decltype(mutex)> lock{mutex};
-    loggers.push_back(logger);
+    sinks.push_back(Sink{logger});
+    update_logging_level();
 }
 
 void mpl::MultiplexingLogger::remove_logger(const Logger* logger)
 {
-    std::lock_guard<decltype(mutex)> lock{mutex};
-    loggers.erase(std::remove(loggers.begin(), loggers.end(), logger), loggers.end());
+    std::unique_lock<decltype(mutex)> lock{mutex};
+    const auto it = std::find_if(sinks.begin(), sinks.end(), [logger](const Sink& sink) {
+        return sink.logger == logger;
+    });
+    if (it == sinks.end())
+        return;
+
+    if (std::this_thread::get_id() != drainer.get_id())
+        delivered.wait(lock, [this, it] { return idle(*it); });
+
+    sinks.erase(it);
+    update_logging_level();
+}
+
+void mpl::MultiplexingLogger::drain()
+{
+    const auto any_queued = [this] {
+        return std::any_of(sinks.cbegin(), sinks.cend(), [](const Sink& sink) { return !sink.queue.empty(); });
+    };
+
+    std::unique_lock<decltype(mutex)> lock{mutex};
+    for (;;)
+    {
+        queued.wait(lock, [this, &any_queued] { return stopping || any_queued(); });
+
+        // A message for each sink in turn, each delivered without the lock so that logging goes on in the meantime
+        for (auto& sink : sinks)
+        {
+            if (sink.queue.empty())
+                continue;
+
+            auto record = std::move(sink.queue.front());
+            sink.queue.pop_front();
+            const auto dropped = std::exchange(sink.dropped, 0);
+            sink.busy = sink.unflushed = true;
+
+            lock.unlock();
+            if (dropped)
+                sink.logger->log(Level::warning, "logging",
+                                 fmt::format("{} messages dropped, logging faster than they could be written",
+                                             dropped));
+            sink.logger->log_record(record);
+            lock.lock();
+
+            sink.busy = false;
+        }
+
+        // Caught up, so what sinks hold back to send together goes out now rather than with whatever comes next
+        if (!any_queued())
+        {
+            for (auto& sink : sinks)
+            {
+                if (!sink.unflushed)
+                    continue;
+
+                sink.busy = true;
+                sink.unflushed = false;
+
+                lock.unlock();
+                sink.logger->flush();
+                lock.lock();
+
+                sink.busy = false;
+            }
+        }
+
+        delivered.notify_all();
+
+        if (stopping && !any_queued())
+            return;
+    }
+}
+
+bool mpl::MultiplexingLogger::idle(const Sink& sink) const
+{
+    return sink.queue.empty() && !sink.busy && !sink.unflushed;
+}
+
+void mpl::MultiplexingLogger::update_logging_level()
+{
+    auto level = logging_level;
+    for (const auto& sink : sinks)
+        level = std::max(level, sink.logger->get_logging_level());
+
+    most_verbose.store(level, std::memory_order_relaxed);
 }
@@ -0,0 +1,104 @@
+/*
+ * Copyright (C) Canonical, Ltd.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; version 3.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#include <multipass/logging/log.h>
+#include <multipass/logging/tracer.h>
+
+#include <multipass/format.h>
+
+#include <QCoreApplication>
+#include <QJsonDocument>
+#include <QJsonObject>
+
+#include <functional>
+#include <thread>
+
+namespace mpl = multipass::logging;
+
+namespace
+{
+constexpr auto category = "tracer";
+
+qint64 microseconds(mpl::Tracer::Clock::duration duration)
+{
+    return std::chrono::duration_cast<std::chrono::microseconds>(duration).count();
+}
+} // namespace
+
+mpl::Tracer::Tracer(const Singleton<Tracer>::PrivatePass& pass) noexcept : Singleton<Tracer>::Singleton{pass}
+{
+}
+
+void mpl::Tracer::record(const std::string& name, const std::string& detail, Clock::time_point start,
+                         Clock::time_point end) noexcept
+try
+{
+    std::lock_guard lock{mutex};
+    if (!open())
+        return;
+
+    // Complete events, the closing bracket of the array is optional so they can be appended as they come
+    QJsonObject event{{"name", QString::fromStdString(name)},
+                      {"cat", "multipass"},
+                      {"ph", "X"},
+                      {"ts", microseconds(start.time_since_epoch())},
+                      {"dur", microseconds(end - start)},
+                      {"pid", QCoreApplication::applicationPid()},
+                      {"tid", static_cast<qint64>(std::hash<std::thread::id>{}(std::this_thread::get_id()) >> 1)}};
+    if (!detail.empty())
+        event.insert("args", QJsonObject{{"detail", QString::fromStdString(detail)}});
+
+    out << QJsonDocument{event}.toJson(QJsonDocument::Compact).toStdString() << ",\n" << std::flush;
+}
+catch (const std::exception& e)
+{
+    log(Level::debug, category, fmt::format("Could not record span \"{}\": {}", name, e.what()));
+}
+
+bool mpl::Tracer::open()
+{
+    if (out.is_open() || disabled)
+        return !disabled;
+
+    // Only looked up once, tracing is not something to switch on and off while running
+    disabled = true;
+    const auto path = qEnvironmentVariable(trace_file_env_var).toStdString();
+    if (path.empty())
+        return false;
+
+    out.open(path, std::ios::out | std::ios::trunc);
+    if (!out)
+    {
+        log(Level::warning, category, fmt::format("Could not open trace file \"{}\"", path));
+        return false;
+    }
+
+    disabled = false;
+    log(Level::info, category, fmt::format("Writing traces to \"{}\"", path));
+    out << "[\n";
+    return true;
+}
+
+mpl::TraceSpan::TraceSpan(std::string name, std::string detail)
+    : name{std::move(name)}, detail{std::move(detail)}, start{Tracer::Clock::now()}
+{
+}
+
+mpl::TraceSpan::~TraceSpan()
+{
+    MP_TRACER.record(name, detail, start, Tracer::Clock::now());
+}
@@ -20,16 +20,19 @@
 #include <multipass/exceptions/http_local_socket_exception.h>
 #include <multipass/format.h>
 
-#include <vector>
-
 #include <QRegularExpression>
+#include <QThread>
+
+#include <iterator>
+#include <vector>
 
 namespace mp = multipass;
 
 namespace
 {
-constexpr int len = 65536;
 constexpr int max_bytes = 32768;
+constexpr std::size_t max_idle_per_socket = 4;
+constexpr auto connect_timeout = 5000; // in milliseconds
 
 // Status code mapping based on
 // https://github.com/qt/qtbase/blob/dev/src/network/access/qhttpthreaddelegate.cpp
@@ -82,16 +85,60 @@ QNetworkReply::NetworkError statusCodeFromHttp(int httpStatusCode)
 }
 } // namespace
 
+mp::LocalSocketPool::LocalSocketPool(QThread* thread) : thread{thread}
+{
+}
+
+mp::LocalSocketPool::~LocalSocketPool()
+{
+    if (QThread::currentThread() != thread)
+        for (auto& [path, sockets] : idle)
+            for (auto& socket : sockets)
+                socket.release()->deleteLater();
+}
+
+mp::LocalSocketUPtr mp::LocalSocketPool::take(const QString& socket_path)
+{
+    if (QThread::currentThread() != thread)
+        return nullptr;
+
+    auto& sockets = idle[socket_path.toStdString()];
+    while (!sockets.empty())
+    {
+        auto socket = std::move(sockets.back());
+        sockets.pop_back();
+
+        // Nothing is expected on an idle connection, other than the server closing it
+        socket->waitForReadyRead(0);
+        if (socket->state() == QLocalSocket::ConnectedState && !socket->bytesAvailable())
+            return socket;
+    }
+
+    return nullptr;
+}
+
+void mp::LocalSocketPool::give_back(LocalSocketUPtr socket)
+{
+    if (QThread::currentThread() != thread || socket->state() != QLocalSocket::ConnectedState)
+        return;
+
+    auto& sockets = idle[socket->fullServerName().toStdString()];
+    if (sockets.size() < max_idle_per_socket)
+        sockets.push_back(std::move(socket));
+}
+
 mp::LocalSocketReply::LocalSocketReply(LocalSocketUPtr local_socket, const QNetworkRequest& request,
-                                       QIODevice* outgoingData)
-    : QNetworkReply(), local_socket{std::move(local_socket)}, reply_data{QByteArray(len, '\0')}
+                                       QIODevice* outgoingData, std::weak_ptr<LocalSocketPool> pool, bool reused)
+    : QNetworkReply(),
+      local_socket{std::move(local_socket)},
+      pool{std::move(pool)},
+      socket_path{this->local_socket->fullServerName()},
+      request{request},
+      retryable{reused && (!outgoingData || outgoingData->size() == 0)}
 {
     open(QIODevice::ReadOnly);
 
-    QObject::connect(this->local_socket.get(), &QLocalSocket::readyRead, this, &LocalSocketReply::read_reply);
-    QObject::connect(this->local_socket.get(), &QLocalSocket::readChannelFinished, this,
-                     &LocalSocketReply::read_finish);
-
+    connect_local_socket();
     send_request(request, outgoingData);
 }
 
@@ -116,6 +163,10 @@ void mp::LocalSocketReply::abort()
 {
     close();
 
+    // Whatever is left of the reply is not to be read, nor the connection reused
+    if (local_socket)
+        QObject::disconnect(local_socket.get(), nullptr, this, nullptr);
+
     setError(OperationCanceledError, "Operation canceled");
     emit error(OperationCanceledError);
 
@@ -137,6 +188,12 @@ qint64 mp::LocalSocketReply::readData(char* data, qint64 maxSize)
     return -1;
 }
 
+void mp::LocalSocketReply::connect_local_socket()
+{
+    QObject::connect(local_socket.get(), &QLocalSocket::readyRead, this, &LocalSocketReply::read_reply);
+    QObject::connect(local_socket.get(), &QLocalSocket::readChannelFinished, this, &LocalSocketReply::read_finish);
+}
+
 void mp::LocalSocketReply::send_request(const QNetworkRequest& request, QIODevice* outgoingData)
 {
     QByteArray http_data;
@@ -172,13 +229,13 @@ void mp::LocalSocketReply::send_request(const QNetworkRequest& request, QIODevic
         http_data += "User-Agent: " + user_agent + "\r\n";
     }
 
-    // Workaround weird issue in LXD's use of Go where Go's HTTP handler thinks there is more
-    // data and "sees" and "empty" query and reponds with an unexpected 400 error
-    http_data += "Connection: close\r\n";
-
     if (!local_socket_write(http_data))
         return;
 
+    // Nothing is to follow a body of a given length, or the server reads it as the start of the next request on the
+    // same connection
+    bool body_has_length{false};
+
     if (op == "POST" || op == "PUT" || op == "PATCH")
     {
         http_data = "Content-Type: " + request.header(QNetworkRequest::ContentTypeHeader).toByteArray() + "\r\n";
@@ -198,6 +255,7 @@ void mp::LocalSocketReply::send_request(const QNetworkRequest& request, QIODevic
                 }
 
                 http_data += "Content-Length: " + content_length + "\r\n";
+                body_has_length = true;
             }
             else if (content_length.isEmpty() && !is_chunked)
             {
@@ -246,7 +304,7 @@ void mp::LocalSocketReply::send_request(const QNetworkRequest& request, QIODevic
         }
     }
 
-    if (!local_socket_write("\r\n"))
+    if (!body_has_length && !local_socket_write("\r\n"))
         return;
 
     local_socket->flush();
@@ -254,59 +312,124 @@ void mp::LocalSocketReply::send_request(const QNetworkRequest& request, QIODevic
 
 void mp::LocalSocketReply::read_reply()
 {
-    auto data_ptr = reply_data.data() + reply_offset;
-    int bytes_read{0};
-
-    do
-    {
-        if (reply_offset + local_socket->bytesAvailable() > reply_data.length())
-        {
-            reply_data.append(len, '\0');
-            data_ptr = reply_data.data() + reply_offset;
-        }
+    reply_data.append(local_socket->readAll());
 
-        bytes_read = local_socket->read(data_ptr, len);
-
-        reply_offset += bytes_read;
-        data_ptr += bytes_read;
-    } while (bytes_read > 0);
+    if (parse_reply())
+        finish(keep_alive && reply_data.isEmpty());
 }
 
 void mp::LocalSocketReply::read_finish()
 {
     if (local_socket->bytesAvailable())
-        read_reply();
+        reply_data.append(local_socket->readAll());
 
-    if (reply_offset)
-        parse_reply();
+    // The server closed a reused connection before it got the request
+    if (retryable && !headers_parsed && reply_data.isEmpty())
+    {
+        retry();
+        return;
+    }
 
-    setFinished(true);
-    emit finished();
+    if (!parse_reply())
+    {
+        // Without framing, or cut short, the body is whatever there is
+        if (headers_parsed)
+            body.append(reply_data);
+        else if (!reply_data.isEmpty())
+            parse_status(reply_data.left(reply_data.indexOf('\n')).trimmed());
+    }
+
+    finish(false);
 }
 
-void mp::LocalSocketReply::parse_reply()
+bool mp::LocalSocketReply::parse_reply()
 {
-    auto reply_lines = reply_data.split('\n');
-    auto it = reply_lines.constBegin();
+    if (!headers_parsed)
+    {
+        const auto headers_end = reply_data.indexOf("\r\n\r\n");
+        if (headers_end < 0)
+            return false;
+
+        const auto header_lines = reply_data.left(headers_end).split('\n');
+        const auto status = header_lines.front().trimmed();
+        parse_status(status);
+        keep_alive = !status.startsWith("HTTP/1.0");
+
+        for (auto it = std::next(header_lines.cbegin()); it != header_lines.cend(); ++it)
+        {
+            const auto colon = it->indexOf(':');
+            if (colon < 0)
+                continue;
+
+            const auto name = it->left(colon).trimmed().toLower();
+            const auto value = it->mid(colon + 1).trimmed().toLower();
+
+            if (name == "content-length")
+                content_length = value.toLongLong();
+            else if (name == "transfer-encoding" && value.contains("chunked"))
+                chunked_transfer_encoding = true;
+            else if (name == "connection" && value == "close")
+                keep_alive = false;
+        }
+
+        reply_data.remove(0, headers_end + 4);
+        headers_parsed = true;
 
-    parse_status(*it);
+        // Otherwise the body goes on until the server closes the connection
+        if (!chunked_transfer_encoding && !content_length)
+            keep_alive = false;
+    }
+
+    if (chunked_transfer_encoding)
+        return parse_chunks();
+
+    if (content_length && reply_data.size() >= *content_length)
+    {
+        body = reply_data.left(*content_length);
+        reply_data.remove(0, *content_length);
+
+        return true;
+    }
+
+    return false;
+}
 
-    for (++it; it != reply_lines.constEnd(); ++it)
+bool mp::LocalSocketReply::parse_chunks()
+{
+    // Each chunk is its size in hex, possibly with extensions, then its data, each followed by CRLF
+    while (true)
     {
-        if ((*it).contains("Transfer-Encoding") && (*it).contains("chunked"))
-            chunked_transfer_encoding = true;
+        const auto size_end = reply_data.indexOf("\r\n");
+        if (size_end < 0)
+            return false;
 
-        if ((*it).isEmpty() || (*it).startsWith('\r'))
+        bool ok;
+        const auto size = reply_data.left(size_end).split(';').front().trimmed().toLongLong(&ok, 16);
+        if (!ok || size < 0)
         {
-            // Advance to the body
-            // Chunked transfer encoding also includes a line with the amount of
-            // bytes (in hex) in the chunk. We just skip it for now.
-            it = chunked_transfer_encoding ? it + 2 : it + 1;
+            setError(QNetworkReply::ProtocolFailure, "Malformed chunk in HTTP response from server");
+            emit error(QNetworkReply::ProtocolFailure);
+            keep_alive = false;
+
+            return true;
+        }
 
-            content_data = (*it).trimmed();
+        if (size == 0)
+        {
+            // The last chunk, then trailers if any, up to an empty line
+            const auto trailers_end = reply_data.indexOf("\r\n\r\n", size_end);
+            if (trailers_end < 0)
+                return false;
 
-            break;
+            reply_data.remove(0, trailers_end + 4);
+            return true;
         }
+
+        if (reply_data.size() < size_end + 2 + size + 2)
+            return false;
+
+        body.append(reply_data.mid(size_end + 2, size));
+        reply_data.remove(0, size_end + 2 + size + 2);
     }
 }
 
@@ -335,6 +458,38 @@ void mp::LocalSocketReply::parse_status(const QByteArray& status)
     }
 }
 
+void mp::LocalSocketReply::finish(bool reuse_connection)
+{
+    content_data = body.trimmed();
+
+    QObject::disconnect(local_socket.get(), nullptr, this, nullptr);
+    if (auto connections = pool.lock(); reuse_connection && connections)
+        connections->give_back(std::move(local_socket));
+
+    setFinished(true);
+    emit finished();
+}
+
+void mp::LocalSocketReply::retry()
+{
+    retryable = false;
+
+    QObject::disconnect(local_socket.get(), nullptr, this, nullptr);
+    local_socket = std::make_unique<QLocalSocket>();
+    local_socket->connectToServer(socket_path);
+    if (!local_socket->waitForConnected(connect_timeout))
+    {
+        setError(QNetworkReply::RemoteHostClosedError, local_socket->errorString());
+        emit error(QNetworkReply::RemoteHostClosedError);
+        finish(false);
+
+        return;
+    }
+
+    connect_local_socket();
+    send_request(request, nullptr);
+}
+
 bool mp::LocalSocketReply::local_socket_write(const QByteArray& data)
 {
     auto bytes_written = local_socket->write(data);
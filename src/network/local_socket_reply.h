@@ -23,18 +23,42 @@
 #include <QNetworkReply>
 #include <QNetworkRequest>
 #include <QString>
+#include <QThread>
 
 #include <memory>
+#include <optional>
+#include <string>
+#include <unordered_map>
+#include <vector>
 
 namespace multipass
 {
 using LocalSocketUPtr = std::unique_ptr<QLocalSocket>;
 
+// Idle keep-alive connections, by socket path. Sockets belong to the thread that connected them, so only those of the
+// given (long-lived) thread are kept; requests from elsewhere connect anew each time, as those threads come and go.
+class LocalSocketPool
+{
+public:
+    explicit LocalSocketPool(QThread* thread);
+    ~LocalSocketPool();
+
+    LocalSocketUPtr take(const QString& socket_path); // nullptr if there is no live one to reuse
+    void give_back(LocalSocketUPtr socket);
+
+private:
+    QThread* const thread;
+    std::unordered_map<std::string, std::vector<LocalSocketUPtr>> idle;
+};
+
 class LocalSocketReply : public QNetworkReply
 {
     Q_OBJECT
 public:
-    LocalSocketReply(LocalSocketUPtr local_socket, const QNetworkRequest& request, QIODevice* outgoingData);
+    // With a pool, the connection goes back to it once the reply is in, unless the server wants it closed. A reused
+    // connection that turns out to have been closed meanwhile is replaced, for requests without a body.
+    LocalSocketReply(LocalSocketUPtr local_socket, const QNetworkRequest& request, QIODevice* outgoingData,
+                     std::weak_ptr<LocalSocketPool> pool = {}, bool reused = false);
     LocalSocketReply();
     virtual ~LocalSocketReply();
 
@@ -50,16 +74,28 @@ private slots:
     void read_finish();
 
 private:
+    void connect_local_socket();
     void send_request(const QNetworkRequest& request, QIODevice* outgoingData);
-    void parse_reply();
+    bool parse_reply(); // true once the whole reply is in
+    bool parse_chunks();
     void parse_status(const QByteArray& status);
+    void finish(bool reuse_connection);
+    void retry();
     bool local_socket_write(const QByteArray& data);
 
     LocalSocketUPtr local_socket;
-    QByteArray reply_data;
-    qint64 reply_offset{0};
+    std::weak_ptr<LocalSocketPool> pool;
+    QString socket_path;
+    QNetworkRequest request;
+    bool retryable{false};
+
+    QByteArray reply_data; // what came in and was not parsed yet
+    QByteArray body;
     qint64 offset{0};
+    bool headers_parsed{false};
+    std::optional<qint64> content_length;
     bool chunked_transfer_encoding{false};
+    bool keep_alive{true};
 };
 } // namespace multipass
 
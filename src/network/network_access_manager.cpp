@@ -23,10 +23,13 @@
 
 namespace mp = multipass;
 
-mp::NetworkAccessManager::NetworkAccessManager(QObject* parent) : QNetworkAccessManager(parent)
+mp::NetworkAccessManager::NetworkAccessManager(QObject* parent)
+    : QNetworkAccessManager(parent), local_socket_pool{std::make_shared<LocalSocketPool>(thread())}
 {
 }
 
+mp::NetworkAccessManager::~NetworkAccessManager() = default;
+
 QNetworkReply* mp::NetworkAccessManager::createRequest(QNetworkAccessManager::Operation operation,
                                                        const QNetworkRequest& orig_request, QIODevice* device)
 {
@@ -47,13 +50,20 @@ QNetworkReply* mp::NetworkAccessManager::createRequest(QNetworkAccessManager::Op
 
         const auto socket_path = QUrl(url_parts[0]).path();
 
-        LocalSocketUPtr local_socket = std::make_unique<QLocalSocket>();
+        // Kept alive between requests, sparing a connection to each
+        LocalSocketUPtr local_socket = local_socket_pool->take(socket_path);
+        const bool reused = local_socket != nullptr;
 
-        local_socket->connectToServer(socket_path);
-        if (!local_socket->waitForConnected(5000))
+        if (!reused)
         {
-            throw LocalSocketConnectionException(
-                fmt::format("Cannot connect to {}: {}", socket_path, local_socket->errorString()));
+            local_socket = std::make_unique<QLocalSocket>();
+
+            local_socket->connectToServer(socket_path);
+            if (!local_socket->waitForConnected(5000))
+            {
+                throw LocalSocketConnectionException(
+                    fmt::format("Cannot connect to {}: {}", socket_path, local_socket->errorString()));
+            }
         }
 
         const auto server_path = url_parts[1];
@@ -65,7 +75,7 @@ QNetworkReply* mp::NetworkAccessManager::createRequest(QNetworkAccessManager::Op
         request.setUrl(url);
 
         // The caller needs to be responsible for freeing the allocated memory
-        return new LocalSocketReply(std::move(local_socket), request, device);
+        return new LocalSocketReply(std::move(local_socket), request, device, local_socket_pool, reused);
     }
     else
     {
@@ -22,18 +22,29 @@
 #include <multipass/file_ops.h>
 #include <multipass/format.h>
 #include <multipass/logging/log.h>
+#include <multipass/logging/metrics.h>
+#include <multipass/logging/tracer.h>
 #include <multipass/platform.h>
 #include <multipass/version.h>
 
 #include <QDir>
 #include <QEventLoop>
 #include <QFile>
+#include <QFileInfo>
+#include <QJsonDocument>
+#include <QJsonObject>
 #include <QNetworkDiskCache>
 #include <QNetworkReply>
+#include <QThread>
 #include <QTimer>
 #include <QUrl>
 
+#include <algorithm>
+#include <exception>
 #include <memory>
+#include <string>
+#include <utility>
+#include <vector>
 
 namespace mp = multipass;
 namespace mpl = multipass::logging;
@@ -41,7 +52,67 @@ namespace mpl = multipass::logging;
 namespace
 {
 constexpr auto category = "url downloader";
+constexpr auto max_download_connections = 4;
+constexpr qint64 min_segment_size = 16 * 1024 * 1024;
 using NetworkReplyUPtr = std::unique_ptr<QNetworkReply>;
+using RawHeaders = std::vector<std::pair<QByteArray, QByteArray>>;
+
+// Where a download goes until it is complete, so that it can be picked up again when interrupted
+QString partial_file_name(const QString& file_name)
+{
+    return file_name + mp::URLDownloader::partial_download_suffix;
+}
+
+QString partial_info_file_name(const QString& file_name)
+{
+    return partial_file_name(file_name) + ".json";
+}
+
+// The If-Range validator of what an earlier attempt at url left behind, empty if it cannot be resumed
+QByteArray resume_validator(const QUrl& url, const QString& file_name)
+{
+    QFile info_file{partial_info_file_name(file_name)};
+    if (QFileInfo{partial_file_name(file_name)}.size() <= 0 || !info_file.open(QIODevice::ReadOnly))
+        return {};
+
+    const auto info = QJsonDocument::fromJson(info_file.readAll()).object();
+    if (info["url"].toString() != url.toString())
+        return {};
+
+    return info["validator"].toString().toUtf8();
+}
+
+void save_resume_validator(const QUrl& url, const QString& file_name, const QNetworkReply* reply)
+{
+    // Weak ETags cannot go in If-Range, Last-Modified is the next best thing
+    auto validator = reply->rawHeader("ETag");
+    if (validator.isEmpty() || validator.startsWith("W/"))
+        validator = reply->rawHeader("Last-Modified");
+
+    QFile info_file{partial_info_file_name(file_name)};
+    if (validator.isEmpty())
+    {
+        info_file.remove();
+        return;
+    }
+
+    if (info_file.open(QIODevice::WriteOnly | QIODevice::Truncate))
+        info_file.write(
+            QJsonDocument{QJsonObject{{"url", url.toString()}, {"validator", QString::fromUtf8(validator)}}}.toJson());
+}
+
+bool is_resumed_at(const QNetworkReply* reply, qint64 offset)
+{
+    return offset > 0 && reply->attribute(QNetworkRequest::HttpStatusCodeAttribute).toInt() == 206;
+}
+
+// Never reused, unlike thread IDs, so that no thread takes the manager of one that came before it
+std::uint64_t thread_serial()
+{
+    static std::atomic_uint64_t next{0};
+    thread_local const auto serial = next++;
+    return serial;
+}
 
 auto make_network_manager(const mp::Path& cache_dir_path)
 {
@@ -73,17 +144,12 @@ void wait_for_reply(QNetworkReply* reply, QTimer& download_timeout)
     event_loop.exec();
 }
 
-template <typename ProgressAction, typename DownloadAction, typename ErrorAction, typename Time>
-QByteArray download(QNetworkAccessManager* manager, const Time& timeout, QUrl const& url, ProgressAction&& on_progress,
-                    DownloadAction&& on_download, ErrorAction&& on_error, const std::atomic_bool& abort_download,
-                    const bool force_cache = false)
+QNetworkRequest make_request(const QUrl& url, const bool force_cache)
 {
-    QTimer download_timeout;
-    download_timeout.setInterval(timeout);
-
     QNetworkRequest request{url};
     request.setRawHeader("Connection", "Keep-Alive");
     request.setAttribute(QNetworkRequest::HttpPipeliningAllowedAttribute, true);
+    request.setAttribute(QNetworkRequest::Http2AllowedAttribute, true); // negotiated, HTTP/1.1 otherwise
     request.setAttribute(QNetworkRequest::FollowRedirectsAttribute, true);
     request.setAttribute(QNetworkRequest::CacheLoadControlAttribute,
                          force_cache ? QNetworkRequest::AlwaysCache : QNetworkRequest::PreferNetwork);
@@ -92,6 +158,21 @@ QByteArray download(QNetworkAccessManager* manager, const Time& timeout, QUrl co
         QString::fromStdString(fmt::format("Multipass/{} ({}; {})", multipass::version_string,
                                            mp::platform::host_version(), QSysInfo::currentCpuArchitecture())));
 
+    return request;
+}
+
+template <typename ProgressAction, typename DownloadAction, typename ErrorAction, typename Time>
+QByteArray download(QNetworkAccessManager* manager, const Time& timeout, QUrl const& url, ProgressAction&& on_progress,
+                    DownloadAction&& on_download, ErrorAction&& on_error, const std::atomic_bool& abort_download,
+                    const bool force_cache = false, const RawHeaders& raw_headers = {})
+{
+    QTimer download_timeout;
+    download_timeout.setInterval(timeout);
+
+    auto request = make_request(url, force_cache);
+    for (const auto& [name, value] : raw_headers)
+        request.setRawHeader(name, value);
+
     NetworkReplyUPtr reply{manager->get(request)};
 
     QObject::connect(reply.get(), &QNetworkReply::downloadProgress, [&](qint64 bytes_received, qint64 bytes_total) {
@@ -117,19 +198,153 @@ QByteArray download(QNetworkAccessManager* manager, const Time& timeout, QUrl co
         }
         else
         {
-            mpl::log(mpl::Level::warning, category,
-                     fmt::format("Error getting {}: {} - trying cache.", url.toString(), msg));
+            mpl::log(mpl::Level::warning, category, "Error getting {}: {} - trying cache.", url.toString(), msg);
             return ::download(manager, timeout, url, on_progress, on_download, on_error, abort_download, true);
         }
     }
 
-    mpl::log(mpl::Level::trace, category,
-             fmt::format("Found {} in cache: {}", url.toString(),
-                         reply->attribute(QNetworkRequest::SourceIsFromCacheAttribute).toBool()));
+    mpl::log(mpl::Level::trace, category, "Found {} in cache: {}", url.toString(),
+             reply->attribute(QNetworkRequest::SourceIsFromCacheAttribute).toBool());
 
     return reply->readAll();
 }
 
+struct Segment
+{
+    NetworkReplyUPtr reply;
+    qint64 offset; // where the next byte goes
+    qint64 end;
+};
+
+// Fetches the file in ranges over parallel connections, writing each where it belongs in the preallocated file.
+// Returns false when the server does not serve ranges or a segment fell through, for a single stream to take over.
+template <typename ProgressAction, typename Time>
+bool download_segments(QNetworkAccessManager* manager, const Time& timeout, const QUrl& url, QFile& file,
+                       const qint64 size, ProgressAction&& on_progress, const std::atomic_bool& abort_downloads,
+                       std::atomic_bool& abort_download)
+{
+    const auto num_segments = std::min<qint64>(max_download_connections, size / min_segment_size);
+    if (num_segments < 2 || !MP_FILEOPS.resize(file, size))
+        return false;
+
+    QTimer download_timeout;
+    download_timeout.setInterval(timeout);
+    QEventLoop event_loop;
+
+    std::vector<Segment> segments;
+    segments.reserve(num_segments);
+    auto unfinished = num_segments;
+    qint64 bytes_received{0};
+    std::string failure;
+
+    auto abort_all = [&segments] {
+        for (auto& segment : segments)
+            if (!segment.reply->isFinished())
+                segment.reply->abort();
+    };
+
+    auto fail = [&failure, &abort_all](const std::string& reason) {
+        if (failure.empty())
+            failure = reason;
+        abort_all();
+    };
+
+    auto on_download = [&](Segment& segment) {
+        if (abort_downloads)
+        {
+            abort_download = true;
+            abort_all();
+            return;
+        }
+
+        // A plain 200 means the whole file is coming on every connection
+        if (segment.reply->attribute(QNetworkRequest::HttpStatusCodeAttribute).toInt() != 206)
+        {
+            fail("ranges not supported");
+            return;
+        }
+
+        const auto data = segment.reply->readAll();
+        if (segment.offset + data.size() > segment.end)
+        {
+            fail("range overrun");
+            return;
+        }
+
+        if (!file.seek(segment.offset) || MP_FILEOPS.write(file, data) != data.size())
+        {
+            mpl::log(mpl::Level::error, category, "error writing image: {}", file.errorString());
+            fail("write error");
+            return;
+        }
+        MP_METRICS.increment("multipass_downloaded_bytes_total", {}, data.size());
+
+        segment.offset += data.size();
+        bytes_received += data.size();
+        on_progress(segment.reply.get(), bytes_received, size);
+
+        if (abort_download)
+            abort_all();
+        else
+            download_timeout.start();
+    };
+
+    for (qint64 i = 0; i < num_segments; ++i)
+    {
+        const auto offset = i * (size / num_segments);
+        const auto end = i == num_segments - 1 ? size : offset + size / num_segments;
+
+        // Partial content has no business in the cache
+        auto request = make_request(url, false);
+        request.setRawHeader("Range", QByteArray{"bytes="} + QByteArray::number(offset) + '-' +
+                                          QByteArray::number(end - 1));
+        request.setAttribute(QNetworkRequest::CacheLoadControlAttribute, QNetworkRequest::AlwaysNetwork);
+        request.setAttribute(QNetworkRequest::CacheSaveControlAttribute, false);
+        // Over HTTP/2 they would all share one connection, which is what they are meant to get around
+        request.setAttribute(QNetworkRequest::Http2AllowedAttribute, false);
+
+        auto& segment = segments.emplace_back(Segment{NetworkReplyUPtr{manager->get(request)}, offset, end});
+        QObject::connect(segment.reply.get(), &QNetworkReply::readyRead, [&on_download, &segment] {
+            on_download(segment);
+        });
+        QObject::connect(segment.reply.get(), &QNetworkReply::finished, [&unfinished, &event_loop] {
+            if (--unfinished == 0)
+                event_loop.quit();
+        });
+    }
+
+    QObject::connect(&download_timeout, &QTimer::timeout, [&download_timeout, &fail] {
+        download_timeout.stop();
+        fail("Network timeout");
+    });
+
+    download_timeout.start();
+    event_loop.exec();
+
+    if (abort_download)
+    {
+        file.remove();
+        throw mp::AbortedDownloadException{segments.front().reply->errorString().toStdString()};
+    }
+
+    for (const auto& segment : segments)
+    {
+        if (failure.empty() && segment.reply->error() != QNetworkReply::NoError)
+            failure = segment.reply->errorString().toStdString();
+        else if (failure.empty() && segment.offset != segment.end)
+            failure = "incomplete range";
+    }
+
+    if (!failure.empty())
+    {
+        mpl::log(mpl::Level::info, category, "Cannot get {} in ranges: {} - using a single stream.", url.toString(),
+                 failure);
+        return false;
+    }
+
+    return true;
+}
+
 template <typename Time>
 auto get_header(QNetworkAccessManager* manager, const QUrl& url, const QNetworkRequest::KnownHeaders header,
                 const Time& timeout)
@@ -137,10 +352,7 @@ auto get_header(QNetworkAccessManager* manager, const QUrl& url, const QNetworkR
     QTimer download_timeout;
     download_timeout.setInterval(timeout);
 
-    QNetworkRequest request{url};
-    request.setAttribute(QNetworkRequest::FollowRedirectsAttribute, true);
-
-    NetworkReplyUPtr reply{manager->head(request)};
+    NetworkReplyUPtr reply{manager->head(make_request(url, false))};
 
     wait_for_reply(reply.get(), download_timeout);
 
@@ -148,13 +360,37 @@ auto get_header(QNetworkAccessManager* manager, const QUrl& url, const QNetworkR
     {
         const auto msg = download_timeout.isActive() ? reply->errorString().toStdString() : "Network timeout";
 
-        mpl::log(mpl::Level::warning, category, fmt::format("Cannot retrieve headers for {}: {}", url.toString(), msg));
+        mpl::log(mpl::Level::warning, category, "Cannot retrieve headers for {}: {}", url.toString(), msg);
 
         throw mp::DownloadException{url.toString().toStdString(), reply->errorString().toStdString()};
     }
 
     return reply->header(header);
 }
+
+auto make_progress_monitor(const std::atomic_bool& abort_downloads, std::atomic_bool& abort_download,
+                           const mp::ProgressMonitor& monitor, const int download_type, int64_t size)
+{
+    return [&abort_downloads, &abort_download, &monitor, download_type, size](
+               QNetworkReply* reply, qint64 bytes_received, qint64 bytes_total) {
+        static int last_progress_printed = -1;
+        if (bytes_received == 0)
+            return;
+
+        if (bytes_total == -1 && size > 0)
+            bytes_total = size;
+
+        auto progress = (size < 0) ? size : (100 * bytes_received + bytes_total / 2) / bytes_total;
+
+        abort_download = abort_downloads || (last_progress_printed != progress && !monitor(download_type, progress));
+        last_progress_printed = progress;
+
+        if (abort_download)
+        {
+            reply->abort();
+        }
+    };
+}
 } // namespace
 
 mp::NetworkManagerFactory::NetworkManagerFactory(const Singleton<NetworkManagerFactory>::PrivatePass& pass) noexcept
@@ -177,36 +413,181 @@ mp::URLDownloader::URLDownloader(const mp::Path& cache_dir, std::chrono::millise
 {
 }
 
+QNetworkAccessManager* mp::URLDownloader::network_manager()
+{
+    const auto serial = thread_serial();
+    std::lock_guard lock{managers_mutex};
+    if (const auto it = managers.find(serial); it != managers.end())
+        return it->second.get();
+
+    const auto manager = (managers[serial] = MP_NETMGRFACTORY.make_network_manager(cache_dir_path)).get();
+
+    // Qt's own threads say when they are done, for the manager to go with its thread rather than linger until the
+    // downloader does; deleted later, which a finished thread sees to before it is gone
+    QObject::connect(
+        QThread::currentThread(), &QThread::finished, manager,
+        [this, serial] {
+            std::lock_guard lock{managers_mutex};
+            if (const auto it = managers.find(serial); it != managers.end())
+            {
+                it->second.release()->deleteLater();
+                managers.erase(it);
+            }
+        },
+        Qt::DirectConnection);
+
+    return manager;
+}
+
 void mp::URLDownloader::download_to(const QUrl& url, const QString& file_name, int64_t size, const int download_type,
                                     const mp::ProgressMonitor& monitor)
 {
+    mpl::TraceSpan span{"download_to", url.toString().toStdString()};
     std::atomic_bool abort_download{false};
-    auto manager{MP_NETMGRFACTORY.make_network_manager(cache_dir_path)};
+    auto manager = network_manager();
+
+    const auto validator = resume_validator(url, file_name);
+    QFile file{partial_file_name(file_name)};
+    file.open(QIODevice::ReadWrite | (validator.isEmpty() ? QIODevice::Truncate : QIODevice::NotOpen));
+    const auto resume_from = validator.isEmpty() ? 0 : file.size();
+    file.seek(resume_from);
+
+    auto finish = [&file, &file_name] {
+        file.close();
+        QFile::remove(file_name);
+        if (!file.rename(file_name))
+            throw std::runtime_error(fmt::format("cannot rename {} to {}", file.fileName(), file_name));
+        QFile::remove(partial_info_file_name(file_name));
+    };
 
-    QFile file{file_name};
-    file.open(QIODevice::ReadWrite | QIODevice::Truncate);
+    // Counts what came before, for a resumed download to pick up where its progress stopped
+    auto progress_monitor = [resume_from, on_progress = make_progress_monitor(abort_downloads, abort_download, monitor,
+                                                                              download_type, size)](
+                                QNetworkReply* reply, qint64 bytes_received, qint64 bytes_total) {
+        const auto offset = is_resumed_at(reply, resume_from) ? resume_from : 0;
+        on_progress(reply, bytes_received + offset, bytes_total < 0 ? bytes_total : bytes_total + offset);
+    };
 
-    auto progress_monitor = [this, &abort_download, &monitor, download_type,
-                             size](QNetworkReply* reply, qint64 bytes_received, qint64 bytes_total) {
-        static int last_progress_printed = -1;
-        if (bytes_received == 0)
-            return;
+    if (validator.isEmpty() && size > 0 &&
+        download_segments(manager, timeout, url, file, size, progress_monitor, abort_downloads, abort_download))
+    {
+        finish();
+        return;
+    }
 
-        if (bytes_total == -1 && size > 0)
-            bytes_total = size;
+    const QNetworkReply* current_reply{nullptr};
+    bool discard_partial{false};
+    auto on_download = [this, &abort_download, &file, &url, &file_name, resume_from, &current_reply,
+                        &discard_partial](QNetworkReply* reply, QTimer& download_timeout) {
+        abort_download = abort_download || abort_downloads;
 
-        auto progress = (size < 0) ? size : (100 * bytes_received + bytes_total / 2) / bytes_total;
+        if (abort_download)
+        {
+            reply->abort();
+            return;
+        }
 
-        abort_download = abort_downloads || (last_progress_printed != progress && !monitor(download_type, progress));
-        last_progress_printed = progress;
+        if (download_timeout.isActive())
+            download_timeout.stop();
+        else
+            return;
 
-        if (abort_download)
+        // Each reply, the one from the cache included, either carries on from the partial file or starts over
+        if (reply != current_reply)
+        {
+            current_reply = reply;
+
+            if (!is_resumed_at(reply, resume_from))
+            {
+                file.resize(0);
+                file.seek(0);
+            }
+            else if (!reply->rawHeader("Content-Range").startsWith(fmt::format("bytes {}-", resume_from).c_str()))
+            {
+                mpl::log(mpl::Level::error, category, "unexpected range resuming {}", url.toString());
+                discard_partial = abort_download = true;
+                reply->abort();
+                return;
+            }
+            else
+            {
+                mpl::log(mpl::Record{mpl::Level::info,
+                                     category,
+                                     "Resuming download",
+                                     {},
+                                     {{"url", url.toString().toStdString()},
+                                      {"from_byte", std::to_string(resume_from)}}});
+            }
+
+            save_resume_validator(url, file_name, reply);
+        }
+
+        if (const auto written = MP_FILEOPS.write(file, reply->readAll()); written < 0)
         {
+            mpl::log(mpl::Level::error, category, "error writing image: {}", file.errorString());
+            discard_partial = abort_download = true;
             reply->abort();
         }
+        else
+        {
+            MP_METRICS.increment("multipass_downloaded_bytes_total", {}, written);
+        }
+        download_timeout.start();
+    };
+
+    // Whatever made it to disk is kept as long as the server can tell whether it is still current
+    auto on_error = [&file, &file_name, &discard_partial]() {
+        if (discard_partial || file.size() == 0 || !QFile::exists(partial_info_file_name(file_name)))
+        {
+            file.remove();
+            QFile::remove(partial_info_file_name(file_name));
+        }
+        else
+        {
+            mpl::log(mpl::Record{mpl::Level::info,
+                                 category,
+                                 "Keeping the partial download to resume later",
+                                 {},
+                                 {{"file", file_name.toStdString()}, {"bytes", std::to_string(file.size())}}});
+        }
     };
 
-    auto on_download = [this, &abort_download, &file](QNetworkReply* reply, QTimer& download_timeout) {
+    RawHeaders resume_headers;
+    if (resume_from > 0)
+        resume_headers = {{"Range", QByteArray{"bytes="} + QByteArray::number(resume_from) + '-'},
+                          {"If-Range", validator}};
+
+    ::download(manager, timeout, url, progress_monitor, on_download, on_error, abort_download, false,
+               resume_headers);
+    finish();
+}
+
+void mp::URLDownloader::download_chunks(const QUrl& url, const ChunkAction& on_chunk, const RestartAction& on_restart,
+                                        int64_t size, const int download_type, const mp::ProgressMonitor& monitor)
+{
+    std::atomic_bool abort_download{false};
+    std::exception_ptr chunk_error;
+    const QNetworkReply* current_reply{nullptr};
+    bool delivered{false};
+    auto manager = network_manager();
+
+    auto deliver = [&](const QNetworkReply* reply, const QByteArray& data) {
+        // A new reply means starting over, from the cache, after the network let us down midway
+        if (reply != current_reply)
+        {
+            if (delivered)
+                on_restart();
+            current_reply = reply;
+        }
+
+        delivered = delivered || !data.isEmpty();
+        on_chunk(data);
+    };
+
+    auto progress_monitor = make_progress_monitor(abort_downloads, abort_download, monitor, download_type, size);
+
+    auto on_download = [this, &abort_download, &chunk_error, &deliver](QNetworkReply* reply,
+                                                                      QTimer& download_timeout) {
         abort_download = abort_download || abort_downloads;
 
         if (abort_download)
@@ -220,23 +601,42 @@ void mp::URLDownloader::download_to(const QUrl& url, const QString& file_name, i
         else
             return;
 
-        if (MP_FILEOPS.write(file, reply->readAll()) < 0)
+        try
         {
-            mpl::log(mpl::Level::error, category, fmt::format("error writing image: {}", file.errorString()));
+            deliver(reply, reply->readAll());
+        }
+        catch (...)
+        {
+            // Nothing may escape into Qt's event loop
+            chunk_error = std::current_exception();
             abort_download = true;
             reply->abort();
+            return;
         }
         download_timeout.start();
     };
 
-    auto on_error = [&file]() { file.remove(); };
+    QByteArray rest;
+    try
+    {
+        rest = ::download(manager, timeout, url, progress_monitor, on_download, [] {}, abort_download);
+    }
+    catch (...)
+    {
+        if (!chunk_error)
+            throw;
+    }
 
-    ::download(manager.get(), timeout, url, progress_monitor, on_download, on_error, abort_download);
+    if (chunk_error)
+        std::rethrow_exception(chunk_error);
+
+    if (!rest.isEmpty())
+        on_chunk(rest);
 }
 
 QByteArray mp::URLDownloader::download(const QUrl& url)
 {
-    auto manager{MP_NETMGRFACTORY.make_network_manager(cache_dir_path)};
+    auto manager = network_manager();
 
     // This will connect to the QNetworkReply::readReady signal and when emitted,
     // reset the timer.
@@ -251,14 +651,105 @@ QByteArray mp::URLDownloader::download(const QUrl& url)
     };
 
     return ::download(
-        manager.get(), timeout, url, [](QNetworkReply*, qint64, qint64) {}, on_download, [] {}, abort_downloads);
+        manager, timeout, url, [](QNetworkReply*, qint64, qint64) {}, on_download, [] {}, abort_downloads);
+}
+
+QByteArray mp::URLDownloader::download_range(const QUrl& url, qint64 offset, qint64 size)
+{
+    auto manager = network_manager();
+
+    QTimer download_timeout;
+    download_timeout.setInterval(timeout);
+
+    // Partial content has no business in the cache
+    const auto range = QByteArray::number(offset) + '-' + QByteArray::number(offset + size - 1);
+    auto request = make_request(url, false);
+    request.setRawHeader("Range", "bytes=" + range);
+    request.setAttribute(QNetworkRequest::CacheLoadControlAttribute, QNetworkRequest::AlwaysNetwork);
+    request.setAttribute(QNetworkRequest::CacheSaveControlAttribute, false);
+
+    NetworkReplyUPtr reply{manager->get(request)};
+    QObject::connect(reply.get(), &QNetworkReply::readyRead, [this, &reply, &download_timeout] {
+        if (abort_downloads)
+            reply->abort();
+        else if (download_timeout.isActive())
+            download_timeout.start();
+    });
+
+    wait_for_reply(reply.get(), download_timeout);
+
+    if (reply->error() != QNetworkReply::NoError)
+    {
+        const auto msg = download_timeout.isActive() ? reply->errorString().toStdString() : "Network timeout";
+        if (abort_downloads)
+            throw mp::AbortedDownloadException{msg};
+
+        throw mp::DownloadException{url.toString().toStdString(), msg};
+    }
+
+    // A plain 200 would be the whole file
+    if (reply->attribute(QNetworkRequest::HttpStatusCodeAttribute).toInt() != 206 ||
+        !reply->rawHeader("Content-Range").startsWith("bytes " + range + '/'))
+        throw mp::DownloadException{url.toString().toStdString(), fmt::format("range {} not served", range)};
+
+    auto data = reply->readAll();
+    if (data.size() != size)
+        throw mp::DownloadException{url.toString().toStdString(), fmt::format("range {} cut short", range)};
+
+    MP_METRICS.increment("multipass_downloaded_bytes_total", {}, data.size());
+    return data;
+}
+
+std::optional<QByteArray> mp::URLDownloader::download_if_changed(const QUrl& url, Validators& validators)
+{
+    auto manager = network_manager();
+
+    QTimer download_timeout;
+    download_timeout.setInterval(timeout);
+
+    // The validators do what the network cache would, it only gets in the way of seeing a 304
+    auto request = make_request(url, false);
+    request.setAttribute(QNetworkRequest::CacheLoadControlAttribute, QNetworkRequest::AlwaysNetwork);
+    request.setAttribute(QNetworkRequest::CacheSaveControlAttribute, false);
+    if (!validators.etag.isEmpty())
+        request.setRawHeader("If-None-Match", validators.etag);
+    if (!validators.last_modified.isEmpty())
+        request.setRawHeader("If-Modified-Since", validators.last_modified);
+
+    NetworkReplyUPtr reply{manager->get(request)};
+    QObject::connect(reply.get(), &QNetworkReply::readyRead, [this, &reply, &download_timeout] {
+        if (abort_downloads)
+            reply->abort();
+        else if (download_timeout.isActive())
+            download_timeout.start();
+    });
+
+    wait_for_reply(reply.get(), download_timeout);
+
+    if (reply->error() != QNetworkReply::NoError)
+    {
+        const auto msg = download_timeout.isActive() ? reply->errorString().toStdString() : "Network timeout";
+        if (abort_downloads)
+            throw mp::AbortedDownloadException{msg};
+
+        throw mp::DownloadException{url.toString().toStdString(), msg};
+    }
+
+    if (reply->attribute(QNetworkRequest::HttpStatusCodeAttribute).toInt() == 304)
+    {
+        mpl::log(mpl::Level::trace, category, "{} has not changed", url.toString());
+        return std::nullopt;
+    }
+
+    validators = {reply->rawHeader("ETag"), reply->rawHeader("Last-Modified")};
+    return reply->readAll();
 }
 
 QDateTime mp::URLDownloader::last_modified(const QUrl& url)
 {
-    auto manager{MP_NETMGRFACTORY.make_network_manager(cache_dir_path)};
+    auto manager = network_manager();
 
-    return get_header(manager.get(), url, QNetworkRequest::LastModifiedHeader, timeout).toDateTime();
+    return get_header(manager, url, QNetworkRequest::LastModifiedHeader, timeout).toDateTime();
 }
 
 void mp::URLDownloader::abort_all_downloads()
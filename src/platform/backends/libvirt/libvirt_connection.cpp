@@ -0,0 +1,170 @@
+/*
+ * Copyright (C) Canonical, Ltd.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; version 3.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#include "libvirt_connection.h"
+#include "libvirt_virtual_machine.h"
+
+#include <multipass/format.h>
+#include <multipass/logging/log.h>
+
+namespace mp = multipass;
+namespace mpl = multipass::logging;
+
+namespace
+{
+constexpr auto category = "libvirt connection";
+constexpr auto keepalive_interval = 5; // seconds, for a libvirtd that went away to be noticed
+constexpr auto keepalive_count = 3;    // unanswered keepalives before the connection is closed
+
+// The default event loop is for the whole process, and needs registering before connections are opened to get events
+bool event_loop_registered(const mp::LibvirtWrapper::UPtr& libvirt_wrapper)
+{
+    static std::once_flag once;
+    static auto registered = false;
+    std::call_once(once, [&libvirt_wrapper] { registered = libvirt_wrapper->virEventRegisterDefaultImpl() == 0; });
+
+    return registered;
+}
+} // namespace
+
+mp::LibvirtConnection::LibvirtConnection(const LibvirtWrapper::UPtr& libvirt_wrapper) : libvirt_wrapper{libvirt_wrapper}
+{
+}
+
+mp::LibvirtConnection::~LibvirtConnection()
+{
+    if (event_thread.joinable())
+    {
+        stopping = true;
+
+        // Always due, for the event loop to come back around and notice it is to stop
+        const auto wake_up = libvirt_wrapper->virEventAddTimeout(0, [](int, void*) {}, nullptr, nullptr);
+        event_thread.join();
+
+        if (wake_up >= 0)
+            libvirt_wrapper->virEventRemoveTimeout(wake_up);
+    }
+
+    std::lock_guard lock{mutex};
+    close();
+}
+
+mp::LibvirtConnection::UPtr mp::LibvirtConnection::get(std::uint64_t* generation)
+{
+    std::lock_guard lock{mutex};
+    if (connection && libvirt_wrapper->virConnectIsAlive(connection) != 1)
+    {
+        mpl::log(mpl::Level::info, category, "Lost the connection to libvirtd, reconnecting");
+        close();
+    }
+
+    if (!connection)
+        open();
+
+    libvirt_wrapper->virConnectRef(connection);
+    if (generation)
+        *generation = this->generation;
+
+    return {connection, libvirt_wrapper->virConnectClose};
+}
+
+std::optional<std::uint64_t> mp::LibvirtConnection::mark() const
+{
+    std::lock_guard lock{mutex};
+    return followed_since ? std::make_optional(sequence) : std::nullopt;
+}
+
+bool mp::LibvirtConnection::unchanged_since(const std::string& domain, std::uint64_t mark) const
+{
+    std::lock_guard lock{mutex};
+    if (!followed_since || followed_since > mark)
+        return false;
+
+    const auto it = domain_events.find(domain);
+    return it == domain_events.end() || it->second <= mark;
+}
+
+void mp::LibvirtConnection::on_lifecycle_event(virConnectPtr, virDomainPtr domain, int, int, void* opaque)
+{
+    auto self = static_cast<LibvirtConnection*>(opaque);
+    const auto name = self->libvirt_wrapper->virDomainGetName(domain);
+    if (!name)
+        return;
+
+    std::lock_guard lock{self->mutex};
+    self->domain_events[name] = ++self->sequence;
+}
+
+void mp::LibvirtConnection::open()
+{
+    const auto follow_events = libvirt_wrapper && !event_loop_failed && event_loop_registered(libvirt_wrapper);
+    connection = LibVirtVirtualMachine::open_libvirt_connection(libvirt_wrapper).release();
+    ++generation;
+
+    if (!follow_events)
+        return;
+
+    if (!event_thread.joinable())
+        event_thread = std::thread{&LibvirtConnection::run_events, this};
+
+    if (libvirt_wrapper->virConnectSetKeepAlive(connection, keepalive_interval, keepalive_count) < 0)
+        mpl::log(mpl::Level::debug, category,
+                 fmt::format("Cannot set keepalive: {}", libvirt_wrapper->virGetLastErrorMessage()));
+
+    callback_id = libvirt_wrapper->virConnectDomainEventRegisterAny(connection, nullptr, VIR_DOMAIN_EVENT_ID_LIFECYCLE,
+                                                                    VIR_DOMAIN_EVENT_CALLBACK(on_lifecycle_event),
+                                                                    this, nullptr);
+    if (callback_id < 0)
+    {
+        mpl::log(mpl::Level::info, category,
+                 fmt::format("Cannot follow domain events: {}", libvirt_wrapper->virGetLastErrorMessage()));
+        return;
+    }
+
+    followed_since = ++sequence;
+}
+
+void mp::LibvirtConnection::close()
+{
+    if (!connection)
+        return;
+
+    if (callback_id >= 0)
+        libvirt_wrapper->virConnectDomainEventDeregisterAny(connection, callback_id);
+
+    libvirt_wrapper->virConnectClose(connection);
+    connection = nullptr;
+    callback_id = -1;
+    followed_since = 0;
+}
+
+void mp::LibvirtConnection::run_events()
+{
+    while (!stopping)
+    {
+        if (libvirt_wrapper->virEventRunDefaultImpl() < 0)
+        {
+            mpl::log(mpl::Level::warning, category,
+                     fmt::format("Stopped following domain events: {}", libvirt_wrapper->virGetLastErrorMessage()));
+
+            std::lock_guard lock{mutex};
+            event_loop_failed = true;
+            followed_since = 0;
+            return;
+        }
+    }
+}
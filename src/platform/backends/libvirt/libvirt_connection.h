@@ -0,0 +1,80 @@
+/*
+ * Copyright (C) Canonical, Ltd.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; version 3.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#ifndef MULTIPASS_LIBVIRT_CONNECTION_H
+#define MULTIPASS_LIBVIRT_CONNECTION_H
+
+#include "libvirt_wrapper.h"
+
+#include <multipass/disabled_copy_move.h>
+
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <thread>
+#include <unordered_map>
+
+namespace multipass
+{
+// The one connection to libvirtd that a factory and its instances share, opened when first needed and again when it
+// drops. Domain lifecycle events come through it on its own thread, for instances to know when what they fetched no
+// longer stands, instead of asking libvirtd every time.
+class LibvirtConnection : private DisabledCopyMove
+{
+public:
+    using UPtr = std::unique_ptr<virConnect, decltype(virConnectClose)*>;
+
+    // Needs to be a reference so testing can override the various libvirt functions
+    explicit LibvirtConnection(const LibvirtWrapper::UPtr& libvirt_wrapper);
+    ~LibvirtConnection();
+
+    // A reference on the connection, opening it if need be, and which one it is for handles obtained through it to be
+    // dropped along with it. Throws if libvirtd cannot be reached.
+    UPtr get(std::uint64_t* generation = nullptr);
+
+    // Where things stand, for unchanged_since() to tell whether anything happened to the domain later on. Nothing if
+    // events are not being followed.
+    std::optional<std::uint64_t> mark() const;
+    bool unchanged_since(const std::string& domain, std::uint64_t mark) const;
+
+private:
+    static void on_lifecycle_event(virConnectPtr connection, virDomainPtr domain, int event, int detail,
+                                   void* opaque);
+    void open();
+    void close();
+    void run_events();
+
+    const LibvirtWrapper::UPtr& libvirt_wrapper;
+
+    mutable std::mutex mutex;
+    virConnectPtr connection{nullptr};
+    std::uint64_t generation{0}; // of connections
+    int callback_id{-1};
+    std::uint64_t sequence{0};       // of events and connections
+    std::uint64_t followed_since{0}; // 0 while lifecycle events are not followed
+    std::unordered_map<std::string, std::uint64_t> domain_events; // the last one about each domain
+    bool event_loop_failed{false};
+
+    std::atomic_bool stopping{false};
+    std::thread event_thread;
+};
+} // namespace multipass
+
+#endif // MULTIPASS_LIBVIRT_CONNECTION_H
@@ -16,26 +16,41 @@
  */
 
 #include "libvirt_virtual_machine.h"
+#include "libvirt_connection.h"
 
+#include <multipass/constants.h>
 #include <multipass/exceptions/start_exception.h>
 #include <multipass/format.h>
 #include <multipass/logging/log.h>
+#include <multipass/logging/tracer.h>
 #include <multipass/memory_size.h>
+#include <multipass/settings/settings.h>
 #include <multipass/ssh/ssh_session.h>
 #include <multipass/utils.h>
 #include <multipass/vm_status_monitor.h>
 
 #include <shared/linux/backend_utils.h>
+#include <shared/linux/host_topology.h>
 #include <shared/qemu_img_utils/qemu_img_utils.h>
 #include <shared/shared_backend_utils.h>
 
+#include <QJsonObject>
 #include <QXmlStreamReader>
 
+#include <algorithm>
+
 namespace mp = multipass;
 namespace mpl = multipass::logging;
 
 namespace
 {
+constexpr auto disk_profile_key = "disk_profile";
+constexpr auto hugepages_key = "hugepages";
+constexpr auto cpu_pinning_key = "cpu_pinning";
+constexpr auto network_limit_key = "network_limit", disk_iops_key = "disk_iops";
+constexpr auto default_disk_profile = "default";
+constexpr auto no_cpu_pinning = "none", numa_cpu_pinning = "numa";
+
 auto instance_mac_addr_for(virDomainPtr domain, const mp::LibvirtWrapper::UPtr& libvirt_wrapper)
 {
     std::string mac_addr;
@@ -57,14 +72,15 @@ auto instance_mac_addr_for(virDomainPtr domain, const mp::LibvirtWrapper::UPtr&
     return mac_addr;
 }
 
-auto instance_ip_for(const std::string& mac_addr, const mp::LibvirtWrapper::UPtr& libvirt_wrapper)
+auto instance_ip_for(const std::string& mac_addr, mp::LibvirtConnection& libvirt_connection,
+                     const mp::LibvirtWrapper::UPtr& libvirt_wrapper)
 {
     std::optional<mp::IPAddress> ip_address;
 
     mp::LibVirtVirtualMachine::ConnectionUPtr connection{nullptr, nullptr};
     try
     {
-        connection = mp::LibVirtVirtualMachine::open_libvirt_connection(libvirt_wrapper);
+        connection = libvirt_connection.get();
     }
     catch (const std::exception&)
     {
@@ -115,8 +131,144 @@ auto host_architecture_for(virConnectPtr connection, const mp::LibvirtWrapper::U
     return arch;
 }
 
+// What the instance settings ask of the domain, kept under the same keys and with the same values as the QEMU
+// backend's
+struct Tuning
+{
+    std::string disk_profile{default_disk_profile};
+    bool hugepages{false};
+    std::string cpu_pinning{no_cpu_pinning};
+    int network_limit{0}; // Mbit/s each way, 0 for no limit
+    int disk_iops{0};
+};
+
+// Settings are left out of the metadata while they have their default value
+void update_metadata_entry(mp::VMStatusMonitor& monitor, const std::string& vm_name, const QString& key,
+                           const QJsonValue& value)
+{
+    auto metadata = monitor.retrieve_metadata_for(vm_name);
+    if (value.isNull())
+        metadata.remove(key);
+    else
+        metadata[key] = value;
+
+    monitor.update_metadata_for(vm_name, metadata);
+}
+
+auto tuning_for(const std::string& vm_name, mp::VMStatusMonitor& monitor)
+{
+    const auto metadata = monitor.retrieve_metadata_for(vm_name);
+
+    Tuning tuning;
+    if (const auto profile = metadata[disk_profile_key].toString(); !profile.isEmpty())
+        tuning.disk_profile = profile.toStdString();
+    tuning.hugepages = metadata[hugepages_key].toBool();
+    if (const auto pinning = metadata[cpu_pinning_key].toString(); !pinning.isEmpty())
+        tuning.cpu_pinning = pinning.toStdString();
+    tuning.network_limit = metadata[network_limit_key].toInt();
+    tuning.disk_iops = metadata[disk_iops_key].toInt();
+
+    return tuning;
+}
+
+// The tuned profiles give the disk a thread of its own, one queue per vCPU and I/O that bypasses the host's page cache
+std::string disk_xml_for(const std::string& disk_profile, const std::string& image_path, int num_cores, int iops)
+{
+    const auto iotune = iops ? fmt::format("      <iotune>\n"
+                                           "        <total_iops_sec>{}</total_iops_sec>\n"
+                                           "      </iotune>\n",
+                                           iops)
+                             : std::string{};
+
+    if (disk_profile == default_disk_profile)
+        return fmt::format("    <disk type=\'file\' device=\'disk\'>\n"
+                           "      <driver name=\'qemu\' type=\'qcow2\' discard=\'unmap\'/>\n"
+                           "      <source file=\'{}\'/>\n"
+                           "      <backingStore/>\n"
+                           "      <target dev=\'vda\' bus=\'virtio\'/>\n"
+                           "      <alias name=\'virtio-disk0\'/>\n"
+                           "{}"
+                           "    </disk>\n",
+                           image_path, iotune);
+
+    if (disk_profile == "virtio-blk")
+        return fmt::format("    <disk type=\'file\' device=\'disk\'>\n"
+                           "      <driver name=\'qemu\' type=\'qcow2\' discard=\'unmap\' cache=\'none\' io=\'native\' "
+                           "iothread=\'1\' queues=\'{}\'/>\n"
+                           "      <source file=\'{}\'/>\n"
+                           "      <backingStore/>\n"
+                           "      <target dev=\'vda\' bus=\'virtio\'/>\n"
+                           "{}"
+                           "    </disk>\n",
+                           num_cores, image_path, iotune);
+
+    assert(disk_profile == "virtio-scsi");
+    return fmt::format("    <controller type=\'scsi\' index=\'0\' model=\'virtio-scsi\'>\n"
+                       "      <driver iothread=\'1\' queues=\'{}\'/>\n"
+                       "    </controller>\n"
+                       "    <disk type=\'file\' device=\'disk\'>\n"
+                       "      <driver name=\'qemu\' type=\'qcow2\' discard=\'unmap\' cache=\'none\' io=\'native\'/>\n"
+                       "      <source file=\'{}\'/>\n"
+                       "      <backingStore/>\n"
+                       "      <target dev=\'sda\' bus=\'scsi\'/>\n"
+                       "{}"
+                       "    </disk>\n",
+                       num_cores, image_path, iotune);
+}
+
+// Where vCPUs run and guest memory is taken from: each vCPU on one CPU of a list in turn, or all of them and guest
+// memory in the NUMA node with the most free memory when the domain is defined
+struct Placement
+{
+    std::string vcpu_cpuset;
+    std::string cputune;
+    std::string numatune;
+};
+
+Placement placement_for(const std::string& pinning, int num_cores, const std::string& vm_name)
+{
+    Placement placement;
+    if (pinning == no_cpu_pinning)
+        return placement;
+
+    if (pinning != numa_cpu_pinning)
+    {
+        const auto cpus = mp::HostTopology::parse_cpu_list(QString::fromStdString(pinning));
+        placement.cputune = "  <cputune>\n";
+        for (auto vcpu = 0; vcpu < num_cores; ++vcpu)
+            placement.cputune +=
+                fmt::format("    <vcpupin vcpu=\'{}\' cpuset=\'{}\'/>\n", vcpu, cpus[vcpu % cpus.size()]);
+        placement.cputune += "  </cputune>\n";
+
+        return placement;
+    }
+
+    const auto nodes = MP_HOST_TOPOLOGY.numa_nodes();
+    if (nodes.empty())
+    {
+        mpl::log(mpl::Level::warning, vm_name, "The host has no NUMA nodes to place vCPUs in, leaving them be");
+        return placement;
+    }
+
+    const auto node = std::max_element(nodes.cbegin(), nodes.cend(), [](const auto& a, const auto& b) {
+                          return a.second.free_memory < b.second.free_memory;
+                      })->first;
+    const auto& cpus = nodes.at(node).cpus;
+    placement.vcpu_cpuset = fmt::format(" cpuset=\'{}\'", fmt::join(cpus.cbegin(), cpus.cend(), ","));
+    mpl::log(mpl::Level::debug, vm_name, fmt::format("Placing vCPUs and memory in NUMA node {}", node));
+
+    // As with QEMU, binding memory is only worth it where there is more than one node
+    if (nodes.size() > 1)
+        placement.numatune = fmt::format("  <numatune>\n"
+                                         "    <memory mode=\'strict\' nodeset=\'{}\'/>\n"
+                                         "  </numatune>\n",
+                                         node);
+
+    return placement;
+}
+
 auto generate_xml_config_for(const mp::VirtualMachineDescription& desc, const std::string& bridge_name,
-                             const std::string& arch)
+                             const std::string& arch, const Tuning& tuning)
 {
     static constexpr auto mem_unit = "k"; // see https://libvirt.org/formatdomain.html#elementsMemoryAllocation
     const auto memory = desc.mem_size.in_kilobytes(); /* floored here, but then "[...] the value will be rounded up to
@@ -124,12 +276,37 @@ auto generate_xml_config_for(const mp::VirtualMachineDescription& desc, const st
 
     auto qemu_path = fmt::format("/usr/bin/qemu-system-{}", arch);
 
+    const auto placement = placement_for(tuning.cpu_pinning, desc.num_cores, desc.vm_name);
+    const auto iothreads = tuning.disk_profile == default_disk_profile ? "" : "  <iothreads>1</iothreads>\n";
+    const auto memory_backing = tuning.hugepages ? "  <memoryBacking>\n"
+                                                   "    <hugepages/>\n"
+                                                   "  </memoryBacking>\n"
+                                                 : "";
+    // A queue pair per vCPU, libvirt using vhost-net whenever the host has it
+    const auto interface_driver =
+        desc.num_cores > 1 ? fmt::format("      <driver queues=\'{}\'/>\n", desc.num_cores) : std::string{};
+    // In kilobytes per second, as libvirt takes it
+    const auto bandwidth = tuning.network_limit ? fmt::format("      <bandwidth>\n"
+                                                              "        <inbound average=\'{0}\'/>\n"
+                                                              "        <outbound average=\'{0}\'/>\n"
+                                                              "      </bandwidth>\n",
+                                                              tuning.network_limit * 125)
+                                                : std::string{};
+    // Opt-in as for QEMU instances, libvirt runs QEMU too: the guest hands the pages it frees back to the host
+    const auto memballoon = MP_SETTINGS.get(mp::qemu_page_reporting_key) == "true"
+                                ? "    <memballoon model=\'virtio\' autodeflate=\'on\' freePageReporting=\'on\'/>\n"
+                                : "";
+
     return fmt::format(
         "<domain type=\'kvm\'>\n"
         "  <name>{}</name>\n"
         "  <memory unit=\'{}\'>{}</memory>\n"
         "  <currentMemory unit=\'{}\'>{}</currentMemory>\n"
-        "  <vcpu placement=\'static\'>{}</vcpu>\n"
+        "{}"
+        "  <vcpu placement=\'static\'{}>{}</vcpu>\n"
+        "{}"
+        "{}"
+        "{}"
         "  <resource>\n"
         "    <partition>/machine</partition>\n"
         "  </resource>\n"
@@ -146,13 +323,7 @@ auto generate_xml_config_for(const mp::VirtualMachineDescription& desc, const st
         "  </cpu>\n"
         "  <devices>\n"
         "    <emulator>{}</emulator>\n"
-        "    <disk type=\'file\' device=\'disk\'>\n"
-        "      <driver name=\'qemu\' type=\'qcow2\' discard=\'unmap\'/>\n"
-        "      <source file=\'{}\'/>\n"
-        "      <backingStore/>\n"
-        "      <target dev=\'vda\' bus=\'virtio\'/>\n"
-        "      <alias name=\'virtio-disk0\'/>\n"
-        "    </disk>\n"
+        "{}"
         "    <disk type=\'file\' device=\'disk\'>\n"
         "      <driver name=\'qemu\' type=\'raw\'/>\n"
         "      <source file=\'{}\'/>\n"
@@ -165,6 +336,8 @@ auto generate_xml_config_for(const mp::VirtualMachineDescription& desc, const st
         "      <source bridge=\'{}\'/>\n"
         "      <target dev=\'vnet0\'/>\n"
         "      <model type=\'virtio\'/>\n"
+        "{}"
+        "{}"
         "      <alias name=\'net0\'/>\n"
         "    </interface>\n"
         "    <serial type=\'pty\'>\n"
@@ -175,10 +348,14 @@ auto generate_xml_config_for(const mp::VirtualMachineDescription& desc, const st
         "      <model type=\'qxl\' ram=\'65536\' vram=\'65536\' vgamem=\'16384\' heads=\'1\' primary=\'yes\'/>\n"
         "      <alias name=\'video0\'/>\n"
         "    </video>\n"
+        "{}"
         "  </devices>\n"
         "</domain>",
-        desc.vm_name, mem_unit, memory, mem_unit, memory, desc.num_cores, arch, qemu_path,
-        desc.image.image_path.toStdString(), desc.cloud_init_iso.toStdString(), desc.default_mac_address, bridge_name);
+        desc.vm_name, mem_unit, memory, mem_unit, memory, memory_backing, placement.vcpu_cpuset, desc.num_cores,
+        iothreads, placement.cputune, placement.numatune, arch, qemu_path,
+        disk_xml_for(tuning.disk_profile, desc.image.image_path.toStdString(), desc.num_cores, tuning.disk_iops),
+        desc.cloud_init_iso.toStdString(), desc.default_mac_address, bridge_name, interface_driver, bandwidth,
+        memballoon);
 }
 
 auto domain_by_name_for(const std::string& vm_name, virConnectPtr connection,
@@ -191,12 +368,13 @@ auto domain_by_name_for(const std::string& vm_name, virConnectPtr connection,
 }
 
 auto domain_by_definition_for(const mp::VirtualMachineDescription& desc, const std::string& bridge_name,
-                              virConnectPtr connection, const mp::LibvirtWrapper::UPtr& libvirt_wrapper)
+                              const Tuning& tuning, virConnectPtr connection,
+                              const mp::LibvirtWrapper::UPtr& libvirt_wrapper)
 {
+    const auto arch = host_architecture_for(connection, libvirt_wrapper);
     mp::LibVirtVirtualMachine::DomainUPtr domain{
-        libvirt_wrapper->virDomainDefineXML(
-            connection,
-            generate_xml_config_for(desc, bridge_name, host_architecture_for(connection, libvirt_wrapper)).c_str()),
+        libvirt_wrapper->virDomainDefineXML(connection,
+                                            generate_xml_config_for(desc, bridge_name, arch, tuning).c_str()),
         libvirt_wrapper->virDomainFree};
 
     return domain;
@@ -259,17 +437,19 @@ void update_max_and_property(virDomainPtr domain_ptr, Updater* fun_ptr, Integer
 
 mp::LibVirtVirtualMachine::LibVirtVirtualMachine(const mp::VirtualMachineDescription& desc,
                                                  const std::string& bridge_name, mp::VMStatusMonitor& monitor,
-                                                 const mp::LibvirtWrapper::UPtr& libvirt_wrapper)
+                                                 const mp::LibvirtWrapper::UPtr& libvirt_wrapper,
+                                                 LibvirtConnection& libvirt_connection)
     : BaseVirtualMachine{desc.vm_name},
       username{desc.ssh_username},
       desc{desc},
       monitor{&monitor},
       bridge_name{bridge_name},
-      libvirt_wrapper{libvirt_wrapper}
+      libvirt_wrapper{libvirt_wrapper},
+      libvirt_connection{libvirt_connection}
 {
     try
     {
-        initialize_domain_info(open_libvirt_connection(libvirt_wrapper).get());
+        initialize_domain_info();
     }
     catch (const std::exception&)
     {
@@ -287,13 +467,8 @@ mp::LibVirtVirtualMachine::~LibVirtVirtualMachine()
 
 void mp::LibVirtVirtualMachine::start()
 {
-    auto connection = open_libvirt_connection(libvirt_wrapper);
-    DomainUPtr domain{nullptr, nullptr};
-
-    if (state == VirtualMachine::State::unknown)
-        domain = initialize_domain_info(connection.get());
-    else
-        domain = domain_by_name_for(vm_name, connection.get(), libvirt_wrapper);
+    mpl::TraceSpan span{"start", vm_name};
+    auto domain = state == VirtualMachine::State::unknown ? initialize_domain_info() : vm_domain();
 
     state = refresh_instance_state_for_domain(domain.get(), state, libvirt_wrapper);
 
@@ -336,7 +511,7 @@ void mp::LibVirtVirtualMachine::stop()
 void mp::LibVirtVirtualMachine::shutdown()
 {
     std::unique_lock<decltype(state_mutex)> lock{state_mutex};
-    auto domain = domain_by_name_for(vm_name, open_libvirt_connection(libvirt_wrapper).get(), libvirt_wrapper);
+    auto domain = vm_domain();
     state = refresh_instance_state_for_domain(domain.get(), state, libvirt_wrapper);
     if (state == State::running || state == State::delayed_shutdown || state == State::unknown)
     {
@@ -368,7 +543,7 @@ void mp::LibVirtVirtualMachine::shutdown()
 
 void mp::LibVirtVirtualMachine::suspend()
 {
-    auto domain = domain_by_name_for(vm_name, open_libvirt_connection(libvirt_wrapper).get(), libvirt_wrapper);
+    auto domain = vm_domain();
     state = refresh_instance_state_for_domain(domain.get(), state, libvirt_wrapper);
     if (state == State::running || state == State::delayed_shutdown)
     {
@@ -398,12 +573,16 @@ mp::VirtualMachine::State mp::LibVirtVirtualMachine::current_state()
 {
     try
     {
-        auto connection = open_libvirt_connection(libvirt_wrapper);
-        auto domain = domain_by_name_for(vm_name, connection.get(), libvirt_wrapper);
+        const auto mark = libvirt_connection.mark(); // taken first, not to miss what happens meanwhile
+        auto domain = vm_domain();
         if (!domain)
-            initialize_domain_info(connection.get());
+            initialize_domain_info();
 
         state = refresh_instance_state_for_domain(domain.get(), state, libvirt_wrapper);
+        state_fetched();
+
+        std::lock_guard lock{event_mark_mutex};
+        event_mark = mark;
     }
     catch (const std::exception&)
     {
@@ -413,6 +592,18 @@ mp::VirtualMachine::State mp::LibVirtVirtualMachine::current_state()
     return state;
 }
 
+mp::VirtualMachine::State mp::LibVirtVirtualMachine::cached_state()
+{
+    auto stale = false;
+    {
+        // With lifecycle events followed since it was fetched, state stands until one comes about the domain
+        std::lock_guard lock{event_mark_mutex};
+        stale = event_mark ? !libvirt_connection.unchanged_since(vm_name, *event_mark) : !state_is_fresh();
+    }
+
+    return stale ? current_state() : state;
+}
+
 int mp::LibVirtVirtualMachine::ssh_port()
 {
     return 22;
@@ -420,17 +611,16 @@ int mp::LibVirtVirtualMachine::ssh_port()
 
 void mp::LibVirtVirtualMachine::ensure_vm_is_running()
 {
-    auto is_vm_running = [this] {
-        auto domain = domain_by_name_for(vm_name, open_libvirt_connection(libvirt_wrapper).get(), libvirt_wrapper);
-        return domain_is_running(domain.get(), libvirt_wrapper);
-    };
+    auto is_vm_running = [this] { return domain_is_running(vm_domain().get(), libvirt_wrapper); };
 
     mp::backend::ensure_vm_is_running_for(this, is_vm_running, "Instance failed to start");
 }
 
 std::string mp::LibVirtVirtualMachine::ssh_hostname(std::chrono::milliseconds timeout)
 {
-    auto get_ip = [this]() -> std::optional<IPAddress> { return instance_ip_for(mac_addr, libvirt_wrapper); };
+    auto get_ip = [this]() -> std::optional<IPAddress> {
+        return instance_ip_for(mac_addr, libvirt_connection, libvirt_wrapper);
+    };
 
     return mp::backend::ip_address_for(this, get_ip, timeout);
 }
@@ -444,7 +634,7 @@ std::string mp::LibVirtVirtualMachine::management_ipv4()
 {
     if (!management_ip)
     {
-        auto result = instance_ip_for(mac_addr, libvirt_wrapper);
+        auto result = instance_ip_for(mac_addr, libvirt_connection, libvirt_wrapper);
         if (result)
             management_ip.emplace(result.value());
         else
@@ -469,13 +659,19 @@ void mp::LibVirtVirtualMachine::update_state()
     monitor->persist_state_for(vm_name, state);
 }
 
-mp::LibVirtVirtualMachine::DomainUPtr mp::LibVirtVirtualMachine::initialize_domain_info(virConnectPtr connection)
+mp::LibVirtVirtualMachine::DomainUPtr mp::LibVirtVirtualMachine::initialize_domain_info()
 {
-    auto domain = domain_by_name_for(vm_name, connection, libvirt_wrapper);
+    std::uint64_t generation{0};
+    auto connection = libvirt_connection.get(&generation);
+    auto domain = vm_domain(connection.get(), generation);
 
     if (!domain)
     {
-        domain = domain_by_definition_for(desc, bridge_name, connection, libvirt_wrapper);
+        std::lock_guard lock{domain_mutex};
+        cached_domain = domain_by_definition_for(desc, bridge_name, tuning_for(vm_name, *monitor), connection.get(),
+                                                 libvirt_wrapper);
+        domain_generation = generation;
+        domain = referenced(cached_domain.get());
     }
 
     if (mac_addr.empty())
@@ -487,12 +683,9 @@ mp::LibVirtVirtualMachine::DomainUPtr mp::LibVirtVirtualMachine::initialize_doma
     return domain;
 }
 
-mp::LibVirtVirtualMachine::DomainUPtr mp::LibVirtVirtualMachine::checked_vm_domain() const
+mp::LibVirtVirtualMachine::DomainUPtr mp::LibVirtVirtualMachine::checked_vm_domain()
 {
-    auto connection = open_libvirt_connection(libvirt_wrapper);
-    assert(connection && "should have thrown otherwise");
-
-    auto domain = domain_by_name_for(vm_name, connection.get(), libvirt_wrapper);
+    auto domain = vm_domain();
     if (!domain)
         throw std::runtime_error{
             fmt::format("Could not obtain libvirt domain: {}", libvirt_wrapper->virGetLastErrorMessage())};
@@ -500,6 +693,35 @@ mp::LibVirtVirtualMachine::DomainUPtr mp::LibVirtVirtualMachine::checked_vm_doma
     return domain;
 }
 
+mp::LibVirtVirtualMachine::DomainUPtr mp::LibVirtVirtualMachine::vm_domain()
+{
+    std::uint64_t generation{0};
+    auto connection = libvirt_connection.get(&generation);
+
+    return vm_domain(connection.get(), generation);
+}
+
+mp::LibVirtVirtualMachine::DomainUPtr mp::LibVirtVirtualMachine::vm_domain(virConnectPtr connection,
+                                                                           std::uint64_t generation)
+{
+    std::lock_guard lock{domain_mutex};
+    if (!cached_domain || domain_generation != generation)
+    {
+        cached_domain = domain_by_name_for(vm_name, connection, libvirt_wrapper);
+        domain_generation = generation;
+    }
+
+    return referenced(cached_domain.get());
+}
+
+mp::LibVirtVirtualMachine::DomainUPtr mp::LibVirtVirtualMachine::referenced(virDomainPtr domain) const
+{
+    if (domain)
+        libvirt_wrapper->virDomainRef(domain);
+
+    return {domain, libvirt_wrapper->virDomainFree};
+}
+
 mp::LibVirtVirtualMachine::ConnectionUPtr
 mp::LibVirtVirtualMachine::open_libvirt_connection(const mp::LibvirtWrapper::UPtr& libvirt_wrapper)
 {
@@ -543,3 +765,93 @@ void mp::LibVirtVirtualMachine::resize_disk(const MemorySize& new_size)
     mp::backend::resize_instance_image(new_size, desc.image.image_path);
     desc.disk_space = new_size;
 }
+
+bool mp::LibVirtVirtualMachine::concurrent_state_changes()
+{
+    return true; // libvirt calls can come from any thread, and states are guarded by state_mutex
+}
+
+std::vector<std::string> mp::LibVirtVirtualMachine::disk_profiles()
+{
+    return {default_disk_profile, "virtio-blk", "virtio-scsi"};
+}
+
+std::string mp::LibVirtVirtualMachine::disk_profile()
+{
+    return tuning_for(vm_name, *monitor).disk_profile;
+}
+
+void mp::LibVirtVirtualMachine::set_disk_profile(const std::string& profile)
+{
+    update_tuning(disk_profile_key, profile == default_disk_profile ? QJsonValue{} : QString::fromStdString(profile));
+}
+
+bool mp::LibVirtVirtualMachine::hugepages()
+{
+    return tuning_for(vm_name, *monitor).hugepages;
+}
+
+void mp::LibVirtVirtualMachine::set_hugepages(bool enabled)
+{
+    update_tuning(hugepages_key, enabled ? QJsonValue{true} : QJsonValue{});
+}
+
+std::string mp::LibVirtVirtualMachine::cpu_pinning()
+{
+    return tuning_for(vm_name, *monitor).cpu_pinning;
+}
+
+void mp::LibVirtVirtualMachine::set_cpu_pinning(const std::string& pinning)
+{
+    if (pinning != no_cpu_pinning && pinning != numa_cpu_pinning)
+        HostTopology::parse_cpu_list(QString::fromStdString(pinning)); // just to check it
+
+    update_tuning(cpu_pinning_key, pinning == no_cpu_pinning ? QJsonValue{} : QString::fromStdString(pinning));
+}
+
+int mp::LibVirtVirtualMachine::network_limit()
+{
+    return tuning_for(vm_name, *monitor).network_limit;
+}
+
+void mp::LibVirtVirtualMachine::set_network_limit(int mbits)
+{
+    update_tuning(network_limit_key, mbits ? QJsonValue{mbits} : QJsonValue{});
+}
+
+int mp::LibVirtVirtualMachine::disk_iops_limit()
+{
+    return tuning_for(vm_name, *monitor).disk_iops;
+}
+
+void mp::LibVirtVirtualMachine::set_disk_iops_limit(int iops)
+{
+    update_tuning(disk_iops_key, iops ? QJsonValue{iops} : QJsonValue{});
+}
+
+void mp::LibVirtVirtualMachine::update_tuning(const QString& key, const QJsonValue& value)
+{
+    const auto previous_metadata = monitor->retrieve_metadata_for(vm_name);
+    update_metadata_entry(*monitor, vm_name, key, value);
+
+    // Settings only change while the instance is stopped, its definition taking them for when it next starts
+    try
+    {
+        std::uint64_t generation{0};
+        auto connection = libvirt_connection.get(&generation);
+        auto domain = domain_by_definition_for(desc, bridge_name, tuning_for(vm_name, *monitor), connection.get(),
+                                               libvirt_wrapper);
+        if (!domain)
+            throw std::runtime_error{
+                fmt::format("Could not update libvirt domain: {}", libvirt_wrapper->virGetLastErrorMessage())};
+
+        std::lock_guard lock{domain_mutex};
+        cached_domain = std::move(domain);
+        domain_generation = generation;
+    }
+    catch (...)
+    {
+        monitor->update_metadata_for(vm_name, previous_metadata);
+        throw;
+    }
+}
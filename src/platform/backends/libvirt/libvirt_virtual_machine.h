@@ -24,8 +24,16 @@
 
 #include <multipass/virtual_machine_description.h>
 
+#include <QJsonValue>
+#include <QString>
+
+#include <cstdint>
+#include <mutex>
+#include <optional>
+
 namespace multipass
 {
+class LibvirtConnection;
 class VMStatusMonitor;
 
 class LibVirtVirtualMachine final : public BaseVirtualMachine
@@ -36,7 +44,8 @@ public:
     using NetworkUPtr = std::unique_ptr<virNetwork, decltype(virNetworkFree)*>;
 
     LibVirtVirtualMachine(const VirtualMachineDescription& desc, const std::string& bridge_name,
-                          VMStatusMonitor& monitor, const LibvirtWrapper::UPtr& libvirt_wrapper);
+                          VMStatusMonitor& monitor, const LibvirtWrapper::UPtr& libvirt_wrapper,
+                          LibvirtConnection& libvirt_connection);
     ~LibVirtVirtualMachine();
 
     void start() override;
@@ -44,6 +53,7 @@ public:
     void shutdown() override;
     void suspend() override;
     State current_state() override;
+    State cached_state() override;
     int ssh_port() override;
     std::string ssh_hostname(std::chrono::milliseconds timeout) override;
     std::string ssh_username() override;
@@ -55,12 +65,29 @@ public:
     void update_cpus(int num_cores) override;
     void resize_memory(const MemorySize& new_size) override;
     void resize_disk(const MemorySize& new_size) override;
+    bool concurrent_state_changes() override;
+    std::vector<std::string> disk_profiles() override;
+    std::string disk_profile() override;
+    void set_disk_profile(const std::string& profile) override;
+    bool hugepages() override;
+    void set_hugepages(bool enabled) override;
+    std::string cpu_pinning() override;
+    void set_cpu_pinning(const std::string& pinning) override;
+    int network_limit() override;
+    void set_network_limit(int mbits) override;
+    int disk_iops_limit() override;
+    void set_disk_iops_limit(int iops) override;
 
     static ConnectionUPtr open_libvirt_connection(const LibvirtWrapper::UPtr& libvirt_wrapper);
 
 private:
-    DomainUPtr initialize_domain_info(virConnectPtr connection);
-    DomainUPtr checked_vm_domain() const;
+    DomainUPtr initialize_domain_info();
+    DomainUPtr checked_vm_domain();
+    // Looked up once for each connection, then reused
+    DomainUPtr vm_domain();
+    DomainUPtr vm_domain(virConnectPtr connection, std::uint64_t generation);
+    DomainUPtr referenced(virDomainPtr domain) const;
+    void update_tuning(const QString& key, const QJsonValue& value); // redefining the domain with it
 
     std::string mac_addr;
     const std::string username;
@@ -70,7 +97,15 @@ private:
     const std::string& bridge_name;
     // Needs to be a reference so testing can override the various libvirt functions
     const LibvirtWrapper::UPtr& libvirt_wrapper;
+    LibvirtConnection& libvirt_connection; // shared with the factory and its other instances
     bool update_suspend_status{true};
+
+    std::mutex domain_mutex;
+    DomainUPtr cached_domain{nullptr, nullptr};
+    std::uint64_t domain_generation{0}; // of the connection it was obtained through
+
+    std::mutex event_mark_mutex;
+    std::optional<std::uint64_t> event_mark; // where lifecycle events stood when state was last fetched
 };
 } // namespace multipass
 
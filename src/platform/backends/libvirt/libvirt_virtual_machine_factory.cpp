@@ -111,7 +111,8 @@ mp::LibVirtVirtualMachineFactory::LibVirtVirtualMachineFactory(const mp::Path& d
     : libvirt_wrapper{make_libvirt_wrapper(libvirt_object_path)},
       data_dir{data_dir},
       bridge_name{enable_libvirt_network(data_dir, libvirt_wrapper)},
-      libvirt_object_path{libvirt_object_path}
+      libvirt_object_path{libvirt_object_path},
+      connection{libvirt_wrapper}
 {
 }
 
@@ -126,16 +127,17 @@ mp::VirtualMachine::UPtr mp::LibVirtVirtualMachineFactory::create_virtual_machin
     if (bridge_name.empty())
         bridge_name = enable_libvirt_network(data_dir, libvirt_wrapper);
 
-    return std::make_unique<mp::LibVirtVirtualMachine>(desc, bridge_name, monitor, libvirt_wrapper);
+    return std::make_unique<mp::LibVirtVirtualMachine>(desc, bridge_name, monitor, libvirt_wrapper, connection);
 }
 
 mp::LibVirtVirtualMachineFactory::~LibVirtVirtualMachineFactory()
 {
     if (bridge_name == multipass_bridge_name)
     {
-        auto connection = LibVirtVirtualMachine::open_libvirt_connection(libvirt_wrapper);
+        auto shared_connection = connection.get();
         mp::LibVirtVirtualMachine::NetworkUPtr network{
-            libvirt_wrapper->virNetworkLookupByName(connection.get(), "default"), libvirt_wrapper->virNetworkFree};
+            libvirt_wrapper->virNetworkLookupByName(shared_connection.get(), "default"),
+            libvirt_wrapper->virNetworkFree};
 
         libvirt_wrapper->virNetworkDestroy(network.get());
     }
@@ -143,9 +145,11 @@ mp::LibVirtVirtualMachineFactory::~LibVirtVirtualMachineFactory()
 
 void mp::LibVirtVirtualMachineFactory::remove_resources_for(const std::string& name)
 {
-    auto connection = LibVirtVirtualMachine::open_libvirt_connection(libvirt_wrapper);
+    auto shared_connection = connection.get();
+    mp::LibVirtVirtualMachine::DomainUPtr domain{
+        libvirt_wrapper->virDomainLookupByName(shared_connection.get(), name.c_str()), libvirt_wrapper->virDomainFree};
 
-    libvirt_wrapper->virDomainUndefine(libvirt_wrapper->virDomainLookupByName(connection.get(), name.c_str()));
+    libvirt_wrapper->virDomainUndefine(domain.get());
 }
 
 mp::VMImage mp::LibVirtVirtualMachineFactory::prepare_source_image(const VMImage& source_image)
@@ -163,13 +167,18 @@ void mp::LibVirtVirtualMachineFactory::prepare_instance_image(const VMImage& ins
 
 void mp::LibVirtVirtualMachineFactory::hypervisor_health_check()
 {
-    MP_BACKEND.check_for_kvm_support();
+    // Only checked until it is there, as KVM does not go away short of unloading its modules
+    if (!kvm_supported)
+    {
+        MP_BACKEND.check_for_kvm_support();
+        kvm_supported = true;
+    }
     MP_BACKEND.check_if_kvm_is_in_use();
 
     if (!libvirt_wrapper)
         libvirt_wrapper = make_libvirt_wrapper(libvirt_object_path);
 
-    LibVirtVirtualMachine::open_libvirt_connection(libvirt_wrapper);
+    connection.get();
 
     if (bridge_name.empty())
         bridge_name = enable_libvirt_network(data_dir, libvirt_wrapper);
@@ -180,9 +189,10 @@ QString mp::LibVirtVirtualMachineFactory::get_backend_version_string()
     try
     {
         unsigned long libvirt_version;
-        auto connection = LibVirtVirtualMachine::open_libvirt_connection(libvirt_wrapper);
+        auto shared_connection = connection.get();
 
-        if (libvirt_wrapper->virConnectGetVersion(connection.get(), &libvirt_version) == 0 && libvirt_version != 0)
+        if (libvirt_wrapper->virConnectGetVersion(shared_connection.get(), &libvirt_version) == 0 &&
+            libvirt_version != 0)
         {
             return QString("libvirt-%1.%2.%3")
                 .arg(libvirt_version / 1000000)
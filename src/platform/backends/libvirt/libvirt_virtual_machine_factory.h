@@ -17,10 +17,12 @@
 #ifndef MULTIPASS_LIBVIRT_VIRTUAL_MACHINE_FACTORY_H
 #define MULTIPASS_LIBVIRT_VIRTUAL_MACHINE_FACTORY_H
 
+#include "libvirt_connection.h"
 #include "libvirt_wrapper.h"
 
 #include <shared/base_virtual_machine_factory.h>
 
+#include <atomic>
 #include <memory>
 #include <string>
 
@@ -50,6 +52,8 @@ private:
     const Path data_dir;
     std::string bridge_name;
     const std::string libvirt_object_path;
+    std::atomic_bool kvm_supported{false};
+    LibvirtConnection connection; // after the wrapper it goes through, to be closed first
 };
 } // namespace multipass
 
@@ -58,6 +58,14 @@ mp::LibvirtWrapper::LibvirtWrapper(const std::string& filename)
           reinterpret_cast<virConnectGetCapabilities_t>(get_symbol_address_for("virConnectGetCapabilities", handle))},
       virConnectGetVersion{
           reinterpret_cast<virConnectGetVersion_t>(get_symbol_address_for("virConnectGetVersion", handle))},
+      virConnectRef{reinterpret_cast<virConnectRef_t>(get_symbol_address_for("virConnectRef", handle))},
+      virConnectIsAlive{reinterpret_cast<virConnectIsAlive_t>(get_symbol_address_for("virConnectIsAlive", handle))},
+      virConnectSetKeepAlive{
+          reinterpret_cast<virConnectSetKeepAlive_t>(get_symbol_address_for("virConnectSetKeepAlive", handle))},
+      virConnectDomainEventRegisterAny{reinterpret_cast<virConnectDomainEventRegisterAny_t>(
+          get_symbol_address_for("virConnectDomainEventRegisterAny", handle))},
+      virConnectDomainEventDeregisterAny{reinterpret_cast<virConnectDomainEventDeregisterAny_t>(
+          get_symbol_address_for("virConnectDomainEventDeregisterAny", handle))},
       virNetworkLookupByName{
           reinterpret_cast<virNetworkLookupByName_t>(get_symbol_address_for("virNetworkLookupByName", handle))},
       virNetworkCreateXML{
@@ -79,6 +87,8 @@ mp::LibvirtWrapper::LibvirtWrapper(const std::string& filename)
           reinterpret_cast<virDomainGetXMLDesc_t>(get_symbol_address_for("virDomainGetXMLDesc", handle))},
       virDomainDestroy{reinterpret_cast<virDomainDestroy_t>(get_symbol_address_for("virDomainDestroy", handle))},
       virDomainFree{reinterpret_cast<virDomainFree_t>(get_symbol_address_for("virDomainFree", handle))},
+      virDomainRef{reinterpret_cast<virDomainRef_t>(get_symbol_address_for("virDomainRef", handle))},
+      virDomainGetName{reinterpret_cast<virDomainGetName_t>(get_symbol_address_for("virDomainGetName", handle))},
       virDomainDefineXML{reinterpret_cast<virDomainDefineXML_t>(get_symbol_address_for("virDomainDefineXML", handle))},
       virDomainGetState{reinterpret_cast<virDomainGetState_t>(get_symbol_address_for("virDomainGetState", handle))},
       virDomainCreate{reinterpret_cast<virDomainCreate_t>(get_symbol_address_for("virDomainCreate", handle))},
@@ -92,7 +102,14 @@ mp::LibvirtWrapper::LibvirtWrapper(const std::string& filename)
       virDomainSetMemoryFlags{
           reinterpret_cast<virDomainSetMemoryFlags_t>(get_symbol_address_for("virDomainSetMemoryFlags", handle))},
       virGetLastErrorMessage{
-          reinterpret_cast<virGetLastErrorMessage_t>(get_symbol_address_for("virGetLastErrorMessage", handle))}
+          reinterpret_cast<virGetLastErrorMessage_t>(get_symbol_address_for("virGetLastErrorMessage", handle))},
+      virEventRegisterDefaultImpl{reinterpret_cast<virEventRegisterDefaultImpl_t>(
+          get_symbol_address_for("virEventRegisterDefaultImpl", handle))},
+      virEventRunDefaultImpl{
+          reinterpret_cast<virEventRunDefaultImpl_t>(get_symbol_address_for("virEventRunDefaultImpl", handle))},
+      virEventAddTimeout{reinterpret_cast<virEventAddTimeout_t>(get_symbol_address_for("virEventAddTimeout", handle))},
+      virEventRemoveTimeout{
+          reinterpret_cast<virEventRemoveTimeout_t>(get_symbol_address_for("virEventRemoveTimeout", handle))}
 {
 }
 
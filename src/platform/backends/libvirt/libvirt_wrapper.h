@@ -61,6 +61,13 @@ private:
     typedef int (*virConnectClose_t)(virConnectPtr conn);
     typedef char* (*virConnectGetCapabilities_t)(virConnectPtr conn);
     typedef int (*virConnectGetVersion_t)(virConnectPtr conn, unsigned long* hvVer);
+    typedef int (*virConnectRef_t)(virConnectPtr conn);
+    typedef int (*virConnectIsAlive_t)(virConnectPtr conn);
+    typedef int (*virConnectSetKeepAlive_t)(virConnectPtr conn, int interval, unsigned int count);
+    typedef int (*virConnectDomainEventRegisterAny_t)(virConnectPtr conn, virDomainPtr dom, int eventID,
+                                                      virConnectDomainEventGenericCallback cb, void* opaque,
+                                                      virFreeCallback freecb);
+    typedef int (*virConnectDomainEventDeregisterAny_t)(virConnectPtr conn, int callbackID);
     typedef virNetworkPtr (*virNetworkLookupByName_t)(virConnectPtr conn, const char* name);
     typedef virNetworkPtr (*virNetworkCreateXML_t)(virConnectPtr conn, const char* xmlDesc);
     typedef int (*virNetworkDestroy_t)(virNetworkPtr network);
@@ -76,6 +83,8 @@ private:
     typedef char* (*virDomainGetXMLDesc_t)(virDomainPtr domain, unsigned int flags);
     typedef int (*virDomainDestroy_t)(virDomainPtr domain);
     typedef int (*virDomainFree_t)(virDomainPtr domain);
+    typedef int (*virDomainRef_t)(virDomainPtr domain);
+    typedef const char* (*virDomainGetName_t)(virDomainPtr domain);
     typedef virDomainPtr (*virDomainDefineXML_t)(virConnectPtr conn, const char* xml);
     typedef int (*virDomainGetState_t)(virDomainPtr domain, int* state, int* reason, unsigned int flags);
     typedef int (*virDomainCreate_t)(virDomainPtr domain);
@@ -85,6 +94,10 @@ private:
     typedef int (*virDomainSetVcpusFlags_t)(virDomainPtr domain, unsigned int nvcpus, unsigned int flags);
     typedef int (*virDomainSetMemoryFlags_t)(virDomainPtr domain, unsigned long memory, unsigned int flags);
     typedef const char* (*virGetLastErrorMessage_t)();
+    typedef int (*virEventRegisterDefaultImpl_t)();
+    typedef int (*virEventRunDefaultImpl_t)();
+    typedef int (*virEventAddTimeout_t)(int timeout, virEventTimeoutCallback cb, void* opaque, virFreeCallback ff);
+    typedef int (*virEventRemoveTimeout_t)(int timer);
 
     void* handle{nullptr};
 
@@ -98,6 +111,11 @@ public:
     virConnectClose_t virConnectClose;
     virConnectGetCapabilities_t virConnectGetCapabilities;
     virConnectGetVersion_t virConnectGetVersion;
+    virConnectRef_t virConnectRef;
+    virConnectIsAlive_t virConnectIsAlive;
+    virConnectSetKeepAlive_t virConnectSetKeepAlive;
+    virConnectDomainEventRegisterAny_t virConnectDomainEventRegisterAny;
+    virConnectDomainEventDeregisterAny_t virConnectDomainEventDeregisterAny;
     virNetworkLookupByName_t virNetworkLookupByName;
     virNetworkCreateXML_t virNetworkCreateXML;
     virNetworkDestroy_t virNetworkDestroy;
@@ -112,6 +130,8 @@ public:
     virDomainGetXMLDesc_t virDomainGetXMLDesc;
     virDomainDestroy_t virDomainDestroy;
     virDomainFree_t virDomainFree;
+    virDomainRef_t virDomainRef;
+    virDomainGetName_t virDomainGetName;
     virDomainDefineXML_t virDomainDefineXML;
     virDomainGetState_t virDomainGetState;
     virDomainCreate_t virDomainCreate;
@@ -121,6 +141,10 @@ public:
     virDomainSetVcpusFlags_t virDomainSetVcpusFlags;
     virDomainSetMemoryFlags_t virDomainSetMemoryFlags;
     virGetLastErrorMessage_t virGetLastErrorMessage;
+    virEventRegisterDefaultImpl_t virEventRegisterDefaultImpl;
+    virEventRunDefaultImpl_t virEventRunDefaultImpl;
+    virEventAddTimeout_t virEventAddTimeout;
+    virEventRemoveTimeout_t virEventRemoveTimeout;
 };
 } // namespace multipass
 
@@ -0,0 +1,335 @@
+/*
+ * Copyright (C) Canonical, Ltd.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; version 3.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#include "lxd_events.h"
+#include "lxd_request.h"
+
+#include <multipass/format.h>
+#include <multipass/logging/log.h>
+
+#include <QCryptographicHash>
+#include <QJsonArray>
+#include <QJsonDocument>
+#include <QLocalSocket>
+#include <QRandomGenerator>
+#include <QRegularExpression>
+#include <QStringList>
+#include <QtEndian>
+
+#include <algorithm>
+#include <vector>
+
+namespace mp = multipass;
+namespace mpl = multipass::logging;
+
+using namespace std::chrono_literals;
+
+namespace
+{
+constexpr auto category = "lxd events";
+constexpr auto connect_timeout = 5000; // ms
+constexpr auto read_interval = 500;    // ms, how soon the thread notices it is to stop
+constexpr auto max_retry_interval = 30s;
+constexpr auto max_message_size = 16 * 1024 * 1024;
+constexpr auto max_operations = 256; // finished ones are forgotten past this
+constexpr auto websocket_guid = "258EAFA5-E914-47DA-95CA-C5AB0DC85B11";
+
+enum class Opcode : char
+{
+    continuation = 0x0,
+    text = 0x1,
+    binary = 0x2,
+    close = 0x8,
+    ping = 0x9,
+    pong = 0xa
+};
+
+QByteArray random_bytes(int count)
+{
+    QByteArray bytes(count, '\0');
+    for (auto& byte : bytes)
+        byte = static_cast<char>(QRandomGenerator::global()->bounded(256));
+
+    return bytes;
+}
+
+// Clients mask all they send, control frames carry no more than 125 bytes
+void write_control_frame(QLocalSocket& socket, Opcode opcode, QByteArray payload)
+{
+    payload.truncate(125);
+    const auto mask = random_bytes(4);
+    for (auto i = 0; i < payload.size(); ++i)
+        payload[i] = static_cast<char>(payload.at(i) ^ mask.at(i % 4));
+
+    QByteArray frame;
+    frame.append(static_cast<char>(0x80 | static_cast<char>(opcode)));
+    frame.append(static_cast<char>(0x80 | payload.size()));
+    frame.append(mask);
+    frame.append(payload);
+
+    socket.write(frame);
+    socket.waitForBytesWritten(connect_timeout);
+}
+
+// The instances an event is about, from paths like /1.0/instances/<name>?project=multipass
+std::vector<std::string> instances_in(const QJsonObject& event)
+{
+    static const QRegularExpression path_re{"^/1\\.0/(?:instances|virtual-machines|containers)/([^/?]+)"};
+
+    QStringList paths;
+    const auto metadata = event["metadata"].toObject();
+    if (event["type"] == QStringLiteral("lifecycle"))
+        paths.append(metadata["source"].toString());
+
+    const auto resources = metadata["resources"].toObject();
+    for (const auto& key : {"instances", "virtual-machines", "containers"})
+        for (const auto& path : resources[key].toArray())
+            paths.append(path.toString());
+
+    std::vector<std::string> instances;
+    for (const auto& path : paths)
+        if (const auto match = path_re.match(path); match.hasMatch())
+            instances.push_back(match.captured(1).toStdString());
+
+    return instances;
+}
+} // namespace
+
+mp::LXDEvents::LXDEvents(const QUrl& base_url)
+    : socket_path{QUrl{base_url.toString().section('@', 0, 0)}.path()},
+      events_path{QString{"/%1/events?type=operation,lifecycle&project=%2"}
+                      .arg(base_url.toString().section('@', 1))
+                      .arg(lxd_project_name)},
+      thread{[this] { run(); }}
+{
+}
+
+mp::LXDEvents::~LXDEvents()
+{
+    {
+        std::lock_guard lock{mutex};
+        stopping = true;
+    }
+    changed.notify_all();
+    thread.join();
+}
+
+std::optional<std::uint64_t> mp::LXDEvents::mark() const
+{
+    std::lock_guard lock{mutex};
+    return connected_at ? std::make_optional(sequence) : std::nullopt;
+}
+
+bool mp::LXDEvents::unchanged_since(const QString& instance, std::uint64_t mark) const
+{
+    std::lock_guard lock{mutex};
+    if (!connected_at || connected_at > mark)
+        return false;
+
+    const auto it = instance_events.find(instance.toStdString());
+    return it == instance_events.end() || it->second <= mark;
+}
+
+std::optional<QJsonObject> mp::LXDEvents::wait_for_operation(const QString& id, std::uint64_t& seen,
+                                                             std::chrono::milliseconds timeout)
+{
+    std::unique_lock lock{mutex};
+
+    const auto key = id.toStdString();
+    auto reported = [this, &key, &seen] {
+        const auto it = operations.find(key);
+        return it != operations.end() && it->second.first > seen;
+    };
+
+    if (!changed.wait_for(lock, timeout, [this, &reported] { return !connected_at || reported(); }) || !reported())
+        return std::nullopt;
+
+    const auto& [reported_at, operation] = operations[key];
+    seen = reported_at;
+    return operation;
+}
+
+void mp::LXDEvents::run()
+{
+    auto retry_interval = 1s;
+    while (!stopping)
+    {
+        QLocalSocket socket;
+        QByteArray buffer;
+        socket.connectToServer(socket_path);
+        if (socket.waitForConnected(connect_timeout) && handshake(socket, buffer))
+        {
+            retry_interval = 1s;
+            {
+                std::lock_guard lock{mutex};
+                connected_at = ++sequence;
+            }
+            mpl::log(mpl::Level::debug, category, fmt::format("Following events on {}", socket_path));
+
+            follow(socket, buffer);
+
+            {
+                std::lock_guard lock{mutex};
+                connected_at = 0;
+            }
+            changed.notify_all();
+            mpl::log(mpl::Level::debug, category, fmt::format("Stopped following events on {}", socket_path));
+        }
+
+        std::unique_lock lock{mutex};
+        changed.wait_for(lock, retry_interval, [this] { return stopping.load(); });
+        retry_interval = std::min<std::chrono::seconds>(retry_interval * 2, max_retry_interval);
+    }
+}
+
+bool mp::LXDEvents::handshake(QLocalSocket& socket, QByteArray& buffer)
+{
+    const auto key = random_bytes(16).toBase64();
+    socket.write(QString{"GET %1 HTTP/1.1\r\n"
+                         "Host: %2\r\n"
+                         "Upgrade: websocket\r\n"
+                         "Connection: Upgrade\r\n"
+                         "Sec-WebSocket-Key: %3\r\n"
+                         "Sec-WebSocket-Version: 13\r\n\r\n"}
+                     .arg(events_path, lxd_project_name, QString{key})
+                     .toLatin1());
+    socket.waitForBytesWritten(connect_timeout);
+
+    auto headers_end = -1;
+    while ((headers_end = buffer.indexOf("\r\n\r\n")) < 0)
+    {
+        if ((!socket.bytesAvailable() && !socket.waitForReadyRead(connect_timeout)) ||
+            buffer.size() > max_message_size)
+            return false;
+        buffer.append(socket.readAll());
+    }
+
+    const auto headers = QString::fromLatin1(buffer.left(headers_end));
+    buffer.remove(0, headers_end + 4);
+
+    const auto accept = QCryptographicHash::hash(key + websocket_guid, QCryptographicHash::Sha1).toBase64();
+    if (!headers.startsWith("HTTP/1.1 101") || !headers.contains(QString{accept}))
+    {
+        mpl::log(mpl::Level::debug, category,
+                 fmt::format("Cannot follow events: {}", headers.section("\r\n", 0, 0).toStdString()));
+        return false;
+    }
+
+    return true;
+}
+
+void mp::LXDEvents::follow(QLocalSocket& socket, QByteArray& buffer)
+{
+    QByteArray message;
+    while (!stopping && socket.state() == QLocalSocket::ConnectedState)
+    {
+        // Frames: FIN and opcode, mask bit and length, extended length, mask, payload
+        while (buffer.size() >= 2)
+        {
+            const auto fin = buffer.at(0) & 0x80;
+            const auto opcode = static_cast<Opcode>(buffer.at(0) & 0x0f);
+            const auto masked = buffer.at(1) & 0x80;
+            qint64 length = buffer.at(1) & 0x7f;
+            auto header = 2;
+
+            if (length == 126)
+            {
+                if (buffer.size() < 4)
+                    break;
+                length = qFromBigEndian<quint16>(buffer.constData() + 2);
+                header = 4;
+            }
+            else if (length == 127)
+            {
+                if (buffer.size() < 10)
+                    break;
+                length = qFromBigEndian<quint64>(buffer.constData() + 2);
+                header = 10;
+            }
+
+            if (length < 0 || message.size() + length > max_message_size)
+            {
+                mpl::log(mpl::Level::warning, category, "Event too large, reconnecting");
+                return;
+            }
+
+            const auto mask_size = masked ? 4 : 0;
+            if (buffer.size() < header + mask_size + length)
+                break;
+
+            auto payload = buffer.mid(header + mask_size, length);
+            if (masked)
+                for (auto i = 0; i < payload.size(); ++i)
+                    payload[i] = static_cast<char>(payload.at(i) ^ buffer.at(header + i % 4));
+            buffer.remove(0, header + mask_size + length);
+
+            switch (opcode)
+            {
+            case Opcode::continuation:
+            case Opcode::text:
+            case Opcode::binary:
+                message.append(payload);
+                if (fin)
+                {
+                    handle(message);
+                    message.clear();
+                }
+                break;
+            case Opcode::ping:
+                write_control_frame(socket, Opcode::pong, payload);
+                break;
+            case Opcode::close:
+                write_control_frame(socket, Opcode::close, payload.left(2));
+                return;
+            default:
+                break;
+            }
+        }
+
+        if (socket.bytesAvailable() || socket.waitForReadyRead(read_interval))
+            buffer.append(socket.readAll());
+    }
+}
+
+void mp::LXDEvents::handle(const QByteArray& message)
+{
+    const auto event = QJsonDocument::fromJson(message).object();
+    if (event.isEmpty())
+        return;
+
+    mpl::log(mpl::Level::trace, category, fmt::format("Got event: {}", message));
+
+    {
+        std::lock_guard lock{mutex};
+        const auto at = ++sequence;
+
+        for (const auto& instance : instances_in(event))
+            instance_events[instance] = at;
+
+        if (event["type"] == QStringLiteral("operation"))
+        {
+            const auto operation = event["metadata"].toObject();
+            operations[operation["id"].toString().toStdString()] = {at, operation};
+
+            if (operations.size() > max_operations)
+                for (auto it = operations.begin(); it != operations.end();)
+                    it = it->second.second.value("status_code").toInt() >= 200 ? operations.erase(it) : std::next(it);
+        }
+    }
+
+    changed.notify_all();
+}
@@ -0,0 +1,80 @@
+/*
+ * Copyright (C) Canonical, Ltd.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; version 3.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#ifndef MULTIPASS_LXD_EVENTS_H
+#define MULTIPASS_LXD_EVENTS_H
+
+#include <multipass/disabled_copy_move.h>
+
+#include <QByteArray>
+#include <QJsonObject>
+#include <QString>
+#include <QUrl>
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <thread>
+#include <unordered_map>
+
+class QLocalSocket;
+
+namespace multipass
+{
+// Follows LXD's /1.0/events websocket on its own thread, reconnecting as needed, so that operations and instances
+// can be waited on rather than polled. Whoever asks while it is not connected is told so, to fall back on polling.
+class LXDEvents : private DisabledCopyMove
+{
+public:
+    explicit LXDEvents(const QUrl& base_url); // the unix:///path/to/socket@1.0 form, like lxd_socket_url
+    ~LXDEvents();
+
+    // Where things stand, for unchanged_since() to tell whether anything happened to instance later on. Nothing if
+    // not connected.
+    std::optional<std::uint64_t> mark() const;
+    bool unchanged_since(const QString& instance, std::uint64_t mark) const;
+
+    // Waits up to timeout for the operation to be reported after what was seen, then updated. Nothing on timeout or
+    // without a connection.
+    std::optional<QJsonObject> wait_for_operation(const QString& id, std::uint64_t& seen,
+                                                  std::chrono::milliseconds timeout);
+
+private:
+    void run();
+    bool handshake(QLocalSocket& socket, QByteArray& buffer);
+    void follow(QLocalSocket& socket, QByteArray& buffer);
+    void handle(const QByteArray& message);
+
+    const QString socket_path;
+    const QString events_path;
+    std::atomic_bool stopping{false};
+
+    mutable std::mutex mutex;
+    std::condition_variable changed;
+    std::uint64_t sequence{0};     // of events and connections
+    std::uint64_t connected_at{0}; // 0 while not connected
+    std::unordered_map<std::string, std::uint64_t> instance_events; // the last one touching each instance
+    std::unordered_map<std::string, std::pair<std::uint64_t, QJsonObject>> operations;
+
+    std::thread thread; // last, to start once everything else is set up
+};
+} // namespace multipass
+#endif // MULTIPASS_LXD_EVENTS_H
@@ -0,0 +1,101 @@
+/*
+ * Copyright (C) Canonical, Ltd.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; version 3.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#include "lxd_instance_templates.h"
+#include "lxd_request.h"
+
+#include <multipass/format.h>
+#include <multipass/logging/log.h>
+
+#include <QJsonObject>
+
+#include <algorithm>
+#include <array>
+
+namespace mp = multipass;
+namespace mpl = multipass::logging;
+
+namespace
+{
+constexpr auto category = "lxd templates";
+const QString template_prefix{"multipass-template-"};
+} // namespace
+
+mp::LXDInstanceTemplates::LXDInstanceTemplates(NetworkAccessManager* manager, const QUrl& base_url)
+    : manager{manager}, base_url{base_url}
+{
+}
+
+bool mp::LXDInstanceTemplates::pay_off_with(const QString& storage_driver)
+{
+    // The drivers LXD keeps optimized images with, where instances are snapshots of the image's volume
+    static const std::array<QString, 4> cloning_drivers{"btrfs", "ceph", "lvm", "zfs"};
+    return std::find(cloning_drivers.cbegin(), cloning_drivers.cend(), storage_driver) != cloning_drivers.cend();
+}
+
+QString mp::LXDInstanceTemplates::name_for(const QString& image_id)
+{
+    // Instance names are limited to 63 characters, and a short fingerprint is how LXD tells images apart too
+    return template_prefix + image_id.left(16);
+}
+
+QString mp::LXDInstanceTemplates::template_for(const std::string& image_id, const QString& storage_pool)
+{
+    const auto id = QString::fromStdString(image_id);
+    const auto name = name_for(id);
+
+    std::lock_guard lock{mutex};
+    try
+    {
+        lxd_request(manager, "GET", QUrl{QString{"%1/virtual-machines/%2"}.arg(base_url.toString()).arg(name)});
+    }
+    catch (const LXDNotFoundException&)
+    {
+        mpl::log(mpl::Level::info, category, fmt::format("Making template {} for image {}", name, image_id));
+
+        QJsonObject instance{
+            {"name", name},
+            {"description", "Template for Multipass instances, never started"},
+            {"devices", QJsonObject{{"root", QJsonObject{{"path", "/"}, {"pool", storage_pool}, {"type", "disk"}}}}},
+            {"source", QJsonObject{{"type", "image"}, {"fingerprint", id}}}};
+
+        auto json_reply =
+            lxd_request(manager, "POST", QUrl{QString{"%1/virtual-machines"}.arg(base_url.toString())}, instance);
+        lxd_wait(manager, base_url, json_reply, 600000);
+    }
+
+    return name;
+}
+
+void mp::LXDInstanceTemplates::remove_for(const QString& image_id)
+{
+    const auto name = name_for(image_id);
+
+    std::lock_guard lock{mutex};
+    try
+    {
+        auto json_reply = lxd_request(manager, "DELETE",
+                                      QUrl{QString{"%1/virtual-machines/%2"}.arg(base_url.toString()).arg(name)});
+        lxd_wait(manager, base_url, json_reply, 300000);
+
+        mpl::log(mpl::Level::debug, category, fmt::format("Removed template {}", name));
+    }
+    catch (const LXDNotFoundException&)
+    {
+        // Never made, the pool did not call for it
+    }
+}
@@ -0,0 +1,54 @@
+/*
+ * Copyright (C) Canonical, Ltd.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; version 3.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#ifndef MULTIPASS_LXD_INSTANCE_TEMPLATES_H
+#define MULTIPASS_LXD_INSTANCE_TEMPLATES_H
+
+#include <multipass/disabled_copy_move.h>
+
+#include <QString>
+#include <QUrl>
+
+#include <mutex>
+#include <string>
+
+namespace multipass
+{
+class NetworkAccessManager;
+
+// Stopped instances made once for each image, never started, for new instances to be copied from. It only pays off on
+// pools that keep images optimized (as volumes of their own), where such a copy is a copy-on-write clone rather than
+// the image being unpacked again.
+class LXDInstanceTemplates : private DisabledCopyMove
+{
+public:
+    LXDInstanceTemplates(NetworkAccessManager* manager, const QUrl& base_url);
+
+    static bool pay_off_with(const QString& storage_driver);
+    static QString name_for(const QString& image_id);
+
+    // The template for the image, made on the storage pool first if need be
+    QString template_for(const std::string& image_id, const QString& storage_pool);
+    void remove_for(const QString& image_id); // once the image is gone, nothing if there is no template
+
+private:
+    NetworkAccessManager* const manager;
+    const QUrl base_url;
+    std::mutex mutex; // not to make the same template twice, when launching several instances of one image
+};
+} // namespace multipass
+#endif // MULTIPASS_LXD_INSTANCE_TEMPLATES_H
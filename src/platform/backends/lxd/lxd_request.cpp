@@ -27,6 +27,8 @@
 #include <QNetworkReply>
 #include <QTimer>
 
+#include <exception>
+
 namespace mp = multipass;
 namespace mpl = multipass::logging;
 
@@ -34,13 +36,8 @@ namespace
 {
 constexpr auto request_category = "lxd request";
 
-template <typename Callable>
-const QJsonObject lxd_request_common(const std::string& method, QUrl& url, int timeout, Callable&& handle_request)
+QNetworkRequest make_request(const std::string& method, QUrl& url)
 {
-    QEventLoop event_loop;
-    QTimer download_timeout;
-    download_timeout.setInterval(timeout);
-
     if (url.host().isEmpty())
     {
         url.setHost(mp::lxd_project_name);
@@ -61,22 +58,28 @@ const QJsonObject lxd_request_common(const std::string& method, QUrl& url, int t
 
     request.setHeader(QNetworkRequest::UserAgentHeader, QString("Multipass/%1").arg(mp::version_string));
 
-    auto verb = QByteArray::fromStdString(method);
+    return request;
+}
 
-    auto reply = handle_request(request, verb);
+QNetworkReply* send_json(mp::NetworkAccessManager* manager, QNetworkRequest& request, const QByteArray& verb,
+                         const std::optional<QJsonObject>& json_data)
+{
+    QByteArray data;
+    if (json_data)
+    {
+        data = QJsonDocument(*json_data).toJson(QJsonDocument::Compact);
 
-    QObject::connect(reply, &QNetworkReply::finished, &event_loop, &QEventLoop::quit);
-    QObject::connect(&download_timeout, &QTimer::timeout, [&]() {
-        download_timeout.stop();
-        reply->abort();
-    });
+        request.setHeader(QNetworkRequest::ContentTypeHeader, "application/json");
+        request.setHeader(QNetworkRequest::ContentLengthHeader, QByteArray::number(data.size()));
 
-    if (!reply->isFinished())
-    {
-        download_timeout.start();
-        event_loop.exec();
+        mpl::log(mpl::Level::trace, request_category, fmt::format("Sending data: {}", data));
     }
 
+    return manager->sendCustomRequest(request, verb, data);
+}
+
+const QJsonObject json_from(QNetworkReply* reply, const std::string& method, const QUrl& url)
+{
     if (reply->error() == QNetworkReply::ContentNotFoundError)
         throw mp::LXDNotFoundException();
 
@@ -118,6 +121,33 @@ const QJsonObject lxd_request_common(const std::string& method, QUrl& url, int t
 
     return json_reply.object();
 }
+
+template <typename Callable>
+const QJsonObject lxd_request_common(const std::string& method, QUrl& url, int timeout, Callable&& handle_request)
+{
+    QEventLoop event_loop;
+    QTimer download_timeout;
+    download_timeout.setInterval(timeout);
+
+    auto request = make_request(method, url);
+    auto verb = QByteArray::fromStdString(method);
+
+    auto reply = handle_request(request, verb);
+
+    QObject::connect(reply, &QNetworkReply::finished, &event_loop, &QEventLoop::quit);
+    QObject::connect(&download_timeout, &QTimer::timeout, [&]() {
+        download_timeout.stop();
+        reply->abort();
+    });
+
+    if (!reply->isFinished())
+    {
+        download_timeout.start();
+        event_loop.exec();
+    }
+
+    return json_from(reply, method, url);
+}
 } // namespace
 
 const QJsonObject mp::lxd_request(mp::NetworkAccessManager* manager, const std::string& method, QUrl url,
@@ -125,18 +155,7 @@ const QJsonObject mp::lxd_request(mp::NetworkAccessManager* manager, const std::
 try
 {
     auto handle_request = [manager, &json_data](QNetworkRequest& request, const QByteArray& verb) {
-        QByteArray data;
-        if (json_data)
-        {
-            data = QJsonDocument(*json_data).toJson(QJsonDocument::Compact);
-
-            request.setHeader(QNetworkRequest::ContentTypeHeader, "application/json");
-            request.setHeader(QNetworkRequest::ContentLengthHeader, QByteArray::number(data.size()));
-
-            mpl::log(mpl::Level::trace, request_category, fmt::format("Sending data: {}", data));
-        }
-
-        return manager->sendCustomRequest(request, verb, data);
+        return send_json(manager, request, verb, json_data);
     };
 
     return lxd_request_common(method, url, timeout, handle_request);
@@ -167,6 +186,87 @@ catch (const LXDRuntimeError& e)
     throw;
 }
 
+struct mp::LXDPendingReply::Outcome
+{
+    QJsonObject json_reply;
+    std::exception_ptr error;
+    bool done{false};
+    QEventLoop* waiting{nullptr};
+};
+
+mp::LXDPendingReply::LXDPendingReply(std::shared_ptr<Outcome> outcome) : outcome{std::move(outcome)}
+{
+}
+
+const QJsonObject mp::LXDPendingReply::wait()
+{
+    if (!outcome->done)
+    {
+        QEventLoop event_loop;
+        outcome->waiting = &event_loop;
+        event_loop.exec();
+        outcome->waiting = nullptr;
+    }
+
+    if (outcome->error)
+        std::rethrow_exception(outcome->error);
+
+    return outcome->json_reply;
+}
+
+bool mp::LXDPendingReply::is_done() const
+{
+    return outcome->done;
+}
+
+mp::LXDPendingReply mp::lxd_request_async(mp::NetworkAccessManager* manager, const std::string& method, QUrl url,
+                                          const std::optional<QJsonObject>& json_data, int timeout)
+{
+    auto request = make_request(method, url);
+    auto reply = send_json(manager, request, QByteArray::fromStdString(method), json_data);
+    auto outcome = std::make_shared<LXDPendingReply::Outcome>();
+
+    // Only once, a reply that is aborted may still report the end of its socket after that
+    auto collect = [reply, method, url, outcome] {
+        if (outcome->done)
+            return;
+
+        try
+        {
+            outcome->json_reply = json_from(reply, method, url);
+        }
+        catch (const LXDRuntimeError& e)
+        {
+            mpl::log(mpl::Level::error, request_category, e.what());
+            outcome->error = std::current_exception();
+        }
+        catch (...)
+        {
+            outcome->error = std::current_exception();
+        }
+
+        reply->deleteLater();
+        outcome->done = true;
+        if (outcome->waiting)
+            outcome->waiting->quit();
+    };
+
+    if (reply->isFinished())
+    {
+        collect();
+    }
+    else
+    {
+        auto request_timeout = new QTimer{reply};
+        request_timeout->setSingleShot(true);
+        QObject::connect(request_timeout, &QTimer::timeout, reply, &QNetworkReply::abort);
+        QObject::connect(reply, &QNetworkReply::finished, reply, collect);
+        request_timeout->start(timeout);
+    }
+
+    return LXDPendingReply{outcome};
+}
+
 const QJsonObject mp::lxd_wait(mp::NetworkAccessManager* manager, const QUrl& base_url, const QJsonObject& task_data,
                                int timeout)
 try
@@ -22,6 +22,7 @@
 #include <QJsonObject>
 #include <QUrl>
 
+#include <memory>
 #include <optional>
 #include <string>
 
@@ -63,6 +64,28 @@ const QJsonObject lxd_request(NetworkAccessManager* manager, const std::string&
 const QJsonObject lxd_request(NetworkAccessManager* manager, const std::string& method, QUrl url,
                               QHttpMultiPart& multi_part, int timeout = 30000 /* in milliseconds */);
 
+// A request sent without waiting for its reply, so that several can be in flight at once (each gets a connection of
+// its own to the socket). The reply is collected as events are processed, whoever waits on it or not.
+class LXDPendingReply
+{
+public:
+    const QJsonObject wait(); // processes events until the reply is in; throws what lxd_request() would
+    bool is_done() const;
+
+private:
+    friend LXDPendingReply lxd_request_async(NetworkAccessManager* manager, const std::string& method, QUrl url,
+                                             const std::optional<QJsonObject>& json_data, int timeout);
+
+    struct Outcome;
+    explicit LXDPendingReply(std::shared_ptr<Outcome> outcome);
+
+    std::shared_ptr<Outcome> outcome;
+};
+
+LXDPendingReply lxd_request_async(NetworkAccessManager* manager, const std::string& method, QUrl url,
+                                  const std::optional<QJsonObject>& json_data = std::nullopt,
+                                  int timeout = 30000 /* in milliseconds */);
+
 const QJsonObject lxd_wait(NetworkAccessManager* manager, const QUrl& base_url, const QJsonObject& task_data,
                            int timeout /* in milliseconds */);
 } // namespace multipass
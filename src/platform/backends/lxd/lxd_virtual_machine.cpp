@@ -16,17 +16,21 @@
  */
 
 #include "lxd_virtual_machine.h"
+#include "lxd_events.h"
+#include "lxd_instance_templates.h"
 #include "lxd_mount_handler.h"
 #include "lxd_request.h"
 
 #include <QJsonArray>
 #include <QJsonDocument>
+#include <QThread>
 
 #include <multipass/exceptions/local_socket_connection_exception.h>
 #include <multipass/exceptions/snap_environment_exception.h>
 #include <multipass/exceptions/start_exception.h>
 #include <multipass/format.h>
 #include <multipass/logging/log.h>
+#include <multipass/logging/tracer.h>
 #include <multipass/memory_size.h>
 #include <multipass/network_access_manager.h>
 #include <multipass/snap_utils.h>
@@ -37,6 +41,7 @@
 
 #include <shared/shared_backend_utils.h>
 
+#include <algorithm>
 #include <chrono>
 #include <thread>
 
@@ -48,10 +53,8 @@ using namespace std::literals::chrono_literals;
 
 namespace
 {
-auto instance_state_for(const QString& name, mp::NetworkAccessManager* manager, const QUrl& url)
+mp::VirtualMachine::State state_from(const QString& name, const QJsonObject& metadata)
 {
-    auto json_reply = lxd_request(manager, "GET", url);
-    auto metadata = json_reply["metadata"].toObject();
     mpl::log(mpl::Level::trace, name.toStdString(),
              fmt::format("Got LXD container state: {} is {}", name, metadata["status"].toString()));
 
@@ -82,6 +85,12 @@ auto instance_state_for(const QString& name, mp::NetworkAccessManager* manager,
     }
 }
 
+auto instance_state_for(const QString& name, mp::NetworkAccessManager* manager, const QUrl& url)
+{
+    auto json_reply = lxd_request(manager, "GET", url);
+    return state_from(name, json_reply["metadata"].toObject());
+}
+
 std::optional<mp::IPAddress> get_ip_for(const QString& mac_addr, mp::NetworkAccessManager* manager, const QUrl& url)
 {
     const auto json_leases = lxd_request(manager, "GET", url);
@@ -154,6 +163,23 @@ QJsonObject generate_devices_config(const multipass::VirtualMachineDescription&
     return devices;
 }
 
+// Limits are kept as LXD takes them, a number and its unit
+constexpr auto network_limit_unit = "Mbit", disk_iops_unit = "iops";
+
+int limit_from(const QString& value, const QString& unit)
+{
+    return value.endsWith(unit) ? value.chopped(unit.size()).toInt() : 0;
+}
+
+void set_limit(QJsonObject& device, const QStringList& keys, int limit, const QString& unit)
+{
+    for (const auto& key : keys)
+        if (limit)
+            device.insert(key, QString::number(limit) + unit);
+        else
+            device.remove(key);
+}
+
 bool uses_default_id_mappings(const multipass::VMMount& mount)
 {
     const auto& gid_mappings = mount.gid_mappings;
@@ -168,7 +194,8 @@ bool uses_default_id_mappings(const multipass::VMMount& mount)
 
 mp::LXDVirtualMachine::LXDVirtualMachine(const VirtualMachineDescription& desc, VMStatusMonitor& monitor,
                                          NetworkAccessManager* manager, const QUrl& base_url,
-                                         const QString& bridge_name, const QString& storage_pool)
+                                         const QString& bridge_name, const QString& storage_pool,
+                                         LXDEvents* events, LXDInstanceTemplates* templates)
     : BaseVirtualMachine{desc.vm_name},
       name{QString::fromStdString(desc.vm_name)},
       username{desc.ssh_username},
@@ -177,7 +204,8 @@ mp::LXDVirtualMachine::LXDVirtualMachine(const VirtualMachineDescription& desc,
       base_url{base_url},
       bridge_name{bridge_name},
       mac_addr{QString::fromStdString(desc.default_mac_address)},
-      storage_pool{storage_pool}
+      storage_pool{storage_pool},
+      events{events}
 {
     try
     {
@@ -188,11 +216,27 @@ mp::LXDVirtualMachine::LXDVirtualMachine(const VirtualMachineDescription& desc,
         mpl::log(mpl::Level::debug, name.toStdString(),
                  fmt::format("Creating instance with image id: {}", desc.image.id));
 
-        QJsonObject virtual_machine{
-            {"name", name},
-            {"config", generate_base_vm_config(desc)},
-            {"devices", generate_devices_config(desc, mac_addr, storage_pool)},
-            {"source", QJsonObject{{"type", "image"}, {"fingerprint", QString::fromStdString(desc.image.id)}}}};
+        QJsonObject source{{"type", "image"}, {"fingerprint", QString::fromStdString(desc.image.id)}};
+        if (templates)
+        {
+            try
+            {
+                // Config and devices given here take precedence over the template's
+                source = QJsonObject{{"type", "copy"},
+                                     {"source", templates->template_for(desc.image.id, storage_pool)},
+                                     {"instance_only", true}};
+            }
+            catch (const std::exception& e)
+            {
+                mpl::log(mpl::Level::warning, vm_name,
+                         fmt::format("Cannot clone from a template, creating from the image instead: {}", e.what()));
+            }
+        }
+
+        QJsonObject virtual_machine{{"name", name},
+                                    {"config", generate_base_vm_config(desc)},
+                                    {"devices", generate_devices_config(desc, mac_addr, storage_pool)},
+                                    {"source", source}};
 
         auto json_reply = lxd_request(manager, "POST", QUrl(QString("%1/virtual-machines").arg(base_url.toString())),
                                       virtual_machine);
@@ -239,6 +283,7 @@ mp::LXDVirtualMachine::~LXDVirtualMachine()
 
 void mp::LXDVirtualMachine::start()
 {
+    mpl::TraceSpan span{"start", vm_name};
     if (state == State::suspended)
     {
         mpl::log(mpl::Level::info, vm_name, fmt::format("Resuming from a suspended state"));
@@ -299,7 +344,13 @@ mp::VirtualMachine::State mp::LXDVirtualMachine::current_state()
 {
     try
     {
+        const auto mark = events ? events->mark() : std::nullopt; // taken first, not to miss what happens meanwhile
         auto present_state = instance_state_for(name, manager, state_url());
+        state_fetched();
+        {
+            std::lock_guard lock{event_mark_mutex};
+            event_mark = mark;
+        }
 
         if ((state == State::delayed_shutdown || state == State::starting) && present_state == State::running)
             return state;
@@ -315,6 +366,62 @@ mp::VirtualMachine::State mp::LXDVirtualMachine::current_state()
     return state;
 }
 
+mp::VirtualMachine::State mp::LXDVirtualMachine::cached_state()
+{
+    return state_is_stale() ? current_state() : state;
+}
+
+bool mp::LXDVirtualMachine::state_is_stale()
+{
+    // Without events about the instance since it was fetched, what was fetched still stands, however long ago
+    if (events)
+    {
+        std::lock_guard lock{event_mark_mutex};
+        if (event_mark && events->unchanged_since(name, *event_mark))
+            return false;
+    }
+
+    return !state_is_fresh();
+}
+
+void mp::LXDVirtualMachine::refresh_from(const QJsonObject& instance, std::optional<std::uint64_t> mark)
+{
+    const auto instance_state = instance["state"].toObject();
+    const auto present_state = state_from(name, instance_state);
+    state_fetched();
+    {
+        std::lock_guard lock{event_mark_mutex};
+        event_mark = mark;
+    }
+
+    if (!((state == State::delayed_shutdown || state == State::starting) && present_state == State::running))
+        state = present_state;
+
+    // The instance reports the addresses of its interfaces, the management one being that with our MAC
+    for (const auto& network : instance_state["network"].toObject())
+    {
+        if (network.toObject()["hwaddr"].toString() != mac_addr)
+            continue;
+
+        for (const auto& address : network.toObject()["addresses"].toArray())
+        {
+            if (address.toObject()["family"] == QStringLiteral("inet") &&
+                address.toObject()["scope"] == QStringLiteral("global"))
+            {
+                try
+                {
+                    management_ip = IPAddress{address.toObject()["address"].toString().toStdString()};
+                    return;
+                }
+                catch (const std::invalid_argument&)
+                {
+                    continue;
+                }
+            }
+        }
+    }
+}
+
 int mp::LXDVirtualMachine::ssh_port()
 {
     return 22;
@@ -385,6 +492,40 @@ std::string mp::LXDVirtualMachine::ipv6()
     return {};
 }
 
+// What lxd-agent tells LXD about the guest's network, rather than asking with SSH
+std::optional<std::vector<std::string>> mp::LXDVirtualMachine::guest_ipv4()
+try
+{
+    // info asks from threads of its own, where the manager of the daemon's cannot be used
+    std::optional<NetworkAccessManager> own_manager;
+    if (manager->thread() != QThread::currentThread())
+        own_manager.emplace();
+
+    const auto network = lxd_request(own_manager ? &*own_manager : manager, "GET", state_url())["metadata"]
+                             .toObject()["network"]
+                             .toObject();
+    if (network.isEmpty())
+        return std::nullopt; // the agent is not up in the guest
+
+    std::vector<std::string> addresses;
+    for (auto it = network.constBegin(); it != network.constEnd(); ++it)
+    {
+        if (it.key() == "lo")
+            continue;
+
+        for (const auto& address : it.value().toObject()["addresses"].toArray())
+            if (address["family"].toString() == "inet" && address["scope"].toString() == "global")
+                addresses.push_back(address["address"].toString().toStdString());
+    }
+
+    return addresses;
+}
+catch (const std::exception& e)
+{
+    mpl::log(mpl::Level::debug, name.toStdString(), fmt::format("Could not get addresses from LXD: {}", e.what()));
+    return std::nullopt;
+}
+
 void mp::LXDVirtualMachine::wait_until_ssh_up(std::chrono::milliseconds timeout)
 {
     mpu::wait_until_ssh_up(this, timeout, [this] { ensure_vm_is_running(); });
@@ -465,9 +606,108 @@ void mp::LXDVirtualMachine::resize_disk(const MemorySize& new_size)
      *        --unix-socket /var/snap/lxd/common/lxd/unix.socket \
      *        lxd/1.0/virtual-machines/asdf?project=multipass
      */
-    QJsonObject root_json{
-        {"path", "/"}, {"pool", storage_pool}, {"size", QString::number(new_size.in_bytes())}, {"type", "disk"}};
-    QJsonObject patch_json{{"devices", QJsonObject{{"root", root_json}}}};
+    patch_device("root", [this, &new_size](QJsonObject& root) {
+        root.insert("path", "/");
+        root.insert("pool", storage_pool);
+        root.insert("size", QString::number(new_size.in_bytes()));
+        root.insert("type", "disk");
+    });
+}
+
+bool mp::LXDVirtualMachine::online_disk_resize()
+{
+    return true; // LXD grows the volume of a running VM in place, the guest's cloud-init grows into it when it boots
+}
+
+int mp::LXDVirtualMachine::network_limit()
+{
+    return limit_from(device("eth0")["limits.egress"].toString(), network_limit_unit);
+}
+
+void mp::LXDVirtualMachine::set_network_limit(int mbits)
+{
+    /*
+     * similar to:
+     * $ curl -s -w "%{http_code}\n" -X PATCH -H "Content-Type: application/json" \
+     *        -d '{"devices": {"eth0": {..., "limits.ingress": "100Mbit", "limits.egress": "100Mbit"}}}' \
+     *        --unix-socket /var/snap/lxd/common/lxd/unix.socket \
+     *        lxd/1.0/virtual-machines/asdf?project=multipass
+     */
+    patch_device("eth0", [mbits](QJsonObject& eth0) {
+        set_limit(eth0, {"limits.ingress", "limits.egress"}, mbits, network_limit_unit);
+    });
+}
+
+int mp::LXDVirtualMachine::disk_iops_limit()
+{
+    return limit_from(device("root")["limits.read"].toString(), disk_iops_unit);
+}
+
+void mp::LXDVirtualMachine::set_disk_iops_limit(int iops)
+{
+    patch_device("root", [iops](QJsonObject& root) {
+        set_limit(root, {"limits.read", "limits.write"}, iops, disk_iops_unit);
+    });
+}
+
+void mp::LXDVirtualMachine::take_snapshot(const std::string& name)
+{
+    assert(manager);
+
+    // Copy-on-write on the storage pools that can, like instances are of their images
+    const QJsonObject snapshot_json{{"name", QString::fromStdString(name)}, {"stateful", false}};
+    auto task = lxd_request(manager, "POST", QUrl{url().toString() + "/snapshots"}, snapshot_json);
+    lxd_wait(manager, base_url, task, 600000);
+}
+
+void mp::LXDVirtualMachine::restore_snapshot(const std::string& name)
+{
+    assert(manager);
+
+    const QJsonObject restore_json{{"restore", QString::fromStdString(name)}};
+    auto task = lxd_request(manager, "PUT", url(), restore_json);
+    lxd_wait(manager, base_url, task, 600000);
+}
+
+std::vector<std::string> mp::LXDVirtualMachine::list_snapshots()
+{
+    assert(manager);
+
+    // The metadata lists them as URLs, ending in their names
+    std::vector<std::string> names;
+    auto json_reply = lxd_request(manager, "GET", QUrl{url().toString() + "/snapshots"});
+    for (const auto& snapshot_url : json_reply["metadata"].toArray())
+        names.push_back(snapshot_url.toString().section('/', -1).toStdString());
+
+    std::sort(names.begin(), names.end());
+    return names;
+}
+
+void mp::LXDVirtualMachine::delete_snapshot(const std::string& name)
+{
+    assert(manager);
+
+    auto task = lxd_request(manager, "DELETE", QUrl{url().toString() + "/snapshots/" + QString::fromStdString(name)});
+    lxd_wait(manager, base_url, task, 600000);
+}
+
+QJsonObject mp::LXDVirtualMachine::device(const QString& device_name)
+{
+    assert(manager);
+
+    // One of the instance's own or, failing that, what a profile gives it
+    const auto metadata = lxd_request(manager, "GET", url())["metadata"].toObject();
+    const auto devices = metadata["devices"].toObject();
+    return (devices.contains(device_name) ? devices : metadata["expanded_devices"].toObject())[device_name].toObject();
+}
+
+// A device is replaced as a whole, so it is patched from what it is now
+void mp::LXDVirtualMachine::patch_device(const QString& device_name, const std::function<void(QJsonObject&)>& change)
+{
+    auto device_json = device(device_name);
+    change(device_json);
+
+    QJsonObject patch_json{{"devices", QJsonObject{{device_name, device_json}}}};
     lxd_request(manager, "PATCH", url(), patch_json);
 }
 
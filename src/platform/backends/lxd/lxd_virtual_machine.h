@@ -24,8 +24,15 @@
 
 #include <shared/base_virtual_machine.h>
 
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <optional>
+
 namespace multipass
 {
+class LXDEvents;
+class LXDInstanceTemplates;
 class NetworkAccessManager;
 class VirtualMachineDescription;
 class VMStatusMonitor;
@@ -34,18 +41,21 @@ class LXDVirtualMachine : public BaseVirtualMachine
 {
 public:
     LXDVirtualMachine(const VirtualMachineDescription& desc, VMStatusMonitor& monitor, NetworkAccessManager* manager,
-                      const QUrl& base_url, const QString& bridge_name, const QString& storage_pool);
+                      const QUrl& base_url, const QString& bridge_name, const QString& storage_pool,
+                      LXDEvents* events = nullptr, LXDInstanceTemplates* templates = nullptr);
     ~LXDVirtualMachine() override;
     void stop() override;
     void start() override;
     void shutdown() override;
     void suspend() override;
     State current_state() override;
+    State cached_state() override;
     int ssh_port() override;
     std::string ssh_hostname(std::chrono::milliseconds timeout) override;
     std::string ssh_username() override;
     std::string management_ipv4() override;
     std::string ipv6() override;
+    std::optional<std::vector<std::string>> guest_ipv4() override;
     void ensure_vm_is_running() override;
     void ensure_vm_is_running(const std::chrono::milliseconds& timeout);
     void wait_until_ssh_up(std::chrono::milliseconds timeout) override;
@@ -53,9 +63,23 @@ public:
     void update_cpus(int num_cores) override;
     void resize_memory(const MemorySize& new_size) override;
     void resize_disk(const MemorySize& new_size) override;
+    bool online_disk_resize() override;
+    int network_limit() override;
+    void set_network_limit(int mbits) override;
+    int disk_iops_limit() override;
+    void set_disk_iops_limit(int iops) override;
+    void take_snapshot(const std::string& name) override;
+    void restore_snapshot(const std::string& name) override;
+    std::vector<std::string> list_snapshots() override;
+    void delete_snapshot(const std::string& name) override;
     std::unique_ptr<MountHandler> make_native_mount_handler(const SSHKeyProvider* ssh_key_provider,
                                                             const std::string& target, const VMMount& mount) override;
 
+    // For the factory to refresh all instances at once, from one in a recursive listing and where events stood
+    // before asking for it
+    bool state_is_stale(); // cached_state() would have to ask LXD
+    void refresh_from(const QJsonObject& instance, std::optional<std::uint64_t> mark);
+
 private:
     const QString name;
     const std::string username;
@@ -67,11 +91,16 @@ private:
     const QString bridge_name;
     const QString mac_addr;
     const QString storage_pool;
+    LXDEvents* const events;
+    std::mutex event_mark_mutex;
+    std::optional<std::uint64_t> event_mark; // where events stood when state was last fetched
 
     const QUrl url();
     const QUrl state_url();
     const QUrl network_leases_url();
     void request_state(const QString& new_state);
+    QJsonObject device(const QString& device_name);
+    void patch_device(const QString& device_name, const std::function<void(QJsonObject&)>& change);
 };
 } // namespace multipass
 #endif // MULTIPASS_LXD_VIRTUAL_MACHINE_H
@@ -30,9 +30,14 @@
 #include <multipass/snap_utils.h>
 #include <multipass/utils.h>
 
+#include <QJsonArray>
 #include <QJsonDocument>
 #include <QJsonObject>
 
+#include <optional>
+#include <unordered_map>
+#include <vector>
+
 namespace mp = multipass;
 namespace mpl = multipass::logging;
 namespace mu = multipass::utils;
@@ -85,15 +90,18 @@ mp::NetworkInterfaceInfo munch_network(std::map<std::string, mp::NetworkInterfac
 } // namespace
 
 mp::LXDVirtualMachineFactory::LXDVirtualMachineFactory(NetworkAccessManager::UPtr manager, const mp::Path& data_dir,
-                                                       const QUrl& base_url)
+                                                       const QUrl& base_url, std::unique_ptr<LXDEvents> events)
     : manager{std::move(manager)},
+      events{std::move(events)},
       data_dir{MP_UTILS.make_dir(data_dir, get_backend_directory_name())},
-      base_url{base_url}
+      base_url{base_url},
+      templates{this->manager.get(), base_url}
 {
 }
 
 mp::LXDVirtualMachineFactory::LXDVirtualMachineFactory(const mp::Path& data_dir, const QUrl& base_url)
-    : LXDVirtualMachineFactory(std::make_unique<NetworkAccessManager>(), data_dir, base_url)
+    : LXDVirtualMachineFactory(std::make_unique<NetworkAccessManager>(), data_dir, base_url,
+                               std::make_unique<LXDEvents>(base_url))
 {
 }
 
@@ -101,7 +109,8 @@ mp::VirtualMachine::UPtr mp::LXDVirtualMachineFactory::create_virtual_machine(co
                                                                               VMStatusMonitor& monitor)
 {
     return std::make_unique<mp::LXDVirtualMachine>(desc, monitor, manager.get(), base_url, multipass_bridge_name,
-                                                   storage_pool);
+                                                   storage_pool, events.get(),
+                                                   clone_from_templates ? &templates : nullptr);
 }
 
 void mp::LXDVirtualMachineFactory::remove_resources_for(const std::string& name)
@@ -129,10 +138,17 @@ void mp::LXDVirtualMachineFactory::configure(VirtualMachineDescription& /*vm_des
 void mp::LXDVirtualMachineFactory::hypervisor_health_check()
 {
     QJsonObject reply;
+    std::optional<LXDPendingReply> project_reply;
 
     try
     {
-        reply = lxd_request(manager.get(), "GET", base_url);
+        // The project is asked for along with the server, pools and the bridge only once the project they are asked
+        // in is sure to be there
+        auto server_reply = lxd_request_async(manager.get(), "GET", base_url);
+        project_reply = lxd_request_async(
+            manager.get(), "GET", QUrl(QString("%1/projects/%2").arg(base_url.toString()).arg(lxd_project_name)));
+
+        reply = server_reply.wait();
     }
     catch (const LocalSocketConnectionException& e)
     {
@@ -154,8 +170,7 @@ void mp::LXDVirtualMachineFactory::hypervisor_health_check()
 
     try
     {
-        lxd_request(manager.get(), "GET",
-                    QUrl(QString("%1/projects/%2").arg(base_url.toString()).arg(lxd_project_name)));
+        project_reply->wait();
     }
     catch (const LXDNotFoundException&)
     {
@@ -164,15 +179,29 @@ void mp::LXDVirtualMachineFactory::hypervisor_health_check()
         lxd_request(manager.get(), "POST", QUrl(QString("%1/projects").arg(base_url.toString())), project);
     }
 
+    // The candidate pools and the bridge are looked up all at once, rather than one after the other
     const QStringList pools_to_try{{"multipass", "default"}};
+    std::vector<LXDPendingReply> pool_replies;
     for (const auto& pool : pools_to_try)
+        pool_replies.push_back(lxd_request_async(
+            manager.get(), "GET", QUrl(QString("%1/storage-pools/%2").arg(base_url.toString()).arg(pool))));
+
+    auto network_reply = lxd_request_async(
+        manager.get(), "GET", QUrl(QString("%1/networks/%2").arg(base_url.toString()).arg(multipass_bridge_name)));
+
+    for (auto i = 0; i < pools_to_try.size(); ++i)
     {
         try
         {
-            lxd_request(manager.get(), "GET", QUrl(QString("%1/storage-pools/%2").arg(base_url.toString()).arg(pool)));
+            const auto pool_reply = pool_replies[i].wait();
+
+            storage_pool = pools_to_try[i];
+            mpl::log(mpl::Level::debug, category, fmt::format("Using the \'{}\' storage pool.", storage_pool));
 
-            storage_pool = pool;
-            mpl::log(mpl::Level::debug, category, fmt::format("Using the \'{}\' storage pool.", pool));
+            // New instances are clones of a template on pools that keep images optimized, rather than copies of the
+            // image each unpacked anew
+            clone_from_templates =
+                LXDInstanceTemplates::pay_off_with(pool_reply["metadata"].toObject()["driver"].toString());
 
             break;
         }
@@ -186,6 +215,7 @@ void mp::LXDVirtualMachineFactory::hypervisor_health_check()
     if (storage_pool.isEmpty())
     {
         storage_pool = "multipass";
+        clone_from_templates = false;
         mpl::log(mpl::Level::info, category, "No storage pool found for multpass: creating…");
         QJsonObject pool_config{
             {"description", "Storage pool for Multipass"}, {"name", storage_pool}, {"driver", "dir"}};
@@ -194,8 +224,7 @@ void mp::LXDVirtualMachineFactory::hypervisor_health_check()
 
     try
     {
-        lxd_request(manager.get(), "GET",
-                    QUrl(QString("%1/networks/%2").arg(base_url.toString()).arg(multipass_bridge_name)));
+        network_reply.wait();
     }
     catch (const LXDNotFoundException&)
     {
@@ -216,14 +245,20 @@ mp::VMImageVault::UPtr mp::LXDVirtualMachineFactory::create_image_vault(std::vec
                                                                         mp::URLDownloader* downloader,
                                                                         const mp::Path& cache_dir_path,
                                                                         const mp::Path& data_dir_path,
-                                                                        const mp::days& days_to_expire)
+                                                                        const mp::days& days_to_expire,
+                                                                        const mp::vault::BlobStore& blobs)
 {
     return std::make_unique<mp::LXDVMImageVault>(image_hosts, downloader, manager.get(), base_url, cache_dir_path,
-                                                 days_to_expire);
+                                                 days_to_expire, blobs, events.get(), &templates);
 }
 
 auto mp::LXDVirtualMachineFactory::networks() const -> std::vector<NetworkInterfaceInfo>
 {
+    std::lock_guard lock{networks_mutex};
+    if (!link_changes.since_last_asked() && cached_networks)
+        return *cached_networks;
+
+    cached_networks.reset(); // not to be kept if asking fails
     auto url = QUrl{QString{"%1/networks?recursion=1"}.arg(base_url.toString())}; // no network filter ATTOW
     auto reply = lxd_request(manager.get(), "GET", url);
 
@@ -242,9 +277,38 @@ auto mp::LXDVirtualMachineFactory::networks() const -> std::vector<NetworkInterf
                 net.needs_authorization = false;
     }
 
+    cached_networks = ret;
     return ret;
 }
 
+void mp::LXDVirtualMachineFactory::refresh_states(const std::vector<VirtualMachine*>& vms)
+{
+    std::unordered_map<std::string, LXDVirtualMachine*> stale_vms;
+    for (auto vm : vms)
+        if (auto lxd_vm = dynamic_cast<LXDVirtualMachine*>(vm); lxd_vm && lxd_vm->state_is_stale())
+            stale_vms.emplace(lxd_vm->vm_name, lxd_vm);
+
+    // A single instance is as well asked on its own, the listing carries every instance's state
+    if (stale_vms.size() < 2)
+        return;
+
+    try
+    {
+        const auto mark = events ? events->mark() : std::nullopt; // taken first, not to miss what happens meanwhile
+        auto reply = lxd_request(manager.get(), "GET",
+                                 QUrl{QString{"%1/virtual-machines?recursion=2"}.arg(base_url.toString())});
+
+        for (const auto& instance : reply["metadata"].toArray())
+            if (auto it = stale_vms.find(instance.toObject()["name"].toString().toStdString()); it != stale_vms.end())
+                it->second->refresh_from(instance.toObject(), mark);
+    }
+    catch (const std::exception& e)
+    {
+        mpl::log(mpl::Level::debug, category,
+                 fmt::format("Cannot get the state of all instances at once: {}", e.what()));
+    }
+}
+
 void mp::LXDVirtualMachineFactory::prepare_networking(std::vector<NetworkInterface>& extra_interfaces)
 {
     prepare_networking_guts(extra_interfaces, "bridge");
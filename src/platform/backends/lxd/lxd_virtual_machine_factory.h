@@ -18,13 +18,21 @@
 #ifndef MULTIPASS_LXD_VIRTUAL_MACHINE_FACTORY_H
 #define MULTIPASS_LXD_VIRTUAL_MACHINE_FACTORY_H
 
+#include "lxd_events.h"
+#include "lxd_instance_templates.h"
 #include "lxd_request.h"
 
 #include <multipass/network_access_manager.h>
 #include <shared/base_virtual_machine_factory.h>
+#include <shared/linux/link_changes.h>
 
 #include <QUrl>
 
+#include <atomic>
+#include <memory>
+#include <mutex>
+#include <optional>
+
 namespace multipass
 {
 class LXDVirtualMachineFactory : public BaseVirtualMachineFactory
@@ -32,7 +40,8 @@ class LXDVirtualMachineFactory : public BaseVirtualMachineFactory
 public:
     explicit LXDVirtualMachineFactory(const Path& data_dir, const QUrl& base_url = lxd_socket_url);
     explicit LXDVirtualMachineFactory(NetworkAccessManager::UPtr manager, const Path& data_dir,
-                                      const QUrl& base_url = lxd_socket_url);
+                                      const QUrl& base_url = lxd_socket_url,
+                                      std::unique_ptr<LXDEvents> events = nullptr);
 
     void prepare_networking(std::vector<NetworkInterface>& extra_interfaces) override;
     VirtualMachine::UPtr create_virtual_machine(const VirtualMachineDescription& desc,
@@ -48,19 +57,26 @@ public:
     QString get_backend_version_string() override;
     VMImageVault::UPtr create_image_vault(std::vector<VMImageHost*> image_hosts, URLDownloader* downloader,
                                           const Path& cache_dir_path, const Path& data_dir_path,
-                                          const days& days_to_expire) override;
+                                          const days& days_to_expire, const vault::BlobStore& blobs) override;
     void configure(VirtualMachineDescription& vm_desc) override;
 
     std::vector<NetworkInterfaceInfo> networks() const override;
+    void refresh_states(const std::vector<VirtualMachine*>& vms) override;
 
 protected:
     std::string create_bridge_with(const NetworkInterfaceInfo& interface) override;
 
 private:
     NetworkAccessManager::UPtr manager;
+    std::unique_ptr<LXDEvents> events; // what the vault and the instances are told of changes through, if anything
     const Path data_dir;
     const QUrl base_url;
     QString storage_pool;
+    LXDInstanceTemplates templates;
+    std::atomic_bool clone_from_templates{false}; // when the storage pool makes cloning cheaper than unpacking
+    mutable std::mutex networks_mutex;
+    mutable LinkChanges link_changes; // LXD's networks are the host's links, as well as those it manages
+    mutable std::optional<std::vector<NetworkInterfaceInfo>> cached_networks;
 };
 } // namespace multipass
 
@@ -16,13 +16,18 @@
  */
 
 #include "lxd_vm_image_vault.h"
+#include "lxd_events.h"
+#include "lxd_instance_templates.h"
 #include "lxd_request.h"
 
+#include <multipass/checksum.h>
 #include <multipass/exceptions/aborted_download_exception.h>
 #include <multipass/exceptions/image_vault_exceptions.h>
 #include <multipass/exceptions/local_socket_connection_exception.h>
 #include <multipass/format.h>
+#include <multipass/image_decoder.h>
 #include <multipass/logging/log.h>
+#include <multipass/logging/tracer.h>
 #include <multipass/network_access_manager.h>
 #include <multipass/platform.h>
 #include <multipass/rpc/multipass.grpc.pb.h>
@@ -37,7 +42,9 @@
 #include <yaml-cpp/yaml.h>
 
 #include <QCoreApplication>
+#include <QCryptographicHash>
 #include <QDateTime>
+#include <QDir>
 #include <QFile>
 #include <QFileInfo>
 #include <QHttpMultiPart>
@@ -48,6 +55,7 @@
 
 #include <chrono>
 #include <thread>
+#include <vector>
 
 namespace mp = multipass;
 namespace mpl = multipass::logging;
@@ -57,6 +65,8 @@ using namespace std::literals::chrono_literals;
 namespace
 {
 constexpr auto category = "lxd image vault";
+constexpr auto image_hashes_db_name = "multipassd-image-hashes.json";
+constexpr auto operation_event_timeout = 10s; // then the operation is looked up, lest an event went amiss
 
 const QHash<QString, QString> host_to_lxd_arch{{"x86_64", "x86_64"}, {"arm", "armv7l"}, {"arm64", "aarch64"},
                                                {"i386", "i686"},     {"power", "ppc"},  {"power64", "ppc64"},
@@ -80,7 +90,7 @@ QString post_process_downloaded_image(const QString& image_path, const mp::Progr
 {
     QString new_image_path{image_path};
 
-    if (image_path.endsWith(".xz"))
+    if (mp::decoding::is_compressed(image_path))
     {
         new_image_path = mp::vault::extract_image(image_path, monitor, true);
     }
@@ -117,7 +127,7 @@ QString create_metadata_tarball(const mp::VMImageInfo& info, const QTemporaryDir
     metadata_yaml_file.close();
 
     const auto metadata_tarball_path = lxd_import_dir.filePath("metadata.tar");
-    auto process = MP_PROCFACTORY.create_process(
+    auto process = MP_PROCFACTORY.create_oneshot_process(
         "tar", QStringList() << "-cf" << metadata_tarball_path << "-C" << lxd_import_dir.path()
                              << QFileInfo(metadata_yaml_file.fileName()).fileName());
 
@@ -147,13 +157,19 @@ std::vector<std::string> copy_aliases(const QStringList& aliases)
 
 mp::LXDVMImageVault::LXDVMImageVault(std::vector<VMImageHost*> image_hosts, URLDownloader* downloader,
                                      NetworkAccessManager* manager, const QUrl& base_url, const QString& cache_dir_path,
-                                     const days& days_to_expire)
+                                     const days& days_to_expire,
+                                     const std::optional<vault::BlobStore>& shared_blobs, LXDEvents* events,
+                                     LXDInstanceTemplates* templates)
     : BaseVMImageVault{image_hosts},
       url_downloader{downloader},
       manager{manager},
       base_url{base_url},
       template_path{QString("%1/%2-").arg(cache_dir_path).arg(QCoreApplication::applicationName())},
-      days_to_expire{days_to_expire}
+      days_to_expire{days_to_expire},
+      image_hashes{QDir{cache_dir_path}.filePath(image_hashes_db_name)},
+      blobs{shared_blobs.value_or(vault::BlobStore{QDir{cache_dir_path}.filePath("blobs")})},
+      events{events},
+      templates{templates}
 {
 }
 
@@ -161,6 +177,8 @@ mp::VMImage mp::LXDVMImageVault::fetch_image(const FetchType& fetch_type, const
                                              const PrepareAction& prepare, const ProgressMonitor& monitor,
                                              const bool unlock, const std::optional<std::string>& checksum)
 {
+    mpl::TraceSpan span{"fetch_image", query.name};
+
     // Look for an already existing instance and get its image info
     try
     {
@@ -257,7 +275,7 @@ mp::VMImage mp::LXDVMImageVault::fetch_image(const FetchType& fetch_type, const
                 throw std::runtime_error(fmt::format("Custom image `{}` does not exist.", image_url.path()));
 
             source_image.image_path = image_url.path();
-            id = mp::vault::compute_image_hash(source_image.image_path);
+            id = image_hashes.hash_of(source_image.image_path);
             last_modified = QDateTime::currentDateTime();
         }
 
@@ -268,53 +286,63 @@ mp::VMImage mp::LXDVMImageVault::fetch_image(const FetchType& fetch_type, const
         source_image.release_date = last_modified.toString(Qt::ISODateWithMs).toStdString();
     }
 
-    try
-    {
-        auto json_reply = lxd_request(manager, "GET", QUrl(QString("%1/images/%2").arg(base_url.toString()).arg(id)));
-    }
-    catch (const LXDNotFoundException&)
-    {
-        auto lxd_image_hash = get_lxd_image_hash_for(id);
-        if (!lxd_image_hash.empty())
-        {
-            source_image.id = lxd_image_hash;
-        }
-        else if (!info.stream_location.isEmpty())
+    // Concurrent launches of the same image, whatever they asked for it by, get it fetched only once
+    return fetch_once(id.toStdString(), monitor, [&] {
+        try
         {
-            lxd_download_image(info, query, monitor);
+            auto json_reply =
+                lxd_request(manager, "GET", QUrl(QString("%1/images/%2").arg(base_url.toString()).arg(id)));
         }
-        else if (!info.image_location.isEmpty())
+        catch (const LXDNotFoundException&)
         {
-            QString image_path;
-            QTemporaryDir lxd_import_dir{template_path};
-
-            if (query.query_type != Query::Type::LocalFile)
+            auto lxd_image_hash = get_lxd_image_hash_for(id);
+            if (!lxd_image_hash.empty())
             {
-                // TODO: Need to make this async like in DefaultVMImageVault
-                image_path = lxd_import_dir.filePath(mp::vault::filename_for(info.image_location));
-
-                url_download_image(info, image_path, monitor);
+                source_image.id = lxd_image_hash;
             }
-            else
+            else if (!info.stream_location.isEmpty())
             {
-                image_path = mp::vault::copy(source_image.image_path, lxd_import_dir.path());
+                lxd_download_image(info, query, monitor);
             }
+            else if (!info.image_location.isEmpty())
+            {
+                QString image_path;
+                QTemporaryDir lxd_import_dir{template_path};
 
-            image_path = post_process_downloaded_image(image_path, monitor);
+                if (query.query_type != Query::Type::LocalFile)
+                {
+                    // TODO: Need to make this async like in DefaultVMImageVault
+                    image_path = lxd_import_dir.filePath(mp::vault::filename_for(info.image_location));
 
-            monitor(LaunchProgress::WAITING, -1);
+                    // Blobs are kept decompressed
+                    const auto blob_path = mp::decoding::decoded_path_for(image_path);
 
-            auto metadata_tarball_path = create_metadata_tarball(info, lxd_import_dir);
+                    if (info.verify && blobs.link(info.id.toStdString(), blob_path))
+                        image_path = blob_path;
+                    else
+                        image_path = url_download_image(info, image_path, monitor);
+                }
+                else
+                {
+                    image_path = mp::vault::copy(source_image.image_path, lxd_import_dir.path());
+                }
 
-            source_image.id = lxd_import_metadata_and_image(metadata_tarball_path, image_path);
-        }
-        else
-        {
-            throw std::runtime_error(fmt::format("Unable to fetch image with hash \'{}\'", id));
+                image_path = post_process_downloaded_image(image_path, monitor);
+
+                monitor(LaunchProgress::WAITING, -1);
+
+                auto metadata_tarball_path = create_metadata_tarball(info, lxd_import_dir);
+
+                source_image.id = lxd_import_metadata_and_image(metadata_tarball_path, image_path);
+            }
+            else
+            {
+                throw std::runtime_error(fmt::format("Unable to fetch image with hash \'{}\'", id));
+            }
         }
-    }
 
-    return source_image;
+        return source_image;
+    });
 }
 
 void mp::LXDVMImageVault::remove(const std::string& name)
@@ -356,6 +384,7 @@ bool mp::LXDVMImageVault::has_record_for(const std::string& name)
 void mp::LXDVMImageVault::prune_expired_images()
 {
     auto images = retrieve_image_list();
+    std::vector<std::pair<QString, LXDPendingReply>> removals;
 
     for (const auto image : images)
     {
@@ -379,17 +408,26 @@ void mp::LXDVMImageVault::prune_expired_images()
                      fmt::format("Source image \'{}\' is expired. Removing it…",
                                  image_info["properties"].toObject()["release"].toString()));
 
-            try
-            {
-                lxd_request(
-                    manager, "DELETE",
-                    QUrl(QString("%1/images/%2").arg(base_url.toString()).arg(image_info["fingerprint"].toString())));
-            }
-            catch (const LXDNotFoundException&)
-            {
-                continue;
-            }
+            // All removed at once, rather than each waiting for the previous one
+            const auto id = image_info["fingerprint"].toString();
+            const auto url = QUrl(QString("%1/images/%2").arg(base_url.toString()).arg(id));
+            removals.emplace_back(id, lxd_request_async(manager, "DELETE", url));
+        }
+    }
+
+    for (auto& [id, removal] : removals)
+    {
+        try
+        {
+            removal.wait();
+        }
+        catch (const LXDNotFoundException&)
+        {
+            continue;
         }
+
+        if (templates)
+            templates->remove_for(id);
     }
 }
 
@@ -426,6 +464,8 @@ void mp::LXDVMImageVault::update_images(const FetchType& fetch_type, const Prepa
                     lxd_download_image(*info, query, monitor, image_info["last_used_at"].toString());
 
                     lxd_request(manager, "DELETE", QUrl(QString("%1/images/%2").arg(base_url.toString()).arg(id)));
+                    if (templates)
+                        templates->remove_for(id);
                 }
             }
             catch (const LXDNotFoundException&)
@@ -498,18 +538,55 @@ void mp::LXDVMImageVault::lxd_download_image(const VMImageInfo& info, const Quer
     poll_download_operation(json_reply, monitor);
 }
 
-void mp::LXDVMImageVault::url_download_image(const VMImageInfo& info, const QString& image_path,
-                                             const ProgressMonitor& monitor)
+QString mp::LXDVMImageVault::url_download_image(const VMImageInfo& info, const QString& image_path,
+                                                const ProgressMonitor& monitor)
 {
-    mp::vault::DeleteOnException image_file{image_path};
+    if (!mp::decoding::is_compressed(image_path))
+    {
+        mp::vault::DeleteOnException image_file{image_path};
 
-    url_downloader->download_to(info.image_location, image_path, info.size, LaunchProgress::IMAGE, monitor);
+        url_downloader->download_to(info.image_location, image_path, info.size, LaunchProgress::IMAGE, monitor);
+
+        if (info.verify)
+        {
+            monitor(LaunchProgress::VERIFY, -1);
+            mp::vault::verify_image_download(image_path, info.id);
+            blobs.add(info.id.toStdString(), image_path);
+        }
+
+        return image_path;
+    }
+
+    // Hashed and decompressed as it comes in, so the compressed image never hits the disk
+    const auto decoded_path = mp::decoding::decoded_path_for(image_path);
+    mp::vault::DeleteOnException image_file{decoded_path};
+
+    mp::checksum::Sha256 hash;
+    const auto decoder = mp::decoding::make_stream_decoder(decoded_path);
+    url_downloader->download_chunks(
+        info.image_location,
+        [&hash, &decoder, verify = info.verify](const QByteArray& chunk) {
+            if (verify)
+                hash.add_data(chunk.constData(), chunk.size());
+            decoder->decode(chunk.constData(), chunk.size());
+        },
+        [&hash, &decoder] {
+            hash.reset();
+            decoder->restart();
+        },
+        info.size, LaunchProgress::IMAGE, monitor);
+    decoder->finish();
 
     if (info.verify)
     {
         monitor(LaunchProgress::VERIFY, -1);
-        mp::vault::verify_image_download(image_path, info.id);
+        if (hash.hex_digest() != info.id.toStdString())
+            throw std::runtime_error("Downloaded image hash does not match");
+
+        blobs.add(info.id.toStdString(), decoded_path);
     }
+
+    return decoded_path;
 }
 
 void mp::LXDVMImageVault::poll_download_operation(const QJsonObject& json_reply, const ProgressMonitor& monitor)
@@ -517,33 +594,45 @@ void mp::LXDVMImageVault::poll_download_operation(const QJsonObject& json_reply,
     if (json_reply["metadata"].toObject()["class"] == QStringLiteral("task") &&
         json_reply["status_code"].toInt(-1) == 100)
     {
-        QUrl task_url(QString("%1/operations/%2")
-                          .arg(base_url.toString())
-                          .arg(json_reply["metadata"].toObject()["id"].toString()));
+        const auto id = json_reply["metadata"].toObject()["id"].toString();
+        QUrl task_url(QString("%1/operations/%2").arg(base_url.toString()).arg(id));
 
-        // Instead of polling, need to use websockets to get events
+        // Events tell of progress as soon as there is any, polling is left for when they cannot be followed
         auto last_download_progress = -2;
+        std::uint64_t seen = 0;
         while (true)
         {
             try
             {
-                auto task_reply = mp::lxd_request(manager, "GET", task_url);
-
-                if (task_reply["error_code"].toInt(-1) != 0)
+                auto operation = events ? events->wait_for_operation(id, seen, operation_event_timeout) : std::nullopt;
+                const auto from_events = operation.has_value();
+                if (!operation)
                 {
-                    mpl::log(mpl::Level::error, category, task_reply["error"].toString().toStdString());
-                    break;
+                    auto task_reply = mp::lxd_request(manager, "GET", task_url);
+
+                    if (task_reply["error_code"].toInt(-1) != 0)
+                    {
+                        mpl::log(mpl::Level::error, category, task_reply["error"].toString().toStdString());
+                        break;
+                    }
+
+                    operation = task_reply["metadata"].toObject();
                 }
 
-                auto status_code = task_reply["metadata"].toObject()["status_code"].toInt(-1);
+                auto status_code = (*operation)["status_code"].toInt(-1);
                 if (status_code == 200)
                 {
                     break;
                 }
+                else if (status_code >= 400)
+                {
+                    mpl::log(mpl::Level::error, category, (*operation)["err"].toString().toStdString());
+                    break;
+                }
                 else
                 {
                     auto download_progress = parse_percent_as_int(
-                        task_reply["metadata"].toObject()["metadata"].toObject()["download_progress"].toString());
+                        (*operation)["metadata"].toObject()["download_progress"].toString());
 
                     if (last_download_progress != download_progress &&
                         !monitor(LaunchProgress::IMAGE, download_progress))
@@ -554,7 +643,8 @@ void mp::LXDVMImageVault::poll_download_operation(const QJsonObject& json_reply,
 
                     last_download_progress = download_progress;
 
-                    std::this_thread::sleep_for(1s);
+                    if (!from_events && !(events && events->mark()))
+                        std::this_thread::sleep_for(1s);
                 }
             }
             // Implies the task is finished
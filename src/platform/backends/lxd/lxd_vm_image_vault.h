@@ -20,14 +20,19 @@
 
 #include <multipass/days.h>
 #include <multipass/query.h>
+#include <multipass/vm_image_vault.h>
 #include <shared/base_vm_image_vault.h>
 
 #include <QJsonArray>
 #include <QJsonObject>
 #include <QUrl>
 
+#include <optional>
+
 namespace multipass
 {
+class LXDEvents;
+class LXDInstanceTemplates;
 class NetworkAccessManager;
 class URLDownloader;
 
@@ -37,7 +42,9 @@ public:
     using TaskCompleteAction = std::function<void(const QJsonObject&)>;
 
     LXDVMImageVault(std::vector<VMImageHost*> image_host, URLDownloader* downloader, NetworkAccessManager* manager,
-                    const QUrl& base_url, const QString& cache_dir_path, const multipass::days& days_to_expire);
+                    const QUrl& base_url, const QString& cache_dir_path, const multipass::days& days_to_expire,
+                    const std::optional<vault::BlobStore>& shared_blobs = std::nullopt, LXDEvents* events = nullptr,
+                    LXDInstanceTemplates* templates = nullptr);
 
     VMImage fetch_image(const FetchType& fetch_type, const Query& query, const PrepareAction& prepare,
                         const ProgressMonitor& monitor, const bool unlock,
@@ -52,7 +59,8 @@ public:
 private:
     void lxd_download_image(const VMImageInfo& info, const Query& query, const ProgressMonitor& monitor,
                             const QString& last_used = QString());
-    void url_download_image(const VMImageInfo& info, const QString& image_path, const ProgressMonitor& monitor);
+    // Where the image ended up, decompressed on the way if need be
+    QString url_download_image(const VMImageInfo& info, const QString& image_path, const ProgressMonitor& monitor);
     void poll_download_operation(const QJsonObject& json_reply, const ProgressMonitor& monitor);
     std::string lxd_import_metadata_and_image(const QString& metadata_path, const QString& image_path);
     std::string get_lxd_image_hash_for(const QString& id);
@@ -63,6 +71,10 @@ private:
     const QUrl base_url;
     const QString template_path;
     const days days_to_expire;
+    vault::ImageHashCache image_hashes;
+    const vault::BlobStore blobs;
+    LXDEvents* const events;
+    LXDInstanceTemplates* const templates; // to go along with the images they were made from, if any
 };
 } // namespace multipass
 #endif // MULTIPASS_LXD_VM_IMAGE_VAULT_H
@@ -22,11 +22,27 @@
 #include <multipass/logging/log.h>
 #include <multipass/process/process.h>
 #include <multipass/utils.h>
+#include <shared/linux/backend_utils.h>
 #include <shared/linux/process_factory.h>
 
 #include <QDir>
 
+#include <algorithm>
+#include <array>
+#include <cerrno>
+#include <csignal>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
 #include <fstream>
+#include <random>
+#include <unordered_set>
+
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <sys/inotify.h>
+#include <sys/socket.h>
+#include <unistd.h>
 
 namespace mp = multipass;
 namespace mpl = multipass::logging;
@@ -34,6 +50,59 @@ namespace mpl = multipass::logging;
 namespace
 {
 constexpr auto immediate_wait = 100; // period to wait for immediate dnsmasq failures, in ms
+constexpr auto leases_file_name = "dnsmasq.leases";
+constexpr auto hosts_file_name = "dnsmasq.hosts";
+
+// The DHCPRELEASE dhcp_release would send: from the instance's address and MAC, to dnsmasq's port through the bridge
+bool send_dhcp_release(const QString& bridge_name, const mp::IPAddress& server, const mp::IPAddress& ip,
+                       const std::string& hw_addr)
+{
+    std::array<std::uint8_t, 6> mac;
+    if (std::sscanf(hw_addr.c_str(), "%hhx:%hhx:%hhx:%hhx:%hhx:%hhx", &mac[0], &mac[1], &mac[2], &mac[3], &mac[4],
+                    &mac[5]) != 6)
+        return false;
+
+    // The fixed BOOTP fields, the magic cookie, then the message type and server identifier options, zero-padded to
+    // the minimum BOOTP size
+    std::array<std::uint8_t, 300> packet{};
+    packet[0] = 1; // BOOTREQUEST
+    packet[1] = 1; // Ethernet
+    packet[2] = static_cast<std::uint8_t>(mac.size());
+    const auto xid = std::random_device{}();
+    std::memcpy(&packet[4], &xid, sizeof(xid));
+    std::copy(ip.octets.cbegin(), ip.octets.cend(), &packet[12]); // ciaddr
+    std::copy(mac.cbegin(), mac.cend(), &packet[28]);              // chaddr
+    const std::array<std::uint8_t, 4> cookie{99, 130, 83, 99};
+    std::copy(cookie.cbegin(), cookie.cend(), &packet[236]);
+    const std::array<std::uint8_t, 10> options{53, 1, 7, // DHCPRELEASE
+                                               54, 4, server.octets[0], server.octets[1], server.octets[2],
+                                               server.octets[3], 255};
+    std::copy(options.cbegin(), options.cend(), &packet[240]);
+
+    const auto fd = MP_LINUX_SYSCALLS.socket(AF_INET, SOCK_DGRAM | SOCK_CLOEXEC, IPPROTO_UDP);
+    if (fd < 0)
+        return false;
+
+    const auto interface = bridge_name.toStdString();
+    sockaddr_in destination{};
+    destination.sin_family = AF_INET;
+    destination.sin_port = htons(67);
+    destination.sin_addr.s_addr = htonl(server.as_uint32());
+
+    // Bound to the bridge, for dnsmasq to take it as coming from there
+    auto sent = MP_LINUX_SYSCALLS.setsockopt(fd, SOL_SOCKET, SO_BINDTODEVICE, interface.c_str(),
+                                             static_cast<socklen_t>(interface.size())) == 0;
+    sent = sent && MP_LINUX_SYSCALLS.sendto(fd, packet.data(), packet.size(), 0,
+                                            reinterpret_cast<sockaddr*>(&destination),
+                                            sizeof(destination)) == static_cast<ssize_t>(packet.size());
+
+    if (!sent)
+        mpl::log(mpl::Level::debug, "dnsmasq",
+                 fmt::format("cannot send DHCP release for {} on {}: {}", hw_addr, interface, std::strerror(errno)));
+
+    MP_LINUX_SYSCALLS.close(fd);
+    return sent;
+}
 
 auto make_dnsmasq_process(const mp::Path& data_dir, const QString& bridge_name, const std::string& subnet,
                           const QString& conf_file_path)
@@ -52,12 +121,23 @@ mp::DNSMasqServer::DNSMasqServer(const Path& data_dir, const QString& bridge_nam
     conf_file.open();
     conf_file.close();
 
-    QFile dnsmasq_hosts(QDir(data_dir).filePath("dnsmasq.hosts"));
+    QFile dnsmasq_hosts(QDir(data_dir).filePath(hosts_file_name));
     if (!dnsmasq_hosts.exists())
     {
         dnsmasq_hosts.open(QIODevice::WriteOnly);
     }
+    else if (dnsmasq_hosts.open(QIODevice::ReadOnly | QIODevice::Text))
+    {
+        // Reservations made before, as <mac addr>,<ipv4>
+        while (!dnsmasq_hosts.atEnd())
+        {
+            const auto fields = QString{dnsmasq_hosts.readLine()}.trimmed().split(',');
+            if (fields.size() == 2)
+                reservations.emplace(fields[0].toStdString(), fields[1].toStdString());
+        }
+    }
 
+    watch_leases(); // before dnsmasq can write to them
     dnsmasq_cmd = make_dnsmasq_process(data_dir, bridge_name, subnet, conf_file.fileName());
     start_dnsmasq();
 }
@@ -80,25 +160,65 @@ mp::DNSMasqServer::~DNSMasqServer()
                 mpl::log(mpl::Level::warning, "dnsmasq", "failed to kill");
         }
     }
+
+    if (leases_watch >= 0)
+        close(leases_watch);
 }
 
 std::optional<mp::IPAddress> mp::DNSMasqServer::get_ip_for(const std::string& hw_addr)
 {
-    // DNSMasq leases entries consist of:
-    // <lease expiration> <mac addr> <ipv4> <name> * * *
-    const auto path = QDir(data_dir).filePath("dnsmasq.leases").toStdString();
-    const std::string delimiter{" "};
-    const int hw_addr_idx{1};
-    const int ipv4_idx{2};
-    std::ifstream leases_file{path};
-    std::string line;
-    while (getline(leases_file, line))
+    std::lock_guard lock{leases_mutex};
+    refresh_leases();
+
+    if (auto it = leases.find(hw_addr); it != leases.end())
+        return it->second;
+
+    // Known before the instance asks for it, dnsmasq hands it out as soon as it does
+    if (auto it = reservations.find(hw_addr); it != reservations.end())
+        return it->second;
+
+    return std::nullopt;
+}
+
+std::optional<mp::IPAddress> mp::DNSMasqServer::reserve_ip_for(const std::string& hw_addr)
+{
+    std::lock_guard lock{leases_mutex};
+    if (auto it = reservations.find(hw_addr); it != reservations.end())
+        return it->second;
+
+    refresh_leases();
+
+    // What it has already, for instances that got a lease before being reserved one. Otherwise, the same address
+    // for the same MAC every time, unless that is taken, within the --dhcp-range of .2 to .254.
+    const auto lease = leases.find(hw_addr);
+    auto ip = lease != leases.end() ? lease->second : std::string{};
+    if (ip.empty())
     {
-        const auto fields = mp::utils::split(line, delimiter);
-        if (fields.size() > 2 && fields[hw_addr_idx] == hw_addr)
-            return fields[ipv4_idx];
+        std::unordered_set<std::string> taken;
+        for (const auto* entries : {&leases, &reservations})
+            for (const auto& [mac, address] : *entries)
+                taken.insert(address);
+
+        constexpr auto first_host = 2u, hosts = 253u;
+        const auto start = std::hash<std::string>{}(hw_addr) % hosts;
+        for (auto i = 0u; i < hosts && ip.empty(); ++i)
+        {
+            auto candidate = fmt::format("{}.{}", subnet, first_host + (start + i) % hosts);
+            if (!taken.count(candidate))
+                ip = std::move(candidate);
+        }
     }
-    return std::nullopt;
+
+    if (ip.empty())
+    {
+        mpl::log(mpl::Level::warning, "dnsmasq", fmt::format("no address left to reserve for {}", hw_addr));
+        return std::nullopt;
+    }
+
+    reservations.emplace(hw_addr, ip);
+    write_reservations();
+
+    return ip;
 }
 
 void mp::DNSMasqServer::release_mac(const std::string& hw_addr)
@@ -110,6 +230,16 @@ void mp::DNSMasqServer::release_mac(const std::string& hw_addr)
         return;
     }
 
+    {
+        std::lock_guard lock{leases_mutex};
+        if (reservations.erase(hw_addr))
+            write_reservations();
+    }
+
+    // Sent from here rather than through a process of its own, unless the bridge cannot be bound to
+    if (send_dhcp_release(bridge_name, IPAddress{fmt::format("{}.1", subnet)}, *ip, hw_addr))
+        return;
+
     QProcess dhcp_release;
     QObject::connect(&dhcp_release, &QProcess::errorOccurred, [&ip, &hw_addr](QProcess::ProcessError error) {
         mpl::log(mpl::Level::warning, "dnsmasq",
@@ -163,6 +293,89 @@ std::string dnsmasq_failure_msg(const mp::ProcessState& state)
 }
 } // namespace
 
+void mp::DNSMasqServer::watch_leases()
+{
+    // The directory rather than the file, which dnsmasq only makes once it starts
+    leases_watch = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+    if (leases_watch >= 0 &&
+        inotify_add_watch(leases_watch, QFile::encodeName(data_dir).constData(),
+                          IN_CREATE | IN_MODIFY | IN_CLOSE_WRITE | IN_MOVED_TO | IN_DELETE) >= 0)
+        return;
+
+    mpl::log(mpl::Level::info, "dnsmasq",
+             fmt::format("cannot watch for lease changes, reading them on every lookup: {}", std::strerror(errno)));
+
+    if (leases_watch >= 0)
+        close(leases_watch);
+    leases_watch = -1;
+}
+
+void mp::DNSMasqServer::refresh_leases()
+{
+    auto changed = !leases_read || leases_watch < 0;
+    if (leases_watch >= 0)
+    {
+        alignas(inotify_event) std::array<char, 4096> buffer;
+        ssize_t length;
+        while ((length = read(leases_watch, buffer.data(), buffer.size())) > 0)
+        {
+            for (auto p = buffer.data(); p < buffer.data() + length;)
+            {
+                const auto event = reinterpret_cast<const inotify_event*>(p);
+                changed |= (event->mask & IN_Q_OVERFLOW) || (event->len && !std::strcmp(event->name, leases_file_name));
+                p += sizeof(inotify_event) + event->len;
+            }
+        }
+    }
+
+    if (!changed)
+        return;
+
+    // DNSMasq leases entries consist of:
+    // <lease expiration> <mac addr> <ipv4> <name> * * *
+    const int hw_addr_idx{1};
+    const int ipv4_idx{2};
+    std::ifstream leases_file{QDir(data_dir).filePath(leases_file_name).toStdString()};
+    std::string line; // reused, so that going through the file does not allocate per line
+
+    leases.clear();
+    while (getline(leases_file, line))
+    {
+        std::array<std::string_view, 3> fields;
+        std::size_t count = 0;
+        for (const auto field : mp::utils::tokens_of(line, " "))
+        {
+            fields[count++] = field;
+            if (count == fields.size())
+                break;
+        }
+
+        if (count == fields.size())
+            leases.emplace(fields[hw_addr_idx], fields[ipv4_idx]); // the first one for a MAC, as before
+    }
+
+    leases_read = true;
+}
+
+void mp::DNSMasqServer::write_reservations()
+{
+    QFile dnsmasq_hosts(QDir(data_dir).filePath(hosts_file_name));
+    if (!dnsmasq_hosts.open(QIODevice::WriteOnly | QIODevice::Truncate | QIODevice::Text))
+    {
+        mpl::log(mpl::Level::warning, "dnsmasq",
+                 fmt::format("cannot write reservations: {}", dnsmasq_hosts.errorString()));
+        return;
+    }
+
+    for (const auto& [mac, ip] : reservations)
+        dnsmasq_hosts.write(fmt::format("{},{}\n", mac, ip).c_str());
+    dnsmasq_hosts.close();
+
+    // The hosts file is only read again on SIGHUP
+    if (dnsmasq_cmd && dnsmasq_cmd->running())
+        ::kill(static_cast<pid_t>(dnsmasq_cmd->process_id()), SIGHUP);
+}
+
 void mp::DNSMasqServer::start_dnsmasq()
 {
     mpl::log(mpl::Level::debug, "dnsmasq", "Starting dnsmasq");
@@ -26,8 +26,10 @@
 #include <QTemporaryFile>
 
 #include <memory>
+#include <mutex>
 #include <optional>
 #include <string>
+#include <unordered_map>
 
 namespace multipass
 {
@@ -41,7 +43,8 @@ public:
     DNSMasqServer(const Path& data_dir, const QString& bridge_name, const std::string& subnet);
     virtual ~DNSMasqServer(); // inherited by mock for testing
 
-    virtual std::optional<IPAddress> get_ip_for(const std::string& hw_addr);
+    virtual std::optional<IPAddress> get_ip_for(const std::string& hw_addr); // the lease, or else the reservation
+    virtual std::optional<IPAddress> reserve_ip_for(const std::string& hw_addr); // a static one, nothing if none left
     virtual void release_mac(const std::string& hw_addr);
     virtual void check_dnsmasq_running();
 
@@ -50,6 +53,9 @@ protected:
 
 private:
     void start_dnsmasq();
+    void watch_leases();
+    void refresh_leases(); // with leases_mutex held
+    void write_reservations(); // with leases_mutex held, and has dnsmasq read them again
 
     const QString data_dir;
     const QString bridge_name;
@@ -57,6 +63,13 @@ private:
     std::unique_ptr<Process> dnsmasq_cmd;
     QMetaObject::Connection finish_connection;
     QTemporaryFile conf_file;
+
+    // What the leases file last said, MAC to IPv4, read again only once inotify reports it changed
+    std::mutex leases_mutex;
+    int leases_watch{-1}; // inotify fd on data_dir, or -1 to read the file on every lookup
+    bool leases_read{false};
+    std::unordered_map<std::string, std::string> leases;
+    std::unordered_map<std::string, std::string> reservations; // in dnsmasq.hosts, MAC to IPv4 too
 };
 
 #define MP_DNSMASQ_SERVER_FACTORY multipass::DNSMasqServerFactory::instance()
@@ -16,6 +16,7 @@
  */
 
 #include "firewall_config.h"
+#include "seed_server.h"
 
 #include <multipass/format.h>
 #include <multipass/logging/log.h>
@@ -26,9 +27,13 @@
 
 #include <semver200.h>
 
+#include <algorithm>
+#include <map>
 #include <stdexcept>
+#include <string>
+#include <string_view>
 
-#include <QRegularExpression>
+#include <QTemporaryFile>
 
 namespace mp = multipass;
 namespace mpl = multipass::logging;
@@ -71,6 +76,7 @@ const QString source{QStringLiteral("--source")};
 const QString list_rules{QStringLiteral("--list-rules")};
 const QString dash_t{QStringLiteral("-t")}; // Use short option for specifying table to avoid var conflicts
 const QString wait{QStringLiteral("--wait")};
+const QString noflush{QStringLiteral("--noflush")};
 
 //   protocol constants
 const QString udp{QStringLiteral("udp")};
@@ -83,6 +89,7 @@ const QString to_ports{QStringLiteral("--to-ports")};
 const QString port_53{QStringLiteral("53")};
 const QString port_67{QStringLiteral("67")};
 const QString port_68{QStringLiteral("68")};
+const QString port_seed{QString::number(mp::seed_server_port)};
 const QString port_range{QStringLiteral("1024-65535")};
 
 //   rule target constants
@@ -102,42 +109,66 @@ public:
         : runtime_error{fmt::format("{}; Table: {}; Failure: {}; Output: {}", issue, table, failure, output)} {};
 };
 
+std::string_view view_of(const QByteArray& bytes)
+{
+    return {bytes.constData(), static_cast<std::size_t>(bytes.size())};
+}
+
+bool contains(std::string_view line, const std::string& text)
+{
+    return line.find(text) != std::string_view::npos;
+}
+
 auto multipass_firewall_comment(const QString& bridge_name)
 {
     return QString("generated for Multipass network %1").arg(bridge_name);
 }
 
-void add_firewall_rule(const QString& firewall, const QString& table, const QString& chain, const QStringList& rule,
+// The lines for iptables-restore to go through, by table
+using Ruleset = std::map<QString, QStringList>;
+
+void add_firewall_rule(Ruleset& rules, const QString& table, const QString& chain, const QStringList& rule,
                        bool append = false)
 {
-    auto process = MP_PROCFACTORY.create_process(
-        firewall, QStringList() << wait << dash_t << table << (append ? append_rule : insert_rule) << chain << rule);
+    QStringList words{append ? append_rule : insert_rule, chain};
+    for (const auto& word : rule)
+        words << (word.contains(' ') ? QString{"\"%1\""}.arg(word) : word);
 
-    auto exit_state = process->execute();
-
-    if (!exit_state.completed_successfully())
-        throw FirewallException("Failed to set firewall rule", table, exit_state.failure_message(),
-                                process->read_all_standard_error());
+    rules[table] << words.join(' ');
 }
 
-void delete_firewall_rule(const QString& firewall, const QString& table, const QStringList& chain_and_rule)
+void apply_firewall_rules(const QString& firewall, const Ruleset& rules)
 {
-    auto args = QStringList() << firewall << wait << dash_t << table << delete_rule << chain_and_rule;
+    QTemporaryFile rules_file;
+    if (!rules_file.open())
+        throw FirewallException("Failed to write firewall rules", rules.begin()->first, rules_file.errorString(), "");
 
-    auto process =
-        MP_PROCFACTORY.create_process(QStringLiteral("sh"), QStringList() << QStringLiteral("-c") << args.join(" "));
+    // Each table is committed at once, none is flushed of what is not ours
+    for (const auto& [table, lines] : rules)
+        rules_file.write(QString{"*%1\n%2\nCOMMIT\n"}.arg(table, lines.join('\n')).toUtf8());
+    rules_file.flush();
+
+    auto process = MP_PROCFACTORY.create_oneshot_process(firewall + QStringLiteral("-restore"),
+                                                         QStringList() << wait << noflush << rules_file.fileName());
 
     auto exit_state = process->execute();
 
     if (!exit_state.completed_successfully())
-        throw FirewallException("Failed to delete firewall rule", table, exit_state.failure_message(),
+    {
+        QStringList tables;
+        for (const auto& [table, lines] : rules)
+            tables << table;
+
+        throw FirewallException("Failed to apply firewall rules", tables.join(','), exit_state.failure_message(),
                                 process->read_all_standard_error());
+    }
 }
 
 auto get_firewall_rules(const QString& firewall, const QString& table)
 {
     // TODO: Parse out stderr so as not to log noisy warnings from iptables-nft when legacy iptables are in use
-    auto process = MP_PROCFACTORY.create_process(firewall, QStringList() << wait << dash_t << table << list_rules);
+    auto process =
+        MP_PROCFACTORY.create_oneshot_process(firewall, QStringList() << wait << dash_t << table << list_rules);
 
     auto exit_state = process->execute();
 
@@ -148,126 +179,145 @@ auto get_firewall_rules(const QString& firewall, const QString& table)
     return process->read_all_standard_output();
 }
 
-void set_firewall_rules(const QString& firewall, const QString& bridge_name, const QString& cidr,
-                        const QString& comment)
+Ruleset multipass_firewall_rules(const QString& bridge_name, const QString& cidr, const QString& comment)
 {
+    Ruleset rules;
     const QStringList comment_option{match, QStringLiteral("comment"), QStringLiteral("--comment"), comment};
 
     // Setup basic firewall overrides for DHCP/DNS
-    add_firewall_rule(firewall, filter, INPUT,
+    add_firewall_rule(rules, filter, INPUT,
                       QStringList() << in_interface << bridge_name << protocol << udp << dport << port_67 << jump
                                     << ACCEPT << comment_option);
 
-    add_firewall_rule(firewall, filter, INPUT,
+    add_firewall_rule(rules, filter, INPUT,
                       QStringList() << in_interface << bridge_name << protocol << udp << dport << port_53 << jump
                                     << ACCEPT << comment_option);
 
-    add_firewall_rule(firewall, filter, INPUT,
+    add_firewall_rule(rules, filter, INPUT,
                       QStringList() << in_interface << bridge_name << protocol << tcp << dport << port_53 << jump
                                     << ACCEPT << comment_option);
 
-    add_firewall_rule(firewall, filter, OUTPUT,
+    // For the instances seeded over nocloud-net
+    add_firewall_rule(rules, filter, INPUT,
+                      QStringList() << in_interface << bridge_name << protocol << tcp << dport << port_seed << jump
+                                    << ACCEPT << comment_option);
+
+    add_firewall_rule(rules, filter, OUTPUT,
                       QStringList() << out_interface << bridge_name << protocol << udp << sport << port_67 << jump
                                     << ACCEPT << comment_option);
 
-    add_firewall_rule(firewall, filter, OUTPUT,
+    add_firewall_rule(rules, filter, OUTPUT,
                       QStringList() << out_interface << bridge_name << protocol << udp << sport << port_53 << jump
                                     << ACCEPT << comment_option);
 
-    add_firewall_rule(firewall, filter, OUTPUT,
+    add_firewall_rule(rules, filter, OUTPUT,
                       QStringList() << out_interface << bridge_name << protocol << tcp << sport << port_53 << jump
                                     << ACCEPT << comment_option);
 
-    add_firewall_rule(firewall, mangle, POSTROUTING,
+    add_firewall_rule(rules, filter, OUTPUT,
+                      QStringList() << out_interface << bridge_name << protocol << tcp << sport << port_seed << jump
+                                    << ACCEPT << comment_option);
+
+    add_firewall_rule(rules, mangle, POSTROUTING,
                       QStringList() << out_interface << bridge_name << protocol << udp << dport << port_68 << jump
                                     << QStringLiteral("CHECKSUM") << QStringLiteral("--checksum-fill")
                                     << comment_option);
 
     // Do not masquerade to these reserved address blocks.
-    add_firewall_rule(firewall, nat, POSTROUTING,
+    add_firewall_rule(rules, nat, POSTROUTING,
                       QStringList() << source << cidr << destination << QStringLiteral("224.0.0.0/24") << jump << RETURN
                                     << comment_option);
 
-    add_firewall_rule(firewall, nat, POSTROUTING,
+    add_firewall_rule(rules, nat, POSTROUTING,
                       QStringList() << source << cidr << destination << QStringLiteral("255.255.255.255/32") << jump
                                     << RETURN << comment_option);
 
     // Masquerade all packets going from VMs to the LAN/Internet
-    add_firewall_rule(firewall, nat, POSTROUTING,
+    add_firewall_rule(rules, nat, POSTROUTING,
                       QStringList() << source << cidr << negate << destination << cidr << protocol << tcp << jump
                                     << MASQUERADE << to_ports << port_range << comment_option);
 
-    add_firewall_rule(firewall, nat, POSTROUTING,
+    add_firewall_rule(rules, nat, POSTROUTING,
                       QStringList() << source << cidr << negate << destination << cidr << protocol << udp << jump
                                     << MASQUERADE << to_ports << port_range << comment_option);
 
-    add_firewall_rule(firewall, nat, POSTROUTING,
+    add_firewall_rule(rules, nat, POSTROUTING,
                       QStringList() << source << cidr << negate << destination << cidr << jump << MASQUERADE
                                     << comment_option);
 
     // Allow established traffic to the private subnet
-    add_firewall_rule(firewall, filter, FORWARD,
+    add_firewall_rule(rules, filter, FORWARD,
                       QStringList() << destination << cidr << out_interface << bridge_name << match
                                     << QStringLiteral("conntrack") << QStringLiteral("--ctstate")
                                     << QStringLiteral("RELATED,ESTABLISHED") << jump << ACCEPT << comment_option);
 
     // Allow outbound traffic from the private subnet
-    add_firewall_rule(firewall, filter, FORWARD,
+    add_firewall_rule(rules, filter, FORWARD,
                       QStringList() << source << cidr << in_interface << bridge_name << jump << ACCEPT
                                     << comment_option);
 
     // Allow traffic between virtual machines
-    add_firewall_rule(firewall, filter, FORWARD,
+    add_firewall_rule(rules, filter, FORWARD,
                       QStringList() << in_interface << bridge_name << out_interface << bridge_name << jump << ACCEPT
                                     << comment_option);
 
     // Reject everything else
-    add_firewall_rule(firewall, filter, FORWARD,
+    add_firewall_rule(rules, filter, FORWARD,
                       QStringList() << in_interface << bridge_name << jump << REJECT << reject_with
                                     << icmp_port_unreachable << comment_option,
                       /*append=*/true);
 
-    add_firewall_rule(firewall, filter, FORWARD,
+    add_firewall_rule(rules, filter, FORWARD,
                       QStringList() << out_interface << bridge_name << jump << REJECT << reject_with
                                     << icmp_port_unreachable << comment_option,
                       /*append=*/true);
+
+    return rules;
 }
 
-void clear_firewall_rules_for(const QString& firewall, const QString& table, const QString& bridge_name,
-                              const QString& cidr, const QString& comment)
+// The deletion of whatever rules are ours, or for our bridge or subnet, in any of the tables, found in one dump
+Ruleset stale_firewall_rules(const QString& firewall, const QString& bridge_name, const QString& cidr,
+                             const QString& comment)
 {
-    auto rules = QString::fromUtf8(get_firewall_rules(firewall, table));
+    auto process = MP_PROCFACTORY.create_oneshot_process(firewall + QStringLiteral("-save"), QStringList{});
 
-    for (auto& rule : rules.split('\n'))
+    auto exit_state = process->execute();
+
+    if (!exit_state.completed_successfully())
+        throw FirewallException("Failed to get firewall rules", firewall_tables.join(','),
+                                exit_state.failure_message(), process->read_all_standard_error());
+
+    // Only the lines that are ours are turned into strings, a dump can hold a good many others
+    const auto output = process->read_all_standard_output();
+    const auto comment_text = comment.toStdString();
+    const auto bridge_text = bridge_name.toStdString();
+    const auto cidr_text = cidr.toStdString();
+
+    Ruleset rules;
+    QString table;
+    for (const auto line : mp::utils::lines_of(view_of(output)))
     {
-        if (rule.contains(comment) || rule.contains(bridge_name) || rule.contains(cidr))
-        {
-            // Remove the policy type since delete doesn't use that
-            rule.remove(0, 3);
-
-            try
-            {
-                // Pass the chain and rule wholesale since we capture the whole line
-                delete_firewall_rule(firewall, table, QStringList() << rule);
-            }
-            catch (const FirewallException& e)
-            {
-                mpl::log(mpl::Level::error, category,
-                         fmt::format("Error deleting firewall rule '{}': {}", rule, e.what()));
-            }
-        }
+        if (!line.empty() && line.front() == '*')
+            table = QString::fromUtf8(line.data() + 1, static_cast<int>(line.size() - 1)).trimmed();
+        else if (firewall_tables.contains(table) && line.substr(0, 3) == "-A " &&
+                 (contains(line, comment_text) || contains(line, bridge_text) || contains(line, cidr_text)))
+            rules[table] << delete_rule + QString::fromUtf8(line.data() + 2, static_cast<int>(line.size() - 2));
     }
+
+    return rules;
 }
 
 bool is_firewall_in_use(const QString& firewall)
 {
 
     return std::any_of(firewall_tables.cbegin(), firewall_tables.cend(), [&firewall](const QString& table) {
-        QRegularExpression re{"^-[ARIN]"};
-        auto rule_lines = get_firewall_rules(firewall, table).split('\n');
+        const auto rules = get_firewall_rules(firewall, table);
+        const auto rule_lines = mp::utils::lines_of(view_of(rules));
 
-        return std::any_of(rule_lines.cbegin(), rule_lines.cend(),
-                           [&re](const QString& line) { return re.match(line).hasMatch(); });
+        return std::any_of(rule_lines.begin(), rule_lines.end(), [](std::string_view line) {
+            constexpr std::string_view rule_commands{"ARIN"};
+            return line.size() > 1 && line[0] == '-' && rule_commands.find(line[1]) != std::string_view::npos;
+        });
     });
 }
 
@@ -323,8 +373,26 @@ mp::FirewallConfig::FirewallConfig(const QString& bridge_name, const std::string
 {
     try
     {
-        clear_all_firewall_rules();
-        set_firewall_rules(firewall, bridge_name, cidr, comment);
+        // Whatever is left from before is replaced in the same transaction, unless deleting it is what fails
+        const auto stale_rules = stale_firewall_rules(firewall, bridge_name, cidr, comment);
+        const auto new_rules = multipass_firewall_rules(bridge_name, cidr, comment);
+
+        try
+        {
+            auto rules = stale_rules;
+            for (const auto& [table, lines] : new_rules)
+                rules[table] << lines;
+
+            apply_firewall_rules(firewall, rules);
+        }
+        catch (const FirewallException& e)
+        {
+            if (stale_rules.empty())
+                throw;
+
+            mpl::log(mpl::Level::error, category, fmt::format("Error deleting firewall rules: {}", e.what()));
+            apply_firewall_rules(firewall, new_rules);
+        }
     }
     catch (const FirewallException& e)
     {
@@ -352,9 +420,17 @@ void mp::FirewallConfig::verify_firewall_rules()
 
 void mp::FirewallConfig::clear_all_firewall_rules()
 {
-    for (const auto& table : firewall_tables)
+    const auto rules = stale_firewall_rules(firewall, bridge_name, cidr, comment);
+    if (rules.empty())
+        return;
+
+    try
+    {
+        apply_firewall_rules(firewall, rules);
+    }
+    catch (const FirewallException& e)
     {
-        clear_firewall_rules_for(firewall, table, bridge_name, cidr, comment);
+        mpl::log(mpl::Level::error, category, fmt::format("Error deleting firewall rules: {}", e.what()));
     }
 }
 
@@ -0,0 +1,267 @@
+/*
+ * Copyright (C) Canonical, Ltd.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; version 3.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#include "netlink.h"
+
+#include <multipass/format.h>
+
+#include <scope_guard.hpp>
+
+#include <array>
+#include <cerrno>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <stdexcept>
+
+#include <arpa/inet.h>
+#include <fcntl.h>
+#include <linux/if_tun.h>
+#include <linux/netlink.h>
+#include <linux/rtnetlink.h>
+#include <net/if.h>
+#include <sys/ioctl.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+namespace mp = multipass;
+
+namespace
+{
+[[noreturn]] void throw_errno(const std::string& what, int error = errno)
+{
+    throw std::runtime_error{fmt::format("{}: {}", what, std::strerror(error))};
+}
+
+unsigned int index_of(const QString& name)
+{
+    const auto index = if_nametoindex(qUtf8Printable(name));
+    if (index == 0)
+        throw_errno(fmt::format("Could not find network interface {}", name));
+
+    return index;
+}
+
+in_addr ipv4_address(const std::string& address)
+{
+    in_addr parsed{};
+    if (inet_pton(AF_INET, address.c_str(), &parsed) != 1)
+        throw std::runtime_error{fmt::format("Invalid IPv4 address: {}", address)};
+
+    return parsed;
+}
+
+std::array<unsigned char, 6> hardware_address(const std::string& mac_address)
+{
+    std::array<unsigned char, 6> parsed{};
+    if (std::sscanf(mac_address.c_str(), "%hhx:%hhx:%hhx:%hhx:%hhx:%hhx", &parsed[0], &parsed[1], &parsed[2],
+                    &parsed[3], &parsed[4], &parsed[5]) != 6)
+        throw std::runtime_error{fmt::format("Invalid MAC address: {}", mac_address)};
+
+    return parsed;
+}
+
+// A single rtnetlink request, sent on its own socket and acknowledged by the kernel
+class Request
+{
+public:
+    Request(std::uint16_t type, std::uint16_t flags)
+    {
+        auto header = reinterpret_cast<nlmsghdr*>(buffer.data());
+        header->nlmsg_type = type;
+        header->nlmsg_flags = NLM_F_REQUEST | NLM_F_ACK | flags;
+        header->nlmsg_seq = 1;
+        length = NLMSG_HDRLEN;
+    }
+
+    template <typename T>
+    void append(const T& payload)
+    {
+        put(&payload, sizeof(T));
+    }
+
+    void attribute(std::uint16_t type, const void* data, std::size_t size)
+    {
+        rtattr attr{};
+        attr.rta_type = type;
+        attr.rta_len = RTA_LENGTH(size);
+        put(&attr, sizeof(attr));
+        put(data, size);
+    }
+
+    template <typename T>
+    void attribute(std::uint16_t type, const T& data)
+    {
+        attribute(type, &data, sizeof(T));
+    }
+
+    void attribute(std::uint16_t type, const QString& value)
+    {
+        const auto bytes = value.toUtf8();
+        attribute(type, bytes.constData(), bytes.size() + 1); // with its terminator
+    }
+
+    std::size_t begin_nested(std::uint16_t type)
+    {
+        const auto offset = length;
+        attribute(type, nullptr, 0);
+        return offset;
+    }
+
+    void end_nested(std::size_t offset)
+    {
+        reinterpret_cast<rtattr*>(buffer.data() + offset)->rta_len = length - offset;
+    }
+
+    void send(const std::string& what)
+    {
+        const auto fd = socket(AF_NETLINK, SOCK_RAW | SOCK_CLOEXEC, NETLINK_ROUTE);
+        if (fd < 0)
+            throw_errno(fmt::format("{}: could not open a netlink socket", what));
+        auto close_socket = sg::make_scope_guard([fd]() noexcept { close(fd); });
+
+        reinterpret_cast<nlmsghdr*>(buffer.data())->nlmsg_len = length;
+
+        sockaddr_nl kernel{};
+        kernel.nl_family = AF_NETLINK;
+        if (sendto(fd, buffer.data(), length, 0, reinterpret_cast<sockaddr*>(&kernel), sizeof(kernel)) < 0)
+            throw_errno(what);
+
+        alignas(nlmsghdr) std::array<char, 4096> reply{};
+        const auto received = recv(fd, reply.data(), reply.size(), 0);
+        if (received < 0)
+            throw_errno(what);
+
+        const auto reply_header = reinterpret_cast<const nlmsghdr*>(reply.data());
+        if (received < static_cast<ssize_t>(NLMSG_LENGTH(sizeof(nlmsgerr))) || reply_header->nlmsg_type != NLMSG_ERROR)
+            throw std::runtime_error{fmt::format("{}: unexpected reply from the kernel", what)};
+
+        if (const auto error = reinterpret_cast<const nlmsgerr*>(NLMSG_DATA(reply_header))->error; error)
+            throw_errno(what, -error);
+    }
+
+private:
+    void put(const void* data, std::size_t size)
+    {
+        if (NLMSG_ALIGN(length + size) > buffer.size())
+            throw std::length_error{"Netlink request too long"};
+
+        if (size)
+            std::memcpy(buffer.data() + length, data, size);
+        length = NLMSG_ALIGN(length + size); // the buffer starts zeroed, so is the padding
+    }
+
+    alignas(nlmsghdr) std::array<char, 512> buffer{};
+    std::size_t length;
+};
+
+ifinfomsg link_info(unsigned int index = 0)
+{
+    ifinfomsg info{};
+    info.ifi_family = AF_UNSPEC;
+    info.ifi_index = static_cast<int>(index);
+    return info;
+}
+} // namespace
+
+mp::Netlink::Netlink(const Singleton<Netlink>::PrivatePass& pass) noexcept : Singleton<Netlink>::Singleton{pass}
+{
+}
+
+bool mp::Netlink::link_exists(const QString& name) const
+{
+    return if_nametoindex(qUtf8Printable(name)) != 0;
+}
+
+void mp::Netlink::add_tap(const QString& name, bool multi_queue) const
+{
+    const auto what = fmt::format("Could not add tap device {}", name);
+
+    const auto fd = open("/dev/net/tun", O_RDWR | O_CLOEXEC);
+    if (fd < 0)
+        throw_errno(what);
+    auto close_tun = sg::make_scope_guard([fd]() noexcept { close(fd); });
+
+    ifreq request{};
+    request.ifr_flags = IFF_TAP | IFF_NO_PI | (multi_queue ? IFF_MULTI_QUEUE : 0);
+    std::strncpy(request.ifr_name, qUtf8Printable(name), IFNAMSIZ - 1);
+
+    if (ioctl(fd, TUNSETIFF, &request) < 0 || ioctl(fd, TUNSETPERSIST, 1) < 0)
+        throw_errno(what);
+}
+
+void mp::Netlink::add_bridge(const QString& name, const std::string& mac_address) const
+{
+    Request request{RTM_NEWLINK, NLM_F_CREATE | NLM_F_EXCL};
+    request.append(link_info());
+    request.attribute(IFLA_IFNAME, name);
+    request.attribute(IFLA_ADDRESS, hardware_address(mac_address));
+
+    const auto link_info_offset = request.begin_nested(IFLA_LINKINFO);
+    request.attribute(IFLA_INFO_KIND, QString{"bridge"});
+    request.end_nested(link_info_offset);
+
+    request.send(fmt::format("Could not add bridge {}", name));
+}
+
+void mp::Netlink::add_address(const QString& name, const std::string& address, int prefix_length,
+                              const std::string& broadcast) const
+{
+    const auto what = fmt::format("Could not add address {}/{} to {}", address, prefix_length, name);
+
+    ifaddrmsg info{};
+    info.ifa_family = AF_INET;
+    info.ifa_prefixlen = static_cast<unsigned char>(prefix_length);
+    info.ifa_index = index_of(name);
+
+    Request request{RTM_NEWADDR, NLM_F_CREATE | NLM_F_EXCL};
+    request.append(info);
+    request.attribute(IFA_LOCAL, ipv4_address(address));
+    request.attribute(IFA_ADDRESS, ipv4_address(address));
+    request.attribute(IFA_BROADCAST, ipv4_address(broadcast));
+
+    request.send(what);
+}
+
+void mp::Netlink::set_master(const QString& name, const QString& master) const
+{
+    Request request{RTM_NEWLINK, 0};
+    request.append(link_info(index_of(name)));
+    request.attribute(IFLA_MASTER, static_cast<std::uint32_t>(index_of(master)));
+
+    request.send(fmt::format("Could not attach {} to {}", name, master));
+}
+
+void mp::Netlink::set_up(const QString& name) const
+{
+    auto info = link_info(index_of(name));
+    info.ifi_flags = IFF_UP;
+    info.ifi_change = IFF_UP;
+
+    Request request{RTM_NEWLINK, 0};
+    request.append(info);
+
+    request.send(fmt::format("Could not bring up {}", name));
+}
+
+void mp::Netlink::delete_link(const QString& name) const
+{
+    Request request{RTM_DELLINK, 0};
+    request.append(link_info(index_of(name)));
+
+    request.send(fmt::format("Could not delete {}", name));
+}
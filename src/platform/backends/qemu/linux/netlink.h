@@ -0,0 +1,49 @@
+/*
+ * Copyright (C) Canonical, Ltd.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; version 3.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#ifndef MULTIPASS_NETLINK_H
+#define MULTIPASS_NETLINK_H
+
+#include <multipass/singleton.h>
+
+#include <string>
+
+#include <QString>
+
+#define MP_NETLINK multipass::Netlink::instance()
+
+namespace multipass
+{
+// Manages network links through rtnetlink and the tun device, rather than forking ip(8) for every change.
+// Failures are thrown as std::runtime_error, carrying the kernel's reason.
+class Netlink : public Singleton<Netlink>
+{
+public:
+    Netlink(const Singleton<Netlink>::PrivatePass&) noexcept;
+
+    virtual bool link_exists(const QString& name) const;
+    // Persistent, so it outlives the daemon's file descriptor; with multi_queue, QEMU must open it with several queues
+    virtual void add_tap(const QString& name, bool multi_queue) const;
+    virtual void add_bridge(const QString& name, const std::string& mac_address) const;
+    virtual void add_address(const QString& name, const std::string& address, int prefix_length,
+                             const std::string& broadcast) const;
+    virtual void set_master(const QString& name, const QString& master) const;
+    virtual void set_up(const QString& name) const;
+    virtual void delete_link(const QString& name) const;
+};
+} // namespace multipass
+#endif // MULTIPASS_NETLINK_H
@@ -20,11 +20,13 @@
 
 #include "dnsmasq_server.h"
 #include "firewall_config.h"
+#include "seed_server.h"
 
 #include <qemu_platform.h>
 
 #include <multipass/path.h>
 
+#include <atomic>
 #include <unordered_map>
 #include <utility>
 
@@ -41,6 +43,10 @@ public:
     void remove_resources_for(const std::string& name) override;
     void platform_health_check() override;
     QStringList vm_platform_args(const VirtualMachineDescription& vm_desc) override;
+    void limit_network(const std::string& name, int mbits) override;
+    std::optional<std::pair<std::uint64_t, std::uint64_t>> network_counters(const std::string& name) override;
+    bool serves_seeds() const override;
+    QStringList seed_platform_args(const std::string& name, const QString& seed_dir) override;
 
 private:
     const QString bridge_name;
@@ -48,7 +54,9 @@ private:
     const std::string subnet;
     DNSMasqServer::UPtr dnsmasq_server;
     FirewallConfig::UPtr firewall_config;
+    SeedServer::UPtr seed_server;
     std::unordered_map<std::string, std::pair<QString, std::string>> name_to_net_device_map;
+    std::atomic_bool kvm_supported{false};
 };
 } // namespace multipass
 #endif // MULTIPASS_QEMU_PLATFORM_DETAIL_H
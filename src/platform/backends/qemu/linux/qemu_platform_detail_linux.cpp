@@ -15,17 +15,25 @@
  *
  */
 
+#include "netlink.h"
 #include "qemu_platform_detail.h"
 
+#include <multipass/constants.h>
 #include <multipass/file_ops.h>
 #include <multipass/format.h>
 #include <multipass/logging/log.h>
+#include <multipass/settings/settings.h>
 #include <multipass/utils.h>
 
 #include <shared/linux/backend_utils.h>
 
 #include <QFile>
 
+#include <algorithm>
+#include <future>
+#include <stdexcept>
+#include <vector>
+
 namespace mp = multipass;
 namespace mpl = multipass::logging;
 
@@ -44,39 +52,101 @@ auto generate_tap_device_name(const std::string& vm_name)
     return QString::fromStdString(tap_name);
 }
 
-void create_tap_device(const QString& tap_name, const QString& bridge_name)
+std::optional<std::uint64_t> read_tap_counter(const QString& tap_name, const QString& counter)
 {
-    if (!MP_UTILS.run_cmd_for_status("ip", {"addr", "show", tap_name}))
-    {
-        MP_UTILS.run_cmd_for_status("ip", {"tuntap", "add", tap_name, "mode", "tap"});
-        MP_UTILS.run_cmd_for_status("ip", {"link", "set", tap_name, "master", bridge_name});
-        MP_UTILS.run_cmd_for_status("ip", {"link", "set", tap_name, "up"});
-    }
+    QFile counter_file{QString{"/sys/class/net/%1/statistics/%2"}.arg(tap_name, counter)};
+    if (!MP_FILEOPS.open(counter_file, QFile::ReadOnly))
+        return std::nullopt;
+
+    bool ok{false};
+    const auto value = counter_file.readAll().trimmed().toULongLong(&ok);
+    return ok ? std::make_optional<std::uint64_t>(value) : std::nullopt;
+}
+
+void create_tap_device(const QString& tap_name, const QString& bridge_name, bool multi_queue)
+try
+{
+    // One left from an earlier boot may not have the queues wanted now, and nothing holds it while QEMU is not running
+    if (MP_NETLINK.link_exists(tap_name))
+        MP_NETLINK.delete_link(tap_name);
+
+    MP_NETLINK.add_tap(tap_name, multi_queue);
+    MP_NETLINK.set_master(tap_name, bridge_name);
+    MP_NETLINK.set_up(tap_name);
+}
+catch (const std::exception& e)
+{
+    mpl::log(mpl::Level::warning, category, e.what());
+}
+
+// vhost-net moves packets in the kernel rather than through QEMU, where the host has it
+std::string netdev_option(const QString& tap_name, int queues)
+{
+    auto option = fmt::format("tap,id=hostnet0,ifname={},script=no,downscript=no", tap_name);
+    if (QFile::exists("/dev/vhost-net"))
+        option += ",vhost=on";
+    if (queues > 1)
+        option += fmt::format(",queues={}", queues);
+
+    return option;
+}
+
+std::string nic_option(const std::string& mac_address, int queues)
+{
+    auto option = fmt::format("virtio-net-pci,netdev=hostnet0,mac={}", mac_address);
+    if (queues > 1)
+        option += fmt::format(",mq=on,vectors={}", 2 * queues + 2); // one per queue, plus config and control
+
+    return option;
+}
+
+// What the tap sends is what the guest receives and the other way around: the former is shaped, the latter policed
+void limit_tap_device(const QString& tap_name, int mbits)
+{
+    const auto rate = QString("%1mbit").arg(mbits);
+    const auto burst = QString::number(std::max(mbits * 1250, 32768)); // 10ms worth of bytes, at least a few frames
+    const std::vector<QStringList> commands{
+        {"qdisc", "replace", "dev", tap_name, "root", "tbf", "rate", rate, "burst", burst, "latency", "50ms"},
+        {"qdisc", "replace", "dev", tap_name, "handle", "ffff:", "ingress"},
+        {"filter", "replace", "dev", tap_name, "parent", "ffff:", "matchall", "action", "police", "rate", rate,
+         "burst", burst, "drop"}};
+
+    for (const auto& args : commands)
+        if (!MP_UTILS.run_cmd_for_status("tc", args))
+            throw std::runtime_error{fmt::format("Could not limit the network of {}: tc {}", tap_name, args.join(' '))};
 }
 
 void remove_tap_device(const QString& tap_device_name)
+try
 {
-    if (MP_UTILS.run_cmd_for_status("ip", {"addr", "show", tap_device_name}))
+    if (MP_NETLINK.link_exists(tap_device_name))
     {
-        MP_UTILS.run_cmd_for_status("ip", {"link", "delete", tap_device_name});
+        MP_NETLINK.delete_link(tap_device_name);
     }
 }
+catch (const std::exception& e)
+{
+    mpl::log(mpl::Level::warning, category, e.what());
+}
 
 void create_virtual_switch(const std::string& subnet, const QString& bridge_name)
+try
 {
-    if (!MP_UTILS.run_cmd_for_status("ip", {"addr", "show", bridge_name}))
+    if (!MP_NETLINK.link_exists(bridge_name))
     {
         const auto mac_address = mp::utils::generate_mac_address();
-        const auto cidr = fmt::format("{}.1/24", subnet);
+        const auto address = fmt::format("{}.1", subnet);
         const auto broadcast = fmt::format("{}.255", subnet);
 
-        MP_UTILS.run_cmd_for_status("ip",
-                                    {"link", "add", bridge_name, "address", mac_address.c_str(), "type", "bridge"});
-        MP_UTILS.run_cmd_for_status(
-            "ip", {"address", "add", cidr.c_str(), "dev", bridge_name, "broadcast", broadcast.c_str()});
-        MP_UTILS.run_cmd_for_status("ip", {"link", "set", bridge_name, "up"});
+        MP_NETLINK.add_bridge(bridge_name, mac_address);
+        MP_NETLINK.add_address(bridge_name, address, 24, broadcast);
+        MP_NETLINK.set_up(bridge_name);
     }
 }
+catch (const std::exception& e)
+{
+    mpl::log(mpl::Level::warning, category, e.what());
+}
 
 void set_ip_forward()
 {
@@ -106,21 +176,54 @@ mp::DNSMasqServer::UPtr init_nat_network(const mp::Path& network_dir, const QStr
 }
 
 void delete_virtual_switch(const QString& bridge_name)
+try
 {
-    if (MP_UTILS.run_cmd_for_status("ip", {"addr", "show", bridge_name}))
+    if (MP_NETLINK.link_exists(bridge_name))
     {
-        MP_UTILS.run_cmd_for_status("ip", {"link", "delete", bridge_name});
+        MP_NETLINK.delete_link(bridge_name);
     }
 }
+catch (const std::exception& e)
+{
+    mpl::log(mpl::Level::warning, category, e.what());
+}
 } // namespace
 
 mp::QemuPlatformDetail::QemuPlatformDetail(const mp::Path& data_dir)
     : bridge_name{multipass_bridge_name},
       network_dir{MP_UTILS.make_dir(QDir(data_dir), "network")},
-      subnet{MP_BACKEND.get_subnet(network_dir, bridge_name)},
-      dnsmasq_server{init_nat_network(network_dir, bridge_name, subnet)},
-      firewall_config{MP_FIREWALL_CONFIG_FACTORY.make_firewall_config(bridge_name, subnet)}
+      subnet{MP_BACKEND.get_subnet(network_dir, bridge_name)}
 {
+    // Firewall rules need nothing of the bridge or dnsmasq, and both take running a few processes
+    auto firewall = std::async(std::launch::async, [this] {
+        return MP_FIREWALL_CONFIG_FACTORY.make_firewall_config(bridge_name, subnet);
+    });
+
+    dnsmasq_server = init_nat_network(network_dir, bridge_name, subnet);
+    firewall_config = firewall.get();
+
+    // Opt-in, as the instances launched with it need it until they are deleted
+    if (MP_SETTINGS.get(mp::qemu_nocloud_net_key) == "true")
+    {
+        try
+        {
+            // What instances ask for is served in this same thread, where the devices are kept track of too
+            auto address_of = [this](const std::string& name) -> std::optional<std::string> {
+                const auto it = name_to_net_device_map.find(name);
+                if (it == name_to_net_device_map.end())
+                    return std::nullopt;
+
+                const auto ip = dnsmasq_server->get_ip_for(it->second.second);
+                return ip ? std::make_optional(ip->as_string()) : std::nullopt;
+            };
+            seed_server = std::make_unique<SeedServer>(QString::fromStdString(fmt::format("{}.1", subnet)),
+                                                       seed_server_port, address_of);
+        }
+        catch (const std::exception& e)
+        {
+            mpl::log(mpl::Level::warning, category, e.what());
+        }
+    }
 }
 
 mp::QemuPlatformDetail::~QemuPlatformDetail()
@@ -150,11 +253,19 @@ void mp::QemuPlatformDetail::remove_resources_for(const std::string& name)
 
         name_to_net_device_map.erase(name);
     }
+
+    if (seed_server)
+        seed_server->stop_serving(name);
 }
 
 void mp::QemuPlatformDetail::platform_health_check()
 {
-    MP_BACKEND.check_for_kvm_support();
+    // Only checked until it is there, as KVM does not go away short of unloading its modules
+    if (!kvm_supported)
+    {
+        MP_BACKEND.check_for_kvm_support();
+        kvm_supported = true;
+    }
     MP_BACKEND.check_if_kvm_is_in_use();
 
     dnsmasq_server->check_dnsmasq_running();
@@ -164,11 +275,16 @@ void mp::QemuPlatformDetail::platform_health_check()
 QStringList mp::QemuPlatformDetail::vm_platform_args(const VirtualMachineDescription& vm_desc)
 {
     // Configure and generate the args for the default network interface
+    // A queue pair per vCPU, so that guest and host can move packets on all of them at once
+    const auto queues = std::max(vm_desc.num_cores, 1);
     auto tap_device_name = generate_tap_device_name(vm_desc.vm_name);
-    create_tap_device(tap_device_name, bridge_name);
+    create_tap_device(tap_device_name, bridge_name, queues > 1);
 
     name_to_net_device_map.emplace(vm_desc.vm_name, std::make_pair(tap_device_name, vm_desc.default_mac_address));
 
+    // Its address known before it boots, rather than once dnsmasq has leased one
+    dnsmasq_server->reserve_ip_for(vm_desc.default_mac_address);
+
     QStringList opts;
 
     // Work around for Xenial where UEFI images are not one and the same
@@ -188,13 +304,50 @@ QStringList mp::QemuPlatformDetail::vm_platform_args(const VirtualMachineDescrip
          << "-cpu"
          << "host"
          // Set up the network related args
-         << "-nic"
-         << QString::fromStdString(fmt::format("tap,ifname={},script=no,downscript=no,model=virtio-net-pci,mac={}",
-                                               tap_device_name, vm_desc.default_mac_address));
+         << "-netdev" << QString::fromStdString(netdev_option(tap_device_name, queues)) << "-device"
+         << QString::fromStdString(nic_option(vm_desc.default_mac_address, queues));
 
     return opts;
 }
 
+void mp::QemuPlatformDetail::limit_network(const std::string& name, int mbits)
+{
+    // The tap is created anew for each boot, so there is no limit to lift
+    const auto it = name_to_net_device_map.find(name);
+    if (mbits && it != name_to_net_device_map.end())
+        limit_tap_device(it->second.first, mbits);
+}
+
+std::optional<std::pair<std::uint64_t, std::uint64_t>> mp::QemuPlatformDetail::network_counters(const std::string& name)
+{
+    const auto it = name_to_net_device_map.find(name);
+    if (it == name_to_net_device_map.end())
+        return std::nullopt;
+
+    // What the tap transmits is what the instance receives, and the other way around
+    const auto received = read_tap_counter(it->second.first, "tx_bytes");
+    const auto sent = read_tap_counter(it->second.first, "rx_bytes");
+    if (!received || !sent)
+        return std::nullopt;
+
+    return std::make_pair(*received, *sent);
+}
+
+bool mp::QemuPlatformDetail::serves_seeds() const
+{
+    return seed_server != nullptr;
+}
+
+QStringList mp::QemuPlatformDetail::seed_platform_args(const std::string& name, const QString& seed_dir)
+{
+    if (!seed_server)
+        throw std::runtime_error{fmt::format("{} is seeded over nocloud-net, which needs {} set to true", name,
+                                             mp::qemu_nocloud_net_key)};
+
+    // cloud-init looks for datasources in the system serial number before anywhere else
+    return {"-smbios", QString{"type=1,serial=ds=nocloud-net;s=%1"}.arg(seed_server->serve(name, seed_dir))};
+}
+
 mp::QemuPlatform::UPtr mp::QemuPlatformFactory::make_qemu_platform(const Path& data_dir) const
 {
     return std::make_unique<mp::QemuPlatformDetail>(data_dir);
@@ -0,0 +1,138 @@
+/*
+ * Copyright (C) Canonical, Ltd.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; version 3.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#include "seed_server.h"
+
+#include <multipass/format.h>
+#include <multipass/logging/log.h>
+
+#include <QDir>
+#include <QFile>
+#include <QHostAddress>
+#include <QTcpSocket>
+
+#include <stdexcept>
+
+namespace mp = multipass;
+namespace mpl = multipass::logging;
+
+namespace
+{
+constexpr auto category = "seed server";
+constexpr auto max_request_size = 8192;
+const QStringList seed_files{"meta-data", "user-data", "vendor-data", "network-config"};
+
+void respond(QTcpSocket* socket, const QByteArray& status, const QByteArray& body = {})
+{
+    socket->write("HTTP/1.1 " + status + "\r\nContent-Length: " + QByteArray::number(body.size()) +
+                  "\r\nConnection: close\r\n\r\n" + body);
+}
+} // namespace
+
+mp::SeedServer::SeedServer(const QString& address, quint16 port, AddressOf address_of)
+    : address_of{std::move(address_of)}
+{
+    QObject::connect(&server, &QTcpServer::newConnection, [this] {
+        while (auto socket = server.nextPendingConnection())
+        {
+            QObject::connect(socket, &QTcpSocket::disconnected, socket, &QObject::deleteLater);
+            QObject::connect(socket, &QTcpSocket::readyRead, socket, [this, socket] { respond_to(socket); });
+        }
+    });
+
+    // Only on the address of the bridge, no one but the instances has any business with their seeds
+    if (!server.listen(QHostAddress{address}, port))
+        throw std::runtime_error(fmt::format("Cannot serve cloud-init seeds on {}:{}: {}", address, port,
+                                             server.errorString()));
+
+    base_url = QString{"http://%1:%2/"}.arg(address).arg(server.serverPort());
+    mpl::log(mpl::Level::info, category, fmt::format("Serving cloud-init seeds at {}", base_url));
+}
+
+QString mp::SeedServer::serve(const std::string& name, const QString& seed_dir)
+{
+    std::lock_guard lock{mutex};
+    seed_dirs[name] = seed_dir;
+
+    return base_url + QString::fromStdString(name) + '/';
+}
+
+void mp::SeedServer::stop_serving(const std::string& name)
+{
+    std::lock_guard lock{mutex};
+    seed_dirs.erase(name);
+}
+
+void mp::SeedServer::respond_to(QTcpSocket* socket)
+{
+    // Whatever comes after the request is of no interest
+    if (socket->property("answered").toBool())
+    {
+        socket->readAll();
+        return;
+    }
+
+    const auto request = socket->peek(max_request_size);
+    const auto headers_end = request.indexOf("\r\n\r\n");
+    if (headers_end < 0 && request.size() < max_request_size)
+        return;
+
+    socket->setProperty("answered", true);
+    socket->readAll();
+
+    const auto request_line = request.left(request.indexOf("\r\n")).split(' ');
+    const auto method = request_line.value(0);
+    const auto target = QString::fromUtf8(request_line.value(1)).split('/', QString::SkipEmptyParts);
+
+    QString seed_dir;
+    if (target.size() == 2 && seed_files.contains(target[1]))
+    {
+        std::lock_guard lock{mutex};
+        if (const auto it = seed_dirs.find(target[0].toStdString()); it != seed_dirs.end())
+            seed_dir = it->second;
+    }
+
+    // Seeds carry keys and passwords, that no other instance on the bridge is to read
+    auto from_instance = false;
+    if (!seed_dir.isEmpty())
+    {
+        const auto instance_address = address_of(target[0].toStdString());
+        from_instance = instance_address && QHostAddress{QString::fromStdString(*instance_address)}.isEqual(
+                                                socket->peerAddress(), QHostAddress::TolerantConversion);
+    }
+
+    QFile file{QDir{seed_dir}.filePath(target.value(1))};
+    if (headers_end < 0)
+        respond(socket, "431 Request Header Fields Too Large");
+    else if (method != "GET")
+        respond(socket, "405 Method Not Allowed");
+    else if (!seed_dir.isEmpty() && !from_instance)
+    {
+        mpl::log(mpl::Level::warning, category,
+                 fmt::format("Refusing {} the seed of {}", socket->peerAddress().toString(), target[0]));
+        respond(socket, "403 Forbidden");
+    }
+    else if (seed_dir.isEmpty() || !file.open(QIODevice::ReadOnly))
+        respond(socket, "404 Not Found");
+    else
+    {
+        mpl::log(mpl::Level::debug, category, fmt::format("Sending {} its {}", target[0], target[1]));
+        respond(socket, "200 OK", file.readAll()); // a few kilobytes of YAML at most
+    }
+
+    socket->disconnectFromHost();
+}
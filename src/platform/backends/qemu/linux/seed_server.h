@@ -0,0 +1,64 @@
+/*
+ * Copyright (C) Canonical, Ltd.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; version 3.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#ifndef MULTIPASS_SEED_SERVER_H
+#define MULTIPASS_SEED_SERVER_H
+
+#include <multipass/disabled_copy_move.h>
+
+#include <QString>
+#include <QTcpServer>
+
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <unordered_map>
+
+class QTcpSocket;
+
+namespace multipass
+{
+constexpr quint16 seed_server_port = 8053;
+
+// Serves cloud-init's nocloud-net datasource, the files in the seed directory of each instance it was told of as
+// GET /<instance>/<file>, to that instance alone. Works in the event loop of the thread it was made on.
+class SeedServer : private DisabledCopyMove
+{
+public:
+    using UPtr = std::unique_ptr<SeedServer>;
+    // The address an instance currently has, if it has one yet
+    using AddressOf = std::function<std::optional<std::string>(const std::string& name)>;
+
+    SeedServer(const QString& address, quint16 port, AddressOf address_of);
+
+    // The URL the instance is to find its seed at, ending in a slash as cloud-init appends the file names to it
+    QString serve(const std::string& name, const QString& seed_dir);
+    void stop_serving(const std::string& name);
+
+private:
+    void respond_to(QTcpSocket* socket);
+
+    const AddressOf address_of;
+    QString base_url;
+    std::mutex mutex;
+    std::unordered_map<std::string, QString> seed_dirs;
+    QTcpServer server;
+};
+} // namespace multipass
+#endif // MULTIPASS_SEED_SERVER_H
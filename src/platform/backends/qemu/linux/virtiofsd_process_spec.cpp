@@ -0,0 +1,131 @@
+/*
+ * Copyright (C) Canonical, Ltd.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; version 3.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#include "virtiofsd_process_spec.h"
+
+#include <multipass/exceptions/snap_environment_exception.h>
+#include <multipass/snap_utils.h>
+
+#include <QFileInfo>
+
+namespace mp = multipass;
+namespace mu = multipass::utils;
+
+namespace
+{
+QString root_dir()
+{
+    try
+    {
+        return mu::snap_dir();
+    }
+    catch (const mp::SnapEnvironmentException&)
+    {
+        return {};
+    }
+}
+} // namespace
+
+mp::VirtiofsdProcessSpec::VirtiofsdProcessSpec(const QString& shared_dir, const QString& socket_path)
+    : shared_dir{shared_dir}, socket_path{socket_path}
+{
+}
+
+QString mp::VirtiofsdProcessSpec::locate()
+{
+    // virtiofsd is not meant to be in $PATH, distributions put it in one of these
+    for (const auto* dir : {"/usr/libexec", "/usr/lib/qemu"})
+    {
+        const QFileInfo candidate{QString{"%1%2/virtiofsd"}.arg(root_dir(), dir)};
+        if (candidate.isExecutable())
+            return candidate.filePath();
+    }
+
+    return {};
+}
+
+QString mp::VirtiofsdProcessSpec::program() const
+{
+    return locate();
+}
+
+QStringList mp::VirtiofsdProcessSpec::arguments() const
+{
+    return QStringList() << QString("--socket-path=%1").arg(socket_path)
+                         << QString("--shared-dir=%1").arg(shared_dir)
+                         // multipassd doesn't leave room for its own namespaces, a chroot is enough to keep it in
+                         << "--sandbox=chroot"
+                         << "--cache=auto";
+}
+
+QString mp::VirtiofsdProcessSpec::apparmor_profile() const
+{
+    QString profile_template(R"END(
+#include <tunables/global>
+profile %1 flags=(attach_disconnected) {
+  #include <abstractions/base>
+
+  # serving files on behalf of the guest, whoever owns them
+  capability chown,
+  capability dac_override,
+  capability dac_read_search,
+  capability fowner,
+  capability fsetid,
+  capability mknod,
+  capability setfcap,
+  capability setgid,
+  capability setuid,
+
+  # for the sandbox and raising the open file limit
+  capability sys_chroot,
+  capability sys_resource,
+
+  # Allow multipassd send virtiofsd signals
+  signal (receive) peer=%2,
+
+  @{PROC}/sys/fs/file-max r,
+  owner @{PROC}/@{pid}/** r,
+
+  # binary and its libs
+  %3 ixr,
+  %4/{,usr/}lib/@{multiarch}/{,**/}*.so* rm,
+
+  # CLASSIC ONLY: need to specify required libs from core snap
+  /{,var/lib/snapd/}snap/core18/*/{,usr/}lib/@{multiarch}/{,**/}*.so* rm,
+
+  # vhost-user socket QEMU connects to, and the lock next to it
+  %5 rw,
+  %5.pid rwk,
+
+  # allow full access just to the shared directory
+  %6/ rw,
+  %6/** rwlk,
+}
+    )END");
+
+    const auto root = root_dir();
+    // if snap confined, specify only multipassd can kill virtiofsd
+    const QString signal_peer = root.isEmpty() ? "unconfined" : "snap.multipass.multipassd";
+
+    return profile_template.arg(apparmor_profile_name(), signal_peer, program(), root, socket_path, shared_dir);
+}
+
+QString mp::VirtiofsdProcessSpec::identifier() const
+{
+    // there is one virtiofsd per mount, each needs a profile of its own
+    return QFileInfo{socket_path}.completeBaseName();
+}
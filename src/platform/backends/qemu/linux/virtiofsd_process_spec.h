@@ -0,0 +1,47 @@
+/*
+ * Copyright (C) Canonical, Ltd.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; version 3.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#ifndef MULTIPASS_VIRTIOFSD_PROCESS_SPEC_H
+#define MULTIPASS_VIRTIOFSD_PROCESS_SPEC_H
+
+#include <multipass/process/process_spec.h>
+
+namespace multipass
+{
+
+class VirtiofsdProcessSpec : public ProcessSpec
+{
+public:
+    explicit VirtiofsdProcessSpec(const QString& shared_dir, const QString& socket_path);
+
+    // Where virtiofsd is installed, empty if it cannot be found
+    static QString locate();
+
+    QString program() const override;
+    QStringList arguments() const override;
+
+    QString apparmor_profile() const override;
+    QString identifier() const override;
+
+private:
+    const QString shared_dir;
+    const QString socket_path;
+};
+
+} // namespace multipass
+
+#endif // MULTIPASS_VIRTIOFSD_PROCESS_SPEC_H
@@ -0,0 +1,188 @@
+/*
+ * Copyright (C) Canonical, Ltd.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; version 3.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#include "qemu_attached_process.h"
+
+#include <multipass/format.h>
+
+#include <QElapsedTimer>
+#include <QThread>
+
+#include <cerrno>
+#include <stdexcept>
+
+#include <signal.h>
+
+namespace mp = multipass;
+
+namespace
+{
+constexpr auto connect_timeout = 5000;
+constexpr auto reap_interval = 100;
+} // namespace
+
+mp::QemuAttachedProcess::QemuAttachedProcess(qint64 pid, const QString& monitor_socket, const QStringList& arguments)
+    : pid{pid}, args{arguments}
+{
+    if (!alive(pid))
+        throw std::runtime_error{fmt::format("process {} is gone", pid)};
+
+    socket.connectToServer(monitor_socket);
+    if (!socket.waitForConnected(connect_timeout))
+        throw std::runtime_error{fmt::format("cannot connect to {}: {}", monitor_socket, socket.errorString())};
+
+    QObject::connect(&socket, &QLocalSocket::readyRead, this, &Process::ready_read_standard_output);
+    // QEMU closes the socket on its way out, but only the process going away says it is done
+    QObject::connect(&socket, &QLocalSocket::disconnected, &reaper, qOverload<>(&QTimer::start));
+    QObject::connect(&reaper, &QTimer::timeout, this, &QemuAttachedProcess::check_finished);
+    reaper.setInterval(reap_interval);
+}
+
+QString mp::QemuAttachedProcess::program() const
+{
+    return args.value(0);
+}
+
+QStringList mp::QemuAttachedProcess::arguments() const
+{
+    return args;
+}
+
+QString mp::QemuAttachedProcess::working_directory() const
+{
+    return {};
+}
+
+QProcessEnvironment mp::QemuAttachedProcess::process_environment() const
+{
+    return {};
+}
+
+qint64 mp::QemuAttachedProcess::process_id() const
+{
+    return pid;
+}
+
+void mp::QemuAttachedProcess::start()
+{
+    // It is started already
+}
+
+void mp::QemuAttachedProcess::terminate()
+{
+    ::kill(pid, SIGTERM);
+}
+
+void mp::QemuAttachedProcess::kill()
+{
+    ::kill(pid, SIGKILL);
+    reaper.start();
+}
+
+bool mp::QemuAttachedProcess::wait_for_started(int)
+{
+    return running();
+}
+
+bool mp::QemuAttachedProcess::wait_for_finished(int msecs)
+{
+    QElapsedTimer elapsed;
+    elapsed.start();
+    while (running() && (msecs < 0 || elapsed.elapsed() < msecs))
+        // Replies and events are handled meanwhile, for as long as the socket is there to bring them
+        if (!socket.waitForReadyRead(reap_interval) && socket.state() != QLocalSocket::ConnectedState)
+            QThread::msleep(reap_interval);
+
+    check_finished();
+    return gone;
+}
+
+bool mp::QemuAttachedProcess::wait_for_ready_read(int msecs)
+{
+    return socket.waitForReadyRead(msecs);
+}
+
+bool mp::QemuAttachedProcess::running() const
+{
+    return !gone && alive(pid);
+}
+
+mp::ProcessState mp::QemuAttachedProcess::process_state() const
+{
+    // Not a child, how it ended is not the daemon's to know
+    mp::ProcessState state;
+    if (gone)
+        state.exit_code = 0;
+
+    return state;
+}
+
+QString mp::QemuAttachedProcess::error_string() const
+{
+    return socket.errorString();
+}
+
+QByteArray mp::QemuAttachedProcess::read_all_standard_output()
+{
+    return socket.readAll();
+}
+
+QByteArray mp::QemuAttachedProcess::read_all_standard_error()
+{
+    return {};
+}
+
+qint64 mp::QemuAttachedProcess::write(const QByteArray& data)
+{
+    const auto written = socket.write(data);
+    socket.flush();
+    return written;
+}
+
+void mp::QemuAttachedProcess::close_write_channel()
+{
+    socket.disconnectFromServer();
+}
+
+void mp::QemuAttachedProcess::set_process_channel_mode(QProcess::ProcessChannelMode)
+{
+}
+
+mp::ProcessState mp::QemuAttachedProcess::execute(const int)
+{
+    throw std::logic_error{"an attached process cannot be executed again"};
+}
+
+bool mp::QemuAttachedProcess::alive(qint64 pid)
+{
+    return pid > 0 && (::kill(pid, 0) == 0 || errno == EPERM);
+}
+
+void mp::QemuAttachedProcess::setup_child_process()
+{
+}
+
+void mp::QemuAttachedProcess::check_finished()
+{
+    if (gone || alive(pid))
+        return;
+
+    gone = true;
+    reaper.stop();
+    emit state_changed(QProcess::NotRunning);
+    emit finished(process_state());
+}
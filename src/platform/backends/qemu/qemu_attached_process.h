@@ -0,0 +1,80 @@
+/*
+ * Copyright (C) Canonical, Ltd.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; version 3.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#ifndef MULTIPASS_QEMU_ATTACHED_PROCESS_H
+#define MULTIPASS_QEMU_ATTACHED_PROCESS_H
+
+#include <multipass/process/process.h>
+
+#include <QLocalSocket>
+#include <QTimer>
+
+namespace multipass
+{
+// A QEMU that outlived the daemon that launched it, driven through the QMP socket it keeps listening on. What it
+// writes there stands for its standard output, it has no standard error to read anymore.
+class QemuAttachedProcess : public Process
+{
+    Q_OBJECT
+public:
+    // Throws when the process is gone, or does not answer on the socket
+    QemuAttachedProcess(qint64 pid, const QString& monitor_socket, const QStringList& arguments);
+
+    QString program() const override;
+    QStringList arguments() const override;
+    QString working_directory() const override;
+    QProcessEnvironment process_environment() const override;
+    qint64 process_id() const override;
+
+    void start() override;
+    void terminate() override;
+    void kill() override;
+
+    bool wait_for_started(int msecs = 30000) override;
+    bool wait_for_finished(int msecs = 30000) override;
+    bool wait_for_ready_read(int msecs = 30000) override;
+
+    bool running() const override;
+    ProcessState process_state() const override;
+    QString error_string() const override;
+
+    QByteArray read_all_standard_output() override;
+    QByteArray read_all_standard_error() override;
+
+    qint64 write(const QByteArray& data) override;
+    void close_write_channel() override;
+    void set_process_channel_mode(QProcess::ProcessChannelMode mode) override;
+
+    ProcessState execute(const int timeout = 30000) override;
+
+    static bool alive(qint64 pid);
+
+protected:
+    void setup_child_process() override;
+
+private:
+    void check_finished(); // tells once that the process is gone
+
+    const qint64 pid;
+    const QStringList args;
+    QLocalSocket socket;
+    QTimer reaper; // not a child, it is only ever seen going away
+    bool gone{false};
+};
+} // namespace multipass
+
+#endif // MULTIPASS_QEMU_ATTACHED_PROCESS_H
@@ -0,0 +1,147 @@
+/*
+ * Copyright (C) Canonical, Ltd.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; version 3.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#include "qemu_guest_agent.h"
+
+#include <multipass/format.h>
+
+#include <QIODevice>
+#include <QJsonArray>
+#include <QJsonDocument>
+#include <QRandomGenerator>
+
+#include <algorithm>
+#include <limits>
+#include <stdexcept>
+#include <thread>
+
+namespace mp = multipass;
+
+using namespace std::chrono_literals;
+
+namespace
+{
+constexpr auto max_exec_poll_interval = 100ms;
+
+int remaining_ms(std::chrono::steady_clock::time_point deadline)
+{
+    using namespace std::chrono;
+
+    const auto left = duration_cast<milliseconds>(deadline - steady_clock::now()).count();
+    return static_cast<int>(std::max(left, decltype(left){0}));
+}
+} // namespace
+
+mp::QemuGuestAgent::QemuGuestAgent(QIODevice& device, std::chrono::milliseconds timeout)
+    : device{device}, deadline{std::chrono::steady_clock::now() + timeout}
+{
+    // Answers to whatever a previous client left unread come first, and are skipped
+    const auto id = QRandomGenerator::global()->bounded(1, std::numeric_limits<int>::max());
+    write({{"execute", "guest-sync"}, {"arguments", QJsonObject{{"id", id}}}});
+    while (read_reply()["return"].toInt(-1) != id)
+        ;
+}
+
+std::string mp::QemuGuestAgent::exec(const std::string& command)
+{
+    const auto started = execute("guest-exec", {{"path", "/bin/sh"},
+                                                {"arg", QJsonArray{"-c", QString::fromStdString(command)}},
+                                                {"capture-output", true}});
+    const auto pid = started.toObject()["pid"].toInt();
+
+    // Quick commands are done by the first look, the interval grows for those that are not
+    for (auto interval = 5ms;; interval = std::min(interval * 2, max_exec_poll_interval))
+    {
+        const auto status = execute("guest-exec-status", {{"pid", pid}}).toObject();
+        if (status["exited"].toBool())
+        {
+            if (const auto code = status["exitcode"].toInt(); code != 0)
+                throw std::runtime_error{fmt::format("\"{}\" exited with code {} in the guest", command, code)};
+
+            return QByteArray::fromBase64(status["out-data"].toString().toLatin1()).toStdString();
+        }
+
+        if (remaining_ms(deadline) < interval.count())
+            throw std::runtime_error{fmt::format("\"{}\" did not finish in time in the guest", command)};
+        std::this_thread::sleep_for(interval);
+    }
+}
+
+std::vector<std::string> mp::QemuGuestAgent::ipv4()
+{
+    std::vector<std::string> addresses;
+    for (const auto& nic : execute("guest-network-get-interfaces").toArray())
+    {
+        if (nic["name"].toString() == "lo")
+            continue;
+
+        for (const auto& address : nic["ip-addresses"].toArray())
+            if (address["ip-address-type"].toString() == "ipv4")
+                addresses.push_back(address["ip-address"].toString().toStdString());
+    }
+
+    return addresses;
+}
+
+QJsonValue mp::QemuGuestAgent::execute(const QString& command, const QJsonObject& arguments)
+{
+    QJsonObject message{{"execute", command}};
+    if (!arguments.isEmpty())
+        message.insert("arguments", arguments);
+
+    write(message);
+
+    const auto reply = read_reply();
+    if (reply.contains("error"))
+        throw std::runtime_error{
+            fmt::format("guest agent command {} failed: {}", command, reply["error"].toObject()["desc"].toString())};
+
+    return reply["return"];
+}
+
+void mp::QemuGuestAgent::write(const QJsonObject& message)
+{
+    if (device.write(QJsonDocument{message}.toJson(QJsonDocument::Compact) + '\n') < 0)
+        throw std::runtime_error{fmt::format("cannot write to the guest agent: {}", device.errorString())};
+
+    while (device.bytesToWrite() > 0)
+        if (!device.waitForBytesWritten(remaining_ms(deadline)))
+            throw std::runtime_error{"cannot write to the guest agent in time"};
+}
+
+QJsonObject mp::QemuGuestAgent::read_reply()
+{
+    while (true)
+    {
+        if (const auto newline = buffer.indexOf('\n'); newline >= 0)
+        {
+            const auto reply = QJsonDocument::fromJson(buffer.left(newline)).object();
+            buffer.remove(0, newline + 1);
+
+            // Anything else, like a line cut short by an earlier client going away, does not answer anything
+            if (reply.contains("return") || reply.contains("error"))
+                return reply;
+
+            continue;
+        }
+
+        if (!device.bytesAvailable() && !device.waitForReadyRead(remaining_ms(deadline)))
+            throw std::runtime_error{"the guest agent did not answer in time"};
+
+        buffer.append(device.readAll());
+    }
+}
@@ -0,0 +1,55 @@
+/*
+ * Copyright (C) Canonical, Ltd.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; version 3.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#ifndef MULTIPASS_QEMU_GUEST_AGENT_H
+#define MULTIPASS_QEMU_GUEST_AGENT_H
+
+#include <QByteArray>
+#include <QJsonObject>
+#include <QJsonValue>
+#include <QString>
+
+#include <chrono>
+#include <string>
+#include <vector>
+
+class QIODevice;
+
+namespace multipass
+{
+// Talks to qemu-ga in the guest, over the virtio-serial port that QEMU exposes on a socket. Unlike QMP, the agent
+// neither greets nor echoes ids: it is synced with first, then asked one thing at a time, each answer waited for.
+// Everything throws std::runtime_error when the agent fails, or does not answer before the timeout runs out.
+class QemuGuestAgent
+{
+public:
+    QemuGuestAgent(QIODevice& device, std::chrono::milliseconds timeout); // for everything asked, taken together
+
+    std::string exec(const std::string& command); // runs it with sh, giving what it printed if it succeeded
+    std::vector<std::string> ipv4();              // the guest's addresses, but for loopback
+
+private:
+    QJsonValue execute(const QString& command, const QJsonObject& arguments = {});
+    void write(const QJsonObject& message);
+    QJsonObject read_reply();
+
+    QIODevice& device;
+    const std::chrono::steady_clock::time_point deadline;
+    QByteArray buffer;
+};
+} // namespace multipass
+#endif // MULTIPASS_QEMU_GUEST_AGENT_H
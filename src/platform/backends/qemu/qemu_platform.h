@@ -29,12 +29,17 @@
 #include <QString>
 #include <QStringList>
 
+#include <cstdint>
 #include <memory>
 #include <optional>
 #include <string>
+#include <utility>
 
 namespace multipass
 {
+// Where, in the instance directory, the files of a nocloud-net seed are kept
+constexpr auto nocloud_net_seed_dir = "cloud-init-seed";
+
 class QemuPlatform : private DisabledCopyMove
 {
 public:
@@ -50,6 +55,25 @@ public:
         return {};
     };
     virtual QStringList vm_platform_args(const VirtualMachineDescription& vm_desc) = 0;
+    // Holds the network vm_platform_args() set up for the instance to so many Mbit/s each way, 0 for no limit
+    virtual void limit_network(const std::string& /*name*/, int /*mbits*/)
+    {
+    }
+    // Bytes the instance received and sent over that network since it started, if the host keeps count
+    virtual std::optional<std::pair<std::uint64_t, std::uint64_t>> network_counters(const std::string& /*name*/)
+    {
+        return std::nullopt;
+    }
+    // Whether instances can be seeded over nocloud-net rather than from an ISO
+    virtual bool serves_seeds() const
+    {
+        return false;
+    }
+    // Has the files in seed_dir served to the instance, giving what points its cloud-init at them
+    virtual QStringList seed_platform_args(const std::string& /*name*/, const QString& /*seed_dir*/)
+    {
+        throw NotImplementedOnThisBackendException("nocloud-net");
+    }
     virtual QString get_directory_name()
     {
         return {};
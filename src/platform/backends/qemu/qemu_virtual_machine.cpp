@@ -16,32 +16,61 @@
  */
 
 #include "qemu_virtual_machine.h"
+#include "qemu_attached_process.h"
+#include "qemu_guest_agent.h"
 #include "qemu_mount_handler.h"
 #include "qemu_vm_process_spec.h"
 #include "qemu_vmstate_process_spec.h"
 
+#ifdef MULTIPASS_PLATFORM_LINUX
+#include "virtiofs_mount_handler.h"
+#include "linux/virtiofsd_process_spec.h"
+
+#include <shared/linux/backend_utils.h>
+#include <shared/linux/cgroups.h>
+#include <shared/linux/host_topology.h>
+
+#include <fcntl.h>
+#include <linux/vhost.h>
+#include <sys/ioctl.h>
+#include <unistd.h>
+#endif
+
 #include <shared/qemu_img_utils/qemu_img_utils.h>
 #include <shared/shared_backend_utils.h>
 
+#include <multipass/constants.h>
 #include <multipass/format.h>
 #include <multipass/logging/log.h>
+#include <multipass/logging/tracer.h>
 #include <multipass/memory_size.h>
 #include <multipass/platform.h>
 #include <multipass/process/simple_process_spec.h>
+#include <multipass/settings/settings.h>
+#include <multipass/ssh/ssh_session.h>
 #include <multipass/utils.h>
 #include <multipass/vm_mount.h>
 #include <multipass/vm_status_monitor.h>
 
+#include <QDir>
 #include <QFile>
 #include <QJsonArray>
 #include <QJsonDocument>
 #include <QJsonObject>
+#include <QLocalSocket>
 #include <QProcess>
+#include <QRegularExpression>
+#include <QSaveFile>
+#include <QStandardPaths>
 #include <QString>
 #include <QStringList>
 #include <QTemporaryFile>
 
+#include <algorithm>
 #include <cassert>
+#include <stdexcept>
+#include <tuple>
+#include <type_traits>
 
 namespace mp = multipass;
 namespace mpl = multipass::logging;
@@ -56,6 +85,26 @@ constexpr auto arguments_key = "arguments";
 constexpr auto mount_data_key = "mount_data";
 constexpr auto mount_source_key = "source";
 constexpr auto mount_arguments_key = "arguments";
+constexpr auto memory_snapshot_key = "memory_snapshot";
+constexpr auto process_key = "process"; // the pid and monitor socket of a QEMU to reattach to
+constexpr auto disk_profile_key = "disk_profile";
+constexpr auto hugepages_key = "hugepages";
+constexpr auto cpu_pinning_key = "cpu_pinning";
+constexpr auto no_cpu_pinning = "none", numa_cpu_pinning = "numa";
+constexpr auto fast_boot_key = "fast_boot";
+constexpr auto network_limit_key = "network_limit", disk_iops_key = "disk_iops";
+constexpr auto cpu_weight_key = "cpu_weight", io_weight_key = "io_weight", memory_limit_key = "memory_limit";
+constexpr auto no_memory_limit = "none", soft_memory_limit = "soft", hard_memory_limit = "hard";
+constexpr auto max_weight = 10000;
+// What QEMU needs besides guest memory, for itself and device buffers: this much, and an eighth of guest memory
+constexpr auto memory_overhead = 256LL * 1024 * 1024;
+constexpr auto boot_files_key = "boot_files"; // what the guest's were like when copied
+constexpr auto kernel_suffix = ".vmlinuz", initrd_suffix = ".initrd", cmdline_suffix = ".cmdline";
+constexpr auto guest_agent_timeout = 5s;
+constexpr auto vsock_cid_key = "vsock_cid"; // the guest's address over vsock, once it was given one
+// Grows the partition of the root file system to the end of its disk, then the file system into it
+constexpr auto grow_root_cmd = "root=$(findmnt -no SOURCE /) && disk=/dev/$(lsblk -no PKNAME \"$root\") && "
+                               "growpart \"$disk\" \"${root##*[!0-9]}\" && resize2fs \"$root\"";
 
 constexpr int timeout = 300000; // 5 minute timeout for shutdown/suspend
 
@@ -105,10 +154,83 @@ auto mount_args_from_json(const QJsonObject& object)
     return mount_args;
 }
 
+// Where the guest's state goes when suspending to a file of its own, rather than into the image with savevm. That
+// doesn't get slower as the image grows, and the state can be written out and read back at the speed of the disk.
+QString memory_snapshot_path(const mp::VirtualMachineDescription& desc)
+{
+    return desc.image.image_path + ".state";
+}
+
+// Kept next to the image, like the memory snapshot
+QString boot_file_path(const mp::VirtualMachineDescription& desc, const char* suffix)
+{
+    return desc.image.image_path + suffix;
+}
+
+std::optional<mp::QemuVMProcessSpec::Tuning::DirectBoot> direct_boot(const mp::VirtualMachineDescription& desc)
+{
+    const auto kernel = boot_file_path(desc, kernel_suffix), initrd = boot_file_path(desc, initrd_suffix);
+    QFile cmdline{boot_file_path(desc, cmdline_suffix)};
+    if (!QFile::exists(kernel) || !QFile::exists(initrd) || !cmdline.open(QIODevice::ReadOnly))
+        return std::nullopt;
+
+    return mp::QemuVMProcessSpec::Tuning::DirectBoot{kernel, initrd, QString{cmdline.readAll()}.trimmed()};
+}
+
+// Streamed from the guest and only put in place once whole, for the next boot not to pick up half a kernel
+void copy_from_guest(mp::SSHSession& session, const std::string& command, const QString& path)
+{
+    QSaveFile file{path};
+    if (!file.open(QIODevice::WriteOnly))
+        throw std::runtime_error{fmt::format("cannot write {}: {}", path, file.errorString())};
+
+    auto proc = session.exec(command);
+    proc.read_std_output([&file](std::string_view data) { file.write(data.data(), data.size()); });
+    if (const auto exit_code = proc.exit_code(); exit_code != 0)
+    {
+        auto error = proc.read_std_error();
+        throw std::runtime_error{
+            fmt::format("'{}' failed with exit code {}: {}", command, exit_code, mp::utils::trim_end(error))};
+    }
+
+    if (!file.commit())
+        throw std::runtime_error{fmt::format("cannot write {}: {}", path, file.errorString())};
+}
+
+QString shell_quote(QString arg)
+{
+    return "'" + arg.replace("'", R"('\'')") + "'";
+}
+
+// What QEMU is to migrate to, to save the state, and from, to restore it. Compressed when zstd is around, at a level
+// that keeps up with the disk.
+std::pair<QString, QString> memory_snapshot_uris(const QString& path)
+{
+    const auto file = shell_quote(path);
+    if (const auto zstd = QStandardPaths::findExecutable("zstd"); !zstd.isEmpty())
+        return {QString{"exec:%1 -1 -T0 -q > %2"}.arg(shell_quote(zstd), file),
+                QString{"exec:%1 -d -c -q %2"}.arg(shell_quote(zstd), file)};
+
+    return {QString{"exec:cat > %1"}.arg(file), QString{"exec:cat %1"}.arg(file)};
+}
+
+// Instances started before the network had several queues have one
+int network_queues(const QStringList& arguments)
+{
+    static const QRegularExpression queues{"^tap,.*,queues=([0-9]+)"};
+    for (const auto& argument : arguments)
+        if (const auto match = queues.match(argument); match.hasMatch())
+            return match.captured(1).toInt();
+
+    return 1;
+}
+
 auto make_qemu_process(const mp::VirtualMachineDescription& desc, const std::optional<QJsonObject>& resume_metadata,
-                       const mp::QemuVirtualMachine::MountArgs& mount_args, const QStringList& platform_args)
+                       const mp::QemuVirtualMachine::MountArgs& mount_args, const QStringList& platform_args,
+                       const mp::QemuVMProcessSpec::Tuning& tuning)
 {
-    if (!QFile::exists(desc.image.image_path) || !QFile::exists(desc.cloud_init_iso))
+    if (!QFile::exists(desc.image.image_path) ||
+        (!QFile::exists(desc.cloud_init_iso) && tuning.nocloud_net_seed.isEmpty()))
     {
         throw std::runtime_error("cannot start VM without an image");
     }
@@ -117,11 +239,13 @@ auto make_qemu_process(const mp::VirtualMachineDescription& desc, const std::opt
     if (resume_metadata)
     {
         const auto& data = resume_metadata.value();
+        const auto incoming =
+            QFile::exists(memory_snapshot_path(desc)) ? data[memory_snapshot_key].toString() : QString{};
         resume_data = mp::QemuVMProcessSpec::ResumeData{suspend_tag, get_vm_machine(data), use_cdrom_set(data),
-                                                        get_arguments(data)};
+                                                        get_arguments(data), incoming};
     }
 
-    auto process_spec = std::make_unique<mp::QemuVMProcessSpec>(desc, platform_args, mount_args, resume_data);
+    auto process_spec = std::make_unique<mp::QemuVMProcessSpec>(desc, platform_args, mount_args, resume_data, tuning);
     auto process = mp::platform::make_process(std::move(process_spec));
 
     mpl::log(mpl::Level::debug, desc.vm_name, fmt::format("process working dir '{}'", process->working_directory()));
@@ -130,23 +254,24 @@ auto make_qemu_process(const mp::VirtualMachineDescription& desc, const std::opt
     return process;
 }
 
-auto qmp_execute_json(const QString& cmd)
+// The command line equivalent of QMP properties, as in "driver,id=foo,size=1024"
+QString device_option(QJsonObject properties)
 {
-    QJsonObject qmp;
-    qmp.insert("execute", cmd);
-    return QJsonDocument(qmp).toJson();
-}
-
-auto hmc_to_qmp_json(const QString& command_line)
-{
-    auto qmp = QJsonDocument::fromJson(qmp_execute_json("human-monitor-command")).object();
-
-    QJsonObject cmd_line;
-    cmd_line.insert("command-line", command_line);
+    QStringList option{properties.take("driver").toString()};
+    for (auto it = properties.constBegin(); it != properties.constEnd(); ++it)
+    {
+        QString value;
+        if (it.value().isBool())
+            value = it.value().toBool() ? "on" : "off";
+        else if (it.value().isDouble())
+            value = QString::number(it.value().toVariant().toLongLong());
+        else
+            value = it.value().toString();
 
-    qmp.insert("arguments", cmd_line);
+        option << QString{"%1=%2"}.arg(it.key(), value);
+    }
 
-    return QJsonDocument(qmp).toJson();
+    return option.join(',');
 }
 
 bool instance_image_has_snapshot(const mp::Path& image_path)
@@ -173,6 +298,11 @@ bool instance_image_has_snapshot(const mp::Path& image_path)
     return false;
 }
 
+bool instance_has_suspended_state(const mp::VirtualMachineDescription& desc)
+{
+    return QFile::exists(memory_snapshot_path(desc)) || instance_image_has_snapshot(desc.image.image_path);
+}
+
 auto get_qemu_machine_type(const QStringList& platform_args)
 {
     QTemporaryFile dump_file;
@@ -211,32 +341,150 @@ auto mount_args_to_json(const mp::QemuVirtualMachine::MountArgs& mount_args)
 }
 
 auto generate_metadata(const QStringList& platform_args, const QStringList& proc_args,
-                       const mp::QemuVirtualMachine::MountArgs& mount_args)
+                       const mp::QemuVirtualMachine::MountArgs& mount_args, const QJsonObject& previous_metadata)
 {
     QJsonObject metadata;
     metadata[machine_type_key] = get_qemu_machine_type(platform_args);
     metadata[arguments_key] = QJsonArray::fromStringList(proc_args);
     metadata[mount_data_key] = mount_args_to_json(mount_args);
+
+    // What the instance was set to stays until it is set otherwise
+    for (const auto key : {disk_profile_key, hugepages_key, cpu_pinning_key, fast_boot_key, boot_files_key,
+                           network_limit_key, disk_iops_key, cpu_weight_key, io_weight_key, memory_limit_key,
+                           vsock_cid_key})
+        if (previous_metadata.contains(key))
+            metadata[key] = previous_metadata[key];
+
     return metadata;
 }
+
+#ifdef MULTIPASS_PLATFORM_LINUX
+// Whether no other guest on the host has the address, which the kernel only tells by refusing to give it again
+bool vsock_cid_free(std::uint32_t cid)
+{
+    const auto fd = ::open("/dev/vhost-vsock", O_RDWR | O_CLOEXEC);
+    if (fd < 0)
+        return true; // QEMU is the one to tell why it cannot have the device either
+
+    std::uint64_t guest_cid = cid;
+    const auto taken = ::ioctl(fd, VHOST_VSOCK_SET_GUEST_CID, &guest_cid) < 0 && errno == EADDRINUSE;
+    ::close(fd);
+
+    return !taken;
+}
+#endif
+
+#ifdef MULTIPASS_PLATFORM_LINUX
+// Which node guest memory was bound to, for resumed instances to keep their vCPUs next to it
+std::optional<int> numa_node(const QStringList& arguments)
+{
+    static const QRegularExpression host_nodes{"^memory-backend-.*,host-nodes=([0-9]+)"};
+    for (const auto& argument : arguments)
+        if (const auto match = host_nodes.match(argument); match.hasMatch())
+            return match.captured(1).toInt();
+
+    return std::nullopt;
+}
+#endif
+
+#ifdef MULTIPASS_PLATFORM_LINUX
+// What the kernel accounts to the QEMU process, vCPU threads and all
+void read_process_stats(qint64 pid, mp::VirtualMachine::HostStats& stats)
+{
+    const auto proc_dir = QString{"/proc/%1"}.arg(pid);
+
+    // utime and stime are the 14th and 15th fields, counted from the command name in parentheses that may have spaces
+    if (QFile stat_file{proc_dir + "/stat"}; stat_file.open(QIODevice::ReadOnly))
+    {
+        const auto line = stat_file.readAll();
+        const auto fields = line.mid(line.lastIndexOf(')') + 2).split(' ');
+        if (fields.size() > 12)
+            stats.cpu_time_ns =
+                (fields[11].toULongLong() + fields[12].toULongLong()) * 1'000'000'000 / sysconf(_SC_CLK_TCK);
+    }
+
+    if (QFile status_file{proc_dir + "/status"}; status_file.open(QIODevice::ReadOnly))
+        for (const auto& line : status_file.readAll().split('\n'))
+            if (line.startsWith("VmRSS:"))
+                stats.rss_bytes = line.simplified().split(' ').value(1).toULongLong() * 1024;
+
+    // The second field is how long a thread was runnable but waiting for a host CPU, which vCPUs see as steal
+    const auto task_dir = proc_dir + "/task";
+    for (const auto& task : QDir{task_dir}.entryList(QDir::Dirs | QDir::NoDotAndDotDot))
+        if (QFile schedstat{QString{"%1/%2/schedstat"}.arg(task_dir, task)}; schedstat.open(QIODevice::ReadOnly))
+            stats.steal_time_ns += schedstat.readAll().split(' ').value(1).toULongLong();
+}
+#endif
+
+// Settings are left out of the metadata while they have their default value
+void update_metadata_entry(mp::VMStatusMonitor& monitor, const std::string& vm_name, const QString& key,
+                           const QJsonValue& value)
+{
+    auto metadata = monitor.retrieve_metadata_for(vm_name);
+    if (value.isNull())
+        metadata.remove(key);
+    else
+        metadata[key] = value;
+
+    monitor.update_metadata_for(vm_name, metadata);
+}
+
+// Whatever goes wrong, SSH is there to fall back on
+template <typename Asking>
+auto ask_guest_agent(const std::string& vm_name, std::mutex& mutex, Asking&& asking)
+    -> std::optional<std::invoke_result_t<Asking, mp::QemuGuestAgent&>>
+{
+    // Only there while QEMU runs with a port for the agent
+    const auto socket_path = mp::QemuVMProcessSpec::guest_agent_socket_for(vm_name);
+    if (!QFile::exists(socket_path))
+        return std::nullopt;
+
+    try
+    {
+        // QEMU takes one client at a time on the socket
+        std::lock_guard lock{mutex};
+
+        QLocalSocket socket;
+        socket.connectToServer(socket_path);
+        if (!socket.waitForConnected(std::chrono::milliseconds{guest_agent_timeout}.count()))
+            throw std::runtime_error{fmt::format("cannot connect to {}: {}", socket_path, socket.errorString())};
+
+        mp::QemuGuestAgent agent{socket, guest_agent_timeout};
+        return asking(agent);
+    }
+    catch (const std::exception& e)
+    {
+        mpl::log(mpl::Level::debug, vm_name, fmt::format("Could not ask the guest agent: {}", e.what()));
+        return std::nullopt;
+    }
+}
 } // namespace
 
 mp::QemuVirtualMachine::QemuVirtualMachine(const VirtualMachineDescription& desc, QemuPlatform* qemu_platform,
                                            VMStatusMonitor& monitor)
-    : BaseVirtualMachine{instance_image_has_snapshot(desc.image.image_path) ? State::suspended : State::off,
-                         desc.vm_name},
+    : BaseVirtualMachine{instance_has_suspended_state(desc) ? State::suspended : State::off, desc.vm_name},
       desc{desc},
       mac_addr{desc.default_mac_address},
       username{desc.ssh_username},
       qemu_platform{qemu_platform},
       monitor{&monitor},
-      mount_args{mount_args_from_json(monitor.retrieve_metadata_for(vm_name))}
+      mount_args{mount_args_from_json(monitor.retrieve_metadata_for(vm_name))},
+      reattaches{QemuVMProcessSpec::reattach_enabled()}
 {
     QObject::connect(
         this, &QemuVirtualMachine::on_delete_memory_snapshot, this,
         [this] {
             mpl::log(mpl::Level::debug, vm_name, fmt::format("Deleted memory snapshot"));
-            vm_process->write(hmc_to_qmp_json("delvm " + QString::fromStdString(suspend_tag)));
+            if (QFile::remove(memory_snapshot_path(this->desc)))
+            {
+                auto metadata = monitor->retrieve_metadata_for(vm_name);
+                metadata.remove(memory_snapshot_key);
+                monitor->update_metadata_for(vm_name, metadata);
+            }
+            else
+            {
+                qmp->human_monitor_command("delvm " + QString::fromStdString(suspend_tag));
+            }
             is_starting_from_suspend = false;
         },
         Qt::QueuedConnection);
@@ -248,31 +496,44 @@ mp::QemuVirtualMachine::QemuVirtualMachine(const VirtualMachineDescription& desc
         [this] {
             mpl::log(mpl::Level::debug, vm_name, fmt::format("Resetting the network"));
 
-            auto qmp = QJsonDocument::fromJson(qmp_execute_json("set_link")).object();
-            QJsonObject args;
-            args.insert("name", "virtio-net-pci.0");
-            args.insert("up", false);
-            qmp.insert("arguments", args);
-
-            vm_process->write(QJsonDocument(qmp).toJson());
-
-            args["up"] = true;
-            qmp["arguments"] = args;
-
-            vm_process->write(QJsonDocument(qmp).toJson());
+            qmp->execute("set_link", QJsonObject{{"name", "virtio-net-pci.0"}, {"up", false}});
+            qmp->execute("set_link", QJsonObject{{"name", "virtio-net-pci.0"}, {"up", true}});
         },
         Qt::QueuedConnection);
+
+    if (reattaches && state == State::off)
+        reattach();
 }
 
 mp::QemuVirtualMachine::~QemuVirtualMachine()
 {
+    if (vm_process && reattaches && state == State::running && vm_process->running() &&
+        outlives_daemon())
+    {
+        mpl::log(mpl::Level::info, vm_name, "Leaving the instance running, to be reattached to");
+
+        // Destroying the process would kill it, whatever it was left talking to is gone with the daemon
+        vm_process->disconnect();
+        qmp.reset();
+        [[maybe_unused]] auto* left_running = vm_process.release();
+        return;
+    }
+
     if (vm_process)
     {
         update_shutdown_status = false;
 
-        if (state == State::running)
+        if (state == State::running && can_suspend)
         {
-            suspend();
+            try
+            {
+                suspend();
+            }
+            catch (const std::exception& e)
+            {
+                mpl::log(mpl::Level::warning, vm_name, fmt::format("{}, shutting it down instead", e.what()));
+                shutdown();
+            }
         }
         else
         {
@@ -283,7 +544,9 @@ mp::QemuVirtualMachine::~QemuVirtualMachine()
 
 void mp::QemuVirtualMachine::start()
 {
+    mpl::TraceSpan span{"start", vm_name};
     initialize_vm_process();
+    set_guest_ready(false);
 
     if (state == State::suspended)
     {
@@ -297,14 +560,26 @@ void mp::QemuVirtualMachine::start()
     {
         // remove the mount arguments from the rest of the arguments, as they are stored separately for easier retrieval
         auto proc_args = vm_process->arguments();
+        const auto reattach_args = QemuVMProcessSpec::reattach_arguments(vm_name);
+        if (const auto rest = proc_args.size() - reattach_args.size();
+            rest >= 0 && proc_args.mid(rest) == reattach_args)
+            proc_args = proc_args.mid(0, rest); // added anew on every start
         for (const auto& [_, mount_data] : mount_args)
             for (const auto& arg : mount_data.second)
                 proc_args.removeOne(arg);
 
-        monitor->update_metadata_for(vm_name,
-                                     generate_metadata(qemu_platform->vmstate_platform_args(), proc_args, mount_args));
+        monitor->update_metadata_for(vm_name, generate_metadata(qemu_platform->vmstate_platform_args(), proc_args,
+                                                                mount_args, monitor->retrieve_metadata_for(vm_name)));
     }
 
+    for (const auto& [_, hook] : mount_hooks)
+        hook();
+
+    // vhost-user devices cannot be migrated, which is what saving the state of the VM amounts to
+    const auto args = vm_process->arguments();
+    can_suspend = std::none_of(args.cbegin(), args.cend(),
+                               [](const QString& arg) { return arg.startsWith("vhost-user-"); });
+
     vm_process->start();
 
     if (!vm_process->wait_for_started())
@@ -326,7 +601,81 @@ void mp::QemuVirtualMachine::start()
         }
     }
 
-    vm_process->write(qmp_execute_json("qmp_capabilities"));
+    negotiate_qmp_capabilities();
+    pin_vcpus();
+    place_in_cgroup();
+
+    if (reattaches)
+        update_metadata_entry(*monitor, vm_name, process_key,
+                              QJsonObject{{"pid", vm_process->process_id()},
+                                          {"monitor", QemuVMProcessSpec::monitor_socket_for(vm_name)}});
+}
+
+void mp::QemuVirtualMachine::reattach()
+{
+    const auto metadata = monitor->retrieve_metadata_for(vm_name);
+    const auto process = metadata[process_key].toObject();
+    const auto pid = static_cast<qint64>(process["pid"].toDouble());
+    if (!pid)
+        return;
+
+    try
+    {
+        // QEMU keeps its pid in there for as long as it runs, a pid that was reused since is another process's
+        QFile pidfile{QemuVMProcessSpec::pidfile_for(vm_name)};
+        if (!pidfile.open(QIODevice::ReadOnly) || pidfile.readAll().trimmed().toLongLong() != pid)
+            throw std::runtime_error{fmt::format("process {} is not the instance's anymore", pid)};
+
+        auto args = get_arguments(metadata);
+        for (const auto& [_, mount_data] : mount_args)
+            args << mount_data.second;
+
+        vm_process = std::make_unique<QemuAttachedProcess>(pid, process["monitor"].toString(), args);
+    }
+    catch (const std::exception& e)
+    {
+        mpl::log(mpl::Level::info, vm_name, fmt::format("Not reattaching: {}", e.what()));
+        update_metadata_entry(*monitor, vm_name, process_key, QJsonValue::Null);
+        return;
+    }
+
+    connect_vm_process();
+    state = State::running;
+    const auto args = vm_process->arguments();
+    can_suspend =
+        std::none_of(args.cbegin(), args.cend(), [](const QString& arg) { return arg.startsWith("vhost-user-"); });
+    set_guest_ready(true); // it booted long ago, the guest is as ready as it is going to be
+
+    negotiate_qmp_capabilities();
+    pin_vcpus();
+    place_in_cgroup();
+    mpl::log(mpl::Level::info, vm_name, fmt::format("Reattached to the QEMU process {}", pid));
+}
+
+// QEMU stays in the daemon's cgroup, and systemd kills the whole of it when stopping the service, unless its KillMode
+// says otherwise. Suspending it then beats losing it.
+bool mp::QemuVirtualMachine::outlives_daemon() const
+{
+#ifdef MULTIPASS_PLATFORM_LINUX
+    if (!MP_BACKEND.service_spares_children())
+    {
+        mpl::log(mpl::Level::warning, vm_name,
+                 "Not leaving the instance running, stopping the daemon's service would stop it too (KillMode)");
+        return false;
+    }
+#endif
+
+    return true;
+}
+
+void mp::QemuVirtualMachine::negotiate_qmp_capabilities()
+{
+    qmp->execute("qmp_capabilities", {}, [this](const QJsonValue&, const QString& error) {
+        if (error.isEmpty())
+            mpl::log(mpl::Level::debug, vm_name, "QMP capabilities negotiated");
+        else
+            mpl::log(mpl::Level::warning, vm_name, fmt::format("Could not negotiate QMP capabilities: {}", error));
+    });
 }
 
 void mp::QemuVirtualMachine::stop()
@@ -343,7 +692,7 @@ void mp::QemuVirtualMachine::shutdown()
     else if ((state == State::running || state == State::delayed_shutdown || state == State::unknown) && vm_process &&
              vm_process->running())
     {
-        vm_process->write(qmp_execute_json("system_powerdown"));
+        qmp->execute("system_powerdown");
         vm_process->wait_for_finished(timeout);
     }
     else
@@ -362,6 +711,9 @@ void mp::QemuVirtualMachine::suspend()
 {
     if ((state == State::running || state == State::delayed_shutdown) && vm_process->running())
     {
+        if (!can_suspend)
+            throw std::runtime_error(fmt::format("cannot suspend \"{}\" while it has virtiofs mounts", vm_name));
+
         if (update_shutdown_status)
         {
             state = State::suspending;
@@ -369,8 +721,16 @@ void mp::QemuVirtualMachine::suspend()
             update_shutdown_status = false;
         }
 
-        vm_process->write(hmc_to_qmp_json("savevm " + QString::fromStdString(suspend_tag)));
-        vm_process->wait_for_finished(timeout);
+        if (MP_SETTINGS.get(mp::qemu_state_file_key) == "true")
+        {
+            suspend_to_file();
+        }
+        else
+        {
+            saving_vm = true;
+            qmp->human_monitor_command("savevm " + QString::fromStdString(suspend_tag));
+            vm_process->wait_for_finished(timeout);
+        }
         vm_process.reset(nullptr);
     }
     else if (state == State::off || state == State::suspended)
@@ -380,6 +740,56 @@ void mp::QemuVirtualMachine::suspend()
     }
 }
 
+void mp::QemuVirtualMachine::suspend_to_file()
+{
+    const auto path = memory_snapshot_path(desc);
+    const auto [save_uri, restore_uri] = memory_snapshot_uris(path);
+    mpl::log(mpl::Level::debug, vm_name, fmt::format("Saving the instance's state to {}", path));
+
+    // Recorded before the file is written, for the instance to be suspended once QEMU is through with it, whatever
+    // happens to the daemon meanwhile. Resuming only goes by it when there is a file to read.
+    update_metadata_entry(*monitor, vm_name, memory_snapshot_key, restore_uri);
+
+    // Paused first, so that memory is written out in a single pass instead of chasing what the guest dirties
+    dumping_memory = true;
+    migration_error.clear();
+    qmp->execute("migrate-set-capabilities",
+                 QJsonObject{{"capabilities", QJsonArray{QJsonObject{{"capability", "events"}, {"state", true}}}}});
+    qmp->execute("stop");
+    qmp->execute("migrate", QJsonObject{{"uri", save_uri}}, [this](const QJsonValue&, const QString& error) {
+        if (!error.isEmpty())
+        {
+            dumping_memory = false;
+            migration_error = error;
+        }
+    });
+
+    const auto deadline = std::chrono::steady_clock::now() + std::chrono::milliseconds{timeout};
+    while (dumping_memory && vm_process->running() && std::chrono::steady_clock::now() < deadline)
+        vm_process->wait_for_ready_read(1000);
+
+    if (state == State::suspended)
+    {
+        vm_process->wait_for_finished(); // it was killed once the state was saved
+        return;
+    }
+
+    dumping_memory = false;
+    QFile::remove(path);
+    update_metadata_entry(*monitor, vm_name, memory_snapshot_key, QJsonValue::Null);
+    if (vm_process->running())
+    {
+        // The guest carries on as if nothing happened
+        qmp->execute("migrate_cancel");
+        qmp->execute("cont");
+        state = State::running;
+        update_state();
+    }
+
+    throw std::runtime_error(fmt::format("failed to suspend \"{}\": {}", vm_name,
+                                         migration_error.isEmpty() ? "timed out" : migration_error.toStdString()));
+}
+
 mp::VirtualMachine::State mp::QemuVirtualMachine::current_state()
 {
     return state;
@@ -423,6 +833,7 @@ void mp::QemuVirtualMachine::on_shutdown()
     }
 
     management_ip = std::nullopt;
+    guest_ready = false;
     update_state();
     vm_process.reset(nullptr);
     lock.unlock();
@@ -439,12 +850,20 @@ void mp::QemuVirtualMachine::on_restart()
 {
     state = State::restarting;
     update_state();
+    set_guest_ready(false);
 
     management_ip = std::nullopt;
 
     monitor->on_restart(vm_name);
 }
 
+void mp::QemuVirtualMachine::set_guest_ready(bool ready)
+{
+    std::lock_guard<decltype(state_mutex)> lock{state_mutex};
+    guest_ready = ready;
+    state_wait.notify_all();
+}
+
 void mp::QemuVirtualMachine::ensure_vm_is_running()
 {
     if (is_starting_from_suspend)
@@ -509,56 +928,110 @@ void mp::QemuVirtualMachine::wait_until_ssh_up(std::chrono::milliseconds timeout
 
 void mp::QemuVirtualMachine::initialize_vm_process()
 {
-    vm_process = make_qemu_process(
-        desc,
-        ((state == State::suspended) ? std::make_optional(monitor->retrieve_metadata_for(vm_name)) : std::nullopt),
-        mount_args, qemu_platform->vm_platform_args(desc));
+    const auto resume_metadata =
+        (state == State::suspended) ? std::make_optional(monitor->retrieve_metadata_for(vm_name)) : std::nullopt;
+
+    // The platform gives the network a queue per vCPU, but a saved state needs the ones it was saved with
+    auto platform_desc = desc;
+    if (resume_metadata)
+        platform_desc.num_cores = network_queues(get_arguments(*resume_metadata));
+
+    QemuVMProcessSpec::Tuning tuning;
+    tuning.disk_profile = QString::fromStdString(disk_profile());
+    tuning.hugepages = hugepages();
+    tuning.numa_node = place_vcpus(resume_metadata);
+    if (fast_boot())
+        tuning.direct_boot = direct_boot(desc); // from the second boot on, once there is a copy
+    tuning.disk_iops = disk_iops_limit();
+    if (const QDir seed_dir{mp::utils::base_dir(desc.image.image_path).filePath(nocloud_net_seed_dir)};
+        seed_dir.exists())
+        tuning.nocloud_net_seed = qemu_platform->seed_platform_args(vm_name, seed_dir.path());
+    // Opt-in, as it takes vhost_vsock loaded on the host: SSH, and the SFTP of mounts over it, can then reach the guest
+    // without going through either network stack
+    if (!resume_metadata && MP_SETTINGS.get(mp::qemu_vsock_key) == "true")
+        tuning.vsock_cid = allocate_vsock_cid();
+
+    const auto platform_args = qemu_platform->vm_platform_args(platform_desc);
+    qemu_platform->limit_network(vm_name, network_limit());
+    vm_process = make_qemu_process(desc, resume_metadata, mount_args, platform_args, tuning);
+    connect_vm_process();
+}
 
+void mp::QemuVirtualMachine::connect_vm_process()
+{
     QObject::connect(vm_process.get(), &Process::started, [this]() {
         mpl::log(mpl::Level::info, vm_name, "process started");
         on_started();
     });
 
-    QObject::connect(vm_process.get(), &Process::ready_read_standard_output, [this]() {
-        auto qmp_output = vm_process->read_all_standard_output();
-        mpl::log(mpl::Level::debug, vm_name, fmt::format("QMP: {}", qmp_output));
-        auto qmp_object = QJsonDocument::fromJson(qmp_output.split('\n').first()).object();
-        auto event = qmp_object["event"];
+    // QEMU is told to talk QMP over its standard streams, which carry nothing else as the serial console is discarded
+    // Resumed instances come back with what was hot-plugged into them on the command line
+    hotplugged_devices = vm_process->arguments().filter(QRegularExpression{",id=hotplug[0-9]+(,|$)"}).size();
+    qmp = std::make_unique<QmpClient>(vm_name, [this](const QByteArray& data) {
+        if (vm_process)
+            vm_process->write(data);
+    });
+    QObject::connect(vm_process.get(), &Process::ready_read_standard_output,
+                     [this]() { qmp->feed(vm_process->read_all_standard_output()); });
 
-        if (!event.isNull())
+    QObject::connect(qmp.get(), &QmpClient::event, [this](const QString& event, const QJsonObject& data) {
+        if (event == "RESET" && state != State::restarting)
         {
-            if (event.toString() == "RESET" && state != State::restarting)
-            {
-                mpl::log(mpl::Level::info, vm_name, "VM restarting");
-                on_restart();
-            }
-            else if (event.toString() == "POWERDOWN")
+            mpl::log(mpl::Level::info, vm_name, "VM restarting");
+            on_restart();
+        }
+        else if (event == "POWERDOWN")
+        {
+            mpl::log(mpl::Level::info, vm_name, "VM powering down");
+        }
+        else if (event == "SHUTDOWN")
+        {
+            mpl::log(mpl::Level::info, vm_name, "VM shut down");
+        }
+        else if (event == "STOP")
+        {
+            mpl::log(mpl::Level::info, vm_name, "VM suspending");
+        }
+        else if (event == "VSERPORT_CHANGE")
+        {
+            if (data["id"].toString() == QemuVMProcessSpec::readiness_port_id && data["open"].toBool())
             {
-                mpl::log(mpl::Level::info, vm_name, "VM powering down");
+                mpl::log(mpl::Level::debug, vm_name, "Guest ready");
+                set_guest_ready(true);
             }
-            else if (event.toString() == "SHUTDOWN")
+        }
+        else if (event == "RESUME")
+        {
+            // The guest is resumed once a savevm is through, other resumes are nothing to act on
+            if (saving_vm && (state == State::suspending || state == State::running))
             {
-                mpl::log(mpl::Level::info, vm_name, "VM shut down");
+                mpl::log(mpl::Level::info, vm_name, "VM suspended");
+                saving_vm = false;
+                vm_process->kill();
+                on_suspend();
             }
-            else if (event.toString() == "STOP")
+        }
+        else if (event == "MIGRATION" && dumping_memory)
+        {
+            const auto status = data["status"].toString();
+            if (status == "completed")
             {
-                mpl::log(mpl::Level::info, vm_name, "VM suspending");
+                mpl::log(mpl::Level::info, vm_name, "VM suspended");
+                dumping_memory = false;
+                vm_process->kill();
+                on_suspend();
             }
-            else if (event.toString() == "RESUME")
+            else if (status == "failed" || status == "cancelled")
             {
-                mpl::log(mpl::Level::info, vm_name, "VM suspended");
-                if (state == State::suspending || state == State::running)
-                {
-                    vm_process->kill();
-                    on_suspend();
-                }
+                dumping_memory = false;
+                migration_error = QString{"saving the state %1"}.arg(status);
             }
         }
     });
 
     QObject::connect(vm_process.get(), &Process::ready_read_standard_error, [this]() {
         saved_error_msg = vm_process->read_all_standard_error().data();
-        mpl::log(mpl::Level::warning, vm_name, saved_error_msg);
+        process_log.append(mpl::Level::warning, saved_error_msg);
     });
 
     QObject::connect(vm_process.get(), &Process::state_changed, [this](QProcess::ProcessState newState) {
@@ -579,6 +1052,11 @@ void mp::QemuVirtualMachine::initialize_vm_process()
         });
 
     QObject::connect(vm_process.get(), &Process::finished, [this](ProcessState process_state) {
+#ifdef MULTIPASS_PLATFORM_LINUX
+        MP_CGROUPS.release(vm_name);
+#endif
+        if (reattaches)
+            update_metadata_entry(*monitor, vm_name, process_key, QJsonValue::Null);
         if (process_state.exit_code)
         {
             mpl::log(mpl::Level::info, vm_name,
@@ -608,26 +1086,609 @@ void mp::QemuVirtualMachine::initialize_vm_process()
 void mp::QemuVirtualMachine::update_cpus(int num_cores)
 {
     assert(num_cores > 0);
+    if (state == State::running)
+        hotplug_cpus(num_cores);
+
     desc.num_cores = num_cores;
 }
 
 void mp::QemuVirtualMachine::resize_memory(const MemorySize& new_size)
 {
+    if (state == State::running)
+        hotplug_memory(new_size);
+
     desc.mem_size = new_size;
+    if (state == State::running)
+        place_in_cgroup(); // for the memory limit to grow with it
+}
+
+bool mp::QemuVirtualMachine::hotpluggable()
+{
+    if (!QemuVMProcessSpec::hotplug_supported() || !vm_process)
+        return false;
+
+    // Instances started before they were given room to grow can't
+    const auto args = vm_process->arguments();
+    const auto smp = args.indexOf("-smp");
+    return smp >= 0 && smp + 1 < args.size() && args[smp + 1].contains("maxcpus=");
+}
+
+std::optional<std::uint32_t> mp::QemuVirtualMachine::vsock_cid()
+{
+    if (!vm_process)
+        return std::nullopt;
+
+    // Instances keep whichever device they were started with, until they are restarted
+    static const QRegularExpression vsock_device{"^vhost-vsock-pci,.*guest-cid=([0-9]+)"};
+    for (const auto& arg : vm_process->arguments())
+        if (const auto match = vsock_device.match(arg); match.hasMatch())
+            return match.captured(1).toUInt();
+
+    return std::nullopt;
+}
+
+std::optional<std::string> mp::QemuVirtualMachine::guest_exec(const std::string& command)
+{
+    return ask_guest_agent(vm_name, guest_agent_mutex,
+                           [&command](QemuGuestAgent& agent) { return agent.exec(command); });
+}
+
+std::optional<std::vector<std::string>> mp::QemuVirtualMachine::guest_ipv4()
+{
+    return ask_guest_agent(vm_name, guest_agent_mutex, [](QemuGuestAgent& agent) { return agent.ipv4(); });
+}
+
+std::optional<mp::VirtualMachine::HostStats> mp::QemuVirtualMachine::host_stats()
+{
+    if (!vm_process || !vm_process->running() || !qmp)
+        return std::nullopt;
+
+    HostStats stats;
+#ifdef MULTIPASS_PLATFORM_LINUX
+    read_process_stats(vm_process->process_id(), stats);
+#endif
+
+    // QEMU answers these from its own loop, however busy the guest is, so only devices that are not there fail them
+    try
+    {
+        const auto balloon = qmp_execute_and_wait("query-balloon").toObject();
+        stats.balloon_bytes = static_cast<std::uint64_t>(balloon["actual"].toDouble());
+    }
+    catch (const std::exception& e)
+    {
+        mpl::log(mpl::Level::trace, vm_name, fmt::format("No balloon size: {}", e.what()));
+    }
+
+    try
+    {
+        for (const auto& device : qmp_execute_and_wait("query-blockstats").toArray())
+        {
+            const auto io = device.toObject()["stats"].toObject();
+            stats.disk_read_bytes += static_cast<std::uint64_t>(io["rd_bytes"].toDouble());
+            stats.disk_written_bytes += static_cast<std::uint64_t>(io["wr_bytes"].toDouble());
+        }
+    }
+    catch (const std::exception& e)
+    {
+        mpl::log(mpl::Level::trace, vm_name, fmt::format("No block device stats: {}", e.what()));
+    }
+
+    if (const auto network = qemu_platform->network_counters(vm_name))
+        std::tie(stats.network_received_bytes, stats.network_sent_bytes) = *network;
+
+    return stats;
+}
+
+std::vector<std::string> mp::QemuVirtualMachine::disk_profiles()
+{
+    std::vector<std::string> ret;
+    for (const auto& profile : QemuVMProcessSpec::disk_profiles())
+        ret.push_back(profile.toStdString());
+
+    return ret;
+}
+
+std::string mp::QemuVirtualMachine::disk_profile()
+{
+    const auto profile = monitor->retrieve_metadata_for(vm_name)[disk_profile_key].toString();
+    return profile.isEmpty() ? QemuVMProcessSpec::default_disk_profile : profile.toStdString();
+}
+
+void mp::QemuVirtualMachine::set_disk_profile(const std::string& profile)
+{
+    // Kept with the rest of what the instance is started with, for the next time it boots from scratch
+    update_metadata_entry(*monitor, vm_name, disk_profile_key,
+                          profile == QemuVMProcessSpec::default_disk_profile ? QJsonValue{}
+                                                                             : QString::fromStdString(profile));
+}
+
+// The address the guest had before, unless another guest took it since, and the first one free from that of its name
+// otherwise, kept for it to stay the same across starts
+std::uint32_t mp::QemuVirtualMachine::allocate_vsock_cid()
+{
+    const auto recorded = monitor->retrieve_metadata_for(vm_name)[vsock_cid_key];
+    auto cid = recorded.isDouble() ? static_cast<std::uint32_t>(recorded.toDouble())
+                                   : QemuVMProcessSpec::vsock_cid_for(vm_name);
+
+#ifdef MULTIPASS_PLATFORM_LINUX
+    // 0 to 2 are reserved and 0xFFFFFFFF means any
+    constexpr std::uint32_t first_cid = 3, last_cid = 0xFFFFFFFE;
+    constexpr auto max_attempts = 64;
+
+    for (auto attempt = 1; !vsock_cid_free(cid); ++attempt)
+    {
+        if (attempt == max_attempts)
+            throw std::runtime_error{fmt::format("no vsock address free for {} after {} tries", vm_name, attempt)};
+
+        cid = cid == last_cid ? first_cid : cid + 1;
+    }
+#endif
+
+    if (!recorded.isDouble() || recorded.toDouble() != cid)
+        update_metadata_entry(*monitor, vm_name, vsock_cid_key, static_cast<qint64>(cid));
+
+    return cid;
+}
+
+bool mp::QemuVirtualMachine::hugepages()
+{
+    return monitor->retrieve_metadata_for(vm_name)[hugepages_key].toBool();
+}
+
+void mp::QemuVirtualMachine::set_hugepages(bool enabled)
+{
+#ifndef MULTIPASS_PLATFORM_LINUX
+    if (enabled)
+        throw NotImplementedOnThisBackendException{"hugepages"};
+#endif
+
+    update_metadata_entry(*monitor, vm_name, hugepages_key, enabled ? QJsonValue{true} : QJsonValue{});
+}
+
+std::string mp::QemuVirtualMachine::cpu_pinning()
+{
+    const auto pinning = monitor->retrieve_metadata_for(vm_name)[cpu_pinning_key].toString();
+    return pinning.isEmpty() ? no_cpu_pinning : pinning.toStdString();
+}
+
+void mp::QemuVirtualMachine::set_cpu_pinning(const std::string& pinning)
+{
+    if (pinning != no_cpu_pinning)
+    {
+#ifdef MULTIPASS_PLATFORM_LINUX
+        if (pinning != numa_cpu_pinning)
+            HostTopology::parse_cpu_list(QString::fromStdString(pinning)); // just to check it
+#else
+        throw NotImplementedOnThisBackendException{"CPU pinning"};
+#endif
+    }
+
+    update_metadata_entry(*monitor, vm_name, cpu_pinning_key,
+                          pinning == no_cpu_pinning ? QJsonValue{} : QString::fromStdString(pinning));
+}
+
+int mp::QemuVirtualMachine::network_limit()
+{
+    return monitor->retrieve_metadata_for(vm_name)[network_limit_key].toInt();
+}
+
+void mp::QemuVirtualMachine::set_network_limit(int mbits)
+{
+#ifndef MULTIPASS_PLATFORM_LINUX
+    if (mbits)
+        throw NotImplementedOnThisBackendException{"network limits"};
+#endif
+
+    update_metadata_entry(*monitor, vm_name, network_limit_key, mbits ? QJsonValue{mbits} : QJsonValue{});
+}
+
+int mp::QemuVirtualMachine::disk_iops_limit()
+{
+    return monitor->retrieve_metadata_for(vm_name)[disk_iops_key].toInt();
+}
+
+void mp::QemuVirtualMachine::set_disk_iops_limit(int iops)
+{
+    update_metadata_entry(*monitor, vm_name, disk_iops_key, iops ? QJsonValue{iops} : QJsonValue{});
+}
+
+int mp::QemuVirtualMachine::cpu_weight()
+{
+    return monitor->retrieve_metadata_for(vm_name)[cpu_weight_key].toInt();
+}
+
+void mp::QemuVirtualMachine::set_cpu_weight(int weight)
+{
+    set_weight(cpu_weight_key, weight);
+}
+
+int mp::QemuVirtualMachine::io_weight()
+{
+    return monitor->retrieve_metadata_for(vm_name)[io_weight_key].toInt();
+}
+
+void mp::QemuVirtualMachine::set_io_weight(int weight)
+{
+    set_weight(io_weight_key, weight);
+}
+
+std::string mp::QemuVirtualMachine::memory_limit()
+{
+    const auto limit = monitor->retrieve_metadata_for(vm_name)[memory_limit_key].toString();
+    return limit.isEmpty() ? no_memory_limit : limit.toStdString();
+}
+
+void mp::QemuVirtualMachine::set_memory_limit(const std::string& limit)
+{
+    if (limit != no_memory_limit && limit != soft_memory_limit && limit != hard_memory_limit)
+        throw std::invalid_argument{fmt::format("\"{}\" is none of \"{}\", \"{}\" and \"{}\"", limit, no_memory_limit,
+                                                soft_memory_limit, hard_memory_limit)};
+#ifndef MULTIPASS_PLATFORM_LINUX
+    if (limit != no_memory_limit)
+        throw NotImplementedOnThisBackendException{"memory limits"};
+#endif
+
+    update_metadata_entry(*monitor, vm_name, memory_limit_key,
+                          limit == no_memory_limit ? QJsonValue{} : QString::fromStdString(limit));
+}
+
+void mp::QemuVirtualMachine::set_weight(const char* key, int weight)
+{
+    if (weight < 0 || weight > max_weight)
+        throw std::invalid_argument{fmt::format("{} is not a weight from 1 to {}", weight, max_weight)};
+#ifndef MULTIPASS_PLATFORM_LINUX
+    if (weight)
+        throw NotImplementedOnThisBackendException{"resource weights"};
+#endif
+
+    update_metadata_entry(*monitor, vm_name, key, weight ? QJsonValue{weight} : QJsonValue{});
+}
+
+bool mp::QemuVirtualMachine::fast_boot()
+{
+    return monitor->retrieve_metadata_for(vm_name)[fast_boot_key].toBool();
+}
+
+void mp::QemuVirtualMachine::set_fast_boot(bool enabled)
+{
+    update_metadata_entry(*monitor, vm_name, fast_boot_key, enabled ? QJsonValue{true} : QJsonValue{});
+    if (!enabled)
+    {
+        update_metadata_entry(*monitor, vm_name, boot_files_key, QJsonValue{});
+        for (const auto suffix : {kernel_suffix, initrd_suffix, cmdline_suffix})
+            QFile::remove(boot_file_path(desc, suffix));
+    }
+}
+
+void mp::QemuVirtualMachine::capture_boot_files(const SSHKeyProvider& key_provider)
+{
+    if (!fast_boot())
+        return;
+
+    mpl::TraceSpan span{"capture_boot_files", vm_name};
+    SSHSession session{ssh_hostname(), ssh_port(), ssh_username(), key_provider};
+
+    // The newest kernel installed, as the bootloader would pick it, copied again whenever that changes
+    const auto boot_files = QString::fromStdString(
+        mp::utils::run_in_ssh_session(session, "sudo stat -L -c '%n %s %Y' /boot/vmlinuz /boot/initrd.img"));
+    if (boot_files == monitor->retrieve_metadata_for(vm_name)[boot_files_key].toString() && direct_boot(desc))
+        return;
+
+    copy_from_guest(session, "sudo cat /boot/vmlinuz", boot_file_path(desc, kernel_suffix));
+    copy_from_guest(session, "sudo cat /boot/initrd.img", boot_file_path(desc, initrd_suffix));
+    // What the bootloader passed, less the entry that only it uses
+    copy_from_guest(session, "sed -e 's/BOOT_IMAGE=[^ ]* *//' /proc/cmdline", boot_file_path(desc, cmdline_suffix));
+
+    update_metadata_entry(*monitor, vm_name, boot_files_key, boot_files);
+    mpl::log(mpl::Level::info, vm_name, "Copied the guest's kernel and initrd for fast boot");
+}
+
+std::string mp::QemuVirtualMachine::console_log()
+{
+    // The ring buffer hands out what it has once, so it is drained into the log each time
+    if (vm_process && vm_process->running())
+    {
+        try
+        {
+            const auto output = qmp_execute_and_wait("ringbuf-read", {{"device", QemuVMProcessSpec::serial_ring_id},
+                                                                      {"size", QemuVMProcessSpec::serial_ring_size},
+                                                                      {"format", "utf8"}});
+            process_log.append(mpl::Level::debug, output.toString().toStdString());
+        }
+        catch (const std::runtime_error& e)
+        {
+            mpl::log(mpl::Level::debug, vm_name, fmt::format("Cannot read the serial console: {}", e.what()));
+        }
+    }
+
+    return process_log.contents();
+}
+
+std::optional<int>
+mp::QemuVirtualMachine::place_vcpus([[maybe_unused]] const std::optional<QJsonObject>& resume_metadata)
+{
+    pinned_cpus.clear();
+    const auto pinning = cpu_pinning();
+    if (pinning == no_cpu_pinning)
+        return std::nullopt;
+
+#ifdef MULTIPASS_PLATFORM_LINUX
+    if (pinning != numa_cpu_pinning)
+    {
+        // One host CPU each, as listed
+        pinned_cpus = HostTopology::parse_cpu_list(QString::fromStdString(pinning));
+        pin_each_vcpu = true;
+        return std::nullopt;
+    }
+
+    const auto nodes = MP_HOST_TOPOLOGY.numa_nodes();
+    if (nodes.empty())
+    {
+        mpl::log(mpl::Level::warning, vm_name, "The host has no NUMA nodes to place vCPUs in, leaving them be");
+        return std::nullopt;
+    }
+
+    // Resumed instances stay where their memory is, others go where there is the most room
+    auto node = resume_metadata ? numa_node(get_arguments(*resume_metadata)) : std::nullopt;
+    if (!node || nodes.find(*node) == nodes.end())
+        node = std::max_element(nodes.cbegin(), nodes.cend(), [](const auto& a, const auto& b) {
+                   return a.second.free_memory < b.second.free_memory;
+               })->first;
+
+    // Any CPU of the node, for the scheduler to balance vCPUs within it
+    pinned_cpus = nodes.at(*node).cpus;
+    pin_each_vcpu = false;
+    mpl::log(mpl::Level::debug, vm_name, fmt::format("Placing vCPUs and memory in NUMA node {}", *node));
+
+    // Binding memory takes a QEMU built with NUMA support, which a host with a single node has no use for
+    return nodes.size() > 1 ? node : std::nullopt;
+#else
+    return std::nullopt;
+#endif
+}
+
+void mp::QemuVirtualMachine::pin_vcpus()
+{
+#ifdef MULTIPASS_PLATFORM_LINUX
+    if (pinned_cpus.empty())
+        return;
+
+    qmp->execute("query-cpus-fast", {}, [this](const QJsonValue& result, const QString& error) {
+        if (!error.isEmpty())
+        {
+            mpl::log(mpl::Level::warning, vm_name, fmt::format("Could not find vCPU threads to pin: {}", error));
+            return;
+        }
+
+        for (const auto& vcpu : result.toArray())
+        {
+            const auto index = static_cast<std::size_t>(vcpu.toObject()["cpu-index"].toInt());
+            const auto thread_id = vcpu.toObject()["thread-id"].toInt();
+            try
+            {
+                MP_HOST_TOPOLOGY.pin_thread(thread_id, pin_each_vcpu
+                                                           ? HostTopology::CPUs{pinned_cpus[index % pinned_cpus.size()]}
+                                                           : pinned_cpus);
+            }
+            catch (const std::runtime_error& e)
+            {
+                mpl::log(mpl::Level::warning, vm_name, e.what());
+            }
+        }
+    });
+#endif
+}
+
+void mp::QemuVirtualMachine::place_in_cgroup()
+{
+#ifdef MULTIPASS_PLATFORM_LINUX
+    if (!vm_process || !MP_CGROUPS.available())
+        return;
+
+    Cgroups::Controls controls{cpu_weight(), io_weight()};
+    if (const auto limit = memory_limit(); limit != no_memory_limit)
+    {
+        const auto guest_memory = desc.mem_size.in_bytes();
+        (limit == hard_memory_limit ? controls.memory_max : controls.memory_high) =
+            guest_memory + guest_memory / 8 + memory_overhead;
+    }
+
+    try
+    {
+        MP_CGROUPS.place(vm_name, vm_process->process_id(), controls);
+    }
+    catch (const std::runtime_error& e)
+    {
+        mpl::log(mpl::Level::warning, vm_name, fmt::format("Could not place the instance in a cgroup: {}", e.what()));
+    }
+#endif
+}
+
+void mp::QemuVirtualMachine::hotplug_cpus(int num_cores)
+{
+    if (num_cores < desc.num_cores)
+        throw std::runtime_error("vCPUs can only be added while the instance is running");
+
+    // The slots still free, listed by QEMU from the last one, to be filled from the first
+    std::vector<QJsonObject> free_slots;
+    for (const auto& slot : qmp_execute_and_wait("query-hotpluggable-cpus").toArray())
+        if (!slot.toObject().contains("qom-path"))
+            free_slots.insert(free_slots.begin(), slot.toObject());
+
+    const auto added = static_cast<std::size_t>(num_cores - desc.num_cores);
+    if (added > free_slots.size())
+        throw std::runtime_error(fmt::format("only {} more vCPUs can be added while the instance is running",
+                                             free_slots.size()));
+
+    for (std::size_t i = 0; i < added; ++i)
+    {
+        auto device = free_slots[i]["props"].toObject();
+        device.insert("driver", free_slots[i]["type"]);
+        device.insert("id", QString{"hotplug%1"}.arg(hotplugged_devices++));
+
+        qmp_execute_and_wait("device_add", device);
+        record_hotplugged_device({"-device", device_option(device)});
+        desc.num_cores += 1;
+    }
+
+    mpl::log(mpl::Level::info, vm_name, fmt::format("Hot-plugged vCPUs, now {}", desc.num_cores));
+    pin_vcpus();
+}
+
+void mp::QemuVirtualMachine::hotplug_memory(const MemorySize& new_size)
+{
+    // Linux brings memory online in blocks of 128MiB on x86
+    constexpr auto block = 128LL * 1024 * 1024;
+
+    const auto added = new_size.in_bytes() - desc.mem_size.in_bytes();
+    if (added < 0)
+        throw std::runtime_error("memory can only be added while the instance is running");
+    if (added % block)
+        throw std::runtime_error("memory can only be added in multiples of 128MiB while the instance is running");
+
+    const auto id = QString{"hotplug%1"}.arg(hotplugged_devices++);
+    const auto memdev = id + "-mem";
+
+    // Shared with the processes serving vhost-user devices and taken from hugepages, like the rest of guest memory
+    const auto on_hugepages = hugepages();
+    QJsonObject backend{{"qom-type", can_suspend && !on_hugepages ? "memory-backend-ram" : "memory-backend-memfd"},
+                        {"id", memdev},
+                        {"size", added}};
+    if (!can_suspend)
+        backend.insert("share", true);
+    if (on_hugepages)
+        backend.insert("hugetlb", true);
+    const QJsonObject dimm{{"driver", "pc-dimm"}, {"id", id}, {"memdev", memdev}};
+
+    qmp_execute_and_wait("object-add", backend);
+    try
+    {
+        qmp_execute_and_wait("device_add", dimm);
+    }
+    catch (const std::runtime_error&)
+    {
+        qmp->execute("object-del", QJsonObject{{"id", memdev}});
+        throw;
+    }
+
+    auto backend_option = backend;
+    backend_option.insert("driver", backend_option.take("qom-type"));
+    record_hotplugged_device({"-object", device_option(backend_option), "-device", device_option(dimm)});
+    mpl::log(mpl::Level::info, vm_name,
+             fmt::format("Hot-plugged {} of memory", MemorySize{std::to_string(added)}.human_readable()));
+}
+
+QJsonValue mp::QemuVirtualMachine::qmp_execute_and_wait(const QString& command, const QJsonObject& arguments)
+{
+    // Shared with the callback, which could come after giving up on it
+    auto reply = std::make_shared<std::optional<std::pair<QJsonValue, QString>>>();
+    qmp->execute(command, arguments,
+                 [reply](const QJsonValue& result, const QString& error) { reply->emplace(result, error); });
+
+    const auto deadline = std::chrono::steady_clock::now() + 30s;
+    while (!*reply && vm_process && vm_process->running() && std::chrono::steady_clock::now() < deadline)
+        vm_process->wait_for_ready_read(1000);
+
+    if (!*reply)
+        throw std::runtime_error(fmt::format("QEMU did not answer {}", command));
+
+    const auto& [result, error] = **reply;
+    if (!error.isEmpty())
+        throw std::runtime_error(fmt::format("{} failed: {}", command, error));
+
+    return result;
+}
+
+// Keeps what was hot-plugged in the arguments to resume the instance with, for its devices to be there to restore
+void mp::QemuVirtualMachine::record_hotplugged_device(const QStringList& args)
+{
+    auto metadata = monitor->retrieve_metadata_for(vm_name);
+    auto recorded_args = metadata[arguments_key].toArray();
+    for (const auto& arg : args)
+        recorded_args.append(arg);
+
+    metadata[arguments_key] = recorded_args;
+    monitor->update_metadata_for(vm_name, metadata);
 }
 
 void mp::QemuVirtualMachine::resize_disk(const MemorySize& new_size)
 {
     assert(new_size > desc.disk_space);
 
-    mp::backend::resize_instance_image(new_size, desc.image.image_path);
+    if (state == State::running)
+        grow_disk_online(new_size);
+    else
+        mp::backend::resize_instance_image(new_size, desc.image.image_path);
+
     desc.disk_space = new_size;
 }
 
+bool mp::QemuVirtualMachine::online_disk_resize()
+{
+    return vm_process && vm_process->running() && qmp;
+}
+
+void mp::QemuVirtualMachine::grow_disk_online(const MemorySize& new_size)
+{
+    qmp_execute_and_wait("block_resize", {{"device", "hda"}, {"size", static_cast<qint64>(new_size.in_bytes())}});
+
+    // The guest sees the new size right away. Without the agent, cloud-init grows the file system on the next boot.
+    if (!guest_exec(grow_root_cmd))
+        mpl::log(mpl::Level::info, vm_name, "The root file system will grow into the new disk space on the next boot");
+}
+
+void mp::QemuVirtualMachine::compact_disk(bool compress)
+{
+    if (vm_process && vm_process->running())
+        throw std::runtime_error{fmt::format("Cannot compact {} while it is running", vm_name)};
+
+    mp::backend::compact_image(desc.image.image_path, compress);
+}
+
+void mp::QemuVirtualMachine::take_snapshot(const std::string& name)
+{
+    if (vm_process && vm_process->running())
+        throw std::runtime_error{fmt::format("Cannot snapshot {} while it is running", vm_name)};
+
+    mp::backend::snapshot_image(desc.image.image_path, QString::fromStdString(name));
+}
+
+void mp::QemuVirtualMachine::restore_snapshot(const std::string& name)
+{
+    if (vm_process && vm_process->running())
+        throw std::runtime_error{fmt::format("Cannot restore {} while it is running", vm_name)};
+
+    mp::backend::restore_image(desc.image.image_path, QString::fromStdString(name));
+}
+
+std::vector<std::string> mp::QemuVirtualMachine::list_snapshots()
+{
+    std::vector<std::string> names;
+    for (const auto& name : mp::backend::list_snapshots(desc.image.image_path))
+        names.push_back(name.toStdString());
+
+    return names;
+}
+
+void mp::QemuVirtualMachine::delete_snapshot(const std::string& name)
+{
+    // What comes after the snapshot has what it holds rewritten into it, which QEMU must not have open meanwhile
+    if (vm_process && vm_process->running())
+        throw std::runtime_error{fmt::format("Cannot delete a snapshot of {} while it is running", vm_name)};
+
+    mp::backend::delete_snapshot(desc.image.image_path, QString::fromStdString(name));
+}
+
 mp::MountHandler::UPtr mp::QemuVirtualMachine::make_native_mount_handler(const SSHKeyProvider* ssh_key_provider,
                                                                          const std::string& target,
                                                                          const VMMount& mount)
 {
+#ifdef MULTIPASS_PLATFORM_LINUX
+    // Opt-in, as instances with virtiofs mounts cannot be suspended
+    if (MP_SETTINGS.get(mp::qemu_virtiofs_key) == "true" && !VirtiofsdProcessSpec::locate().isEmpty())
+        return std::make_unique<VirtiofsMountHandler>(this, ssh_key_provider, target, mount);
+#endif
+
     return std::make_unique<QemuMountHandler>(this, ssh_key_provider, target, mount);
 }
 
@@ -635,3 +1696,8 @@ mp::QemuVirtualMachine::MountArgs& mp::QemuVirtualMachine::modifiable_mount_args
 {
     return mount_args;
 }
+
+mp::QemuVirtualMachine::MountHooks& mp::QemuVirtualMachine::modifiable_mount_hooks()
+{
+    return mount_hooks;
+}
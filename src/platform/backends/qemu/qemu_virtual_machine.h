@@ -19,16 +19,23 @@
 #define MULTIPASS_QEMU_VIRTUAL_MACHINE_H
 
 #include "qemu_platform.h"
+#include "qmp_client.h"
 
 #include <shared/base_virtual_machine.h>
 
+#include <multipass/logging/instance_log.h>
 #include <multipass/process/process.h>
 #include <multipass/virtual_machine_description.h>
 
+#include <QJsonObject>
 #include <QObject>
 #include <QStringList>
 
+#include <functional>
+#include <mutex>
+#include <optional>
 #include <unordered_map>
+#include <vector>
 
 namespace multipass
 {
@@ -40,6 +47,8 @@ class QemuVirtualMachine : public QObject, public BaseVirtualMachine
     Q_OBJECT
 public:
     using MountArgs = std::unordered_map<std::string, std::pair<std::string, QStringList>>;
+    // Run before QEMU is launched, by mount tag, for mounts served by a host process QEMU needs to connect to
+    using MountHooks = std::unordered_map<std::string, std::function<void()>>;
 
     QemuVirtualMachine(const VirtualMachineDescription& desc, QemuPlatform* qemu_platform, VMStatusMonitor& monitor);
     ~QemuVirtualMachine();
@@ -52,6 +61,10 @@ public:
     int ssh_port() override;
     std::string ssh_hostname(std::chrono::milliseconds timeout) override;
     std::string ssh_username() override;
+    std::optional<std::uint32_t> vsock_cid() override;
+    std::optional<std::string> guest_exec(const std::string& command) override;
+    std::optional<std::vector<std::string>> guest_ipv4() override;
+    std::optional<HostStats> host_stats() override;
     std::string management_ipv4() override;
     std::string ipv6() override;
     void ensure_vm_is_running() override;
@@ -60,7 +73,36 @@ public:
     void update_cpus(int num_cores) override;
     void resize_memory(const MemorySize& new_size) override;
     void resize_disk(const MemorySize& new_size) override;
+    bool online_disk_resize() override;
+    void compact_disk(bool compress) override;
+    void take_snapshot(const std::string& name) override;
+    void restore_snapshot(const std::string& name) override;
+    std::vector<std::string> list_snapshots() override;
+    void delete_snapshot(const std::string& name) override;
+    bool hotpluggable() override;
+    std::vector<std::string> disk_profiles() override;
+    std::string disk_profile() override;
+    void set_disk_profile(const std::string& profile) override;
+    bool hugepages() override;
+    void set_hugepages(bool enabled) override;
+    std::string cpu_pinning() override;
+    void set_cpu_pinning(const std::string& pinning) override;
+    int network_limit() override;
+    void set_network_limit(int mbits) override;
+    int disk_iops_limit() override;
+    void set_disk_iops_limit(int iops) override;
+    int cpu_weight() override;
+    void set_cpu_weight(int weight) override;
+    int io_weight() override;
+    void set_io_weight(int weight) override;
+    std::string memory_limit() override;
+    void set_memory_limit(const std::string& limit) override;
+    bool fast_boot() override;
+    void set_fast_boot(bool enabled) override;
+    void capture_boot_files(const SSHKeyProvider& key_provider) override;
+    std::string console_log() override;
     virtual MountArgs& modifiable_mount_args();
+    virtual MountHooks& modifiable_mount_hooks();
     std::unique_ptr<MountHandler> make_native_mount_handler(const SSHKeyProvider* ssh_key_provider,
                                                             const std::string& target, const VMMount& mount) override;
 
@@ -79,19 +121,47 @@ private:
     void on_shutdown();
     void on_suspend();
     void on_restart();
+    void set_guest_ready(bool ready);
     void initialize_vm_process();
+    void connect_vm_process();
+    void reattach(); // to a QEMU left running by the daemon before, if there is one
+    bool outlives_daemon() const; // whether QEMU would survive the daemon's service stopping
+    void negotiate_qmp_capabilities();
+    void suspend_to_file();
+    std::optional<int> place_vcpus(const std::optional<QJsonObject>& resume_metadata); // the NUMA node, if any
+    void pin_vcpus();
+    std::uint32_t allocate_vsock_cid(); // for the guest, kept in the metadata
+    void place_in_cgroup(); // with the weights and memory limit it is set to
+    void set_weight(const char* key, int weight);
+    void hotplug_cpus(int num_cores);
+    void hotplug_memory(const MemorySize& new_size);
+    void grow_disk_online(const MemorySize& new_size);
+    QJsonValue qmp_execute_and_wait(const QString& command, const QJsonObject& arguments = {});
+    void record_hotplugged_device(const QStringList& args);
 
     VirtualMachineDescription desc;
     std::unique_ptr<Process> vm_process{nullptr};
+    std::unique_ptr<QmpClient> qmp;
     const std::string mac_addr;
     const std::string username;
     QemuPlatform* qemu_platform;
     VMStatusMonitor* monitor;
     MountArgs mount_args;
+    MountHooks mount_hooks;
     std::string saved_error_msg;
     bool update_shutdown_status{true};
     bool is_starting_from_suspend{false};
+    bool can_suspend{true};
+    const bool reattaches{false}; // read once, so that going away with the daemon does not ask settings
+    bool saving_vm{false};      // savevm sent, until QEMU resumes the guest once it's through
+    bool dumping_memory{false}; // migrating to a memory snapshot file, until it's complete or failed
+    QString migration_error;
+    int hotplugged_devices{0}; // to give them ids of their own
+    std::vector<int> pinned_cpus; // host CPUs for vCPUs to run on, any while empty
+    bool pin_each_vcpu{false};    // to one of pinned_cpus, in turn, rather than to all
     std::chrono::steady_clock::time_point network_deadline;
+    logging::InstanceLog process_log{vm_name}; // QEMU's standard error and the serial console
+    std::mutex guest_agent_mutex; // asked from info's threads, one at a time
 };
 } // namespace multipass
 
@@ -18,18 +18,24 @@
 #include "qemu_virtual_machine_factory.h"
 #include "qemu_virtual_machine.h"
 
+#include <multipass/constants.h>
 #include <multipass/format.h>
 #include <multipass/logging/log.h>
 #include <multipass/platform.h>
 #include <multipass/process/simple_process_spec.h>
+#include <multipass/settings/settings.h>
+#include <multipass/utils.h>
 #include <multipass/virtual_machine_description.h>
 
 #include <shared/qemu_img_utils/qemu_img_utils.h>
 
+#include <QDir>
+#include <QFile>
 #include <QRegularExpression>
 
 namespace mp = multipass;
 namespace mpl = multipass::logging;
+namespace mpu = multipass::utils;
 
 namespace
 {
@@ -56,15 +62,53 @@ mp::VMImage mp::QemuVirtualMachineFactory::prepare_source_image(const mp::VMImag
 {
     VMImage image{source_image};
     image.image_path = mp::backend::convert_to_qcow_if_necessary(source_image.image_path);
+
+    // Cached compressed, to take less space and less reading; instances get their own uncompressed copy
+    if (MP_SETTINGS.get(mp::image_compression_key) == "zstd")
+    {
+        const auto header = mp::backend::read_image_header(image.image_path);
+        if (header && !header->zstd_compressed)
+            mp::backend::compress_image(image.image_path);
+    }
+
     return image;
 }
 
 void mp::QemuVirtualMachineFactory::prepare_instance_image(const mp::VMImage& instance_image,
                                                            const VirtualMachineDescription& desc)
 {
+    // Copied from a compressed cache, it is expanded so that the instance does not pay for decompressing its reads
+    if (const auto header = mp::backend::read_image_header(instance_image.image_path);
+        header && header->zstd_compressed)
+        mp::backend::compact_image(instance_image.image_path, /*compress=*/false);
+
     mp::backend::resize_instance_image(desc.disk_space, instance_image.image_path);
 }
 
+void mp::QemuVirtualMachineFactory::configure(VirtualMachineDescription& vm_desc)
+{
+    // Instances keep being seeded the way they were launched, whatever the daemon is told since
+    const auto instance_dir = mpu::base_dir(vm_desc.image.image_path);
+    const QDir seed_dir{instance_dir.filePath(nocloud_net_seed_dir)};
+    if (!seed_dir.exists() && (QFile::exists(instance_dir.filePath("cloud-init-config.iso")) ||
+                               !qemu_platform->serves_seeds()))
+        return BaseVirtualMachineFactory::configure(vm_desc);
+
+    // Plain files rather than an ISO, served to the instance for as long as it lives
+    if (!seed_dir.exists())
+    {
+        std::vector<std::pair<QString, const YAML::Node*>> files{{"meta-data", &vm_desc.meta_data_config},
+                                                                {"vendor-data", &vm_desc.vendor_data_config},
+                                                                {"user-data", &vm_desc.user_data_config}};
+        if (!vm_desc.network_data_config.IsNull())
+            files.emplace_back("network-config", &vm_desc.network_data_config);
+
+        for (const auto& [name, config] : files)
+            MP_UTILS.make_file_with_content(seed_dir.filePath(name).toStdString(), mpu::emit_cloud_config(*config),
+                                            true);
+    }
+}
+
 void mp::QemuVirtualMachineFactory::hypervisor_health_check()
 {
     qemu_platform->platform_health_check();
@@ -17,20 +17,120 @@
 
 #include "qemu_vm_process_spec.h"
 
+#include <multipass/constants.h>
 #include <multipass/exceptions/snap_environment_exception.h>
 #include <multipass/format.h>
 #include <multipass/logging/log.h>
+#include <multipass/settings/settings.h>
 #include <multipass/snap_utils.h>
+#include <multipass/standard_paths.h>
+#include <multipass/utils.h>
 #include <shared/linux/backend_utils.h>
+#include <shared/qemu_img_utils/qemu_img_utils.h>
+
+#include <QCryptographicHash>
+#include <QDir>
+
+#include <algorithm>
+#include <cassert>
+#include <thread>
+
+#include <unistd.h>
 
 namespace mp = multipass;
 namespace mpl = multipass::logging;
 namespace mu = multipass::utils;
 
+namespace
+{
+// Devices served by another host process, like virtiofs', access guest memory directly
+bool has_vhost_user_devices(const mp::QemuVirtualMachine::MountArgs& mount_args)
+{
+    auto is_vhost_user_device = [](const QString& arg) { return arg.startsWith("vhost-user-"); };
+    return std::any_of(mount_args.cbegin(), mount_args.cend(), [&is_vhost_user_device](const auto& mount) {
+        const auto& args = mount.second.second;
+        return std::any_of(args.cbegin(), args.cend(), is_vhost_user_device);
+    });
+}
+
+// Kept out of the temporary directory, where anyone could leave a socket or pidfile in their place for the daemon to
+// take for QEMU's; that of the daemon's user is only its own
+QString private_runtime_dir()
+{
+    auto dir = MP_STDPATHS.writableLocation(mp::StandardPaths::RuntimeLocation);
+    if (dir.isEmpty()) // none that is safe to use, the daemon's data is not anyone else's either
+    {
+        dir = MP_STDPATHS.writableLocation(mp::StandardPaths::AppLocalDataLocation);
+        QDir{}.mkpath(dir);
+    }
+
+    return dir;
+}
+
+// What the guest can grow to while running, no more than the host has but never less than what it starts with
+int max_cpus(int num_cores)
+{
+    return std::max(num_cores, static_cast<int>(std::thread::hardware_concurrency()));
+}
+
+long long max_memory_in_megabytes(const mp::MemorySize& mem_size)
+{
+    const auto host_memory = static_cast<long long>(sysconf(_SC_PHYS_PAGES)) * sysconf(_SC_PAGESIZE);
+    return std::max(mem_size.in_megabytes(), host_memory / (1024 * 1024));
+}
+
+// The tuned profiles give the disk a thread of its own, one queue per vCPU and I/O that bypasses the host's page cache
+QStringList disk_arguments(const QString& disk_profile, const QString& image_path, int num_cores, int iops)
+{
+    auto drive = QString("file=%1,if=none,format=qcow2,discard=unmap,id=hda").arg(image_path);
+    if (iops)
+        drive += QString(",throttling.iops-total=%1").arg(iops);
+
+    if (disk_profile == mp::QemuVMProcessSpec::default_disk_profile)
+        return {"-device", "virtio-scsi-pci,id=scsi0", "-drive", drive, "-device", "scsi-hd,drive=hda,bus=scsi0.0"};
+
+    QStringList args{"-object", "iothread,id=iothread0", "-drive", drive + ",cache=none,aio=native"};
+    if (disk_profile == "virtio-blk")
+        return args << "-device" << QString("virtio-blk-pci,drive=hda,iothread=iothread0,num-queues=%1").arg(num_cores);
+
+    assert(disk_profile == "virtio-scsi");
+    return args << "-device" << QString("virtio-scsi-pci,id=scsi0,iothread=iothread0,num_queues=%1").arg(num_cores)
+                << "-device"
+                << "scsi-hd,drive=hda,bus=scsi0.0";
+}
+
+QString memory_backend(const QString& mem_size, bool shared, const mp::QemuVMProcessSpec::Tuning& tuning)
+{
+    auto backend = QString("memory-backend-memfd,id=mem,size=%1").arg(mem_size);
+    if (shared)
+        backend += ",share=on";
+    if (tuning.hugepages)
+        backend += ",hugetlb=on"; // of the host's default size, which the memory size must be a multiple of
+    if (tuning.numa_node)
+        backend += QString(",host-nodes=%1,policy=bind").arg(*tuning.numa_node);
+
+    return backend;
+}
+
+// QEMU loads the kernel itself when booting it directly, and falls back to its built-in firmware without -bios
+QStringList without_firmware(QStringList platform_args)
+{
+    if (const auto bios = platform_args.indexOf("-bios"); bios >= 0 && bios + 1 < platform_args.size())
+        platform_args.erase(platform_args.begin() + bios, platform_args.begin() + bios + 2);
+
+    return platform_args;
+}
+} // namespace
+
+QStringList mp::QemuVMProcessSpec::disk_profiles()
+{
+    return {default_disk_profile, "virtio-blk", "virtio-scsi"};
+}
+
 mp::QemuVMProcessSpec::QemuVMProcessSpec(const mp::VirtualMachineDescription& desc, const QStringList& platform_args,
                                          const mp::QemuVirtualMachine::MountArgs& mount_args,
-                                         const std::optional<ResumeData>& resume_data)
-    : desc{desc}, platform_args{platform_args}, mount_args{mount_args}, resume_data{resume_data}
+                                         const std::optional<ResumeData>& resume_data, const Tuning& tuning)
+    : desc{desc}, platform_args{platform_args}, mount_args{mount_args}, resume_data{resume_data}, tuning{tuning}
 {
 }
 
@@ -43,7 +143,10 @@ QStringList mp::QemuVMProcessSpec::arguments() const
         args = resume_data->arguments;
 
         // need to append extra arguments for resume
-        args << "-loadvm" << resume_data->suspend_tag;
+        if (resume_data->incoming.isEmpty())
+            args << "-loadvm" << resume_data->suspend_tag;
+        else
+            args << "-incoming" << resume_data->incoming;
 
         QString machine_type = resume_data->machine_type;
         if (!machine_type.isEmpty())
@@ -65,30 +168,73 @@ QStringList mp::QemuVMProcessSpec::arguments() const
         auto mem_size = QString::number(desc.mem_size.in_megabytes()) + 'M'; /* flooring here; format documented in
     `man qemu-system`, under `-m` option; including suffix to avoid relying on default unit */
 
-        args << platform_args;
+        if (tuning.direct_boot)
+            args << without_firmware(platform_args) << "-kernel" << tuning.direct_boot->kernel << "-initrd"
+                 << tuning.direct_boot->initrd << "-append" << tuning.direct_boot->append;
+        else
+            args << platform_args;
         // The VM image itself
-        args << "-device"
-             << "virtio-scsi-pci,id=scsi0"
-             << "-drive" << QString("file=%1,if=none,format=qcow2,discard=unmap,id=hda").arg(desc.image.image_path)
-             << "-device"
-             << "scsi-hd,drive=hda,bus=scsi0.0";
-        // Number of cpu cores
-        args << "-smp" << QString::number(desc.num_cores);
-        // Memory to use for VM
-        args << "-m" << mem_size;
+        args << disk_arguments(tuning.disk_profile, desc.image.image_path, desc.num_cores, tuning.disk_iops);
+        // Number of cpu cores, and memory to use for VM
+        if constexpr (hotplug_supported())
+        {
+            args << "-smp" << QString("%1,maxcpus=%2").arg(desc.num_cores).arg(max_cpus(desc.num_cores));
+            args << "-m"
+                 << QString("%1,slots=%2,maxmem=%3M")
+                        .arg(mem_size)
+                        .arg(memory_slots)
+                        .arg(max_memory_in_megabytes(desc.mem_size));
+        }
+        else
+        {
+            args << "-smp" << QString::number(desc.num_cores);
+            args << "-m" << mem_size;
+        }
+        // Guest memory gets a backend of its own when it takes more than anonymous memory from anywhere on the host
+        const auto shared_memory = has_vhost_user_devices(mount_args);
+        if (shared_memory || tuning.hugepages || tuning.numa_node)
+            args << "-object" << memory_backend(mem_size, shared_memory, tuning) << "-numa"
+                 << "node,memdev=mem";
+        // Mergeable, as QEMU has it by default, for KSM to share what identical instances have identical in memory
+        args << "-machine"
+             << "mem-merge=on";
         // Control interface
         args << "-qmp"
              << "stdio";
-        // No console
+        // No console, its output is kept in a ring buffer for QMP to read on demand
         args << "-chardev"
-             // TODO Read and log machine output when verbose
-             << "null,id=char0"
+             << QString("ringbuf,id=%1,size=%2").arg(serial_ring_id).arg(serial_ring_size)
              << "-serial"
-             << "chardev:char0"
+             << QString("chardev:%1").arg(serial_ring_id)
              // TODO Add a debugging mode with access to console
              << "-nographic";
-        // Cloud-init disk
-        args << "-cdrom" << desc.cloud_init_iso;
+        // Cloud-init disk, unless the seed is served
+        if (tuning.nocloud_net_seed.isEmpty())
+            args << "-cdrom" << desc.cloud_init_iso;
+        else
+            args << tuning.nocloud_net_seed;
+        // Port the guest opens once booted, which QMP tells about
+        args << "-chardev"
+             << "null,id=char1"
+             << "-device"
+             << "virtio-serial"
+             << "-device"
+             << QString("virtserialport,chardev=char1,id=%1,name=%2").arg(readiness_port_id, readiness_port_name);
+        // Opt-in, as it takes QEMU 5.1: the guest hands the pages it frees back to the host as it goes, so that
+        // instances sitting idle don't keep memory they once touched
+        if (MP_SETTINGS.get(mp::qemu_page_reporting_key) == "true")
+            args << "-device"
+                 << "virtio-balloon-pci,id=balloon0,deflate-on-oom=on,free-page-reporting=on";
+        // For SSH, and the SFTP of mounts over it, to reach the guest without going through either network stack
+        if (tuning.vsock_cid)
+            args << "-device" << QString("vhost-vsock-pci,id=vsock0,guest-cid=%1").arg(*tuning.vsock_cid);
+        // Opt-in, as it takes qemu-guest-agent installed in the guest: info then asks it, rather than SSH, about load,
+        // memory, disks and addresses
+        if (MP_SETTINGS.get(mp::qemu_guest_agent_key) == "true")
+            args << "-chardev"
+                 << QString("socket,id=qga0,path=%1,server=on,wait=off").arg(guest_agent_socket_for(desc.vm_name))
+                 << "-device"
+                 << "virtserialport,chardev=qga0,name=org.qemu.guest_agent.0";
     }
 
     for (const auto& [_, mount_data] : mount_args)
@@ -97,9 +243,56 @@ QStringList mp::QemuVMProcessSpec::arguments() const
         args << mount_args;
     }
 
+    // Opt-in, as it keeps instances running when the daemon stops rather than suspending them: a second monitor that
+    // stays there for the next daemon to connect to, and the pid to find the process by
+    if (reattach_enabled())
+        args << reattach_arguments(desc.vm_name);
+
     return args;
 }
 
+std::uint32_t mp::QemuVMProcessSpec::vsock_cid_for(const std::string& vm_name)
+{
+    // 0 to 2 are reserved and 0xFFFFFFFF means any, what is left is plenty for names not to collide by accident
+    constexpr std::uint32_t first_cid = 3, last_cid = 0xFFFFFFFE;
+
+    const auto hash = QCryptographicHash::hash(QByteArray::fromStdString(vm_name), QCryptographicHash::Sha256);
+    std::uint32_t value{0};
+    for (auto i = 0; i < 4; ++i)
+        value = (value << 8) | static_cast<unsigned char>(hash[i]);
+
+    return first_cid + value % (last_cid - first_cid + 1);
+}
+
+QString mp::QemuVMProcessSpec::guest_agent_socket_for(const std::string& vm_name)
+{
+    // Kept short, socket paths cannot be longer than 107 bytes
+    return QDir::temp().filePath(QString{"multipass-qga-%1.sock"}.arg(mu::make_uuid(vm_name + ":qga").remove("-")));
+}
+
+bool mp::QemuVMProcessSpec::reattach_enabled()
+{
+    return MP_SETTINGS.get(mp::qemu_reattach_key) == "true";
+}
+
+QString mp::QemuVMProcessSpec::monitor_socket_for(const std::string& vm_name)
+{
+    return QDir{private_runtime_dir()}.filePath(
+        QString{"multipass-qmp-%1.sock"}.arg(mu::make_uuid(vm_name + ":qmp").remove("-")));
+}
+
+QString mp::QemuVMProcessSpec::pidfile_for(const std::string& vm_name)
+{
+    return QDir{private_runtime_dir()}.filePath(
+        QString{"multipass-qemu-%1.pid"}.arg(mu::make_uuid(vm_name + ":pid").remove("-")));
+}
+
+QStringList mp::QemuVMProcessSpec::reattach_arguments(const std::string& vm_name)
+{
+    return {"-qmp", QString("unix:%1,server=on,wait=off").arg(monitor_socket_for(vm_name)), "-pidfile",
+            pidfile_for(vm_name)};
+}
+
 QString mp::QemuVMProcessSpec::apparmor_profile() const
 {
     // Following profile is based on /etc/apparmor.d/abstractions/libvirt-qemu
@@ -130,6 +323,8 @@ profile %1 flags=(attach_disconnected) {
   signal (receive) peer=%2,
 
   /dev/net/tun rw,
+  /dev/vhost-net rw,
+  /dev/vhost-vsock rw,
   /dev/kvm rw,
   /dev/ptmx rw,
   /dev/kqemu rw,
@@ -156,6 +351,11 @@ profile %1 flags=(attach_disconnected) {
   # for restore
   /{usr/,}bin/bash rmix,
 
+  # for suspending to a file of its own, compressed when zstd is around
+  /{usr/,}bin/zstd rmix,
+  %4/usr/bin/zstd rmix,
+  %6.state rw,
+
   # for file-posix getting limits since 9103f1ce
   /sys/devices/**/block/*/queue/max_segments r,
 
@@ -175,9 +375,20 @@ profile %1 flags=(attach_disconnected) {
   # Disk images
   %6 rwk,  # QCow2 filesystem image
   %7 rk,   # cloud-init ISO
+  %10/*.qcow2 rk,  # snapshots, which the image is an overlay of
 
   # allow full access just to user-specified mount directories on the host
   %8
+
+  # vhost-user sockets of virtiofs mounts
+  %9/multipass-virtiofs-*.sock rw,
+
+  # guest agent socket
+  %9/multipass-qga-*.sock rw,
+
+  # monitor socket and pidfile, for a restarted daemon to reattach
+  %11/multipass-qmp-*.sock rw,
+  %11/multipass-qemu-*.pid rwk,
 }
     )END");
 
@@ -206,8 +417,10 @@ profile %1 flags=(attach_disconnected) {
         firmware = "/usr/share/{seabios,ovmf,qemu-efi}/*";
     }
 
-    return profile_template.arg(apparmor_profile_name(), signal_peer, firmware, root_dir, program(),
-                                desc.image.image_path, desc.cloud_init_iso, mount_dirs);
+    return profile_template
+        .arg(apparmor_profile_name(), signal_peer, firmware, root_dir, program(), desc.image.image_path,
+             desc.cloud_init_iso, mount_dirs, QDir::tempPath())
+        .arg(mp::backend::snapshots_dir(desc.image.image_path), private_runtime_dir());
 }
 
 QString mp::QemuVMProcessSpec::identifier() const
@@ -23,6 +23,7 @@
 
 #include <multipass/virtual_machine_description.h>
 
+#include <cstdint>
 #include <optional>
 #include <unordered_map>
 
@@ -38,13 +39,62 @@ public:
         QString machine_type;
         bool use_cdrom_flag; // to be removed, should be replaced by "arguments"
         QStringList arguments;
+        QString incoming; // where to read the state from, if it was saved outside of the image
     };
 
     static QString default_machine_type();
+    // Whether instances start with room to add vCPUs and memory to them while they run
+    static constexpr bool hotplug_supported()
+    {
+#if defined MULTIPASS_PLATFORM_LINUX && defined Q_PROCESSOR_X86
+        return true;
+#else
+        return false;
+#endif
+    }
+    static constexpr auto memory_slots = 8; // to hot-plug memory into, one DIMM each
+    static constexpr auto readiness_port_id = "multipass-ready"; // what QMP names the port in its events
+    static constexpr auto serial_ring_id = "char0";
+    static constexpr auto serial_ring_size = 64 * 1024; // a power of two, as QEMU wants it
+    static constexpr auto default_disk_profile = "default";
+    // How the image can be attached: through virtio-scsi as always by default, or tuned for throughput on virtio-blk
+    // or virtio-scsi
+    static QStringList disk_profiles();
+    // The vsock address an instance's guest is first offered, the same for the same name
+    static std::uint32_t vsock_cid_for(const std::string& vm_name);
+    // Where QEMU listens for the daemon to talk to the guest agent, when the instance was given a port for it
+    static QString guest_agent_socket_for(const std::string& vm_name);
+    // Whether instances are left running when the daemon goes away, for the next one to take them back through the
+    // monitor socket and the pidfile QEMU keeps, both in the daemon's runtime directory
+    static bool reattach_enabled();
+    static QString monitor_socket_for(const std::string& vm_name);
+    static QString pidfile_for(const std::string& vm_name);
+    // What QEMU is started with for that, last on its command line
+    static QStringList reattach_arguments(const std::string& vm_name);
+
+    // What the instance was set to, beyond its description
+    struct Tuning
+    {
+        // A copy of the guest's kernel, initrd and command line, to boot without firmware and bootloader
+        struct DirectBoot
+        {
+            QString kernel;
+            QString initrd;
+            QString append;
+        };
+
+        QString disk_profile{default_disk_profile};
+        bool hugepages{false};
+        std::optional<int> numa_node{}; // to bind guest memory to
+        std::optional<DirectBoot> direct_boot{};
+        int disk_iops{0}; // 0 for no limit
+        QStringList nocloud_net_seed{}; // what points cloud-init at its seed, in place of the ISO
+        std::optional<std::uint32_t> vsock_cid{}; // the guest's address, for it to be given a vsock device
+    };
 
     explicit QemuVMProcessSpec(const VirtualMachineDescription& desc, const QStringList& platform_args,
                                const QemuVirtualMachine::MountArgs& mount_args,
-                               const std::optional<ResumeData>& resume_data);
+                               const std::optional<ResumeData>& resume_data, const Tuning& tuning);
 
     QStringList arguments() const override;
 
@@ -56,6 +106,7 @@ private:
     const QStringList platform_args;
     const QemuVirtualMachine::MountArgs mount_args;
     const std::optional<ResumeData> resume_data;
+    const Tuning tuning;
 };
 
 } // namespace multipass
@@ -0,0 +1,112 @@
+/*
+ * Copyright (C) Canonical, Ltd.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; version 3.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#include "qmp_client.h"
+
+#include <multipass/format.h>
+#include <multipass/logging/log.h>
+
+#include <QJsonDocument>
+
+namespace mp = multipass;
+namespace mpl = multipass::logging;
+
+mp::QmpClient::QmpClient(const std::string& log_category, Writer writer)
+    : log_category{log_category}, writer{std::move(writer)}
+{
+}
+
+void mp::QmpClient::feed(const QByteArray& data)
+{
+    buffer.append(data);
+
+    // Messages can be split across reads, or several can arrive in one
+    int newline;
+    while ((newline = buffer.indexOf('\n')) >= 0)
+    {
+        const auto line = buffer.left(newline).trimmed();
+        buffer.remove(0, newline + 1);
+
+        if (!line.isEmpty())
+            handle_message(line);
+    }
+}
+
+void mp::QmpClient::execute(const QString& command, const QJsonObject& arguments, Callback callback)
+{
+    const auto id = next_id++;
+
+    QJsonObject qmp{{"execute", command}, {"id", id}};
+    if (!arguments.isEmpty())
+        qmp.insert("arguments", arguments);
+
+    pending.emplace(id, Pending{command, std::move(callback)});
+
+    writer(QJsonDocument{qmp}.toJson(QJsonDocument::Compact) + '\n');
+}
+
+void mp::QmpClient::human_monitor_command(const QString& command_line, Callback callback)
+{
+    execute("human-monitor-command", QJsonObject{{"command-line", command_line}}, std::move(callback));
+}
+
+std::size_t mp::QmpClient::pending_commands() const
+{
+    return pending.size();
+}
+
+void mp::QmpClient::handle_message(const QByteArray& line)
+{
+    // Formatting every message is not free, and there is one per event
+    if (mpl::get_logging_level() >= mpl::Level::debug)
+        mpl::log(mpl::Level::debug, log_category, fmt::format("QMP: {}", line));
+
+    QJsonParseError parse_error;
+    const auto message = QJsonDocument::fromJson(line, &parse_error).object();
+    if (parse_error.error != QJsonParseError::NoError)
+    {
+        mpl::log(mpl::Level::warning, log_category,
+                 fmt::format("Could not parse QMP message: {}", parse_error.errorString()));
+        return;
+    }
+
+    if (const auto name = message["event"]; name.isString())
+    {
+        emit event(name.toString(), message["data"].toObject());
+        return;
+    }
+
+    if (!message.contains("return") && !message.contains("error"))
+        return; // the greeting, or anything else that doesn't answer a command
+
+    const auto it = pending.find(message["id"].toInt(-1));
+    if (it == pending.end())
+    {
+        mpl::log(mpl::Level::debug, log_category, "Ignoring a QMP reply to no pending command");
+        return;
+    }
+
+    // Out of the map first, so the callback can send commands of its own
+    const auto [command, callback] = std::move(it->second);
+    pending.erase(it);
+
+    const auto error = message["error"].toObject()["desc"].toString();
+    if (callback)
+        callback(message["return"], error);
+    else if (message.contains("error"))
+        mpl::log(mpl::Level::warning, log_category, fmt::format("QMP command {} failed: {}", command, error));
+}
@@ -0,0 +1,72 @@
+/*
+ * Copyright (C) Canonical, Ltd.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; version 3.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#ifndef MULTIPASS_QMP_CLIENT_H
+#define MULTIPASS_QMP_CLIENT_H
+
+#include <QByteArray>
+#include <QJsonObject>
+#include <QJsonValue>
+#include <QObject>
+#include <QString>
+
+#include <functional>
+#include <map>
+#include <string>
+
+namespace multipass
+{
+// Speaks the QEMU Machine Protocol over whatever carries it: bytes QEMU writes are fed in as they come and split into
+// the JSON messages they frame, one per line. Replies are matched to the command they answer through its "id".
+class QmpClient : public QObject
+{
+    Q_OBJECT
+public:
+    using Writer = std::function<void(const QByteArray&)>;
+    // error is QEMU's description of why the command failed, empty when it succeeded with result
+    using Callback = std::function<void(const QJsonValue& result, const QString& error)>;
+
+    QmpClient(const std::string& log_category, Writer writer);
+
+    void feed(const QByteArray& data);
+
+    // Callbacks still pending when the client is destroyed are dropped, without being called
+    void execute(const QString& command, const QJsonObject& arguments = {}, Callback callback = {});
+    void human_monitor_command(const QString& command_line, Callback callback = {});
+
+    std::size_t pending_commands() const;
+
+signals:
+    void event(const QString& name, const QJsonObject& data);
+
+private:
+    struct Pending
+    {
+        QString command;
+        Callback callback; // failures of commands without one are logged
+    };
+
+    void handle_message(const QByteArray& line);
+
+    const std::string log_category;
+    const Writer writer;
+    QByteArray buffer;
+    int next_id{0};
+    std::map<int, Pending> pending;
+};
+} // namespace multipass
+#endif // MULTIPASS_QMP_CLIENT_H
@@ -0,0 +1,187 @@
+/*
+ * Copyright (C) Canonical, Ltd.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; version 3.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#include "virtiofs_mount_handler.h"
+#include "linux/virtiofsd_process_spec.h"
+
+#include <multipass/platform.h>
+#include <multipass/utils.h>
+
+#include <QDir>
+#include <QFile>
+
+#include <algorithm>
+#include <thread>
+
+namespace mpl = multipass::logging;
+namespace mpu = multipass::utils;
+
+using namespace std::chrono_literals;
+
+namespace
+{
+constexpr auto category = "virtiofs-mount-handler";
+constexpr auto socket_timeout = 5s;
+
+bool is_identity(const multipass::id_mappings& mappings)
+{
+    return std::all_of(mappings.cbegin(), mappings.cend(),
+                       [](const auto& mapping) { return mapping.first == mapping.second || mapping.second == -1; });
+}
+} // namespace
+
+namespace multipass
+{
+VirtiofsMountHandler::VirtiofsMountHandler(QemuVirtualMachine* vm, const SSHKeyProvider* ssh_key_provider,
+                                           const std::string& target, const VMMount& mount)
+    : MountHandler{vm, ssh_key_provider, target, mount.source_path},
+      vm_mount_args{vm->modifiable_mount_args()},
+      vm_mount_hooks{vm->modifiable_mount_hooks()},
+      // Same scheme as 9p mount tags, so that either kind of native mount finds what the other left behind
+      tag{mp::utils::make_uuid(target).remove("-").left(30).prepend('m').toStdString()},
+      // Kept short, socket paths cannot be longer than 107 bytes
+      socket_path{QDir::temp().filePath(
+          QString{"multipass-virtiofs-%1.sock"}.arg(mp::utils::make_uuid(vm->vm_name + ':' + target).remove("-")))}
+{
+    auto state = vm->current_state();
+    if (state == VirtualMachine::State::suspended && vm_mount_args.find(tag) != vm_mount_args.end())
+    {
+        mpl::log(mpl::Level::info, category,
+                 fmt::format("Found native mount {} => {} in '{}' while suspended", source, target, vm->vm_name));
+        vm_mount_hooks[tag] = [this] { start_virtiofsd(); };
+        return;
+    }
+
+    if (state != VirtualMachine::State::off && state != VirtualMachine::State::stopped)
+    {
+        throw mp::NativeMountNeedsStoppedVMException(vm->vm_name);
+    }
+
+    // virtiofsd hands out host IDs as they are
+    if (!is_identity(mount.uid_mappings) || !is_identity(mount.gid_mappings))
+        mpl::log(mpl::Level::warning, category,
+                 fmt::format("ID mappings are not applied to virtiofs mount {} => {} in '{}'", source, target,
+                             vm->vm_name));
+
+    mpl::log(mpl::Level::info, category,
+             fmt::format("initializing virtiofs mount {} => {} in '{}'", source, target, vm->vm_name));
+
+    const auto qtag = QString::fromStdString(tag);
+    vm_mount_args[tag] = {source,
+                          {"-chardev", QString{"socket,id=%1,path=%2"}.arg(qtag, socket_path), "-device",
+                           QString{"vhost-user-fs-pci,chardev=%1,tag=%1"}.arg(qtag)}};
+    vm_mount_hooks[tag] = [this] { start_virtiofsd(); };
+}
+
+bool VirtiofsMountHandler::is_active()
+try
+{
+    return active && !SSHSession{vm->ssh_hostname(), vm->ssh_port(), vm->ssh_username(), *ssh_key_provider}
+                          .exec(fmt::format("findmnt --type virtiofs | grep '{} {}'", target, tag))
+                          .exit_code();
+}
+catch (const std::exception& e)
+{
+    mpl::log(mpl::Level::warning, category,
+             fmt::format("Failed checking virtiofs mount \"{}\" in instance '{}': {}", target, vm->vm_name, e.what()));
+    return false;
+}
+
+void VirtiofsMountHandler::activate_impl(ServerVariant, std::chrono::milliseconds)
+{
+    SSHSession session{vm->ssh_hostname(), vm->ssh_port(), vm->ssh_username(), *ssh_key_provider};
+
+    // Split the path in existing and missing parts
+    // We need to create the part of the path which does not still exist, and set then the correct ownership.
+    if (const auto& [leading, missing] = mpu::get_path_split(session, target); missing != ".")
+    {
+        const auto default_uid = std::stoi(mpu::run_in_ssh_session(session, "id -u"));
+        const auto default_gid = std::stoi(mpu::run_in_ssh_session(session, "id -g"));
+
+        mpu::make_target_dir(session, leading, missing);
+        mpu::set_owner_for(session, leading, missing, default_uid, default_gid);
+    }
+
+    mpu::run_in_ssh_session(session, fmt::format("sudo mount -t virtiofs {} {}", tag, target));
+}
+
+void VirtiofsMountHandler::deactivate_impl(bool force)
+try
+{
+    mpl::log(mpl::Level::info, category,
+             fmt::format("Stopping virtiofs mount \"{}\" in instance '{}'", target, vm->vm_name));
+    SSHSession session{vm->ssh_hostname(), vm->ssh_port(), vm->ssh_username(), *ssh_key_provider};
+    mpu::run_in_ssh_session(session, fmt::format("if mountpoint -q {0}; then sudo umount {0}; else true; fi", target));
+}
+catch (const std::exception& e)
+{
+    if (!force)
+        throw;
+    mpl::log(mpl::Level::warning, category,
+             fmt::format("Failed to gracefully stop mount \"{}\" in instance '{}': {}", target, vm->vm_name, e.what()));
+}
+
+void VirtiofsMountHandler::start_virtiofsd()
+{
+    // It quits along with QEMU, so each start needs a new one
+    if (virtiofsd && virtiofsd->running())
+        return;
+
+    QFile::remove(socket_path);
+
+    virtiofsd = mp::platform::make_process(
+        std::make_unique<VirtiofsdProcessSpec>(QString::fromStdString(source), socket_path));
+    virtiofsd->start();
+
+    if (!virtiofsd->wait_for_started())
+        throw std::runtime_error(
+            fmt::format("failed to start virtiofsd for \"{}\": {}", source, virtiofsd->error_string()));
+
+    // QEMU gives up on the device if nobody is listening yet
+    for (const auto deadline = std::chrono::steady_clock::now() + socket_timeout; !QFile::exists(socket_path);)
+    {
+        if (!virtiofsd->running() || std::chrono::steady_clock::now() > deadline)
+            throw std::runtime_error(fmt::format("virtiofsd for \"{}\" did not come up: {}", source,
+                                                 virtiofsd->read_all_standard_error()));
+
+        std::this_thread::sleep_for(10ms);
+    }
+
+    mpl::log(mpl::Level::debug, category, fmt::format("virtiofsd serving \"{}\" on {}", source, socket_path));
+}
+
+void VirtiofsMountHandler::stop_virtiofsd()
+{
+    if (virtiofsd && virtiofsd->running())
+    {
+        virtiofsd->terminate();
+        if (!virtiofsd->wait_for_finished())
+            virtiofsd->kill();
+    }
+
+    virtiofsd.reset();
+    QFile::remove(socket_path);
+}
+
+VirtiofsMountHandler::~VirtiofsMountHandler()
+{
+    deactivate(/*force=*/true);
+    stop_virtiofsd();
+    vm_mount_hooks.erase(tag);
+    vm_mount_args.erase(tag);
+}
+} // namespace multipass
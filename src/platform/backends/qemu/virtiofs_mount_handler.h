@@ -0,0 +1,54 @@
+/*
+ * Copyright (C) Canonical, Ltd.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; version 3.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#ifndef MULTIPASS_VIRTIOFS_MOUNT_HANDLER_H
+#define MULTIPASS_VIRTIOFS_MOUNT_HANDLER_H
+
+#include "qemu_virtual_machine.h"
+
+#include <multipass/mount_handler.h>
+#include <multipass/process/process.h>
+
+#include <memory>
+
+namespace multipass
+{
+// Native mount served by virtiofsd on the host, which QEMU hands guest requests to over a vhost-user socket
+class VirtiofsMountHandler : public MountHandler
+{
+public:
+    VirtiofsMountHandler(QemuVirtualMachine* vm, const SSHKeyProvider* ssh_key_provider, const std::string& target,
+                         const VMMount& mount);
+    ~VirtiofsMountHandler() override;
+
+    void activate_impl(ServerVariant server, std::chrono::milliseconds timeout) override;
+    void deactivate_impl(bool force) override;
+    bool is_active() override;
+
+private:
+    void start_virtiofsd();
+    void stop_virtiofsd();
+
+    QemuVirtualMachine::MountArgs& vm_mount_args;
+    QemuVirtualMachine::MountHooks& vm_mount_hooks;
+    std::string tag;
+    QString socket_path;
+    std::unique_ptr<Process> virtiofsd;
+};
+
+} // namespace multipass
+#endif // MULTIPASS_VIRTIOFS_MOUNT_HANDLER_H
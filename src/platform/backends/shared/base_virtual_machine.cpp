@@ -23,36 +23,48 @@
 namespace mp = multipass;
 namespace mpl = multipass::logging;
 
+using namespace std::chrono_literals;
+
+namespace
+{
+// Our own transitions land in state as they happen, this only bounds how late outside ones show up
+constexpr auto state_freshness = 2s;
+} // namespace
+
 namespace multipass
 {
 
+VirtualMachine::State BaseVirtualMachine::cached_state()
+{
+    if (state_is_fresh())
+        return state;
+
+    return current_state();
+}
+
+void BaseVirtualMachine::state_fetched()
+{
+    state_fetched_at = std::chrono::steady_clock::now();
+}
+
+bool BaseVirtualMachine::state_is_fresh() const
+{
+    return std::chrono::steady_clock::now() - state_fetched_at.load() < state_freshness;
+}
+
 std::vector<std::string> BaseVirtualMachine::get_all_ipv4(const SSHKeyProvider& key_provider)
 {
     std::vector<std::string> all_ipv4;
 
     if (current_state() == State::running)
     {
-        QString ip_a_output;
+        if (auto guest_ipv4 = this->guest_ipv4())
+            return *guest_ipv4;
 
         try
         {
             SSHSession session{ssh_hostname(), ssh_port(), ssh_username(), key_provider};
-
-            ip_a_output = QString::fromStdString(
-                mpu::run_in_ssh_session(session, "ip -brief -family inet address show scope global"));
-
-            QRegularExpression ipv4_re{QStringLiteral("([\\d\\.]+)\\/\\d+\\s*(metric \\d+)?\\s*$"),
-                                       QRegularExpression::MultilineOption};
-
-            QRegularExpressionMatchIterator ip_it = ipv4_re.globalMatch(ip_a_output);
-
-            while (ip_it.hasNext())
-            {
-                auto ip_match = ip_it.next();
-                auto ip = ip_match.captured(1).toStdString();
-
-                all_ipv4.push_back(ip);
-            }
+            all_ipv4 = get_all_ipv4(session);
         }
         catch (const SSHException& e)
         {
@@ -63,4 +75,9 @@ std::vector<std::string> BaseVirtualMachine::get_all_ipv4(const SSHKeyProvider&
     return all_ipv4;
 }
 
+std::vector<std::string> BaseVirtualMachine::get_all_ipv4(SSHSession& session)
+{
+    return current_state() == State::running ? mpu::ipv4_addresses_in(session) : std::vector<std::string>{};
+}
+
 } // namespace multipass
@@ -29,6 +29,9 @@
 #include <QRegularExpression>
 #include <QString>
 
+#include <atomic>
+#include <chrono>
+
 namespace mp = multipass;
 namespace mpl = multipass::logging;
 namespace mpu = multipass::utils;
@@ -41,13 +44,23 @@ public:
     BaseVirtualMachine(VirtualMachine::State state, const std::string& vm_name) : VirtualMachine(state, vm_name){};
     BaseVirtualMachine(const std::string& vm_name) : VirtualMachine(vm_name){};
 
+    State cached_state() override;
     std::vector<std::string> get_all_ipv4(const SSHKeyProvider& key_provider) override;
+    std::vector<std::string> get_all_ipv4(SSHSession& session) override;
     std::unique_ptr<MountHandler> make_native_mount_handler(const SSHKeyProvider* ssh_key_provider,
                                                             const std::string& target,
                                                             const multipass::VMMount& mount) override
     {
         throw NotImplementedOnThisBackendException("native mounts");
     };
+
+protected:
+    // For backends whose current_state() asks the hypervisor, to mark state as freshly fetched
+    void state_fetched();
+    bool state_is_fresh() const; // enough for cached_state() to answer with it
+
+private:
+    std::atomic<std::chrono::steady_clock::time_point> state_fetched_at{};
 };
 } // namespace multipass
 
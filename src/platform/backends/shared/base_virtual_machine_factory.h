@@ -52,10 +52,10 @@ public:
 
     VMImageVault::UPtr create_image_vault(std::vector<VMImageHost*> image_hosts, URLDownloader* downloader,
                                           const Path& cache_dir_path, const Path& data_dir_path,
-                                          const days& days_to_expire) override
+                                          const days& days_to_expire, const vault::BlobStore& blobs) override
     {
         return std::make_unique<DefaultVMImageVault>(image_hosts, downloader, cache_dir_path, data_dir_path,
-                                                     days_to_expire);
+                                                     days_to_expire, blobs);
     };
 
     void configure(VirtualMachineDescription& vm_desc) override;
@@ -65,6 +65,10 @@ public:
         throw NotImplementedOnThisBackendException("networks");
     };
 
+    void refresh_states(const std::vector<VirtualMachine*>& /*vms*/) override
+    {
+    }
+
 protected:
     std::string create_bridge_with(const NetworkInterfaceInfo& interface) override
     {
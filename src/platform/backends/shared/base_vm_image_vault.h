@@ -20,11 +20,18 @@
 
 #include <multipass/format.h>
 #include <multipass/query.h>
+#include <multipass/rpc/multipass.grpc.pb.h>
 #include <multipass/vm_image.h>
 #include <multipass/vm_image_host.h>
 #include <multipass/vm_image_vault.h>
 
+#include <exception>
+#include <functional>
+#include <future>
+#include <mutex>
+#include <optional>
 #include <string>
+#include <unordered_map>
 #include <utility>
 #include <vector>
 
@@ -66,6 +73,79 @@ public:
     };
 
 protected:
+    // While an image is being fetched, whoever else is after the same id waits for that fetch instead of starting one
+    class InFlightFetches
+    {
+    public:
+        // The fetch of id in progress or, if there is none, nothing: the caller is then the one to fetch it, and to
+        // report how that went with done() or failed()
+        std::optional<std::shared_future<VMImage>> join(const std::string& id)
+        {
+            std::lock_guard<decltype(mutex)> lock{mutex};
+            if (auto it = fetches.find(id); it != fetches.end())
+                return it->second.future;
+
+            auto& fetch = fetches[id];
+            fetch.future = fetch.promise.get_future().share();
+            return std::nullopt;
+        }
+
+        void done(const std::string& id, const VMImage& image)
+        {
+            finish(id, [&image](auto& promise) { promise.set_value(image); });
+        }
+
+        void failed(const std::string& id, std::exception_ptr error)
+        {
+            finish(id, [&error](auto& promise) { promise.set_exception(error); });
+        }
+
+    private:
+        struct Fetch
+        {
+            std::promise<VMImage> promise;
+            std::shared_future<VMImage> future;
+        };
+
+        template <typename Fulfill>
+        void finish(const std::string& id, Fulfill&& fulfill)
+        {
+            std::lock_guard<decltype(mutex)> lock{mutex};
+            if (auto it = fetches.find(id); it != fetches.end())
+            {
+                fulfill(it->second.promise);
+                fetches.erase(it);
+            }
+        }
+
+        std::mutex mutex;
+        std::unordered_map<std::string, Fetch> fetches;
+    };
+
+    // Runs fetch for id, unless someone else is already at it, in which case its outcome is shared
+    VMImage fetch_once(const std::string& id, const ProgressMonitor& monitor, const std::function<VMImage()>& fetch)
+    {
+        if (auto running_fetch = in_flight_fetches.join(id); running_fetch)
+        {
+            monitor(LaunchProgress::WAITING, -1);
+            return running_fetch->get();
+        }
+
+        try
+        {
+            auto image = fetch();
+            in_flight_fetches.done(id, image);
+            return image;
+        }
+        catch (...)
+        {
+            in_flight_fetches.failed(id, std::current_exception());
+            throw;
+        }
+    }
+
+    InFlightFetches in_flight_fetches;
+
     virtual std::optional<VMImageInfo> info_for(const Query& query) const
     {
         std::optional<VMImageInfo> info;
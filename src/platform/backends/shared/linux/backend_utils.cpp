@@ -64,6 +64,10 @@ const auto nm_settings_obj = QStringLiteral("/org/freedesktop/NetworkManager/Set
 const auto nm_settings_ifc = QStringLiteral("org.freedesktop.NetworkManager.Settings");
 const auto nm_connection_ifc = QStringLiteral("org.freedesktop.NetworkManager.Settings.Connection");
 constexpr auto max_bridge_name_len = 15; // maximum number of characters in a bridge name
+const auto systemd_bus_name = QStringLiteral("org.freedesktop.systemd1");
+const auto systemd_root_obj = QStringLiteral("/org/freedesktop/systemd1");
+const auto systemd_manager_ifc = QStringLiteral("org.freedesktop.systemd1.Manager");
+const auto dbus_properties_ifc = QStringLiteral("org.freedesktop.DBus.Properties");
 
 bool subnet_used_locally(const std::string& subnet)
 {
@@ -121,18 +125,24 @@ std::unique_ptr<mpdbus::DBusInterface> get_checked_interface(const mpdbus::DBusC
     return ret;
 }
 
-template <typename T, bool RollingBack = false, typename... Ts>
-T checked_dbus_call(mpdbus::DBusInterface& interface, const QString& method_name, Ts&&... params)
+template <bool RollingBack = false>
+mp::backend::CreateBridgeException dbus_call_failure(mpdbus::DBusInterface& interface, const QString& method_name,
+                                                     const QDBusError& error)
 {
     static constexpr auto error_template = "Failed DBus call. (Service: {}; Object: {}; Interface: {}; Method: {})";
+    return mp::backend::CreateBridgeException{
+        fmt::format(error_template, interface.service(), interface.path(), interface.interface(), method_name), error,
+        RollingBack};
+}
 
+template <typename T, bool RollingBack = false, typename... Ts>
+T checked_dbus_call(mpdbus::DBusInterface& interface, const QString& method_name, Ts&&... params)
+{
     auto reply_msg = interface.call(QDBus::Block, method_name, QVariant::fromValue(std::forward<Ts>(params))...);
     QDBusReply<T> reply = reply_msg;
 
     if (!reply.isValid())
-        throw mp::backend::CreateBridgeException{
-            fmt::format(error_template, interface.service(), interface.path(), interface.interface(), method_name),
-            reply.error(), RollingBack};
+        throw dbus_call_failure<RollingBack>(interface, method_name, reply.error());
 
     if constexpr (!std::is_void_v<T>)
         return reply.value();
@@ -229,8 +239,19 @@ std::string mp::Backend::create_bridge_with(const std::string& interface)
     //   `nmcli connection add type bridge ifname <br> connection.autoconnect-slaves 1`
     //   `nmcli connection add type bridge-slave ifname <if> master <br> connection.autoconnect-priority 10`
     //   `nmcli connection up <child_connection>`
-    parent_path = checked_dbus_call<QDBusObjectPath>(*nm_settings, "AddConnection", arg1);
-    child_path = checked_dbus_call<QDBusObjectPath>(*nm_settings, "AddConnection", arg2);
+    // The child names its master rather than pointing to it, so both can be added at once
+    const auto parent_call = nm_settings->async_call("AddConnection", QVariant::fromValue(arg1));
+    const auto child_call = nm_settings->async_call("AddConnection", QVariant::fromValue(arg2));
+    const QDBusReply<QDBusObjectPath> parent_reply = parent_call, child_reply = child_call; // waiting for both
+
+    // Whichever was added is rolled back if the other was not
+    for (auto [reply, path] : {std::pair{&parent_reply, &parent_path}, std::pair{&child_reply, &child_path}})
+        if (reply->isValid())
+            *path = reply->value();
+    for (const auto* reply : {&parent_reply, &child_reply})
+        if (!reply->isValid())
+            throw dbus_call_failure(*nm_settings, "AddConnection", reply->error());
+
     checked_dbus_call<QDBusObjectPath>(*nm_root, "ActivateConnection", child_path, root_path, root_path); /* Inspiration
     for '/' to signal null `device` and `specific-object` derived from nmcli and libnm. See https://bit.ly/3dMA3QB */
 
@@ -293,6 +314,32 @@ void mp::Backend::check_if_kvm_is_in_use()
     MP_LINUX_SYSCALLS.close(ret);
 }
 
+bool mp::Backend::service_spares_children()
+{
+    const auto& system_bus = mpdbus::DBusProvider::instance().get_system_bus();
+    if (!system_bus.is_connected())
+        return false;
+
+    auto manager = system_bus.get_interface(systemd_bus_name, systemd_root_obj, systemd_manager_ifc);
+    const QDBusReply<QDBusObjectPath> unit =
+        manager->call(QDBus::Block, "GetUnitByPID", QVariant::fromValue(static_cast<uint>(getpid())));
+    if (!unit.isValid())
+        return false;
+
+    auto properties = system_bus.get_interface(systemd_bus_name, unit.value().path(), dbus_properties_ifc);
+    auto get = [&properties](const QString& interface, const QString& property) {
+        const QDBusReply<QDBusVariant> reply = properties->call(QDBus::Block, "Get", interface, property);
+        return reply.isValid() ? reply.value().variant().toString() : QString{};
+    };
+
+    // Run by hand, in a scope of the session's that outlives the daemon
+    if (const auto id = get("org.freedesktop.systemd1.Unit", "Id"); id.isEmpty() || !id.endsWith(".service"))
+        return !id.isEmpty();
+
+    const auto kill_mode = get("org.freedesktop.systemd1.Service", "KillMode");
+    return kill_mode == "process" || kill_mode == "none";
+}
+
 mp::backend::CreateBridgeException::CreateBridgeException(const std::string& detail, const QDBusError& dbus_error,
                                                           bool rollback)
     : std::runtime_error(fmt::format("{}. {}: {}", rollback ? "Could not rollback bridge" : "Could not create bridge",
@@ -314,3 +361,19 @@ int mp::LinuxSysCalls::open(const char* path, mode_t mode) const
 {
     return ::open(path, mode);
 }
+
+int mp::LinuxSysCalls::socket(int domain, int type, int protocol) const
+{
+    return ::socket(domain, type, protocol);
+}
+
+int mp::LinuxSysCalls::setsockopt(int fd, int level, int name, const void* value, socklen_t size) const
+{
+    return ::setsockopt(fd, level, name, value, size);
+}
+
+ssize_t mp::LinuxSysCalls::sendto(int fd, const void* data, size_t size, int flags, const sockaddr* destination,
+                                  socklen_t destination_size) const
+{
+    return ::sendto(fd, data, size, flags, destination, destination_size);
+}
@@ -25,6 +25,8 @@
 #include <stdexcept>
 #include <string>
 
+#include <sys/socket.h>
+
 #define MP_BACKEND multipass::Backend::instance()
 #define MP_LINUX_SYSCALLS multipass::LinuxSysCalls::instance()
 
@@ -57,6 +59,10 @@ public:
     // For detecting KVM
     virtual void check_for_kvm_support();
     virtual void check_if_kvm_is_in_use();
+
+    // Whether the processes the daemon started are left alone when its service is stopped, as systemd does with
+    // KillMode=process, rather than killed along with it; false when it cannot tell
+    virtual bool service_spares_children();
 };
 
 class LinuxSysCalls : public Singleton<LinuxSysCalls>
@@ -67,6 +73,10 @@ public:
     virtual int close(int fd) const;
     virtual int ioctl(int fd, unsigned long request, unsigned long parameter) const;
     virtual int open(const char* path, mode_t mode) const;
+    virtual int socket(int domain, int type, int protocol) const;
+    virtual int setsockopt(int fd, int level, int name, const void* value, socklen_t size) const;
+    virtual ssize_t sendto(int fd, const void* data, size_t size, int flags, const sockaddr* destination,
+                           socklen_t destination_size) const;
 };
 } // namespace multipass
 #endif // MULTIPASS_BACKEND_UTILS_H
@@ -0,0 +1,251 @@
+/*
+ * Copyright (C) Canonical, Ltd.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; version 3.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#include "cgroups.h"
+
+#include <multipass/format.h>
+#include <multipass/logging/log.h>
+
+#include <QDir>
+#include <QFile>
+#include <QRegularExpression>
+
+#include <cerrno>
+#include <cstring>
+#include <stdexcept>
+
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace mp = multipass;
+namespace mpl = multipass::logging;
+
+namespace
+{
+constexpr auto category = "cgroups";
+constexpr auto daemon_dir = "multipassd", instances_dir = "instances";
+constexpr auto daemon_weight = 1000;             // against the default of 100 that instances get
+constexpr auto daemon_memory_low = 256LL << 20; // kept from being reclaimed while instances press on memory
+
+QString read_file(const QString& path)
+{
+    QFile f{path};
+    return f.open(QFile::ReadOnly) ? QString::fromLatin1(f.readAll()) : QString{};
+}
+
+void write_file(const QString& path, const std::string& value)
+{
+    const auto fd = ::open(QFile::encodeName(path).constData(), O_WRONLY | O_CLOEXEC);
+    const auto written = fd < 0 ? -1 : ::write(fd, value.data(), value.size());
+    const auto error = errno;
+    if (fd >= 0)
+        ::close(fd);
+
+    if (written != static_cast<ssize_t>(value.size()))
+        throw std::runtime_error{fmt::format("Could not write \"{}\" to {}: {}", value, path, std::strerror(error))};
+}
+
+// Interface files only show for the controllers that the parent hands down
+void write_control(const QString& dir, const char* file, const std::string& value)
+{
+    if (const auto path = QDir{dir}.filePath(file); QFile::exists(path))
+        write_file(path, value);
+}
+
+void make_dir(const QString& path)
+{
+    if (::mkdir(QFile::encodeName(path).constData(), 0755) < 0 && errno != EEXIST)
+        throw std::runtime_error{fmt::format("Could not create {}: {}", path, std::strerror(errno))};
+}
+
+// Where this process is in the unified hierarchy, as in "0::/system.slice/snap.multipass.multipassd.service"
+QString own_cgroup(const QString& cgroup_fs, const QString& own_cgroup_path)
+{
+    for (const auto& line : read_file(own_cgroup_path).split('\n'))
+        if (line.startsWith("0::"))
+            return QDir::cleanPath(cgroup_fs + line.mid(3).trimmed());
+
+    return {};
+}
+
+// The controllers worth handing down, of those the cgroup has, as in "+cpu +memory +io"
+std::string enabled_controllers(const QString& cgroup)
+{
+    const auto available = read_file(QDir{cgroup}.filePath("cgroup.controllers")).trimmed().split(' ');
+
+    QStringList enabled;
+    for (const auto* controller : {"cpu", "memory", "io"})
+        if (available.contains(controller))
+            enabled << QString{"+%1"}.arg(controller);
+
+    return enabled.join(' ').toStdString();
+}
+
+std::string weight(int value)
+{
+    return std::to_string(value ? value : 100);
+}
+
+std::string memory_limit(const std::optional<long long>& bytes)
+{
+    return bytes ? std::to_string(*bytes) : "max";
+}
+
+QString set_up_daemon_cgroup(const QString& cgroup_fs, const QString& own_cgroup_path)
+{
+    if (!QFile::exists(QDir{cgroup_fs}.filePath("cgroup.controllers")))
+    {
+        mpl::log(mpl::Level::debug, category, "No cgroup v2 hierarchy, instances stay in the daemon's cgroup");
+        return {};
+    }
+
+    const auto root = own_cgroup(cgroup_fs, own_cgroup_path);
+    try
+    {
+        if (root.isEmpty() || root == QDir::cleanPath(cgroup_fs))
+            throw std::runtime_error{"the daemon is not in a cgroup of its own"};
+
+        const auto controllers = enabled_controllers(root);
+        if (controllers.empty())
+            throw std::runtime_error{fmt::format("no controllers were delegated to {}", root)};
+
+        // Only cgroups without processes of their own can hand controllers down, so the daemon and whatever it shares
+        // its cgroup with go to a leaf
+        const auto daemon = QDir{root}.filePath(daemon_dir);
+        make_dir(daemon);
+        for (const auto& pid : read_file(QDir{root}.filePath("cgroup.procs")).split('\n', QString::SkipEmptyParts))
+        {
+            try
+            {
+                write_file(QDir{daemon}.filePath("cgroup.procs"), pid.toStdString());
+            }
+            catch (const std::runtime_error&)
+            {
+                // gone by now, otherwise handing controllers down fails below
+            }
+        }
+
+        const auto instances = QDir{root}.filePath(instances_dir);
+        write_file(QDir{root}.filePath("cgroup.subtree_control"), controllers);
+        make_dir(instances);
+        write_file(QDir{instances}.filePath("cgroup.subtree_control"), controllers);
+
+        write_control(daemon, "cpu.weight", weight(daemon_weight));
+        write_control(daemon, "io.weight", "default " + weight(daemon_weight));
+        write_control(daemon, "memory.low", std::to_string(daemon_memory_low));
+    }
+    catch (const std::runtime_error& e)
+    {
+        mpl::log(mpl::Level::warning, category, fmt::format("Instances stay in the daemon's cgroup: {}", e.what()));
+        return {};
+    }
+
+    mpl::log(mpl::Level::info, category, fmt::format("Placing instances in cgroups under {}", root));
+    return root;
+}
+
+// As in "some avg10=0.00 avg60=0.00 avg300=0.00 total=12345", and a line for "full" on kernels that count it
+std::optional<mp::Cgroups::Stall> read_stall(const QString& path)
+{
+    static const QRegularExpression line_regex{R"(^(some|full) .*total=([0-9]+)$)",
+                                               QRegularExpression::MultilineOption};
+
+    std::optional<mp::Cgroups::Stall> stall;
+    for (auto it = line_regex.globalMatch(read_file(path)); it.hasNext();)
+    {
+        const auto match = it.next();
+        if (!stall)
+            stall.emplace();
+        (match.captured(1) == "some" ? stall->some : stall->full) = match.captured(2).toULongLong();
+    }
+
+    return stall;
+}
+
+mp::Cgroups::Pressure read_pressure(const QString& cgroup)
+{
+    mp::Cgroups::Pressure pressure;
+    for (const auto* resource : {"cpu", "memory", "io"})
+        if (const auto stall = read_stall(QDir{cgroup}.filePath(QString{"%1.pressure"}.arg(resource))))
+            pressure.emplace(resource, *stall);
+
+    return pressure;
+}
+} // namespace
+
+mp::Cgroups::Cgroups(const Singleton<Cgroups>::PrivatePass& pass) noexcept : Singleton<Cgroups>::Singleton{pass}
+{
+}
+
+bool mp::Cgroups::available() const
+{
+    std::call_once(set_up, [this] { root = set_up_daemon_cgroup(hierarchy_path(), own_cgroup_path()); });
+    return !root.isEmpty();
+}
+
+void mp::Cgroups::place(const std::string& instance, qint64 pid, const Controls& controls) const
+{
+    if (!available())
+        throw std::runtime_error{"there are no cgroups to place instances in"};
+
+    const auto leaf = QDir{QDir{root}.filePath(instances_dir)}.filePath(QString::fromStdString(instance));
+    make_dir(leaf);
+
+    write_control(leaf, "cpu.weight", weight(controls.cpu_weight));
+    write_control(leaf, "io.weight", "default " + weight(controls.io_weight));
+    write_control(leaf, "memory.high", memory_limit(controls.memory_high));
+    write_control(leaf, "memory.max", memory_limit(controls.memory_max));
+    write_file(QDir{leaf}.filePath("cgroup.procs"), std::to_string(pid));
+}
+
+void mp::Cgroups::release(const std::string& instance) const
+{
+    if (!available())
+        return;
+
+    const auto leaf = QDir{QDir{root}.filePath(instances_dir)}.filePath(QString::fromStdString(instance));
+    if (::rmdir(QFile::encodeName(leaf).constData()) < 0 && errno != ENOENT)
+        mpl::log(mpl::Level::debug, category, fmt::format("Could not remove {}: {}", leaf, std::strerror(errno)));
+}
+
+auto mp::Cgroups::pressure() const -> std::map<std::string, Pressure>
+{
+    std::map<std::string, Pressure> pressure;
+    if (!available())
+        return pressure;
+
+    if (auto daemon = read_pressure(QDir{root}.filePath(daemon_dir)); !daemon.empty())
+        pressure.emplace("", std::move(daemon));
+
+    const QDir instances{QDir{root}.filePath(instances_dir)};
+    for (const auto& name : instances.entryList(QDir::Dirs | QDir::NoDotAndDotDot))
+        if (auto leaf = read_pressure(instances.filePath(name)); !leaf.empty())
+            pressure.emplace(name.toStdString(), std::move(leaf));
+
+    return pressure;
+}
+
+QString mp::Cgroups::hierarchy_path() const
+{
+    return QStringLiteral("/sys/fs/cgroup");
+}
+
+QString mp::Cgroups::own_cgroup_path() const
+{
+    return QStringLiteral("/proc/self/cgroup");
+}
@@ -0,0 +1,74 @@
+/*
+ * Copyright (C) Canonical, Ltd.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; version 3.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#ifndef MULTIPASS_CGROUPS_H
+#define MULTIPASS_CGROUPS_H
+
+#include <multipass/singleton.h>
+
+#include <QString>
+
+#include <cstdint>
+#include <map>
+#include <mutex>
+#include <optional>
+#include <string>
+
+#define MP_CGROUPS multipass::Cgroups::instance()
+
+namespace multipass
+{
+// cgroup v2 leaves under the daemon's own cgroup: one for the daemon, weighted and protected so that instances cannot
+// starve it, and one per instance, for instances to be weighed against each other. Takes the daemon's cgroup to be
+// delegated to it, as systemd does with Delegate=yes; where it isn't, processes stay where they start.
+class Cgroups : public Singleton<Cgroups>
+{
+public:
+    struct Controls
+    {
+        int cpu_weight{0}; // from 1 to 10000, 0 for the kernel's default of 100
+        int io_weight{0};  // likewise
+        std::optional<long long> memory_high{}; // in bytes, reclaimed from past it; none for no limit
+        std::optional<long long> memory_max{};  // in bytes, out of memory past it; none for no limit
+    };
+
+    // Microseconds that some and all of a cgroup's tasks were held up waiting on a resource, as the kernel counts them
+    struct Stall
+    {
+        std::uint64_t some{0};
+        std::uint64_t full{0};
+    };
+    using Pressure = std::map<std::string, Stall>; // by "cpu", "memory" and "io", those the kernel keeps track of
+
+    Cgroups(const Singleton<Cgroups>::PrivatePass&) noexcept;
+
+    virtual bool available() const; // setting up the daemon's leaf the first time
+    // Moves the process to the instance's leaf, made with the controls given; again to update them
+    virtual void place(const std::string& instance, qint64 pid, const Controls& controls) const; // throws runtime_error
+    virtual void release(const std::string& instance) const; // once its processes are gone
+    virtual std::map<std::string, Pressure> pressure() const; // by instance, and "" for the daemon
+
+    // Where the unified hierarchy is mounted, and where the kernel tells which cgroup this process is in
+    virtual QString hierarchy_path() const;
+    virtual QString own_cgroup_path() const;
+
+private:
+    mutable std::once_flag set_up;
+    mutable QString root; // the daemon's cgroup, empty when there's nothing to place processes in
+};
+} // namespace multipass
+#endif // MULTIPASS_CGROUPS_H
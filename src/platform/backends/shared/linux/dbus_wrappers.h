@@ -74,6 +74,14 @@ public:
         return call_impl(mode, method, arg1, arg2, arg3); // indirection avoids default args in virtual method
     }
 
+    // Sent right away, the reply waited for only when it is needed, so that calls that do not depend on each other
+    // can be in flight together
+    QDBusPendingCall async_call(const QString& method, const QVariant& arg1 = {}, const QVariant& arg2 = {},
+                                const QVariant& arg3 = {})
+    {
+        return async_call_impl(method, arg1, arg2, arg3);
+    }
+
 protected:
     DBusInterface() = default; // for mocks
 
@@ -91,6 +99,20 @@ protected:
         return iface->call(mode, method, arg1, arg2, arg3);
     }
 
+    virtual QDBusPendingCall async_call_impl(const QString& method, const QVariant& arg1, const QVariant& arg2,
+                                             const QVariant& arg3)
+    {
+        assert(iface);
+        if (!arg1.isValid())
+            return iface->asyncCall(method);
+        if (!arg2.isValid())
+            return iface->asyncCall(method, arg1);
+        if (!arg3.isValid())
+            return iface->asyncCall(method, arg1, arg2);
+
+        return iface->asyncCall(method, arg1, arg2, arg3);
+    }
+
 private:
     friend class DBusConnection;
     explicit DBusInterface(
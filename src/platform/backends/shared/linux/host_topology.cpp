@@ -0,0 +1,116 @@
+/*
+ * Copyright (C) Canonical, Ltd.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; version 3.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#include "host_topology.h"
+
+#include <multipass/format.h>
+
+#include <QDir>
+#include <QFile>
+#include <QRegularExpression>
+
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <stdexcept>
+
+#include <sched.h>
+
+namespace mp = multipass;
+
+namespace
+{
+const QString nodes_dir{"/sys/devices/system/node"};
+
+QString read_node_file(const QString& node, const QString& file)
+{
+    QFile f{QDir{nodes_dir}.filePath(node + "/" + file)};
+    return f.open(QFile::ReadOnly) ? QString::fromLatin1(f.readAll()) : QString{};
+}
+
+long long free_memory(const QString& meminfo)
+{
+    // As in "Node 0 MemFree:         1234567 kB"
+    static const QRegularExpression mem_free{R"(MemFree:\s+([0-9]+) kB)"};
+    const auto match = mem_free.match(meminfo);
+    return match.hasMatch() ? match.captured(1).toLongLong() * 1024 : 0;
+}
+} // namespace
+
+mp::HostTopology::HostTopology(const Singleton<HostTopology>::PrivatePass& pass) noexcept
+    : Singleton<HostTopology>::Singleton{pass}
+{
+}
+
+auto mp::HostTopology::parse_cpu_list(const QString& list) -> CPUs
+{
+    static const QRegularExpression range_regex{QRegularExpression::anchoredPattern("([0-9]+)(?:-([0-9]+))?")};
+
+    CPUs cpus;
+    for (const auto& range : list.trimmed().split(','))
+    {
+        const auto match = range_regex.match(range);
+        const auto first = match.captured(1).toInt();
+        const auto last = match.captured(2).isEmpty() ? first : match.captured(2).toInt();
+
+        if (!match.hasMatch() || last < first || last >= CPU_SETSIZE)
+            throw std::invalid_argument{fmt::format("\"{}\" is not a list of CPUs, like \"0-3,8\"", list)};
+
+        for (auto cpu = first; cpu <= last; ++cpu)
+            if (std::find(cpus.cbegin(), cpus.cend(), cpu) == cpus.cend())
+                cpus.push_back(cpu);
+    }
+
+    return cpus;
+}
+
+auto mp::HostTopology::numa_nodes() const -> std::map<int, NumaNode>
+{
+    std::map<int, NumaNode> nodes;
+    const auto node_names = QDir{nodes_dir}.entryList({"node*"}, QDir::Dirs);
+    for (const auto& name : node_names)
+    {
+        bool ok = false;
+        const auto id = name.mid(4).toInt(&ok);
+        if (!ok)
+            continue;
+
+        try
+        {
+            auto cpus = parse_cpu_list(read_node_file(name, "cpulist"));
+            nodes.emplace(id, NumaNode{std::move(cpus), free_memory(read_node_file(name, "meminfo"))});
+        }
+        catch (const std::invalid_argument&)
+        {
+            // nodes with memory but no CPUs, like those of CXL or persistent memory, are no use to pin to
+        }
+    }
+
+    return nodes;
+}
+
+void mp::HostTopology::pin_thread(int thread_id, const CPUs& cpus) const
+{
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    for (const auto cpu : cpus)
+        CPU_SET(cpu, &set);
+
+    if (sched_setaffinity(thread_id, sizeof(set), &set) < 0)
+        throw std::runtime_error{fmt::format("Could not pin thread {} to CPUs {}: {}", thread_id,
+                                             fmt::join(cpus.cbegin(), cpus.cend(), ","), std::strerror(errno))};
+}
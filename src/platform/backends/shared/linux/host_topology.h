@@ -0,0 +1,52 @@
+/*
+ * Copyright (C) Canonical, Ltd.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; version 3.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#ifndef MULTIPASS_HOST_TOPOLOGY_H
+#define MULTIPASS_HOST_TOPOLOGY_H
+
+#include <multipass/singleton.h>
+
+#include <map>
+#include <vector>
+
+#include <QString>
+
+#define MP_HOST_TOPOLOGY multipass::HostTopology::instance()
+
+namespace multipass
+{
+// Where the host's CPUs and memory are, as sysfs tells, and which of those CPUs a thread gets to run on
+class HostTopology : public Singleton<HostTopology>
+{
+public:
+    using CPUs = std::vector<int>;
+    struct NumaNode
+    {
+        CPUs cpus;
+        long long free_memory; // in bytes
+    };
+
+    HostTopology(const Singleton<HostTopology>::PrivatePass&) noexcept;
+
+    // As the kernel writes them, e.g. "0-3,8,10-11"; throws std::invalid_argument when it is not one
+    static CPUs parse_cpu_list(const QString& list);
+
+    virtual std::map<int, NumaNode> numa_nodes() const; // empty where the kernel was built without NUMA
+    virtual void pin_thread(int thread_id, const CPUs& cpus) const; // throws std::runtime_error
+};
+} // namespace multipass
+#endif // MULTIPASS_HOST_TOPOLOGY_H
@@ -0,0 +1,72 @@
+/*
+ * Copyright (C) Canonical, Ltd.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; version 3.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#include "link_changes.h"
+
+#include <multipass/format.h>
+#include <multipass/logging/log.h>
+
+#include <linux/netlink.h>
+#include <linux/rtnetlink.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include <array>
+#include <cerrno>
+#include <cstring>
+
+namespace mp = multipass;
+namespace mpl = multipass::logging;
+
+mp::LinkChanges::LinkChanges() : socket_fd{socket(AF_NETLINK, SOCK_RAW | SOCK_NONBLOCK | SOCK_CLOEXEC, NETLINK_ROUTE)}
+{
+    sockaddr_nl address{};
+    address.nl_family = AF_NETLINK;
+    address.nl_groups = RTMGRP_LINK;
+
+    if (socket_fd >= 0 && bind(socket_fd, reinterpret_cast<sockaddr*>(&address), sizeof(address)) == 0)
+        return;
+
+    mpl::log(mpl::Level::debug, "link changes",
+             fmt::format("Cannot be notified of network link changes: {}", std::strerror(errno)));
+    if (socket_fd >= 0)
+        close(socket_fd);
+    socket_fd = -1;
+}
+
+mp::LinkChanges::~LinkChanges()
+{
+    if (socket_fd >= 0)
+        close(socket_fd);
+}
+
+bool mp::LinkChanges::since_last_asked()
+{
+    auto changed = !asked || socket_fd < 0;
+    asked = true;
+
+    // Only whether there were any matters, not what they were
+    if (socket_fd >= 0)
+    {
+        std::array<char, 8192> buffer;
+        ssize_t length;
+        while ((length = recv(socket_fd, buffer.data(), buffer.size(), 0)) > 0 || (length < 0 && errno == ENOBUFS))
+            changed = true; // ENOBUFS when the socket overflowed, notifications lost
+    }
+
+    return changed;
+}
@@ -0,0 +1,41 @@
+/*
+ * Copyright (C) Canonical, Ltd.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; version 3.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#ifndef MULTIPASS_LINK_CHANGES_H
+#define MULTIPASS_LINK_CHANGES_H
+
+#include <multipass/disabled_copy_move.h>
+
+namespace multipass
+{
+// Whether the host's network links were added, removed or changed since last asked, as the kernel notifies over
+// netlink, for what is learnt of them to be kept until then
+class LinkChanges : private DisabledCopyMove
+{
+public:
+    LinkChanges();
+    ~LinkChanges();
+
+    // Also true the first time, where notifications cannot be had and where some were lost
+    bool since_last_asked();
+
+private:
+    int socket_fd{-1};
+    bool asked{false};
+};
+} // namespace multipass
+#endif // MULTIPASS_LINK_CHANGES_H
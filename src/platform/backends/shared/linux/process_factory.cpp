@@ -16,6 +16,7 @@
  */
 
 #include "process_factory.h"
+#include "spawned_process.h"
 
 #include <multipass/exceptions/snap_environment_exception.h>
 #include <multipass/format.h>
@@ -121,6 +122,12 @@ std::unique_ptr<mp::Process> mp::ProcessFactory::create_process(std::unique_ptr<
             return std::make_unique<BasicProcess>(spec);
         }
     }
+    else if (process_spec->run_to_completion() && process_spec->apparmor_profile().isNull() &&
+             process_spec->working_directory().isNull())
+    {
+        // posix_spawn neither runs code in the child nor changes directory, so nothing else qualifies
+        return std::make_unique<SpawnedProcess>(std::move(process_spec));
+    }
     else
     {
         return std::make_unique<BasicProcess>(std::move(process_spec));
@@ -132,3 +139,9 @@ std::unique_ptr<mp::Process> mp::ProcessFactory::create_process(const QString& c
 {
     return create_process(simple_process_spec(command, arguments));
 }
+
+std::unique_ptr<mp::Process> mp::ProcessFactory::create_oneshot_process(const QString& command,
+                                                                        const QStringList& arguments) const
+{
+    return create_process(oneshot_process_spec(command, arguments));
+}
@@ -38,6 +38,9 @@ public:
 
     virtual std::unique_ptr<Process> create_process(std::unique_ptr<ProcessSpec>&& process_spec) const;
     std::unique_ptr<Process> create_process(const QString& command, const QStringList& args = QStringList()) const;
+    // For commands that are only executed or waited for, spawned without forking the daemon
+    std::unique_ptr<Process> create_oneshot_process(const QString& command,
+                                                    const QStringList& args = QStringList()) const;
 
 private:
     const std::optional<AppArmor> apparmor;
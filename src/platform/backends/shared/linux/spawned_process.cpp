@@ -0,0 +1,419 @@
+/*
+ * Copyright (C) Canonical, Ltd.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; version 3.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#include "spawned_process.h"
+
+#include <multipass/format.h>
+#include <multipass/logging/log.h>
+
+#include <QElapsedTimer>
+
+#include <algorithm>
+#include <cerrno>
+#include <chrono>
+#include <csignal>
+#include <cstring>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#include <fcntl.h>
+#include <poll.h>
+#include <spawn.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+extern char** environ;
+
+namespace mp = multipass;
+namespace mpl = multipass::logging;
+
+using namespace std::chrono_literals;
+
+namespace
+{
+std::vector<char*> null_terminated(std::vector<QByteArray>& strings)
+{
+    std::vector<char*> ret;
+    for (auto& string : strings)
+        ret.push_back(string.data());
+    ret.push_back(nullptr);
+
+    return ret;
+}
+
+int remaining(const QElapsedTimer& timer, int msecs) // -1 waits for ever, as with poll
+{
+    return msecs < 0 ? -1 : static_cast<int>(std::max<qint64>(msecs - timer.elapsed(), 0));
+}
+} // namespace
+
+mp::SpawnedProcess::SpawnedProcess(std::shared_ptr<ProcessSpec> spec) : process_spec{std::move(spec)}
+{
+    // Writing to a child that's gone must fail rather than take the daemon down, as QProcess arranges too
+    static const auto sigpipe_ignored = std::signal(SIGPIPE, SIG_IGN);
+    Q_UNUSED(sigpipe_ignored);
+}
+
+mp::SpawnedProcess::~SpawnedProcess()
+{
+    if (running())
+    {
+        ::kill(pid, SIGKILL);
+        reap(/*wait=*/true);
+    }
+
+    close_fd(stdin_fd);
+    close_fd(stdout_fd);
+    close_fd(stderr_fd);
+}
+
+QString mp::SpawnedProcess::program() const
+{
+    return process_spec->program();
+}
+
+QStringList mp::SpawnedProcess::arguments() const
+{
+    return process_spec->arguments();
+}
+
+QString mp::SpawnedProcess::working_directory() const
+{
+    return process_spec->working_directory();
+}
+
+QProcessEnvironment mp::SpawnedProcess::process_environment() const
+{
+    return process_spec->environment();
+}
+
+qint64 mp::SpawnedProcess::process_id() const
+{
+    return pid;
+}
+
+void mp::SpawnedProcess::start()
+{
+    if (pid || error)
+        return;
+
+    const auto merged = channel_mode == QProcess::MergedChannels;
+    int in[2]{-1, -1}, out[2]{-1, -1}, err[2]{-1, -1};
+    auto close_pipes = [&in, &out, &err] {
+        for (auto fd : {in[0], in[1], out[0], out[1], err[0], err[1]})
+            if (fd >= 0)
+                ::close(fd);
+    };
+
+    if (pipe2(in, O_CLOEXEC) || pipe2(out, O_CLOEXEC) || (!merged && pipe2(err, O_CLOEXEC)))
+    {
+        const auto reason = std::strerror(errno);
+        close_pipes();
+        return fail(QProcess::FailedToStart, QString{"Could not create pipes: %1"}.arg(reason));
+    }
+
+    posix_spawn_file_actions_t actions;
+    posix_spawn_file_actions_init(&actions);
+    posix_spawn_file_actions_adddup2(&actions, in[0], STDIN_FILENO);
+    posix_spawn_file_actions_adddup2(&actions, out[1], STDOUT_FILENO);
+    posix_spawn_file_actions_adddup2(&actions, merged ? out[1] : err[1], STDERR_FILENO);
+
+    // The child starts with no signals blocked and SIGPIPE back to its default
+    posix_spawnattr_t attributes;
+    posix_spawnattr_init(&attributes);
+    sigset_t no_signals, sigpipe;
+    sigemptyset(&no_signals);
+    sigemptyset(&sigpipe);
+    sigaddset(&sigpipe, SIGPIPE);
+    posix_spawnattr_setsigmask(&attributes, &no_signals);
+    posix_spawnattr_setsigdefault(&attributes, &sigpipe);
+    posix_spawnattr_setflags(&attributes, POSIX_SPAWN_SETSIGMASK | POSIX_SPAWN_SETSIGDEF);
+
+    std::vector<QByteArray> args{program().toLocal8Bit()};
+    for (const auto& arg : arguments())
+        args.push_back(arg.toLocal8Bit());
+
+    std::vector<QByteArray> env;
+    for (const auto& variable : process_environment().toStringList())
+        env.push_back(variable.toLocal8Bit());
+
+    auto argv = null_terminated(args);
+    auto envp = null_terminated(env);
+    const auto spawned =
+        posix_spawnp(&pid, argv[0], &actions, &attributes, argv.data(), env.empty() ? environ : envp.data());
+
+    posix_spawnattr_destroy(&attributes);
+    posix_spawn_file_actions_destroy(&actions);
+
+    // What the child got is its own now
+    close_fd(in[0]);
+    close_fd(out[1]);
+    close_fd(err[1]);
+    stdin_fd = in[1];
+    stdout_fd = out[0];
+    stderr_fd = err[0];
+
+    if (spawned != 0)
+    {
+        pid = 0;
+        close_fd(stdin_fd);
+        close_fd(stdout_fd);
+        close_fd(stderr_fd);
+        return fail(QProcess::FailedToStart, std::strerror(spawned));
+    }
+
+    mpl::log(mpl::Level::debug, qUtf8Printable(program()), "[{}] started: {} {}", pid, program(),
+             arguments().join(' '));
+
+    emit state_changed(QProcess::Running);
+    emit started();
+}
+
+void mp::SpawnedProcess::terminate()
+{
+    if (running())
+        ::kill(pid, SIGTERM);
+}
+
+void mp::SpawnedProcess::kill()
+{
+    if (running())
+        ::kill(pid, SIGKILL);
+}
+
+bool mp::SpawnedProcess::wait_for_started(int)
+{
+    return pid != 0; // spawned or failed by the time start() returns
+}
+
+bool mp::SpawnedProcess::wait_for_finished(int msecs)
+{
+    if (!running())
+        return false;
+
+    QElapsedTimer timer;
+    timer.start();
+
+    while (stdout_fd >= 0 || stderr_fd >= 0)
+        if (!read_available(remaining(timer, msecs)))
+            return false;
+
+    // Its output closed, the child is on its way out
+    while (!reap(/*wait=*/false))
+    {
+        if (msecs >= 0 && timer.elapsed() >= msecs)
+            return false;
+
+        std::this_thread::sleep_for(1ms);
+    }
+
+    return true;
+}
+
+bool mp::SpawnedProcess::wait_for_ready_read(int msecs)
+{
+    QElapsedTimer timer;
+    timer.start();
+
+    const auto before = standard_output.size();
+    while (standard_output.size() == before && stdout_fd >= 0)
+        if (!read_available(remaining(timer, msecs)))
+            break;
+
+    return standard_output.size() != before;
+}
+
+bool mp::SpawnedProcess::running() const
+{
+    return pid != 0 && !exit_code && !error;
+}
+
+mp::ProcessState mp::SpawnedProcess::process_state() const
+{
+    ProcessState state;
+    if (error)
+        state.error = error;
+    else
+        state.exit_code = exit_code;
+
+    return state;
+}
+
+QString mp::SpawnedProcess::error_string() const
+{
+    return QString{"program: %1; error: %2"}.arg(program(), error ? error->message : QStringLiteral("Unknown error"));
+}
+
+QByteArray mp::SpawnedProcess::read_all_standard_output()
+{
+    if (running())
+        read_available(0);
+
+    return std::exchange(standard_output, {});
+}
+
+QByteArray mp::SpawnedProcess::read_all_standard_error()
+{
+    if (running())
+        read_available(0);
+
+    return std::exchange(standard_error, {});
+}
+
+qint64 mp::SpawnedProcess::write(const QByteArray& data)
+{
+    if (stdin_fd < 0)
+        return -1;
+
+    qint64 written = 0;
+    while (written < data.size())
+    {
+        const auto ret = ::write(stdin_fd, data.constData() + written, data.size() - written);
+        if (ret < 0 && errno == EINTR)
+            continue;
+        if (ret < 0)
+            return written ? written : -1;
+
+        written += ret;
+    }
+
+    return written;
+}
+
+void mp::SpawnedProcess::close_write_channel()
+{
+    close_fd(stdin_fd);
+}
+
+void mp::SpawnedProcess::set_process_channel_mode(QProcess::ProcessChannelMode mode)
+{
+    channel_mode = mode; // applies from the next start
+}
+
+mp::ProcessState mp::SpawnedProcess::execute(const int timeout)
+{
+    start();
+
+    if (wait_for_started(timeout) && !wait_for_finished(timeout) && running())
+    {
+        kill();
+        reap(/*wait=*/true);
+        error = ProcessState::Error{QProcess::Timedout, QStringLiteral("Process operation timed out")};
+    }
+
+    if (error || !exit_code)
+    {
+        mpl::log(mpl::Level::error, qUtf8Printable(program()), qUtf8Printable(error_string()));
+
+        ProcessState state;
+        state.error = ProcessState::Error{error ? error->state : QProcess::UnknownError, error_string()};
+        return state;
+    }
+
+    return process_state();
+}
+
+void mp::SpawnedProcess::setup_child_process()
+{
+    // Nothing runs in the child between spawning and exec
+}
+
+bool mp::SpawnedProcess::read_available(int msecs)
+{
+    std::vector<pollfd> fds;
+    for (auto fd : {stdout_fd, stderr_fd})
+        if (fd >= 0)
+            fds.push_back(pollfd{fd, POLLIN, 0});
+
+    if (fds.empty())
+        return true;
+
+    const auto ready = ::poll(fds.data(), fds.size(), msecs);
+    if (ready < 0 && errno == EINTR)
+        return true;
+    if (ready <= 0)
+        return ready != 0;
+
+    for (const auto& polled : fds)
+    {
+        if (!polled.revents)
+            continue;
+
+        char buffer[4096];
+        const auto ret = ::read(polled.fd, buffer, sizeof(buffer));
+        if (ret < 0 && errno == EINTR)
+            continue;
+
+        const auto is_stdout = polled.fd == stdout_fd;
+        if (ret <= 0)
+        {
+            close_fd(is_stdout ? stdout_fd : stderr_fd);
+            continue;
+        }
+
+        if (is_stdout)
+        {
+            standard_output.append(buffer, ret);
+            emit ready_read_standard_output();
+        }
+        else
+        {
+            standard_error.append(buffer, ret);
+            mpl::log(process_spec->error_log_level(), qUtf8Printable(program()), std::string{buffer, std::size_t(ret)});
+            emit ready_read_standard_error();
+        }
+    }
+
+    return true;
+}
+
+bool mp::SpawnedProcess::reap(bool wait)
+{
+    int status = 0;
+    pid_t ret;
+    do
+        ret = ::waitpid(pid, &status, wait ? 0 : WNOHANG);
+    while (ret < 0 && errno == EINTR);
+
+    if (ret == 0)
+        return false;
+
+    if (ret == pid && WIFEXITED(status))
+        exit_code = WEXITSTATUS(status);
+    else // killed, or taken by someone else
+        error = ProcessState::Error{QProcess::Crashed, QStringLiteral("Process crashed")};
+
+    close_fd(stdin_fd);
+    emit state_changed(QProcess::NotRunning);
+    emit finished(process_state());
+
+    return true;
+}
+
+void mp::SpawnedProcess::fail(QProcess::ProcessError error, const QString& message)
+{
+    this->error = ProcessState::Error{error, message};
+    emit error_occurred(error, error_string());
+}
+
+void mp::SpawnedProcess::close_fd(int& fd)
+{
+    if (fd >= 0)
+        ::close(fd);
+    fd = -1;
+}
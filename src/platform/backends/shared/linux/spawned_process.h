@@ -0,0 +1,89 @@
+/*
+ * Copyright (C) Canonical, Ltd.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; version 3.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#ifndef MULTIPASS_SPAWNED_PROCESS_H
+#define MULTIPASS_SPAWNED_PROCESS_H
+
+#include <multipass/process/process.h>
+#include <multipass/process/process_spec.h>
+
+#include <sys/types.h>
+
+#include <memory>
+#include <optional>
+
+namespace multipass
+{
+// A process started with posix_spawn, which doesn't copy the daemon's address space the way fork does. It is only
+// driven by waiting on it: started, finished and output are signalled from within the calls that wait, not from the
+// event loop. Meant for short-lived commands whose specs say they run to completion.
+class SpawnedProcess : public Process
+{
+public:
+    explicit SpawnedProcess(std::shared_ptr<ProcessSpec> spec);
+    ~SpawnedProcess() override; // kills and reaps the child if still running
+
+    QString program() const override;
+    QStringList arguments() const override;
+    QString working_directory() const override;
+    QProcessEnvironment process_environment() const override;
+    qint64 process_id() const override;
+
+    void start() override;
+    void terminate() override;
+    void kill() override;
+
+    bool wait_for_started(int msecs = 30000) override;
+    bool wait_for_finished(int msecs = 30000) override;
+    bool wait_for_ready_read(int msecs = 30000) override;
+
+    bool running() const override;
+    ProcessState process_state() const override;
+    QString error_string() const override;
+
+    QByteArray read_all_standard_output() override;
+    QByteArray read_all_standard_error() override;
+
+    qint64 write(const QByteArray& data) override;
+    void close_write_channel() override;
+    void set_process_channel_mode(QProcess::ProcessChannelMode mode) override;
+
+    ProcessState execute(const int timeout = 30000) override;
+
+protected:
+    void setup_child_process() override;
+
+private:
+    bool read_available(int msecs); // false once timed out
+    bool reap(bool wait);
+    void fail(QProcess::ProcessError error, const QString& message);
+    void close_fd(int& fd);
+
+    const std::shared_ptr<ProcessSpec> process_spec;
+    QProcess::ProcessChannelMode channel_mode{QProcess::SeparateChannels};
+    pid_t pid{0};
+    int stdin_fd{-1};
+    int stdout_fd{-1};
+    int stderr_fd{-1};
+    QByteArray standard_output;
+    QByteArray standard_error;
+    std::optional<int> exit_code;
+    std::optional<ProcessState::Error> error;
+};
+} // namespace multipass
+
+#endif // MULTIPASS_SPAWNED_PROCESS_H
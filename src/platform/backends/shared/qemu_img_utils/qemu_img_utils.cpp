@@ -19,19 +19,214 @@
 
 #include <multipass/constants.h>
 #include <multipass/format.h>
+#include <multipass/logging/log.h>
+#include <multipass/logging/tracer.h>
 #include <multipass/memory_size.h>
 #include <multipass/platform.h>
+#include <multipass/process/process.h>
 #include <multipass/process/qemuimg_process_spec.h>
 
+#include <QDir>
+#include <QFile>
+#include <QFileInfo>
 #include <QJsonDocument>
 #include <QJsonObject>
+#include <QRegularExpression>
 #include <QString>
 #include <QStringList>
+#include <QtEndian>
+
+#include <filesystem>
 
 namespace mp = multipass;
+namespace mpl = multipass::logging;
+
+namespace
+{
+constexpr auto category = "qemu-img";
+
+// Parallel coroutines for qemu-img convert, its maximum
+constexpr auto convert_coroutines = "16";
+
+void log_convert_progress(mp::Process* process, const mp::Path& image_path)
+{
+    // With -p, qemu-img reports progress as "    (12.34/100%)\r"
+    QObject::connect(process, &mp::Process::ready_read_standard_output, [process, image_path, last = -1]() mutable {
+        static const QRegularExpression progress_re{"\\((\\d+)\\.\\d+/100%\\)"};
+
+        auto matches = progress_re.globalMatch(QString{process->read_all_standard_output()});
+        auto percent = last;
+        while (matches.hasNext())
+            percent = matches.next().captured(1).toInt();
+
+        if (percent != last)
+        {
+            mpl::log(mpl::Level::debug, category, fmt::format("Converting {}: {}%", image_path, percent));
+            last = percent;
+        }
+    });
+}
+
+// Converts a qcow2 image in place through a file next to it, replaced only once complete; returns the size before
+qint64 rewrite_image(const mp::Path& image_path, const QStringList& options, const char* action)
+{
+    const auto header = mp::backend::read_image_header(image_path);
+    if (!header || header->format != "qcow2")
+        throw std::runtime_error(fmt::format("Cannot {} image {}, it is not a qcow2 image", action, image_path));
+
+    const auto rewritten_path = image_path + ".rewriting";
+    QStringList arguments{"convert", "-p", "-m", convert_coroutines, "-f", "qcow2", "-O", "qcow2"};
+
+    // An overlay, of a snapshot say, stays one: only what it has on top of its backing file is written out again
+    if (!header->backing_file.isEmpty())
+        arguments << "-B" << header->backing_file << "-o"
+                  << "backing_fmt=qcow2";
+
+    arguments << options << image_path << rewritten_path;
+
+    auto qemuimg_convert_process =
+        mp::platform::make_process(std::make_unique<mp::QemuImgProcessSpec>(arguments, image_path, rewritten_path));
+    log_convert_progress(qemuimg_convert_process.get(), image_path);
+
+    auto process_state = qemuimg_convert_process->execute(mp::image_resize_timeout);
+    if (!process_state.completed_successfully())
+    {
+        QFile::remove(rewritten_path);
+        throw std::runtime_error(fmt::format("Cannot {} image: qemu-img failed ({}) with output:\n{}", action,
+                                             process_state.failure_message(),
+                                             qemuimg_convert_process->read_all_standard_error()));
+    }
+
+    const auto size_before = QFileInfo{image_path}.size();
+    std::error_code err;
+    std::filesystem::rename(rewritten_path.toStdString(), image_path.toStdString(), err);
+    if (err)
+    {
+        QFile::remove(rewritten_path);
+        throw std::runtime_error(fmt::format("Cannot replace image {}: {}", image_path, err.message()));
+    }
+
+    return size_before;
+}
+
+mp::Path snapshot_path(const mp::Path& image_path, const QString& snapshot_name)
+{
+    return QDir{mp::backend::snapshots_dir(image_path)}.filePath(snapshot_name + ".qcow2");
+}
+
+mp::Path existing_snapshot_path(const mp::Path& image_path, const QString& snapshot_name)
+{
+    auto path = snapshot_path(image_path, snapshot_name);
+    if (!QFile::exists(path))
+    {
+        const auto names = mp::backend::list_snapshots(image_path);
+        throw std::runtime_error(fmt::format("There is no snapshot named \"{}\"{}", snapshot_name,
+                                             names.isEmpty() ? QString{} : "; there are: " + names.join(", ")));
+    }
+
+    return path;
+}
+
+// Has the image be an overlay of another backing file, or of none, taking in whatever it would read differently
+void rebase_image(const mp::Path& image_path, const mp::Path& backing_path)
+{
+    QStringList arguments{"rebase", "-f", "qcow2", "-b", backing_path};
+    if (!backing_path.isEmpty())
+        arguments << "-F"
+                  << "qcow2";
+    arguments << image_path;
+
+    auto qemuimg_rebase_process =
+        mp::platform::make_process(std::make_unique<mp::QemuImgProcessSpec>(arguments, "", image_path));
+
+    auto process_state = qemuimg_rebase_process->execute(mp::image_resize_timeout);
+    if (!process_state.completed_successfully())
+        throw std::runtime_error(fmt::format("Cannot rebase image {}: qemu-img failed ({}) with output:\n{}",
+                                             image_path, process_state.failure_message(),
+                                             qemuimg_rebase_process->read_all_standard_error()));
+}
+
+// Has the image start afresh as an empty overlay of the backing file, through a file next to it renamed over it
+void create_overlay(const mp::Path& backing_path, const mp::Path& image_path)
+{
+    const auto overlay_path = image_path + ".overlay";
+    auto qemuimg_create_process = mp::platform::make_process(std::make_unique<mp::QemuImgProcessSpec>(
+        QStringList{"create", "-f", "qcow2", "-F", "qcow2", "-b", backing_path, overlay_path}, backing_path,
+        overlay_path));
+
+    auto process_state = qemuimg_create_process->execute();
+    if (!process_state.completed_successfully())
+    {
+        QFile::remove(overlay_path);
+        throw std::runtime_error(fmt::format("Cannot create overlay image: qemu-img failed ({}) with output:\n{}",
+                                             process_state.failure_message(),
+                                             qemuimg_create_process->read_all_standard_error()));
+    }
+
+    std::error_code err;
+    std::filesystem::rename(overlay_path.toStdString(), image_path.toStdString(), err);
+    if (err)
+    {
+        QFile::remove(overlay_path);
+        throw std::runtime_error(fmt::format("Cannot replace image {}: {}", image_path, err.message()));
+    }
+}
+} // namespace
+
+std::optional<mp::backend::ImageHeader> mp::backend::read_image_header(const mp::Path& image_path)
+{
+    // Big endian, laid out in qemu's docs/interop/qcow2.txt: magic, version, where in the file the backing file name
+    // is and its length, virtual size at byte 24 and, from version 3 on, incompatible features at byte 72, with bit 3
+    // telling a compression type other than zlib
+    constexpr auto header_size = 32;
+    constexpr auto v3_header_size = 80;
+    constexpr auto version_offset = 4;
+    constexpr auto backing_file_offset_offset = 8;
+    constexpr auto backing_file_size_offset = 16;
+    constexpr quint32 max_backing_file_size = 1023; // as qemu has it
+    constexpr auto size_offset = 24;
+    constexpr auto incompatible_features_offset = 72;
+    constexpr quint64 compression_type_bit = 1 << 3;
+
+    QFile image{image_path};
+    if (!image.open(QIODevice::ReadOnly))
+        return std::nullopt;
+
+    const auto header = image.read(v3_header_size);
+    if (header.size() < header_size || !header.startsWith(QByteArray{"QFI\xfb", 4}))
+        return std::nullopt;
+
+    const auto version = qFromBigEndian<quint32>(header.constData() + version_offset);
+    if (version != 2 && version != 3)
+        return std::nullopt;
+
+    const auto virtual_size = qFromBigEndian<quint64>(header.constData() + size_offset);
+    const auto zstd_compressed =
+        version == 3 && header.size() == v3_header_size &&
+        (qFromBigEndian<quint64>(header.constData() + incompatible_features_offset) & compression_type_bit);
+
+    QString backing_file;
+    const auto backing_file_offset = qFromBigEndian<quint64>(header.constData() + backing_file_offset_offset);
+    const auto backing_file_size = qFromBigEndian<quint32>(header.constData() + backing_file_size_offset);
+    if (backing_file_offset && backing_file_size && backing_file_size <= max_backing_file_size)
+    {
+        if (!image.seek(backing_file_offset))
+            return std::nullopt;
+
+        const auto name = image.read(backing_file_size);
+        if (name.size() != static_cast<int>(backing_file_size))
+            return std::nullopt;
+
+        // Relative names are to the image's own directory
+        backing_file = QFileInfo{image_path}.dir().absoluteFilePath(QString::fromUtf8(name));
+    }
+
+    return ImageHeader{"qcow2", MemorySize{std::to_string(virtual_size)}, zstd_compressed, backing_file};
+}
 
 void mp::backend::resize_instance_image(const MemorySize& disk_space, const mp::Path& image_path)
 {
+    mp::logging::TraceSpan span{"resize_instance_image", image_path.toStdString()};
     auto disk_size = QString::number(disk_space.in_bytes()); // format documented in `man qemu-img` (look for "size")
     QStringList qemuimg_parameters{{"resize", image_path, disk_size}};
     auto qemuimg_process =
@@ -48,10 +243,15 @@ void mp::backend::resize_instance_image(const MemorySize& disk_space, const mp::
 
 mp::Path mp::backend::convert_to_qcow_if_necessary(const mp::Path& image_path)
 {
+    mp::logging::TraceSpan span{"convert_to_qcow_if_necessary", image_path.toStdString()};
+
     // Check if raw image file, and if so, convert to qcow2 format.
     // TODO: we could support converting from other the image formats that qemu-img can deal with
     const auto qcow2_path{image_path + ".qcow2"};
 
+    if (const auto header = read_image_header(image_path); header && header->format == "qcow2")
+        return image_path;
+
     auto qemuimg_info_spec =
         std::make_unique<mp::QemuImgProcessSpec>(QStringList{"info", "--output=json", image_path}, image_path);
     auto qemuimg_info_process = mp::platform::make_process(std::move(qemuimg_info_spec));
@@ -69,9 +269,12 @@ mp::Path mp::backend::convert_to_qcow_if_necessary(const mp::Path& image_path)
 
     if (image_record["format"].toString() == "raw")
     {
+        // No -W: out-of-order writes are only advisable when the target is preallocated, which a qcow2 is not
         auto qemuimg_convert_spec = std::make_unique<mp::QemuImgProcessSpec>(
-            QStringList{"convert", "-p", "-O", "qcow2", image_path, qcow2_path}, image_path, qcow2_path);
+            QStringList{"convert", "-p", "-m", convert_coroutines, "-f", "raw", "-O", "qcow2", image_path, qcow2_path},
+            image_path, qcow2_path);
         auto qemuimg_convert_process = mp::platform::make_process(std::move(qemuimg_convert_spec));
+        log_convert_progress(qemuimg_convert_process.get(), image_path);
         process_state = qemuimg_convert_process->execute(mp::image_resize_timeout);
 
         if (!process_state.completed_successfully())
@@ -87,3 +290,127 @@ mp::Path mp::backend::convert_to_qcow_if_necessary(const mp::Path& image_path)
         return image_path;
     }
 }
+
+void mp::backend::clone_image(const mp::Path& source_path, const mp::Path& destination_path)
+{
+    mp::logging::TraceSpan span{"clone_image", source_path.toStdString()};
+
+    if (const auto header = read_image_header(source_path); !header || header->format != "qcow2")
+    {
+        if (!QFile::copy(source_path, destination_path))
+            throw std::runtime_error(fmt::format("Cannot copy image {} to {}", source_path, destination_path));
+        return;
+    }
+
+    // Only what is allocated is copied, unlike with a plain file copy, which would also fill any holes in
+    auto qemuimg_convert_spec = std::make_unique<mp::QemuImgProcessSpec>(
+        QStringList{"convert", "-p", "-m", convert_coroutines, "-f", "qcow2", "-O", "qcow2", source_path,
+                    destination_path},
+        source_path, destination_path);
+    auto qemuimg_convert_process = mp::platform::make_process(std::move(qemuimg_convert_spec));
+    log_convert_progress(qemuimg_convert_process.get(), source_path);
+
+    auto process_state = qemuimg_convert_process->execute(mp::image_resize_timeout);
+    if (!process_state.completed_successfully())
+    {
+        QFile::remove(destination_path);
+        throw std::runtime_error(fmt::format("Cannot clone image: qemu-img failed ({}) with output:\n{}",
+                                             process_state.failure_message(),
+                                             qemuimg_convert_process->read_all_standard_error()));
+    }
+}
+
+void mp::backend::compact_image(const mp::Path& image_path, bool compress)
+{
+    mp::logging::TraceSpan span{"compact_image", image_path.toStdString()};
+
+    const auto size_before = rewrite_image(image_path, compress ? QStringList{"-c"} : QStringList{}, "compact");
+    mpl::log(mpl::Level::info, category,
+             fmt::format("Compacted {} from {} to {} bytes", image_path, size_before, QFileInfo{image_path}.size()));
+}
+
+void mp::backend::compress_image(const mp::Path& image_path)
+{
+    mp::logging::TraceSpan span{"compress_image", image_path.toStdString()};
+
+    const auto size_before = rewrite_image(image_path, {"-c", "-o", "compression_type=zstd"}, "compress");
+    mpl::log(mpl::Level::info, category,
+             fmt::format("Compressed {} from {} to {} bytes", image_path, size_before, QFileInfo{image_path}.size()));
+}
+
+mp::Path mp::backend::snapshots_dir(const mp::Path& image_path)
+{
+    return QFileInfo{image_path}.dir().filePath("snapshots");
+}
+
+void mp::backend::snapshot_image(const mp::Path& image_path, const QString& snapshot_name)
+{
+    mp::logging::TraceSpan span{"snapshot_image", image_path.toStdString()};
+
+    const auto path = snapshot_path(image_path, snapshot_name);
+    if (QFile::exists(path))
+        throw std::runtime_error(fmt::format("There is a snapshot named \"{}\" already", snapshot_name));
+
+    if (!QDir{}.mkpath(snapshots_dir(image_path)))
+        throw std::runtime_error(fmt::format("Cannot create the snapshots directory of {}", image_path));
+
+    // The image itself becomes the snapshot, never to be written to again
+    std::error_code err;
+    std::filesystem::rename(image_path.toStdString(), path.toStdString(), err);
+    if (err)
+        throw std::runtime_error(fmt::format("Cannot snapshot image {}: {}", image_path, err.message()));
+
+    try
+    {
+        create_overlay(path, image_path);
+    }
+    catch (...)
+    {
+        std::filesystem::rename(path.toStdString(), image_path.toStdString(), err);
+        throw;
+    }
+
+    mpl::log(mpl::Level::info, category, fmt::format("Snapshotted {} as {}", image_path, snapshot_name));
+}
+
+void mp::backend::restore_image(const mp::Path& image_path, const QString& snapshot_name)
+{
+    mp::logging::TraceSpan span{"restore_image", image_path.toStdString()};
+
+    const auto path = existing_snapshot_path(image_path, snapshot_name);
+    create_overlay(path, image_path);
+    mpl::log(mpl::Level::info, category, fmt::format("Restored {} to {}", image_path, snapshot_name));
+}
+
+QStringList mp::backend::list_snapshots(const mp::Path& image_path)
+{
+    auto names = QDir{snapshots_dir(image_path)}.entryList({"*.qcow2"}, QDir::Files, QDir::Name);
+    names.replaceInStrings(QRegularExpression{"\\.qcow2$"}, "");
+
+    return names;
+}
+
+void mp::backend::delete_snapshot(const mp::Path& image_path, const QString& snapshot_name)
+{
+    mp::logging::TraceSpan span{"delete_snapshot", image_path.toStdString()};
+
+    const auto path = existing_snapshot_path(image_path, snapshot_name);
+    const auto header = read_image_header(path);
+    const auto backing_path = header ? header->backing_file : QString{};
+
+    // Whatever is an overlay of it, the image itself or later snapshots, first takes in what it holds
+    QStringList overlay_candidates{image_path};
+    for (const auto& name : list_snapshots(image_path))
+        if (name != snapshot_name)
+            overlay_candidates << snapshot_path(image_path, name);
+
+    for (const auto& candidate : overlay_candidates)
+        if (const auto candidate_header = read_image_header(candidate);
+            candidate_header && candidate_header->backing_file == QFileInfo{path}.absoluteFilePath())
+            rebase_image(candidate, backing_path);
+
+    if (!QFile::remove(path))
+        throw std::runtime_error(fmt::format("Cannot remove snapshot {}", path));
+
+    mpl::log(mpl::Level::info, category, fmt::format("Deleted snapshot {} of {}", snapshot_name, image_path));
+}
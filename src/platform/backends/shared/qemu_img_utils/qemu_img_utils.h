@@ -18,16 +18,48 @@
 #ifndef MULTIPASS_QEMU_IMG_UTILS_H
 #define MULTIPASS_QEMU_IMG_UTILS_H
 
+#include <multipass/memory_size.h>
 #include <multipass/path.h>
 
+#include <QString>
+#include <QStringList>
+
+#include <optional>
+
 namespace multipass
 {
-class MemorySize;
-
 namespace backend
 {
+struct ImageHeader
+{
+    QString format;
+    MemorySize virtual_size;
+    bool zstd_compressed{false};
+    QString backing_file; // absolute, and empty for images that are not an overlay
+};
+
+// Read in-process, without spawning qemu-img. Only qcow2 identifies itself, so nothing for any other format
+std::optional<ImageHeader> read_image_header(const Path& image_path);
+
 void resize_instance_image(const MemorySize& disk_space, const multipass::Path& image_path);
 Path convert_to_qcow_if_necessary(const Path& image_path);
+// A standalone copy, not an overlay: neither image depends on the other afterwards
+void clone_image(const Path& source_path, const Path& destination_path);
+// Rewrites a qcow2 image without the clusters that are unallocated or all zeroes, compressing the rest if asked to
+void compact_image(const Path& image_path, bool compress);
+// Rewrites a qcow2 image with its clusters compressed with zstd; reads get cheaper, writes land uncompressed
+void compress_image(const Path& image_path);
+
+// Where the snapshots of an instance image are kept, as read-only backing files of whatever came after them
+Path snapshots_dir(const Path& image_path);
+// Freezes the image as the named snapshot, for it to go on as an empty overlay of that; nothing is copied
+void snapshot_image(const Path& image_path, const QString& snapshot_name);
+// Drops whatever the image has on top of the named snapshot, by starting it afresh as an empty overlay of it
+void restore_image(const Path& image_path, const QString& snapshot_name);
+// The names of the image's snapshots, in alphabetical order
+QStringList list_snapshots(const Path& image_path);
+// Drops the named snapshot, once whatever was an overlay of it has taken in what it holds
+void delete_snapshot(const Path& image_path, const QString& snapshot_name);
 } // namespace backend
 } // namespace multipass
 #endif // MULTIPASS_QEMU_IMG_UTILS_H
@@ -41,16 +41,27 @@ QString serialise_id_mappings(const mp::id_mappings& xid_mappings)
     return out;
 }
 
-QByteArray gen_hash(const std::string& path)
+QByteArray gen_hash(const mp::SSHFSServerConfig& config)
 {
+    // A shared server is told apart by the sources it may serve, one for a single mount by its own
+    if (!config.shared_sources.empty())
+    {
+        QCryptographicHash hash{QCryptographicHash::Sha256};
+        for (const auto& source : config.shared_sources)
+            hash.addData(QByteArray::fromStdString(source + '\0'));
+        return "shared." + hash.result().toHex().left(8);
+    }
+
     // need to return unique name for each mount.  The target directory string will be unique,
     // so hash it and return first 8 hex chars.
-    return QCryptographicHash::hash(QByteArray::fromStdString(path), QCryptographicHash::Sha256).toHex().left(8);
+    return QCryptographicHash::hash(QByteArray::fromStdString(config.source_path), QCryptographicHash::Sha256)
+        .toHex()
+        .left(8);
 }
 } // namespace
 
 mp::SSHFSServerProcessSpec::SSHFSServerProcessSpec(const SSHFSServerConfig& config)
-    : config(config), target_hash(gen_hash(config.source_path))
+    : config(config), target_hash(gen_hash(config))
 {
 }
 
@@ -61,6 +72,11 @@ QString mp::SSHFSServerProcessSpec::program() const
 
 QStringList mp::SSHFSServerProcessSpec::arguments() const
 {
+    if (!config.shared_sources.empty())
+        return QStringList() << "--shared" << QString::fromStdString(config.host) << QString::number(config.port)
+                             << QString::fromStdString(config.username)
+                             << QString::number(static_cast<int>(mp::logging::get_logging_level()));
+
     return QStringList() << QString::fromStdString(config.host) << QString::number(config.port)
                          << QString::fromStdString(config.username) << QString::fromStdString(config.source_path)
                          << QString::fromStdString(config.target_path) << serialise_id_mappings(config.uid_mappings)
@@ -72,6 +88,12 @@ QProcessEnvironment mp::SSHFSServerProcessSpec::environment() const
 {
     QProcessEnvironment env = QProcessEnvironment::systemEnvironment();
     env.insert("KEY", QString::fromStdString(config.private_key));
+    if (config.compression)
+        env.insert("MULTIPASS_SSH_COMPRESSION", "1");
+    if (config.write_behind)
+        env.insert("MULTIPASS_SSHFS_WRITE_BEHIND", "1");
+    if (!config.mount_profile.empty() && config.shared_sources.empty()) // shared servers get one with each mount
+        env.insert("MULTIPASS_SSHFS_MOUNT_PROFILE", QString::fromStdString(config.mount_profile));
     return env;
 }
 
@@ -102,6 +124,9 @@ profile %1 flags=(attach_disconnected) {
     capability setuid,
     capability setgid,
 
+    # SSH to guests given a vsock device
+    network vsock stream,
+
     # Allow multipassd send sshfs_server signals
     signal (receive) peer=%2,
 
@@ -116,10 +141,8 @@ profile %1 flags=(attach_disconnected) {
     # CLASSIC ONLY: need to specify required libs from core snap
     /{,var/lib/snapd/}snap/core18/*/{,usr/}lib/@{multiarch}/{,**/}*.so* rm,
 
-    # allow full access just to this user-specified source directory on the host
-    %4/ rw,
-    %4/** rwlk,
-}
+    # allow full access just to the user-specified source directories on the host
+%4}
     )END");
 
     /* Customisations depending on if running inside snap or not */
@@ -140,8 +163,13 @@ profile %1 flags=(attach_disconnected) {
         signal_peer = "unconfined";
     }
 
-    return profile_template.arg(apparmor_profile_name(), signal_peer, root_dir,
-                                QString::fromStdString(config.source_path));
+    QString source_rules;
+    const auto sources = config.shared_sources.empty() ? std::vector<std::string>{config.source_path}
+                                                       : config.shared_sources;
+    for (const auto& source : sources)
+        source_rules += QString("    %1/ rw,\n    %1/** rwlk,\n").arg(QString::fromStdString(source));
+
+    return profile_template.arg(apparmor_profile_name(), signal_peer, root_dir, source_rules);
 }
 
 QString mp::SSHFSServerProcessSpec::identifier() const
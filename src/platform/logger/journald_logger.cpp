@@ -20,8 +20,29 @@
 #define SD_JOURNAL_SUPPRESS_LOCATION
 #include <systemd/sd-journal.h>
 
+#include <multipass/format.h>
+
+#include <sys/uio.h>
+
+#include <cctype>
+#include <string>
+#include <vector>
+
 namespace mpl = multipass::logging;
 
+namespace
+{
+// Journal field names take uppercase letters, digits and underscores, and can't start with an underscore
+std::string field_name(const std::string& key)
+{
+    std::string name{"MULTIPASS_"};
+    for (const auto c : key)
+        name += std::isalnum(static_cast<unsigned char>(c)) ? std::toupper(static_cast<unsigned char>(c)) : '_';
+
+    return name;
+}
+} // namespace
+
 mpl::JournaldLogger::JournaldLogger(mpl::Level level) : LinuxLogger{level}
 {
 }
@@ -34,3 +55,23 @@ void mpl::JournaldLogger::log(mpl::Level level, CString category, CString messag
                         category.c_str(), nullptr);
     }
 }
+
+void mpl::JournaldLogger::log_record(const Record& record) const
+{
+    if (record.level > logging_level)
+        return;
+
+    std::vector<std::string> fields{fmt::format("MESSAGE={}", record.message),
+                                    fmt::format("PRIORITY={}", to_syslog_priority(record.level)),
+                                    fmt::format("CATEGORY={}", record.category)};
+    if (!record.instance.empty())
+        fields.push_back(fmt::format("INSTANCE={}", record.instance));
+    for (const auto& [key, value] : record.fields)
+        fields.push_back(fmt::format("{}={}", field_name(key), value));
+
+    std::vector<iovec> iov;
+    for (auto& field : fields)
+        iov.push_back(iovec{field.data(), field.size()});
+
+    sd_journal_sendv(iov.data(), static_cast<int>(iov.size()));
+}
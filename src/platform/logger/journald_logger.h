@@ -29,6 +29,7 @@ class JournaldLogger : public LinuxLogger
 public:
     explicit JournaldLogger(Level level);
     void log(Level level, CString category, CString message) const override;
+    void log_record(const Record& record) const override; // with the instance and fields as journal fields
 };
 } // namespace logging
 } // namespace multipass
@@ -47,11 +47,17 @@
 
 #include "platform_linux_detail.h"
 #include "platform_shared.h"
+#include "shared/linux/cgroups.h"
+#include "shared/linux/link_changes.h"
 #include "shared/linux/process_factory.h"
 #include "shared/sshfs_server_process_spec.h"
 #include <disabled_update_prompt.h>
 
 #include <QCoreApplication>
+#include <QDBusConnection>
+#include <QDBusInterface>
+#include <QDBusReply>
+#include <QDBusUnixFileDescriptor>
 #include <QDir>
 #include <QFile>
 #include <QRegularExpression>
@@ -59,12 +65,17 @@
 #include <QTextStream>
 
 #include <errno.h>
+#include <fcntl.h>
+#include <linux/fs.h>
 #include <linux/if_arp.h>
 #include <string.h>
+#include <sys/ioctl.h>
 #include <sys/stat.h>
 #include <sys/types.h>
 #include <unistd.h>
 
+#include <mutex>
+
 namespace mp = multipass;
 namespace mpl = multipass::logging;
 namespace mu = multipass::utils;
@@ -73,6 +84,10 @@ namespace
 {
 constexpr auto autostart_filename = "multipass.gui.autostart.desktop";
 constexpr auto category = "Linux platform";
+constexpr auto ksm_dir = "/sys/kernel/mm/ksm";
+constexpr auto logind_service = "org.freedesktop.login1";
+constexpr auto logind_path = "/org/freedesktop/login1";
+constexpr auto logind_interface = "org.freedesktop.login1.Manager";
 
 // Fetch the ARP protocol HARDWARE identifier.
 int get_net_type(const QDir& net_dir) // types defined in if_arp.h
@@ -178,6 +193,16 @@ std::string get_alias_script_path(const std::string& alias)
 
     return aliases_folder.absoluteFilePath(QString::fromStdString(alias)).toStdString();
 }
+
+bool write_ksm_tunable(const QString& name, const QString& value)
+{
+    QFile tunable{QDir{ksm_dir}.filePath(name)};
+    if (tunable.open(QIODevice::WriteOnly | QIODevice::Text) && tunable.write(value.toUtf8()) >= 0)
+        return true;
+
+    mpl::log(mpl::Level::warning, category, fmt::format("Could not write {} to {}", value, tunable.fileName()));
+    return false;
+}
 } // namespace
 
 std::unique_ptr<QFile> multipass::platform::detail::find_os_release()
@@ -246,7 +271,17 @@ std::string multipass::platform::detail::read_os_release()
 std::map<std::string, mp::NetworkInterfaceInfo> mp::platform::Platform::get_network_interfaces_info() const
 {
     static const auto sysfs = QDir{QStringLiteral("/sys/class/net")};
-    return detail::get_network_interfaces_from(sysfs);
+
+    // Walked again only once links have changed
+    static std::mutex mutex;
+    static LinkChanges link_changes;
+    static std::map<std::string, NetworkInterfaceInfo> interfaces;
+
+    std::lock_guard lock{mutex};
+    if (link_changes.since_last_asked())
+        interfaces = detail::get_network_interfaces_from(sysfs);
+
+    return interfaces;
 }
 
 QString mp::platform::Platform::get_blueprints_url_override() const
@@ -279,6 +314,33 @@ bool mp::platform::Platform::link(const char* target, const char* link) const
     return ::link(target, link) == 0;
 }
 
+bool mp::platform::Platform::clone_file(const char* source, const char* destination) const
+{
+    const auto source_fd = ::open(source, O_RDONLY | O_CLOEXEC);
+    if (source_fd < 0)
+        return false;
+
+    struct stat source_stat;
+    auto cloned = false;
+    if (fstat(source_fd, &source_stat) == 0)
+    {
+        if (const auto destination_fd = ::open(destination, O_WRONLY | O_CREAT | O_EXCL | O_CLOEXEC,
+                                               source_stat.st_mode & 07777);
+            destination_fd >= 0)
+        {
+            // Only filesystems like btrfs and xfs support this, the rest fail with EOPNOTSUPP or EXDEV
+            cloned = ioctl(destination_fd, FICLONE, source_fd) == 0;
+            ::close(destination_fd);
+
+            if (!cloned)
+                ::unlink(destination);
+        }
+    }
+
+    ::close(source_fd);
+    return cloned;
+}
+
 QDir mp::platform::Platform::get_alias_scripts_folder() const
 {
     QDir aliases_folder;
@@ -300,11 +362,26 @@ void mp::platform::Platform::create_alias_script(const std::string& alias, const
 {
     std::string file_path = get_alias_script_path(alias);
 
-    std::string multipass_exec = mu::in_multipass_snap()
-                                     ? "exec /usr/bin/snap run multipass"
-                                     : fmt::format("\"{}\"", QCoreApplication::applicationFilePath());
+    // Outside the snap, the alias is a link to the client itself, which runs the alias it is invoked as. That saves
+    // starting a shell on every invocation.
+    if (!mu::in_multipass_snap())
+    {
+        const mp::fs::path link{file_path};
+        std::error_code err;
+
+        MP_FILEOPS.create_directories(link.parent_path(), err);
+        if (!err)
+            MP_FILEOPS.remove(link, err);
+        if (!err)
+            MP_FILEOPS.create_symlink(QCoreApplication::applicationFilePath().toStdString(), link, err);
+
+        if (err)
+            throw std::runtime_error(fmt::format("cannot create alias link '{}': {}", file_path, err.message()));
+
+        return;
+    }
 
-    std::string script = "#!/bin/sh\n\n" + multipass_exec + " " + alias + " -- \"${@}\"\n";
+    std::string script = "#!/bin/sh\n\nexec /usr/bin/snap run multipass " + alias + " -- \"${@}\"\n";
 
     MP_UTILS.make_file_with_content(file_path, script, true);
 
@@ -362,6 +439,103 @@ bool mp::platform::Platform::is_image_url_supported() const
     return true;
 }
 
+void mp::platform::Platform::tune_memory_merging(const QString& policy, int pages_to_scan) const
+{
+    if (policy != "on" && policy != "off")
+        return; // left as the host has it
+
+    if (!QDir{ksm_dir}.exists())
+    {
+        mpl::log(mpl::Level::debug, category, "No kernel same-page merging on this host");
+        return;
+    }
+
+    // Stopped rather than unmerged (run=2) when off, which would have every merged page copied out at once
+    const auto on = policy == "on";
+    if ((!on || write_ksm_tunable("pages_to_scan", QString::number(pages_to_scan))) &&
+        write_ksm_tunable("run", on ? "1" : "0"))
+        mpl::log(mpl::Level::debug, category, fmt::format("Kernel same-page merging turned {}", policy));
+}
+
+std::map<std::string, std::uint64_t> mp::platform::Platform::memory_merging_stats() const
+{
+    std::map<std::string, std::uint64_t> stats;
+    for (const auto* name : {"pages_shared", "pages_sharing", "pages_unshared", "pages_volatile", "full_scans"})
+    {
+        QFile stat{QDir{ksm_dir}.filePath(name)};
+        if (!stat.open(QIODevice::ReadOnly | QIODevice::Text))
+            continue;
+
+        bool ok;
+        const auto value = stat.readAll().trimmed().toULongLong(&ok);
+        if (ok)
+            stats.emplace(name, value);
+    }
+
+    return stats;
+}
+
+auto mp::platform::Platform::resource_pressure() const -> std::vector<ResourcePressure>
+{
+    std::vector<ResourcePressure> pressure;
+    for (const auto& [instance, resources] : MP_CGROUPS.pressure())
+        for (const auto& [resource, stall] : resources)
+            pressure.push_back({instance, resource, stall.some * 1e-6, stall.full * 1e-6});
+
+    return pressure;
+}
+
+std::uint64_t mp::platform::Platform::resident_memory() const
+{
+    // In pages, the second field being what is resident
+    QFile statm{"/proc/self/statm"};
+    if (!statm.open(QIODevice::ReadOnly | QIODevice::Text))
+        return 0;
+
+    const auto fields = QString{statm.readAll()}.split(' ', QString::SkipEmptyParts);
+    bool ok = false;
+    const auto pages = fields.size() > 1 ? fields[1].toULongLong(&ok) : 0;
+
+    return ok ? pages * static_cast<std::uint64_t>(sysconf(_SC_PAGESIZE)) : 0;
+}
+
+bool mp::platform::Platform::watch_host_sleep(QObject* receiver, const char* slot) const
+{
+    auto bus = QDBusConnection::systemBus();
+    if (bus.isConnected() &&
+        bus.connect(logind_service, logind_path, logind_interface, "PrepareForSleep", receiver, slot))
+        return true;
+
+    mpl::log(mpl::Level::debug, category, "Cannot watch for the host going to sleep");
+    return false;
+}
+
+void mp::platform::Platform::hold_host_sleep(bool hold) const
+{
+    // A delay lock, which logind waits on for no longer than its InhibitDelayMaxSec before sleeping anyway
+    static std::mutex mutex;
+    static QDBusUnixFileDescriptor lock;
+
+    std::lock_guard guard{mutex};
+    if (!hold)
+    {
+        lock = {}; // closed, letting the host go
+        return;
+    }
+
+    if (lock.isValid())
+        return;
+
+    QDBusInterface logind{logind_service, logind_path, logind_interface, QDBusConnection::systemBus()};
+    QDBusReply<QDBusUnixFileDescriptor> reply =
+        logind.call("Inhibit", "sleep", "Multipass", "Suspending instances", "delay");
+    if (reply.isValid())
+        lock = reply.value();
+    else
+        mpl::log(mpl::Level::debug, category,
+                 fmt::format("Cannot hold off host sleep: {}", reply.error().message().toStdString()));
+}
+
 auto mp::platform::detail::get_network_interfaces_from(const QDir& sys_dir)
     -> std::map<std::string, NetworkInterfaceInfo>
 {
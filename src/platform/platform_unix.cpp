@@ -26,6 +26,10 @@
 
 #include <libssh/sftp.h>
 
+#include <QStorageInfo>
+
+#include <algorithm>
+
 namespace mp = multipass;
 
 namespace
@@ -141,6 +145,18 @@ QString mp::platform::Platform::multipass_storage_location() const
     return mp::utils::get_multipass_storage();
 }
 
+auto mp::platform::Platform::host_capacity(const QString& storage_dir) const -> HostCapacity
+{
+    HostCapacity capacity;
+    capacity.cpus = static_cast<int>(std::max(0L, sysconf(_SC_NPROCESSORS_ONLN)));
+    if (const auto pages = sysconf(_SC_PHYS_PAGES), page_size = sysconf(_SC_PAGESIZE); pages > 0 && page_size > 0)
+        capacity.memory = static_cast<long long>(pages) * page_size;
+    if (QStorageInfo storage{QDir{storage_dir}}; storage.isValid())
+        capacity.disk = storage.bytesTotal();
+
+    return capacity;
+}
+
 int mp::platform::symlink_attr_from(const char* path, sftp_attributes_struct* attr)
 {
     struct stat st
@@ -21,6 +21,7 @@
 #include <multipass/update_prompt.h>
 #include <chrono>
 #include <memory>
+#include <mutex>
 
 namespace multipass
 {
@@ -42,6 +43,7 @@ public:
 private:
     std::unique_ptr<NewReleaseMonitor> monitor;
     std::chrono::system_clock::time_point last_shown;
+    std::mutex last_shown_mutex;
 };
 } // namespace multipass
 
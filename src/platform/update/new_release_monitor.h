@@ -25,6 +25,7 @@
 #include <QString>
 #include <QTimer>
 
+#include <mutex>
 #include <optional>
 
 namespace multipass
@@ -60,6 +61,7 @@ private slots:
 private:
     const QString current_version, update_url;
     std::optional<NewReleaseInfo> new_release;
+    mutable std::mutex new_release_mutex; // read-only requests ask for it off the main thread
     QTimer refresh_timer;
 
     qt_delete_later_unique_ptr<LatestReleaseChecker> worker_thread;
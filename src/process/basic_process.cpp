@@ -19,6 +19,10 @@
 #include <multipass/logging/log.h>
 #include <multipass/process/basic_process.h>
 
+#include <QTimer>
+
+#include <utility>
+
 namespace mp = multipass;
 namespace mpl = multipass::logging;
 
@@ -207,6 +211,40 @@ mp::ProcessState mp::BasicProcess::execute(const int timeout)
     return exit_state;
 }
 
+void mp::BasicProcess::execute_async(Callback on_finished, const int timeout)
+{
+    auto timer = new QTimer{this};
+    auto done = std::make_shared<bool>(false);
+    auto report = [this, timer, done, on_finished = std::move(on_finished)](const mp::ProcessState& exit_state) {
+        if (std::exchange(*done, true))
+            return;
+
+        timer->deleteLater();
+        if (exit_state.error)
+            mpl::log(mpl::Level::error, qUtf8Printable(process_spec->program()),
+                     qUtf8Printable(exit_state.error->message));
+
+        on_finished(exit_state);
+    };
+
+    connect(this, &mp::Process::finished, timer, report);
+    connect(this, &mp::Process::error_occurred, timer, [report](QProcess::ProcessError error, QString error_string) {
+        if (error == QProcess::FailedToStart)
+            report(mp::ProcessState{std::nullopt, mp::ProcessState::Error{error, error_string}});
+    });
+
+    // The whole run is bounded, rather than the start and the finish separately as with execute()
+    timer->setSingleShot(true);
+    connect(timer, &QTimer::timeout, this, [this, report] {
+        const auto message = QString{"program: %1; error: Process operation timed out"}.arg(process_spec->program());
+        report(mp::ProcessState{std::nullopt, mp::ProcessState::Error{QProcess::Timedout, message}});
+        process.kill();
+    });
+
+    timer->start(timeout);
+    start();
+}
+
 void mp::BasicProcess::setup_child_process()
 {
 }
@@ -46,6 +46,12 @@ mpl::Level mp::ProcessSpec::error_log_level() const
     return mpl::Level::warning;
 }
 
+// Whether the process is only started to be waited for, which lets it be spawned without copying this one
+bool mp::ProcessSpec::run_to_completion() const
+{
+    return false;
+}
+
 // For cases when multiple instances of this process need different AppArmor profiles, use this
 // identifier to distinguish them
 QString multipass::ProcessSpec::identifier() const
@@ -19,6 +19,8 @@
 #include <multipass/process/qemuimg_process_spec.h>
 #include <multipass/snap_utils.h>
 
+#include <QFileInfo>
+
 namespace mp = multipass;
 namespace mu = multipass::utils;
 
@@ -87,5 +89,10 @@ profile %1 flags=(attach_disconnected) {
     if (!target_image.isEmpty())
         images.append(QString("  %1 rwk,\n").arg(target_image));
 
+    // What either is an overlay of: instance snapshots are kept next to the image, and then next to one another
+    for (const auto& image : {source_image, target_image})
+        if (!image.isEmpty())
+            images.append(QString("  %1/{,snapshots/}*.qcow2 rk,\n").arg(QFileInfo{image}.absolutePath()));
+
     return profile_template.arg(apparmor_profile_name(), extra_capabilities, root_dir, program(), images, signal_peer);
 }
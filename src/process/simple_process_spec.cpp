@@ -24,7 +24,8 @@ namespace
 class SimpleProcessSpec : public mp::ProcessSpec
 {
 public:
-    SimpleProcessSpec(const QString& cmd, const QStringList& args) : cmd{cmd}, args{args}
+    SimpleProcessSpec(const QString& cmd, const QStringList& args, bool oneshot = false)
+        : cmd{cmd}, args{args}, oneshot{oneshot}
     {
     }
 
@@ -42,9 +43,15 @@ public:
         return QString();
     }
 
+    bool run_to_completion() const override
+    {
+        return oneshot;
+    }
+
 private:
     const QString cmd;
     const QStringList args;
+    const bool oneshot;
 };
 } // namespace
 
@@ -52,3 +59,8 @@ std::unique_ptr<mp::ProcessSpec> mp::simple_process_spec(const QString& cmd, con
 {
     return std::make_unique<::SimpleProcessSpec>(cmd, args);
 }
+
+std::unique_ptr<mp::ProcessSpec> mp::oneshot_process_spec(const QString& cmd, const QStringList& args)
+{
+    return std::make_unique<::SimpleProcessSpec>(cmd, args, /*oneshot=*/true);
+}
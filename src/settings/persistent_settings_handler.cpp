@@ -22,6 +22,8 @@
 #include <multipass/logging/log.h>
 #include <multipass/settings/persistent_settings_handler.h>
 
+#include <QFileInfo>
+
 #include <cassert>
 
 namespace mp = multipass;
@@ -58,10 +60,8 @@ void check_status(const mp::WrappedQSettings& qsettings, const QString& attempte
                                      : QStringLiteral("access error (consider running with an administrative role)")};
 }
 
-QString checked_get(mp::WrappedQSettings& qsettings, const QString& key, const mp::SettingSpec& spec, std::mutex& mutex)
+QString checked_get(mp::WrappedQSettings& qsettings, const QString& key, const mp::SettingSpec& spec)
 {
-    std::lock_guard<std::mutex> lock{mutex};
-
     const auto& fallback = spec.get_default();
     auto ret = qsettings.value(key, fallback).toString();
 
@@ -83,10 +83,8 @@ QString checked_get(mp::WrappedQSettings& qsettings, const QString& key, const m
     return ret;
 }
 
-void checked_set(mp::WrappedQSettings& qsettings, const QString& key, const QString& val, std::mutex& mutex)
+void checked_set(mp::WrappedQSettings& qsettings, const QString& key, const QString& val)
 {
-    std::lock_guard<std::mutex> lock{mutex};
-
     qsettings.setValue(key, val);
 
     qsettings.sync(); // flush to confirm we can write
@@ -97,14 +95,26 @@ void checked_set(mp::WrappedQSettings& qsettings, const QString& key, const QStr
 mp::PersistentSettingsHandler::PersistentSettingsHandler(QString filename, SettingSpec::Set settings)
     : filename{std::move(filename)}, settings{convert(std::move(settings))}
 {
+    // The directory too, for the file being created, or replaced as QSettings writes it
+    watcher.addPath(QFileInfo{this->filename}.absolutePath());
+    if (QFileInfo::exists(this->filename))
+        watcher.addPath(this->filename);
+
+    QObject::connect(&watcher, &QFileSystemWatcher::fileChanged, [this] { forget_values(); });
+    QObject::connect(&watcher, &QFileSystemWatcher::directoryChanged, [this] { forget_values(); });
 }
 
 // TODO try installing yaml backend
 QString mp::PersistentSettingsHandler::get(const QString& key) const
 {
     const auto& setting_spec = get_setting(key); // make sure the key is valid before reading from disk
+
+    std::lock_guard<std::mutex> lock{mutex};
+    if (const auto it = cached.find(key); it != cached.end())
+        return it->second;
+
     auto settings_file = persistent_settings(filename);
-    return checked_get(*settings_file, key, setting_spec, mutex);
+    return cached[key] = checked_get(*settings_file, key, setting_spec);
 }
 
 auto mp::PersistentSettingsHandler::get_setting(const QString& key) const -> const SettingSpec&
@@ -124,8 +134,73 @@ void mp::PersistentSettingsHandler::set(const QString& key, const QString& val)
 {
     auto interpreted = get_setting(key).interpret(val); // check both key and value validity, convert as appropriate
 
+    std::lock_guard<std::mutex> lock{mutex};
+    cached.erase(key); // whether or not it makes it to the file
+
+    auto settings_file = persistent_settings(filename);
+    checked_set(*settings_file, key, interpreted);
+    cached[key] = interpreted;
+}
+
+std::map<QString, QString> mp::PersistentSettingsHandler::get_values(const std::set<QString>& keys) const
+{
+    std::map<QString, QString> ret;
+    std::unique_ptr<WrappedQSettings> settings_file; // only if some aren't known already
+
+    std::lock_guard<std::mutex> lock{mutex};
+    for (const auto& key : keys)
+    {
+        const auto setting = settings.find(key);
+        if (setting == settings.end())
+            continue;
+
+        if (const auto it = cached.find(key); it != cached.end())
+        {
+            ret.emplace(key, it->second);
+            continue;
+        }
+
+        if (!settings_file)
+            settings_file = persistent_settings(filename);
+
+        ret.emplace(key, cached[key] = checked_get(*settings_file, key, *setting->second));
+    }
+
+    return ret;
+}
+
+void mp::PersistentSettingsHandler::set_values(const std::map<QString, QString>& values)
+{
+    // All checked before any is written
+    std::map<QString, QString> interpreted;
+    for (const auto& [key, val] : values)
+        if (const auto setting = settings.find(key); setting != settings.end())
+            interpreted.emplace(key, setting->second->interpret(val));
+
+    if (interpreted.empty())
+        return;
+
+    std::lock_guard<std::mutex> lock{mutex};
+    for (const auto& [key, val] : interpreted)
+        cached.erase(key); // whether or not they make it to the file
+
     auto settings_file = persistent_settings(filename);
-    checked_set(*settings_file, key, interpreted, mutex);
+    for (const auto& [key, val] : interpreted)
+        settings_file->setValue(key, val);
+
+    settings_file->sync(); // flush to confirm we can write
+    check_status(*settings_file, QStringLiteral("read/write"));
+
+    cached.merge(interpreted);
+}
+
+void mp::PersistentSettingsHandler::forget_values()
+{
+    std::lock_guard<std::mutex> lock{mutex};
+    cached.clear();
+
+    if (!watcher.files().contains(filename) && QFileInfo::exists(filename))
+        watcher.addPath(filename);
 }
 
 std::set<QString> mp::PersistentSettingsHandler::keys() const
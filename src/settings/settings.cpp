@@ -17,11 +17,45 @@
 
 #include <multipass/settings/settings.h>
 
+#include <algorithm>
 #include <memory>
 #include <stdexcept>
 
 namespace mp = multipass;
 
+std::map<QString, QString> mp::SettingsHandler::get_values(const std::set<QString>& keys) const
+{
+    std::map<QString, QString> ret;
+    for (const auto& key : keys)
+    {
+        try
+        {
+            ret.emplace(key, get(key));
+        }
+        catch (const UnrecognizedSettingException&)
+        {
+            continue;
+        }
+    }
+
+    return ret;
+}
+
+void mp::SettingsHandler::set_values(const std::map<QString, QString>& values)
+{
+    for (const auto& [key, val] : values)
+    {
+        try
+        {
+            set(key, val);
+        }
+        catch (const UnrecognizedSettingException&)
+        {
+            continue;
+        }
+    }
+}
+
 mp::Settings::Settings(const Singleton<Settings>::PrivatePass& pass) : Singleton<Settings>::Singleton{pass}
 {
 }
@@ -104,3 +138,38 @@ void mp::Settings::set(const QString& key, const QString& val)
     if (!success)
         throw UnrecognizedSettingException{key};
 }
+
+std::map<QString, QString> mp::Settings::get_values(const std::set<QString>& keys) const
+{
+    std::map<QString, QString> ret;
+    auto remaining = keys;
+    for (auto it = handlers.cbegin(); it != handlers.cend() && !remaining.empty(); ++it)
+    {
+        assert(*it && "can't have null settings handler"); // TODO use a `not_null` type (e.g. gsl::not_null)
+        for (auto& [key, val] : (*it)->get_values(remaining))
+        {
+            remaining.erase(key);
+            ret.emplace(key, std::move(val));
+        }
+    }
+
+    if (!remaining.empty())
+        throw UnrecognizedSettingException{*remaining.cbegin()};
+
+    return ret;
+}
+
+void mp::Settings::set_values(const std::map<QString, QString>& values)
+{
+    // Up front, so that none are set if any would be refused
+    const auto known = keys();
+    for (const auto& [key, val] : values)
+        if (!known.count(key))
+            throw UnrecognizedSettingException{key};
+
+    for (const auto& handler : handlers) // all handlers get a chance to react, as with single settings
+    {
+        assert(handler && "can't have null settings handler"); // TODO use a `not_null` type (e.g. gsl::not_null)
+        handler->set_values(values);
+    }
+}
@@ -17,10 +17,12 @@
 
 #include <multipass/simple_streams_manifest.h>
 
+#include <QDataStream>
 #include <QFileInfo>
 #include <QHash>
 #include <QJsonDocument>
 #include <QJsonObject>
+#include <QSet>
 #include <QSysInfo>
 
 #include <multipass/constants.h>
@@ -28,6 +30,8 @@
 #include <multipass/settings/settings.h>
 #include <multipass/utils.h>
 
+#include <algorithm>
+
 namespace mp = multipass;
 
 namespace
@@ -36,6 +40,84 @@ const QHash<QString, QString> arch_to_manifest{{"x86_64", "amd64"}, {"arm", "arm
                                                {"i386", "i386"},    {"power", "powerpc"}, {"power64", "ppc64el"},
                                                {"s390x", "s390x"}};
 
+constexpr quint32 snapshot_magic = 0x4d505353; // "MPSS"
+constexpr quint32 snapshot_version = 2;
+constexpr auto snapshot_stream_version = QDataStream::Qt_5_12;
+
+QString current_arch()
+{
+    return arch_to_manifest.value(QSysInfo::currentCpuArchitecture());
+}
+
+// Hands out one shared copy of each distinct string. Releases, titles, versions and the like repeat across products
+// and versions, and QStrings that are copies of one another keep a single buffer between them.
+class StringPool
+{
+public:
+    QString operator()(const QString& string)
+    {
+        if (const auto it = strings.constFind(string); it != strings.constEnd())
+            return *it;
+
+        strings.insert(string);
+        return string;
+    }
+
+    QStringList operator()(QStringList list)
+    {
+        for (auto& string : list)
+            string = (*this)(string);
+
+        return list;
+    }
+
+private:
+    QSet<QString> strings;
+};
+
+// The strings of the products, each of them once, for the snapshot to refer to by index
+class StringTable
+{
+public:
+    quint32 index_of(const QString& string)
+    {
+        auto it = indices.constFind(string);
+        if (it == indices.constEnd())
+        {
+            it = indices.insert(string, strings.size());
+            strings.append(string);
+        }
+
+        return *it;
+    }
+
+    const QStringList& all() const
+    {
+        return strings;
+    }
+
+private:
+    QHash<QString, quint32> indices;
+    QStringList strings;
+};
+
+std::unique_ptr<mp::SimpleStreamsManifest> make_manifest(const QString& updated, std::vector<mp::VMImageInfo> products)
+{
+    QMap<QString, const mp::VMImageInfo*> map;
+
+    for (const auto& product : products)
+    {
+        map[product.id] = &product;
+        for (const auto& alias : product.aliases)
+        {
+            map[alias] = &product;
+        }
+    }
+
+    return std::unique_ptr<mp::SimpleStreamsManifest>(
+        new mp::SimpleStreamsManifest{updated, std::move(products), std::move(map)});
+}
+
 QJsonObject parse_manifest(const QByteArray& json)
 {
     QJsonParseError parse_error;
@@ -73,7 +155,7 @@ mp::SimpleStreamsManifest::fromJson(const QByteArray& json_from_official,
     if (manifest_products_from_official.isEmpty())
         throw mp::GenericManifestException("No products found");
 
-    auto arch = arch_to_manifest.value(QSysInfo::currentCpuArchitecture());
+    auto arch = current_arch();
 
     if (arch.isEmpty())
         throw mp::GenericManifestException("Unsupported cloud image architecture");
@@ -88,6 +170,10 @@ mp::SimpleStreamsManifest::fromJson(const QByteArray& json_from_official,
 
     const QJsonObject manifest_products = manifest_products_from_mirror.value_or(manifest_products_from_official);
 
+    StringPool intern;
+    const auto os = intern("Ubuntu");
+    const auto stream_location = intern(host_url);
+
     std::vector<VMImageInfo> products;
     for (auto it = manifest_products.constBegin(); it != manifest_products.constEnd(); ++it)
     {
@@ -97,10 +183,10 @@ mp::SimpleStreamsManifest::fromJson(const QByteArray& json_from_official,
         if (product["arch"].toString() != arch)
             continue;
 
-        const auto product_aliases = product["aliases"].toString().split(",");
+        const auto product_aliases = intern(product["aliases"].toString().split(","));
 
-        const auto release = product["release"].toString();
-        const auto release_title = product["release_title"].toString();
+        const auto release = intern(product["release"].toString());
+        const auto release_title = intern(product["release_title"].toString());
         const auto supported = product["supported"].toBool();
 
         const auto versions = product["versions"].toObject();
@@ -155,25 +241,129 @@ mp::SimpleStreamsManifest::fromJson(const QByteArray& json_from_official,
 
             // Aliases always alias to the latest version
             const QStringList& aliases = version_string == latest_version ? product_aliases : QStringList();
-            products.push_back({aliases, "Ubuntu", release, release_title, supported, image_location, sha256, host_url,
-                                version_string, size, true});
+            products.push_back({aliases, os, release, release_title, supported, image_location, sha256, stream_location,
+                                intern(version_string), size, true});
         }
     }
 
     if (products.empty())
         throw mp::EmptyManifestException("No supported products found.");
 
-    QMap<QString, const VMImageInfo*> map;
+    return make_manifest(updated, std::move(products));
+}
 
-    for (const auto& product : products)
+std::unique_ptr<mp::SimpleStreamsManifest> mp::SimpleStreamsManifest::fromSnapshot(const QByteArray& snapshot)
+{
+    QDataStream stream{snapshot};
+    stream.setVersion(snapshot_stream_version);
+
+    quint32 magic, version;
+    QString arch, driver, updated;
+    QStringList strings;
+    quint32 num_products;
+    stream >> magic >> version;
+    if (magic != snapshot_magic || version != snapshot_version)
+        return nullptr;
+
+    stream >> arch >> driver >> updated >> strings >> num_products;
+    if (stream.status() != QDataStream::Ok || arch != current_arch() || driver != MP_SETTINGS.get(mp::driver_key))
+        return nullptr;
+
+    // Products refer to the strings they share, so that they come out shared, as they were parsed
+    auto bad_index = false;
+    auto read_string = [&stream, &strings, &bad_index] {
+        quint32 index{0};
+        stream >> index;
+        bad_index = bad_index || index >= static_cast<quint32>(strings.size());
+        return bad_index ? QString{} : strings[index];
+    };
+
+    std::vector<VMImageInfo> products;
+    products.reserve(std::min<quint32>(num_products, snapshot.size()));
+    for (quint32 i = 0; i < num_products && stream.status() == QDataStream::Ok && !bad_index; ++i)
     {
-        map[product.id] = &product;
-        for (const auto& alias : product.aliases)
+        VMImageInfo info;
+        quint32 num_aliases;
+        stream >> num_aliases;
+        for (quint32 j = 0; j < num_aliases && stream.status() == QDataStream::Ok && !bad_index; ++j)
+            info.aliases.append(read_string());
+
+        qint64 size;
+        info.os = read_string();
+        info.release = read_string();
+        info.release_title = read_string();
+        stream >> info.supported;
+        info.image_location = read_string();
+        info.id = read_string();
+        info.stream_location = read_string();
+        info.version = read_string();
+        stream >> size >> info.verify;
+        info.size = size;
+        products.push_back(std::move(info));
+    }
+
+    if (stream.status() != QDataStream::Ok || bad_index || !stream.atEnd() || products.empty())
+        return nullptr;
+
+    return make_manifest(updated, std::move(products));
+}
+
+QByteArray mp::SimpleStreamsManifest::toSnapshot() const
+{
+    QByteArray snapshot;
+    QDataStream stream{&snapshot, QIODevice::WriteOnly};
+    stream.setVersion(snapshot_stream_version);
+
+    StringTable table;
+    for (const auto& info : products)
+    {
+        for (const auto& alias : info.aliases)
+            table.index_of(alias);
+        for (const auto& string : {info.os, info.release, info.release_title, info.image_location, info.id,
+                                   info.stream_location, info.version})
+            table.index_of(string);
+    }
+
+    stream << snapshot_magic << snapshot_version << current_arch() << MP_SETTINGS.get(mp::driver_key) << updated_at
+           << table.all() << static_cast<quint32>(products.size());
+    for (const auto& info : products)
+    {
+        stream << static_cast<quint32>(info.aliases.size());
+        for (const auto& alias : info.aliases)
+            stream << table.index_of(alias);
+
+        stream << table.index_of(info.os) << table.index_of(info.release) << table.index_of(info.release_title)
+               << info.supported << table.index_of(info.image_location) << table.index_of(info.id)
+               << table.index_of(info.stream_location) << table.index_of(info.version)
+               << static_cast<qint64>(info.size) << info.verify;
+    }
+
+    return snapshot;
+}
+
+std::size_t mp::SimpleStreamsManifest::memory_footprint() const
+{
+    QSet<const QChar*> counted;
+    auto bytes = sizeof(*this) + products.capacity() * sizeof(VMImageInfo) +
+                 static_cast<std::size_t>(image_records.size()) * (sizeof(QString) + sizeof(VMImageInfo*));
+    const auto count = [&counted, &bytes](const QString& string) {
+        if (!string.isEmpty() && !counted.contains(string.constData()))
         {
-            map[alias] = &product;
+            counted.insert(string.constData());
+            bytes += static_cast<std::size_t>(string.capacity()) * sizeof(QChar);
         }
+    };
+
+    count(updated_at);
+    for (const auto& info : products)
+    {
+        bytes += static_cast<std::size_t>(info.aliases.size()) * sizeof(QString);
+        for (const auto& alias : info.aliases)
+            count(alias);
+        for (const auto* string : {&info.os, &info.release, &info.release_title, &info.image_location, &info.id,
+                                   &info.stream_location, &info.version})
+            count(*string);
     }
 
-    return std::unique_ptr<SimpleStreamsManifest>(
-        new SimpleStreamsManifest{updated, std::move(products), std::move(map)});
+    return bytes;
 }
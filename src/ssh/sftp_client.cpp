@@ -18,21 +18,227 @@
 #include <multipass/ssh/sftp_client.h>
 
 #include "ssh_client_key_provider.h"
+#include <multipass/checksum.h>
 #include <multipass/file_ops.h>
 #include <multipass/logging/log.h>
 #include <multipass/ssh/sftp_utils.h>
 #include <multipass/ssh/throw_on_error.h>
 #include <multipass/utils.h>
 
+
+#include <algorithm>
 #include <array>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <deque>
 #include <fcntl.h>
 #include <fmt/std.h>
+#include <mutex>
+#include <optional>
+#include <thread>
 
 constexpr int file_mode = 0664;
 constexpr auto max_transfer = 65536u;
+constexpr auto default_transfer_window = 16;
+constexpr auto max_transfer_window = 256;
 const std::string stream_file_name{"stream_output.dat"};
 const char* log_category = "sftp";
 
+namespace
+{
+namespace fs = multipass::fs;
+
+// There is no clock_cast before C++20, but both clocks tick alike, so the offset between them only needs taking once
+std::chrono::microseconds file_clock_offset()
+{
+    using namespace std::chrono;
+    static const auto offset = duration_cast<microseconds>(system_clock::now().time_since_epoch()) -
+                               duration_cast<microseconds>(fs::file_time_type::clock::now().time_since_epoch());
+    return offset;
+}
+
+std::int64_t to_epoch_seconds(fs::file_time_type time)
+{
+    const auto since_epoch = std::chrono::duration_cast<std::chrono::microseconds>(time.time_since_epoch());
+    return std::chrono::round<std::chrono::seconds>(since_epoch + file_clock_offset()).count();
+}
+
+fs::file_time_type from_epoch_seconds(std::int64_t seconds)
+{
+    return fs::file_time_type{
+        std::chrono::duration_cast<fs::file_time_type::duration>(std::chrono::seconds{seconds} - file_clock_offset())};
+}
+
+// What syncing compares to tell whether a file needs copying again, with times in whole seconds as SFTP has them
+struct FileStamp
+{
+    std::uintmax_t size;
+    std::int64_t mtime;
+    fs::perms perms;
+
+    bool operator==(const FileStamp& other) const
+    {
+        return size == other.size && mtime == other.mtime;
+    }
+};
+
+std::optional<FileStamp> stamp_of_local(const fs::path& path)
+{
+    std::error_code err;
+    const auto size = MP_FILEOPS.file_size(path, err);
+    if (err)
+        return std::nullopt;
+
+    const auto mtime = MP_FILEOPS.last_write_time(path, err);
+    if (err)
+        return std::nullopt;
+
+    const auto status = MP_FILEOPS.status(path, err);
+    if (err)
+        return std::nullopt;
+
+    return FileStamp{size, to_epoch_seconds(mtime), status.permissions()};
+}
+
+std::optional<FileStamp> stamp_of_remote(sftp_session sftp, const fs::path& path)
+{
+    auto attr = multipass::mp_sftp_stat(sftp, path.u8string().c_str());
+    if (!attr || attr->type != SSH_FILEXFER_TYPE_REGULAR)
+        return std::nullopt;
+
+    return FileStamp{attr->size, attr->mtime, static_cast<fs::perms>(attr->permissions) & fs::perms::mask};
+}
+
+// Empty when the file can't be read that far
+std::string local_prefix_hash(const fs::path& path, std::uintmax_t size)
+{
+    auto file = MP_FILEOPS.open_read(path, std::ios_base::in | std::ios_base::binary);
+    multipass::checksum::Sha256 hash;
+    std::array<char, max_transfer> buffer{};
+    for (auto left = size; left > 0;)
+    {
+        const auto r = file->read(buffer.data(), std::min<std::uintmax_t>(left, buffer.size())).gcount();
+        if (r <= 0)
+            return {};
+
+        hash.add_data(buffer.data(), r);
+        left -= r;
+    }
+
+    return hash.hex_digest();
+}
+
+// Hashed inside the instance, reading the whole prefix back over the link would defeat the purpose of resuming
+std::string remote_prefix_hash(multipass::SSHSession& session, const fs::path& path, std::uintmax_t size)
+try
+{
+    const auto cmd =
+        fmt::format("head -c {} -- {} | sha256sum", size, multipass::utils::escape_for_shell(path.u8string()));
+    const auto output = multipass::utils::run_in_ssh_session(session, cmd);
+    return output.substr(0, output.find(' '));
+}
+catch (const std::exception& e)
+{
+    multipass::logging::log(multipass::logging::Level::debug, log_category,
+                            fmt::format("cannot hash remote file {}: {}", path, e.what()));
+    return {};
+}
+
+// A partial target is only picked up where its content matches the start of the source
+bool same_prefix(multipass::SSHSession& session, const fs::path& local_path, const fs::path& remote_path,
+                 std::uintmax_t size)
+{
+    const auto local_hash = local_prefix_hash(local_path, size);
+    return !local_hash.empty() && local_hash == remote_prefix_hash(session, remote_path, size);
+}
+
+// Hands files out to whichever client is free, so that a few big ones don't hold up the rest. Without any clients of
+// its own, files are copied right away with the fallback one, and errors are left to the caller.
+class ParallelCopier
+{
+public:
+    using Copy = std::function<void(multipass::SFTPClient&)>;
+
+    ParallelCopier(multipass::SFTPClient& fallback, std::vector<std::unique_ptr<multipass::SFTPClient>> clients)
+        : fallback{fallback}, clients{std::move(clients)}
+    {
+        for (const auto& client : this->clients)
+            workers.emplace_back([this, &client = *client] { work(client); });
+    }
+
+    ~ParallelCopier()
+    {
+        finish();
+    }
+
+    void add(Copy copy)
+    {
+        if (workers.empty())
+            return copy(fallback);
+
+        {
+            std::lock_guard<std::mutex> lock{mutex};
+            copies.push_back(std::move(copy));
+        }
+        cv.notify_one();
+    }
+
+    // Waits for every file to be copied, returns whether they all were
+    bool finish()
+    {
+        {
+            std::lock_guard<std::mutex> lock{mutex};
+            done = true;
+        }
+        cv.notify_all();
+
+        for (auto& worker : workers)
+            if (worker.joinable())
+                worker.join();
+
+        return success;
+    }
+
+private:
+    void work(multipass::SFTPClient& client)
+    {
+        while (true)
+        {
+            Copy copy;
+            {
+                std::unique_lock<std::mutex> lock{mutex};
+                cv.wait(lock, [this] { return done || !copies.empty(); });
+                if (copies.empty())
+                    return;
+
+                copy = std::move(copies.front());
+                copies.pop_front();
+            }
+
+            try
+            {
+                copy(client);
+            }
+            catch (const std::exception& e)
+            {
+                multipass::logging::log(multipass::logging::Level::error, log_category, e.what());
+                success = false;
+            }
+        }
+    }
+
+    multipass::SFTPClient& fallback;
+    std::vector<std::unique_ptr<multipass::SFTPClient>> clients;
+    std::vector<std::thread> workers;
+    std::mutex mutex;
+    std::condition_variable cv;
+    std::deque<Copy> copies;
+    bool done{false};
+    std::atomic_bool success{true};
+};
+} // namespace
+
 namespace multipass
 {
 namespace mpl = logging;
@@ -46,17 +252,35 @@ SFTPSessionUPtr make_sftp_session(ssh_session session)
     return sftp;
 }
 
-SFTPClient::SFTPClient(const std::string& host, int port, const std::string& username, const std::string& priv_key_blob)
-    : SFTPClient{std::make_unique<SSHSession>(host, port, username, SSHClientKeyProvider(priv_key_blob))}
+SFTPClient::SFTPClient(const std::string& host, int port, const std::string& username, const std::string& priv_key_blob,
+                       bool compression, const std::string& ciphers)
+    : SFTPClient{std::make_unique<SSHSession>(host, port, username, SSHClientKeyProvider(priv_key_blob),
+                                              std::chrono::seconds(20), compression, ciphers)}
 {
+    make_ssh_session = [host, port, username, priv_key_blob, compression, ciphers] {
+        return std::make_unique<SSHSession>(host, port, username, SSHClientKeyProvider(priv_key_blob),
+                                            std::chrono::seconds(20), compression, ciphers);
+    };
 }
 
 SFTPClient::SFTPClient(SSHSessionUPtr ssh_session)
-    : ssh_session{std::move(ssh_session)}, sftp{make_sftp_session(*this->ssh_session)}
+    : ssh_session{std::move(ssh_session)},
+      sftp{make_sftp_session(*this->ssh_session)},
+      transfer_window{default_transfer_window}
 {
     SSH::throw_on_error(sftp, *this->ssh_session, "[sftp] init failed", sftp_init);
 }
 
+void SFTPClient::set_parallel_transfers(int count)
+{
+    parallel_transfers = count;
+}
+
+void SFTPClient::set_transfer_window(int window)
+{
+    transfer_window = std::clamp(window, 1, max_transfer_window);
+}
+
 bool SFTPClient::is_remote_dir(const fs::path& path)
 {
     auto attr = mp_sftp_stat(sftp.get(), path.u8string().c_str());
@@ -77,14 +301,14 @@ try
 
         auto full_target_path = MP_SFTPUTILS.get_remote_dir_target(sftp.get(), source, target_path,
                                                                    flags.testFlag(SFTPClient::Flag::MakeParent));
-        return push_dir(source, full_target_path);
+        return push_dir(source, full_target_path, flags);
     }
     else if (err)
         throw SFTPError{"cannot access {}: {}", source_path, err.message()};
 
     auto full_target_path = MP_SFTPUTILS.get_remote_file_target(sftp.get(), source, target_path,
                                                                 flags.testFlag(SFTPClient::Flag::MakeParent));
-    push_file(source, full_target_path);
+    push_file(source, full_target_path, flags);
     return true;
 }
 catch (const SFTPError& e)
@@ -106,12 +330,12 @@ try
 
         auto full_target_path =
             MP_SFTPUTILS.get_local_dir_target(source, target_path, flags.testFlag(SFTPClient::Flag::MakeParent));
-        return pull_dir(source, full_target_path);
+        return pull_dir(source, full_target_path, flags);
     }
 
     auto full_target_path =
         MP_SFTPUTILS.get_local_file_target(source, target_path, flags.testFlag(SFTPClient::Flag::MakeParent));
-    pull_file(source, full_target_path);
+    pull_file(source, full_target_path, flags);
     return true;
 }
 catch (const SFTPError& e)
@@ -120,13 +344,29 @@ catch (const SFTPError& e)
     return false;
 }
 
-void SFTPClient::push_file(const fs::path& source_path, const fs::path& target_path)
+void SFTPClient::push_file(const fs::path& source_path, const fs::path& target_path, const Flags flags)
 {
+    const auto sync = flags.testFlag(Flag::Sync);
+    const auto local_stamp = sync ? stamp_of_local(source_path) : std::nullopt;
+    if (const auto remote_stamp = sync ? stamp_of_remote(sftp.get(), target_path) : std::nullopt;
+        local_stamp && local_stamp == remote_stamp)
+    {
+        mpl::log(mpl::Level::debug, log_category, fmt::format("skipping unchanged file {}", source_path));
+        if (local_stamp->perms != remote_stamp->perms &&
+            sftp_chmod(sftp.get(), target_path.u8string().c_str(), static_cast<mode_t>(local_stamp->perms)) !=
+                SSH_FX_OK)
+            throw SFTPError{"cannot set permissions for remote file {}: {}", target_path,
+                            ssh_get_error(sftp->session)};
+        return;
+    }
+
+    const auto offset = flags.testFlag(Flag::Resume) ? push_resume_offset(source_path, target_path) : 0;
+
     auto local_file = MP_FILEOPS.open_read(source_path, std::ios_base::in | std::ios_base::binary);
     if (local_file->fail())
         throw SFTPError{"cannot open local file {}: {}", source_path, strerror(errno)};
 
-    do_push_file(*local_file, target_path);
+    do_push_file(*local_file, target_path, offset);
 
     std::error_code _;
     auto status = MP_FILEOPS.status(source_path, _);
@@ -135,26 +375,58 @@ void SFTPClient::push_file(const fs::path& source_path, const fs::path& target_p
 
     if (local_file->fail() && !local_file->eof())
         throw SFTPError{"cannot read from local file {}: {}", source_path, strerror(errno)};
+
+    // So that the next sync can tell the file is unchanged
+    if (local_stamp)
+    {
+        sftp_attributes_struct attr{};
+        attr.flags = SSH_FILEXFER_ATTR_ACMODTIME;
+        attr.atime = attr.mtime = static_cast<std::uint32_t>(local_stamp->mtime);
+        if (sftp_setstat(sftp.get(), target_path.u8string().c_str(), &attr) != SSH_FX_OK)
+            throw SFTPError{"cannot set modification time for remote file {}: {}", target_path,
+                            ssh_get_error(sftp->session)};
+    }
 }
 
-void SFTPClient::pull_file(const fs::path& source_path, const fs::path& target_path)
+void SFTPClient::pull_file(const fs::path& source_path, const fs::path& target_path, const Flags flags)
 {
-    auto local_file = MP_FILEOPS.open_write(target_path, std::ios_base::out | std::ios_base::binary);
+    const auto sync = flags.testFlag(Flag::Sync);
+    const auto remote_stamp = sync ? stamp_of_remote(sftp.get(), source_path) : std::nullopt;
+    std::error_code err;
+    if (remote_stamp && remote_stamp == stamp_of_local(target_path))
+    {
+        mpl::log(mpl::Level::debug, log_category, fmt::format("skipping unchanged file {}", source_path));
+        if (MP_FILEOPS.permissions(target_path, remote_stamp->perms, err); err)
+            throw SFTPError{"cannot set permissions for local file {}: {}", target_path, err.message()};
+        return;
+    }
+
+    const auto offset = flags.testFlag(Flag::Resume) ? pull_resume_offset(source_path, target_path) : 0;
+
+    const auto append = offset > 0 ? std::ios_base::app : std::ios_base::trunc;
+    auto local_file = MP_FILEOPS.open_write(target_path, std::ios_base::out | std::ios_base::binary | append);
     if (local_file->fail())
         throw SFTPError{"cannot open local file {}: {}", target_path, strerror(errno)};
 
-    do_pull_file(source_path, *local_file);
+    do_pull_file(source_path, *local_file, offset);
 
     auto source_perms = mp_sftp_stat(sftp.get(), source_path.u8string().c_str())->permissions;
-    std::error_code err;
     if (MP_FILEOPS.permissions(target_path, static_cast<fs::perms>(source_perms), err); err)
         throw SFTPError{"cannot set permissions for local file {}: {}", target_path, err.message()};
 
     if (local_file->fail())
         throw SFTPError{"cannot write to local file {}: {}", target_path, strerror(errno)};
+
+    // So that the next sync can tell the file is unchanged; closing it first, or the last flush would touch it again
+    if (remote_stamp)
+    {
+        local_file.reset();
+        if (MP_FILEOPS.last_write_time(target_path, from_epoch_seconds(remote_stamp->mtime), err); err)
+            throw SFTPError{"cannot set modification time for local file {}: {}", target_path, err.message()};
+    }
 }
 
-bool SFTPClient::push_dir(const fs::path& source_path, const fs::path& target_path)
+bool SFTPClient::push_dir(const fs::path& source_path, const fs::path& target_path, const Flags flags)
 {
     auto success = true;
     std::error_code err;
@@ -163,6 +435,8 @@ bool SFTPClient::push_dir(const fs::path& source_path, const fs::path& target_pa
     if (err)
         throw SFTPError{"cannot open local directory {}: {}", source_path, err.message()};
 
+    ParallelCopier copier{*this, make_parallel_clients()};
+
     std::vector<std::pair<fs::path, fs::perms>> subdirectory_perms{
         {target_path, MP_FILEOPS.status(source_path, err).permissions()}};
 
@@ -181,7 +455,9 @@ bool SFTPClient::push_dir(const fs::path& source_path, const fs::path& target_pa
             {
             case fs::file_type::regular:
             {
-                push_file(entry.path(), remote_file_path);
+                copier.add([source = entry.path(), remote_file_path, flags](SFTPClient& client) {
+                    client.push_file(source, remote_file_path, flags);
+                });
                 break;
             }
             case fs::file_type::directory:
@@ -223,6 +499,9 @@ bool SFTPClient::push_dir(const fs::path& source_path, const fs::path& target_pa
         }
     }
 
+    // Permissions are only fixed once everything is in, in case they keep files from being written
+    success &= copier.finish();
+
     for (auto it = subdirectory_perms.crbegin(); it != subdirectory_perms.crend(); ++it)
     {
         const auto& [path, perms] = *it;
@@ -238,12 +517,13 @@ bool SFTPClient::push_dir(const fs::path& source_path, const fs::path& target_pa
     return success;
 }
 
-bool SFTPClient::pull_dir(const fs::path& source_path, const fs::path& target_path)
+bool SFTPClient::pull_dir(const fs::path& source_path, const fs::path& target_path, const Flags flags)
 {
     auto success = true;
     std::error_code err;
 
     auto remote_iter = MP_SFTPUTILS.make_SFTPDirIterator(sftp.get(), source_path);
+    ParallelCopier copier{*this, make_parallel_clients()};
 
     std::vector<std::pair<fs::path, mode_t>> subdirectory_perms{
         {target_path, mp_sftp_stat(sftp.get(), source_path.u8string().c_str())->permissions}};
@@ -259,7 +539,9 @@ bool SFTPClient::pull_dir(const fs::path& source_path, const fs::path& target_pa
             {
             case SSH_FILEXFER_TYPE_REGULAR:
             {
-                pull_file(entry->name, local_file_path);
+                copier.add([source = fs::path{entry->name}, local_file_path, flags](SFTPClient& client) {
+                    client.pull_file(source, local_file_path, flags);
+                });
                 break;
             }
             case SSH_FILEXFER_TYPE_DIRECTORY:
@@ -296,6 +578,8 @@ bool SFTPClient::pull_dir(const fs::path& source_path, const fs::path& target_pa
         }
     }
 
+    success &= copier.finish();
+
     for (auto it = subdirectory_perms.crbegin(); it != subdirectory_perms.crend(); ++it)
     {
         const auto& [path, perms] = *it;
@@ -322,33 +606,138 @@ void SFTPClient::to_cout(const fs::path& source_path, std::ostream& cout)
     do_pull_file(source_path, cout);
 }
 
-void SFTPClient::do_push_file(std::istream& source, const fs::path& target_path)
+std::uintmax_t SFTPClient::push_resume_offset(const fs::path& source_path, const fs::path& target_path)
 {
+    std::error_code err;
+    const auto local_size = MP_FILEOPS.file_size(source_path, err);
+    const auto remote_stamp = stamp_of_remote(sftp.get(), target_path);
+    if (err || !remote_stamp || remote_stamp->size == 0 || remote_stamp->size > local_size ||
+        !same_prefix(*ssh_session, source_path, target_path, remote_stamp->size))
+        return 0;
+
+    mpl::log(mpl::Level::debug, log_category,
+             fmt::format("resuming {} at byte {} of {}", source_path, remote_stamp->size, local_size));
+    return remote_stamp->size;
+}
+
+std::uintmax_t SFTPClient::pull_resume_offset(const fs::path& source_path, const fs::path& target_path)
+{
+    std::error_code err;
+    const auto local_size = MP_FILEOPS.file_size(target_path, err);
+    const auto remote_stamp = stamp_of_remote(sftp.get(), source_path);
+    if (err || !remote_stamp || local_size == 0 || local_size > remote_stamp->size ||
+        !same_prefix(*ssh_session, target_path, source_path, local_size))
+        return 0;
+
+    mpl::log(mpl::Level::debug, log_category,
+             fmt::format("resuming {} at byte {} of {}", source_path, local_size, remote_stamp->size));
+    return local_size;
+}
+
+void SFTPClient::do_push_file(std::istream& source, const fs::path& target_path, std::uintmax_t offset)
+{
+    const auto truncate = offset > 0 ? 0 : O_TRUNC;
     auto remote_file =
-        mp_sftp_open(sftp.get(), target_path.u8string().c_str(), O_WRONLY | O_CREAT | O_TRUNC, file_mode);
+        mp_sftp_open(sftp.get(), target_path.u8string().c_str(), O_WRONLY | O_CREAT | truncate, file_mode);
     if (!remote_file)
         throw SFTPError{"cannot open remote file {}: {}", target_path, ssh_get_error(sftp->session)};
 
+    if (offset > 0)
+    {
+        source.seekg(offset);
+        if (sftp_seek64(remote_file.get(), offset) < 0)
+            throw SFTPError{"cannot seek in remote file {}: {}", target_path, ssh_get_error(sftp->session)};
+    }
+
     std::array<char, max_transfer> buffer{};
     while (auto r = source.read(buffer.data(), buffer.size()).gcount())
         if (sftp_write(remote_file.get(), buffer.data(), r) < 0)
             throw SFTPError{"cannot write to remote file {}: {}", target_path, ssh_get_error(sftp->session)};
 }
 
-void SFTPClient::do_pull_file(const fs::path& source_path, std::ostream& target)
+void SFTPClient::do_pull_file(const fs::path& source_path, std::ostream& target, std::uintmax_t offset)
 {
     auto remote_file = mp_sftp_open(sftp.get(), source_path.u8string().c_str(), O_RDONLY, 0);
     if (!remote_file)
         throw SFTPError{"cannot open remote file {}: {}", source_path, ssh_get_error(sftp->session)};
 
+    // Reads are asked for ahead of time, so that waiting on each round trip doesn't bound the throughput
+    std::deque<std::pair<int, std::uint64_t>> in_flight; // request id and offset
+    std::uint64_t next_offset{offset};
+
+    auto request_more = [&] {
+        while (in_flight.size() < static_cast<std::size_t>(transfer_window))
+        {
+            // Each read is at the offset the file had when it was asked for
+            sftp_seek64(remote_file.get(), next_offset);
+            const auto id = sftp_async_read_begin(remote_file.get(), max_transfer);
+            if (id < 0)
+                throw SFTPError{"cannot read from remote file {}: {}", source_path, ssh_get_error(sftp->session)};
+
+            in_flight.emplace_back(id, next_offset);
+            next_offset += max_transfer;
+        }
+    };
+
     std::array<char, max_transfer> buffer{};
-    while (auto r = sftp_read(remote_file.get(), buffer.data(), buffer.size()))
-    {
+    auto receive = [&] {
+        const auto [id, offset] = in_flight.front();
+        in_flight.pop_front();
+
+        // libssh doesn't pick up replies anymore once it saw the end of the file, seeking clears that
+        sftp_seek64(remote_file.get(), offset);
+        const auto r = sftp_async_read(remote_file.get(), buffer.data(), max_transfer, id);
         if (r < 0)
             throw SFTPError{"cannot read from remote file {}: {}", source_path, ssh_get_error(sftp->session)};
 
+        return std::make_pair(r, offset);
+    };
+
+    for (request_more(); !in_flight.empty();)
+    {
+        const auto [r, offset] = receive();
         target.write(buffer.data(), r);
+
+        if (static_cast<std::size_t>(r) < max_transfer)
+        {
+            // Whatever was asked for past a short read would leave a gap, so it is dropped
+            while (!in_flight.empty())
+                receive();
+
+            if (r == 0)
+                break;
+
+            next_offset = offset + r;
+        }
+
+        request_more();
+    }
+}
+
+std::vector<std::unique_ptr<SFTPClient>> SFTPClient::make_parallel_clients()
+{
+    std::vector<std::unique_ptr<SFTPClient>> clients;
+    if (parallel_transfers <= 1 || !make_ssh_session)
+        return clients;
+
+    // libssh sessions can't be shared between threads, so each client gets a connection of its own
+    for (auto i = 0; i < parallel_transfers; ++i)
+    {
+        try
+        {
+            clients.push_back(std::make_unique<SFTPClient>(make_ssh_session()));
+            clients.back()->set_transfer_window(transfer_window);
+        }
+        catch (const std::exception& e)
+        {
+            mpl::log(mpl::Level::warning, log_category,
+                     fmt::format("cannot open connection {} of {} for parallel transfers: {}", i + 1,
+                                 parallel_transfers, e.what()));
+            break;
+        }
     }
+
+    return clients;
 }
 
 } // namespace multipass
@@ -160,9 +160,9 @@ void SFTPUtils::mkdir_recursive(sftp_session sftp, const fs::path& path)
 }
 
 std::unique_ptr<SFTPClient> SFTPUtils::make_SFTPClient(const std::string& host, int port, const std::string& username,
-                                                       const std::string& priv_key_blob)
+                                                       const std::string& priv_key_blob, bool compression)
 {
-    return std::make_unique<SFTPClient>(host, port, username, priv_key_blob);
+    return std::make_unique<SFTPClient>(host, port, username, priv_key_blob, compression);
 }
 
 std::unique_ptr<SFTPDirIterator> SFTPUtils::make_SFTPDirIterator(sftp_session sftp, const fs::path& path)
@@ -21,10 +21,76 @@
 
 #include "ssh_client_key_provider.h"
 
+#include <libssh/callbacks.h>
+
+#include <algorithm>
+#include <cerrno>
+#include <cstdio>
+
+#include <poll.h>
+#include <unistd.h>
+
 namespace mp = multipass;
 
 namespace
 {
+struct Forwarding
+{
+    ssh_channel channel;
+    std::vector<char> buffer;
+    bool stdin_open{true};
+    bool stdin_polled{false};
+};
+
+void write_all(int fd, const char* data, std::size_t size)
+{
+    while (size > 0)
+    {
+        const auto ret = write(fd, data, size);
+        if (ret < 0 && errno == EAGAIN)
+        {
+            pollfd poll_fd{fd, POLLOUT, 0};
+            poll(&poll_fd, 1, -1);
+            continue;
+        }
+        if (ret < 0 && errno == EINTR)
+            continue;
+        if (ret <= 0)
+            return; // nobody is reading anymore, what is left goes nowhere
+
+        data += ret;
+        size -= ret;
+    }
+}
+
+int on_channel_data(ssh_session, ssh_channel, void* data, uint32_t len, int is_stderr, void*)
+{
+    // Straight out of libssh's buffer; taking our time here is what holds the remote end back when output is slow
+    write_all(fileno(is_stderr ? stderr : stdout), static_cast<const char*>(data), len);
+    return len;
+}
+
+int on_stdin(socket_t fd, int, void* userdata)
+{
+    auto& forwarding = *static_cast<Forwarding*>(userdata);
+
+    // No more than the remote end is ready to take, so that writing to the channel does not block
+    const auto count = std::min<std::size_t>(forwarding.buffer.size(), ssh_channel_window_size(forwarding.channel));
+    if (count == 0)
+        return 0;
+
+    const auto num_read = read(fd, forwarding.buffer.data(), count);
+    if (num_read > 0)
+        ssh_channel_write(forwarding.channel, forwarding.buffer.data(), num_read);
+    else if (num_read == 0 || (errno != EINTR && errno != EAGAIN))
+    {
+        forwarding.stdin_open = false;
+        ssh_channel_send_eof(forwarding.channel);
+    }
+
+    return 0;
+}
+
 mp::SSHClient::ChannelUPtr make_channel(ssh_session session)
 {
     mp::SSHClient::ChannelUPtr channel{ssh_channel_new(session), ssh_channel_free};
@@ -36,8 +102,9 @@ mp::SSHClient::ChannelUPtr make_channel(ssh_session session)
 } // namespace
 
 mp::SSHClient::SSHClient(const std::string& host, int port, const std::string& username,
-                         const std::string& priv_key_blob, ConsoleCreator console_creator)
-    : SSHClient{std::make_unique<mp::SSHSession>(host, port, username, mp::SSHClientKeyProvider(priv_key_blob)),
+                         const std::string& priv_key_blob, ConsoleCreator console_creator, bool compression)
+    : SSHClient{std::make_unique<mp::SSHSession>(host, port, username, mp::SSHClientKeyProvider(priv_key_blob),
+                                                 std::chrono::seconds(20), compression),
                 console_creator}
 {
 }
@@ -60,6 +127,11 @@ int mp::SSHClient::exec(const std::vector<std::string>& args)
 }
 
 int mp::SSHClient::exec(const std::vector<std::vector<std::string>>& args_list)
+{
+    return exec_string(to_cmd_line(args_list));
+}
+
+std::string mp::SSHClient::to_cmd_line(const std::vector<std::vector<std::string>>& args_list)
 {
     std::string cmd_line;
 
@@ -71,7 +143,12 @@ int mp::SSHClient::exec(const std::vector<std::vector<std::string>>& args_list)
             cmd_line += "&&" + utils::to_cmd(*args_it, mp::utils::QuoteType::quote_every_arg);
     }
 
-    return exec_string(cmd_line);
+    return cmd_line;
+}
+
+void mp::SSHClient::set_buffer_size(std::size_t size)
+{
+    buffer_size = size;
 }
 
 void mp::SSHClient::handle_ssh_events()
@@ -107,6 +184,39 @@ void mp::SSHClient::handle_ssh_events()
     ssh_event_remove_connector(event.get(), connector_err.get());
 }
 
+void mp::SSHClient::forward_streams()
+{
+    Forwarding forwarding{channel.get(), std::vector<char>(buffer_size)};
+
+    ssh_channel_callbacks_struct callbacks{};
+    ssh_callbacks_init(&callbacks);
+    callbacks.userdata = &forwarding;
+    callbacks.channel_data_function = on_channel_data;
+    ssh_add_channel_callbacks(channel.get(), &callbacks);
+
+    std::unique_ptr<ssh_event_struct, void (*)(ssh_event)> event{ssh_event_new(), ssh_event_free};
+    ssh_event_add_session(event.get(), *ssh_session);
+
+    const auto stdin_fd = fileno(stdin);
+    while (ssh_channel_is_open(channel.get()) && !ssh_channel_is_eof(channel.get()))
+    {
+        // Input is left alone while the remote window is full, it would just keep waking us up otherwise
+        const auto want_stdin = forwarding.stdin_open && ssh_channel_window_size(channel.get()) > 0;
+        if (want_stdin && !forwarding.stdin_polled)
+            ssh_event_add_fd(event.get(), stdin_fd, POLLIN, on_stdin, &forwarding);
+        else if (!want_stdin && forwarding.stdin_polled)
+            ssh_event_remove_fd(event.get(), stdin_fd);
+        forwarding.stdin_polled = want_stdin;
+
+        ssh_event_dopoll(event.get(), 60000);
+    }
+
+    if (forwarding.stdin_polled)
+        ssh_event_remove_fd(event.get(), stdin_fd);
+    ssh_event_remove_session(event.get(), *ssh_session);
+    ssh_remove_channel_callbacks(channel.get(), &callbacks);
+}
+
 int mp::SSHClient::exec_string(const std::string& cmd_line)
 {
     if (cmd_line.empty())
@@ -115,7 +225,11 @@ int mp::SSHClient::exec_string(const std::string& cmd_line)
         SSH::throw_on_error(channel, *ssh_session, "[ssh client] exec request failed", ssh_channel_request_exec,
                             cmd_line.c_str());
 
-    handle_ssh_events();
+    // Output going to a terminal is interactive, anything else is likely bulk data that calls for large reads
+    if (isatty(fileno(stdout)))
+        handle_ssh_events();
+    else
+        forward_streams();
 
     return ssh_channel_get_exit_status(channel.get());
 }
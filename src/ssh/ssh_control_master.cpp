@@ -0,0 +1,726 @@
+/*
+ * Copyright (C) Canonical, Ltd.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; version 3.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#include <multipass/format.h>
+#include <multipass/ssh/ssh_control_master.h>
+
+#include "ssh_client_key_provider.h"
+
+#include <algorithm>
+#include <array>
+#include <cerrno>
+#include <csignal>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <stdexcept>
+#include <vector>
+
+#include <fcntl.h>
+#include <poll.h>
+#include <sys/ioctl.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <sys/wait.h>
+#include <termios.h>
+#include <unistd.h>
+
+namespace mp = multipass;
+
+namespace
+{
+#ifdef MSG_NOSIGNAL
+constexpr auto send_flags = MSG_NOSIGNAL;
+#else
+constexpr auto send_flags = 0;
+#endif
+
+constexpr auto poll_timeout_ms = 1000;
+constexpr auto request_timeout = std::chrono::seconds(5);
+constexpr auto started = '+';
+
+// What a client sends first, along with its standard streams. The command line follows.
+struct Request
+{
+    std::uint32_t cmd_size;
+    std::uint16_t columns;
+    std::uint16_t rows;
+    std::uint8_t pty;
+    char term[63];
+    char session[32]; // the name of a shell to keep running while no one is attached to it, if any
+};
+static_assert(sizeof(Request::session) == mp::SSHControlMaster::max_session_name_length + 1);
+
+// A request as it trickles in, the master does not wait for it while others need serving
+struct IncomingRequest
+{
+    Request request{};
+    std::size_t received{0}; // of the request and then of the command line
+    std::string cmd_line;
+    std::chrono::steady_clock::time_point since{std::chrono::steady_clock::now()};
+};
+
+enum class Reception
+{
+    partial,
+    complete,
+    failed
+};
+
+// What a client sends whenever its terminal is resized
+struct Resize
+{
+    std::uint16_t columns;
+    std::uint16_t rows;
+};
+
+using ChannelUPtr = std::unique_ptr<ssh_channel_struct, void (*)(ssh_channel)>;
+using ConnectorUPtr = std::unique_ptr<ssh_connector_struct, void (*)(ssh_connector)>;
+
+struct ScopedFd
+{
+    ~ScopedFd()
+    {
+        close(fd);
+    }
+
+    const int fd;
+};
+
+volatile std::sig_atomic_t window_changed{0};
+
+void on_window_change(int)
+{
+    window_changed = 1;
+}
+
+bool send_all(int fd, const void* data, std::size_t size)
+{
+    for (auto ptr = static_cast<const char*>(data); size > 0;)
+    {
+        const auto ret = send(fd, ptr, size, send_flags);
+        if (ret < 0 && errno == EINTR)
+            continue;
+        if (ret <= 0)
+            return false;
+
+        ptr += ret;
+        size -= ret;
+    }
+
+    return true;
+}
+
+bool read_all(int fd, void* data, std::size_t size)
+{
+    for (auto ptr = static_cast<char*>(data); size > 0;)
+    {
+        const auto ret = read(fd, ptr, size);
+        if (ret < 0 && errno == EINTR)
+            continue;
+        if (ret <= 0)
+            return false;
+
+        ptr += ret;
+        size -= ret;
+    }
+
+    return true;
+}
+
+sockaddr_un address_of(const std::string& socket_path)
+{
+    sockaddr_un address{};
+    if (socket_path.size() >= sizeof(address.sun_path))
+        throw std::runtime_error(fmt::format("control socket path is too long: {}", socket_path));
+
+    address.sun_family = AF_UNIX;
+    std::strncpy(address.sun_path, socket_path.c_str(), sizeof(address.sun_path) - 1);
+    return address;
+}
+
+int connect_to(const std::string& socket_path)
+{
+    const auto address = address_of(socket_path);
+    const auto fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (fd < 0)
+        return -1;
+
+    fcntl(fd, F_SETFD, FD_CLOEXEC);
+    if (connect(fd, reinterpret_cast<const sockaddr*>(&address), sizeof(address)) < 0)
+    {
+        close(fd);
+        return -1;
+    }
+
+    return fd;
+}
+
+int listen_on(const std::string& socket_path)
+{
+    const auto address = address_of(socket_path);
+    const auto fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (fd < 0)
+        throw std::runtime_error(fmt::format("cannot create control socket: {}", std::strerror(errno)));
+
+    fcntl(fd, F_SETFD, FD_CLOEXEC);
+    auto do_bind = [fd, &address] { return bind(fd, reinterpret_cast<const sockaddr*>(&address), sizeof(address)); };
+
+    auto ret = do_bind();
+    if (ret < 0 && errno == EADDRINUSE)
+    {
+        // Left behind by a master that did not get to clean up, unless there is one serving on it
+        if (const auto other = connect_to(socket_path); other >= 0)
+        {
+            close(other);
+            close(fd);
+            throw std::runtime_error(fmt::format("a master is already serving on {}", socket_path));
+        }
+
+        unlink(socket_path.c_str());
+        ret = do_bind();
+    }
+
+    if (ret < 0 || chmod(socket_path.c_str(), S_IRUSR | S_IWUSR) < 0 || listen(fd, SOMAXCONN) < 0)
+    {
+        const auto error = errno;
+        close(fd);
+        throw std::runtime_error(fmt::format("cannot listen on {}: {}", socket_path, std::strerror(error)));
+    }
+
+    fcntl(fd, F_SETFL, fcntl(fd, F_GETFL) | O_NONBLOCK);
+    return fd;
+}
+
+// Takes in whatever has arrived of the client's request, without waiting for more. Its standard streams come along with
+// the first of it.
+Reception receive_request(int fd, IncomingRequest& incoming, std::array<int, 3>& fds)
+{
+    auto received_more = [&incoming](ssize_t ret) {
+        if (ret > 0)
+            incoming.received += ret;
+        return ret > 0 || (ret < 0 && errno == EINTR);
+    };
+
+    constexpr auto request_size = sizeof(Request);
+    while (incoming.received < request_size)
+    {
+        alignas(cmsghdr) char control[CMSG_SPACE(sizeof(fds))]{};
+        iovec iov{reinterpret_cast<char*>(&incoming.request) + incoming.received, request_size - incoming.received};
+        msghdr message{};
+        message.msg_iov = &iov;
+        message.msg_iovlen = 1;
+        message.msg_control = control;
+        message.msg_controllen = sizeof(control);
+
+        const auto ret = recvmsg(fd, &message, MSG_DONTWAIT);
+        if (ret > 0 && incoming.received == 0)
+        {
+            const auto cmsg = CMSG_FIRSTHDR(&message);
+            if ((message.msg_flags & MSG_CTRUNC) || !cmsg || cmsg->cmsg_level != SOL_SOCKET ||
+                cmsg->cmsg_type != SCM_RIGHTS || cmsg->cmsg_len != CMSG_LEN(sizeof(fds)))
+                return Reception::failed;
+
+            std::memcpy(fds.data(), CMSG_DATA(cmsg), sizeof(fds));
+            for (auto stream_fd : fds)
+                fcntl(stream_fd, F_SETFD, FD_CLOEXEC);
+        }
+
+        if (!received_more(ret))
+            return ret < 0 && (errno == EAGAIN || errno == EWOULDBLOCK) ? Reception::partial : Reception::failed;
+    }
+
+    incoming.request.term[sizeof(incoming.request.term) - 1] = '\0';
+    incoming.request.session[sizeof(incoming.request.session) - 1] = '\0';
+    incoming.cmd_line.resize(incoming.request.cmd_size);
+
+    while (incoming.received < request_size + incoming.cmd_line.size())
+    {
+        const auto offset = incoming.received - request_size;
+        const auto ret = recv(fd, incoming.cmd_line.data() + offset, incoming.cmd_line.size() - offset, MSG_DONTWAIT);
+        if (!received_more(ret))
+            return ret < 0 && (errno == EAGAIN || errno == EWOULDBLOCK) ? Reception::partial : Reception::failed;
+    }
+
+    return Reception::complete;
+}
+
+bool send_string(int fd, const std::string& value)
+{
+    const std::uint32_t size = value.size();
+    return send_all(fd, &size, sizeof(size)) && send_all(fd, value.data(), value.size());
+}
+
+std::string read_string(int fd)
+{
+    std::uint32_t size{};
+    std::string value;
+    if (!read_all(fd, &size, sizeof(size)) || (value.resize(size), !read_all(fd, value.data(), value.size())))
+        throw std::runtime_error("incomplete control master parameters");
+
+    return value;
+}
+
+int on_readable(socket_t, int, void* userdata)
+{
+    *static_cast<bool*>(userdata) = true;
+    return 0;
+}
+
+class RawTerminal
+{
+public:
+    explicit RawTerminal(bool enable) : enabled{enable && tcgetattr(STDIN_FILENO, &saved) == 0}
+    {
+        if (enabled)
+        {
+            auto raw = saved;
+            cfmakeraw(&raw);
+            tcsetattr(STDIN_FILENO, TCSANOW, &raw);
+        }
+    }
+
+    ~RawTerminal()
+    {
+        if (enabled)
+            tcsetattr(STDIN_FILENO, TCSANOW, &saved);
+    }
+
+private:
+    termios saved{};
+    const bool enabled;
+};
+
+Resize window_size()
+{
+    winsize size{};
+    ioctl(STDOUT_FILENO, TIOCGWINSZ, &size);
+    return {size.ws_col, size.ws_row};
+}
+} // namespace
+
+struct mp::SSHControlMaster::Client
+{
+    explicit Client(int control_fd) : control_fd{control_fd}
+    {
+    }
+
+    ~Client()
+    {
+        for (auto fd : {control_fd, fds[0], fds[1], fds[2]})
+            if (fd >= 0)
+                close(fd);
+    }
+
+    int control_fd;
+    std::array<int, 3> fds{-1, -1, -1}; // stdin, stdout and stderr
+    ChannelUPtr channel{nullptr, ssh_channel_free};
+    std::vector<ConnectorUPtr> connectors;
+    bool control_readable{false};
+    bool gone{false};
+    std::string session;
+    std::optional<std::chrono::steady_clock::time_point> detached_since;
+    std::optional<IncomingRequest> incoming{std::in_place}; // until the command is up and running
+};
+
+mp::SSHControlMaster::SSHControlMaster(std::unique_ptr<SSHSession> session, const std::string& socket_path,
+                                       std::chrono::seconds idle_timeout)
+    : session{std::move(session)},
+      socket_path{socket_path},
+      idle_timeout{idle_timeout},
+      listen_fd{listen_on(socket_path)},
+      event{ssh_event_new(), ssh_event_free}
+{
+}
+
+mp::SSHControlMaster::~SSHControlMaster()
+{
+    // Stop taking new clients first, so that they set up their own sessions instead
+    unlink(socket_path.c_str());
+    for (auto& client : clients)
+        drop(client);
+    clients.clear();
+
+    ssh_event_remove_fd(event.get(), listen_fd);
+    close(listen_fd);
+}
+
+void mp::SSHControlMaster::run()
+{
+    bool incoming{false};
+    ssh_event_add_fd(event.get(), listen_fd, POLLIN, on_readable, &incoming);
+
+    auto last_used = std::chrono::steady_clock::now();
+    while (ssh_is_connected(*session))
+    {
+        if (clients.empty() && std::chrono::steady_clock::now() - last_used >= idle_timeout)
+            break;
+
+        // libssh callbacks must not reenter the session, so they only flag what needs doing
+        ssh_event_dopoll(event.get(), poll_timeout_ms);
+
+        if (incoming)
+        {
+            incoming = false;
+            accept_client();
+        }
+
+        const auto now = std::chrono::steady_clock::now();
+        for (auto it = clients.begin(); it != clients.end();)
+        {
+            if (it->incoming)
+            {
+                if (it->control_readable)
+                    take_request(*it);
+
+                // Those that never got going leave the client to run the command some other way
+                if (it->incoming && (it->gone || now - it->incoming->since >= request_timeout))
+                {
+                    drop(*it);
+                    it = clients.erase(it);
+                    continue;
+                }
+
+                if (it->incoming)
+                {
+                    ++it;
+                    continue;
+                }
+            }
+            else if (it->control_readable)
+                handle_control(*it);
+
+            const auto ended = !ssh_channel_is_open(it->channel.get()) || ssh_channel_is_eof(it->channel.get());
+            if (it->gone && !ended && !it->session.empty())
+                detach(*it);
+
+            if (ended || it->gone || (it->detached_since && now - *it->detached_since >= idle_timeout))
+            {
+                finish(*it);
+                it = clients.erase(it);
+                last_used = now;
+            }
+            else
+                ++it;
+        }
+    }
+}
+
+// Clients are only taken in here, what they want is read as it arrives so that none of them can hold up the rest
+void mp::SSHControlMaster::accept_client()
+{
+    for (int fd; (fd = accept(listen_fd, nullptr, nullptr)) >= 0;)
+    {
+        // Some systems pass the listening socket's O_NONBLOCK on, requests are read with MSG_DONTWAIT instead
+        fcntl(fd, F_SETFD, FD_CLOEXEC);
+        fcntl(fd, F_SETFL, fcntl(fd, F_GETFL) & ~O_NONBLOCK);
+        auto& client = clients.emplace_back(fd);
+        ssh_event_add_fd(event.get(), fd, POLLIN, on_readable, &client.control_readable);
+    }
+}
+
+void mp::SSHControlMaster::take_request(Client& client)
+{
+    client.control_readable = false;
+
+    const auto reception = receive_request(client.control_fd, *client.incoming, client.fds);
+    if (reception != Reception::complete)
+    {
+        client.gone = reception == Reception::failed;
+        return;
+    }
+
+    const auto& request = client.incoming->request;
+    const auto& cmd_line = client.incoming->cmd_line;
+    client.session = request.session;
+
+    auto ok = false;
+    if (const auto previous = find_session(client); previous != clients.end())
+    {
+        // Taken over as it is, from wherever it was last attached to or from a client that is still hanging on to it,
+        // after losing its connection; the size change lets full screen programs know to redraw
+        detach(*previous);
+        client.channel = std::move(previous->channel);
+        clients.erase(previous);
+
+        ok = !request.pty || ssh_channel_change_pty_size(client.channel.get(), request.columns, request.rows) == SSH_OK;
+    }
+    else
+    {
+        client.channel.reset(ssh_channel_new(*session));
+        ok = client.channel && ssh_channel_open_session(client.channel.get()) == SSH_OK &&
+             (!request.pty || ssh_channel_request_pty_size(client.channel.get(), request.term, request.columns,
+                                                           request.rows) == SSH_OK) &&
+             (cmd_line.empty() ? ssh_channel_request_shell(client.channel.get())
+                               : ssh_channel_request_exec(client.channel.get(), cmd_line.c_str())) == SSH_OK;
+    }
+
+    // Without the go-ahead the client runs the command some other way
+    if (!ok || !send_all(client.control_fd, &started, 1))
+    {
+        client.gone = true;
+        return;
+    }
+
+    client.incoming.reset();
+
+    auto add_connector = [this, &client](auto configure) {
+        auto& connector = client.connectors.emplace_back(ssh_connector_new(*session), ssh_connector_free);
+        configure(connector.get(), client.channel.get());
+        ssh_event_add_connector(event.get(), connector.get());
+    };
+
+    add_connector([&client](ssh_connector connector, ssh_channel channel) {
+        ssh_connector_set_in_fd(connector, client.fds[0]);
+        ssh_connector_set_out_channel(connector, channel, SSH_CONNECTOR_STDOUT);
+    });
+    add_connector([&client](ssh_connector connector, ssh_channel channel) {
+        ssh_connector_set_in_channel(connector, channel, SSH_CONNECTOR_STDOUT);
+        ssh_connector_set_out_fd(connector, client.fds[1]);
+    });
+    add_connector([&client](ssh_connector connector, ssh_channel channel) {
+        ssh_connector_set_in_channel(connector, channel, SSH_CONNECTOR_STDERR);
+        ssh_connector_set_out_fd(connector, client.fds[2]);
+    });
+}
+
+void mp::SSHControlMaster::handle_control(Client& client)
+{
+    client.control_readable = false;
+
+    Resize resize{};
+    if (!read_all(client.control_fd, &resize, sizeof(resize)))
+        client.gone = true; // interrupted, most likely; the command goes along with it
+    else
+        ssh_channel_change_pty_size(client.channel.get(), resize.columns, resize.rows);
+}
+
+auto mp::SSHControlMaster::find_session(const Client& client) -> std::list<Client>::iterator
+{
+    if (client.session.empty())
+        return clients.end();
+
+    return std::find_if(clients.begin(), clients.end(), [&client](const Client& other) {
+        return &other != &client && !other.incoming && other.session == client.session;
+    });
+}
+
+// The shell carries on without anyone to take its input or output, until it is attached to again
+void mp::SSHControlMaster::detach(Client& client)
+{
+    drop(client);
+
+    for (auto fd : {&client.control_fd, &client.fds[0], &client.fds[1], &client.fds[2]})
+    {
+        if (*fd >= 0)
+            close(*fd);
+        *fd = -1;
+    }
+
+    client.gone = false;
+    client.detached_since = std::chrono::steady_clock::now();
+}
+
+void mp::SSHControlMaster::finish(Client& client)
+{
+    drop(client);
+
+    if (client.control_fd >= 0 && !client.gone && ssh_channel_is_eof(client.channel.get()))
+    {
+        const std::int32_t exit_code = ssh_channel_get_exit_status(client.channel.get());
+        send_all(client.control_fd, &exit_code, sizeof(exit_code));
+    }
+
+    ssh_channel_close(client.channel.get());
+}
+
+void mp::SSHControlMaster::drop(Client& client)
+{
+    for (auto& connector : client.connectors)
+        ssh_event_remove_connector(event.get(), connector.get());
+    client.connectors.clear();
+
+    if (client.control_fd >= 0)
+        ssh_event_remove_fd(event.get(), client.control_fd);
+}
+
+void mp::SSHControlMaster::spawn(const std::string& executable, const std::string& socket_path,
+                                 const std::string& host, int port, const std::string& username,
+                                 const std::string& priv_key_blob, std::chrono::seconds idle_timeout, bool compression)
+{
+    // The parameters go through a socket rather than on the command line, where anyone could read the key
+    int sockets[2];
+    if (socketpair(AF_UNIX, SOCK_STREAM, 0, sockets) < 0)
+        throw std::runtime_error(fmt::format("cannot hand over to a control master: {}", std::strerror(errno)));
+
+    const ScopedFd ours{sockets[0]};
+    for (auto fd : sockets)
+        fcntl(fd, F_SETFD, FD_CLOEXEC);
+
+    // All prepared up front: between forking a multithreaded process and exec, only async-signal-safe calls are allowed
+    const std::array<const char*, 3> argv{executable.c_str(), master_argument, nullptr};
+    const ScopedFd null_fd{open("/dev/null", O_RDWR | O_CLOEXEC)};
+
+    const auto child = fork();
+    if (child == 0)
+    {
+        // Detach from the terminal and let the intermediate child go, so that nobody has to reap the master
+        setsid();
+        if (fork() != 0)
+            _exit(0);
+
+        dup2(sockets[1], STDIN_FILENO);
+        for (auto fd : {STDOUT_FILENO, STDERR_FILENO})
+            dup2(null_fd.fd, fd);
+
+        execv(argv[0], const_cast<char* const*>(argv.data()));
+        _exit(EXIT_FAILURE);
+    }
+
+    close(sockets[1]);
+    if (child < 0)
+        throw std::runtime_error(fmt::format("cannot spawn a control master: {}", std::strerror(errno)));
+
+    waitpid(child, nullptr, 0);
+
+    // A master that did not make it has nothing to read this, the next client connects on its own all the same
+    for (const auto& parameter : {socket_path, host, std::to_string(port), username, priv_key_blob,
+                                  std::to_string(idle_timeout.count()), std::string{compression ? "1" : "0"}})
+        if (!send_string(ours.fd, parameter))
+            break;
+}
+
+int mp::SSHControlMaster::serve(int parameters_fd)
+{
+    // Clients going away while output is on its way to them must not bring everyone else down
+    std::signal(SIGPIPE, SIG_IGN);
+
+    try
+    {
+        const auto socket_path = read_string(parameters_fd);
+        const auto host = read_string(parameters_fd);
+        const auto port = std::stoi(read_string(parameters_fd));
+        const auto username = read_string(parameters_fd);
+        const auto priv_key_blob = read_string(parameters_fd);
+        const auto idle_timeout = std::chrono::seconds(std::stoll(read_string(parameters_fd)));
+        const auto compression = read_string(parameters_fd) == "1";
+
+        mp::SSHControlMaster master{std::make_unique<mp::SSHSession>(host, port, username,
+                                                                     mp::SSHClientKeyProvider{priv_key_blob},
+                                                                     std::chrono::seconds(20), compression),
+                                    socket_path, idle_timeout};
+        master.run();
+    }
+    catch (const std::exception&)
+    {
+        return EXIT_FAILURE;
+    }
+
+    return EXIT_SUCCESS;
+}
+
+std::optional<int> mp::SSHControlMaster::exec(const std::string& socket_path, const std::string& cmd_line, bool pty,
+                                              const std::string& session)
+{
+    const auto fd = connect_to(socket_path);
+    if (fd < 0)
+        return std::nullopt;
+
+    const ScopedFd fd_guard{fd};
+
+    Request request{};
+    request.cmd_size = cmd_line.size();
+    request.pty = pty;
+    std::strncpy(request.session, session.c_str(), sizeof(request.session) - 1);
+    if (pty)
+    {
+        const auto size = window_size();
+        request.columns = size.columns;
+        request.rows = size.rows;
+
+        const auto term = std::getenv("TERM");
+        std::strncpy(request.term, term ? term : "xterm", sizeof(request.term) - 1);
+    }
+
+    const std::array<int, 3> fds{STDIN_FILENO, STDOUT_FILENO, STDERR_FILENO};
+    alignas(cmsghdr) char control[CMSG_SPACE(sizeof(fds))]{};
+    iovec iov{&request, sizeof(request)};
+    msghdr message{};
+    message.msg_iov = &iov;
+    message.msg_iovlen = 1;
+    message.msg_control = control;
+    message.msg_controllen = sizeof(control);
+
+    const auto cmsg = CMSG_FIRSTHDR(&message);
+    cmsg->cmsg_level = SOL_SOCKET;
+    cmsg->cmsg_type = SCM_RIGHTS;
+    cmsg->cmsg_len = CMSG_LEN(sizeof(fds));
+    std::memcpy(CMSG_DATA(cmsg), fds.data(), sizeof(fds));
+
+    if (sendmsg(fd, &message, send_flags) != static_cast<ssize_t>(sizeof(request)) ||
+        !send_all(fd, cmd_line.data(), cmd_line.size()))
+        return std::nullopt;
+
+    char reply{};
+    if (!read_all(fd, &reply, 1) || reply != started)
+        return std::nullopt;
+
+    // From here on the command is running, there is no falling back anymore
+    RawTerminal raw_terminal{pty};
+
+    struct sigaction winch_action
+    {
+    };
+    struct sigaction old_winch_action
+    {
+    };
+    winch_action.sa_handler = on_window_change;
+    sigemptyset(&winch_action.sa_mask);
+    if (pty)
+        sigaction(SIGWINCH, &winch_action, &old_winch_action);
+
+    std::int32_t exit_code{0};
+    auto ptr = reinterpret_cast<char*>(&exit_code);
+    for (std::size_t remaining = sizeof(exit_code); remaining > 0;)
+    {
+        if (const auto ret = read(fd, ptr, remaining); ret > 0)
+        {
+            ptr += ret;
+            remaining -= ret;
+        }
+        else if (ret < 0 && errno == EINTR)
+        {
+            if (window_changed)
+            {
+                window_changed = 0;
+                const auto size = window_size();
+                send_all(fd, &size, sizeof(size));
+            }
+        }
+        else
+        {
+            exit_code = 255; // like ssh, when the connection is lost midway
+            break;
+        }
+    }
+
+    if (pty)
+        sigaction(SIGWINCH, &old_winch_action, nullptr);
+
+    return exit_code;
+}
@@ -24,10 +24,11 @@
 
 #include <libssh/callbacks.h>
 
-#include <array>
-#include <sstream>
+#include <algorithm>
+#include <vector>
 
 #include <cerrno>
+#include <cstdint>
 #include <cstring>
 
 namespace mp = multipass;
@@ -37,6 +38,9 @@ namespace
 {
 constexpr auto category = "ssh process";
 
+// libssh hands out whatever it has buffered, up to this much per read
+constexpr std::uint32_t read_chunk_size = 64 * 1024;
+
 class ExitStatusCallback
 {
 public:
@@ -112,45 +116,146 @@ std::string mp::SSHProcess::read_std_error()
     return read_stream(StreamType::err);
 }
 
+void mp::SSHProcess::read_std_output(const OutputHandler& handler)
+{
+    read_stream(StreamType::out, handler);
+}
+
+void mp::SSHProcess::read_std_error(const OutputHandler& handler)
+{
+    read_stream(StreamType::err, handler);
+}
+
 std::string mp::SSHProcess::read_stream(StreamType type, int timeout)
 {
-    mpl::log(mpl::Level::debug, category,
-             fmt::format("{}:{} {}(type = {}, timeout = {}): ", __FILE__, __LINE__, __FUNCTION__,
-                         static_cast<int>(type), timeout));
+    // Read straight into the result, growing it as needed so there is a single copy out of libssh
+    std::string output;
+    std::size_t size{0};
+    read_stream(
+        type,
+        [&output, &size](std::size_t count) {
+            if (output.size() < size + count)
+                output.resize(std::max(size + count, 2 * output.size()));
+            return output.data() + size;
+        },
+        [&size](std::size_t num_bytes) { size += num_bytes; }, timeout);
+
+    output.resize(size);
+    return output;
+}
+
+void mp::SSHProcess::read_stream(StreamType type, const OutputHandler& handler, int timeout)
+{
+    std::vector<char> buffer(read_chunk_size);
+    read_stream(
+        type, [&buffer](std::size_t) { return buffer.data(); },
+        [&buffer, &handler](std::size_t num_bytes) { handler(std::string_view{buffer.data(), num_bytes}); }, timeout);
+}
+
+void mp::SSHProcess::read_stream(StreamType type, const std::function<char*(std::size_t)>& get_buffer,
+                                 const std::function<void(std::size_t)>& on_read, int timeout)
+{
+    // Formatted only when debugging, they come once per chunk
+    mpl::log(mpl::Level::debug, category, "{}:{} {}(type = {}, timeout = {}): ", __FILE__, __LINE__, __FUNCTION__,
+             static_cast<int>(type), timeout);
+
     // If the channel is closed there's no output to read
     if (ssh_channel_is_closed(channel.get()))
     {
-        mpl::log(mpl::Level::debug, category,
-                 fmt::format("{}:{} {}(): channel closed", __FILE__, __LINE__, __FUNCTION__));
-        return std::string();
+        mpl::log(mpl::Level::debug, category, "{}:{} {}(): channel closed", __FILE__, __LINE__, __FUNCTION__);
+        return;
     }
 
-    std::stringstream output;
-    std::array<char, 256> buffer;
     int num_bytes{0};
     const bool is_std_err = type == StreamType::err;
     do
     {
-        num_bytes = ssh_channel_read_timeout(channel.get(), buffer.data(), buffer.size(), is_std_err, timeout);
-        mpl::log(mpl::Level::debug, category,
-                 fmt::format("{}:{} {}(): num_bytes = {}", __FILE__, __LINE__, __FUNCTION__, num_bytes));
+        auto buffer = get_buffer(read_chunk_size);
+        num_bytes = ssh_channel_read_timeout(channel.get(), buffer, read_chunk_size, is_std_err, timeout);
+        mpl::log(mpl::Level::debug, category, "{}:{} {}(): num_bytes = {}", __FILE__, __LINE__, __FUNCTION__,
+                 num_bytes);
         if (num_bytes < 0)
         {
             // Latest libssh now returns an error if the channel has been closed instead of returning 0 bytes
             if (ssh_channel_is_closed(channel.get()))
             {
-                mpl::log(mpl::Level::debug, category,
-                         fmt::format("{}:{} {}(): channel closed", __FILE__, __LINE__, __FUNCTION__));
-                return output.str();
+                mpl::log(mpl::Level::debug, category, "{}:{} {}(): channel closed", __FILE__, __LINE__, __FUNCTION__);
+                return;
             }
 
             throw mp::SSHException(
                 fmt::format("error while reading ssh channel for remote process '{}' - error: {}", cmd, num_bytes));
         }
-        output.write(buffer.data(), num_bytes);
+
+        if (num_bytes > 0)
+            on_read(num_bytes);
     } while (num_bytes > 0);
+}
+
+void mp::SSHProcess::write_std_input(std::string_view data)
+{
+    while (!data.empty())
+    {
+        // Blocks for as long as the remote window is full, which is what holds back whoever feeds the input
+        const auto count = static_cast<std::uint32_t>(std::min<std::size_t>(data.size(), read_chunk_size));
+        const auto written = ssh_channel_write(channel.get(), data.data(), count);
+        if (written < 0)
+            throw mp::SSHException(fmt::format("error while writing to remote process '{}' - error: {}", cmd,
+                                               ssh_get_error(session)));
+
+        data.remove_prefix(written);
+    }
+}
+
+void mp::SSHProcess::close_std_input()
+{
+    if (ssh_channel_send_eof(channel.get()) != SSH_OK)
+        throw mp::SSHException(
+            fmt::format("error while closing input of remote process '{}' - error: {}", cmd, ssh_get_error(session)));
+}
+
+bool mp::SSHProcess::read_available_output(const OutputHandler& out_handler, const OutputHandler& err_handler,
+                                           std::chrono::milliseconds timeout)
+{
+    // Only output is waited for, what comes on stderr in the meantime is picked up right after
+    auto more = false;
+    std::vector<char> buffer(read_chunk_size);
+    for (const auto is_std_err : {false, true})
+    {
+        const auto available =
+            ssh_channel_poll_timeout(channel.get(), is_std_err ? 0 : static_cast<int>(timeout.count()), is_std_err);
+        if (available == SSH_EOF)
+            continue;
+
+        if (available == SSH_ERROR)
+            throw mp::SSHException(fmt::format("error while polling ssh channel for remote process '{}' - error: {}",
+                                               cmd, ssh_get_error(session)));
+
+        more = true;
+        if (available == 0)
+            continue;
+
+        // No more than is there, so this does not wait
+        const auto num_bytes = ssh_channel_read_timeout(
+            channel.get(), buffer.data(), std::min<std::uint32_t>(available, read_chunk_size), is_std_err, -1);
+        if (num_bytes < 0)
+            throw mp::SSHException(
+                fmt::format("error while reading ssh channel for remote process '{}' - error: {}", cmd, num_bytes));
+
+        (is_std_err ? err_handler : out_handler)(std::string_view{buffer.data(), static_cast<std::size_t>(num_bytes)});
+    }
+
+    return more;
+}
+
+int mp::SSHProcess::final_exit_code()
+{
+    // Waits for the status if it is not in yet, and fails if the channel closes without one
+    const auto status = ssh_channel_get_exit_status(channel.get());
+    if (status < 0)
+        throw ExitlessSSHProcessException{cmd, "no exit status"};
 
-    return output.str();
+    return status;
 }
 
 ssh_channel mp::SSHProcess::release_channel()
@@ -18,6 +18,7 @@
 #include <multipass/exceptions/ssh_exception.h>
 #include <multipass/format.h>
 #include <multipass/logging/log.h>
+#include <multipass/logging/metrics.h>
 #include <multipass/ssh/ssh_key_provider.h>
 #include <multipass/ssh/ssh_session.h>
 #include <multipass/ssh/throw_on_error.h>
@@ -27,13 +28,69 @@
 
 #include <QDir>
 
+#include <cerrno>
+#include <cstring>
 #include <string>
 
+#ifdef MULTIPASS_PLATFORM_LINUX
+#include <linux/vm_sockets.h>
+#include <sys/socket.h>
+#include <unistd.h>
+#endif
+
 namespace mp = multipass;
 namespace mpl = multipass::logging;
 
+namespace
+{
+constexpr auto vsock_prefix = "vsock:";
+
+bool is_vsock(const std::string& host)
+{
+    return host.rfind(vsock_prefix, 0) == 0;
+}
+
+// Hands libssh a socket of our own, as it knows nothing of vsock
+void connect_over_vsock(ssh_session session, const std::string& host, int port)
+{
+#ifdef MULTIPASS_PLATFORM_LINUX
+    sockaddr_vm address{};
+    address.svm_family = AF_VSOCK;
+    address.svm_port = static_cast<unsigned int>(port);
+    try
+    {
+        address.svm_cid = static_cast<unsigned int>(std::stoul(host.substr(std::strlen(vsock_prefix))));
+    }
+    catch (const std::logic_error&)
+    {
+        throw mp::SSHException(fmt::format("invalid vsock host: {}", host));
+    }
+
+    const socket_t fd = socket(AF_VSOCK, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    if (fd < 0)
+        throw mp::SSHException(fmt::format("could not open a vsock socket: {}", std::strerror(errno)));
+
+    if (connect(fd, reinterpret_cast<sockaddr*>(&address), sizeof(address)) != 0 ||
+        ssh_options_set(session, SSH_OPTIONS_FD, &fd) != SSH_OK)
+    {
+        const auto error = errno;
+        close(fd);
+        throw mp::SSHException(fmt::format("could not connect to {}: {}", host, std::strerror(error)));
+    }
+#else
+    throw mp::SSHException(fmt::format("cannot connect to {}: vsock is only available on Linux", host));
+#endif
+}
+} // namespace
+
+std::string mp::SSHSession::vsock_host(std::uint32_t cid)
+{
+    return fmt::format("{}{}", vsock_prefix, cid);
+}
+
 mp::SSHSession::SSHSession(const std::string& host, int port, const std::string& username,
-                           const SSHKeyProvider* key_provider, const std::chrono::milliseconds timeout)
+                           const SSHKeyProvider* key_provider, const std::chrono::milliseconds timeout,
+                           bool compression, const std::string& ciphers)
     : session{ssh_new(), ssh_free}
 {
     if (session == nullptr)
@@ -43,26 +100,37 @@ mp::SSHSession::SSHSession(const std::string& host, int port, const std::string&
     const int nodelay{1};
     auto ssh_dir = QDir(MP_STDPATHS.writableLocation(StandardPaths::AppConfigLocation)).filePath("ssh").toStdString();
 
+    // Still named, as libssh keys known hosts by it
     set_option(SSH_OPTIONS_HOST, host.c_str());
-    set_option(SSH_OPTIONS_PORT, &port);
+    if (is_vsock(host))
+        connect_over_vsock(session.get(), host, port);
+    else
+        set_option(SSH_OPTIONS_PORT, &port);
     set_option(SSH_OPTIONS_USER, username.c_str());
     set_option(SSH_OPTIONS_TIMEOUT, &timeout_secs);
     set_option(SSH_OPTIONS_NODELAY, &nodelay);
-    set_option(SSH_OPTIONS_CIPHERS_C_S, "chacha20-poly1305@openssh.com,aes256-ctr");
-    set_option(SSH_OPTIONS_CIPHERS_S_C, "chacha20-poly1305@openssh.com,aes256-ctr");
+    set_option(SSH_OPTIONS_CIPHERS_C_S, ciphers.c_str());
+    set_option(SSH_OPTIONS_CIPHERS_S_C, ciphers.c_str());
     set_option(SSH_OPTIONS_SSH_DIR, ssh_dir.c_str());
 
+    // Only worth the CPU over slow links; the server may still turn it down
+    if (compression)
+        set_option(SSH_OPTIONS_COMPRESSION, "yes");
+
     SSH::throw_on_error(session, "ssh connection failed", ssh_connect);
     if (key_provider)
     {
         SSH::throw_on_error(session, "ssh failed to authenticate", ssh_userauth_publickey, nullptr,
                             key_provider->private_key());
     }
+
+    MP_METRICS.increment("multipass_ssh_sessions_opened_total");
 }
 
 mp::SSHSession::SSHSession(const std::string& host, int port, const std::string& username,
-                           const SSHKeyProvider& key_provider, const std::chrono::milliseconds timeout)
-    : SSHSession(host, port, username, &key_provider, timeout)
+                           const SSHKeyProvider& key_provider, const std::chrono::milliseconds timeout,
+                           bool compression, const std::string& ciphers)
+    : SSHSession(host, port, username, &key_provider, timeout, compression, ciphers)
 {
 }
 
@@ -73,7 +141,7 @@ mp::SSHSession::SSHSession(const std::string& host, int port, const std::chrono:
 
 mp::SSHProcess mp::SSHSession::exec(const std::string& cmd)
 {
-    mpl::log(mpl::Level::debug, "ssh session", fmt::format("Executing '{}'", cmd));
+    mpl::log(mpl::Record{mpl::Level::debug, "ssh session", "Executing", {}, {{"command", cmd}}});
     return {session.get(), cmd};
 }
 
@@ -112,6 +180,8 @@ const char* name_for(ssh_options_e type)
         return "server to client ciphers";
     case SSH_OPTIONS_SSH_DIR:
         return "ssh config directory";
+    case SSH_OPTIONS_COMPRESSION:
+        return "compression";
     default:
         break;
     }
@@ -127,6 +197,7 @@ std::string as_string(ssh_options_e type, const void* value)
     case SSH_OPTIONS_CIPHERS_C_S:
     case SSH_OPTIONS_CIPHERS_S_C:
     case SSH_OPTIONS_SSH_DIR:
+    case SSH_OPTIONS_COMPRESSION:
         return std::string(reinterpret_cast<const char*>(value));
     case SSH_OPTIONS_PORT:
     case SSH_OPTIONS_NODELAY:
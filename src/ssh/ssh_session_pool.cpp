@@ -0,0 +1,123 @@
+/*
+ * Copyright (C) Canonical, Ltd.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; version 3.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#include <multipass/ssh/ssh_session_pool.h>
+
+#include <multipass/exceptions/ssh_exception.h>
+#include <multipass/format.h>
+#include <multipass/logging/log.h>
+#include <multipass/ssh/ssh_session.h>
+
+#include <libssh/libssh.h>
+
+#include <algorithm>
+#include <iterator>
+
+namespace mp = multipass;
+namespace mpl = multipass::logging;
+
+namespace
+{
+constexpr auto category = "ssh session pool";
+
+// More than this many idle sessions to the same instance means the pool is not what is holding things up
+constexpr auto max_idle_per_instance = 4u;
+} // namespace
+
+mp::SSHSessionPool::SSHSessionPool(std::chrono::milliseconds max_idle) : max_idle{max_idle}
+{
+}
+
+mp::SSHSessionPool::~SSHSessionPool() = default;
+
+void mp::SSHSessionPool::with_session(const std::string& instance, const std::string& host, int port,
+                                      const std::string& username, const SSHKeyProvider& key_provider,
+                                      const Action& action)
+{
+    const Destination destination{host, port, username};
+    if (auto session = take(instance, destination))
+    {
+        try
+        {
+            action(*session);
+            give_back(instance, destination, std::move(session));
+            return;
+        }
+        catch (const SSHException& e) // the session or its channel failed, not the action
+        {
+            mpl::log(mpl::Level::debug, category,
+                     fmt::format("pooled session to \"{}\" failed, trying a new one: {}", instance, e.what()));
+        }
+    }
+
+    auto session = std::make_unique<SSHSession>(host, port, username, key_provider);
+    action(*session);
+    give_back(instance, destination, std::move(session));
+}
+
+void mp::SSHSessionPool::forget(const std::string& instance)
+{
+    // Disconnected once out of the lock, saying goodbye can take a while
+    std::vector<IdleSession> dropped;
+
+    std::lock_guard<std::mutex> lock{mutex};
+    if (auto it = idle_sessions.find(instance); it != idle_sessions.end())
+    {
+        dropped = std::move(it->second);
+        idle_sessions.erase(it);
+    }
+}
+
+std::unique_ptr<mp::SSHSession> mp::SSHSessionPool::take(const std::string& instance, const Destination& destination)
+{
+    std::vector<IdleSession> stale; // likewise let go of once out of the lock
+
+    std::lock_guard<std::mutex> lock{mutex};
+    auto it = idle_sessions.find(instance);
+    if (it == idle_sessions.end())
+        return nullptr;
+
+    // Whatever is too old or goes somewhere else, e.g. since the instance came back with another address, is dropped
+    auto& sessions = it->second;
+    const auto now = Clock::now();
+    const auto unfit = std::stable_partition(sessions.begin(), sessions.end(), [&](const IdleSession& idle) {
+        return idle.destination == destination && now - idle.since < max_idle && ssh_is_connected(*idle.session);
+    });
+    std::move(unfit, sessions.end(), std::back_inserter(stale));
+    sessions.erase(unfit, sessions.end());
+
+    if (sessions.empty())
+        return nullptr;
+
+    // The most recently used is the likeliest to still be alive
+    auto session = std::move(sessions.back().session);
+    sessions.pop_back();
+
+    return session;
+}
+
+void mp::SSHSessionPool::give_back(const std::string& instance, const Destination& destination,
+                                   std::unique_ptr<SSHSession> session)
+{
+    if (!ssh_is_connected(*session))
+        return;
+
+    std::lock_guard<std::mutex> lock{mutex};
+    auto& sessions = idle_sessions[instance];
+    if (sessions.size() < max_idle_per_instance)
+        sessions.push_back({destination, std::move(session), Clock::now()});
+}
@@ -0,0 +1,305 @@
+/*
+ * Copyright (C) Canonical, Ltd.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; version 3.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#include "sftp_attribute_cache.h"
+
+#include <multipass/format.h>
+#include <multipass/logging/log.h>
+#include <multipass/top_catch_all.h>
+
+#include <cerrno>
+#include <cstring>
+
+#include <fcntl.h>
+#include <unistd.h>
+
+#ifdef MULTIPASS_PLATFORM_LINUX
+#include <poll.h>
+#include <sys/inotify.h>
+#endif
+
+namespace mp = multipass;
+namespace mpl = multipass::logging;
+
+namespace
+{
+#ifdef MULTIPASS_PLATFORM_LINUX
+constexpr auto category = "sftp attribute cache";
+constexpr auto poll_timeout_ms = 250;
+#endif
+
+// Past this, everything is dropped and the cache starts over
+constexpr std::size_t max_entries = 100000u;
+
+// Only plain absolute paths are cached, anything else could name the same file more than one way
+bool cacheable(const std::string& path)
+{
+    auto ends_with = [&path](const std::string& suffix) {
+        return path.size() >= suffix.size() && path.compare(path.size() - suffix.size(), suffix.size(), suffix) == 0;
+    };
+
+    return path.size() > 1 && path.front() == '/' && path.back() != '/' && path.find("//") == std::string::npos &&
+           path.find("/./") == std::string::npos && path.find("/../") == std::string::npos && !ends_with("/.") &&
+           !ends_with("/..");
+}
+
+std::string parent_of(const std::string& path)
+{
+    const auto pos = path.rfind('/');
+    if (pos == std::string::npos)
+        return {};
+
+    return pos == 0 ? "/" : path.substr(0, pos);
+}
+
+std::string join(const std::string& dir, const std::string& name)
+{
+    return dir == "/" ? dir + name : dir + "/" + name;
+}
+
+bool starts_with(const std::string& path, const std::string& prefix)
+{
+    return path.compare(0, prefix.size(), prefix) == 0;
+}
+} // namespace
+
+mp::SftpAttributeCache::SftpAttributeCache()
+{
+#ifdef MULTIPASS_PLATFORM_LINUX
+    inotify_fd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+    if (inotify_fd < 0)
+    {
+        mpl::log(mpl::Level::info, category,
+                 fmt::format("cannot watch for changes, attributes won't be cached: {}", std::strerror(errno)));
+        return;
+    }
+
+    watcher = std::thread{[this] { mp::top_catch_all(category, [this] { watch_for_changes(); }); }};
+#endif
+}
+
+mp::SftpAttributeCache::~SftpAttributeCache()
+{
+    stopping = true;
+    if (watcher.joinable())
+        watcher.join();
+
+    if (inotify_fd >= 0)
+        close(inotify_fd);
+}
+
+int mp::SftpAttributeCache::lstat(const std::string& path, struct stat& st)
+{
+    return lookup(path, parent_of(path), [&path](struct stat& st) { return ::lstat(path.c_str(), &st); }, st);
+}
+
+int mp::SftpAttributeCache::stat(const std::string& path, struct stat& st)
+{
+    if (auto ret = lstat(path, st); ret < 0 || !S_ISLNK(st.st_mode))
+        return ret;
+
+    // Wherever the link points to isn't watched
+    return ::stat(path.c_str(), &st);
+}
+
+int mp::SftpAttributeCache::lstat_at(int dir_fd, const std::string& dir, const std::string& name, struct stat& st)
+{
+    return lookup(
+        join(dir, name), dir,
+        [dir_fd, &name](struct stat& st) { return fstatat(dir_fd, name.c_str(), &st, AT_SYMLINK_NOFOLLOW); }, st);
+}
+
+void mp::SftpAttributeCache::invalidate(const std::string& path)
+{
+    if (!enabled())
+        return;
+
+    std::lock_guard<std::mutex> lock{mutex};
+    entries.erase(path);
+
+    const auto dir = parent_of(path);
+    entries.erase(dir);
+    if (auto it = watch_by_dir.find(dir); it != watch_by_dir.end())
+        ++watches[it->second].generation;
+
+    // In case it was a directory that was renamed or removed
+    forget_tree(path);
+}
+
+bool mp::SftpAttributeCache::enabled() const
+{
+    return inotify_fd >= 0;
+}
+
+int mp::SftpAttributeCache::lookup(const std::string& path, const std::string& dir, const Stat& do_stat,
+                                   struct stat& st)
+{
+    if (!enabled() || !cacheable(path))
+        return do_stat(st);
+
+    int wd{-1};
+    std::uint64_t generation{0};
+    {
+        std::lock_guard<std::mutex> lock{mutex};
+        if (auto it = entries.find(path); it != entries.end())
+        {
+            if (it->second.error != 0)
+            {
+                errno = it->second.error;
+                return -1;
+            }
+
+            st = it->second.st;
+            return 0;
+        }
+
+        wd = watch_for(dir);
+        if (wd >= 0)
+            generation = watches[wd].generation;
+    }
+
+    const auto ret = do_stat(st);
+    const auto error = ret < 0 ? errno : 0;
+
+    if (wd >= 0 && (ret == 0 || error == ENOENT))
+    {
+        std::lock_guard<std::mutex> lock{mutex};
+
+        // Whatever changed in the directory meanwhile may not be reflected in what was just read
+        if (auto it = watches.find(wd); it != watches.end() && it->second.generation == generation)
+        {
+            if (entries.size() >= max_entries)
+                entries.clear();
+
+            entries.insert_or_assign(path, Entry{error, st});
+        }
+    }
+
+    errno = error;
+    return ret;
+}
+
+int mp::SftpAttributeCache::watch_for(const std::string& dir)
+{
+    if (auto it = watch_by_dir.find(dir); it != watch_by_dir.end())
+        return it->second;
+
+#ifdef MULTIPASS_PLATFORM_LINUX
+    constexpr auto mask = IN_ATTRIB | IN_MODIFY | IN_CREATE | IN_DELETE | IN_MOVED_FROM | IN_MOVED_TO |
+                          IN_DELETE_SELF | IN_MOVE_SELF | IN_ONLYDIR | IN_EXCL_UNLINK;
+
+    const auto wd = inotify_add_watch(inotify_fd, dir.c_str(), mask);
+    if (wd < 0)
+    {
+        mpl::log(mpl::Level::trace, category, fmt::format("cannot watch \'{}\': {}", dir, std::strerror(errno)));
+        return -1;
+    }
+
+    // Already watched under another name, e.g. through a symlink; changes are only reported for that one
+    if (!watches.try_emplace(wd, Watch{dir, 0}).second)
+        return -1;
+
+    watch_by_dir.emplace(dir, wd);
+    return wd;
+#else
+    return -1;
+#endif
+}
+
+void mp::SftpAttributeCache::forget_tree(const std::string& path)
+{
+    const auto prefix = path == "/" ? path : path + "/";
+    for (auto it = entries.lower_bound(prefix); it != entries.end() && starts_with(it->first, prefix);)
+        it = entries.erase(it);
+
+    auto drop_watch = [this](std::map<std::string, int>::iterator it) {
+#ifdef MULTIPASS_PLATFORM_LINUX
+        inotify_rm_watch(inotify_fd, it->second);
+#endif
+        watches.erase(it->second);
+        return watch_by_dir.erase(it);
+    };
+
+    if (auto it = watch_by_dir.find(path); it != watch_by_dir.end())
+        drop_watch(it);
+
+    for (auto it = watch_by_dir.lower_bound(prefix); it != watch_by_dir.end() && starts_with(it->first, prefix);)
+        it = drop_watch(it);
+}
+
+void mp::SftpAttributeCache::watch_for_changes()
+{
+#ifdef MULTIPASS_PLATFORM_LINUX
+    alignas(struct inotify_event) char buffer[16 * 1024];
+    pollfd fds{inotify_fd, POLLIN, 0};
+
+    while (!stopping)
+    {
+        if (poll(&fds, 1, poll_timeout_ms) <= 0)
+            continue;
+
+        const auto len = read(inotify_fd, buffer, sizeof(buffer));
+        if (len > 0)
+            handle_events(buffer, len);
+    }
+#endif
+}
+
+void mp::SftpAttributeCache::handle_events(const char* buffer, std::size_t len)
+{
+#ifdef MULTIPASS_PLATFORM_LINUX
+    std::lock_guard<std::mutex> lock{mutex};
+
+    for (auto ptr = buffer; ptr < buffer + len;)
+    {
+        const auto& event = *reinterpret_cast<const struct inotify_event*>(ptr);
+        ptr += sizeof(struct inotify_event) + event.len;
+
+        if (event.mask & IN_Q_OVERFLOW)
+        {
+            // Changes went unreported, nothing cached can be trusted anymore
+            entries.clear();
+            for (auto& [wd, watch] : watches)
+                ++watch.generation;
+            continue;
+        }
+
+        auto it = watches.find(event.wd);
+        if (it == watches.end())
+            continue;
+
+        ++it->second.generation;
+        const auto dir = it->second.dir;
+
+        // The directory's own times move on along with its entries
+        entries.erase(dir);
+
+        if (event.len > 0)
+        {
+            const auto path = join(dir, event.name);
+            entries.erase(path);
+
+            // A name now refers to something else, whatever was known below the old one no longer applies
+            if (event.mask & (IN_CREATE | IN_DELETE | IN_MOVED_FROM | IN_MOVED_TO))
+                forget_tree(path);
+        }
+
+        if (event.mask & (IN_DELETE_SELF | IN_MOVE_SELF | IN_IGNORED))
+            forget_tree(dir);
+    }
+#endif
+}
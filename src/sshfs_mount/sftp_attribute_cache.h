@@ -0,0 +1,84 @@
+/*
+ * Copyright (C) Canonical, Ltd.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; version 3.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#ifndef MULTIPASS_SFTP_ATTRIBUTE_CACHE_H
+#define MULTIPASS_SFTP_ATTRIBUTE_CACHE_H
+
+#include <multipass/disabled_copy_move.h>
+
+#include <atomic>
+#include <cstdint>
+#include <functional>
+#include <map>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <unordered_map>
+
+#include <sys/stat.h>
+
+namespace multipass
+{
+// Remembers lstat() results, including missing files, for the paths the sftp server is asked about. Each directory a
+// cached path lives in is watched with inotify, and entries are dropped as soon as a change to them is reported.
+// Where inotify is not available, or a directory cannot be watched, lookups go straight to the filesystem.
+class SftpAttributeCache : private DisabledCopyMove
+{
+public:
+    SftpAttributeCache();
+    ~SftpAttributeCache();
+
+    // Same contract as their namesakes: 0 on success, -1 with errno set otherwise
+    int lstat(const std::string& path, struct stat& st);
+    int stat(const std::string& path, struct stat& st);
+    int lstat_at(int dir_fd, const std::string& dir, const std::string& name, struct stat& st);
+
+    // For changes made by the server itself, which must be visible to the very next request
+    void invalidate(const std::string& path);
+
+    bool enabled() const;
+
+private:
+    struct Entry
+    {
+        int error; // errno of a failed lookup, 0 if st holds the attributes
+        struct stat st;
+    };
+
+    struct Watch
+    {
+        std::string dir;
+        std::uint64_t generation{0}; // bumped whenever something in the directory changes
+    };
+
+    using Stat = std::function<int(struct stat&)>;
+    int lookup(const std::string& path, const std::string& dir, const Stat& do_stat, struct stat& st);
+    int watch_for(const std::string& dir);
+    void forget_tree(const std::string& path);
+    void watch_for_changes();
+    void handle_events(const char* buffer, std::size_t len);
+
+    int inotify_fd{-1};
+    std::mutex mutex;
+    std::map<std::string, Entry> entries; // ordered, so that whole subtrees can be dropped at once
+    std::map<std::string, int> watch_by_dir;
+    std::unordered_map<int, Watch> watches;
+    std::atomic_bool stopping{false};
+    std::thread watcher;
+};
+} // namespace multipass
+#endif // MULTIPASS_SFTP_ATTRIBUTE_CACHE_H
@@ -0,0 +1,172 @@
+/*
+ * Copyright (C) Canonical, Ltd.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; version 3.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#include "sftp_dispatcher.h"
+
+#include <multipass/format.h>
+#include <multipass/top_catch_all.h>
+
+#include <scope_guard.hpp>
+
+#include <algorithm>
+
+namespace mp = multipass;
+
+namespace
+{
+constexpr auto category = "sftp dispatcher";
+constexpr auto max_default_workers = 8u;
+} // namespace
+
+mp::SftpDispatcher::SftpDispatcher(unsigned num_workers)
+{
+    num_workers = std::max(num_workers, 1u);
+    workers.reserve(num_workers);
+    for (auto i = 0u; i < num_workers; ++i)
+        workers.emplace_back(&SftpDispatcher::work, this);
+}
+
+mp::SftpDispatcher::~SftpDispatcher()
+{
+    {
+        std::lock_guard<std::mutex> lock{mutex};
+        stopping = true;
+    }
+    work_available.notify_all();
+
+    for (auto& worker : workers)
+        if (worker.joinable())
+            worker.join();
+}
+
+unsigned mp::SftpDispatcher::default_num_workers()
+{
+    return std::clamp(std::thread::hardware_concurrency(), 2u, max_default_workers);
+}
+
+void mp::SftpDispatcher::dispatch(const std::string& key, Task task)
+{
+    {
+        std::lock_guard<std::mutex> lock{mutex};
+        ++in_flight;
+
+        auto [it, inserted] = waiting_by_key.try_emplace(key);
+        if (!inserted)
+        {
+            // Another task for this key is queued or running; it hands over to this one when done
+            it->second.push_back(std::move(task));
+            return;
+        }
+
+        ready.emplace_back(key, std::move(task));
+    }
+    work_available.notify_one();
+}
+
+void mp::SftpDispatcher::wait_for_idle()
+{
+    std::unique_lock<std::mutex> lock{mutex};
+    all_done.wait(lock, [this] { return in_flight == 0; });
+}
+
+bool mp::SftpDispatcher::idle() const
+{
+    std::lock_guard<std::mutex> lock{mutex};
+    return in_flight == 0;
+}
+
+void mp::SftpDispatcher::work()
+{
+    std::unique_lock<std::mutex> lock{mutex};
+    while (true)
+    {
+        work_available.wait(lock, [this] { return stopping || !ready.empty(); });
+        if (ready.empty())
+            return;
+
+        auto [key, task] = std::move(ready.front());
+        ready.pop_front();
+
+        lock.unlock();
+        mp::top_catch_all(category, task);
+        task = nullptr; // release whatever the task holds before handing over
+        lock.lock();
+
+        --in_flight;
+
+        auto it = waiting_by_key.find(key);
+        if (it->second.empty())
+        {
+            waiting_by_key.erase(it);
+        }
+        else
+        {
+            ready.emplace_back(std::move(key), std::move(it->second.front()));
+            it->second.pop_front();
+            work_available.notify_one();
+        }
+
+        if (in_flight == 0)
+            all_done.notify_all();
+    }
+}
+
+mp::SftpDispatchQueue::SftpDispatchQueue(std::shared_ptr<SftpDispatcher> dispatcher) : dispatcher{std::move(dispatcher)}
+{
+}
+
+mp::SftpDispatchQueue::~SftpDispatchQueue()
+{
+    // Tasks refer to this queue, and the dispatcher may well outlive it
+    wait_for_idle();
+}
+
+void mp::SftpDispatchQueue::dispatch(const std::string& key, Task task)
+{
+    {
+        std::lock_guard<std::mutex> lock{mutex};
+        ++in_flight;
+    }
+
+    dispatcher->dispatch(fmt::format("{}:{}", fmt::ptr(this), key), [this, task = std::move(task)]() mutable {
+        auto guard = sg::make_scope_guard([this, &task]() noexcept {
+            task = nullptr; // released before the queue can be considered done with
+            done();
+        });
+        task();
+    });
+}
+
+void mp::SftpDispatchQueue::wait_for_idle()
+{
+    std::unique_lock<std::mutex> lock{mutex};
+    all_done.wait(lock, [this] { return in_flight == 0; });
+}
+
+bool mp::SftpDispatchQueue::idle() const
+{
+    std::lock_guard<std::mutex> lock{mutex};
+    return in_flight == 0;
+}
+
+void mp::SftpDispatchQueue::done()
+{
+    // Notified while holding the lock, as whoever is waiting may destroy the queue as soon as it gets it
+    std::lock_guard<std::mutex> lock{mutex};
+    if (--in_flight == 0)
+        all_done.notify_all();
+}
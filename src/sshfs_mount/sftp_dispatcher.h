@@ -0,0 +1,87 @@
+/*
+ * Copyright (C) Canonical, Ltd.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; version 3.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#ifndef MULTIPASS_SFTP_DISPATCHER_H
+#define MULTIPASS_SFTP_DISPATCHER_H
+
+#include <multipass/disabled_copy_move.h>
+
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+namespace multipass
+{
+// Runs tasks on a fixed pool of worker threads. Tasks sharing a key run one at a time, in the order they were
+// dispatched; tasks with different keys may run concurrently and complete in any order.
+class SftpDispatcher : private DisabledCopyMove
+{
+public:
+    using Task = std::function<void()>;
+
+    explicit SftpDispatcher(unsigned num_workers);
+    ~SftpDispatcher();
+
+    static unsigned default_num_workers(); // a few, regardless of how many servers end up sharing them
+
+    void dispatch(const std::string& key, Task task);
+    void wait_for_idle();
+    bool idle() const;
+
+private:
+    void work();
+
+    mutable std::mutex mutex;
+    std::condition_variable work_available;
+    std::condition_variable all_done;
+    std::deque<std::pair<std::string, Task>> ready;
+    std::unordered_map<std::string, std::deque<Task>> waiting_by_key;
+    std::size_t in_flight{0};
+    bool stopping{false};
+    std::vector<std::thread> workers;
+};
+
+// One server's share of a dispatcher that may be working for others too. Its keys do not clash with theirs, and
+// waiting for or checking idleness only concerns the tasks dispatched through it.
+class SftpDispatchQueue : private DisabledCopyMove
+{
+public:
+    using Task = SftpDispatcher::Task;
+
+    explicit SftpDispatchQueue(std::shared_ptr<SftpDispatcher> dispatcher);
+    ~SftpDispatchQueue();
+
+    void dispatch(const std::string& key, Task task);
+    void wait_for_idle();
+    bool idle() const;
+
+private:
+    void done();
+
+    const std::shared_ptr<SftpDispatcher> dispatcher;
+    mutable std::mutex mutex;
+    std::condition_variable all_done;
+    std::size_t in_flight{0};
+};
+} // namespace multipass
+#endif // MULTIPASS_SFTP_DISPATCHER_H
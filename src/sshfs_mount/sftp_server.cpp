@@ -31,6 +31,20 @@
 #include <QDir>
 #include <QFile>
 
+#include <scope_guard.hpp>
+
+#include <algorithm>
+#include <cerrno>
+#include <chrono>
+#include <cstring>
+#include <fcntl.h>
+#include <optional>
+#include <sys/stat.h>
+#include <sys/statvfs.h>
+#include <thread>
+#include <unistd.h>
+#include <utility>
+
 namespace mp = multipass;
 namespace mpl = multipass::logging;
 
@@ -38,8 +52,38 @@ namespace
 {
 constexpr auto category = "sftp server";
 using SftpHandleUPtr = std::unique_ptr<ssh_string_struct, void (*)(ssh_string)>;
+using MsgUPtr = std::unique_ptr<sftp_client_message_struct, decltype(sftp_client_message_free)*>;
 using namespace std::literals::chrono_literals;
 
+// How long to wait for client data while holding the session: long when there is no work in flight, short otherwise
+// so that workers don't sit on finished replies
+constexpr auto idle_poll_timeout = 250ms;
+constexpr auto busy_poll_timeout = 1ms;
+
+// sshfs asks for 64 KiB at a time by default, but bigger reads are honoured up to what OpenSSH's sftp-server allows
+constexpr auto max_read_size = 256u * 1024u;
+
+// Once a handle has seen this many back-to-back reads, the following ones are fetched ahead of time
+constexpr auto sequential_reads_before_read_ahead = 2;
+constexpr auto read_ahead_factor = 4;
+constexpr qint64 max_read_ahead_size = 1024 * 1024;
+
+// With write-behind, adjacent writes on a handle are gathered up to this size before being applied, and no more than
+// max_dirty_bytes are held back across all handles; anything beyond that is written straight away
+constexpr qint64 max_write_behind_size = 1024 * 1024;
+constexpr qint64 max_dirty_bytes = 16 * 1024 * 1024;
+
+// What limits@openssh.com tells clients they can ask for, so that they don't stick to conservative defaults; packets
+// leave room for the request around the data
+constexpr std::uint64_t max_packet_size = max_read_size + 1024u;
+
+// Server-side copies go in steps of this size, so that a big one doesn't hold a worker in a single call for long
+constexpr qint64 max_copy_chunk = 8 * 1024 * 1024;
+
+// Directory listings are sent in replies of about this size; each entry costs its names plus the encoded attributes
+constexpr std::size_t max_readdir_reply_size = 64u * 1024u;
+constexpr std::size_t readdir_entry_overhead = 64u;
+
 enum Permissions
 {
     read_user = 0400,
@@ -60,103 +104,45 @@ auto make_sftp_session(ssh_session session, ssh_channel channel)
     return sftp_server_session;
 }
 
-int reply_ok(sftp_client_message msg)
-{
-    return sftp_reply_status(msg, SSH_FX_OK, nullptr);
-}
-
-int reply_failure(sftp_client_message msg)
-{
-    return sftp_reply_status(msg, SSH_FX_FAILURE, nullptr);
-}
-
-int reply_perm_denied(sftp_client_message msg)
-{
-    return sftp_reply_status(msg, SSH_FX_PERMISSION_DENIED, "permission denied");
-}
-
-int reply_bad_handle(sftp_client_message msg, const char* type)
-{
-    return sftp_reply_status(msg, SSH_FX_BAD_MESSAGE, fmt::format("{}: invalid handle", type).c_str());
-}
-
-int reply_unsupported(sftp_client_message msg)
-{
-    return sftp_reply_status(msg, SSH_FX_OP_UNSUPPORTED, "Unsupported message");
-}
-
 fmt::memory_buffer& operator<<(fmt::memory_buffer& buf, const char* v)
 {
     fmt::format_to(std::back_inserter(buf), v);
     return buf;
 }
 
-auto longname_from(const QFileInfo& file_info, const std::string& filename)
+auto longname_from(const struct stat& st, const std::string& filename)
 {
     fmt::memory_buffer out;
-    auto mode = file_info.permissions();
+    const auto mode = st.st_mode;
 
-    if (file_info.isSymLink())
+    if (S_ISLNK(mode))
         out << "l";
-    else if (file_info.isDir())
+    else if (S_ISDIR(mode))
         out << "d";
     else
         out << "-";
 
     /* user */
-    if (mode & QFileDevice::ReadOwner)
-        out << "r";
-    else
-        out << "-";
-
-    if (mode & QFileDevice::WriteOwner)
-        out << "w";
-    else
-        out << "-";
-
-    if (mode & QFileDevice::ExeOwner)
-        out << "x";
-    else
-        out << "-";
+    out << (mode & S_IRUSR ? "r" : "-");
+    out << (mode & S_IWUSR ? "w" : "-");
+    out << (mode & S_IXUSR ? "x" : "-");
 
     /*group*/
-    if (mode & QFileDevice::ReadGroup)
-        out << "r";
-    else
-        out << "-";
-
-    if (mode & QFileDevice::WriteGroup)
-        out << "w";
-    else
-        out << "-";
-
-    if (mode & QFileDevice::ExeGroup)
-        out << "x";
-    else
-        out << "-";
+    out << (mode & S_IRGRP ? "r" : "-");
+    out << (mode & S_IWGRP ? "w" : "-");
+    out << (mode & S_IXGRP ? "x" : "-");
 
     /* other */
-    if (mode & QFileDevice::ReadOther)
-        out << "r";
-    else
-        out << "-";
-
-    if (mode & QFileDevice::WriteOther)
-        out << "w";
-    else
-        out << "-";
-
-    if (mode & QFileDevice::ExeOther)
-        out << "x";
-    else
-        out << "-";
+    out << (mode & S_IROTH ? "r" : "-");
+    out << (mode & S_IWOTH ? "w" : "-");
+    out << (mode & S_IXOTH ? "x" : "-");
 
-    fmt::format_to(std::back_inserter(out), " 1 {} {} {}", file_info.ownerId(), file_info.groupId(), file_info.size());
+    fmt::format_to(std::back_inserter(out), " 1 {} {} {}", st.st_uid, st.st_gid, st.st_size);
 
-    const auto timestamp = file_info.lastModified().toString("MMM d hh:mm:ss yyyy").toStdString();
+    const auto timestamp = QDateTime::fromSecsSinceEpoch(st.st_mtime).toString("MMM d hh:mm:ss yyyy").toStdString();
     fmt::format_to(std::back_inserter(out), " {} {}", timestamp, filename);
 
-    return out;
+    return fmt::to_string(out);
 }
 
 auto to_qt_permissions(uint32_t perms)
@@ -220,15 +206,107 @@ auto validate_path(const std::string& source_path, const std::string& current_pa
 }
 
 template <typename T>
-auto handle_from(sftp_client_message msg, const std::unordered_map<void*, std::unique_ptr<T>>& handles) -> T*
+auto handle_from(sftp_session sftp, ssh_string handle, const std::unordered_map<void*, std::unique_ptr<T>>& handles,
+                 std::mutex& handles_mutex) -> T*
 {
-    const auto id = sftp_handle(msg->sftp, msg->handle);
+    std::lock_guard<std::mutex> lock{handles_mutex};
+    const auto id = sftp_handle(sftp, handle);
     auto entry = handles.find(id);
     if (entry != handles.end())
         return entry->second.get();
     return nullptr;
 }
 
+template <typename T>
+auto handle_from(sftp_client_message msg, const std::unordered_map<void*, std::unique_ptr<T>>& handles,
+                 std::mutex& handles_mutex) -> T*
+{
+    return handle_from(msg->sftp, msg->handle, handles, handles_mutex);
+}
+
+template <typename T>
+auto handle_from(sftp_client_message msg, const std::optional<std::string>& handle,
+                 const std::unordered_map<void*, std::unique_ptr<T>>& handles, std::mutex& handles_mutex) -> T*
+{
+    if (!handle)
+        return nullptr;
+
+    SftpHandleUPtr id{ssh_string_new(handle->size()), ssh_string_free};
+    if (!id || ssh_string_fill(id.get(), handle->data(), handle->size()) != 0)
+        return nullptr;
+
+    return handle_from(msg->sftp, id.get(), handles, handles_mutex);
+}
+
+// The arguments of the extended requests libssh doesn't parse, read from the copy of the packet it keeps: they follow
+// the request id and the extension's name
+class ExtendedArgs
+{
+public:
+    explicit ExtendedArgs(sftp_client_message msg)
+        : next{msg->complete_message ? static_cast<const unsigned char*>(ssh_buffer_get(msg->complete_message))
+                                     : nullptr},
+          end{next ? next + ssh_buffer_get_len(msg->complete_message) : nullptr}
+    {
+        number(4);
+        string();
+    }
+
+    std::optional<std::uint64_t> u64()
+    {
+        return number(8);
+    }
+
+    std::optional<std::string> string()
+    {
+        const auto size = number(4);
+        if (!size || *size > static_cast<std::uint64_t>(end - next))
+            return std::nullopt;
+
+        std::string value(reinterpret_cast<const char*>(next), *size);
+        next += *size;
+        return value;
+    }
+
+private:
+    std::optional<std::uint64_t> number(int bytes)
+    {
+        if (next == nullptr || end - next < bytes)
+        {
+            next = end;
+            return std::nullopt;
+        }
+
+        std::uint64_t value{0};
+        for (auto i = 0; i < bytes; ++i)
+            value = (value << 8) | *next++;
+        return value;
+    }
+
+    const unsigned char* next;
+    const unsigned char* const end;
+};
+
+// libssh has no reply for extended requests, so the packet is framed here: its length, type and request id, then the
+// values the extension answers with
+int extended_reply(sftp_client_message msg, ssh_channel channel, const std::vector<std::uint64_t>& values)
+{
+    std::vector<unsigned char> packet;
+    auto append = [&packet](std::uint64_t value, int bytes) {
+        for (auto shift = 8 * (bytes - 1); shift >= 0; shift -= 8)
+            packet.push_back(static_cast<unsigned char>(value >> shift));
+    };
+
+    append(1 + 4 + 8 * values.size(), 4);
+    append(SSH_FXP_EXTENDED_REPLY, 1);
+    append(msg->id, 4);
+    for (const auto value : values)
+        append(value, 8);
+
+    const auto written = ssh_channel_write(channel, packet.data(), packet.size());
+    return written == static_cast<int>(packet.size()) ? SSH_OK : SSH_ERROR;
+}
+
 void check_sshfs_status(mp::SSHSession& session, mp::SSHProcess& sshfs_process)
 {
     try
@@ -276,28 +354,169 @@ int reverse_id_for(const mp::id_mappings& id_maps, const int id, const int rev_i
 
     return found == id_maps.cend() ? rev_id_if_not_found : found->first;
 }
+
+bool write_at(QFile& file, qint64 offset, const char* data, qint64 len)
+{
+    if (!MP_FILEOPS.seek(file, offset))
+    {
+        mpl::log(mpl::Level::trace, category, "{}: cannot seek to position {} in \'{}\'", __FUNCTION__, offset,
+                 file.fileName());
+        return false;
+    }
+
+    do
+    {
+        auto r = MP_FILEOPS.write(file, data, len);
+        if (r < 0)
+        {
+            mpl::log(mpl::Level::trace, category, "{}: write failed for \'{}\': {}", __FUNCTION__, file.fileName(),
+                     file.errorString());
+            return false;
+        }
+
+        file.flush();
+
+        data += r;
+        len -= r;
+    } while (len > 0);
+
+    return true;
+}
+
+// How much of the range was copied, 0 at the end of the source or -1 on failure
+qint64 copy_chunk(QFile& from, qint64 from_offset, QFile& to, qint64 to_offset, qint64 len, std::vector<char>& buffer)
+{
+#ifdef MULTIPASS_PLATFORM_LINUX
+    // Lets the filesystem share extents or copy within the kernel, where it can
+    loff_t in{from_offset}, out{to_offset};
+    const auto r = ::copy_file_range(from.handle(), &in, to.handle(), &out, len, 0);
+    if (r >= 0 || (errno != EXDEV && errno != ENOSYS && errno != EINVAL && errno != EOPNOTSUPP))
+        return r;
+#endif
+
+    buffer.resize(len);
+    const auto r = MP_FILEOPS.read_at(from, buffer.data(), len, from_offset);
+    if (r <= 0)
+        return r;
+
+    return write_at(to, to_offset, buffer.data(), r) ? r : -1;
+}
+
+// A length of 0 copies up to the end of the source, as copy-data has it
+bool copy_range(QFile& from, qint64 from_offset, QFile& to, qint64 to_offset, qint64 length)
+{
+    const auto until_eof = length == 0;
+    std::vector<char> buffer;
+    while (until_eof || length > 0)
+    {
+        const auto chunk = until_eof ? max_copy_chunk : std::min(length, max_copy_chunk);
+        const auto copied = copy_chunk(from, from_offset, to, to_offset, chunk, buffer);
+        if (copied < 0)
+            return false;
+        if (copied == 0)
+            break;
+
+        from_offset += copied;
+        to_offset += copied;
+        length -= copied;
+    }
+
+    return true;
+}
+
+bool operates_on_handle(uint8_t type)
+{
+    switch (type)
+    {
+    case SFTP_CLOSE:
+    case SFTP_READ:
+    case SFTP_WRITE:
+    case SFTP_FSTAT:
+    case SFTP_FSETSTAT:
+    case SFTP_READDIR:
+        return true;
+    default:
+        return false;
+    }
+}
+
+// Opening allocates the handle that later messages refer to, so it has to be done before reading the next message
+bool allocates_handle(uint8_t type)
+{
+    return type == SFTP_OPEN || type == SFTP_OPENDIR;
+}
 } // namespace
 
 mp::SftpServer::SftpServer(SSHSession&& session, const std::string& source, const std::string& target,
                            const id_mappings& gid_mappings, const id_mappings& uid_mappings, int default_uid,
-                           int default_gid, const std::string& sshfs_exec_line)
-    : ssh_session{std::move(session)},
-      sshfs_process{create_sshfs_process(ssh_session, sshfs_exec_line, mp::utils::escape_char(source, '"'),
+                           int default_gid, const std::string& sshfs_exec_line, bool write_behind)
+    : SftpServer{std::make_shared<SSHSession>(std::move(session)),
+                 std::make_shared<std::mutex>(),
+                 source,
+                 target,
+                 gid_mappings,
+                 uid_mappings,
+                 default_uid,
+                 default_gid,
+                 sshfs_exec_line,
+                 write_behind}
+{
+    owns_session = true;
+}
+
+mp::SftpServer::SftpServer(std::shared_ptr<SSHSession> session, std::shared_ptr<std::mutex> session_mutex,
+                           const std::string& source, const std::string& target, const id_mappings& gid_mappings,
+                           const id_mappings& uid_mappings, int default_uid, int default_gid,
+                           const std::string& sshfs_exec_line, bool write_behind,
+                           std::shared_ptr<SftpDispatcher> shared_dispatcher)
+    : session_mutex{std::move(session_mutex)},
+      ssh_session{std::move(session)},
+      sshfs_process{create_sshfs_process(*ssh_session, sshfs_exec_line, mp::utils::escape_char(source, '"'),
                                          mp::utils::escape_char(target, '"'))},
-      sftp_server_session{make_sftp_session(ssh_session, sshfs_process->release_channel())},
+      sftp_server_session{make_sftp_session(*ssh_session, sshfs_process->release_channel())},
       source_path{source},
       target_path{target},
       gid_mappings{gid_mappings},
       uid_mappings{uid_mappings},
       default_uid{default_uid},
       default_gid{default_gid},
-      sshfs_exec_line{sshfs_exec_line}
+      sshfs_exec_line{sshfs_exec_line},
+      write_behind{write_behind},
+      dispatcher{shared_dispatcher ? std::move(shared_dispatcher)
+                                   : std::make_shared<SftpDispatcher>(SftpDispatcher::default_num_workers())}
 {
 }
 
 mp::SftpServer::~SftpServer()
 {
     stop_invoked = true;
+
+    // The client was told these writes succeeded, so they must not be dropped along with the handles
+    dispatcher.wait_for_idle();
+    flush_all_writes();
+
+    // Closing the channel goes through the session, which other servers may be using
+    std::lock_guard<std::mutex> lock{*session_mutex};
+    sftp_server_session.reset();
+    sshfs_process.reset();
+}
+
+sftp_attributes_struct mp::SftpServer::attr_from(const struct stat& st)
+{
+    sftp_attributes_struct attr{};
+
+    attr.size = st.st_size;
+
+    attr.uid = mapped_uid_for(st.st_uid);
+    attr.gid = mapped_gid_for(st.st_gid);
+
+    attr.permissions = st.st_mode;
+    attr.atime = st.st_atime;
+    attr.mtime = st.st_mtime;
+    attr.flags =
+        SSH_FILEXFER_ATTR_SIZE | SSH_FILEXFER_ATTR_UIDGID | SSH_FILEXFER_ATTR_PERMISSIONS | SSH_FILEXFER_ATTR_ACMODTIME;
+
+    return attr;
 }
 
 sftp_attributes_struct mp::SftpServer::attr_from(const QFileInfo& file_info)
@@ -345,10 +564,171 @@ inline int mp::SftpServer::reverse_gid_for(const int gid, const int rev_gid_if_n
     return reverse_id_for(gid_mappings, gid, rev_gid_if_not_found);
 }
 
+mp::SftpServer::OpenFile::~OpenFile()
+{
+    std::unique_lock<std::mutex> lock{read_ahead.mutex};
+    read_ahead.filled.wait(lock, [this] { return !read_ahead.pending; });
+}
+
+const char* mp::SftpServer::read_ahead_data(OpenFile& handle, qint64 offset, qint64 len)
+{
+    auto& read_ahead = handle.read_ahead;
+    std::unique_lock<std::mutex> lock{read_ahead.mutex};
+
+    if (read_ahead.pending && offset >= read_ahead.offset && offset < read_ahead.offset + read_ahead.requested)
+        read_ahead.filled.wait(lock, [&read_ahead] { return !read_ahead.pending; });
+
+    if (!read_ahead.pending && offset >= read_ahead.offset && offset + len <= read_ahead.offset + read_ahead.size)
+        return read_ahead.data.data() + (offset - read_ahead.offset);
+
+    return nullptr;
+}
+
+void mp::SftpServer::schedule_read_ahead(OpenFile& handle, qint64 len)
+{
+    auto& read_ahead = handle.read_ahead;
+    const auto offset = handle.next_offset;
+    {
+        std::lock_guard<std::mutex> lock{read_ahead.mutex};
+        if (read_ahead.pending ||
+            (offset >= read_ahead.offset && offset + len <= read_ahead.offset + read_ahead.size))
+            return;
+
+        read_ahead.pending = true;
+        read_ahead.offset = offset;
+        read_ahead.requested = std::min(len * read_ahead_factor, max_read_ahead_size);
+        read_ahead.size = 0;
+    }
+
+    // Not keyed on the handle, the point is for it to run while the client gets to its next request
+    dispatcher.dispatch(fmt::format("read-ahead:{}", fmt::ptr(&handle)), [this, &handle] { fill_read_ahead(handle); });
+}
+
+void mp::SftpServer::fill_read_ahead(OpenFile& handle)
+{
+    auto& read_ahead = handle.read_ahead;
+    if (static_cast<qint64>(read_ahead.data.size()) < read_ahead.requested)
+        read_ahead.data.resize(read_ahead.requested);
+
+    auto r = MP_FILEOPS.read_at(*handle.file, read_ahead.data.data(), read_ahead.requested, read_ahead.offset);
+
+    {
+        std::lock_guard<std::mutex> lock{read_ahead.mutex};
+        read_ahead.size = std::max(r, qint64{0});
+        read_ahead.pending = false;
+    }
+    read_ahead.filled.notify_all();
+}
+
+void mp::SftpServer::invalidate_read_ahead(OpenFile& handle)
+{
+    auto& read_ahead = handle.read_ahead;
+    std::unique_lock<std::mutex> lock{read_ahead.mutex};
+    read_ahead.filled.wait(lock, [&read_ahead] { return !read_ahead.pending; });
+    read_ahead.size = 0;
+    handle.sequential_reads = 0;
+}
+
+// Callers hold the handle's write-behind lock
+void mp::SftpServer::apply_pending_writes(OpenFile& handle)
+{
+    auto& pending = handle.write_behind;
+    if (pending.data.empty())
+        return;
+
+    if (!write_at(*handle.file, pending.offset, pending.data.data(), pending.data.size()) && pending.error.empty())
+        pending.error = fmt::format("deferred write failed: {}", handle.file->errorString());
+
+    attribute_cache.invalidate(handle.file->fileName().toStdString());
+    dirty_bytes -= pending.data.size();
+    pending.data.clear();
+}
+
+// Checked and added in one step, as writes to other handles count against the same limit at the same time
+bool mp::SftpServer::reserve_dirty_bytes(qint64 len)
+{
+    auto held = dirty_bytes.load();
+    do
+    {
+        if (held + len > max_dirty_bytes)
+            return false;
+    } while (!dirty_bytes.compare_exchange_weak(held, held + len));
+
+    return true;
+}
+
+std::string mp::SftpServer::flush_writes(OpenFile& handle)
+{
+    std::lock_guard<std::mutex> lock{handle.write_behind.mutex};
+    apply_pending_writes(handle);
+    return std::exchange(handle.write_behind.error, {});
+}
+
+// Errors are left for the handles themselves to report
+void mp::SftpServer::flush_writes_to(const QString& filename)
+{
+    std::lock_guard<std::mutex> lock{handles_mutex};
+    for (auto& [id, handle] : open_file_handles)
+    {
+        if (handle->file->fileName() == filename)
+        {
+            std::lock_guard<std::mutex> write_lock{handle->write_behind.mutex};
+            apply_pending_writes(*handle);
+        }
+    }
+}
+
+void mp::SftpServer::flush_all_writes()
+{
+    std::lock_guard<std::mutex> lock{handles_mutex};
+    for (auto& [id, handle] : open_file_handles)
+    {
+        if (auto error = flush_writes(*handle); !error.empty())
+            mpl::log(mpl::Level::warning, category, "{} to \'{}\'", error, handle->file->fileName());
+    }
+}
+
+template <typename Reply, typename... Args>
+int mp::SftpServer::reply(Reply&& sftp_reply, sftp_client_message msg, Args&&... args)
+{
+    // libssh sessions must not be used by more than one thread at a time
+    ++pending_replies;
+    std::lock_guard<std::mutex> lock{*session_mutex};
+    --pending_replies;
+
+    return sftp_reply(msg, std::forward<Args>(args)...);
+}
+
+int mp::SftpServer::reply_ok(sftp_client_message msg)
+{
+    return reply(sftp_reply_status, msg, SSH_FX_OK, nullptr);
+}
+
+int mp::SftpServer::reply_failure(sftp_client_message msg)
+{
+    return reply(sftp_reply_status, msg, SSH_FX_FAILURE, nullptr);
+}
+
+int mp::SftpServer::reply_perm_denied(sftp_client_message msg)
+{
+    return reply(sftp_reply_status, msg, SSH_FX_PERMISSION_DENIED, "permission denied");
+}
+
+int mp::SftpServer::reply_bad_handle(sftp_client_message msg, const char* type)
+{
+    return reply(sftp_reply_status, msg, SSH_FX_BAD_MESSAGE, fmt::format("{}: invalid handle", type).c_str());
+}
+
+int mp::SftpServer::reply_unsupported(sftp_client_message msg)
+{
+    return reply(sftp_reply_status, msg, SSH_FX_OP_UNSUPPORTED, "Unsupported message");
+}
+
 void mp::SftpServer::process_message(sftp_client_message msg)
 {
     int ret = 0;
     const auto type = sftp_client_message_get_type(msg);
+    const auto start = std::chrono::steady_clock::now();
     switch (type)
     {
     case SFTP_REALPATH:
@@ -405,102 +785,193 @@ void mp::SftpServer::process_message(sftp_client_message msg)
         ret = handle_extended(msg);
         break;
     default:
-        mpl::log(mpl::Level::trace, category, fmt::format("Unknown message: {}", static_cast<int>(type)));
+        mpl::log(mpl::Level::trace, category, "Unknown message: {}", static_cast<int>(type));
         ret = reply_unsupported(msg);
     }
+    io_stats.record(type, std::chrono::steady_clock::now() - start);
+
     if (ret != 0)
-        mpl::log(mpl::Level::error, category, fmt::format("error occurred when replying to client: {}", ret));
+        mpl::log(mpl::Level::error, category, "error occurred when replying to client: {}", ret);
+}
+
+std::string mp::SftpServer::dispatch_key_for(sftp_client_message msg)
+{
+    const auto type = sftp_client_message_get_type(msg);
+    if (operates_on_handle(type))
+    {
+        std::lock_guard<std::mutex> lock{handles_mutex};
+        return fmt::format("handle:{}", sftp_handle(sftp_server_session.get(), msg->handle));
+    }
+
+    // Path based requests are only ordered with respect to others on the same path
+    const auto filename = sftp_client_message_get_filename(msg);
+    return fmt::format("path:{}", filename ? filename : "");
 }
 
 void mp::SftpServer::run()
 {
-    using MsgUPtr = std::unique_ptr<sftp_client_message_struct, decltype(sftp_client_message_free)*>;
+    while (serve_next(dispatcher.idle() ? idle_poll_timeout : busy_poll_timeout))
+        ;
+}
 
-    while (true)
+bool mp::SftpServer::serve_next(std::chrono::milliseconds timeout)
+{
+    MsgUPtr client_msg{nullptr, sftp_client_message_free};
+    if (!stop_invoked)
     {
-        MsgUPtr client_msg{sftp_get_client_message(sftp_server_session.get()), sftp_client_message_free};
-        auto msg = client_msg.get();
-        if (msg == nullptr)
+        if (pending_replies > 0)
         {
-            if (stop_invoked)
-                break;
+            std::this_thread::yield();
+            return true;
+        }
 
-            int status{0};
-            try
-            {
-                status = sshfs_process->exit_code(250ms);
-            }
-            catch (const mp::ExitlessSSHProcessException&)
-            {
-                status = 1;
-            }
+        std::lock_guard<std::mutex> lock{*session_mutex};
+        if (ssh_channel_poll_timeout(sftp_server_session->channel, timeout.count(), 0) == 0)
+            return true;
 
-            if (status != 0)
-            {
-                mpl::log(mpl::Level::error, category,
-                         "sshfs in the instance appears to have exited unexpectedly.  Trying to recover.");
-                auto proc = ssh_session.exec(fmt::format("findmnt --source :{}  -o TARGET -n", source_path));
-                auto mount_path = proc.read_std_output();
-                if (!mount_path.empty())
-                {
-                    ssh_session.exec(fmt::format("sudo umount {}", mount_path));
-                }
+        client_msg.reset(sftp_get_client_message(sftp_server_session.get()));
+    }
 
-                sshfs_process =
-                    create_sshfs_process(ssh_session, sshfs_exec_line, mp::utils::escape_char(source_path, '"'),
-                                         mp::utils::escape_char(target_path, '"'));
-                sftp_server_session = make_sftp_session(ssh_session, sshfs_process->release_channel());
+    auto msg = client_msg.get();
+    if (msg == nullptr)
+        return recover();
 
-                continue;
-            }
-            else
-            {
-                break;
-            }
-        }
+    if (allocates_handle(sftp_client_message_get_type(msg)))
+    {
+        process_message(msg);
+        return true;
+    }
 
+    dispatcher.dispatch(dispatch_key_for(msg), [this, msg = client_msg.release()] {
+        MsgUPtr client_msg{msg, sftp_client_message_free};
         process_message(msg);
+    });
+
+    return true;
+}
+
+// Called when there are no more messages to be had: sshfs may have died in the instance, in which case it is started
+// again. Returns whether to carry on serving.
+bool mp::SftpServer::recover()
+{
+    // Outstanding requests refer to the current session, let them finish before deciding what to do with it
+    dispatcher.wait_for_idle();
+
+    if (stop_invoked)
+        return false;
+
+    std::lock_guard<std::mutex> lock{*session_mutex};
+
+    int status{0};
+    try
+    {
+        status = sshfs_process->exit_code(250ms);
+    }
+    catch (const mp::ExitlessSSHProcessException&)
+    {
+        status = 1;
+    }
+
+    if (status == 0)
+        return false;
+
+    mpl::log(mpl::Level::error, category,
+             "sshfs in the instance appears to have exited unexpectedly.  Trying to recover.");
+    flush_all_writes();
+
+    auto proc = ssh_session->exec(fmt::format("findmnt --source :{}  -o TARGET -n", source_path));
+    auto mount_path = proc.read_std_output();
+    if (!mount_path.empty())
+    {
+        ssh_session->exec(fmt::format("sudo umount {}", mount_path));
     }
+
+    sshfs_process = create_sshfs_process(*ssh_session, sshfs_exec_line, mp::utils::escape_char(source_path, '"'),
+                                         mp::utils::escape_char(target_path, '"'));
+    sftp_server_session = make_sftp_session(*ssh_session, sshfs_process->release_channel());
+
+    return true;
 }
 
 void mp::SftpServer::stop()
 {
     stop_invoked = true;
-    ssh_session.force_shutdown();
+    if (owns_session)
+        ssh_session->force_shutdown();
+}
+
+bool mp::SftpServer::busy() const
+{
+    return !dispatcher.idle() || pending_replies > 0;
+}
+
+ssh_channel mp::SftpServer::channel() const
+{
+    return sftp_server_session->channel;
+}
+
+const mp::SftpStats& mp::SftpServer::stats() const
+{
+    return io_stats;
 }
 
 int mp::SftpServer::handle_close(sftp_client_message msg)
 {
+    std::unique_ptr<OpenFile> closed_file; // destroyed outside the lock, it may need to wait for a read-ahead
+
+    std::unique_lock<std::mutex> lock{handles_mutex};
     const auto id = sftp_handle(sftp_server_session.get(), msg->handle);
 
-    auto erased = open_file_handles.erase(id);
-    erased += open_dir_handles.erase(id);
+    auto erased = open_dir_handles.erase(id);
+    if (auto entry = open_file_handles.find(id); entry != open_file_handles.end())
+    {
+        closed_file = std::move(entry->second);
+        open_file_handles.erase(entry);
+        ++erased;
+    }
+
+    if (erased != 0)
+        sftp_handle_remove(sftp_server_session.get(), id);
+    lock.unlock();
+
     if (erased == 0)
     {
-        mpl::log(mpl::Level::trace, category, fmt::format("{}: bad handle requested", __FUNCTION__));
+        mpl::log(mpl::Level::trace, category, "{}: bad handle requested", __FUNCTION__);
         return reply_bad_handle(msg, "close");
     }
 
-    sftp_handle_remove(sftp_server_session.get(), id);
+    if (closed_file)
+    {
+        if (auto error = flush_writes(*closed_file); !error.empty())
+        {
+            mpl::log(mpl::Level::trace, category, "{}: {} for \'{}\'", __FUNCTION__, error,
+                     closed_file->file->fileName());
+            return reply(sftp_reply_status, msg, SSH_FX_FAILURE, error.c_str());
+        }
+    }
+
     return reply_ok(msg);
 }
 
 int mp::SftpServer::handle_fstat(sftp_client_message msg)
 {
-    auto file = handle_from(msg, open_file_handles);
-    if (file == nullptr)
+    auto handle = handle_from(msg, open_file_handles, handles_mutex);
+    if (handle == nullptr)
     {
-        mpl::log(mpl::Level::trace, category, fmt::format("{}: bad handle requested", __FUNCTION__));
+        mpl::log(mpl::Level::trace, category, "{}: bad handle requested", __FUNCTION__);
         return reply_bad_handle(msg, "fstat");
     }
 
-    QFileInfo file_info(*file);
+    if (auto error = flush_writes(*handle); !error.empty())
+        return reply(sftp_reply_status, msg, SSH_FX_FAILURE, error.c_str());
+
+    QFileInfo file_info(*handle->file);
 
     if (file_info.isSymLink())
         file_info = QFileInfo(file_info.symLinkTarget());
 
     auto attr = attr_from(file_info);
-    return sftp_reply_attr(msg, &attr);
+    return reply(sftp_reply_attr, msg, &attr);
 }
 
 int mp::SftpServer::handle_mkdir(sftp_client_message msg)
@@ -508,24 +979,23 @@ int mp::SftpServer::handle_mkdir(sftp_client_message msg)
     const auto filename = sftp_client_message_get_filename(msg);
     if (!validate_path(source_path, filename))
     {
-        mpl::log(
-            mpl::Level::trace, category,
-            fmt::format("{}: cannot validate path \'{}\' against source \'{}\'", __FUNCTION__, filename, source_path));
+        mpl::log(mpl::Level::trace, category, "{}: cannot validate path \'{}\' against source \'{}\'", __FUNCTION__,
+                 filename, source_path);
         return reply_perm_denied(msg);
     }
 
     QDir dir(filename);
     if (!dir.mkdir(filename))
     {
-        mpl::log(mpl::Level::trace, category, fmt::format("{}: mkdir failed for \'{}\'", __FUNCTION__, filename));
+        mpl::log(mpl::Level::trace, category, "{}: mkdir failed for \'{}\'", __FUNCTION__, filename);
         return reply_failure(msg);
     }
+    attribute_cache.invalidate(filename);
 
     QFile file(filename);
     if (!MP_FILEOPS.setPermissions(file, to_qt_permissions(msg->attr->permissions)))
     {
-        mpl::log(mpl::Level::trace, category,
-                 fmt::format("{}: set permissions failed for \'{}\'", __FUNCTION__, filename));
+        mpl::log(mpl::Level::trace, category, "{}: set permissions failed for \'{}\'", __FUNCTION__, filename);
         return reply_failure(msg);
     }
 
@@ -536,8 +1006,8 @@ int mp::SftpServer::handle_mkdir(sftp_client_message msg)
 
     if (MP_PLATFORM.chown(filename, rev_uid, rev_gid) < 0)
     {
-        mpl::log(mpl::Level::trace, category,
-                 fmt::format("failed to chown '{}' to owner:{} and group:{}", filename, rev_uid, rev_gid));
+        mpl::log(mpl::Level::trace, category, "failed to chown '{}' to owner:{} and group:{}", filename, rev_uid,
+                 rev_gid);
         return reply_failure(msg);
     }
     return reply_ok(msg);
@@ -548,18 +1018,18 @@ int mp::SftpServer::handle_rmdir(sftp_client_message msg)
     const auto filename = sftp_client_message_get_filename(msg);
     if (!validate_path(source_path, filename))
     {
-        mpl::log(
-            mpl::Level::trace, category,
-            fmt::format("{}: cannot validate path \'{}\' against source \'{}\'", __FUNCTION__, filename, source_path));
+        mpl::log(mpl::Level::trace, category, "{}: cannot validate path \'{}\' against source \'{}\'", __FUNCTION__,
+                 filename, source_path);
         return reply_perm_denied(msg);
     }
 
     QDir dir(filename);
     if (!MP_FILEOPS.rmdir(dir, filename))
     {
-        mpl::log(mpl::Level::trace, category, fmt::format("{}: rmdir failed for \'{}\'", __FUNCTION__, filename));
+        mpl::log(mpl::Level::trace, category, "{}: rmdir failed for \'{}\'", __FUNCTION__, filename);
         return reply_failure(msg);
     }
+    attribute_cache.invalidate(filename);
 
     return reply_ok(msg);
 }
@@ -569,9 +1039,8 @@ int mp::SftpServer::handle_open(sftp_client_message msg)
     const auto filename = sftp_client_message_get_filename(msg);
     if (!validate_path(source_path, filename))
     {
-        mpl::log(
-            mpl::Level::trace, category,
-            fmt::format("{}: cannot validate path \'{}\' against source \'{}\'", __FUNCTION__, filename, source_path));
+        mpl::log(mpl::Level::trace, category, "{}: cannot validate path \'{}\' against source \'{}\'", __FUNCTION__,
+                 filename, source_path);
         return reply_perm_denied(msg);
     }
 
@@ -600,49 +1069,81 @@ int mp::SftpServer::handle_open(sftp_client_message msg)
     if (flags & SSH_FXF_TRUNC)
         mode |= QIODevice::Truncate;
 
-    auto file = std::make_unique<QFile>(filename);
-
-    auto exists = QFileInfo(filename).isSymLink() || file->exists();
+    // Symlinks, dangling ones too, count as existing
+    struct stat existing;
+    auto exists = ::lstat(filename, &existing) == 0;
 
-    if (!MP_FILEOPS.open(*file, mode))
+    if (!exists && mode & QIODevice::WriteOnly)
     {
-        mpl::log(mpl::Level::trace, category, fmt::format("Cannot open \'{}\': {}", filename, file->errorString()));
-        return reply_failure(msg);
-    }
-
-    if (!exists)
-    {
-        if (!MP_FILEOPS.setPermissions(*file, to_qt_permissions(msg->attr->permissions)))
+        // Created with its permissions from the start, and given away only when not already owned as it should be:
+        // creating many small files is common, and the extra syscalls add up
+        const auto permissions = msg->attr->permissions & 07777;
+        const auto fd = ::open(filename, O_WRONLY | O_CREAT | O_EXCL | O_CLOEXEC, permissions);
+        if (fd < 0 && errno != EEXIST)
         {
-            mpl::log(mpl::Level::trace, category,
-                     fmt::format("Cannot set permissions for \'{}\': {}", filename, file->errorString()));
+            mpl::log(mpl::Level::trace, category, "Cannot create \'{}\': {}", filename, std::strerror(errno));
             return reply_failure(msg);
         }
 
-        QFileInfo current_file(filename);
-        QFileInfo current_dir(current_file.path());
+        exists = fd < 0; // someone else created it in the meantime
+        if (!exists)
+        {
+            auto close_fd = sg::make_scope_guard([fd]() noexcept { ::close(fd); });
+            attribute_cache.invalidate(filename);
 
-        auto new_uid = reverse_uid_for(msg->attr->uid, current_dir.ownerId());
-        auto new_gid = reverse_gid_for(msg->attr->gid, current_dir.groupId());
+            struct stat created;
+            const auto known = ::fstat(fd, &created) == 0;
 
-        if (MP_PLATFORM.chown(filename, new_uid, new_gid) < 0)
-        {
-            mpl::log(mpl::Level::trace, category,
-                     fmt::format("failed to chown '{}' to owner:{} and group:{}", filename, new_uid, new_gid));
-            return reply_failure(msg);
+            // The umask may have taken some of them away
+            if ((!known || (created.st_mode & 07777) != permissions) && ::fchmod(fd, permissions) < 0)
+            {
+                mpl::log(mpl::Level::trace, category, "Cannot set permissions for \'{}\': {}", filename,
+                         std::strerror(errno));
+                return reply_failure(msg);
+            }
+
+            QFileInfo current_dir(QFileInfo(filename).path());
+
+            auto new_uid = reverse_uid_for(msg->attr->uid, current_dir.ownerId());
+            auto new_gid = reverse_gid_for(msg->attr->gid, current_dir.groupId());
+
+            const auto owned = known && created.st_uid == static_cast<uid_t>(new_uid) &&
+                               created.st_gid == static_cast<gid_t>(new_gid);
+            if (!owned && MP_PLATFORM.chown(filename, new_uid, new_gid) < 0)
+            {
+                mpl::log(mpl::Level::trace, category, "failed to chown '{}' to owner:{} and group:{}", filename,
+                         new_uid, new_gid);
+                return reply_failure(msg);
+            }
         }
     }
 
-    SftpHandleUPtr sftp_handle{sftp_handle_alloc(sftp_server_session.get(), file.get()), ssh_string_free};
+    auto file = std::make_unique<QFile>(filename);
+    if (!MP_FILEOPS.open(*file, mode))
+    {
+        mpl::log(mpl::Level::trace, category, "Cannot open \'{}\': {}", filename, file->errorString());
+        return reply_failure(msg);
+    }
+
+    if (exists && mode & QIODevice::Truncate)
+        attribute_cache.invalidate(filename);
+
+    auto open_file = std::make_unique<OpenFile>();
+    open_file->file = std::move(file);
+
+    std::unique_lock<std::mutex> lock{handles_mutex};
+    SftpHandleUPtr sftp_handle{sftp_handle_alloc(sftp_server_session.get(), open_file.get()), ssh_string_free};
     if (!sftp_handle)
     {
+        lock.unlock();
         mpl::log(mpl::Level::trace, category, "Cannot allocate handle for open()");
         return reply_failure(msg);
     }
 
-    open_file_handles.emplace(file.get(), std::move(file));
+    open_file_handles.emplace(open_file.get(), std::move(open_file));
+    lock.unlock();
 
-    return sftp_reply_handle(msg, sftp_handle.get());
+    return reply(sftp_reply_handle, msg, sftp_handle.get());
 }
 
 int mp::SftpServer::handle_opendir(sftp_client_message msg)
@@ -650,110 +1151,165 @@ int mp::SftpServer::handle_opendir(sftp_client_message msg)
     auto filename = sftp_client_message_get_filename(msg);
     if (!validate_path(source_path, filename))
     {
-        mpl::log(
-            mpl::Level::trace, category,
-            fmt::format("{}: cannot validate path \'{}\' against source \'{}\'", __FUNCTION__, filename, source_path));
+        mpl::log(mpl::Level::trace, category, "{}: cannot validate path \'{}\' against source \'{}\'", __FUNCTION__,
+                 filename, source_path);
         return reply_perm_denied(msg);
     }
 
     QDir dir(filename);
     if (!dir.exists())
     {
-        mpl::log(mpl::Level::trace, category, fmt::format("Cannot open directory \'{}\': no such directory", filename));
-        return sftp_reply_status(msg, SSH_FX_NO_SUCH_FILE, "no such directory");
+        mpl::log(mpl::Level::trace, category, "Cannot open directory \'{}\': no such directory", filename);
+        return reply(sftp_reply_status, msg, SSH_FX_NO_SUCH_FILE, "no such directory");
     }
 
     if (!MP_FILEOPS.isReadable(dir))
     {
-        mpl::log(mpl::Level::trace, category, fmt::format("Cannot read directory \'{}\': permission denied", filename));
+        mpl::log(mpl::Level::trace, category, "Cannot read directory \'{}\': permission denied", filename);
         return reply_perm_denied(msg);
     }
 
-    auto entry_list =
-        std::make_unique<QFileInfoList>(dir.entryInfoList(QDir::AllEntries | QDir::System | QDir::Hidden));
+    // Entries are read as they are asked for, listing a huge directory doesn't mean holding all of it in memory
+    auto open_dir = std::make_unique<OpenDir>();
+    open_dir->path = filename;
+    open_dir->dir.reset(::opendir(filename));
+    if (!open_dir->dir)
+    {
+        mpl::log(mpl::Level::trace, category, "Cannot open directory \'{}\': {}", filename, std::strerror(errno));
+        return reply_failure(msg);
+    }
 
-    SftpHandleUPtr sftp_handle{sftp_handle_alloc(sftp_server_session.get(), entry_list.get()), ssh_string_free};
+    std::unique_lock<std::mutex> lock{handles_mutex};
+    SftpHandleUPtr sftp_handle{sftp_handle_alloc(sftp_server_session.get(), open_dir.get()), ssh_string_free};
     if (!sftp_handle)
     {
+        lock.unlock();
         mpl::log(mpl::Level::trace, category, "Cannot allocate handle for opendir()");
         return reply_failure(msg);
     }
 
-    open_dir_handles.emplace(entry_list.get(), std::move(entry_list));
+    open_dir_handles.emplace(open_dir.get(), std::move(open_dir));
+    lock.unlock();
 
-    return sftp_reply_handle(msg, sftp_handle.get());
+    return reply(sftp_reply_handle, msg, sftp_handle.get());
 }
 
 int mp::SftpServer::handle_read(sftp_client_message msg)
 {
-    auto file = handle_from(msg, open_file_handles);
-    if (file == nullptr)
+    auto handle = handle_from(msg, open_file_handles, handles_mutex);
+    if (handle == nullptr)
     {
-        mpl::log(mpl::Level::trace, category, fmt::format("{}: bad handle requested", __FUNCTION__));
+        mpl::log(mpl::Level::trace, category, "{}: bad handle requested", __FUNCTION__);
         return reply_bad_handle(msg, "read");
     }
 
-    const auto max_packet_size = 65536u;
-    const auto len = std::min(msg->len, max_packet_size);
+    // Requests on a handle see its own writes, whether or not they were held back
+    if (auto error = flush_writes(*handle); !error.empty())
+        return reply(sftp_reply_status, msg, SSH_FX_FAILURE, error.c_str());
 
-    std::vector<char> data;
-    data.reserve(len);
+    const qint64 len = std::min(msg->len, max_read_size);
+    const qint64 offset = msg->offset;
+    auto& file = *handle->file;
 
-    if (!MP_FILEOPS.seek(*file, msg->offset))
+    // Requests on a handle are serialized, so its state and buffer can be used without locking
+    handle->sequential_reads = offset == handle->next_offset ? handle->sequential_reads + 1 : 0;
+
+    qint64 r = len;
+    auto data = read_ahead_data(*handle, offset, len);
+    if (data == nullptr)
     {
-        mpl::log(mpl::Level::trace, category,
-                 fmt::format("{}: cannot seek to position {} in \'{}\'", __FUNCTION__, msg->offset, file->fileName()));
-        return reply_failure(msg);
+        auto& buffer = handle->read_buffer;
+        if (static_cast<qint64>(buffer.size()) < len)
+            buffer.resize(len);
+
+        r = MP_FILEOPS.read_at(file, buffer.data(), len, offset);
+        data = buffer.data();
     }
 
-    auto r = MP_FILEOPS.read(*file, data.data(), len);
     if (r < 0)
     {
-        mpl::log(mpl::Level::trace, category,
-                 fmt::format("{}: read failed for {}: {}", __FUNCTION__, file->fileName(), file->errorString()));
-        return sftp_reply_status(msg, SSH_FX_FAILURE, file->errorString().toStdString().c_str());
+        const auto error_string = std::strerror(errno);
+        mpl::log(mpl::Level::trace, category, "{}: read failed for {}: {}", __FUNCTION__, file.fileName(),
+                 error_string);
+        return reply(sftp_reply_status, msg, SSH_FX_FAILURE, error_string);
     }
     else if (r == 0)
-        return sftp_reply_status(msg, SSH_FX_EOF, "End of file");
+        return reply(sftp_reply_status, msg, SSH_FX_EOF, "End of file");
 
-    return sftp_reply_data(msg, data.data(), r);
+    handle->next_offset = offset + r;
+    auto ret = reply(sftp_reply_data, msg, data, r);
+    io_stats.add_bytes_read(r);
+
+    // Only after replying, since the reply may have been served straight from the read-ahead data
+    if (handle->sequential_reads >= sequential_reads_before_read_ahead && r == len)
+        schedule_read_ahead(*handle, len);
+
+    return ret;
 }
 
 int mp::SftpServer::handle_readdir(sftp_client_message msg)
 {
-    auto dir_entries = handle_from(msg, open_dir_handles);
-    if (dir_entries == nullptr)
+    auto handle = handle_from(msg, open_dir_handles, handles_mutex);
+    if (handle == nullptr)
     {
-        mpl::log(mpl::Level::trace, category, fmt::format("{}: bad handle requested", __FUNCTION__));
+        mpl::log(mpl::Level::trace, category, "{}: bad handle requested", __FUNCTION__);
         return reply_bad_handle(msg, "readdir");
     }
 
-    if (dir_entries->empty())
-        return sftp_reply_status(msg, SSH_FX_EOF, nullptr);
-
-    const auto max_num_entries_per_packet = 50;
-    const auto num_entries = std::min(dir_entries->size(), max_num_entries_per_packet);
+    auto dir = handle->dir.get();
+    std::size_t reply_size{0};
+    auto num_entries{0};
 
-    for (int i = 0; i < num_entries; i++)
+    while (true)
     {
-        const QFileInfo entry = dir_entries->takeFirst();
-        const auto filename = entry.fileName().toStdString();
-        sftp_attributes_struct attr{};
-        if (entry.isSymLink())
+        auto filename = std::exchange(handle->held_over_entry, {});
+        if (filename.empty())
         {
-            mp::platform::symlink_attr_from(entry.absoluteFilePath().toStdString().c_str(), &attr);
-            attr.uid = mapped_uid_for(attr.uid);
-            attr.gid = mapped_gid_for(attr.gid);
+            errno = 0;
+            const auto entry = ::readdir(dir);
+            if (entry == nullptr)
+            {
+                if (errno != 0 && num_entries == 0)
+                {
+                    const auto error_string = std::strerror(errno);
+                    mpl::log(mpl::Level::trace, category, "{}: readdir failed: {}", __FUNCTION__, error_string);
+                    return reply(sftp_reply_status, msg, SSH_FX_FAILURE, error_string);
+                }
+                break;
+            }
+            filename = entry->d_name;
         }
-        else
+
+        struct stat st
+        {
+        };
+        if (attribute_cache.lstat_at(dirfd(dir), handle->path, filename, st) < 0)
+        {
+            // Most likely removed since it was listed
+            mpl::log(mpl::Level::trace, category, "{}: cannot stat \'{}\': {}", __FUNCTION__, filename,
+                     std::strerror(errno));
+            continue;
+        }
+
+        const auto longname = longname_from(st, filename);
+        const auto entry_size = filename.size() + longname.size() + readdir_entry_overhead;
+        if (num_entries > 0 && reply_size + entry_size > max_readdir_reply_size)
         {
-            attr = attr_from(entry);
+            handle->held_over_entry = std::move(filename);
+            break;
         }
-        const auto longname = longname_from(entry, filename);
-        sftp_reply_names_add(msg, filename.c_str(), longname.data(), &attr);
+
+        auto attr = attr_from(st);
+        sftp_reply_names_add(msg, filename.c_str(), longname.c_str(), &attr);
+
+        reply_size += entry_size;
+        ++num_entries;
     }
 
-    return sftp_reply_names(msg);
+    if (num_entries == 0)
+        return reply(sftp_reply_status, msg, SSH_FX_EOF, nullptr);
+
+    return reply(sftp_reply_names, msg);
 }
 
 int mp::SftpServer::handle_readlink(sftp_client_message msg)
@@ -761,22 +1317,21 @@ int mp::SftpServer::handle_readlink(sftp_client_message msg)
     auto filename = sftp_client_message_get_filename(msg);
     if (!validate_path(source_path, filename))
     {
-        mpl::log(
-            mpl::Level::trace, category,
-            fmt::format("{}: cannot validate path \'{}\' against source \'{}\'", __FUNCTION__, filename, source_path));
+        mpl::log(mpl::Level::trace, category, "{}: cannot validate path \'{}\' against source \'{}\'", __FUNCTION__,
+                 filename, source_path);
         return reply_perm_denied(msg);
     }
 
     auto link = QFile::symLinkTarget(filename);
     if (link.isEmpty())
     {
-        mpl::log(mpl::Level::trace, category, fmt::format("{}: invalid link for \'{}\'", __FUNCTION__, filename));
-        return sftp_reply_status(msg, SSH_FX_NO_SUCH_FILE, "invalid link");
+        mpl::log(mpl::Level::trace, category, "{}: invalid link for \'{}\'", __FUNCTION__, filename);
+        return reply(sftp_reply_status, msg, SSH_FX_NO_SUCH_FILE, "invalid link");
     }
 
     sftp_attributes_struct attr{};
     sftp_reply_names_add(msg, link.toStdString().c_str(), link.toStdString().c_str(), &attr);
-    return sftp_reply_names(msg);
+    return reply(sftp_reply_names, msg);
 }
 
 int mp::SftpServer::handle_realpath(sftp_client_message msg)
@@ -784,14 +1339,13 @@ int mp::SftpServer::handle_realpath(sftp_client_message msg)
     auto filename = sftp_client_message_get_filename(msg);
     if (!validate_path(source_path, filename))
     {
-        mpl::log(
-            mpl::Level::trace, category,
-            fmt::format("{}: cannot validate path \'{}\' against source \'{}\'", __FUNCTION__, filename, source_path));
+        mpl::log(mpl::Level::trace, category, "{}: cannot validate path \'{}\' against source \'{}\'", __FUNCTION__,
+                 filename, source_path);
         return reply_perm_denied(msg);
     }
 
     auto realpath = QFileInfo(filename).absoluteFilePath();
-    return sftp_reply_name(msg, realpath.toStdString().c_str(), nullptr);
+    return reply(sftp_reply_name, msg, realpath.toStdString().c_str(), nullptr);
 }
 
 int mp::SftpServer::handle_remove(sftp_client_message msg)
@@ -799,18 +1353,18 @@ int mp::SftpServer::handle_remove(sftp_client_message msg)
     auto filename = sftp_client_message_get_filename(msg);
     if (!validate_path(source_path, filename))
     {
-        mpl::log(
-            mpl::Level::trace, category,
-            fmt::format("{}: cannot validate path \'{}\' against source \'{}\'", __FUNCTION__, filename, source_path));
+        mpl::log(mpl::Level::trace, category, "{}: cannot validate path \'{}\' against source \'{}\'", __FUNCTION__,
+                 filename, source_path);
         return reply_perm_denied(msg);
     }
 
     QFile file{filename};
     if (!MP_FILEOPS.remove(file))
     {
-        mpl::log(mpl::Level::trace, category, fmt::format("{}: cannot remove \'{}\'", __FUNCTION__, filename));
+        mpl::log(mpl::Level::trace, category, "{}: cannot remove \'{}\'", __FUNCTION__, filename);
         return reply_failure(msg);
     }
+    attribute_cache.invalidate(filename);
 
     return reply_ok(msg);
 }
@@ -820,25 +1374,22 @@ int mp::SftpServer::handle_rename(sftp_client_message msg)
     const auto source = sftp_client_message_get_filename(msg);
     if (!validate_path(source_path, source))
     {
-        mpl::log(
-            mpl::Level::trace, category,
-            fmt::format("{}: cannot validate path \'{}\' against source \'{}\'", __FUNCTION__, source, source_path));
+        mpl::log(mpl::Level::trace, category, "{}: cannot validate path \'{}\' against source \'{}\'", __FUNCTION__,
+                 source, source_path);
         return reply_perm_denied(msg);
     }
 
     if (!QFileInfo(source).isSymLink() && !QFile::exists(source))
     {
-        mpl::log(mpl::Level::trace, category,
-                 fmt::format("{}: cannot rename \'{}\': no such file", __FUNCTION__, source));
-        return sftp_reply_status(msg, SSH_FX_NO_SUCH_FILE, "no such file");
+        mpl::log(mpl::Level::trace, category, "{}: cannot rename \'{}\': no such file", __FUNCTION__, source);
+        return reply(sftp_reply_status, msg, SSH_FX_NO_SUCH_FILE, "no such file");
     }
 
     const auto target = sftp_client_message_get_data(msg);
     if (!validate_path(source_path, target))
     {
-        mpl::log(mpl::Level::trace, category,
-                 fmt::format("{}: cannot validate target path \'{}\' against source \'{}\'", __FUNCTION__, target,
-                             source_path));
+        mpl::log(mpl::Level::trace, category, "{}: cannot validate target path \'{}\' against source \'{}\'",
+                 __FUNCTION__, target, source_path);
         return reply_perm_denied(msg);
     }
 
@@ -847,19 +1398,20 @@ int mp::SftpServer::handle_rename(sftp_client_message msg)
     {
         if (!MP_FILEOPS.remove(target_file))
         {
-            mpl::log(mpl::Level::trace, category,
-                     fmt::format("{}: cannot remove \'{}\' for renaming", __FUNCTION__, target));
+            mpl::log(mpl::Level::trace, category, "{}: cannot remove \'{}\' for renaming", __FUNCTION__, target);
             return reply_failure(msg);
         }
+        attribute_cache.invalidate(target);
     }
 
     QFile source_file{source};
     if (!MP_FILEOPS.rename(source_file, target))
     {
-        mpl::log(mpl::Level::trace, category,
-                 fmt::format("{}: failed renaming \'{}\' to \'{}\'", __FUNCTION__, source, target));
+        mpl::log(mpl::Level::trace, category, "{}: failed renaming \'{}\' to \'{}\'", __FUNCTION__, source, target);
         return reply_failure(msg);
     }
+    attribute_cache.invalidate(source);
+    attribute_cache.invalidate(target);
 
     return reply_ok(msg);
 }
@@ -870,41 +1422,47 @@ int mp::SftpServer::handle_setstat(sftp_client_message msg)
 
     if (sftp_client_message_get_type(msg) == SFTP_FSETSTAT)
     {
-        auto handle = handle_from(msg, open_file_handles);
+        auto handle = handle_from(msg, open_file_handles, handles_mutex);
         if (handle == nullptr)
         {
-            mpl::log(mpl::Level::trace, category, fmt::format("{}: bad handle requested", __FUNCTION__));
+            mpl::log(mpl::Level::trace, category, "{}: bad handle requested", __FUNCTION__);
             return reply_bad_handle(msg, "setstat");
         }
 
-        filename = handle->fileName();
+        invalidate_read_ahead(*handle);
+        if (auto error = flush_writes(*handle); !error.empty())
+            return reply(sftp_reply_status, msg, SSH_FX_FAILURE, error.c_str());
+
+        filename = handle->file->fileName();
     }
     else
     {
         filename = sftp_client_message_get_filename(msg);
         if (!validate_path(source_path, filename.toStdString()))
         {
-            mpl::log(mpl::Level::trace, category,
-                     fmt::format("{}: cannot validate path \'{}\' against source \'{}\'", __FUNCTION__, filename,
-                                 source_path));
+            mpl::log(mpl::Level::trace, category, "{}: cannot validate path \'{}\' against source \'{}\'", __FUNCTION__,
+                     filename, source_path);
             return reply_perm_denied(msg);
         }
 
         if (!QFileInfo(filename).isSymLink() && !QFile::exists(filename))
         {
-            mpl::log(mpl::Level::trace, category,
-                     fmt::format("{}: cannot setstat \'{}\': no such file", __FUNCTION__, filename));
-            return sftp_reply_status(msg, SSH_FX_NO_SUCH_FILE, "no such file");
+            mpl::log(mpl::Level::trace, category, "{}: cannot setstat \'{}\': no such file", __FUNCTION__, filename);
+            return reply(sftp_reply_status, msg, SSH_FX_NO_SUCH_FILE, "no such file");
         }
+
+        if (write_behind)
+            flush_writes_to(filename);
     }
 
     QFile file{filename};
+    attribute_cache.invalidate(filename.toStdString());
 
     if (msg->attr->flags & SSH_FILEXFER_ATTR_SIZE)
     {
         if (!MP_FILEOPS.resize(file, msg->attr->size))
         {
-            mpl::log(mpl::Level::trace, category, fmt::format("{}: cannot resize \'{}\'", __FUNCTION__, filename));
+            mpl::log(mpl::Level::trace, category, "{}: cannot resize \'{}\'", __FUNCTION__, filename);
             return reply_failure(msg);
         }
     }
@@ -913,8 +1471,7 @@ int mp::SftpServer::handle_setstat(sftp_client_message msg)
     {
         if (!MP_FILEOPS.setPermissions(file, to_qt_permissions(msg->attr->permissions)))
         {
-            mpl::log(mpl::Level::trace, category,
-                     fmt::format("{}: set permissions failed for \'{}\'", __FUNCTION__, filename));
+            mpl::log(mpl::Level::trace, category, "{}: set permissions failed for \'{}\'", __FUNCTION__, filename);
             return reply_failure(msg);
         }
     }
@@ -923,8 +1480,8 @@ int mp::SftpServer::handle_setstat(sftp_client_message msg)
     {
         if (MP_PLATFORM.utime(filename.toStdString().c_str(), msg->attr->atime, msg->attr->mtime) < 0)
         {
-            mpl::log(mpl::Level::trace, category,
-                     fmt::format("{}: cannot set modification date for \'{}\'", __FUNCTION__, filename));
+            mpl::log(mpl::Level::trace, category, "{}: cannot set modification date for \'{}\'", __FUNCTION__,
+                     filename);
             return reply_failure(msg);
         }
     }
@@ -933,8 +1490,7 @@ int mp::SftpServer::handle_setstat(sftp_client_message msg)
         (MP_PLATFORM.chown(filename.toStdString().c_str(), reverse_uid_for(msg->attr->uid, msg->attr->uid),
                            reverse_gid_for(msg->attr->gid, msg->attr->gid)) < 0))
     {
-        mpl::log(mpl::Level::trace, category,
-                 fmt::format("{}: cannot set ownership for \'{}\'", __FUNCTION__, filename));
+        mpl::log(mpl::Level::trace, category, "{}: cannot set ownership for \'{}\'", __FUNCTION__, filename);
         return reply_failure(msg);
     }
 
@@ -946,37 +1502,29 @@ int mp::SftpServer::handle_stat(sftp_client_message msg, const bool follow)
     auto filename = sftp_client_message_get_filename(msg);
     if (!validate_path(source_path, filename))
     {
-        mpl::log(
-            mpl::Level::trace, category,
-            fmt::format("{}: cannot validate path \'{}\' against source \'{}\'", __FUNCTION__, filename, source_path));
+        mpl::log(mpl::Level::trace, category, "{}: cannot validate path \'{}\' against source \'{}\'", __FUNCTION__,
+                 filename, source_path);
         return reply_perm_denied(msg);
     }
 
-    QFileInfo file_info(filename);
-    if (!file_info.isSymLink() && !file_info.exists())
+    struct stat st
     {
-        mpl::log(mpl::Level::trace, category,
-                 fmt::format("{}: cannot stat  \'{}\': no such file", __FUNCTION__, filename));
-        return sftp_reply_status(msg, SSH_FX_NO_SUCH_FILE, "no such file");
-    }
-
-    sftp_attributes_struct attr{};
-
-    if (!follow && file_info.isSymLink())
+    };
+    if (attribute_cache.lstat(filename, st) < 0)
     {
-        mp::platform::symlink_attr_from(filename, &attr);
-        attr.uid = mapped_uid_for(attr.uid);
-        attr.gid = mapped_gid_for(attr.gid);
+        mpl::log(mpl::Level::trace, category, "{}: cannot stat  \'{}\': no such file", __FUNCTION__, filename);
+        return reply(sftp_reply_status, msg, SSH_FX_NO_SUCH_FILE, "no such file");
     }
-    else
-    {
-        if (file_info.isSymLink())
-            file_info = QFileInfo(file_info.symLinkTarget());
 
-        attr = attr_from(file_info);
-    }
+    // A dangling link is still described by its own attributes
+    struct stat target_st
+    {
+    };
+    if (follow && S_ISLNK(st.st_mode) && attribute_cache.stat(filename, target_st) == 0)
+        st = target_st;
 
-    return sftp_reply_attr(msg, &attr);
+    auto attr = attr_from(st);
+    return reply(sftp_reply_attr, msg, &attr);
 }
 
 int mp::SftpServer::handle_symlink(sftp_client_message msg)
@@ -986,57 +1534,85 @@ int mp::SftpServer::handle_symlink(sftp_client_message msg)
     const auto new_name = sftp_client_message_get_data(msg);
     if (!validate_path(source_path, new_name))
     {
-        mpl::log(
-            mpl::Level::trace, category,
-            fmt::format("{}: cannot validate path \'{}\' against source \'{}\'", __FUNCTION__, new_name, source_path));
+        mpl::log(mpl::Level::trace, category, "{}: cannot validate path \'{}\' against source \'{}\'", __FUNCTION__,
+                 new_name, source_path);
         return reply_perm_denied(msg);
     }
 
     if (!MP_PLATFORM.symlink(old_name, new_name, QFileInfo(old_name).isDir()))
     {
-        mpl::log(mpl::Level::trace, category,
-                 fmt::format("{}: failure creating symlink from \'{}\' to \'{}\'", __FUNCTION__, old_name, new_name));
+        mpl::log(mpl::Level::trace, category, "{}: failure creating symlink from \'{}\' to \'{}\'", __FUNCTION__,
+                 old_name, new_name);
         return reply_failure(msg);
     }
+    attribute_cache.invalidate(new_name);
 
     return reply_ok(msg);
 }
 
 int mp::SftpServer::handle_write(sftp_client_message msg)
 {
-    auto file = handle_from(msg, open_file_handles);
-    if (file == nullptr)
+    auto handle = handle_from(msg, open_file_handles, handles_mutex);
+    if (handle == nullptr)
     {
-        mpl::log(mpl::Level::trace, category, fmt::format("{}: bad handle requested", __FUNCTION__));
+        mpl::log(mpl::Level::trace, category, "{}: bad handle requested", __FUNCTION__);
         return reply_bad_handle(msg, "write");
     }
 
-    auto len = ssh_string_len(msg->data);
-    auto data_ptr = ssh_string_get_char(msg->data);
-    if (!MP_FILEOPS.seek(*file, msg->offset))
+    invalidate_read_ahead(*handle);
+
+    auto& file = *handle->file;
+    const qint64 len = ssh_string_len(msg->data);
+    const auto data = ssh_string_get_char(msg->data);
+    const qint64 offset = msg->offset;
+
+    if (!write_behind)
     {
-        mpl::log(mpl::Level::trace, category,
-                 fmt::format("{}: cannot seek to position {} in \'{}\'", __FUNCTION__, msg->offset, file->fileName()));
-        return reply_failure(msg);
+        const auto written = write_at(file, offset, data, len);
+        attribute_cache.invalidate(file.fileName().toStdString());
+        if (!written)
+            return reply_failure(msg);
+
+        io_stats.add_bytes_written(len);
+        return reply_ok(msg);
     }
 
-    do
+    auto& pending = handle->write_behind;
+    std::unique_lock<std::mutex> lock{pending.mutex};
+
+    const auto buffered = static_cast<qint64>(pending.data.size());
+    const auto fits = buffered + len <= max_write_behind_size && dirty_bytes + len <= max_dirty_bytes;
+    if (buffered > 0 && (offset != pending.offset + buffered || !fits))
+        apply_pending_writes(*handle);
+
+    if (!pending.error.empty())
     {
-        auto r = MP_FILEOPS.write(*file, data_ptr, len);
-        if (r < 0)
-        {
-            mpl::log(
-                mpl::Level::trace, category,
-                fmt::format("{}: write failed for \'{}\': {}", __FUNCTION__, file->fileName(), file->errorString()));
+        // An earlier write was already acknowledged, this is the first chance to tell the client it failed
+        const auto error = std::exchange(pending.error, {});
+        lock.unlock();
+
+        mpl::log(mpl::Level::trace, category, "{}: {} for \'{}\'", __FUNCTION__, error, file.fileName());
+        return reply(sftp_reply_status, msg, SSH_FX_FAILURE, error.c_str());
+    }
+
+    if (len > max_write_behind_size || !reserve_dirty_bytes(len))
+    {
+        lock.unlock();
+        const auto written = write_at(file, offset, data, len);
+        attribute_cache.invalidate(file.fileName().toStdString());
+        if (!written)
             return reply_failure(msg);
-        }
 
-        file->flush();
+        io_stats.add_bytes_written(len);
+        return reply_ok(msg);
+    }
 
-        data_ptr += r;
-        len -= r;
-    } while (len > 0);
+    if (pending.data.empty())
+        pending.offset = offset;
+    pending.data.insert(pending.data.end(), data, data + len);
+    lock.unlock();
 
+    io_stats.add_bytes_written(len);
     return reply_ok(msg);
 }
 
@@ -1045,7 +1621,7 @@ int mp::SftpServer::handle_extended(sftp_client_message msg)
     const auto submessage = sftp_client_message_get_submessage(msg);
     if (submessage == nullptr)
     {
-        mpl::log(mpl::Level::trace, category, fmt::format("{}: invalid submesage requested", __FUNCTION__));
+        mpl::log(mpl::Level::trace, category, "{}: invalid submesage requested", __FUNCTION__);
         return reply_failure(msg);
     }
 
@@ -1057,28 +1633,141 @@ int mp::SftpServer::handle_extended(sftp_client_message msg)
         const auto new_name = sftp_client_message_get_data(msg);
         if (!validate_path(source_path, new_name))
         {
-            mpl::log(mpl::Level::trace, category,
-                     fmt::format("{}: cannot validate path \'{}\' against source \'{}\'", __FUNCTION__, new_name,
-                                 source_path));
+            mpl::log(mpl::Level::trace, category, "{}: cannot validate path \'{}\' against source \'{}\'", __FUNCTION__,
+                     new_name, source_path);
             return reply_perm_denied(msg);
         }
 
         if (!MP_PLATFORM.link(old_name, new_name))
         {
-            mpl::log(mpl::Level::trace, category,
-                     fmt::format("{}: failed creating link from \'{}\' to \'{}\'", __FUNCTION__, old_name, new_name));
+            mpl::log(mpl::Level::trace, category, "{}: failed creating link from \'{}\' to \'{}\'", __FUNCTION__,
+                     old_name, new_name);
             return reply_failure(msg);
         }
+        attribute_cache.invalidate(old_name);
+        attribute_cache.invalidate(new_name);
     }
     else if (method == "posix-rename@openssh.com")
     {
         return handle_rename(msg);
     }
+    else if (method == "copy-data")
+    {
+        return handle_copy_data(msg);
+    }
+    else if (method == "fsync@openssh.com")
+    {
+        return handle_fsync(msg);
+    }
+    else if (method == "statvfs@openssh.com")
+    {
+        return handle_statvfs(msg);
+    }
+    else if (method == "limits@openssh.com")
+    {
+        return reply(extended_reply, msg, channel(),
+                     std::vector<std::uint64_t>{max_packet_size, max_read_size, max_read_size, SFTP_HANDLES});
+    }
     else
     {
-        mpl::log(mpl::Level::trace, category, fmt::format("Unhandled extended method requested: {}", method));
+        mpl::log(mpl::Level::trace, category, "Unhandled extended method requested: {}", method);
         return reply_unsupported(msg);
     }
 
     return reply_ok(msg);
 }
+
+int mp::SftpServer::handle_copy_data(sftp_client_message msg)
+{
+    ExtendedArgs args{msg};
+    const auto read_from = args.string();
+    const auto read_offset = args.u64();
+    const auto length = args.u64();
+    const auto write_to = args.string();
+    const auto write_offset = args.u64();
+    if (!write_offset)
+    {
+        mpl::log(mpl::Level::trace, category, "{}: invalid request", __FUNCTION__);
+        return reply(sftp_reply_status, msg, SSH_FX_BAD_MESSAGE, "invalid copy-data request");
+    }
+
+    auto source = handle_from(msg, read_from, open_file_handles, handles_mutex);
+    auto destination = handle_from(msg, write_to, open_file_handles, handles_mutex);
+    if (source == nullptr || destination == nullptr)
+    {
+        mpl::log(mpl::Level::trace, category, "{}: bad handle requested", __FUNCTION__);
+        return reply_bad_handle(msg, "copy-data");
+    }
+
+    // Within one file the ranges must not overlap, the copy would read back what it had just written
+    const auto from = static_cast<qint64>(*read_offset), to = static_cast<qint64>(*write_offset);
+    const auto span = *length ? static_cast<qint64>(*length) : std::max(source->file->size() - from, qint64{0});
+    if (source->file->fileName() == destination->file->fileName() && from < to + span && to < from + span)
+        return reply(sftp_reply_status, msg, SSH_FX_FAILURE, "overlapping copy-data ranges");
+
+    for (auto handle : {source, destination})
+        if (auto error = flush_writes(*handle); !error.empty())
+            return reply(sftp_reply_status, msg, SSH_FX_FAILURE, error.c_str());
+    invalidate_read_ahead(*destination);
+
+    const auto copied = copy_range(*source->file, from, *destination->file, to, static_cast<qint64>(*length));
+    attribute_cache.invalidate(destination->file->fileName().toStdString());
+    if (!copied)
+    {
+        mpl::log(mpl::Level::trace, category, "{}: failed copying from \'{}\' to \'{}\'", __FUNCTION__,
+                 source->file->fileName(), destination->file->fileName());
+        return reply_failure(msg);
+    }
+
+    return reply_ok(msg);
+}
+
+int mp::SftpServer::handle_fsync(sftp_client_message msg)
+{
+    ExtendedArgs args{msg};
+    auto handle = handle_from(msg, args.string(), open_file_handles, handles_mutex);
+    if (handle == nullptr)
+    {
+        mpl::log(mpl::Level::trace, category, "{}: bad handle requested", __FUNCTION__);
+        return reply_bad_handle(msg, "fsync");
+    }
+
+    if (auto error = flush_writes(*handle); !error.empty())
+        return reply(sftp_reply_status, msg, SSH_FX_FAILURE, error.c_str());
+
+    if (::fsync(handle->file->handle()) != 0)
+    {
+        const auto error_string = std::strerror(errno);
+        mpl::log(mpl::Level::trace, category, "{}: fsync failed for \'{}\': {}", __FUNCTION__,
+                 handle->file->fileName(), error_string);
+        return reply(sftp_reply_status, msg, SSH_FX_FAILURE, error_string);
+    }
+
+    return reply_ok(msg);
+}
+
+int mp::SftpServer::handle_statvfs(sftp_client_message msg)
+{
+    ExtendedArgs args{msg};
+    const auto path = args.string();
+    if (path && !validate_path(source_path, *path))
+    {
+        mpl::log(mpl::Level::trace, category, "{}: cannot validate path '{}' against source '{}'", __FUNCTION__,
+                 *path, source_path);
+        return reply_perm_denied(msg);
+    }
+
+    struct statvfs st;
+    if (!path || ::statvfs(path->c_str(), &st) != 0)
+    {
+        mpl::log(mpl::Level::trace, category, "{}: cannot get filesystem statistics for \'{}\'", __FUNCTION__,
+                 path.value_or(""));
+        return reply_failure(msg);
+    }
+
+    const std::uint64_t flags = (st.f_flag & ST_RDONLY ? SSH_FXE_STATVFS_ST_RDONLY : 0) |
+                                (st.f_flag & ST_NOSUID ? SSH_FXE_STATVFS_ST_NOSUID : 0);
+    return reply(extended_reply, msg, channel(),
+                 std::vector<std::uint64_t>{st.f_bsize, st.f_frsize, st.f_blocks, st.f_bfree, st.f_bavail, st.f_files,
+                                            st.f_ffree, st.f_favail, st.f_fsid, flags, st.f_namemax});
+}
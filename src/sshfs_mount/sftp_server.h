@@ -18,13 +18,26 @@
 #ifndef MULTIPASS_SFTP_SERVER_H
 #define MULTIPASS_SFTP_SERVER_H
 
+#include "sftp_attribute_cache.h"
+#include "sftp_dispatcher.h"
+#include "sftp_stats.h"
+
 #include <multipass/id_mappings.h>
 #include <multipass/ssh/ssh_session.h>
 
 #include <libssh/sftp.h>
 
+#include <dirent.h>
+#include <sys/stat.h>
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
 #include <memory>
+#include <mutex>
+#include <string>
 #include <unordered_map>
+#include <vector>
 
 #include <QFile>
 #include <QFileInfo>
@@ -39,25 +52,97 @@ class SftpServer
 public:
     SftpServer(SSHSession&& ssh_session, const std::string& source, const std::string& target,
                const id_mappings& gid_mappings, const id_mappings& uid_mappings, int default_uid, int default_gid,
-               const std::string& sshfs_exec_line);
+               const std::string& sshfs_exec_line, bool write_behind = false);
+    // For serving over a session shared with other servers: every use of it is made holding session_mutex, which
+    // the caller must hold while constructing too. The caller drives the server with serve_next() instead of run().
+    // Requests are handled on the given dispatcher, which the other servers may share too, or on one of its own.
+    SftpServer(std::shared_ptr<SSHSession> ssh_session, std::shared_ptr<std::mutex> session_mutex,
+               const std::string& source, const std::string& target, const id_mappings& gid_mappings,
+               const id_mappings& uid_mappings, int default_uid, int default_gid, const std::string& sshfs_exec_line,
+               bool write_behind = false, std::shared_ptr<SftpDispatcher> shared_dispatcher = nullptr);
     SftpServer(SftpServer&& other);
     ~SftpServer();
 
     void run();
     void stop();
 
+    // Waits up to timeout for a message and handles it; false once the server is done
+    bool serve_next(std::chrono::milliseconds timeout);
+    bool busy() const; // when it has work in flight, and should not be left waiting for long
+    ssh_channel channel() const;
+
+    const SftpStats& stats() const;
+
     using SSHSessionUptr = std::unique_ptr<ssh_session_struct, decltype(ssh_free)*>;
     using SftpSessionUptr = std::unique_ptr<sftp_session_struct, decltype(sftp_free)*>;
     using SSHFSProcUptr = std::unique_ptr<SSHProcess>;
 
 private:
+    struct ReadAhead
+    {
+        std::mutex mutex;
+        std::condition_variable filled;
+        bool pending{false}; // a background read is filling data; only it touches data meanwhile
+        std::vector<char> data;
+        qint64 offset{0};
+        qint64 requested{0};
+        qint64 size{0};
+    };
+
+    struct WriteBehind
+    {
+        std::mutex mutex;
+        std::vector<char> data; // adjacent writes acknowledged but not yet applied, starting at offset
+        qint64 offset{0};
+        std::string error; // why applying them failed, reported on the next request that flushes
+    };
+
+    struct OpenDir
+    {
+        std::string path;
+        std::unique_ptr<DIR, int (*)(DIR*)> dir{nullptr, closedir};
+        std::string held_over_entry; // read, but it didn't fit in the last reply
+    };
+
+    struct OpenFile
+    {
+        ~OpenFile();
+
+        std::unique_ptr<QFile> file;
+        std::vector<char> read_buffer; // reused by every read on the handle
+        qint64 next_offset{0};         // where a sequential reader would continue
+        int sequential_reads{0};
+        ReadAhead read_ahead;
+        WriteBehind write_behind;
+    };
+
+    bool recover();
+    std::string dispatch_key_for(sftp_client_message msg);
+    const char* read_ahead_data(OpenFile& handle, qint64 offset, qint64 len);
+    void schedule_read_ahead(OpenFile& handle, qint64 len);
+    void fill_read_ahead(OpenFile& handle);
+    void invalidate_read_ahead(OpenFile& handle);
+    void apply_pending_writes(OpenFile& handle);
+    bool reserve_dirty_bytes(qint64 len);
+    std::string flush_writes(OpenFile& handle);
+    void flush_writes_to(const QString& filename);
+    void flush_all_writes();
     void process_message(sftp_client_message msg);
+    sftp_attributes_struct attr_from(const struct stat& st);
     sftp_attributes_struct attr_from(const QFileInfo& file_info);
     int mapped_uid_for(const int uid);
     int mapped_gid_for(const int gid);
     int reverse_uid_for(const int uid, const int rev_uid_if_not_found);
     int reverse_gid_for(const int gid, const int rev_gid_if_not_found);
 
+    template <typename Reply, typename... Args>
+    int reply(Reply&& sftp_reply, sftp_client_message msg, Args&&... args);
+    int reply_ok(sftp_client_message msg);
+    int reply_failure(sftp_client_message msg);
+    int reply_perm_denied(sftp_client_message msg);
+    int reply_bad_handle(sftp_client_message msg, const char* type);
+    int reply_unsupported(sftp_client_message msg);
+
     int handle_close(sftp_client_message msg);
     int handle_fstat(sftp_client_message msg);
     int handle_mkdir(sftp_client_message msg);
@@ -75,20 +160,32 @@ private:
     int handle_symlink(sftp_client_message msg);
     int handle_write(sftp_client_message msg);
     int handle_extended(sftp_client_message msg);
+    int handle_copy_data(sftp_client_message msg);
+    int handle_fsync(sftp_client_message msg);
+    int handle_statvfs(sftp_client_message msg);
 
-    SSHSession ssh_session;
+    const std::shared_ptr<std::mutex> session_mutex; // serializes libssh calls on the session
+    const std::shared_ptr<SSHSession> ssh_session;
+    bool owns_session{false}; // stopping may then shut the session down, as nothing else uses it
     SSHFSProcUptr sshfs_process;
     SftpSessionUptr sftp_server_session;
     const std::string source_path;
     const std::string target_path;
-    std::unordered_map<void*, std::unique_ptr<QFileInfoList>> open_dir_handles;
-    std::unordered_map<void*, std::unique_ptr<QFile>> open_file_handles;
+    std::unordered_map<void*, std::unique_ptr<OpenDir>> open_dir_handles;
+    std::unordered_map<void*, std::unique_ptr<OpenFile>> open_file_handles;
     const id_mappings gid_mappings;
     const id_mappings uid_mappings;
     const int default_uid;
     const int default_gid;
     const std::string sshfs_exec_line;
-    bool stop_invoked{false};
+    const bool write_behind;
+    std::atomic<qint64> dirty_bytes{0}; // acknowledged write data held across all handles
+    std::atomic_bool stop_invoked{false};
+    std::mutex handles_mutex; // guards the sftp handle table and the open_*_handles maps
+    std::atomic_int pending_replies{0};
+    SftpStats io_stats;
+    SftpAttributeCache attribute_cache;
+    SftpDispatchQueue dispatcher; // declared last, so that outstanding requests finish before anything goes away
 };
 } // namespace multipass
 #endif // MULTIPASS_SFTP_SERVER_H
@@ -0,0 +1,117 @@
+/*
+ * Copyright (C) Canonical, Ltd.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; version 3.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#include "sftp_stats.h"
+
+#include <libssh/sftp.h>
+
+#include <QJsonArray>
+
+#include <algorithm>
+
+namespace mp = multipass;
+
+void mp::SftpStats::record(std::uint8_t type, std::chrono::nanoseconds latency)
+{
+    const auto us = std::chrono::duration_cast<std::chrono::microseconds>(latency).count();
+    const auto bucket = std::lower_bound(latency_bounds_us.cbegin(), latency_bounds_us.cend(), us) -
+                        latency_bounds_us.cbegin();
+
+    // Anything the server doesn't know about is lumped together
+    auto& op = ops[op_name(type) ? type : 0];
+    ++op.count;
+    ++op.latency_histogram[bucket];
+}
+
+void mp::SftpStats::add_bytes_read(std::uint64_t bytes)
+{
+    bytes_read += bytes;
+}
+
+void mp::SftpStats::add_bytes_written(std::uint64_t bytes)
+{
+    bytes_written += bytes;
+}
+
+QJsonObject mp::SftpStats::to_json() const
+{
+    QJsonObject json_ops;
+    for (auto type = 0u; type < ops.size(); ++type)
+    {
+        const auto& op = ops[type];
+        if (op.count == 0)
+            continue;
+
+        QJsonArray histogram;
+        for (const auto& bucket : op.latency_histogram)
+            histogram.append(static_cast<qint64>(bucket.load()));
+
+        json_ops.insert(type == 0 ? "other" : op_name(type),
+                        QJsonObject{{"count", static_cast<qint64>(op.count.load())}, {"latency_histogram", histogram}});
+    }
+
+    return QJsonObject{{"bytes_read", static_cast<qint64>(bytes_read.load())},
+                       {"bytes_written", static_cast<qint64>(bytes_written.load())},
+                       {"ops", json_ops}};
+}
+
+const char* mp::SftpStats::op_name(std::uint8_t type)
+{
+    switch (type)
+    {
+    case SFTP_OPEN:
+        return "open";
+    case SFTP_CLOSE:
+        return "close";
+    case SFTP_READ:
+        return "read";
+    case SFTP_WRITE:
+        return "write";
+    case SFTP_LSTAT:
+        return "lstat";
+    case SFTP_FSTAT:
+        return "fstat";
+    case SFTP_SETSTAT:
+        return "setstat";
+    case SFTP_FSETSTAT:
+        return "fsetstat";
+    case SFTP_OPENDIR:
+        return "opendir";
+    case SFTP_READDIR:
+        return "readdir";
+    case SFTP_REMOVE:
+        return "remove";
+    case SFTP_MKDIR:
+        return "mkdir";
+    case SFTP_RMDIR:
+        return "rmdir";
+    case SFTP_REALPATH:
+        return "realpath";
+    case SFTP_STAT:
+        return "stat";
+    case SFTP_RENAME:
+        return "rename";
+    case SFTP_READLINK:
+        return "readlink";
+    case SFTP_SYMLINK:
+        return "symlink";
+    case SFTP_EXTENDED:
+        return "extended";
+    default:
+        return nullptr;
+    }
+}
@@ -0,0 +1,62 @@
+/*
+ * Copyright (C) Canonical, Ltd.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; version 3.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#ifndef MULTIPASS_SFTP_STATS_H
+#define MULTIPASS_SFTP_STATS_H
+
+#include <multipass/disabled_copy_move.h>
+
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+
+#include <QJsonObject>
+
+namespace multipass
+{
+// What the sftp server has been asked to do, for `multipass info`. Counters can be updated from any thread.
+class SftpStats : private DisabledCopyMove
+{
+public:
+    // Upper bounds of the latency histogram buckets, past the last one requests fall in a bucket of their own
+    static constexpr std::array<std::chrono::microseconds::rep, 5> latency_bounds_us{100, 1000, 10000, 100000,
+                                                                                     1000000};
+
+    void record(std::uint8_t type, std::chrono::nanoseconds latency);
+    void add_bytes_read(std::uint64_t bytes);
+    void add_bytes_written(std::uint64_t bytes);
+
+    // {"bytes_read": n, "bytes_written": n, "ops": {"<op>": {"count": n, "latency_histogram": [n, ...]}}}
+    QJsonObject to_json() const;
+
+    // nullptr for messages the server doesn't handle
+    static const char* op_name(std::uint8_t type);
+
+private:
+    struct Op
+    {
+        std::atomic<std::uint64_t> count{0};
+        std::array<std::atomic<std::uint64_t>, latency_bounds_us.size() + 1> latency_histogram{};
+    };
+
+    std::array<Op, 256> ops; // by sftp message type, 0 being all the unknown ones
+    std::atomic<std::uint64_t> bytes_read{0};
+    std::atomic<std::uint64_t> bytes_written{0};
+};
+} // namespace multipass
+#endif // MULTIPASS_SFTP_STATS_H
@@ -29,8 +29,13 @@
 #include <semver200.h>
 
 #include <QDir>
+#include <QJsonDocument>
 #include <QString>
+
+#include <algorithm>
+#include <array>
 #include <iostream>
+#include <stdexcept>
 
 namespace mp = multipass;
 namespace mpl = multipass::logging;
@@ -42,8 +47,32 @@ constexpr auto category = "sshfs mount";
 const std::string fuse_version_string{"FUSE library version"};
 const std::string ld_library_path_key{"LD_LIBRARY_PATH="};
 const std::string snap_path_key{"SNAP="};
+constexpr auto stats_interval = std::chrono::seconds(5);
+const QByteArray stats_prefix{"Stats "}; // picked up by SSHFSMountHandler
+
+// Options on top of the ones every mount gets, for libfuse 2 and 3, which renamed some of them
+struct MountProfile
+{
+    const char* name;
+    const char* fuse2_options;
+    const char* fuse3_options;
+};
+
+const std::array<MountProfile, 4> mount_profiles{{
+    // What mounts always had: a few seconds of caching
+    {"default", " -o cache_timeout=3", " -o dcache_timeout=3"},
+    // Large reads, and the page cache kept across opens of files that only change through the mount
+    {"throughput", " -o cache_timeout=30 -o kernel_cache -o max_read=262144",
+     " -o dcache_timeout=30 -o kernel_cache -o max_read=262144"},
+    // Builds and the like, which look up and list far more than they read
+    {"metadata", " -o cache_timeout=60 -o entry_timeout=60 -o attr_timeout=60",
+     " -o dcache_timeout=60 -o entry_timeout=60 -o attr_timeout=60"},
+    // Changes made on the host seen right away, at the cost of asking the host for everything
+    {"consistent", " -o cache=no -o direct_io -o entry_timeout=0 -o attr_timeout=0",
+     " -o dir_cache=no -o direct_io -o entry_timeout=0 -o attr_timeout=0"},
+}};
 
-auto get_sshfs_exec_and_options(mp::SSHSession& session)
+mp::SshfsProbe probe_sshfs(mp::SSHSession& session)
 {
     std::string sshfs_exec;
 
@@ -79,10 +108,19 @@ auto get_sshfs_exec_and_options(mp::SSHSession& session)
     sshfs_exec = mp::utils::trim_end(sshfs_exec);
 
     auto version_info{mpu::run_in_ssh_session(session, fmt::format("sudo {} -V", sshfs_exec))};
+    return {sshfs_exec, mp::utils::match_line_for(version_info, fuse_version_string)};
+}
+
+auto get_sshfs_exec_and_options(const mp::SshfsProbe& probe, const std::string& profile)
+{
+    const auto options = std::find_if(mount_profiles.cbegin(), mount_profiles.cend(),
+                                      [&profile](const auto& known) { return profile == known.name; });
+    if (options == mount_profiles.cend())
+        throw std::invalid_argument{fmt::format("Unknown mount profile: {}", profile)};
 
-    sshfs_exec += " -o slave -o transform_symlinks -o allow_other -o Compression=no";
+    auto sshfs_exec = probe.sshfs_exec + " -o slave -o transform_symlinks -o allow_other -o Compression=no";
 
-    auto fuse_version_line = mp::utils::match_line_for(version_info, fuse_version_string);
+    const auto& fuse_version_line = probe.fuse_version_line;
     if (!fuse_version_line.empty())
     {
         std::string fuse_version;
@@ -101,11 +139,11 @@ auto get_sshfs_exec_and_options(mp::SSHSession& session)
         // The option was made the default in libfuse 3.0
         else if (version::Semver200_version(fuse_version) < version::Semver200_version("3.0.0"))
         {
-            sshfs_exec += " -o nonempty -o cache_timeout=3";
+            sshfs_exec += std::string{" -o nonempty"} + options->fuse2_options;
         }
         else
         {
-            sshfs_exec += " -o dcache_timeout=3";
+            sshfs_exec += options->fuse3_options;
         }
     }
     else
@@ -117,12 +155,37 @@ auto get_sshfs_exec_and_options(mp::SSHSession& session)
 }
 
 auto make_sftp_server(mp::SSHSession&& session, const std::string& source, const std::string& target,
-                      const mp::id_mappings& gid_mappings, const mp::id_mappings& uid_mappings)
+                      const mp::id_mappings& gid_mappings, const mp::id_mappings& uid_mappings, bool write_behind,
+                      const std::string& profile)
 {
     mpl::log(mpl::Level::debug, category,
              fmt::format("{}:{} {}(source = {}, target = {}, …): ", __FILE__, __LINE__, __FUNCTION__, source, target));
 
-    auto sshfs_exec_line = get_sshfs_exec_and_options(session);
+    std::optional<mp::SshfsProbe> probe;
+    auto [sshfs_exec_line, path, default_uid, default_gid] = mp::prepare_sshfs_target(session, target, profile, probe);
+    return std::make_unique<mp::SftpServer>(std::move(session), source, path, gid_mappings, uid_mappings, default_uid,
+                                            default_gid, sshfs_exec_line, write_behind);
+}
+} // namespace
+
+const std::vector<std::string>& mp::sshfs_mount_profiles()
+{
+    static const auto names = [] {
+        std::vector<std::string> ret;
+        for (const auto& profile : mount_profiles)
+            ret.push_back(profile.name);
+        return ret;
+    }();
+
+    return names;
+}
+
+mp::SshfsTarget mp::prepare_sshfs_target(SSHSession& session, const std::string& target, const std::string& profile,
+                                         std::optional<SshfsProbe>& probe)
+{
+    if (!probe)
+        probe = probe_sshfs(session);
+    auto sshfs_exec_line = get_sshfs_exec_and_options(*probe, profile.empty() ? mount_profiles[0].name : profile);
 
     // Split the path in existing and missing parts.
     const auto& [leading, missing] = mpu::get_path_split(session, target);
@@ -145,22 +208,22 @@ auto make_sftp_server(mp::SSHSession&& session, const std::string& source, const
         mpu::set_owner_for(session, leading, missing, default_uid, default_gid);
     }
 
-    return std::make_unique<mp::SftpServer>(std::move(session), source, leading + missing, gid_mappings, uid_mappings,
-                                            default_uid, default_gid, sshfs_exec_line);
+    return {sshfs_exec_line, leading + missing, default_uid, default_gid};
 }
 
-} // namespace
-
 mp::SshfsMount::SshfsMount(SSHSession&& session, const std::string& source, const std::string& target,
-                           const mp::id_mappings& gid_mappings, const mp::id_mappings& uid_mappings)
-    : sftp_server{make_sftp_server(std::move(session), source, target, gid_mappings, uid_mappings)},
+                           const mp::id_mappings& gid_mappings, const mp::id_mappings& uid_mappings,
+                           bool write_behind, const std::string& profile)
+    : sftp_server{
+          make_sftp_server(std::move(session), source, target, gid_mappings, uid_mappings, write_behind, profile)},
       sftp_thread{[this]() {
           mp::top_catch_all(category, [this] {
               std::cout << "Connected" << std::endl;
               sftp_server->run();
               std::cout << "Stopped" << std::endl;
           });
-      }}
+      }},
+      stats_thread{[this]() { mp::top_catch_all(category, [this] { report_stats(); }); }}
 {
 }
 
@@ -171,7 +234,30 @@ mp::SshfsMount::~SshfsMount()
 
 void mp::SshfsMount::stop()
 {
+    {
+        std::lock_guard<std::mutex> lock{stats_mutex};
+        stopping = true;
+    }
+    stopped.notify_all();
+    if (stats_thread.joinable())
+        stats_thread.join();
+
     sftp_server->stop();
     if (sftp_thread.joinable())
         sftp_thread.join();
 }
+
+void mp::SshfsMount::report_stats()
+{
+    QByteArray last_report;
+    std::unique_lock<std::mutex> lock{stats_mutex};
+    while (!stopped.wait_for(lock, stats_interval, [this] { return stopping; }))
+    {
+        // One line at a time, so that it cannot get mixed up with anything else printed
+        auto report = stats_prefix + QJsonDocument{sftp_server->stats().to_json()}.toJson(QJsonDocument::Compact);
+        if (report != last_report)
+            std::cout << (report + '\n').toStdString() << std::flush;
+
+        last_report = std::move(report);
+    }
+}
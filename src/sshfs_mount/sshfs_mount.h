@@ -20,29 +20,65 @@
 
 #include <multipass/id_mappings.h>
 
+#include <condition_variable>
 #include <memory>
+#include <mutex>
+#include <optional>
+#include <string>
 #include <thread>
 #include <unordered_map>
+#include <vector>
 
 namespace multipass
 {
 class SSHSession;
 class SftpServer;
+
+// What serving a target in the instance takes; getting it creates whatever part of the target path is missing
+struct SshfsTarget
+{
+    std::string sshfs_exec_line;
+    std::string path;
+    int default_uid;
+    int default_gid;
+};
+
+// What was found out about sshfs in the instance, which only changes when it is reinstalled
+struct SshfsProbe
+{
+    std::string sshfs_exec;        // how to run it
+    std::string fuse_version_line; // from `sshfs -V`, empty if it had none
+};
+
+// Named sets of sshfs options, tuned for different uses; the first one is what mounts get when they name none
+const std::vector<std::string>& sshfs_mount_profiles();
+
+// The probe is made the first time around, and reused for the instance's other mounts after that
+SshfsTarget prepare_sshfs_target(SSHSession& session, const std::string& target, const std::string& profile,
+                                 std::optional<SshfsProbe>& probe);
+
 class SshfsMount
 {
 public:
     SshfsMount(SSHSession&& session, const std::string& source, const std::string& target,
-               const id_mappings& gid_mappings, const id_mappings& uid_mappings);
+               const id_mappings& gid_mappings, const id_mappings& uid_mappings, bool write_behind = false,
+               const std::string& profile = {});
     SshfsMount(SshfsMount&& other);
     ~SshfsMount();
 
     void stop();
 
 private:
+    void report_stats();
+
     // sftp_server Doesn't need to be a pointer, but done for now to avoid bringing sftp.h
     // which has an error with -pedantic.
     std::unique_ptr<SftpServer> sftp_server;
     std::thread sftp_thread;
+    std::mutex stats_mutex;
+    std::condition_variable stopped;
+    bool stopping{false};
+    std::thread stats_thread;
 };
 } // namespace multipass
 #endif // MULTIPASS_SSHFS_MOUNT
@@ -15,15 +15,28 @@
  *
  */
 
+#include "sshfs_mount.h"
+
+#include <multipass/constants.h>
 #include <multipass/exceptions/exitless_sshprocess_exception.h>
 #include <multipass/exceptions/sshfs_missing_error.h>
 #include <multipass/platform.h>
+#include <multipass/settings/settings.h>
 #include <multipass/sshfs_mount/sshfs_mount_handler.h>
 #include <multipass/utils.h>
 
 #include <QCoreApplication>
+#include <QCryptographicHash>
 #include <QEventLoop>
+#include <QJsonArray>
+#include <QJsonDocument>
+#include <QJsonObject>
 #include <QThread>
+#include <QTimer>
+
+#include <algorithm>
+#include <map>
+#include <set>
 
 namespace mp = multipass;
 namespace mpl = multipass::logging;
@@ -32,6 +45,7 @@ namespace mpu = multipass::utils;
 namespace
 {
 constexpr auto category = "sshfs-mount-handler";
+const QByteArray stats_prefix{"Stats "}; // printed by sshfs_server
 
 void start_and_block_until_connected(mp::Process* process)
 {
@@ -51,6 +65,51 @@ void start_and_block_until_connected(mp::Process* process)
     QObject::disconnect(running_conn);
 }
 
+// Reports sshfs_server prints, see SftpStats::to_json()
+mp::MountStats stats_from_json(const QJsonObject& json)
+{
+    auto to_uint64 = [](const QJsonValue& value) { return value.toVariant().toULongLong(); };
+
+    mp::MountStats stats;
+    stats.set_bytes_read(to_uint64(json["bytes_read"]));
+    stats.set_bytes_written(to_uint64(json["bytes_written"]));
+
+    const auto ops = json["ops"].toObject();
+    for (auto it = ops.begin(); it != ops.end(); ++it)
+    {
+        const auto json_op = it.value().toObject();
+        auto op = stats.add_ops();
+        op->set_op(it.key().toStdString());
+        op->set_count(to_uint64(json_op["count"]));
+        for (const auto& bucket : json_op["latency_histogram"].toArray())
+            op->add_latency_histogram(to_uint64(bucket));
+    }
+
+    return stats;
+}
+
+QString serialise_id_mappings(const mp::id_mappings& xid_mappings)
+{
+    QString out;
+    for (auto ids : xid_mappings)
+        out += QString("%1:%2,").arg(ids.first).arg(ids.second);
+    return out;
+}
+
+// Guests from before the vsock socket unit, or without the vhost_vsock module, only have SSH over the network
+bool reachable_over_vsock(const std::string& name, std::uint32_t cid, const std::string& username,
+                          const mp::SSHKeyProvider& key_provider)
+try
+{
+    mp::SSHSession{mp::SSHSession::vsock_host(cid), mp::vsock_ssh_port, username, key_provider};
+    return true;
+}
+catch (const std::exception& e)
+{
+    mpl::log(mpl::Level::debug, category, fmt::format("[{}] Mounting over the network, not vsock: {}", name, e.what()));
+    return false;
+}
+
 bool has_sshfs(const std::string& name, mp::SSHSession& session)
 {
     // Check if snap support is installed in the instance
@@ -107,14 +166,259 @@ catch (const mp::ExitlessSSHProcessException&)
     mpl::log(mpl::Level::info, category, fmt::format("Timeout while installing 'multipass-sshfs' in '{}'", name));
     throw mp::SSHFSMissingError();
 }
+struct SharedServerRegistry
+{
+    std::mutex mutex;
+    std::map<std::string, std::multiset<std::string>> declared_sources; // by instance, of the mounts it has
+    std::map<std::string, std::weak_ptr<mp::SharedSSHFSServer>> servers; // by instance, the one new mounts go to
+};
+
+SharedServerRegistry& shared_server_registry()
+{
+    static SharedServerRegistry registry;
+    return registry;
+}
 } // namespace
 
 namespace multipass
 {
+// A single sshfs_server for the mounts of an instance, see SshfsMultiMount. It may only serve the sources that were
+// known to be mounted in the instance when it started, as its AppArmor profile allows no others; mounting anything
+// else starts a new server, which the instance's later mounts then share.
+class SharedSSHFSServer
+{
+public:
+    static void declare(const std::string& instance, const std::string& source);
+    static void withdraw(const std::string& instance, const std::string& source);
+    static std::shared_ptr<SharedSSHFSServer> for_mount(const SSHFSServerConfig& config);
+
+    explicit SharedSSHFSServer(const SSHFSServerConfig& config);
+    ~SharedSSHFSServer();
+
+    void add(const std::string& id, const SSHFSServerConfig& mount, std::chrono::milliseconds timeout);
+    void remove(const std::string& id);
+    bool is_active(const std::string& id);
+    std::optional<MountStats> stats(const std::string& id);
+
+private:
+    void send(const QJsonObject& command);
+    void read_output();
+
+    const std::vector<std::string> sources;
+    qt_delete_later_unique_ptr<Process> process;
+    std::mutex mutex;
+    QByteArray unread_output;
+    std::map<std::string, QByteArray> outcomes; // of adding mounts: Connected, Failed or Missing, and later Stopped
+    std::map<std::string, QByteArray> failures; // why they did
+    std::map<std::string, MountStats> mount_stats;
+};
+
+void SharedSSHFSServer::declare(const std::string& instance, const std::string& source)
+{
+    auto& registry = shared_server_registry();
+    std::lock_guard lock{registry.mutex};
+    registry.declared_sources[instance].insert(source);
+}
+
+void SharedSSHFSServer::withdraw(const std::string& instance, const std::string& source)
+{
+    auto& registry = shared_server_registry();
+    std::lock_guard lock{registry.mutex};
+    auto& declared = registry.declared_sources[instance];
+    if (auto it = declared.find(source); it != declared.end())
+        declared.erase(it);
+}
+
+std::shared_ptr<SharedSSHFSServer> SharedSSHFSServer::for_mount(const SSHFSServerConfig& config)
+{
+    auto& registry = shared_server_registry();
+    std::lock_guard lock{registry.mutex}; // held while starting, so that an instance does not get two at once
+
+    auto& current = registry.servers[config.instance];
+    if (auto server = current.lock(); server && server->process->running() &&
+                                      std::count(server->sources.cbegin(), server->sources.cend(), config.source_path))
+        return server;
+
+    const auto& declared = registry.declared_sources[config.instance];
+    std::set<std::string> sources{declared.cbegin(), declared.cend()};
+    sources.insert(config.source_path);
+
+    auto shared_config = config;
+    shared_config.shared_sources.assign(sources.cbegin(), sources.cend());
+
+    auto server = std::make_shared<SharedSSHFSServer>(shared_config);
+    current = server;
+    return server;
+}
+
+SharedSSHFSServer::SharedSSHFSServer(const SSHFSServerConfig& config)
+    : sources{config.shared_sources}, process{platform::make_sshfs_server_process(config).release()}
+{
+    QObject::connect(process.get(), &Process::finished, [instance = config.instance](const ProcessState& exit_state) {
+        if (exit_state.completed_successfully())
+            mpl::log(mpl::Level::info, category, fmt::format("Mounts of instance '{}' have stopped", instance));
+        else
+            mpl::log(mpl::Level::warning, category,
+                     fmt::format("Mounts of instance '{}' have stopped unsuccessfully: {}", instance,
+                                 exit_state.failure_message()));
+    });
+    QObject::connect(process.get(), &Process::error_occurred,
+                     [instance = config.instance](auto error, auto error_string) {
+                         mpl::log(mpl::Level::error, category,
+                                  fmt::format("There was an error with sshfs_server for instance '{}': {} - {}",
+                                              instance, mpu::qenum_to_string(error), error_string));
+                     });
+
+    mpl::log(mpl::Level::info, category, fmt::format("process program '{}'", process->program()));
+    mpl::log(mpl::Level::info, category, fmt::format("process arguments '{}'", process->arguments().join(", ")));
+
+    start_and_block_until_connected(process.get());
+    process->moveToThread(QCoreApplication::instance()->thread()); // see SSHFSMountHandler::activate_impl()
+
+    auto process_state = process->process_state();
+    if (process_state.exit_code == 9) // Magic number returned by sshfs_server
+        throw SSHFSMissingError();
+    else if (process_state.exit_code || process_state.error)
+        throw std::runtime_error(
+            fmt::format("{}: {}", process_state.failure_message(), process->read_all_standard_error()));
+
+    QObject::connect(process.get(), &Process::ready_read_standard_output, [this] { read_output(); });
+}
+
+SharedSSHFSServer::~SharedSSHFSServer()
+{
+    QObject::disconnect(process.get(), &Process::ready_read_standard_output, nullptr, nullptr);
+    QObject::disconnect(process.get(), &Process::error_occurred, nullptr, nullptr);
+    if (process->terminate(); !process->wait_for_finished(5000))
+        mpl::log(mpl::Level::warning, category,
+                 fmt::format("Failed to terminate shared SSHFS mount process: {}", process->read_all_standard_error()));
+}
+
+void SharedSSHFSServer::add(const std::string& id, const SSHFSServerConfig& mount, std::chrono::milliseconds timeout)
+{
+    auto added = [this, &id] {
+        std::lock_guard lock{mutex};
+        return outcomes.count(id) > 0;
+    };
+
+    {
+        std::lock_guard lock{mutex};
+        outcomes.erase(id);
+    }
+
+    QEventLoop event_loop;
+    auto stop_conn = QObject::connect(process.get(), &Process::finished, &event_loop, &QEventLoop::quit);
+    auto output_conn = QObject::connect(process.get(), &Process::ready_read_standard_output, &event_loop, [&] {
+        if (added())
+            event_loop.quit();
+    });
+    QTimer::singleShot(timeout, &event_loop, &QEventLoop::quit);
+
+    send({{"add", QString::fromStdString(id)},
+          {"source", QString::fromStdString(mount.source_path)},
+          {"target", QString::fromStdString(mount.target_path)},
+          {"uid_mappings", serialise_id_mappings(mount.uid_mappings)},
+          {"gid_mappings", serialise_id_mappings(mount.gid_mappings)},
+          {"profile", QString::fromStdString(mount.mount_profile)}});
+
+    if (!added())
+        event_loop.exec();
+
+    QObject::disconnect(stop_conn);
+    QObject::disconnect(output_conn);
+
+    std::unique_lock lock{mutex};
+    const auto outcome = outcomes.find(id);
+    if (outcome == outcomes.end())
+    {
+        lock.unlock();
+        remove(id); // in case it comes through after all
+        throw std::runtime_error{fmt::format("sshfs_server did not mount \"{}\": {}", mount.target_path,
+                                             process->running() ? "timed out" : "it has stopped")};
+    }
+
+    if (outcome->second == "Missing")
+        throw SSHFSMissingError();
+    if (outcome->second == "Failed")
+        throw std::runtime_error{failures[id].toStdString()};
+}
+
+void SharedSSHFSServer::remove(const std::string& id)
+{
+    {
+        std::lock_guard lock{mutex};
+        outcomes.erase(id);
+        failures.erase(id);
+        mount_stats.erase(id);
+    }
+
+    send({{"remove", QString::fromStdString(id)}});
+}
+
+bool SharedSSHFSServer::is_active(const std::string& id)
+{
+    std::lock_guard lock{mutex};
+    auto outcome = outcomes.find(id);
+    return outcome != outcomes.end() && outcome->second == "Connected" && process->running();
+}
+
+std::optional<MountStats> SharedSSHFSServer::stats(const std::string& id)
+{
+    std::lock_guard lock{mutex};
+    auto found = mount_stats.find(id);
+    return found == mount_stats.end() ? std::nullopt : std::make_optional(found->second);
+}
+
+void SharedSSHFSServer::send(const QJsonObject& command)
+{
+    // The process belongs to the main thread, which is where it has to be written to
+    const auto line = QJsonDocument{command}.toJson(QJsonDocument::Compact) + '\n';
+    QMetaObject::invokeMethod(process.get(), [process = process.get(), line] { process->write(line); });
+}
+
+// Lines about a mount start with what happened and its id, see SshfsMultiMount
+void SharedSSHFSServer::read_output()
+{
+    std::lock_guard lock{mutex};
+    unread_output += process->read_all_standard_output();
+
+    for (auto end = unread_output.indexOf('\n'); end != -1; end = unread_output.indexOf('\n'))
+    {
+        const auto line = unread_output.left(end);
+        unread_output.remove(0, end + 1);
+
+        const auto fields = line.split(' ');
+        if (fields.size() < 2)
+            continue;
+
+        const auto& what = fields[0];
+        const auto id = fields[1].toStdString();
+        const auto rest = line.mid(what.size() + fields[1].size() + 2);
+        if (what == "Connected" || what == "Failed" || what == "Missing")
+        {
+            outcomes[id] = what;
+            if (what == "Failed")
+                failures[id] = rest;
+        }
+        else if (auto outcome = outcomes.find(id); what == "Stopped" && outcome != outcomes.end())
+        {
+            outcome->second = what; // only for mounts still known, not those just removed
+        }
+        else if (what == stats_prefix.trimmed())
+        {
+            mount_stats[id] = stats_from_json(QJsonDocument::fromJson(rest).object());
+        }
+    }
+}
+
 SSHFSMountHandler::SSHFSMountHandler(VirtualMachine* vm, const SSHKeyProvider* ssh_key_provider,
                                      const std::string& target, const VMMount& mount)
     : MountHandler{vm, ssh_key_provider, target, mount.source_path},
       process{nullptr},
+      mount_id{QCryptographicHash::hash(QByteArray::fromStdString(target), QCryptographicHash::Sha256)
+                   .toHex()
+                   .left(8)
+                   .toStdString()},
       config{"",
              0,
              vm->ssh_username(),
@@ -123,16 +427,25 @@ SSHFSMountHandler::SSHFSMountHandler(VirtualMachine* vm, const SSHKeyProvider* s
              mount.source_path,
              target,
              mount.gid_mappings,
-             mount.uid_mappings}
+             mount.uid_mappings,
+             false,
+             mount.mount_profile}
 {
     mpl::log(mpl::Level::info, category,
              fmt::format("initializing mount {} => {} in '{}'", mount.source_path, target, vm->vm_name));
+    SharedSSHFSServer::declare(vm->vm_name, mount.source_path);
+}
+
+const std::vector<std::string>& SSHFSMountHandler::mount_profiles()
+{
+    return sshfs_mount_profiles();
 }
 
 bool SSHFSMountHandler::is_active()
 try
 {
-    return active && process && process->running() &&
+    const auto running = shared_server ? shared_server->is_active(mount_id) : process && process->running();
+    return active && running &&
            !SSHSession{vm->ssh_hostname(), vm->ssh_port(), vm->ssh_username(), *ssh_key_provider}
                 .exec(fmt::format("findmnt --type fuse.sshfs | grep '{} :{}'", target, source))
                 .exit_code();
@@ -164,6 +477,27 @@ void SSHFSMountHandler::activate_impl(ServerVariant server, std::chrono::millise
     // Can't obtain hostname/IP address until instance is running
     config.host = vm->ssh_hostname();
     config.port = vm->ssh_port();
+    if (const auto cid = vm->vsock_cid();
+        cid && reachable_over_vsock(vm->vm_name, *cid, config.username, *ssh_key_provider))
+    {
+        config.host = SSHSession::vsock_host(*cid);
+        config.port = vsock_ssh_port;
+    }
+    // Instances are a local link away, so only compress when told to outright
+    config.compression = MP_SETTINGS.get(ssh_compression_key) == "on";
+    config.write_behind = MP_SETTINGS.get(sshfs_write_behind_key) == "true";
+
+    if (shared_server)
+        shared_server->remove(mount_id);
+    shared_server.reset();
+
+    if (MP_SETTINGS.get(sshfs_shared_server_key) == "true")
+    {
+        auto server = SharedSSHFSServer::for_mount(config);
+        server->add(mount_id, config, timeout);
+        shared_server = std::move(server);
+        return;
+    }
 
     if (process)
         process.reset();
@@ -199,6 +533,8 @@ void SSHFSMountHandler::activate_impl(ServerVariant server, std::chrono::millise
     // when stopping the mount from the main thread again, qt will try to send an event from the main thread to the one
     // in which the process lives this will result in an error since qt can't send events from one thread to another
     process->moveToThread(QCoreApplication::instance()->thread());
+    QObject::connect(process.get(), &Process::ready_read_standard_output,
+                     [this, process = process.get()] { read_stats(*process); });
 
     // Check in case sshfs_server stopped, usually due to an error
     auto process_state = process->process_state();
@@ -211,7 +547,14 @@ void SSHFSMountHandler::activate_impl(ServerVariant server, std::chrono::millise
 
 void SSHFSMountHandler::deactivate_impl(bool force)
 {
-    mpl::log(mpl::Level::info, category, fmt::format("Stopping mount \"{}\" in instance '{}'", target, vm->vm_name));
+    mpl::log(mpl::Record{mpl::Level::info, category, "Stopping mount", vm->vm_name, {{"target", target}}});
+    if (shared_server)
+    {
+        shared_server->remove(mount_id);
+        shared_server.reset();
+        return;
+    }
+
     QObject::disconnect(process.get(), &Process::error_occurred, nullptr, nullptr);
     if (process->terminate(); !process->wait_for_finished(5000))
     {
@@ -224,10 +567,39 @@ void SSHFSMountHandler::deactivate_impl(bool force)
             throw std::runtime_error{err};
     }
     process.reset();
+
+    std::lock_guard lock{stats_mutex};
+    unread_output.clear();
+    last_stats.reset();
+}
+
+std::optional<MountStats> SSHFSMountHandler::stats()
+{
+    if (shared_server)
+        return shared_server->stats(mount_id);
+
+    std::lock_guard lock{stats_mutex};
+    return last_stats;
+}
+
+void SSHFSMountHandler::read_stats(Process& process)
+{
+    std::lock_guard lock{stats_mutex};
+    unread_output += process.read_all_standard_output();
+
+    for (auto end = unread_output.indexOf('\n'); end != -1; end = unread_output.indexOf('\n'))
+    {
+        const auto line = unread_output.left(end);
+        unread_output.remove(0, end + 1);
+
+        if (line.startsWith(stats_prefix))
+            last_stats = stats_from_json(QJsonDocument::fromJson(line.mid(stats_prefix.size())).object());
+    }
 }
 
 SSHFSMountHandler::~SSHFSMountHandler()
 {
     deactivate(/*force=*/true);
+    SharedSSHFSServer::withdraw(vm->vm_name, source);
 }
 } // namespace multipass
@@ -0,0 +1,245 @@
+/*
+ * Copyright (C) Canonical, Ltd.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; version 3.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#include "sshfs_multi_mount.h"
+#include "sftp_dispatcher.h"
+#include "sftp_server.h"
+#include "sshfs_mount.h"
+
+#include <multipass/format.h>
+#include <multipass/logging/log.h>
+#include <multipass/ssh/ssh_session.h>
+#include <multipass/top_catch_all.h>
+
+#include <QJsonDocument>
+
+#include <poll.h>
+
+#include <algorithm>
+#include <iostream>
+#include <stdexcept>
+#include <vector>
+
+namespace mp = multipass;
+namespace mpl = multipass::logging;
+using namespace std::literals::chrono_literals;
+
+namespace
+{
+constexpr auto category = "sshfs multi mount";
+constexpr auto stats_interval = std::chrono::seconds(5);
+
+// How long to wait on the channels: long when nothing is in flight, short otherwise so that replies are not held up
+constexpr auto idle_select_timeout = 250ms;
+constexpr auto busy_select_timeout = 1ms;
+
+// Prints whole lines at once, as they are read by SSHFSMountHandler and must not get mixed up with anything else
+void print_line(const std::string& line)
+{
+    std::cout << line + '\n' << std::flush;
+}
+} // namespace
+
+mp::SshfsMultiMount::SshfsMultiMount(SSHSession&& session, SSHSession&& control_session, bool write_behind,
+                                     std::function<void()> on_failure)
+    : session{std::make_shared<SSHSession>(std::move(session))},
+      session_mutex{std::make_shared<std::mutex>()},
+      control_session{std::move(control_session)},
+      write_behind{write_behind},
+      on_failure{std::move(on_failure)},
+      dispatcher{std::make_shared<SftpDispatcher>(SftpDispatcher::default_num_workers())},
+      reactor{[this]() {
+          mp::top_catch_all(category, [this] { serve(); });
+
+          // Nothing serves the mounts anymore, nor would anything added from now on be
+          if (!stopping && this->on_failure)
+              this->on_failure();
+      }},
+      stats_thread{[this]() { mp::top_catch_all(category, [this] { report_stats(); }); }}
+{
+}
+
+mp::SshfsMultiMount::~SshfsMultiMount()
+{
+    stop();
+}
+
+void mp::SshfsMultiMount::add(const std::string& id, const std::string& source, const std::string& target,
+                              const id_mappings& gid_mappings, const id_mappings& uid_mappings,
+                              const std::string& profile)
+{
+    mpl::log(mpl::Level::debug, category,
+             fmt::format("adding mount {} (source = {}, target = {})", id, source, target));
+
+    {
+        std::lock_guard<std::mutex> lock{mounts_mutex};
+        if (mounts.count(id))
+            throw std::runtime_error{fmt::format("There is a mount with id {} already", id)};
+    }
+
+    std::shared_ptr<SftpServer> server;
+    {
+        std::lock_guard<std::mutex> control_lock{control_mutex};
+        auto [sshfs_exec_line, path, default_uid, default_gid] =
+            prepare_sshfs_target(control_session, target, profile, probe);
+
+        // Only starting sshfs takes the session the mounts are served over
+        std::lock_guard<std::mutex> lock{*session_mutex};
+        server = std::make_shared<SftpServer>(session, session_mutex, source, path, gid_mappings, uid_mappings,
+                                              default_uid, default_gid, sshfs_exec_line, write_behind, dispatcher);
+    }
+
+    {
+        std::lock_guard<std::mutex> lock{mounts_mutex};
+        mounts.emplace(id, std::move(server));
+    }
+
+    state_changed.notify_all();
+    print_line(fmt::format("Connected {}", id));
+}
+
+void mp::SshfsMultiMount::remove(const std::string& id)
+{
+    std::shared_ptr<SftpServer> server;
+    {
+        std::lock_guard<std::mutex> lock{mounts_mutex};
+        auto it = mounts.find(id);
+        if (it == mounts.end())
+            return;
+
+        server = std::move(it->second);
+        mounts.erase(it);
+    }
+
+    // The reactor may be serving it still, in which case it goes away once that is done
+    server->stop();
+    print_line(fmt::format("Stopped {}", id));
+}
+
+void mp::SshfsMultiMount::stop()
+{
+    stopping = true;
+    state_changed.notify_all();
+
+    if (stats_thread.joinable())
+        stats_thread.join();
+    if (reactor.joinable())
+        reactor.join();
+
+    std::map<std::string, std::shared_ptr<SftpServer>> stopped_mounts;
+    {
+        std::lock_guard<std::mutex> lock{mounts_mutex};
+        stopped_mounts.swap(mounts);
+    }
+
+    for (auto& [id, server] : stopped_mounts)
+        server->stop();
+}
+
+void mp::SshfsMultiMount::serve()
+{
+    std::vector<std::pair<std::string, std::shared_ptr<SftpServer>>> serving;
+    std::vector<ssh_channel> channels;
+
+    while (!stopping)
+    {
+        {
+            std::lock_guard<std::mutex> lock{mounts_mutex};
+            serving.assign(mounts.cbegin(), mounts.cend());
+        }
+
+        if (serving.empty())
+        {
+            std::unique_lock<std::mutex> lock{state_mutex};
+            state_changed.wait_for(lock, idle_select_timeout);
+            continue;
+        }
+
+        const auto busy = std::any_of(serving.cbegin(), serving.cend(), [](const auto& m) { return m.second->busy(); });
+        const auto timeout = busy ? busy_select_timeout : idle_select_timeout;
+
+        channels.clear();
+        for (const auto& [id, server] : serving)
+            channels.push_back(server->channel());
+        channels.push_back(nullptr);
+
+        socket_t fd;
+        {
+            // Leaves only the channels with something to read, which includes those that were closed. Without waiting,
+            // so that the session is only held for as long as it takes to read what came in.
+            std::lock_guard<std::mutex> lock{*session_mutex};
+            timeval no_wait{0, 0};
+            const auto result = ssh_channel_select(channels.data(), nullptr, nullptr, &no_wait);
+            if (result == SSH_ERROR)
+                throw std::runtime_error{fmt::format("[sftp] waiting on the mounts failed: {}",
+                                                     ssh_get_error(static_cast<ssh_session>(*session)))};
+            if (result != SSH_OK) // interrupted
+                continue;
+
+            fd = ssh_get_fd(static_cast<ssh_session>(*session));
+        }
+
+        if (!channels.front())
+        {
+            // Nothing yet: waited for on the socket instead, with the session free for the servers to reply over
+            pollfd session_fd{fd, POLLIN, 0};
+            poll(&session_fd, 1, static_cast<int>(timeout.count()));
+            continue;
+        }
+
+        for (auto ready = channels.data(); *ready; ++ready)
+        {
+            auto mount = std::find_if(serving.cbegin(), serving.cend(),
+                                      [channel = *ready](const auto& m) { return m.second->channel() == channel; });
+            if (mount == serving.cend() || mount->second->serve_next(0ms))
+                continue;
+
+            // Done with, sshfs could not be brought back in the instance
+            const auto& [id, server] = *mount;
+            {
+                std::lock_guard<std::mutex> lock{mounts_mutex};
+                if (auto it = mounts.find(id); it != mounts.end() && it->second == server)
+                {
+                    mounts.erase(it);
+                    print_line(fmt::format("Stopped {}", id));
+                }
+            }
+        }
+    }
+}
+
+void mp::SshfsMultiMount::report_stats()
+{
+    std::map<std::string, QByteArray> last_reports;
+    std::unique_lock<std::mutex> lock{state_mutex};
+    while (!state_changed.wait_for(lock, stats_interval, [this] { return stopping.load(); }))
+    {
+        std::map<std::string, QByteArray> reports;
+        {
+            std::lock_guard<std::mutex> mounts_lock{mounts_mutex};
+            for (const auto& [id, server] : mounts)
+                reports.emplace(id, QJsonDocument{server->stats().to_json()}.toJson(QJsonDocument::Compact));
+        }
+
+        // Stats for each mount on a line of their own, see SshfsMount::report_stats()
+        for (const auto& [id, report] : reports)
+            if (last_reports[id] != report)
+                print_line(fmt::format("Stats {} {}", id, report.toStdString()));
+
+        last_reports = std::move(reports);
+    }
+}
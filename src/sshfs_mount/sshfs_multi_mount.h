@@ -0,0 +1,79 @@
+/*
+ * Copyright (C) Canonical, Ltd.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; version 3.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#ifndef MULTIPASS_SSHFS_MULTI_MOUNT
+#define MULTIPASS_SSHFS_MULTI_MOUNT
+
+#include "sshfs_mount.h"
+
+#include <multipass/id_mappings.h>
+
+#include <atomic>
+#include <condition_variable>
+#include <functional>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <thread>
+
+namespace multipass
+{
+class SSHSession;
+class SftpDispatcher;
+class SftpServer;
+
+// Serves any number of an instance's mounts over a single SSH session, a channel each. One thread waits on all the
+// channels and hands the messages to the servers, whose requests are then handled on a pool of workers they share:
+// the threads are the same few however many mounts there are. Targets are prepared over a session of their own, for
+// mounts being added not to hold up those being served. Should the thread serving them fail, on_failure is called.
+class SshfsMultiMount
+{
+public:
+    SshfsMultiMount(SSHSession&& session, SSHSession&& control_session, bool write_behind = false,
+                    std::function<void()> on_failure = {});
+    ~SshfsMultiMount();
+
+    // Mounts are told apart by the id they were added with, which prefixes what is printed about them
+    void add(const std::string& id, const std::string& source, const std::string& target,
+             const id_mappings& gid_mappings, const id_mappings& uid_mappings, const std::string& profile = {});
+    void remove(const std::string& id);
+    void stop();
+
+private:
+    void serve();
+    void report_stats();
+
+    const std::shared_ptr<SSHSession> session;
+    const std::shared_ptr<std::mutex> session_mutex;
+    SSHSession control_session;
+    std::mutex control_mutex;
+    const bool write_behind;
+    const std::function<void()> on_failure;
+    const std::shared_ptr<SftpDispatcher> dispatcher; // outlives the servers, declared before them
+    std::optional<SshfsProbe> probe; // under the control mutex, as it is made over the control session
+    std::mutex mounts_mutex;
+    std::map<std::string, std::shared_ptr<SftpServer>> mounts; // shared, to be served outside of the lock
+    std::atomic_bool stopping{false};
+    std::mutex state_mutex;
+    std::condition_variable state_changed; // on mounts being added and on stopping
+    std::thread reactor;
+    std::thread stats_thread;
+};
+} // namespace multipass
+#endif // MULTIPASS_SSHFS_MULTI_MOUNT
@@ -15,13 +15,19 @@
  *
  */
 
+#include <atomic>
+#include <functional>
 #include <iostream>
 #include <memory>
 #include <string>
+#include <thread>
 
+#include <QJsonDocument>
+#include <QJsonObject>
 #include <QStringList>
 
 #include "sshfs_mount.h"
+#include "sshfs_multi_mount.h"
 
 #include <multipass/exceptions/sshfs_missing_error.h>
 #include <multipass/id_mappings.h>
@@ -33,6 +39,9 @@
 
 #include <ssh/ssh_client_key_provider.h>
 
+#include <signal.h>
+#include <unistd.h>
+
 namespace mp = multipass;
 namespace mpl = multipass::logging;
 namespace mpp = multipass::platform;
@@ -40,10 +49,9 @@ using namespace std;
 
 namespace
 {
-mp::id_mappings convert_id_mappings(const char* in)
+mp::id_mappings convert_id_mappings(const QString& input)
 {
     mp::id_mappings ret_map;
-    QString input(in);
 
     auto maps = input.split(',', QString::SkipEmptyParts);
     for (auto map : maps)
@@ -69,11 +77,75 @@ mp::id_mappings convert_id_mappings(const char* in)
 
     return ret_map;
 }
+
+// One JSON object per line, either {"add": id, "source": ..., "target": ..., "uid_mappings": ..., "gid_mappings": ...,
+// "profile": ...} or {"remove": id}; how each went is printed on a line starting with its id
+void run_command(mp::SshfsMultiMount& mounts, const std::string& line)
+{
+    const auto command = QJsonDocument::fromJson(QByteArray::fromStdString(line)).object();
+    if (command.contains("remove"))
+    {
+        mounts.remove(command["remove"].toString().toStdString());
+        return;
+    }
+
+    const auto id = command["add"].toString().toStdString();
+    if (id.empty())
+    {
+        cerr << "Incorrect command: " << line << endl;
+        return;
+    }
+
+    try
+    {
+        mounts.add(id, command["source"].toString().toStdString(), command["target"].toString().toStdString(),
+                   convert_id_mappings(command["gid_mappings"].toString()),
+                   convert_id_mappings(command["uid_mappings"].toString()),
+                   command["profile"].toString().toStdString());
+    }
+    catch (const mp::SSHFSMissingError&)
+    {
+        cout << "Missing " + id + '\n' << flush;
+    }
+    catch (const exception& e)
+    {
+        cout << "Failed " + id + ' ' + QString{e.what()}.simplified().toStdString() + '\n' << flush;
+    }
+}
+
+[[noreturn]] void serve_mounts(mp::SSHSession&& session, mp::SSHSession&& control_session, bool write_behind,
+                              const std::function<int()>& watchdog)
+{
+    // Should nothing serve the mounts anymore, the process goes for the daemon to start another one for them
+    std::atomic_bool failed{false};
+    mp::SshfsMultiMount mounts{std::move(session), std::move(control_session), write_behind, [&failed] {
+                                   failed = true;
+                                   kill(getpid(), SIGTERM);
+                               }};
+    cout << "Connected" << endl;
+
+    // Left to run, it may be in the middle of reading when told to stop. Stdin closing means the daemon is gone.
+    std::thread{[&mounts] {
+        std::string line;
+        while (getline(cin, line))
+            run_command(mounts, line);
+
+        kill(getpid(), SIGTERM);
+    }}.detach();
+
+    if (int sig = watchdog(); sig && !failed)
+        cout << "Received signal " << sig << ". Stopping" << endl;
+
+    mounts.stop();
+    exit(failed ? 1 : 0);
+}
 } // namespace
 
 int main(int argc, char* argv[])
 {
-    if (argc != 9)
+    // With --shared, a single process serves any number of an instance's mounts, which are given on stdin
+    const auto shared = argc == 6 && string(argv[1]) == "--shared";
+    if (argc != 9 && !shared)
     {
         cerr << "Incorrect arguments" << endl;
         exit(2);
@@ -85,15 +157,17 @@ int main(int argc, char* argv[])
         cerr << "KEY not set" << endl;
         exit(2);
     }
+    const auto args = shared ? argv + 1 : argv;
     const auto priv_key_blob = string(key);
-    const auto host = string(argv[1]);
-    const int port = atoi(argv[2]);
-    const auto username = string(argv[3]);
-    const auto source_path = string(argv[4]);
-    const auto target_path = string(argv[5]);
-    const mp::id_mappings uid_mappings = convert_id_mappings(argv[6]);
-    const mp::id_mappings gid_mappings = convert_id_mappings(argv[7]);
-    const mpl::Level log_level = static_cast<mpl::Level>(atoi(argv[8]));
+    const auto host = string(args[1]);
+    const int port = atoi(args[2]);
+    const auto username = string(args[3]);
+    const mpl::Level log_level = static_cast<mpl::Level>(atoi(shared ? args[4] : args[8]));
+
+    // Passed on by the daemon from its settings
+    const auto write_behind = qEnvironmentVariableIsSet("MULTIPASS_SSHFS_WRITE_BEHIND");
+    const auto compression = qEnvironmentVariableIsSet("MULTIPASS_SSH_COMPRESSION");
+    const auto profile = qEnvironmentVariable("MULTIPASS_SSHFS_MOUNT_PROFILE").toStdString();
 
     auto logger = mpp::make_logger(log_level);
     if (!logger)
@@ -107,8 +181,20 @@ int main(int argc, char* argv[])
     {
         auto watchdog = mpp::make_quit_watchdog(); // called while there is only one thread
 
-        mp::SSHSession session{host, port, username, mp::SSHClientKeyProvider{priv_key_blob}};
-        mp::SshfsMount sshfs_mount(std::move(session), source_path, target_path, gid_mappings, uid_mappings);
+        mp::SSHSession session{host, port, username, mp::SSHClientKeyProvider{priv_key_blob}, std::chrono::seconds(20),
+                               compression};
+        if (shared)
+            serve_mounts(std::move(session),
+                         mp::SSHSession{host, port, username, mp::SSHClientKeyProvider{priv_key_blob},
+                                        std::chrono::seconds(20)},
+                         write_behind, watchdog);
+
+        const auto source_path = string(args[4]);
+        const auto target_path = string(args[5]);
+        const mp::id_mappings uid_mappings = convert_id_mappings(args[6]);
+        const mp::id_mappings gid_mappings = convert_id_mappings(args[7]);
+        mp::SshfsMount sshfs_mount(std::move(session), source_path, target_path, gid_mappings, uid_mappings,
+                                   write_behind, profile);
 
         // ssh lives on its own thread, use this thread to listen for quit signal
         if (int sig = watchdog())
@@ -0,0 +1,330 @@
+/*
+ * Copyright (C) Canonical, Ltd.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; version 3.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#include <multipass/checksum.h>
+
+#include <openssl/evp.h>
+
+#include <algorithm>
+#include <array>
+#include <new>
+#include <stdexcept>
+
+#if defined(__x86_64__) && (defined(__GNUC__) || defined(__clang__))
+#define MULTIPASS_CRC32_PCLMUL
+#include <immintrin.h>
+#elif defined(__aarch64__) && (defined(__GNUC__) || defined(__clang__))
+#define MULTIPASS_CRC32_ARMV8
+#include <arm_acle.h>
+#if defined(__linux__)
+#include <asm/hwcap.h>
+#include <sys/auxv.h>
+#endif
+#endif
+
+namespace mpcs = multipass::checksum;
+
+namespace
+{
+constexpr std::uint32_t crc32_polynomial = 0xedb88320;
+constexpr std::uint64_t crc64_polynomial = 0xc96c5795d7870f42;
+
+template <typename T>
+using SliceTables = std::array<std::array<T, 256>, 8>;
+
+// One table per byte of a 64-bit word, so that eight bytes go in at a time rather than one
+template <typename T>
+constexpr SliceTables<T> make_slice_tables(T polynomial)
+{
+    SliceTables<T> tables{};
+    for (unsigned i = 0; i < 256; ++i)
+    {
+        T crc = i;
+        for (auto bit = 0; bit < 8; ++bit)
+            crc = crc & 1 ? (crc >> 1) ^ polynomial : crc >> 1;
+        tables[0][i] = crc;
+    }
+
+    for (auto k = 1; k < 8; ++k)
+        for (unsigned i = 0; i < 256; ++i)
+            tables[k][i] = (tables[k - 1][i] >> 8) ^ tables[0][tables[k - 1][i] & 0xff];
+
+    return tables;
+}
+
+constexpr auto crc32_tables = make_slice_tables(crc32_polynomial);
+constexpr auto crc64_tables = make_slice_tables(crc64_polynomial);
+
+std::uint64_t read_le64(const std::uint8_t* data)
+{
+    std::uint64_t word = 0;
+    for (auto i = 0; i < 8; ++i)
+        word |= std::uint64_t{data[i]} << (8 * i);
+
+    return word;
+}
+
+// On the inverted CRC, for both widths: a 32-bit CRC only covers the first half of the word
+template <typename T>
+T sliced(const SliceTables<T>& tables, const std::uint8_t* data, std::size_t size, T crc)
+{
+    for (; size >= 8; data += 8, size -= 8)
+    {
+        const auto word = std::uint64_t{crc} ^ read_le64(data);
+        T next = 0;
+        for (auto k = 0; k < 8; ++k)
+            next ^= tables[7 - k][(word >> (8 * k)) & 0xff];
+        crc = next;
+    }
+
+    for (; size > 0; --size)
+        crc = tables[0][(crc ^ *data++) & 0xff] ^ (crc >> 8);
+
+    return crc;
+}
+
+std::uint32_t crc32_sliced(const std::uint8_t* data, std::size_t size, std::uint32_t crc)
+{
+    return sliced(crc32_tables, data, size, crc);
+}
+
+#if defined(MULTIPASS_CRC32_PCLMUL)
+#define MULTIPASS_PCLMUL __attribute__((target("pclmul,sse4.1")))
+
+MULTIPASS_PCLMUL __m128i load(const std::uint8_t* data)
+{
+    return _mm_loadu_si128(reinterpret_cast<const __m128i*>(data));
+}
+
+// Carries the 128 bits so far 128 (or, with other constants, 512) bits further along and adds in the next ones
+MULTIPASS_PCLMUL __m128i fold(__m128i folded, __m128i constants, __m128i next)
+{
+    const auto low = _mm_clmulepi64_si128(folded, constants, 0x00);
+    const auto high = _mm_clmulepi64_si128(folded, constants, 0x11);
+    return _mm_xor_si128(_mm_xor_si128(low, high), next);
+}
+
+// Folding four lanes at a time, then Barrett reduction, as in Intel's "Fast CRC Computation for Generic Polynomials
+// Using PCLMULQDQ Instruction"
+MULTIPASS_PCLMUL std::uint32_t crc32_pclmul(const std::uint8_t* data, std::size_t size, std::uint32_t crc)
+{
+    if (size < 64)
+        return crc32_sliced(data, size, crc);
+
+    const auto k1k2 = _mm_set_epi64x(0x1c6e41596, 0x154442bd4);
+    const auto k3k4 = _mm_set_epi64x(0x0ccaa009e, 0x1751997d0);
+    const auto k5 = _mm_set_epi64x(0, 0x163cd6124);
+    const auto poly_mu = _mm_set_epi64x(0x1f7011641, 0x1db710641);
+    const auto low32 = _mm_set_epi32(0, 0, 0, -1);
+
+    auto x1 = _mm_xor_si128(load(data), _mm_cvtsi32_si128(static_cast<int>(crc)));
+    auto x2 = load(data + 16);
+    auto x3 = load(data + 32);
+    auto x4 = load(data + 48);
+    for (data += 64, size -= 64; size >= 64; data += 64, size -= 64)
+    {
+        x1 = fold(x1, k1k2, load(data));
+        x2 = fold(x2, k1k2, load(data + 16));
+        x3 = fold(x3, k1k2, load(data + 32));
+        x4 = fold(x4, k1k2, load(data + 48));
+    }
+
+    x1 = fold(fold(fold(x1, k3k4, x2), k3k4, x3), k3k4, x4);
+    for (; size >= 16; data += 16, size -= 16)
+        x1 = fold(x1, k3k4, load(data));
+
+    // Down to 64 bits, then 32, then the remainder
+    x1 = _mm_xor_si128(_mm_srli_si128(x1, 8), _mm_clmulepi64_si128(x1, k3k4, 0x10));
+    x1 = _mm_xor_si128(_mm_srli_si128(x1, 4), _mm_clmulepi64_si128(_mm_and_si128(x1, low32), k5, 0x00));
+    auto quotient = _mm_and_si128(_mm_clmulepi64_si128(_mm_and_si128(x1, low32), poly_mu, 0x10), low32);
+    x1 = _mm_xor_si128(x1, _mm_clmulepi64_si128(quotient, poly_mu, 0x00));
+
+    return crc32_sliced(data, size, static_cast<std::uint32_t>(_mm_extract_epi32(x1, 1)));
+}
+#elif defined(MULTIPASS_CRC32_ARMV8)
+#if defined(__clang__)
+#define MULTIPASS_ARMV8_CRC __attribute__((target("crc")))
+#else
+#define MULTIPASS_ARMV8_CRC __attribute__((target("+crc")))
+#endif
+
+MULTIPASS_ARMV8_CRC std::uint32_t crc32_armv8(const std::uint8_t* data, std::size_t size, std::uint32_t crc)
+{
+    for (; size >= 8; data += 8, size -= 8)
+        crc = __crc32d(crc, read_le64(data));
+    for (; size > 0; --size)
+        crc = __crc32b(crc, *data++);
+
+    return crc;
+}
+#endif
+
+struct Crc32Implementation
+{
+    std::uint32_t (*compute)(const std::uint8_t*, std::size_t, std::uint32_t);
+    const char* name;
+};
+
+Crc32Implementation pick_crc32()
+{
+#if defined(MULTIPASS_CRC32_PCLMUL)
+    if (__builtin_cpu_supports("pclmul") && __builtin_cpu_supports("sse4.1"))
+        return {crc32_pclmul, "pclmul"};
+#elif defined(MULTIPASS_CRC32_ARMV8) && defined(__APPLE__)
+    return {crc32_armv8, "armv8"};
+#elif defined(MULTIPASS_CRC32_ARMV8) && defined(__linux__)
+    if (getauxval(AT_HWCAP) & HWCAP_CRC32)
+        return {crc32_armv8, "armv8"};
+#endif
+
+    return {crc32_sliced, "slicing-by-8"};
+}
+
+const Crc32Implementation& crc32_implementation_for_cpu()
+{
+    static const auto implementation = pick_crc32();
+    return implementation;
+}
+
+std::uint32_t rotl(std::uint32_t x, int s)
+{
+    return (x << s) | (x >> (32 - s));
+}
+
+// RFC 1320, one 64-byte block into the state
+void md4_block(std::array<std::uint32_t, 4>& state, const std::uint8_t* block)
+{
+    std::uint32_t x[16];
+    for (auto i = 0; i < 16; ++i)
+        x[i] = std::uint32_t{block[4 * i]} | std::uint32_t{block[4 * i + 1]} << 8 |
+               std::uint32_t{block[4 * i + 2]} << 16 | std::uint32_t{block[4 * i + 3]} << 24;
+
+    auto [a, b, c, d] = state;
+    const auto f = [](auto x, auto y, auto z) { return (x & y) | (~x & z); };
+    const auto g = [](auto x, auto y, auto z) { return (x & y) | (x & z) | (y & z); };
+    const auto h = [](auto x, auto y, auto z) { return x ^ y ^ z; };
+
+    constexpr int shifts[3][4] = {{3, 7, 11, 19}, {3, 5, 9, 13}, {3, 9, 11, 15}};
+    constexpr int round3_order[16] = {0, 8, 4, 12, 2, 10, 6, 14, 1, 9, 5, 13, 3, 11, 7, 15};
+    for (auto i = 0; i < 48; ++i)
+    {
+        const auto round = i / 16, step = i % 16;
+        std::uint32_t mixed, word;
+        if (round == 0)
+            mixed = f(b, c, d), word = x[step];
+        else if (round == 1)
+            mixed = g(b, c, d) + 0x5a827999, word = x[(step % 4) * 4 + step / 4];
+        else
+            mixed = h(b, c, d) + 0x6ed9eba1, word = x[round3_order[step]];
+
+        const auto rotated = rotl(a + mixed + word, shifts[round][step % 4]);
+        a = d, d = c, c = b, b = rotated;
+    }
+
+    state[0] += a;
+    state[1] += b;
+    state[2] += c;
+    state[3] += d;
+}
+} // namespace
+
+std::uint32_t mpcs::crc32(const void* data, std::size_t size, std::uint32_t crc)
+{
+    return ~crc32_implementation_for_cpu().compute(static_cast<const std::uint8_t*>(data), size, ~crc);
+}
+
+std::uint64_t mpcs::crc64(const void* data, std::size_t size, std::uint64_t crc)
+{
+    return ~sliced(crc64_tables, static_cast<const std::uint8_t*>(data), size, ~crc);
+}
+
+const char* mpcs::crc32_implementation()
+{
+    return crc32_implementation_for_cpu().name;
+}
+
+// By hand: OpenSSL 3 only has it in the legacy provider, which is not there to count on
+std::array<std::uint8_t, 16> mpcs::md4(const void* data, std::size_t size)
+{
+    std::array<std::uint32_t, 4> state{0x67452301, 0xefcdab89, 0x98badcfe, 0x10325476};
+    const auto bytes = static_cast<const std::uint8_t*>(data);
+
+    auto done = std::size_t{0};
+    for (; size - done >= 64; done += 64)
+        md4_block(state, bytes + done);
+
+    // What is left, the 0x80 that ends the message and its length in bits, in one or two more blocks
+    std::array<std::uint8_t, 128> tail{};
+    const auto left = size - done;
+    std::copy(bytes + done, bytes + size, tail.begin());
+    tail[left] = 0x80;
+    const auto tail_size = left < 56 ? 64 : 128;
+    for (auto i = 0; i < 8; ++i)
+        tail[tail_size - 8 + i] = static_cast<std::uint8_t>((std::uint64_t{size} * 8) >> (8 * i));
+    for (auto offset = 0; offset < tail_size; offset += 64)
+        md4_block(state, tail.data() + offset);
+
+    std::array<std::uint8_t, 16> digest;
+    for (auto i = 0; i < 16; ++i)
+        digest[i] = static_cast<std::uint8_t>(state[i / 4] >> (8 * (i % 4)));
+
+    return digest;
+}
+
+mpcs::Sha256::Sha256() : context{EVP_MD_CTX_new(), EVP_MD_CTX_free}
+{
+    if (!context)
+        throw std::bad_alloc{};
+
+    reset();
+}
+
+mpcs::Sha256::~Sha256() = default;
+
+void mpcs::Sha256::add_data(const void* data, std::size_t size)
+{
+    if (!EVP_DigestUpdate(context.get(), data, size))
+        throw std::runtime_error("Cannot compute SHA-256");
+}
+
+void mpcs::Sha256::reset()
+{
+    if (!EVP_DigestInit_ex(context.get(), EVP_sha256(), nullptr))
+        throw std::runtime_error("Cannot initialize SHA-256");
+}
+
+std::string mpcs::Sha256::hex_digest() const
+{
+    // Finished on a copy, so that this one can keep going
+    std::unique_ptr<EVP_MD_CTX, decltype(&EVP_MD_CTX_free)> finished{EVP_MD_CTX_new(), EVP_MD_CTX_free};
+    unsigned char digest[EVP_MAX_MD_SIZE];
+    unsigned int digest_size{0};
+    if (!finished || !EVP_MD_CTX_copy_ex(finished.get(), context.get()) ||
+        !EVP_DigestFinal_ex(finished.get(), digest, &digest_size))
+        throw std::runtime_error("Cannot compute SHA-256");
+
+    constexpr auto hex_digits = "0123456789abcdef";
+    std::string hex;
+    hex.reserve(2 * digest_size);
+    for (unsigned int i = 0; i < digest_size; ++i)
+    {
+        hex += hex_digits[digest[i] >> 4];
+        hex += hex_digits[digest[i] & 0xf];
+    }
+
+    return hex;
+}
@@ -0,0 +1,411 @@
+/*
+ * Copyright (C) Canonical, Ltd.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; version 3.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#include "dir_walker.h"
+
+#include <cerrno>
+#include <string_view>
+#include <utility>
+
+#include <dirent.h>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+namespace mp = multipass;
+namespace fs = mp::fs;
+
+namespace
+{
+constexpr auto buffer_size = 32 * 1024; // as much as the kernel lists at once
+
+fs::file_type type_from_dirent(unsigned char type)
+{
+    switch (type)
+    {
+    case DT_REG:
+        return fs::file_type::regular;
+    case DT_DIR:
+        return fs::file_type::directory;
+    case DT_LNK:
+        return fs::file_type::symlink;
+    case DT_BLK:
+        return fs::file_type::block;
+    case DT_CHR:
+        return fs::file_type::character;
+    case DT_FIFO:
+        return fs::file_type::fifo;
+    case DT_SOCK:
+        return fs::file_type::socket;
+    default:
+        return fs::file_type::unknown;
+    }
+}
+
+fs::file_type type_from_mode(mode_t mode)
+{
+    switch (mode & S_IFMT)
+    {
+    case S_IFREG:
+        return fs::file_type::regular;
+    case S_IFDIR:
+        return fs::file_type::directory;
+    case S_IFLNK:
+        return fs::file_type::symlink;
+    case S_IFBLK:
+        return fs::file_type::block;
+    case S_IFCHR:
+        return fs::file_type::character;
+    case S_IFIFO:
+        return fs::file_type::fifo;
+    case S_IFSOCK:
+        return fs::file_type::socket;
+    default:
+        return fs::file_type::unknown;
+    }
+}
+
+fs::perms perms_from_mode(mode_t mode)
+{
+    return static_cast<fs::perms>(mode) & fs::perms::mask;
+}
+
+std::error_code last_error()
+{
+    return {errno, std::system_category()};
+}
+} // namespace
+
+mp::WalkedEntry::WalkedEntry(fs::path path, fs::file_status symlink_status)
+    : entry_path{std::move(path)}, known_status{symlink_status}
+{
+}
+
+void mp::WalkedEntry::assign(const fs::path& path)
+{
+    entry_path = path;
+    refresh();
+}
+
+void mp::WalkedEntry::assign(const fs::path& path, std::error_code& err)
+{
+    entry_path = path;
+    refresh(err);
+}
+
+void mp::WalkedEntry::replace_filename(const fs::path& path)
+{
+    entry_path.replace_filename(path);
+    refresh();
+}
+
+void mp::WalkedEntry::replace_filename(const fs::path& path, std::error_code& err)
+{
+    entry_path.replace_filename(path);
+    refresh(err);
+}
+
+void mp::WalkedEntry::refresh()
+{
+    known_status = fs::symlink_status(entry_path);
+}
+
+void mp::WalkedEntry::refresh(std::error_code& err) noexcept
+{
+    known_status = fs::symlink_status(entry_path, err);
+}
+
+const fs::path& mp::WalkedEntry::path() const noexcept
+{
+    return entry_path;
+}
+
+bool mp::WalkedEntry::exists() const
+{
+    return fs::exists(followed());
+}
+
+bool mp::WalkedEntry::exists(std::error_code& err) const noexcept
+{
+    return fs::exists(followed(err));
+}
+
+bool mp::WalkedEntry::is_block_file() const
+{
+    return fs::is_block_file(followed());
+}
+
+bool mp::WalkedEntry::is_block_file(std::error_code& err) const noexcept
+{
+    return fs::is_block_file(followed(err));
+}
+
+bool mp::WalkedEntry::is_character_file() const
+{
+    return fs::is_character_file(followed());
+}
+
+bool mp::WalkedEntry::is_character_file(std::error_code& err) const noexcept
+{
+    return fs::is_character_file(followed(err));
+}
+
+bool mp::WalkedEntry::is_directory() const
+{
+    return fs::is_directory(followed());
+}
+
+bool mp::WalkedEntry::is_directory(std::error_code& err) const noexcept
+{
+    return fs::is_directory(followed(err));
+}
+
+bool mp::WalkedEntry::is_fifo() const
+{
+    return fs::is_fifo(followed());
+}
+
+bool mp::WalkedEntry::is_fifo(std::error_code& err) const noexcept
+{
+    return fs::is_fifo(followed(err));
+}
+
+bool mp::WalkedEntry::is_other() const
+{
+    return fs::is_other(followed());
+}
+
+bool mp::WalkedEntry::is_other(std::error_code& err) const noexcept
+{
+    return fs::is_other(followed(err));
+}
+
+bool mp::WalkedEntry::is_regular_file() const
+{
+    return fs::is_regular_file(followed());
+}
+
+bool mp::WalkedEntry::is_regular_file(std::error_code& err) const noexcept
+{
+    return fs::is_regular_file(followed(err));
+}
+
+bool mp::WalkedEntry::is_socket() const
+{
+    return fs::is_socket(followed());
+}
+
+bool mp::WalkedEntry::is_socket(std::error_code& err) const noexcept
+{
+    return fs::is_socket(followed(err));
+}
+
+bool mp::WalkedEntry::is_symlink() const
+{
+    return fs::is_symlink(known_status);
+}
+
+bool mp::WalkedEntry::is_symlink(std::error_code& err) const noexcept
+{
+    err.clear();
+    return fs::is_symlink(known_status);
+}
+
+uintmax_t mp::WalkedEntry::file_size() const
+{
+    return fs::file_size(entry_path);
+}
+
+uintmax_t mp::WalkedEntry::file_size(std::error_code& err) const noexcept
+{
+    return fs::file_size(entry_path, err);
+}
+
+uintmax_t mp::WalkedEntry::hard_link_count() const
+{
+    return fs::hard_link_count(entry_path);
+}
+
+uintmax_t mp::WalkedEntry::hard_link_count(std::error_code& err) const noexcept
+{
+    return fs::hard_link_count(entry_path, err);
+}
+
+fs::file_time_type mp::WalkedEntry::last_write_time() const
+{
+    return fs::last_write_time(entry_path);
+}
+
+fs::file_time_type mp::WalkedEntry::last_write_time(std::error_code& err) const noexcept
+{
+    return fs::last_write_time(entry_path, err);
+}
+
+fs::file_status mp::WalkedEntry::status() const
+{
+    return !is_symlink() && known_status.permissions() != fs::perms::unknown ? known_status : fs::status(entry_path);
+}
+
+fs::file_status mp::WalkedEntry::status(std::error_code& err) const noexcept
+{
+    if (!is_symlink() && known_status.permissions() != fs::perms::unknown)
+    {
+        err.clear();
+        return known_status;
+    }
+
+    return fs::status(entry_path, err);
+}
+
+fs::file_status mp::WalkedEntry::symlink_status() const
+{
+    return known_status;
+}
+
+fs::file_status mp::WalkedEntry::symlink_status(std::error_code& err) const noexcept
+{
+    err.clear();
+    return known_status;
+}
+
+bool mp::WalkedEntry::operator==(const DirectoryEntry& rhs) const noexcept
+{
+    return entry_path == rhs.path();
+}
+
+fs::file_status mp::WalkedEntry::followed() const
+{
+    return is_symlink() ? fs::status(entry_path) : known_status;
+}
+
+fs::file_status mp::WalkedEntry::followed(std::error_code& err) const noexcept
+{
+    if (is_symlink())
+        return fs::status(entry_path, err);
+
+    err.clear();
+    return known_status;
+}
+
+mp::DirWalker::DirWalker(const fs::path& path, std::error_code& err)
+{
+    err.clear();
+
+    // The top one is followed if it's a link, like std::filesystem does
+    const auto fd = ::open(path.c_str(), O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+    if (fd < 0)
+    {
+        err = last_error();
+        return;
+    }
+
+    dirs.push_back({fd, path, std::vector<char>(buffer_size)});
+}
+
+mp::DirWalker::~DirWalker()
+{
+    for (const auto& dir : dirs)
+        ::close(dir.fd);
+}
+
+bool mp::DirWalker::hasNext()
+{
+    return pending || read_next();
+}
+
+const mp::DirectoryEntry& mp::DirWalker::next()
+{
+    if (!hasNext())
+        throw fs::filesystem_error{"no more entries", std::make_error_code(std::errc::no_such_file_or_directory)};
+
+    current = std::move(*pending);
+    pending.reset();
+    return current;
+}
+
+bool mp::DirWalker::read_next()
+{
+    while (!dirs.empty())
+    {
+        auto& dir = dirs.back();
+        if (dir.offset >= dir.filled)
+        {
+            const auto read = ::syscall(SYS_getdents64, dir.fd, dir.buffer.data(), dir.buffer.size());
+            if (read < 0)
+                throw fs::filesystem_error{"cannot read directory", dir.path, last_error()};
+
+            if (read == 0)
+            {
+                ::close(dir.fd);
+                dirs.pop_back();
+                continue;
+            }
+
+            dir.filled = read;
+            dir.offset = 0;
+        }
+
+        const auto* entry = reinterpret_cast<const struct dirent64*>(dir.buffer.data() + dir.offset);
+        dir.offset += entry->d_reclen;
+
+        if (const std::string_view name{entry->d_name}; name == "." || name == "..")
+            continue;
+
+        auto type = type_from_dirent(entry->d_type);
+        auto perms = fs::perms::unknown;
+        if (type == fs::file_type::unknown)
+        {
+            struct statx attributes;
+            if (::statx(dir.fd, entry->d_name, AT_SYMLINK_NOFOLLOW, STATX_TYPE | STATX_MODE, &attributes) < 0)
+            {
+                if (errno == ENOENT)
+                    continue;
+                throw fs::filesystem_error{"cannot get the type of", dir.path / entry->d_name, last_error()};
+            }
+
+            type = type_from_mode(attributes.stx_mode);
+            perms = perms_from_mode(attributes.stx_mode);
+        }
+
+        auto path = dir.path / entry->d_name;
+        if (type == fs::file_type::directory)
+        {
+            // Opened right away to be walked next, which also tells its permissions without another lookup by path
+            const auto fd = ::openat(dir.fd, entry->d_name, O_RDONLY | O_DIRECTORY | O_NOFOLLOW | O_CLOEXEC);
+            if (fd < 0)
+            {
+                if (errno == ENOENT)
+                    continue;
+                throw fs::filesystem_error{"cannot open directory", path, last_error()};
+            }
+
+            struct stat attributes;
+            if (::fstat(fd, &attributes) == 0)
+                perms = perms_from_mode(attributes.st_mode);
+
+            pending.emplace(path, fs::file_status{type, perms});
+            dirs.push_back({fd, std::move(path), std::vector<char>(buffer_size)}); // `dir` is not to be used after this
+            return true;
+        }
+
+        pending.emplace(std::move(path), fs::file_status{type, perms});
+        return true;
+    }
+
+    return false;
+}
@@ -0,0 +1,114 @@
+/*
+ * Copyright (C) Canonical, Ltd.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; version 3.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#ifndef MULTIPASS_DIR_WALKER_H
+#define MULTIPASS_DIR_WALKER_H
+
+#include <multipass/disabled_copy_move.h>
+#include <multipass/recursive_dir_iterator.h>
+
+#include <optional>
+#include <vector>
+
+namespace multipass
+{
+// An entry as the directory listing had it. Its type is always known, and so are its permissions if it is a
+// directory, which the walker opens anyway; symlink_status() gives fs::perms::unknown for anything else. Whatever the
+// listing did not say is looked up when asked for
+class WalkedEntry : public DirectoryEntry
+{
+public:
+    WalkedEntry() = default;
+    WalkedEntry(fs::path path, fs::file_status symlink_status);
+
+    void assign(const fs::path& path) override;
+    void assign(const fs::path& path, std::error_code& err) override;
+    void replace_filename(const fs::path& path) override;
+    void replace_filename(const fs::path& path, std::error_code& err) override;
+    void refresh() override;
+    void refresh(std::error_code& err) noexcept override;
+    const fs::path& path() const noexcept override;
+    bool exists() const override;
+    bool exists(std::error_code& err) const noexcept override;
+    bool is_block_file() const override;
+    bool is_block_file(std::error_code& err) const noexcept override;
+    bool is_character_file() const override;
+    bool is_character_file(std::error_code& err) const noexcept override;
+    bool is_directory() const override;
+    bool is_directory(std::error_code& err) const noexcept override;
+    bool is_fifo() const override;
+    bool is_fifo(std::error_code& err) const noexcept override;
+    bool is_other() const override;
+    bool is_other(std::error_code& err) const noexcept override;
+    bool is_regular_file() const override;
+    bool is_regular_file(std::error_code& err) const noexcept override;
+    bool is_socket() const override;
+    bool is_socket(std::error_code& err) const noexcept override;
+    bool is_symlink() const override;
+    bool is_symlink(std::error_code& err) const noexcept override;
+    uintmax_t file_size() const override;
+    uintmax_t file_size(std::error_code& err) const noexcept override;
+    uintmax_t hard_link_count() const override;
+    uintmax_t hard_link_count(std::error_code& err) const noexcept override;
+    fs::file_time_type last_write_time() const override;
+    fs::file_time_type last_write_time(std::error_code& err) const noexcept override;
+    fs::file_status status() const override;
+    fs::file_status status(std::error_code& err) const noexcept override;
+    fs::file_status symlink_status() const override;
+    fs::file_status symlink_status(std::error_code& err) const noexcept override;
+    bool operator==(const DirectoryEntry& rhs) const noexcept override;
+
+private:
+    fs::file_status followed() const; // what symlinks point to, the entry itself otherwise
+    fs::file_status followed(std::error_code& err) const noexcept;
+
+    fs::path entry_path;
+    fs::file_status known_status;
+};
+
+// Walks a tree depth first, without following symlinks, like std::filesystem::recursive_directory_iterator does.
+// Directories are read with getdents64() on descriptors opened relative to their parents, and entries take their types
+// from the listing; only filesystems that leave them out cost a statx() per entry. Errors along the way are thrown as
+// fs::filesystem_error, entries that go away while the walk is on are skipped
+class DirWalker : public RecursiveDirIterator, private DisabledCopyMove
+{
+public:
+    DirWalker(const fs::path& path, std::error_code& err);
+    ~DirWalker() override;
+
+    bool hasNext() override;
+    const DirectoryEntry& next() override;
+
+private:
+    struct OpenDir
+    {
+        int fd;
+        fs::path path;
+        std::vector<char> buffer;
+        long filled{0};
+        long offset{0};
+    };
+
+    bool read_next(); // into pending, false at the end of the walk
+
+    std::vector<OpenDir> dirs; // from the top down to the one being read
+    std::optional<WalkedEntry> pending;
+    WalkedEntry current;
+};
+} // namespace multipass
+
+#endif // MULTIPASS_DIR_WALKER_H
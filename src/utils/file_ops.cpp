@@ -17,6 +17,14 @@
 
 #include <multipass/file_ops.h>
 
+#ifdef MULTIPASS_PLATFORM_LINUX
+#include "dir_walker.h"
+#endif
+
+#include <cerrno>
+
+#include <unistd.h>
+
 namespace mp = multipass;
 namespace fs = mp::fs;
 
@@ -84,6 +92,27 @@ qint64 mp::FileOps::read(QFile& file, char* data, qint64 maxSize) const
     return file.read(data, maxSize);
 }
 
+qint64 mp::FileOps::read_at(QFile& file, char* data, qint64 maxSize, qint64 pos) const
+{
+    qint64 total = 0;
+    while (total < maxSize)
+    {
+        const auto r = ::pread(file.handle(), data + total, maxSize - total, pos + total);
+        if (r < 0)
+        {
+            if (errno == EINTR)
+                continue;
+            return total > 0 ? total : -1;
+        }
+        if (r == 0) // end of file
+            break;
+
+        total += r;
+    }
+
+    return total;
+}
+
 QByteArray mp::FileOps::read_all(QFile& file) const
 {
     return file.readAll();
@@ -199,8 +228,27 @@ fs::file_status mp::FileOps::status(const fs::path& path, std::error_code& err)
     return fs::status(path, err);
 }
 
+std::uintmax_t mp::FileOps::file_size(const fs::path& path, std::error_code& err) const
+{
+    return fs::file_size(path, err);
+}
+
+fs::file_time_type mp::FileOps::last_write_time(const fs::path& path, std::error_code& err) const
+{
+    return fs::last_write_time(path, err);
+}
+
+void mp::FileOps::last_write_time(const fs::path& path, fs::file_time_type new_time, std::error_code& err) const
+{
+    fs::last_write_time(path, new_time, err);
+}
+
 std::unique_ptr<mp::RecursiveDirIterator> mp::FileOps::recursive_dir_iterator(const fs::path& path,
                                                                               std::error_code& err) const
 {
+#ifdef MULTIPASS_PLATFORM_LINUX
+    return std::make_unique<mp::DirWalker>(path, err);
+#else
     return std::make_unique<mp::RecursiveDirIterator>(path, err);
+#endif
 }
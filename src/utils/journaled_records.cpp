@@ -0,0 +1,147 @@
+/*
+ * Copyright (C) Canonical, Ltd.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; version 3.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#include <multipass/journaled_records.h>
+
+#include <multipass/checksum.h>
+#include <multipass/format.h>
+#include <multipass/logging/log.h>
+
+#include <QFile>
+#include <QJsonDocument>
+#include <QSaveFile>
+
+#include <algorithm>
+
+namespace mp = multipass;
+namespace mpl = multipass::logging;
+
+namespace
+{
+constexpr auto category = "records";
+
+QString journal_path_for(const QString& db_path)
+{
+    auto journal_path = db_path;
+    if (journal_path.endsWith(".json"))
+        journal_path.chop(5);
+
+    return journal_path + ".journal";
+}
+
+std::string hash_of(const QByteArray& contents)
+{
+    mp::checksum::Sha256 hash;
+    hash.add_data(contents.constData(), contents.size());
+    return hash.hex_digest();
+}
+
+QByteArray line_of(const QJsonObject& json)
+{
+    return QJsonDocument{json}.toJson(QJsonDocument::Compact) + '\n';
+}
+} // namespace
+
+mp::JournaledRecords::JournaledRecords(QString db_path, std::size_t min_entries_to_compact)
+    : db_path{std::move(db_path)},
+      journal_path{journal_path_for(this->db_path)},
+      min_entries_to_compact{min_entries_to_compact}
+{
+}
+
+// The journal holds a compact JSON object per line. The first line names the database it goes on top of, so that one
+// left behind by an interrupted compaction is not replayed over a newer database. A line cut short by a crash is where
+// the journal ends
+QJsonObject mp::JournaledRecords::read(const QString& db_path)
+{
+    QFile db_file{db_path};
+    if (!db_file.open(QIODevice::ReadOnly))
+        return {};
+
+    const auto db_contents = db_file.readAll();
+    const auto doc = QJsonDocument::fromJson(db_contents);
+    if (!doc.isObject())
+        return {};
+
+    auto records = doc.object();
+
+    QFile journal{journal_path_for(db_path)};
+    if (!journal.open(QIODevice::ReadOnly) ||
+        QJsonDocument::fromJson(journal.readLine())["base"].toString().toStdString() != hash_of(db_contents))
+        return records;
+
+    while (!journal.atEnd())
+    {
+        const auto line = journal.readLine();
+        const auto entry = QJsonDocument::fromJson(line).object();
+        if (!line.endsWith('\n') || entry.isEmpty())
+            break;
+
+        for (auto it = entry.constBegin(); it != entry.constEnd(); ++it)
+            if (it.value().isNull())
+                records.remove(it.key());
+            else
+                records[it.key()] = it.value();
+    }
+
+    return records;
+}
+
+void mp::JournaledRecords::write(const QJsonObject& records)
+{
+    // Written aside and moved into place, so that a crash leaves either the previous database or this one
+    const auto contents = QJsonDocument{records}.toJson();
+    QSaveFile db_file{db_path};
+    if (!db_file.open(QIODevice::WriteOnly) || db_file.write(contents) != contents.size() || !db_file.commit())
+    {
+        mpl::log(mpl::Level::error, category, fmt::format("Cannot write {}: {}", db_path, db_file.errorString()));
+        return;
+    }
+
+    // Everything in the journal is in the database now
+    db_hash = hash_of(contents);
+    db_records = static_cast<std::size_t>(records.size());
+    journal_entries = 0;
+    QFile::remove(journal_path);
+}
+
+void mp::JournaledRecords::update(const QString& key, const QJsonValue& record,
+                                  const std::function<QJsonObject()>& all_records)
+{
+    // Compacted once the journal holds about as much as a database rewrite would write
+    if (db_hash.empty() || journal_entries >= std::max(min_entries_to_compact, 2 * db_records))
+        return write(all_records());
+
+    QFile journal{journal_path};
+    auto opened = journal.open(QIODevice::WriteOnly | (journal_entries ? QIODevice::Append : QIODevice::Truncate));
+    if (opened && !journal_entries)
+    {
+        const auto header = line_of({{"base", QString::fromStdString(db_hash)}});
+        opened = journal.write(header) == header.size();
+    }
+
+    const auto entry = line_of({{key, record.isUndefined() ? QJsonValue{} : record}});
+    if (!opened || journal.write(entry) != entry.size() || !journal.flush())
+    {
+        mpl::log(mpl::Level::warning, category,
+                 fmt::format("Cannot append to {}, writing the whole database instead: {}", journal_path,
+                             journal.errorString()));
+        return write(all_records());
+    }
+
+    ++journal_entries;
+}
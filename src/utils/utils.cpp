@@ -24,6 +24,7 @@
 #include <multipass/file_ops.h>
 #include <multipass/format.h>
 #include <multipass/logging/log.h>
+#include <multipass/logging/tracer.h>
 #include <multipass/platform.h>
 #include <multipass/ssh/ssh_session.h>
 #include <multipass/standard_paths.h>
@@ -40,9 +41,13 @@
 
 #include <algorithm>
 #include <array>
+#include <atomic>
 #include <cassert>
 #include <cctype>
+#include <exception>
 #include <fstream>
+#include <mutex>
+#include <optional>
 #include <random>
 #include <regex>
 #include <sstream>
@@ -86,6 +91,58 @@ mp::utils::TimeoutAction log_and_retry(const ExceptionT& e, const mp::VirtualMac
     mpl::log(log_level, vm->vm_name, e.what());
     return mp::utils::TimeoutAction::retry;
 };
+
+bool guest_ready(mp::VirtualMachine* vm)
+{
+    std::lock_guard<decltype(vm->state_mutex)> lock{vm->state_mutex};
+    return vm->guest_ready;
+}
+
+// Like try_action_for, but the pause between attempts is cut short by the backend hearing from the guest, so that
+// polling is only what is left for guests and backends that cannot tell
+template <typename OnTimeoutCallable, typename TryAction>
+void try_action_until_guest_ready(mp::VirtualMachine* vm, OnTimeoutCallable&& on_timeout,
+                                  std::chrono::milliseconds timeout, TryAction&& try_action)
+{
+    auto deadline = std::chrono::steady_clock::now() + timeout;
+    while (std::chrono::steady_clock::now() < deadline)
+    {
+        if (try_action() == mp::utils::TimeoutAction::done)
+            return;
+
+        std::unique_lock<decltype(vm->state_mutex)> lock{vm->state_mutex};
+        vm->state_wait.wait_for(lock, timeout < 1s ? timeout : 1s, [vm] { return vm->guest_ready; });
+    }
+    on_timeout();
+}
+
+bool all_of(std::string_view text, bool (*is_allowed)(char))
+{
+    return !text.empty() && std::all_of(text.cbegin(), text.cend(), is_allowed);
+}
+
+// `ip -brief` lists the addresses of an interface after its name and state, each with its prefix length; the one
+// taken is the last on the line, which a route metric can follow
+std::optional<std::string_view> last_ipv4_of(std::string_view line)
+{
+    std::array<std::string_view, 3> last_tokens{}; // the latest first
+    for (const auto token : mp::utils::tokens_of(line))
+        last_tokens = {token, last_tokens[0], last_tokens[1]};
+
+    const auto is_digit = [](char c) { return c >= '0' && c <= '9'; };
+    const auto has_metric = last_tokens[1] == "metric" && all_of(last_tokens[0], is_digit);
+    const auto address = has_metric ? last_tokens[2] : last_tokens[0];
+
+    const auto slash = address.find('/');
+    if (slash == std::string_view::npos || !all_of(address.substr(slash + 1), is_digit))
+        return std::nullopt;
+
+    const auto ip = address.substr(0, slash);
+    if (!all_of(ip, [](char c) { return c == '.' || (c >= '0' && c <= '9'); }))
+        return std::nullopt;
+
+    return ip;
+}
 } // namespace
 
 mp::Utils::Utils(const Singleton<Utils>::PrivatePass& pass) noexcept : Singleton<Utils>::Singleton{pass}
@@ -148,8 +205,12 @@ void mp::Utils::make_file_with_content(const std::string& file_name, const std::
 void mp::Utils::wait_for_cloud_init(mp::VirtualMachine* virtual_machine, std::chrono::milliseconds timeout,
                                     const mp::SSHKeyProvider& key_provider) const
 {
+    mpl::TraceSpan span{"wait_for_cloud_init", virtual_machine->vm_name};
     auto action = [virtual_machine, &key_provider] {
         virtual_machine->ensure_vm_is_running();
+        if (guest_ready(virtual_machine)) // what tells the host is only run once cloud-init is done
+            return mp::utils::TimeoutAction::done;
+
         try
         {
             mp::SSHSession session{virtual_machine->ssh_hostname(), virtual_machine->ssh_port(),
@@ -167,7 +228,7 @@ void mp::Utils::wait_for_cloud_init(mp::VirtualMachine* virtual_machine, std::ch
         }
     };
     auto on_timeout = [] { throw std::runtime_error("timed out waiting for initialization to complete"); };
-    mp::utils::try_action_for(on_timeout, timeout, action);
+    try_action_until_guest_ready(virtual_machine, on_timeout, timeout, action);
 }
 
 std::string mp::Utils::get_kernel_version() const
@@ -300,6 +361,16 @@ std::vector<std::string> mp::utils::split(const std::string& string, const std::
     return {std::sregex_token_iterator{string.begin(), string.end(), regex, -1}, std::sregex_token_iterator{}};
 }
 
+mp::utils::SplitView mp::utils::lines_of(std::string_view text)
+{
+    return {text, "\n", /*keep_empty=*/true};
+}
+
+mp::utils::SplitView mp::utils::tokens_of(std::string_view text, std::string_view delimiters)
+{
+    return {text, delimiters, /*keep_empty=*/false};
+}
+
 std::string mp::utils::generate_mac_address()
 {
     std::default_random_engine gen;
@@ -324,13 +395,18 @@ void mp::utils::wait_until_ssh_up(VirtualMachine* virtual_machine, std::chrono::
                                   std::function<void()> const& ensure_vm_is_running)
 {
     static constexpr auto wait_step = 1s;
+    mpl::TraceSpan span{"wait_until_ssh_up", virtual_machine->vm_name};
     mpl::log(mpl::Level::debug, virtual_machine->vm_name, "Waiting for SSH to be up");
 
     auto action = [virtual_machine, &ensure_vm_is_running] {
         ensure_vm_is_running();
         try
         {
-            mp::SSHSession session{virtual_machine->ssh_hostname(wait_step), virtual_machine->ssh_port()};
+            // The guest only tells once SSH is up, so there is no need to try it then
+            if (!guest_ready(virtual_machine))
+            {
+                mp::SSHSession session{virtual_machine->ssh_hostname(wait_step), virtual_machine->ssh_port()};
+            }
 
             std::lock_guard<decltype(virtual_machine->state_mutex)> lock{virtual_machine->state_mutex};
             virtual_machine->state = VirtualMachine::State::running;
@@ -362,7 +438,7 @@ void mp::utils::wait_until_ssh_up(VirtualMachine* virtual_machine, std::chrono::
         throw std::runtime_error(fmt::format("{}: timed out waiting for response", virtual_machine->vm_name));
     };
 
-    mp::utils::try_action_for(on_timeout, timeout, action);
+    try_action_until_guest_ready(virtual_machine, on_timeout, timeout, action);
 }
 
 // Executes a given command on the given session. Returns the output of the command, with spaces and feeds trimmed.
@@ -382,6 +458,18 @@ std::string mp::utils::run_in_ssh_session(mp::SSHSession& session, const std::st
     return mp::utils::trim_end(output);
 }
 
+std::vector<std::string> mp::utils::ipv4_addresses_in(mp::SSHSession& session)
+{
+    const auto output = run_in_ssh_session(session, "ip -brief -family inet address show scope global");
+
+    std::vector<std::string> addresses;
+    for (const auto line : lines_of(output))
+        if (const auto ip = last_ipv4_of(line))
+            addresses.emplace_back(*ip);
+
+    return addresses;
+}
+
 void mp::utils::link_autostart_file(const QDir& link_dir, const QString& autostart_subdir,
                                     const QString& autostart_filename)
 {
@@ -522,6 +610,19 @@ void mp::utils::validate_server_address(const std::string& address)
         throw std::runtime_error(fmt::format("invalid port number in address '{}'", address));
 }
 
+// The socket next to the daemon's own, where clients with a session connect with no TLS
+std::string mp::utils::local_server_address(const std::string& server_address)
+{
+    return server_address.find("unix:") == 0 ? server_address + "-local" : std::string{};
+}
+
+std::string mp::utils::completion_cache_path(const std::string& server_address)
+{
+    constexpr std::string_view unix_scheme{"unix:"};
+    return server_address.find(unix_scheme) == 0 ? server_address.substr(unix_scheme.size()) + "-completion"
+                                                 : std::string{};
+}
+
 std::string mp::utils::filename_for(const std::string& path)
 {
     return QFileInfo(QString::fromStdString(path)).fileName().toStdString();
@@ -534,16 +635,9 @@ bool mp::utils::is_dir(const std::string& path)
 
 std::string mp::utils::match_line_for(const std::string& output, const std::string& matcher)
 {
-    std::istringstream ss{output};
-    std::string line;
-
-    while (std::getline(ss, line, '\n'))
-    {
-        if (line.find(matcher) != std::string::npos)
-        {
-            return line;
-        }
-    }
+    for (const auto line : lines_of(output))
+        if (line.find(matcher) != std::string_view::npos)
+            return std::string{line};
 
     return std::string{};
 }
@@ -553,6 +647,39 @@ bool mp::utils::is_running(const VirtualMachine::State& state)
     return state == VirtualMachine::State::running || state == VirtualMachine::State::delayed_shutdown;
 }
 
+void mp::utils::run_concurrently(const std::vector<std::function<void()>>& tasks, std::size_t max_workers)
+{
+    std::atomic_size_t next{0};
+    std::mutex failure_mutex;
+    std::exception_ptr failure;
+    auto work = [&tasks, &next, &failure_mutex, &failure] {
+        for (auto i = next++; i < tasks.size(); i = next++)
+        {
+            try
+            {
+                tasks[i]();
+            }
+            catch (...)
+            {
+                std::lock_guard<std::mutex> lock{failure_mutex};
+                if (!failure)
+                    failure = std::current_exception();
+            }
+        }
+    };
+
+    std::vector<std::thread> workers;
+    for (auto count = std::min(max_workers, tasks.size()); count > 1; --count)
+        workers.emplace_back(work);
+
+    work();
+    for (auto& worker : workers)
+        worker.join();
+
+    if (failure)
+        std::rethrow_exception(failure);
+}
+
 void mp::utils::check_and_create_config_file(const QString& config_file_path)
 {
     QFile config_file{config_file_path};
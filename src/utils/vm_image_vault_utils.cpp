@@ -15,18 +15,44 @@
  *
  */
 
+#include <multipass/checksum.h>
 #include <multipass/format.h>
+#include <multipass/image_decoder.h>
+#include <multipass/json_utils.h>
+#include <multipass/platform.h>
+#include <multipass/sparse_file.h>
 #include <multipass/vm_image_host.h>
 #include <multipass/vm_image_vault.h>
-#include <multipass/xz_image_decoder.h>
 
-#include <QCryptographicHash>
+#include <QDateTime>
 #include <QFileInfo>
+#include <QJsonDocument>
 
+#include <algorithm>
+#include <cctype>
+#include <filesystem>
 #include <stdexcept>
+#include <system_error>
+#include <vector>
+
+#include <sys/stat.h>
 
 namespace mp = multipass;
 
+namespace
+{
+constexpr auto copy_buffer_size = 1 << 20;
+constexpr auto hash_buffer_size = 1 << 20;
+constexpr auto max_cached_hashes = 256;
+
+// Blob names come from image manifests, anything but a hash could point anywhere
+bool is_sha256(const std::string& hash)
+{
+    return hash.size() == 64 &&
+           std::all_of(hash.cbegin(), hash.cend(), [](unsigned char c) { return std::isxdigit(c); });
+}
+} // namespace
+
 QString mp::vault::filename_for(const mp::Path& path)
 {
     QFileInfo file_info(path);
@@ -44,7 +70,32 @@ QString mp::vault::copy(const QString& file_name, const QDir& output_dir)
     QFileInfo info{file_name};
     const auto source_name = info.fileName();
     auto new_path = output_dir.filePath(source_name);
-    QFile::copy(file_name, new_path);
+
+    // Like QFile::copy(), leave be what is already there, but keep the holes of sparse images
+    QFile source{file_name}, destination{new_path};
+    if (destination.exists() ||
+        MP_PLATFORM.clone_file(QFile::encodeName(file_name).constData(), QFile::encodeName(new_path).constData()))
+        return new_path;
+
+    if (!source.open(QIODevice::ReadOnly) || !destination.open(QIODevice::WriteOnly | QIODevice::NewOnly))
+        throw std::runtime_error(fmt::format("Cannot copy {} to {}", file_name, new_path));
+
+    std::vector<char> buffer(copy_buffer_size);
+    for (qint64 num_read; (num_read = source.read(buffer.data(), buffer.size())) != 0;)
+    {
+        if (num_read < 0 || !mp::sparse::write(destination, buffer.data(), num_read))
+        {
+            destination.remove();
+            throw std::runtime_error(fmt::format("Cannot copy {} to {}", file_name, new_path));
+        }
+    }
+
+    if (!mp::sparse::end(destination) || !destination.setPermissions(source.permissions()))
+    {
+        destination.remove();
+        throw std::runtime_error(fmt::format("Cannot copy {} to {}", file_name, new_path));
+    }
+
     return new_path;
 }
 
@@ -62,13 +113,20 @@ QString mp::vault::compute_image_hash(const mp::Path& image_path)
         throw std::runtime_error("Cannot open image file for computing hash");
     }
 
-    QCryptographicHash hash(QCryptographicHash::Sha256);
-    if (!hash.addData(&image_file))
+    // Large reads keep the SHA extensions busy
+    mp::checksum::Sha256 hash;
+    std::vector<char> buffer(hash_buffer_size);
+    for (qint64 num_read; (num_read = image_file.read(buffer.data(), buffer.size())) != 0;)
     {
-        throw std::runtime_error("Cannot read image file to compute hash");
+        if (num_read < 0)
+        {
+            throw std::runtime_error("Cannot read image file to compute hash");
+        }
+
+        hash.add_data(buffer.data(), num_read);
     }
 
-    return hash.result().toHex();
+    return QString::fromStdString(hash.hex_digest());
 }
 
 void mp::vault::verify_image_download(const mp::Path& image_path, const QString& image_hash)
@@ -83,18 +141,122 @@ void mp::vault::verify_image_download(const mp::Path& image_path, const QString&
 
 QString mp::vault::extract_image(const mp::Path& image_path, const mp::ProgressMonitor& monitor, const bool delete_file)
 {
-    mp::XzImageDecoder xz_decoder(image_path);
-    QString new_image_path{image_path};
-
-    new_image_path.remove(".xz");
+    const auto new_image_path = mp::decoding::decoded_path_for(image_path);
 
-    xz_decoder.decode_to(new_image_path, monitor);
+    mp::decoding::make_decoder(image_path)->decode_to(new_image_path, monitor);
 
     mp::vault::delete_file(image_path);
 
     return new_image_path;
 }
 
+mp::vault::ImageHashCache::ImageHashCache(const Path& cache_file) : cache_file{cache_file}
+{
+    QFile file{cache_file};
+    if (file.open(QIODevice::ReadOnly))
+        hashes = QJsonDocument::fromJson(file.readAll()).object();
+}
+
+QString mp::vault::ImageHashCache::hash_of(const Path& image_path)
+{
+    struct stat image_stat;
+    if (stat(QFile::encodeName(image_path).constData(), &image_stat) != 0)
+        return compute_image_hash(image_path);
+
+    const auto key = QString::fromStdString(
+        fmt::format("{}:{}:{}:{}.{}", image_stat.st_dev, image_stat.st_ino, image_stat.st_size,
+                    image_stat.st_mtim.tv_sec, image_stat.st_mtim.tv_nsec));
+    const auto now = QDateTime::currentSecsSinceEpoch();
+
+    {
+        std::lock_guard<std::mutex> lock{mutex};
+        if (auto entry = hashes.value(key).toObject(); !entry.isEmpty())
+        {
+            entry["used"] = now;
+            hashes[key] = entry;
+            persist();
+            return entry["hash"].toString();
+        }
+    }
+
+    // Hashing takes a while, other images need not wait for it
+    const auto hash = compute_image_hash(image_path);
+
+    std::lock_guard<std::mutex> lock{mutex};
+    hashes[key] = QJsonObject{{"hash", hash}, {"used", now}};
+
+    // Entries for files long gone are never looked up again, drop the least recently used ones
+    while (hashes.size() > max_cached_hashes)
+    {
+        auto oldest = hashes.begin();
+        for (auto it = hashes.begin(); it != hashes.end(); ++it)
+            if (it.value()["used"].toDouble() < oldest.value()["used"].toDouble())
+                oldest = it;
+        hashes.erase(oldest);
+    }
+
+    persist();
+    return hash;
+}
+
+void mp::vault::ImageHashCache::persist()
+{
+    mp::write_json(hashes, cache_file);
+}
+
+mp::vault::BlobStore::BlobStore(const Path& store_dir, const QStringList& peers) : store_dir{store_dir}, peers{peers}
+{
+}
+
+mp::Path mp::vault::BlobStore::path_for(const std::string& hash) const
+{
+    return is_sha256(hash) ? store_dir.filePath(QString::fromStdString(hash)) : Path{};
+}
+
+QStringList mp::vault::BlobStore::peer_urls_for(const std::string& hash) const
+{
+    QStringList urls;
+    if (is_sha256(hash))
+        for (const auto& peer : peers)
+            urls << QString{"%1images/%2"}.arg(peer, QString::fromStdString(hash));
+
+    return urls;
+}
+
+bool mp::vault::BlobStore::link(const std::string& hash, const Path& destination) const
+{
+    const auto blob = path_for(hash);
+    if (blob.isEmpty())
+        return false;
+
+    std::error_code err;
+    std::filesystem::create_hard_link(blob.toStdString(), destination.toStdString(), err);
+
+    // Hard links cannot cross file systems, a copy still saves the download
+    return !err || QFile::copy(blob, destination);
+}
+
+void mp::vault::BlobStore::add(const std::string& hash, const Path& image_path) const
+{
+    const auto blob = path_for(hash);
+    if (blob.isEmpty() || !store_dir.mkpath("."))
+        return;
+
+    // Whoever got there first has the same content, so failing is as good as succeeding
+    std::error_code err;
+    std::filesystem::create_hard_link(image_path.toStdString(), blob.toStdString(), err);
+}
+
+void mp::vault::BlobStore::prune() const
+{
+    for (const auto& blob : store_dir.entryInfoList(QDir::Files))
+    {
+        std::error_code err;
+        if (std::filesystem::hard_link_count(blob.absoluteFilePath().toStdString(), err) == 1)
+            QFile::remove(blob.absoluteFilePath());
+    }
+}
+
 std::unordered_map<std::string, mp::VMImageHost*>
 mp::vault::configure_image_host_map(const std::vector<mp::VMImageHost*>& image_hosts)
 {
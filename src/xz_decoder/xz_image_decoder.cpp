@@ -19,14 +19,26 @@
 
 #include <multipass/rpc/multipass.grpc.pb.h>
 
+#include <multipass/checksum.h>
 #include <multipass/format.h>
+#include <multipass/logging/tracer.h>
+#include <multipass/sparse_file.h>
 
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <exception>
+#include <mutex>
+#include <thread>
 #include <vector>
 
 namespace mp = multipass;
 
 namespace
 {
+constexpr auto max_size = 65536u;
+constexpr auto block_write_size = 1u << 20;
+
 bool verify_decode(const xz_ret& ret)
 {
     switch (ret)
@@ -52,67 +64,333 @@ bool verify_decode(const xz_ret& ret)
 
     return true;
 }
+
+std::uint32_t read_le32(const char* data)
+{
+    const auto bytes = reinterpret_cast<const unsigned char*>(data);
+    return bytes[0] | bytes[1] << 8 | bytes[2] << 16 | std::uint32_t(bytes[3]) << 24;
+}
+
+void append_le32(QByteArray& data, std::uint32_t value)
+{
+    for (auto i = 0; i < 4; ++i)
+        data.append(char((value >> (8 * i)) & 0xff));
+}
+
+std::uint32_t crc32_of(const QByteArray& data, int from = 0)
+{
+    return mp::checksum::crc32(data.constData() + from, data.size() - from);
+}
+
+bool read_vli(const char*& data, const char* end, std::uint64_t& value)
+{
+    value = 0;
+    for (auto i = 0; i < 9 && data < end; ++i)
+    {
+        const auto byte = static_cast<unsigned char>(*data++);
+        value |= std::uint64_t(byte & 0x7f) << (7 * i);
+        if (!(byte & 0x80))
+            return true;
+    }
+
+    return false;
+}
+
+void append_vli(QByteArray& data, std::uint64_t value)
+{
+    for (; value >= 0x80; value >>= 7)
+        data.append(char(value | 0x80));
+    data.append(char(value));
+}
+
+void pad_to_four(QByteArray& data)
+{
+    while (data.size() % 4)
+        data.append('\0');
+}
+
+// Blocks can only be told apart from the index at the end of the file. When that cannot be made sense of, e.g. with
+// several streams or stream padding, the result has no blocks and the file is decoded front to back instead.
+mp::XzBlockIndex read_block_index(QFile& xz_file)
+{
+    constexpr auto header_size = 12;
+    constexpr auto footer_size = 12;
+    mp::XzBlockIndex index;
+
+    const auto file_size = xz_file.size();
+    if (file_size < header_size + footer_size || !xz_file.seek(0))
+        return {};
+
+    index.stream_header = xz_file.read(header_size);
+    if (!xz_file.seek(file_size - footer_size))
+        return {};
+
+    const auto footer = xz_file.read(footer_size);
+    if (index.stream_header.size() != header_size || footer.size() != footer_size || !footer.endsWith("YZ") ||
+        footer.mid(8, 2) != index.stream_header.mid(6, 2) || crc32_of(footer.mid(4, 6)) != read_le32(footer))
+        return {};
+
+    const auto index_size = (qint64{read_le32(footer.constData() + 4)} + 1) * 4;
+    const auto index_offset = file_size - footer_size - index_size;
+    if (index_offset < header_size || !xz_file.seek(index_offset))
+        return {};
+
+    const auto index_data = xz_file.read(index_size);
+    if (index_data.size() != index_size || index_data[0] != '\0' ||
+        crc32_of(index_data.left(index_size - 4)) != read_le32(index_data.constData() + index_size - 4))
+        return {};
+
+    auto data = index_data.constData() + 1;
+    const auto end = index_data.constData() + index_size - 4;
+    std::uint64_t num_records;
+    if (!read_vli(data, end, num_records))
+        return {};
+
+    qint64 offset{header_size}, decoded_offset{0};
+    for (std::uint64_t i = 0; i < num_records; ++i)
+    {
+        mp::XzBlock block;
+        if (!read_vli(data, end, block.unpadded_size) || !read_vli(data, end, block.decoded_size))
+            return {};
+
+        block.offset = offset;
+        block.size = (block.unpadded_size + 3) & ~std::uint64_t{3};
+        block.decoded_offset = decoded_offset;
+        offset += block.size;
+        decoded_offset += block.decoded_size;
+        index.blocks.push_back(block);
+    }
+
+    // The blocks need to take up all there is between the header and the index
+    if (offset != index_offset)
+        return {};
+
+    return index;
+}
+
+// Wraps a block in a stream of its own, for any decoder to take on separately from the others
+QByteArray make_single_block_stream(const mp::XzBlockIndex& index, const mp::XzBlock& block, const QByteArray& data)
+{
+    auto stream = index.stream_header + data;
+
+    const auto index_offset = stream.size();
+    stream.append('\0');
+    append_vli(stream, 1);
+    append_vli(stream, block.unpadded_size);
+    append_vli(stream, block.decoded_size);
+    pad_to_four(stream);
+    append_le32(stream, crc32_of(stream, index_offset));
+
+    QByteArray footer;
+    append_le32(footer, (stream.size() - index_offset) / 4 - 1);
+    footer.append(index.stream_header.mid(6, 2));
+    append_le32(stream, crc32_of(footer));
+
+    return stream + footer + "YZ";
+}
+
+void decode_single_block_stream(xz_dec* decoder, const QByteArray& stream, std::vector<unsigned char>& out_buffer,
+                                QFile& out)
+{
+    struct xz_buf decode_buf
+    {
+    };
+    decode_buf.in = reinterpret_cast<const unsigned char*>(stream.constData());
+    decode_buf.in_size = stream.size();
+    decode_buf.out = out_buffer.data();
+    decode_buf.out_size = out_buffer.size();
+
+    xz_dec_reset(decoder);
+    for (auto ended = false; !ended;)
+    {
+        ended = !verify_decode(xz_dec_run(decoder, &decode_buf));
+
+        if (decode_buf.out_pos == decode_buf.out_size || ended)
+        {
+            if (!mp::sparse::write(out, reinterpret_cast<const char*>(out_buffer.data()), decode_buf.out_pos))
+                throw std::runtime_error(fmt::format("failed to write {}", out.fileName()));
+            decode_buf.out_pos = 0;
+        }
+    }
+}
 } // namespace
 
-mp::XzImageDecoder::XzImageDecoder(const Path& xz_file_path)
-    : xz_file{xz_file_path}, xz_decoder{xz_dec_init(XZ_DYNALLOC, 1u << 26), xz_dec_end}
+mp::XzImageDecoder::XzImageDecoder(const Path& xz_file_path) : xz_file{xz_file_path}
 {
-    xz_crc32_init();
-    xz_crc64_init();
 }
 
 void mp::XzImageDecoder::decode_to(const Path& decoded_image_path, const ProgressMonitor& monitor)
 {
+    mp::logging::TraceSpan span{"decode_to", xz_file.fileName().toStdString()};
+
     if (!xz_file.open(QIODevice::ReadOnly))
         throw std::runtime_error(fmt::format("failed to open {} for reading", xz_file.fileName()));
 
-    QFile decoded_file{decoded_image_path};
-    if (!decoded_file.open(QIODevice::WriteOnly))
-        throw std::runtime_error(fmt::format("failed to open {} for writing", decoded_file.fileName()));
+    xz_crc32_init();
+    xz_crc64_init();
 
-    struct xz_buf decode_buf
-    {
-    };
-    const auto max_size = 65536u;
+    const auto index = read_block_index(xz_file);
+    const auto num_threads = std::min<std::size_t>(std::thread::hardware_concurrency(), index.blocks.size());
 
-    std::vector<char> read_data, write_data;
-    read_data.reserve(max_size);
-    write_data.reserve(max_size);
+    if (num_threads > 1)
+        decode_blocks(index, num_threads, decoded_image_path, monitor);
+    else
+        decode_stream(decoded_image_path, monitor);
+}
 
-    decode_buf.in = reinterpret_cast<unsigned char*>(read_data.data());
-    decode_buf.in_pos = 0;
-    decode_buf.in_size = 0;
-    decode_buf.out = reinterpret_cast<unsigned char*>(write_data.data());
-    decode_buf.out_pos = 0;
-    decode_buf.out_size = max_size;
+void mp::XzImageDecoder::decode_stream(const Path& decoded_image_path, const ProgressMonitor& monitor)
+{
+    if (!xz_file.seek(0))
+        throw std::runtime_error(fmt::format("failed to read {}", xz_file.fileName()));
+
+    XzStreamDecoder decoder{decoded_image_path};
+    std::vector<char> read_data(max_size);
 
     const auto file_size = xz_file.size();
     qint64 total_bytes_extracted{0};
 
     auto last_progress = -1;
-    while (true)
+    for (qint64 num_read; (num_read = xz_file.read(read_data.data(), max_size)) > 0;)
     {
-        if (decode_buf.in_pos == decode_buf.in_size)
+        decoder.decode(read_data.data(), num_read);
+
+        total_bytes_extracted += num_read;
+        auto progress = (total_bytes_extracted / (float)file_size) * 100;
+        if (last_progress != progress)
+            monitor(LaunchProgress::EXTRACT, progress);
+        last_progress = progress;
+    }
+
+    decoder.finish();
+}
+
+void mp::XzImageDecoder::decode_blocks(const XzBlockIndex& index, std::size_t num_threads,
+                                       const Path& decoded_image_path, const ProgressMonitor& monitor)
+{
+    const auto& last_block = index.blocks.back();
+    QFile decoded_file{decoded_image_path};
+    if (!decoded_file.open(QIODevice::WriteOnly | QIODevice::Truncate) ||
+        !decoded_file.resize(last_block.decoded_offset + last_block.decoded_size))
+        throw std::runtime_error(fmt::format("failed to open {} for writing", decoded_file.fileName()));
+    decoded_file.close();
+
+    const auto total_bytes = last_block.offset + last_block.size - index.blocks.front().offset;
+    std::atomic_size_t next_block{0};
+    std::atomic_bool failed{false};
+    std::exception_ptr error;
+    std::mutex mutex;
+    qint64 total_bytes_extracted{0};
+    auto last_progress = -1;
+
+    // Every block goes to its own place in the preallocated file, in whatever order they get done
+    auto work = [&] {
+        try
         {
-            decode_buf.in_size = xz_file.read(read_data.data(), max_size);
-            decode_buf.in_pos = 0;
-            total_bytes_extracted += decode_buf.in_size;
-            auto progress = (total_bytes_extracted / (float)file_size) * 100;
-            if (last_progress != progress)
-                monitor(LaunchProgress::EXTRACT, progress);
-            last_progress = progress;
-        }
+            QFile in{xz_file.fileName()}, out{decoded_image_path};
+            if (!in.open(QIODevice::ReadOnly) || !out.open(QIODevice::ReadWrite))
+                throw std::runtime_error(fmt::format("failed to open {} for decoding", xz_file.fileName()));
 
-        if (!verify_decode(xz_dec_run(xz_decoder.get(), &decode_buf)))
+            XzDecoderUPtr decoder{xz_dec_init(XZ_DYNALLOC, 1u << 26), xz_dec_end};
+            std::vector<unsigned char> out_buffer(block_write_size);
+
+            while (!failed)
+            {
+                const auto i = next_block++;
+                if (i >= index.blocks.size())
+                    break;
+
+                const auto& block = index.blocks[i];
+                if (!in.seek(block.offset) || !out.seek(block.decoded_offset))
+                    throw std::runtime_error(fmt::format("failed to seek in {}", xz_file.fileName()));
+
+                const auto stream = make_single_block_stream(index, block, in.read(block.size));
+                decode_single_block_stream(decoder.get(), stream, out_buffer, out);
+
+                std::lock_guard<std::mutex> lock{mutex};
+                total_bytes_extracted += block.size;
+                auto progress = (total_bytes_extracted / (float)total_bytes) * 100;
+                if (last_progress != progress)
+                    monitor(LaunchProgress::EXTRACT, progress);
+                last_progress = progress;
+            }
+        }
+        catch (...)
         {
-            decoded_file.write(write_data.data(), decode_buf.out_pos);
-            return;
+            std::lock_guard<std::mutex> lock{mutex};
+            if (!failed.exchange(true))
+                error = std::current_exception();
         }
+    };
+
+    std::vector<std::thread> threads;
+    for (std::size_t i = 1; i < num_threads; ++i)
+        threads.emplace_back(work);
+    work();
 
-        if (decode_buf.out_pos == max_size)
+    for (auto& thread : threads)
+        thread.join();
+
+    if (error)
+        std::rethrow_exception(error);
+}
+
+mp::XzStreamDecoder::XzStreamDecoder(const Path& decoded_file_path)
+    : decoded_file{decoded_file_path}, xz_decoder{xz_dec_init(XZ_DYNALLOC, 1u << 26), xz_dec_end}, out_buffer(max_size)
+{
+    xz_crc32_init();
+    xz_crc64_init();
+
+    if (!decoded_file.open(QIODevice::WriteOnly | QIODevice::Truncate))
+        throw std::runtime_error(fmt::format("failed to open {} for writing", decoded_file.fileName()));
+}
+
+void mp::XzStreamDecoder::decode(const char* data, std::size_t size)
+{
+    struct xz_buf decode_buf
+    {
+    };
+    decode_buf.in = reinterpret_cast<const unsigned char*>(data);
+    decode_buf.in_size = size;
+    decode_buf.out = out_buffer.data();
+    decode_buf.out_size = out_buffer.size();
+
+    // Whatever comes after the end of the stream is ignored
+    for (bool out_full{true}; !ended && (decode_buf.in_pos < decode_buf.in_size || out_full);)
+    {
+        ended = !verify_decode(xz_dec_run(xz_decoder.get(), &decode_buf));
+        out_full = decode_buf.out_pos == decode_buf.out_size;
+
+        if (out_full || ended)
         {
-            decoded_file.write(write_data.data(), decode_buf.out_pos);
+            flush(decode_buf.out_pos);
             decode_buf.out_pos = 0;
         }
     }
+
+    flush(decode_buf.out_pos);
+}
+
+void mp::XzStreamDecoder::restart()
+{
+    xz_dec_reset(xz_decoder.get());
+    ended = false;
+
+    if (!decoded_file.resize(0) || !decoded_file.seek(0))
+        throw std::runtime_error(fmt::format("failed to truncate {}", decoded_file.fileName()));
+}
+
+void mp::XzStreamDecoder::finish()
+{
+    // The decoder may hold on to output for lack of room, and it reports a truncated stream once it cannot go on
+    while (!ended)
+        decode(nullptr, 0);
+
+    if (!sparse::end(decoded_file) || !decoded_file.flush())
+        throw std::runtime_error(fmt::format("failed to write {}", decoded_file.fileName()));
+}
+
+void mp::XzStreamDecoder::flush(std::size_t size)
+{
+    if (size > 0 && !sparse::write(decoded_file, reinterpret_cast<const char*>(out_buffer.data()), size))
+        throw std::runtime_error(fmt::format("failed to write {}", decoded_file.fileName()));
 }
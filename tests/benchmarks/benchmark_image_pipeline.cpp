@@ -0,0 +1,237 @@
+/*
+ * Copyright (C) Canonical, Ltd.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; version 3.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#include "peak_rss.h"
+#include "temp_dir.h"
+
+#include <multipass/cloud_init_iso.h>
+#include <multipass/format.h>
+#include <multipass/vm_image_vault.h>
+#include <multipass/xz_image_decoder.h>
+
+#if QEMU_IMG_UTILS_ENABLED
+#include <shared/qemu_img_utils/qemu_img_utils.h>
+#endif
+
+#include <benchmark/benchmark.h>
+
+#include <QDir>
+#include <QFile>
+#include <QFileInfo>
+#include <QProcess>
+#include <QStandardPaths>
+
+#include <cstdint>
+#include <cstring>
+#include <map>
+#include <random>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+namespace mp = multipass;
+namespace mpt = multipass::test;
+
+// Images come from the environment when given, a real cloud image being what matters in the end:
+//   MULTIPASS_BENCHMARK_IMAGE     a raw disk image, for hashing, copying and converting
+//   MULTIPASS_BENCHMARK_XZ_IMAGE  an xz compressed one, for decoding
+// Otherwise synthetic sparse images are made, of the size given to each benchmark, in MiB. A quarter of it is data,
+// half of that random and half repeated, for about the allocation and compression ratio of an Ubuntu cloud image.
+namespace
+{
+constexpr qint64 mebibyte = 1024 * 1024;
+
+const mpt::TempDir& work_dir()
+{
+    static const mpt::TempDir dir;
+    return dir;
+}
+
+QString synthetic_image(qint64 size_in_mib)
+{
+    static std::map<qint64, QString> images;
+    if (auto it = images.find(size_in_mib); it != images.end())
+        return it->second;
+
+    const auto path = QDir{work_dir().path()}.filePath(QString{"synthetic-%1.img"}.arg(size_in_mib));
+    QFile image{path};
+    if (!image.open(QIODevice::WriteOnly))
+        throw std::runtime_error(fmt::format("cannot create {}", path));
+
+    std::mt19937_64 random{42};
+    std::vector<char> chunk(mebibyte);
+    for (qint64 i = 0; i < size_in_mib; i += 4)
+    {
+        for (std::size_t j = 0; j < chunk.size(); j += sizeof(std::uint64_t))
+        {
+            const auto value = j < chunk.size() / 2 ? random() : j / 4096;
+            std::memcpy(chunk.data() + j, &value, sizeof value);
+        }
+
+        image.seek(i * mebibyte);
+        image.write(chunk.data(), chunk.size());
+    }
+    image.resize(size_in_mib * mebibyte);
+
+    return images[size_in_mib] = path;
+}
+
+QString image_for(const benchmark::State& state)
+{
+    const auto given = qEnvironmentVariable("MULTIPASS_BENCHMARK_IMAGE");
+    return given.isEmpty() ? synthetic_image(state.range(0)) : given;
+}
+
+// Compressed with the xz tool, in a single block or in blocks of its threads' size, as decoding differs
+QString xz_image_for(const benchmark::State& state, bool blocks)
+{
+    if (const auto given = qEnvironmentVariable("MULTIPASS_BENCHMARK_XZ_IMAGE"); !given.isEmpty())
+        return given;
+
+    const auto source = synthetic_image(state.range(0));
+    const auto path = source + (blocks ? ".blocks.xz" : ".xz");
+    if (QFile::exists(path))
+        return path;
+
+    const auto xz = QStandardPaths::findExecutable("xz");
+    if (xz.isEmpty())
+        return {};
+
+    QProcess process;
+    process.setStandardOutputFile(path);
+    process.start(xz, {"--check=crc32", blocks ? "--threads=0" : "--threads=1", "--stdout", source});
+    if (!process.waitForFinished(-1) || process.exitCode() != 0)
+        return {};
+
+    return path;
+}
+
+void report(benchmark::State& state, qint64 bytes_per_iteration)
+{
+    state.SetBytesProcessed(state.iterations() * bytes_per_iteration);
+    state.counters["peak_rss_mib"] = mpt::peak_rss_in_mib();
+}
+
+void decode_xz_image(benchmark::State& state)
+{
+    const auto xz_image = xz_image_for(state, state.range(1) != 0);
+    if (xz_image.isEmpty())
+        return state.SkipWithError("no xz tool to compress the synthetic image with");
+
+    const auto decoded = QDir{work_dir().path()}.filePath("decoded.img");
+    mpt::reset_peak_rss();
+    for (auto _ : state)
+    {
+        mp::XzImageDecoder{xz_image}.decode_to(decoded, [](auto...) { return true; });
+
+        state.PauseTiming();
+        QFile::remove(decoded);
+        state.ResumeTiming();
+    }
+
+    report(state, QFileInfo{xz_image}.size());
+}
+
+void hash_image(benchmark::State& state)
+{
+    const auto image = image_for(state);
+    mpt::reset_peak_rss();
+    for (auto _ : state)
+        benchmark::DoNotOptimize(mp::vault::compute_image_hash(image));
+
+    report(state, QFileInfo{image}.size());
+}
+
+void copy_image(benchmark::State& state)
+{
+    const auto image = image_for(state);
+    const QDir output_dir{QDir{work_dir().path()}.filePath("copies")};
+    output_dir.mkpath(".");
+
+    mpt::reset_peak_rss();
+    for (auto _ : state)
+    {
+        const auto copied = mp::vault::copy(image, output_dir);
+
+        state.PauseTiming();
+        QFile::remove(copied);
+        state.ResumeTiming();
+    }
+
+    report(state, QFileInfo{image}.size());
+}
+
+#if QEMU_IMG_UTILS_ENABLED
+void convert_image(benchmark::State& state)
+{
+    if (QStandardPaths::findExecutable("qemu-img").isEmpty())
+        return state.SkipWithError("no qemu-img to convert with");
+
+    const auto image = image_for(state);
+    mpt::reset_peak_rss();
+    for (auto _ : state)
+    {
+        const auto converted = mp::backend::convert_to_qcow_if_necessary(image);
+
+        state.PauseTiming();
+        if (converted != image)
+            QFile::remove(converted);
+        state.ResumeTiming();
+    }
+
+    report(state, QFileInfo{image}.size());
+}
+#endif
+
+// What the daemon writes for every launch
+void write_cloud_init_iso(benchmark::State& state)
+{
+    const std::string user_data(state.range(0) * 1024, '#');
+    const auto iso_path = QDir{work_dir().path()}.filePath("cloud-init.iso");
+
+    mpt::reset_peak_rss();
+    for (auto _ : state)
+    {
+        mp::CloudInitIso iso;
+        iso.add_file("meta-data", "#cloud-config\ninstance-id: benchmark\nlocal-hostname: benchmark\n");
+        iso.add_file("vendor-data", "#cloud-config\ngrowpart:\n  mode: auto\n  devices: [\"/\"]\n");
+        iso.add_file("user-data", user_data);
+        iso.add_file("network-config", "version: 2\nethernets:\n  default:\n    dhcp4: true\n");
+        iso.write_to(iso_path);
+    }
+
+    report(state, QFileInfo{iso_path}.size());
+}
+} // namespace
+
+BENCHMARK(decode_xz_image)
+    ->Name("ImagePipeline/decode_xz")
+    ->ArgsProduct({{256, 2048}, {0, 1}})
+    ->ArgNames({"mib", "blocks"})
+    ->Unit(benchmark::kMillisecond)
+    ->UseRealTime();
+BENCHMARK(hash_image)->Name("ImagePipeline/hash")->Arg(256)->Arg(2048)->Unit(benchmark::kMillisecond)->UseRealTime();
+BENCHMARK(copy_image)->Name("ImagePipeline/copy")->Arg(256)->Arg(2048)->Unit(benchmark::kMillisecond)->UseRealTime();
+#if QEMU_IMG_UTILS_ENABLED
+BENCHMARK(convert_image)
+    ->Name("ImagePipeline/convert_to_qcow")
+    ->Arg(256)
+    ->Arg(2048)
+    ->Unit(benchmark::kMillisecond)
+    ->UseRealTime();
+#endif
+BENCHMARK(write_cloud_init_iso)->Name("ImagePipeline/cloud_init_iso")->Arg(4)->Arg(256)->UseRealTime();
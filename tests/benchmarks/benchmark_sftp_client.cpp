@@ -0,0 +1,313 @@
+/*
+ * Copyright (C) Canonical, Ltd.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; version 3.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#include "temp_dir.h"
+
+#include <multipass/format.h>
+#include <multipass/ssh/sftp_client.h>
+
+#include <benchmark/benchmark.h>
+
+#include <QByteArray>
+#include <QFile>
+
+#include <algorithm>
+#include <array>
+#include <cstdint>
+#include <fstream>
+#include <memory>
+#include <optional>
+#include <random>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+namespace mp = multipass;
+namespace mpt = multipass::test;
+
+// Copies to and from a real SSH server, an instance or a local sshd for runs that do not depend on one:
+//   MULTIPASS_BENCHMARK_SSH_HOST  the server, the benchmarks are skipped without it
+//   MULTIPASS_BENCHMARK_SSH_PORT  22 by default
+//   MULTIPASS_BENCHMARK_SSH_USER  ubuntu by default
+//   MULTIPASS_BENCHMARK_SSH_KEY   the private key file to authenticate with
+//   MULTIPASS_BENCHMARK_SSH_DIR   where to copy to on the server, /tmp/multipass-benchmark by default
+// Each benchmark takes the cipher, the transfer window (the reads or writes kept in flight for a file) and the
+// number of parallel transfers for directories.
+namespace
+{
+constexpr std::size_t mebibyte = 1024 * 1024;
+constexpr std::size_t large_file_size = 256 * mebibyte;
+constexpr std::size_t small_file_size = 4096;
+constexpr auto small_files = 1000;
+constexpr auto tree_depth = 8; // each directory with two subdirectories, down to the last level
+constexpr auto files_per_dir = 4;
+
+const std::array<const char*, 3> ciphers{"chacha20-poly1305@openssh.com", "aes128-gcm@openssh.com", "aes256-ctr"};
+
+struct Server
+{
+    std::string host;
+    int port;
+    std::string username;
+    std::string priv_key;
+    mp::fs::path dir;
+};
+
+std::optional<Server> server_from_env()
+{
+    const auto host = qEnvironmentVariable("MULTIPASS_BENCHMARK_SSH_HOST").toStdString();
+    if (host.empty())
+        return std::nullopt;
+
+    QFile key_file{qEnvironmentVariable("MULTIPASS_BENCHMARK_SSH_KEY")};
+    if (!key_file.open(QIODevice::ReadOnly))
+        throw std::runtime_error{"MULTIPASS_BENCHMARK_SSH_KEY has to name a readable private key file"};
+
+    auto ok = false;
+    const auto port = qEnvironmentVariableIntValue("MULTIPASS_BENCHMARK_SSH_PORT", &ok);
+    return Server{host,
+                  ok ? port : 22,
+                  qEnvironmentVariable("MULTIPASS_BENCHMARK_SSH_USER", "ubuntu").toStdString(),
+                  key_file.readAll().toStdString(),
+                  qEnvironmentVariable("MULTIPASS_BENCHMARK_SSH_DIR", "/tmp/multipass-benchmark").toStdString()};
+}
+
+const mpt::TempDir& work_dir()
+{
+    static const mpt::TempDir dir;
+    return dir;
+}
+
+mp::fs::path local_path(const std::string& name)
+{
+    return mp::fs::path{work_dir().path().toStdString()} / name;
+}
+
+void write_file(const mp::fs::path& path, std::size_t size)
+{
+    static std::mt19937 random{42};
+
+    std::vector<char> data(std::min(size, mebibyte));
+    std::generate(data.begin(), data.end(), [] { return static_cast<char>(random()); });
+
+    std::ofstream out{path, std::ios::binary};
+    for (std::size_t written = 0; written < size; written += data.size())
+        out.write(data.data(), std::min(data.size(), size - written));
+}
+
+void make_tree(const mp::fs::path& dir, int depth)
+{
+    mp::fs::create_directories(dir);
+    for (auto i = 0; i < files_per_dir; ++i)
+        write_file(dir / fmt::format("file{}", i), small_file_size);
+
+    if (depth > 1)
+        for (const auto* sub : {"a", "b"})
+            make_tree(dir / sub, depth - 1);
+}
+
+constexpr int tree_files()
+{
+    return ((1 << tree_depth) - 1) * files_per_dir;
+}
+
+// Made the first time a benchmark needs them
+const mp::fs::path& large_file()
+{
+    static const auto path = [] {
+        auto path = local_path("large");
+        write_file(path, large_file_size);
+        return path;
+    }();
+    return path;
+}
+
+const mp::fs::path& small_files_dir()
+{
+    static const auto path = [] {
+        auto path = local_path("small");
+        mp::fs::create_directories(path);
+        for (auto i = 0; i < small_files; ++i)
+            write_file(path / fmt::format("file{}", i), small_file_size);
+        return path;
+    }();
+    return path;
+}
+
+const mp::fs::path& deep_tree()
+{
+    static const auto path = [] {
+        auto path = local_path("tree");
+        make_tree(path, tree_depth);
+        return path;
+    }();
+    return path;
+}
+
+struct Connection
+{
+    std::unique_ptr<mp::SFTPClient> client;
+    mp::fs::path remote_dir;
+};
+
+// Connected with the benchmark's settings, or nothing when there is no server to benchmark against
+std::optional<Connection> connect(benchmark::State& state)
+{
+    static const auto server = server_from_env();
+    if (!server)
+    {
+        state.SkipWithError("Set MULTIPASS_BENCHMARK_SSH_HOST and MULTIPASS_BENCHMARK_SSH_KEY to run it");
+        return std::nullopt;
+    }
+
+    // The only one offered, by the client and every session it makes for parallel transfers
+    const auto cipher = ciphers.at(state.range(0));
+    state.SetLabel(cipher);
+
+    auto client = std::make_unique<mp::SFTPClient>(server->host, server->port, server->username, server->priv_key,
+                                                   false, cipher);
+    client->set_transfer_window(static_cast<int>(state.range(1)));
+    client->set_parallel_transfers(static_cast<int>(state.range(2)));
+
+    // So that the remote directory exists, and directories copied into it land in the same place every time
+    const auto marker = local_path("marker");
+    write_file(marker, 1);
+    if (!client->push(marker, server->dir / "marker", mp::SFTPClient::Flag::MakeParent))
+        throw std::runtime_error{fmt::format("cannot create {} on the server", server->dir.string())};
+
+    return Connection{std::move(client), server->dir};
+}
+
+template <typename Copy>
+void run_copies(benchmark::State& state, Copy&& copy, std::size_t bytes, int files)
+{
+    for (auto _ : state)
+        if (!copy())
+        {
+            state.SkipWithError("The copy failed, see the log");
+            break;
+        }
+
+    state.SetBytesProcessed(static_cast<std::int64_t>(state.iterations() * bytes));
+    state.counters["files_per_second"] =
+        benchmark::Counter(static_cast<double>(state.iterations() * files), benchmark::Counter::kIsRate);
+}
+
+void push_large_file(benchmark::State& state)
+{
+    if (auto connection = connect(state))
+        run_copies(
+            state, [&] { return connection->client->push(large_file(), connection->remote_dir / "large"); },
+            large_file_size, 1);
+}
+
+void pull_large_file(benchmark::State& state)
+{
+    auto connection = connect(state);
+    if (!connection || !connection->client->push(large_file(), connection->remote_dir / "large"))
+        return;
+
+    run_copies(
+        state, [&] { return connection->client->pull(connection->remote_dir / "large", local_path("pulled")); },
+        large_file_size, 1);
+}
+
+void copy_dir(benchmark::State& state, const mp::fs::path& dir, std::size_t bytes, int files, bool push)
+{
+    constexpr auto flags = mp::SFTPClient::Flag::Recursive;
+    auto connection = connect(state);
+    if (!connection)
+        return;
+
+    if (push)
+    {
+        run_copies(
+            state, [&] { return connection->client->push(dir, connection->remote_dir, flags); }, bytes, files);
+        return;
+    }
+
+    // What is pulled is pushed first, once
+    if (!connection->client->push(dir, connection->remote_dir, flags))
+    {
+        state.SkipWithError("Could not push what to pull");
+        return;
+    }
+
+    const auto pulled = local_path("pulled-dirs");
+    mp::fs::create_directories(pulled);
+    run_copies(
+        state, [&] { return connection->client->pull(connection->remote_dir / dir.filename(), pulled, flags); },
+        bytes, files);
+}
+
+void push_small_files(benchmark::State& state)
+{
+    copy_dir(state, small_files_dir(), small_files * small_file_size, small_files, true);
+}
+
+void pull_small_files(benchmark::State& state)
+{
+    copy_dir(state, small_files_dir(), small_files * small_file_size, small_files, false);
+}
+
+void push_deep_tree(benchmark::State& state)
+{
+    copy_dir(state, deep_tree(), tree_files() * small_file_size, tree_files(), true);
+}
+
+void pull_deep_tree(benchmark::State& state)
+{
+    copy_dir(state, deep_tree(), tree_files() * small_file_size, tree_files(), false);
+}
+} // namespace
+
+BENCHMARK(push_large_file)
+    ->Name("SFTPClient/push_large")
+    ->ArgNames({"cipher", "window", "parallel"})
+    ->ArgsProduct({{0, 1, 2}, {1, 16, 64}, {1}})
+    ->Unit(benchmark::kMillisecond)
+    ->UseRealTime();
+BENCHMARK(pull_large_file)
+    ->Name("SFTPClient/pull_large")
+    ->ArgNames({"cipher", "window", "parallel"})
+    ->ArgsProduct({{0, 1, 2}, {1, 16, 64}, {1}})
+    ->Unit(benchmark::kMillisecond)
+    ->UseRealTime();
+BENCHMARK(push_small_files)
+    ->Name("SFTPClient/push_small")
+    ->ArgNames({"cipher", "window", "parallel"})
+    ->ArgsProduct({{0}, {16}, {1, 4, 8}})
+    ->Unit(benchmark::kMillisecond)
+    ->UseRealTime();
+BENCHMARK(pull_small_files)
+    ->Name("SFTPClient/pull_small")
+    ->ArgNames({"cipher", "window", "parallel"})
+    ->ArgsProduct({{0}, {16}, {1, 4, 8}})
+    ->Unit(benchmark::kMillisecond)
+    ->UseRealTime();
+BENCHMARK(push_deep_tree)
+    ->Name("SFTPClient/push_tree")
+    ->ArgNames({"cipher", "window", "parallel"})
+    ->ArgsProduct({{0}, {16}, {1, 4, 8}})
+    ->Unit(benchmark::kMillisecond)
+    ->UseRealTime();
+BENCHMARK(pull_deep_tree)
+    ->Name("SFTPClient/pull_tree")
+    ->ArgNames({"cipher", "window", "parallel"})
+    ->ArgsProduct({{0}, {16}, {1, 4, 8}})
+    ->Unit(benchmark::kMillisecond)
+    ->UseRealTime();
@@ -0,0 +1,319 @@
+/*
+ * Copyright (C) Canonical, Ltd.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; version 3.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#include "mock_ssh_process_exit_status.h"
+#include "sftp_server_test_fixture.h"
+#include "temp_dir.h"
+
+#include <src/sshfs_mount/sftp_server.h>
+
+#include <multipass/ssh/ssh_session.h>
+
+#include <benchmark/benchmark.h>
+
+#include <QDir>
+#include <QFile>
+
+#include <atomic>
+#include <cstring>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <queue>
+#include <string>
+#include <vector>
+
+namespace mp = multipass;
+namespace mpt = multipass::test;
+
+namespace
+{
+using StringUPtr = std::unique_ptr<ssh_string_struct, void (*)(ssh_string)>;
+
+constexpr auto messages_per_run = 256;
+constexpr qint64 file_size = 16 * 1024 * 1024;
+
+// Handles carry the address of what the server opened, where libssh's would carry an index into a table of them
+ssh_string handle_for(void* info)
+{
+    auto handle = ssh_string_new(sizeof info);
+    ssh_string_fill(handle, &info, sizeof info);
+    return handle;
+}
+
+void* info_from(ssh_string handle)
+{
+    void* info{nullptr};
+    std::memcpy(&info, ssh_string_data(handle), sizeof info);
+    return info;
+}
+
+// Feeds a server batches of messages as sshfs would send them, counting what it replies
+struct SftpServerBench : public mpt::SftpServerMocks
+{
+    explicit SftpServerBench(bool write_behind = false)
+        : server{mp::SSHSession{"a", 42}, root.path().toStdString(), root.path().toStdString(), {}, {}, 1000, 1000,
+                 "sshfs", write_behind}
+    {
+    }
+
+    sftp_client_message add_message(uint8_t type)
+    {
+        auto& msg = batch.emplace_back(std::make_unique<sftp_client_message_struct>());
+        msg->type = type;
+        queue.push(msg.get());
+        return msg.get();
+    }
+
+    sftp_client_message add_message(uint8_t type, const QString& path)
+    {
+        auto msg = add_message(type);
+        msg->filename = filenames.emplace_back(path.toStdString()).data();
+        return msg;
+    }
+
+    sftp_client_message add_message(uint8_t type, ssh_string handle)
+    {
+        auto msg = add_message(type);
+        msg->handle = handle;
+        return msg;
+    }
+
+    void run()
+    {
+        server.run();
+        batch.clear();
+        filenames.clear();
+    }
+
+    std::vector<StringUPtr> open(const QStringList& paths, uint32_t flags, uint8_t type = SFTP_OPEN)
+    {
+        for (const auto& path : paths)
+            add_message(type, path)->flags = flags;
+        run();
+
+        std::vector<StringUPtr> handles;
+        for (auto info : opened)
+            handles.emplace_back(handle_for(info), ssh_string_free);
+        opened.clear();
+
+        return handles;
+    }
+
+    StringUPtr open(const QString& path, uint32_t flags, uint8_t type = SFTP_OPEN)
+    {
+        return std::move(open(QStringList{path}, flags, type).front());
+    }
+
+    QString make_file(const QString& name, qint64 size = 0)
+    {
+        const auto path = QDir{root.path()}.filePath(name);
+        QFile file{path};
+        file.open(QIODevice::WriteOnly);
+        file.resize(size);
+
+        return path;
+    }
+
+    mpt::TempDir root;
+    mpt::ExitStatusMock exit_status_mock;
+
+    std::vector<std::unique_ptr<sftp_client_message_struct>> batch;
+    std::deque<std::string> filenames;
+    std::queue<sftp_client_message> queue;
+    std::mutex opened_mutex;
+    std::vector<void*> opened; // handled on the server's threads
+
+    std::atomic<int64_t> replies{0};
+    std::atomic<int64_t> bytes{0};
+    std::atomic<int64_t> entries{0};
+    std::atomic<bool> eof{false};
+
+    MockScope<decltype(mock_sftp_get_client_message)> next_message{mock_sftp_get_client_message, [this](auto...) {
+                                                                       if (queue.empty())
+                                                                           return sftp_client_message{nullptr};
+                                                                       auto msg = queue.front();
+                                                                       queue.pop();
+                                                                       return msg;
+                                                                   }};
+    MockScope<decltype(mock_sftp_handle_alloc)> alloc_handle{mock_sftp_handle_alloc, [this](auto, void* info) {
+                                                                 std::lock_guard lock{opened_mutex};
+                                                                 opened.push_back(info);
+                                                                 return handle_for(info);
+                                                             }};
+    MockScope<decltype(mock_sftp_handle)> find_handle{mock_sftp_handle,
+                                                      [](auto, ssh_string handle) { return info_from(handle); }};
+    MockScope<decltype(mock_sftp_reply_handle)> reply_handle{mock_sftp_reply_handle, [](auto...) { return SSH_OK; }};
+    MockScope<decltype(mock_sftp_reply_status)> reply_status{mock_sftp_reply_status,
+                                                             [this](auto, uint32_t status, auto) {
+                                                                 ++replies;
+                                                                 if (status == SSH_FX_EOF)
+                                                                     eof = true;
+                                                                 return SSH_OK;
+                                                             }};
+    MockScope<decltype(mock_sftp_reply_data)> reply_data{mock_sftp_reply_data, [this](auto, auto, int len) {
+                                                             ++replies;
+                                                             bytes += len;
+                                                             return SSH_OK;
+                                                         }};
+    MockScope<decltype(mock_sftp_reply_attr)> reply_attr{mock_sftp_reply_attr, [this](auto...) {
+                                                             ++replies;
+                                                             return SSH_OK;
+                                                         }};
+    MockScope<decltype(mock_sftp_reply_names_add)> reply_names_add{mock_sftp_reply_names_add, [this](auto...) {
+                                                                       ++entries;
+                                                                       return SSH_OK;
+                                                                   }};
+    MockScope<decltype(mock_sftp_reply_names)> reply_names{mock_sftp_reply_names, [this](auto...) {
+                                                               ++replies;
+                                                               return SSH_OK;
+                                                           }};
+
+    mp::SftpServer server; // last, so that it goes before what answers for libssh
+};
+
+void report(benchmark::State& state, const SftpServerBench& bench, int64_t operations)
+{
+    state.SetItemsProcessed(operations);
+    state.SetBytesProcessed(bench.bytes);
+    state.counters["replies"] = benchmark::Counter(static_cast<double>(bench.replies), benchmark::Counter::kIsRate);
+}
+
+// Sequential reads of a large file, in the sizes sshfs asks for
+void read_file(benchmark::State& state)
+{
+    const auto len = state.range(0);
+    SftpServerBench bench;
+    const auto handle = bench.open(bench.make_file("file", file_size), SSH_FXF_READ);
+
+    qint64 offset = 0;
+    for (auto _ : state)
+    {
+        for (auto i = 0; i < messages_per_run; ++i, offset = (offset + len) % file_size)
+        {
+            auto msg = bench.add_message(SFTP_READ, handle.get());
+            msg->offset = offset;
+            msg->len = len;
+        }
+        bench.run();
+    }
+
+    report(state, bench, state.iterations() * messages_per_run);
+}
+
+// Sequential writes, applied as they come or with write-behind
+void write_file(benchmark::State& state)
+{
+    const auto len = state.range(0);
+    SftpServerBench bench{state.range(1) != 0};
+    const auto handle = bench.open(bench.make_file("file"), SSH_FXF_WRITE | SSH_FXF_TRUNC);
+    const std::string payload(len, 'x');
+    const StringUPtr data{ssh_string_new(len), ssh_string_free};
+    ssh_string_fill(data.get(), payload.data(), len);
+
+    qint64 offset = 0;
+    for (auto _ : state)
+    {
+        for (auto i = 0; i < messages_per_run; ++i, offset = (offset + len) % file_size)
+        {
+            auto msg = bench.add_message(SFTP_WRITE, handle.get());
+            msg->offset = offset;
+            msg->data = data.get();
+        }
+        bench.run();
+    }
+
+    state.SetBytesProcessed(state.iterations() * messages_per_run * len);
+    state.SetItemsProcessed(state.iterations() * messages_per_run);
+}
+
+// Listing a directory from opening it to its end, with as many entries as asked
+void read_dir(benchmark::State& state)
+{
+    SftpServerBench bench;
+    const auto dir = QDir{bench.root.path()}.filePath("dir");
+    QDir{}.mkpath(dir);
+    for (auto i = 0; i < state.range(0); ++i)
+        bench.make_file(QString{"dir/a-file-with-a-reasonably-long-name-%1"}.arg(i));
+
+    for (auto _ : state)
+    {
+        const auto handle = bench.open(dir, 0, SFTP_OPENDIR);
+        for (bench.eof = false; !bench.eof;)
+        {
+            bench.add_message(SFTP_READDIR, handle.get());
+            bench.run();
+        }
+
+        bench.add_message(SFTP_CLOSE, handle.get());
+        bench.run();
+    }
+
+    state.SetItemsProcessed(bench.entries);
+}
+
+// Looking files up across a tree, as a build does
+void stat_files(benchmark::State& state)
+{
+    SftpServerBench bench;
+    QStringList paths;
+    for (auto i = 0; i < state.range(0); ++i)
+    {
+        QDir{bench.root.path()}.mkpath(QString::number(i % 16));
+        paths << bench.make_file(QString{"%1/file-%2"}.arg(i % 16).arg(i));
+    }
+
+    auto next = 0;
+    for (auto _ : state)
+    {
+        for (auto i = 0; i < messages_per_run; ++i, next = (next + 1) % paths.size())
+            bench.add_message(SFTP_LSTAT, paths[next]);
+        bench.run();
+    }
+
+    report(state, bench, state.iterations() * messages_per_run);
+}
+
+// Opening files and closing them again, each one once per run
+void open_files(benchmark::State& state)
+{
+    SftpServerBench bench;
+    QStringList paths;
+    for (auto i = 0; i < messages_per_run; ++i)
+        paths << bench.make_file(QString{"file-%1"}.arg(i));
+
+    for (auto _ : state)
+    {
+        const auto handles = bench.open(paths, SSH_FXF_READ);
+        for (const auto& handle : handles)
+            bench.add_message(SFTP_CLOSE, handle.get());
+        bench.run();
+    }
+
+    report(state, bench, state.iterations() * messages_per_run);
+}
+} // namespace
+
+BENCHMARK(read_file)->Name("SftpServer/read")->Arg(4 * 1024)->Arg(32 * 1024)->Arg(64 * 1024)->UseRealTime();
+BENCHMARK(write_file)
+    ->Name("SftpServer/write")
+    ->ArgsProduct({{4 * 1024, 32 * 1024, 64 * 1024}, {0, 1}})
+    ->ArgNames({"len", "write_behind"})
+    ->UseRealTime();
+BENCHMARK(read_dir)->Name("SftpServer/readdir")->Arg(100)->Arg(10000)->UseRealTime();
+BENCHMARK(stat_files)->Name("SftpServer/stat")->Arg(1000)->UseRealTime();
+BENCHMARK(open_files)->Name("SftpServer/open")->UseRealTime();
@@ -0,0 +1,336 @@
+/*
+ * Copyright (C) Canonical, Ltd.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; version 3.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#include "peak_rss.h"
+
+#include <src/daemon/ubuntu_image_host.h>
+
+#include <multipass/constants.h>
+#include <multipass/exceptions/settings_exceptions.h>
+#include <multipass/format.h>
+#include <multipass/query.h>
+#include <multipass/settings/settings.h>
+#include <multipass/settings/settings_handler.h>
+#include <multipass/simple_streams_index.h>
+#include <multipass/simple_streams_manifest.h>
+#include <multipass/url_downloader.h>
+
+#include <benchmark/benchmark.h>
+
+#include <QCryptographicHash>
+#include <QFile>
+#include <QJsonArray>
+#include <QJsonDocument>
+#include <QJsonObject>
+
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+namespace mp = multipass;
+namespace mpt = multipass::test;
+
+// Manifests come from the environment when given, captured from the real image servers being what matters:
+//   MULTIPASS_BENCHMARK_INDEX     an index.json
+//   MULTIPASS_BENCHMARK_MANIFEST  the download.json it points at
+// Otherwise a synthetic pair of about the size of the released images' is made: releases for every architecture,
+// with a few dozen versions each.
+namespace
+{
+constexpr auto host_url = "https://cloud-images.ubuntu.com/releases/";
+constexpr auto manifest_path = "streams/v1/com.ubuntu.cloud:released:download.json";
+constexpr auto synthetic_releases = 24;
+constexpr auto synthetic_versions = 40;
+const auto synthetic_arches = {"amd64", "armhf", "arm64", "i386", "powerpc", "ppc64el", "s390x"};
+
+QString fake_sha256(const QString& of)
+{
+    return QCryptographicHash::hash(of.toUtf8(), QCryptographicHash::Sha256).toHex();
+}
+
+QByteArray synthetic_manifest(QStringList& product_keys)
+{
+    QJsonObject products;
+    for (auto r = 0; r < synthetic_releases; ++r)
+    {
+        const auto version = QString{"%1.%2"}.arg(10 + r / 2).arg(r % 2 ? "10" : "04");
+        const auto codename = QString{"release%1"}.arg(r);
+
+        for (const auto* arch : synthetic_arches)
+        {
+            QJsonObject versions;
+            for (auto v = 0; v < synthetic_versions; ++v)
+            {
+                const auto serial = QString{"2023%1.%2"}.arg(v / 4 + 1, 2, 10, QChar{'0'}).arg(v % 4);
+                const auto name = QString{"%1-%2-%3"}.arg(codename, arch, serial);
+                const auto path = QString{"server/releases/%1/release-%2/%3"}.arg(codename, serial, name);
+
+                QJsonObject items{
+                    {"disk1.img", QJsonObject{{"ftype", "disk1.img"},
+                                              {"md5", fake_sha256(name + "md5").left(32)},
+                                              {"path", path + ".img"},
+                                              {"sha256", fake_sha256(name + ".img")},
+                                              {"size", 600 * 1024 * 1024}}},
+                    {"lxd.tar.xz", QJsonObject{{"combined_disk1-img_sha256", fake_sha256(name + "combined")},
+                                               {"combined_squashfs_sha256", fake_sha256(name + "squashfs")},
+                                               {"ftype", "lxd.tar.xz"},
+                                               {"md5", fake_sha256(name + "lxd md5").left(32)},
+                                               {"path", path + "-lxd.tar.xz"},
+                                               {"sha256", fake_sha256(name + ".tar.xz")},
+                                               {"size", 900}}},
+                    {"manifest", QJsonObject{{"ftype", "manifest"},
+                                             {"path", path + ".manifest"},
+                                             {"sha256", fake_sha256(name + ".manifest")},
+                                             {"size", 15000}}}};
+                versions.insert(serial, QJsonObject{{"items", items}, {"label", "release"}, {"pubname", name}});
+            }
+
+            const auto key = QString{"com.ubuntu.cloud:server:%1:%2"}.arg(version, arch);
+            product_keys.append(key);
+            products.insert(key, QJsonObject{{"aliases", QString{"%1,%2"}.arg(version, codename)},
+                                             {"arch", arch},
+                                             {"os", "ubuntu"},
+                                             {"release", codename},
+                                             {"release_title", version},
+                                             {"supported", true},
+                                             {"version", version},
+                                             {"versions", versions}});
+        }
+    }
+
+    return QJsonDocument{QJsonObject{{"content_id", "com.ubuntu.cloud:released:download"},
+                                     {"datatype", "image-downloads"},
+                                     {"format", "products:1.0"},
+                                     {"products", products},
+                                     {"updated", "Mon, 02 Oct 2023 12:00:00 +0000"}}}
+        .toJson(QJsonDocument::Compact);
+}
+
+QByteArray synthetic_index(const QStringList& product_keys)
+{
+    QJsonObject entry{{"datatype", "image-downloads"},
+                      {"format", "products:1.0"},
+                      {"path", manifest_path},
+                      {"products", QJsonArray::fromStringList(product_keys)},
+                      {"updated", "Mon, 02 Oct 2023 12:00:00 +0000"}};
+
+    return QJsonDocument{QJsonObject{{"format", "index:1.0"},
+                                     {"index", QJsonObject{{"com.ubuntu.cloud:released:download", entry}}}}}
+        .toJson(QJsonDocument::Compact);
+}
+
+QByteArray read_file(const QString& path)
+{
+    QFile file{path};
+    if (!file.open(QIODevice::ReadOnly))
+        throw std::runtime_error{fmt::format("cannot read {}", path)};
+
+    return file.readAll();
+}
+
+struct Streams
+{
+    QByteArray index;
+    QByteArray manifest;
+};
+
+const Streams& streams()
+{
+    static const auto streams = [] {
+        const auto index_path = qEnvironmentVariable("MULTIPASS_BENCHMARK_INDEX");
+        const auto captured_manifest_path = qEnvironmentVariable("MULTIPASS_BENCHMARK_MANIFEST");
+        if (!index_path.isEmpty() && !captured_manifest_path.isEmpty())
+            return Streams{read_file(index_path), read_file(captured_manifest_path)};
+
+        QStringList product_keys;
+        auto manifest = synthetic_manifest(product_keys);
+        return Streams{synthetic_index(product_keys), std::move(manifest)};
+    }();
+    return streams;
+}
+
+// The manifests are filtered by driver, there are no other settings to the parsing
+struct DriverSettings : public mp::SettingsHandler
+{
+    std::set<QString> keys() const override
+    {
+        return {mp::driver_key};
+    }
+
+    QString get(const QString& key) const override
+    {
+        if (key != mp::driver_key)
+            throw mp::UnrecognizedSettingException{key};
+        return "qemu";
+    }
+
+    void set(const QString& key, const QString&) override
+    {
+        throw mp::UnrecognizedSettingException{key};
+    }
+};
+
+void register_settings()
+{
+    static const auto handler = MP_SETTINGS.register_handler(std::make_unique<DriverSettings>());
+    (void)handler;
+}
+
+// Serves the streams to the image host, the same ones every time, as a server that says they did not change would
+struct StreamsURLDownloader : public mp::URLDownloader
+{
+    StreamsURLDownloader() : mp::URLDownloader{std::chrono::seconds{10}}
+    {
+    }
+
+    QByteArray download(const QUrl& url) override
+    {
+        return url.path().endsWith("index.json") ? streams().index : streams().manifest;
+    }
+
+    std::optional<QByteArray> download_if_changed(const QUrl& url, Validators& validators) override
+    {
+        validators.etag = "\"benchmark\"";
+        return download(url);
+    }
+};
+
+void report_peak_rss(benchmark::State& state)
+{
+    state.counters["peak_rss_mib"] = mpt::peak_rss_in_mib();
+}
+
+void parse_index(benchmark::State& state)
+{
+    const auto& index = streams().index;
+    for (auto _ : state)
+        benchmark::DoNotOptimize(mp::SimpleStreamsIndex::fromJson(index));
+
+    state.SetBytesProcessed(state.iterations() * index.size());
+}
+
+void parse_manifest(benchmark::State& state)
+{
+    register_settings();
+    const auto& manifest = streams().manifest;
+
+    mpt::reset_peak_rss();
+    for (auto _ : state)
+        benchmark::DoNotOptimize(mp::SimpleStreamsManifest::fromJson(manifest, std::nullopt, host_url));
+
+    state.SetBytesProcessed(state.iterations() * manifest.size());
+    report_peak_rss(state);
+}
+
+void load_manifest_snapshot(benchmark::State& state)
+{
+    register_settings();
+    const auto snapshot = mp::SimpleStreamsManifest::fromJson(streams().manifest, std::nullopt, host_url)->toSnapshot();
+
+    mpt::reset_peak_rss();
+    for (auto _ : state)
+        benchmark::DoNotOptimize(mp::SimpleStreamsManifest::fromSnapshot(snapshot));
+
+    state.SetBytesProcessed(state.iterations() * snapshot.size());
+    report_peak_rss(state);
+}
+
+struct ImageHost
+{
+    ImageHost()
+    {
+        register_settings();
+
+        // What there is to look up, as the parsing sees it
+        const auto manifest = mp::SimpleStreamsManifest::fromJson(streams().manifest, std::nullopt, host_url);
+        for (const auto& product : manifest->products)
+        {
+            hashes.push_back(product.id.toStdString());
+            for (const auto& alias : product.aliases)
+                aliases.push_back(alias.toStdString());
+        }
+
+        if (hashes.empty() || aliases.empty())
+            throw std::runtime_error{"nothing to look up in the manifest"};
+
+        host.info_for(query_for(aliases.front())); // to fetch the manifest, outside of what is timed
+    }
+
+    mp::Query query_for(const std::string& release) const
+    {
+        return {"", release, false, mp::release_remote, mp::Query::Type::Alias};
+    }
+
+    StreamsURLDownloader downloader;
+    mp::UbuntuVMImageHost host{{{mp::release_remote, mp::UbuntuVMImageRemote{"https://cloud-images.ubuntu.com/",
+                                                                             "releases/"}}},
+                               &downloader,
+                               std::chrono::hours{1}};
+    std::vector<std::string> aliases;
+    std::vector<std::string> hashes;
+};
+
+ImageHost& image_host()
+{
+    static ImageHost image_host;
+    return image_host;
+}
+
+void info_for_alias(benchmark::State& state)
+{
+    auto& fixture = image_host();
+    std::size_t i = 0;
+    for (auto _ : state)
+        benchmark::DoNotOptimize(
+            fixture.host.info_for(fixture.query_for(fixture.aliases[i++ % fixture.aliases.size()])));
+}
+
+void info_for_partial_hash(benchmark::State& state)
+{
+    auto& fixture = image_host();
+    std::size_t i = 0;
+    for (auto _ : state)
+        benchmark::DoNotOptimize(
+            fixture.host.info_for(fixture.query_for(fixture.hashes[i++ % fixture.hashes.size()].substr(0, 12))));
+}
+
+void all_info_for_alias(benchmark::State& state)
+{
+    auto& fixture = image_host();
+    std::size_t i = 0;
+    for (auto _ : state)
+        benchmark::DoNotOptimize(
+            fixture.host.all_info_for(fixture.query_for(fixture.aliases[i++ % fixture.aliases.size()])));
+}
+
+void info_for_full_hash(benchmark::State& state)
+{
+    auto& fixture = image_host();
+    std::size_t i = 0;
+    for (auto _ : state)
+        benchmark::DoNotOptimize(fixture.host.info_for_full_hash(fixture.hashes[i++ % fixture.hashes.size()]));
+}
+} // namespace
+
+BENCHMARK(parse_index)->Name("SimpleStreams/parse_index")->Unit(benchmark::kMicrosecond);
+BENCHMARK(parse_manifest)->Name("SimpleStreams/parse_manifest")->Unit(benchmark::kMillisecond);
+BENCHMARK(load_manifest_snapshot)->Name("SimpleStreams/load_snapshot")->Unit(benchmark::kMillisecond);
+BENCHMARK(info_for_alias)->Name("UbuntuVMImageHost/info_for");
+BENCHMARK(info_for_partial_hash)->Name("UbuntuVMImageHost/info_for_partial_hash");
+BENCHMARK(all_info_for_alias)->Name("UbuntuVMImageHost/all_info_for");
+BENCHMARK(info_for_full_hash)->Name("UbuntuVMImageHost/info_for_full_hash");
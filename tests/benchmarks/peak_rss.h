@@ -0,0 +1,50 @@
+/*
+ * Copyright (C) Canonical, Ltd.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; version 3.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#ifndef MULTIPASS_BENCHMARK_PEAK_RSS_H
+#define MULTIPASS_BENCHMARK_PEAK_RSS_H
+
+#include <QFile>
+
+namespace multipass
+{
+namespace test
+{
+// The high water mark since the last reset, which only Linux allows
+inline void reset_peak_rss()
+{
+#ifdef __linux__
+    QFile clear_refs{"/proc/self/clear_refs"};
+    if (clear_refs.open(QIODevice::WriteOnly))
+        clear_refs.write("5");
+#endif
+}
+
+inline double peak_rss_in_mib()
+{
+#ifdef __linux__
+    QFile status{"/proc/self/status"};
+    if (status.open(QIODevice::ReadOnly))
+        for (const auto& line : status.readAll().split('\n'))
+            if (line.startsWith("VmHWM:"))
+                return line.mid(6).trimmed().split(' ').front().toDouble() / 1024;
+#endif
+    return 0;
+}
+} // namespace test
+} // namespace multipass
+#endif // MULTIPASS_BENCHMARK_PEAK_RSS_H
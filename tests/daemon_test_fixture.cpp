@@ -19,6 +19,7 @@
 #include "common.h"
 #include "file_operations.h"
 #include "mock_cert_provider.h"
+#include "mock_exec_server.h"
 #include "mock_server_reader_writer.h"
 #include "mock_standard_paths.h"
 #include "stub_cert_store.h"
@@ -640,3 +641,40 @@ template grpc::Status mpt::DaemonTestFixture::call_daemon_slot(
     void (mp::Daemon::*)(const mp::InfoRequest*, grpc::ServerReaderWriterInterface<mp::InfoReply, mp::InfoRequest>*,
                          std::promise<grpc::Status>*),
     const mp::InfoRequest&, StrictMock<mpt::MockServerReaderWriter<mp::InfoReply, mp::InfoRequest>>&);
+template grpc::Status mpt::DaemonTestFixture::call_daemon_slot(
+    mp::Daemon&,
+    void (mp::Daemon::*)(const mp::WatchRequest*, grpc::ServerReaderWriterInterface<mp::WatchReply, mp::WatchRequest>*,
+                         std::promise<grpc::Status>*),
+    const mp::WatchRequest&, StrictMock<mpt::MockServerReaderWriter<mp::WatchReply, mp::WatchRequest>>&);
+template grpc::Status mpt::DaemonTestFixture::call_daemon_slot(
+    mp::Daemon&,
+    void (mp::Daemon::*)(const mp::StopRequest*, grpc::ServerReaderWriterInterface<mp::StopReply, mp::StopRequest>*,
+                         std::promise<grpc::Status>*),
+    const mp::StopRequest&, StrictMock<mpt::MockServerReaderWriter<mp::StopReply, mp::StopRequest>>&);
+template grpc::Status mpt::DaemonTestFixture::call_daemon_slot(
+    mp::Daemon&,
+    void (mp::Daemon::*)(const mp::SuspendRequest*,
+                         grpc::ServerReaderWriterInterface<mp::SuspendReply, mp::SuspendRequest>*,
+                         std::promise<grpc::Status>*),
+    const mp::SuspendRequest&, StrictMock<mpt::MockServerReaderWriter<mp::SuspendReply, mp::SuspendRequest>>&);
+template grpc::Status mpt::DaemonTestFixture::call_daemon_slot(
+    mp::Daemon&,
+    void (mp::Daemon::*)(const mp::ForwardRequest*,
+                         grpc::ServerReaderWriterInterface<mp::ForwardReply, mp::ForwardRequest>*,
+                         std::promise<grpc::Status>*),
+    const mp::ForwardRequest&, StrictMock<mpt::MockServerReaderWriter<mp::ForwardReply, mp::ForwardRequest>>&);
+template grpc::Status mpt::DaemonTestFixture::call_daemon_slot(
+    mp::Daemon&, void (mp::Daemon::*)(const mp::ExecRequest*, mp::ExecServer*, std::promise<grpc::Status>*),
+    const mp::ExecRequest&, StrictMock<mpt::MockExecServer>&);
+template grpc::Status mpt::DaemonTestFixture::call_daemon_slot(
+    mp::Daemon&,
+    void (mp::Daemon::*)(const mp::SSHInfoRequest*,
+                         grpc::ServerReaderWriterInterface<mp::SSHInfoReply, mp::SSHInfoRequest>*,
+                         std::promise<grpc::Status>*),
+    const mp::SSHInfoRequest&, StrictMock<mpt::MockServerReaderWriter<mp::SSHInfoReply, mp::SSHInfoRequest>>&);
+template grpc::Status mpt::DaemonTestFixture::call_daemon_slot(
+    mp::Daemon&,
+    void (mp::Daemon::*)(const mp::DeleteRequest*,
+                         grpc::ServerReaderWriterInterface<mp::DeleteReply, mp::DeleteRequest>*,
+                         std::promise<grpc::Status>*),
+    const mp::DeleteRequest&, NiceMock<mpt::MockServerReaderWriter<mp::DeleteReply, mp::DeleteRequest>>&&);
@@ -23,8 +23,21 @@
 #include <stdlib.h>
 #include <string.h>
 
+#include <chrono>
+#include <condition_variable>
+#include <map>
+#include <mutex>
+
 namespace mpt = multipass::test;
 
+namespace
+{
+std::mutex event_mutex;
+std::condition_variable timeout_added;
+std::map<int, std::pair<virEventTimeoutCallback, void*>> event_timeouts;
+int last_timeout{0};
+} // namespace
+
 /*
  * These are default fake libvirt functions for testing.  They return the most
  * common values needed for testing.
@@ -53,6 +66,33 @@ int virConnectGetVersion(virConnectPtr /*conn*/, unsigned long* hvVer)
     return 0;
 }
 
+int virConnectRef(virConnectPtr /*conn*/)
+{
+    return 0;
+}
+
+int virConnectIsAlive(virConnectPtr /*conn*/)
+{
+    return 1;
+}
+
+int virConnectSetKeepAlive(virConnectPtr /*conn*/, int /*interval*/, unsigned int /*count*/)
+{
+    return 0;
+}
+
+int virConnectDomainEventRegisterAny(virConnectPtr /*conn*/, virDomainPtr /*dom*/, int /*eventID*/,
+                                     virConnectDomainEventGenericCallback /*cb*/, void* /*opaque*/,
+                                     virFreeCallback /*freecb*/)
+{
+    return 0;
+}
+
+int virConnectDomainEventDeregisterAny(virConnectPtr /*conn*/, int /*callbackID*/)
+{
+    return 0;
+}
+
 int virDomainCreate(virDomainPtr /*domain*/)
 {
     return 0;
@@ -73,6 +113,16 @@ int virDomainFree(virDomainPtr /*domain*/)
     return 0;
 }
 
+int virDomainRef(virDomainPtr /*domain*/)
+{
+    return 0;
+}
+
+const char* virDomainGetName(virDomainPtr /*domain*/)
+{
+    return "";
+}
+
 int virDomainGetState(virDomainPtr /*domain*/, int* state, int* /*reason*/, unsigned int /*flags*/)
 {
     *state = VIR_DOMAIN_SHUTOFF;
@@ -171,3 +221,40 @@ int virDomainSetMemoryFlags(virDomainPtr /*domain*/, unsigned long /*memory*/, u
 {
     return 1;
 }
+
+int virEventRegisterDefaultImpl()
+{
+    return 0;
+}
+
+// Only timeouts for this one, which are all taken to be due as soon as they are added
+int virEventRunDefaultImpl()
+{
+    std::unique_lock lock{event_mutex};
+    timeout_added.wait_for(lock, std::chrono::milliseconds(100), [] { return !event_timeouts.empty(); });
+
+    const auto due = event_timeouts;
+    lock.unlock();
+
+    for (const auto& [timer, timeout] : due)
+        timeout.first(timer, timeout.second);
+
+    return 0;
+}
+
+int virEventAddTimeout(int /*timeout*/, virEventTimeoutCallback cb, void* opaque, virFreeCallback /*ff*/)
+{
+    std::lock_guard lock{event_mutex};
+    event_timeouts.emplace(++last_timeout, std::make_pair(cb, opaque));
+    timeout_added.notify_all();
+
+    return last_timeout;
+}
+
+int virEventRemoveTimeout(int timer)
+{
+    std::lock_guard lock{event_mutex};
+    event_timeouts.erase(timer);
+
+    return 0;
+}
@@ -18,6 +18,7 @@
 #include "tests/common.h"
 #include "tests/fake_handle.h"
 #include "tests/mock_backend_utils.h"
+#include "tests/mock_settings.h"
 #include "tests/mock_ssh.h"
 #include "tests/mock_status_monitor.h"
 #include "tests/stub_ssh_key_provider.h"
@@ -34,6 +35,8 @@
 #include <multipass/virtual_machine.h>
 #include <multipass/virtual_machine_description.h>
 
+#include <QJsonObject>
+
 #include <cstdlib>
 
 namespace mp = multipass;
@@ -64,6 +67,7 @@ struct LibVirtBackend : public Test
 
     mpt::MockBackend::GuardedMock backend_attr{mpt::MockBackend::inject<NiceMock>()};
     mpt::MockBackend* mock_backend = backend_attr.first;
+    mpt::MockSettings::GuardedMock mock_settings_injection = mpt::MockSettings::inject<NiceMock>();
 };
 
 TEST_F(LibVirtBackend, libvirt_wrapper_missing_libvirt_throws)
@@ -263,6 +267,122 @@ TEST_F(LibVirtBackend, suspend_with_broken_libvirt_connection_throws)
     EXPECT_THAT(machine->current_state(), Eq(mp::VirtualMachine::State::unknown));
 }
 
+TEST_F(LibVirtBackend, machines_share_one_connection_and_look_domains_up_once)
+{
+    static auto opened{0}, looked_up{0};
+    opened = looked_up = 0;
+
+    mp::LibVirtVirtualMachineFactory backend{data_dir.path(), fake_libvirt_path};
+    backend.libvirt_wrapper->virConnectOpen = [](auto...) {
+        ++opened;
+        return mpt::fake_handle<virConnectPtr>();
+    };
+    backend.libvirt_wrapper->virDomainLookupByName = [](auto...) {
+        ++looked_up;
+        return mpt::fake_handle<virDomainPtr>();
+    };
+
+    mpt::StubVMStatusMonitor stub_monitor;
+    auto machine = backend.create_virtual_machine(default_description, stub_monitor);
+    machine->start();
+    machine->current_state();
+    machine->shutdown();
+
+    auto other_description = default_description;
+    other_description.vm_name = "hooli-valley";
+    backend.create_virtual_machine(other_description, stub_monitor)->current_state();
+
+    EXPECT_EQ(opened, 1);
+    EXPECT_EQ(looked_up, 2);
+}
+
+TEST_F(LibVirtBackend, cached_state_fetched_again_on_lifecycle_events)
+{
+    static virConnectDomainEventGenericCallback lifecycle_callback{nullptr};
+    static void* lifecycle_opaque{nullptr};
+
+    mp::LibVirtVirtualMachineFactory backend{data_dir.path(), fake_libvirt_path};
+    backend.libvirt_wrapper->virConnectDomainEventRegisterAny = [](auto, auto, auto, auto cb, auto opaque, auto) {
+        lifecycle_callback = cb;
+        lifecycle_opaque = opaque;
+        return 1;
+    };
+    backend.libvirt_wrapper->virDomainGetName = [](auto) { return "pied-piper-valley"; };
+
+    mpt::StubVMStatusMonitor stub_monitor;
+    auto machine = backend.create_virtual_machine(default_description, stub_monitor);
+    ASSERT_THAT(machine->current_state(), Eq(mp::VirtualMachine::State::off));
+    ASSERT_TRUE(lifecycle_callback);
+
+    backend.libvirt_wrapper->virDomainGetState = [](auto, auto state, auto, auto) {
+        *state = VIR_DOMAIN_RUNNING;
+        return 0;
+    };
+    EXPECT_THAT(machine->cached_state(), Eq(mp::VirtualMachine::State::off));
+
+    reinterpret_cast<virConnectDomainEventLifecycleCallback>(lifecycle_callback)(
+        mpt::fake_handle<virConnectPtr>(), mpt::fake_handle<virDomainPtr>(), VIR_DOMAIN_EVENT_STARTED, 0,
+        lifecycle_opaque);
+
+    EXPECT_THAT(machine->cached_state(), Eq(mp::VirtualMachine::State::running));
+}
+
+TEST_F(LibVirtBackend, defines_domains_with_their_tuning)
+{
+    static std::string defined_xml;
+    defined_xml.clear();
+
+    mp::LibVirtVirtualMachineFactory backend{data_dir.path(), fake_libvirt_path};
+    backend.libvirt_wrapper->virDomainLookupByName = [](auto...) -> virDomainPtr { return nullptr; };
+    backend.libvirt_wrapper->virDomainDefineXML = [](auto, const char* xml) {
+        defined_xml = xml;
+        return mpt::fake_handle<virDomainPtr>();
+    };
+
+    NiceMock<mpt::MockVMStatusMonitor> mock_monitor;
+    ON_CALL(mock_monitor, retrieve_metadata_for(_))
+        .WillByDefault(Return(QJsonObject{{"disk_profile", "virtio-blk"}, {"hugepages", true}, {"cpu_pinning", "6"}}));
+
+    auto machine = backend.create_virtual_machine(default_description, mock_monitor);
+
+    EXPECT_THAT(defined_xml, HasSubstr("<iothreads>1</iothreads>"));
+    EXPECT_THAT(defined_xml, HasSubstr("cache='none' io='native' iothread='1' queues='2'"));
+    EXPECT_THAT(defined_xml, HasSubstr("<hugepages/>"));
+    EXPECT_THAT(defined_xml, HasSubstr("<vcpupin vcpu='1' cpuset='6'/>"));
+    EXPECT_THAT(defined_xml, HasSubstr("<driver queues='2'/>"));
+
+    EXPECT_EQ(machine->disk_profile(), "virtio-blk");
+    EXPECT_TRUE(machine->hugepages());
+    EXPECT_EQ(machine->cpu_pinning(), "6");
+}
+
+TEST_F(LibVirtBackend, setting_tuning_redefines_the_domain)
+{
+    static auto defined{0};
+    defined = 0;
+
+    mp::LibVirtVirtualMachineFactory backend{data_dir.path(), fake_libvirt_path};
+    backend.libvirt_wrapper->virDomainDefineXML = [](auto, const char* xml) {
+        ++defined;
+        EXPECT_THAT(xml, HasSubstr("<target dev='sda' bus='scsi'/>"));
+        return mpt::fake_handle<virDomainPtr>();
+    };
+
+    NiceMock<mpt::MockVMStatusMonitor> mock_monitor;
+    QJsonObject metadata;
+    ON_CALL(mock_monitor, retrieve_metadata_for(_)).WillByDefault([&metadata](auto...) { return metadata; });
+    ON_CALL(mock_monitor, update_metadata_for(_, _)).WillByDefault([&metadata](auto, const QJsonObject& updated) {
+        metadata = updated;
+    });
+
+    auto machine = backend.create_virtual_machine(default_description, mock_monitor);
+    machine->set_disk_profile("virtio-scsi");
+
+    EXPECT_EQ(defined, 1);
+    EXPECT_EQ(metadata["disk_profile"].toString().toStdString(), "virtio-scsi");
+    EXPECT_THROW(machine->set_cpu_pinning("nope"), std::invalid_argument);
+}
+
 TEST_F(LibVirtBackend, current_state_with_broken_libvirt_unknown)
 {
     mp::LibVirtVirtualMachineFactory backend{data_dir.path(), fake_libvirt_path};
@@ -80,6 +80,8 @@ public:
     MOCK_METHOD(QString, service, (), (const, override));
     MOCK_METHOD(QDBusMessage, call_impl,
                 (QDBus::CallMode, const QString&, const QVariant&, const QVariant&, const QVariant&), (override));
+    MOCK_METHOD(QDBusPendingCall, async_call_impl, (const QString&, const QVariant&, const QVariant&, const QVariant&),
+                (override));
 };
 
 struct CreateBridgeTest : public Test
@@ -121,6 +123,11 @@ struct CreateBridgeTest : public Test
         return QDBusMessage{}.createReply(QVariant::fromValue(QDBusObjectPath{obj_path}));
     }
 
+    static auto completed(const QDBusMessage& reply)
+    {
+        return QDBusPendingCall::fromCompletedCall(reply);
+    }
+
     static auto make_parent_connection_matcher(const char* child)
     {
         return Truly([child](const QVariant& arg) {
@@ -189,12 +196,12 @@ TEST_F(CreateBridgeTest, creates_and_activates_connections) // success case
     {
         InSequence seq{};
         EXPECT_CALL(*mock_nm_settings,
-                    call_impl(QDBus::Block, Eq("AddConnection"), make_parent_connection_matcher(network), empty, empty))
-            .WillOnce(Return(make_obj_path_reply("/a/b/c")));
+                    async_call_impl(Eq("AddConnection"), make_parent_connection_matcher(network), empty, empty))
+            .WillOnce(Return(completed(make_obj_path_reply("/a/b/c"))));
 
         EXPECT_CALL(*mock_nm_settings,
-                    call_impl(QDBus::Block, Eq("AddConnection"), make_child_connection_matcher(network), empty, empty))
-            .WillOnce(Return(make_obj_path_reply(child_obj_path)));
+                    async_call_impl(Eq("AddConnection"), make_child_connection_matcher(network), empty, empty))
+            .WillOnce(Return(completed(make_obj_path_reply(child_obj_path))));
 
         auto null_obj_matcher = make_object_path_matcher(null_obj_path);
         auto child_obj_matcher = make_object_path_matcher(child_obj_path);
@@ -249,13 +256,23 @@ TEST_F(CreateBridgeTest, throws_on_failure_to_create_first_connection)
     auto obj = QStringLiteral("An object");
     auto svc = QStringLiteral("A service");
 
-    EXPECT_CALL(*mock_nm_settings, call_impl(_, Eq("AddConnection"), _, _, _))
-        .WillOnce(Return(QDBusMessage::createError(QDBusError::AccessDenied, msg)));
+    const auto new_connection_path = QStringLiteral("/the/child");
+
+    EXPECT_CALL(*mock_nm_settings, async_call_impl(Eq("AddConnection"), _, _, _))
+        .WillOnce(Return(completed(QDBusMessage::createError(QDBusError::AccessDenied, msg))))
+        .WillOnce(Return(completed(make_obj_path_reply(new_connection_path))));
     EXPECT_CALL(*mock_nm_settings, interface).WillOnce(Return(ifc));
     EXPECT_CALL(*mock_nm_settings, path).WillOnce(Return(obj));
     EXPECT_CALL(*mock_nm_settings, service).WillOnce(Return(svc));
 
     inject_dbus_interfaces();
+
+    // The child was asked for along with the parent, so it is there to roll back
+    std::unique_ptr<MockDBusInterface> mock_nm_connection = std::make_unique<MockDBusInterface>();
+    EXPECT_CALL(*mock_nm_connection, call_impl(_, Eq("Delete"), empty, empty, empty));
+    EXPECT_CALL(mock_bus, get_interface(Eq("org.freedesktop.NetworkManager"), Eq(new_connection_path),
+                                        Eq("org.freedesktop.NetworkManager.Settings.Connection")))
+        .WillOnce(Return(ByMove(std::move(mock_nm_connection))));
     MP_ASSERT_THROW_THAT(MP_BACKEND.create_bridge_with("umdolita"), mp::backend::CreateBridgeException,
                          mpt::match_what(AllOf(HasSubstr(msg.toStdString()), HasSubstr(ifc.toStdString()),
                                                HasSubstr(obj.toStdString()), HasSubstr(svc.toStdString()))));
@@ -269,9 +286,9 @@ TEST_F(CreateBridgeTest, throws_on_failure_to_create_second_connection)
     const auto svc = QStringLiteral("the service");
     const auto new_connection_path = QStringLiteral("/a/b/c");
 
-    EXPECT_CALL(*mock_nm_settings, call_impl(_, Eq("AddConnection"), _, _, _))
-        .WillOnce(Return(make_obj_path_reply(new_connection_path)))
-        .WillOnce(Return(QDBusMessage::createError(QDBusError::UnknownMethod, msg)));
+    EXPECT_CALL(*mock_nm_settings, async_call_impl(Eq("AddConnection"), _, _, _))
+        .WillOnce(Return(completed(make_obj_path_reply(new_connection_path))))
+        .WillOnce(Return(completed(QDBusMessage::createError(QDBusError::UnknownMethod, msg))));
     EXPECT_CALL(*mock_nm_settings, interface).WillOnce(Return(ifc));
     EXPECT_CALL(*mock_nm_settings, path).WillOnce(Return(obj));
     EXPECT_CALL(*mock_nm_settings, service).WillOnce(Return(svc));
@@ -298,9 +315,9 @@ TEST_F(CreateBridgeTest, throws_on_failure_to_activate_second_connection)
     const auto new_connection_path1 = QStringLiteral("/foo");
     const auto new_connection_path2 = QStringLiteral("/bar");
 
-    EXPECT_CALL(*mock_nm_settings, call_impl(_, Eq("AddConnection"), _, _, _))
-        .WillOnce(Return(make_obj_path_reply(new_connection_path1)))
-        .WillOnce(Return(make_obj_path_reply(new_connection_path2)));
+    EXPECT_CALL(*mock_nm_settings, async_call_impl(Eq("AddConnection"), _, _, _))
+        .WillOnce(Return(completed(make_obj_path_reply(new_connection_path1))))
+        .WillOnce(Return(completed(make_obj_path_reply(new_connection_path2))));
 
     EXPECT_CALL(*mock_nm_root, call_impl(_, Eq("ActivateConnection"), _, _, _))
         .WillOnce(Return(QDBusMessage::createError(QDBusError::InvalidArgs, msg)));
@@ -332,9 +349,9 @@ TEST_F(CreateBridgeTest, logs_on_failure_to_rollback)
     const auto original_error = 255;
     const auto rollback_error = "fail";
 
-    EXPECT_CALL(*mock_nm_settings, call_impl(_, Eq("AddConnection"), _, _, _))
-        .WillOnce(Return(make_obj_path_reply("/asdf")))
-        .WillOnce(Return(make_obj_path_reply(child_path)));
+    EXPECT_CALL(*mock_nm_settings, async_call_impl(Eq("AddConnection"), _, _, _))
+        .WillOnce(Return(completed(make_obj_path_reply("/asdf"))))
+        .WillOnce(Return(completed(make_obj_path_reply(child_path))));
     EXPECT_CALL(*mock_nm_root, call_impl(_, Eq("ActivateConnection"), _, _, _)).WillOnce(Throw(original_error));
 
     inject_dbus_interfaces();
@@ -381,6 +398,71 @@ TEST_P(CreateBridgeExceptionTest, create_bridge_exception_mentions_unknown_cause
 }
 
 INSTANTIATE_TEST_SUITE_P(CreateBridgeTest, CreateBridgeExceptionTest, Values(true, false));
+struct ServiceSparesChildrenTest : public Test
+{
+    ServiceSparesChildrenTest()
+    {
+        EXPECT_CALL(*mock_dbus_provider, get_system_bus).WillRepeatedly(ReturnRef(mock_bus));
+        EXPECT_CALL(mock_bus, is_connected).WillRepeatedly(Return(true));
+    }
+
+    void inject_unit(const QString& id, const QString& kill_mode) // moves mocks, so expectations first please
+    {
+        EXPECT_CALL(*mock_manager, call_impl(QDBus::Block, Eq("GetUnitByPID"), _, _, _))
+            .WillOnce(Return(QDBusMessage{}.createReply(QVariant::fromValue(QDBusObjectPath{unit_path}))));
+        EXPECT_CALL(*mock_properties, call_impl(QDBus::Block, Eq("Get"), Eq(QVariant{"org.freedesktop.systemd1.Unit"}),
+                                                Eq(QVariant{"Id"}), _))
+            .WillOnce(Return(make_variant_reply(id)));
+        EXPECT_CALL(*mock_properties, call_impl(QDBus::Block, Eq("Get"),
+                                                Eq(QVariant{"org.freedesktop.systemd1.Service"}),
+                                                Eq(QVariant{"KillMode"}), _))
+            .Times(id.endsWith(".service") ? 1 : 0)
+            .WillRepeatedly(Return(make_variant_reply(kill_mode)));
+
+        EXPECT_CALL(mock_bus, get_interface(Eq("org.freedesktop.systemd1"), Eq("/org/freedesktop/systemd1"),
+                                            Eq("org.freedesktop.systemd1.Manager")))
+            .WillOnce(Return(ByMove(std::move(mock_manager))));
+        EXPECT_CALL(mock_bus, get_interface(Eq("org.freedesktop.systemd1"), Eq(unit_path),
+                                            Eq("org.freedesktop.DBus.Properties")))
+            .WillOnce(Return(ByMove(std::move(mock_properties))));
+    }
+
+    static QDBusMessage make_variant_reply(const QString& value)
+    {
+        return QDBusMessage{}.createReply(QVariant::fromValue(QDBusVariant{value}));
+    }
+
+    const QString unit_path{"/org/freedesktop/systemd1/unit/multipassd_2eservice"};
+    MockDBusProvider::GuardedMock mock_dbus_injection = MockDBusProvider::inject();
+    MockDBusProvider* mock_dbus_provider = mock_dbus_injection.first;
+    MockDBusConnection mock_bus{};
+    std::unique_ptr<MockDBusInterface> mock_manager = std::make_unique<MockDBusInterface>();
+    std::unique_ptr<MockDBusInterface> mock_properties = std::make_unique<MockDBusInterface>();
+};
+
+TEST_F(ServiceSparesChildrenTest, spares_them_when_only_the_main_process_is_killed)
+{
+    inject_unit("multipassd.service", "process");
+    EXPECT_TRUE(MP_BACKEND.service_spares_children());
+}
+
+TEST_F(ServiceSparesChildrenTest, does_not_when_the_whole_cgroup_is_killed)
+{
+    inject_unit("multipassd.service", "control-group");
+    EXPECT_FALSE(MP_BACKEND.service_spares_children());
+}
+
+TEST_F(ServiceSparesChildrenTest, spares_them_outside_of_a_service)
+{
+    inject_unit("session-2.scope", "control-group");
+    EXPECT_TRUE(MP_BACKEND.service_spares_children());
+}
+
+TEST_F(ServiceSparesChildrenTest, does_not_when_it_cannot_tell)
+{
+    EXPECT_CALL(mock_bus, is_connected).WillOnce(Return(false));
+    EXPECT_FALSE(MP_BACKEND.service_spares_children());
+}
 } // namespace
 
 TEST(LinuxBackendUtils, check_for_kvm_support_no_error_does_not_throw)
@@ -0,0 +1,218 @@
+/*
+ * Copyright (C) Canonical, Ltd.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; version 3.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#include "tests/common.h"
+#include "tests/file_operations.h"
+#include "tests/mock_logger.h"
+#include "tests/mock_singleton_helpers.h"
+#include "tests/temp_dir.h"
+
+#include <src/platform/backends/shared/linux/cgroups.h>
+
+#include <QDir>
+#include <QFile>
+
+namespace mp = multipass;
+namespace mpl = multipass::logging;
+namespace mpt = multipass::test;
+using namespace testing;
+
+namespace
+{
+// Looks at a made-up hierarchy instead of the host's
+class MockCgroups : public mp::Cgroups
+{
+public:
+    using Cgroups::Cgroups;
+
+    MOCK_METHOD(QString, hierarchy_path, (), (const, override));
+    MOCK_METHOD(QString, own_cgroup_path, (), (const, override));
+
+    MP_MOCK_SINGLETON_BOILERPLATE(MockCgroups, Cgroups);
+};
+
+struct Cgroups : public Test
+{
+    Cgroups()
+    {
+        ON_CALL(*mock_cgroups, hierarchy_path).WillByDefault(Return(cgroup_fs.path()));
+        ON_CALL(*mock_cgroups, own_cgroup_path).WillByDefault(Return(proc.filePath("cgroup")));
+
+        mpt::make_file_with_content(proc.filePath("cgroup"), "0::/system.slice/multipassd.service\n");
+        mpt::make_file_with_content(cgroup_fs.filePath("cgroup.controllers"), "cpuset cpu io memory pids\n");
+        mpt::make_file_with_content(root.filePath("cgroup.controllers"), "cpu io memory pids\n");
+        mpt::make_file_with_content(root.filePath("cgroup.procs"), "4242\n");
+
+        // The kernel makes the interface files along with a cgroup, here they are there beforehand
+        make_cgroup(root.path(), {"cgroup.subtree_control"});
+        make_cgroup(root.filePath("multipassd"), {"cgroup.procs", "cpu.weight", "io.weight", "memory.low"});
+        make_cgroup(root.filePath("instances"), {"cgroup.subtree_control"});
+
+        logger_scope.mock_logger->screen_logs(mpl::Level::warning);
+    }
+
+    static void make_cgroup(const QString& path, const QStringList& interface_files)
+    {
+        ASSERT_TRUE(QDir{path}.mkpath("."));
+        for (const auto& file : interface_files)
+            if (!QFile::exists(QDir{path}.filePath(file)))
+                mpt::make_file_with_content(QDir{path}.filePath(file), "");
+    }
+
+    QString instance_leaf(const QString& instance) const
+    {
+        return QDir{root.filePath("instances")}.filePath(instance);
+    }
+
+    mpt::TempDir cgroup_fs;
+    mpt::TempDir proc;
+    const QDir root{cgroup_fs.filePath("system.slice/multipassd.service")};
+    mpt::MockLogger::Scope logger_scope = mpt::MockLogger::inject();
+    MockCgroups::GuardedMock cgroups_injection{MockCgroups::inject<NiceMock>()};
+    MockCgroups* mock_cgroups{cgroups_injection.first};
+};
+
+TEST_F(Cgroups, movesTheDaemonIntoALeafOfItsOwn)
+{
+    ASSERT_TRUE(MP_CGROUPS.available());
+
+    const QDir daemon{root.filePath("multipassd")};
+    EXPECT_EQ(mpt::load(daemon.filePath("cgroup.procs")), "4242");
+    EXPECT_EQ(mpt::load(daemon.filePath("cpu.weight")), "1000");
+    EXPECT_EQ(mpt::load(daemon.filePath("io.weight")), "default 1000");
+    EXPECT_EQ(mpt::load(daemon.filePath("memory.low")), QByteArray::number(256LL << 20));
+}
+
+TEST_F(Cgroups, delegatesTheControllersItHasToInstances)
+{
+    ASSERT_TRUE(MP_CGROUPS.available());
+
+    EXPECT_EQ(mpt::load(root.filePath("cgroup.subtree_control")), "+cpu +memory +io");
+    EXPECT_EQ(mpt::load(QDir{root.filePath("instances")}.filePath("cgroup.subtree_control")), "+cpu +memory +io");
+}
+
+TEST_F(Cgroups, delegatesOnlyControllersItWasHandedDown)
+{
+    QFile controllers{root.filePath("cgroup.controllers")};
+    ASSERT_TRUE(controllers.open(QFile::WriteOnly | QFile::Truncate));
+    controllers.write("memory pids\n");
+    controllers.close();
+
+    ASSERT_TRUE(MP_CGROUPS.available());
+    EXPECT_EQ(mpt::load(root.filePath("cgroup.subtree_control")), "+memory");
+}
+
+TEST_F(Cgroups, isNotAvailableWithoutControllersToDelegate)
+{
+    QFile controllers{root.filePath("cgroup.controllers")};
+    ASSERT_TRUE(controllers.open(QFile::WriteOnly | QFile::Truncate));
+    controllers.write("pids\n");
+    controllers.close();
+
+    logger_scope.mock_logger->expect_log(mpl::Level::warning, "no controllers were delegated");
+    EXPECT_FALSE(MP_CGROUPS.available());
+    EXPECT_TRUE(mpt::load(root.filePath("multipassd/cgroup.procs")).isEmpty());
+}
+
+TEST_F(Cgroups, isNotAvailableWhenTheDaemonIsInTheRootCgroup)
+{
+    QFile own_cgroup{proc.filePath("cgroup")};
+    ASSERT_TRUE(own_cgroup.open(QFile::WriteOnly | QFile::Truncate));
+    own_cgroup.write("0::/\n");
+    own_cgroup.close();
+
+    logger_scope.mock_logger->expect_log(mpl::Level::warning, "not in a cgroup of its own");
+    EXPECT_FALSE(MP_CGROUPS.available());
+}
+
+TEST_F(Cgroups, isNotAvailableWithoutUnifiedHierarchy)
+{
+    ASSERT_TRUE(QFile::remove(cgroup_fs.filePath("cgroup.controllers")));
+
+    EXPECT_FALSE(MP_CGROUPS.available());
+    EXPECT_THROW(MP_CGROUPS.place("foo", 1234, {}), std::runtime_error);
+}
+
+TEST_F(Cgroups, placesInstanceInItsLeafWithItsControls)
+{
+    make_cgroup(instance_leaf("foo"), {"cgroup.procs", "cpu.weight", "memory.high", "memory.max"});
+
+    mp::Cgroups::Controls controls;
+    controls.cpu_weight = 200;
+    controls.memory_max = 1LL << 30;
+    MP_CGROUPS.place("foo", 1234, controls);
+
+    const QDir leaf{instance_leaf("foo")};
+    EXPECT_EQ(mpt::load(leaf.filePath("cgroup.procs")), "1234");
+    EXPECT_EQ(mpt::load(leaf.filePath("cpu.weight")), "200");
+    EXPECT_EQ(mpt::load(leaf.filePath("memory.high")), "max");
+    EXPECT_EQ(mpt::load(leaf.filePath("memory.max")), QByteArray::number(1LL << 30));
+    EXPECT_FALSE(QFile::exists(leaf.filePath("io.weight"))); // io was not handed down to it
+}
+
+TEST_F(Cgroups, throwsWhenTheInstanceCannotBeMovedToItsLeaf)
+{
+    make_cgroup(instance_leaf("foo"), {});
+
+    MP_EXPECT_THROW_THAT(MP_CGROUPS.place("foo", 1234, {}), std::runtime_error,
+                         mpt::match_what(HasSubstr("Could not write \"1234\"")));
+}
+
+TEST_F(Cgroups, releasesInstanceLeaf)
+{
+    ASSERT_TRUE(QDir{root.filePath("instances")}.mkdir("foo"));
+
+    MP_CGROUPS.release("foo");
+    EXPECT_FALSE(QDir{instance_leaf("foo")}.exists());
+
+    EXPECT_NO_THROW(MP_CGROUPS.release("foo")); // gone already
+}
+
+TEST_F(Cgroups, readsPressureOfDaemonAndInstances)
+{
+    mpt::make_file_with_content(root.filePath("multipassd/io.pressure"),
+                                "some avg10=0.00 avg60=0.00 avg300=0.00 total=12\n"
+                                "full avg10=0.00 avg60=0.00 avg300=0.00 total=3\n");
+    mpt::make_file_with_content(instance_leaf("foo") + "/cpu.pressure",
+                                "some avg10=1.50 avg60=0.75 avg300=0.20 total=123456\n");
+    mpt::make_file_with_content(instance_leaf("foo") + "/memory.pressure",
+                                "some avg10=0.00 avg60=0.00 avg300=0.00 total=78\n"
+                                "full avg10=0.00 avg60=0.00 avg300=0.00 total=9\n");
+    make_cgroup(instance_leaf("bar"), {}); // no pressure to tell
+
+    const auto pressure = MP_CGROUPS.pressure();
+    ASSERT_THAT(pressure, ElementsAre(Key(""), Key("foo")));
+
+    const auto& daemon = pressure.at("");
+    ASSERT_THAT(daemon, ElementsAre(Key("io")));
+    EXPECT_EQ(daemon.at("io").some, 12u);
+    EXPECT_EQ(daemon.at("io").full, 3u);
+
+    const auto& foo = pressure.at("foo");
+    ASSERT_THAT(foo, ElementsAre(Key("cpu"), Key("memory")));
+    EXPECT_EQ(foo.at("cpu").some, 123456u);
+    EXPECT_EQ(foo.at("cpu").full, 0u); // older kernels count no full stalls for cpu
+    EXPECT_EQ(foo.at("memory").some, 78u);
+    EXPECT_EQ(foo.at("memory").full, 9u);
+}
+
+TEST_F(Cgroups, readsNoPressureWhereThereAreNoCgroups)
+{
+    ASSERT_TRUE(QFile::remove(cgroup_fs.filePath("cgroup.controllers")));
+    EXPECT_THAT(MP_CGROUPS.pressure(), IsEmpty());
+}
+} // namespace
@@ -0,0 +1,146 @@
+/*
+ * Copyright (C) Canonical, Ltd.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; version 3.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#include "tests/common.h"
+#include "tests/temp_dir.h"
+
+#include <src/utils/dir_walker.h>
+
+#include <algorithm>
+#include <fstream>
+#include <map>
+
+namespace mp = multipass;
+namespace mpt = multipass::test;
+namespace fs = std::filesystem;
+
+using namespace testing;
+
+namespace
+{
+struct DirWalker : public Test
+{
+    DirWalker()
+    {
+        fs::create_directories(top / "sub" / "nested");
+        fs::create_directory(top / "elsewhere");
+        std::ofstream{top / "file"} << "contents";
+        std::ofstream{top / "sub" / "nested" / "deep-file"};
+        fs::create_symlink("file", top / "file-link");
+        fs::create_directory_symlink("../elsewhere", top / "sub" / "dir-link");
+        fs::permissions(top / "sub" / "nested", fs::perms::owner_all | fs::perms::group_read | fs::perms::group_exec);
+    }
+
+    std::map<fs::path, fs::file_type> walk()
+    {
+        std::error_code err;
+        mp::DirWalker walker{top, err};
+        EXPECT_FALSE(err);
+
+        std::map<fs::path, fs::file_type> walked;
+        while (walker.hasNext())
+        {
+            const auto& entry = walker.next();
+            walked.emplace(entry.path(), entry.symlink_status().type());
+        }
+
+        return walked;
+    }
+
+    mpt::TempDir temp_dir;
+    const fs::path top{temp_dir.path().toStdString()};
+};
+
+TEST_F(DirWalker, walksWhatStdFilesystemDoes)
+{
+    std::map<fs::path, fs::file_type> expected;
+    for (const auto& entry : fs::recursive_directory_iterator{top})
+        expected.emplace(entry.path(), entry.symlink_status().type());
+
+    EXPECT_EQ(walk(), expected);
+}
+
+TEST_F(DirWalker, doesNotFollowDirectoryLinks)
+{
+    const auto walked = walk();
+
+    EXPECT_EQ(walked.at(top / "sub" / "dir-link"), fs::file_type::symlink);
+    EXPECT_EQ(walked.count(top / "sub" / "dir-link" / "nested"), 0u);
+}
+
+TEST_F(DirWalker, givesDirectoriesBeforeWhatIsInThem)
+{
+    std::error_code err;
+    mp::DirWalker walker{top, err};
+
+    std::vector<fs::path> order;
+    while (walker.hasNext())
+        order.push_back(walker.next().path());
+
+    const auto position = [&order](const fs::path& path) { return std::find(order.begin(), order.end(), path); };
+    EXPECT_LT(position(top / "sub"), position(top / "sub" / "nested"));
+    EXPECT_LT(position(top / "sub" / "nested"), position(top / "sub" / "nested" / "deep-file"));
+}
+
+TEST_F(DirWalker, knowsDirectoryPermissions)
+{
+    std::error_code err;
+    mp::DirWalker walker{top, err};
+
+    while (walker.hasNext())
+    {
+        const auto& entry = walker.next();
+        if (entry.path() == top / "sub" / "nested")
+        {
+            EXPECT_EQ(entry.symlink_status().permissions(), fs::status(entry.path()).permissions());
+            return;
+        }
+    }
+
+    FAIL() << "the directory was not walked";
+}
+
+TEST_F(DirWalker, looksUpWhatTheListingDidNotSay)
+{
+    std::error_code err;
+    mp::DirWalker walker{top, err};
+
+    while (walker.hasNext())
+    {
+        const auto& entry = walker.next();
+        if (entry.path() == top / "file-link")
+        {
+            EXPECT_TRUE(entry.is_symlink());
+            EXPECT_TRUE(entry.is_regular_file());
+            EXPECT_EQ(entry.status().permissions(), fs::status(top / "file").permissions());
+            EXPECT_EQ(entry.file_size(), 8u);
+            return;
+        }
+    }
+
+    FAIL() << "the link was not walked";
+}
+
+TEST_F(DirWalker, failsOnWhatIsNotADirectory)
+{
+    std::error_code err;
+    mp::DirWalker walker{top / "file", err};
+
+    EXPECT_EQ(err, std::errc::not_a_directory);
+    EXPECT_FALSE(walker.hasNext());
+}
+} // namespace
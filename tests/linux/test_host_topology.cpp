@@ -0,0 +1,49 @@
+/*
+ * Copyright (C) Canonical, Ltd.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; version 3.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#include "tests/common.h"
+
+#include <src/platform/backends/shared/linux/host_topology.h>
+
+namespace mp = multipass;
+using namespace testing;
+
+namespace
+{
+TEST(HostTopology, parsesCpuListsAsTheKernelWritesThem)
+{
+    EXPECT_THAT(mp::HostTopology::parse_cpu_list("0-3,8,10-11\n"), ElementsAre(0, 1, 2, 3, 8, 10, 11));
+    EXPECT_THAT(mp::HostTopology::parse_cpu_list("5"), ElementsAre(5));
+}
+
+TEST(HostTopology, listsEachCpuOnce)
+{
+    EXPECT_THAT(mp::HostTopology::parse_cpu_list("2-4,3"), ElementsAre(2, 3, 4));
+}
+
+struct HostTopologyBadCpuLists : public TestWithParam<const char*>
+{
+};
+
+TEST_P(HostTopologyBadCpuLists, throwsOnWhatIsNotACpuList)
+{
+    EXPECT_THROW(mp::HostTopology::parse_cpu_list(GetParam()), std::invalid_argument);
+}
+
+INSTANTIATE_TEST_SUITE_P(HostTopology, HostTopologyBadCpuLists,
+                         Values("", "3-1", "-2", "1-2-3", "0,,1", "a", "0-99999", "numa"));
+} // namespace
@@ -50,8 +50,10 @@
 
 #include <scope_guard.hpp>
 
+#include <QCoreApplication>
 #include <QDir>
 #include <QFile>
+#include <QFileInfo>
 #include <QString>
 
 #include <stdexcept>
@@ -765,18 +767,36 @@ TEST_F(PlatformLinux, create_alias_script_works_unconfined)
 
     EXPECT_NO_THROW(MP_PLATFORM.create_alias_script("alias_name", mp::AliasDefinition{"instance", "command", "map"}));
 
-    QFile checked_script(tmp_dir.path() + "/bin/alias_name");
-    checked_script.open(QFile::ReadOnly);
+    const QFileInfo checked_link(tmp_dir.path() + "/bin/alias_name");
+    EXPECT_TRUE(checked_link.isSymLink());
+    EXPECT_EQ(checked_link.symLinkTarget(), QCoreApplication::applicationFilePath());
+}
 
-    EXPECT_EQ(checked_script.readLine().toStdString(), "#!/bin/sh\n");
-    EXPECT_EQ(checked_script.readLine().toStdString(), "\n");
-    EXPECT_THAT(checked_script.readLine().toStdString(), HasSubstr("alias_name -- \"${@}\"\n"));
-    EXPECT_TRUE(checked_script.atEnd());
+TEST_F(PlatformLinux, create_alias_script_overwrites_unconfined)
+{
+    const mpt::TempDir tmp_dir;
 
-    auto script_permissions = checked_script.permissions();
-    EXPECT_TRUE(script_permissions & QFileDevice::ExeOwner);
-    EXPECT_TRUE(script_permissions & QFileDevice::ExeGroup);
-    EXPECT_TRUE(script_permissions & QFileDevice::ExeOther);
+    EXPECT_CALL(mpt::MockStandardPaths::mock_instance(), writableLocation(mp::StandardPaths::AppLocalDataLocation))
+        .WillRepeatedly(Return(tmp_dir.path()));
+
+    mpt::make_file_with_content(tmp_dir.path() + "/bin/alias_name", "#!/bin/sh\n\nan old alias script\n");
+
+    EXPECT_NO_THROW(MP_PLATFORM.create_alias_script("alias_name", mp::AliasDefinition{"instance", "command", "map"}));
+    EXPECT_TRUE(QFileInfo{tmp_dir.path() + "/bin/alias_name"}.isSymLink());
+}
+
+TEST_F(PlatformLinux, create_alias_script_throws_if_cannot_create_link)
+{
+    auto [mock_file_ops, guard] = mpt::MockFileOps::inject();
+
+    EXPECT_CALL(*mock_file_ops, create_directories(_, _)).WillOnce(Return(false));
+    EXPECT_CALL(*mock_file_ops, remove(A<const mp::fs::path&>(), _)).WillOnce(Return(false));
+    EXPECT_CALL(*mock_file_ops, create_symlink(_, _, _))
+        .WillOnce(SetArgReferee<2>(std::make_error_code(std::errc::permission_denied)));
+
+    MP_EXPECT_THROW_THAT(
+        MP_PLATFORM.create_alias_script("alias_name", mp::AliasDefinition{"instance", "command", "map"}),
+        std::runtime_error, mpt::match_what(HasSubstr("cannot create alias link '")));
 }
 
 TEST_F(PlatformLinux, create_alias_script_works_confined)
@@ -809,6 +829,9 @@ TEST_F(PlatformLinux, create_alias_script_works_confined)
 
 TEST_F(PlatformLinux, create_alias_script_overwrites)
 {
+    const mpt::TempDir tmp_dir;
+    const mpt::SetEnvScope snap_name{"SNAP_NAME", "multipass"};
+    const mpt::SetEnvScope snap_user_common{"SNAP_USER_COMMON", tmp_dir.path().toUtf8()};
     auto [mock_utils, guard1] = mpt::MockUtils::inject();
     auto [mock_file_ops, guard2] = mpt::MockFileOps::inject();
 
@@ -822,6 +845,9 @@ TEST_F(PlatformLinux, create_alias_script_overwrites)
 
 TEST_F(PlatformLinux, create_alias_script_throws_if_cannot_create_path)
 {
+    const mpt::TempDir tmp_dir;
+    const mpt::SetEnvScope snap_name{"SNAP_NAME", "multipass"};
+    const mpt::SetEnvScope snap_user_common{"SNAP_USER_COMMON", tmp_dir.path().toUtf8()};
     auto [mock_file_ops, guard] = mpt::MockFileOps::inject();
 
     EXPECT_CALL(*mock_file_ops, mkpath(_, _)).WillOnce(Return(false));
@@ -833,6 +859,9 @@ TEST_F(PlatformLinux, create_alias_script_throws_if_cannot_create_path)
 
 TEST_F(PlatformLinux, create_alias_script_throws_if_cannot_write_script)
 {
+    const mpt::TempDir tmp_dir;
+    const mpt::SetEnvScope snap_name{"SNAP_NAME", "multipass"};
+    const mpt::SetEnvScope snap_user_common{"SNAP_USER_COMMON", tmp_dir.path().toUtf8()};
     auto [mock_file_ops, guard] = mpt::MockFileOps::inject();
 
     EXPECT_CALL(*mock_file_ops, mkpath(_, _)).WillOnce(Return(true));
@@ -846,6 +875,9 @@ TEST_F(PlatformLinux, create_alias_script_throws_if_cannot_write_script)
 
 TEST_F(PlatformLinux, create_alias_script_throws_if_cannot_set_permissions)
 {
+    const mpt::TempDir tmp_dir;
+    const mpt::SetEnvScope snap_name{"SNAP_NAME", "multipass"};
+    const mpt::SetEnvScope snap_user_common{"SNAP_USER_COMMON", tmp_dir.path().toUtf8()};
     auto [mock_utils, guard1] = mpt::MockUtils::inject();
     auto [mock_file_ops, guard2] = mpt::MockFileOps::inject();
 
@@ -884,4 +916,9 @@ TEST_F(PlatformLinux, remove_alias_script_throws_if_cannot_remove_script)
     MP_EXPECT_THROW_THAT(MP_PLATFORM.remove_alias_script("alias_name"), std::runtime_error,
                          mpt::match_what(StrEq("No such file or directory")));
 }
+
+TEST_F(PlatformLinux, resident_memory_is_that_of_this_process)
+{
+    EXPECT_GT(MP_PLATFORM.resident_memory(), 0u);
+}
 } // namespace
@@ -0,0 +1,172 @@
+/*
+ * Copyright (C) Canonical, Ltd.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; version 3.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+#include "tests/common.h"
+
+#include <src/daemon/port_forwarder.h>
+
+#include <QCoreApplication>
+
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include <atomic>
+#include <chrono>
+#include <stdexcept>
+#include <string>
+#include <thread>
+
+namespace mp = multipass;
+
+using namespace testing;
+
+namespace
+{
+int listening_socket(quint16& port)
+{
+    const auto fd = socket(AF_INET, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    sockaddr_in address{};
+    address.sin_family = AF_INET;
+    address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    socklen_t length = sizeof(address);
+    if (bind(fd, reinterpret_cast<sockaddr*>(&address), length) || listen(fd, 1) ||
+        getsockname(fd, reinterpret_cast<sockaddr*>(&address), &length))
+        throw std::runtime_error("cannot listen");
+
+    port = ntohs(address.sin_port);
+    return fd;
+}
+
+// Sends data, closes its side, and collects what comes back until the other side closes too
+std::string round_trip(quint16 port, const std::string& data)
+{
+    const auto fd = socket(AF_INET, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    sockaddr_in address{};
+    address.sin_family = AF_INET;
+    address.sin_port = htons(port);
+    address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    if (connect(fd, reinterpret_cast<sockaddr*>(&address), sizeof(address)))
+        throw std::runtime_error("cannot connect");
+
+    std::thread writer{[fd, &data] {
+        for (std::size_t sent = 0; sent < data.size();)
+        {
+            const auto written = send(fd, data.data() + sent, data.size() - sent, MSG_NOSIGNAL);
+            if (written <= 0)
+                break;
+            sent += written;
+        }
+        shutdown(fd, SHUT_WR);
+    }};
+
+    std::string received;
+    char buffer[4096];
+    for (ssize_t count; (count = read(fd, buffer, sizeof(buffer))) > 0;)
+        received.append(buffer, count);
+
+    writer.join();
+    close(fd);
+    return received;
+}
+
+// Connections are taken in the event loop, which is to keep going while the client waits on them
+std::string round_trip_through_event_loop(quint16 port, const std::string& data)
+{
+    std::string received;
+    std::atomic_bool done{false};
+    std::thread client{[&] {
+        received = round_trip(port, data);
+        done = true;
+    }};
+
+    const auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(10);
+    while (!done && std::chrono::steady_clock::now() < deadline)
+        QCoreApplication::processEvents(QEventLoop::AllEvents, 10);
+
+    client.join();
+    return received;
+}
+
+struct PortForwarder : public Test
+{
+    PortForwarder()
+    {
+        echo_fd = listening_socket(echo_port);
+        echo = std::thread{[this] {
+            const auto fd = accept(echo_fd, nullptr, nullptr);
+            char buffer[4096];
+            for (ssize_t count; (count = read(fd, buffer, sizeof(buffer))) > 0;)
+                for (ssize_t sent = 0; sent < count;)
+                    sent += write(fd, buffer + sent, count - sent);
+            close(fd);
+        }};
+    }
+
+    ~PortForwarder() override
+    {
+        shutdown(echo_fd, SHUT_RDWR); // wakes the echo server if nothing connected
+        echo.join();
+        close(echo_fd);
+    }
+
+    quint16 echo_port{0};
+    int echo_fd;
+    std::thread echo;
+};
+} // namespace
+
+TEST_F(PortForwarder, relaysBothWays)
+{
+    mp::PortForwarder forwarder{0, [] { return std::string{"127.0.0.1"}; }, echo_port};
+
+    std::string data(1024 * 1024, '\0');
+    for (std::size_t i = 0; i < data.size(); ++i)
+        data[i] = static_cast<char>(i * 7);
+
+    EXPECT_EQ(round_trip_through_event_loop(forwarder.host_port(), data), data);
+}
+
+TEST_F(PortForwarder, dropsConnectionsWithNowhereToGo)
+{
+    mp::PortForwarder forwarder{0, []() -> std::string { throw std::runtime_error{"not running"}; }, echo_port};
+
+    EXPECT_THAT(round_trip_through_event_loop(forwarder.host_port(), "hello"), IsEmpty());
+}
+
+TEST_F(PortForwarder, throwsWhenThePortIsTaken)
+{
+    mp::PortForwarder forwarder{0, [] { return std::string{"127.0.0.1"}; }, echo_port};
+
+    EXPECT_THROW((mp::PortForwarder{forwarder.host_port(), [] { return std::string{"127.0.0.1"}; }, echo_port}),
+                 std::runtime_error);
+}
+
+TEST_F(PortForwarder, looksUpTheAddressOnTheThreadItWasMadeOn)
+{
+    const auto made_on = std::this_thread::get_id();
+    std::atomic_bool looked_up_elsewhere{false};
+    mp::PortForwarder forwarder{0,
+                                [made_on, &looked_up_elsewhere] {
+                                    looked_up_elsewhere = std::this_thread::get_id() != made_on;
+                                    return std::string{"127.0.0.1"};
+                                },
+                                echo_port};
+
+    EXPECT_EQ(round_trip_through_event_loop(forwarder.host_port(), "hello"), "hello");
+    EXPECT_FALSE(looked_up_elsewhere);
+}
@@ -0,0 +1,61 @@
+/*
+ * Copyright (C) Canonical, Ltd.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; version 3.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#include "tests/common.h"
+#include "tests/temp_dir.h"
+
+#include <src/daemon/profiler.h>
+
+#include <QFile>
+
+namespace mp = multipass;
+namespace mpt = multipass::test;
+
+using namespace testing;
+
+namespace
+{
+struct ProfileCaptureTest : public Test
+{
+    mpt::TempDir temp_dir;
+    QString directory{temp_dir.filePath("profiles")};
+};
+
+#if !MULTIPASS_PROFILER_GPERFTOOLS && !MULTIPASS_PROFILER_JEMALLOC
+TEST_F(ProfileCaptureTest, writesHeapStatisticsWithoutAProfilerBuiltIn)
+{
+    mp::daemon::ProfileCapture capture{directory};
+    const auto files = capture.finish();
+
+    ASSERT_THAT(files, SizeIs(1));
+    EXPECT_THAT(files.front().toStdString(), EndsWith(".malloc_info.xml"));
+    EXPECT_TRUE(files.front().startsWith(directory));
+
+    QFile file{files.front()};
+    ASSERT_TRUE(file.open(QIODevice::ReadOnly));
+    EXPECT_THAT(file.readAll().toStdString(), HasSubstr("<malloc"));
+}
+#endif
+
+TEST_F(ProfileCaptureTest, finishesOnce)
+{
+    mp::daemon::ProfileCapture capture{directory};
+    capture.finish();
+
+    EXPECT_THAT(capture.finish(), IsEmpty());
+}
+} // namespace
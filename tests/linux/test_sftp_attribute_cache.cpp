@@ -0,0 +1,160 @@
+/*
+ * Copyright (C) Canonical, Ltd.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; version 3.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#include "tests/common.h"
+#include "tests/file_operations.h"
+#include "tests/temp_dir.h"
+
+#include <src/sshfs_mount/sftp_attribute_cache.h>
+
+#include <QDir>
+#include <QFile>
+
+#include <cerrno>
+#include <chrono>
+#include <functional>
+#include <thread>
+
+#include <unistd.h>
+
+namespace mp = multipass;
+namespace mpt = multipass::test;
+
+using namespace std::chrono_literals;
+using namespace testing;
+
+namespace
+{
+struct SftpAttributeCache : public Test
+{
+    void SetUp() override
+    {
+        if (!cache.enabled())
+            GTEST_SKIP() << "inotify is not available";
+    }
+
+    // Changes are picked up asynchronously
+    bool eventually(const std::function<bool()>& condition)
+    {
+        for (auto deadline = std::chrono::steady_clock::now() + 5s; std::chrono::steady_clock::now() < deadline;)
+        {
+            if (condition())
+                return true;
+            std::this_thread::sleep_for(10ms);
+        }
+        return condition();
+    }
+
+    qint64 cached_size(const QString& path)
+    {
+        struct stat st
+        {
+        };
+        return cache.lstat(path.toStdString(), st) == 0 ? st.st_size : -1;
+    }
+
+    void append(const QString& path, const QByteArray& data)
+    {
+        QFile file{path};
+        ASSERT_TRUE(file.open(QIODevice::Append));
+        ASSERT_EQ(file.write(data), data.size());
+    }
+
+    mpt::TempDir temp_dir;
+    mp::SftpAttributeCache cache;
+};
+} // namespace
+
+TEST_F(SftpAttributeCache, serves_attributes_from_the_cache)
+{
+    // Changes made through a link elsewhere are not reported for this directory, which gives away the cache
+    QDir{temp_dir.path()}.mkpath("a");
+    QDir{temp_dir.path()}.mkpath("b");
+    const auto file_name = temp_dir.path() + "/a/file";
+    const auto link_name = temp_dir.path() + "/b/link";
+    mpt::make_file_with_content(file_name, "12345");
+    ASSERT_EQ(::link(file_name.toStdString().c_str(), link_name.toStdString().c_str()), 0);
+
+    EXPECT_EQ(cached_size(file_name), 5);
+
+    append(link_name, "678");
+    std::this_thread::sleep_for(100ms);
+
+    EXPECT_EQ(cached_size(file_name), 5);
+
+    cache.invalidate(file_name.toStdString());
+    EXPECT_EQ(cached_size(file_name), 8);
+}
+
+TEST_F(SftpAttributeCache, picks_up_changes_to_a_file)
+{
+    const auto file_name = temp_dir.path() + "/file";
+    mpt::make_file_with_content(file_name, "12345");
+
+    EXPECT_EQ(cached_size(file_name), 5);
+
+    append(file_name, "678");
+
+    EXPECT_TRUE(eventually([&] { return cached_size(file_name) == 8; }));
+}
+
+TEST_F(SftpAttributeCache, remembers_missing_files_until_they_appear)
+{
+    const auto file_name = temp_dir.path() + "/file";
+
+    struct stat st
+    {
+    };
+    EXPECT_EQ(cache.lstat(file_name.toStdString(), st), -1);
+    EXPECT_EQ(errno, ENOENT);
+
+    mpt::make_file_with_content(file_name, "12345");
+
+    EXPECT_TRUE(eventually([&] { return cached_size(file_name) == 5; }));
+}
+
+TEST_F(SftpAttributeCache, forgets_what_was_under_a_renamed_directory)
+{
+    QDir{temp_dir.path()}.mkpath("dir/sub");
+    const auto file_name = temp_dir.path() + "/dir/sub/file";
+    mpt::make_file_with_content(file_name, "12345");
+
+    EXPECT_EQ(cached_size(file_name), 5);
+
+    ASSERT_TRUE(QDir{temp_dir.path()}.rename("dir", "other"));
+
+    EXPECT_TRUE(eventually([&] { return cached_size(file_name) == -1; }));
+    EXPECT_EQ(cached_size(temp_dir.path() + "/other/sub/file"), 5);
+}
+
+TEST_F(SftpAttributeCache, stat_follows_symlinks)
+{
+    const auto file_name = temp_dir.path() + "/file";
+    const auto link_name = temp_dir.path() + "/link";
+    mpt::make_file_with_content(file_name, "12345");
+    ASSERT_TRUE(QFile::link(file_name, link_name));
+
+    struct stat st
+    {
+    };
+    ASSERT_EQ(cache.lstat(link_name.toStdString(), st), 0);
+    EXPECT_TRUE(S_ISLNK(st.st_mode));
+
+    ASSERT_EQ(cache.stat(link_name.toStdString(), st), 0);
+    EXPECT_TRUE(S_ISREG(st.st_mode));
+    EXPECT_EQ(st.st_size, 5);
+}
@@ -0,0 +1,95 @@
+/*
+ * Copyright (C) Canonical, Ltd.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; version 3.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#include "tests/common.h"
+#include "tests/mock_logger.h"
+
+#include <src/platform/backends/shared/linux/spawned_process.h>
+
+#include <multipass/process/simple_process_spec.h>
+
+namespace mp = multipass;
+namespace mpt = multipass::test;
+
+using namespace testing;
+
+namespace
+{
+struct SpawnedProcess : public Test
+{
+    mpt::MockLogger::Scope logger_scope = mpt::MockLogger::inject();
+};
+} // namespace
+
+TEST_F(SpawnedProcess, collects_output_and_exit_code)
+{
+    mp::SpawnedProcess process{mp::oneshot_process_spec("sh", {"-c", "echo out; echo err >&2; exit 3"})};
+
+    const auto state = process.execute();
+
+    ASSERT_TRUE(state.exit_code);
+    EXPECT_EQ(*state.exit_code, 3);
+    EXPECT_FALSE(state.error);
+    EXPECT_FALSE(process.running());
+    EXPECT_EQ(process.read_all_standard_output(), "out\n");
+    EXPECT_EQ(process.read_all_standard_error(), "err\n");
+}
+
+TEST_F(SpawnedProcess, merges_channels_when_asked)
+{
+    mp::SpawnedProcess process{mp::oneshot_process_spec("sh", {"-c", "echo out; echo err >&2"})};
+    process.set_process_channel_mode(QProcess::MergedChannels);
+
+    EXPECT_TRUE(process.execute().completed_successfully());
+    EXPECT_EQ(process.read_all_standard_output(), "out\nerr\n");
+}
+
+TEST_F(SpawnedProcess, feeds_what_is_written_to_the_program)
+{
+    mp::SpawnedProcess process{mp::oneshot_process_spec("cat")};
+
+    process.start();
+    ASSERT_TRUE(process.wait_for_started());
+    EXPECT_EQ(process.write("piped"), 5);
+    process.close_write_channel();
+
+    EXPECT_TRUE(process.wait_for_finished());
+    EXPECT_TRUE(process.process_state().completed_successfully());
+    EXPECT_EQ(process.read_all_standard_output(), "piped");
+}
+
+TEST_F(SpawnedProcess, reports_programs_it_cannot_find)
+{
+    mp::SpawnedProcess process{mp::oneshot_process_spec("no-such-program-anywhere")};
+
+    const auto state = process.execute();
+
+    ASSERT_TRUE(state.error);
+    EXPECT_EQ(state.error->state, QProcess::FailedToStart);
+    EXPECT_FALSE(process.running());
+}
+
+TEST_F(SpawnedProcess, times_out_and_kills_what_runs_too_long)
+{
+    mp::SpawnedProcess process{mp::oneshot_process_spec("sleep", {"10"})};
+
+    const auto state = process.execute(50);
+
+    ASSERT_TRUE(state.error);
+    EXPECT_EQ(state.error->state, QProcess::Timedout);
+    EXPECT_FALSE(process.running());
+}
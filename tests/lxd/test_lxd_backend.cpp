@@ -29,6 +29,7 @@
 #include "tests/stub_url_downloader.h"
 #include "tests/temp_dir.h"
 
+#include <src/platform/backends/lxd/lxd_instance_templates.h>
 #include <src/platform/backends/lxd/lxd_virtual_machine.h>
 #include <src/platform/backends/lxd/lxd_virtual_machine_factory.h>
 #include <src/platform/backends/lxd/lxd_vm_image_vault.h>
@@ -41,6 +42,7 @@
 #include <multipass/network_interface_info.h>
 #include <multipass/virtual_machine_description.h>
 
+#include <QJsonArray>
 #include <QJsonDocument>
 #include <QString>
 #include <QUrl>
@@ -394,7 +396,8 @@ TEST_F(LXDBackend, factory_creates_expected_image_vault)
 
     mp::LXDVirtualMachineFactory backend{std::move(mock_network_access_manager), data_dir.path(), base_url};
 
-    auto vault = backend.create_image_vault(hosts, &stub_downloader, cache_dir.path(), data_dir.path(), mp::days{0});
+    auto vault = backend.create_image_vault(hosts, &stub_downloader, cache_dir.path(), data_dir.path(), mp::days{0},
+                                            mp::vault::BlobStore{cache_dir.filePath("blobs")});
 
     EXPECT_TRUE(dynamic_cast<mp::LXDVMImageVault*>(vault.get()));
 }
@@ -887,6 +890,75 @@ TEST_F(LXDBackend, posts_expected_data_when_creating_instance)
                                   bridge_name,         default_storage_pool};
 }
 
+TEST_F(LXDBackend, clones_instances_from_one_template_per_image)
+{
+    mpt::StubVMStatusMonitor stub_monitor;
+    default_description.image.id = "ab12cd34ef56ab12cd34ef56";
+    const QString template_name{"multipass-template-ab12cd34ef56ab12"};
+
+    std::vector<QJsonObject> posted;
+    QStringList created;
+
+    EXPECT_CALL(*mock_network_access_manager, createRequest(_, _, _))
+        .WillRepeatedly([&](auto, auto request, auto outgoingData) {
+            outgoingData->open(QIODevice::ReadOnly);
+            auto data = outgoingData->readAll();
+            auto op = request.attribute(QNetworkRequest::CustomVerbAttribute).toString();
+            auto url = request.url().toString();
+
+            if (op == "POST" && url.contains("1.0/virtual-machines"))
+            {
+                posted.push_back(QJsonDocument::fromJson(data).object());
+                return new mpt::MockLocalSocketReply(mpt::create_vm_data);
+            }
+            else if (op == "GET" && url.contains("1.0/operations/0020444c-2e4c-49d5-83ed-3275e3f6d005"))
+            {
+                created.push_back(posted.back()["name"].toString());
+                return new mpt::MockLocalSocketReply(mpt::create_vm_finished_data);
+            }
+            else if (op == "GET" && std::any_of(created.cbegin(), created.cend(), [&url](const auto& name) {
+                         return url.contains("1.0/virtual-machines/" + name);
+                     }))
+            {
+                return new mpt::MockLocalSocketReply(mpt::vm_info_data);
+            }
+
+            return new mpt::MockLocalSocketReply(mpt::not_found_data, QNetworkReply::ContentNotFoundError);
+        });
+
+    auto other_description = default_description;
+    other_description.vm_name = "hooli";
+
+    auto manager = mock_network_access_manager.get();
+    mp::LXDInstanceTemplates templates{manager, base_url};
+
+    mp::LXDVirtualMachine first{default_description, stub_monitor, manager, base_url, bridge_name,
+                                default_storage_pool, nullptr,      &templates};
+    mp::LXDVirtualMachine second{other_description,   stub_monitor, manager, base_url, bridge_name,
+                                 default_storage_pool, nullptr,     &templates};
+
+    ASSERT_EQ(posted.size(), 3u);
+    EXPECT_EQ(posted[0]["name"].toString(), template_name);
+    EXPECT_EQ(posted[0]["source"].toObject()["fingerprint"].toString(), "ab12cd34ef56ab12cd34ef56");
+    EXPECT_EQ(posted[0]["devices"].toObject()["root"].toObject()["pool"].toString(), default_storage_pool);
+
+    for (const auto i : {1, 2})
+    {
+        const auto source = posted[i]["source"].toObject();
+        EXPECT_EQ(source["type"].toString(), "copy");
+        EXPECT_EQ(source["source"].toString(), template_name);
+        EXPECT_TRUE(source["instance_only"].toBool());
+        EXPECT_EQ(posted[i]["devices"].toObject()["eth0"].toObject()["hwaddr"].toString(), "00:16:3e:fe:f2:b9");
+    }
+}
+
+TEST_F(LXDBackend, only_clones_from_templates_on_pools_that_optimize_images)
+{
+    EXPECT_TRUE(mp::LXDInstanceTemplates::pay_off_with("zfs"));
+    EXPECT_TRUE(mp::LXDInstanceTemplates::pay_off_with("btrfs"));
+    EXPECT_FALSE(mp::LXDInstanceTemplates::pay_off_with("dir"));
+}
+
 TEST_F(LXDBackend, prepare_source_image_does_not_modify)
 {
     mp::LXDVirtualMachineFactory backend{std::move(mock_network_access_manager), data_dir.path(), base_url};
@@ -1185,6 +1257,63 @@ TEST_F(LXDBackend, no_ip_address_returns_unknown)
     EXPECT_EQ(machine.management_ipv4(), "UNKNOWN");
 }
 
+TEST_F(LXDBackend, refreshes_states_of_all_instances_at_once)
+{
+    mpt::StubVMStatusMonitor stub_monitor;
+    auto state_requests = 0, listing_requests = 0;
+
+    auto instance = [](const QString& name, const QString& hwaddr, int status_code) {
+        QJsonObject address{{"address", "10.217.27.168"}, {"family", "inet"}, {"scope", "global"}};
+        QJsonObject network{{"eth0", QJsonObject{{"hwaddr", hwaddr}, {"addresses", QJsonArray{address}}}}};
+        return QJsonObject{{"name", name},
+                           {"state", QJsonObject{{"status_code", status_code}, {"network", network}}}};
+    };
+    const auto listing = QJsonDocument{QJsonObject{
+        {"metadata", QJsonArray{instance("pied-piper-valley", "00:16:3e:fe:f2:b9", 103),
+                                instance("hooli", "00:16:3e:fe:f2:ba", 102)}}}}.toJson();
+
+    EXPECT_CALL(*mock_network_access_manager, createRequest(_, _, _))
+        .WillRepeatedly([&](auto, auto request, auto) -> QNetworkReply* {
+            auto url = request.url().toString();
+
+            if (url.contains("1.0/virtual-machines?recursion=2"))
+            {
+                ++listing_requests;
+                return new mpt::MockLocalSocketReply(listing);
+            }
+            else if (url.contains("/state"))
+            {
+                // Not reached when the instances are created, so that their state is not fresh
+                if (++state_requests <= 2)
+                    throw mp::LocalSocketConnectionException("Cannot connect");
+
+                return new mpt::MockLocalSocketReply(mpt::vm_state_stopped_data);
+            }
+
+            return new mpt::MockLocalSocketReply(mpt::not_found_data, QNetworkReply::ContentNotFoundError);
+        });
+
+    auto manager = mock_network_access_manager.get();
+    mp::LXDVirtualMachineFactory backend{std::move(mock_network_access_manager), data_dir.path(), base_url};
+
+    auto other_description = default_description;
+    other_description.vm_name = "hooli";
+    other_description.default_mac_address = "00:16:3e:fe:f2:ba";
+
+    mp::LXDVirtualMachine first{default_description, stub_monitor, manager, base_url, bridge_name,
+                                default_storage_pool};
+    mp::LXDVirtualMachine second{other_description, stub_monitor, manager, base_url, bridge_name,
+                                 default_storage_pool};
+
+    backend.refresh_states({&first, &second});
+
+    EXPECT_EQ(listing_requests, 1);
+    EXPECT_EQ(first.cached_state(), mp::VirtualMachine::State::running);
+    EXPECT_EQ(second.cached_state(), mp::VirtualMachine::State::stopped);
+    EXPECT_EQ(first.management_ipv4(), "10.217.27.168");
+    EXPECT_EQ(state_requests, 2);
+}
+
 TEST_F(LXDBackend, lxd_request_timeout_aborts_and_throws)
 {
     EXPECT_CALL(*mock_network_access_manager, createRequest(_, _, _)).WillOnce([](auto...) {
@@ -1209,6 +1338,57 @@ TEST_F(LXDBackend, lxd_request_timeout_aborts_and_throws)
                          std::runtime_error, mpt::match_what(HasSubstr(error_string)));
 }
 
+TEST_F(LXDBackend, lxd_request_async_sends_requests_before_any_reply_is_in)
+{
+    std::vector<mpt::MockLocalSocketReply*> replies;
+    EXPECT_CALL(*mock_network_access_manager, createRequest(_, _, _)).Times(2).WillRepeatedly([&replies](auto...) {
+        auto reply = new mpt::MockLocalSocketReply(mpt::lxd_server_info_data);
+        reply->setFinished(false);
+        replies.push_back(reply);
+
+        return reply;
+    });
+
+    auto first = mp::lxd_request_async(mock_network_access_manager.get(), "GET", base_url);
+    auto second = mp::lxd_request_async(mock_network_access_manager.get(), "GET", base_url);
+
+    ASSERT_EQ(replies.size(), 2u);
+    EXPECT_FALSE(first.is_done());
+    EXPECT_FALSE(second.is_done());
+
+    for (auto reply : replies)
+    {
+        reply->setFinished(true);
+        emit reply->finished();
+    }
+
+    EXPECT_TRUE(first.is_done());
+    EXPECT_TRUE(second.is_done());
+    EXPECT_EQ(second.wait()["metadata"].toObject()["auth"].toString(), "trusted");
+}
+
+TEST_F(LXDBackend, lxd_request_async_times_out_and_throws_on_wait)
+{
+    EXPECT_CALL(*mock_network_access_manager, createRequest(_, _, _)).WillOnce([](auto...) {
+        auto reply = new mpt::MockLocalSocketReply(QByteArray{});
+        reply->setFinished(false);
+
+        return reply;
+    });
+
+    base_url.setHost("test");
+
+    const std::string error_string{
+        fmt::format("Timeout getting response for GET operation on {}", base_url.toString().toStdString())};
+
+    EXPECT_CALL(*logger_scope.mock_logger,
+                log(Eq(mpl::Level::error), mpt::MockLogger::make_cstring_matcher(StrEq("lxd request")),
+                    mpt::MockLogger::make_cstring_matcher(HasSubstr(error_string))));
+
+    auto pending = mp::lxd_request_async(mock_network_access_manager.get(), "GET", base_url, std::nullopt, 3);
+    MP_EXPECT_THROW_THAT(pending.wait(), std::runtime_error, mpt::match_what(HasSubstr(error_string)));
+}
+
 TEST_F(LXDBackend, lxd_request_empty_data_returned_throws_and_logs)
 {
     EXPECT_CALL(*mock_network_access_manager, createRequest(_, _, _)).WillOnce([](auto...) {
@@ -1498,6 +1678,52 @@ TEST_F(LXDBackend, lxd_wait_metadata_status_code_failure_returned_throws_and_log
                          std::runtime_error, mpt::match_what(error_matcher));
 }
 
+TEST_F(LXDBackend, limits_patch_the_devices_they_are_on)
+{
+    mpt::StubVMStatusMonitor stub_monitor;
+    std::vector<QJsonObject> patched;
+
+    EXPECT_CALL(*mock_network_access_manager, createRequest(_, _, _))
+        .WillRepeatedly([&patched](auto, auto request, auto outgoingData) {
+            auto op = request.attribute(QNetworkRequest::CustomVerbAttribute).toString();
+            auto url = request.url().toString();
+
+            if (op == "GET" && url.contains("1.0/virtual-machines/pied-piper-valley/state"))
+                return new mpt::MockLocalSocketReply(mpt::vm_state_stopped_data);
+
+            if (url.contains("1.0/virtual-machines/pied-piper-valley"))
+            {
+                if (op == "GET")
+                    return new mpt::MockLocalSocketReply(mpt::vm_info_data);
+
+                if (op == "PATCH")
+                {
+                    outgoingData->open(QIODevice::ReadOnly);
+                    patched.push_back(QJsonDocument::fromJson(outgoingData->readAll()).object()["devices"].toObject());
+                    return new mpt::MockLocalSocketReply(mpt::vm_info_data);
+                }
+            }
+
+            return new mpt::MockLocalSocketReply(mpt::not_found_data, QNetworkReply::ContentNotFoundError);
+        });
+
+    mp::LXDVirtualMachine machine{default_description, stub_monitor,        mock_network_access_manager.get(), base_url,
+                                  bridge_name,         default_storage_pool};
+
+    machine.set_network_limit(100);
+    machine.set_disk_iops_limit(500);
+
+    ASSERT_EQ(patched.size(), 2u);
+    const auto eth0 = patched[0]["eth0"].toObject();
+    EXPECT_EQ(eth0["limits.ingress"].toString(), "100Mbit");
+    EXPECT_EQ(eth0["limits.egress"].toString(), "100Mbit");
+    EXPECT_EQ(eth0["name"].toString(), "eth0"); // the rest of the device kept
+
+    const auto root = patched[1]["root"].toObject();
+    EXPECT_EQ(root["limits.read"].toString(), "500iops");
+    EXPECT_EQ(root["size"].toString(), "16106127360");
+}
+
 TEST_F(LXDBackend, unsupported_suspend_throws)
 {
     mpt::StubVMStatusMonitor stub_monitor;
@@ -1529,6 +1755,50 @@ TEST_F(LXDBackend, unsupported_suspend_throws)
                          mpt::match_what(StrEq("suspend is currently not supported")));
 }
 
+TEST_F(LXDBackend, guest_ipv4_comes_from_the_instance_state)
+{
+    mpt::StubVMStatusMonitor stub_monitor;
+
+    EXPECT_CALL(*mock_network_access_manager, createRequest(_, _, _))
+        .WillRepeatedly([](auto, auto request, auto) {
+            auto op = request.attribute(QNetworkRequest::CustomVerbAttribute).toString();
+            auto url = request.url().toString();
+
+            if (op == "GET" && url.contains("1.0/virtual-machines/pied-piper-valley/state"))
+                return new mpt::MockLocalSocketReply(mpt::vm_state_fully_running_data);
+
+            return new mpt::MockLocalSocketReply(mpt::not_found_data, QNetworkReply::ContentNotFoundError);
+        });
+
+    mp::LXDVirtualMachine machine{default_description, stub_monitor,        mock_network_access_manager.get(), base_url,
+                                  bridge_name,         default_storage_pool};
+
+    const auto ipv4 = machine.guest_ipv4();
+    ASSERT_TRUE(ipv4);
+    EXPECT_THAT(*ipv4, ElementsAre("10.217.27.168"));
+}
+
+TEST_F(LXDBackend, guest_ipv4_is_left_to_ssh_without_network_state)
+{
+    mpt::StubVMStatusMonitor stub_monitor;
+
+    EXPECT_CALL(*mock_network_access_manager, createRequest(_, _, _))
+        .WillRepeatedly([](auto, auto request, auto) {
+            auto op = request.attribute(QNetworkRequest::CustomVerbAttribute).toString();
+            auto url = request.url().toString();
+
+            if (op == "GET" && url.contains("1.0/virtual-machines/pied-piper-valley/state"))
+                return new mpt::MockLocalSocketReply(mpt::vm_state_stopped_data);
+
+            return new mpt::MockLocalSocketReply(mpt::not_found_data, QNetworkReply::ContentNotFoundError);
+        });
+
+    mp::LXDVirtualMachine machine{default_description, stub_monitor,        mock_network_access_manager.get(), base_url,
+                                  bridge_name,         default_storage_pool};
+
+    EXPECT_EQ(machine.guest_ipv4(), std::nullopt);
+}
+
 TEST_F(LXDBackend, start_while_frozen_unfreezes)
 {
     mpt::StubVMStatusMonitor stub_monitor;
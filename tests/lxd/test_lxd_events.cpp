@@ -0,0 +1,194 @@
+/*
+ * Copyright (C) Canonical, Ltd.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; version 3.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#include "tests/common.h"
+#include "tests/temp_dir.h"
+
+#include "src/platform/backends/lxd/lxd_events.h"
+
+#include <QCryptographicHash>
+#include <QJsonArray>
+#include <QJsonDocument>
+#include <QLocalServer>
+#include <QLocalSocket>
+#include <QRegularExpression>
+
+#include <memory>
+#include <thread>
+
+namespace mp = multipass;
+namespace mpt = multipass::test;
+
+using namespace std::chrono_literals;
+using namespace testing;
+
+namespace
+{
+// Stands in for LXD's socket, answering the websocket handshake and sending unmasked text frames
+struct FakeLXDEventsServer
+{
+    FakeLXDEventsServer()
+    {
+        server.listen(temp_dir.filePath("lxd.socket"));
+    }
+
+    QUrl url() const
+    {
+        return QUrl{QString{"unix://%1@1.0"}.arg(server.fullServerName())};
+    }
+
+    void accept()
+    {
+        ASSERT_TRUE(server.waitForNewConnection(5000));
+        connection.reset(server.nextPendingConnection());
+
+        QByteArray request;
+        while (!request.contains("\r\n\r\n") && connection->waitForReadyRead(5000))
+            request.append(connection->readAll());
+
+        ASSERT_THAT(request.toStdString(), HasSubstr("GET /1.0/events?type=operation,lifecycle&project=multipass"));
+
+        const auto key = QRegularExpression{"Sec-WebSocket-Key: (\\S+)"}.match(request).captured(1).toLatin1();
+        const auto accept =
+            QCryptographicHash::hash(key + "258EAFA5-E914-47DA-95CA-C5AB0DC85B11", QCryptographicHash::Sha1);
+        connection->write("HTTP/1.1 101 Switching Protocols\r\n"
+                          "Upgrade: websocket\r\n"
+                          "Connection: Upgrade\r\n"
+                          "Sec-WebSocket-Accept: " +
+                          accept.toBase64() + "\r\n\r\n");
+        connection->waitForBytesWritten(5000);
+    }
+
+    void send(const QJsonObject& event)
+    {
+        const auto payload = QJsonDocument{event}.toJson(QJsonDocument::Compact);
+
+        QByteArray frame{1, static_cast<char>(0x81)};
+        if (payload.size() < 126)
+            frame.append(static_cast<char>(payload.size()));
+        else
+        {
+            frame.append(static_cast<char>(126));
+            frame.append(static_cast<char>(payload.size() >> 8));
+            frame.append(static_cast<char>(payload.size() & 0xff));
+        }
+        frame.append(payload);
+
+        connection->write(frame);
+        connection->waitForBytesWritten(5000);
+    }
+
+    mpt::TempDir temp_dir;
+    QLocalServer server;
+    std::unique_ptr<QLocalSocket> connection;
+};
+
+QJsonObject operation_event(const QString& id, int status_code, const QString& instance = "pied-piper-valley")
+{
+    return QJsonObject{
+        {"type", "operation"},
+        {"metadata",
+         QJsonObject{{"id", id},
+                     {"status_code", status_code},
+                     {"resources", QJsonObject{{"instances", QJsonArray{"/1.0/instances/" + instance}}}}}}};
+}
+
+std::optional<std::uint64_t> wait_for_mark(const mp::LXDEvents& events)
+{
+    for (auto i = 0; i < 500 && !events.mark(); ++i)
+        std::this_thread::sleep_for(10ms);
+
+    return events.mark();
+}
+
+struct LXDEvents : public Test
+{
+    FakeLXDEventsServer server;
+};
+} // namespace
+
+TEST_F(LXDEvents, waitsForReportedOperations)
+{
+    mp::LXDEvents events{server.url()};
+    server.accept();
+    ASSERT_TRUE(wait_for_mark(events));
+
+    server.send(operation_event("b43c2c7c", 103));
+    server.send(operation_event("b43c2c7c", 200));
+
+    std::uint64_t seen{0};
+    auto operation = events.wait_for_operation("b43c2c7c", seen, 5s);
+    ASSERT_TRUE(operation);
+
+    while (operation->value("status_code").toInt() != 200)
+    {
+        operation = events.wait_for_operation("b43c2c7c", seen, 5s);
+        ASSERT_TRUE(operation);
+    }
+
+    EXPECT_EQ(operation->value("id").toString(), "b43c2c7c");
+    EXPECT_FALSE(events.wait_for_operation("b43c2c7c", seen, 10ms));
+}
+
+TEST_F(LXDEvents, tellsInstancesThatChangedSinceMark)
+{
+    mp::LXDEvents events{server.url()};
+    server.accept();
+
+    const auto mark = wait_for_mark(events);
+    ASSERT_TRUE(mark);
+    EXPECT_TRUE(events.unchanged_since("pied-piper-valley", *mark));
+
+    const auto source = "/1.0/instances/pied-piper-valley?project=multipass";
+    server.send(QJsonObject{{"type", "lifecycle"},
+                            {"metadata", QJsonObject{{"action", "instance-stopped"}, {"source", source}}}});
+    server.send(operation_event("a9f2e0b1", 200, "hooli"));
+
+    // Events are handled in order, so the lifecycle one has been by the time the operation is reported
+    std::uint64_t seen{0};
+    ASSERT_TRUE(events.wait_for_operation("a9f2e0b1", seen, 5s));
+
+    EXPECT_FALSE(events.unchanged_since("pied-piper-valley", *mark));
+    EXPECT_FALSE(events.unchanged_since("hooli", *mark));
+    EXPECT_TRUE(events.unchanged_since("gavin", *mark));
+}
+
+TEST_F(LXDEvents, reportsNothingWhenDisconnected)
+{
+    server.server.close();
+    mp::LXDEvents events{server.url()};
+
+    std::uint64_t seen{0};
+    EXPECT_FALSE(events.mark());
+    EXPECT_FALSE(events.unchanged_since("pied-piper-valley", 0));
+    EXPECT_FALSE(events.wait_for_operation("b43c2c7c", seen, 10ms));
+}
+
+TEST_F(LXDEvents, reportsNothingAfterServerHangsUp)
+{
+    mp::LXDEvents events{server.url()};
+    server.accept();
+    const auto mark = wait_for_mark(events);
+    ASSERT_TRUE(mark);
+
+    server.connection->disconnectFromServer();
+    server.server.close();
+
+    std::uint64_t seen{0};
+    EXPECT_FALSE(events.wait_for_operation("b43c2c7c", seen, 5s));
+    EXPECT_FALSE(events.unchanged_since("pied-piper-valley", *mark));
+}
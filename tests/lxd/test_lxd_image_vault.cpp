@@ -23,6 +23,8 @@
 #include "tests/mock_image_host.h"
 #include "tests/mock_logger.h"
 #include "tests/mock_process_factory.h"
+#include "tests/mock_url_downloader.h"
+#include "tests/path.h"
 #include "tests/stub_url_downloader.h"
 #include "tests/temp_dir.h"
 #include "tests/tracking_url_downloader.h"
@@ -35,6 +37,8 @@
 #include <multipass/format.h>
 #include <multipass/vm_image.h>
 
+#include <QCryptographicHash>
+#include <QDir>
 #include <QUrl>
 
 #include <vector>
@@ -71,6 +75,91 @@ struct LXDImageVault : public Test
     mpt::StubURLDownloader stub_url_downloader;
     mpt::TempDir cache_dir;
 };
+
+// What the xz images in the test data decode to
+QByteArray xz_test_image_content()
+{
+    QByteArray content;
+    for (auto i = 0; i < 300000; ++i)
+        content.append(char((i * 7 + i / 100) % 256));
+
+    return content;
+}
+
+QByteArray read_file(const QString& path)
+{
+    QFile file{path};
+    EXPECT_TRUE(file.open(QIODevice::ReadOnly));
+    return file.readAll();
+}
+
+// Makes the metadata tarball with a copy of its file, rather than running tar
+std::unique_ptr<mpt::MockProcessFactory::Scope> fake_tar()
+{
+    auto factory = mpt::MockProcessFactory::Inject();
+    factory->register_callback([](mpt::MockProcess* process) {
+        if (process->program().startsWith("tar"))
+        {
+            auto tar_args = process->arguments();
+            QFile output_file{tar_args[1]}, input_file{tar_args[3] + "/" + tar_args[4]};
+
+            output_file.open(QIODevice::WriteOnly);
+            input_file.open(QIODevice::ReadOnly);
+            output_file.write(input_file.readAll());
+
+            mp::ProcessState exit_state;
+            exit_state.exit_code = 0;
+            ON_CALL(*process, execute(_)).WillByDefault(Return(exit_state));
+        }
+    });
+
+    return factory;
+}
+
+void accept_image_uploads(mpt::MockNetworkAccessManager& manager)
+{
+    ON_CALL(manager, createRequest(_, _, _)).WillByDefault([](auto, auto request, auto) {
+        auto op = request.attribute(QNetworkRequest::CustomVerbAttribute).toString();
+        auto url = request.url().toString();
+
+        if (op == "POST" && url.contains("1.0/images"))
+            return new mpt::MockLocalSocketReply(mpt::image_upload_task_data);
+        else if (op == "GET" && url.contains("1.0/operations/dcce4fda-aab9-4117-89c1-9f42b8e3f4a8"))
+            return new mpt::MockLocalSocketReply(mpt::image_upload_task_complete_data);
+
+        return new mpt::MockLocalSocketReply(mpt::not_found_data, QNetworkReply::ContentNotFoundError);
+    });
+}
+
+struct LXDImageVaultXzDownload : public LXDImageVault
+{
+    LXDImageVaultXzDownload()
+    {
+        xz_image_info.image_location = "http://www.foo.com/images/foo.img.xz";
+        xz_image_info.id = QCryptographicHash::hash(xz_image, QCryptographicHash::Sha256).toHex();
+        xz_image_info.verify = true;
+        ON_CALL(host, info_for(_)).WillByDefault(Return(xz_image_info));
+
+        accept_image_uploads(*mock_network_access_manager);
+    }
+
+    // Hands the image over in pieces, the way it would come in
+    void serve_xz_image()
+    {
+        EXPECT_CALL(url_downloader, download_to).Times(0);
+        EXPECT_CALL(url_downloader, download_chunks(Eq(QUrl{xz_image_info.image_location}), _, _, _, _, _))
+            .WillOnce([this](auto&, const auto& chunk_action, auto&, auto, auto, auto&) {
+                for (auto pos = 0; pos < xz_image.size(); pos += 4096)
+                    chunk_action(xz_image.mid(pos, 4096));
+            });
+    }
+
+    mp::vault::BlobStore blobs{QDir{cache_dir.path()}.filePath("blobs")};
+    const QByteArray xz_image{read_file(mpt::test_data_path_for("multi_block.img.xz"))};
+    mp::VMImageInfo xz_image_info{host.mock_custom_image_info};
+    NiceMock<mpt::MockURLDownloader> url_downloader;
+    std::unique_ptr<mpt::MockProcessFactory::Scope> factory{fake_tar()};
+};
 } // namespace
 
 TEST_F(LXDImageVault, instance_exists_fetch_returns_expected_image_info)
@@ -1158,3 +1247,44 @@ TEST_F(LXDImageVault, updateImagesThrowsOnMissingImage)
     EXPECT_THROW(image_vault.update_images(mp::FetchType::ImageOnly, stub_prepare, stub_monitor),
                  mp::ImageNotFoundException);
 }
+
+TEST_F(LXDImageVaultXzDownload, decodes_xz_image_as_it_downloads_and_keeps_it_as_a_blob)
+{
+    serve_xz_image();
+
+    mp::LXDVMImageVault image_vault{hosts,    &url_downloader,  mock_network_access_manager.get(),
+                                    base_url, cache_dir.path(), mp::days{0}};
+    image_vault.fetch_image(mp::FetchType::ImageOnly, default_query, stub_prepare, stub_monitor, false, std::nullopt);
+
+    EXPECT_EQ(read_file(blobs.path_for(xz_image_info.id.toStdString())), xz_test_image_content());
+}
+
+TEST_F(LXDImageVaultXzDownload, links_xz_image_kept_as_a_blob_without_downloading_it)
+{
+    mpt::TempDir image_dir;
+    const auto kept_image = image_dir.path() + "/kept.img";
+    mpt::make_file_with_content(kept_image, xz_test_image_content().toStdString());
+    blobs.add(xz_image_info.id.toStdString(), kept_image);
+
+    EXPECT_CALL(url_downloader, download_to).Times(0);
+    EXPECT_CALL(url_downloader, download_chunks).Times(0);
+
+    mp::LXDVMImageVault image_vault{hosts,    &url_downloader,  mock_network_access_manager.get(),
+                                    base_url, cache_dir.path(), mp::days{0}};
+    image_vault.fetch_image(mp::FetchType::ImageOnly, default_query, stub_prepare, stub_monitor, false, std::nullopt);
+}
+
+TEST_F(LXDImageVaultXzDownload, throws_on_xz_image_hash_mismatch_and_keeps_no_blob)
+{
+    xz_image_info.id = QByteArray(64, 'a');
+    ON_CALL(host, info_for(_)).WillByDefault(Return(xz_image_info));
+    serve_xz_image();
+
+    mp::LXDVMImageVault image_vault{hosts,    &url_downloader,  mock_network_access_manager.get(),
+                                    base_url, cache_dir.path(), mp::days{0}};
+
+    MP_EXPECT_THROW_THAT(image_vault.fetch_image(mp::FetchType::ImageOnly, default_query, stub_prepare, stub_monitor,
+                                                 false, std::nullopt),
+                         std::runtime_error, mpt::match_what(StrEq("Downloaded image hash does not match")));
+    EXPECT_FALSE(QFile::exists(blobs.path_for(xz_image_info.id.toStdString())));
+}
@@ -35,6 +35,11 @@ QByteArray mpt::MischievousURLDownloader::download(const QUrl& url)
     return URLDownloader::download(choose_url(url));
 }
 
+std::optional<QByteArray> mpt::MischievousURLDownloader::download_if_changed(const QUrl& url, Validators& validators)
+{
+    return URLDownloader::download_if_changed(choose_url(url), validators);
+}
+
 QDateTime mpt::MischievousURLDownloader::last_modified(const QUrl& url)
 {
     return URLDownloader::last_modified(choose_url(url));
@@ -22,6 +22,8 @@
 
 #include <QUrl>
 
+#include <atomic>
+
 namespace multipass
 {
 namespace test
@@ -34,10 +36,11 @@ public:
     void download_to(const QUrl& url, const QString& file_name, int64_t size, const int download_type,
                      const ProgressMonitor& monitor) override;
     QByteArray download(const QUrl& url) override;
+    std::optional<QByteArray> download_if_changed(const QUrl& url, Validators& validators) override;
     QDateTime last_modified(const QUrl& url) override;
 
 public:
-    int mischiefs = 0;
+    std::atomic_int mischiefs = 0;
 
 private:
     const QUrl& choose_url(const QUrl& url);
@@ -34,6 +34,7 @@ public:
     MOCK_METHOD(std::string, get_subnet, (const Path&, const QString&), (const, override));
     MOCK_METHOD(void, check_for_kvm_support, (), (override));
     MOCK_METHOD(void, check_if_kvm_is_in_use, (), (override));
+    MOCK_METHOD(bool, service_spares_children, (), (override));
 
     MP_MOCK_SINGLETON_BOILERPLATE(MockBackend, Backend);
 };
@@ -46,6 +47,9 @@ public:
     MOCK_METHOD(int, close, (int), (const, override));
     MOCK_METHOD(int, ioctl, (int, unsigned long, unsigned long), (const, override));
     MOCK_METHOD(int, open, (const char*, mode_t), (const, override));
+    MOCK_METHOD(int, socket, (int, int, int), (const, override));
+    MOCK_METHOD(int, setsockopt, (int, int, int, const void*, socklen_t), (const, override));
+    MOCK_METHOD(ssize_t, sendto, (int, const void*, size_t, int, const sockaddr*, socklen_t), (const, override));
 
     MP_MOCK_SINGLETON_BOILERPLATE(MockLinuxSysCalls, LinuxSysCalls);
 };
@@ -188,6 +188,66 @@ public:
                 (override));
     MOCK_METHOD((grpc::ClientAsyncReaderWriterInterface<multipass::AuthenticateRequest, multipass::AuthenticateReply>*),
                 PrepareAsyncauthenticateRaw, (grpc::ClientContext * context, grpc::CompletionQueue* cq), (override));
+    MOCK_METHOD((grpc::ClientReaderWriterInterface<multipass::WatchRequest, multipass::WatchReply>*), watchRaw,
+                (grpc::ClientContext * context), (override));
+    MOCK_METHOD((grpc::ClientAsyncReaderWriterInterface<multipass::WatchRequest, multipass::WatchReply>*),
+                AsyncwatchRaw, (grpc::ClientContext * context, grpc::CompletionQueue* cq, void* tag), (override));
+    MOCK_METHOD((grpc::ClientAsyncReaderWriterInterface<multipass::WatchRequest, multipass::WatchReply>*),
+                PrepareAsyncwatchRaw, (grpc::ClientContext * context, grpc::CompletionQueue* cq), (override));
+    MOCK_METHOD((grpc::ClientReaderWriterInterface<multipass::MetricsRequest, multipass::MetricsReply>*), metricsRaw,
+                (grpc::ClientContext * context), (override));
+    MOCK_METHOD((grpc::ClientAsyncReaderWriterInterface<multipass::MetricsRequest, multipass::MetricsReply>*),
+                AsyncmetricsRaw, (grpc::ClientContext * context, grpc::CompletionQueue* cq, void* tag), (override));
+    MOCK_METHOD((grpc::ClientAsyncReaderWriterInterface<multipass::MetricsRequest, multipass::MetricsReply>*),
+                PrepareAsyncmetricsRaw, (grpc::ClientContext * context, grpc::CompletionQueue* cq), (override));
+    MOCK_METHOD((grpc::ClientReaderWriterInterface<multipass::ConsoleLogRequest, multipass::ConsoleLogReply>*),
+                console_logRaw, (grpc::ClientContext * context), (override));
+    MOCK_METHOD((grpc::ClientAsyncReaderWriterInterface<multipass::ConsoleLogRequest, multipass::ConsoleLogReply>*),
+                Asyncconsole_logRaw, (grpc::ClientContext * context, grpc::CompletionQueue* cq, void* tag), (override));
+    MOCK_METHOD((grpc::ClientAsyncReaderWriterInterface<multipass::ConsoleLogRequest, multipass::ConsoleLogReply>*),
+                PrepareAsyncconsole_logRaw, (grpc::ClientContext * context, grpc::CompletionQueue* cq), (override));
+    MOCK_METHOD((grpc::ClientReaderWriterInterface<multipass::CloneRequest, multipass::CloneReply>*), cloneRaw,
+                (grpc::ClientContext * context), (override));
+    MOCK_METHOD((grpc::ClientAsyncReaderWriterInterface<multipass::CloneRequest, multipass::CloneReply>*),
+                AsynccloneRaw, (grpc::ClientContext * context, grpc::CompletionQueue* cq, void* tag), (override));
+    MOCK_METHOD((grpc::ClientAsyncReaderWriterInterface<multipass::CloneRequest, multipass::CloneReply>*),
+                PrepareAsynccloneRaw, (grpc::ClientContext * context, grpc::CompletionQueue* cq), (override));
+    MOCK_METHOD((grpc::ClientReaderWriterInterface<multipass::CompactRequest, multipass::CompactReply>*), compactRaw,
+                (grpc::ClientContext * context), (override));
+    MOCK_METHOD((grpc::ClientAsyncReaderWriterInterface<multipass::CompactRequest, multipass::CompactReply>*),
+                AsynccompactRaw, (grpc::ClientContext * context, grpc::CompletionQueue* cq, void* tag), (override));
+    MOCK_METHOD((grpc::ClientAsyncReaderWriterInterface<multipass::CompactRequest, multipass::CompactReply>*),
+                PrepareAsynccompactRaw, (grpc::ClientContext * context, grpc::CompletionQueue* cq), (override));
+    MOCK_METHOD((grpc::ClientReaderWriterInterface<multipass::SnapshotRequest, multipass::SnapshotReply>*), snapshotRaw,
+                (grpc::ClientContext * context), (override));
+    MOCK_METHOD((grpc::ClientAsyncReaderWriterInterface<multipass::SnapshotRequest, multipass::SnapshotReply>*),
+                AsyncsnapshotRaw, (grpc::ClientContext * context, grpc::CompletionQueue* cq, void* tag), (override));
+    MOCK_METHOD((grpc::ClientAsyncReaderWriterInterface<multipass::SnapshotRequest, multipass::SnapshotReply>*),
+                PrepareAsyncsnapshotRaw, (grpc::ClientContext * context, grpc::CompletionQueue* cq), (override));
+    MOCK_METHOD((grpc::ClientReaderWriterInterface<multipass::RestoreRequest, multipass::RestoreReply>*), restoreRaw,
+                (grpc::ClientContext * context), (override));
+    MOCK_METHOD((grpc::ClientAsyncReaderWriterInterface<multipass::RestoreRequest, multipass::RestoreReply>*),
+                AsyncrestoreRaw, (grpc::ClientContext * context, grpc::CompletionQueue* cq, void* tag), (override));
+    MOCK_METHOD((grpc::ClientAsyncReaderWriterInterface<multipass::RestoreRequest, multipass::RestoreReply>*),
+                PrepareAsyncrestoreRaw, (grpc::ClientContext * context, grpc::CompletionQueue* cq), (override));
+    MOCK_METHOD((grpc::ClientReaderWriterInterface<multipass::ExecRequest, multipass::ExecReply>*), execRaw,
+                (grpc::ClientContext * context), (override));
+    MOCK_METHOD((grpc::ClientAsyncReaderWriterInterface<multipass::ExecRequest, multipass::ExecReply>*), AsyncexecRaw,
+                (grpc::ClientContext * context, grpc::CompletionQueue* cq, void* tag), (override));
+    MOCK_METHOD((grpc::ClientAsyncReaderWriterInterface<multipass::ExecRequest, multipass::ExecReply>*),
+                PrepareAsyncexecRaw, (grpc::ClientContext * context, grpc::CompletionQueue* cq), (override));
+    MOCK_METHOD((grpc::ClientReaderWriterInterface<multipass::ForwardRequest, multipass::ForwardReply>*), forwardRaw,
+                (grpc::ClientContext * context), (override));
+    MOCK_METHOD((grpc::ClientAsyncReaderWriterInterface<multipass::ForwardRequest, multipass::ForwardReply>*),
+                AsyncforwardRaw, (grpc::ClientContext * context, grpc::CompletionQueue* cq, void* tag), (override));
+    MOCK_METHOD((grpc::ClientAsyncReaderWriterInterface<multipass::ForwardRequest, multipass::ForwardReply>*),
+                PrepareAsyncforwardRaw, (grpc::ClientContext * context, grpc::CompletionQueue* cq), (override));
+    MOCK_METHOD((grpc::ClientReaderWriterInterface<multipass::ApplyRequest, multipass::ApplyReply>*), applyRaw,
+                (grpc::ClientContext * context), (override));
+    MOCK_METHOD((grpc::ClientAsyncReaderWriterInterface<multipass::ApplyRequest, multipass::ApplyReply>*),
+                AsyncapplyRaw, (grpc::ClientContext * context, grpc::CompletionQueue* cq, void* tag), (override));
+    MOCK_METHOD((grpc::ClientAsyncReaderWriterInterface<multipass::ApplyRequest, multipass::ApplyReply>*),
+                PrepareAsyncapplyRaw, (grpc::ClientContext * context, grpc::CompletionQueue* cq), (override));
 };
 } // namespace multipass::test
 
@@ -116,6 +116,43 @@ struct MockDaemon : public Daemon
                  (grpc::ServerReaderWriterInterface<AuthenticateReply, AuthenticateRequest>*),
                  std::promise<grpc::Status>*),
                 (override));
+    MOCK_METHOD(void, watch,
+                (const WatchRequest*, (grpc::ServerReaderWriterInterface<WatchReply, WatchRequest>*),
+                 std::promise<grpc::Status>*),
+                (override));
+    MOCK_METHOD(void, metrics,
+                (const MetricsRequest*, (grpc::ServerReaderWriterInterface<MetricsReply, MetricsRequest>*),
+                 std::promise<grpc::Status>*),
+                (override));
+    MOCK_METHOD(void, console_log,
+                (const ConsoleLogRequest*, (grpc::ServerReaderWriterInterface<ConsoleLogReply, ConsoleLogRequest>*),
+                 std::promise<grpc::Status>*),
+                (override));
+    MOCK_METHOD(void, clone,
+                (const CloneRequest*, (grpc::ServerReaderWriterInterface<CloneReply, CloneRequest>*),
+                 std::promise<grpc::Status>*),
+                (override));
+    MOCK_METHOD(void, compact,
+                (const CompactRequest*, (grpc::ServerReaderWriterInterface<CompactReply, CompactRequest>*),
+                 std::promise<grpc::Status>*),
+                (override));
+    MOCK_METHOD(void, snapshot,
+                (const SnapshotRequest*, (grpc::ServerReaderWriterInterface<SnapshotReply, SnapshotRequest>*),
+                 std::promise<grpc::Status>*),
+                (override));
+    MOCK_METHOD(void, restore,
+                (const RestoreRequest*, (grpc::ServerReaderWriterInterface<RestoreReply, RestoreRequest>*),
+                 std::promise<grpc::Status>*),
+                (override));
+    MOCK_METHOD(void, exec, (const ExecRequest*, ExecServer*, std::promise<grpc::Status>*), (override));
+    MOCK_METHOD(void, forward,
+                (const ForwardRequest*, (grpc::ServerReaderWriterInterface<ForwardReply, ForwardRequest>*),
+                 std::promise<grpc::Status>*),
+                (override));
+    MOCK_METHOD(void, apply,
+                (const ApplyRequest*, (grpc::ServerReaderWriterInterface<ApplyReply, ApplyRequest>*),
+                 std::promise<grpc::Status>*),
+                (override));
 
     template <typename Request, typename Reply>
     void set_promise_value(const Request*, grpc::ServerReaderWriterInterface<Reply, Request>*,
@@ -48,6 +48,7 @@ public:
     MOCK_METHOD(bool, open, (QFileDevice&, QIODevice::OpenMode), (const, override));
     MOCK_METHOD(QFileDevice::Permissions, permissions, (const QFile&), (const, override));
     MOCK_METHOD(qint64, read, (QFile&, char*, qint64), (const, override));
+    MOCK_METHOD(qint64, read_at, (QFile&, char*, qint64, qint64), (const, override));
     MOCK_METHOD(QByteArray, read_all, (QFile&), (const, override));
     MOCK_METHOD(QString, read_line, (QTextStream&), (const, override));
     MOCK_METHOD(bool, remove, (QFile&), (const, override));
@@ -78,6 +79,10 @@ public:
     MOCK_METHOD(fs::path, read_symlink, (const fs::path& path, std::error_code& err), (override, const));
     MOCK_METHOD(void, permissions, (const fs::path& path, fs::perms perms, std::error_code& err), (override, const));
     MOCK_METHOD(fs::file_status, status, (const fs::path& path, std::error_code& err), (override, const));
+    MOCK_METHOD(std::uintmax_t, file_size, (const fs::path& path, std::error_code& err), (override, const));
+    MOCK_METHOD(fs::file_time_type, last_write_time, (const fs::path& path, std::error_code& err), (override, const));
+    MOCK_METHOD(void, last_write_time, (const fs::path& path, fs::file_time_type new_time, std::error_code& err),
+                (override, const));
     MOCK_METHOD(std::unique_ptr<multipass::RecursiveDirIterator>, recursive_dir_iterator,
                 (const fs::path& path, std::error_code& err), (override, const));
 
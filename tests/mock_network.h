@@ -68,6 +68,11 @@ public:
         setHeader(header, value);
     }
 
+    void set_raw_header(const QByteArray& header, const QByteArray& value)
+    {
+        setRawHeader(header, value);
+    }
+
 public Q_SLOTS:
     MOCK_METHOD(void, abort, (), (override));
 };
@@ -44,6 +44,7 @@ public:
     MOCK_METHOD(int, chown, (const char*, unsigned int, unsigned int), (const, override));
     MOCK_METHOD(bool, link, (const char*, const char*), (const, override));
     MOCK_METHOD(bool, symlink, (const char*, const char*, bool), (const, override));
+    MOCK_METHOD(bool, clone_file, (const char*, const char*), (const, override));
     MOCK_METHOD(int, utime, (const char*, int, int), (const, override));
     MOCK_METHOD(void, create_alias_script, (const std::string&, const AliasDefinition&), (const, override));
     MOCK_METHOD(void, remove_alias_script, (const std::string&), (const, override));
@@ -55,6 +56,13 @@ public:
     MOCK_METHOD(QString, default_driver, (), (const, override));
     MOCK_METHOD(QString, default_privileged_mounts, (), (const, override));
     MOCK_METHOD(bool, is_image_url_supported, (), (const, override));
+    MOCK_METHOD(platform::HostCapacity, host_capacity, (const QString&), (const, override));
+    MOCK_METHOD(void, tune_memory_merging, (const QString&, int), (const, override));
+    MOCK_METHOD((std::map<std::string, std::uint64_t>), memory_merging_stats, (), (const, override));
+    MOCK_METHOD(std::vector<platform::ResourcePressure>, resource_pressure, (), (const, override));
+    MOCK_METHOD(std::uint64_t, resident_memory, (), (const, override));
+    MOCK_METHOD(bool, watch_host_sleep, (QObject*, const char*), (const, override));
+    MOCK_METHOD(void, hold_host_sleep, (bool), (const, override));
 
     MP_MOCK_SINGLETON_BOILERPLATE(MockPlatform, Platform);
 };
@@ -35,6 +35,8 @@ public:
     MOCK_METHOD(QString, get, (const QString&), (const, override));
     MOCK_METHOD(void, set, (const QString&, const QString&), (override));
     MOCK_METHOD(std::set<QString>, keys, (), (const, override));
+    MOCK_METHOD((std::map<QString, QString>), get_values, (const std::set<QString>&), (const, override));
+    MOCK_METHOD(void, set_values, ((const std::map<QString, QString>&)), (override));
 
     MP_MOCK_SINGLETON_BOILERPLATE(MockSettings, Settings);
 };
@@ -30,6 +30,8 @@ struct MockSFTPClient : public SFTPClient
     MOCK_METHOD(bool, pull, (const fs::path& source_path, const fs::path& target_path, Flags flags), (override));
     MOCK_METHOD(void, from_cin, (std::istream & cin, const fs::path& target_path, bool make_parent), (override));
     MOCK_METHOD(void, to_cout, (const fs::path& source_path, std::ostream& cout), (override));
+    MOCK_METHOD(void, set_parallel_transfers, (int count), (override));
+    MOCK_METHOD(void, set_transfer_window, (int window), (override));
 };
 } // namespace multipass::test
 
@@ -25,7 +25,8 @@ struct MockSFTPUtils : public SFTPUtils
     MOCK_METHOD(std::unique_ptr<SFTPDirIterator>, make_SFTPDirIterator, (sftp_session sftp, const fs::path& path),
                 (override));
     MOCK_METHOD(std::unique_ptr<SFTPClient>, make_SFTPClient,
-                (const std::string& host, int port, const std::string& username, const std::string& priv_key_blob),
+                (const std::string& host, int port, const std::string& username, const std::string& priv_key_blob,
+                 bool compression),
                 (override));
 
     MP_MOCK_SINGLETON_BOILERPLATE(MockSFTPUtils, SFTPUtils);
@@ -29,9 +29,14 @@ struct MockURLDownloader : public multipass::URLDownloader
     MockURLDownloader() : URLDownloader{std::chrono::seconds(10)} {};
 
     MOCK_METHOD(QByteArray, download, (const QUrl&), (override));
+    MOCK_METHOD(QByteArray, download_range, (const QUrl&, qint64, qint64), (override));
+    MOCK_METHOD(std::optional<QByteArray>, download_if_changed, (const QUrl&, Validators&), (override));
     MOCK_METHOD(QDateTime, last_modified, (const QUrl&), (override));
     MOCK_METHOD(void, download_to, (const QUrl&, const QString&, int64_t, const int, const ProgressMonitor&),
                 (override));
+    MOCK_METHOD(void, download_chunks,
+                (const QUrl&, const ChunkAction&, const RestartAction&, int64_t, const int, const ProgressMonitor&),
+                (override));
 };
 } // namespace test
 } // namespace multipass
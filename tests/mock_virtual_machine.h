@@ -42,7 +42,9 @@ struct MockVirtualMachineT : public T
         ON_CALL(*this, ssh_hostname(_)).WillByDefault(Return("localhost"));
         ON_CALL(*this, ssh_username()).WillByDefault(Return("ubuntu"));
         ON_CALL(*this, management_ipv4()).WillByDefault(Return("0.0.0.0"));
-        ON_CALL(*this, get_all_ipv4(_)).WillByDefault(Return(std::vector<std::string>{"192.168.2.123"}));
+        ON_CALL(*this, get_all_ipv4(A<const SSHKeyProvider&>()))
+            .WillByDefault(Return(std::vector<std::string>{"192.168.2.123"}));
+        ON_CALL(*this, get_all_ipv4(A<SSHSession&>())).WillByDefault(Return(std::vector<std::string>{"192.168.2.123"}));
         ON_CALL(*this, ipv6()).WillByDefault(Return("::/0"));
     }
 
@@ -57,6 +59,10 @@ struct MockVirtualMachineT : public T
     MOCK_METHOD(std::string, ssh_username, (), (override));
     MOCK_METHOD(std::string, management_ipv4, (), (override));
     MOCK_METHOD(std::vector<std::string>, get_all_ipv4, (const SSHKeyProvider&), (override));
+    MOCK_METHOD(std::vector<std::string>, get_all_ipv4, (SSHSession&), (override));
+    MOCK_METHOD(std::optional<std::string>, guest_exec, (const std::string&), (override));
+    MOCK_METHOD(std::optional<std::vector<std::string>>, guest_ipv4, (), (override));
+    MOCK_METHOD(std::optional<HostStats>, host_stats, (), (override));
     MOCK_METHOD(std::string, ipv6, (), (override));
     MOCK_METHOD(void, ensure_vm_is_running, (), (override));
     MOCK_METHOD(void, wait_until_ssh_up, (std::chrono::milliseconds), (override));
@@ -64,6 +70,12 @@ struct MockVirtualMachineT : public T
     MOCK_METHOD(void, update_cpus, (int num_cores), (override));
     MOCK_METHOD(void, resize_memory, (const MemorySize& new_size), (override));
     MOCK_METHOD(void, resize_disk, (const MemorySize& new_size), (override));
+    MOCK_METHOD(bool, concurrent_state_changes, (), (override));
+    MOCK_METHOD(void, compact_disk, (bool), (override));
+    MOCK_METHOD(void, take_snapshot, (const std::string&), (override));
+    MOCK_METHOD(std::vector<std::string>, list_snapshots, (), (override));
+    MOCK_METHOD(void, delete_snapshot, (const std::string&), (override));
+    MOCK_METHOD(void, restore_snapshot, (const std::string&), (override));
     MOCK_METHOD(std::unique_ptr<MountHandler>, make_native_mount_handler,
                 (const SSHKeyProvider* ssh_key_provider, const std::string& target, const VMMount& mount), (override));
 };
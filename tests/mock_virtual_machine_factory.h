@@ -43,9 +43,12 @@ struct MockVirtualMachineFactory : public VirtualMachineFactory
     MOCK_METHOD(QString, get_backend_directory_name, (), (override));
     MOCK_METHOD(QString, get_backend_version_string, (), (override));
     MOCK_METHOD(VMImageVault::UPtr, create_image_vault,
-                (std::vector<VMImageHost*>, URLDownloader*, const Path&, const Path&, const days&), (override));
+                (std::vector<VMImageHost*>, URLDownloader*, const Path&, const Path&, const days&,
+                 const vault::BlobStore&),
+                (override));
     MOCK_METHOD(void, configure, (VirtualMachineDescription&), (override));
     MOCK_METHOD(std::vector<NetworkInterfaceInfo>, networks, (), (const, override));
+    MOCK_METHOD(void, refresh_states, (const std::vector<VirtualMachine*>&), (override));
 
     // originally protected:
     MOCK_METHOD(std::string, create_bridge_with, (const NetworkInterfaceInfo&), (override));
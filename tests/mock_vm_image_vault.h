@@ -48,12 +48,18 @@ public:
                  const std::optional<std::string>&),
                 (override));
     MOCK_METHOD(void, remove, (const std::string&), (override));
+    MOCK_METHOD(void, empty_trash, (), (override));
     MOCK_METHOD(bool, has_record_for, (const std::string&), (override));
     MOCK_METHOD(void, prune_expired_images, (), (override));
+    MOCK_METHOD(void, prune_to_size, (const MemorySize&), (override));
     MOCK_METHOD(void, update_images, (const FetchType&, const PrepareAction&, const ProgressMonitor&), (override));
     MOCK_METHOD(MemorySize, minimum_image_size_for, (const std::string&), (override));
     MOCK_METHOD(VMImageHost*, image_host_for, (const std::string&), (const, override));
     MOCK_METHOD((std::vector<std::pair<std::string, VMImageInfo>>), all_info_for, (const Query&), (const, override));
+    MOCK_METHOD(VMImage, clone, (const std::string&, const std::string&), (override));
+    MOCK_METHOD(bool, keeps_golden_images, (), (const, override));
+    MOCK_METHOD(void, keep_golden_image, (const std::string&, const std::string&), (override));
+    MOCK_METHOD(std::optional<VMImage>, golden_image_for, (const std::string&, const std::string&), (override));
 
 private:
     TempFile dummy_image;
@@ -18,6 +18,8 @@
 #include <QCommandLineParser>
 #include <QCoreApplication>
 
+#include <csignal>
+
 #include <unistd.h>
 
 int main(int argc, char* argv[])
@@ -40,6 +42,8 @@ int main(int argc, char* argv[])
         }
     }
 
+    std::signal(SIGHUP, SIG_IGN); // what the real one reads its hosts file again on
+
     pause(); // wait to be terminated from the outside
     return 0;
 }
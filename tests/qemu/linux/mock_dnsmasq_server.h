@@ -32,6 +32,7 @@ struct MockDNSMasqServer : public DNSMasqServer
     using DNSMasqServer::DNSMasqServer; // ctor
 
     MOCK_METHOD(std::optional<IPAddress>, get_ip_for, (const std::string&), (override));
+    MOCK_METHOD(std::optional<IPAddress>, reserve_ip_for, (const std::string&), (override));
     MOCK_METHOD(void, release_mac, (const std::string&), (override));
     MOCK_METHOD(void, check_dnsmasq_running, (), (override));
 };
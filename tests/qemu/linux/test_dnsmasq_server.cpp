@@ -16,6 +16,7 @@
  */
 
 #include "tests/common.h"
+#include "tests/mock_backend_utils.h"
 #include "tests/file_operations.h"
 #include "tests/mock_environment_helpers.h"
 #include "tests/mock_logger.h"
@@ -32,9 +33,16 @@
 
 #include <QDir>
 
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
 #include <memory>
 #include <stdexcept>
 #include <string>
+#include <vector>
+
+#include <netinet/in.h>
+#include <sys/socket.h>
 
 namespace mp = multipass;
 namespace mpl = multipass::logging;
@@ -113,6 +121,52 @@ TEST_F(DNSMasqServer, finds_ip)
     EXPECT_EQ(ip.value(), mp::IPAddress(expected_ip));
 }
 
+TEST_F(DNSMasqServer, finds_ip_once_leases_change)
+{
+    auto dns = make_default_dnsmasq_server();
+    make_lease_entry("00:01:02:03:04:06");
+
+    EXPECT_FALSE(dns.get_ip_for(hw_addr));
+
+    ASSERT_TRUE(QFile::remove(QDir{data_dir.path()}.filePath("dnsmasq.leases")));
+    make_lease_entry();
+    auto ip = dns.get_ip_for(hw_addr);
+
+    ASSERT_TRUE(ip);
+    EXPECT_EQ(ip.value(), mp::IPAddress(expected_ip));
+    EXPECT_FALSE(dns.get_ip_for("00:01:02:03:04:06"));
+}
+
+TEST_F(DNSMasqServer, reserves_ip_before_any_lease_and_keeps_it)
+{
+    std::optional<mp::IPAddress> reserved;
+    {
+        auto dns = make_default_dnsmasq_server();
+        reserved = dns.reserve_ip_for(hw_addr);
+
+        ASSERT_TRUE(reserved);
+        EXPECT_THAT(reserved->as_string(), StartsWith(subnet + "."));
+        EXPECT_EQ(dns.get_ip_for(hw_addr), reserved);
+        EXPECT_EQ(dns.reserve_ip_for(hw_addr), reserved);
+    }
+
+    QFile hosts{QDir{data_dir.path()}.filePath("dnsmasq.hosts")};
+    ASSERT_TRUE(hosts.open(QIODevice::ReadOnly));
+    EXPECT_EQ(hosts.readAll().toStdString(), fmt::format("{},{}\n", hw_addr, reserved->as_string()));
+    hosts.close();
+
+    auto dns = make_default_dnsmasq_server();
+    EXPECT_EQ(dns.get_ip_for(hw_addr), reserved);
+}
+
+TEST_F(DNSMasqServer, reserves_the_ip_already_leased)
+{
+    auto dns = make_default_dnsmasq_server();
+    make_lease_entry();
+
+    EXPECT_EQ(dns.reserve_ip_for(hw_addr), mp::IPAddress{expected_ip});
+}
+
 TEST_F(DNSMasqServer, returns_null_ip_when_leases_file_does_not_exist)
 {
     auto dns = make_default_dnsmasq_server();
@@ -173,6 +227,105 @@ TEST_F(DNSMasqServer, release_mac_crashes_logs_failure)
                 Contains(fmt::format("failed to release ip addr {} with mac {}: Crashed", expected_ip, crash_hw_addr)));
 }
 
+TEST_F(DNSMasqServer, release_mac_sends_release_through_bridge)
+{
+    const QString dchp_release_called{QDir{data_dir.path()}.filePath("dhcp_release_called")};
+    const auto bridge = dchp_release_called.toStdString();
+    constexpr auto fd = 42;
+    auto [mock_syscalls, guard] = mpt::MockLinuxSysCalls::inject<NiceMock>();
+
+    std::string bound_device;
+    std::vector<std::uint8_t> packet;
+    sockaddr_in destination{};
+    EXPECT_CALL(*mock_syscalls, socket(AF_INET, SOCK_DGRAM | SOCK_CLOEXEC, IPPROTO_UDP)).WillOnce(Return(fd));
+    EXPECT_CALL(*mock_syscalls, setsockopt(fd, SOL_SOCKET, SO_BINDTODEVICE, _, bridge.size()))
+        .WillOnce([&bound_device](int, int, int, const void* value, socklen_t size) {
+            bound_device.assign(static_cast<const char*>(value), size);
+            return 0;
+        });
+    EXPECT_CALL(*mock_syscalls, sendto(fd, _, _, 0, _, sizeof(sockaddr_in)))
+        .WillOnce([&packet, &destination](int, const void* data, size_t size, int, const sockaddr* to, socklen_t) {
+            const auto bytes = static_cast<const std::uint8_t*>(data);
+            packet.assign(bytes, bytes + size);
+            std::memcpy(&destination, to, sizeof(destination));
+            return static_cast<ssize_t>(size);
+        });
+    EXPECT_CALL(*mock_syscalls, close(fd));
+
+    mp::DNSMasqServer dns{data_dir.path(), dchp_release_called, subnet};
+    make_lease_entry();
+
+    dns.release_mac(hw_addr);
+
+    EXPECT_FALSE(QFile::exists(dchp_release_called));
+    EXPECT_EQ(bound_device, bridge);
+    EXPECT_EQ(destination.sin_family, AF_INET);
+    EXPECT_EQ(ntohs(destination.sin_port), 67);
+    EXPECT_EQ(ntohl(destination.sin_addr.s_addr), mp::IPAddress{subnet + ".1"}.as_uint32());
+
+    ASSERT_EQ(packet.size(), 300u);
+    EXPECT_THAT(std::vector<std::uint8_t>(packet.begin(), packet.begin() + 3), ElementsAre(1, 1, 6));
+    EXPECT_THAT(std::vector<std::uint8_t>(packet.begin() + 12, packet.begin() + 16), ElementsAre(10, 177, 224, 22));
+    EXPECT_THAT(std::vector<std::uint8_t>(packet.begin() + 28, packet.begin() + 34), ElementsAre(0, 1, 2, 3, 4, 5));
+    EXPECT_THAT(std::vector<std::uint8_t>(packet.begin() + 236, packet.begin() + 240), ElementsAre(99, 130, 83, 99));
+    EXPECT_THAT(std::vector<std::uint8_t>(packet.begin() + 240, packet.begin() + 250),
+                ElementsAre(53, 1, 7, 54, 4, 192, 168, 64, 1, 255));
+    EXPECT_TRUE(std::all_of(packet.begin() + 250, packet.end(), [](auto byte) { return byte == 0; }));
+}
+
+TEST_F(DNSMasqServer, release_mac_falls_back_to_dhcp_release_when_bridge_cannot_be_bound)
+{
+    const QString dchp_release_called{QDir{data_dir.path()}.filePath("dhcp_release_called")};
+    constexpr auto fd = 42;
+    auto [mock_syscalls, guard] = mpt::MockLinuxSysCalls::inject<NiceMock>();
+
+    EXPECT_CALL(*mock_syscalls, socket).WillOnce(Return(fd));
+    EXPECT_CALL(*mock_syscalls, setsockopt(fd, SOL_SOCKET, SO_BINDTODEVICE, _, _)).WillOnce(Return(-1));
+    EXPECT_CALL(*mock_syscalls, sendto).Times(0);
+    EXPECT_CALL(*mock_syscalls, close(fd));
+
+    mp::DNSMasqServer dns{data_dir.path(), dchp_release_called, subnet};
+    make_lease_entry();
+
+    dns.release_mac(hw_addr);
+
+    EXPECT_TRUE(QFile::exists(dchp_release_called));
+}
+
+TEST_F(DNSMasqServer, release_mac_falls_back_to_dhcp_release_on_short_send)
+{
+    const QString dchp_release_called{QDir{data_dir.path()}.filePath("dhcp_release_called")};
+    auto [mock_syscalls, guard] = mpt::MockLinuxSysCalls::inject<NiceMock>();
+
+    EXPECT_CALL(*mock_syscalls, socket).WillOnce(Return(42));
+    EXPECT_CALL(*mock_syscalls, setsockopt).WillOnce(Return(0));
+    EXPECT_CALL(*mock_syscalls, sendto).WillOnce(Return(-1));
+
+    mp::DNSMasqServer dns{data_dir.path(), dchp_release_called, subnet};
+    make_lease_entry();
+
+    dns.release_mac(hw_addr);
+
+    EXPECT_TRUE(QFile::exists(dchp_release_called));
+}
+
+TEST_F(DNSMasqServer, release_mac_falls_back_to_dhcp_release_without_socket)
+{
+    const QString dchp_release_called{QDir{data_dir.path()}.filePath("dhcp_release_called")};
+    auto [mock_syscalls, guard] = mpt::MockLinuxSysCalls::inject<NiceMock>();
+
+    EXPECT_CALL(*mock_syscalls, socket).WillOnce(Return(-1));
+    EXPECT_CALL(*mock_syscalls, setsockopt).Times(0);
+    EXPECT_CALL(*mock_syscalls, close).Times(0);
+
+    mp::DNSMasqServer dns{data_dir.path(), dchp_release_called, subnet};
+    make_lease_entry();
+
+    dns.release_mac(hw_addr);
+
+    EXPECT_TRUE(QFile::exists(dchp_release_called));
+}
+
 TEST_F(DNSMasqServer, dnsmasq_starts_and_does_not_throw)
 {
     auto dns = make_default_dnsmasq_server();
@@ -26,6 +26,7 @@
 
 #include <multipass/format.h>
 
+#include <QFile>
 #include <QString>
 
 #include <tuple>
@@ -48,6 +49,13 @@ struct FirewallConfig : public Test
     const std::string subnet{"192.168.2"};
 
     mpt::MockLogger::Scope logger_scope = mpt::MockLogger::inject();
+
+    // What iptables-restore is given, from the file named last
+    static QByteArray rules_in(mpt::MockProcess* process)
+    {
+        QFile rules_file{process->arguments().last()};
+        return rules_file.open(QIODevice::ReadOnly) ? rules_file.readAll() : QByteArray{};
+    }
 };
 
 struct FirewallToUseTestSuite : FirewallConfig, WithParamInterface<std::tuple<std::string, QByteArray, QByteArray>>
@@ -82,7 +90,7 @@ TEST_F(FirewallConfig, iptablesNftErrorLogsWarningUsesIptablesLegacyByDefault)
 TEST_F(FirewallConfig, firewallVerifyNoErrorDoesNotThrow)
 {
     mpt::MockProcessFactory::Callback firewall_callback = [this](mpt::MockProcess* process) {
-        if (process->arguments().contains(goodbr0))
+        if (process->program().endsWith("-restore") && rules_in(process).contains(goodbr0))
         {
             mp::ProcessState exit_state;
             exit_state.exit_code = 0;
@@ -103,7 +111,7 @@ TEST_F(FirewallConfig, firewallErrorThrowsOnVerify)
     const QByteArray msg{"Evil bridge detected!"};
 
     mpt::MockProcessFactory::Callback firewall_callback = [this, &msg](mpt::MockProcess* process) {
-        if (process->arguments().contains(evilbr0))
+        if (process->program().endsWith("-restore") && rules_in(process).contains(evilbr0))
         {
             mp::ProcessState exit_state;
             exit_state.exit_code = 1;
@@ -132,14 +140,15 @@ TEST_F(FirewallConfig, dtorDeletesKnownRules)
 
     mpt::MockProcessFactory::Callback firewall_callback = [&base_rule, &full_rule,
                                                            &delete_called](mpt::MockProcess* process) {
-        if (process->arguments().contains("--list-rules"))
+        if (process->program().endsWith("-save"))
         {
-            EXPECT_CALL(*process, read_all_standard_output()).WillRepeatedly(Return(full_rule));
+            EXPECT_CALL(*process, read_all_standard_output())
+                .WillRepeatedly(Return("*nat\n:POSTROUTING ACCEPT [0:0]\n" + full_rule + "\nCOMMIT\n"));
         }
-        else if (process->program() == "sh" && process->arguments().at(1).contains("--delete"))
+        else if (process->program().endsWith("-restore") && rules_in(process).contains("--delete"))
         {
             delete_called = true;
-            EXPECT_TRUE(process->arguments().at(1).contains(base_rule));
+            EXPECT_TRUE(rules_in(process).contains("*nat\n--delete " + base_rule));
         }
     };
 
@@ -163,13 +172,13 @@ TEST_F(FirewallConfig, dtorDeleteErrorLogsErrorAndContinues)
     const QByteArray msg{"Bad stuff happened"};
 
     mpt::MockProcessFactory::Callback firewall_callback = [&](mpt::MockProcess* process) {
-        if (process->arguments().contains("--list-rules"))
+        if (process->program().endsWith("-save"))
         {
-            EXPECT_CALL(*process, read_all_standard_output()).WillRepeatedly(Return(full_rule));
+            EXPECT_CALL(*process, read_all_standard_output()).WillRepeatedly(Return("*nat\n" + full_rule));
         }
-        else if (process->program() == "sh" && process->arguments().at(1).contains("--delete"))
+        else if (process->program().endsWith("-restore"))
         {
-            if (process->arguments().at(1).contains(base_rule))
+            if (rules_in(process).contains("--delete " + base_rule))
             {
                 mp::ProcessState exit_state;
                 exit_state.exit_code = 1;
@@ -187,9 +196,38 @@ TEST_F(FirewallConfig, dtorDeleteErrorLogsErrorAndContinues)
 
     {
         mp::FirewallConfig firewall_config{goodbr0, subnet};
+        EXPECT_NO_THROW(firewall_config.verify_firewall_rules()); // set up nonetheless
     }
 }
 
+TEST_F(FirewallConfig, setsUpAllRulesInOneTransaction)
+{
+    auto restores = 0;
+    QByteArray rules;
+
+    mpt::MockProcessFactory::Callback firewall_callback = [&](mpt::MockProcess* process) {
+        EXPECT_FALSE(process->arguments().contains("--insert")); // not one rule at a time
+        if (process->program().endsWith("-restore"))
+        {
+            ++restores;
+            rules = rules_in(process);
+            EXPECT_THAT(process->arguments(), Contains(QStringLiteral("--noflush")));
+        }
+    };
+
+    auto factory = mpt::MockProcessFactory::Inject();
+    factory->register_callback(firewall_callback);
+
+    mp::FirewallConfig firewall_config{goodbr0, subnet};
+
+    EXPECT_EQ(restores, 1);
+    EXPECT_THAT(rules.toStdString(), HasSubstr("*filter\n--insert INPUT --in-interface goodbr0"));
+    EXPECT_THAT(rules.toStdString(), HasSubstr("--comment \"generated for Multipass network goodbr0\""));
+    EXPECT_THAT(rules.toStdString(), HasSubstr("*mangle\n"));
+    EXPECT_THAT(rules.toStdString(), HasSubstr("*nat\n"));
+    EXPECT_EQ(rules.count("COMMIT\n"), 3);
+}
+
 TEST_P(FirewallToUseTestSuite, usesExpectedFirewall)
 {
     const auto& param = GetParam();
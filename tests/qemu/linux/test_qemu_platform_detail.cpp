@@ -17,17 +17,23 @@
 
 #include "mock_dnsmasq_server.h"
 #include "mock_firewall_config.h"
+#include "mock_netlink.h"
 
 #include "tests/common.h"
 #include "tests/mock_backend_utils.h"
 #include "tests/mock_file_ops.h"
 #include "tests/mock_logger.h"
 #include "tests/mock_process_factory.h"
+#include "tests/mock_settings.h"
 #include "tests/mock_utils.h"
 #include "tests/temp_dir.h"
 
 #include <src/platform/backends/qemu/linux/qemu_platform_detail.h>
 
+#include <multipass/constants.h>
+
+#include <QFile>
+
 namespace mp = multipass;
 namespace mpl = multipass::logging;
 namespace mpt = multipass::test;
@@ -52,11 +58,8 @@ struct QemuPlatformDetail : public Test
             return std::move(mock_firewall_config);
         });
 
-        EXPECT_CALL(*mock_utils, run_cmd_for_status(QString("ip"), _, _)).WillRepeatedly(Return(true));
-        EXPECT_CALL(*mock_utils,
-                    run_cmd_for_status(QString("ip"), QStringList({"addr", "show", multipass_bridge_name}), _))
-            .WillOnce(Return(false))
-            .WillOnce(Return(true));
+        EXPECT_CALL(*mock_netlink, link_exists(_)).WillRepeatedly(Return(true));
+        EXPECT_CALL(*mock_netlink, link_exists(multipass_bridge_name)).WillOnce(Return(false)).WillOnce(Return(true));
 
         EXPECT_CALL(*mock_file_ops, open(_, _)).WillRepeatedly(Return(true));
         EXPECT_CALL(*mock_file_ops, write(_, _)).WillRepeatedly(Return(1));
@@ -74,6 +77,9 @@ struct QemuPlatformDetail : public Test
     mpt::MockUtils::GuardedMock utils_attr{mpt::MockUtils::inject<NiceMock>()};
     mpt::MockUtils* mock_utils = utils_attr.first;
 
+    mpt::MockNetlink::GuardedMock netlink_attr{mpt::MockNetlink::inject<NiceMock>()};
+    mpt::MockNetlink* mock_netlink = netlink_attr.first;
+
     mpt::MockBackend::GuardedMock backend_attr{mpt::MockBackend::inject<NiceMock>()};
     mpt::MockBackend* mock_backend = backend_attr.first;
 
@@ -88,30 +94,22 @@ struct QemuPlatformDetail : public Test
     mpt::MockFileOps::GuardedMock file_ops_attr{mpt::MockFileOps::inject<NiceMock>()};
     mpt::MockFileOps* mock_file_ops = file_ops_attr.first;
 
+    mpt::MockSettings::GuardedMock mock_settings_injection = mpt::MockSettings::inject<NiceMock>();
+
     mpt::MockLogger::Scope logger_scope = mpt::MockLogger::inject();
 };
 } // namespace
 
 TEST_F(QemuPlatformDetail, ctor_sets_up_expected_virtual_switch)
 {
-    const QString qstring_subnet{QString::fromStdString(subnet)};
-
-    EXPECT_CALL(*mock_utils, run_cmd_for_status(QString("ip"),
-                                                ElementsAre(QString("link"), QString("add"), multipass_bridge_name,
-                                                            QString("address"), _, QString("type"), QString("bridge")),
-                                                _))
-        .WillOnce(Return(true));
-    EXPECT_CALL(*mock_utils, run_cmd_for_status(QString("ip"),
-                                                ElementsAre(QString("address"), QString("add"),
-                                                            QString("%1.1/24").arg(qstring_subnet), QString("dev"),
-                                                            multipass_bridge_name, "broadcast",
-                                                            QString("%1.255").arg(qstring_subnet)),
-                                                _))
-        .WillOnce(Return(true));
-    EXPECT_CALL(*mock_utils, run_cmd_for_status(
-                                 QString("ip"),
-                                 ElementsAre(QString("link"), QString("set"), multipass_bridge_name, QString("up")), _))
-        .WillOnce(Return(true));
+    {
+        InSequence seq;
+
+        EXPECT_CALL(*mock_netlink, add_bridge(multipass_bridge_name, _));
+        EXPECT_CALL(*mock_netlink,
+                    add_address(multipass_bridge_name, fmt::format("{}.1", subnet), 24, fmt::format("{}.255", subnet)));
+        EXPECT_CALL(*mock_netlink, set_up(multipass_bridge_name));
+    }
 
     mp::QemuPlatformDetail qemu_platform_detail{data_dir.path()};
 }
@@ -132,25 +130,26 @@ TEST_F(QemuPlatformDetail, get_ip_for_returns_expected_info)
 TEST_F(QemuPlatformDetail, platform_args_generate_net_resources_removes_works_as_expected)
 {
     mp::VirtualMachineDescription vm_desc;
+    vm_desc.num_cores = 2;
     vm_desc.vm_name = "foo";
     vm_desc.default_mac_address = hw_addr;
 
     QString tap_name;
 
+    EXPECT_CALL(*mock_dnsmasq_server, reserve_ip_for(hw_addr)).WillOnce(Return(std::nullopt));
     EXPECT_CALL(*mock_dnsmasq_server, release_mac(hw_addr)).WillOnce(Return());
 
-    EXPECT_CALL(
-        *mock_utils,
-        run_cmd_for_status(QString("ip"),
-                           ElementsAre(QString("addr"), QString("show"), mpt::match_qstring(StartsWith("tap-"))), _))
-        .WillOnce([&tap_name](auto& cmd, auto& opts, auto...) {
-            tap_name = opts.last();
-            return false;
-        });
+    EXPECT_CALL(*mock_netlink, link_exists(mpt::match_qstring(StartsWith("tap-")))).WillOnce([&tap_name](auto& name) {
+        tap_name = name;
+        return false;
+    });
+    EXPECT_CALL(*mock_netlink, add_tap(mpt::match_qstring(StartsWith("tap-")), true));
+    EXPECT_CALL(*mock_netlink, set_master(mpt::match_qstring(StartsWith("tap-")), multipass_bridge_name));
 
     mp::QemuPlatformDetail qemu_platform_detail{data_dir.path()};
 
     const auto platform_args = qemu_platform_detail.vm_platform_args(vm_desc);
+    const auto vhost = QFile::exists("/dev/vhost-net") ? ",vhost=on" : "";
 
     // Tests the order and correctness of the arguments returned
     std::vector<QString> expected_platform_args
@@ -160,23 +159,50 @@ TEST_F(QemuPlatformDetail, platform_args_generate_net_resources_removes_works_as
 #elif defined Q_PROCESSOR_ARM
         "-bios", "QEMU_EFI.fd",
 #endif
-            "--enable-kvm", "-cpu", "host", "-nic",
-            QString::fromStdString(fmt::format("tap,ifname={},script=no,downscript=no,model=virtio-net-pci,mac={}",
-                                               tap_name, vm_desc.default_mac_address))
+            "--enable-kvm", "-cpu", "host", "-netdev",
+            QString::fromStdString(
+                fmt::format("tap,id=hostnet0,ifname={},script=no,downscript=no{},queues=2", tap_name, vhost)),
+            "-device",
+            QString::fromStdString(
+                fmt::format("virtio-net-pci,netdev=hostnet0,mac={},mq=on,vectors=6", vm_desc.default_mac_address))
     };
 
     EXPECT_THAT(platform_args, ElementsAreArray(expected_platform_args));
 
-    EXPECT_CALL(*mock_utils,
-                run_cmd_for_status(QString("ip"), ElementsAre(QString("addr"), QString("show"), tap_name), _))
-        .WillOnce(Return(true));
-    EXPECT_CALL(*mock_utils,
-                run_cmd_for_status(QString("ip"), ElementsAre(QString("link"), QString("delete"), tap_name), _))
-        .WillOnce(Return(true));
+    EXPECT_CALL(*mock_netlink, link_exists(tap_name)).WillOnce(Return(true));
+    EXPECT_CALL(*mock_netlink, delete_link(tap_name));
 
     qemu_platform_detail.remove_resources_for(name);
 }
 
+TEST_F(QemuPlatformDetail, single_core_instances_get_a_single_queue_tap)
+{
+    mp::VirtualMachineDescription vm_desc;
+    vm_desc.num_cores = 1;
+    vm_desc.vm_name = "foo";
+    vm_desc.default_mac_address = hw_addr;
+
+    EXPECT_CALL(*mock_netlink, link_exists(mpt::match_qstring(StartsWith("tap-")))).WillOnce(Return(true));
+    EXPECT_CALL(*mock_netlink, delete_link(mpt::match_qstring(StartsWith("tap-")))); // may have had other queues
+    EXPECT_CALL(*mock_netlink, add_tap(mpt::match_qstring(StartsWith("tap-")), false));
+
+    mp::QemuPlatformDetail qemu_platform_detail{data_dir.path()};
+
+    const auto platform_args = qemu_platform_detail.vm_platform_args(vm_desc);
+    EXPECT_THAT(platform_args, Contains(QString::fromStdString(fmt::format("virtio-net-pci,netdev=hostnet0,mac={}",
+                                                                           vm_desc.default_mac_address))));
+    EXPECT_FALSE(platform_args.join(' ').contains("queues="));
+}
+
+TEST_F(QemuPlatformDetail, seeds_are_not_served_unless_asked_for)
+{
+    mp::QemuPlatformDetail qemu_platform_detail{data_dir.path()};
+
+    EXPECT_FALSE(qemu_platform_detail.serves_seeds());
+    MP_EXPECT_THROW_THAT(qemu_platform_detail.seed_platform_args(name, data_dir.path()), std::runtime_error,
+                         mpt::match_what(HasSubstr(mp::qemu_nocloud_net_key)));
+}
+
 TEST_F(QemuPlatformDetail, platform_health_check_calls_expected_methods)
 {
     EXPECT_CALL(*mock_backend, check_for_kvm_support()).WillOnce(Return());
@@ -189,6 +215,33 @@ TEST_F(QemuPlatformDetail, platform_health_check_calls_expected_methods)
     qemu_platform_detail.platform_health_check();
 }
 
+TEST_F(QemuPlatformDetail, platform_health_check_checks_kvm_support_until_it_is_there)
+{
+    EXPECT_CALL(*mock_backend, check_for_kvm_support())
+        .WillOnce(Throw(std::runtime_error{"KVM support is not enabled on this machine."}))
+        .WillOnce(Return());
+    EXPECT_CALL(*mock_backend, check_if_kvm_is_in_use()).Times(2);
+
+    mp::QemuPlatformDetail qemu_platform_detail{data_dir.path()};
+
+    EXPECT_THROW(qemu_platform_detail.platform_health_check(), std::runtime_error);
+    qemu_platform_detail.platform_health_check();
+    qemu_platform_detail.platform_health_check();
+}
+
+TEST_F(QemuPlatformDetail, link_failures_are_logged)
+{
+    const std::string error{"Could not add bridge mpqemubr0: Operation not permitted"};
+
+    logger_scope.mock_logger->screen_logs(mpl::Level::warning); // warning and above expected explicitly in tests
+    logger_scope.mock_logger->expect_log(mpl::Level::warning, error);
+
+    EXPECT_CALL(*mock_netlink, add_bridge(multipass_bridge_name, _)).WillOnce(Throw(std::runtime_error{error}));
+    EXPECT_CALL(*mock_netlink, set_up(_)).Times(0);
+
+    mp::QemuPlatformDetail qemu_platform_detail{data_dir.path()};
+}
+
 TEST_F(QemuPlatformDetail, opening_ipforward_file_failure_logs_expected_message)
 {
     logger_scope.mock_logger->screen_logs(mpl::Level::warning); // warning and above expected explicitly in tests
@@ -0,0 +1,102 @@
+/*
+ * Copyright (C) Canonical, Ltd.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; version 3.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#include "tests/common.h"
+#include "tests/file_operations.h"
+#include "tests/temp_dir.h"
+
+#include <src/platform/backends/qemu/linux/seed_server.h>
+
+#include <QEventLoop>
+#include <QTcpSocket>
+#include <QTimer>
+#include <QUrl>
+
+namespace mp = multipass;
+namespace mpt = multipass::test;
+
+using namespace testing;
+
+namespace
+{
+struct SeedServer : public Test
+{
+    SeedServer()
+    {
+        mpt::make_file_with_content(seed_dir.filePath("user-data"), "#cloud-config\npassword: secret\n");
+    }
+
+    // What the server answers a GET of path with, from where the test runs
+    QByteArray get(const QString& path)
+    {
+        QTcpSocket socket;
+        QByteArray reply;
+        QEventLoop loop;
+        QObject::connect(&socket, &QTcpSocket::connected, [&socket, &path] {
+            socket.write("GET " + path.toUtf8() + " HTTP/1.1\r\nHost: seeds\r\n\r\n");
+        });
+        QObject::connect(&socket, &QTcpSocket::readyRead, [&socket, &reply] { reply += socket.readAll(); });
+        QObject::connect(&socket, &QTcpSocket::disconnected, &loop, &QEventLoop::quit);
+        QTimer::singleShot(5000, &loop, &QEventLoop::quit);
+
+        socket.connectToHost("127.0.0.1", port);
+        loop.exec();
+
+        return reply;
+    }
+
+    mpt::TempDir seed_dir;
+    std::unordered_map<std::string, std::string> addresses{{"foo", "127.0.0.1"}, {"bar", "10.0.0.9"}};
+    mp::SeedServer server{"127.0.0.1", 0, [this](const std::string& name) -> std::optional<std::string> {
+                              const auto it = addresses.find(name);
+                              return it == addresses.end() ? std::nullopt : std::make_optional(it->second);
+                          }};
+    quint16 port{0};
+};
+} // namespace
+
+TEST_F(SeedServer, serves_an_instance_its_own_seed)
+{
+    port = QUrl{server.serve("foo", seed_dir.path())}.port();
+
+    const auto reply = get("/foo/user-data");
+    EXPECT_TRUE(reply.startsWith("HTTP/1.1 200 OK"));
+    EXPECT_TRUE(reply.endsWith("password: secret\n"));
+}
+
+TEST_F(SeedServer, refuses_the_seed_of_another_instance)
+{
+    port = QUrl{server.serve("bar", seed_dir.path())}.port();
+
+    const auto reply = get("/bar/user-data");
+    EXPECT_TRUE(reply.startsWith("HTTP/1.1 403 Forbidden"));
+    EXPECT_FALSE(reply.contains("secret"));
+}
+
+TEST_F(SeedServer, refuses_an_instance_without_an_address_yet)
+{
+    port = QUrl{server.serve("baz", seed_dir.path())}.port();
+
+    EXPECT_TRUE(get("/baz/user-data").startsWith("HTTP/1.1 403 Forbidden"));
+}
+
+TEST_F(SeedServer, knows_nothing_of_instances_it_was_not_told_of)
+{
+    port = QUrl{server.serve("foo", seed_dir.path())}.port();
+
+    EXPECT_TRUE(get("/qux/user-data").startsWith("HTTP/1.1 404 Not Found"));
+}
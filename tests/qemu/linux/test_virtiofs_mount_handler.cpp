@@ -0,0 +1,161 @@
+/*
+ * Copyright (C) Canonical, Ltd.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; version 3.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#include "tests/common.h"
+#include "tests/mock_file_ops.h"
+#include "tests/mock_logger.h"
+#include "tests/mock_server_reader_writer.h"
+#include "tests/mock_ssh_process_exit_status.h"
+#include "tests/mock_ssh_test_fixture.h"
+#include "tests/mock_virtual_machine.h"
+#include "tests/stub_ssh_key_provider.h"
+
+#include "virtiofs_mount_handler.h"
+
+#include <multipass/utils.h>
+#include <multipass/vm_mount.h>
+
+namespace mp = multipass;
+namespace mpt = multipass::test;
+
+using namespace testing;
+
+namespace
+{
+struct MockQemuVirtualMachine : mpt::MockVirtualMachineT<mp::QemuVirtualMachine>
+{
+    explicit MockQemuVirtualMachine(const std::string& name) : mpt::MockVirtualMachineT<mp::QemuVirtualMachine>{name}
+    {
+    }
+
+    MOCK_METHOD(mp::QemuVirtualMachine::MountArgs&, modifiable_mount_args, (), (override));
+    MOCK_METHOD(mp::QemuVirtualMachine::MountHooks&, modifiable_mount_hooks, (), (override));
+};
+
+std::string tag_from_target(const std::string& target)
+{
+    return mp::utils::make_uuid(target).remove("-").left(30).prepend('m').toStdString();
+}
+
+struct VirtiofsMountHandlerTest : public ::Test
+{
+    VirtiofsMountHandlerTest()
+    {
+        EXPECT_CALL(mock_file_ops, status)
+            .WillOnce(Return(mp::fs::file_status{mp::fs::file_type::directory, mp::fs::perms::all}));
+        EXPECT_CALL(vm, modifiable_mount_args).WillOnce(ReturnRef(mount_args));
+        EXPECT_CALL(vm, modifiable_mount_hooks).WillOnce(ReturnRef(mount_hooks));
+    }
+
+    // the returned lambda will modify `output` so that it can be used to mock ssh_channel_read_timeout
+    auto mocked_ssh_channel_request_exec(std::string& output)
+    {
+        return [&](ssh_channel, const char* command) {
+            if (const auto it = commands.find(command); it != commands.end())
+                output = it->second;
+            else
+                ADD_FAILURE() << "unexpected command: " << command;
+
+            exit_status_mock.return_exit_code(0);
+            return SSH_OK;
+        };
+    }
+
+    static auto mocked_ssh_channel_read_timeout(const std::string& output)
+    {
+        return [&, copied = 0u](auto, void* dest, uint32_t count, auto...) mutable {
+            auto n = std::min(static_cast<std::string::size_type>(count), output.size() - copied);
+            std::copy_n(output.begin() + copied, n, static_cast<char*>(dest));
+            n ? copied += n : copied = 0;
+            return n;
+        };
+    }
+
+    mpt::StubSSHKeyProvider key_provider;
+    std::string default_source{"source"}, default_target{"target"};
+    mpt::MockFileOps::GuardedMock mock_file_ops_injection = mpt::MockFileOps::inject();
+    mpt::MockFileOps& mock_file_ops = *mock_file_ops_injection.first;
+    mpt::MockLogger::Scope logger_scope = mpt::MockLogger::inject(mpl::Level::debug);
+    mpt::MockServerReaderWriter<mp::MountReply, mp::MountRequest> server;
+    mpt::MockSSHTestFixture mock_ssh_test_fixture;
+    mpt::ExitStatusMock exit_status_mock;
+    NiceMock<MockQemuVirtualMachine> vm{"my_instance"};
+    mp::QemuVirtualMachine::MountArgs mount_args;
+    mp::QemuVirtualMachine::MountHooks mount_hooks;
+    mp::VMMount mount{default_source, {}, {}, mp::VMMount::MountType::Native};
+    std::unordered_map<std::string, std::string> commands{
+        {"echo $PWD/target", "/home/ubuntu/target"},
+        {R"(sudo /bin/bash -c 'P="/home/ubuntu/target"; while [ ! -d "$P/" ]; do P="${P%/*}"; done; echo $P/')",
+         "/home/ubuntu/target"},
+        {fmt::format("sudo mount -t virtiofs {} {}", tag_from_target(default_target), default_target), ""},
+        {fmt::format("findmnt --type virtiofs | grep '{} {}'", default_target, tag_from_target(default_target)), ""},
+        {fmt::format("if mountpoint -q {0}; then sudo umount {0}; else true; fi", default_target), ""},
+    };
+};
+} // namespace
+
+TEST_F(VirtiofsMountHandlerTest, mount_fails_when_vm_not_stopped)
+{
+    EXPECT_CALL(vm, current_state()).WillOnce(Return(mp::VirtualMachine::State::running));
+    MP_EXPECT_THROW_THAT(mp::VirtiofsMountHandler(&vm, &key_provider, default_target, mount),
+                         mp::NativeMountNeedsStoppedVMException,
+                         mpt::match_what(HasSubstr("Please stop the instance")));
+}
+
+TEST_F(VirtiofsMountHandlerTest, mount_adds_vhost_user_device_and_hook)
+{
+    const auto tag = tag_from_target(default_target);
+    {
+        mp::VirtiofsMountHandler handler{&vm, &key_provider, default_target, mount};
+
+        ASSERT_EQ(mount_args.size(), 1u);
+        const auto& [source, args] = mount_args.at(tag);
+        EXPECT_EQ(source, default_source);
+        ASSERT_EQ(args.size(), 4);
+        EXPECT_EQ(args[0], "-chardev");
+        EXPECT_TRUE(args[1].startsWith(QString::fromStdString(fmt::format("socket,id={},path=", tag))));
+        EXPECT_TRUE(args[1].endsWith(".sock"));
+        EXPECT_EQ(args[2], "-device");
+        EXPECT_EQ(args[3].toStdString(), fmt::format("vhost-user-fs-pci,chardev={0},tag={0}", tag));
+
+        EXPECT_EQ(mount_hooks.count(tag), 1u);
+    }
+
+    EXPECT_TRUE(mount_args.empty());
+    EXPECT_TRUE(mount_hooks.empty());
+}
+
+TEST_F(VirtiofsMountHandlerTest, recover_from_suspended)
+{
+    mount_args[tag_from_target(default_target)] = {};
+    EXPECT_CALL(vm, current_state()).WillOnce(Return(mp::VirtualMachine::State::suspended));
+
+    mp::VirtiofsMountHandler handler{&vm, &key_provider, default_target, mount};
+
+    EXPECT_EQ(mount_hooks.count(tag_from_target(default_target)), 1u);
+}
+
+TEST_F(VirtiofsMountHandlerTest, start_success_stop_success)
+{
+    std::string ssh_command_output;
+    REPLACE(ssh_channel_request_exec, mocked_ssh_channel_request_exec(ssh_command_output));
+    REPLACE(ssh_channel_read_timeout, mocked_ssh_channel_read_timeout(ssh_command_output));
+
+    mp::VirtiofsMountHandler handler{&vm, &key_provider, default_target, mount};
+    EXPECT_NO_THROW(handler.activate(&server));
+    EXPECT_NO_THROW(handler.deactivate());
+}
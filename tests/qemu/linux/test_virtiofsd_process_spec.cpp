@@ -0,0 +1,81 @@
+/*
+ * Copyright (C) Canonical, Ltd.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; version 3.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#include "tests/common.h"
+#include "tests/mock_environment_helpers.h"
+
+#include <src/platform/backends/qemu/linux/virtiofsd_process_spec.h>
+
+#include <QTemporaryDir>
+
+namespace mp = multipass;
+namespace mpt = multipass::test;
+using namespace testing;
+
+struct TestVirtiofsdProcessSpec : public Test
+{
+    const QString shared_dir{"/path/to/source"};
+    const QString socket_path{"/tmp/multipass-virtiofs-0123456789abcdef.sock"};
+};
+
+TEST_F(TestVirtiofsdProcessSpec, default_arguments_correct)
+{
+    mp::VirtiofsdProcessSpec spec(shared_dir, socket_path);
+
+    EXPECT_EQ(spec.arguments(),
+              QStringList({"--socket-path=/tmp/multipass-virtiofs-0123456789abcdef.sock",
+                           "--shared-dir=/path/to/source", "--sandbox=chroot", "--cache=auto"}));
+}
+
+TEST_F(TestVirtiofsdProcessSpec, apparmor_profile_identifier)
+{
+    mp::VirtiofsdProcessSpec spec(shared_dir, socket_path);
+
+    EXPECT_EQ(spec.identifier(), "multipass-virtiofs-0123456789abcdef");
+}
+
+TEST_F(TestVirtiofsdProcessSpec, apparmor_profile_permits_shared_dir_and_socket)
+{
+    mp::VirtiofsdProcessSpec spec(shared_dir, socket_path);
+
+    EXPECT_TRUE(spec.apparmor_profile().contains("/path/to/source/ rw,"));
+    EXPECT_TRUE(spec.apparmor_profile().contains("/path/to/source/** rwlk,"));
+    EXPECT_TRUE(spec.apparmor_profile().contains("/tmp/multipass-virtiofs-0123456789abcdef.sock rw,"));
+}
+
+TEST_F(TestVirtiofsdProcessSpec, apparmor_profile_running_as_snap_correct)
+{
+    const QByteArray snap_name{"multipass"};
+    QTemporaryDir snap_dir;
+
+    mpt::SetEnvScope e1("SNAP", snap_dir.path().toUtf8());
+    mpt::SetEnvScope e2("SNAP_NAME", snap_name);
+    mp::VirtiofsdProcessSpec spec(shared_dir, socket_path);
+
+    EXPECT_TRUE(spec.apparmor_profile().contains("signal (receive) peer=snap.multipass.multipassd"));
+}
+
+TEST_F(TestVirtiofsdProcessSpec, apparmor_profile_not_running_as_snap_correct)
+{
+    const QByteArray snap_name{"multipass"};
+
+    mpt::UnsetEnvScope e("SNAP");
+    mpt::SetEnvScope e2("SNAP_NAME", snap_name);
+    mp::VirtiofsdProcessSpec spec(shared_dir, socket_path);
+
+    EXPECT_TRUE(spec.apparmor_profile().contains("signal (receive) peer=unconfined"));
+}
@@ -0,0 +1,164 @@
+/*
+ * Copyright (C) Canonical, Ltd.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; version 3.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#include "tests/common.h"
+#include "tests/temp_dir.h"
+
+#include <src/platform/backends/qemu/qemu_attached_process.h>
+
+#include <QElapsedTimer>
+#include <QLocalServer>
+#include <QThread>
+
+#include <stdexcept>
+
+#include <signal.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+namespace mp = multipass;
+namespace mpt = multipass::test;
+using namespace testing;
+
+namespace
+{
+// Not a child of ours, as QEMU is not the next daemon's; it waits to be killed and is then reaped by someone else
+qint64 spawn_orphan()
+{
+    int pipe_fds[2];
+    if (pipe(pipe_fds) != 0)
+        return -1;
+
+    if (const auto child = fork(); child == 0)
+    {
+        if (const auto grandchild = fork(); grandchild == 0)
+        {
+            pause();
+            _exit(0);
+        }
+        else
+        {
+            [[maybe_unused]] const auto written = write(pipe_fds[1], &grandchild, sizeof(grandchild));
+            _exit(0);
+        }
+    }
+    else if (child > 0)
+        waitpid(child, nullptr, 0);
+
+    pid_t orphan{-1};
+    close(pipe_fds[1]);
+    if (read(pipe_fds[0], &orphan, sizeof(orphan)) != sizeof(orphan))
+        orphan = -1;
+    close(pipe_fds[0]);
+
+    return orphan;
+}
+
+bool gone_within(qint64 pid, int msecs)
+{
+    QElapsedTimer elapsed;
+    elapsed.start();
+    while (mp::QemuAttachedProcess::alive(pid) && elapsed.elapsed() < msecs)
+        QThread::msleep(10);
+
+    return !mp::QemuAttachedProcess::alive(pid);
+}
+
+struct QemuAttachedProcess : public Test
+{
+    QemuAttachedProcess()
+    {
+        server.listen(socket_path);
+    }
+
+    mpt::TempDir temp_dir;
+    const QString socket_path{temp_dir.path() + "/qmp.sock"};
+    QLocalServer server;
+    const QStringList arguments{"qemu-system-x86_64", "-qmp", "stdio"};
+};
+} // namespace
+
+TEST_F(QemuAttachedProcess, throws_when_the_process_is_gone)
+{
+    const auto orphan = spawn_orphan();
+    ASSERT_GT(orphan, 0);
+    ::kill(orphan, SIGKILL);
+    ASSERT_TRUE(gone_within(orphan, 5000));
+
+    MP_EXPECT_THROW_THAT((mp::QemuAttachedProcess{orphan, socket_path, arguments}), std::runtime_error,
+                         mpt::match_what(HasSubstr("is gone")));
+}
+
+TEST_F(QemuAttachedProcess, throws_when_nothing_listens_on_the_monitor_socket)
+{
+    server.close();
+
+    MP_EXPECT_THROW_THAT((mp::QemuAttachedProcess{getpid(), socket_path, arguments}), std::runtime_error,
+                         mpt::match_what(HasSubstr("cannot connect")));
+}
+
+TEST_F(QemuAttachedProcess, talks_qmp_over_the_monitor_socket)
+{
+    mp::QemuAttachedProcess process{getpid(), socket_path, arguments};
+    ASSERT_TRUE(server.waitForNewConnection(5000));
+    auto monitor = server.nextPendingConnection();
+
+    const QByteArray command{"{\"execute\": \"qmp_capabilities\"}\n"};
+    EXPECT_EQ(process.write(command), command.size());
+    ASSERT_TRUE(monitor->waitForReadyRead(5000));
+    EXPECT_EQ(monitor->readAll(), command);
+
+    const QByteArray reply{"{\"return\": {}}\n"};
+    monitor->write(reply);
+    monitor->flush();
+    ASSERT_TRUE(process.wait_for_ready_read(5000));
+    EXPECT_EQ(process.read_all_standard_output(), reply);
+    EXPECT_TRUE(process.read_all_standard_error().isEmpty());
+}
+
+TEST_F(QemuAttachedProcess, stands_for_the_process_it_was_given)
+{
+    mp::QemuAttachedProcess process{getpid(), socket_path, arguments};
+
+    EXPECT_EQ(process.process_id(), getpid());
+    EXPECT_EQ(process.program(), arguments.first());
+    EXPECT_EQ(process.arguments(), arguments);
+    EXPECT_TRUE(process.running());
+    EXPECT_TRUE(process.wait_for_started());
+    EXPECT_FALSE(process.process_state().exit_code);
+    EXPECT_THROW(process.execute(), std::logic_error);
+}
+
+TEST_F(QemuAttachedProcess, tells_once_that_the_process_is_gone)
+{
+    const auto orphan = spawn_orphan();
+    ASSERT_GT(orphan, 0);
+    mp::QemuAttachedProcess process{orphan, socket_path, arguments};
+
+    auto finished = 0;
+    QObject::connect(&process, &mp::Process::finished, [&finished](const mp::ProcessState& state) {
+        ++finished;
+        EXPECT_EQ(state.exit_code, 0);
+    });
+
+    process.kill();
+    EXPECT_TRUE(process.wait_for_finished(5000));
+    EXPECT_FALSE(process.running());
+
+    EXPECT_TRUE(process.wait_for_finished(0));
+    EXPECT_EQ(finished, 1);
+}
@@ -20,6 +20,9 @@
 #include "tests/common.h"
 #include "tests/mock_environment_helpers.h"
 #include "tests/mock_process_factory.h"
+#include "tests/mock_settings.h"
+#include "tests/mock_singleton_helpers.h"
+#include "tests/mock_standard_paths.h"
 #include "tests/mock_status_monitor.h"
 #include "tests/stub_process_factory.h"
 #include "tests/stub_ssh_key_provider.h"
@@ -30,18 +33,32 @@
 
 #include <src/platform/backends/qemu/qemu_virtual_machine.h>
 #include <src/platform/backends/qemu/qemu_virtual_machine_factory.h>
+#include <src/platform/backends/qemu/qemu_vm_process_spec.h>
+
+#ifdef MULTIPASS_PLATFORM_LINUX
+#include "tests/mock_backend_utils.h"
+
+#include <src/platform/backends/shared/linux/cgroups.h>
+#endif
 
 #include <multipass/auto_join_thread.h>
+#include <multipass/constants.h>
 #include <multipass/exceptions/start_exception.h>
 #include <multipass/memory_size.h>
 #include <multipass/platform.h>
 #include <multipass/virtual_machine.h>
 #include <multipass/virtual_machine_description.h>
 
+#include <scope_guard.hpp>
+
+#include <QCoreApplication>
+#include <QFile>
 #include <QJsonArray>
 #include <QJsonDocument>
 #include <QJsonObject>
+#include <QLocalServer>
 
+#include <optional>
 #include <thread>
 
 namespace mp = multipass;
@@ -51,6 +68,20 @@ using namespace testing;
 namespace
 { // copied from QemuVirtualMachine implementation
 constexpr auto suspend_tag = "suspend";
+constexpr auto process_key = "process";
+
+#ifdef MULTIPASS_PLATFORM_LINUX
+// Keeps this process, which stands in for QEMU when reattaching, out of the way of instances' cgroups
+class MockCgroups : public mp::Cgroups
+{
+public:
+    using Cgroups::Cgroups;
+
+    MOCK_METHOD(bool, available, (), (const, override));
+
+    MP_MOCK_SINGLETON_BOILERPLATE(MockCgroups, Cgroups);
+};
+#endif
 } // namespace
 
 struct QemuBackend : public mpt::TestWithMockedBinPath
@@ -134,7 +165,7 @@ struct QemuBackend : public mpt::TestWithMockedBinPath
                             EXPECT_CALL(*process, read_all_standard_output())
                                 .WillRepeatedly(Return(
                                     "{\"timestamp\": {\"seconds\": 1541188919, \"microseconds\": 838498}, \"event\": "
-                                    "\"RESUME\"}"));
+                                    "\"RESUME\"}\n"));
 
                             EXPECT_CALL(*process, kill()).WillOnce([process] {
                                 mp::ProcessState exit_state{
@@ -167,6 +198,9 @@ struct QemuBackend : public mpt::TestWithMockedBinPath
     mpt::MockQemuPlatformFactory::GuardedMock qemu_platform_factory_attr{
         mpt::MockQemuPlatformFactory::inject<NiceMock>()};
     mpt::MockQemuPlatformFactory* mock_qemu_platform_factory{qemu_platform_factory_attr.first};
+
+    mpt::MockSettings::GuardedMock mock_settings_injection = mpt::MockSettings::inject<NiceMock>();
+    mpt::MockSettings& mock_settings = *mock_settings_injection.first;
 };
 
 TEST_F(QemuBackend, creates_in_off_state)
@@ -246,6 +280,50 @@ TEST_F(QemuBackend, machine_start_suspend_sends_monitoring_event)
     machine->suspend();
 }
 
+TEST_F(QemuBackend, records_the_memory_snapshot_before_suspending_to_a_state_file)
+{
+    EXPECT_CALL(mock_settings, get(Eq(mp::qemu_state_file_key))).WillRepeatedly(Return("true"));
+    EXPECT_CALL(*mock_qemu_platform_factory, make_qemu_platform(_)).WillOnce([this](auto...) {
+        return std::move(mock_qemu_platform);
+    });
+
+    QJsonObject metadata;
+    NiceMock<mpt::MockVMStatusMonitor> mock_monitor;
+    ON_CALL(mock_monitor, retrieve_metadata_for(_)).WillByDefault(ReturnPointee(&metadata));
+    ON_CALL(mock_monitor, update_metadata_for(_, _)).WillByDefault(SaveArg<1>(&metadata));
+
+    // QEMU says it is through as soon as it is asked to migrate
+    std::optional<bool> recorded_before_migrating;
+    process_factory->register_callback([&metadata, &recorded_before_migrating](mpt::MockProcess* process) {
+        handle_qemu_system(process);
+        if (!process->program().contains("qemu-system") || process->arguments().contains("-dump-vmstate"))
+            return;
+
+        EXPECT_CALL(*process, write(_)).WillRepeatedly([process, &metadata, &recorded_before_migrating](auto& data) {
+            if (QJsonDocument::fromJson(data)["execute"] == "migrate")
+            {
+                recorded_before_migrating = metadata.contains("memory_snapshot");
+                EXPECT_CALL(*process, read_all_standard_output())
+                    .WillOnce(Return("{\"event\": \"MIGRATION\", \"data\": {\"status\": \"completed\"}}\n"))
+                    .WillRepeatedly(Return(QByteArray{}));
+                emit process->ready_read_standard_output();
+            }
+            return data.size();
+        });
+    });
+
+    mp::QemuVirtualMachineFactory backend{data_dir.path()};
+    auto machine = backend.create_virtual_machine(default_description, mock_monitor);
+    machine->start();
+    machine->state = mp::VirtualMachine::State::running;
+
+    machine->suspend();
+
+    EXPECT_EQ(machine->current_state(), mp::VirtualMachine::State::suspended);
+    EXPECT_THAT(recorded_before_migrating, Optional(true));
+    EXPECT_TRUE(metadata.contains("memory_snapshot"));
+}
+
 TEST_F(QemuBackend, throws_when_shutdown_while_starting)
 {
     mpt::MockProcess* vmproc = nullptr;
@@ -330,6 +408,41 @@ TEST_F(QemuBackend, includes_error_when_shutdown_while_starting)
               mpt::match_what(AllOf(HasSubstr(error_msg), HasSubstr("shutdown"), HasSubstr("starting")))));
 }
 
+TEST_F(QemuBackend, machine_is_ready_once_the_guest_opens_its_readiness_port)
+{
+    mpt::MockProcess* vmproc = nullptr;
+    process_factory->register_callback([&vmproc](mpt::MockProcess* process) {
+        if (process->program().startsWith("qemu-system-") && !process->arguments().contains("-dump-vmstate"))
+        {
+            vmproc = process;
+            EXPECT_CALL(*process, read_all_standard_output())
+                .WillOnce(Return("{\"event\": \"VSERPORT_CHANGE\", \"data\": {\"open\": true, \"id\": \"other\"}}\n"))
+                .WillOnce(Return("{\"event\": \"VSERPORT_CHANGE\", \"data\": {\"open\": true, \"id\": "
+                                 "\"multipass-ready\"}}\n"));
+        }
+    });
+
+    EXPECT_CALL(*mock_qemu_platform_factory, make_qemu_platform(_)).WillOnce([this](auto...) {
+        return std::move(mock_qemu_platform);
+    });
+
+    mpt::StubVMStatusMonitor stub_monitor;
+    mp::QemuVirtualMachineFactory backend{data_dir.path()};
+
+    auto machine = backend.create_virtual_machine(default_description, stub_monitor);
+    machine->start();
+    ASSERT_TRUE(vmproc);
+    EXPECT_FALSE(machine->guest_ready);
+
+    emit vmproc->ready_read_standard_output();
+    EXPECT_FALSE(machine->guest_ready);
+
+    emit vmproc->ready_read_standard_output();
+    EXPECT_TRUE(machine->guest_ready);
+
+    ON_CALL(*vmproc, running()).WillByDefault(Return(false));
+}
+
 TEST_F(QemuBackend, machine_unknown_state_properly_shuts_down)
 {
     EXPECT_CALL(*mock_qemu_platform_factory, make_qemu_platform(_)).WillOnce([this](auto...) {
@@ -412,7 +525,50 @@ TEST_F(QemuBackend, verify_some_common_qemu_arguments)
     EXPECT_TRUE(qemu_args.contains("-qmp"));
     EXPECT_TRUE(qemu_args.contains("stdio"));
     EXPECT_TRUE(qemu_args.contains("-chardev"));
-    EXPECT_TRUE(qemu_args.contains("null,id=char0"));
+    EXPECT_TRUE(qemu_args.contains("ringbuf,id=char0,size=65536"));
+}
+
+TEST_F(QemuBackend, gives_the_guest_a_vsock_address_and_keeps_it_in_the_metadata)
+{
+    EXPECT_CALL(mock_settings, get(Eq(mp::qemu_vsock_key))).WillRepeatedly(Return("true"));
+    EXPECT_CALL(*mock_qemu_platform_factory, make_qemu_platform(_)).WillOnce([this](auto...) {
+        return std::move(mock_qemu_platform);
+    });
+
+    QJsonObject metadata;
+    NiceMock<mpt::MockVMStatusMonitor> mock_monitor;
+    ON_CALL(mock_monitor, retrieve_metadata_for(_)).WillByDefault(ReturnPointee(&metadata));
+    ON_CALL(mock_monitor, update_metadata_for(_, _)).WillByDefault(SaveArg<1>(&metadata));
+
+    mp::QemuVirtualMachineFactory backend{data_dir.path()};
+    auto machine = backend.create_virtual_machine(default_description, mock_monitor);
+    machine->start();
+    machine->state = mp::VirtualMachine::State::running;
+
+    const auto cid = mp::QemuVMProcessSpec::vsock_cid_for(default_description.vm_name);
+    EXPECT_EQ(metadata["vsock_cid"].toDouble(), cid);
+    EXPECT_EQ(machine->vsock_cid(), std::make_optional(cid));
+}
+
+TEST_F(QemuBackend, starts_with_the_vsock_address_kept_in_the_metadata)
+{
+    EXPECT_CALL(mock_settings, get(Eq(mp::qemu_vsock_key))).WillRepeatedly(Return("true"));
+    EXPECT_CALL(*mock_qemu_platform_factory, make_qemu_platform(_)).WillOnce([this](auto...) {
+        return std::move(mock_qemu_platform);
+    });
+
+    QJsonObject metadata{{"vsock_cid", 4242}};
+    NiceMock<mpt::MockVMStatusMonitor> mock_monitor;
+    ON_CALL(mock_monitor, retrieve_metadata_for(_)).WillByDefault(ReturnPointee(&metadata));
+    ON_CALL(mock_monitor, update_metadata_for(_, _)).WillByDefault(SaveArg<1>(&metadata));
+
+    mp::QemuVirtualMachineFactory backend{data_dir.path()};
+    auto machine = backend.create_virtual_machine(default_description, mock_monitor);
+    machine->start();
+    machine->state = mp::VirtualMachine::State::running;
+
+    EXPECT_EQ(machine->vsock_cid(), std::make_optional(std::uint32_t{4242}));
+    EXPECT_EQ(metadata["vsock_cid"].toInt(), 4242);
 }
 
 TEST_F(QemuBackend, verify_qemu_arguments_when_resuming_suspend_image)
@@ -473,6 +629,43 @@ TEST_F(QemuBackend, verify_qemu_arguments_when_resuming_suspend_image_uses_metad
     EXPECT_TRUE(qemu->arguments.contains(machine_type));
 }
 
+TEST_F(QemuBackend, verify_qemu_arguments_when_resuming_from_memory_snapshot_file)
+{
+    constexpr auto restore_uri = "exec:cat 'state'";
+
+    EXPECT_CALL(*mock_qemu_platform_factory, make_qemu_platform(_)).WillOnce([this](auto...) {
+        return std::move(mock_qemu_platform);
+    });
+
+    QFile memory_snapshot{dummy_image.name() + ".state"};
+    ASSERT_TRUE(memory_snapshot.open(QIODevice::WriteOnly));
+    memory_snapshot.close();
+    auto remove_snapshot = sg::make_scope_guard([&memory_snapshot]() noexcept { memory_snapshot.remove(); });
+
+    NiceMock<mpt::MockVMStatusMonitor> mock_monitor;
+    EXPECT_CALL(mock_monitor, retrieve_metadata_for(_))
+        .WillRepeatedly(Return(QJsonObject({{"memory_snapshot", restore_uri}})));
+
+    mp::QemuVirtualMachineFactory backend{data_dir.path()};
+
+    auto machine = backend.create_virtual_machine(default_description, mock_monitor);
+    EXPECT_THAT(machine->current_state(), Eq(mp::VirtualMachine::State::suspended));
+
+    machine->start();
+    machine->state = mp::VirtualMachine::State::running;
+
+    auto processes = process_factory->process_list();
+    auto qemu = std::find_if(processes.cbegin(), processes.cend(),
+                             [](const mpt::MockProcessFactory::ProcessInfo& process_info) {
+                                 return process_info.command.startsWith("qemu-system-");
+                             });
+
+    ASSERT_TRUE(qemu != processes.cend());
+    EXPECT_THAT(qemu->arguments, Contains("-incoming"));
+    EXPECT_THAT(qemu->arguments, Contains(restore_uri));
+    EXPECT_FALSE(qemu->arguments.contains("-loadvm"));
+}
+
 TEST_F(QemuBackend, verify_qemu_arguments_from_metadata_are_used)
 {
     constexpr auto suspend_tag = "suspend";
@@ -749,6 +942,86 @@ TEST_F(QemuBackend, get_backend_directory_name_calls_qemu_platform)
     EXPECT_TRUE(get_directory_name_called);
 }
 
+#ifdef MULTIPASS_PLATFORM_LINUX
+struct QemuBackendReattach : public QemuBackend
+{
+    QemuBackendReattach()
+    {
+        EXPECT_CALL(*mock_qemu_platform_factory, make_qemu_platform(_)).WillOnce([this](auto...) {
+            return std::move(mock_qemu_platform);
+        });
+        EXPECT_CALL(mpt::MockStandardPaths::mock_instance(), writableLocation(mp::StandardPaths::RuntimeLocation))
+            .WillRepeatedly(Return(data_dir.path()));
+        EXPECT_CALL(*mock_cgroups, available).WillRepeatedly(Return(false));
+        EXPECT_CALL(mock_settings, get(Eq(mp::qemu_reattach_key))).WillRepeatedly(Return("true"));
+
+        monitor_server.listen(data_dir.path() + "/monitor.sock");
+    }
+
+    // What the daemon before recorded, with this very process standing in for the QEMU it left running
+    void record_process(qint64 pidfile_pid)
+    {
+        QFile pidfile{mp::QemuVMProcessSpec::pidfile_for(default_description.vm_name)};
+        ASSERT_TRUE(pidfile.open(QIODevice::WriteOnly));
+        pidfile.write(QByteArray::number(pidfile_pid) + "\n");
+
+        EXPECT_CALL(mock_monitor, retrieve_metadata_for(_))
+            .WillRepeatedly(Return(QJsonObject{
+                {process_key, QJsonObject{{"pid", pid}, {"monitor", monitor_server.fullServerName()}}}}));
+    }
+
+    const qint64 pid{QCoreApplication::applicationPid()};
+    MockCgroups::GuardedMock cgroups_injection{MockCgroups::inject<NiceMock>()};
+    MockCgroups* mock_cgroups{cgroups_injection.first};
+    mpt::MockBackend::GuardedMock backend_injection{mpt::MockBackend::inject<NiceMock>()};
+    mpt::MockBackend* mock_backend{backend_injection.first};
+    QLocalServer monitor_server;
+    NiceMock<mpt::MockVMStatusMonitor> mock_monitor;
+};
+
+TEST_F(QemuBackendReattach, takes_back_the_qemu_left_running_and_leaves_it_running_again)
+{
+    record_process(pid);
+    EXPECT_CALL(*mock_backend, service_spares_children).WillOnce(Return(true));
+    EXPECT_CALL(mock_monitor, on_suspend).Times(0);
+
+    mp::QemuVirtualMachineFactory backend{data_dir.path()};
+    {
+        auto machine = backend.create_virtual_machine(default_description, mock_monitor);
+        EXPECT_EQ(machine->current_state(), mp::VirtualMachine::State::running);
+        EXPECT_TRUE(monitor_server.waitForNewConnection(5000));
+    } // this process is to be left running, or the test would not get past here
+}
+
+TEST_F(QemuBackendReattach, does_not_take_back_a_pid_that_is_not_the_instances_anymore)
+{
+    record_process(pid + 1);
+    EXPECT_CALL(mock_monitor, update_metadata_for(_, Truly([](const QJsonObject& metadata) {
+                                                      return !metadata.contains(process_key);
+                                                  })));
+
+    mp::QemuVirtualMachineFactory backend{data_dir.path()};
+    auto machine = backend.create_virtual_machine(default_description, mock_monitor);
+
+    EXPECT_EQ(machine->current_state(), mp::VirtualMachine::State::off);
+    EXPECT_FALSE(monitor_server.hasPendingConnections());
+}
+
+TEST_F(QemuBackendReattach, suspends_the_instance_when_its_service_stopping_would_kill_it)
+{
+    EXPECT_CALL(*mock_backend, service_spares_children).WillOnce(Return(false));
+    process_factory->register_callback(handle_qemu_system);
+
+    mp::QemuVirtualMachineFactory backend{data_dir.path()};
+    auto machine = backend.create_virtual_machine(default_description, mock_monitor);
+    machine->start();
+    machine->state = mp::VirtualMachine::State::running;
+
+    EXPECT_CALL(mock_monitor, on_suspend);
+    machine.reset();
+}
+#endif
+
 TEST(QemuPlatform, base_qemu_platform_returns_expected_values)
 {
     mpt::MockQemuPlatform qemu_platform;
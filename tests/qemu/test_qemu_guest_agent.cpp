@@ -0,0 +1,172 @@
+/*
+ * Copyright (C) Canonical, Ltd.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; version 3.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+#include "tests/common.h"
+
+#include <src/platform/backends/qemu/qemu_guest_agent.h>
+
+#include <QIODevice>
+#include <QJsonArray>
+#include <QJsonDocument>
+
+#include <algorithm>
+#include <cstring>
+#include <map>
+#include <stdexcept>
+#include <vector>
+
+namespace mp = multipass;
+namespace mpt = multipass::test;
+using namespace testing;
+using namespace std::chrono_literals;
+
+namespace
+{
+// Answers each command as it is written, the way qemu-ga would
+class FakeGuestAgent : public QIODevice
+{
+public:
+    FakeGuestAgent()
+    {
+        open(QIODevice::ReadWrite);
+    }
+
+    bool isSequential() const override
+    {
+        return true;
+    }
+
+    qint64 bytesAvailable() const override
+    {
+        return unread.size() + QIODevice::bytesAvailable();
+    }
+
+    std::vector<QJsonObject> commands;
+    std::map<QString, QJsonObject> replies; // by command, guest-sync is answered as it should be unless given
+    QByteArray unread;
+
+protected:
+    qint64 readData(char* data, qint64 max_size) override
+    {
+        const auto size = std::min<qint64>(max_size, unread.size());
+        std::memcpy(data, unread.constData(), size);
+        unread.remove(0, size);
+        return size;
+    }
+
+    qint64 writeData(const char* data, qint64 size) override
+    {
+        for (const auto& line : QByteArray{data, static_cast<int>(size)}.split('\n'))
+        {
+            if (line.isEmpty())
+                continue;
+
+            const auto command = QJsonDocument::fromJson(line).object();
+            commands.push_back(command);
+
+            const auto name = command["execute"].toString();
+            if (const auto reply = replies.find(name); reply != replies.end())
+                answer(reply->second);
+            else if (name == "guest-sync")
+                answer({{"return", command["arguments"].toObject()["id"]}});
+        }
+
+        return size;
+    }
+
+private:
+    void answer(const QJsonObject& reply)
+    {
+        unread += QJsonDocument{reply}.toJson(QJsonDocument::Compact) + '\n';
+    }
+};
+
+struct TestQemuGuestAgent : public Test
+{
+    FakeGuestAgent device;
+};
+} // namespace
+
+TEST_F(TestQemuGuestAgent, syncs_first_skipping_what_was_left_unread)
+{
+    device.unread = "{\"return\": {\"pid\": 7}}\n{\"retu";
+
+    mp::QemuGuestAgent agent{device, 1s};
+
+    ASSERT_THAT(device.commands, SizeIs(1));
+    EXPECT_EQ(device.commands[0]["execute"].toString(), "guest-sync");
+    EXPECT_TRUE(device.unread.isEmpty());
+}
+
+TEST_F(TestQemuGuestAgent, exec_gives_what_the_command_printed)
+{
+    device.replies["guest-exec"] = {{"return", QJsonObject{{"pid", 42}}}};
+    const auto output = QString{QByteArray{"42\n"}.toBase64()};
+    device.replies["guest-exec-status"] = {
+        {"return", QJsonObject{{"exited", true}, {"exitcode", 0}, {"out-data", output}}}};
+
+    mp::QemuGuestAgent agent{device, 1s};
+
+    EXPECT_EQ(agent.exec("nproc"), "42\n");
+
+    ASSERT_THAT(device.commands, SizeIs(3));
+    EXPECT_EQ(device.commands[1]["arguments"].toObject()["arg"].toArray(), (QJsonArray{"-c", "nproc"}));
+    EXPECT_EQ(device.commands[2]["arguments"].toObject()["pid"].toInt(), 42);
+}
+
+TEST_F(TestQemuGuestAgent, exec_throws_when_the_command_fails)
+{
+    device.replies["guest-exec"] = {{"return", QJsonObject{{"pid", 42}}}};
+    device.replies["guest-exec-status"] = {{"return", QJsonObject{{"exited", true}, {"exitcode", 1}}}};
+
+    mp::QemuGuestAgent agent{device, 1s};
+
+    MP_EXPECT_THROW_THAT(agent.exec("false"), std::runtime_error, mpt::match_what(HasSubstr("exited with code 1")));
+}
+
+TEST_F(TestQemuGuestAgent, ipv4_leaves_out_loopback_and_ipv6)
+{
+    const auto address = [](const QString& type, const QString& ip) {
+        return QJsonObject{{"ip-address-type", type}, {"ip-address", ip}, {"prefix", 24}};
+    };
+    device.replies["guest-network-get-interfaces"] = {
+        {"return",
+         QJsonArray{QJsonObject{{"name", "lo"}, {"ip-addresses", QJsonArray{address("ipv4", "127.0.0.1")}}},
+                    QJsonObject{{"name", "enp5s0"},
+                                {"ip-addresses", QJsonArray{address("ipv4", "10.1.2.3"), address("ipv6", "fe80::1")}}},
+                    QJsonObject{{"name", "enp6s0"}, {"ip-addresses", QJsonArray{address("ipv4", "192.168.7.8")}}}}}};
+
+    mp::QemuGuestAgent agent{device, 1s};
+
+    EXPECT_THAT(agent.ipv4(), ElementsAre("10.1.2.3", "192.168.7.8"));
+}
+
+TEST_F(TestQemuGuestAgent, throws_what_the_agent_says_went_wrong)
+{
+    device.replies["guest-exec"] = {{"error", QJsonObject{{"class", "GenericError"}, {"desc", "not allowed"}}}};
+
+    mp::QemuGuestAgent agent{device, 1s};
+
+    MP_EXPECT_THROW_THAT(agent.exec("nproc"), std::runtime_error, mpt::match_what(HasSubstr("not allowed")));
+}
+
+TEST_F(TestQemuGuestAgent, throws_when_the_agent_does_not_answer)
+{
+    device.replies["guest-sync"] = {}; // not answering, as far as the client can tell
+
+    MP_EXPECT_THROW_THAT((mp::QemuGuestAgent{device, 1s}), std::runtime_error,
+                         mpt::match_what(HasSubstr("did not answer")));
+}
@@ -16,13 +16,20 @@
  */
 
 #include "tests/common.h"
+#include "tests/file_operations.h"
 #include "tests/mock_process_factory.h"
+#include "tests/temp_dir.h"
 
 #include <src/platform/backends/shared/qemu_img_utils/qemu_img_utils.h>
 
 #include <multipass/constants.h>
 #include <multipass/memory_size.h>
 
+#include <QDir>
+#include <QFile>
+#include <QFileInfo>
+#include <QtEndian>
+
 namespace mp = multipass;
 namespace mpt = multipass::test;
 
@@ -83,14 +90,17 @@ void simulate_qemuimg_convert(const mpt::MockProcess* process, const QString& im
     ASSERT_EQ(process->program().toStdString(), "qemu-img");
 
     const auto args = process->arguments();
-    ASSERT_EQ(args.size(), 6);
+    ASSERT_EQ(args.size(), 10);
 
     EXPECT_EQ(args.at(0), "convert");
     EXPECT_EQ(args.at(1), "-p");
-    EXPECT_EQ(args.at(2), "-O");
-    EXPECT_EQ(args.at(3), "qcow2");
-    EXPECT_EQ(args.at(4), img_path);
-    EXPECT_EQ(args.at(5), expected_img_path);
+    EXPECT_EQ(args.at(2), "-m");
+    EXPECT_EQ(args.at(4), "-f");
+    EXPECT_EQ(args.at(5), "raw");
+    EXPECT_EQ(args.at(6), "-O");
+    EXPECT_EQ(args.at(7), "qcow2");
+    EXPECT_EQ(args.at(8), img_path);
+    EXPECT_EQ(args.at(9), expected_img_path);
 
     EXPECT_CALL(*process, execute).WillOnce(Return(produce_result));
 }
@@ -159,6 +169,26 @@ const std::vector<ImageConversionParamType> image_conversion_inputs{
      std::make_optional(HasSubstr("not found"))},
     {"/fake/img/path.qcow2", "{\n    \"format\": \"raw\"\n}", success, true, failure,
      std::make_optional(HasSubstr("qemu-img failed"))}};
+
+std::string qcow2_header(quint32 version, quint64 virtual_size)
+{
+    std::string header(32, '\0');
+    header.replace(0, 4, "QFI\xfb");
+    qToBigEndian(version, header.data() + 4);
+    qToBigEndian(virtual_size, header.data() + 24);
+
+    return header;
+}
+
+std::string qcow2_overlay_header(const std::string& backing_file)
+{
+    auto header = qcow2_header(3, 1048576);
+    header.resize(104, '\0');
+    qToBigEndian(quint64{104}, header.data() + 8);
+    qToBigEndian(static_cast<quint32>(backing_file.size()), header.data() + 16);
+
+    return header + backing_file;
+}
 } // namespace
 
 TEST(QemuImgUtils, image_resizing_checks_minimum_size_and_proceeds_when_larger)
@@ -216,4 +246,282 @@ TEST_P(ImageConversionTestSuite, properly_handles_image_conversion)
                           qemuimg_convert_result, throw_msg_matcher);
 }
 
+TEST(QemuImgUtils, reads_qcow2_header_in_process)
+{
+    mpt::TempDir dir;
+    const auto img_path = dir.filePath("image.img");
+    mpt::make_file_with_content(img_path, qcow2_header(3, 10737418240));
+
+    const auto header = mp::backend::read_image_header(img_path);
+
+    ASSERT_TRUE(header);
+    EXPECT_EQ(header->format, "qcow2");
+    EXPECT_EQ(header->virtual_size, mp::MemorySize{"10G"});
+    EXPECT_FALSE(header->zstd_compressed);
+}
+
+TEST(QemuImgUtils, tells_zstd_compressed_qcow2_images)
+{
+    mpt::TempDir dir;
+    const auto img_path = dir.filePath("image.img");
+    auto header = qcow2_header(3, 1048576);
+    header.resize(104, '\0');
+    qToBigEndian(quint64{1} << 3, header.data() + 72);
+    mpt::make_file_with_content(img_path, header);
+
+    const auto read = mp::backend::read_image_header(img_path);
+
+    ASSERT_TRUE(read);
+    EXPECT_TRUE(read->zstd_compressed);
+}
+
+TEST(QemuImgUtils, reads_backing_files_relative_to_the_image)
+{
+    mpt::TempDir dir;
+    const auto img_path = dir.filePath("image.img");
+    const auto base_path = dir.filePath("base.img");
+    mpt::make_file_with_content(img_path, qcow2_overlay_header("snapshots/clean.qcow2"));
+    mpt::make_file_with_content(base_path, qcow2_header(3, 1048576));
+
+    const auto overlay = mp::backend::read_image_header(img_path);
+    const auto base = mp::backend::read_image_header(base_path);
+
+    ASSERT_TRUE(overlay);
+    EXPECT_EQ(overlay->backing_file, QDir{dir.path()}.absoluteFilePath("snapshots/clean.qcow2"));
+    ASSERT_TRUE(base);
+    EXPECT_TRUE(base->backing_file.isEmpty());
+}
+
+TEST(QemuImgUtils, does_not_read_unknown_headers)
+{
+    mpt::TempDir dir;
+    const auto raw_path = dir.filePath("raw.img");
+    const auto future_path = dir.filePath("future.img");
+    mpt::make_file_with_content(raw_path, std::string(512, '\0'));
+    mpt::make_file_with_content(future_path, qcow2_header(4, 1024));
+
+    EXPECT_FALSE(mp::backend::read_image_header(raw_path));
+    EXPECT_FALSE(mp::backend::read_image_header(future_path));
+    EXPECT_FALSE(mp::backend::read_image_header(dir.filePath("missing.img")));
+}
+
+TEST(QemuImgUtils, qcow2_images_are_not_converted_nor_inspected_with_qemuimg)
+{
+    mpt::TempDir dir;
+    const auto img_path = dir.filePath("image.img");
+    mpt::make_file_with_content(img_path, qcow2_header(2, 1048576));
+
+    auto mock_factory_scope = mpt::MockProcessFactory::Inject();
+
+    EXPECT_EQ(mp::backend::convert_to_qcow_if_necessary(img_path), img_path);
+    EXPECT_TRUE(mock_factory_scope->process_list().empty());
+}
+
+TEST(QemuImgUtils, clones_qcow2_images_with_qemuimg)
+{
+    mpt::TempDir dir;
+    const auto img_path = dir.filePath("image.img");
+    const auto clone_path = dir.filePath("clone.img");
+    mpt::make_file_with_content(img_path, qcow2_header(3, 1048576));
+
+    auto mock_factory_scope = mpt::MockProcessFactory::Inject();
+    mock_factory_scope->register_callback([&](mpt::MockProcess* process) {
+        const auto args = process->arguments();
+        ASSERT_EQ(args.size(), 10);
+        EXPECT_EQ(args.at(0), "convert");
+        EXPECT_EQ(args.at(5), "qcow2");
+        EXPECT_EQ(args.at(8), img_path);
+        EXPECT_EQ(args.at(9), clone_path);
+        EXPECT_CALL(*process, execute).WillOnce(Return(success));
+    });
+
+    mp::backend::clone_image(img_path, clone_path);
+    EXPECT_EQ(mock_factory_scope->process_list().size(), 1u);
+}
+
+TEST(QemuImgUtils, copies_other_images_when_cloning)
+{
+    mpt::TempDir dir;
+    const auto img_path = dir.filePath("image.img");
+    const auto clone_path = dir.filePath("clone.img");
+    mpt::make_file_with_content(img_path, "raw contents");
+
+    auto mock_factory_scope = mpt::MockProcessFactory::Inject();
+
+    mp::backend::clone_image(img_path, clone_path);
+    EXPECT_TRUE(mock_factory_scope->process_list().empty());
+    EXPECT_TRUE(QFile::exists(clone_path));
+}
+
+TEST(QemuImgUtils, compacts_qcow2_images_in_place_with_qemuimg)
+{
+    mpt::TempDir dir;
+    const auto img_path = dir.filePath("image.img");
+    mpt::make_file_with_content(img_path, qcow2_header(3, 1048576));
+
+    auto mock_factory_scope = mpt::MockProcessFactory::Inject();
+    mock_factory_scope->register_callback([&](mpt::MockProcess* process) {
+        const auto args = process->arguments();
+        ASSERT_EQ(args.size(), 11);
+        EXPECT_EQ(args.at(0), "convert");
+        EXPECT_EQ(args.at(8), "-c");
+        EXPECT_EQ(args.at(9), img_path);
+        EXPECT_CALL(*process, execute).WillOnce([compacted_path = args.at(10)](auto) {
+            mpt::make_file_with_content(compacted_path, "compacted");
+            return success;
+        });
+    });
+
+    mp::backend::compact_image(img_path, /*compress=*/true);
+    EXPECT_EQ(mock_factory_scope->process_list().size(), 1u);
+    EXPECT_EQ(QFileInfo{img_path}.size(), 9);
+    EXPECT_FALSE(QFile::exists(img_path + ".rewriting"));
+}
+
+TEST(QemuImgUtils, does_not_compact_other_images)
+{
+    mpt::TempDir dir;
+    const auto img_path = dir.filePath("image.img");
+    mpt::make_file_with_content(img_path, "raw contents");
+
+    auto mock_factory_scope = mpt::MockProcessFactory::Inject();
+
+    EXPECT_THROW(mp::backend::compact_image(img_path, false), std::runtime_error);
+    EXPECT_TRUE(mock_factory_scope->process_list().empty());
+}
+
+TEST(QemuImgUtils, compacting_an_overlay_keeps_its_backing_file)
+{
+    mpt::TempDir dir;
+    const auto img_path = dir.filePath("image.img");
+    const auto backing_path = dir.filePath("snapshots/clean.qcow2");
+    mpt::make_file_with_content(img_path, qcow2_overlay_header(backing_path.toStdString()));
+
+    auto mock_factory_scope = mpt::MockProcessFactory::Inject();
+    mock_factory_scope->register_callback([&](mpt::MockProcess* process) {
+        const auto args = process->arguments();
+        ASSERT_EQ(args.size(), 14);
+        EXPECT_EQ(args.mid(8, 4), QStringList({"-B", backing_path, "-o", "backing_fmt=qcow2"}));
+        EXPECT_EQ(args.at(12), img_path);
+        EXPECT_CALL(*process, execute).WillOnce([compacted_path = args.at(13)](auto) {
+            mpt::make_file_with_content(compacted_path, "compacted");
+            return success;
+        });
+    });
+
+    mp::backend::compact_image(img_path, /*compress=*/false);
+    EXPECT_EQ(mock_factory_scope->process_list().size(), 1u);
+}
+
+TEST(QemuImgUtils, compresses_qcow2_images_in_place_with_zstd)
+{
+    mpt::TempDir dir;
+    const auto img_path = dir.filePath("image.img");
+    mpt::make_file_with_content(img_path, qcow2_header(3, 1048576));
+
+    auto mock_factory_scope = mpt::MockProcessFactory::Inject();
+    mock_factory_scope->register_callback([&](mpt::MockProcess* process) {
+        const auto args = process->arguments();
+        ASSERT_EQ(args.size(), 13);
+        EXPECT_EQ(args.at(0), "convert");
+        EXPECT_EQ(args.at(8), "-c");
+        EXPECT_EQ(args.at(10), "compression_type=zstd");
+        EXPECT_EQ(args.at(11), img_path);
+        EXPECT_CALL(*process, execute).WillOnce([compressed_path = args.at(12)](auto) {
+            mpt::make_file_with_content(compressed_path, "compressed");
+            return success;
+        });
+    });
+
+    mp::backend::compress_image(img_path);
+    EXPECT_EQ(mock_factory_scope->process_list().size(), 1u);
+    EXPECT_EQ(QFileInfo{img_path}.size(), 10);
+    EXPECT_FALSE(QFile::exists(img_path + ".rewriting"));
+}
+
+TEST(QemuImgUtils, snapshots_and_restores_images_through_overlays)
+{
+    mpt::TempDir dir;
+    const auto img_path = dir.filePath("image.img");
+    const auto snapshot_path = QDir{mp::backend::snapshots_dir(img_path)}.filePath("clean.qcow2");
+    mpt::make_file_with_content(img_path, "original");
+
+    auto mock_factory_scope = mpt::MockProcessFactory::Inject();
+    mock_factory_scope->register_callback([&](mpt::MockProcess* process) {
+        const auto args = process->arguments();
+        ASSERT_EQ(args.size(), 8);
+        EXPECT_EQ(args.at(0), "create");
+        EXPECT_EQ(args.at(6), snapshot_path);
+        EXPECT_CALL(*process, execute).WillOnce([overlay_path = args.at(7)](auto) {
+            mpt::make_file_with_content(overlay_path, "overlay");
+            return success;
+        });
+    });
+
+    mp::backend::snapshot_image(img_path, "clean");
+    EXPECT_EQ(mpt::load(snapshot_path), "original");
+    EXPECT_EQ(mpt::load(img_path), "overlay");
+    EXPECT_THROW(mp::backend::snapshot_image(img_path, "clean"), std::runtime_error);
+
+    ASSERT_TRUE(QFile::remove(img_path));
+    mpt::make_file_with_content(img_path, "changed");
+    mp::backend::restore_image(img_path, "clean");
+    EXPECT_EQ(mpt::load(img_path), "overlay");
+    EXPECT_EQ(mpt::load(snapshot_path), "original");
+    EXPECT_EQ(mock_factory_scope->process_list().size(), 2u);
+
+    MP_EXPECT_THROW_THAT(mp::backend::restore_image(img_path, "dirty"), std::runtime_error,
+                         mpt::match_what(AllOf(HasSubstr("no snapshot named \"dirty\""), HasSubstr("clean"))));
+}
+
+TEST(QemuImgUtils, deleting_a_snapshot_rebases_what_was_an_overlay_of_it)
+{
+    mpt::TempDir dir;
+    const auto img_path = dir.filePath("image.img");
+    const auto first_path = QDir{mp::backend::snapshots_dir(img_path)}.filePath("first.qcow2");
+    const auto second_path = QDir{mp::backend::snapshots_dir(img_path)}.filePath("second.qcow2");
+    ASSERT_TRUE(QDir{}.mkpath(mp::backend::snapshots_dir(img_path)));
+    mpt::make_file_with_content(first_path, qcow2_header(3, 1048576));
+    mpt::make_file_with_content(second_path, qcow2_overlay_header(first_path.toStdString()));
+    mpt::make_file_with_content(img_path, qcow2_overlay_header(second_path.toStdString()));
+
+    auto mock_factory_scope = mpt::MockProcessFactory::Inject();
+    mock_factory_scope->register_callback([](mpt::MockProcess* process) {
+        EXPECT_CALL(*process, execute).WillOnce(Return(success));
+    });
+
+    mp::backend::delete_snapshot(img_path, "second");
+
+    ASSERT_EQ(mock_factory_scope->process_list().size(), 1u);
+    EXPECT_EQ(mock_factory_scope->process_list().front().arguments,
+              QStringList({"rebase", "-f", "qcow2", "-b", first_path, "-F", "qcow2", img_path}));
+    EXPECT_FALSE(QFile::exists(second_path));
+    EXPECT_EQ(mp::backend::list_snapshots(img_path), QStringList{"first"});
+
+    MP_EXPECT_THROW_THAT(mp::backend::delete_snapshot(img_path, "second"), std::runtime_error,
+                         mpt::match_what(AllOf(HasSubstr("no snapshot named \"second\""), HasSubstr("first"))));
+}
+
+TEST(QemuImgUtils, deleting_the_first_snapshot_leaves_its_overlay_standalone)
+{
+    mpt::TempDir dir;
+    const auto img_path = dir.filePath("image.img");
+    const auto first_path = QDir{mp::backend::snapshots_dir(img_path)}.filePath("first.qcow2");
+    ASSERT_TRUE(QDir{}.mkpath(mp::backend::snapshots_dir(img_path)));
+    mpt::make_file_with_content(first_path, qcow2_header(3, 1048576));
+    mpt::make_file_with_content(img_path, qcow2_overlay_header(first_path.toStdString()));
+
+    auto mock_factory_scope = mpt::MockProcessFactory::Inject();
+    mock_factory_scope->register_callback([](mpt::MockProcess* process) {
+        EXPECT_CALL(*process, execute).WillOnce(Return(success));
+    });
+
+    mp::backend::delete_snapshot(img_path, "first");
+
+    ASSERT_EQ(mock_factory_scope->process_list().size(), 1u);
+    EXPECT_EQ(mock_factory_scope->process_list().front().arguments,
+              QStringList({"rebase", "-f", "qcow2", "-b", "", img_path}));
+    EXPECT_TRUE(mp::backend::list_snapshots(img_path).isEmpty());
+}
+
 INSTANTIATE_TEST_SUITE_P(QemuImgUtils, ImageConversionTestSuite, ValuesIn(image_conversion_inputs));
@@ -17,9 +17,13 @@
 
 #include "tests/common.h"
 #include "tests/mock_environment_helpers.h"
+#include "tests/mock_settings.h"
+#include "tests/mock_standard_paths.h"
 
 #include <src/platform/backends/qemu/qemu_vm_process_spec.h>
 
+#include <multipass/constants.h>
+
 #include <QString>
 #include <QStringList>
 #include <QTemporaryDir>
@@ -49,13 +53,29 @@ struct TestQemuVMProcessSpec : public Test
          {"path/to/source",
           {"-virtfs", "local,security_model=passthrough,uid_map=1000:1000,gid_map=1000:1000,path=path/to/"
                       "target,mount_tag=m810e457178f448d9afffc9d950d726"}}}};
+
+    mpt::MockSettings::GuardedMock mock_settings_injection = mpt::MockSettings::inject<NiceMock>();
+    mpt::MockSettings& mock_settings = *mock_settings_injection.first;
 };
 
 TEST_F(TestQemuVMProcessSpec, default_arguments_correct)
 {
-    mp::QemuVMProcessSpec spec(desc, platform_args, mount_args, std::nullopt);
-
-    EXPECT_EQ(spec.arguments(), QStringList({"--enable-kvm",
+    mp::QemuVMProcessSpec spec(desc, platform_args, mount_args, std::nullopt, {});
+
+    auto args = spec.arguments();
+    if constexpr (mp::QemuVMProcessSpec::hotplug_supported())
+    {
+        // What they can grow to depends on the host, checked on their own
+        const auto smp = args.indexOf("-smp") + 1, memory = args.indexOf("-m") + 1;
+        ASSERT_GT(smp, 0);
+        ASSERT_GT(memory, 0);
+        EXPECT_THAT(args[smp].toStdString(), MatchesRegex("2,maxcpus=[0-9]+"));
+        EXPECT_THAT(args[memory].toStdString(), MatchesRegex("3072M,slots=8,maxmem=[0-9]+M"));
+        args[smp] = "2";
+        args[memory] = "3072M";
+    }
+
+    EXPECT_EQ(args, QStringList({"--enable-kvm",
                                              "-nic",
                                              "tap,ifname=tap_device,script=no,downscript=no",
                                              "-device",
@@ -68,25 +88,219 @@ TEST_F(TestQemuVMProcessSpec, default_arguments_correct)
                                              "2",
                                              "-m",
                                              "3072M",
+                                             "-machine",
+                                             "mem-merge=on",
                                              "-qmp",
                                              "stdio",
                                              "-chardev",
-                                             "null,id=char0",
+                                             "ringbuf,id=char0,size=65536",
                                              "-serial",
                                              "chardev:char0",
                                              "-nographic",
                                              "-cdrom",
                                              "/path/to/cloud_init.iso",
+                                             "-chardev",
+                                             "null,id=char1",
+                                             "-device",
+                                             "virtio-serial",
+                                             "-device",
+                                             "virtserialport,chardev=char1,id=multipass-ready,"
+                                             "name=com.canonical.multipass.ready",
                                              "-virtfs",
                                              "local,security_model=passthrough,uid_map=1000:1000,gid_map=1000:1000,"
                                              "path=path/to/target,mount_tag=m810e457178f448d9afffc9d950d726"}));
 }
 
+TEST_F(TestQemuVMProcessSpec, vhost_user_mounts_get_shared_memory)
+{
+    const mp::QemuVirtualMachine::MountArgs virtiofs_mount_args{
+        {"m810e457178f448d9afffc9d950d726",
+         {"path/to/source",
+          {"-chardev", "socket,id=m810e457178f448d9afffc9d950d726,path=/tmp/multipass-virtiofs-0123.sock", "-device",
+           "vhost-user-fs-pci,chardev=m810e457178f448d9afffc9d950d726,tag=m810e457178f448d9afffc9d950d726"}}}};
+    mp::QemuVMProcessSpec spec(desc, platform_args, virtiofs_mount_args, std::nullopt, {});
+
+    const auto args = spec.arguments();
+    const auto memory = args.indexOf("-m");
+    ASSERT_NE(memory, -1);
+    ASSERT_LT(memory + 1, args.size());
+    EXPECT_EQ(args[memory + 1].split(',').first(), "3072M"); // followed by room to grow where it can
+    EXPECT_EQ(args.mid(memory + 2, 4), QStringList({"-object", "memory-backend-memfd,id=mem,size=3072M,share=on",
+                                                    "-numa", "node,memdev=mem"}));
+    EXPECT_TRUE(spec.apparmor_profile().contains("/multipass-virtiofs-*.sock rw,"));
+}
+
+TEST_F(TestQemuVMProcessSpec, free_page_reporting_balloon_added_when_asked_for)
+{
+    mp::QemuVMProcessSpec spec(desc, platform_args, mount_args, std::nullopt, {});
+    EXPECT_FALSE(spec.arguments().join(' ').contains("virtio-balloon"));
+
+    EXPECT_CALL(mock_settings, get(Eq(mp::qemu_page_reporting_key))).WillRepeatedly(Return("true"));
+    EXPECT_THAT(spec.arguments(), Contains("virtio-balloon-pci,id=balloon0,deflate-on-oom=on,free-page-reporting=on"));
+}
+
+TEST_F(TestQemuVMProcessSpec, vsock_device_added_when_asked_for)
+{
+    mp::QemuVMProcessSpec spec(desc, platform_args, mount_args, std::nullopt, {});
+    EXPECT_FALSE(spec.arguments().join(' ').contains("vhost-vsock"));
+
+    mp::QemuVMProcessSpec::Tuning tuning;
+    tuning.vsock_cid = 1234;
+    mp::QemuVMProcessSpec vsock_spec(desc, platform_args, mount_args, std::nullopt, tuning);
+    EXPECT_THAT(vsock_spec.arguments(), Contains("vhost-vsock-pci,id=vsock0,guest-cid=1234"));
+    EXPECT_TRUE(vsock_spec.apparmor_profile().contains("/dev/vhost-vsock rw,"));
+}
+
+TEST_F(TestQemuVMProcessSpec, guest_agent_port_added_when_asked_for)
+{
+    mp::QemuVMProcessSpec spec(desc, platform_args, mount_args, std::nullopt, {});
+    EXPECT_FALSE(spec.arguments().join(' ').contains("org.qemu.guest_agent.0"));
+
+    EXPECT_CALL(mock_settings, get(Eq(mp::qemu_guest_agent_key))).WillRepeatedly(Return("true"));
+    const auto socket_path = mp::QemuVMProcessSpec::guest_agent_socket_for(desc.vm_name);
+    EXPECT_THAT(spec.arguments(), Contains(QString("socket,id=qga0,path=%1,server=on,wait=off").arg(socket_path)));
+    EXPECT_THAT(spec.arguments(), Contains("virtserialport,chardev=qga0,name=org.qemu.guest_agent.0"));
+    EXPECT_LE(socket_path.size(), 107);
+    EXPECT_TRUE(spec.apparmor_profile().contains("/multipass-qga-*.sock rw,"));
+}
+
+TEST_F(TestQemuVMProcessSpec, reattach_monitor_and_pidfile_come_last_when_asked_for)
+{
+    const mp::QemuVMProcessSpec::ResumeData resume_data{"suspend_tag", "machine_type", false, {"-one"}, {}};
+    mp::QemuVMProcessSpec spec(desc, platform_args, mount_args, resume_data, {});
+    EXPECT_FALSE(spec.arguments().contains("-pidfile"));
+
+    QTemporaryDir runtime_dir;
+    EXPECT_CALL(mpt::MockStandardPaths::mock_instance(), writableLocation(mp::StandardPaths::RuntimeLocation))
+        .WillRepeatedly(Return(runtime_dir.path()));
+
+    EXPECT_CALL(mock_settings, get(Eq(mp::qemu_reattach_key))).WillRepeatedly(Return("true"));
+    const auto socket_path = mp::QemuVMProcessSpec::monitor_socket_for(desc.vm_name);
+    EXPECT_EQ(spec.arguments(), QStringList({"-one", "-loadvm", "suspend_tag", "-machine", "machine_type"})
+                                    << mount_args.begin()->second.second << "-qmp"
+                                    << QString("unix:%1,server=on,wait=off").arg(socket_path) << "-pidfile"
+                                    << mp::QemuVMProcessSpec::pidfile_for(desc.vm_name));
+    EXPECT_LE(socket_path.size(), 107);
+    EXPECT_TRUE(spec.apparmor_profile().contains(runtime_dir.path() + "/multipass-qmp-*.sock rw,"));
+}
+
+TEST_F(TestQemuVMProcessSpec, reattach_monitor_and_pidfile_are_kept_private)
+{
+    QTemporaryDir data_dir;
+    EXPECT_CALL(mpt::MockStandardPaths::mock_instance(), writableLocation(mp::StandardPaths::RuntimeLocation))
+        .WillRepeatedly(Return(QString{}));
+    EXPECT_CALL(mpt::MockStandardPaths::mock_instance(), writableLocation(mp::StandardPaths::AppLocalDataLocation))
+        .WillRepeatedly(Return(data_dir.path()));
+
+    // Never in the temporary directory, where anyone could put something else there first
+    EXPECT_TRUE(mp::QemuVMProcessSpec::monitor_socket_for(desc.vm_name).startsWith(data_dir.path() + "/"));
+    EXPECT_TRUE(mp::QemuVMProcessSpec::pidfile_for(desc.vm_name).startsWith(data_dir.path() + "/"));
+}
+
+TEST_F(TestQemuVMProcessSpec, vsock_cid_is_stable_and_not_reserved)
+{
+    const auto cid = mp::QemuVMProcessSpec::vsock_cid_for("vm_name");
+
+    EXPECT_GE(cid, 3u);
+    EXPECT_LT(cid, 0xFFFFFFFFu);
+    EXPECT_EQ(cid, mp::QemuVMProcessSpec::vsock_cid_for("vm_name"));
+    EXPECT_NE(cid, mp::QemuVMProcessSpec::vsock_cid_for("other_vm"));
+}
+
+TEST_F(TestQemuVMProcessSpec, virtio_blk_disk_profile_gives_the_disk_an_iothread_and_queues)
+{
+    mp::QemuVMProcessSpec::Tuning tuning;
+    tuning.disk_profile = "virtio-blk";
+    mp::QemuVMProcessSpec spec(desc, platform_args, mount_args, std::nullopt, tuning);
+
+    const auto args = spec.arguments();
+    const auto disk = args.indexOf("-object");
+    ASSERT_NE(disk, -1);
+    EXPECT_EQ(args.mid(disk, 6),
+              QStringList({"-object", "iothread,id=iothread0", "-drive",
+                           "file=/path/to/image,if=none,format=qcow2,discard=unmap,id=hda,cache=none,aio=native",
+                           "-device", "virtio-blk-pci,drive=hda,iothread=iothread0,num-queues=2"}));
+    EXPECT_FALSE(args.join(' ').contains("scsi"));
+}
+
+TEST_F(TestQemuVMProcessSpec, virtio_scsi_disk_profile_keeps_the_scsi_disk)
+{
+    mp::QemuVMProcessSpec::Tuning tuning;
+    tuning.disk_profile = "virtio-scsi";
+    mp::QemuVMProcessSpec spec(desc, platform_args, mount_args, std::nullopt, tuning);
+
+    const auto args = spec.arguments();
+    EXPECT_THAT(args, Contains("virtio-scsi-pci,id=scsi0,iothread=iothread0,num_queues=2"));
+    EXPECT_THAT(args, Contains("scsi-hd,drive=hda,bus=scsi0.0"));
+    EXPECT_TRUE(args.join(' ').contains("cache=none,aio=native"));
+}
+
+TEST_F(TestQemuVMProcessSpec, disk_iops_throttle_the_drive)
+{
+    mp::QemuVMProcessSpec::Tuning tuning;
+    tuning.disk_iops = 500;
+    mp::QemuVMProcessSpec spec(desc, platform_args, mount_args, std::nullopt, tuning);
+
+    EXPECT_THAT(spec.arguments(),
+                Contains("file=/path/to/image,if=none,format=qcow2,discard=unmap,id=hda,throttling.iops-total=500"));
+}
+
+TEST_F(TestQemuVMProcessSpec, nocloud_net_seed_replaces_the_cloud_init_disk)
+{
+    mp::QemuVMProcessSpec::Tuning tuning;
+    tuning.nocloud_net_seed = {"-smbios", "type=1,serial=ds=nocloud-net;s=http://10.0.0.1:8053/foo/"};
+    mp::QemuVMProcessSpec spec(desc, platform_args, mount_args, std::nullopt, tuning);
+
+    const auto args = spec.arguments();
+    EXPECT_THAT(args, Not(Contains("-cdrom")));
+    EXPECT_THAT(args, Contains("-smbios"));
+    EXPECT_THAT(args, Contains("type=1,serial=ds=nocloud-net;s=http://10.0.0.1:8053/foo/"));
+}
+
+TEST_F(TestQemuVMProcessSpec, hugepages_and_numa_node_give_guest_memory_a_backend)
+{
+    mp::QemuVMProcessSpec::Tuning tuning;
+    tuning.hugepages = true;
+    tuning.numa_node = 1;
+    mp::QemuVMProcessSpec spec(desc, platform_args, mount_args, std::nullopt, tuning);
+
+    const auto args = spec.arguments();
+    const auto backend = args.indexOf("memory-backend-memfd,id=mem,size=3072M,hugetlb=on,host-nodes=1,policy=bind");
+    ASSERT_NE(backend, -1);
+    EXPECT_EQ(args.mid(backend - 1, 4), QStringList({"-object", args[backend], "-numa", "node,memdev=mem"}));
+}
+
+TEST_F(TestQemuVMProcessSpec, direct_boot_loads_the_kernel_instead_of_the_firmware)
+{
+    auto firmware_args = platform_args;
+    firmware_args << "-bios"
+                  << "OVMF.fd";
+    mp::QemuVMProcessSpec::Tuning tuning;
+    tuning.direct_boot = mp::QemuVMProcessSpec::Tuning::DirectBoot{"/path/to/image.vmlinuz", "/path/to/image.initrd",
+                                                                   "root=LABEL=cloudimg-rootfs ro"};
+    mp::QemuVMProcessSpec spec(desc, firmware_args, mount_args, std::nullopt, tuning);
+
+    const auto args = spec.arguments();
+    EXPECT_FALSE(args.contains("-bios"));
+    EXPECT_FALSE(args.contains("OVMF.fd"));
+    EXPECT_EQ(args.mid(0, platform_args.size()), platform_args);
+    EXPECT_EQ(args.mid(platform_args.size(), 6),
+              QStringList({"-kernel", "/path/to/image.vmlinuz", "-initrd", "/path/to/image.initrd", "-append",
+                           "root=LABEL=cloudimg-rootfs ro"}));
+}
+
+TEST_F(TestQemuVMProcessSpec, shared_memory_left_out_without_vhost_user_mounts)
+{
+    mp::QemuVMProcessSpec spec(desc, platform_args, mount_args, std::nullopt, {});
+
+    EXPECT_FALSE(spec.arguments().contains("node,memdev=mem"));
+}
+
 TEST_F(TestQemuVMProcessSpec, resume_arguments_taken_from_resumedata)
 {
-    const mp::QemuVMProcessSpec::ResumeData resume_data{"suspend_tag", "machine_type", false, {"-one", "-two"}};
+    const mp::QemuVMProcessSpec::ResumeData resume_data{"suspend_tag", "machine_type", false, {"-one", "-two"}, {}};
 
-    mp::QemuVMProcessSpec spec(desc, platform_args, mount_args, resume_data);
+    mp::QemuVMProcessSpec spec(desc, platform_args, mount_args, resume_data, {});
 
     EXPECT_EQ(spec.arguments(), QStringList({"-one", "-two", "-loadvm", "suspend_tag", "-machine", "machine_type"})
                                     << mount_args.begin()->second.second);
@@ -98,17 +312,29 @@ TEST_F(TestQemuVMProcessSpec, resume_with_missing_machine_type_guesses_correctly
     resume_data_missing_machine_info.suspend_tag = "suspend_tag";
     resume_data_missing_machine_info.arguments = QStringList{"-args"};
 
-    mp::QemuVMProcessSpec spec(desc, platform_args, mount_args, resume_data_missing_machine_info);
+    mp::QemuVMProcessSpec spec(desc, platform_args, mount_args, resume_data_missing_machine_info, {});
 
     EXPECT_EQ(spec.arguments(), QStringList({"-args", "-loadvm", "suspend_tag"}) << mount_args.begin()->second.second);
 }
 
+TEST_F(TestQemuVMProcessSpec, resumeFromMemorySnapshotFileUsesIncomingInsteadOfLoadvm)
+{
+    const mp::QemuVMProcessSpec::ResumeData resume_data{
+        "suspend_tag", "machine_type", false, {"-one"}, "exec:cat '/path/to/image.state'"};
+
+    mp::QemuVMProcessSpec spec(desc, platform_args, mount_args, resume_data, {});
+
+    EXPECT_EQ(spec.arguments(), QStringList({"-one", "-incoming", "exec:cat '/path/to/image.state'", "-machine",
+                                             "machine_type"})
+                                    << mount_args.begin()->second.second);
+}
+
 TEST_F(TestQemuVMProcessSpec, ResumeFixesVmnetFormat)
 {
     const mp::QemuVMProcessSpec::ResumeData resume_data{
-        "suspend_tag", "machine_type", false, {"vmnet-macos,mode=shared,foo"}};
+        "suspend_tag", "machine_type", false, {"vmnet-macos,mode=shared,foo"}, {}};
 
-    mp::QemuVMProcessSpec spec(desc, platform_args, mount_args, resume_data);
+    mp::QemuVMProcessSpec spec(desc, platform_args, mount_args, resume_data, {});
 
     EXPECT_EQ(spec.arguments(), QStringList({"vmnet-shared,foo", "-loadvm", "suspend_tag", "-machine", "machine_type"})
                                     << mount_args.begin()->second.second);
@@ -116,7 +342,7 @@ TEST_F(TestQemuVMProcessSpec, ResumeFixesVmnetFormat)
 
 TEST_F(TestQemuVMProcessSpec, apparmorProfileIncludesFileMountPerms)
 {
-    mp::QemuVMProcessSpec spec(desc, platform_args, mount_args, std::nullopt);
+    mp::QemuVMProcessSpec spec(desc, platform_args, mount_args, std::nullopt, {});
 
     EXPECT_TRUE(spec.apparmor_profile().contains("path/to/source/ rw"));
     EXPECT_TRUE(spec.apparmor_profile().contains("path/to/source/** rwlk"));
@@ -124,22 +350,23 @@ TEST_F(TestQemuVMProcessSpec, apparmorProfileIncludesFileMountPerms)
 
 TEST_F(TestQemuVMProcessSpec, apparmor_profile_has_correct_name)
 {
-    mp::QemuVMProcessSpec spec(desc, platform_args, mount_args, std::nullopt);
+    mp::QemuVMProcessSpec spec(desc, platform_args, mount_args, std::nullopt, {});
 
     EXPECT_TRUE(spec.apparmor_profile().contains("profile multipass.vm_name.qemu-system-"));
 }
 
 TEST_F(TestQemuVMProcessSpec, apparmor_profile_includes_disk_images)
 {
-    mp::QemuVMProcessSpec spec(desc, platform_args, mount_args, std::nullopt);
+    mp::QemuVMProcessSpec spec(desc, platform_args, mount_args, std::nullopt, {});
 
     EXPECT_TRUE(spec.apparmor_profile().contains("/path/to/image rwk,"));
     EXPECT_TRUE(spec.apparmor_profile().contains("/path/to/cloud_init.iso rk,"));
+    EXPECT_TRUE(spec.apparmor_profile().contains("/path/to/snapshots/*.qcow2 rk,"));
 }
 
 TEST_F(TestQemuVMProcessSpec, apparmor_profile_identifier)
 {
-    mp::QemuVMProcessSpec spec(desc, platform_args, mount_args, std::nullopt);
+    mp::QemuVMProcessSpec spec(desc, platform_args, mount_args, std::nullopt, {});
 
     EXPECT_EQ(spec.identifier(), "vm_name");
 }
@@ -151,7 +378,7 @@ TEST_F(TestQemuVMProcessSpec, apparmor_profile_running_as_snap_correct)
 
     mpt::SetEnvScope e("SNAP", snap_dir.path().toUtf8());
     mpt::SetEnvScope e2("SNAP_NAME", snap_name);
-    mp::QemuVMProcessSpec spec(desc, platform_args, mount_args, std::nullopt);
+    mp::QemuVMProcessSpec spec(desc, platform_args, mount_args, std::nullopt, {});
 
     EXPECT_TRUE(spec.apparmor_profile().contains("signal (receive) peer=snap.multipass.multipassd"));
     EXPECT_TRUE(spec.apparmor_profile().contains(QString("%1/qemu/* r,").arg(snap_dir.path())));
@@ -168,7 +395,7 @@ TEST_F(TestQemuVMProcessSpec, apparmor_profile_running_as_symlinked_snap_correct
 
     mpt::SetEnvScope e("SNAP", link_dir.path().toUtf8());
     mpt::SetEnvScope e2("SNAP_NAME", snap_name);
-    mp::QemuVMProcessSpec spec(desc, platform_args, mount_args, std::nullopt);
+    mp::QemuVMProcessSpec spec(desc, platform_args, mount_args, std::nullopt, {});
 
     EXPECT_TRUE(spec.apparmor_profile().contains(QString("%1/qemu/* r,").arg(snap_dir.path())));
     EXPECT_TRUE(spec.apparmor_profile().contains(QString("%1/usr/bin/qemu-system-").arg(snap_dir.path())));
@@ -180,7 +407,7 @@ TEST_F(TestQemuVMProcessSpec, apparmor_profile_not_running_as_snap_correct)
 
     mpt::UnsetEnvScope e("SNAP");
     mpt::SetEnvScope e2("SNAP_NAME", snap_name);
-    mp::QemuVMProcessSpec spec(desc, platform_args, mount_args, std::nullopt);
+    mp::QemuVMProcessSpec spec(desc, platform_args, mount_args, std::nullopt, {});
 
     EXPECT_TRUE(spec.apparmor_profile().contains("signal (receive) peer=unconfined"));
     EXPECT_TRUE(spec.apparmor_profile().contains("/usr/share/{seabios,ovmf,qemu-efi}/* r,"));
@@ -0,0 +1,104 @@
+/*
+ * Copyright (C) Canonical, Ltd.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; version 3.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+#include "tests/common.h"
+
+#include <src/platform/backends/qemu/qmp_client.h>
+
+#include <QJsonDocument>
+
+#include <algorithm>
+#include <vector>
+
+namespace mp = multipass;
+using namespace testing;
+
+namespace
+{
+struct TestQmpClient : public Test
+{
+    QJsonObject sent(std::size_t i) const
+    {
+        return QJsonDocument::fromJson(written.at(i)).object();
+    }
+
+    std::vector<QByteArray> written;
+    mp::QmpClient client{"test", [this](const QByteArray& data) { written.push_back(data); }};
+};
+} // namespace
+
+TEST_F(TestQmpClient, commandsAreSentOnePerLineWithIncreasingIds)
+{
+    client.execute("qmp_capabilities");
+    client.human_monitor_command("savevm suspend");
+
+    ASSERT_EQ(written.size(), 2u);
+    EXPECT_TRUE(std::all_of(written.cbegin(), written.cend(),
+                            [](const QByteArray& line) { return line.endsWith('\n') && line.count('\n') == 1; }));
+
+    EXPECT_EQ(sent(0)["execute"].toString(), "qmp_capabilities");
+    EXPECT_FALSE(sent(0).contains("arguments"));
+    EXPECT_EQ(sent(1)["execute"].toString(), "human-monitor-command");
+    EXPECT_EQ(sent(1)["arguments"].toObject()["command-line"].toString(), "savevm suspend");
+    EXPECT_LT(sent(0)["id"].toInt(), sent(1)["id"].toInt());
+}
+
+TEST_F(TestQmpClient, repliesCompleteTheCommandTheyAnswer)
+{
+    QJsonValue first, second;
+    QString second_error;
+    client.execute("query-status", {}, [&first](const QJsonValue& result, auto&) { first = result; });
+    client.execute("cont", {}, [&](const QJsonValue& result, const QString& error) {
+        second = result;
+        second_error = error;
+    });
+
+    const auto first_id = sent(0)["id"].toInt(), second_id = sent(1)["id"].toInt();
+    client.feed(QString{"{\"error\": {\"class\": \"GenericError\", \"desc\": \"nope\"}, \"id\": %1}\r\n"}
+                    .arg(second_id)
+                    .toUtf8());
+    client.feed(QString{"{\"return\": {\"status\": \"running\"}, \"id\": %1}\r\n"}.arg(first_id).toUtf8());
+
+    EXPECT_EQ(first.toObject()["status"].toString(), "running");
+    EXPECT_TRUE(second.isUndefined());
+    EXPECT_EQ(second_error, "nope");
+    EXPECT_EQ(client.pending_commands(), 0u);
+}
+
+TEST_F(TestQmpClient, eventsArrivingTogetherOrInPiecesAreAllDelivered)
+{
+    std::vector<QString> events;
+    QObject::connect(&client, &mp::QmpClient::event,
+                     [&events](const QString& name, const QJsonObject&) { events.push_back(name); });
+
+    client.feed("{\"QMP\": {\"version\": {}, \"capabilities\": []}}\r\n{\"event\": \"STOP\"}\r\n{\"event\": \"RES");
+    EXPECT_THAT(events, ElementsAre("STOP"));
+
+    client.feed("UME\"}\r\n");
+    EXPECT_THAT(events, ElementsAre("STOP", "RESUME"));
+}
+
+TEST_F(TestQmpClient, eventDataIsPassedAlong)
+{
+    QJsonObject received;
+    QObject::connect(&client, &mp::QmpClient::event,
+                     [&received](const QString&, const QJsonObject& data) { received = data; });
+
+    client.feed("{\"event\": \"VSERPORT_CHANGE\", \"data\": {\"open\": true, \"id\": \"multipass-ready\"}}\n");
+
+    EXPECT_EQ(received["id"].toString(), "multipass-ready");
+    EXPECT_TRUE(received["open"].toBool());
+}
@@ -27,9 +27,10 @@ namespace multipass
 {
 namespace test
 {
-struct SftpServerTest : public testing::Test
+// The libssh calls an SftpServer makes, answered in process, for tests and benchmarks alike
+struct SftpServerMocks
 {
-    SftpServerTest()
+    SftpServerMocks()
         : free_sftp{mock_sftp_free, [](sftp_session sftp) {
                         std::free(sftp->handles);
                         std::free(sftp);
@@ -50,6 +51,10 @@ struct SftpServerTest : public testing::Test
 
     MockSSHTestFixture mock_ssh_test_fixture;
 };
+
+struct SftpServerTest : public testing::Test, public SftpServerMocks
+{
+};
 } // namespace test
 } // namespace multipass
 #endif // MULTIPASS_SFTP_SERVER_TEST_FIXTURE_H
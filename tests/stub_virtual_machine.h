@@ -81,6 +81,11 @@ struct StubVirtualMachine final : public multipass::VirtualMachine
         return std::vector<std::string>{"192.168.2.123"};
     }
 
+    std::vector<std::string> get_all_ipv4(SSHSession& session) override
+    {
+        return std::vector<std::string>{"192.168.2.123"};
+    }
+
     std::string ipv6() override
     {
         return {};
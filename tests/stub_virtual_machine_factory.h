@@ -70,7 +70,7 @@ struct StubVirtualMachineFactory : public multipass::BaseVirtualMachineFactory
 
     multipass::VMImageVault::UPtr create_image_vault(std::vector<VMImageHost*> image_hosts, URLDownloader* downloader,
                                                      const Path& cache_dir_path, const Path& data_dir_path,
-                                                     const days& days_to_expire) override
+                                                     const days& days_to_expire, const vault::BlobStore& blobs) override
     {
         return std::make_unique<StubVMImageVault>();
     }
@@ -421,6 +421,66 @@ TEST_F(AliasDictionary, get_unexisting_alias_returns_nullopt)
     ASSERT_EQ(dict.get_alias("unexisting"), std::nullopt);
 }
 
+TEST_F(AliasDictionary, getsAliasesFromIndexWithoutReadingDb)
+{
+    {
+        std::stringstream trash_stream;
+        mpt::StubTerminal trash_term(trash_stream, trash_stream, trash_stream);
+        mp::AliasDict writer(&trash_term);
+
+        writer.add_alias("alias", {"instance", "command", "map"});
+        writer.set_active_context("other_context");
+        writer.add_alias("other_alias", {"other_instance", "other_command", "default"});
+    }
+
+    ASSERT_TRUE(QFile::exists(QString::fromStdString(db_filename() + ".idx")));
+
+    auto [mock_file_ops, guard] = mpt::MockFileOps::inject();
+    EXPECT_CALL(*mock_file_ops, open(_, _)).Times(0);
+
+    std::stringstream trash_stream;
+    mpt::StubTerminal trash_term(trash_stream, trash_stream, trash_stream);
+    mp::AliasDict dict(&trash_term);
+
+    EXPECT_EQ(dict.active_context_name(), "other_context");
+    EXPECT_EQ(dict.get_alias("alias"), (mp::AliasDefinition{"instance", "command", "map"}));
+    EXPECT_EQ(dict.get_alias("other_context.other_alias"),
+              (mp::AliasDefinition{"other_instance", "other_command", "default"}));
+    EXPECT_EQ(dict.get_alias("other_context.alias"), std::nullopt);
+    EXPECT_EQ(dict.get_alias("unexisting"), std::nullopt);
+}
+
+TEST_F(AliasDictionary, ignoresIndexOfPreviousDb)
+{
+    populate_db_file(AliasesVector{{"some_alias", {"some_instance", "some_command", "map"}}});
+
+    ASSERT_TRUE(QFile::remove(QString::fromStdString(db_filename())));
+    mpt::make_file_with_content(QString::fromStdString(db_filename()),
+                                "{\"another_alias\": {\"command\": \"a_command\", \"instance\": \"an_instance\", "
+                                "\"working-directory\": \"map\"}}\n");
+
+    std::stringstream trash_stream;
+    mpt::StubTerminal trash_term(trash_stream, trash_stream, trash_stream);
+    mp::AliasDict dict(&trash_term);
+
+    EXPECT_EQ(dict.get_alias("another_alias"), (mp::AliasDefinition{"an_instance", "a_command", "map"}));
+    EXPECT_EQ(dict.get_alias("some_alias"), std::nullopt);
+}
+
+TEST_F(AliasDictionary, ignoresBrokenIndex)
+{
+    populate_db_file(AliasesVector{{"some_alias", {"some_instance", "some_command", "map"}}});
+
+    ASSERT_TRUE(QFile::remove(QString::fromStdString(db_filename() + ".idx")));
+    mpt::make_file_with_content(QString::fromStdString(db_filename() + ".idx"), "broken index");
+
+    std::stringstream trash_stream;
+    mpt::StubTerminal trash_term(trash_stream, trash_stream, trash_stream);
+    mp::AliasDict dict(&trash_term);
+
+    EXPECT_EQ(dict.get_alias("some_alias"), (mp::AliasDefinition{"some_instance", "some_command", "map"}));
+}
+
 TEST_F(AliasDictionary, creates_backup_db)
 {
     populate_db_file(AliasesVector{{"some_alias", {"some_instance", "some_command", "map"}}});
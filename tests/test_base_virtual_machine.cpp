@@ -148,6 +148,35 @@ TEST_F(BaseVM, get_all_ipv4_works_when_instance_is_off)
     EXPECT_EQ(base_vm.get_all_ipv4(key_provider).size(), 0u);
 }
 
+TEST_F(BaseVM, cached_state_reuses_a_freshly_fetched_state)
+{
+    struct FetchingVirtualMachine : public StubBaseVirtualMachine
+    {
+        mp::VirtualMachine::State current_state() override
+        {
+            ++fetches;
+            state_fetched();
+            return state;
+        }
+
+        int fetches{0};
+    } fetching_vm;
+
+    EXPECT_EQ(fetching_vm.cached_state(), mp::VirtualMachine::State::off);
+    fetching_vm.start();
+    EXPECT_EQ(fetching_vm.cached_state(), mp::VirtualMachine::State::running);
+    EXPECT_EQ(fetching_vm.fetches, 1);
+}
+
+TEST_F(BaseVM, cached_state_asks_backends_that_do_not_fetch)
+{
+    StubBaseVirtualMachine base_vm(mp::VirtualMachine::State::running);
+
+    EXPECT_EQ(base_vm.cached_state(), mp::VirtualMachine::State::running);
+    base_vm.suspend();
+    EXPECT_EQ(base_vm.cached_state(), mp::VirtualMachine::State::suspended);
+}
+
 struct IpTestParams
 {
     int exit_status;
@@ -21,6 +21,9 @@
 #include <multipass/process/basic_process.h>
 #include <multipass/process/simple_process_spec.h>
 
+#include <QEventLoop>
+#include <QTimer>
+
 namespace mp = multipass;
 namespace mpt = multipass::test;
 
@@ -286,3 +289,42 @@ TEST_F(BasicProcessTest, reads_expected_data_from_stdout_and_stderr)
 
     EXPECT_TRUE(process.wait_for_finished());
 }
+
+TEST_F(BasicProcessTest, execute_async_calls_back_with_exit_code)
+{
+    mp::BasicProcess process(mp::simple_process_spec("mock_process", {"3"}));
+
+    QEventLoop loop;
+    std::optional<mp::ProcessState> process_state;
+    process.execute_async([&](const mp::ProcessState& state) {
+        process_state = state;
+        loop.quit();
+    });
+    EXPECT_FALSE(process_state); // not before the event loop gets to it
+    loop.exec();
+
+    ASSERT_TRUE(process_state && process_state->exit_code);
+    EXPECT_EQ(*process_state->exit_code, 3);
+    EXPECT_FALSE(process_state->error);
+}
+
+TEST_F(BasicProcessTest, execute_async_times_out_once)
+{
+    mp::BasicProcess process(mp::simple_process_spec("mock_process", {"0", "stay-alive"}));
+
+    QEventLoop loop;
+    int calls = 0;
+    std::optional<mp::ProcessState> process_state;
+    process.execute_async(
+        [&](const mp::ProcessState& state) {
+            ++calls;
+            process_state = state;
+            QTimer::singleShot(100, &loop, &QEventLoop::quit); // leave time for the kill to come through
+        },
+        50);
+    loop.exec();
+
+    EXPECT_EQ(calls, 1);
+    ASSERT_TRUE(process_state && process_state->error);
+    EXPECT_EQ(process_state->error->state, QProcess::Timedout);
+}
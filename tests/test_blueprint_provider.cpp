@@ -71,6 +71,16 @@ TEST_F(VMBlueprintProvider, downloadsZipToExpectedLocation)
     EXPECT_EQ(downloaded_zip.size(), original_zip.size());
 }
 
+TEST_F(VMBlueprintProvider, doesNotReadUnchangedArchiveAgain)
+{
+    mp::DefaultVMBlueprintProvider blueprint_provider{blueprints_zip_url, &url_downloader, cache_dir.path(), 0s};
+
+    auto [mock_poco_zip_utils, guard] = mpt::MockPocoZipUtils::inject();
+    EXPECT_CALL(*mock_poco_zip_utils, zip_archive_for(_)).Times(0);
+
+    EXPECT_FALSE(blueprint_provider.all_blueprints().empty());
+}
+
 TEST_F(VMBlueprintProvider, fetchBlueprintForUnknownBlueprintThrows)
 {
     mp::DefaultVMBlueprintProvider blueprint_provider{blueprints_zip_url, &url_downloader, cache_dir.path(),
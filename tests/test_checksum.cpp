@@ -0,0 +1,116 @@
+/*
+ * Copyright (C) Canonical, Ltd.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; version 3.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#include "common.h"
+
+#include <multipass/checksum.h>
+
+#include <numeric>
+#include <string>
+#include <vector>
+
+namespace mpcs = multipass::checksum;
+
+using namespace testing;
+
+namespace
+{
+const std::string check_input{"123456789"};
+
+// Bit at a time, straight from the definition
+std::uint32_t reference_crc32(const std::vector<unsigned char>& data)
+{
+    std::uint32_t crc = ~0u;
+    for (const auto byte : data)
+    {
+        crc ^= byte;
+        for (auto bit = 0; bit < 8; ++bit)
+            crc = crc & 1 ? (crc >> 1) ^ 0xedb88320 : crc >> 1;
+    }
+
+    return ~crc;
+}
+
+std::vector<unsigned char> bytes(std::size_t size)
+{
+    std::vector<unsigned char> data(size);
+    std::iota(data.begin(), data.end(), static_cast<unsigned char>(7));
+    return data;
+}
+} // namespace
+
+TEST(Checksum, crc32_gives_the_standard_check_value)
+{
+    EXPECT_EQ(mpcs::crc32(check_input.data(), check_input.size()), 0xcbf43926u);
+    EXPECT_EQ(mpcs::crc32(nullptr, 0), 0u);
+}
+
+TEST(Checksum, crc32_matches_the_definition_whatever_the_size_and_alignment)
+{
+    const auto data = bytes(1031);
+    for (auto offset : {0, 1, 3, 8})
+        for (auto size : {0, 1, 15, 16, 63, 64, 65, 127, 200, 1000})
+        {
+            const std::vector<unsigned char> part(data.begin() + offset, data.begin() + offset + size);
+            EXPECT_EQ(mpcs::crc32(data.data() + offset, size), reference_crc32(part))
+                << mpcs::crc32_implementation() << ", " << size << " bytes at " << offset;
+        }
+}
+
+TEST(Checksum, crc32_carries_on_from_a_previous_result)
+{
+    const auto data = bytes(4096);
+    const auto first = mpcs::crc32(data.data(), 1500);
+
+    EXPECT_EQ(mpcs::crc32(data.data() + 1500, data.size() - 1500, first), mpcs::crc32(data.data(), data.size()));
+}
+
+TEST(Checksum, crc64_gives_the_xz_check_value)
+{
+    EXPECT_EQ(mpcs::crc64(check_input.data(), check_input.size()), 0x995dc9bbdf1939faull);
+}
+
+TEST(Checksum, md4_gives_the_rfc_1320_values)
+{
+    const auto hex = [](const std::string& input) {
+        const auto digest = mpcs::md4(input.data(), input.size());
+        std::string hex;
+        for (const auto byte : digest)
+            hex += fmt::format("{:02x}", byte);
+        return hex;
+    };
+
+    EXPECT_EQ(hex(""), "31d6cfe0d16ae931b73c59d7e0c089c0");
+    EXPECT_EQ(hex("abc"), "a448017aaf21d8525fc10ae87aa6729d");
+    EXPECT_EQ(hex("message digest"), "d9130a8164549fe818874806e1c7014b");
+    EXPECT_EQ(hex("12345678901234567890123456789012345678901234567890123456789012345678901234567890"),
+              "e33b4ddc9c38f2199c3e7b164fcc0536");
+}
+
+TEST(Checksum, sha256_hashes_what_was_added_so_far)
+{
+    mpcs::Sha256 hash;
+    EXPECT_EQ(hash.hex_digest(), "e3b0c44298fc1c149afbf4c8996fb92427ae41e4649b934ca495991b7852b855");
+
+    hash.add_data("ab", 2);
+    hash.add_data("c", 1);
+    EXPECT_EQ(hash.hex_digest(), "ba7816bf8f01cfea414140de5dae2223b00361a396177a9cb410ff61f20015ad");
+
+    hash.reset();
+    hash.add_data("ab", 2);
+    EXPECT_EQ(hash.hex_digest(), "fb8e20fc2e4c3f248c60c39bd652f3c1347298bb977b8b4d5903b85055620603");
+}
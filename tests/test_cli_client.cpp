@@ -21,6 +21,7 @@
 #include "disabling_macros.h"
 #include "fake_alias_config.h"
 #include "fake_key_data.h"
+#include "file_operations.h"
 #include "mock_cert_provider.h"
 #include "mock_environment_helpers.h"
 #include "mock_file_ops.h"
@@ -136,6 +137,31 @@ struct MockDaemonRpc : public mp::DaemonRpc
                 (grpc::ServerContext * context,
                  (grpc::ServerReaderWriter<mp::AuthenticateReply, mp::AuthenticateRequest> * server)),
                 (override));
+    MOCK_METHOD(grpc::Status, clone,
+                (grpc::ServerContext * context, (grpc::ServerReaderWriter<mp::CloneReply, mp::CloneRequest> * server)),
+                (override));
+    MOCK_METHOD(grpc::Status, compact,
+                (grpc::ServerContext * context,
+                 (grpc::ServerReaderWriter<mp::CompactReply, mp::CompactRequest> * server)),
+                (override));
+    MOCK_METHOD(grpc::Status, snapshot,
+                (grpc::ServerContext * context,
+                 (grpc::ServerReaderWriter<mp::SnapshotReply, mp::SnapshotRequest> * server)),
+                (override));
+    MOCK_METHOD(grpc::Status, restore,
+                (grpc::ServerContext * context,
+                 (grpc::ServerReaderWriter<mp::RestoreReply, mp::RestoreRequest> * server)),
+                (override));
+    MOCK_METHOD(grpc::Status, exec,
+                (grpc::ServerContext * context, (grpc::ServerReaderWriter<mp::ExecReply, mp::ExecRequest> * server)),
+                (override));
+    MOCK_METHOD(grpc::Status, forward,
+                (grpc::ServerContext * context,
+                 (grpc::ServerReaderWriter<mp::ForwardReply, mp::ForwardRequest> * server)),
+                (override));
+    MOCK_METHOD(grpc::Status, apply,
+                (grpc::ServerContext * context, (grpc::ServerReaderWriter<mp::ApplyReply, mp::ApplyRequest> * server)),
+                (override));
 };
 
 struct Client : public Test
@@ -145,6 +171,9 @@ struct Client : public Test
         EXPECT_CALL(mock_settings, get(Eq(mp::petenv_key))).WillRepeatedly(Return(petenv_name));
         EXPECT_CALL(mock_settings, get(Eq(mp::winterm_key))).WillRepeatedly(Return("none"));
         EXPECT_CALL(mock_settings, get(Eq(mp::mounts_key))).WillRepeatedly(Return("true"));
+        EXPECT_CALL(mock_settings, get(Eq(mp::ssh_control_persist_key))).WillRepeatedly(Return("0"));
+        EXPECT_CALL(mock_settings, get(Eq(mp::rpc_compression_key))).WillRepeatedly(Return("true"));
+        EXPECT_CALL(mock_settings, get(Eq(mp::rpc_keepalive_key))).WillRepeatedly(Return("60"));
         EXPECT_CALL(mock_settings, register_handler(_)).WillRepeatedly(Return(nullptr));
         EXPECT_CALL(mock_settings, unregister_handler).Times(AnyNumber());
 
@@ -452,7 +481,7 @@ auto match_uptr_to_remote_settings_handler(M&& matcher)
 
 struct RemoteHandlerTest : public Client, public WithParamInterface<std::string>
 {
-    inline static const auto cmds = Values("", " ", "help", "get");
+    inline static const auto cmds = Values("help", "get");
 };
 
 TEST_P(RemoteHandlerTest, registersRemoteSettingsHandler)
@@ -476,6 +505,15 @@ TEST_P(RemoteHandlerTest, unregistersRemoteSettingsHandler)
 
 INSTANTIATE_TEST_SUITE_P(Client, RemoteHandlerTest, RemoteHandlerTest::cmds);
 
+TEST_F(Client, doesNotRegisterRemoteSettingsHandlerWithoutACommandToRun)
+{
+    EXPECT_CALL(mock_settings, register_handler(match_uptr_to_remote_settings_handler(_))).Times(0);
+
+    send_command({""});
+    send_command({"--help"});
+    send_command({"unknown-command"});
+}
+
 struct RemoteHandlerVerbosity : public Client, WithParamInterface<std::tuple<int, std::string>>
 {
 };
@@ -617,6 +655,150 @@ TEST_F(Client, transfer_cmd_local_source_instance_target)
     EXPECT_EQ(send_command({"transfer", "foo", "C:\\Users\\file", "test-vm:bar"}), mp::ReturnCode::Ok);
 }
 
+TEST_F(Client, transfer_cmd_parallel_sets_up_client)
+{
+    auto [mocked_sftp_utils, mocked_sftp_utils_guard] = mpt::MockSFTPUtils::inject();
+    auto mocked_sftp_client = std::make_unique<mpt::MockSFTPClient>();
+    auto mocked_sftp_client_p = mocked_sftp_client.get();
+
+    EXPECT_CALL(*mocked_sftp_utils, make_SFTPClient).WillOnce(Return(std::move(mocked_sftp_client)));
+    {
+        InSequence seq;
+        EXPECT_CALL(*mocked_sftp_client_p, set_parallel_transfers(4));
+        EXPECT_CALL(*mocked_sftp_client_p, pull).WillOnce(Return(true));
+    }
+    EXPECT_CALL(mock_daemon, ssh_info)
+        .WillOnce([](auto, grpc::ServerReaderWriter<mp::SSHInfoReply, mp::SSHInfoRequest>* server) {
+            mp::SSHInfoReply reply;
+            reply.mutable_ssh_info()->insert({"test-vm", mp::SSHInfo{}});
+            server->Write(reply);
+            return grpc::Status{};
+        });
+    EXPECT_EQ(send_command({"transfer", "--recursive", "--parallel", "4", "test-vm:foo", "bar"}), mp::ReturnCode::Ok);
+}
+
+TEST_F(Client, transfer_cmd_uses_window_from_daemon)
+{
+    auto [mocked_sftp_utils, mocked_sftp_utils_guard] = mpt::MockSFTPUtils::inject();
+    auto mocked_sftp_client = std::make_unique<mpt::MockSFTPClient>();
+    auto mocked_sftp_client_p = mocked_sftp_client.get();
+
+    EXPECT_CALL(*mocked_sftp_utils, make_SFTPClient).WillOnce(Return(std::move(mocked_sftp_client)));
+    {
+        InSequence seq;
+        EXPECT_CALL(*mocked_sftp_client_p, set_transfer_window(64));
+        EXPECT_CALL(*mocked_sftp_client_p, pull).WillOnce(Return(true));
+    }
+    EXPECT_CALL(mock_daemon, ssh_info)
+        .WillOnce([](auto, grpc::ServerReaderWriter<mp::SSHInfoReply, mp::SSHInfoRequest>* server) {
+            mp::SSHInfo ssh_info;
+            ssh_info.set_transfer_window(64);
+            mp::SSHInfoReply reply;
+            reply.mutable_ssh_info()->insert({"test-vm", ssh_info});
+            server->Write(reply);
+            return grpc::Status{};
+        });
+    EXPECT_EQ(send_command({"transfer", "test-vm:foo", "bar"}), mp::ReturnCode::Ok);
+}
+
+TEST_F(Client, transfer_cmd_sync_sets_flag)
+{
+    auto [mocked_sftp_utils, mocked_sftp_utils_guard] = mpt::MockSFTPUtils::inject();
+    auto mocked_sftp_client = std::make_unique<mpt::MockSFTPClient>();
+    auto mocked_sftp_client_p = mocked_sftp_client.get();
+
+    EXPECT_CALL(*mocked_sftp_utils, make_SFTPClient).WillOnce(Return(std::move(mocked_sftp_client)));
+    EXPECT_CALL(*mocked_sftp_client_p, is_remote_dir).WillOnce(Return(true));
+    EXPECT_CALL(*mocked_sftp_client_p,
+                push(_, _, mp::SFTPClient::Flags{mp::SFTPClient::Flag::Recursive | mp::SFTPClient::Flag::Sync}))
+        .Times(2)
+        .WillRepeatedly(Return(true));
+    EXPECT_CALL(mock_daemon, ssh_info)
+        .WillOnce([](auto, grpc::ServerReaderWriter<mp::SSHInfoReply, mp::SSHInfoRequest>* server) {
+            mp::SSHInfoReply reply;
+            reply.mutable_ssh_info()->insert({"test-vm", mp::SSHInfo{}});
+            server->Write(reply);
+            return grpc::Status{};
+        });
+    EXPECT_EQ(send_command({"transfer", "--recursive", "--sync", "foo", "baz", "test-vm:bar"}), mp::ReturnCode::Ok);
+}
+
+TEST_F(Client, transfer_cmd_resume_sets_flag)
+{
+    auto [mocked_sftp_utils, mocked_sftp_utils_guard] = mpt::MockSFTPUtils::inject();
+    auto mocked_sftp_client = std::make_unique<mpt::MockSFTPClient>();
+    auto mocked_sftp_client_p = mocked_sftp_client.get();
+
+    EXPECT_CALL(*mocked_sftp_utils, make_SFTPClient).WillOnce(Return(std::move(mocked_sftp_client)));
+    EXPECT_CALL(*mocked_sftp_client_p, pull(_, _, mp::SFTPClient::Flags{mp::SFTPClient::Flag::Resume}))
+        .WillOnce(Return(true));
+    EXPECT_CALL(mock_daemon, ssh_info)
+        .WillOnce([](auto, grpc::ServerReaderWriter<mp::SSHInfoReply, mp::SSHInfoRequest>* server) {
+            mp::SSHInfoReply reply;
+            reply.mutable_ssh_info()->insert({"test-vm", mp::SSHInfo{}});
+            server->Write(reply);
+            return grpc::Status{};
+        });
+    EXPECT_EQ(send_command({"transfer", "--resume", "test-vm:foo", "bar"}), mp::ReturnCode::Ok);
+}
+
+TEST_F(Client, transfer_cmd_compress_overrides_daemon_setting)
+{
+    auto [mocked_sftp_utils, mocked_sftp_utils_guard] = mpt::MockSFTPUtils::inject();
+    auto mocked_sftp_client = std::make_unique<mpt::MockSFTPClient>();
+    auto mocked_sftp_client_p = mocked_sftp_client.get();
+
+    EXPECT_CALL(*mocked_sftp_utils, make_SFTPClient(_, _, _, _, true)).WillOnce(Return(std::move(mocked_sftp_client)));
+    EXPECT_CALL(*mocked_sftp_client_p, pull).WillOnce(Return(true));
+    EXPECT_CALL(mock_daemon, ssh_info)
+        .WillOnce([](auto, grpc::ServerReaderWriter<mp::SSHInfoReply, mp::SSHInfoRequest>* server) {
+            mp::SSHInfo ssh_info;
+            ssh_info.set_compression("off");
+            mp::SSHInfoReply reply;
+            reply.mutable_ssh_info()->insert({"test-vm", ssh_info});
+            server->Write(reply);
+            return grpc::Status{};
+        });
+    EXPECT_EQ(send_command({"transfer", "--compress", "test-vm:foo", "bar"}), mp::ReturnCode::Ok);
+}
+
+TEST_F(Client, transfer_cmd_follows_daemon_compression_setting)
+{
+    auto [mocked_sftp_utils, mocked_sftp_utils_guard] = mpt::MockSFTPUtils::inject();
+    auto mocked_sftp_client = std::make_unique<mpt::MockSFTPClient>();
+    auto mocked_sftp_client_p = mocked_sftp_client.get();
+
+    EXPECT_CALL(*mocked_sftp_utils, make_SFTPClient(_, _, _, _, true)).WillOnce(Return(std::move(mocked_sftp_client)));
+    EXPECT_CALL(*mocked_sftp_client_p, pull).WillOnce(Return(true));
+    EXPECT_CALL(mock_daemon, ssh_info)
+        .WillOnce([](auto, grpc::ServerReaderWriter<mp::SSHInfoReply, mp::SSHInfoRequest>* server) {
+            mp::SSHInfo ssh_info;
+            ssh_info.set_compression("on");
+            mp::SSHInfoReply reply;
+            reply.mutable_ssh_info()->insert({"test-vm", ssh_info});
+            server->Write(reply);
+            return grpc::Status{};
+        });
+    EXPECT_EQ(send_command({"transfer", "test-vm:foo", "bar"}), mp::ReturnCode::Ok);
+}
+
+TEST_F(Client, transfer_cmd_fails_with_clashing_compression_options)
+{
+    EXPECT_EQ(send_command({"transfer", "--compress", "--no-compress", "test-vm:foo", "bar"}),
+              mp::ReturnCode::CommandLineError);
+}
+
+TEST_F(Client, transfer_cmd_parallel_out_of_range_fails)
+{
+    for (const auto& count : {"0", "17", "many"})
+    {
+        std::stringstream err;
+        EXPECT_EQ(send_command({"transfer", "--parallel", count, "test-vm:foo", "bar"}, trash_stream, err),
+                  mp::ReturnCode::CommandLineError);
+        EXPECT_THAT(err.str(), HasSubstr("--parallel value has to be an integer between 1 and 16"));
+    }
+}
+
 TEST_F(Client, transfer_cmd_help_ok)
 {
     EXPECT_THAT(send_command({"transfer", "-h"}), Eq(mp::ReturnCode::Ok));
@@ -712,6 +894,20 @@ TEST_F(Client, shell_cmd_good_arguments)
     EXPECT_THAT(send_command({"shell", "foo"}), Eq(mp::ReturnCode::Ok));
 }
 
+TEST_F(Client, shell_cmd_fails_with_too_long_session_name)
+{
+    EXPECT_THAT(send_command({"shell", "--session", std::string(40, 'a'), "foo"}),
+                Eq(mp::ReturnCode::CommandLineError));
+}
+
+TEST_F(Client, shell_cmd_session_needs_shared_connections)
+{
+    std::stringstream cerr_stream;
+    EXPECT_THAT(send_command({"shell", "--session", "work", "foo"}, trash_stream, cerr_stream),
+                Eq(mp::ReturnCode::CommandLineError));
+    EXPECT_THAT(cerr_stream.str(), HasSubstr(mp::ssh_control_persist_key));
+}
+
 TEST_F(Client, shell_cmd_help_ok)
 {
     EXPECT_THAT(send_command({"shell", "-h"}), Eq(mp::ReturnCode::Ok));
@@ -1222,6 +1418,34 @@ TEST_F(Client, launch_cmd_mount_option)
     EXPECT_EQ(send_command({"launch", "--name", instance_name, "--mount", fake_source}), mp::ReturnCode::Ok);
 }
 
+TEST_F(Client, launch_cmd_count_asks_for_several_instances_at_once)
+{
+    const auto count_matcher = AllOf(Property(&mp::LaunchRequest::count, Eq(3)),
+                                     Property(&mp::LaunchRequest::instance_name, StrEq("node-{}")));
+
+    EXPECT_CALL(mock_daemon, launch)
+        .WillOnce(WithArg<1>(check_request_and_return<mp::LaunchReply, mp::LaunchRequest>(count_matcher, ok)));
+    EXPECT_CALL(mock_daemon, mount).Times(0);
+    EXPECT_EQ(send_command({"launch", "--count", "3", "--name", "node-{}"}), mp::ReturnCode::Ok);
+}
+
+TEST_F(Client, launch_cmd_count_fails_when_not_positive)
+{
+    EXPECT_EQ(send_command({"launch", "--count", "0"}), mp::ReturnCode::CommandLineError);
+    EXPECT_EQ(send_command({"launch", "--count", "many"}), mp::ReturnCode::CommandLineError);
+}
+
+TEST_F(Client, launch_cmd_count_refuses_mounts)
+{
+    const QTemporaryDir fake_directory{};
+
+    std::stringstream err;
+    EXPECT_EQ(send_command({"launch", "--count", "2", "--mount", fake_directory.path().toStdString()}, trash_stream,
+                           err),
+              mp::ReturnCode::CommandLineError);
+    EXPECT_THAT(err.str(), HasSubstr("Mounts are not supported when launching several instances"));
+}
+
 TEST_F(Client, launchCmdMountOptionFailsOnInvalidDir)
 {
     auto [mocked_file_ops, mocked_file_ops_guard] = mpt::MockFileOps::inject();
@@ -1449,6 +1673,24 @@ TEST_F(Client, exec_cmd_no_double_dash_fails_cmd_arg_with_opts)
     EXPECT_THAT(send_command({"exec", "foo", "cmd", "--foo"}), Eq(mp::ReturnCode::CommandLineError));
 }
 
+TEST_F(Client, exec_cmd_accepts_buffer_size)
+{
+    EXPECT_CALL(mock_daemon, ssh_info(_, _));
+    EXPECT_THAT(send_command({"exec", "foo", "--no-map-working-directory", "--buffer-size", "1048576", "--", "cmd"}),
+                Eq(mp::ReturnCode::Ok));
+}
+
+TEST_F(Client, exec_cmd_fails_on_bad_buffer_size)
+{
+    for (const auto* size : {"0", "1024", "1000000000", "lots"})
+    {
+        std::stringstream cerr_stream;
+        EXPECT_THAT(send_command({"exec", "foo", "--buffer-size", size, "--", "cmd"}, trash_stream, cerr_stream),
+                    Eq(mp::ReturnCode::CommandLineError));
+        EXPECT_THAT(cerr_stream.str(), HasSubstr("--buffer-size value has to be an integer"));
+    }
+}
+
 TEST_F(Client, exec_cmd_help_ok)
 {
     EXPECT_THAT(send_command({"exec", "-h"}), Eq(mp::ReturnCode::Ok));
@@ -1671,6 +1913,55 @@ TEST_F(Client, execCmdFailsIfSshExecThrows)
     EXPECT_THAT(cerr_stream.str(), HasSubstr("exec failed: some exception\n"));
 }
 
+TEST_F(Client, execCmdGoesThroughARemoteDaemon)
+{
+    const mpt::SetEnvScope server_address_env{"MULTIPASS_SERVER_ADDRESS", "remote.example.com:50051"};
+
+    EXPECT_CALL(mock_daemon, exec(_, _))
+        .WillOnce([](grpc::ServerContext*, grpc::ServerReaderWriter<mp::ExecReply, mp::ExecRequest>* server) {
+            mp::ExecRequest request;
+            server->Read(&request);
+            EXPECT_EQ(request.instance_name(), "instance");
+            EXPECT_EQ(request.command(), "cat");
+
+            server->Write(mp::ExecReply{}); // started
+
+            std::string input;
+            while (server->Read(&request))
+                input += request.std_in();
+
+            mp::ExecReply reply;
+            reply.set_std_out(input);
+            reply.set_std_err("on stderr");
+            server->Write(reply);
+
+            reply.Clear();
+            reply.set_exited(true);
+            reply.set_exit_code(3);
+            server->Write(reply);
+
+            return grpc::Status{};
+        });
+
+    std::stringstream cout_stream, cerr_stream, cin_stream{"some\ninput"};
+    EXPECT_EQ(send_command({"exec", "instance", "-n", "--", "cat"}, cout_stream, cerr_stream, cin_stream), 3);
+    EXPECT_EQ(cout_stream.str(), "some\ninput");
+    EXPECT_THAT(cerr_stream.str(), HasSubstr("on stderr"));
+}
+
+TEST_F(Client, execCmdStartsTheInstanceForARemoteDaemon)
+{
+    const mpt::SetEnvScope server_address_env{"MULTIPASS_SERVER_ADDRESS", "remote.example.com:50051"};
+    const grpc::Status aborted{grpc::StatusCode::ABORTED, "instance \"instance\" is not running"};
+
+    InSequence seq;
+    EXPECT_CALL(mock_daemon, exec(_, _)).WillOnce(Return(aborted));
+    EXPECT_CALL(mock_daemon, start(_, _)).WillOnce(Return(grpc::Status{}));
+    EXPECT_CALL(mock_daemon, exec(_, _)).WillOnce(Return(grpc::Status{}));
+
+    EXPECT_EQ(send_command({"exec", "instance", "-n", "--", "true"}), mp::ReturnCode::Ok);
+}
+
 TEST_F(Client, execFailsOnArgumentClash)
 {
     std::stringstream cerr_stream;
@@ -1775,6 +2066,15 @@ TEST_F(Client, list_cmd_ok_no_args)
     EXPECT_THAT(send_command({"list"}), Eq(mp::ReturnCode::Ok));
 }
 
+TEST_F(Client, list_cmd_asks_for_instances_in_chunks)
+{
+    const auto list_matcher = Property(&mp::ListRequest::chunk_size, Gt(0u));
+
+    EXPECT_CALL(mock_daemon, list)
+        .WillOnce(WithArg<1>(check_request_and_return<mp::ListReply, mp::ListRequest>(list_matcher, ok)));
+    EXPECT_THAT(send_command({"list"}), Eq(mp::ReturnCode::Ok));
+}
+
 TEST_F(Client, list_cmd_fails_with_args)
 {
     EXPECT_THAT(send_command({"list", "foo"}), Eq(mp::ReturnCode::CommandLineError));
@@ -1920,6 +2220,269 @@ TEST_F(Client, recover_cmd_fails_with_names_and_all)
     EXPECT_THAT(send_command({"recover", "--all", "foo", "bar"}), Eq(mp::ReturnCode::CommandLineError));
 }
 
+// clone cli tests
+TEST_F(Client, clone_cmd_fails_no_args)
+{
+    EXPECT_THAT(send_command({"clone"}), Eq(mp::ReturnCode::CommandLineError));
+}
+
+TEST_F(Client, clone_cmd_fails_with_multiple_sources)
+{
+    EXPECT_THAT(send_command({"clone", "foo", "bar"}), Eq(mp::ReturnCode::CommandLineError));
+}
+
+TEST_F(Client, clone_cmd_help_ok)
+{
+    EXPECT_THAT(send_command({"clone", "-h"}), Eq(mp::ReturnCode::Ok));
+}
+
+TEST_F(Client, clone_cmd_leaves_the_name_to_the_daemon)
+{
+    const auto matcher = AllOf(Property(&mp::CloneRequest::source_name, StrEq("foo")),
+                               Property(&mp::CloneRequest::destination_name, IsEmpty()));
+    EXPECT_CALL(mock_daemon, clone(_, _))
+        .WillOnce(WithArg<1>(check_request_and_return<mp::CloneReply, mp::CloneRequest>(matcher, ok)));
+    EXPECT_THAT(send_command({"clone", "foo"}), Eq(mp::ReturnCode::Ok));
+}
+
+TEST_F(Client, clone_cmd_passes_the_name)
+{
+    const auto matcher = AllOf(Property(&mp::CloneRequest::source_name, StrEq("foo")),
+                               Property(&mp::CloneRequest::destination_name, StrEq("bar")));
+    EXPECT_CALL(mock_daemon, clone(_, _))
+        .WillOnce(WithArg<1>(check_request_and_return<mp::CloneReply, mp::CloneRequest>(matcher, ok)));
+    EXPECT_THAT(send_command({"clone", "foo", "--name", "bar"}), Eq(mp::ReturnCode::Ok));
+}
+
+// compact cli tests
+TEST_F(Client, compact_cmd_needs_one_instance)
+{
+    EXPECT_THAT(send_command({"compact"}), Eq(mp::ReturnCode::CommandLineError));
+    EXPECT_THAT(send_command({"compact", "foo", "bar"}), Eq(mp::ReturnCode::CommandLineError));
+}
+
+TEST_F(Client, compact_cmd_help_ok)
+{
+    EXPECT_THAT(send_command({"compact", "-h"}), Eq(mp::ReturnCode::Ok));
+}
+
+TEST_F(Client, compact_cmd_passes_compress)
+{
+    const auto matcher = AllOf(Property(&mp::CompactRequest::instance_name, StrEq("foo")),
+                               Property(&mp::CompactRequest::compress, IsTrue()));
+    EXPECT_CALL(mock_daemon, compact(_, _))
+        .WillOnce(WithArg<1>(check_request_and_return<mp::CompactReply, mp::CompactRequest>(matcher, ok)));
+    EXPECT_THAT(send_command({"compact", "foo", "--compress"}), Eq(mp::ReturnCode::Ok));
+}
+
+// forward cli tests
+TEST_F(Client, forward_cmd_needs_an_instance_port_and_a_host_port)
+{
+    EXPECT_THAT(send_command({"forward"}), Eq(mp::ReturnCode::CommandLineError));
+    EXPECT_THAT(send_command({"forward", "foo:80"}), Eq(mp::ReturnCode::CommandLineError));
+    EXPECT_THAT(send_command({"forward", "foo", "8080"}), Eq(mp::ReturnCode::CommandLineError));
+    EXPECT_THAT(send_command({"forward", "foo:http", "8080"}), Eq(mp::ReturnCode::CommandLineError));
+    EXPECT_THAT(send_command({"forward", "foo:80", "70000"}), Eq(mp::ReturnCode::CommandLineError));
+    EXPECT_THAT(send_command({"forward", "--cancel"}), Eq(mp::ReturnCode::CommandLineError));
+    EXPECT_THAT(send_command({"forward", "--cancel", "foo:80", "8080"}), Eq(mp::ReturnCode::CommandLineError));
+}
+
+TEST_F(Client, forward_cmd_passes_the_ports)
+{
+    const auto matcher = AllOf(Property(&mp::ForwardRequest::instance_name, StrEq("foo")),
+                               Property(&mp::ForwardRequest::instance_port, Eq(80)),
+                               Property(&mp::ForwardRequest::host_port, Eq(8080)),
+                               Property(&mp::ForwardRequest::cancel, IsFalse()));
+    EXPECT_CALL(mock_daemon, forward(_, _))
+        .WillOnce(WithArg<1>(check_request_and_return<mp::ForwardReply, mp::ForwardRequest>(matcher, ok)));
+    EXPECT_THAT(send_command({"forward", "foo:80", "8080"}), Eq(mp::ReturnCode::Ok));
+}
+
+TEST_F(Client, forward_cmd_cancels_a_host_port)
+{
+    const auto matcher = AllOf(Property(&mp::ForwardRequest::host_port, Eq(8080)),
+                               Property(&mp::ForwardRequest::cancel, IsTrue()));
+    EXPECT_CALL(mock_daemon, forward(_, _))
+        .WillOnce(WithArg<1>(check_request_and_return<mp::ForwardReply, mp::ForwardRequest>(matcher, ok)));
+    EXPECT_THAT(send_command({"forward", "--cancel", "8080"}), Eq(mp::ReturnCode::Ok));
+}
+
+// apply cli tests
+TEST_F(Client, apply_cmd_fails_on_bad_files)
+{
+    mpt::TempDir temp_dir;
+    const auto no_name = temp_dir.filePath("no-name.yaml"), unknown = temp_dir.filePath("unknown.yaml");
+    mpt::make_file_with_content(no_name, "instances: [foo]\n");
+    mpt::make_file_with_content(unknown, "instances:\n  foo:\n    colour: blue\n");
+
+    EXPECT_THAT(send_command({"apply"}), Eq(mp::ReturnCode::CommandLineError));
+    EXPECT_THAT(send_command({"apply", qPrintable(temp_dir.filePath("missing.yaml"))}),
+                Eq(mp::ReturnCode::CommandLineError));
+    EXPECT_THAT(send_command({"apply", qPrintable(no_name)}), Eq(mp::ReturnCode::CommandLineError));
+    EXPECT_THAT(send_command({"apply", qPrintable(unknown)}), Eq(mp::ReturnCode::CommandLineError));
+}
+
+TEST_F(Client, apply_cmd_sends_the_instances_with_paths_relative_to_the_file)
+{
+    mpt::TempDir temp_dir;
+    const auto file = temp_dir.filePath("instances.yaml");
+    mpt::make_file_with_content(temp_dir.filePath("user-data.yaml"), "password: passw0rd\n");
+    mpt::make_file_with_content(file, "instances:\n"
+                                      "  foo:\n"
+                                      "    image: daily:noble\n"
+                                      "    cpus: 2\n"
+                                      "    memory: 2G\n"
+                                      "    cloud-init: user-data.yaml\n"
+                                      "    mounts:\n"
+                                      "      - source: src\n"
+                                      "        target: /srv\n"
+                                      "  bar:\n"
+                                      "    state: absent\n");
+
+    const auto source = temp_dir.filePath("src").toStdString();
+    const auto matcher = Truly([&source](const mp::ApplyRequest& request) {
+        if (request.instances_size() != 2 || !request.dry_run())
+            return false;
+
+        const auto& foo = request.instances(0);
+        const auto& bar = request.instances(1);
+        return foo.launch().instance_name() == "foo" && foo.launch().remote_name() == "daily" &&
+               foo.launch().image() == "noble" && foo.launch().num_cores() == 2 && foo.launch().mem_size() == "2G" &&
+               foo.launch().cloud_init_user_data().find("passw0rd") != std::string::npos &&
+               foo.mounts().mounts_size() == 1 && foo.mounts().mounts(0).source_path() == source &&
+               foo.mounts().mounts(0).target_path() == "/srv" && foo.mounts().mount_maps().uid_mappings_size() == 1 &&
+               foo.state().empty() && bar.launch().instance_name() == "bar" && bar.state() == "absent" &&
+               !bar.has_mounts();
+    });
+    EXPECT_CALL(mock_daemon, apply(_, _))
+        .WillOnce(WithArg<1>(check_request_and_return<mp::ApplyReply, mp::ApplyRequest>(matcher, ok)));
+    EXPECT_THAT(send_command({"apply", "--dry-run", qPrintable(file)}), Eq(mp::ReturnCode::Ok));
+}
+
+// snapshot and restore cli tests
+TEST_F(Client, snapshot_cmd_needs_an_instance_and_a_name)
+{
+    EXPECT_THAT(send_command({"snapshot"}), Eq(mp::ReturnCode::CommandLineError));
+    EXPECT_THAT(send_command({"snapshot", "foo"}), Eq(mp::ReturnCode::CommandLineError));
+    EXPECT_THAT(send_command({"snapshot", "foo", "bar", "baz"}), Eq(mp::ReturnCode::CommandLineError));
+    EXPECT_THAT(send_command({"snapshot", "--delete", "foo"}), Eq(mp::ReturnCode::CommandLineError));
+    EXPECT_THAT(send_command({"snapshot", "--list", "foo", "bar"}), Eq(mp::ReturnCode::CommandLineError));
+    EXPECT_THAT(send_command({"snapshot", "--list", "--delete", "foo", "bar"}),
+                Eq(mp::ReturnCode::CommandLineError));
+}
+
+TEST_F(Client, snapshot_cmd_lists_snapshots)
+{
+    EXPECT_CALL(mock_daemon, snapshot)
+        .WillOnce([](auto, grpc::ServerReaderWriter<mp::SnapshotReply, mp::SnapshotRequest>* server) {
+            mp::SnapshotRequest request;
+            server->Read(&request);
+            EXPECT_EQ(request.instance_name(), "foo");
+            EXPECT_TRUE(request.list_snapshots());
+
+            mp::SnapshotReply reply;
+            reply.add_snapshot_names("clean");
+            reply.add_snapshot_names("configured");
+            server->Write(reply);
+            return grpc::Status{};
+        });
+
+    std::stringstream cout_stream;
+    EXPECT_THAT(send_command({"snapshot", "--list", "foo"}, cout_stream), Eq(mp::ReturnCode::Ok));
+    EXPECT_EQ(cout_stream.str(), "clean\nconfigured\n");
+}
+
+TEST_F(Client, snapshot_cmd_deletes_the_named_snapshot)
+{
+    const auto matcher = AllOf(Property(&mp::SnapshotRequest::instance_name, StrEq("foo")),
+                               Property(&mp::SnapshotRequest::snapshot_name, StrEq("clean")),
+                               Property(&mp::SnapshotRequest::delete_snapshot, IsTrue()));
+    EXPECT_CALL(mock_daemon, snapshot(_, _))
+        .WillOnce(WithArg<1>(check_request_and_return<mp::SnapshotReply, mp::SnapshotRequest>(matcher, ok)));
+    EXPECT_THAT(send_command({"snapshot", "--delete", "foo", "clean"}), Eq(mp::ReturnCode::Ok));
+}
+
+TEST_F(Client, snapshot_cmd_passes_the_names)
+{
+    const auto matcher = AllOf(Property(&mp::SnapshotRequest::instance_name, StrEq("foo")),
+                               Property(&mp::SnapshotRequest::snapshot_name, StrEq("clean")));
+    EXPECT_CALL(mock_daemon, snapshot(_, _))
+        .WillOnce(WithArg<1>(check_request_and_return<mp::SnapshotReply, mp::SnapshotRequest>(matcher, ok)));
+    EXPECT_THAT(send_command({"snapshot", "foo", "clean"}), Eq(mp::ReturnCode::Ok));
+}
+
+TEST_F(Client, restore_cmd_needs_an_instance_and_a_name)
+{
+    EXPECT_THAT(send_command({"restore"}), Eq(mp::ReturnCode::CommandLineError));
+    EXPECT_THAT(send_command({"restore", "foo"}), Eq(mp::ReturnCode::CommandLineError));
+}
+
+TEST_F(Client, restore_cmd_passes_the_names)
+{
+    const auto matcher = AllOf(Property(&mp::RestoreRequest::instance_name, StrEq("foo")),
+                               Property(&mp::RestoreRequest::snapshot_name, StrEq("clean")));
+    EXPECT_CALL(mock_daemon, restore(_, _))
+        .WillOnce(WithArg<1>(check_request_and_return<mp::RestoreReply, mp::RestoreRequest>(matcher, ok)));
+    EXPECT_THAT(send_command({"restore", "foo", "clean"}), Eq(mp::ReturnCode::Ok));
+}
+
+// benchmark-mount cli tests
+TEST_F(Client, benchmarkMountNeedsAnInstanceAndAPath)
+{
+    EXPECT_THAT(send_command({"benchmark-mount"}), Eq(mp::ReturnCode::CommandLineError));
+    EXPECT_THAT(send_command({"benchmark-mount", "primary"}), Eq(mp::ReturnCode::CommandLineError));
+    EXPECT_THAT(send_command({"benchmark-mount", "primary:"}), Eq(mp::ReturnCode::CommandLineError));
+    EXPECT_THAT(send_command({"benchmark-mount", ":/home/ubuntu"}), Eq(mp::ReturnCode::CommandLineError));
+}
+
+TEST_F(Client, benchmarkMountRefusesSizesThatAreNotPositive)
+{
+    EXPECT_THAT(send_command({"benchmark-mount", "primary:/home/ubuntu", "--size", "0"}),
+                Eq(mp::ReturnCode::CommandLineError));
+    EXPECT_THAT(send_command({"benchmark-mount", "primary:/home/ubuntu", "--files", "many"}),
+                Eq(mp::ReturnCode::CommandLineError));
+}
+
+TEST_F(Client, benchmarkMountFailsOutsideTheMounts)
+{
+    const std::string source_dir{"/home/user/src"}, target_dir{"/home/ubuntu/src"};
+    EXPECT_CALL(mock_daemon, info(_, _)).WillOnce(make_info_function(source_dir, target_dir));
+    EXPECT_CALL(mock_daemon, ssh_info(_, _)).Times(0);
+
+    std::stringstream cerr_stream;
+    EXPECT_THAT(send_command({"benchmark-mount", "primary:/home/ubuntu/srcs"}, trash_stream, cerr_stream),
+                Eq(mp::ReturnCode::CommandFail));
+    EXPECT_THAT(cerr_stream.str(), HasSubstr("not in a mount"));
+}
+
+TEST_F(Client, benchmarkMountRunsTheWorkloadsInTheMount)
+{
+    const std::string source_dir{"/home/user/src"}, target_dir{"/home/ubuntu/src"};
+    EXPECT_CALL(mock_daemon, info(_, _)).WillOnce(make_info_function(source_dir, target_dir));
+
+    const auto response = make_fake_ssh_info_response("primary");
+    EXPECT_CALL(mock_daemon, ssh_info(_, _))
+        .WillOnce([&response](grpc::ServerContext*,
+                              grpc::ServerReaderWriter<mp::SSHInfoReply, mp::SSHInfoRequest>* server) {
+            server->Write(response);
+            return grpc::Status{};
+        });
+
+    std::string cmd;
+    REPLACE(ssh_channel_request_exec, ([&cmd](ssh_channel, const char* raw_cmd) {
+                cmd = raw_cmd;
+                return SSH_OK;
+            }));
+    REPLACE(ssh_channel_get_exit_status, [](auto) { return 0; });
+
+    std::stringstream cout_stream;
+    EXPECT_THAT(send_command({"benchmark-mount", "primary:/home/ubuntu/src/build"}, cout_stream),
+                Eq(mp::ReturnCode::Ok));
+    EXPECT_THAT(cmd, StartsWith("python3 -c "));
+    EXPECT_THAT(cmd, HasSubstr("/home/ubuntu/src/build"));
+    EXPECT_THAT(cout_stream.str(), HasSubstr("classic (sshfs) mount"));
+}
+
 // start cli tests
 TEST_F(Client, start_cmd_ok_with_one_arg)
 {
@@ -2026,6 +2589,24 @@ TEST_F(Client, version_without_arg)
     EXPECT_THAT(send_command({"version"}), Eq(mp::ReturnCode::Ok));
 }
 
+TEST_F(Client, batch_runs_each_line_and_marks_where_it_ends)
+{
+    EXPECT_CALL(mock_daemon, version(_, _)).Times(2);
+
+    std::stringstream cin{"version\n\n# a comment\n  version --format \"json\"\nversion 'unbalanced\n"}, cout;
+    EXPECT_THAT(send_command({"batch"}, cout, trash_stream, cin), Eq(mp::ReturnCode::CommandLineError));
+
+    const auto output = cout.str();
+    EXPECT_THAT(output, HasSubstr(fmt::format("--- {}\n", static_cast<int>(mp::ReturnCode::Ok))));
+    EXPECT_THAT(output, EndsWith(fmt::format("--- {}\n", static_cast<int>(mp::ReturnCode::CommandLineError))));
+    EXPECT_EQ(QString::fromStdString(output).count("--- "), 3);
+}
+
+TEST_F(Client, batch_cmd_fails_with_args)
+{
+    EXPECT_THAT(send_command({"batch", "version"}), Eq(mp::ReturnCode::CommandLineError));
+}
+
 TEST_F(Client, version_with_positional_format_arg)
 {
     EXPECT_THAT(send_command({"version", "format"}), Eq(mp::ReturnCode::CommandLineError));
@@ -2797,6 +3378,13 @@ TEST_F(Client, findCmdUnsupportedOptionOk)
     EXPECT_THAT(send_command({"find", "--show-unsupported"}), Eq(mp::ReturnCode::Ok));
 }
 
+TEST_F(Client, findCmdFilterOptionsOk)
+{
+    EXPECT_CALL(mock_daemon, find(_, _));
+    EXPECT_THAT(send_command({"find", "--alias-prefix", "j", "--min-release", "20.04", "--max-release", "24.04"}),
+                Eq(mp::ReturnCode::Ok));
+}
+
 TEST_F(Client, findCmdFailsOnMultipleConditions)
 {
     EXPECT_THAT(send_command({"find"
@@ -2897,15 +3485,35 @@ TEST_F(Client, set_cmd_fails_with_no_arguments)
     EXPECT_THAT(send_command({"set"}), Eq(mp::ReturnCode::CommandLineError));
 }
 
-TEST_F(Client, get_cmd_fails_with_multiple_arguments)
+TEST_F(Client, get_cmd_gets_multiple_settings_at_once)
+{
+    const std::map<QString, QString> values{{mp::petenv_key, "asdf"}, {mp::driver_key, "qemu"}};
+    EXPECT_CALL(mock_settings, get_values(std::set<QString>{mp::petenv_key, mp::driver_key})).WillOnce(Return(values));
+    EXPECT_CALL(mock_settings, get(_)).Times(0);
+
+    EXPECT_THAT(get_setting({mp::driver_key, mp::petenv_key}),
+                Eq(fmt::format("{}=qemu\n{}=asdf", mp::driver_key, mp::petenv_key)));
+}
+
+TEST_F(Client, get_cmd_fails_with_multiple_arguments_and_keys_option)
 {
-    EXPECT_THAT(send_command({"get", mp::petenv_key, mp::driver_key}), Eq(mp::ReturnCode::CommandLineError));
+    EXPECT_THAT(send_command({"get", "--keys", mp::petenv_key, mp::driver_key}), Eq(mp::ReturnCode::CommandLineError));
 }
 
-TEST_F(Client, set_cmd_fails_with_multiple_arguments)
+TEST_F(Client, set_cmd_sets_multiple_settings_at_once)
 {
+    const std::map<QString, QString> values{{mp::petenv_key, "asdf"}, {mp::driver_key, "qemu"}};
+    EXPECT_CALL(mock_settings, set_values(values));
     EXPECT_CALL(mock_settings, set(_, _)).Times(0);
+
     EXPECT_THAT(send_command({"set", keyval_arg(mp::petenv_key, "asdf"), keyval_arg(mp::driver_key, "qemu")}),
+                Eq(mp::ReturnCode::Ok));
+}
+
+TEST_F(Client, set_cmd_fails_with_multiple_arguments_without_values)
+{
+    EXPECT_CALL(mock_settings, set_values(_)).Times(0);
+    EXPECT_THAT(send_command({"set", keyval_arg(mp::petenv_key, "asdf"), mp::driver_key}),
                 Eq(mp::ReturnCode::CommandLineError));
 }
 
@@ -3326,6 +3934,42 @@ INSTANTIATE_TEST_SUITE_P(Client, ClientLogMessageSuite,
                                 std::vector<std::string>{"start"}, std::vector<std::string>{"version"},
                                 std::vector<std::string>{"restart"}, std::vector<std::string>{"version"}));
 
+TEST_F(ClientAlias, complete_prints_alias_names)
+{
+    populate_db_file(AliasesVector{{"an_alias", {"an_instance", "a_command", "map"}}});
+
+    std::stringstream cout_stream;
+    EXPECT_EQ(send_command({"complete", "aliases"}, cout_stream), mp::ReturnCode::Ok);
+    EXPECT_EQ(cout_stream.str(), "an_alias\n");
+}
+
+TEST_F(Client, complete_prints_cached_instances_in_the_states_asked_for)
+{
+    mpt::TempDir temp_dir;
+    const mpt::SetEnvScope server_address{"MULTIPASS_SERVER_ADDRESS", ("unix:" + temp_dir.path() + "/socket").toUtf8()};
+    mpt::make_file_with_content(temp_dir.filePath("socket-completion"),
+                                "instance foo RUNNING\ninstance bar STOPPED\ninstance baz DELETED\nnetwork eth0\n");
+
+    std::stringstream cout_stream;
+    EXPECT_EQ(send_command({"complete", "instances", "Running", "Stopped"}, cout_stream), mp::ReturnCode::Ok);
+    EXPECT_EQ(cout_stream.str(), "foo\nbar\n");
+}
+
+TEST_F(Client, complete_fails_without_the_daemon_cache)
+{
+    mpt::TempDir temp_dir;
+    const mpt::SetEnvScope server_address{"MULTIPASS_SERVER_ADDRESS", ("unix:" + temp_dir.path() + "/socket").toUtf8()};
+
+    EXPECT_EQ(send_command({"complete", "networks"}), mp::ReturnCode::CommandFail);
+}
+
+TEST_F(Client, complete_needs_to_know_what_to_complete)
+{
+    EXPECT_EQ(send_command({"complete"}), mp::ReturnCode::CommandLineError);
+    EXPECT_EQ(send_command({"complete", "snapshots"}), mp::ReturnCode::CommandLineError);
+    EXPECT_EQ(send_command({"complete", "networks", "Running"}), mp::ReturnCode::CommandLineError);
+}
+
 TEST_F(ClientAlias, alias_creates_alias)
 {
     EXPECT_CALL(mock_daemon, info(_, _)).Times(AtMost(1)).WillRepeatedly(make_info_function());
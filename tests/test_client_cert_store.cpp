@@ -140,6 +140,20 @@ TEST_F(ClientCertStore, verifyCertInStoreReturnsTrue)
     EXPECT_TRUE(cert_store.verify_cert(cert_data));
 }
 
+TEST_F(ClientCertStore, verifyCertTellsAuthenticatedCertsApartEveryTime)
+{
+    mp::ClientCertStore cert_store{temp_dir.path()};
+    cert_store.add_cert(cert_data);
+
+    EXPECT_TRUE(cert_store.verify_cert(cert_data));
+    EXPECT_TRUE(cert_store.verify_cert(cert_data));
+    EXPECT_FALSE(cert_store.verify_cert(cert2_data));
+    EXPECT_FALSE(cert_store.verify_cert("not a certificate"));
+
+    cert_store.add_cert(cert2_data);
+    EXPECT_TRUE(cert_store.verify_cert(cert2_data));
+}
+
 TEST_F(ClientCertStore, addCertAlreadyExistingDoesNotAddAgain)
 {
     const QDir dir{cert_dir};
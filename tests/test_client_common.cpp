@@ -17,6 +17,7 @@
 
 #include "common.h"
 #include "daemon_test_fixture.h"
+#include "fake_alias_config.h"
 #include "file_operations.h"
 #include "mock_cert_provider.h"
 #include "mock_cert_store.h"
@@ -28,6 +29,7 @@
 #include "temp_dir.h"
 
 #include <multipass/cli/client_common.h>
+#include <multipass/constants.h>
 #include <multipass/utils.h>
 
 namespace mp = multipass;
@@ -156,3 +158,38 @@ TEST(TestClientHandleUserPassword, defaultHasNoPassword)
 
     mp::cmd::handle_password(client.get(), &term);
 }
+
+struct TestClientAliasInvocation : public FakeAliasConfig, public Test
+{
+    TestClientAliasInvocation()
+    {
+        populate_db_file({{"an_alias", {"an_instance", "a_command", "map"}}});
+    }
+
+    std::stringstream trash_stream;
+    mpt::StubTerminal term{trash_stream, trash_stream, trash_stream};
+};
+
+TEST_F(TestClientAliasInvocation, runsAliasTheClientIsInvokedAs)
+{
+    EXPECT_EQ(mp::client::alias_invocation_arguments({"/home/user/bin/an_alias", "--flag", "arg"}, &term),
+              (QStringList{mp::client_name, "an_alias", "--", "--flag", "arg"}));
+}
+
+TEST_F(TestClientAliasInvocation, runsAliasInContextTheClientIsInvokedAs)
+{
+    EXPECT_EQ(mp::client::alias_invocation_arguments({"/home/user/bin/default.an_alias", "arg"}, &term),
+              (QStringList{mp::client_name, "default.an_alias", "--", "arg"}));
+}
+
+TEST_F(TestClientAliasInvocation, leavesClientInvocationsAlone)
+{
+    const QStringList arguments{"/usr/bin/multipass", "list"};
+    EXPECT_EQ(mp::client::alias_invocation_arguments(arguments, &term), arguments);
+}
+
+TEST_F(TestClientAliasInvocation, leavesLinksNamedOtherThanAnAliasAlone)
+{
+    const QStringList arguments{"/usr/local/bin/mp", "list"};
+    EXPECT_EQ(mp::client::alias_invocation_arguments(arguments, &term), arguments);
+}
@@ -44,3 +44,27 @@ TEST_F(CloudInitIso, creates_iso_file)
     EXPECT_TRUE(file.exists());
     EXPECT_THAT(file.size(), Ge(0));
 }
+
+TEST_F(CloudInitIso, lays_out_descriptors_records_and_files_in_whole_blocks)
+{
+    mp::CloudInitIso iso;
+    iso.add_file("meta-data", "#cloud-config\n");
+    iso.add_file("user-data", std::string(3000, 'x'));
+    iso.write_to(iso_path);
+
+    QFile file{iso_path};
+    ASSERT_TRUE(file.open(QIODevice::ReadOnly));
+    const auto image = file.readAll();
+
+    constexpr auto block = 2048;
+    const auto volume_blocks = 16 + 3 + 2 + 2 + 1 + 2; // reserved, descriptors, path tables, records, then the files
+    ASSERT_EQ(image.size(), volume_blocks * block);
+    EXPECT_EQ(image.mid(16 * block + 1, 5), "CD001");
+    EXPECT_EQ(image.mid(17 * block + 1, 5), "CD001");
+    EXPECT_EQ(static_cast<uint8_t>(image.at(18 * block)), 0xFF); // set terminator
+    EXPECT_EQ(static_cast<uint8_t>(image.at(16 * block + 80)), volume_blocks);
+
+    EXPECT_TRUE(image.mid(21 * block, block).contains("META_DAT.;1"));
+    EXPECT_EQ(image.mid(23 * block, 14), "#cloud-config\n");
+    EXPECT_EQ(image.mid(24 * block, 3000), QByteArray(3000, 'x'));
+}
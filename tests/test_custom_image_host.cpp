@@ -21,6 +21,7 @@
 #include "mock_platform.h"
 #include "mock_url_downloader.h"
 #include "path.h"
+#include "temp_dir.h"
 
 #include <src/daemon/custom_image_host.h>
 
@@ -30,6 +31,7 @@
 #include <multipass/format.h>
 #include <multipass/query.h>
 
+#include <QFile>
 #include <QUrl>
 
 #include <cstddef>
@@ -243,7 +245,7 @@ TEST_F(CustomImageHost, handles_and_recovers_from_initial_network_failure)
     EXPECT_TRUE(host.info_for(query));
 }
 
-TEST_F(CustomImageHost, handles_and_recovers_from_later_network_failure)
+TEST_F(CustomImageHost, keeps_serving_stale_manifests_through_later_network_failure)
 {
     const auto ttl = 0s; // to ensure updates are always retried
     mp::CustomVMImageHost host{"x86_64", &mock_url_downloader, ttl};
@@ -255,7 +257,7 @@ TEST_F(CustomImageHost, handles_and_recovers_from_later_network_failure)
         .WillOnce(Throw(mp::DownloadException{"", ""}))
         .WillRepeatedly(DoDefault());
 
-    EXPECT_THROW(host.info_for(query), std::runtime_error);
+    EXPECT_TRUE(host.info_for(query));
 
     EXPECT_TRUE(host.info_for(query));
 }
@@ -327,3 +329,41 @@ TEST_P(EmptyArchSuite, empty_for_other_arches)
 }
 
 INSTANTIATE_TEST_SUITE_P(CustomImageHost, EmptyArchSuite, Values("arm", "arm64", "i386", "power", "power64", "s390x"));
+
+TEST_F(CustomImageHost, lazy_host_stamps_its_usage_once_asked_for_images)
+{
+    mpt::TempDir temp_dir;
+    const auto usage_stamp = temp_dir.path() + "/custom-image-host.used";
+
+    mp::CustomVMImageHost host{"x86_64", &mock_url_downloader, default_ttl, "", usage_stamp};
+    EXPECT_FALSE(QFile::exists(usage_stamp));
+
+    EXPECT_TRUE(host.info_for(make_query("core18", "")));
+    EXPECT_TRUE(QFile::exists(usage_stamp));
+}
+
+TEST_F(CustomImageHost, does_not_look_images_up_again_when_their_sums_did_not_change)
+{
+    mpt::TempDir cache_dir;
+    EXPECT_CALL(mock_url_downloader, download_if_changed(_, _))
+        .WillRepeatedly([](const QUrl&, mp::URLDownloader::Validators& validators) -> std::optional<QByteArray> {
+            if (validators.etag == "\"v1\"")
+                return std::nullopt;
+
+            validators.etag = "\"v1\"";
+            return QByteArray{sha256_sums};
+        });
+    EXPECT_CALL(mock_url_downloader, last_modified(_)).Times(4).WillRepeatedly(Return(QDateTime::currentDateTime()));
+
+    const auto query = make_query("core20", "");
+    {
+        mp::CustomVMImageHost host{"x86_64", &mock_url_downloader, 0s, cache_dir.path()};
+        EXPECT_TRUE(host.info_for(query));
+        EXPECT_TRUE(host.info_for(query));
+    }
+
+    mp::CustomVMImageHost host{"x86_64", &mock_url_downloader, 0s, cache_dir.path()};
+    auto info = host.info_for(query);
+    ASSERT_TRUE(info);
+    EXPECT_EQ(info->id, "52a4606b0b3b28e4cb64e2c2595ef8fdbb4170bfd3596f4e0b84f4d84511b614");
+}
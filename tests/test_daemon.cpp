@@ -23,12 +23,15 @@
 #include "json_utils.h"
 #include "mock_daemon.h"
 #include "mock_environment_helpers.h"
+#include "mock_exec_server.h"
 #include "mock_file_ops.h"
 #include "mock_image_host.h"
 #include "mock_logger.h"
+#include "mock_mount_handler.h"
 #include "mock_platform.h"
 #include "mock_server_reader_writer.h"
 #include "mock_settings.h"
+#include "mock_ssh_test_fixture.h"
 #include "mock_standard_paths.h"
 #include "mock_utils.h"
 #include "mock_virtual_machine.h"
@@ -54,17 +57,32 @@
 
 #include <scope_guard.hpp>
 
+#include <QCryptographicHash>
+#include <QDir>
 #include <QJsonArray>
 #include <QJsonDocument>
 #include <QNetworkProxyFactory>
 #include <QStorageInfo>
 #include <QString>
 #include <QSysInfo>
-
+#include <QThread>
+#include <QThreadPool>
+#include <QtConcurrent/QtConcurrent>
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <cstring>
+#include <future>
 #include <memory>
+#include <mutex>
+#include <optional>
 #include <ostream>
+#include <set>
+#include <sstream>
 #include <stdexcept>
 #include <string>
+#include <thread>
 #include <variant>
 
 namespace mp = multipass;
@@ -125,6 +143,14 @@ struct Daemon : public mpt::DaemonTestFixture
         EXPECT_CALL(mock_settings, get(Eq(mp::mounts_key))).WillRepeatedly(Return("true")); /* TODO should probably add
                              a few more tests for `false`, since there are different portions of code depending on it */
         EXPECT_CALL(mock_settings, get(Eq(mp::winterm_key))).WillRepeatedly(Return("none"));
+        EXPECT_CALL(mock_settings, get(Eq(mp::bulk_parallelism_key))).WillRepeatedly(Return("8"));
+        EXPECT_CALL(mock_settings, get(AnyOf(Eq(mp::cpu_overcommit_key), Eq(mp::memory_overcommit_key),
+                                             Eq(mp::disk_overcommit_key))))
+            .WillRepeatedly(Return("0"));
+        EXPECT_CALL(mock_settings, get(Eq(mp::placement_key))).WillRepeatedly(Return("none"));
+        EXPECT_CALL(mock_settings, get(Eq(mp::image_cache_size_key))).WillRepeatedly(Return(""));
+        EXPECT_CALL(mock_settings, get(Eq(mp::ksm_key))).WillRepeatedly(Return("host"));
+        EXPECT_CALL(mock_settings, get(Eq(mp::ksm_pages_to_scan_key))).WillRepeatedly(Return("100"));
     }
 
     mpt::MockUtils::GuardedMock mock_utils_injection{mpt::MockUtils::inject<NiceMock>()};
@@ -637,6 +663,22 @@ TEST_P(DaemonCreateLaunchPollinateDataTestSuite, adds_pollinate_user_agent_to_cl
     send_command({command, alias});
 }
 
+TEST_F(Daemon, cloud_init_vendor_config_is_made_once_for_the_same_launch_arguments)
+{
+    auto mock_factory = use_a_mock_vm_factory();
+    mp::Daemon daemon{config_builder.build()};
+
+    EXPECT_CALL(*mock_factory, get_backend_version_string()).WillOnce(Return("mock-1234"));
+    EXPECT_CALL(*mock_factory, prepare_instance_image(_, _))
+        .Times(2)
+        .WillRepeatedly([](const multipass::VMImage&, const mp::VirtualMachineDescription& desc) {
+            EXPECT_THAT(desc.vendor_data_config, YAMLNodeContainsMap("growpart"));
+        });
+
+    send_command({"launch", "-n", "first"});
+    send_command({"launch", "-n", "second"});
+}
+
 TEST_F(DaemonCreateLaunchAliasTestSuite, blueprintFoundPassesExpectedAliases)
 {
     auto mock_factory = use_a_mock_vm_factory();
@@ -1297,6 +1339,23 @@ TEST_P(LaunchStorageCheckSuite, launch_fails_with_invalid_data_directory)
     EXPECT_THAT(stream.str(), HasSubstr("Failed to determine information about the volume containing"));
 }
 
+TEST_F(Daemon, launch_is_refused_past_the_overcommit_ratios)
+{
+    auto mock_factory = use_a_mock_vm_factory();
+    config_builder.vault = std::make_unique<NiceMock<mpt::MockVMImageVault>>();
+    mp::Daemon daemon{config_builder.build()};
+
+    EXPECT_CALL(mock_platform, host_capacity(_))
+        .WillRepeatedly(Return(mp::platform::HostCapacity{2, mp::MemorySize{"4G"}.in_bytes(), 0}));
+    EXPECT_CALL(mock_settings, get(Eq(mp::cpu_overcommit_key))).WillRepeatedly(Return("2"));
+    EXPECT_CALL(*mock_factory, create_virtual_machine(_, _)).Times(0);
+
+    std::stringstream stream;
+    send_command({"launch", "--cpus", "5"}, trash_stream, stream);
+
+    EXPECT_THAT(stream.str(), HasSubstr("5 vCPUs would be committed, past the 4 that 2 host CPUs allow"));
+}
+
 INSTANTIATE_TEST_SUITE_P(Daemon, DaemonCreateLaunchTestSuite, Values("launch", "test_create"));
 INSTANTIATE_TEST_SUITE_P(Daemon, DaemonCreateLaunchPollinateDataTestSuite,
                          Combine(Values("launch", "test_create"), Values("foo", "")));
@@ -1411,6 +1470,55 @@ TEST_F(Daemon, reads_mac_addresses_from_json)
     check_interfaces_in_json(filename, mac_addr, extra_interfaces);
 }
 
+TEST_F(Daemon, instance_states_are_refreshed_all_at_once)
+{
+    auto mock_factory = use_a_mock_vm_factory();
+    config_builder.vault = std::make_unique<NiceMock<mpt::MockVMImageVault>>();
+
+    const auto [temp_dir, filename] = plant_instance_json(fake_json_contents("52:54:00:73:76:28", {}));
+    config_builder.data_directory = temp_dir->path();
+    EXPECT_CALL(*mock_factory, refresh_states(_)).Times(AnyNumber());
+    EXPECT_CALL(*mock_factory, refresh_states(ElementsAre(NotNull()))).Times(AtLeast(1));
+    mp::Daemon daemon{config_builder.build()};
+
+    std::stringstream stream;
+    send_command({"list"}, stream);
+    EXPECT_THAT(stream.str(), HasSubstr("real-zebraphant"));
+}
+
+TEST_F(Daemon, watch_starts_with_every_instance_and_ends_when_the_client_is_gone)
+{
+    config_builder.vault = std::make_unique<NiceMock<mpt::MockVMImageVault>>();
+
+    const auto [temp_dir, filename] = plant_instance_json(fake_json_contents("52:54:00:73:76:28", {}));
+    config_builder.data_directory = temp_dir->path();
+    mp::Daemon daemon{config_builder.build()};
+
+    StrictMock<mpt::MockServerReaderWriter<mp::WatchReply, mp::WatchRequest>> mock_server;
+    auto instance_matcher = Property(&mp::WatchVMInstance::name, "real-zebraphant");
+    EXPECT_CALL(mock_server, Write(AllOf(Property(&mp::WatchReply::instances, ElementsAre(instance_matcher)),
+                                         Property(&mp::WatchReply::purged, IsEmpty())),
+                                   _))
+        .WillOnce(Return(false));
+
+    EXPECT_TRUE(call_daemon_slot(daemon, &mp::Daemon::watch, mp::WatchRequest{}, mock_server).ok());
+}
+
+TEST_F(Daemon, keeps_instance_names_for_completion_next_to_the_socket)
+{
+    const auto cache_path = QString::fromStdString(mp::utils::completion_cache_path(server_address));
+    if (cache_path.isEmpty())
+        GTEST_SKIP() << "Only kept next to unix sockets";
+
+    config_builder.vault = std::make_unique<NiceMock<mpt::MockVMImageVault>>();
+    const auto [temp_dir, filename] = plant_instance_json(fake_json_contents("52:54:00:73:76:28", {}));
+    config_builder.data_directory = temp_dir->path();
+    QFile::remove(cache_path);
+    mp::Daemon daemon{config_builder.build()};
+
+    EXPECT_THAT(mpt::load(cache_path).toStdString(), HasSubstr("instance real-zebraphant "));
+}
+
 TEST_F(Daemon, writesAndReadsMountsInJson)
 {
     ON_CALL(mock_utils, make_dir(_, _, _))
@@ -1698,8 +1806,81 @@ TEST_F(Daemon, ctor_drops_removed_instances)
     EXPECT_THAT(updated_json.toStdString(), AllOf(HasSubstr(stayed), Not(HasSubstr(gone))));
 }
 
+TEST_F(Daemon, list_sends_chunks_in_name_order)
+{
+    const auto [temp_dir, filename] = plant_instance_json(fmt::format(
+        "{{\n{},\n{},\n{},\n{},\n{}\n}}", fmt::format(valid_template, "echo", "01"),
+        fmt::format(deleted_template, "charlie", "02"), fmt::format(valid_template, "bravo", "03"),
+        fmt::format(valid_template, "delta", "04"), fmt::format(deleted_template, "alpha", "05")));
+    config_builder.data_directory = temp_dir->path();
+    config_builder.vault = std::make_unique<NiceMock<mpt::MockVMImageVault>>();
+    use_a_mock_vm_factory();
+
+    mp::Daemon daemon{config_builder.build()};
+
+    const auto names = [](auto... expected) {
+        return Property(&mp::ListReply::instances, ElementsAre(Property(&mp::ListVMInstance::name, expected)...));
+    };
+
+    StrictMock<mpt::MockServerReaderWriter<mp::ListReply, mp::ListRequest>> mock_server;
+    InSequence seq;
+    EXPECT_CALL(mock_server, Write(names("alpha", "bravo"), _)).WillOnce(Return(true));
+    EXPECT_CALL(mock_server, Write(names("charlie", "delta"), _)).WillOnce(Return(true));
+    EXPECT_CALL(mock_server, Write(names("echo"), _)).WillOnce(Return(true));
+
+    mp::ListRequest request;
+    request.set_chunk_size(2);
+    EXPECT_TRUE(call_daemon_slot(daemon, &mp::Daemon::list, request, mock_server).ok());
+}
+
+TEST_F(Daemon, ssh_info_resumes_instances_suspended_while_idle_before_a_restart)
+{
+    const auto [temp_dir, filename] = plant_instance_json(R"({
+"sleepy": {
+    "deleted": false,
+    "disk_space": "3232323232",
+    "idle_suspend": 30,
+    "idle_suspended": true,
+    "mac_addr": "ab:cd:ef:12:34:56",
+    "mem_size": "2323232323",
+    "metadata": {},
+    "mounts": [],
+    "num_cores": 4,
+    "ssh_username": "ubuntu",
+    "state": 7
+}
+})");
+    config_builder.data_directory = temp_dir->path();
+    config_builder.vault = std::make_unique<NiceMock<mpt::MockVMImageVault>>();
+    auto mock_factory = use_a_mock_vm_factory();
+
+    auto state = mp::VirtualMachine::State::suspended;
+    auto instance_ptr = std::make_unique<NiceMock<mpt::MockVirtualMachine>>("sleepy");
+    EXPECT_CALL(*instance_ptr, current_state()).WillRepeatedly(ReturnPointee(&state));
+    EXPECT_CALL(*instance_ptr, start()).WillOnce(Assign(&state, mp::VirtualMachine::State::running));
+    EXPECT_CALL(*mock_factory, create_virtual_machine).WillOnce([&instance_ptr](const auto&, auto&) {
+        return std::move(instance_ptr);
+    });
+
+    EXPECT_CALL(mock_settings, get(Eq(mp::ssh_compression_key))).WillRepeatedly(Return("auto"));
+    EXPECT_CALL(mock_settings, get(Eq(mp::transfer_window_key))).WillRepeatedly(Return("16"));
+
+    mp::Daemon daemon{config_builder.build()};
+
+    StrictMock<mpt::MockServerReaderWriter<mp::SSHInfoReply, mp::SSHInfoRequest>> mock_server;
+    EXPECT_CALL(mock_server, Write(Property(&mp::SSHInfoReply::ssh_info, Contains(Key("sleepy"))), _))
+        .WillOnce(Return(true));
+
+    mp::SSHInfoRequest request;
+    request.add_instance_name("sleepy");
+    EXPECT_TRUE(call_daemon_slot(daemon, &mp::Daemon::ssh_info, request, mock_server).ok());
+
+    EXPECT_THAT(mpt::load(filename).toStdString(), Not(HasSubstr("idle_suspended"))); // resumed for good
+}
+
 TEST_P(ListIP, lists_with_ip)
 {
+    mpt::MockSSHTestFixture mock_ssh_test_fixture; // addresses are asked for over a session the daemon keeps
     auto mock_factory = use_a_mock_vm_factory();
     config_builder.vault = std::make_unique<NiceMock<mpt::MockVMImageVault>>();
 
@@ -1717,6 +1898,17 @@ TEST_P(ListIP, lists_with_ip)
 
     send_command({"launch"});
 
+    std::string output{"enp5s0 UP 192.168.2.123/24\n"};
+    REPLACE(ssh_channel_read_timeout, [&output](auto, void* dest, std::uint32_t count, int is_stderr, auto) {
+        if (is_stderr || output.empty())
+            return 0;
+
+        const auto size = std::min<std::size_t>(count, output.size());
+        std::memcpy(dest, output.data(), size);
+        output.erase(0, size);
+        return static_cast<int>(size);
+    });
+
     std::stringstream stream;
     send_command(cmd, stream);
 
@@ -1724,6 +1916,206 @@ TEST_P(ListIP, lists_with_ip)
         EXPECT_THAT(stream.str(), HasSubstr(s));
 }
 
+TEST_F(Daemon, list_asks_instances_nothing_off_the_main_thread)
+{
+    mpt::MockSSHTestFixture mock_ssh_test_fixture;
+    auto mock_factory = use_a_mock_vm_factory();
+    config_builder.vault = std::make_unique<NiceMock<mpt::MockVMImageVault>>();
+
+    mp::Daemon daemon{config_builder.build()};
+
+    const auto main_thread = std::this_thread::get_id();
+    std::atomic_bool asked_elsewhere{false};
+    const auto check_thread = [main_thread, &asked_elsewhere] {
+        if (std::this_thread::get_id() != main_thread)
+            asked_elsewhere = true;
+    };
+
+    auto instance_ptr = std::make_unique<NiceMock<mpt::MockVirtualMachine>>("mock");
+    EXPECT_CALL(*instance_ptr, current_state())
+        .WillRepeatedly(DoAll(Invoke(check_thread), Return(mp::VirtualMachine::State::running)));
+    EXPECT_CALL(*instance_ptr, management_ipv4()).WillRepeatedly(DoAll(Invoke(check_thread), Return("10.2.3.4")));
+    EXPECT_CALL(*instance_ptr, ensure_vm_is_running()).WillRepeatedly(Throw(std::runtime_error("Not running")));
+    EXPECT_CALL(*instance_ptr, get_all_ipv4(A<mp::SSHSession&>())).Times(0);
+    EXPECT_CALL(*mock_factory, create_virtual_machine).WillRepeatedly([&instance_ptr](const auto&, auto&) {
+        return std::move(instance_ptr);
+    });
+
+    send_command({"launch"});
+
+    std::stringstream stream;
+    send_command({"list"}, stream);
+
+    EXPECT_THAT(stream.str(), AllOf(HasSubstr("Running"), HasSubstr("10.2.3.4")));
+    EXPECT_FALSE(asked_elsewhere);
+}
+
+TEST_F(Daemon, info_gathers_runtime_information_in_one_go)
+{
+    mpt::MockSSHTestFixture mock_ssh_test_fixture;
+    auto mock_factory = use_a_mock_vm_factory();
+    config_builder.vault = std::make_unique<NiceMock<mpt::MockVMImageVault>>();
+
+    mp::Daemon daemon{config_builder.build()};
+
+    auto instance_ptr = std::make_unique<NiceMock<mpt::MockVirtualMachine>>("mock");
+    EXPECT_CALL(*instance_ptr, current_state()).WillRepeatedly(Return(mp::VirtualMachine::State::running));
+    EXPECT_CALL(*mock_factory, create_virtual_machine).WillRepeatedly([&instance_ptr](const auto&, auto&) {
+        return std::move(instance_ptr);
+    });
+
+    send_command({"launch"});
+
+    std::vector<std::string> commands;
+    REPLACE(ssh_channel_request_exec, [&commands](auto, const char* cmd) {
+        commands.emplace_back(cmd);
+        return SSH_OK;
+    });
+    std::string output{"load=0.01 0.02 0.03\nmemory_usage=1000\nmemory_total=2000\ndisk_usage=3000\n"
+                       "disk_total=4000\ncpu_count=2\ncurrent_release=Ubuntu 22.04 LTS\n"};
+    REPLACE(ssh_channel_read_timeout, [&output](auto, void* dest, std::uint32_t count, int is_stderr, auto) {
+        if (is_stderr || output.empty())
+            return 0;
+
+        const auto size = std::min<std::size_t>(count, output.size());
+        std::memcpy(dest, output.data(), size);
+        output.erase(0, size);
+        return static_cast<int>(size);
+    });
+
+    std::stringstream stream;
+    send_command({"info", "--all"}, stream);
+
+    EXPECT_EQ(commands.size(), 1u);
+    EXPECT_THAT(stream.str(), AllOf(HasSubstr("0.01 0.02 0.03"), HasSubstr("Ubuntu 22.04 LTS"),
+                                    HasSubstr("192.168.2.123")));
+}
+
+TEST_F(Daemon, info_asks_the_guest_directly_when_the_backend_can)
+{
+    mpt::MockSSHTestFixture mock_ssh_test_fixture;
+    auto mock_factory = use_a_mock_vm_factory();
+    config_builder.vault = std::make_unique<NiceMock<mpt::MockVMImageVault>>();
+
+    mp::Daemon daemon{config_builder.build()};
+
+    auto instance_ptr = std::make_unique<NiceMock<mpt::MockVirtualMachine>>("mock");
+    EXPECT_CALL(*instance_ptr, current_state()).WillRepeatedly(Return(mp::VirtualMachine::State::running));
+    EXPECT_CALL(*instance_ptr, guest_exec(_))
+        .WillOnce(Return("load=0.04 0.05 0.06\nmemory_usage=1000\nmemory_total=2000\ndisk_usage=3000\n"
+                         "disk_total=4000\ncpu_count=2\ncurrent_release=Ubuntu 24.04 LTS\n"));
+    EXPECT_CALL(*instance_ptr, guest_ipv4()).WillOnce(Return(std::vector<std::string>{"10.1.2.3"}));
+    EXPECT_CALL(*instance_ptr, get_all_ipv4(A<mp::SSHSession&>())).Times(0);
+    EXPECT_CALL(*mock_factory, create_virtual_machine).WillRepeatedly([&instance_ptr](const auto&, auto&) {
+        return std::move(instance_ptr);
+    });
+
+    send_command({"launch"});
+
+    std::vector<std::string> commands;
+    REPLACE(ssh_channel_request_exec, [&commands](auto, const char* cmd) {
+        commands.emplace_back(cmd);
+        return SSH_OK;
+    });
+
+    std::stringstream stream;
+    send_command({"info", "--all"}, stream);
+
+    EXPECT_TRUE(commands.empty());
+    EXPECT_THAT(stream.str(), AllOf(HasSubstr("0.04 0.05 0.06"), HasSubstr("Ubuntu 24.04 LTS"), HasSubstr("10.1.2.3")));
+}
+
+TEST_F(Daemon, info_asks_no_more_instances_at_a_time_than_bulk_parallelism)
+{
+    auto mock_factory = use_a_mock_vm_factory();
+    config_builder.vault = std::make_unique<NiceMock<mpt::MockVMImageVault>>();
+    EXPECT_CALL(mock_settings, get(Eq(mp::bulk_parallelism_key))).WillRepeatedly(Return("2"));
+
+    mp::Daemon daemon{config_builder.build()};
+
+    std::atomic_int asking{0}, most_asking{0};
+    EXPECT_CALL(*mock_factory, create_virtual_machine)
+        .WillRepeatedly([&asking, &most_asking](const mp::VirtualMachineDescription& desc, auto&) {
+            auto instance = std::make_unique<NiceMock<mpt::MockVirtualMachine>>(desc.vm_name);
+            EXPECT_CALL(*instance, current_state()).WillRepeatedly(Return(mp::VirtualMachine::State::running));
+            EXPECT_CALL(*instance, guest_ipv4()).WillRepeatedly(Return(std::vector<std::string>{}));
+            EXPECT_CALL(*instance, guest_exec(_)).WillRepeatedly([&asking, &most_asking](auto&) {
+                const auto now_asking = ++asking;
+                for (auto most = most_asking.load(); most < now_asking;)
+                    most_asking.compare_exchange_weak(most, now_asking);
+
+                std::this_thread::sleep_for(std::chrono::milliseconds{50});
+                --asking;
+                return std::optional<std::string>{"cpu_count=2\n"};
+            });
+            return instance;
+        });
+
+    for (const auto* name : {"one", "two", "three", "four"})
+        send_command({"launch", "--name", name});
+
+    std::stringstream stream;
+    send_command({"info", "--all"}, stream);
+
+    EXPECT_LE(most_asking, 2);
+    EXPECT_THAT(stream.str(), AllOf(HasSubstr("one"), HasSubstr("two"), HasSubstr("three"), HasSubstr("four")));
+}
+
+TEST_F(Daemon, info_keeps_runtime_values_apart_when_some_are_missing)
+{
+    auto mock_factory = use_a_mock_vm_factory();
+    config_builder.vault = std::make_unique<NiceMock<mpt::MockVMImageVault>>();
+
+    mp::Daemon daemon{config_builder.build()};
+
+    auto instance_ptr = std::make_unique<NiceMock<mpt::MockVirtualMachine>>("mock");
+    EXPECT_CALL(*instance_ptr, current_state()).WillRepeatedly(Return(mp::VirtualMachine::State::running));
+    EXPECT_CALL(*instance_ptr, guest_exec(_))
+        .WillOnce(Return("load=0.04 0.05 0.06\ndisk_usage=3000\ndisk_total=4000\ncpu_count=2\n"
+                         "current_release=Ubuntu 24.04 LTS\n"));
+    EXPECT_CALL(*instance_ptr, guest_ipv4()).WillOnce(Return(std::vector<std::string>{"10.1.2.3"}));
+    EXPECT_CALL(*mock_factory, create_virtual_machine).WillRepeatedly([&instance_ptr](const auto&, auto&) {
+        return std::move(instance_ptr);
+    });
+
+    send_command({"launch"});
+
+    std::stringstream stream;
+    send_command({"info", "--all"}, stream);
+
+    EXPECT_THAT(stream.str(), AllOf(HasSubstr("CPU(s):         2\n"), HasSubstr("Load:           0.04 0.05 0.06\n"),
+                                    HasSubstr("Memory usage:   --\n"), Not(HasSubstr("Disk usage:     --")),
+                                    HasSubstr("Ubuntu 24.04 LTS")));
+}
+
+TEST_F(Daemon, info_includes_what_the_host_sees_the_instance_use)
+{
+    auto mock_factory = use_a_mock_vm_factory();
+    config_builder.vault = std::make_unique<NiceMock<mpt::MockVMImageVault>>();
+
+    mp::Daemon daemon{config_builder.build()};
+
+    mp::VirtualMachine::HostStats stats;
+    stats.rss_bytes = 4096;
+    stats.network_sent_bytes = 12345;
+
+    auto instance_ptr = std::make_unique<NiceMock<mpt::MockVirtualMachine>>("mock");
+    EXPECT_CALL(*instance_ptr, current_state()).WillRepeatedly(Return(mp::VirtualMachine::State::running));
+    EXPECT_CALL(*instance_ptr, guest_exec(_)).WillRepeatedly(Return("\n"));
+    EXPECT_CALL(*instance_ptr, guest_ipv4()).WillRepeatedly(Return(std::vector<std::string>{}));
+    EXPECT_CALL(*instance_ptr, host_stats()).WillRepeatedly(Return(stats));
+    EXPECT_CALL(*mock_factory, create_virtual_machine).WillRepeatedly([&instance_ptr](const auto&, auto&) {
+        return std::move(instance_ptr);
+    });
+
+    send_command({"launch"});
+
+    std::stringstream stream;
+    send_command({"info", "--all", "--format", "json"}, stream);
+
+    EXPECT_THAT(stream.str(), AllOf(HasSubstr("\"rss_bytes\": 4096"), HasSubstr("\"network_sent_bytes\": 12345")));
+}
+
 INSTANTIATE_TEST_SUITE_P(
     Daemon, ListIP,
     Values(std::make_tuple(mp::VirtualMachine::State::running, std::vector<std::string>{"list"},
@@ -2133,6 +2525,143 @@ TEST_F(Daemon, purgePersistsInstances)
     EXPECT_THAT(updated_json.toStdString(), AllOf(HasSubstr(name1), HasSubstr(name2)));
 }
 
+TEST_F(Daemon, journals_state_changes_on_top_of_the_instance_db)
+{
+    const std::string name{"world-of-goo"};
+    const auto instance_json = fmt::format("{{{}}}", fmt::format(valid_template, name, "10"));
+    const auto [temp_dir, filename] = plant_instance_json(instance_json);
+    const auto journal_filename = temp_dir->path() + "/multipassd-vm-instances.journal";
+    config_builder.data_directory = temp_dir->path();
+    config_builder.vault = std::make_unique<NiceMock<mpt::MockVMImageVault>>();
+    mp::Daemon daemon{config_builder.build()};
+
+    auto& monitor = static_cast<mp::VMStatusMonitor&>(daemon);
+    monitor.persist_state_for(name, mp::VirtualMachine::State::stopped);
+    monitor.persist_state_for(name, mp::VirtualMachine::State::off);
+
+    const auto persisted_state = [&db = filename, &name] {
+        return QJsonDocument::fromJson(mpt::load(db))[QString::fromStdString(name)]["state"].toInt();
+    };
+    EXPECT_TRUE(QFile::exists(journal_filename));
+    EXPECT_EQ(persisted_state(), static_cast<int>(mp::VirtualMachine::State::stopped));
+
+    call_daemon_slot(daemon, &mp::Daemon::purge, mp::PurgeRequest{},
+                     NiceMock<mpt::MockServerReaderWriter<mp::PurgeReply, mp::PurgeRequest>>{});
+
+    EXPECT_FALSE(QFile::exists(journal_filename));
+    EXPECT_EQ(persisted_state(), static_cast<int>(mp::VirtualMachine::State::off));
+}
+
+TEST_F(Daemon, replays_the_journal_kept_on_top_of_the_instance_db)
+{
+    const std::string name{"world-of-goo"};
+    const auto instance_json = fmt::format("{{{}}}", fmt::format(valid_template, name, "10"));
+    const auto [temp_dir, filename] = plant_instance_json(instance_json);
+    const auto db_hash = QCryptographicHash::hash(mpt::load(filename), QCryptographicHash::Sha256).toHex();
+
+    // What the daemon would have journaled for the instance being turned off, on a single line
+    auto journaled_json = fmt::format(valid_template, name, "10");
+    journaled_json.replace(journaled_json.find("\"state\": 1"), 10, "\"state\": 0");
+    journaled_json.erase(std::remove(journaled_json.begin(), journaled_json.end(), '\n'), journaled_json.end());
+    mpt::make_file_with_content(temp_dir->path() + "/multipassd-vm-instances.journal",
+                                fmt::format("{{\"base\": \"{}\"}}\n{{{}}}\n", db_hash.toStdString(), journaled_json));
+
+    config_builder.data_directory = temp_dir->path();
+    config_builder.vault = std::make_unique<NiceMock<mpt::MockVMImageVault>>();
+    mp::Daemon daemon{config_builder.build()};
+
+    QFile::remove(filename);
+    call_daemon_slot(daemon, &mp::Daemon::purge, mp::PurgeRequest{},
+                     NiceMock<mpt::MockServerReaderWriter<mp::PurgeReply, mp::PurgeRequest>>{});
+
+    const auto updated_json = QJsonDocument::fromJson(mpt::load(filename));
+    EXPECT_EQ(updated_json[QString::fromStdString(name)]["state"].toInt(),
+              static_cast<int>(mp::VirtualMachine::State::off));
+}
+
+TEST_F(Daemon, stops_several_instances_at_a_time)
+{
+    mpt::MockSSHTestFixture mock_ssh_test_fixture;
+    const std::string name1{"world-of-goo"}, name2{"small-beauty-goo"};
+    const auto instances_json =
+        fmt::format("{{{}, {}}}", fmt::format(valid_template, name1, "10"), fmt::format(valid_template, name2, "11"));
+    const auto [temp_dir, filename] = plant_instance_json(instances_json);
+    config_builder.data_directory = temp_dir->path();
+    config_builder.vault = std::make_unique<NiceMock<mpt::MockVMImageVault>>();
+
+    // Each shutdown only returns once both have begun
+    std::mutex mutex;
+    std::condition_variable cv;
+    int shutting_down{0};
+    auto mock_factory = use_a_mock_vm_factory();
+    EXPECT_CALL(*mock_factory, create_virtual_machine)
+        .Times(2)
+        .WillRepeatedly([&](const mp::VirtualMachineDescription& desc, auto&) -> mp::VirtualMachine::UPtr {
+            const auto running = mp::VirtualMachine::State::running;
+            auto vm = std::make_unique<NiceMock<mpt::MockVirtualMachine>>(running, desc.vm_name);
+            EXPECT_CALL(*vm, current_state).WillRepeatedly(Return(running));
+            EXPECT_CALL(*vm, concurrent_state_changes).WillRepeatedly(Return(true));
+            EXPECT_CALL(*vm, shutdown).WillOnce([&] {
+                std::unique_lock<std::mutex> lock{mutex};
+                ++shutting_down;
+                cv.notify_all();
+                EXPECT_TRUE(cv.wait_for(lock, std::chrono::seconds(5), [&] { return shutting_down == 2; }));
+            });
+            return vm;
+        });
+    mp::Daemon daemon{config_builder.build()};
+
+    mp::StopRequest request;
+    request.mutable_instance_names()->add_instance_name(name1);
+    request.mutable_instance_names()->add_instance_name(name2);
+    StrictMock<mpt::MockServerReaderWriter<mp::StopReply, mp::StopRequest>> mock_server;
+    EXPECT_CALL(mock_server, Write(Property(&mp::StopReply::log_line, HasSubstr("Stopped")), _))
+        .Times(2)
+        .WillRepeatedly(Return(true));
+
+    EXPECT_TRUE(call_daemon_slot(daemon, &mp::Daemon::stop, request, mock_server).ok());
+}
+
+TEST_F(Daemon, suspends_instances_of_backends_bound_to_their_thread_in_that_thread)
+{
+    const std::string name1{"world-of-goo"}, name2{"small-beauty-goo"};
+    const auto instances_json =
+        fmt::format("{{{}, {}}}", fmt::format(valid_template, name1, "10"), fmt::format(valid_template, name2, "11"));
+    const auto [temp_dir, filename] = plant_instance_json(instances_json);
+    config_builder.data_directory = temp_dir->path();
+    config_builder.vault = std::make_unique<NiceMock<mpt::MockVMImageVault>>();
+
+    std::mutex mutex;
+    std::set<std::thread::id> suspending_threads;
+    auto mock_factory = use_a_mock_vm_factory();
+    EXPECT_CALL(*mock_factory, create_virtual_machine)
+        .Times(2)
+        .WillRepeatedly([&](const mp::VirtualMachineDescription& desc, auto&) -> mp::VirtualMachine::UPtr {
+            const auto running = mp::VirtualMachine::State::running;
+            auto vm = std::make_unique<NiceMock<mpt::MockVirtualMachine>>(running, desc.vm_name);
+            EXPECT_CALL(*vm, current_state).WillRepeatedly(Return(running));
+            EXPECT_CALL(*vm, concurrent_state_changes).WillRepeatedly(Return(false));
+            EXPECT_CALL(*vm, suspend).WillOnce([&] {
+                std::lock_guard<std::mutex> lock{mutex};
+                suspending_threads.insert(std::this_thread::get_id());
+            });
+            return vm;
+        });
+    mp::Daemon daemon{config_builder.build()};
+
+    mp::SuspendRequest request;
+    request.mutable_instance_names()->add_instance_name(name1);
+    request.mutable_instance_names()->add_instance_name(name2);
+    StrictMock<mpt::MockServerReaderWriter<mp::SuspendReply, mp::SuspendRequest>> mock_server;
+    EXPECT_CALL(mock_server, Write(Property(&mp::SuspendReply::log_line, HasSubstr("Suspended")), _))
+        .Times(2)
+        .WillRepeatedly(Return(true));
+
+    // Both in the thread the request came in on, one after the other
+    EXPECT_TRUE(call_daemon_slot(daemon, &mp::Daemon::suspend, request, mock_server).ok());
+    EXPECT_THAT(suspending_threads, SizeIs(1));
+}
+
 TEST_F(Daemon, launch_fails_with_incompatible_blueprint)
 {
     auto mock_blueprint_provider = std::make_unique<NiceMock<mpt::MockVMBlueprintProvider>>();
@@ -2171,4 +2700,553 @@ TEST_F(Daemon, info_all_returns_all_instances)
 
     call_daemon_slot(daemon, &mp::Daemon::info, mp::InfoRequest{}, mock_server);
 }
+
+TEST_F(Daemon, info_pages_through_instances_by_name)
+{
+    const std::string good_instance_name{"good-instance"}, deleted_instance_name{"deleted-instance"};
+    const auto good_instance_json = fmt::format(valid_template, good_instance_name, "10");
+    const auto deleted_instance_json = fmt::format(deleted_template, deleted_instance_name, "11");
+    const auto instances_json = fmt::format("{{{}, {}}}", good_instance_json, deleted_instance_json);
+    const auto [temp_dir, __] = plant_instance_json(instances_json);
+    config_builder.data_directory = temp_dir->path();
+    config_builder.vault = std::make_unique<NiceMock<mpt::MockVMImageVault>>();
+
+    EXPECT_CALL(*use_a_mock_vm_factory(), create_virtual_machine).WillRepeatedly(WithArg<0>([](const auto& desc) {
+        return std::make_unique<mpt::StubVirtualMachine>(desc.vm_name);
+    }));
+
+    mp::Daemon daemon{config_builder.build()};
+
+    mp::InfoRequest request;
+    request.set_page_size(1);
+
+    StrictMock<mpt::MockServerReaderWriter<mp::InfoReply, mp::InfoRequest>> first_server{};
+    EXPECT_CALL(first_server,
+                Write(AllOf(Property(&mp::InfoReply::info,
+                                     ElementsAre(Property(&mp::InfoReply::Info::name, deleted_instance_name))),
+                            Property(&mp::InfoReply::next_page_token, deleted_instance_name)),
+                      _))
+        .WillOnce(Return(true));
+    EXPECT_TRUE(call_daemon_slot(daemon, &mp::Daemon::info, request, first_server).ok());
+
+    request.set_page_token(deleted_instance_name);
+
+    StrictMock<mpt::MockServerReaderWriter<mp::InfoReply, mp::InfoRequest>> second_server{};
+    EXPECT_CALL(second_server,
+                Write(AllOf(Property(&mp::InfoReply::info,
+                                     ElementsAre(Property(&mp::InfoReply::Info::name, good_instance_name))),
+                            Property(&mp::InfoReply::next_page_token, IsEmpty())),
+                      _))
+        .WillOnce(Return(true));
+    EXPECT_TRUE(call_daemon_slot(daemon, &mp::Daemon::info, request, second_server).ok());
+}
+
+TEST_F(Daemon, info_fills_in_only_the_fields_asked_for)
+{
+    const auto [temp_dir, __] = plant_instance_json(fmt::format(valid_template, "masked", "10"));
+    config_builder.data_directory = temp_dir->path();
+
+    auto mock_image_vault = std::make_unique<NiceMock<mpt::MockVMImageVault>>();
+    EXPECT_CALL(*mock_image_vault, fetch_image(_, Field(&mp::Query::name, "masked"), _, _, _, _))
+        .Times(AtMost(1)) // when the instance is loaded, but not to answer
+        .WillRepeatedly(DoDefault());
+    config_builder.vault = std::move(mock_image_vault);
+
+    EXPECT_CALL(*use_a_mock_vm_factory(), create_virtual_machine).WillRepeatedly(WithArg<0>([](const auto& desc) {
+        return std::make_unique<mpt::StubVirtualMachine>(desc.vm_name);
+    }));
+
+    mp::Daemon daemon{config_builder.build()};
+
+    mp::InfoRequest request;
+    request.add_fields("name");
+
+    StrictMock<mpt::MockServerReaderWriter<mp::InfoReply, mp::InfoRequest>> mock_server{};
+    const auto masked_matcher = AllOf(Property(&mp::InfoReply::Info::name, "masked"),
+                                      Property(&mp::InfoReply::Info::id, IsEmpty()),
+                                      Property(&mp::InfoReply::Info::has_mount_info, IsFalse()));
+    EXPECT_CALL(mock_server, Write(Property(&mp::InfoReply::info, ElementsAre(masked_matcher)), _))
+        .WillOnce(Return(true));
+    EXPECT_TRUE(call_daemon_slot(daemon, &mp::Daemon::info, request, mock_server).ok());
+}
+
+TEST_F(Daemon, info_rejects_unknown_fields)
+{
+    mp::Daemon daemon{config_builder.build()};
+
+    mp::InfoRequest request;
+    request.add_fields("shoe_size");
+
+    StrictMock<mpt::MockServerReaderWriter<mp::InfoReply, mp::InfoRequest>> mock_server{};
+    const auto status = call_daemon_slot(daemon, &mp::Daemon::info, request, mock_server);
+    EXPECT_EQ(status.error_code(), grpc::StatusCode::FAILED_PRECONDITION);
+    EXPECT_THAT(status.error_message(), HasSubstr("shoe_size"));
+}
+
+struct DaemonExec : public Daemon
+{
+    DaemonExec()
+    {
+        config_builder.vault = std::make_unique<NiceMock<mpt::MockVMImageVault>>();
+
+        EXPECT_CALL(*instance_ptr, current_state()).WillRepeatedly(Return(mp::VirtualMachine::State::running));
+        EXPECT_CALL(*mock_factory, create_virtual_machine).WillRepeatedly([this](const auto&, auto&) {
+            return std::move(instance_ptr);
+        });
+
+        request.set_instance_name(instance_name);
+        request.set_command("echo hello");
+
+        EXPECT_CALL(mock_server, Write).WillRepeatedly([this](const mp::ExecReply& reply, auto) {
+            replies.push_back(reply);
+            return true;
+        });
+    }
+
+    const std::string instance_name{"foo"};
+    mpt::MockSSHTestFixture mock_ssh_test_fixture;
+    mpt::MockVirtualMachineFactory* mock_factory = use_a_mock_vm_factory();
+    std::unique_ptr<NiceMock<mpt::MockVirtualMachine>> instance_ptr =
+        std::make_unique<NiceMock<mpt::MockVirtualMachine>>(instance_name);
+
+    std::vector<std::string> commands;
+    std::string output{"hello\n"};
+    MockScope<decltype(mock_ssh_channel_request_exec)> request_exec{
+        mock_ssh_channel_request_exec, [this](auto, const char* cmd) {
+            commands.emplace_back(cmd);
+            return SSH_OK;
+        }};
+    MockScope<decltype(mock_ssh_channel_poll_timeout)> poll{
+        mock_ssh_channel_poll_timeout, [this](auto, auto, int is_stderr) {
+            return is_stderr || output.empty() ? SSH_EOF : static_cast<int>(output.size());
+        }};
+    MockScope<decltype(mock_ssh_channel_read_timeout)> read{
+        mock_ssh_channel_read_timeout, [this](auto, void* dest, std::uint32_t count, auto, auto) {
+            const auto size = std::min<std::size_t>(count, output.size());
+            std::memcpy(dest, output.data(), size);
+            output.erase(0, size);
+            return static_cast<int>(size);
+        }};
+    MockScope<decltype(mock_ssh_channel_get_exit_status)> exit_status{mock_ssh_channel_get_exit_status,
+                                                                      [](auto) { return 3; }};
+
+    mp::ExecRequest request;
+    StrictMock<mpt::MockExecServer> mock_server;
+    std::vector<mp::ExecReply> replies;
+};
+
+TEST_F(DaemonExec, runs_the_command_and_relays_what_it_prints_and_how_it_exits)
+{
+    mp::Daemon daemon{config_builder.build()};
+    send_command({"launch", "--name", instance_name});
+
+    EXPECT_CALL(mock_server, Read).WillOnce(Return(false));
+    EXPECT_CALL(mock_server, cancel).Times(0);
+
+    EXPECT_TRUE(call_daemon_slot(daemon, &mp::Daemon::exec, request, mock_server).ok());
+
+    EXPECT_THAT(commands, Contains("echo hello"));
+    ASSERT_FALSE(replies.empty());
+    EXPECT_THAT(replies, Contains(Property(&mp::ExecReply::std_out, "hello\n")));
+    EXPECT_TRUE(replies.back().exited());
+    EXPECT_EQ(replies.back().exit_code(), 3);
+}
+
+TEST_F(DaemonExec, cuts_off_a_client_that_does_not_say_it_is_done_sending)
+{
+    mp::Daemon daemon{config_builder.build()};
+    send_command({"launch", "--name", instance_name});
+
+    std::promise<void> cancelled;
+    EXPECT_CALL(mock_server, Read).WillOnce([cancelled_future = cancelled.get_future()](auto) {
+        cancelled_future.wait();
+        return false;
+    });
+    EXPECT_CALL(mock_server, cancel).WillOnce([&cancelled] { cancelled.set_value(); });
+
+    EXPECT_TRUE(call_daemon_slot(daemon, &mp::Daemon::exec, request, mock_server).ok());
+
+    ASSERT_FALSE(replies.empty());
+    EXPECT_TRUE(replies.back().exited());
+    EXPECT_EQ(replies.back().exit_code(), 3);
+}
+
+#ifdef MULTIPASS_PLATFORM_LINUX
+TEST_F(Daemon, forward_refuses_privileged_host_ports)
+{
+    mp::Daemon daemon{config_builder.build()};
+
+    mp::ForwardRequest request;
+    request.set_instance_name("foo");
+    request.set_instance_port(80);
+    request.set_host_port(80);
+
+    StrictMock<mpt::MockServerReaderWriter<mp::ForwardReply, mp::ForwardRequest>> mock_server{};
+    const auto status = call_daemon_slot(daemon, &mp::Daemon::forward, request, mock_server);
+    EXPECT_EQ(status.error_code(), grpc::StatusCode::INVALID_ARGUMENT);
+    EXPECT_THAT(status.error_message(), HasSubstr("privileged"));
+}
+#else
+TEST_F(Daemon, forward_is_unimplemented_off_linux)
+{
+    mp::Daemon daemon{config_builder.build()};
+
+    mp::ForwardRequest request;
+    request.set_instance_name("foo");
+    request.set_instance_port(80);
+    request.set_host_port(8080);
+
+    StrictMock<mpt::MockServerReaderWriter<mp::ForwardReply, mp::ForwardRequest>> mock_server{};
+    EXPECT_EQ(call_daemon_slot(daemon, &mp::Daemon::forward, request, mock_server).error_code(),
+              grpc::StatusCode::UNIMPLEMENTED);
+}
+#endif
+
+TEST_F(Daemon, apply_dry_run_tells_the_steps_it_would_take)
+{
+    const std::unordered_map<std::string, mp::VMMount> mounts{
+        {"/home/ubuntu/keep", {"/src/keep", {}, {}, mp::VMMount::MountType::Native}},
+        {"/home/ubuntu/move", {"/src/old", {}, {}, mp::VMMount::MountType::Native}}};
+    const auto [temp_dir, filename] = plant_instance_json(fake_json_contents("52:54:00:73:76:28", {}, mounts));
+    config_builder.data_directory = temp_dir->path();
+    config_builder.vault = std::make_unique<NiceMock<mpt::MockVMImageVault>>();
+
+    auto instance_ptr = std::make_unique<NiceMock<mpt::MockVirtualMachine>>("real-zebraphant");
+    EXPECT_CALL(*instance_ptr, make_native_mount_handler).WillRepeatedly([](auto&&...) {
+        return std::make_unique<NiceMock<mpt::MockMountHandler>>();
+    });
+    EXPECT_CALL(*instance_ptr, start).Times(0);
+    auto mock_factory = use_a_mock_vm_factory();
+    EXPECT_CALL(*mock_factory, create_virtual_machine).WillOnce([&instance_ptr](const auto&, auto&) {
+        return std::move(instance_ptr);
+    });
+
+    mp::Daemon daemon{config_builder.build()};
+
+    const auto file = QDir{temp_dir->path()}.filePath("instances.yaml");
+    mpt::make_file_with_content(file, "instances:\n"
+                                      "  real-zebraphant:\n"
+                                      "    mounts:\n"
+                                      "      - source: /src/keep\n"
+                                      "        target: /home/ubuntu/keep\n"
+                                      "      - source: /src/new\n"
+                                      "        target: /home/ubuntu/move\n"
+                                      "  dormant:\n"
+                                      "    state: stopped\n"
+                                      "  lively:\n"
+                                      "    state: running\n");
+
+    std::stringstream out;
+    send_command({"apply", "--dry-run", file.toStdString()}, out);
+
+    EXPECT_THAT(out.str(), AllOf(HasSubstr("real-zebraphant: would be unmounting /home/ubuntu/move\n"),
+                                 HasSubstr("real-zebraphant: would be mounting /src/new on /home/ubuntu/move\n"),
+                                 Not(HasSubstr("/home/ubuntu/keep")), HasSubstr("dormant: would be creating\n"),
+                                 HasSubstr("lively: would be launching\n")));
+    EXPECT_LT(out.str().find("would be mounting"), out.str().find("real-zebraphant: would be starting"));
+    EXPECT_THAT(mpt::load(filename).toStdString(), AllOf(Not(HasSubstr("dormant")), Not(HasSubstr("lively"))));
+}
+
+TEST_F(Daemon, apply_resizes_once_stopped_and_purges_alongside)
+{
+    mpt::MockSSHTestFixture mock_ssh_test_fixture;
+    const auto [temp_dir, filename] = plant_instance_json(
+        fmt::format("{{{}, {}}}", fmt::format(valid_template, "big", "10"), fmt::format(valid_template, "gone", "11")));
+    config_builder.data_directory = temp_dir->path();
+    config_builder.vault = std::make_unique<NiceMock<mpt::MockVMImageVault>>();
+
+    auto big_state = mp::VirtualMachine::State::running;
+    auto big = std::make_unique<NiceMock<mpt::MockVirtualMachine>>(big_state, "big");
+    auto gone = std::make_unique<NiceMock<mpt::MockVirtualMachine>>(mp::VirtualMachine::State::stopped, "gone");
+    EXPECT_CALL(*big, current_state).WillRepeatedly(ReturnPointee(&big_state));
+    EXPECT_CALL(*gone, current_state).WillRepeatedly(Return(mp::VirtualMachine::State::stopped));
+    {
+        InSequence seq;
+        EXPECT_CALL(*big, shutdown).WillOnce(Assign(&big_state, mp::VirtualMachine::State::stopped));
+        EXPECT_CALL(mock_settings, set_values(Contains(Pair(QString{"local.big.cpus"}, QString{"2"}))));
+        EXPECT_CALL(*big, start).WillOnce(Assign(&big_state, mp::VirtualMachine::State::running));
+    }
+
+    auto mock_factory = use_a_mock_vm_factory();
+    EXPECT_CALL(*mock_factory, create_virtual_machine)
+        .Times(2)
+        .WillRepeatedly([&big, &gone](const mp::VirtualMachineDescription& desc, auto&) -> mp::VirtualMachine::UPtr {
+            if (desc.vm_name == "big")
+                return std::move(big);
+            return std::move(gone);
+        });
+
+    mp::Daemon daemon{config_builder.build()};
+
+    const auto file = QDir{temp_dir->path()}.filePath("instances.yaml");
+    mpt::make_file_with_content(file, "instances:\n"
+                                      "  big:\n"
+                                      "    cpus: 2\n"
+                                      "  gone:\n"
+                                      "    state: absent\n");
+
+    std::stringstream out, err;
+    send_command({"apply", file.toStdString()}, out, err);
+
+    EXPECT_THAT(err.str(), IsEmpty());
+    EXPECT_THAT(out.str(), HasSubstr("big: stopping\nbig: resizing\nbig: starting\nbig: done\n"));
+    EXPECT_THAT(out.str(), AllOf(HasSubstr("gone: purging\n"), HasSubstr("gone: done\n")));
+    EXPECT_THAT(mpt::load(filename).toStdString(), AllOf(HasSubstr("big"), Not(HasSubstr("gone"))));
+}
+
+TEST_F(Daemon, apply_fails_with_all_the_instances_that_could_not_be_applied)
+{
+    const auto [temp_dir, filename] = plant_instance_json(fmt::format(
+        "{{{}, {}, {}}}", fmt::format(valid_template, "fine", "10"), fmt::format(deleted_template, "ghost", "11"),
+        fmt::format(deleted_template, "spook", "12")));
+    config_builder.data_directory = temp_dir->path();
+    config_builder.vault = std::make_unique<NiceMock<mpt::MockVMImageVault>>();
+
+    auto mock_factory = use_a_mock_vm_factory();
+    EXPECT_CALL(*mock_factory, create_virtual_machine)
+        .Times(3)
+        .WillRepeatedly([](const mp::VirtualMachineDescription& desc, auto&) -> mp::VirtualMachine::UPtr {
+            auto vm = std::make_unique<NiceMock<mpt::MockVirtualMachine>>(desc.vm_name);
+            EXPECT_CALL(*vm, current_state).WillRepeatedly(Return(mp::VirtualMachine::State::running));
+            EXPECT_CALL(*vm, start).Times(0);
+            return vm;
+        });
+
+    mp::Daemon daemon{config_builder.build()};
+
+    const auto file = QDir{temp_dir->path()}.filePath("instances.yaml");
+    mpt::make_file_with_content(file, "instances:\n"
+                                      "  fine:\n"
+                                      "  ghost:\n"
+                                      "  spook:\n");
+
+    std::stringstream out, err;
+    send_command({"apply", file.toStdString()}, out, err);
+
+    EXPECT_THAT(out.str(), AllOf(HasSubstr("fine: up to date\n"), HasSubstr("ghost: failed: the instance is deleted"),
+                                 HasSubstr("spook: failed: the instance is deleted")));
+    EXPECT_THAT(err.str(), AllOf(HasSubstr("2 of 3 instances could not be applied"), HasSubstr("ghost: the instance"),
+                                 HasSubstr("spook: the instance")));
+}
+
+TEST_F(Daemon, clone_copies_a_stopped_instance_with_new_macs)
+{
+    const auto [temp_dir, filename] =
+        plant_instance_json(fmt::format("{{{}}}", fmt::format(valid_template, "source", "10")));
+    config_builder.data_directory = temp_dir->path();
+    auto mock_image_vault = std::make_unique<NiceMock<mpt::MockVMImageVault>>();
+    EXPECT_CALL(*mock_image_vault, clone(Eq("source"), Eq("source-clone1"))).WillOnce(Return(mp::VMImage{}));
+    config_builder.vault = std::move(mock_image_vault);
+
+    std::vector<mp::VirtualMachineDescription> descriptions;
+    auto mock_factory = use_a_mock_vm_factory();
+    EXPECT_CALL(*mock_factory, create_virtual_machine)
+        .Times(2)
+        .WillRepeatedly([&descriptions](const mp::VirtualMachineDescription& desc, auto&) -> mp::VirtualMachine::UPtr {
+            descriptions.push_back(desc);
+            return std::make_unique<NiceMock<mpt::MockVirtualMachine>>(desc.vm_name);
+        });
+
+    mp::Daemon daemon{config_builder.build()};
+
+    std::stringstream out;
+    send_command({"clone", "source"}, out);
+
+    ASSERT_EQ(descriptions.size(), 2u);
+    EXPECT_EQ(descriptions[1].vm_name, "source-clone1");
+    EXPECT_EQ(descriptions[1].num_cores, descriptions[0].num_cores);
+    EXPECT_EQ(descriptions[1].mem_size, descriptions[0].mem_size);
+    EXPECT_NE(descriptions[1].default_mac_address, descriptions[0].default_mac_address);
+    EXPECT_THAT(out.str(), HasSubstr("Cloned source as source-clone1"));
+    EXPECT_THAT(mpt::load(filename).toStdString(), HasSubstr("\"source-clone1\""));
+}
+
+TEST_F(Daemon, clone_refuses_a_source_that_is_not_stopped)
+{
+    const auto [temp_dir, filename] =
+        plant_instance_json(fmt::format("{{{}}}", fmt::format(valid_template, "source", "10")));
+    config_builder.data_directory = temp_dir->path();
+    auto mock_image_vault = std::make_unique<NiceMock<mpt::MockVMImageVault>>();
+    EXPECT_CALL(*mock_image_vault, clone).Times(0);
+    config_builder.vault = std::move(mock_image_vault);
+
+    auto mock_factory = use_a_mock_vm_factory();
+    EXPECT_CALL(*mock_factory, create_virtual_machine)
+        .WillOnce([](const mp::VirtualMachineDescription& desc, auto&) -> mp::VirtualMachine::UPtr {
+            auto vm = std::make_unique<NiceMock<mpt::MockVirtualMachine>>(desc.vm_name);
+            EXPECT_CALL(*vm, current_state).WillRepeatedly(Return(mp::VirtualMachine::State::running));
+            return vm;
+        });
+
+    mp::Daemon daemon{config_builder.build()};
+
+    std::stringstream err;
+    send_command({"clone", "source"}, trash_stream, err);
+
+    EXPECT_THAT(err.str(), HasSubstr("instance \"source\" must be stopped to be cloned"));
+}
+
+TEST_F(Daemon, delete_is_refused_while_the_instance_is_being_cloned)
+{
+    const auto [temp_dir, filename] =
+        plant_instance_json(fmt::format("{{{}}}", fmt::format(valid_template, "source", "10")));
+    config_builder.data_directory = temp_dir->path();
+
+    // Asked to delete the source while its image is being copied
+    mp::Daemon* daemon_ptr = nullptr;
+    std::optional<grpc::Status> delete_status;
+    auto mock_image_vault = std::make_unique<NiceMock<mpt::MockVMImageVault>>();
+    EXPECT_CALL(*mock_image_vault, clone(Eq("source"), _)).WillOnce([this, &daemon_ptr, &delete_status](auto&...) {
+        mp::DeleteRequest request;
+        request.mutable_instance_names()->add_instance_name("source");
+        request.set_purge(true);
+        delete_status = call_daemon_slot(*daemon_ptr, &mp::Daemon::delet, request,
+                                         NiceMock<mpt::MockServerReaderWriter<mp::DeleteReply, mp::DeleteRequest>>{});
+        return mp::VMImage{};
+    });
+    config_builder.vault = std::move(mock_image_vault);
+
+    auto mock_factory = use_a_mock_vm_factory();
+    mp::Daemon daemon{config_builder.build()};
+    daemon_ptr = &daemon;
+
+    send_command({"clone", "source"});
+
+    ASSERT_TRUE(delete_status);
+    EXPECT_EQ(delete_status->error_code(), grpc::StatusCode::FAILED_PRECONDITION);
+    EXPECT_THAT(delete_status->error_message(), HasSubstr("Cannot delete the instance 'source' while cloning it"));
+    EXPECT_THAT(mpt::load(filename).toStdString(), HasSubstr("\"source\""));
+}
+
+TEST_F(Daemon, empties_the_trash_again_when_asked_while_at_it)
+{
+    const auto [temp_dir, filename] =
+        plant_instance_json(fmt::format("{{{}}}", fmt::format(valid_template, "trashed", "10")));
+    config_builder.data_directory = temp_dir->path();
+
+    std::promise<void> purged;
+    std::promise<void> emptied_again;
+    auto mock_image_vault = std::make_unique<NiceMock<mpt::MockVMImageVault>>();
+    EXPECT_CALL(*mock_image_vault, empty_trash())
+        .WillOnce([purged_future = purged.get_future().share()] { // the round on startup, still going through the purge
+            purged_future.wait_for(std::chrono::seconds{5});
+        })
+        .WillOnce([&emptied_again] { emptied_again.set_value(); })
+        .WillRepeatedly(Return());
+    config_builder.vault = std::move(mock_image_vault);
+
+    mp::Daemon daemon{config_builder.build()};
+
+    send_command({"delete", "--purge", "trashed"});
+    purged.set_value();
+
+    EXPECT_EQ(emptied_again.get_future().wait_for(std::chrono::seconds{5}), std::future_status::ready);
+}
+
+TEST_F(Daemon, list_looks_up_missing_release_titles_in_the_background)
+{
+    const auto [temp_dir, filename] =
+        plant_instance_json(fmt::format("{{{}}}", fmt::format(valid_template, "untitled", "10")));
+    config_builder.data_directory = temp_dir->path();
+
+    mp::VMImage image;
+    image.id = "3b2e5cbd4e8f1b9a";
+    auto mock_image_vault = std::make_unique<NiceMock<mpt::MockVMImageVault>>();
+    EXPECT_CALL(*mock_image_vault, fetch_image(_, _, _, _, _, _)).WillRepeatedly(Return(image));
+    config_builder.vault = std::move(mock_image_vault);
+
+    mp::VMImageInfo info;
+    info.release_title = "Ubuntu 24.04 LTS";
+    auto mock_image_host = std::make_unique<NiceMock<mpt::MockImageHost>>();
+    EXPECT_CALL(*mock_image_host, info_for_full_hash(Eq(image.id))).WillOnce(Return(info));
+    config_builder.image_hosts.clear();
+    config_builder.image_hosts.push_back(std::move(mock_image_host));
+
+    mp::Daemon daemon{config_builder.build()};
+
+    // The first listing does not wait for the title, those after it have it once it was looked up
+    std::stringstream first;
+    send_command({"list"}, first);
+    EXPECT_THAT(first.str(), AllOf(HasSubstr("untitled"), Not(HasSubstr("Ubuntu 24.04 LTS"))));
+
+    std::string later;
+    for (auto attempt = 0; attempt < 100 && later.find("Ubuntu 24.04 LTS") == std::string::npos; ++attempt)
+    {
+        std::this_thread::sleep_for(std::chrono::milliseconds{20});
+        std::stringstream listing;
+        send_command({"list"}, listing);
+        later = listing.str();
+    }
+
+    EXPECT_THAT(later, HasSubstr("Ubuntu 24.04 LTS"));
+}
+
+TEST_F(Daemon, looks_up_release_titles_at_idle_priority)
+{
+    const auto [temp_dir, filename] =
+        plant_instance_json(fmt::format("{{{}}}", fmt::format(valid_template, "untitled", "10")));
+    config_builder.data_directory = temp_dir->path();
+
+    mp::VMImage image;
+    image.id = "3b2e5cbd4e8f1b9a";
+    auto mock_image_vault = std::make_unique<NiceMock<mpt::MockVMImageVault>>();
+    EXPECT_CALL(*mock_image_vault, fetch_image(_, _, _, _, _, _)).WillRepeatedly(Return(image));
+    config_builder.vault = std::move(mock_image_vault);
+
+    std::promise<QThread::Priority> lookup_priority;
+    auto mock_image_host = std::make_unique<NiceMock<mpt::MockImageHost>>();
+    EXPECT_CALL(*mock_image_host, info_for_full_hash(Eq(image.id))).WillOnce([&lookup_priority](auto&) {
+        lookup_priority.set_value(QThread::currentThread()->priority());
+        return mp::VMImageInfo{};
+    });
+    config_builder.image_hosts.clear();
+    config_builder.image_hosts.push_back(std::move(mock_image_host));
+
+    mp::Daemon daemon{config_builder.build()};
+    send_command({"list"});
+
+    auto priority = lookup_priority.get_future();
+    ASSERT_EQ(priority.wait_for(std::chrono::seconds{5}), std::future_status::ready);
+    EXPECT_EQ(priority.get(), QThread::IdlePriority);
+}
+
+TEST_F(Daemon, launch_prepares_instances_while_the_global_pool_is_busy)
+{
+    auto* global_pool = QThreadPool::globalInstance();
+    const auto max_threads = global_pool->maxThreadCount();
+    auto restore_pool = sg::make_scope_guard([global_pool, max_threads]() noexcept {
+        global_pool->setMaxThreadCount(max_threads);
+    });
+
+    mpt::TempFile image_file;
+    std::promise<void> fetched;
+    auto fetched_future = fetched.get_future().share();
+    std::atomic_bool fetched_alongside_blocker{false};
+    QFuture<void> blocker;
+
+    auto mock_image_vault = std::make_unique<NiceMock<mpt::MockVMImageVault>>();
+    EXPECT_CALL(*mock_image_vault, fetch_image(_, _, _, _, _, _))
+        .WillOnce([&image_file, &fetched, &fetched_alongside_blocker, &blocker](auto&&...) {
+            fetched_alongside_blocker = blocker.isRunning();
+            fetched.set_value();
+            return mp::VMImage{image_file.name(), {}, {}, {}, {}, {}};
+        });
+    config_builder.vault = std::move(mock_image_vault);
+
+    mp::Daemon daemon{config_builder.build()};
+
+    // Takes up the only thread the global pool is left with, until the image is fetched
+    global_pool->setMaxThreadCount(1);
+    std::promise<void> blocking;
+    blocker = QtConcurrent::run([&blocking, fetched_future] {
+        blocking.set_value();
+        fetched_future.wait_for(std::chrono::seconds{5});
+    });
+    blocking.get_future().wait();
+
+    send_command({"launch"});
+    blocker.waitForFinished();
+
+    EXPECT_TRUE(fetched_alongside_blocker);
+}
 } // namespace
@@ -47,6 +47,8 @@ struct DaemonFind : public mpt::DaemonTestFixture
         EXPECT_CALL(mock_settings, register_handler).WillRepeatedly(Return(nullptr));
         EXPECT_CALL(mock_settings, unregister_handler).Times(AnyNumber());
         EXPECT_CALL(mock_settings, get(Eq(mp::winterm_key))).WillRepeatedly(Return("none"));
+        EXPECT_CALL(mock_settings, get(Eq(mp::ksm_key))).WillRepeatedly(Return("host"));
+        EXPECT_CALL(mock_settings, get(Eq(mp::ksm_pages_to_scan_key))).WillRepeatedly(Return("100"));
     }
 
     mpt::MockPlatform::GuardedMock attr{mpt::MockPlatform::inject<NiceMock>()};
@@ -250,3 +252,45 @@ TEST_F(DaemonFind, invalidRemoteNameAndNonEmptySearchString)
     EXPECT_THAT(cerr_Stream.str(), HasSubstr(error_msg));
     EXPECT_EQ(total_lines_of_output(cerr_Stream), 1);
 }
+
+TEST_F(DaemonFind, filtersByAliasPrefixAndReleaseRange)
+{
+    config_builder.image_hosts.clear();
+    config_builder.image_hosts.push_back(std::make_unique<NiceMock<mpt::MockImageHost>>());
+    mp::Daemon daemon{config_builder.build()};
+
+    std::stringstream prefixed_stream;
+    send_command({"find", "--only-images", "--alias-prefix", "an"}, prefixed_stream);
+    EXPECT_THAT(prefixed_stream.str(), AllOf(HasSubstr(mpt::another_alias), Not(HasSubstr(mpt::default_alias)),
+                                             Not(HasSubstr(mpt::snapcraft_alias))));
+
+    std::stringstream ranged_stream;
+    send_command({"find", "--only-images", "--min-release", "18.04", "--max-release", "20.04"}, ranged_stream);
+    EXPECT_THAT(ranged_stream.str(), AllOf(HasSubstr(mpt::default_alias), Not(HasSubstr(mpt::another_alias)),
+                                           Not(HasSubstr(mpt::snapcraft_alias))));
+}
+
+TEST_F(DaemonFind, streamsEverythingFoundInChunks)
+{
+    constexpr auto num_images = 100;
+    auto mock_image_host = std::make_unique<NiceMock<mpt::MockImageHost>>();
+    EXPECT_CALL(*mock_image_host, for_each_entry_do(_)).WillRepeatedly([&host = *mock_image_host](const auto& action) {
+        for (auto i = 0; i < num_images; ++i)
+        {
+            auto info = host.mock_bionic_image_info;
+            info.aliases = QStringList{QString{"alias%1"}.arg(i)};
+            info.release_title = QString{"Release %1"}.arg(i);
+            action(mpt::release_remote, info);
+        }
+    });
+
+    config_builder.image_hosts.clear();
+    config_builder.image_hosts.push_back(std::move(mock_image_host));
+    mp::Daemon daemon{config_builder.build()};
+
+    std::stringstream stream;
+    send_command({"find", "--only-images", "--format", "csv"}, stream);
+
+    EXPECT_THAT(stream.str(), AllOf(HasSubstr("alias0,"), HasSubstr("alias99,")));
+    EXPECT_EQ(total_lines_of_output(stream), num_images + 1);
+}
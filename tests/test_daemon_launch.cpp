@@ -18,6 +18,7 @@
 #include "blueprint_test_lambdas.h"
 #include "common.h"
 #include "daemon_test_fixture.h"
+#include "file_operations.h"
 #include "mock_image_host.h"
 #include "mock_platform.h"
 #include "mock_server_reader_writer.h"
@@ -33,6 +34,8 @@
 #include <multipass/constants.h>
 #include <multipass/format.h>
 
+#include <mutex>
+
 namespace mp = multipass;
 namespace mpt = multipass::test;
 using namespace testing;
@@ -44,6 +47,13 @@ struct TestDaemonLaunch : public mpt::DaemonTestFixture
         EXPECT_CALL(mock_settings, register_handler).WillRepeatedly(Return(nullptr));
         EXPECT_CALL(mock_settings, unregister_handler).Times(AnyNumber());
         EXPECT_CALL(mock_settings, get(Eq(mp::mounts_key))).WillRepeatedly(Return("true"));
+        EXPECT_CALL(mock_settings, get(AnyOf(Eq(mp::cpu_overcommit_key), Eq(mp::memory_overcommit_key),
+                                             Eq(mp::disk_overcommit_key))))
+            .WillRepeatedly(Return("0"));
+        EXPECT_CALL(mock_settings, get(Eq(mp::placement_key))).WillRepeatedly(Return("none"));
+        EXPECT_CALL(mock_settings, get(Eq(mp::image_cache_size_key))).WillRepeatedly(Return(""));
+        EXPECT_CALL(mock_settings, get(Eq(mp::ksm_key))).WillRepeatedly(Return("host"));
+        EXPECT_CALL(mock_settings, get(Eq(mp::ksm_pages_to_scan_key))).WillRepeatedly(Return("100"));
     }
 
     mpt::MockPlatform::GuardedMock attr{mpt::MockPlatform::inject<NiceMock>()};
@@ -155,3 +165,111 @@ TEST_F(TestDaemonLaunch, v2BlueprintFoundPropagatesSha)
 
     auto status = call_daemon_slot(daemon, &mp::Daemon::launch, request, writer);
 }
+
+TEST_F(TestDaemonLaunch, reportsHowLongEachStageTook)
+{
+    mp::Daemon daemon{config_builder.build()};
+
+    std::vector<std::string> stages;
+    StrictMock<mpt::MockServerReaderWriter<mp::LaunchReply, mp::LaunchRequest>> writer{};
+    EXPECT_CALL(writer, Write(_, _)).WillRepeatedly([&stages](const mp::LaunchReply& written_reply, auto) -> bool {
+        for (const auto& timing : written_reply.stage_timings())
+            stages.push_back(timing.stage());
+        return true;
+    });
+
+    EXPECT_TRUE(call_daemon_slot(daemon, &mp::Daemon::launch, mp::LaunchRequest{}, writer).ok());
+    EXPECT_THAT(stages, ElementsAre("blueprint", "image", "networking", "configuration", "instance image"));
+}
+
+TEST_F(TestDaemonLaunch, takesAWarmInstanceWhenNothingInParticularIsAskedFor)
+{
+    auto contents = fake_json_contents("52:54:00:73:76:28", {});
+    contents.insert(contents.find("\"deleted\""), "\"warm\": true,\n        ");
+    const auto [temp_dir, filename] = plant_instance_json(contents);
+    config_builder.data_directory = temp_dir->path();
+    config_builder.vault = std::make_unique<NiceMock<mpt::MockVMImageVault>>();
+
+    auto mock_factory = use_a_mock_vm_factory();
+    EXPECT_CALL(*mock_factory, create_virtual_machine).Times(1); // when loading it, but not when launching
+    mp::Daemon daemon{config_builder.build()};
+
+    std::string launched;
+    StrictMock<mpt::MockServerReaderWriter<mp::LaunchReply, mp::LaunchRequest>> writer{};
+    EXPECT_CALL(writer, Write(_, _)).WillRepeatedly([&launched](const mp::LaunchReply& written_reply, auto) -> bool {
+        if (!written_reply.vm_instance_name().empty())
+            launched = written_reply.vm_instance_name();
+        return true;
+    });
+
+    EXPECT_TRUE(call_daemon_slot(daemon, &mp::Daemon::launch, mp::LaunchRequest{}, writer).ok());
+    EXPECT_EQ(launched, "real-zebraphant");
+    EXPECT_THAT(mpt::load(filename).toStdString(), Not(HasSubstr("\"warm\"")));
+}
+
+TEST_F(TestDaemonLaunch, takesNoWarmInstancePastTheOvercommitRatios)
+{
+    auto contents = fake_json_contents("52:54:00:73:76:28", {});
+    contents.insert(contents.find("\"deleted\""), "\"warm\": true,\n        ");
+    const auto [temp_dir, filename] = plant_instance_json(contents);
+    config_builder.data_directory = temp_dir->path();
+    config_builder.vault = std::make_unique<NiceMock<mpt::MockVMImageVault>>();
+
+    auto mock_factory = use_a_mock_vm_factory();
+    mp::Daemon daemon{config_builder.build()};
+
+    EXPECT_CALL(*mock_platform, host_capacity(_))
+        .WillRepeatedly(Return(mp::platform::HostCapacity{1, mp::MemorySize{"4G"}.in_bytes(), 0}));
+    EXPECT_CALL(mock_settings, get(Eq(mp::cpu_overcommit_key))).WillRepeatedly(Return("0.5"));
+
+    StrictMock<mpt::MockServerReaderWriter<mp::LaunchReply, mp::LaunchRequest>> writer{};
+    EXPECT_CALL(writer, Write(_, _)).Times(0);
+
+    const auto status = call_daemon_slot(daemon, &mp::Daemon::launch, mp::LaunchRequest{}, writer);
+    EXPECT_EQ(status.error_code(), grpc::StatusCode::RESOURCE_EXHAUSTED);
+    EXPECT_THAT(status.error_message(), HasSubstr("vCPUs would be committed"));
+    EXPECT_THAT(mpt::load(filename).toStdString(), HasSubstr("\"warm\""));
+}
+
+TEST_F(TestDaemonLaunch, launchesAsManyInstancesAsCountedAfterTheNamePattern)
+{
+    mp::Daemon daemon{config_builder.build()};
+
+    std::mutex written_mutex;
+    std::vector<std::string> launched, marked;
+    StrictMock<mpt::MockServerReaderWriter<mp::LaunchReply, mp::LaunchRequest>> writer{};
+    EXPECT_CALL(writer, Write(_, _))
+        .WillRepeatedly([&written_mutex, &launched, &marked](const mp::LaunchReply& written_reply, auto) -> bool {
+            std::lock_guard lock{written_mutex};
+            if (!written_reply.vm_instance_name().empty())
+            {
+                launched.push_back(written_reply.vm_instance_name());
+                marked.push_back(written_reply.batch_instance());
+            }
+            return true;
+        });
+
+    mp::LaunchRequest request;
+    request.set_instance_name("node-{}");
+    request.set_count(3);
+
+    EXPECT_TRUE(call_daemon_slot(daemon, &mp::Daemon::launch, request, writer).ok());
+    EXPECT_THAT(launched, UnorderedElementsAre("node-1", "node-2", "node-3"));
+    EXPECT_THAT(marked, UnorderedElementsAreArray(launched));
+}
+
+TEST_F(TestDaemonLaunch, tellsWhichInstancesOfABatchFailed)
+{
+    mp::Daemon daemon{config_builder.build()};
+
+    NiceMock<mpt::MockServerReaderWriter<mp::LaunchReply, mp::LaunchRequest>> writer{};
+
+    mp::LaunchRequest request;
+    request.set_instance_name("bad_{}_name");
+    request.set_count(2);
+
+    auto status = call_daemon_slot(daemon, &mp::Daemon::launch, request, writer);
+    EXPECT_FALSE(status.ok());
+    EXPECT_THAT(status.error_message(), HasSubstr("2 of 2 instances failed to launch"));
+    EXPECT_THAT(status.error_message(), HasSubstr("bad_1_name"));
+}
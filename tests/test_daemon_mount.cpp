@@ -127,6 +127,30 @@ TEST_F(TestDaemonMount, invalidTargetPathFails)
     EXPECT_THAT(status.error_message(), HasSubstr(fmt::format("unable to mount to \"{}\"", invalid_path)));
 }
 
+TEST_F(TestDaemonMount, unknownMountProfileFails)
+{
+    const auto [temp_dir, _] = plant_instance_json(fake_json_contents(mac_addr, extra_interfaces));
+    config_builder.data_directory = temp_dir->path();
+
+    EXPECT_CALL(*mock_factory, create_virtual_machine)
+        .WillOnce(Return(std::make_unique<NiceMock<mpt::MockVirtualMachine>>(mock_instance_name)));
+
+    mp::Daemon daemon{config_builder.build()};
+
+    mp::MountRequest request;
+    request.set_source_path(mount_dir.path().toStdString());
+    request.set_mount_profile("fastest");
+    auto entry = request.add_target_paths();
+    entry->set_instance_name(mock_instance_name);
+    entry->set_target_path(fake_target_path);
+
+    auto status = call_daemon_slot(daemon, &mp::Daemon::mount, request,
+                                   StrictMock<mpt::MockServerReaderWriter<mp::MountReply, mp::MountRequest>>{});
+
+    EXPECT_EQ(status.error_code(), grpc::StatusCode::INVALID_ARGUMENT);
+    EXPECT_THAT(status.error_message(), HasSubstr("unknown mount profile \"fastest\""));
+}
+
 TEST_F(TestDaemonMount, mountIgnoresTrailingSlash)
 {
     const auto [temp_dir, _] = plant_instance_json(fake_json_contents(mac_addr, extra_interfaces));
@@ -30,6 +30,11 @@
 #include <multipass/constants.h>
 #include <multipass/format.h>
 
+#include <QCoreApplication>
+
+#include <atomic>
+#include <chrono>
+
 namespace mp = multipass;
 namespace mpt = multipass::test;
 using namespace testing;
@@ -41,6 +46,8 @@ struct TestDaemonStart : public mpt::DaemonTestFixture
         EXPECT_CALL(mock_settings, register_handler).WillRepeatedly(Return(nullptr));
         EXPECT_CALL(mock_settings, unregister_handler).Times(AnyNumber());
         EXPECT_CALL(mock_settings, get(Eq(mp::mounts_key))).WillRepeatedly(Return("true"));
+        EXPECT_CALL(mock_settings, get(Eq(mp::ksm_key))).WillRepeatedly(Return("host"));
+        EXPECT_CALL(mock_settings, get(Eq(mp::ksm_pages_to_scan_key))).WillRepeatedly(Return("100"));
     }
 
     const std::string mock_instance_name{"real-zebraphant"};
@@ -173,6 +180,46 @@ TEST_F(TestDaemonStart, definedMountsInitializedDuringStart)
     EXPECT_TRUE(status.ok());
 }
 
+TEST_F(TestDaemonStart, allDefinedMountsActivatedDuringStart)
+{
+    std::unordered_map<std::string, mp::VMMount> mounts;
+    for (auto i = 0; i < 10; ++i)
+        mounts.emplace(fmt::format("/home/luke/skywalker{}", i),
+                       mp::VMMount{"/home/han/solo", {}, {}, mp::VMMount::MountType::Native});
+
+    auto mock_factory = use_a_mock_vm_factory();
+    const auto [temp_dir, filename] = plant_instance_json(fake_json_contents(mac_addr, extra_interfaces, mounts));
+
+    std::atomic_int activated{0};
+    auto mock_vm = std::make_unique<NiceMock<mpt::MockVirtualMachine>>(mock_instance_name);
+    EXPECT_CALL(*mock_vm, wait_until_ssh_up).WillRepeatedly(Return());
+    EXPECT_CALL(*mock_vm, current_state).WillRepeatedly(Return(mp::VirtualMachine::State::off));
+    EXPECT_CALL(*mock_vm, start).Times(1);
+    EXPECT_CALL(*mock_vm, make_native_mount_handler)
+        .Times(10)
+        .WillRepeatedly([&activated](auto...) -> mp::MountHandler::UPtr {
+            auto mock_mount_handler = std::make_unique<mpt::MockMountHandler>();
+            EXPECT_CALL(*mock_mount_handler, activate_impl).WillOnce([&activated](auto...) { ++activated; });
+            return mock_mount_handler;
+        });
+
+    EXPECT_CALL(*mock_factory, create_virtual_machine).WillOnce(Return(std::move(mock_vm)));
+
+    config_builder.data_directory = temp_dir->path();
+    config_builder.vault = std::make_unique<NiceMock<mpt::MockVMImageVault>>();
+
+    mp::Daemon daemon{config_builder.build()};
+
+    mp::StartRequest request;
+    request.mutable_instance_names()->add_instance_name(mock_instance_name);
+
+    auto status = call_daemon_slot(daemon, &mp::Daemon::start, request,
+                                   StrictMock<mpt::MockServerReaderWriter<mp::StartReply, mp::StartRequest>>{});
+
+    EXPECT_TRUE(status.ok());
+    EXPECT_EQ(activated, 10);
+}
+
 TEST_F(TestDaemonStart, removingMountOnFailedStart)
 {
     const std::string fake_target_path{"/home/luke/skywalker"}, fake_source_path{"/home/han/solo"};
@@ -210,3 +257,34 @@ TEST_F(TestDaemonStart, removingMountOnFailedStart)
     auto status = call_daemon_slot(daemon, &mp::Daemon::start, request, std::move(server));
     EXPECT_TRUE(status.ok());
 }
+
+TEST_F(TestDaemonStart, previouslyRunningInstanceIsStartedAfterConstruction)
+{
+    auto mock_factory = use_a_mock_vm_factory();
+    auto json = fake_json_contents(mac_addr, extra_interfaces);
+    json.replace(json.find("\"state\": 2"), 10, "\"state\": 4");
+    const auto [temp_dir, filename] = plant_instance_json(json);
+
+    std::atomic_bool started{false}, ready{false};
+    auto mock_vm = std::make_unique<NiceMock<mpt::MockVirtualMachine>>(mock_instance_name);
+    EXPECT_CALL(*mock_vm, wait_until_ssh_up).WillRepeatedly(Return());
+    EXPECT_CALL(*mock_vm, current_state).WillRepeatedly(Return(mp::VirtualMachine::State::off));
+    EXPECT_CALL(*mock_vm, start).WillOnce([&started] { started = true; });
+    EXPECT_CALL(*mock_vm, update_state).WillRepeatedly([&ready] { ready = true; });
+
+    EXPECT_CALL(*mock_factory, create_virtual_machine).WillOnce(Return(std::move(mock_vm)));
+
+    config_builder.data_directory = temp_dir->path();
+    config_builder.vault = std::make_unique<NiceMock<mpt::MockVMImageVault>>();
+
+    mp::Daemon daemon{config_builder.build()};
+    EXPECT_FALSE(started);
+
+    // Once waited for like any other start, which must be over before the daemon goes
+    for (const auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(5);
+         !ready && std::chrono::steady_clock::now() < deadline;)
+        QCoreApplication::processEvents(QEventLoop::AllEvents, 10);
+
+    EXPECT_TRUE(started);
+    EXPECT_TRUE(ready);
+}
@@ -110,6 +110,29 @@ TEST_F(FileOps, status)
     EXPECT_FALSE(err);
 }
 
+TEST_F(FileOps, file_size)
+{
+    std::ofstream{temp_file} << "0123456789";
+
+    EXPECT_EQ(MP_FILEOPS.file_size(temp_file, err), 10u);
+    EXPECT_FALSE(err);
+    MP_FILEOPS.file_size(temp_dir / "nonexistent", err);
+    EXPECT_TRUE(err);
+}
+
+TEST_F(FileOps, last_write_time)
+{
+    const auto time = MP_FILEOPS.last_write_time(temp_file, err) - std::chrono::hours{1};
+    EXPECT_FALSE(err);
+
+    MP_FILEOPS.last_write_time(temp_file, time, err);
+    EXPECT_FALSE(err);
+    EXPECT_EQ(MP_FILEOPS.last_write_time(temp_file, err), time);
+
+    MP_FILEOPS.last_write_time(temp_dir / "nonexistent", err);
+    EXPECT_TRUE(err);
+}
+
 TEST_F(FileOps, dir_iter)
 {
     MP_FILEOPS.recursive_dir_iterator(temp_dir, err);
@@ -125,3 +148,19 @@ TEST_F(FileOps, create_directories)
     EXPECT_FALSE(MP_FILEOPS.create_directories(temp_dir / "subdir/nested", err));
     EXPECT_FALSE(err);
 }
+
+TEST_F(FileOps, read_at)
+{
+    std::ofstream{temp_file} << "0123456789";
+
+    QFile file{QString::fromStdString(temp_file.string())};
+    ASSERT_TRUE(file.open(QIODevice::ReadOnly));
+
+    char data[4]{};
+    EXPECT_EQ(MP_FILEOPS.read_at(file, data, 4, 3), 4);
+    EXPECT_EQ(std::string(data, 4), "3456");
+    EXPECT_EQ(file.pos(), 0);
+
+    EXPECT_EQ(MP_FILEOPS.read_at(file, data, 4, 8), 2);
+    EXPECT_EQ(MP_FILEOPS.read_at(file, data, 4, 10), 0);
+}
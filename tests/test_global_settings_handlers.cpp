@@ -140,7 +140,11 @@ TEST_F(TestGlobalSettingsHandlers, clientsRegisterPersistentHandlerForClientSett
 
     inject_default_returning_mock_qsettings();
 
-    expect_setting_values({{mp::petenv_key, "primary"}, {mp::autostart_key, "true"}});
+    expect_setting_values({{mp::petenv_key, "primary"},
+                           {mp::autostart_key, "true"},
+                           {mp::ssh_control_persist_key, "0"},
+                           {mp::rpc_compression_key, "true"},
+                           {mp::rpc_keepalive_key, "60"}});
     EXPECT_EQ(QKeySequence{handler->get(mp::hotkey_key)}, QKeySequence{mp::hotkey_default});
 }
 
@@ -193,6 +197,44 @@ TEST_F(TestGlobalSettingsHandlers, clientsRegisterHandlerThatAcceptsBoolAutostar
     ASSERT_NO_THROW(handler->set(mp::autostart_key, "0"));
 }
 
+TEST_F(TestGlobalSettingsHandlers, clientsRegisterHandlerThatAcceptsControlPersistSeconds)
+{
+    mp::client::register_global_settings_handlers();
+
+    EXPECT_CALL(*mock_qsettings, setValue(Eq(mp::ssh_control_persist_key), Eq("600")));
+    inject_mock_qsettings();
+
+    ASSERT_NO_THROW(handler->set(mp::ssh_control_persist_key, "600"));
+}
+
+TEST_F(TestGlobalSettingsHandlers, clientsRegisterHandlerThatRejectsBadControlPersist)
+{
+    mp::client::register_global_settings_handlers();
+
+    for (const auto* val : {"-1", "ten", ""})
+        MP_ASSERT_THROW_THAT(handler->set(mp::ssh_control_persist_key, val), mp::InvalidSettingException,
+                             mpt::match_what(HasSubstr(mp::ssh_control_persist_key)));
+}
+
+TEST_F(TestGlobalSettingsHandlers, clientsRegisterHandlerThatAcceptsKeepaliveSeconds)
+{
+    mp::client::register_global_settings_handlers();
+
+    EXPECT_CALL(*mock_qsettings, setValue(Eq(mp::rpc_keepalive_key), Eq("0")));
+    inject_mock_qsettings();
+
+    ASSERT_NO_THROW(handler->set(mp::rpc_keepalive_key, "0"));
+}
+
+TEST_F(TestGlobalSettingsHandlers, clientsRegisterHandlerThatRejectsBadKeepalive)
+{
+    mp::client::register_global_settings_handlers();
+
+    for (const auto* val : {"-5", "a minute", ""})
+        MP_ASSERT_THROW_THAT(handler->set(mp::rpc_keepalive_key, val), mp::InvalidSettingException,
+                             mpt::match_what(HasSubstr(mp::rpc_keepalive_key)));
+}
+
 struct TestGoodPetEnvSetting : public TestGlobalSettingsHandlers, WithParamInterface<const char*>
 {
 };
@@ -328,6 +370,90 @@ TEST_F(TestGlobalSettingsHandlers, daemonRegistersHandlerThatAcceptsBrigedInterf
     ASSERT_NO_THROW(handler->set(mp::bridged_interface_key, val));
 }
 
+TEST_F(TestGlobalSettingsHandlers, daemonRegistersHandlerThatNormalizesImagePeers)
+{
+    mp::daemon::register_global_settings_handlers();
+
+    EXPECT_CALL(*mock_qsettings, setValue(Eq(mp::image_peers_key), Eq("http://lab-1:8080/,https://lab-2/")));
+    inject_mock_qsettings();
+
+    ASSERT_NO_THROW(handler->set(mp::image_peers_key, "http://lab-1:8080, https://lab-2/"));
+}
+
+TEST_F(TestGlobalSettingsHandlers, daemonRegistersHandlerThatRejectsImagePeersWithoutProtocol)
+{
+    mp::daemon::register_global_settings_handlers();
+
+    MP_ASSERT_THROW_THAT(handler->set(mp::image_peers_key, "http://lab-1:8080,lab-2"), mp::InvalidSettingException,
+                         mpt::match_what(HasSubstr(mp::image_peers_key)));
+}
+
+TEST_F(TestGlobalSettingsHandlers, daemonRegistersHandlerThatRejectsBadImageSharePort)
+{
+    mp::daemon::register_global_settings_handlers();
+
+    for (const auto* val : {"0", "65536", "http"})
+        MP_ASSERT_THROW_THAT(handler->set(mp::image_share_port_key, val), mp::InvalidSettingException,
+                             mpt::match_what(HasSubstr(mp::image_share_port_key)));
+}
+
+TEST_F(TestGlobalSettingsHandlers, daemonRegistersHandlerThatRejectsBadImageCacheSize)
+{
+    mp::daemon::register_global_settings_handlers();
+
+    for (const auto* val : {"-1G", "lots", "10X"})
+        MP_ASSERT_THROW_THAT(handler->set(mp::image_cache_size_key, val), mp::InvalidSettingException,
+                             mpt::match_what(HasSubstr(mp::image_cache_size_key)));
+}
+
+TEST_F(TestGlobalSettingsHandlers, daemonRegistersHandlersThatRejectBadKsmSettings)
+{
+    mp::daemon::register_global_settings_handlers();
+
+    for (const auto* val : {"", "yes", "auto"})
+        MP_ASSERT_THROW_THAT(handler->set(mp::ksm_key, val), mp::InvalidSettingException,
+                             mpt::match_what(HasSubstr(mp::ksm_key)));
+    for (const auto* val : {"0", "-100", "lots"})
+        MP_ASSERT_THROW_THAT(handler->set(mp::ksm_pages_to_scan_key, val), mp::InvalidSettingException,
+                             mpt::match_what(HasSubstr(mp::ksm_pages_to_scan_key)));
+}
+
+TEST_F(TestGlobalSettingsHandlers, daemonRegistersHandlerThatRejectsBadImageCompression)
+{
+    mp::daemon::register_global_settings_handlers();
+
+    for (const auto* val : {"", "xz", "ZSTD"})
+        MP_ASSERT_THROW_THAT(handler->set(mp::image_compression_key, val), mp::InvalidSettingException,
+                             mpt::match_what(HasSubstr(mp::image_compression_key)));
+}
+
+TEST_F(TestGlobalSettingsHandlers, daemonRegistersHandlerThatSharesImagesOnLoopbackByDefault)
+{
+    mp::daemon::register_global_settings_handlers();
+
+    inject_default_returning_mock_qsettings();
+    expect_setting_values({{mp::image_share_address_key, "127.0.0.1"}});
+}
+
+TEST_F(TestGlobalSettingsHandlers, daemonRegistersHandlerThatAcceptsImageShareAddress)
+{
+    mp::daemon::register_global_settings_handlers();
+
+    EXPECT_CALL(*mock_qsettings, setValue(Eq(mp::image_share_address_key), Eq("10.1.2.3")));
+    inject_mock_qsettings();
+
+    ASSERT_NO_THROW(handler->set(mp::image_share_address_key, " 10.1.2.3"));
+}
+
+TEST_F(TestGlobalSettingsHandlers, daemonRegistersHandlerThatRejectsImageShareAddressOfAnyInterface)
+{
+    mp::daemon::register_global_settings_handlers();
+
+    for (const auto* val : {"0.0.0.0", "::", "lab-1", ""})
+        MP_ASSERT_THROW_THAT(handler->set(mp::image_share_address_key, val), mp::InvalidSettingException,
+                             mpt::match_what(HasSubstr(mp::image_share_address_key)));
+}
+
 TEST_F(TestGlobalSettingsHandlers, daemonRegistersHandlerThatHashesNonEmptyPassword)
 {
     const auto val = "correct horse battery staple";
@@ -0,0 +1,80 @@
+/*
+ * Copyright (C) Canonical, Ltd.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; version 3.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#include "common.h"
+
+#include <src/daemon/idle_monitor.h>
+
+namespace mp = multipass;
+
+using namespace std::chrono_literals;
+using namespace testing;
+
+namespace
+{
+struct IdleMonitor : public Test
+{
+    mp::VirtualMachine::HostStats stats_with(std::uint64_t cpu_time_ns, std::uint64_t network_bytes = 0)
+    {
+        mp::VirtualMachine::HostStats stats;
+        stats.cpu_time_ns = cpu_time_ns;
+        stats.network_received_bytes = network_bytes;
+        return stats;
+    }
+
+    mp::IdleMonitor monitor;
+    const mp::IdleMonitor::Clock::time_point start{};
+};
+} // namespace
+
+TEST_F(IdleMonitor, tells_instances_idle_once_past_the_limit)
+{
+    EXPECT_FALSE(monitor.idle_for("foo", stats_with(1'000'000'000), 2min, start));
+    EXPECT_FALSE(monitor.idle_for("foo", stats_with(1'100'000'000), 2min, start + 1min));
+    EXPECT_TRUE(monitor.idle_for("foo", stats_with(1'200'000'000), 2min, start + 2min));
+}
+
+TEST_F(IdleMonitor, busy_cpus_start_the_count_over)
+{
+    monitor.idle_for("foo", stats_with(0), 2min, start);
+    monitor.idle_for("foo", stats_with(0), 2min, start + 1min);
+    EXPECT_FALSE(monitor.idle_for("foo", stats_with(30'000'000'000), 2min, start + 2min));
+    EXPECT_FALSE(monitor.idle_for("foo", stats_with(30'000'000'000), 2min, start + 3min));
+    EXPECT_TRUE(monitor.idle_for("foo", stats_with(30'000'000'000), 2min, start + 4min));
+}
+
+TEST_F(IdleMonitor, network_traffic_starts_the_count_over)
+{
+    monitor.idle_for("foo", stats_with(0, 0), 1min, start);
+    EXPECT_FALSE(monitor.idle_for("foo", stats_with(0, 10 * 1024 * 1024), 1min, start + 1min));
+    EXPECT_TRUE(monitor.idle_for("foo", stats_with(0, 10 * 1024 * 1024), 1min, start + 2min));
+}
+
+TEST_F(IdleMonitor, being_touched_starts_the_count_over)
+{
+    monitor.idle_for("foo", stats_with(0), 2min, start);
+    monitor.touch("foo", start + 1min);
+    EXPECT_FALSE(monitor.idle_for("foo", stats_with(0), 2min, start + 2min));
+    EXPECT_TRUE(monitor.idle_for("foo", stats_with(0), 2min, start + 3min));
+}
+
+TEST_F(IdleMonitor, counts_anew_for_forgotten_instances)
+{
+    monitor.idle_for("foo", stats_with(0), 1min, start);
+    monitor.forget("foo");
+    EXPECT_FALSE(monitor.idle_for("foo", stats_with(0), 1min, start + 5min));
+}
@@ -0,0 +1,244 @@
+/*
+ * Copyright (C) Canonical, Ltd.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; version 3.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#include "common.h"
+#include "path.h"
+#include "temp_dir.h"
+
+#include <multipass/image_decoder.h>
+
+#include <QFile>
+
+#include <algorithm>
+#include <memory>
+#include <stdexcept>
+
+#include <zlib.h>
+#include <zstd.h>
+
+namespace mp = multipass;
+namespace mpd = multipass::decoding;
+namespace mpt = multipass::test;
+
+using namespace testing;
+
+namespace
+{
+struct ImageDecoder : public Test
+{
+    // Same as what the xz test images hold
+    static QByteArray expected_content()
+    {
+        QByteArray content;
+        for (auto i = 0; i < 300000; ++i)
+            content.append(char((i * 7 + i / 100) % 256));
+
+        return content;
+    }
+
+    static QByteArray zstd(const QByteArray& data, bool with_content_size = true)
+    {
+        std::unique_ptr<ZSTD_CCtx, decltype(ZSTD_freeCCtx)*> context{ZSTD_createCCtx(), ZSTD_freeCCtx};
+        ZSTD_CCtx_setParameter(context.get(), ZSTD_c_contentSizeFlag, with_content_size);
+
+        QByteArray compressed(ZSTD_compressBound(data.size()), '\0');
+        const auto size =
+            ZSTD_compress2(context.get(), compressed.data(), compressed.size(), data.constData(), data.size());
+        EXPECT_FALSE(ZSTD_isError(size));
+
+        return compressed.left(size);
+    }
+
+    static QByteArray gzip(const QByteArray& data)
+    {
+        z_stream stream{};
+        EXPECT_EQ(deflateInit2(&stream, Z_DEFAULT_COMPRESSION, Z_DEFLATED, 16 + MAX_WBITS, 8, Z_DEFAULT_STRATEGY),
+                  Z_OK);
+
+        QByteArray compressed(deflateBound(&stream, data.size()), '\0');
+        stream.next_in = reinterpret_cast<Bytef*>(const_cast<char*>(data.constData()));
+        stream.avail_in = data.size();
+        stream.next_out = reinterpret_cast<Bytef*>(compressed.data());
+        stream.avail_out = compressed.size();
+        EXPECT_EQ(deflate(&stream, Z_FINISH), Z_STREAM_END);
+        deflateEnd(&stream);
+
+        return compressed.left(stream.total_out);
+    }
+
+    QString write(const QString& name, const QByteArray& data)
+    {
+        const auto path = temp_dir.path() + "/" + name;
+        QFile file{path};
+        EXPECT_TRUE(file.open(QIODevice::WriteOnly));
+        EXPECT_EQ(file.write(data), data.size());
+
+        return path;
+    }
+
+    QByteArray decoded_content()
+    {
+        QFile decoded_file{decoded_file_path};
+        EXPECT_TRUE(decoded_file.open(QIODevice::ReadOnly));
+
+        return decoded_file.readAll();
+    }
+
+    void decode(const QString& path)
+    {
+        auto last_progress = -1;
+        mpd::make_decoder(path)->decode_to(decoded_file_path, [&last_progress](int, int progress) {
+            EXPECT_GE(progress, last_progress);
+            last_progress = progress;
+            return true;
+        });
+
+        EXPECT_EQ(last_progress, 100);
+    }
+
+    void stream(const QByteArray& data, std::size_t chunk_size)
+    {
+        const auto decoder = mpd::make_stream_decoder(decoded_file_path);
+        for (auto pos = 0; pos < data.size(); pos += chunk_size)
+            decoder->decode(data.constData() + pos, std::min<std::size_t>(chunk_size, data.size() - pos));
+        decoder->finish();
+    }
+
+    mpt::TempDir temp_dir;
+    const QString decoded_file_path{temp_dir.path() + "/image.img"};
+    const QByteArray content{expected_content()};
+};
+} // namespace
+
+TEST_F(ImageDecoder, tells_codecs_apart_by_their_magic)
+{
+    EXPECT_EQ(mpd::codec_of(zstd(content).left(mpd::magic_size)), mpd::Codec::zstd);
+    EXPECT_EQ(mpd::codec_of(gzip(content).left(mpd::magic_size)), mpd::Codec::gzip);
+    EXPECT_EQ(mpd::codec_of(QByteArray::fromHex("fd377a585a00")), mpd::Codec::xz);
+    EXPECT_EQ(mpd::codec_of(QByteArray::fromHex("514649fb0000")), mpd::Codec::raw);
+    EXPECT_EQ(mpd::codec_of(QByteArray{}), mpd::Codec::raw);
+}
+
+TEST_F(ImageDecoder, strips_compressed_suffixes)
+{
+    EXPECT_TRUE(mpd::is_compressed("/images/disk.img.zst"));
+    EXPECT_TRUE(mpd::is_compressed("/images/disk.img.gz"));
+    EXPECT_TRUE(mpd::is_compressed("/images/disk.img.xz"));
+    EXPECT_FALSE(mpd::is_compressed("/images/disk.img"));
+
+    EXPECT_EQ(mpd::decoded_path_for("/images/disk.img.zst"), "/images/disk.img");
+    EXPECT_EQ(mpd::decoded_path_for("/images/disk.img.gz"), "/images/disk.img");
+    EXPECT_EQ(mpd::decoded_path_for("/images/disk.img"), "/images/disk.img");
+}
+
+TEST_F(ImageDecoder, decodes_zstd_image)
+{
+    decode(write("image.img.zst", zstd(content)));
+
+    EXPECT_EQ(decoded_content(), content);
+}
+
+TEST_F(ImageDecoder, decodes_zstd_image_in_frames)
+{
+    const auto half = content.size() / 2;
+    decode(write("image.img.zst", zstd(content.left(half)) + zstd(content.mid(half))));
+
+    EXPECT_EQ(decoded_content(), content);
+}
+
+TEST_F(ImageDecoder, decodes_zstd_image_with_frames_of_unknown_size)
+{
+    const auto half = content.size() / 2;
+    decode(write("image.img.zst", zstd(content.left(half), false) + zstd(content.mid(half), false)));
+
+    EXPECT_EQ(decoded_content(), content);
+}
+
+TEST_F(ImageDecoder, fails_on_truncated_zstd_image)
+{
+    const auto compressed = zstd(content);
+    const auto path = write("image.img.zst", compressed.left(compressed.size() - 16));
+
+    EXPECT_THROW(mpd::make_decoder(path)->decode_to(decoded_file_path, [](auto...) { return true; }),
+                 std::runtime_error);
+}
+
+TEST_F(ImageDecoder, decodes_gzip_image)
+{
+    decode(write("image.img.gz", gzip(content)));
+
+    EXPECT_EQ(decoded_content(), content);
+}
+
+TEST_F(ImageDecoder, decodes_xz_image_whatever_its_suffix)
+{
+    QFile xz_file{mpt::test_data_path_for("single_block.img.xz")};
+    ASSERT_TRUE(xz_file.open(QIODevice::ReadOnly));
+    decode(write("image.img.zst", xz_file.readAll()));
+
+    EXPECT_EQ(decoded_content(), content);
+}
+
+TEST_F(ImageDecoder, copies_raw_image)
+{
+    decode(write("image.img.gz", content));
+
+    EXPECT_EQ(decoded_content(), content);
+}
+
+TEST_F(ImageDecoder, streams_codecs_by_their_magic)
+{
+    QFile xz_file{mpt::test_data_path_for("multi_block.img.xz")};
+    ASSERT_TRUE(xz_file.open(QIODevice::ReadOnly));
+    const auto xz = xz_file.readAll();
+
+    // Chunks smaller than the magic, for it to be put together before the codec is picked
+    for (const auto& data : {zstd(content), gzip(content), gzip(content.left(1000)) + gzip(content.mid(1000)), xz,
+                             content})
+    {
+        stream(data, 3);
+        EXPECT_EQ(decoded_content(), content);
+
+        stream(data, 64 * 1024);
+        EXPECT_EQ(decoded_content(), content);
+    }
+}
+
+TEST_F(ImageDecoder, stream_restarts_from_scratch)
+{
+    const auto compressed = zstd(content);
+    const auto decoder = mpd::make_stream_decoder(decoded_file_path);
+    decoder->decode(compressed.constData(), compressed.size() / 2);
+
+    decoder->restart();
+    const auto gzipped = gzip(content);
+    decoder->decode(gzipped.constData(), gzipped.size());
+    decoder->finish();
+
+    EXPECT_EQ(decoded_content(), content);
+}
+
+TEST_F(ImageDecoder, stream_fails_on_truncated_data)
+{
+    for (const auto& compressed : {zstd(content), gzip(content)})
+    {
+        const auto decoder = mpd::make_stream_decoder(decoded_file_path);
+        decoder->decode(compressed.constData(), compressed.size() - 16);
+
+        EXPECT_THROW(decoder->finish(), std::runtime_error);
+    }
+}
@@ -21,6 +21,7 @@
 #include "mock_image_host.h"
 #include "mock_logger.h"
 #include "mock_process_factory.h"
+#include "mock_utils.h"
 #include "path.h"
 #include "stub_url_downloader.h"
 #include "temp_dir.h"
@@ -39,6 +40,8 @@
 #include <multipass/utils.h>
 
 #include <QDateTime>
+#include <QDir>
+#include <QFileInfo>
 #include <QThread>
 #include <QUrl>
 
@@ -89,11 +92,13 @@ struct HttpURLDownloader : public mp::URLDownloader
 
     QDateTime last_modified(const QUrl& url) override
     {
+        ++last_modified_requests;
         return default_last_modified;
     }
 
     QStringList downloaded_files;
     QStringList downloaded_urls;
+    int last_modified_requests{0};
 };
 
 struct RunningURLDownloader : public mp::URLDownloader
@@ -183,6 +188,16 @@ TEST_F(ImageVault, downloads_image)
     EXPECT_TRUE(url_downloader.downloaded_urls.contains(host.image.url()));
 }
 
+TEST_F(ImageVault, downloads_image_from_peers_first)
+{
+    const mp::vault::BlobStore blobs{cache_dir.filePath("blobs"), {"http://peer:8080/"}};
+    mp::DefaultVMImageVault vault{hosts, &url_downloader, cache_dir.path(), data_dir.path(), mp::days{0}, blobs};
+    vault.fetch_image(mp::FetchType::ImageOnly, default_query, stub_prepare, stub_monitor, false, std::nullopt);
+
+    EXPECT_THAT(url_downloader.downloaded_urls,
+                ElementsAre(QString{"http://peer:8080/images/%1"}.arg(mpt::default_id)));
+}
+
 TEST_F(ImageVault, returned_image_contains_instance_name)
 {
     mp::DefaultVMImageVault vault{hosts, &url_downloader, cache_dir.path(), data_dir.path(), mp::days{0}};
@@ -249,6 +264,109 @@ TEST_F(ImageVault, caches_prepared_images)
     EXPECT_THAT(vm_image1.id, Eq(vm_image2.id));
 }
 
+TEST_F(ImageVault, fetching_without_instance_reuses_prepared_image)
+{
+    mp::DefaultVMImageVault vault{hosts, &url_downloader, cache_dir.path(), data_dir.path(), mp::days{0}};
+    int prepare_called_count{0};
+    auto prepare = [&prepare_called_count](const mp::VMImage& source_image) -> mp::VMImage {
+        ++prepare_called_count;
+        return source_image;
+    };
+
+    auto query = default_query;
+    query.name.clear();
+    vault.fetch_image(mp::FetchType::ImageOnly, query, prepare, stub_monitor, false, std::nullopt);
+    vault.fetch_image(mp::FetchType::ImageOnly, query, prepare, stub_monitor, false, std::nullopt);
+
+    EXPECT_THAT(url_downloader.downloaded_files.size(), Eq(1));
+    EXPECT_THAT(prepare_called_count, Eq(1));
+}
+
+TEST_F(ImageVault, fetch_that_fails_setting_up_lets_the_next_one_through)
+{
+    mp::DefaultVMImageVault vault{hosts, &url_downloader, cache_dir.path(), data_dir.path(), mp::days{0}};
+
+    auto [mock_utils, guard] = mpt::MockUtils::inject<NiceMock>();
+    const auto real_make_dir = [mock_utils = mock_utils](const QDir& dir, const QString& name, auto permissions) {
+        return mock_utils->Utils::make_dir(dir, name, permissions);
+    };
+    EXPECT_CALL(*mock_utils, make_dir(_, A<const QString&>(), _))
+        .WillOnce(Throw(std::runtime_error{"no room for the image"}))
+        .WillRepeatedly(real_make_dir);
+
+    EXPECT_THROW(
+        vault.fetch_image(mp::FetchType::ImageOnly, default_query, stub_prepare, stub_monitor, false, std::nullopt),
+        std::runtime_error);
+
+    // Would wait forever on the first fetch, had it been left registered as in flight
+    vault.fetch_image(mp::FetchType::ImageOnly, default_query, stub_prepare, stub_monitor, false, std::nullopt);
+    EXPECT_THAT(url_downloader.downloaded_files.size(), Eq(1));
+}
+
+TEST_F(ImageVault, prune_to_size_evicts_least_recently_used_images)
+{
+    mp::DefaultVMImageVault vault{hosts, &url_downloader, cache_dir.path(), data_dir.path(), mp::days{0}};
+    auto prepare = [](const mp::VMImage& source_image) -> mp::VMImage {
+        mpt::make_file_with_content(QFileInfo{source_image.image_path}.dir().filePath("kernel"));
+        return source_image;
+    };
+
+    auto query = default_query;
+    query.name.clear();
+    vault.fetch_image(mp::FetchType::ImageOnly, query, prepare, stub_monitor, false, std::nullopt);
+    vault.prune_to_size(mp::MemorySize{"0"});
+    vault.fetch_image(mp::FetchType::ImageOnly, query, prepare, stub_monitor, false, std::nullopt);
+
+    EXPECT_THAT(url_downloader.downloaded_files.size(), Eq(2));
+}
+
+TEST_F(ImageVault, prune_to_size_keeps_images_instances_were_made_from)
+{
+    mp::DefaultVMImageVault vault{hosts, &url_downloader, cache_dir.path(), data_dir.path(), mp::days{0}};
+    auto prepare = [](const mp::VMImage& source_image) -> mp::VMImage {
+        mpt::make_file_with_content(QFileInfo{source_image.image_path}.dir().filePath("kernel"));
+        return source_image;
+    };
+
+    vault.fetch_image(mp::FetchType::ImageOnly, default_query, prepare, stub_monitor, false, std::nullopt);
+    vault.prune_to_size(mp::MemorySize{"0"});
+
+    auto another_query = default_query;
+    another_query.name = "valley-pied-piper-chat";
+    vault.fetch_image(mp::FetchType::ImageOnly, another_query, prepare, stub_monitor, false, std::nullopt);
+
+    EXPECT_THAT(url_downloader.downloaded_files.size(), Eq(1));
+}
+
+TEST_F(ImageVault, remove_leaves_the_instance_image_for_the_trash)
+{
+    mp::DefaultVMImageVault vault{hosts, &url_downloader, cache_dir.path(), data_dir.path(), mp::days{0}};
+    const auto vm_image =
+        vault.fetch_image(mp::FetchType::ImageOnly, default_query, stub_prepare, stub_monitor, false, std::nullopt);
+
+    vault.remove(instance_name);
+
+    const QDir trash_dir{QDir{data_dir.path()}.filePath("vault/trash")};
+    EXPECT_FALSE(vault.has_record_for(instance_name));
+    EXPECT_FALSE(QFileInfo::exists(vm_image.image_path));
+    EXPECT_EQ(trash_dir.entryList(QDir::Dirs | QDir::NoDotAndDotDot).size(), 1);
+
+    vault.empty_trash();
+
+    EXPECT_TRUE(trash_dir.isEmpty());
+}
+
+TEST_F(ImageVault, empty_trash_deletes_what_was_left_before)
+{
+    const QDir trash_dir{QDir{data_dir.path()}.filePath("vault/trash")};
+    mpt::make_file_with_content(trash_dir.filePath("crashed-1234/image.img"));
+
+    mp::DefaultVMImageVault vault{hosts, &url_downloader, cache_dir.path(), data_dir.path(), mp::days{0}};
+    vault.empty_trash();
+
+    EXPECT_TRUE(trash_dir.isEmpty());
+}
+
 TEST_F(ImageVault, remembers_instance_images)
 {
     int prepare_called_count{0};
@@ -490,6 +608,23 @@ TEST_F(ImageVault, DISABLE_ON_WINDOWS_AND_MACOS(http_download_returns_expected_i
     EXPECT_THAT(image.release_date, Eq(default_last_modified.toString().toStdString()));
 }
 
+TEST_F(ImageVault, DISABLE_ON_WINDOWS_AND_MACOS(http_download_last_modified_is_not_asked_again_right_away))
+{
+    HttpURLDownloader http_url_downloader;
+    mp::DefaultVMImageVault vault{hosts, &http_url_downloader, cache_dir.path(), data_dir.path(), mp::days{0}};
+
+    auto image_url{"http://www.foo.com/images/foo.img"};
+    mp::Query first_query{instance_name, image_url, false, "", mp::Query::Type::HttpDownload};
+    mp::Query second_query{"other-pied-piper", image_url, false, "", mp::Query::Type::HttpDownload};
+
+    vault.fetch_image(mp::FetchType::ImageOnly, first_query, stub_prepare, stub_monitor, false, std::nullopt);
+    vault.fetch_image(mp::FetchType::ImageOnly, second_query, stub_prepare, stub_monitor, false, std::nullopt);
+
+    EXPECT_EQ(http_url_downloader.last_modified_requests, 1);
+    EXPECT_EQ(http_url_downloader.downloaded_files.size(), 1);
+    EXPECT_TRUE(vault.has_record_for("other-pied-piper"));
+}
+
 TEST_F(ImageVault, image_update_creates_new_dir_and_removes_old)
 {
     mp::DefaultVMImageVault vault{hosts, &url_downloader, cache_dir.path(), data_dir.path(), mp::days{1}};
@@ -545,6 +680,80 @@ TEST_F(ImageVault, minimum_image_size_returns_expected_size)
     EXPECT_EQ(image_size, size);
 }
 
+TEST_F(ImageVault, minimum_image_size_is_cached_for_prepared_images)
+{
+    const mp::MemorySize image_size{"1048576"};
+    const mp::ProcessState qemuimg_exit_status{0, std::nullopt};
+    const QByteArray qemuimg_output(fake_img_info(image_size));
+    auto mock_factory_scope = inject_fake_qemuimg_callback(qemuimg_exit_status, qemuimg_output);
+
+    mp::DefaultVMImageVault vault{hosts, &url_downloader, cache_dir.path(), data_dir.path(), mp::days{0}};
+    auto vm_image =
+        vault.fetch_image(mp::FetchType::ImageOnly, default_query, stub_prepare, stub_monitor, false, std::nullopt);
+
+    EXPECT_EQ(vault.minimum_image_size_for(vm_image.id), image_size);
+    EXPECT_EQ(vault.minimum_image_size_for(vm_image.id), image_size);
+    EXPECT_EQ(mock_factory_scope->process_list().size(), 1u);
+
+    mp::DefaultVMImageVault reloaded_vault{hosts, &url_downloader, cache_dir.path(), data_dir.path(), mp::days{0}};
+    EXPECT_EQ(reloaded_vault.minimum_image_size_for(vm_image.id), image_size);
+    EXPECT_EQ(mock_factory_scope->process_list().size(), 1u);
+}
+
+TEST_F(ImageVault, clone_copies_the_instance_image_and_record)
+{
+    mp::DefaultVMImageVault vault{hosts, &url_downloader, cache_dir.path(), data_dir.path(), mp::days{0}};
+    auto vm_image =
+        vault.fetch_image(mp::FetchType::ImageOnly, default_query, stub_prepare, stub_monitor, false, std::nullopt);
+
+    const auto clone = vault.clone(instance_name, "clone");
+
+    EXPECT_TRUE(vault.has_record_for("clone"));
+    EXPECT_NE(clone.image_path, vm_image.image_path);
+    EXPECT_TRUE(QFile::exists(clone.image_path));
+    EXPECT_EQ(clone.id, vm_image.id);
+
+    mp::DefaultVMImageVault reloaded_vault{hosts, &url_downloader, cache_dir.path(), data_dir.path(), mp::days{0}};
+    EXPECT_TRUE(reloaded_vault.has_record_for("clone"));
+}
+
+TEST_F(ImageVault, clone_refuses_missing_sources_and_existing_destinations)
+{
+    mp::DefaultVMImageVault vault{hosts, &url_downloader, cache_dir.path(), data_dir.path(), mp::days{0}};
+    vault.fetch_image(mp::FetchType::ImageOnly, default_query, stub_prepare, stub_monitor, false, std::nullopt);
+
+    MP_EXPECT_THROW_THAT(vault.clone("missing", "clone"), std::runtime_error,
+                         mpt::match_what(HasSubstr("Cannot find an image")));
+    MP_EXPECT_THROW_THAT(vault.clone(instance_name, instance_name), std::runtime_error,
+                         mpt::match_what(HasSubstr("already an image")));
+}
+
+TEST_F(ImageVault, golden_images_are_kept_for_later_instances)
+{
+    mp::DefaultVMImageVault vault{hosts, &url_downloader, cache_dir.path(), data_dir.path(), mp::days{0}};
+    vault.fetch_image(mp::FetchType::ImageOnly, default_query, stub_prepare, stub_monitor, false, std::nullopt);
+    const std::string key{"docker@1/x86_64/abc"};
+
+    EXPECT_TRUE(vault.keeps_golden_images());
+    EXPECT_FALSE(vault.golden_image_for(key, instance_name));
+
+    vault.keep_golden_image(key, instance_name);
+
+    auto query = default_query;
+    query.name = "later";
+    auto later_image =
+        vault.fetch_image(mp::FetchType::ImageOnly, query, stub_prepare, stub_monitor, false, std::nullopt);
+    const auto golden_image = vault.golden_image_for(key, "later");
+
+    ASSERT_TRUE(golden_image);
+    EXPECT_EQ(golden_image->id, key);
+    EXPECT_EQ(golden_image->image_path, later_image.image_path);
+    EXPECT_TRUE(QFile::exists(golden_image->image_path));
+
+    mp::DefaultVMImageVault reloaded_vault{hosts, &url_downloader, cache_dir.path(), data_dir.path(), mp::days{0}};
+    EXPECT_TRUE(reloaded_vault.golden_image_for(key, "later"));
+}
+
 TEST_F(ImageVault, DISABLE_ON_WINDOWS_AND_MACOS(file_based_minimum_size_returns_expected_size))
 {
     const mp::MemorySize image_size{"2097152"};
@@ -0,0 +1,87 @@
+/*
+ * Copyright (C) Canonical, Ltd.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; version 3.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#include "common.h"
+#include "mock_logger.h"
+
+#include <multipass/logging/instance_log.h>
+
+#include <string>
+
+namespace mpl = multipass::logging;
+namespace mpt = multipass::test;
+
+using namespace testing;
+
+TEST(InstanceLog, keeps_what_was_appended)
+{
+    auto logger_scope = mpt::MockLogger::inject(mpl::Level::debug);
+    mpl::InstanceLog log{"vm"};
+
+    log.append(mpl::Level::warning, "one\ntwo\n");
+    log.append(mpl::Level::debug, "three\n");
+
+    EXPECT_EQ(log.contents(), "one\ntwo\nthree\n");
+}
+
+TEST(InstanceLog, forwards_each_line_at_its_level)
+{
+    auto logger_scope = mpt::MockLogger::inject(mpl::Level::debug);
+    EXPECT_CALL(*logger_scope.mock_logger, log(mpl::Level::warning, mpt::MockLogger::make_cstring_matcher(StrEq("vm")),
+                                               mpt::MockLogger::make_cstring_matcher(StrEq("one"))));
+    EXPECT_CALL(*logger_scope.mock_logger, log(mpl::Level::warning, mpt::MockLogger::make_cstring_matcher(StrEq("vm")),
+                                               mpt::MockLogger::make_cstring_matcher(StrEq("two"))));
+
+    mpl::InstanceLog log{"vm"};
+    log.append(mpl::Level::warning, "one\n\ntwo");
+}
+
+TEST(InstanceLog, drops_the_oldest_lines_beyond_its_capacity)
+{
+    auto logger_scope = mpt::MockLogger::inject(mpl::Level::debug);
+    mpl::InstanceLog log{"vm", 10};
+
+    log.append(mpl::Level::debug, "first\nsecond\nthird\n");
+
+    EXPECT_EQ(log.contents(), "third\n");
+}
+
+TEST(InstanceLog, does_not_log_more_lines_than_its_rate)
+{
+    auto logger_scope = mpt::MockLogger::inject(mpl::Level::debug);
+    logger_scope.mock_logger->expect_log(mpl::Level::info, "line", Exactly(3));
+
+    mpl::InstanceLog log{"vm", mpl::InstanceLog::default_capacity, 3};
+    for (auto i = 0; i < 10; ++i)
+        log.append(mpl::Level::info, "line\n");
+
+    EXPECT_EQ(log.contents().size(), std::string{"line\n"}.size() * 10);
+}
+
+TEST(InstanceLog, counts_what_every_log_buffers)
+{
+    auto logger_scope = mpt::MockLogger::inject(mpl::Level::debug);
+    const auto before = mpl::InstanceLog::buffered_bytes();
+    {
+        mpl::InstanceLog log{"vm"};
+        log.append(mpl::Level::debug, std::string(1000, 'x'));
+
+        EXPECT_GE(mpl::InstanceLog::buffered_bytes(), before + 1000);
+    }
+
+    EXPECT_EQ(mpl::InstanceLog::buffered_bytes(), before);
+}
@@ -110,6 +110,9 @@ TEST_P(TestInstanceSettingsKeys, keysCoversAllPropertiesForAllInstances)
 
         for (const auto& prop : properties)
             expected_keys.push_back(make_key(name, prop));
+        for (const auto& prop : {"disk-profile", "hugepages", "cpu-pinning", "fast-boot", "network-limit", "disk-iops",
+                                 "idle-suspend", "interactive", "cpu-weight", "io-weight", "memory-limit"})
+            expected_keys.push_back(make_key(name, prop));
     }
 
     EXPECT_THAT(make_handler().keys(), UnorderedElementsAreArray(expected_keys));
@@ -424,6 +427,51 @@ TEST_F(TestInstanceSettingsHandler, setRefusesWrongProperty)
     EXPECT_EQ(original_specs, specs[target_instance_name]);
 }
 
+TEST_F(TestInstanceSettingsHandler, setValuesAppliesAllChangesAndPersistsOnce)
+{
+    constexpr auto target_instance_name = "batched";
+    auto& spec = specs[target_instance_name];
+    spec.num_cores = 2;
+    spec.mem_size = mp::MemorySize{"1G"};
+    spec.disk_space = mp::MemorySize{"5G"};
+
+    auto& instance = mock_vm(target_instance_name);
+    EXPECT_CALL(instance, update_cpus(4)).Times(1);
+    EXPECT_CALL(instance, resize_memory(Eq(mp::MemorySize{"2G"}))).Times(1);
+    EXPECT_CALL(instance, resize_disk(Eq(mp::MemorySize{"10G"}))).Times(1);
+
+    auto persisted = 0;
+    mp::InstanceSettingsHandler handler{specs, vms, deleted_vms, preparing_vms, [&persisted] { ++persisted; }};
+    handler.set_values({{make_key(target_instance_name, "cpus"), "4"},
+                        {make_key(target_instance_name, "memory"), "2G"},
+                        {make_key(target_instance_name, "disk"), "10G"},
+                        {"some.other.key", "for another handler"}});
+
+    EXPECT_EQ(persisted, 1);
+    EXPECT_EQ(spec.num_cores, 4);
+    EXPECT_EQ(spec.disk_space, mp::MemorySize{"10G"});
+}
+
+TEST_F(TestInstanceSettingsHandler, setValuesChangesNothingWhenAnyValueIsBad)
+{
+    constexpr auto target_instance_name = "batched";
+    auto& spec = specs[target_instance_name];
+    spec.num_cores = 2;
+    spec.disk_space = mp::MemorySize{"5G"};
+    const auto original_spec = spec;
+
+    auto& instance = mock_vm(target_instance_name);
+    EXPECT_CALL(instance, update_cpus).Times(0);
+    EXPECT_CALL(instance, resize_disk).Times(0);
+
+    MP_EXPECT_THROW_THAT(make_handler().set_values({{make_key(target_instance_name, "cpus"), "4"},
+                                                    {make_key(target_instance_name, "disk"), "1G"}}),
+                         mp::InvalidSettingException, mpt::match_what(HasSubstr("expanded")));
+
+    EXPECT_EQ(spec, original_spec);
+    EXPECT_FALSE(fake_persister_called);
+}
+
 using VMSt = mp::VirtualMachine::State;
 using Property = const char*;
 using PropertyAndState = std::tuple<Property, VMSt>; // no subliminal political msg intended :)
@@ -454,6 +502,475 @@ INSTANTIATE_TEST_SUITE_P(TestInstanceSettingsHandler, TestInstanceModOnNonStoppe
                                  Values(VMSt::running, VMSt::restarting, VMSt::starting, VMSt::delayed_shutdown,
                                         VMSt::suspended, VMSt::suspending, VMSt::unknown)));
 
+struct HotpluggableMockVirtualMachine : public mpt::MockVirtualMachine
+{
+    using mpt::MockVirtualMachine::MockVirtualMachine;
+
+    bool hotpluggable() override
+    {
+        return true;
+    }
+};
+
+TEST_F(TestInstanceSettingsHandler, setGrowsRunningInstancesThatCanBeHotplugged)
+{
+    constexpr auto target_instance_name = "Brahms";
+    const auto& actual_cpus = specs[target_instance_name].num_cores = 2;
+
+    auto instance = std::make_shared<NiceMock<HotpluggableMockVirtualMachine>>(target_instance_name);
+    vms.emplace(target_instance_name, instance);
+
+    EXPECT_CALL(*instance, current_state).WillRepeatedly(Return(VMSt::running));
+    EXPECT_CALL(*instance, update_cpus(4));
+
+    make_handler().set(make_key(target_instance_name, "cpus"), "4");
+    EXPECT_EQ(actual_cpus, 4);
+}
+
+TEST_F(TestInstanceSettingsHandler, setReportsWhyRunningInstancesCouldNotBeGrown)
+{
+    constexpr auto target_instance_name = "Schubert";
+    const auto& actual_cpus = specs[target_instance_name].num_cores = 2;
+
+    auto instance = std::make_shared<NiceMock<HotpluggableMockVirtualMachine>>(target_instance_name);
+    vms.emplace(target_instance_name, instance);
+
+    EXPECT_CALL(*instance, current_state).WillRepeatedly(Return(VMSt::running));
+    EXPECT_CALL(*instance, update_cpus).WillOnce(Throw(std::runtime_error{"no more room"}));
+
+    MP_EXPECT_THROW_THAT(make_handler().set(make_key(target_instance_name, "cpus"), "4"),
+                         mp::InstanceSettingsException,
+                         mpt::match_what(AllOf(HasSubstr("Cannot update"), HasSubstr("no more room"))));
+    EXPECT_EQ(actual_cpus, 2);
+}
+
+TEST_F(TestInstanceSettingsHandler, setRefusesToResizeDisksOfRunningInstancesEvenIfHotpluggable)
+{
+    constexpr auto target_instance_name = "Chopin";
+    specs[target_instance_name];
+
+    auto instance = std::make_shared<NiceMock<HotpluggableMockVirtualMachine>>(target_instance_name);
+    vms.emplace(target_instance_name, instance);
+
+    EXPECT_CALL(*instance, current_state).WillRepeatedly(Return(VMSt::running));
+    EXPECT_CALL(*instance, resize_disk).Times(0);
+
+    MP_EXPECT_THROW_THAT(make_handler().set(make_key(target_instance_name, "disk"), "10G"),
+                         mp::InstanceSettingsException, mpt::match_what(HasSubstr("Instance must be stopped")));
+}
+
+struct OnlineResizeMockVirtualMachine : public mpt::MockVirtualMachine
+{
+    using mpt::MockVirtualMachine::MockVirtualMachine;
+
+    bool online_disk_resize() override
+    {
+        return true;
+    }
+};
+
+TEST_F(TestInstanceSettingsHandler, setGrowsDisksOfRunningInstancesThatCanBeResizedOnline)
+{
+    constexpr auto target_instance_name = "Liszt";
+    const auto& actual_disk = specs[target_instance_name].disk_space = mp::MemorySize{"5G"};
+
+    auto instance = std::make_shared<NiceMock<OnlineResizeMockVirtualMachine>>(target_instance_name);
+    vms.emplace(target_instance_name, instance);
+
+    EXPECT_CALL(*instance, current_state).WillRepeatedly(Return(VMSt::running));
+    EXPECT_CALL(*instance, resize_disk(Eq(mp::MemorySize{"10G"})));
+
+    make_handler().set(make_key(target_instance_name, "disk"), "10G");
+    EXPECT_EQ(actual_disk, mp::MemorySize{"10G"});
+}
+
+struct TunableMockVirtualMachine : public mpt::MockVirtualMachine
+{
+    using mpt::MockVirtualMachine::MockVirtualMachine;
+
+    std::vector<std::string> disk_profiles() override
+    {
+        return {"default", "virtio-blk"};
+    }
+
+    MOCK_METHOD(std::string, disk_profile, (), (override));
+    MOCK_METHOD(void, set_disk_profile, (const std::string&), (override));
+    MOCK_METHOD(bool, hugepages, (), (override));
+    MOCK_METHOD(void, set_hugepages, (bool), (override));
+    MOCK_METHOD(std::string, cpu_pinning, (), (override));
+    MOCK_METHOD(void, set_cpu_pinning, (const std::string&), (override));
+    MOCK_METHOD(bool, fast_boot, (), (override));
+    MOCK_METHOD(void, set_fast_boot, (bool), (override));
+    MOCK_METHOD(int, network_limit, (), (override));
+    MOCK_METHOD(void, set_network_limit, (int), (override));
+    MOCK_METHOD(int, disk_iops_limit, (), (override));
+    MOCK_METHOD(void, set_disk_iops_limit, (int), (override));
+    MOCK_METHOD(int, cpu_weight, (), (override));
+    MOCK_METHOD(void, set_cpu_weight, (int), (override));
+    MOCK_METHOD(int, io_weight, (), (override));
+    MOCK_METHOD(void, set_io_weight, (int), (override));
+    MOCK_METHOD(std::string, memory_limit, (), (override));
+    MOCK_METHOD(void, set_memory_limit, (const std::string&), (override));
+};
+
+TEST_F(TestInstanceSettingsHandler, getFetchesInstanceDiskProfile)
+{
+    constexpr auto target_instance_name = "Ravel";
+    specs[target_instance_name];
+
+    auto instance = std::make_shared<NiceMock<TunableMockVirtualMachine>>(target_instance_name);
+    vms.emplace(target_instance_name, instance);
+    EXPECT_CALL(*instance, disk_profile).WillOnce(Return("virtio-blk"));
+
+    EXPECT_EQ(make_handler().get(make_key(target_instance_name, "disk-profile")), "virtio-blk");
+}
+
+TEST_F(TestInstanceSettingsHandler, setChangesDiskProfileOfStoppedInstances)
+{
+    constexpr auto target_instance_name = "Debussy";
+    specs[target_instance_name];
+
+    auto instance = std::make_shared<NiceMock<TunableMockVirtualMachine>>(target_instance_name);
+    vms.emplace(target_instance_name, instance);
+    EXPECT_CALL(*instance, current_state).WillRepeatedly(Return(VMSt::stopped));
+    EXPECT_CALL(*instance, disk_profile).WillRepeatedly(Return("default"));
+    EXPECT_CALL(*instance, set_disk_profile("virtio-blk"));
+
+    make_handler().set(make_key(target_instance_name, "disk-profile"), "virtio-blk");
+    EXPECT_TRUE(fake_persister_called);
+}
+
+TEST_F(TestInstanceSettingsHandler, setRefusesDiskProfilesTheBackendDoesNotKnow)
+{
+    constexpr auto target_instance_name = "Satie";
+    specs[target_instance_name];
+
+    auto instance = std::make_shared<NiceMock<TunableMockVirtualMachine>>(target_instance_name);
+    vms.emplace(target_instance_name, instance);
+    EXPECT_CALL(*instance, current_state).WillRepeatedly(Return(VMSt::stopped));
+    EXPECT_CALL(*instance, set_disk_profile).Times(0);
+
+    MP_EXPECT_THROW_THAT(make_handler().set(make_key(target_instance_name, "disk-profile"), "floppy"),
+                         mp::InvalidSettingException,
+                         mpt::match_what(AllOf(HasSubstr("floppy"), HasSubstr("default, virtio-blk"))));
+}
+
+TEST_F(TestInstanceSettingsHandler, setRefusesToChangeDiskProfileOfRunningInstances)
+{
+    constexpr auto target_instance_name = "Faure";
+    specs[target_instance_name];
+
+    auto instance = std::make_shared<NiceMock<TunableMockVirtualMachine>>(target_instance_name);
+    vms.emplace(target_instance_name, instance);
+    EXPECT_CALL(*instance, current_state).WillRepeatedly(Return(VMSt::running));
+    EXPECT_CALL(*instance, set_disk_profile).Times(0);
+
+    MP_EXPECT_THROW_THAT(make_handler().set(make_key(target_instance_name, "disk-profile"), "virtio-blk"),
+                         mp::InstanceSettingsException, mpt::match_what(HasSubstr("Instance must be stopped")));
+}
+
+TEST_F(TestInstanceSettingsHandler, getFetchesInstanceHugepagesAndCpuPinning)
+{
+    constexpr auto target_instance_name = "Dvorak";
+    specs[target_instance_name];
+
+    auto instance = std::make_shared<NiceMock<TunableMockVirtualMachine>>(target_instance_name);
+    vms.emplace(target_instance_name, instance);
+    EXPECT_CALL(*instance, hugepages).WillOnce(Return(true));
+    EXPECT_CALL(*instance, cpu_pinning).WillOnce(Return("numa"));
+
+    auto handler = make_handler();
+    EXPECT_EQ(handler.get(make_key(target_instance_name, "hugepages")), "true");
+    EXPECT_EQ(handler.get(make_key(target_instance_name, "cpu-pinning")), "numa");
+}
+
+TEST_F(TestInstanceSettingsHandler, getReportsDefaultsOfBackendsWithoutHugepagesOrCpuPinning)
+{
+    constexpr auto target_instance_name = "Smetana";
+    specs[target_instance_name];
+    mock_vm(target_instance_name);
+
+    auto handler = make_handler();
+    EXPECT_EQ(handler.get(make_key(target_instance_name, "hugepages")), "false");
+    EXPECT_EQ(handler.get(make_key(target_instance_name, "cpu-pinning")), "none");
+}
+
+TEST_F(TestInstanceSettingsHandler, setEnablesHugepagesOfStoppedInstances)
+{
+    constexpr auto target_instance_name = "Janacek";
+    specs[target_instance_name];
+
+    auto instance = std::make_shared<NiceMock<TunableMockVirtualMachine>>(target_instance_name);
+    vms.emplace(target_instance_name, instance);
+    EXPECT_CALL(*instance, current_state).WillRepeatedly(Return(VMSt::off));
+    EXPECT_CALL(*instance, hugepages).WillRepeatedly(Return(false));
+    EXPECT_CALL(*instance, set_hugepages(true));
+
+    make_handler().set(make_key(target_instance_name, "hugepages"), "on");
+    EXPECT_TRUE(fake_persister_called);
+}
+
+TEST_F(TestInstanceSettingsHandler, setRefusesHugepagesWhereTheBackendHasNone)
+{
+    constexpr auto target_instance_name = "Martinu";
+    specs[target_instance_name];
+    EXPECT_CALL(mock_vm(target_instance_name), current_state).WillRepeatedly(Return(VMSt::stopped));
+
+    MP_EXPECT_THROW_THAT(make_handler().set(make_key(target_instance_name, "hugepages"), "true"),
+                         mp::InstanceSettingsException,
+                         mpt::match_what(AllOf(HasSubstr("Cannot update"), HasSubstr("hugepages"))));
+}
+
+TEST_F(TestInstanceSettingsHandler, setRefusesBadHugepagesValues)
+{
+    constexpr auto target_instance_name = "Suk";
+    specs[target_instance_name];
+    EXPECT_CALL(mock_vm(target_instance_name), current_state).WillRepeatedly(Return(VMSt::stopped));
+
+    MP_EXPECT_THROW_THAT(make_handler().set(make_key(target_instance_name, "hugepages"), "lots"),
+                         mp::InvalidSettingException, mpt::match_what(HasSubstr("lots")));
+}
+
+TEST_F(TestInstanceSettingsHandler, setPinsCpusOfStoppedInstances)
+{
+    constexpr auto target_instance_name = "Bartok";
+    specs[target_instance_name];
+
+    auto instance = std::make_shared<NiceMock<TunableMockVirtualMachine>>(target_instance_name);
+    vms.emplace(target_instance_name, instance);
+    EXPECT_CALL(*instance, current_state).WillRepeatedly(Return(VMSt::stopped));
+    EXPECT_CALL(*instance, cpu_pinning).WillRepeatedly(Return("none"));
+    EXPECT_CALL(*instance, set_cpu_pinning("0-3,8"));
+
+    make_handler().set(make_key(target_instance_name, "cpu-pinning"), "0-3,8");
+    EXPECT_TRUE(fake_persister_called);
+}
+
+TEST_F(TestInstanceSettingsHandler, setRefusesCpuPinningsTheBackendCannotParse)
+{
+    constexpr auto target_instance_name = "Kodaly";
+    specs[target_instance_name];
+
+    auto instance = std::make_shared<NiceMock<TunableMockVirtualMachine>>(target_instance_name);
+    vms.emplace(target_instance_name, instance);
+    EXPECT_CALL(*instance, current_state).WillRepeatedly(Return(VMSt::stopped));
+    EXPECT_CALL(*instance, cpu_pinning).WillRepeatedly(Return("none"));
+    EXPECT_CALL(*instance, set_cpu_pinning).WillOnce(Throw(std::invalid_argument{"not a list of CPUs"}));
+
+    MP_EXPECT_THROW_THAT(make_handler().set(make_key(target_instance_name, "cpu-pinning"), "3-1"),
+                         mp::InvalidSettingException,
+                         mpt::match_what(AllOf(HasSubstr("3-1"), HasSubstr("not a list of CPUs"))));
+    EXPECT_FALSE(fake_persister_called);
+}
+
+TEST_F(TestInstanceSettingsHandler, getFetchesInstanceFastBoot)
+{
+    constexpr auto target_instance_name = "Grieg";
+    specs[target_instance_name];
+
+    auto instance = std::make_shared<NiceMock<TunableMockVirtualMachine>>(target_instance_name);
+    vms.emplace(target_instance_name, instance);
+    EXPECT_CALL(*instance, fast_boot).WillOnce(Return(true));
+
+    EXPECT_EQ(make_handler().get(make_key(target_instance_name, "fast-boot")), "true");
+}
+
+TEST_F(TestInstanceSettingsHandler, setEnablesFastBootOfStoppedInstances)
+{
+    constexpr auto target_instance_name = "Nielsen";
+    specs[target_instance_name];
+
+    auto instance = std::make_shared<NiceMock<TunableMockVirtualMachine>>(target_instance_name);
+    vms.emplace(target_instance_name, instance);
+    EXPECT_CALL(*instance, current_state).WillRepeatedly(Return(VMSt::stopped));
+    EXPECT_CALL(*instance, fast_boot).WillRepeatedly(Return(false));
+    EXPECT_CALL(*instance, set_fast_boot(true));
+
+    make_handler().set(make_key(target_instance_name, "fast-boot"), "yes");
+    EXPECT_TRUE(fake_persister_called);
+}
+
+TEST_F(TestInstanceSettingsHandler, setRefusesFastBootOfRunningInstances)
+{
+    constexpr auto target_instance_name = "Sibelius";
+    specs[target_instance_name];
+
+    auto instance = std::make_shared<NiceMock<TunableMockVirtualMachine>>(target_instance_name);
+    vms.emplace(target_instance_name, instance);
+    EXPECT_CALL(*instance, current_state).WillRepeatedly(Return(VMSt::running));
+    EXPECT_CALL(*instance, fast_boot).WillRepeatedly(Return(false));
+    EXPECT_CALL(*instance, set_fast_boot).Times(0);
+
+    MP_EXPECT_THROW_THAT(make_handler().set(make_key(target_instance_name, "fast-boot"), "true"),
+                         mp::InstanceSettingsException, mpt::match_what(HasSubstr("Cannot update")));
+    EXPECT_FALSE(fake_persister_called);
+}
+
+TEST_F(TestInstanceSettingsHandler, setRefusesFastBootWhereTheBackendHasNone)
+{
+    constexpr auto target_instance_name = "Halvorsen";
+    specs[target_instance_name];
+    EXPECT_CALL(mock_vm(target_instance_name), current_state).WillRepeatedly(Return(VMSt::stopped));
+
+    MP_EXPECT_THROW_THAT(make_handler().set(make_key(target_instance_name, "fast-boot"), "true"),
+                         mp::InstanceSettingsException,
+                         mpt::match_what(AllOf(HasSubstr("Cannot update"), HasSubstr("fast boot"))));
+}
+
+TEST_F(TestInstanceSettingsHandler, getFetchesInstanceLimits)
+{
+    constexpr auto target_instance_name = "Nyman";
+    specs[target_instance_name];
+
+    auto instance = std::make_shared<NiceMock<TunableMockVirtualMachine>>(target_instance_name);
+    vms.emplace(target_instance_name, instance);
+    EXPECT_CALL(*instance, network_limit).WillOnce(Return(100));
+    EXPECT_CALL(*instance, disk_iops_limit).WillOnce(Return(0));
+
+    const auto handler = make_handler();
+    EXPECT_EQ(handler.get(make_key(target_instance_name, "network-limit")), "100");
+    EXPECT_EQ(handler.get(make_key(target_instance_name, "disk-iops")), "none");
+}
+
+TEST_F(TestInstanceSettingsHandler, setLimitsStoppedInstances)
+{
+    constexpr auto target_instance_name = "Part";
+    specs[target_instance_name];
+
+    auto instance = std::make_shared<NiceMock<TunableMockVirtualMachine>>(target_instance_name);
+    vms.emplace(target_instance_name, instance);
+    EXPECT_CALL(*instance, current_state).WillRepeatedly(Return(VMSt::stopped));
+    EXPECT_CALL(*instance, network_limit).WillRepeatedly(Return(100));
+    EXPECT_CALL(*instance, set_network_limit(0));
+    EXPECT_CALL(*instance, disk_iops_limit).WillRepeatedly(Return(0));
+    EXPECT_CALL(*instance, set_disk_iops_limit(500));
+
+    auto handler = make_handler();
+    handler.set(make_key(target_instance_name, "network-limit"), "none");
+    handler.set(make_key(target_instance_name, "disk-iops"), "500");
+    EXPECT_TRUE(fake_persister_called);
+}
+
+TEST_F(TestInstanceSettingsHandler, setRefusesBadLimits)
+{
+    constexpr auto target_instance_name = "Tormis";
+    specs[target_instance_name];
+
+    auto instance = std::make_shared<NiceMock<TunableMockVirtualMachine>>(target_instance_name);
+    vms.emplace(target_instance_name, instance);
+    EXPECT_CALL(*instance, current_state).WillRepeatedly(Return(VMSt::stopped));
+    EXPECT_CALL(*instance, set_network_limit).Times(0);
+    EXPECT_CALL(*instance, set_disk_iops_limit).Times(0);
+
+    for (const auto* bad : {"-1", "fast", "1.5"})
+    {
+        MP_EXPECT_THROW_THAT(make_handler().set(make_key(target_instance_name, "network-limit"), bad),
+                             mp::InvalidSettingException, mpt::match_what(HasSubstr("positive integer")));
+        MP_EXPECT_THROW_THAT(make_handler().set(make_key(target_instance_name, "disk-iops"), bad),
+                             mp::InvalidSettingException, mpt::match_what(HasSubstr("positive integer")));
+    }
+    EXPECT_FALSE(fake_persister_called);
+}
+
+TEST_F(TestInstanceSettingsHandler, getFetchesInstanceResourceControls)
+{
+    constexpr auto target_instance_name = "Saariaho";
+    specs[target_instance_name];
+
+    auto instance = std::make_shared<NiceMock<TunableMockVirtualMachine>>(target_instance_name);
+    vms.emplace(target_instance_name, instance);
+    EXPECT_CALL(*instance, cpu_weight).WillOnce(Return(500));
+    EXPECT_CALL(*instance, io_weight).WillOnce(Return(0));
+    EXPECT_CALL(*instance, memory_limit).WillOnce(Return("soft"));
+
+    const auto handler = make_handler();
+    EXPECT_EQ(handler.get(make_key(target_instance_name, "cpu-weight")), "500");
+    EXPECT_EQ(handler.get(make_key(target_instance_name, "io-weight")), "default");
+    EXPECT_EQ(handler.get(make_key(target_instance_name, "memory-limit")), "soft");
+}
+
+TEST_F(TestInstanceSettingsHandler, setResourceControlsStoppedInstances)
+{
+    constexpr auto target_instance_name = "Lindberg";
+    specs[target_instance_name];
+
+    auto instance = std::make_shared<NiceMock<TunableMockVirtualMachine>>(target_instance_name);
+    vms.emplace(target_instance_name, instance);
+    EXPECT_CALL(*instance, current_state).WillRepeatedly(Return(VMSt::stopped));
+    EXPECT_CALL(*instance, cpu_weight).WillRepeatedly(Return(0));
+    EXPECT_CALL(*instance, set_cpu_weight(10000));
+    EXPECT_CALL(*instance, io_weight).WillRepeatedly(Return(50));
+    EXPECT_CALL(*instance, set_io_weight(0));
+    EXPECT_CALL(*instance, memory_limit).WillRepeatedly(Return("none"));
+    EXPECT_CALL(*instance, set_memory_limit("hard"));
+
+    auto handler = make_handler();
+    handler.set(make_key(target_instance_name, "cpu-weight"), "10000");
+    handler.set(make_key(target_instance_name, "io-weight"), "default");
+    handler.set(make_key(target_instance_name, "memory-limit"), "hard");
+    EXPECT_TRUE(fake_persister_called);
+}
+
+TEST_F(TestInstanceSettingsHandler, setRefusesBadResourceControls)
+{
+    constexpr auto target_instance_name = "Kaipainen";
+    specs[target_instance_name];
+
+    auto instance = std::make_shared<NiceMock<TunableMockVirtualMachine>>(target_instance_name);
+    vms.emplace(target_instance_name, instance);
+    EXPECT_CALL(*instance, current_state).WillRepeatedly(Return(VMSt::stopped));
+    EXPECT_CALL(*instance, set_cpu_weight).Times(0);
+    EXPECT_CALL(*instance, set_io_weight).Times(0);
+    EXPECT_CALL(*instance, set_memory_limit).WillOnce(Throw(std::invalid_argument{"none of those"}));
+
+    for (const auto* bad : {"0", "10001", "heavy", "-5"})
+    {
+        MP_EXPECT_THROW_THAT(make_handler().set(make_key(target_instance_name, "cpu-weight"), bad),
+                             mp::InvalidSettingException, mpt::match_what(HasSubstr("from 1 to 10000")));
+        MP_EXPECT_THROW_THAT(make_handler().set(make_key(target_instance_name, "io-weight"), bad),
+                             mp::InvalidSettingException, mpt::match_what(HasSubstr("from 1 to 10000")));
+    }
+    MP_EXPECT_THROW_THAT(make_handler().set(make_key(target_instance_name, "memory-limit"), "tight"),
+                         mp::InvalidSettingException, mpt::match_what(HasSubstr("none of those")));
+    EXPECT_FALSE(fake_persister_called);
+}
+
+TEST_F(TestInstanceSettingsHandler, setsIdleSuspendWhileRunning)
+{
+    constexpr auto target_instance_name = "Haapsalu";
+    specs[target_instance_name];
+
+    auto instance = std::make_shared<NiceMock<TunableMockVirtualMachine>>(target_instance_name);
+    vms.emplace(target_instance_name, instance);
+    EXPECT_CALL(*instance, current_state).WillRepeatedly(Return(VMSt::running));
+
+    auto handler = make_handler();
+    EXPECT_EQ(handler.get(make_key(target_instance_name, "idle-suspend")), "none");
+
+    handler.set(make_key(target_instance_name, "idle-suspend"), "30");
+    EXPECT_EQ(specs[target_instance_name].idle_suspend, 30);
+    EXPECT_EQ(handler.get(make_key(target_instance_name, "idle-suspend")), "30");
+    EXPECT_TRUE(fake_persister_called);
+}
+
+TEST_F(TestInstanceSettingsHandler, setsInteractiveWhileRunning)
+{
+    constexpr auto target_instance_name = "Kuressaare";
+    specs[target_instance_name];
+
+    auto instance = std::make_shared<NiceMock<TunableMockVirtualMachine>>(target_instance_name);
+    vms.emplace(target_instance_name, instance);
+    EXPECT_CALL(*instance, current_state).WillRepeatedly(Return(VMSt::running));
+
+    auto handler = make_handler();
+    EXPECT_EQ(handler.get(make_key(target_instance_name, "interactive")), "false");
+
+    handler.set(make_key(target_instance_name, "interactive"), "true");
+    EXPECT_TRUE(specs[target_instance_name].interactive);
+    EXPECT_EQ(handler.get(make_key(target_instance_name, "interactive")), "true");
+    EXPECT_THROW(handler.set(make_key(target_instance_name, "interactive"), "sometimes"), mp::InvalidSettingException);
+}
+
 struct TestInstanceModOnStoppedInstance : public TestInstanceSettingsHandler,
                                           public WithParamInterface<PropertyAndState>
 {
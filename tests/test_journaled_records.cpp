@@ -0,0 +1,135 @@
+/*
+ * Copyright (C) Canonical, Ltd.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; version 3.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#include "common.h"
+#include "file_operations.h"
+#include "temp_dir.h"
+
+#include <multipass/journaled_records.h>
+
+#include <QFile>
+#include <QJsonDocument>
+
+namespace mp = multipass;
+namespace mpt = multipass::test;
+
+using namespace testing;
+
+namespace
+{
+struct JournaledRecords : public Test
+{
+    QJsonObject records_with(int count)
+    {
+        QJsonObject records;
+        for (auto i = 0; i < count; ++i)
+            records.insert(QString("record-%1").arg(i), QJsonObject{{"value", i}});
+
+        return records;
+    }
+
+    mpt::TempDir temp_dir;
+    const QString db_path{temp_dir.filePath("records.json")};
+    const QString journal_path{temp_dir.filePath("records.journal")};
+};
+} // namespace
+
+TEST_F(JournaledRecords, journals_updates_after_the_database_is_written)
+{
+    mp::JournaledRecords db{db_path};
+    auto records = records_with(2);
+    db.write(records);
+    const auto written = mpt::load(db_path);
+
+    records["record-1"] = QJsonObject{{"value", 42}};
+    db.update("record-1", records["record-1"], [&records] { return records; });
+
+    EXPECT_EQ(mpt::load(db_path), written);
+    EXPECT_TRUE(QFile::exists(journal_path));
+    EXPECT_EQ(mp::JournaledRecords::read(db_path), records);
+}
+
+TEST_F(JournaledRecords, writes_everything_the_first_time_around)
+{
+    mp::JournaledRecords db{db_path};
+    const auto records = records_with(3);
+    db.update("record-0", records["record-0"], [&records] { return records; });
+
+    EXPECT_FALSE(QFile::exists(journal_path));
+    EXPECT_EQ(mp::JournaledRecords::read(db_path), records);
+}
+
+TEST_F(JournaledRecords, removes_records_journaled_as_null)
+{
+    mp::JournaledRecords db{db_path};
+    auto records = records_with(2);
+    db.write(records);
+
+    records.remove("record-0");
+    db.update("record-0", QJsonValue{}, [&records] { return records; });
+
+    EXPECT_EQ(mp::JournaledRecords::read(db_path), records);
+}
+
+TEST_F(JournaledRecords, folds_the_journal_in_once_it_grows)
+{
+    mp::JournaledRecords db{db_path, 4};
+    auto records = records_with(2);
+    db.write(records);
+
+    auto writes_in_full = 0;
+    for (auto i = 0; i < 5; ++i)
+    {
+        records["record-0"] = QJsonObject{{"value", 100 + i}};
+        db.update("record-0", records["record-0"], [&records, &writes_in_full] {
+            ++writes_in_full;
+            return records;
+        });
+    }
+
+    EXPECT_EQ(writes_in_full, 1);
+    EXPECT_FALSE(QFile::exists(journal_path));
+    EXPECT_EQ(mp::JournaledRecords::read(db_path), records);
+}
+
+TEST_F(JournaledRecords, ignores_a_journal_kept_for_another_database)
+{
+    mp::JournaledRecords db{db_path};
+    const auto records = records_with(2);
+    db.write(records);
+    db.update("record-0", QJsonValue{}, [&records] { return records; });
+
+    // As if the daemon went down between writing the database and removing the journal
+    mpt::make_file_with_content(db_path, QJsonDocument{records}.toJson().append(' ').toStdString());
+
+    EXPECT_EQ(mp::JournaledRecords::read(db_path), records);
+}
+
+TEST_F(JournaledRecords, stops_at_a_line_cut_short)
+{
+    mp::JournaledRecords db{db_path};
+    auto records = records_with(1);
+    db.write(records);
+    db.update("record-0", QJsonObject{{"value", 7}}, [&records] { return records; });
+
+    QFile journal{journal_path};
+    ASSERT_TRUE(journal.open(QIODevice::Append));
+    journal.write(R"({"record-0": {"val)");
+    journal.close();
+
+    EXPECT_EQ(mp::JournaledRecords::read(db_path)["record-0"].toObject()["value"].toInt(), 7);
+}
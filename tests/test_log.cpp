@@ -0,0 +1,108 @@
+/*
+ * Copyright (C) Canonical, Ltd.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; version 3.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#include "common.h"
+#include "mock_logger.h"
+
+#include <multipass/logging/log.h>
+#include <multipass/logging/metrics.h>
+
+namespace mpl = multipass::logging;
+namespace mpt = multipass::test;
+
+using namespace testing;
+
+namespace
+{
+// Counts how often it is formatted
+struct Formatted
+{
+    int& count;
+};
+} // namespace
+
+template <>
+struct fmt::formatter<Formatted> : formatter<int>
+{
+    template <typename FormatContext>
+    auto format(const Formatted& formatted, FormatContext& ctx) const
+    {
+        return formatter<int>::format(++formatted.count, ctx);
+    }
+};
+
+namespace
+{
+struct Log : public Test
+{
+    ~Log()
+    {
+        mpl::clear_category_levels();
+    }
+
+    mpt::MockLogger::Scope logger_scope = mpt::MockLogger::inject(mpl::Level::info);
+    int formatted{0};
+};
+} // namespace
+
+TEST_F(Log, formats_only_what_the_logger_takes)
+{
+    logger_scope.mock_logger->screen_logs(mpl::Level::trace);
+    logger_scope.mock_logger->expect_log(mpl::Level::info, "formatted 1");
+
+    mpl::log(mpl::Level::debug, "test", "formatted {}", Formatted{formatted});
+    mpl::log(mpl::Level::info, "test", "formatted {}", Formatted{formatted});
+
+    EXPECT_EQ(formatted, 1);
+}
+
+TEST_F(Log, category_levels_cap_what_their_category_logs)
+{
+    mpl::set_category_level("quiet", mpl::Level::error);
+
+    logger_scope.mock_logger->screen_logs(mpl::Level::trace);
+    logger_scope.mock_logger->expect_log(mpl::Level::info, "loud");
+    logger_scope.mock_logger->expect_log(mpl::Level::error, "quiet but failing");
+
+    mpl::log(mpl::Level::info, "quiet", "quiet");
+    mpl::log(mpl::Level::info, "quiet", "quiet {}", Formatted{formatted});
+    mpl::log(mpl::Level::info, "loud", "loud");
+    mpl::log(mpl::Level::error, "quiet", "quiet but failing");
+
+    EXPECT_FALSE(mpl::enabled(mpl::Level::warning, "quiet"));
+    EXPECT_TRUE(mpl::enabled(mpl::Level::warning, "loud"));
+    EXPECT_EQ(formatted, 0);
+}
+
+TEST_F(Log, records_reach_loggers_without_fields_of_their_own_as_text)
+{
+    logger_scope.mock_logger->screen_logs(mpl::Level::trace);
+    logger_scope.mock_logger->expect_log(mpl::Level::info, "Stopping instance=foo target=/mnt");
+
+    mpl::log(mpl::Record{mpl::Level::info, "test", "Stopping", "foo", {{"target", "/mnt"}}});
+}
+
+TEST_F(Log, counts_messages_by_category_and_level)
+{
+    logger_scope.mock_logger->screen_logs(mpl::Level::error);
+
+    mpl::log(mpl::Level::info, "counted", "once");
+    mpl::log(mpl::Record{mpl::Level::info, "counted", "twice"});
+
+    EXPECT_THAT(MP_METRICS.exposition(),
+                HasSubstr("multipass_log_messages_total{category=\"counted\",level=\"info\"} 2"));
+}
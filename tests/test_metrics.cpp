@@ -0,0 +1,111 @@
+/*
+ * Copyright (C) Canonical, Ltd.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; version 3.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#include "common.h"
+
+#include <multipass/logging/metrics.h>
+
+#include <stdexcept>
+
+namespace mpl = multipass::logging;
+
+using namespace std::chrono_literals;
+using namespace testing;
+
+namespace
+{
+struct Metrics : public Test
+{
+    // Whatever else ran in this process may have counted things already
+    struct ResettableMetrics : public mpl::Metrics
+    {
+        static void reset_instance()
+        {
+            reset();
+        }
+    };
+
+    Metrics()
+    {
+        ResettableMetrics::reset_instance();
+    }
+
+    ~Metrics()
+    {
+        ResettableMetrics::reset_instance();
+    }
+};
+} // namespace
+
+TEST_F(Metrics, exposes_counters_and_gauges_by_label)
+{
+    MP_METRICS.increment("multipass_rpc_requests_total", {{"method", "launch"}, {"code", "0"}});
+    MP_METRICS.increment("multipass_rpc_requests_total", {{"method", "launch"}, {"code", "0"}});
+    MP_METRICS.increment("multipass_downloaded_bytes_total", {}, 1024);
+    MP_METRICS.adjust("multipass_rpc_requests_in_flight", {}, 2);
+    MP_METRICS.adjust("multipass_rpc_requests_in_flight", {}, -1);
+
+    const auto exposition = MP_METRICS.exposition();
+
+    EXPECT_THAT(exposition, HasSubstr("# TYPE multipass_rpc_requests_total counter\n"
+                                      "multipass_rpc_requests_total{code=\"0\",method=\"launch\"} 2\n"));
+    EXPECT_THAT(exposition, HasSubstr("multipass_downloaded_bytes_total 1024\n"));
+    EXPECT_THAT(exposition, HasSubstr("# TYPE multipass_rpc_requests_in_flight gauge\n"
+                                      "multipass_rpc_requests_in_flight 1\n"));
+}
+
+TEST_F(Metrics, exposes_cumulative_histogram_buckets)
+{
+    MP_METRICS.observe("launch_seconds", {{"stage", "image"}}, 20ms);
+    MP_METRICS.observe("launch_seconds", {{"stage", "image"}}, 2s);
+
+    const auto exposition = MP_METRICS.exposition();
+
+    EXPECT_THAT(exposition, HasSubstr("# TYPE launch_seconds histogram\n"));
+    EXPECT_THAT(exposition, HasSubstr("launch_seconds_bucket{stage=\"image\",le=\"0.01\"} 0\n"));
+    EXPECT_THAT(exposition, HasSubstr("launch_seconds_bucket{stage=\"image\",le=\"0.025\"} 1\n"));
+    EXPECT_THAT(exposition, HasSubstr("launch_seconds_bucket{stage=\"image\",le=\"2.5\"} 2\n"));
+    EXPECT_THAT(exposition, HasSubstr("launch_seconds_bucket{stage=\"image\",le=\"+Inf\"} 2\n"));
+    EXPECT_THAT(exposition, HasSubstr("launch_seconds_sum{stage=\"image\"} 2.02\n"));
+    EXPECT_THAT(exposition, HasSubstr("launch_seconds_count{stage=\"image\"} 2\n"));
+}
+
+TEST_F(Metrics, escapes_label_values)
+{
+    MP_METRICS.increment("multipass_mount_operations_total", {{"operation", "a \"quoted\"\\path"}});
+
+    EXPECT_THAT(MP_METRICS.exposition(), HasSubstr("{operation=\"a \\\"quoted\\\"\\\\path\"} 1\n"));
+}
+
+TEST_F(Metrics, refuses_a_name_used_as_another_type)
+{
+    MP_METRICS.increment("multipass_ssh_sessions_opened_total");
+
+    EXPECT_THROW(MP_METRICS.adjust("multipass_ssh_sessions_opened_total", {}, 1), std::logic_error);
+}
+
+TEST_F(Metrics, sampled_gauges_are_set_and_forgotten)
+{
+    MP_METRICS.set("multipass_instance_rss_bytes", {{"instance", "foo"}}, 1024);
+    MP_METRICS.set("multipass_instance_rss_bytes", {{"instance", "foo"}}, 2048);
+
+    EXPECT_THAT(MP_METRICS.exposition(), HasSubstr("multipass_instance_rss_bytes{instance=\"foo\"} 2048\n"));
+
+    MP_METRICS.forget("multipass_instance_rss_bytes");
+
+    EXPECT_THAT(MP_METRICS.exposition(), Not(HasSubstr("multipass_instance_rss_bytes")));
+}
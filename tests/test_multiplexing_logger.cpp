@@ -0,0 +1,133 @@
+/*
+ * Copyright (C) Canonical, Ltd.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; version 3.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#include "common.h"
+
+#include <multipass/logging/multiplexing_logger.h>
+
+#include <atomic>
+#include <future>
+#include <mutex>
+#include <string>
+#include <vector>
+
+namespace mpl = multipass::logging;
+
+using namespace testing;
+
+namespace
+{
+struct RecordingLogger : public mpl::Logger
+{
+    explicit RecordingLogger(mpl::Level level = mpl::Level::trace) : mpl::Logger{level}
+    {
+    }
+
+    void log(mpl::Level, mpl::CString, mpl::CString message) const override
+    {
+        std::lock_guard<std::mutex> lock{mutex};
+        messages.emplace_back(message.c_str());
+    }
+
+    void flush() const override
+    {
+        ++flushes;
+    }
+
+    std::vector<std::string> logged() const
+    {
+        std::lock_guard<std::mutex> lock{mutex};
+        return messages;
+    }
+
+    mutable std::mutex mutex;
+    mutable std::vector<std::string> messages;
+    mutable std::atomic<int> flushes{0};
+};
+
+// Holds up the first message until told to go on
+struct StuckLogger : public RecordingLogger
+{
+    void log(mpl::Level level, mpl::CString category, mpl::CString message) const override
+    {
+        if (logged().empty())
+        {
+            entered.set_value();
+            released.wait();
+        }
+
+        RecordingLogger::log(level, category, message);
+    }
+
+    mutable std::promise<void> entered;
+    std::shared_future<void> released;
+};
+} // namespace
+
+TEST(MultiplexingLogger, delivers_to_the_system_logger_and_those_added)
+{
+    auto system_logger = std::make_unique<RecordingLogger>();
+    auto& system = *system_logger;
+    RecordingLogger added;
+
+    mpl::MultiplexingLogger logger{std::move(system_logger)};
+    logger.log(mpl::Level::info, "test", "before");
+    logger.add_logger(&added);
+    logger.log(mpl::Level::info, "test", "after");
+    logger.flush();
+
+    EXPECT_THAT(system.logged(), ElementsAre("before", "after"));
+    EXPECT_THAT(added.logged(), ElementsAre("after"));
+
+    logger.remove_logger(&added);
+}
+
+TEST(MultiplexingLogger, slow_loggers_drop_what_does_not_fit_without_holding_up_logging)
+{
+    std::promise<void> release;
+    StuckLogger stuck;
+    stuck.released = release.get_future().share();
+
+    mpl::MultiplexingLogger logger{std::make_unique<RecordingLogger>(), 2};
+    logger.add_logger(&stuck);
+
+    logger.log(mpl::Level::info, "test", "1");
+    stuck.entered.get_future().wait();
+    for (const auto message : {"2", "3", "4", "5"})
+        logger.log(mpl::Level::info, "test", message);
+
+    release.set_value();
+    logger.remove_logger(&stuck); // once the rest is delivered
+
+    EXPECT_THAT(stuck.logged(), ElementsAre("1", HasSubstr("2 messages dropped"), "2", "3"));
+}
+
+TEST(MultiplexingLogger, only_delivers_what_loggers_take_and_flushes_them_once_caught_up)
+{
+    RecordingLogger added{mpl::Level::warning};
+
+    mpl::MultiplexingLogger logger{std::make_unique<RecordingLogger>()};
+    logger.add_logger(&added);
+    logger.log(mpl::Level::debug, "test", "too verbose");
+    logger.log(mpl::Level::error, "test", "taken");
+    logger.flush();
+
+    EXPECT_THAT(added.logged(), ElementsAre("taken"));
+    EXPECT_EQ(added.flushes, 1);
+
+    logger.remove_logger(&added);
+}
@@ -0,0 +1,157 @@
+/*
+ * Copyright (C) Canonical, Ltd.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; version 3.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#include "common.h"
+#include "temp_dir.h"
+
+#include <multipass/network_access_manager.h>
+
+#include <QEventLoop>
+#include <QLocalServer>
+#include <QLocalSocket>
+#include <QNetworkReply>
+
+#include <memory>
+#include <vector>
+
+namespace mp = multipass;
+namespace mpt = multipass::test;
+
+using namespace testing;
+
+namespace
+{
+// Stands in for LXD on its unix socket, answering each request with the next of the given responses
+struct FakeUnixSocketServer
+{
+    explicit FakeUnixSocketServer(std::vector<QByteArray> responses) : responses{std::move(responses)}
+    {
+        QObject::connect(&server, &QLocalServer::newConnection, [this] {
+            auto connection = server.nextPendingConnection();
+            ++connections;
+            QObject::connect(connection, &QLocalSocket::readyRead, [this, connection] { respond(connection); });
+        });
+
+        server.listen(temp_dir.filePath("unix.socket"));
+    }
+
+    void respond(QLocalSocket* connection)
+    {
+        received.append(connection->readAll());
+        while (received.contains("\r\n\r\n") && !responses.empty())
+        {
+            received.remove(0, received.indexOf("\r\n\r\n") + 4);
+
+            const auto response = responses.front();
+            responses.erase(responses.begin());
+            connection->write(response);
+            connection->flush();
+
+            if (response.contains("Connection: close") || hang_up_after_response)
+                connection->disconnectFromServer();
+        }
+    }
+
+    QUrl url() const
+    {
+        return QUrl{QString{"unix://multipass%1@1.0"}.arg(server.fullServerName())};
+    }
+
+    mpt::TempDir temp_dir;
+    QLocalServer server;
+    std::vector<QByteArray> responses;
+    QByteArray received;
+    int connections{0};
+    bool hang_up_after_response{false};
+};
+
+QByteArray get(mp::NetworkAccessManager& manager, const QUrl& url)
+{
+    std::unique_ptr<QNetworkReply> reply{manager.sendCustomRequest(QNetworkRequest{url}, "GET")};
+    if (!reply->isFinished())
+    {
+        QEventLoop event_loop;
+        QObject::connect(reply.get(), &QNetworkReply::finished, &event_loop, &QEventLoop::quit);
+        event_loop.exec();
+    }
+
+    return reply->readAll();
+}
+
+const QByteArray json_response{"HTTP/1.1 200 OK\r\n"
+                               "Content-Type: application/json\r\n"
+                               "Content-Length: 18\r\n\r\n"
+                               "{\"type\": \"sync\"}\r\n"};
+
+const QByteArray chunked_response{"HTTP/1.1 200 OK\r\n"
+                                  "Content-Type: application/json\r\n"
+                                  "Transfer-Encoding: chunked\r\n\r\n"
+                                  "9\r\n{\"type\": \r\n"
+                                  "7\r\n\"sync\"}\r\n"
+                                  "0\r\n\r\n"};
+} // namespace
+
+TEST(NetworkAccessManager, reusesUnixSocketConnections)
+{
+    FakeUnixSocketServer server{{json_response, chunked_response, json_response}};
+    mp::NetworkAccessManager manager;
+
+    for (auto i = 0; i < 3; ++i)
+        EXPECT_EQ(get(manager, server.url()), "{\"type\": \"sync\"}");
+
+    EXPECT_EQ(server.connections, 1);
+}
+
+TEST(NetworkAccessManager, reconnectsWhenServerAsksToClose)
+{
+    const QByteArray closing_response{"HTTP/1.1 200 OK\r\n"
+                                      "Connection: close\r\n"
+                                      "Content-Type: application/json\r\n"
+                                      "Content-Length: 16\r\n\r\n"
+                                      "{\"type\": \"sync\"}"};
+    FakeUnixSocketServer server{{closing_response, closing_response}};
+    mp::NetworkAccessManager manager;
+
+    EXPECT_EQ(get(manager, server.url()), "{\"type\": \"sync\"}");
+    EXPECT_EQ(get(manager, server.url()), "{\"type\": \"sync\"}");
+
+    EXPECT_EQ(server.connections, 2);
+}
+
+TEST(NetworkAccessManager, reconnectsWhenIdleConnectionWasClosed)
+{
+    FakeUnixSocketServer server{{json_response, json_response}};
+    server.hang_up_after_response = true;
+    mp::NetworkAccessManager manager;
+
+    EXPECT_EQ(get(manager, server.url()), "{\"type\": \"sync\"}");
+    EXPECT_EQ(get(manager, server.url()), "{\"type\": \"sync\"}");
+
+    EXPECT_EQ(server.connections, 2);
+}
+
+TEST(NetworkAccessManager, readsRepliesWithoutFramingUntilClosed)
+{
+    const QByteArray unframed_response{"HTTP/1.1 200 OK\r\n"
+                                       "Content-Type: application/json\r\n\r\n"
+                                       "{\"type\": \"sync\"}"};
+    FakeUnixSocketServer server{{unframed_response}};
+    server.hang_up_after_response = true;
+    mp::NetworkAccessManager manager;
+
+    EXPECT_EQ(get(manager, server.url()), "{\"type\": \"sync\"}");
+}
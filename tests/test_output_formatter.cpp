@@ -1338,6 +1338,21 @@ TEST_P(FormatterSuite, properly_formats_output)
     EXPECT_EQ(output, expected_output);
 }
 
+TEST_P(FormatterSuite, streams_lists_as_they_are_formatted)
+{
+    const auto& [formatter, reply, expected_output, test_name] = GetParam();
+    Q_UNUSED(test_name);
+
+    if (auto input = dynamic_cast<const mp::ListReply*>(reply))
+    {
+        auto stream = formatter->list_stream();
+        auto output = stream->add(*input);
+        output += stream->finish();
+
+        EXPECT_EQ(output, expected_output);
+    }
+}
+
 INSTANTIATE_TEST_SUITE_P(OrderableListInfoOutputFormatter, FormatterSuite,
                          ValuesIn(orderable_list_info_formatter_outputs), print_param_name);
 INSTANTIATE_TEST_SUITE_P(NonOrderableListInfoOutputFormatter, FormatterSuite,
@@ -1348,6 +1363,57 @@ INSTANTIATE_TEST_SUITE_P(NonOrderableNetworksOutputFormatter, FormatterSuite,
 INSTANTIATE_TEST_SUITE_P(VersionInfoOutputFormatter, FormatterSuite, ValuesIn(version_formatter_outputs),
                          print_param_name);
 
+TEST(OutputFormatter, streamsListsAnInstanceAtATime)
+{
+    const auto reply = construct_unsorted_list_reply();
+
+    for (const mp::Formatter* formatter : {static_cast<const mp::Formatter*>(&table_formatter),
+                                           static_cast<const mp::Formatter*>(&json_formatter)})
+    {
+        auto stream = formatter->list_stream();
+
+        std::string output;
+        for (const auto& instance : reply.instances())
+        {
+            mp::ListReply chunk;
+            *chunk.add_instances() = instance;
+            output += stream->add(chunk);
+        }
+        output += stream->finish();
+
+        EXPECT_EQ(output, formatter->format(reply));
+    }
+}
+
+TEST(OutputFormatter, showsLimitsOfInstancesHeldToThem)
+{
+    auto reply = construct_single_instance_info_reply();
+    reply.mutable_info(0)->set_network_limit("100");
+    reply.mutable_info(0)->set_disk_iops_limit("500");
+
+    EXPECT_THAT(mp::TableFormatter().format(reply),
+                AllOf(HasSubstr("Network limit:  100 Mbit/s\n"), HasSubstr("Disk limit:     500 IOPS\n")));
+    EXPECT_THAT(mp::JsonFormatter().format(reply), HasSubstr("\"network_mbits\": 100"));
+    EXPECT_THAT(mp::YamlFormatter().format(reply), HasSubstr("disk_iops: 500"));
+    EXPECT_THAT(mp::TableFormatter().format(single_instance_info_reply), Not(HasSubstr("limit")));
+}
+
+TEST(OutputFormatter, showsHostStatsWhenTheBackendHasThem)
+{
+    auto reply = construct_single_instance_info_reply();
+    auto stats = reply.mutable_info(0)->mutable_host_stats();
+    stats->set_cpu_time_ns(12'500'000'000);
+    stats->set_steal_time_ns(250'000'000);
+    stats->set_disk_read_bytes(2048);
+
+    EXPECT_THAT(mp::TableFormatter().format(reply),
+                AllOf(HasSubstr("Host CPU time:  12.50s, 0.25s of it stolen\n"),
+                      HasSubstr("Host disk I/O:  2.0KiB read, 0B written\n")));
+    EXPECT_THAT(mp::JsonFormatter().format(reply), HasSubstr("\"steal_time_ns\": 250000000"));
+    EXPECT_THAT(mp::YamlFormatter().format(reply), HasSubstr("disk_read_bytes: 2048"));
+    EXPECT_THAT(mp::TableFormatter().format(single_instance_info_reply), Not(HasSubstr("Host CPU")));
+}
+
 #if GTEST_HAS_POSIX_RE
 TEST_P(PetenvFormatterSuite, pet_env_first_in_output)
 {
@@ -309,4 +309,45 @@ TEST_F(TestPersistentSettingsHandler, setThrowsInterpreterExceptions)
     MP_EXPECT_THROW_THAT(handler.set(key, val), mp::InvalidSettingException, mpt::match_what(HasSubstr(error)));
 }
 
+TEST_F(TestPersistentSettingsHandler, getReadsTheFileOnlyOnceForEachKey)
+{
+    const auto key = "cached.key", val = "read once";
+    const auto handler = make_handler(key);
+
+    EXPECT_CALL(*mock_qsettings, value_impl(Eq(key), _)).WillOnce(Return(val));
+
+    inject_mock_qsettings(); // once only
+
+    EXPECT_EQ(handler.get(key), QString{val});
+    EXPECT_EQ(handler.get(key), QString{val});
+}
+
+TEST_F(TestPersistentSettingsHandler, getReturnsWhatWasSetWithoutReadingTheFile)
+{
+    const auto key = "set.key", val = "just set";
+    auto handler = make_handler(key);
+
+    EXPECT_CALL(*mock_qsettings, setValue(Eq(key), Eq(val)));
+    EXPECT_CALL(*mock_qsettings, value_impl).Times(0);
+
+    inject_mock_qsettings(); // for the set only
+
+    handler.set(key, val);
+    EXPECT_EQ(handler.get(key), QString{val});
+}
+
+TEST_F(TestPersistentSettingsHandler, setValuesWritesAllOnceAfterCheckingThem)
+{
+    const auto key = "checked.key", other_key = "other.key";
+    auto handler = make_handler(key, "default", [](QString v) { return v.toUpper(); });
+
+    EXPECT_CALL(*mock_qsettings, setValue(Eq(key), Eq(QStringLiteral("ONE"))));
+    EXPECT_CALL(*mock_qsettings, setValue(Eq("a.key"), Eq(QStringLiteral("two"))));
+    EXPECT_CALL(*mock_qsettings, sync).Times(1);
+
+    inject_mock_qsettings(); // once only
+
+    handler.set_values({{key, "one"}, {"a.key", "two"}, {other_key, "not this handler's"}});
+}
+
 } // namespace
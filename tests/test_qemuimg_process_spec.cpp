@@ -107,6 +107,14 @@ TEST(TestQemuImgProcessSpec, apparmor_profile_running_as_snap_with_only_target_c
     EXPECT_TRUE(spec.apparmor_profile().contains(QString("%1 rwk,").arg(target_image)));
 }
 
+TEST(TestQemuImgProcessSpec, apparmor_profile_lets_backing_snapshots_be_read)
+{
+    mp::QemuImgProcessSpec spec({}, "/source/image/file", "/target/snapshots/file.qcow2");
+
+    EXPECT_TRUE(spec.apparmor_profile().contains("/source/image/{,snapshots/}*.qcow2 rk,"));
+    EXPECT_TRUE(spec.apparmor_profile().contains("/target/snapshots/{,snapshots/}*.qcow2 rk,"));
+}
+
 TEST(TestQemuImgProcessSpec,
      DISABLE_ON_WINDOWS(apparmor_profile_running_as_symlinked_snap_correct)) // TODO tests involving apparmor should
                                                                              // probably be moved elsewhere
@@ -0,0 +1,92 @@
+/*
+ * Copyright (C) Canonical, Ltd.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; version 3.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#include "common.h"
+
+#include <src/daemon/resource_accountant.h>
+#include <src/daemon/vm_specs.h>
+
+#include <string>
+#include <unordered_map>
+
+namespace mp = multipass;
+using namespace testing;
+
+namespace
+{
+struct ResourceAccountant : public Test
+{
+    void add_instance(const std::string& name, int cpus, const std::string& memory, const std::string& disk,
+                      mp::VirtualMachine::State state, bool deleted = false)
+    {
+        instances[name] = {cpus, mp::MemorySize{memory}, mp::MemorySize{disk}, "", {}, "", state, {}, deleted, {}};
+    }
+
+    const mp::platform::HostCapacity capacity{4, mp::MemorySize{"8G"}.in_bytes(), mp::MemorySize{"100G"}.in_bytes()};
+    std::unordered_map<std::string, mp::VMSpecs> instances;
+};
+} // namespace
+
+TEST_F(ResourceAccountant, admits_what_fits_within_the_ratios)
+{
+    add_instance("running", 4, "4G", "20G", mp::VirtualMachine::State::running);
+    const mp::ResourceAccountant accountant{capacity, {2, 1, 1}};
+
+    EXPECT_EQ(accountant.refusal(instances, 4, mp::MemorySize{"4G"}, mp::MemorySize{"20G"}), std::nullopt);
+}
+
+TEST_F(ResourceAccountant, refuses_what_takes_cpus_past_their_ratio)
+{
+    add_instance("running", 6, "1G", "5G", mp::VirtualMachine::State::running);
+    const mp::ResourceAccountant accountant{capacity, {2, 1, 1}};
+
+    const auto refusal = accountant.refusal(instances, 4, mp::MemorySize{"1G"}, mp::MemorySize{"5G"});
+
+    ASSERT_TRUE(refusal);
+    EXPECT_THAT(*refusal, HasSubstr("10 vCPUs would be committed, past the 8 that 4 host CPUs allow"));
+}
+
+TEST_F(ResourceAccountant, counts_cpus_and_memory_of_running_instances_only)
+{
+    add_instance("stopped", 4, "8G", "5G", mp::VirtualMachine::State::stopped);
+    add_instance("deleted", 4, "8G", "5G", mp::VirtualMachine::State::running, true);
+    const mp::ResourceAccountant accountant{capacity, {1, 1, 1}};
+
+    EXPECT_EQ(accountant.refusal(instances, 4, mp::MemorySize{"8G"}, mp::MemorySize{"5G"}), std::nullopt);
+}
+
+TEST_F(ResourceAccountant, counts_disk_of_every_instance_kept)
+{
+    add_instance("stopped", 1, "1G", "50G", mp::VirtualMachine::State::stopped);
+    add_instance("deleted", 1, "1G", "40G", mp::VirtualMachine::State::off, true);
+    const mp::ResourceAccountant accountant{capacity, {1, 1, 1}};
+
+    const auto refusal = accountant.refusal(instances, 1, mp::MemorySize{"1G"}, mp::MemorySize{"20G"});
+
+    ASSERT_TRUE(refusal);
+    EXPECT_THAT(*refusal, HasSubstr("of disk would be committed"));
+}
+
+TEST_F(ResourceAccountant, leaves_unchecked_what_has_no_ratio_or_no_known_capacity)
+{
+    add_instance("running", 64, "64G", "500G", mp::VirtualMachine::State::running);
+
+    EXPECT_EQ(mp::ResourceAccountant(capacity, {}).refusal(instances, 1, mp::MemorySize{"1G"}, mp::MemorySize{"5G"}),
+              std::nullopt);
+    EXPECT_EQ(mp::ResourceAccountant({}, {1, 1, 1}).refusal(instances, 1, mp::MemorySize{"1G"}, mp::MemorySize{"5G"}),
+              std::nullopt);
+}
@@ -394,6 +394,31 @@ INSTANTIATE_TEST_SUITE_P(TestSettings, TestSettingSetOtherExceptions,
                                         std::runtime_error{"something else"}),
                                  Values(8u), Range(0u, 8u, 2u)));
 
+TEST_F(TestSettings, getValuesAsksEachHandlerForWhatIsLeft)
+{
+    auto first = std::make_unique<MockSettingsHandler>();
+    auto second = std::make_unique<MockSettingsHandler>();
+    EXPECT_CALL(*first, get(Eq("a"))).WillOnce(Return("1"));
+    EXPECT_CALL(*first, get(Eq("b"))).WillOnce(Throw(mp::UnrecognizedSettingException{"b"}));
+    EXPECT_CALL(*second, get(Eq("b"))).WillOnce(Return("2"));
+    EXPECT_CALL(*second, get(Eq("a"))).Times(0);
+
+    MP_SETTINGS.register_handler(std::move(first));
+    MP_SETTINGS.register_handler(std::move(second));
+    EXPECT_THAT(MP_SETTINGS.get_values({"a", "b"}), ElementsAre(Pair("a", "1"), Pair("b", "2")));
+}
+
+TEST_F(TestSettings, setValuesSetsNothingWhenAnyKeyIsUnrecognized)
+{
+    auto handler = std::make_unique<MockSettingsHandler>();
+    EXPECT_CALL(*handler, keys).WillOnce(Return(std::set<QString>{"a"}));
+    EXPECT_CALL(*handler, set).Times(0);
+
+    MP_SETTINGS.register_handler(std::move(handler));
+    MP_EXPECT_THROW_THAT(MP_SETTINGS.set_values({{"a", "1"}, {"b", "2"}}), mp::UnrecognizedSettingException,
+                         mpt::match_what(HasSubstr("b")));
+}
+
 struct TestSettingsGetAs : public Test
 {
     mpt::MockSettings::GuardedMock mock_settings_injection = mpt::MockSettings::inject();
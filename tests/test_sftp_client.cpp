@@ -16,6 +16,7 @@
  */
 
 #include "common.h"
+#include "fake_key_data.h"
 #include "mock_file_ops.h"
 #include "mock_logger.h"
 #include "mock_recursive_dir_iterator.h"
@@ -30,6 +31,16 @@
 
 #include <fmt/std.h>
 
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstring>
+#include <map>
+#include <mutex>
+#include <optional>
+#include <set>
+#include <thread>
+
 namespace mp = multipass;
 namespace mpt = multipass::test;
 namespace mpl = multipass::logging;
@@ -56,6 +67,72 @@ sftp_attributes get_dummy_sftp_attr(uint8_t type = SSH_FILEXFER_TYPE_REGULAR, co
     return attr;
 }
 
+// Stands in for the server when reading asynchronously, replying with the content found where each read was asked for
+struct MockRemoteFile
+{
+    explicit MockRemoteFile(std::string content, std::uint32_t max_reply = UINT32_MAX)
+        : content{std::move(content)}, max_reply{max_reply}
+    {
+    }
+
+    auto seek()
+    {
+        return [this](auto, std::uint64_t new_offset) {
+            offset = new_offset;
+            return SSH_OK;
+        };
+    }
+
+    auto read_begin()
+    {
+        return [this](auto, std::uint32_t len) {
+            requests.emplace(next_id, std::make_pair(offset, len));
+            most_in_flight = std::max(most_in_flight, requests.size());
+            offset += len;
+            return next_id++;
+        };
+    }
+
+    auto read()
+    {
+        return [this](auto, void* data, auto, std::uint32_t id) {
+            const auto [start, len] = requests.at(id);
+            requests.erase(id);
+
+            if (start >= content.size())
+                return 0;
+
+            const auto size = std::min<std::size_t>({len, max_reply, content.size() - start});
+            std::memcpy(data, content.data() + start, size);
+            return static_cast<int>(size);
+        };
+    }
+
+    std::string content;
+    std::uint32_t max_reply;
+    std::uint64_t offset{0};
+    int next_id{0};
+    std::map<int, std::pair<std::uint64_t, std::uint32_t>> requests;
+    std::size_t most_in_flight{0};
+};
+
+// Hands out what a command run in the instance prints, a bit at a time
+auto channel_output(std::string output)
+{
+    return [output = std::move(output)](auto, void* dest, std::uint32_t count, int is_stderr, auto) mutable {
+        if (is_stderr || output.empty())
+            return 0;
+
+        const auto size = std::min<std::size_t>(count, output.size());
+        std::memcpy(dest, output.data(), size);
+        output.erase(0, size);
+        return static_cast<int>(size);
+    };
+}
+
+// What sha256sum prints for the first 4 bytes of "test_data"
+const std::string test_prefix_hash_output{"9f86d081884c7d659a2feaa0c55ad015a3bf4f1b2b0b822cd15d6c15b0f00a08  -\n"};
+
 struct SFTPClient : public testing::Test
 {
     SFTPClient()
@@ -152,6 +229,187 @@ TEST_F(SFTPClient, push_file_success)
     EXPECT_EQ(static_cast<mode_t>(status.permissions()), written_perms);
 }
 
+TEST_F(SFTPClient, push_file_sync_skips_unchanged_file)
+{
+    std::string test_data = "test_data";
+    const auto mtime = fs::file_time_type::clock::now();
+    auto status = fs::file_status{fs::file_type::regular, fs::perms::owner_read | fs::perms::owner_write};
+
+    REPLACE(sftp_init, [](auto...) { return SSH_OK; });
+    EXPECT_CALL(*mock_file_ops, is_directory(source_path, _)).WillRepeatedly(Return(false));
+    EXPECT_CALL(*mock_sftp_utils, get_remote_file_target(_, source_path, target_path, _))
+        .WillRepeatedly(Return(target_path));
+    EXPECT_CALL(*mock_file_ops, file_size(source_path, _)).WillRepeatedly(Return(test_data.size()));
+    EXPECT_CALL(*mock_file_ops, last_write_time(source_path, _)).WillRepeatedly(Return(mtime));
+    EXPECT_CALL(*mock_file_ops, status(source_path, _)).WillRepeatedly(Return(status));
+    EXPECT_CALL(*mock_file_ops, open_read(source_path, _))
+        .WillOnce(Return(std::make_unique<std::stringstream>(test_data)));
+
+    REPLACE(sftp_open, [](auto sftp, auto...) { return get_dummy_sftp_file(sftp); });
+    REPLACE(sftp_write, [](auto, auto, auto size) { return size; });
+    REPLACE(sftp_chmod, [](auto...) { return SSH_FX_OK; });
+
+    // Nothing there the first time, then what the first push left behind
+    sftp_attributes_struct remote{};
+    auto remote_exists = false;
+    REPLACE(sftp_stat, [&](auto...) {
+        if (!remote_exists)
+            return static_cast<sftp_attributes>(nullptr);
+
+        auto attr = get_dummy_sftp_attr(SSH_FILEXFER_TYPE_REGULAR, "", static_cast<mode_t>(status.permissions()));
+        attr->size = test_data.size();
+        attr->mtime = remote.mtime;
+        return attr;
+    });
+    REPLACE(sftp_setstat, [&](auto, auto, sftp_attributes attr) {
+        EXPECT_EQ(attr->flags, static_cast<std::uint32_t>(SSH_FILEXFER_ATTR_ACMODTIME));
+        remote.mtime = attr->mtime;
+        remote_exists = true;
+        return SSH_FX_OK;
+    });
+
+    auto sftp_client = make_sftp_client();
+
+    EXPECT_TRUE(sftp_client.push(source_path, target_path, mp::SFTPClient::Flag::Sync));
+    EXPECT_TRUE(remote_exists);
+    EXPECT_TRUE(sftp_client.push(source_path, target_path, mp::SFTPClient::Flag::Sync));
+}
+
+TEST_F(SFTPClient, pull_file_sync_skips_unchanged_file)
+{
+    std::string test_data = "test_data";
+    const mode_t perms = 0644;
+
+    REPLACE(sftp_init, [](auto...) { return SSH_OK; });
+    EXPECT_CALL(*mock_sftp_utils, get_local_file_target(source_path, target_path, _))
+        .WillRepeatedly(Return(target_path));
+    REPLACE(sftp_stat, [&](auto...) {
+        auto attr = get_dummy_sftp_attr(SSH_FILEXFER_TYPE_REGULAR, "", perms);
+        attr->size = test_data.size();
+        attr->mtime = 1700000000;
+        return attr;
+    });
+    EXPECT_CALL(*mock_file_ops, permissions(target_path, static_cast<fs::perms>(perms), _)).Times(2);
+
+    // Nothing there the first time, then what the first pull left behind
+    std::optional<fs::file_time_type> local_mtime;
+    EXPECT_CALL(*mock_file_ops, file_size(target_path, _)).WillRepeatedly([&](auto, std::error_code& err) {
+        if (!local_mtime)
+            err = std::make_error_code(std::errc::no_such_file_or_directory);
+        return test_data.size();
+    });
+    EXPECT_CALL(*mock_file_ops, last_write_time(target_path, _)).WillRepeatedly([&](auto, std::error_code& err) {
+        err.clear();
+        return local_mtime.value();
+    });
+    EXPECT_CALL(*mock_file_ops, status(target_path, _))
+        .WillRepeatedly(Return(fs::file_status{fs::file_type::regular, static_cast<fs::perms>(perms)}));
+    EXPECT_CALL(*mock_file_ops, last_write_time(target_path, _, _)).WillOnce([&](auto, auto time, auto) {
+        local_mtime = time;
+    });
+
+    EXPECT_CALL(*mock_file_ops, open_write(target_path, _)).WillOnce(Return(std::make_unique<std::stringstream>()));
+    REPLACE(sftp_open, [](auto sftp, auto...) { return get_dummy_sftp_file(sftp); });
+    MockRemoteFile remote_file{test_data};
+    REPLACE(sftp_seek64, remote_file.seek());
+    REPLACE(sftp_async_read_begin, remote_file.read_begin());
+    REPLACE(sftp_async_read, remote_file.read());
+
+    auto sftp_client = make_sftp_client();
+
+    EXPECT_TRUE(sftp_client.pull(source_path, target_path, mp::SFTPClient::Flag::Sync));
+    ASSERT_TRUE(local_mtime);
+    EXPECT_TRUE(sftp_client.pull(source_path, target_path, mp::SFTPClient::Flag::Sync));
+}
+
+TEST_F(SFTPClient, push_file_resume_continues_matching_partial_target)
+{
+    std::string test_data = "test_data";
+
+    REPLACE(sftp_init, [](auto...) { return SSH_OK; });
+    EXPECT_CALL(*mock_file_ops, is_directory(source_path, _)).WillOnce(Return(false));
+    EXPECT_CALL(*mock_sftp_utils, get_remote_file_target(_, source_path, target_path, _)).WillOnce(Return(target_path));
+    EXPECT_CALL(*mock_file_ops, file_size(source_path, _)).WillOnce(Return(test_data.size()));
+    EXPECT_CALL(*mock_file_ops, open_read(source_path, _))
+        .WillOnce(Return(std::make_unique<std::stringstream>(test_data)))
+        .WillOnce(Return(std::make_unique<std::stringstream>(test_data)));
+    EXPECT_CALL(*mock_file_ops, status(source_path, _))
+        .WillOnce(Return(fs::file_status{fs::file_type::regular, fs::perms::all}));
+    REPLACE(sftp_stat, [](auto...) {
+        auto attr = get_dummy_sftp_attr();
+        attr->size = 4;
+        return attr;
+    });
+
+    std::string remote_cmd;
+    REPLACE(ssh_channel_request_exec, [&remote_cmd](auto, const char* cmd) {
+        remote_cmd = cmd;
+        return SSH_OK;
+    });
+    REPLACE(ssh_channel_read_timeout, channel_output(test_prefix_hash_output));
+
+    int open_flags{0};
+    REPLACE(sftp_open, [&open_flags](auto sftp, auto, int flags, auto) {
+        open_flags = flags;
+        return get_dummy_sftp_file(sftp);
+    });
+    std::uint64_t seek_offset{0};
+    REPLACE(sftp_seek64, [&seek_offset](auto, std::uint64_t offset) {
+        seek_offset = offset;
+        return SSH_OK;
+    });
+    std::string written;
+    REPLACE(sftp_write, [&written](auto, const void* data, auto size) {
+        written.append(static_cast<const char*>(data), size);
+        return size;
+    });
+    REPLACE(sftp_chmod, [](auto...) { return SSH_FX_OK; });
+
+    auto sftp_client = make_sftp_client();
+
+    EXPECT_TRUE(sftp_client.push(source_path, target_path, mp::SFTPClient::Flag::Resume));
+    EXPECT_THAT(remote_cmd, HasSubstr("head -c 4"));
+    EXPECT_FALSE(open_flags & O_TRUNC);
+    EXPECT_EQ(seek_offset, 4u);
+    EXPECT_EQ(written, "_data");
+}
+
+TEST_F(SFTPClient, pull_file_resume_starts_over_when_partial_target_differs)
+{
+    std::string test_data = "test_data";
+
+    REPLACE(sftp_init, [](auto...) { return SSH_OK; });
+    EXPECT_CALL(*mock_sftp_utils, get_local_file_target(source_path, target_path, _)).WillOnce(Return(target_path));
+    REPLACE(sftp_stat, [&test_data](auto...) {
+        auto attr = get_dummy_sftp_attr();
+        attr->size = test_data.size();
+        return attr;
+    });
+    EXPECT_CALL(*mock_file_ops, file_size(target_path, _)).WillOnce(Return(4));
+    EXPECT_CALL(*mock_file_ops, open_read(target_path, _))
+        .WillOnce(Return(std::make_unique<std::stringstream>("best")));
+    REPLACE(ssh_channel_read_timeout, channel_output(test_prefix_hash_output));
+
+    std::ios_base::openmode mode{};
+    EXPECT_CALL(*mock_file_ops, open_write(target_path, _)).WillOnce([&mode](auto, auto open_mode) {
+        mode = open_mode;
+        return std::make_unique<std::stringstream>();
+    });
+    EXPECT_CALL(*mock_file_ops, permissions(target_path, _, _));
+
+    REPLACE(sftp_open, [](auto sftp, auto...) { return get_dummy_sftp_file(sftp); });
+    MockRemoteFile remote_file{test_data};
+    REPLACE(sftp_seek64, remote_file.seek());
+    REPLACE(sftp_async_read_begin, remote_file.read_begin());
+    REPLACE(sftp_async_read, remote_file.read());
+
+    auto sftp_client = make_sftp_client();
+
+    EXPECT_TRUE(sftp_client.pull(source_path, target_path, mp::SFTPClient::Flag::Resume));
+    EXPECT_TRUE(mode & std::ios_base::trunc);
+    EXPECT_FALSE(mode & std::ios_base::app);
+}
+
 TEST_F(SFTPClient, push_file_cannot_open_source)
 {
     REPLACE(sftp_init, [](auto...) { return SSH_OK; });
@@ -278,11 +536,10 @@ TEST_F(SFTPClient, pull_file_success)
     EXPECT_CALL(*mock_file_ops, open_write(target_path, _)).WillOnce(Return(std::move(tee_stream)));
     REPLACE(sftp_open, [](auto sftp, auto...) { return get_dummy_sftp_file(sftp); });
 
-    auto mocked_sftp_read = [&, read = false](auto, void* data, auto) mutable {
-        strcpy((char*)data, test_data.c_str());
-        return (read = !read) ? test_data.size() : 0;
-    };
-    REPLACE(sftp_read, mocked_sftp_read);
+    MockRemoteFile remote_file{test_data};
+    REPLACE(sftp_seek64, remote_file.seek());
+    REPLACE(sftp_async_read_begin, remote_file.read_begin());
+    REPLACE(sftp_async_read, remote_file.read());
 
     mode_t perms = 0777;
     REPLACE(sftp_stat, [&](auto...) { return get_dummy_sftp_attr(SSH_FILEXFER_TYPE_REGULAR, "", perms); });
@@ -344,13 +601,16 @@ TEST_F(SFTPClient, pull_file_cannot_write_target)
     REPLACE(sftp_open, [](auto sftp, auto...) { return get_dummy_sftp_file(sftp); });
 
     auto err = EACCES;
-    auto mocked_sftp_read = [&, read = false](auto...) mutable {
+    MockRemoteFile remote_file{"0123456789"};
+    REPLACE(sftp_seek64, remote_file.seek());
+    REPLACE(sftp_async_read_begin, remote_file.read_begin());
+    auto mocked_sftp_async_read = [&, read = remote_file.read()](auto... args) mutable {
         test_file_p->clear();
         test_file_p->setstate(std::ios_base::failbit);
         errno = err;
-        return (read = !read) ? 10 : 0;
+        return read(args...);
     };
-    REPLACE(sftp_read, mocked_sftp_read);
+    REPLACE(sftp_async_read, mocked_sftp_async_read);
     REPLACE(sftp_stat, [&](auto...) { return get_dummy_sftp_attr(); });
     EXPECT_CALL(*mock_file_ops, permissions(target_path, _, _));
     REPLACE(sftp_setstat, [](auto...) { return SSH_FX_OK; });
@@ -370,7 +630,10 @@ TEST_F(SFTPClient, pull_file_cannot_read_source)
     EXPECT_CALL(*mock_file_ops, open_write(target_path, _)).WillOnce(Return(std::make_unique<std::stringstream>()));
     REPLACE(sftp_open, [](auto sftp, auto...) { return get_dummy_sftp_file(sftp); });
 
-    REPLACE(sftp_read, [](auto...) { return -1; });
+    MockRemoteFile remote_file{""};
+    REPLACE(sftp_seek64, remote_file.seek());
+    REPLACE(sftp_async_read_begin, remote_file.read_begin());
+    REPLACE(sftp_async_read, [](auto...) { return -1; });
     auto err = "SFTP server: Permission denied";
     REPLACE(ssh_get_error, [&](auto...) { return err; });
 
@@ -386,7 +649,10 @@ TEST_F(SFTPClient, pull_file_cannot_set_perms)
     EXPECT_CALL(*mock_sftp_utils, get_local_file_target(source_path, target_path, _)).WillOnce(Return(target_path));
     EXPECT_CALL(*mock_file_ops, open_write(target_path, _)).WillOnce(Return(std::make_unique<std::stringstream>()));
     REPLACE(sftp_open, [](auto sftp, auto...) { return get_dummy_sftp_file(sftp); });
-    REPLACE(sftp_read, [read = false](auto...) mutable { return (read = !read) ? 10 : 0; });
+    MockRemoteFile remote_file{"0123456789"};
+    REPLACE(sftp_seek64, remote_file.seek());
+    REPLACE(sftp_async_read_begin, remote_file.read_begin());
+    REPLACE(sftp_async_read, remote_file.read());
 
     mode_t perms = 0777;
     REPLACE(sftp_stat, [&](auto...) { return get_dummy_sftp_attr(SSH_FILEXFER_TYPE_REGULAR, "", perms); });
@@ -401,6 +667,69 @@ TEST_F(SFTPClient, pull_file_cannot_set_perms)
     EXPECT_FALSE(sftp_client.pull(source_path, target_path));
 }
 
+TEST_F(SFTPClient, pull_file_keeps_reads_in_flight)
+{
+    REPLACE(sftp_init, [](auto...) { return SSH_OK; });
+    REPLACE(sftp_open, [](auto sftp, auto...) { return get_dummy_sftp_file(sftp); });
+
+    MockRemoteFile remote_file{std::string(3 * 65536 + 5, 'x')};
+    REPLACE(sftp_seek64, remote_file.seek());
+    REPLACE(sftp_async_read_begin, remote_file.read_begin());
+    REPLACE(sftp_async_read, remote_file.read());
+
+    auto sftp_client = make_sftp_client();
+
+    std::stringstream pulled;
+    sftp_client.to_cout(source_path, pulled);
+
+    EXPECT_EQ(pulled.str(), remote_file.content);
+    EXPECT_EQ(remote_file.most_in_flight, 16u);
+    EXPECT_TRUE(remote_file.requests.empty());
+}
+
+TEST_F(SFTPClient, pull_file_uses_window_it_is_given)
+{
+    REPLACE(sftp_init, [](auto...) { return SSH_OK; });
+    REPLACE(sftp_open, [](auto sftp, auto...) { return get_dummy_sftp_file(sftp); });
+
+    MockRemoteFile remote_file{std::string(5 * 65536, 'x')};
+    REPLACE(sftp_seek64, remote_file.seek());
+    REPLACE(sftp_async_read_begin, remote_file.read_begin());
+    REPLACE(sftp_async_read, remote_file.read());
+
+    auto sftp_client = make_sftp_client();
+    sftp_client.set_transfer_window(2);
+
+    std::stringstream pulled;
+    sftp_client.to_cout(source_path, pulled);
+
+    EXPECT_EQ(pulled.str(), remote_file.content);
+    EXPECT_EQ(remote_file.most_in_flight, 2u);
+}
+
+TEST_F(SFTPClient, pull_file_resumes_after_short_reads)
+{
+    REPLACE(sftp_init, [](auto...) { return SSH_OK; });
+    REPLACE(sftp_open, [](auto sftp, auto...) { return get_dummy_sftp_file(sftp); });
+
+    std::string content;
+    for (auto i = 0; i < 10000; ++i)
+        content += std::to_string(i);
+
+    MockRemoteFile remote_file{content, 1000};
+    REPLACE(sftp_seek64, remote_file.seek());
+    REPLACE(sftp_async_read_begin, remote_file.read_begin());
+    REPLACE(sftp_async_read, remote_file.read());
+
+    auto sftp_client = make_sftp_client();
+
+    std::stringstream pulled;
+    sftp_client.to_cout(source_path, pulled);
+
+    EXPECT_EQ(pulled.str(), content);
+    EXPECT_TRUE(remote_file.requests.empty());
+}
+
 TEST_F(SFTPClient, push_dir_success_regular)
 {
     REPLACE(sftp_init, [](auto...) { return SSH_OK; });
@@ -440,6 +769,66 @@ TEST_F(SFTPClient, push_dir_success_regular)
     EXPECT_EQ(test_data, written_data);
 }
 
+TEST_F(SFTPClient, push_dir_spreads_files_over_parallel_clients)
+{
+    REPLACE(sftp_init, [](auto...) { return SSH_OK; });
+    EXPECT_CALL(*mock_file_ops, is_directory(source_path, _)).WillOnce(Return(true));
+    EXPECT_CALL(*mock_sftp_utils, get_remote_dir_target(_, source_path, target_path, _)).WillOnce(Return(target_path));
+
+    constexpr auto file_count = 20;
+    auto iter = std::make_unique<mpt::MockRecursiveDirIterator>();
+    auto iter_p = iter.get();
+    EXPECT_CALL(*mock_file_ops, recursive_dir_iterator(source_path, _)).WillOnce(Return(std::move(iter)));
+    EXPECT_CALL(*iter_p, hasNext).WillRepeatedly([n = 0]() mutable { return n++ < file_count; });
+
+    mpt::MockDirectoryEntry entry;
+    auto status = fs::file_status{fs::file_type::regular, fs::perms::all};
+    fs::path path{"file"};
+    EXPECT_CALL(entry, path).WillRepeatedly(ReturnRef(path));
+    EXPECT_CALL(entry, symlink_status()).WillRepeatedly(Return(status));
+    EXPECT_CALL(*iter_p, next).WillRepeatedly(ReturnRef(entry));
+
+    std::string test_data = "test_data";
+    EXPECT_CALL(*mock_file_ops, open_read).WillRepeatedly([&](auto...) {
+        return std::make_unique<std::stringstream>(test_data);
+    });
+    EXPECT_CALL(*mock_file_ops, status).WillRepeatedly(Return(status));
+
+    // Called from the clients' own threads
+    std::mutex mutex;
+    std::set<sftp_session> sessions_used;
+    std::atomic_int files_written{0};
+    REPLACE(sftp_open, [&](auto sftp, auto...) {
+        std::lock_guard<std::mutex> lock{mutex};
+        sessions_used.insert(sftp);
+        return get_dummy_sftp_file(sftp);
+    });
+    REPLACE(sftp_write, [](auto, auto, auto size) {
+        std::this_thread::sleep_for(std::chrono::milliseconds{5});
+        return size;
+    });
+    REPLACE(sftp_close, [&](auto file) {
+        ++files_written;
+        std::free(file);
+        return SSH_OK;
+    });
+
+    auto files_written_before_dir_perms = -1;
+    REPLACE(sftp_chmod, [&](auto, auto chmod_path, auto) {
+        if (target_path == chmod_path)
+            files_written_before_dir_perms = files_written;
+        return SSH_FX_OK;
+    });
+
+    mp::SFTPClient sftp_client{"b", 43, "ubuntu", mpt::fake_key_data};
+    sftp_client.set_parallel_transfers(3);
+
+    EXPECT_TRUE(sftp_client.push(source_path, target_path, mp::SFTPClient::Flag::Recursive));
+    EXPECT_EQ(files_written, file_count);
+    EXPECT_EQ(files_written_before_dir_perms, file_count);
+    EXPECT_GT(sessions_used.size(), 1u);
+}
+
 TEST_F(SFTPClient, push_dir_success_dir)
 {
     REPLACE(sftp_init, [](auto...) { return SSH_OK; });
@@ -726,11 +1115,10 @@ TEST_F(SFTPClient, pull_dir_success_regular)
     EXPECT_CALL(*mock_file_ops, open_write).WillOnce(Return(std::move(tee_stream)));
     REPLACE(sftp_open, [](auto sftp, auto...) { return get_dummy_sftp_file(sftp); });
 
-    auto mocked_sftp_read = [&, read = false](auto, const void* data, auto size) mutable {
-        strcpy((char*)data, test_data.c_str());
-        return (read = !read) ? test_data.size() : 0;
-    };
-    REPLACE(sftp_read, mocked_sftp_read);
+    MockRemoteFile remote_file{test_data};
+    REPLACE(sftp_seek64, remote_file.seek());
+    REPLACE(sftp_async_read_begin, remote_file.read_begin());
+    REPLACE(sftp_async_read, remote_file.read());
 
     mode_t perms = 0777;
     REPLACE(sftp_stat, [&](auto, auto path) {
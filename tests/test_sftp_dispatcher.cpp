@@ -0,0 +1,167 @@
+/*
+ * Copyright (C) Canonical, Ltd.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; version 3.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#include "common.h"
+
+#include <src/sshfs_mount/sftp_dispatcher.h>
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <stdexcept>
+#include <thread>
+#include <vector>
+
+namespace mp = multipass;
+
+using namespace std::chrono_literals;
+using namespace testing;
+
+TEST(SftpDispatcher, runs_tasks_with_same_key_in_order)
+{
+    std::mutex order_mutex;
+    std::vector<int> order;
+
+    {
+        mp::SftpDispatcher dispatcher{4};
+        for (auto i = 0; i < 100; ++i)
+            dispatcher.dispatch("handle", [i, &order, &order_mutex] {
+                std::lock_guard<std::mutex> lock{order_mutex};
+                order.push_back(i);
+            });
+
+        dispatcher.wait_for_idle();
+    }
+
+    ASSERT_THAT(order, SizeIs(100));
+    EXPECT_TRUE(std::is_sorted(order.cbegin(), order.cend()));
+}
+
+TEST(SftpDispatcher, runs_tasks_with_different_keys_concurrently)
+{
+    mp::SftpDispatcher dispatcher{2};
+
+    std::promise<void> second_ran;
+    std::atomic_bool first_saw_second{false};
+
+    dispatcher.dispatch("slow", [&first_saw_second, second_done = second_ran.get_future().share()] {
+        first_saw_second = second_done.wait_for(5s) == std::future_status::ready;
+    });
+    dispatcher.dispatch("fast", [&second_ran] { second_ran.set_value(); });
+
+    dispatcher.wait_for_idle();
+
+    EXPECT_TRUE(first_saw_second);
+}
+
+TEST(SftpDispatcher, does_not_run_same_key_tasks_concurrently)
+{
+    mp::SftpDispatcher dispatcher{4};
+
+    std::atomic_int running{0};
+    std::atomic_int max_running{0};
+
+    for (auto i = 0; i < 20; ++i)
+        dispatcher.dispatch("handle", [&running, &max_running] {
+            auto now_running = ++running;
+            max_running = std::max(max_running.load(), now_running);
+            std::this_thread::sleep_for(1ms);
+            --running;
+        });
+
+    dispatcher.wait_for_idle();
+
+    EXPECT_EQ(max_running, 1);
+}
+
+TEST(SftpDispatcher, idle_reflects_outstanding_work)
+{
+    mp::SftpDispatcher dispatcher{1};
+    EXPECT_TRUE(dispatcher.idle());
+
+    std::promise<void> release;
+    dispatcher.dispatch("key", [done = release.get_future().share()] { done.wait(); });
+
+    EXPECT_FALSE(dispatcher.idle());
+
+    release.set_value();
+    dispatcher.wait_for_idle();
+
+    EXPECT_TRUE(dispatcher.idle());
+}
+
+TEST(SftpDispatcher, keeps_going_when_a_task_throws)
+{
+    mp::SftpDispatcher dispatcher{1};
+    bool ran{false};
+
+    dispatcher.dispatch("key", [] { throw std::runtime_error{"boom"}; });
+    dispatcher.dispatch("key", [&ran] { ran = true; });
+
+    dispatcher.wait_for_idle();
+
+    EXPECT_TRUE(ran);
+}
+
+TEST(SftpDispatcher, finishes_outstanding_work_on_destruction)
+{
+    std::atomic_int count{0};
+
+    {
+        mp::SftpDispatcher dispatcher{2};
+        for (auto i = 0; i < 10; ++i)
+            dispatcher.dispatch(std::to_string(i % 3), [&count] { ++count; });
+    }
+
+    EXPECT_EQ(count, 10);
+}
+
+TEST(SftpDispatchQueue, idles_regardless_of_other_queues_on_the_dispatcher)
+{
+    auto dispatcher = std::make_shared<mp::SftpDispatcher>(2);
+    mp::SftpDispatchQueue busy_queue{dispatcher};
+    mp::SftpDispatchQueue other_queue{dispatcher};
+
+    std::promise<void> release;
+    busy_queue.dispatch("key", [done = release.get_future().share()] { done.wait(); });
+
+    bool ran{false};
+    other_queue.dispatch("key", [&ran] { ran = true; }); // the same key, but not the same queue's
+    other_queue.wait_for_idle();
+
+    EXPECT_TRUE(ran);
+    EXPECT_TRUE(other_queue.idle());
+    EXPECT_FALSE(busy_queue.idle());
+
+    release.set_value();
+    busy_queue.wait_for_idle();
+
+    EXPECT_TRUE(busy_queue.idle());
+}
+
+TEST(SftpDispatchQueue, counts_throwing_tasks_as_done)
+{
+    mp::SftpDispatchQueue queue{std::make_shared<mp::SftpDispatcher>(1)};
+
+    queue.dispatch("key", [] { throw std::runtime_error{"boom"}; });
+    queue.wait_for_idle();
+
+    EXPECT_TRUE(queue.idle());
+}
@@ -0,0 +1,91 @@
+/*
+ * Copyright (C) Canonical, Ltd.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; version 3.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#include "common.h"
+
+#include <src/sshfs_mount/sftp_stats.h>
+
+#include <libssh/sftp.h>
+
+#include <QJsonArray>
+
+namespace mp = multipass;
+
+using namespace std::chrono_literals;
+using namespace testing;
+
+namespace
+{
+std::vector<qint64> histogram_of(const QJsonObject& json, const QString& op)
+{
+    std::vector<qint64> histogram;
+    for (const auto& bucket : json["ops"].toObject()[op].toObject()["latency_histogram"].toArray())
+        histogram.push_back(bucket.toVariant().toLongLong());
+
+    return histogram;
+}
+} // namespace
+
+TEST(SftpStats, starts_out_empty)
+{
+    mp::SftpStats stats;
+
+    const auto json = stats.to_json();
+    EXPECT_EQ(json["bytes_read"].toInt(-1), 0);
+    EXPECT_EQ(json["bytes_written"].toInt(-1), 0);
+    EXPECT_TRUE(json["ops"].toObject().isEmpty());
+}
+
+TEST(SftpStats, counts_bytes)
+{
+    mp::SftpStats stats;
+    stats.add_bytes_read(100);
+    stats.add_bytes_read(23);
+    stats.add_bytes_written(42);
+
+    const auto json = stats.to_json();
+    EXPECT_EQ(json["bytes_read"].toInt(), 123);
+    EXPECT_EQ(json["bytes_written"].toInt(), 42);
+}
+
+TEST(SftpStats, buckets_latencies)
+{
+    mp::SftpStats stats;
+    stats.record(SFTP_READ, 50us);
+    stats.record(SFTP_READ, 100us);
+    stats.record(SFTP_READ, 101us);
+    stats.record(SFTP_READ, 50ms);
+    stats.record(SFTP_READ, 2s);
+
+    const auto json = stats.to_json();
+    EXPECT_EQ(json["ops"].toObject()["read"].toObject()["count"].toInt(), 5);
+    EXPECT_THAT(histogram_of(json, "read"), ElementsAre(2, 1, 0, 1, 0, 1));
+    EXPECT_FALSE(json["ops"].toObject().contains("write"));
+}
+
+TEST(SftpStats, lumps_unknown_messages_together)
+{
+    mp::SftpStats stats;
+    stats.record(SFTP_INIT, 10us);
+    stats.record(255, 10us);
+
+    EXPECT_EQ(mp::SftpStats::op_name(255), nullptr);
+
+    const auto json = stats.to_json();
+    EXPECT_EQ(json["ops"].toObject().size(), 1);
+    EXPECT_EQ(json["ops"].toObject()["other"].toObject()["count"].toInt(), 2);
+}
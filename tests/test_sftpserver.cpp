@@ -33,6 +33,8 @@
 #include <multipass/platform.h>
 #include <multipass/ssh/ssh_session.h>
 
+#include <future>
+#include <mutex>
 #include <queue>
 
 namespace mp = multipass;
@@ -40,6 +42,7 @@ namespace mpl = multipass::logging;
 namespace mpt = multipass::test;
 
 using namespace testing;
+using namespace std::chrono_literals;
 
 using StringUPtr = std::unique_ptr<ssh_string_struct, void (*)(ssh_string)>;
 
@@ -54,10 +57,11 @@ struct SftpServer : public mp::test::SftpServerTest
     }
 
     mp::SftpServer make_sftpserver(const std::string& path, const mp::id_mappings& gid_mappings = {},
-                                   const mp::id_mappings& uid_mappings = {})
+                                   const mp::id_mappings& uid_mappings = {}, bool write_behind = false)
     {
         mp::SSHSession session{"a", 42};
-        return {std::move(session), path, path, gid_mappings, uid_mappings, default_id, default_id, "sshfs"};
+        return {std::move(session), path, path, gid_mappings, uid_mappings, default_id, default_id, "sshfs",
+                write_behind};
     }
 
     auto make_msg(uint8_t type = SFTP_BAD_MESSAGE)
@@ -95,7 +99,7 @@ struct SftpServer : public mp::test::SftpServerTest
     mpt::ExitStatusMock exit_status_mock;
     std::queue<sftp_client_message> messages;
     int default_id{1000};
-    mpt::MockLogger::Scope logger_scope = mpt::MockLogger::inject();
+    mpt::MockLogger::Scope logger_scope = mpt::MockLogger::inject(mpl::Level::trace);
 };
 
 struct MessageAndReply
@@ -210,6 +214,47 @@ auto make_data(const std::string& in)
     return out;
 }
 
+// The packet of an extended request, which libssh keeps a copy of in the message
+struct ExtendedRequest
+{
+    explicit ExtendedRequest(const std::string& name)
+    {
+        number(42, 4).string(name);
+    }
+
+    ExtendedRequest& u64(std::uint64_t value)
+    {
+        return number(value, 8);
+    }
+
+    ExtendedRequest& string(const std::string& value)
+    {
+        number(value.size(), 4);
+        ssh_buffer_add_data(buffer.get(), value.data(), value.size());
+        return *this;
+    }
+
+    ExtendedRequest& number(std::uint64_t value, int bytes)
+    {
+        for (auto shift = 8 * (bytes - 1); shift >= 0; shift -= 8)
+        {
+            const auto byte = static_cast<unsigned char>(value >> shift);
+            ssh_buffer_add_data(buffer.get(), &byte, 1);
+        }
+        return *this;
+    }
+
+    std::unique_ptr<ssh_buffer_struct, decltype(ssh_buffer_free)*> buffer{ssh_buffer_new(), ssh_buffer_free};
+};
+
+std::uint64_t number_at(const std::vector<unsigned char>& packet, std::size_t offset, int bytes)
+{
+    std::uint64_t value{0};
+    for (auto i = 0; i < bytes; ++i)
+        value = (value << 8) | packet.at(offset + i);
+    return value;
+}
+
 bool content_match(const QString& path, const std::string& data)
 {
     auto content = mpt::load(path);
@@ -326,6 +371,39 @@ TEST_F(SftpServer, stops_after_a_null_message)
     sftp.run();
 }
 
+TEST_F(SftpServer, serves_a_message_at_a_time_over_a_shared_session)
+{
+    mp::SftpServer sftp{std::make_shared<mp::SSHSession>("a", 42),
+                        std::make_shared<std::mutex>(),
+                        "",
+                        "",
+                        {},
+                        {},
+                        default_id,
+                        default_id,
+                        "sshfs"};
+
+    auto msg = make_msg(SFTP_BAD_MESSAGE);
+    REPLACE(sftp_get_client_message, make_msg_handler());
+
+    EXPECT_TRUE(sftp.serve_next(0ms));
+    EXPECT_FALSE(sftp.serve_next(0ms)); // no more messages, and sshfs is still fine
+
+    msg_free.expectCalled(1).withValues(msg.get());
+}
+
+TEST_F(SftpServer, serves_nothing_once_stopped)
+{
+    auto sftp = make_sftpserver();
+
+    auto msg = make_msg(SFTP_BAD_MESSAGE);
+    REPLACE(sftp_get_client_message, make_msg_handler());
+
+    sftp.stop();
+    EXPECT_FALSE(sftp.serve_next(0ms));
+    EXPECT_THAT(messages.size(), Eq(1u));
+}
+
 TEST_F(SftpServer, frees_message)
 {
     auto sftp = make_sftpserver();
@@ -1087,40 +1165,65 @@ TEST_F(SftpServer, open_unable_to_open_fails)
     EXPECT_EQ(failure_num_calls, 1);
 }
 
-TEST_F(SftpServer, open_unable_to_set_permissions_fails)
+TEST_F(SftpServer, DISABLE_ON_WINDOWS(open_creates_file_with_requested_permissions))
 {
     mpt::TempDir temp_dir;
     auto file_name = temp_dir.path() + "/test-file";
 
-    auto [mock_file_ops, guard] = mpt::MockFileOps::inject();
+    auto sftp = make_sftpserver(temp_dir.path().toStdString());
+    auto msg = make_msg(SFTP_OPEN);
+    msg->flags |= SSH_FXF_WRITE;
+    sftp_attributes_struct attr{};
+    attr.permissions = 0741; // not one a umask would leave alone
+    msg->attr = &attr;
+    auto name = name_as_char_array(file_name.toStdString());
+    msg->filename = name.data();
 
-    EXPECT_CALL(*mock_file_ops, open(_, _)).WillOnce(Return(true));
-    EXPECT_CALL(*mock_file_ops, setPermissions(_, _)).WillOnce(Return(false));
+    bool reply_handle_invoked{false};
+    auto reply_handle = [&reply_handle_invoked](auto...) {
+        reply_handle_invoked = true;
+        return SSH_OK;
+    };
+    REPLACE(sftp_reply_handle, reply_handle);
+    REPLACE(sftp_get_client_message, make_msg_handler());
+
+    sftp.run();
+
+    struct stat created;
+    ASSERT_TRUE(reply_handle_invoked);
+    ASSERT_EQ(::stat(file_name.toStdString().c_str(), &created), 0);
+    EXPECT_EQ(created.st_mode & 07777, 0741u);
+}
+
+TEST_F(SftpServer, DISABLE_ON_WINDOWS(open_does_not_chown_files_created_with_the_right_owner))
+{
+    mpt::TempDir temp_dir;
+    auto file_name = temp_dir.path() + "/test-file";
+
+    auto [mock_platform, guard] = mpt::MockPlatform::inject();
+    EXPECT_CALL(*mock_platform, chown(_, _, _)).Times(0);
 
     auto sftp = make_sftpserver(temp_dir.path().toStdString());
     auto msg = make_msg(SFTP_OPEN);
     msg->flags |= SSH_FXF_WRITE;
     sftp_attributes_struct attr{};
-    attr.permissions = 0777;
+    attr.permissions = 0644;
     msg->attr = &attr;
     auto name = name_as_char_array(file_name.toStdString());
     msg->filename = name.data();
 
-    int failure_num_calls{0};
-    auto reply_status = make_reply_status(msg.get(), SSH_FX_FAILURE, failure_num_calls);
-
+    bool reply_handle_invoked{false};
+    auto reply_handle = [&reply_handle_invoked](auto...) {
+        reply_handle_invoked = true;
+        return SSH_OK;
+    };
+    REPLACE(sftp_reply_handle, reply_handle);
     REPLACE(sftp_get_client_message, make_msg_handler());
-    REPLACE(sftp_reply_status, reply_status);
-
-    logger_scope.mock_logger->screen_logs(mpl::Level::error);
-    EXPECT_CALL(*logger_scope.mock_logger,
-                log(Eq(mpl::Level::trace), mpt::MockLogger::make_cstring_matcher(StrEq("sftp server")),
-                    mpt::MockLogger::make_cstring_matcher(
-                        AllOf(HasSubstr("Cannot set permissions for"), HasSubstr(file_name.toStdString())))));
 
     sftp.run();
 
-    EXPECT_EQ(failure_num_calls, 1);
+    EXPECT_TRUE(reply_handle_invoked);
+    EXPECT_TRUE(QFile::exists(file_name));
 }
 
 TEST_F(SftpServer, open_chown_failure_fails)
@@ -1132,7 +1235,9 @@ TEST_F(SftpServer, open_chown_failure_fails)
 
     EXPECT_CALL(*mock_platform, chown(_, _, _)).WillOnce(Return(-1));
 
-    auto sftp = make_sftpserver(temp_dir.path().toStdString());
+    // Owned by someone else than whoever creates it, so that it needs giving away
+    const mp::id_mappings uid_mappings{{QFileInfo(temp_dir.path()).ownerId() + 1, 0}};
+    auto sftp = make_sftpserver(temp_dir.path().toStdString(), {}, uid_mappings);
     auto msg = make_msg(SFTP_OPEN);
     msg->flags |= SSH_FXF_WRITE;
     sftp_attributes_struct attr{};
@@ -1239,7 +1344,62 @@ TEST_F(SftpServer, handles_readdir)
     EXPECT_THAT(eof_num_calls, Eq(1));
 
     std::vector<std::string> expected_entries = {".", "..", "test-dir-entry", "test-file"};
-    EXPECT_THAT(entries, ContainerEq(expected_entries));
+    EXPECT_THAT(entries, UnorderedElementsAreArray(expected_entries));
+}
+
+TEST_F(SftpServer, readdir_streams_large_directories_over_several_replies)
+{
+    constexpr auto num_files = 2000;
+
+    mpt::TempDir temp_dir;
+    std::vector<std::string> expected_entries{".", ".."};
+    for (auto i = 0; i < num_files; ++i)
+    {
+        const auto file_name = fmt::format("a-file-with-a-reasonably-long-name-{:04}", i);
+        mpt::make_file_with_content(temp_dir.path() + "/" + QString::fromStdString(file_name), "");
+        expected_entries.push_back(file_name);
+    }
+
+    auto sftp = make_sftpserver(temp_dir.path().toStdString());
+    auto open_dir_msg = make_msg(SFTP_OPENDIR);
+    auto dir_name = name_as_char_array(temp_dir.path().toStdString());
+    open_dir_msg->filename = dir_name.data();
+
+    std::vector<std::unique_ptr<sftp_client_message_struct>> readdir_msgs;
+    for (auto i = 0; i < 10; ++i)
+        readdir_msgs.push_back(make_msg(SFTP_READDIR));
+
+    void* id{nullptr};
+    auto handle_alloc = [&id](sftp_session, void* info) {
+        id = info;
+        return ssh_string_new(4);
+    };
+
+    std::vector<std::string> entries;
+    auto reply_names_add = [&entries](sftp_client_message, const char* file, const char*, sftp_attributes) {
+        entries.push_back(file);
+        return SSH_OK;
+    };
+
+    int names_num_calls{0};
+    auto reply_names = [&names_num_calls](auto...) {
+        ++names_num_calls;
+        return SSH_OK;
+    };
+
+    REPLACE(sftp_reply_handle, [](auto...) { return SSH_OK; });
+    REPLACE(sftp_handle_alloc, handle_alloc);
+    REPLACE(sftp_handle, [&id](auto...) { return id; });
+    REPLACE(sftp_get_client_message, make_msg_handler());
+    REPLACE(sftp_reply_status, [](auto...) { return SSH_OK; });
+    REPLACE(sftp_reply_names_add, reply_names_add);
+    REPLACE(sftp_reply_names, reply_names);
+
+    sftp.run();
+
+    EXPECT_GT(names_num_calls, 1);
+    EXPECT_LT(names_num_calls, 10);
+    EXPECT_THAT(entries, UnorderedElementsAreArray(expected_entries));
 }
 
 TEST_F(SftpServer, handles_readdir_attributes_preserved)
@@ -1456,6 +1616,44 @@ TEST_F(SftpServer, handles_setstat)
     EXPECT_THAT(file.size(), Eq(expected_size));
 }
 
+TEST_F(SftpServer, stat_sees_changes_made_through_the_server)
+{
+    mpt::TempDir temp_dir;
+    auto file_name = temp_dir.path() + "/test-file";
+    const auto initial_size = mpt::make_file_with_content(file_name);
+
+    auto sftp = make_sftpserver(temp_dir.path().toStdString());
+    auto name = name_as_char_array(file_name.toStdString());
+
+    auto stat_msg = make_msg(SFTP_STAT);
+    stat_msg->filename = name.data();
+
+    auto setstat_msg = make_msg(SFTP_SETSTAT);
+    sftp_attributes_struct attr{};
+    const int expected_size = 7777;
+    attr.size = expected_size;
+    attr.flags = SSH_FILEXFER_ATTR_SIZE;
+    setstat_msg->filename = name.data();
+    setstat_msg->attr = &attr;
+
+    auto second_stat_msg = make_msg(SFTP_STAT);
+    second_stat_msg->filename = name.data();
+
+    std::vector<uint64_t> sizes;
+    auto reply_attr = [&sizes](sftp_client_message, sftp_attributes attr) {
+        sizes.push_back(attr->size);
+        return SSH_OK;
+    };
+
+    REPLACE(sftp_get_client_message, make_msg_handler());
+    REPLACE(sftp_reply_status, [](auto...) { return SSH_OK; });
+    REPLACE(sftp_reply_attr, reply_attr);
+
+    sftp.run();
+
+    EXPECT_THAT(sizes, ElementsAre(static_cast<uint64_t>(initial_size), static_cast<uint64_t>(expected_size)));
+}
+
 TEST_F(SftpServer, setstat_correctly_modifies_file_timestamp)
 {
     mpt::TempDir temp_dir;
@@ -1732,7 +1930,6 @@ TEST_F(SftpServer, write_cannot_seek_fails)
     EXPECT_CALL(*mock_file_ops, open(_, _)).WillOnce([](QFileDevice& file, QIODevice::OpenMode mode) {
         return file.open(mode);
     });
-    EXPECT_CALL(*mock_file_ops, setPermissions(_, _)).WillOnce(Return(true));
     EXPECT_CALL(*mock_file_ops, seek(_, _)).WillOnce(Return(false));
 
     int failure_num_calls{0};
@@ -1786,7 +1983,6 @@ TEST_F(SftpServer, write_failure_fails)
     EXPECT_CALL(*mock_file_ops, open(_, _)).WillOnce([](QFileDevice& file, QIODevice::OpenMode mode) {
         return file.open(mode);
     });
-    EXPECT_CALL(*mock_file_ops, setPermissions(_, _)).WillOnce(Return(true));
     EXPECT_CALL(*mock_file_ops, seek(_, _)).WillOnce(Return(true));
     EXPECT_CALL(*mock_file_ops, write(_, _, _)).WillOnce(Return(-1));
 
@@ -1810,22 +2006,32 @@ TEST_F(SftpServer, write_failure_fails)
     EXPECT_EQ(failure_num_calls, 1);
 }
 
-TEST_F(SftpServer, handles_reads)
+TEST_F(SftpServer, write_behind_coalesces_adjacent_writes)
 {
     mpt::TempDir temp_dir;
     auto file_name = temp_dir.path() + "/test-file";
-    auto size = mpt::make_file_with_content(file_name);
 
-    auto sftp = make_sftpserver(temp_dir.path().toStdString());
+    auto sftp = make_sftpserver(temp_dir.path().toStdString(), {}, {}, true);
     auto open_msg = make_msg(SFTP_OPEN);
     auto name = name_as_char_array(file_name.toStdString());
+    sftp_attributes_struct attr{};
+    attr.permissions = 0777;
+
     open_msg->filename = name.data();
-    open_msg->flags |= SSH_FXF_READ;
+    open_msg->attr = &attr;
+    open_msg->flags |= SSH_FXF_WRITE | SSH_FXF_TRUNC;
 
-    auto read_msg = make_msg(SFTP_READ);
-    read_msg->offset = 10;
-    const int expected_size = size - read_msg->offset;
-    read_msg->len = expected_size;
+    auto write_msg1 = make_msg(SFTP_WRITE);
+    auto data1 = make_data("The answer is ");
+    write_msg1->data = data1.get();
+    write_msg1->offset = 0;
+
+    auto write_msg2 = make_msg(SFTP_WRITE);
+    auto data2 = make_data("always 42");
+    write_msg2->data = data2.get();
+    write_msg2->offset = ssh_string_len(data1.get());
+
+    auto close_msg = make_msg(SFTP_CLOSE);
 
     void* id{nullptr};
     auto handle_alloc = [&id](sftp_session, void* info) {
@@ -1833,13 +2039,20 @@ TEST_F(SftpServer, handles_reads)
         return ssh_string_new(4);
     };
 
-    int num_calls{0};
-    auto reply_data = [&num_calls, &read_msg](sftp_client_message msg, const void* data, int len) {
-        EXPECT_THAT(len, Gt(0));
-        EXPECT_THAT(msg, Eq(read_msg.get()));
+    auto [mock_file_ops, guard] = mpt::MockFileOps::inject();
+    auto file_ops = mock_file_ops;
+    EXPECT_CALL(*mock_file_ops, open(_, _)).WillOnce([](QFileDevice& file, QIODevice::OpenMode mode) {
+        return file.open(mode);
+    });
+    EXPECT_CALL(*mock_file_ops, seek(_, 0)).WillOnce([](QFile& file, qint64 pos) { return file.seek(pos); });
+    EXPECT_CALL(*mock_file_ops, write(_, _, 23))
+        .WillOnce([file_ops](QFile& file, const char* data, qint64 size) {
+            return file_ops->mp::FileOps::write(file, data, size);
+        });
 
-        std::string data_read{reinterpret_cast<const char*>(data), static_cast<std::string::size_type>(len)};
-        EXPECT_THAT(data_read, StrEq("test file"));
+    int num_calls{0};
+    auto reply_status = [&num_calls](sftp_client_message, uint32_t status, const char*) {
+        EXPECT_TRUE(status == SSH_FX_OK);
         ++num_calls;
         return SSH_OK;
     };
@@ -1847,31 +2060,39 @@ TEST_F(SftpServer, handles_reads)
     REPLACE(sftp_reply_handle, [](auto...) { return SSH_OK; });
     REPLACE(sftp_handle_alloc, handle_alloc);
     REPLACE(sftp_handle, [&id](auto...) { return id; });
+    REPLACE(sftp_handle_remove, [](auto...) {});
     REPLACE(sftp_get_client_message, make_msg_handler());
-    REPLACE(sftp_reply_data, reply_data);
+    REPLACE(sftp_reply_status, reply_status);
 
     sftp.run();
 
-    ASSERT_THAT(num_calls, Eq(1));
+    ASSERT_THAT(num_calls, Eq(3));
+    EXPECT_TRUE(content_match(file_name, "The answer is always 42"));
 }
 
-TEST_F(SftpServer, read_cannot_seek_fails)
+TEST_F(SftpServer, write_behind_flushes_before_reading)
 {
-    const int seek_pos{10};
     mpt::TempDir temp_dir;
     auto file_name = temp_dir.path() + "/test-file";
-    auto size = mpt::make_file_with_content(file_name);
 
-    auto sftp = make_sftpserver(temp_dir.path().toStdString());
+    auto sftp = make_sftpserver(temp_dir.path().toStdString(), {}, {}, true);
     auto open_msg = make_msg(SFTP_OPEN);
     auto name = name_as_char_array(file_name.toStdString());
+    sftp_attributes_struct attr{};
+    attr.permissions = 0777;
+
     open_msg->filename = name.data();
-    open_msg->flags |= SSH_FXF_READ;
+    open_msg->attr = &attr;
+    open_msg->flags |= SSH_FXF_READ | SSH_FXF_WRITE | SSH_FXF_TRUNC;
+
+    auto write_msg = make_msg(SFTP_WRITE);
+    auto data = make_data("The answer is always 42");
+    write_msg->data = data.get();
+    write_msg->offset = 0;
 
     auto read_msg = make_msg(SFTP_READ);
-    read_msg->offset = seek_pos;
-    const int expected_size = size - read_msg->offset;
-    read_msg->len = expected_size;
+    read_msg->offset = 14;
+    read_msg->len = 9;
 
     void* id{nullptr};
     auto handle_alloc = [&id](sftp_session, void* info) {
@@ -1879,47 +2100,45 @@ TEST_F(SftpServer, read_cannot_seek_fails)
         return ssh_string_new(4);
     };
 
-    auto [mock_file_ops, guard] = mpt::MockFileOps::inject();
-    EXPECT_CALL(*mock_file_ops, open(_, _)).WillOnce(Return(true));
-    EXPECT_CALL(*mock_file_ops, seek(_, _)).WillOnce(Return(false));
-
-    int failure_num_calls{0};
-    auto reply_status = make_reply_status(read_msg.get(), SSH_FX_FAILURE, failure_num_calls);
+    std::string data_read;
+    auto reply_data = [&data_read](sftp_client_message, const void* data, int len) {
+        data_read.append(reinterpret_cast<const char*>(data), len);
+        return SSH_OK;
+    };
 
     REPLACE(sftp_reply_handle, [](auto...) { return SSH_OK; });
     REPLACE(sftp_handle_alloc, handle_alloc);
     REPLACE(sftp_handle, [&id](auto...) { return id; });
     REPLACE(sftp_get_client_message, make_msg_handler());
-    REPLACE(sftp_reply_status, reply_status);
-
-    logger_scope.mock_logger->screen_logs(mpl::Level::trace);
-    EXPECT_CALL(*logger_scope.mock_logger,
-                log(Eq(mpl::Level::trace), mpt::MockLogger::make_cstring_matcher(StrEq("sftp server")),
-                    mpt::MockLogger::make_cstring_matcher(
-                        AllOf(HasSubstr(fmt::format("cannot seek to position {} in", seek_pos)),
-                              HasSubstr(file_name.toStdString())))));
+    REPLACE(sftp_reply_status, [](auto...) { return SSH_OK; });
+    REPLACE(sftp_reply_data, reply_data);
 
     sftp.run();
 
-    EXPECT_EQ(failure_num_calls, 1);
+    EXPECT_EQ(data_read, "always 42");
 }
 
-TEST_F(SftpServer, read_returns_failure_fails)
+TEST_F(SftpServer, write_behind_reports_deferred_failure_on_close)
 {
     mpt::TempDir temp_dir;
     auto file_name = temp_dir.path() + "/test-file";
-    auto size = mpt::make_file_with_content(file_name);
 
-    auto sftp = make_sftpserver(temp_dir.path().toStdString());
+    auto sftp = make_sftpserver(temp_dir.path().toStdString(), {}, {}, true);
     auto open_msg = make_msg(SFTP_OPEN);
     auto name = name_as_char_array(file_name.toStdString());
+    sftp_attributes_struct attr{};
+    attr.permissions = 0777;
+
     open_msg->filename = name.data();
-    open_msg->flags |= SSH_FXF_READ;
+    open_msg->attr = &attr;
+    open_msg->flags |= SSH_FXF_WRITE | SSH_FXF_TRUNC;
 
-    auto read_msg = make_msg(SFTP_READ);
-    read_msg->offset = 10;
-    const int expected_size = size - read_msg->offset;
-    read_msg->len = expected_size;
+    auto write_msg = make_msg(SFTP_WRITE);
+    auto data = make_data("The answer is ");
+    write_msg->data = data.get();
+    write_msg->offset = 0;
+
+    auto close_msg = make_msg(SFTP_CLOSE);
 
     void* id{nullptr};
     auto handle_alloc = [&id](sftp_session, void* info) {
@@ -1928,31 +2147,33 @@ TEST_F(SftpServer, read_returns_failure_fails)
     };
 
     auto [mock_file_ops, guard] = mpt::MockFileOps::inject();
-    EXPECT_CALL(*mock_file_ops, open(_, _)).WillOnce(Return(true));
+    EXPECT_CALL(*mock_file_ops, open(_, _)).WillOnce([](QFileDevice& file, QIODevice::OpenMode mode) {
+        return file.open(mode);
+    });
     EXPECT_CALL(*mock_file_ops, seek(_, _)).WillOnce(Return(true));
-    EXPECT_CALL(*mock_file_ops, read(_, _, _)).WillOnce(Return(-1));
+    EXPECT_CALL(*mock_file_ops, write(_, _, _)).WillOnce(Return(-1));
 
-    int failure_num_calls{0};
-    auto reply_status = make_reply_status(read_msg.get(), SSH_FX_FAILURE, failure_num_calls);
+    std::vector<std::pair<sftp_client_message, uint32_t>> replies;
+    auto reply_status = [&replies](sftp_client_message msg, uint32_t status, const char*) {
+        replies.emplace_back(msg, status);
+        return SSH_OK;
+    };
 
     REPLACE(sftp_reply_handle, [](auto...) { return SSH_OK; });
     REPLACE(sftp_handle_alloc, handle_alloc);
     REPLACE(sftp_handle, [&id](auto...) { return id; });
+    REPLACE(sftp_handle_remove, [](auto...) {});
     REPLACE(sftp_get_client_message, make_msg_handler());
     REPLACE(sftp_reply_status, reply_status);
 
-    logger_scope.mock_logger->screen_logs(mpl::Level::trace);
-    EXPECT_CALL(*logger_scope.mock_logger,
-                log(Eq(mpl::Level::trace), mpt::MockLogger::make_cstring_matcher(StrEq("sftp server")),
-                    mpt::MockLogger::make_cstring_matcher(
-                        AllOf(HasSubstr("read failed for"), HasSubstr(file_name.toStdString())))));
-
     sftp.run();
 
-    EXPECT_EQ(failure_num_calls, 1);
+    std::vector<std::pair<sftp_client_message, uint32_t>> expected_replies{{write_msg.get(), SSH_FX_OK},
+                                                                          {close_msg.get(), SSH_FX_FAILURE}};
+    EXPECT_EQ(replies, expected_replies);
 }
 
-TEST_F(SftpServer, read_returns_zero_end_of_file)
+TEST_F(SftpServer, handles_reads)
 {
     mpt::TempDir temp_dir;
     auto file_name = temp_dir.path() + "/test-file";
@@ -1975,11 +2196,262 @@ TEST_F(SftpServer, read_returns_zero_end_of_file)
         return ssh_string_new(4);
     };
 
-    auto [mock_file_ops, guard] = mpt::MockFileOps::inject();
-    EXPECT_CALL(*mock_file_ops, open(_, _)).WillOnce(Return(true));
-    EXPECT_CALL(*mock_file_ops, seek(_, _)).WillOnce(Return(true));
-    EXPECT_CALL(*mock_file_ops, read(_, _, _)).WillOnce(Return(0));
-
+    int num_calls{0};
+    auto reply_data = [&num_calls, &read_msg](sftp_client_message msg, const void* data, int len) {
+        EXPECT_THAT(len, Gt(0));
+        EXPECT_THAT(msg, Eq(read_msg.get()));
+
+        std::string data_read{reinterpret_cast<const char*>(data), static_cast<std::string::size_type>(len)};
+        EXPECT_THAT(data_read, StrEq("test file"));
+        ++num_calls;
+        return SSH_OK;
+    };
+
+    REPLACE(sftp_reply_handle, [](auto...) { return SSH_OK; });
+    REPLACE(sftp_handle_alloc, handle_alloc);
+    REPLACE(sftp_handle, [&id](auto...) { return id; });
+    REPLACE(sftp_get_client_message, make_msg_handler());
+    REPLACE(sftp_reply_data, reply_data);
+
+    sftp.run();
+
+    ASSERT_THAT(num_calls, Eq(1));
+}
+
+TEST_F(SftpServer, read_does_not_seek)
+{
+    const int read_pos{10};
+    mpt::TempDir temp_dir;
+    auto file_name = temp_dir.path() + "/test-file";
+    auto size = mpt::make_file_with_content(file_name);
+
+    auto sftp = make_sftpserver(temp_dir.path().toStdString());
+    auto open_msg = make_msg(SFTP_OPEN);
+    auto name = name_as_char_array(file_name.toStdString());
+    open_msg->filename = name.data();
+    open_msg->flags |= SSH_FXF_READ;
+
+    auto read_msg = make_msg(SFTP_READ);
+    read_msg->offset = read_pos;
+    const int expected_size = size - read_msg->offset;
+    read_msg->len = expected_size;
+
+    void* id{nullptr};
+    auto handle_alloc = [&id](sftp_session, void* info) {
+        id = info;
+        return ssh_string_new(4);
+    };
+
+    auto [mock_file_ops, guard] = mpt::MockFileOps::inject();
+    EXPECT_CALL(*mock_file_ops, open(_, _)).WillOnce(Return(true));
+    EXPECT_CALL(*mock_file_ops, seek(_, _)).Times(0);
+    EXPECT_CALL(*mock_file_ops, read_at(_, _, expected_size, read_pos)).WillOnce(Return(expected_size));
+
+    int num_calls{0};
+    auto reply_data = [&num_calls, &read_msg, expected_size](sftp_client_message msg, const void*, int len) {
+        EXPECT_THAT(msg, Eq(read_msg.get()));
+        EXPECT_THAT(len, Eq(expected_size));
+        ++num_calls;
+        return SSH_OK;
+    };
+
+    REPLACE(sftp_reply_handle, [](auto...) { return SSH_OK; });
+    REPLACE(sftp_handle_alloc, handle_alloc);
+    REPLACE(sftp_handle, [&id](auto...) { return id; });
+    REPLACE(sftp_get_client_message, make_msg_handler());
+    REPLACE(sftp_reply_data, reply_data);
+
+    sftp.run();
+
+    EXPECT_EQ(num_calls, 1);
+}
+
+TEST_F(SftpServer, handles_reads_larger_than_64k)
+{
+    mpt::TempDir temp_dir;
+    auto file_name = temp_dir.path() + "/test-file";
+    const std::string content(200 * 1024, 'x');
+    mpt::make_file_with_content(file_name, content);
+
+    auto sftp = make_sftpserver(temp_dir.path().toStdString());
+    auto open_msg = make_msg(SFTP_OPEN);
+    auto name = name_as_char_array(file_name.toStdString());
+    open_msg->filename = name.data();
+    open_msg->flags |= SSH_FXF_READ;
+
+    auto read_msg = make_msg(SFTP_READ);
+    read_msg->offset = 0;
+    read_msg->len = content.size();
+
+    void* id{nullptr};
+    auto handle_alloc = [&id](sftp_session, void* info) {
+        id = info;
+        return ssh_string_new(4);
+    };
+
+    int num_calls{0};
+    auto reply_data = [&num_calls, &content](sftp_client_message, const void* data, int len) {
+        EXPECT_THAT(len, Eq(static_cast<int>(content.size())));
+        EXPECT_TRUE(std::equal(content.begin(), content.end(), reinterpret_cast<const char*>(data)));
+        ++num_calls;
+        return SSH_OK;
+    };
+
+    REPLACE(sftp_reply_handle, [](auto...) { return SSH_OK; });
+    REPLACE(sftp_handle_alloc, handle_alloc);
+    REPLACE(sftp_handle, [&id](auto...) { return id; });
+    REPLACE(sftp_get_client_message, make_msg_handler());
+    REPLACE(sftp_reply_data, reply_data);
+
+    sftp.run();
+
+    EXPECT_EQ(num_calls, 1);
+}
+
+TEST_F(SftpServer, sequential_reads_are_served_from_read_ahead)
+{
+    constexpr auto chunk = 16;
+    constexpr auto num_reads = 6;
+
+    mpt::TempDir temp_dir;
+    auto file_name = temp_dir.path() + "/test-file";
+    std::string content;
+    for (auto i = 0; i < chunk * num_reads; ++i)
+        content.push_back('a' + i % 26);
+    mpt::make_file_with_content(file_name, content);
+
+    auto sftp = make_sftpserver(temp_dir.path().toStdString());
+    auto open_msg = make_msg(SFTP_OPEN);
+    auto name = name_as_char_array(file_name.toStdString());
+    open_msg->filename = name.data();
+    open_msg->flags |= SSH_FXF_READ;
+
+    std::vector<std::unique_ptr<sftp_client_message_struct>> read_msgs;
+    for (auto i = 0; i < num_reads; ++i)
+    {
+        auto& read_msg = read_msgs.emplace_back(make_msg(SFTP_READ));
+        read_msg->offset = i * chunk;
+        read_msg->len = chunk;
+    }
+
+    void* id{nullptr};
+    auto handle_alloc = [&id](sftp_session, void* info) {
+        id = info;
+        return ssh_string_new(4);
+    };
+
+    std::mutex reads_mutex;
+    std::vector<std::pair<qint64, qint64>> disk_reads;
+    auto [mock_file_ops, guard] = mpt::MockFileOps::inject();
+    auto file_ops = mock_file_ops;
+    EXPECT_CALL(*mock_file_ops, open(_, _)).WillOnce([](QFileDevice& file, QIODevice::OpenMode mode) {
+        return file.open(mode);
+    });
+    EXPECT_CALL(*mock_file_ops, read_at(_, _, _, _))
+        .WillRepeatedly([file_ops, &reads_mutex, &disk_reads](QFile& file, char* data, qint64 size, qint64 pos) {
+            {
+                std::lock_guard<std::mutex> lock{reads_mutex};
+                disk_reads.emplace_back(pos, size);
+            }
+            return file_ops->mp::FileOps::read_at(file, data, size, pos);
+        });
+
+    std::string data_read;
+    auto reply_data = [&data_read](sftp_client_message, const void* data, int len) {
+        data_read.append(reinterpret_cast<const char*>(data), len);
+        return SSH_OK;
+    };
+
+    REPLACE(sftp_reply_handle, [](auto...) { return SSH_OK; });
+    REPLACE(sftp_handle_alloc, handle_alloc);
+    REPLACE(sftp_handle, [&id](auto...) { return id; });
+    REPLACE(sftp_get_client_message, make_msg_handler());
+    REPLACE(sftp_reply_data, reply_data);
+
+    sftp.run();
+
+    EXPECT_EQ(data_read, content);
+
+    // the first two reads go to disk and the rest is read ahead, including a last attempt past the end of the file
+    std::vector<std::pair<qint64, qint64>> expected_reads{
+        {0, chunk}, {chunk, chunk}, {2 * chunk, 4 * chunk}, {6 * chunk, 4 * chunk}};
+    EXPECT_EQ(disk_reads, expected_reads);
+}
+
+TEST_F(SftpServer, read_returns_failure_fails)
+{
+    mpt::TempDir temp_dir;
+    auto file_name = temp_dir.path() + "/test-file";
+    auto size = mpt::make_file_with_content(file_name);
+
+    auto sftp = make_sftpserver(temp_dir.path().toStdString());
+    auto open_msg = make_msg(SFTP_OPEN);
+    auto name = name_as_char_array(file_name.toStdString());
+    open_msg->filename = name.data();
+    open_msg->flags |= SSH_FXF_READ;
+
+    auto read_msg = make_msg(SFTP_READ);
+    read_msg->offset = 10;
+    const int expected_size = size - read_msg->offset;
+    read_msg->len = expected_size;
+
+    void* id{nullptr};
+    auto handle_alloc = [&id](sftp_session, void* info) {
+        id = info;
+        return ssh_string_new(4);
+    };
+
+    auto [mock_file_ops, guard] = mpt::MockFileOps::inject();
+    EXPECT_CALL(*mock_file_ops, open(_, _)).WillOnce(Return(true));
+    EXPECT_CALL(*mock_file_ops, read_at(_, _, _, _)).WillOnce(Return(-1));
+
+    int failure_num_calls{0};
+    auto reply_status = make_reply_status(read_msg.get(), SSH_FX_FAILURE, failure_num_calls);
+
+    REPLACE(sftp_reply_handle, [](auto...) { return SSH_OK; });
+    REPLACE(sftp_handle_alloc, handle_alloc);
+    REPLACE(sftp_handle, [&id](auto...) { return id; });
+    REPLACE(sftp_get_client_message, make_msg_handler());
+    REPLACE(sftp_reply_status, reply_status);
+
+    logger_scope.mock_logger->screen_logs(mpl::Level::trace);
+    EXPECT_CALL(*logger_scope.mock_logger,
+                log(Eq(mpl::Level::trace), mpt::MockLogger::make_cstring_matcher(StrEq("sftp server")),
+                    mpt::MockLogger::make_cstring_matcher(
+                        AllOf(HasSubstr("read failed for"), HasSubstr(file_name.toStdString())))));
+
+    sftp.run();
+
+    EXPECT_EQ(failure_num_calls, 1);
+}
+
+TEST_F(SftpServer, read_returns_zero_end_of_file)
+{
+    mpt::TempDir temp_dir;
+    auto file_name = temp_dir.path() + "/test-file";
+    auto size = mpt::make_file_with_content(file_name);
+
+    auto sftp = make_sftpserver(temp_dir.path().toStdString());
+    auto open_msg = make_msg(SFTP_OPEN);
+    auto name = name_as_char_array(file_name.toStdString());
+    open_msg->filename = name.data();
+    open_msg->flags |= SSH_FXF_READ;
+
+    auto read_msg = make_msg(SFTP_READ);
+    read_msg->offset = 10;
+    const int expected_size = size - read_msg->offset;
+    read_msg->len = expected_size;
+
+    void* id{nullptr};
+    auto handle_alloc = [&id](sftp_session, void* info) {
+        id = info;
+        return ssh_string_new(4);
+    };
+
+    auto [mock_file_ops, guard] = mpt::MockFileOps::inject();
+    EXPECT_CALL(*mock_file_ops, open(_, _)).WillOnce(Return(true));
+    EXPECT_CALL(*mock_file_ops, read_at(_, _, _, _)).WillOnce(Return(0));
+
     int eof_num_calls{0};
     auto reply_status = make_reply_status(read_msg.get(), SSH_FX_EOF, eof_num_calls);
 
@@ -1994,6 +2466,62 @@ TEST_F(SftpServer, read_returns_zero_end_of_file)
     EXPECT_EQ(eof_num_calls, 1);
 }
 
+TEST_F(SftpServer, slow_read_does_not_hold_up_other_requests)
+{
+    mpt::TempDir temp_dir;
+    auto file_name = temp_dir.path() + "/test-file";
+    auto other_file_name = temp_dir.path() + "/other-file";
+    mpt::make_file_with_content(file_name);
+    mpt::make_file_with_content(other_file_name);
+
+    auto sftp = make_sftpserver(temp_dir.path().toStdString());
+    auto open_msg = make_msg(SFTP_OPEN);
+    auto name = name_as_char_array(file_name.toStdString());
+    open_msg->filename = name.data();
+    open_msg->flags |= SSH_FXF_READ;
+
+    auto read_msg = make_msg(SFTP_READ);
+    read_msg->offset = 0;
+    read_msg->len = 10;
+
+    auto stat_msg = make_msg(SFTP_STAT);
+    auto other_name = name_as_char_array(other_file_name.toStdString());
+    stat_msg->filename = other_name.data();
+
+    void* id{nullptr};
+    auto handle_alloc = [&id](sftp_session, void* info) {
+        id = info;
+        return ssh_string_new(4);
+    };
+
+    std::promise<void> stat_replied;
+    auto stat_replied_future = stat_replied.get_future().share();
+    auto reply_attr = [&stat_replied, &stat_msg](sftp_client_message msg, sftp_attributes) {
+        EXPECT_THAT(msg, Eq(stat_msg.get()));
+        stat_replied.set_value();
+        return SSH_OK;
+    };
+
+    bool stat_replied_during_read{false};
+    auto [mock_file_ops, guard] = mpt::MockFileOps::inject();
+    EXPECT_CALL(*mock_file_ops, open(_, _)).WillOnce(Return(true));
+    EXPECT_CALL(*mock_file_ops, read_at(_, _, _, _))
+        .WillOnce([&stat_replied_during_read, stat_replied_future](auto...) {
+            stat_replied_during_read = stat_replied_future.wait_for(5s) == std::future_status::ready;
+            return 0;
+        });
+
+    REPLACE(sftp_reply_handle, [](auto...) { return SSH_OK; });
+    REPLACE(sftp_handle_alloc, handle_alloc);
+    REPLACE(sftp_handle, [&id](auto...) { return id; });
+    REPLACE(sftp_get_client_message, make_msg_handler());
+    REPLACE(sftp_reply_attr, reply_attr);
+
+    sftp.run();
+
+    EXPECT_TRUE(stat_replied_during_read);
+}
+
 TEST_F(SftpServer, handle_extended_link)
 {
     mpt::TempDir temp_dir;
@@ -2140,6 +2668,206 @@ TEST_F(SftpServer, extended_rename_in_invalid_dir_fails)
     EXPECT_THAT(perm_denied_num_calls, Eq(1));
 }
 
+TEST_F(SftpServer, extended_copy_data_copies_between_handles)
+{
+    mpt::TempDir temp_dir;
+    auto source_name = temp_dir.path() + "/test-file";
+    auto copy_name = temp_dir.path() + "/test-copy";
+    mpt::make_file_with_content(source_name);
+
+    auto sftp = make_sftpserver(temp_dir.path().toStdString());
+    sftp_attributes_struct attr{};
+    attr.permissions = 0644;
+
+    auto open_source = make_msg(SFTP_OPEN);
+    auto source = name_as_char_array(source_name.toStdString());
+    open_source->filename = source.data();
+    open_source->attr = &attr;
+    open_source->flags |= SSH_FXF_READ;
+
+    auto open_copy = make_msg(SFTP_OPEN);
+    auto copy = name_as_char_array(copy_name.toStdString());
+    open_copy->filename = copy.data();
+    open_copy->attr = &attr;
+    open_copy->flags |= SSH_FXF_WRITE | SSH_FXF_CREAT | SSH_FXF_TRUNC;
+
+    // From the 6th byte to the end of the source, to the start of the copy
+    ExtendedRequest request{"copy-data"};
+    request.string(std::string(1, '\0')).u64(5).u64(0).string(std::string(1, '\1')).u64(0);
+    auto msg = make_msg(SFTP_EXTENDED);
+    auto submessage = name_as_char_array("copy-data");
+    msg->submessage = submessage.data();
+    msg->complete_message = request.buffer.get();
+
+    std::vector<void*> ids;
+    auto handle_alloc = [&ids](sftp_session, void* info) {
+        const char index = ids.size();
+        ids.push_back(info);
+        auto handle = ssh_string_new(1);
+        ssh_string_fill(handle, &index, 1);
+        return handle;
+    };
+
+    int num_calls{0};
+    auto reply_status = make_reply_status(msg.get(), SSH_FX_OK, num_calls);
+
+    REPLACE(sftp_reply_handle, [](auto...) { return SSH_OK; });
+    REPLACE(sftp_handle_alloc, handle_alloc);
+    REPLACE(sftp_handle, [&ids](sftp_session, ssh_string handle) {
+        return ids.at(static_cast<std::size_t>(*ssh_string_get_char(handle)));
+    });
+    REPLACE(sftp_get_client_message, make_msg_handler());
+    REPLACE(sftp_reply_status, reply_status);
+
+    sftp.run();
+
+    EXPECT_EQ(num_calls, 1);
+    EXPECT_TRUE(content_match(copy_name, "is a test file"));
+}
+
+TEST_F(SftpServer, extended_copy_data_with_unknown_handle_fails)
+{
+    ExtendedRequest request{"copy-data"};
+    request.string("foo").u64(0).u64(0).string("bar").u64(0);
+
+    auto sftp = make_sftpserver();
+    auto msg = make_msg(SFTP_EXTENDED);
+    auto submessage = name_as_char_array("copy-data");
+    msg->submessage = submessage.data();
+    msg->complete_message = request.buffer.get();
+
+    int num_calls{0};
+    auto reply_status = make_reply_status(msg.get(), SSH_FX_BAD_MESSAGE, num_calls);
+
+    REPLACE(sftp_get_client_message, make_msg_handler());
+    REPLACE(sftp_reply_status, reply_status);
+
+    sftp.run();
+
+    EXPECT_EQ(num_calls, 1);
+}
+
+TEST_F(SftpServer, extended_statvfs_replies_with_filesystem_statistics)
+{
+    mpt::TempDir temp_dir;
+    ExtendedRequest request{"statvfs@openssh.com"};
+    request.string(temp_dir.path().toStdString());
+
+    auto sftp = make_sftpserver(temp_dir.path().toStdString());
+    auto msg = make_msg(SFTP_EXTENDED);
+    auto submessage = name_as_char_array("statvfs@openssh.com");
+    msg->submessage = submessage.data();
+    msg->complete_message = request.buffer.get();
+    msg->id = 42;
+
+    std::vector<unsigned char> packet;
+    REPLACE(ssh_channel_write, [&packet](ssh_channel, const void* data, uint32_t len) {
+        const auto bytes = static_cast<const unsigned char*>(data);
+        packet.assign(bytes, bytes + len);
+        return static_cast<int>(len);
+    });
+    REPLACE(sftp_get_client_message, make_msg_handler());
+
+    sftp.run();
+
+    // Length, type and id, then 11 values
+    ASSERT_EQ(packet.size(), 4u + 1u + 4u + 11u * 8u);
+    EXPECT_EQ(number_at(packet, 0, 4), packet.size() - 4);
+    EXPECT_EQ(packet[4], SSH_FXP_EXTENDED_REPLY);
+    EXPECT_EQ(number_at(packet, 5, 4), 42u);
+    EXPECT_GT(number_at(packet, 9, 8), 0u); // the block size
+}
+
+TEST_F(SftpServer, extended_statvfs_fails_with_path_outside_source)
+{
+    mpt::TempDir temp_dir;
+    ExtendedRequest request{"statvfs@openssh.com"};
+    request.string("/etc");
+
+    auto sftp = make_sftpserver(temp_dir.path().toStdString());
+    auto msg = make_msg(SFTP_EXTENDED);
+    auto submessage = name_as_char_array("statvfs@openssh.com");
+    msg->submessage = submessage.data();
+    msg->complete_message = request.buffer.get();
+
+    int perm_denied_num_calls{0};
+    auto reply_status = make_reply_status(msg.get(), SSH_FX_PERMISSION_DENIED, perm_denied_num_calls);
+
+    REPLACE(sftp_get_client_message, make_msg_handler());
+    REPLACE(sftp_reply_status, reply_status);
+
+    sftp.run();
+
+    EXPECT_THAT(perm_denied_num_calls, Eq(1));
+}
+
+TEST_F(SftpServer, extended_limits_advertises_larger_reads_and_writes)
+{
+    ExtendedRequest request{"limits@openssh.com"};
+
+    auto sftp = make_sftpserver();
+    auto msg = make_msg(SFTP_EXTENDED);
+    auto submessage = name_as_char_array("limits@openssh.com");
+    msg->submessage = submessage.data();
+    msg->complete_message = request.buffer.get();
+
+    std::vector<unsigned char> packet;
+    REPLACE(ssh_channel_write, [&packet](ssh_channel, const void* data, uint32_t len) {
+        const auto bytes = static_cast<const unsigned char*>(data);
+        packet.assign(bytes, bytes + len);
+        return static_cast<int>(len);
+    });
+    REPLACE(sftp_get_client_message, make_msg_handler());
+
+    sftp.run();
+
+    ASSERT_EQ(packet.size(), 4u + 1u + 4u + 4u * 8u);
+    EXPECT_EQ(packet[4], SSH_FXP_EXTENDED_REPLY);
+    EXPECT_EQ(number_at(packet, 17, 8), 256u * 1024u); // read length
+    EXPECT_EQ(number_at(packet, 25, 8), 256u * 1024u); // write length
+}
+
+TEST_F(SftpServer, extended_fsync_syncs_handle)
+{
+    mpt::TempDir temp_dir;
+    auto file_name = temp_dir.path() + "/test-file";
+
+    auto sftp = make_sftpserver(temp_dir.path().toStdString());
+    auto open_msg = make_msg(SFTP_OPEN);
+    auto name = name_as_char_array(file_name.toStdString());
+    sftp_attributes_struct attr{};
+    attr.permissions = 0644;
+    open_msg->filename = name.data();
+    open_msg->attr = &attr;
+    open_msg->flags |= SSH_FXF_WRITE | SSH_FXF_CREAT;
+
+    ExtendedRequest request{"fsync@openssh.com"};
+    request.string("handle");
+    auto msg = make_msg(SFTP_EXTENDED);
+    auto submessage = name_as_char_array("fsync@openssh.com");
+    msg->submessage = submessage.data();
+    msg->complete_message = request.buffer.get();
+
+    void* id{nullptr};
+    auto handle_alloc = [&id](sftp_session, void* info) {
+        id = info;
+        return ssh_string_new(4);
+    };
+
+    int num_calls{0};
+    auto reply_status = make_reply_status(msg.get(), SSH_FX_OK, num_calls);
+
+    REPLACE(sftp_reply_handle, [](auto...) { return SSH_OK; });
+    REPLACE(sftp_handle_alloc, handle_alloc);
+    REPLACE(sftp_handle, [&id](auto...) { return id; });
+    REPLACE(sftp_get_client_message, make_msg_handler());
+    REPLACE(sftp_reply_status, reply_status);
+
+    sftp.run();
+
+    EXPECT_EQ(num_calls, 1);
+}
+
 TEST_F(SftpServer, invalid_extended_fails)
 {
     auto sftp = make_sftpserver();
@@ -2333,8 +3061,9 @@ TEST_F(SftpServer, DISABLE_ON_WINDOWS(open_chown_honors_maps_in_the_host))
 
     auto [mock_platform, guard] = mpt::MockPlatform::inject();
 
-    int host_uid = QFileInfo(temp_dir.path()).ownerId();
-    int host_gid = QFileInfo(temp_dir.path()).groupId();
+    // Not whoever creates the file, or there would be nothing to change
+    int host_uid = QFileInfo(temp_dir.path()).ownerId() + 1;
+    int host_gid = QFileInfo(temp_dir.path()).groupId() + 1;
     int sftp_uid = 1008;
     int sftp_gid = 1009;
 
@@ -156,4 +156,51 @@ TEST_F(TestSimpleStreamsManifest, LXDDriverReturnsExpectedData)
     EXPECT_EQ(bionic_info->id, expected_bionic_id);
 }
 
+TEST_F(TestSimpleStreamsManifest, snapshot_loads_what_was_parsed)
+{
+    auto json = mpt::load_test_file("good_manifest.json");
+    auto manifest = mp::SimpleStreamsManifest::fromJson(json, std::nullopt, "http://stream/url");
+
+    auto loaded = mp::SimpleStreamsManifest::fromSnapshot(manifest->toSnapshot());
+    ASSERT_THAT(loaded, NotNull());
+    EXPECT_EQ(loaded->updated_at, manifest->updated_at);
+    EXPECT_EQ(loaded->products, manifest->products);
+    EXPECT_EQ(loaded->image_records.keys(), manifest->image_records.keys());
+
+    const auto info = loaded->image_records["default"];
+    ASSERT_THAT(info, NotNull());
+    EXPECT_EQ(*info, *manifest->image_records["default"]);
+}
+
+TEST_F(TestSimpleStreamsManifest, products_share_the_strings_they_have_in_common)
+{
+    auto json = mpt::load_test_file("good_manifest.json");
+    auto manifest = mp::SimpleStreamsManifest::fromJson(json, std::nullopt, "http://stream/url");
+    auto loaded = mp::SimpleStreamsManifest::fromSnapshot(manifest->toSnapshot());
+    ASSERT_THAT(loaded, NotNull());
+
+    for (const auto& products : {&manifest->products, &loaded->products})
+    {
+        ASSERT_EQ(products->size(), 2u);
+        const auto &first = products->front(), &second = products->back();
+        EXPECT_EQ(first.os.constData(), second.os.constData());
+        EXPECT_EQ(first.stream_location.constData(), second.stream_location.constData());
+        EXPECT_NE(first.id.constData(), second.id.constData());
+    }
+
+    EXPECT_GT(manifest->memory_footprint(), sizeof(mp::SimpleStreamsManifest));
+}
+
+TEST_F(TestSimpleStreamsManifest, snapshot_does_not_load_for_another_driver_or_when_damaged)
+{
+    auto json = mpt::load_test_file("good_manifest.json");
+    const auto snapshot = mp::SimpleStreamsManifest::fromJson(json, std::nullopt, "")->toSnapshot();
+
+    EXPECT_THAT(mp::SimpleStreamsManifest::fromSnapshot(snapshot.left(snapshot.size() / 2)), IsNull());
+    EXPECT_THAT(mp::SimpleStreamsManifest::fromSnapshot("not a snapshot"), IsNull());
+
+    EXPECT_CALL(mock_settings, get(Eq(mp::driver_key))).WillRepeatedly(Return("lxd"));
+    EXPECT_THAT(mp::SimpleStreamsManifest::fromSnapshot(snapshot), IsNull());
+}
+
 } // namespace
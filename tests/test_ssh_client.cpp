@@ -25,6 +25,12 @@
 #include <multipass/ssh/ssh_client.h>
 #include <multipass/ssh/ssh_session.h>
 
+#include <cstdio>
+#include <optional>
+#include <string>
+
+#include <unistd.h>
+
 namespace mp = multipass;
 namespace mpt = multipass::test;
 
@@ -93,6 +99,27 @@ TEST_F(SSHClient, DISABLE_ON_WINDOWS(execPollingWorksAsExpected))
     EXPECT_EQ(poll_count, 1);
 }
 
+TEST_F(SSHClient, DISABLE_ON_WINDOWS(execForwardsChannelOutputWhenNotOnATerminal))
+{
+    if (isatty(fileno(stdout)))
+        GTEST_SKIP() << "output goes to a terminal";
+
+    std::string output{"forwarded\n"};
+    std::optional<int> consumed;
+    auto add_channel_cbs = [&output, &consumed](ssh_channel channel, ssh_channel_callbacks cb) {
+        if (cb->channel_data_function)
+            consumed = cb->channel_data_function(nullptr, channel, output.data(), output.size(), 0, cb->userdata);
+        return SSH_OK;
+    };
+    REPLACE(ssh_add_channel_callbacks, add_channel_cbs);
+
+    auto client = make_ssh_client();
+
+    EXPECT_EQ(client.exec({"foo"}), SSH_OK);
+    // Everything is taken in at once, nothing is left waiting in libssh's buffers
+    EXPECT_EQ(consumed, static_cast<int>(output.size()));
+}
+
 TEST_F(SSHClient, throws_when_unable_to_open_session)
 {
     REPLACE(ssh_channel_open_session, [](auto...) { return SSH_ERROR; });
@@ -0,0 +1,234 @@
+/*
+ * Copyright (C) Canonical, Ltd.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; version 3.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#include "common.h"
+#include "mock_ssh_test_fixture.h"
+#include "temp_dir.h"
+
+#include <multipass/ssh/ssh_control_master.h>
+
+#include <QFile>
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <functional>
+#include <stdexcept>
+#include <string>
+#include <thread>
+
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+namespace mp = multipass;
+namespace mpt = multipass::test;
+
+using namespace testing;
+
+namespace
+{
+struct SSHControlMaster : public Test
+{
+    // Stands in for a master, handling a single client with what it was sent and the number of descriptors in there
+    void serve(const std::function<void(int, const std::string&, int)>& handle)
+    {
+        listen_fd = socket(AF_UNIX, SOCK_STREAM, 0);
+        sockaddr_un address{};
+        address.sun_family = AF_UNIX;
+        std::strncpy(address.sun_path, socket_path.c_str(), sizeof(address.sun_path) - 1);
+        ASSERT_EQ(bind(listen_fd, reinterpret_cast<sockaddr*>(&address), sizeof(address)), 0);
+        ASSERT_EQ(listen(listen_fd, 1), 0);
+
+        server = std::thread{[this, handle] {
+            const auto fd = accept(listen_fd, nullptr, nullptr);
+
+            char buffer[1024];
+            alignas(cmsghdr) char control[CMSG_SPACE(3 * sizeof(int))]{};
+            iovec iov{buffer, sizeof(buffer)};
+            msghdr message{};
+            message.msg_iov = &iov;
+            message.msg_iovlen = 1;
+            message.msg_control = control;
+            message.msg_controllen = sizeof(control);
+
+            auto received = recvmsg(fd, &message, 0);
+            const auto cmsg = CMSG_FIRSTHDR(&message);
+            const auto num_fds = cmsg ? (cmsg->cmsg_len - CMSG_LEN(0)) / sizeof(int) : 0;
+            std::string data(buffer, received > 0 ? received : 0);
+
+            // The command line comes last, all the client sends before waiting for an answer
+            while (data.size() < cmd.size() || data.compare(data.size() - cmd.size(), cmd.size(), cmd) != 0)
+            {
+                if ((received = read(fd, buffer, sizeof(buffer))) <= 0)
+                    break;
+                data.append(buffer, received);
+            }
+
+            handle(fd, data, num_fds);
+            close(fd);
+        }};
+    }
+
+    ~SSHControlMaster()
+    {
+        if (server.joinable())
+            server.join();
+        if (listen_fd >= 0)
+            close(listen_fd);
+    }
+
+    const std::string cmd{"echo 'hello there'"};
+    mpt::TempDir temp_dir;
+    const std::string socket_path{(temp_dir.path() + "/control.sock").toStdString()};
+    int listen_fd{-1};
+    std::thread server;
+};
+} // namespace
+
+TEST_F(SSHControlMaster, exec_gives_nothing_without_a_master)
+{
+    EXPECT_EQ(mp::SSHControlMaster::exec(socket_path, cmd, false), std::nullopt);
+}
+
+TEST_F(SSHControlMaster, exec_hands_over_standard_streams_and_returns_exit_code)
+{
+    std::string received;
+    int received_fds{0};
+    serve([&](int fd, const std::string& data, int num_fds) {
+        received = data;
+        received_fds = num_fds;
+
+        const std::int32_t exit_code{42};
+        EXPECT_EQ(write(fd, "+", 1), 1);
+        EXPECT_EQ(write(fd, &exit_code, sizeof(exit_code)), static_cast<ssize_t>(sizeof(exit_code)));
+    });
+
+    EXPECT_EQ(mp::SSHControlMaster::exec(socket_path, cmd, false), 42);
+
+    server.join();
+    EXPECT_THAT(received, EndsWith(cmd));
+    EXPECT_EQ(received_fds, 3);
+}
+
+TEST_F(SSHControlMaster, exec_names_the_session_to_keep)
+{
+    std::string received;
+    serve([&](int fd, const std::string& data, int) {
+        received = data;
+
+        const std::int32_t exit_code{0};
+        EXPECT_EQ(write(fd, "+", 1), 1);
+        EXPECT_EQ(write(fd, &exit_code, sizeof(exit_code)), static_cast<ssize_t>(sizeof(exit_code)));
+    });
+
+    EXPECT_EQ(mp::SSHControlMaster::exec(socket_path, cmd, false, "a-session"), 0);
+
+    server.join();
+    EXPECT_THAT(received, HasSubstr(std::string{"a-session\0", 10}));
+}
+
+TEST_F(SSHControlMaster, exec_gives_nothing_when_the_master_cannot_run_the_command)
+{
+    serve([](auto...) {});
+
+    EXPECT_EQ(mp::SSHControlMaster::exec(socket_path, cmd, false), std::nullopt);
+}
+
+TEST_F(SSHControlMaster, exec_fails_when_the_master_goes_away_midway)
+{
+    serve([](int fd, auto...) { EXPECT_EQ(write(fd, "+", 1), 1); });
+
+    EXPECT_EQ(mp::SSHControlMaster::exec(socket_path, cmd, false), 255);
+}
+
+TEST_F(SSHControlMaster, master_does_not_take_over_a_socket_in_use)
+{
+    mpt::MockSSHTestFixture mock_ssh_test_fixture;
+
+    mp::SSHControlMaster master{std::make_unique<mp::SSHSession>("theanswertoeverything", 42), socket_path,
+                                std::chrono::seconds(1)};
+
+    EXPECT_THROW((mp::SSHControlMaster{std::make_unique<mp::SSHSession>("theanswertoeverything", 42), socket_path,
+                                       std::chrono::seconds(1)}),
+                 std::runtime_error);
+}
+
+TEST_F(SSHControlMaster, master_is_not_held_up_by_a_client_that_sends_nothing)
+{
+    mpt::MockSSHTestFixture mock_ssh_test_fixture;
+    std::atomic_bool done{false};
+    REPLACE(ssh_is_connected, [&done](auto...) { return !done; });
+    REPLACE(ssh_channel_new, [](auto...) { return nullptr; });
+
+    mp::SSHControlMaster master{std::make_unique<mp::SSHSession>("theanswertoeverything", 42), socket_path,
+                                std::chrono::seconds(30)};
+    std::thread master_thread{[&master] { master.run(); }};
+
+    const auto silent_fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    sockaddr_un address{};
+    address.sun_family = AF_UNIX;
+    std::strncpy(address.sun_path, socket_path.c_str(), sizeof(address.sun_path) - 1);
+    ASSERT_EQ(connect(silent_fd, reinterpret_cast<sockaddr*>(&address), sizeof(address)), 0);
+
+    // Told promptly that the command cannot be run there, rather than once the silent one has been given up on
+    const auto start = std::chrono::steady_clock::now();
+    EXPECT_EQ(mp::SSHControlMaster::exec(socket_path, cmd, false), std::nullopt);
+    EXPECT_LT(std::chrono::steady_clock::now() - start, std::chrono::seconds(3));
+
+    done = true;
+    master_thread.join();
+    close(silent_fd);
+}
+
+TEST_F(SSHControlMaster, serve_fails_without_all_its_parameters)
+{
+    int sockets[2];
+    ASSERT_EQ(socketpair(AF_UNIX, SOCK_STREAM, 0, sockets), 0);
+
+    const std::uint32_t size = socket_path.size();
+    ASSERT_EQ(write(sockets[0], &size, sizeof(size)), static_cast<ssize_t>(sizeof(size)));
+    ASSERT_EQ(write(sockets[0], socket_path.data(), size), static_cast<ssize_t>(size));
+    close(sockets[0]);
+
+    EXPECT_EQ(mp::SSHControlMaster::serve(sockets[1]), EXIT_FAILURE);
+    EXPECT_FALSE(QFile::exists(QString::fromStdString(socket_path)));
+    close(sockets[1]);
+}
+
+TEST_F(SSHControlMaster, master_takes_over_a_stale_socket_and_cleans_up)
+{
+    mpt::MockSSHTestFixture mock_ssh_test_fixture;
+
+    // Bound but no longer listening, as if its master had been killed
+    const auto stale_fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    sockaddr_un address{};
+    address.sun_family = AF_UNIX;
+    std::strncpy(address.sun_path, socket_path.c_str(), sizeof(address.sun_path) - 1);
+    ASSERT_EQ(bind(stale_fd, reinterpret_cast<sockaddr*>(&address), sizeof(address)), 0);
+    close(stale_fd);
+
+    {
+        mp::SSHControlMaster master{std::make_unique<mp::SSHSession>("theanswertoeverything", 42), socket_path,
+                                    std::chrono::seconds(1)};
+        EXPECT_TRUE(QFile::exists(QString::fromStdString(socket_path)));
+    }
+
+    EXPECT_FALSE(QFile::exists(QString::fromStdString(socket_path)));
+}
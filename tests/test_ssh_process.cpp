@@ -21,7 +21,10 @@
 #include <multipass/ssh/ssh_session.h>
 
 #include <algorithm>
+#include <map>
+#include <string>
 #include <thread>
+#include <vector>
 
 namespace mp = multipass;
 namespace mpt = multipass::test;
@@ -143,3 +146,101 @@ TEST_F(SSHProcess, can_read_output)
 
     EXPECT_THAT(output, StrEq(expected_output));
 }
+
+TEST_F(SSHProcess, can_read_output_larger_than_a_chunk)
+{
+    const std::string expected_output(200 * 1024, 'x');
+    std::size_t offset{0};
+    auto channel_read = [&expected_output, &offset](ssh_channel, void* dest, uint32_t count, int, int) {
+        const auto num_to_copy = std::min(static_cast<std::size_t>(count), expected_output.size() - offset);
+        std::copy_n(expected_output.begin() + offset, num_to_copy, reinterpret_cast<char*>(dest));
+        offset += num_to_copy;
+        return static_cast<int>(num_to_copy);
+    };
+    REPLACE(ssh_channel_read_timeout, channel_read);
+
+    auto proc = session.exec("something");
+
+    EXPECT_EQ(proc.read_std_output(), expected_output);
+}
+
+TEST_F(SSHProcess, streams_output_as_it_arrives)
+{
+    std::vector<std::string> chunks{"first", "second", "third"};
+    std::size_t next{0};
+    auto channel_read = [&chunks, &next](ssh_channel, void* dest, uint32_t, int is_stderr, int) {
+        EXPECT_TRUE(is_stderr);
+        if (next == chunks.size())
+            return 0;
+
+        const auto& chunk = chunks[next++];
+        std::copy(chunk.begin(), chunk.end(), reinterpret_cast<char*>(dest));
+        return static_cast<int>(chunk.size());
+    };
+    REPLACE(ssh_channel_read_timeout, channel_read);
+
+    auto proc = session.exec("something");
+
+    std::vector<std::string> received;
+    proc.read_std_error([&received](std::string_view chunk) { received.emplace_back(chunk); });
+
+    EXPECT_EQ(received, chunks);
+}
+
+TEST_F(SSHProcess, follows_both_streams_until_they_finish)
+{
+    std::map<int, std::vector<std::string>> pending{{0, {"out"}}, {1, {"err", "more err"}}};
+    REPLACE(ssh_channel_poll_timeout, [&pending](ssh_channel, int, int is_stderr) {
+        auto& chunks = pending[is_stderr];
+        return chunks.empty() ? SSH_EOF : static_cast<int>(chunks.front().size());
+    });
+    REPLACE(ssh_channel_read_timeout, [&pending](ssh_channel, void* dest, uint32_t count, int is_stderr, int) {
+        auto& chunks = pending[is_stderr];
+        EXPECT_EQ(count, chunks.front().size());
+        std::copy(chunks.front().begin(), chunks.front().end(), reinterpret_cast<char*>(dest));
+        chunks.erase(chunks.begin());
+        return static_cast<int>(count);
+    });
+
+    auto proc = session.exec("something");
+
+    std::string out, err;
+    auto append_to = [](std::string& stream) { return [&stream](std::string_view chunk) { stream += chunk; }; };
+    auto rounds = 0;
+    while (proc.read_available_output(append_to(out), append_to(err), std::chrono::milliseconds(1)))
+        ++rounds;
+
+    EXPECT_EQ(out, "out");
+    EXPECT_EQ(err, "errmore err");
+    EXPECT_EQ(rounds, 2);
+}
+
+TEST_F(SSHProcess, writes_all_of_the_input_before_closing_it)
+{
+    std::string written;
+    REPLACE(ssh_channel_write, [&written](ssh_channel, const void* data, uint32_t len) {
+        const auto count = std::min(len, 3u); // a little at a time, as the window allows
+        written.append(reinterpret_cast<const char*>(data), count);
+        return static_cast<int>(count);
+    });
+    auto eof_sent = false;
+    REPLACE(ssh_channel_send_eof, [&eof_sent](ssh_channel) {
+        eof_sent = true;
+        return SSH_OK;
+    });
+
+    auto proc = session.exec("something");
+    proc.write_std_input("some input");
+    proc.close_std_input();
+
+    EXPECT_EQ(written, "some input");
+    EXPECT_TRUE(eof_sent);
+}
+
+TEST_F(SSHProcess, final_exit_code_throws_without_a_status)
+{
+    REPLACE(ssh_channel_get_exit_status, [](ssh_channel) { return -1; });
+
+    auto proc = session.exec("something");
+    EXPECT_THROW(proc.final_exit_code(), std::runtime_error);
+}
@@ -100,3 +100,22 @@ TEST(SSHSession, exec_succeeds)
 
     EXPECT_NO_THROW(session.exec("dummy"));
 }
+
+TEST(SSHSession, requests_compression_only_when_asked)
+{
+    mp::test::StubSSHKeyProvider key_provider;
+    std::vector<std::string> compression_values;
+    REPLACE(ssh_options_set, [&](auto, auto type, auto value) {
+        if (type == SSH_OPTIONS_COMPRESSION)
+            compression_values.emplace_back(static_cast<const char*>(value));
+        return SSH_OK;
+    });
+    REPLACE(ssh_connect, [](auto...) { return SSH_OK; });
+    REPLACE(ssh_userauth_publickey, [](auto...) { return SSH_AUTH_SUCCESS; });
+
+    mp::SSHSession{"theanswertoeverything", 42, "ubuntu", key_provider};
+    EXPECT_THAT(compression_values, IsEmpty());
+
+    mp::SSHSession{"theanswertoeverything", 42, "ubuntu", key_provider, std::chrono::seconds(20), true};
+    EXPECT_THAT(compression_values, ElementsAre("yes"));
+}
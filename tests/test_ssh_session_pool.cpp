@@ -0,0 +1,154 @@
+/*
+ * Copyright (C) Canonical, Ltd.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; version 3.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#include "common.h"
+#include "mock_ssh.h"
+#include "mock_ssh_test_fixture.h"
+#include "stub_ssh_key_provider.h"
+
+#include <multipass/exceptions/ssh_exception.h>
+#include <multipass/ssh/ssh_session.h>
+#include <multipass/ssh/ssh_session_pool.h>
+
+#include <stdexcept>
+
+namespace mp = multipass;
+namespace mpt = multipass::test;
+
+using namespace testing;
+
+namespace
+{
+struct SSHSessionPool : public Test
+{
+    void use(const std::string& instance = "foo", const std::string& host = "localhost")
+    {
+        pool.with_session(instance, host, 42, "ubuntu", key_provider, [](mp::SSHSession&) {});
+    }
+
+    int connects{0};
+    mpt::MockSSHTestFixture mock_ssh_test_fixture;
+    MockScope<decltype(mock_ssh_connect)> connect{mock_ssh_connect, [this](auto...) {
+                                                      ++connects;
+                                                      return SSH_OK;
+                                                  }};
+    mpt::StubSSHKeyProvider key_provider;
+    mp::SSHSessionPool pool;
+};
+} // namespace
+
+TEST_F(SSHSessionPool, reuses_sessions)
+{
+    use();
+    use();
+    use();
+
+    EXPECT_EQ(connects, 1);
+}
+
+TEST_F(SSHSessionPool, keeps_instances_apart)
+{
+    use("foo");
+    use("bar");
+    use("foo");
+    use("bar");
+
+    EXPECT_EQ(connects, 2);
+}
+
+TEST_F(SSHSessionPool, does_not_reuse_sessions_to_another_address)
+{
+    use("foo", "10.0.0.1");
+    use("foo", "10.0.0.2");
+
+    EXPECT_EQ(connects, 2);
+}
+
+TEST_F(SSHSessionPool, does_not_reuse_disconnected_sessions)
+{
+    use();
+
+    REPLACE(ssh_is_connected, [](auto...) { return false; });
+    use();
+
+    EXPECT_EQ(connects, 2);
+}
+
+TEST_F(SSHSessionPool, does_not_reuse_sessions_idle_for_too_long)
+{
+    mp::SSHSessionPool impatient_pool{std::chrono::milliseconds::zero()};
+    auto use_impatiently = [this, &impatient_pool] {
+        impatient_pool.with_session("foo", "localhost", 42, "ubuntu", key_provider, [](mp::SSHSession&) {});
+    };
+
+    use_impatiently();
+    use_impatiently();
+
+    EXPECT_EQ(connects, 2);
+}
+
+TEST_F(SSHSessionPool, retries_on_a_new_session_when_a_pooled_one_fails)
+{
+    use();
+
+    auto attempts = 0;
+    pool.with_session("foo", "localhost", 42, "ubuntu", key_provider, [&attempts](mp::SSHSession&) {
+        if (++attempts == 1)
+            throw mp::SSHException{"connection reset"};
+    });
+
+    EXPECT_EQ(attempts, 2);
+    EXPECT_EQ(connects, 2);
+}
+
+TEST_F(SSHSessionPool, does_not_retry_what_failed_for_reasons_other_than_ssh)
+{
+    use();
+
+    auto attempts = 0;
+    EXPECT_THROW(pool.with_session("foo", "localhost", 42, "ubuntu", key_provider,
+                                   [&attempts](mp::SSHSession&) {
+                                       ++attempts;
+                                       throw std::runtime_error{"the command exited with 1"};
+                                   }),
+                 std::runtime_error);
+
+    EXPECT_EQ(attempts, 1);
+    EXPECT_EQ(connects, 1);
+}
+
+TEST_F(SSHSessionPool, lets_failures_on_new_sessions_through)
+{
+    auto attempts = 0;
+    EXPECT_THROW(pool.with_session("foo", "localhost", 42, "ubuntu", key_provider,
+                                   [&attempts](mp::SSHSession&) {
+                                       ++attempts;
+                                       throw std::runtime_error{"nope"};
+                                   }),
+                 std::runtime_error);
+
+    EXPECT_EQ(attempts, 1);
+}
+
+TEST_F(SSHSessionPool, forgets_sessions_to_an_instance)
+{
+    use();
+    pool.forget("foo");
+    use();
+
+    EXPECT_EQ(connects, 2);
+}
@@ -23,11 +23,13 @@
 #include "mock_logger.h"
 #include "mock_process_factory.h"
 #include "mock_server_reader_writer.h"
+#include "mock_settings.h"
 #include "mock_ssh_process_exit_status.h"
 #include "mock_virtual_machine.h"
 #include "stub_ssh_key_provider.h"
 #include "stub_virtual_machine.h"
 
+#include <multipass/constants.h>
 #include <multipass/exceptions/sshfs_missing_error.h>
 #include <multipass/sshfs_mount/sshfs_mount_handler.h>
 #include <multipass/vm_mount.h>
@@ -35,6 +37,8 @@
 #include <thread>
 
 #include <QCoreApplication>
+#include <QJsonDocument>
+#include <QJsonObject>
 #include <QTimer>
 
 namespace mp = multipass;
@@ -95,6 +99,7 @@ struct SSHFSMountHandlerTest : public ::Test
     mp::id_mappings gid_mappings{{1, 2}, {3, 4}}, uid_mappings{{5, -1}, {6, 10}};
     mpt::SetEnvScope env_scope{"DISABLE_APPARMOR", "1"};
     mpt::MockLogger::Scope logger_scope = mpt::MockLogger::inject(default_log_level);
+    mpt::MockSettings::GuardedMock mock_settings_injection = mpt::MockSettings::inject();
     mpt::MockServerReaderWriter<mp::MountReply, mp::MountRequest> server;
     mpt::MockSSHTestFixture mock_ssh_test_fixture;
     mpt::ExitStatusMock exit_status_mock;
@@ -188,6 +193,69 @@ TEST_F(SSHFSMountHandlerTest, stop_terminates_sshfs_process)
     sshfs_mount_handler.deactivate();
 }
 
+TEST_F(SSHFSMountHandlerTest, write_behind_setting_reaches_sshfs_server)
+{
+    auto& mock_settings = *mock_settings_injection.first;
+    EXPECT_CALL(mock_settings, get(_)).Times(AnyNumber());
+    EXPECT_CALL(mock_settings, get(Eq(mp::sshfs_write_behind_key))).WillRepeatedly(Return("true"));
+
+    auto write_behind = false;
+    factory->register_callback(sshfs_server_callback([this, &write_behind](mpt::MockProcess* process) {
+        write_behind = process->process_environment().contains("MULTIPASS_SSHFS_WRITE_BEHIND");
+        sshfs_prints_connected(process);
+    }));
+
+    mp::SSHFSMountHandler sshfs_mount_handler{&vm, &key_provider, target_path, mount};
+    sshfs_mount_handler.activate(&server);
+
+    EXPECT_TRUE(write_behind);
+}
+
+TEST_F(SSHFSMountHandlerTest, shared_server_serves_all_mounts_of_an_instance)
+{
+    auto& mock_settings = *mock_settings_injection.first;
+    EXPECT_CALL(mock_settings, get(_)).Times(AnyNumber());
+    EXPECT_CALL(mock_settings, get(Eq(mp::sshfs_shared_server_key))).WillRepeatedly(Return("true"));
+    EXPECT_CALL(mock_file_ops, status)
+        .WillOnce(Return(mp::fs::file_status{mp::fs::file_type::directory, mp::fs::perms::all}))
+        .RetiresOnSaturation();
+
+    QStringList added;
+    factory->register_callback(sshfs_server_callback([this, &added](mpt::MockProcess* process) {
+        sshfs_prints_connected(process);
+        ON_CALL(*process, running).WillByDefault(Return(true));
+
+        // Have it tell each mount, as it is added, that it is connected
+        EXPECT_CALL(*process, write).WillRepeatedly([process, &added](const QByteArray& line) {
+            const auto command = QJsonDocument::fromJson(line).object();
+            if (command.contains("add"))
+            {
+                added << command["target"].toString();
+                ON_CALL(*process, read_all_standard_output)
+                    .WillByDefault(Return("Connected " + command["add"].toString().toUtf8() + "\n"));
+                QTimer::singleShot(1, process, [process] { emit process->ready_read_standard_output(); });
+            }
+            return line.size();
+        });
+        EXPECT_CALL(*process, terminate);
+        EXPECT_CALL(*process, wait_for_finished).WillOnce(Return(true));
+    }));
+
+    {
+        mp::SSHFSMountHandler first_handler{&vm, &key_provider, target_path, mount};
+        mp::SSHFSMountHandler second_handler{&vm, &key_provider, "/another/target", mount};
+        first_handler.activate(&server);
+        second_handler.activate(&server);
+
+        EXPECT_TRUE(first_handler.is_active());
+        EXPECT_TRUE(second_handler.is_active());
+    }
+
+    ASSERT_EQ(factory->process_list().size(), 1u);
+    EXPECT_EQ(factory->process_list()[0].arguments.first(), "--shared");
+    EXPECT_EQ(added, QStringList({QString::fromStdString(target_path), "/another/target"}));
+}
+
 TEST_F(SSHFSMountHandlerTest, throws_install_sshfs_which_snap_fails)
 {
     auto invoked = false;
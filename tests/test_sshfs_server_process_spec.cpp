@@ -39,7 +39,8 @@ struct TestSSHFSServerProcessSpec : public Test
                                  "source_path",
                                  "target_path",
                                  {{1, 2}, {3, 4}},
-                                 {{5, -1}, {6, 10}}};
+                                 {{5, -1}, {6, 10}},
+                                 false};
 };
 
 TEST_F(TestSSHFSServerProcessSpec, program_correct)
@@ -63,6 +64,27 @@ TEST_F(TestSSHFSServerProcessSpec, arguments_correct)
     EXPECT_EQ(spec.arguments()[7], "0");
 }
 
+TEST_F(TestSSHFSServerProcessSpec, shared_server_arguments_leave_mounts_out)
+{
+    config.shared_sources = {"source_path", "other_source_path"};
+    mp::SSHFSServerProcessSpec spec(config);
+
+    EXPECT_EQ(spec.arguments(), QStringList({"--shared", "host", "42", "username", "0"}));
+}
+
+TEST_F(TestSSHFSServerProcessSpec, shared_server_is_identified_apart_from_a_single_mount)
+{
+    const auto single_mount_identifier = mp::SSHFSServerProcessSpec{config}.identifier();
+
+    config.shared_sources = {"source_path"};
+    const auto shared_identifier = mp::SSHFSServerProcessSpec{config}.identifier();
+
+    config.shared_sources.push_back("other_source_path");
+    EXPECT_TRUE(shared_identifier.startsWith("instance.shared."));
+    EXPECT_NE(shared_identifier, single_mount_identifier);
+    EXPECT_NE(mp::SSHFSServerProcessSpec{config}.identifier(), shared_identifier);
+}
+
 TEST_F(TestSSHFSServerProcessSpec, environment_correct)
 {
     mp::SSHFSServerProcessSpec spec(config);
@@ -71,6 +93,30 @@ TEST_F(TestSSHFSServerProcessSpec, environment_correct)
     EXPECT_EQ(spec.environment().value("KEY"), "private_key");
 }
 
+TEST_F(TestSSHFSServerProcessSpec, environment_asks_for_compression_only_when_configured)
+{
+    EXPECT_FALSE(mp::SSHFSServerProcessSpec{config}.environment().contains("MULTIPASS_SSH_COMPRESSION"));
+
+    config.compression = true;
+    EXPECT_TRUE(mp::SSHFSServerProcessSpec{config}.environment().contains("MULTIPASS_SSH_COMPRESSION"));
+}
+
+TEST_F(TestSSHFSServerProcessSpec, environment_asks_for_write_behind_only_when_configured)
+{
+    EXPECT_FALSE(mp::SSHFSServerProcessSpec{config}.environment().contains("MULTIPASS_SSHFS_WRITE_BEHIND"));
+
+    config.write_behind = true;
+    EXPECT_TRUE(mp::SSHFSServerProcessSpec{config}.environment().contains("MULTIPASS_SSHFS_WRITE_BEHIND"));
+}
+
+TEST_F(TestSSHFSServerProcessSpec, environment_names_mount_profile_only_when_given)
+{
+    EXPECT_FALSE(mp::SSHFSServerProcessSpec{config}.environment().contains("MULTIPASS_SSHFS_MOUNT_PROFILE"));
+
+    config.mount_profile = "throughput";
+    EXPECT_EQ(mp::SSHFSServerProcessSpec{config}.environment().value("MULTIPASS_SSHFS_MOUNT_PROFILE"), "throughput");
+}
+
 TEST_F(TestSSHFSServerProcessSpec, snap_confined_apparmor_profile_returns_expected_data)
 {
     mpt::TempDir bin_dir;
@@ -103,3 +149,15 @@ TEST_F(TestSSHFSServerProcessSpec, unconfined_apparmor_profile_returns_expected_
     EXPECT_TRUE(apparmor_profile.contains(current_dir.absolutePath() + "/{usr/,}lib/**"));
     EXPECT_TRUE(apparmor_profile.contains("signal (receive) peer=unconfined"));
 }
+
+TEST_F(TestSSHFSServerProcessSpec, shared_server_apparmor_profile_allows_every_source)
+{
+    config.shared_sources = {"/source/one", "/source/two"};
+    mp::SSHFSServerProcessSpec spec(config);
+
+    const auto apparmor_profile = spec.apparmor_profile();
+
+    EXPECT_TRUE(apparmor_profile.contains("/source/one/** rwlk,"));
+    EXPECT_TRUE(apparmor_profile.contains("/source/two/** rwlk,"));
+    EXPECT_FALSE(apparmor_profile.contains("source_path"));
+}
@@ -50,7 +50,7 @@ struct SshfsMount : public mp::test::SftpServerTest
     {
         mp::SSHSession session{"a", 42};
         return {std::move(session), default_source, target.value_or(default_target), default_mappings,
-                default_mappings};
+                default_mappings, false, profile};
     }
 
     auto make_exec_that_fails_for(const std::vector<std::string>& expected_cmds, bool& invoked)
@@ -178,6 +178,7 @@ struct SshfsMount : public mp::test::SftpServerTest
 
     std::string default_source{"source"};
     std::string default_target{"target"};
+    std::string profile{};
     mp::id_mappings default_mappings;
     int default_id{1000};
     mpt::MockLogger::Scope logger_scope = mpt::MockLogger::inject();
@@ -400,6 +401,26 @@ TEST_F(SshfsMount, unblocks_when_sftpserver_exits)
     EXPECT_TRUE(stopped_ok);
 }
 
+TEST_F(SshfsMount, mount_profile_picks_sshfs_options)
+{
+    profile = "consistent";
+    CommandVector commands = {
+        {"sudo env LD_LIBRARY_PATH=/foo/bar /baz/bin/sshfs -V", "FUSE library version: 3.0.0\n"},
+        {"sudo env LD_LIBRARY_PATH=/foo/bar /baz/bin/sshfs -o slave -o transform_symlinks -o allow_other -o "
+         "Compression=no -o dir_cache=no -o direct_io -o entry_timeout=0 -o attr_timeout=0 :\"source\" "
+         "\"/home/ubuntu/target\"",
+         "don't care\n"}};
+
+    test_command_execution(commands);
+}
+
+TEST_F(SshfsMount, unknown_mount_profile_throws)
+{
+    profile = "fastest";
+
+    EXPECT_THROW(test_command_execution(CommandVector()), std::invalid_argument);
+}
+
 TEST_F(SshfsMount, blank_fuse_version_logs_error)
 {
     CommandVector commands = {{"sudo env LD_LIBRARY_PATH=/foo/bar /baz/bin/sshfs -V", "FUSE library version:\n"}};
@@ -0,0 +1,109 @@
+/*
+ * Copyright (C) Canonical, Ltd.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; version 3.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#include "common.h"
+#include "temp_dir.h"
+
+#include <multipass/logging/tracer.h>
+
+#include <QFile>
+#include <QJsonArray>
+#include <QJsonDocument>
+#include <QJsonObject>
+
+#include <thread>
+
+namespace mpl = multipass::logging;
+namespace mpt = multipass::test;
+
+using namespace std::chrono_literals;
+using namespace testing;
+
+namespace
+{
+struct Tracer : public Test
+{
+    // Lets every test start over, the file is only looked up once
+    struct ResettableTracer : public mpl::Tracer
+    {
+        static void reset_instance()
+        {
+            reset();
+        }
+    };
+
+    Tracer()
+    {
+        qputenv(mpl::trace_file_env_var, trace_file.toUtf8());
+        ResettableTracer::reset_instance();
+    }
+
+    ~Tracer()
+    {
+        qunsetenv(mpl::trace_file_env_var);
+        ResettableTracer::reset_instance();
+    }
+
+    QJsonArray read_trace()
+    {
+        QFile file{trace_file};
+        EXPECT_TRUE(file.open(QIODevice::ReadOnly));
+
+        // What gets written is left open for more, close it as a viewer would
+        auto contents = file.readAll().trimmed();
+        if (contents.endsWith(','))
+            contents.chop(1);
+
+        return QJsonDocument::fromJson(contents + ']').array();
+    }
+
+    mpt::TempDir temp_dir;
+    const QString trace_file{temp_dir.filePath("trace.json")};
+};
+} // namespace
+
+TEST_F(Tracer, writes_spans_as_complete_trace_events)
+{
+    {
+        mpl::TraceSpan span{"wait_until_ssh_up", "zebraphant"};
+        std::this_thread::sleep_for(2ms);
+    }
+    mpl::TraceSpan{"download_to"};
+
+    const auto events = read_trace();
+    ASSERT_EQ(events.size(), 2);
+
+    const auto first = events[0].toObject();
+    EXPECT_EQ(first["name"].toString(), "wait_until_ssh_up");
+    EXPECT_EQ(first["ph"].toString(), "X");
+    EXPECT_GE(first["dur"].toDouble(), 2000);
+    EXPECT_EQ(first["args"].toObject()["detail"].toString(), "zebraphant");
+
+    const auto second = events[1].toObject();
+    EXPECT_EQ(second["name"].toString(), "download_to");
+    EXPECT_GE(second["ts"].toDouble(), first["ts"].toDouble() + first["dur"].toDouble());
+    EXPECT_FALSE(second.contains("args"));
+}
+
+TEST_F(Tracer, records_nothing_without_a_trace_file)
+{
+    qunsetenv(mpl::trace_file_env_var);
+
+    mpl::TraceSpan{"create_vm", "zebraphant"};
+
+    EXPECT_FALSE(QFile::exists(trace_file));
+}
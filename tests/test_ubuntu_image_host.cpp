@@ -22,6 +22,7 @@
 #include "mock_settings.h"
 #include "path.h"
 #include "stub_url_downloader.h"
+#include "temp_dir.h"
 
 #include <src/daemon/ubuntu_image_host.h>
 
@@ -46,6 +47,29 @@ using namespace std::literals::chrono_literals;
 
 namespace
 {
+// Pretends the server has a single version of everything, which it tells apart by its ETag
+struct ValidatingURLDownloader : public mpt::MischievousURLDownloader
+{
+    ValidatingURLDownloader() : MischievousURLDownloader{std::chrono::seconds{10}}
+    {
+    }
+
+    std::optional<QByteArray> download_if_changed(const QUrl& url, Validators& validators) override
+    {
+        if (validators.etag == "\"v1\"")
+        {
+            ++unchanged;
+            return std::nullopt;
+        }
+
+        auto bytes = MischievousURLDownloader::download_if_changed(url, validators);
+        validators.etag = "\"v1\"";
+        return bytes;
+    }
+
+    std::atomic_int unchanged{0};
+};
+
 struct UbuntuImageHost : public testing::Test
 {
     UbuntuImageHost()
@@ -134,6 +158,21 @@ TEST_F(UbuntuImageHost, returns_expected_mirror_info_with_most_recent_image)
     EXPECT_THAT(info->id, Eq(expected_id));
 }
 
+TEST_F(UbuntuImageHost, uses_a_responsive_mirror_among_several)
+{
+    const auto missing_mirror_host = QUrl::fromLocalFile(mpt::test_data_path() + "missing_image_mirror/").toString();
+    EXPECT_CALL(mock_settings, get(Eq(mp::mirror_key)))
+        .WillRepeatedly(Return(missing_mirror_host + "," + test_valid_mirror_host));
+
+    mp::UbuntuVMImageHost host{{release_remote_spec_with_mirror_allowed}, &url_downloader, default_ttl};
+
+    auto info = host.info_for(make_query("xenial", release_remote_spec.first));
+    QString expected_location{test_valid_mirror_host + "releases/" + "newest_image.img"};
+
+    ASSERT_TRUE(info);
+    EXPECT_THAT(info->image_location, Eq(expected_location));
+}
+
 TEST_F(UbuntuImageHost, throw_if_mirror_is_invalid)
 {
     EXPECT_CALL(mock_settings, get(Eq(mp::mirror_key))).WillRepeatedly(Return(test_invalid_mirror_host));
@@ -218,6 +257,19 @@ TEST_F(UbuntuImageHost, can_query_by_partial_hash)
     EXPECT_FALSE(host.info_for(make_query("abcde", release_remote_spec.first)));
 }
 
+TEST_F(UbuntuImageHost, info_for_full_hash_finds_image_by_its_complete_hash_only)
+{
+    mp::UbuntuVMImageHost host{{release_remote_spec}, &url_downloader, default_ttl};
+    const auto expected_id = "1797c5c82016c1e65f4008fcf89deae3a044ef76087a9ec5b907c6d64a3609ac";
+
+    auto info = host.info_for_full_hash(expected_id);
+    EXPECT_THAT(info.id, Eq(expected_id));
+    EXPECT_THAT(info.image_location, StartsWith(host_url));
+
+    EXPECT_THROW(host.info_for_full_hash("1797c5"), std::runtime_error);
+    EXPECT_THROW(host.info_for_full_hash("default"), std::runtime_error);
+}
+
 TEST_F(UbuntuImageHost, supports_multiple_manifests)
 {
     mp::UbuntuVMImageHost host{all_remote_specs, &url_downloader, default_ttl};
@@ -359,7 +411,7 @@ TEST_F(UbuntuImageHost, handles_and_recovers_from_initial_network_failure)
     EXPECT_TRUE(host.info_for(query));
 }
 
-TEST_F(UbuntuImageHost, handles_and_recovers_from_later_network_failure)
+TEST_F(UbuntuImageHost, keeps_serving_stale_manifests_through_later_network_failure)
 {
     const auto ttl = 0s; // to ensure updates are always retried
     mp::UbuntuVMImageHost host{all_remote_specs, &url_downloader, ttl};
@@ -368,7 +420,7 @@ TEST_F(UbuntuImageHost, handles_and_recovers_from_later_network_failure)
     EXPECT_TRUE(host.info_for(query));
 
     url_downloader.mischiefs = 1000;
-    EXPECT_THROW(host.info_for(query), std::runtime_error);
+    EXPECT_TRUE(host.info_for(query));
 
     url_downloader.mischiefs = 0;
     EXPECT_TRUE(host.info_for(query));
@@ -377,18 +429,41 @@ TEST_F(UbuntuImageHost, handles_and_recovers_from_later_network_failure)
 TEST_F(UbuntuImageHost, handles_and_recovers_from_independent_server_failures)
 {
     const auto ttl = 0h;
-    mp::UbuntuVMImageHost host{all_remote_specs, &url_downloader, ttl};
-
-    const auto num_remotes = mpt::count_remotes(host);
+    mp::UbuntuVMImageHost healthy_host{all_remote_specs, &url_downloader, ttl};
+    const auto num_remotes = mpt::count_remotes(healthy_host);
     EXPECT_GT(num_remotes, 0u);
 
     for (size_t i = 0; i < num_remotes; ++i)
     {
+        // A fresh host each time, there would be stale manifests serving in place of the failed ones otherwise
+        mp::UbuntuVMImageHost host{all_remote_specs, &url_downloader, ttl};
         url_downloader.mischiefs = i;
         EXPECT_EQ(mpt::count_remotes(host), num_remotes - i);
     }
 }
 
+TEST_F(UbuntuImageHost, reuses_manifests_that_did_not_change)
+{
+    mpt::TempDir cache_dir;
+    ValidatingURLDownloader validating_url_downloader;
+    const auto query = make_query("xenial", release_remote_spec.first);
+
+    {
+        mp::UbuntuVMImageHost host{all_remote_specs, &validating_url_downloader, 0s, cache_dir.path()};
+        EXPECT_TRUE(host.info_for(query));
+        EXPECT_EQ(validating_url_downloader.unchanged, 0);
+
+        EXPECT_TRUE(host.info_for(query));
+        EXPECT_GT(validating_url_downloader.unchanged, 0);
+    }
+
+    // Nothing is downloaded again, the manifests come from the cache
+    mp::UbuntuVMImageHost host{all_remote_specs, &validating_url_downloader, 0s, cache_dir.path()};
+    const auto unchanged = validating_url_downloader.unchanged.load();
+    EXPECT_TRUE(host.info_for(query));
+    EXPECT_GT(validating_url_downloader.unchanged, unchanged);
+}
+
 TEST_F(UbuntuImageHost, throws_unsupported_image_when_image_not_supported)
 {
     mp::UbuntuVMImageHost host{all_remote_specs, &url_downloader, default_ttl};
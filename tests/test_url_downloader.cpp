@@ -16,6 +16,7 @@
  */
 
 #include "common.h"
+#include "file_operations.h"
 #include "mock_file_ops.h"
 #include "mock_logger.h"
 #include "mock_network.h"
@@ -26,6 +27,9 @@
 
 #include <QTimer>
 
+#include <algorithm>
+#include <vector>
+
 namespace mp = multipass;
 namespace mpl = multipass::logging;
 namespace mpt = multipass::test;
@@ -51,7 +55,33 @@ struct URLDownloader : public Test
     mpt::MockNetworkManagerFactory* mock_network_manager_factory{attr.first};
     std::unique_ptr<NiceMock<mpt::MockQNetworkAccessManager>> mock_network_access_manager;
     const QUrl fake_url{"http://a.fake.url"};
-    mpt::MockLogger::Scope logger_scope = mpt::MockLogger::inject();
+    mpt::MockLogger::Scope logger_scope = mpt::MockLogger::inject(mpl::Level::trace);
+};
+
+// A 206 reply with its slice of the file, handing over as much of it as has arrived
+struct RangeReply
+{
+    explicit RangeReply(const QByteArray& slice) : slice{slice}
+    {
+        reply->set_attribute(QNetworkRequest::HttpStatusCodeAttribute, 206);
+        EXPECT_CALL(*reply, readData(_, _)).WillRepeatedly([this](char* data, qint64 max_size) {
+            const auto count = std::min(max_size, arrived - read);
+            memcpy(data, this->slice.constData() + read, count);
+            read += count;
+            return count;
+        });
+    }
+
+    void arrive(qint64 up_to)
+    {
+        arrived = up_to;
+        reply->readyRead();
+    }
+
+    mpt::MockQNetworkReply* reply{new mpt::MockQNetworkReply()}; // the downloader's to delete once requested
+    const QByteArray slice;
+    qint64 arrived{0};
+    qint64 read{0};
 };
 } // namespace
 
@@ -84,6 +114,31 @@ TEST_F(URLDownloader, simpleDownloadReturnsExpectedData)
     EXPECT_EQ(downloaded_data, test_data);
 }
 
+TEST_F(URLDownloader, downloadsReuseTheNetworkManagerOfTheirThread)
+{
+    const QByteArray test_data{"42"};
+    auto make_reply = [&test_data] {
+        auto mock_reply = new mpt::MockQNetworkReply();
+        EXPECT_CALL(*mock_reply, readData(_, _))
+            .WillOnce([&test_data](char* data, auto) {
+                memcpy(data, test_data.constData(), test_data.size());
+                return test_data.size();
+            })
+            .WillRepeatedly(Return(0));
+        QTimer::singleShot(0, [mock_reply] { mock_reply->finished(); });
+        return mock_reply;
+    };
+
+    // Made only once, by the fixture's expectation
+    EXPECT_CALL(*mock_network_access_manager, createRequest(_, _, _))
+        .Times(2)
+        .WillRepeatedly(InvokeWithoutArgs(make_reply));
+
+    mp::URLDownloader downloader(cache_dir.path(), 1s);
+    EXPECT_EQ(downloader.download(fake_url), test_data);
+    EXPECT_EQ(downloader.download(fake_url), test_data);
+}
+
 TEST_F(URLDownloader, simpleDownloadNetworkTimeoutTriesCache)
 {
     mpt::MockQNetworkReply* mock_reply_abort = new mpt::MockQNetworkReply();
@@ -217,6 +272,73 @@ TEST_F(URLDownloader, fileDownloadNoErrorHasExpectedResults)
     EXPECT_EQ(file_data, test_data);
 }
 
+TEST_F(URLDownloader, chunkDownloadHandsOverDataAsItArrives)
+{
+    mpt::MockQNetworkReply* mock_reply = new mpt::MockQNetworkReply();
+    const QByteArray test_data{"This is some data to be handed over as it comes in."};
+    const int download_type{-1};
+
+    EXPECT_CALL(*mock_network_access_manager, createRequest(_, _, _)).WillOnce([&mock_reply, &test_data](auto...) {
+        QTimer::singleShot(0, [&mock_reply, &test_data] {
+            mock_reply->downloadProgress(test_data.size(), test_data.size());
+            mock_reply->readyRead();
+            mock_reply->finished();
+        });
+        return mock_reply;
+    });
+
+    EXPECT_CALL(*mock_reply, readData(_, _))
+        .WillOnce([&test_data](char* data, auto) {
+            auto data_size{test_data.size()};
+            memcpy(data, test_data.constData(), data_size);
+
+            return data_size;
+        })
+        .WillRepeatedly(Return(0));
+
+    mp::URLDownloader downloader(cache_dir.path(), 10ms);
+
+    QByteArray received;
+    bool restarted{false};
+    downloader.download_chunks(
+        fake_url, [&received](const QByteArray& chunk) { received.append(chunk); }, [&restarted] { restarted = true; },
+        test_data.size(), download_type, [](auto...) { return true; });
+
+    EXPECT_EQ(received, test_data);
+    EXPECT_FALSE(restarted);
+}
+
+TEST_F(URLDownloader, chunkDownloadPassesOnChunkActionErrors)
+{
+    mpt::MockQNetworkReply* mock_reply = new mpt::MockQNetworkReply();
+    const QByteArray test_data{"This is some data the chunk action chokes on."};
+
+    EXPECT_CALL(*mock_network_access_manager, createRequest(_, _, _)).WillOnce([&mock_reply, &test_data](auto...) {
+        QTimer::singleShot(0, [&mock_reply, &test_data] {
+            mock_reply->downloadProgress(test_data.size(), test_data.size());
+            mock_reply->readyRead();
+            mock_reply->finished();
+        });
+        return mock_reply;
+    });
+
+    EXPECT_CALL(*mock_reply, readData(_, _))
+        .WillOnce([&test_data](char* data, auto) {
+            auto data_size{test_data.size()};
+            memcpy(data, test_data.constData(), data_size);
+
+            return data_size;
+        })
+        .WillRepeatedly(Return(0));
+
+    mp::URLDownloader downloader(cache_dir.path(), 10ms);
+
+    MP_EXPECT_THROW_THAT(downloader.download_chunks(
+                             fake_url, [](const QByteArray&) { throw std::runtime_error("bad chunk"); }, [] {},
+                             test_data.size(), -1, [](auto...) { return true; }),
+                         std::runtime_error, mpt::match_what(StrEq("bad chunk")));
+}
+
 TEST_F(URLDownloader, fileDownloadErrorTriesCache)
 {
     mpt::MockQNetworkReply* mock_reply_abort = new mpt::MockQNetworkReply();
@@ -269,6 +391,166 @@ TEST_F(URLDownloader, fileDownloadErrorTriesCache)
     EXPECT_EQ(file_data, test_data);
 }
 
+TEST_F(URLDownloader, fileDownloadWithoutRangeSupportFallsBackToSingleStream)
+{
+    mpt::MockQNetworkReply* mock_reply_ranges[]{new mpt::MockQNetworkReply(), new mpt::MockQNetworkReply()};
+    mpt::MockQNetworkReply* mock_reply = new mpt::MockQNetworkReply();
+    const QByteArray test_data{"This is some data to put in a file when downloaded."};
+    const qint64 size{32 * 1024 * 1024};
+    std::vector<QByteArray> ranges;
+
+    for (auto mock_reply_range : mock_reply_ranges)
+        EXPECT_CALL(*mock_reply_range, abort()).WillOnce([mock_reply_range] { mock_reply_range->abort_operation(); });
+
+    EXPECT_CALL(*mock_network_access_manager, createRequest(_, _, _))
+        .Times(3)
+        .WillRepeatedly([&](auto, const QNetworkRequest& request, auto) -> QNetworkReply* {
+            ranges.push_back(request.rawHeader("Range"));
+
+            if (ranges.size() == 1)
+                QTimer::singleShot(0, [&mock_reply_ranges] {
+                    mock_reply_ranges[0]->set_attribute(QNetworkRequest::HttpStatusCodeAttribute, 200);
+                    mock_reply_ranges[0]->readyRead();
+                });
+
+            if (ranges.size() <= 2)
+                return mock_reply_ranges[ranges.size() - 1];
+
+            QTimer::singleShot(0, [&mock_reply, &test_data] {
+                mock_reply->downloadProgress(test_data.size(), test_data.size());
+                mock_reply->readyRead();
+                mock_reply->finished();
+            });
+            return mock_reply;
+        });
+
+    EXPECT_CALL(*mock_reply, readData(_, _))
+        .WillOnce([&test_data](char* data, auto) {
+            auto data_size{test_data.size()};
+            memcpy(data, test_data.constData(), data_size);
+
+            return data_size;
+        })
+        .WillRepeatedly(Return(0));
+
+    mp::URLDownloader downloader(cache_dir.path(), 10ms);
+
+    mpt::TempDir file_dir;
+    QString download_file{file_dir.path() + "/foo.txt"};
+
+    downloader.download_to(fake_url, download_file, size, -1, [](auto...) { return true; });
+
+    EXPECT_THAT(ranges, ElementsAre("bytes=0-16777215", "bytes=16777216-33554431", ""));
+
+    QFile file{download_file};
+    ASSERT_TRUE(file.open(QIODevice::ReadOnly));
+    EXPECT_EQ(file.readAll(), test_data);
+}
+
+TEST_F(URLDownloader, fileDownloadInRangesWritesEachWhereItBelongs)
+{
+    const qint64 size{32 * 1024 * 1024};
+    const auto segment_size = static_cast<int>(size / 2);
+    QByteArray test_data{static_cast<int>(size), Qt::Uninitialized};
+    for (qint64 i = 0; i < size; ++i)
+        test_data[static_cast<int>(i)] = static_cast<char>(i % 251);
+
+    RangeReply first{test_data.left(segment_size)}, second{test_data.mid(segment_size)};
+    std::vector<QByteArray> ranges;
+
+    EXPECT_CALL(*mock_network_access_manager, createRequest(_, _, _))
+        .Times(2)
+        .WillRepeatedly([&](auto, const QNetworkRequest& request, auto) -> QNetworkReply* {
+            ranges.push_back(request.rawHeader("Range"));
+            if (ranges.size() == 1)
+                return first.reply;
+
+            // Interleaved, the later range getting ahead
+            QTimer::singleShot(0, [&] {
+                second.arrive(segment_size / 2);
+                first.arrive(segment_size / 3);
+                first.arrive(segment_size);
+                second.arrive(segment_size);
+                first.reply->finished();
+                second.reply->finished();
+            });
+            return second.reply;
+        });
+
+    mp::URLDownloader downloader(cache_dir.path(), 1s);
+
+    mpt::TempDir file_dir;
+    QString download_file{file_dir.path() + "/foo.txt"};
+
+    downloader.download_to(fake_url, download_file, size, -1, [](auto...) { return true; });
+
+    EXPECT_THAT(ranges, ElementsAre("bytes=0-16777215", "bytes=16777216-33554431"));
+
+    QFile file{download_file};
+    ASSERT_TRUE(file.open(QIODevice::ReadOnly));
+    EXPECT_TRUE(file.readAll() == test_data);
+    EXPECT_FALSE(QFile::exists(download_file + mp::URLDownloader::partial_download_suffix));
+}
+
+TEST_F(URLDownloader, fileDownloadInRangesFallsBackToSingleStreamWhenASegmentFails)
+{
+    const qint64 size{32 * 1024 * 1024};
+    const auto segment_size = static_cast<int>(size / 2);
+    const QByteArray test_data{"This is some data to put in a file when downloaded."};
+    RangeReply first{QByteArray{segment_size, 'a'}}, second{QByteArray{segment_size, 'b'}};
+    mpt::MockQNetworkReply* mock_reply = new mpt::MockQNetworkReply();
+    std::vector<QByteArray> ranges;
+
+    EXPECT_CALL(*mock_network_access_manager, createRequest(_, _, _))
+        .Times(3)
+        .WillRepeatedly([&](auto, const QNetworkRequest& request, auto) -> QNetworkReply* {
+            ranges.push_back(request.rawHeader("Range"));
+            if (ranges.size() == 1)
+                return first.reply;
+
+            if (ranges.size() == 2)
+            {
+                QTimer::singleShot(0, [&] {
+                    first.arrive(segment_size / 2);
+                    first.reply->set_error(QNetworkReply::RemoteHostClosedError, "Remote host closed");
+                    first.reply->finished();
+                    second.arrive(segment_size);
+                    second.reply->finished();
+                });
+                return second.reply;
+            }
+
+            QTimer::singleShot(0, [&mock_reply] {
+                mock_reply->readyRead();
+                mock_reply->finished();
+            });
+            return mock_reply;
+        });
+
+    EXPECT_CALL(*mock_reply, readData(_, _))
+        .WillOnce([&test_data](char* data, auto) {
+            memcpy(data, test_data.constData(), test_data.size());
+            return test_data.size();
+        })
+        .WillRepeatedly(Return(0));
+
+    logger_scope.mock_logger->screen_logs(mpl::Level::error);
+    logger_scope.mock_logger->expect_log(mpl::Level::info, "in ranges: Remote host closed - using a single stream");
+
+    mp::URLDownloader downloader(cache_dir.path(), 1s);
+
+    mpt::TempDir file_dir;
+    QString download_file{file_dir.path() + "/foo.txt"};
+
+    downloader.download_to(fake_url, download_file, size, -1, [](auto...) { return true; });
+
+    EXPECT_THAT(ranges, ElementsAre("bytes=0-16777215", "bytes=16777216-33554431", ""));
+
+    QFile file{download_file};
+    ASSERT_TRUE(file.open(QIODevice::ReadOnly));
+    EXPECT_EQ(file.readAll(), test_data);
+}
+
 TEST_F(URLDownloader, fileDownloadMonitorReturnFalseAborts)
 {
     mpt::MockQNetworkReply* mock_reply = new mpt::MockQNetworkReply();
@@ -293,6 +575,146 @@ TEST_F(URLDownloader, fileDownloadMonitorReturnFalseAborts)
     EXPECT_FALSE(QFile::exists(download_file));
 }
 
+TEST_F(URLDownloader, fileDownloadAbortKeepsResumablePartialFile)
+{
+    mpt::MockQNetworkReply* mock_reply = new mpt::MockQNetworkReply();
+    const QByteArray test_data{"This is the first part of some data to put in a file."};
+
+    mock_reply->set_raw_header("ETag", "\"an-etag\"");
+
+    EXPECT_CALL(*mock_reply, abort()).WillOnce([&mock_reply] { mock_reply->abort_operation(); });
+
+    EXPECT_CALL(*mock_network_access_manager, createRequest(_, _, _)).WillOnce([&mock_reply](auto...) {
+        QTimer::singleShot(0, [&mock_reply] {
+            mock_reply->readyRead();
+            mock_reply->downloadProgress(1000, 2000);
+        });
+        return mock_reply;
+    });
+
+    EXPECT_CALL(*mock_reply, readData(_, _))
+        .WillOnce([&test_data](char* data, auto) {
+            auto data_size{test_data.size()};
+            memcpy(data, test_data.constData(), data_size);
+
+            return data_size;
+        })
+        .WillRepeatedly(Return(0));
+
+    mp::URLDownloader downloader(cache_dir.path(), 10ms);
+
+    mpt::TempDir file_dir;
+    QString download_file{file_dir.path() + "/foo.txt"};
+
+    EXPECT_THROW(downloader.download_to(fake_url, download_file, -1, -1, [](auto...) { return false; }),
+                 mp::AbortedDownloadException);
+
+    EXPECT_FALSE(QFile::exists(download_file));
+
+    QFile partial_file{download_file + mp::URLDownloader::partial_download_suffix};
+    ASSERT_TRUE(partial_file.open(QIODevice::ReadOnly));
+    EXPECT_EQ(partial_file.readAll(), test_data);
+    EXPECT_TRUE(QFile::exists(partial_file.fileName() + ".json"));
+}
+
+TEST_F(URLDownloader, fileDownloadResumesPartialFile)
+{
+    mpt::MockQNetworkReply* mock_reply = new mpt::MockQNetworkReply();
+    const QByteArray first_part{"This is the first part of some data, "};
+    const QByteArray second_part{"and this is the rest of it."};
+
+    mpt::TempDir file_dir;
+    QString download_file{file_dir.path() + "/foo.txt"};
+    const auto partial_file_name = download_file + mp::URLDownloader::partial_download_suffix;
+    mpt::make_file_with_content(partial_file_name, first_part.toStdString());
+    mpt::make_file_with_content(partial_file_name + ".json",
+                                fmt::format(R"({{"url": "{}", "validator": "\"an-etag\""}})", fake_url.toString()));
+
+    QNetworkRequest request;
+    EXPECT_CALL(*mock_network_access_manager, createRequest(_, _, _))
+        .WillOnce([&mock_reply, &request, &first_part, &second_part](auto, const QNetworkRequest& req, auto) {
+            request = req;
+            QTimer::singleShot(0, [&mock_reply, &first_part, &second_part] {
+                mock_reply->set_attribute(QNetworkRequest::HttpStatusCodeAttribute, 206);
+                mock_reply->set_raw_header("Content-Range", QByteArray{"bytes "} +
+                                                                QByteArray::number(first_part.size()) + "-*/*");
+                mock_reply->readyRead();
+                mock_reply->finished();
+            });
+            return mock_reply;
+        });
+
+    EXPECT_CALL(*mock_reply, readData(_, _))
+        .WillOnce([&second_part](char* data, auto) {
+            auto data_size{second_part.size()};
+            memcpy(data, second_part.constData(), data_size);
+
+            return data_size;
+        })
+        .WillRepeatedly(Return(0));
+
+    mp::URLDownloader downloader(cache_dir.path(), 10ms);
+
+    downloader.download_to(fake_url, download_file, -1, -1, [](auto...) { return true; });
+
+    EXPECT_EQ(request.rawHeader("Range"), QByteArray{"bytes="} + QByteArray::number(first_part.size()) + "-");
+    EXPECT_EQ(request.rawHeader("If-Range"), "\"an-etag\"");
+
+    QFile file{download_file};
+    ASSERT_TRUE(file.open(QIODevice::ReadOnly));
+    EXPECT_EQ(file.readAll(), first_part + second_part);
+    EXPECT_FALSE(QFile::exists(partial_file_name));
+    EXPECT_FALSE(QFile::exists(partial_file_name + ".json"));
+}
+
+TEST_F(URLDownloader, rangeDownloadReturnsTheRange)
+{
+    mpt::MockQNetworkReply* mock_reply = new mpt::MockQNetworkReply();
+    const QByteArray range_data{"in the middle"};
+
+    QNetworkRequest request;
+    EXPECT_CALL(*mock_network_access_manager, createRequest(_, _, _))
+        .WillOnce([&mock_reply, &request](auto, const QNetworkRequest& req, auto) {
+            request = req;
+            QTimer::singleShot(0, [&mock_reply] {
+                mock_reply->set_attribute(QNetworkRequest::HttpStatusCodeAttribute, 206);
+                mock_reply->set_raw_header("Content-Range", "bytes 100-112/1000");
+                mock_reply->readyRead();
+                mock_reply->finished();
+            });
+            return mock_reply;
+        });
+
+    EXPECT_CALL(*mock_reply, readData(_, _))
+        .WillOnce([&range_data](char* data, auto) {
+            memcpy(data, range_data.constData(), range_data.size());
+            return range_data.size();
+        })
+        .WillRepeatedly(Return(0));
+
+    mp::URLDownloader downloader(cache_dir.path(), 1s);
+
+    EXPECT_EQ(downloader.download_range(fake_url, 100, range_data.size()), range_data);
+    EXPECT_EQ(request.rawHeader("Range"), "bytes=100-112");
+}
+
+TEST_F(URLDownloader, rangeDownloadThrowsWhenTheWholeFileComes)
+{
+    mpt::MockQNetworkReply* mock_reply = new mpt::MockQNetworkReply();
+
+    EXPECT_CALL(*mock_network_access_manager, createRequest(_, _, _)).WillOnce([&mock_reply](auto...) {
+        QTimer::singleShot(0, [&mock_reply] {
+            mock_reply->set_attribute(QNetworkRequest::HttpStatusCodeAttribute, 200);
+            mock_reply->finished();
+        });
+        return mock_reply;
+    });
+
+    mp::URLDownloader downloader(cache_dir.path(), 1s);
+
+    EXPECT_THROW(downloader.download_range(fake_url, 100, 13), mp::DownloadException);
+}
+
 TEST_F(URLDownloader, fileDownloadZeroBytesReceivedDoesNotCallMonitor)
 {
     mpt::MockQNetworkReply* mock_reply = new mpt::MockQNetworkReply();
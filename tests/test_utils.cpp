@@ -20,6 +20,7 @@
 #include "mock_file_ops.h"
 #include "mock_logger.h"
 #include "mock_openssl_syscalls.h"
+#include "mock_platform.h"
 #include "mock_ssh.h"
 #include "mock_ssh_process_exit_status.h"
 #include "mock_ssh_test_fixture.h"
@@ -36,8 +37,17 @@
 
 #include <gtest/gtest-death-test.h>
 
+#include <atomic>
+#include <chrono>
+#include <functional>
 #include <sstream>
+#include <stdexcept>
 #include <string>
+#include <thread>
+#include <vector>
+
+#include <fcntl.h>
+#include <sys/stat.h>
 
 namespace mp = multipass;
 namespace mpl = multipass::logging;
@@ -529,6 +539,35 @@ TEST(Utils, split_returns_one_token_if_no_delimiter)
     EXPECT_THAT(tokens[0], StrEq(content));
 }
 
+TEST(Utils, lines_of_gives_what_getline_does)
+{
+    for (const std::string content : {"", "\n", "one", "one\ntwo", "one\n\nthree\n"})
+    {
+        std::vector<std::string> expected_lines;
+        std::istringstream stream{content};
+        for (std::string line; std::getline(stream, line);)
+            expected_lines.push_back(line);
+
+        const auto lines = mp::utils::lines_of(content);
+        EXPECT_THAT(std::vector<std::string>(lines.begin(), lines.end()), ContainerEq(expected_lines))
+            << "for \"" << content << "\"";
+    }
+}
+
+TEST(Utils, tokens_of_skips_runs_of_delimiters)
+{
+    const std::string content{"  eth0 \t UP   10.0.0.2/24  "};
+
+    const auto tokens = mp::utils::tokens_of(content);
+    EXPECT_THAT(std::vector<std::string_view>(tokens.begin(), tokens.end()), ElementsAre("eth0", "UP", "10.0.0.2/24"));
+}
+
+TEST(Utils, tokens_of_gives_nothing_for_only_delimiters)
+{
+    const auto tokens = mp::utils::tokens_of(" :: ", " :");
+    EXPECT_EQ(tokens.begin(), tokens.end());
+}
+
 TEST(Utils, valid_mac_address_works)
 {
     EXPECT_TRUE(mp::utils::valid_mac_address("00:11:22:33:44:55"));
@@ -674,6 +713,50 @@ TEST(Utils, line_matcher_no_match_returns_empty_string)
     EXPECT_TRUE(snap_data.empty());
 }
 
+TEST(Utils, run_concurrently_runs_every_task_on_no_more_workers_than_asked)
+{
+    std::atomic_int running{0}, most_running{0};
+    std::vector<int> ran(8, 0); // each written by one task, read once they are all done
+    std::vector<std::function<void()>> tasks;
+    for (auto i = 0u; i < ran.size(); ++i)
+        tasks.emplace_back([&running, &most_running, &ran, i] {
+            const auto now_running = ++running;
+            for (auto most = most_running.load(); most < now_running;)
+                most_running.compare_exchange_weak(most, now_running);
+
+            std::this_thread::sleep_for(std::chrono::milliseconds{10});
+            ran[i] = 1;
+            --running;
+        });
+
+    mp::utils::run_concurrently(tasks, 3);
+
+    EXPECT_THAT(ran, Each(1));
+    EXPECT_LE(most_running, 3);
+    EXPECT_GE(most_running, 1);
+}
+
+TEST(Utils, run_concurrently_rethrows_a_failure_once_every_task_ran)
+{
+    std::atomic_int ran{0};
+    std::vector<std::function<void()>> tasks;
+    for (auto i = 0; i < 6; ++i)
+        tasks.emplace_back([&ran, i] {
+            ++ran;
+            if (i == 1)
+                throw std::runtime_error{"task failed"};
+        });
+
+    MP_EXPECT_THROW_THAT(mp::utils::run_concurrently(tasks, 2), std::runtime_error,
+                         mpt::match_what(StrEq("task failed")));
+    EXPECT_EQ(ran, 6);
+}
+
+TEST(Utils, run_concurrently_without_tasks_returns_right_away)
+{
+    EXPECT_NO_THROW(mp::utils::run_concurrently({}, 4));
+}
+
 TEST(Utils, make_dir_creates_correct_dir)
 {
     mpt::TempDir temp_dir;
@@ -735,6 +818,24 @@ TEST(Utils, wait_for_cloud_init_error_times_out_throws)
                          mpt::match_what(StrEq("timed out waiting for initialization to complete")));
 }
 
+TEST(Utils, wait_for_cloud_init_is_done_once_the_guest_is_ready)
+{
+    mpt::MockSSHTestFixture mock_ssh_test_fixture;
+    REPLACE(ssh_connect, [](auto...) {
+        ADD_FAILURE() << "no session needed once ready";
+        return SSH_ERROR;
+    });
+
+    mp::test::StubSSHKeyProvider key_provider;
+    NiceMock<mpt::MockVirtualMachine> vm{"my_instance"};
+    vm.guest_ready = true;
+
+    EXPECT_CALL(vm, ensure_vm_is_running()).WillRepeatedly(Return());
+
+    std::chrono::milliseconds timeout(1);
+    EXPECT_NO_THROW(MP_UTILS.wait_for_cloud_init(&vm, timeout, key_provider));
+}
+
 TEST(Utils, wait_for_cloud_init_cannot_connect_times_out)
 {
     mpt::MockSSHTestFixture mock_ssh_test_fixture;
@@ -766,6 +867,123 @@ TEST(VaultUtils, copy_creates_new_file_and_returned_path_exists)
     EXPECT_TRUE(QFile::exists(new_file_path));
 }
 
+TEST(VaultUtils, copy_keeps_content_and_leaves_out_runs_of_zeros)
+{
+    mpt::TempDir temp_dir1, temp_dir2;
+    auto orig_file_path = QDir(temp_dir1.path()).filePath("test_file");
+
+    auto content = std::string(1 << 21, '\0');
+    content.replace(12345, 4, "data");
+    content.back() = 'x';
+    mpt::make_file_with_content(orig_file_path, content);
+
+    auto new_file_path = mp::vault::copy(orig_file_path, temp_dir2.path());
+
+    QFile new_file{new_file_path};
+    ASSERT_TRUE(new_file.open(QIODevice::ReadOnly));
+    EXPECT_EQ(new_file.readAll().toStdString(), content);
+
+    struct stat new_file_stat;
+    ASSERT_EQ(stat(new_file_path.toStdString().c_str(), &new_file_stat), 0);
+    EXPECT_LT(new_file_stat.st_blocks * 512, static_cast<blkcnt_t>(content.size()));
+}
+
+TEST(VaultUtils, copy_clones_file_where_platform_can)
+{
+    mpt::TempDir temp_dir1, temp_dir2;
+    auto orig_file_path = QDir(temp_dir1.path()).filePath("test_file");
+    auto expected_path = QDir(temp_dir2.path()).filePath("test_file");
+
+    mpt::make_file_with_content(orig_file_path);
+
+    auto [mock_platform, guard] = mpt::MockPlatform::inject();
+    EXPECT_CALL(*mock_platform, clone_file(StrEq(orig_file_path.toStdString()), StrEq(expected_path.toStdString())))
+        .WillOnce(Return(true));
+
+    EXPECT_EQ(mp::vault::copy(orig_file_path, temp_dir2.path()), expected_path);
+    EXPECT_FALSE(QFile::exists(expected_path));
+}
+
+TEST(VaultUtils, image_hash_cache_does_not_hash_unchanged_files_again)
+{
+    mpt::TempDir temp_dir;
+    const auto image_path = QDir(temp_dir.path()).filePath("image");
+    const auto cache_path = QDir(temp_dir.path()).filePath("hashes.json");
+
+    mpt::make_file_with_content(image_path, "some image");
+    const auto hash = mp::vault::compute_image_hash(image_path);
+
+    EXPECT_EQ(mp::vault::ImageHashCache{cache_path}.hash_of(image_path), hash);
+
+    // Same size and modification time, for all the cache can tell nothing changed
+    struct stat image_stat;
+    ASSERT_EQ(stat(image_path.toStdString().c_str(), &image_stat), 0);
+    {
+        QFile image_file{image_path};
+        ASSERT_TRUE(image_file.open(QIODevice::ReadWrite));
+        ASSERT_EQ(image_file.write("other"), 5);
+    }
+    const timespec times[]{image_stat.st_atim, image_stat.st_mtim};
+    ASSERT_EQ(utimensat(AT_FDCWD, image_path.toStdString().c_str(), times, 0), 0);
+
+    EXPECT_EQ(mp::vault::ImageHashCache{cache_path}.hash_of(image_path), hash);
+}
+
+TEST(VaultUtils, image_hash_cache_hashes_changed_files)
+{
+    mpt::TempDir temp_dir;
+    const auto image_path = QDir(temp_dir.path()).filePath("image");
+    mp::vault::ImageHashCache cache{QDir(temp_dir.path()).filePath("hashes.json")};
+
+    mpt::make_file_with_content(image_path, "some image");
+    const auto hash = cache.hash_of(image_path);
+
+    {
+        QFile image_file{image_path};
+        ASSERT_TRUE(image_file.open(QIODevice::Append));
+        ASSERT_EQ(image_file.write(" and then some"), 14);
+    }
+
+    EXPECT_NE(cache.hash_of(image_path), hash);
+    EXPECT_EQ(cache.hash_of(image_path), mp::vault::compute_image_hash(image_path));
+}
+
+TEST(VaultUtils, blob_store_shares_images_and_prunes_them_once_unused)
+{
+    mpt::TempDir temp_dir;
+    const QDir dir{temp_dir.path()};
+    const mp::vault::BlobStore blobs{dir.filePath("blobs")};
+    const std::string hash{"e3b0c44298fc1c149afbf4c8996fb92427ae41e4649b934ca495991b7852b855"};
+
+    mpt::make_file_with_content(dir.filePath("image"), "some image");
+    EXPECT_FALSE(blobs.link(hash, dir.filePath("shared")));
+
+    blobs.add(hash, dir.filePath("image"));
+    ASSERT_TRUE(blobs.link(hash, dir.filePath("shared")));
+    EXPECT_EQ(mpt::load(dir.filePath("shared")), "some image");
+
+    ASSERT_TRUE(QFile::remove(dir.filePath("image")));
+    blobs.prune();
+    EXPECT_TRUE(QFile::exists(QDir{dir.filePath("blobs")}.filePath(QString::fromStdString(hash))));
+
+    ASSERT_TRUE(QFile::remove(dir.filePath("shared")));
+    blobs.prune();
+    EXPECT_FALSE(QFile::exists(QDir{dir.filePath("blobs")}.filePath(QString::fromStdString(hash))));
+}
+
+TEST(VaultUtils, blob_store_takes_nothing_but_hashes)
+{
+    mpt::TempDir temp_dir;
+    const QDir dir{temp_dir.path()};
+    const mp::vault::BlobStore blobs{dir.filePath("blobs")};
+
+    mpt::make_file_with_content(dir.filePath("image"), "some image");
+    blobs.add("../escaped", dir.filePath("image"));
+
+    EXPECT_FALSE(QFile::exists(dir.filePath("escaped")));
+    EXPECT_FALSE(blobs.link("../image", dir.filePath("shared")));
+}
+
 TEST(VaultUtils, copy_returns_empty_path_when_file_name_is_empty)
 {
     mpt::TempDir temp_dir;
@@ -0,0 +1,92 @@
+/*
+ * Copyright (C) Canonical, Ltd.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; version 3.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#include "common.h"
+#include "path.h"
+#include "temp_dir.h"
+
+#include <multipass/xz_image_decoder.h>
+
+#include <QFile>
+
+#include <stdexcept>
+
+namespace mp = multipass;
+namespace mpt = multipass::test;
+
+using namespace testing;
+
+namespace
+{
+struct XzImageDecoder : public Test
+{
+    // What the test images hold, compressed both in one block and in blocks of 64 KiB
+    static QByteArray expected_content()
+    {
+        QByteArray content;
+        for (auto i = 0; i < 300000; ++i)
+            content.append(char((i * 7 + i / 100) % 256));
+
+        return content;
+    }
+
+    mpt::TempDir temp_dir;
+    const QString decoded_file_path{temp_dir.path() + "/image.img"};
+};
+
+struct XzImageDecoderImages : public XzImageDecoder, public WithParamInterface<const char*>
+{
+};
+} // namespace
+
+TEST_P(XzImageDecoderImages, decodes_image)
+{
+    mp::XzImageDecoder decoder{mpt::test_data_path_for(GetParam())};
+
+    auto last_progress = -1;
+    decoder.decode_to(decoded_file_path, [&last_progress](int, int progress) {
+        EXPECT_GE(progress, last_progress);
+        last_progress = progress;
+        return true;
+    });
+
+    EXPECT_EQ(last_progress, 100);
+
+    QFile decoded_file{decoded_file_path};
+    ASSERT_TRUE(decoded_file.open(QIODevice::ReadOnly));
+    EXPECT_EQ(decoded_file.readAll(), expected_content());
+}
+
+INSTANTIATE_TEST_SUITE_P(XzImageDecoder, XzImageDecoderImages, Values("single_block.img.xz", "multi_block.img.xz"));
+
+TEST_F(XzImageDecoder, fails_on_corrupt_block)
+{
+    const auto corrupt_file_path = temp_dir.path() + "/corrupt.img.xz";
+    ASSERT_TRUE(QFile::copy(mpt::test_data_path_for("multi_block.img.xz"), corrupt_file_path));
+
+    // Somewhere in the compressed data of the second block, leaving the index alone
+    QFile corrupt_file{corrupt_file_path};
+    ASSERT_TRUE(corrupt_file.open(QIODevice::ReadWrite));
+    ASSERT_TRUE(corrupt_file.seek(corrupt_file.size() / 3));
+    const auto byte = corrupt_file.peek(1);
+    ASSERT_TRUE(corrupt_file.putChar(~byte[0]));
+    corrupt_file.close();
+
+    mp::XzImageDecoder decoder{corrupt_file_path};
+
+    EXPECT_THROW(decoder.decode_to(decoded_file_path, [](auto...) { return true; }), std::runtime_error);
+}
@@ -0,0 +1,212 @@
+/*
+ * Copyright (C) Canonical, Ltd.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; version 3.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#include "common.h"
+#include "mock_url_downloader.h"
+#include "temp_dir.h"
+
+#include <src/daemon/zsync_delta.h>
+
+#include <multipass/checksum.h>
+#include <multipass/exceptions/download_exception.h>
+#include <multipass/vm_image_info.h>
+
+#include <QFile>
+
+#include <stdexcept>
+
+namespace mp = multipass;
+namespace mpt = multipass::test;
+
+using namespace testing;
+
+namespace
+{
+constexpr auto block_size = 1024;
+
+// Nothing that repeats, for blocks to be found only where they are
+QByteArray content(int size, std::uint32_t seed)
+{
+    QByteArray data;
+    for (auto i = 0; i < size; ++i)
+    {
+        seed ^= seed << 13;
+        seed ^= seed >> 17;
+        seed ^= seed << 5;
+        data.append(char(seed >> 24));
+    }
+
+    return data;
+}
+
+// As zsyncmake writes it, with whole sums
+QByteArray control_file_for(const QByteArray& target, const QByteArray& extra_headers = {})
+{
+    auto control = QByteArray{"zsync: 0.6.2\nFilename: image.img\nBlocksize: "} + QByteArray::number(block_size) +
+                   "\nLength: " + QByteArray::number(target.size()) + "\nHash-Lengths: 1,4,16\n" + extra_headers +
+                   "\n";
+
+    for (auto offset = 0; offset < target.size(); offset += block_size)
+    {
+        auto block = target.mid(offset, block_size);
+        block.append(QByteArray(block_size - block.size(), '\0'));
+
+        const auto data = reinterpret_cast<const std::uint8_t*>(block.constData());
+        const auto rsum = mp::zsync::rsum(data, block.size());
+        for (auto shift : {24, 16, 8, 0})
+            control.append(char(rsum >> shift));
+
+        const auto checksum = mp::checksum::md4(data, block.size());
+        control.append(reinterpret_cast<const char*>(checksum.data()), checksum.size());
+    }
+
+    return control;
+}
+
+std::string sha256_of(const QByteArray& data)
+{
+    mp::checksum::Sha256 hash;
+    hash.add_data(data.constData(), data.size());
+    return hash.hex_digest();
+}
+
+struct ZsyncDelta : public Test
+{
+    QString write(const QString& name, const QByteArray& data)
+    {
+        const auto path = temp_dir.path() + "/" + name;
+        QFile file{path};
+        EXPECT_TRUE(file.open(QIODevice::WriteOnly));
+        EXPECT_EQ(file.write(data), data.size());
+
+        return path;
+    }
+
+    mp::VMImageInfo info_for(const QByteArray& target)
+    {
+        return {{}, {}, {}, {}, true, image_url, QString::fromStdString(sha256_of(target)), {}, {}, target.size(),
+                true};
+    }
+
+    mpt::TempDir temp_dir;
+    const QString image_url{"http://images.fake/daily/image.img"};
+    const QString image_path{temp_dir.path() + "/image.img"};
+    NiceMock<mpt::MockURLDownloader> downloader;
+    const mp::ProgressMonitor monitor{[](auto...) { return true; }};
+};
+} // namespace
+
+TEST_F(ZsyncDelta, parses_the_control_file)
+{
+    const auto target = content(10 * block_size + 100, 1);
+    const auto control = mp::zsync::parse_control_file(control_file_for(target));
+
+    EXPECT_EQ(control.length, target.size());
+    EXPECT_EQ(control.block_size, block_size);
+    EXPECT_EQ(control.rsum_bytes, 4);
+    EXPECT_EQ(control.checksum_bytes, 16);
+    ASSERT_EQ(control.blocks.size(), 11u);
+    EXPECT_EQ(control.blocks[1].rsum,
+              mp::zsync::rsum(reinterpret_cast<const std::uint8_t*>(target.constData()) + block_size, block_size));
+}
+
+TEST_F(ZsyncDelta, refuses_what_it_cannot_rebuild_from)
+{
+    const auto target = content(4 * block_size, 1);
+
+    EXPECT_THROW(mp::zsync::parse_control_file("not a control file"), std::runtime_error);
+    EXPECT_THROW(mp::zsync::parse_control_file(control_file_for(target, "Z-Map2: 12\n")), std::runtime_error);
+    EXPECT_THROW(mp::zsync::parse_control_file(control_file_for(target).chopped(1)), std::runtime_error);
+}
+
+TEST_F(ZsyncDelta, finds_blocks_wherever_they_moved)
+{
+    const auto target = content(8 * block_size, 1);
+
+    // Shifted by a few bytes, with the fourth block changed
+    auto basis = QByteArray("shift") + target;
+    basis.replace(5 + 3 * block_size, block_size, content(block_size, 7));
+
+    const auto control = mp::zsync::parse_control_file(control_file_for(target));
+    const auto found = mp::zsync::find_blocks(control, reinterpret_cast<const std::uint8_t*>(basis.constData()),
+                                              basis.size());
+
+    ASSERT_EQ(found.size(), 8u);
+    for (auto i = 0; i < 8; ++i)
+        EXPECT_EQ(found[i], i == 3 ? -1 : 5 + i * block_size) << "block " << i;
+}
+
+TEST_F(ZsyncDelta, fetches_only_what_the_basis_does_not_have)
+{
+    const auto target = content(200 * block_size + 300, 1);
+    auto old = target;
+    old.replace(100 * block_size, block_size, content(block_size, 9));
+    const auto basis = write("old.img", QByteArray("a little header") + old);
+
+    EXPECT_CALL(downloader, download(QUrl{image_url + ".zsync"})).WillOnce(Return(control_file_for(target)));
+    EXPECT_CALL(downloader, download_range(QUrl{image_url}, _, _))
+        .WillOnce([&target](auto, qint64 offset, qint64 size) {
+            EXPECT_LT(size, 100 * block_size);
+            return target.mid(offset, size);
+        })
+        .WillOnce([&target](auto, qint64 offset, qint64 size) {
+            // The partial last block, which the basis cannot have whole
+            EXPECT_EQ(offset + size, target.size());
+            return target.mid(offset, size);
+        });
+
+    EXPECT_TRUE(mp::zsync::fetch_delta(&downloader, info_for(target), basis, image_path, monitor));
+
+    QFile image{image_path};
+    ASSERT_TRUE(image.open(QIODevice::ReadOnly));
+    EXPECT_EQ(image.readAll(), target);
+}
+
+TEST_F(ZsyncDelta, gives_up_when_the_result_does_not_verify)
+{
+    const auto target = content(20 * block_size, 1);
+    const auto basis = write("old.img", target);
+    auto info = info_for(target);
+    info.id = QString::fromStdString(sha256_of("something else"));
+
+    EXPECT_CALL(downloader, download(_)).WillOnce(Return(control_file_for(target)));
+
+    EXPECT_FALSE(mp::zsync::fetch_delta(&downloader, info, basis, image_path, monitor));
+    EXPECT_FALSE(QFile::exists(image_path));
+}
+
+TEST_F(ZsyncDelta, gives_up_without_a_control_file)
+{
+    const auto target = content(20 * block_size, 1);
+    const auto basis = write("old.img", target);
+
+    EXPECT_CALL(downloader, download(_)).WillOnce(Throw(mp::DownloadException{"url", "Not Found"}));
+    EXPECT_CALL(downloader, download_range).Times(0);
+
+    EXPECT_FALSE(mp::zsync::fetch_delta(&downloader, info_for(target), basis, image_path, monitor));
+}
+
+TEST_F(ZsyncDelta, gives_up_when_there_is_too_little_in_common)
+{
+    const auto target = content(20 * block_size, 1);
+    const auto basis = write("old.img", content(20 * block_size, 3));
+
+    EXPECT_CALL(downloader, download(_)).WillOnce(Return(control_file_for(target)));
+    EXPECT_CALL(downloader, download_range).Times(0);
+
+    EXPECT_FALSE(mp::zsync::fetch_delta(&downloader, info_for(target), basis, image_path, monitor));
+}
@@ -26,6 +26,14 @@
 
 #include <src/daemon/daemon_rpc.h>
 
+#include <multipass/constants.h>
+#include <multipass/utils.h>
+
+#include <condition_variable>
+#include <future>
+#include <mutex>
+#include <vector>
+
 namespace mp = multipass;
 namespace mpl = multipass::logging;
 namespace mpt = multipass::test;
@@ -193,6 +201,118 @@ TEST_F(TestDaemonRpc, pingReturnsUnauthenticatedWhenCertIsNotVerified)
     EXPECT_EQ(stub.ping(&context, request, &reply).error_code(), grpc::StatusCode::UNAUTHENTICATED);
 }
 
+TEST_F(TestDaemonRpc, offersSessionThatAuthenticatesThroughLocalSocket)
+{
+    EXPECT_CALL(*mock_platform, set_server_socket_restrictions(_, false)).Times(1);
+    EXPECT_CALL(*mock_cert_store, empty()).WillOnce(Return(false));
+    EXPECT_CALL(*mock_cert_store, verify_cert(StrEq(mpt::client_cert))).Times(2).WillRepeatedly(Return(true));
+
+    mpt::MockDaemon daemon{make_secure_server()};
+    mp::PingRequest request;
+    mp::PingReply reply;
+
+    auto stub = make_secure_stub();
+    grpc::ClientContext context;
+    ASSERT_TRUE(stub.ping(&context, request, &reply).ok());
+
+    const auto& metadata = context.GetServerInitialMetadata();
+    const auto session = metadata.find(mp::session_metadata_key);
+    ASSERT_NE(session, metadata.end());
+
+    const std::string token{session->second.data(), session->second.size()};
+    auto credentials = grpc::CompositeChannelCredentials(grpc::experimental::LocalCredentials(LOCAL_UDS),
+                                                         grpc::AccessTokenCredentials(token));
+    mp::Rpc::Stub local_stub{grpc::CreateChannel(mp::utils::local_server_address(server_address), credentials)};
+
+    grpc::ClientContext local_context;
+    EXPECT_TRUE(local_stub.ping(&local_context, request, &reply).ok());
+}
+
+TEST_F(TestDaemonRpc, refusesLocalSocketWithoutSession)
+{
+    EXPECT_CALL(*mock_platform, set_server_socket_restrictions(_, true)).Times(1);
+    EXPECT_CALL(*mock_cert_store, empty()).WillOnce(Return(true));
+    EXPECT_CALL(*mock_cert_store, verify_cert).Times(0);
+
+    mpt::MockDaemon daemon{make_secure_server()};
+    mp::PingRequest request;
+    mp::PingReply reply;
+
+    auto credentials = grpc::CompositeChannelCredentials(grpc::experimental::LocalCredentials(LOCAL_UDS),
+                                                         grpc::AccessTokenCredentials("made-up"));
+    mp::Rpc::Stub local_stub{grpc::CreateChannel(mp::utils::local_server_address(server_address), credentials)};
+
+    grpc::ClientContext context;
+    EXPECT_EQ(local_stub.ping(&context, request, &reply).error_code(), grpc::StatusCode::UNAUTHENTICATED);
+}
+
+TEST_F(TestDaemonRpc, turnsRequestsAwayPastTheCapOnRequestsInFlight)
+{
+    constexpr auto max_requests = mp::DaemonRpc::max_requests_in_flight;
+
+    EXPECT_CALL(*mock_platform, set_server_socket_restrictions(_, false)).Times(1);
+    EXPECT_CALL(*mock_cert_store, empty()).WillRepeatedly(Return(false));
+    EXPECT_CALL(*mock_cert_store, verify_cert(StrEq(mpt::client_cert))).WillRepeatedly(Return(true));
+
+    std::mutex mutex;
+    std::condition_variable held_cv;
+    std::vector<std::promise<grpc::Status>*> held;
+
+    mpt::MockDaemon daemon{make_secure_server()};
+    EXPECT_CALL(daemon, list(_, _, _))
+        .Times(max_requests + 1)
+        .WillRepeatedly([&mutex, &held_cv, &held](auto, auto, auto* status_promise) {
+            std::lock_guard lock{mutex};
+            held.push_back(status_promise);
+            held_cv.notify_all();
+        });
+
+    auto list = [this] {
+        auto stub = make_secure_stub();
+        grpc::ClientContext context;
+        auto stream = stub.list(&context);
+        stream->Write(mp::ListRequest{});
+        stream->WritesDone();
+
+        mp::ListReply reply;
+        while (stream->Read(&reply))
+            ;
+        return stream->Finish();
+    };
+
+    // The daemon holds on to these, without answering them
+    std::vector<std::future<grpc::Status>> in_flight;
+    for (auto i = 0; i < max_requests; ++i)
+        in_flight.push_back(std::async(std::launch::async, list));
+
+    {
+        std::unique_lock lock{mutex};
+        held_cv.wait(lock, [&held] { return held.size() == static_cast<std::size_t>(max_requests); });
+    }
+
+    EXPECT_EQ(list().error_code(), grpc::StatusCode::RESOURCE_EXHAUSTED);
+
+    {
+        std::lock_guard lock{mutex};
+        for (auto* status_promise : held)
+            status_promise->set_value(grpc::Status::OK);
+        held.clear();
+    }
+
+    for (auto& request : in_flight)
+        EXPECT_TRUE(request.get().ok());
+
+    // With the others answered, there is room again
+    auto last_request = std::async(std::launch::async, list);
+    {
+        std::unique_lock lock{mutex};
+        held_cv.wait(lock, [&held] { return held.size() == 1; });
+        held.front()->set_value(grpc::Status::OK);
+    }
+
+    EXPECT_TRUE(last_request.get().ok());
+}
+
 // The following 'list' command tests are for testing the authentication of an arbirary command in DaemonRpc
 TEST_F(TestDaemonRpc, listCertExistsCompletesSuccesfully)
 {
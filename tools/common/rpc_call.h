@@ -0,0 +1,63 @@
+/*
+ * Copyright (C) Canonical, Ltd.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; version 3.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#ifndef MULTIPASS_TOOLS_RPC_CALL_H
+#define MULTIPASS_TOOLS_RPC_CALL_H
+
+#include <multipass/format.h>
+
+#include <grpcpp/grpcpp.h>
+
+#include <algorithm>
+#include <cmath>
+#include <functional>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+namespace multipass
+{
+namespace tools
+{
+// Writes the one request a streaming call takes and reads its replies through, throwing if it does not succeed
+template <typename Reply, typename Request, typename Call>
+void dispatch(const std::string& what, Call&& call, const Request& request,
+              const std::function<void(const Reply&)>& on_reply = {})
+{
+    grpc::ClientContext context;
+    auto stream = call(&context);
+    stream->Write(request);
+    stream->WritesDone();
+
+    Reply reply;
+    while (stream->Read(&reply))
+        if (on_reply)
+            on_reply(reply);
+
+    if (const auto status = stream->Finish(); !status.ok())
+        throw std::runtime_error{fmt::format("{} failed: {}", what, status.error_message())};
+}
+
+// Nearest rank, of sorted values
+inline double percentile(const std::vector<double>& sorted, double p)
+{
+    const auto rank = static_cast<std::size_t>(std::ceil(p / 100 * sorted.size()));
+    return sorted[std::clamp<std::size_t>(rank, 1, sorted.size()) - 1];
+}
+} // namespace tools
+} // namespace multipass
+#endif // MULTIPASS_TOOLS_RPC_CALL_H
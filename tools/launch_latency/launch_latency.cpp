@@ -0,0 +1,328 @@
+/*
+ * Copyright (C) Canonical, Ltd.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; version 3.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+// Drives a running daemon through a launch, stop, start, suspend, resume and delete of instances, again and again,
+// and prints how long each operation took, and each of its phases as seen in the daemon's trace spans.
+// Run it once per backend, the daemon's local.driver labels the results.
+
+#include "common/rpc_call.h"
+
+#include <multipass/cli/client_common.h>
+#include <multipass/constants.h>
+#include <multipass/format.h>
+#include <multipass/logging/tracer.h>
+#include <multipass/rpc/multipass.grpc.pb.h>
+#include <multipass/top_catch_all.h>
+
+#include <QCommandLineParser>
+#include <QCoreApplication>
+#include <QJsonDocument>
+#include <QJsonObject>
+
+#include <algorithm>
+#include <chrono>
+#include <fstream>
+#include <functional>
+#include <iostream>
+#include <map>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+namespace mp = multipass;
+namespace mpl = multipass::logging;
+namespace mpt = multipass::tools;
+
+namespace
+{
+using Clock = mpl::Tracer::Clock; // the daemon's, the monotonic clock is system wide
+using Milliseconds = std::chrono::duration<double, std::milli>;
+
+constexpr auto total_phase = "total";
+
+struct Sample
+{
+    std::string operation;
+    bool cold_cache;
+    std::map<std::string, double> phases; // in milliseconds, by name
+};
+
+// The trace file grows as the daemon works, each call picks up the spans recorded since the last one
+class TraceReader
+{
+public:
+    explicit TraceReader(const std::string& path) : in{path}
+    {
+        if (!path.empty() && !in)
+            throw std::runtime_error{fmt::format("Could not open trace file \"{}\"", path)};
+        skip_to_end();
+    }
+
+    // Summed by name, for the spans that began and ended in the window
+    std::map<std::string, double> phases_between(Clock::time_point start, Clock::time_point end)
+    {
+        std::map<std::string, double> phases;
+        if (!in.is_open())
+            return phases;
+
+        const auto start_us = std::chrono::duration_cast<std::chrono::microseconds>(start.time_since_epoch()).count();
+        const auto end_us = std::chrono::duration_cast<std::chrono::microseconds>(end.time_since_epoch()).count();
+
+        in.clear();
+        std::string line;
+        while (std::getline(in, line))
+        {
+            if (!line.empty() && line.back() == ',')
+                line.pop_back();
+
+            const auto event = QJsonDocument::fromJson(QByteArray::fromStdString(line)).object();
+            if (event.isEmpty())
+                continue;
+
+            const auto ts = event["ts"].toVariant().toLongLong();
+            const auto dur = event["dur"].toVariant().toLongLong();
+            if (ts >= start_us && ts + dur <= end_us)
+                phases[event["name"].toString().toStdString()] += dur / 1000.0;
+        }
+
+        return phases;
+    }
+
+    void skip_to_end()
+    {
+        if (in.is_open())
+            phases_between(Clock::time_point::max(), Clock::time_point::max());
+    }
+
+private:
+    std::ifstream in;
+};
+
+template <typename Request>
+Request request_for(const std::string& instance)
+{
+    Request request;
+    request.mutable_instance_names()->add_instance_name(instance);
+    return request;
+}
+
+class Driver
+{
+public:
+    Driver(mp::Rpc::Stub& stub, TraceReader& trace) : stub{stub}, trace{trace}
+    {
+    }
+
+    // Whether the image had to be downloaded tells a cold cache from a warm one
+    bool launch(mp::LaunchRequest request)
+    {
+        bool downloaded = false;
+        std::map<std::string, double> stage_timings;
+
+        time("launch", [&] {
+            mpt::dispatch<mp::LaunchReply>(
+                "launch", [this](auto context) { return stub.launch(context); }, request,
+                [&](const mp::LaunchReply& reply) {
+                    if (reply.has_launch_progress() && reply.launch_progress().type() == mp::LaunchProgress::IMAGE)
+                        downloaded = true;
+                    for (const auto& timing : reply.stage_timings())
+                        stage_timings[fmt::format("stage:{}", timing.stage())] = timing.milliseconds();
+                });
+        });
+
+        cold_cache = downloaded; // and for the rest of this instance's lifecycle
+        samples.back().cold_cache = downloaded;
+        samples.back().phases.merge(stage_timings);
+        return downloaded;
+    }
+
+    void start(const std::string& instance, const std::string& operation = "start")
+    {
+        time(operation, [&] {
+            mpt::dispatch<mp::StartReply>(
+                operation, [this](auto context) { return stub.start(context); },
+                request_for<mp::StartRequest>(instance));
+        });
+    }
+
+    void stop(const std::string& instance)
+    {
+        time("stop", [&] {
+            mpt::dispatch<mp::StopReply>(
+                "stop", [this](auto context) { return stub.stop(context); }, request_for<mp::StopRequest>(instance));
+        });
+    }
+
+    void suspend(const std::string& instance)
+    {
+        time("suspend", [&] {
+            mpt::dispatch<mp::SuspendReply>(
+                "suspend", [this](auto context) { return stub.suspend(context); },
+                request_for<mp::SuspendRequest>(instance));
+        });
+    }
+
+    void remove(const std::string& instance)
+    {
+        auto request = request_for<mp::DeleteRequest>(instance);
+        request.set_purge(true);
+
+        time("delete", [&] {
+            mpt::dispatch<mp::DeleteReply>(
+                "delete", [this](auto context) { return stub.delet(context); }, request);
+        });
+    }
+
+    const std::vector<Sample>& results() const
+    {
+        return samples;
+    }
+
+private:
+    void time(const std::string& operation, const std::function<void()>& run)
+    {
+        trace.skip_to_end();
+        const auto start = Clock::now();
+        run();
+        const auto end = Clock::now();
+
+        auto phases = trace.phases_between(start, end);
+        phases[total_phase] = Milliseconds{end - start}.count();
+        samples.push_back({operation, cold_cache, std::move(phases)});
+    }
+
+    mp::Rpc::Stub& stub;
+    TraceReader& trace;
+    bool cold_cache{false};
+    std::vector<Sample> samples;
+};
+
+std::string get_driver(mp::Rpc::Stub& stub)
+{
+    mp::GetRequest request;
+    request.set_key(mp::driver_key);
+
+    std::string driver;
+    mpt::dispatch<mp::GetReply>(
+        "get", [&stub](auto context) { return stub.get(context); }, request,
+        [&driver](const mp::GetReply& reply) { driver = reply.value(); });
+
+    return driver;
+}
+
+void print_summary(const std::string& driver, const std::vector<Sample>& samples)
+{
+    // By cache state, then operation, then phase
+    std::map<bool, std::map<std::string, std::map<std::string, std::vector<double>>>> grouped;
+    std::vector<std::string> operations;
+    for (const auto& sample : samples)
+    {
+        if (std::find(operations.cbegin(), operations.cend(), sample.operation) == operations.cend())
+            operations.push_back(sample.operation);
+        for (const auto& [phase, milliseconds] : sample.phases)
+            grouped[sample.cold_cache][sample.operation][phase].push_back(milliseconds);
+    }
+
+    for (const auto& [cold_cache, by_operation] : grouped)
+    {
+        fmt::print("\n{} backend, {} image cache (milliseconds)\n", driver, cold_cache ? "cold" : "warm");
+        fmt::print("{:<32} {:>5} {:>10} {:>10} {:>10} {:>10}\n", "operation / phase", "n", "p50", "p90", "p99",
+                   "max");
+
+        for (const auto& operation : operations)
+        {
+            const auto it = by_operation.find(operation);
+            if (it == by_operation.cend())
+                continue;
+
+            auto phases = it->second;
+            auto print = [](const std::string& label, std::vector<double>& values) {
+                std::sort(values.begin(), values.end());
+                fmt::print("{:<32} {:>5} {:>10.1f} {:>10.1f} {:>10.1f} {:>10.1f}\n", label, values.size(),
+                           mpt::percentile(values, 50), mpt::percentile(values, 90), mpt::percentile(values, 99),
+                           values.back());
+            };
+
+            print(operation, phases[total_phase]);
+            phases.erase(total_phase);
+            for (auto& [phase, values] : phases)
+                print(fmt::format("  {}", phase), values);
+        }
+    }
+}
+
+int main_impl(int argc, char* argv[])
+{
+    QCoreApplication app(argc, argv);
+    QCoreApplication::setApplicationName(mp::client_name); // to find the client's certificates
+
+    QCommandLineParser parser;
+    parser.setApplicationDescription(
+        fmt::format("Times the instance lifecycle against a running daemon. For the phases, have the daemon write "
+                    "its traces with {} and pass the same file with --trace-file.",
+                    mpl::trace_file_env_var)
+            .c_str());
+    parser.addHelpOption();
+
+    QCommandLineOption image_option{"image", "Image to launch, the default one if not given", "image"};
+    QCommandLineOption iterations_option{"iterations", "Lifecycles to go through, 5 by default", "n", "5"};
+    QCommandLineOption trace_option{"trace-file", "The daemon's trace file", "path"};
+    QCommandLineOption prefix_option{"name-prefix", "Prefix of the instances' names, \"latency\" by default",
+                                     "prefix", "latency"};
+    parser.addOptions({image_option, iterations_option, trace_option, prefix_option});
+    parser.process(app);
+
+    bool ok;
+    const auto iterations = parser.value(iterations_option).toInt(&ok);
+    if (!ok || iterations < 1)
+        throw std::runtime_error{"--iterations must be a positive integer"};
+
+    auto cert_provider = mp::client::get_cert_provider();
+    mp::Rpc::Stub stub{mp::client::make_channel(mp::client::get_server_address(), cert_provider.get())};
+
+    TraceReader trace{parser.value(trace_option).toStdString()};
+    Driver driver{stub, trace};
+    const auto backend = get_driver(stub);
+
+    for (auto i = 0; i < iterations; ++i)
+    {
+        const auto instance = fmt::format("{}-{}", parser.value(prefix_option), i);
+
+        mp::LaunchRequest request;
+        request.set_instance_name(instance);
+        request.set_image(parser.value(image_option).toStdString());
+
+        const auto cold = driver.launch(request);
+        driver.stop(instance);
+        driver.start(instance);
+        driver.suspend(instance);
+        driver.start(instance, "resume");
+        driver.remove(instance);
+
+        std::cerr << fmt::format("{}: lifecycle {} of {} done, {} image cache\n", instance, i + 1, iterations,
+                                 cold ? "cold" : "warm");
+    }
+
+    print_summary(backend, driver.results());
+    return EXIT_SUCCESS;
+}
+} // namespace
+
+int main(int argc, char* argv[])
+{
+    return mp::top_catch_all("launch_latency", /* fallback_return = */ EXIT_FAILURE, main_impl, argc, argv);
+}
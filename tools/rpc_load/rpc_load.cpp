@@ -0,0 +1,290 @@
+/*
+ * Copyright (C) Canonical, Ltd.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; version 3.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+// Keeps a daemon busy with many clients at once, each going through a mix of the quick, read-only RPCs, while
+// instances launch in the background, and prints the latencies and errors of each kind of call.
+
+#include "common/rpc_call.h"
+
+#include <multipass/cli/client_common.h>
+#include <multipass/constants.h>
+#include <multipass/format.h>
+#include <multipass/rpc/multipass.grpc.pb.h>
+#include <multipass/top_catch_all.h>
+
+#include <QCommandLineParser>
+#include <QCoreApplication>
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <functional>
+#include <iostream>
+#include <map>
+#include <mutex>
+#include <random>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace mp = multipass;
+namespace mpt = multipass::tools;
+
+namespace
+{
+using Clock = std::chrono::steady_clock;
+using Milliseconds = std::chrono::duration<double, std::milli>;
+
+constexpr auto default_mix = "list=1,info=1,find=1,get=1,version=1,ping=1";
+
+using Call = void (*)(mp::Rpc::Stub&);
+
+const std::map<std::string, Call> calls{
+    {"list",
+     [](mp::Rpc::Stub& stub) {
+         mpt::dispatch<mp::ListReply>(
+             "list", [&stub](auto context) { return stub.list(context); }, mp::ListRequest{});
+     }},
+    {"info",
+     [](mp::Rpc::Stub& stub) {
+         mpt::dispatch<mp::InfoReply>(
+             "info", [&stub](auto context) { return stub.info(context); }, mp::InfoRequest{});
+     }},
+    {"find",
+     [](mp::Rpc::Stub& stub) {
+         mpt::dispatch<mp::FindReply>(
+             "find", [&stub](auto context) { return stub.find(context); }, mp::FindRequest{});
+     }},
+    {"get",
+     [](mp::Rpc::Stub& stub) {
+         mp::GetRequest request;
+         request.set_key(mp::driver_key);
+         mpt::dispatch<mp::GetReply>(
+             "get", [&stub](auto context) { return stub.get(context); }, request);
+     }},
+    {"version",
+     [](mp::Rpc::Stub& stub) {
+         mpt::dispatch<mp::VersionReply>(
+             "version", [&stub](auto context) { return stub.version(context); }, mp::VersionRequest{});
+     }},
+    {"ping", [](mp::Rpc::Stub& stub) {
+         grpc::ClientContext context;
+         mp::PingReply reply;
+         if (const auto status = stub.ping(&context, mp::PingRequest{}, &reply); !status.ok())
+             throw std::runtime_error{fmt::format("ping failed: {}", status.error_message())};
+     }}};
+
+struct Results
+{
+    std::vector<double> latencies; // in milliseconds
+    std::size_t errors{0};
+    std::string last_error;
+};
+
+// "list=4,ping=1" as the names of the calls, each repeated as many times as it weighs
+std::vector<std::string> parse_mix(const QString& mix)
+{
+    std::vector<std::string> weighted;
+    for (const auto& entry : mix.split(',', QString::SkipEmptyParts))
+    {
+        const auto pair = entry.split('=');
+        const auto name = pair.first().trimmed().toStdString();
+        if (calls.find(name) == calls.cend())
+            throw std::runtime_error{fmt::format("Unknown call \"{}\" in the mix", name)};
+
+        bool ok = pair.size() == 1;
+        const auto weight = ok ? 1 : pair.at(1).toInt(&ok);
+        if (!ok || weight < 0)
+            throw std::runtime_error{fmt::format("Invalid weight for \"{}\" in the mix", name)};
+
+        weighted.insert(weighted.end(), static_cast<std::size_t>(weight), name);
+    }
+
+    if (weighted.empty())
+        throw std::runtime_error{"The mix has no calls"};
+
+    return weighted;
+}
+
+void launch_in_background(mp::Rpc::Stub& stub, const std::vector<std::string>& instances, const std::string& image,
+                          const std::atomic_bool& done, Results& results)
+{
+    for (const auto& instance : instances)
+    {
+        if (done)
+            break;
+
+        mp::LaunchRequest request;
+        request.set_instance_name(instance);
+        request.set_image(image);
+
+        const auto start = Clock::now();
+        try
+        {
+            mpt::dispatch<mp::LaunchReply>(
+                "launch", [&stub](auto context) { return stub.launch(context); }, request);
+            results.latencies.push_back(Milliseconds{Clock::now() - start}.count());
+        }
+        catch (const std::exception& e)
+        {
+            ++results.errors;
+            results.last_error = e.what();
+        }
+    }
+}
+
+void delete_instances(mp::Rpc::Stub& stub, const std::vector<std::string>& instances)
+{
+    mp::DeleteRequest request;
+    for (const auto& instance : instances)
+        request.mutable_instance_names()->add_instance_name(instance);
+    request.set_purge(true);
+
+    mpt::dispatch<mp::DeleteReply>(
+        "delete", [&stub](auto context) { return stub.delet(context); }, request);
+}
+
+void print_summary(const std::map<std::string, Results>& by_call, std::chrono::duration<double> elapsed)
+{
+    fmt::print("{:<10} {:>8} {:>7} {:>9} {:>10} {:>10} {:>10} {:>10}\n", "call", "n", "errors", "per sec",
+               "p50 ms", "p99 ms", "p999 ms", "max ms");
+
+    for (auto [name, results] : by_call)
+    {
+        auto& values = results.latencies;
+        std::sort(values.begin(), values.end());
+
+        if (values.empty())
+            fmt::print("{:<10} {:>8} {:>7}\n", name, 0, results.errors);
+        else
+            fmt::print("{:<10} {:>8} {:>7} {:>9.1f} {:>10.2f} {:>10.2f} {:>10.2f} {:>10.2f}\n", name, values.size(),
+                       results.errors, values.size() / elapsed.count(), mpt::percentile(values, 50),
+                       mpt::percentile(values, 99), mpt::percentile(values, 99.9), values.back());
+
+        if (results.errors)
+            fmt::print("  last error: {}\n", results.last_error);
+    }
+}
+
+int main_impl(int argc, char* argv[])
+{
+    QCoreApplication app(argc, argv);
+    QCoreApplication::setApplicationName(mp::client_name); // to find the client's certificates
+
+    QCommandLineParser parser;
+    parser.setApplicationDescription("Loads a running daemon with concurrent clients and reports their latencies.");
+    parser.addHelpOption();
+
+    QCommandLineOption clients_option{"clients", "Concurrent clients, 8 by default", "n", "8"};
+    QCommandLineOption duration_option{"duration", "Seconds to keep going, 30 by default", "seconds", "30"};
+    QCommandLineOption mix_option{"mix", fmt::format("Calls to make, with their weights, \"{}\" by default",
+                                                     default_mix).c_str(), "mix", default_mix};
+    QCommandLineOption launches_option{"launches", "Instances to launch in the background, none by default", "n",
+                                       "0"};
+    QCommandLineOption image_option{"image", "Image for the background launches, the default one if not given",
+                                    "image"};
+    QCommandLineOption prefix_option{"name-prefix", "Prefix of the launched instances' names, \"load\" by default",
+                                     "prefix", "load"};
+    parser.addOptions({clients_option, duration_option, mix_option, launches_option, image_option, prefix_option});
+    parser.process(app);
+
+    bool clients_ok, duration_ok, launches_ok;
+    const auto clients = parser.value(clients_option).toInt(&clients_ok);
+    const auto duration = std::chrono::seconds{parser.value(duration_option).toInt(&duration_ok)};
+    const auto launches = parser.value(launches_option).toInt(&launches_ok);
+    if (!clients_ok || clients < 1 || !duration_ok || duration.count() < 1 || !launches_ok || launches < 0)
+        throw std::runtime_error{"--clients and --duration must be positive integers, --launches not negative"};
+
+    const auto mix = parse_mix(parser.value(mix_option));
+    const auto server_address = mp::client::get_server_address();
+    const auto cert_provider = mp::client::get_cert_provider();
+
+    std::vector<std::string> instances;
+    for (auto i = 0; i < launches; ++i)
+        instances.push_back(fmt::format("{}-{}", parser.value(prefix_option), i));
+
+    std::atomic_bool done{false};
+    Results launch_results;
+    mp::Rpc::Stub launch_stub{mp::client::make_channel(server_address, cert_provider.get())};
+    std::thread launcher{launch_in_background, std::ref(launch_stub), std::cref(instances),
+                         parser.value(image_option).toStdString(), std::cref(done), std::ref(launch_results)};
+
+    // Each client its own channel and its own results, merged once they are all done
+    std::vector<std::map<std::string, Results>> client_results(clients);
+    std::vector<std::thread> threads;
+    const auto start = Clock::now();
+    const auto deadline = start + duration;
+    for (auto i = 0; i < clients; ++i)
+    {
+        threads.emplace_back([&, i] {
+            mp::Rpc::Stub stub{mp::client::make_channel(server_address, cert_provider.get())};
+            std::mt19937 random{static_cast<std::mt19937::result_type>(i)};
+            std::uniform_int_distribution<std::size_t> pick{0, mix.size() - 1};
+
+            while (Clock::now() < deadline)
+            {
+                const auto& name = mix[pick(random)];
+                auto& results = client_results[i][name];
+
+                const auto call_start = Clock::now();
+                try
+                {
+                    calls.at(name)(stub);
+                    results.latencies.push_back(Milliseconds{Clock::now() - call_start}.count());
+                }
+                catch (const std::exception& e)
+                {
+                    ++results.errors;
+                    results.last_error = e.what();
+                }
+            }
+        });
+    }
+
+    for (auto& thread : threads)
+        thread.join();
+    const auto elapsed = Clock::now() - start;
+
+    done = true;
+    launcher.join();
+    if (!instances.empty())
+        delete_instances(launch_stub, instances);
+
+    std::map<std::string, Results> by_call;
+    for (auto& results : client_results)
+        for (auto& [name, client] : results)
+        {
+            auto& merged = by_call[name];
+            merged.latencies.insert(merged.latencies.end(), client.latencies.cbegin(), client.latencies.cend());
+            merged.errors += client.errors;
+            if (!client.last_error.empty())
+                merged.last_error = client.last_error;
+        }
+
+    if (launches)
+        by_call["launch"] = std::move(launch_results);
+
+    print_summary(by_call, elapsed);
+    return EXIT_SUCCESS;
+}
+} // namespace
+
+int main(int argc, char* argv[])
+{
+    return mp::top_catch_all("rpc_load", /* fallback_return = */ EXIT_FAILURE, main_impl, argc, argv);
+}